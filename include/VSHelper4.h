@@ -26,6 +26,7 @@
 #define VSH_STD_PLUGIN_ID "com.vapoursynth.std"
 #define VSH_RESIZE_PLUGIN_ID "com.vapoursynth.resize"
 #define VSH_TEXT_PLUGIN_ID "com.vapoursynth.text"
+#define VSH_REMOTE_PLUGIN_ID "com.vapoursynth.remote"
 
 #ifdef __cplusplus
 namespace vsh {
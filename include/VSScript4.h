@@ -24,12 +24,15 @@
 #include "VapourSynth4.h"
 
 #define VSSCRIPT_API_MAJOR 4
-#define VSSCRIPT_API_MINOR 0
+#define VSSCRIPT_API_MINOR 1
 #define VSSCRIPT_API_VERSION VS_MAKE_VERSION(VSSCRIPT_API_MAJOR, VSSCRIPT_API_MINOR)
 
 typedef struct VSScript VSScript;
 typedef struct VSSCRIPTAPI VSSCRIPTAPI;
 
+/* Called once an asynchronous evaluation has finished, the handle is the same one that was returned when the evaluation was started */
+typedef void (VS_CC *VSScriptEvaluationDone)(void *userData, VSScript *handle);
+
 typedef struct VSScriptOptions {
     /* Must be set to sizeof(VSScriptOptions) */
     int size; 
@@ -63,6 +66,10 @@ struct VSSCRIPTAPI {
     * Returns a VSScript pointer both on success and error. Call getError() to see if the script evaluation succeeded.
     * Note that calling any function other than getError() and freeScript() on a VSScript object in the error state
     * will result in undefined behavior.
+    *
+    * The GIL is released while plugin functions create their filters so other Python threads, including other
+    * evaluations, can run in the middle of a script. Embedders can't rely on the GIL to keep filter creation
+    * from interleaving with their own Python code.
     */
     VSScript *(VS_CC *evaluateBuffer)(const char *buffer, const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options) VS_NOEXCEPT;
 
@@ -96,6 +103,27 @@ struct VSSCRIPTAPI {
     int (VS_CC *clearLogHandler)(VSScript *handle) VS_NOEXCEPT;
 
     void (VS_CC *freeScript)(VSScript *handle) VS_NOEXCEPT;
+
+    /*
+    * Asynchronous versions of evaluateBuffer() and evaluateFile(), only available in VSSCRIPT_API_MINOR 1 and later. The handle is returned
+    * right away and the script is evaluated on a separate thread which calls done when it's finished, use getError() to see if the evaluation
+    * succeeded. The handle must not be passed to any other function before done has been called. The buffer, vars and options are copied
+    * so they don't have to outlive the call. Scripts share the Python interpreter so their Python code runs one at a time but the
+    * GIL is released while filters are created and frames are waited for, which is where most of the evaluation time is spent in
+    * practice, so several evaluations can make progress at the same time.
+    */
+    VSScript *(VS_CC *evaluateBufferAsync)(const char *buffer, const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options, VSScriptEvaluationDone done, void *userData) VS_NOEXCEPT;
+    VSScript *(VS_CC *evaluateFileAsync)(const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options, VSScriptEvaluationDone done, void *userData) VS_NOEXCEPT;
+
+    /*
+    * Compiles a script once so it can be evaluated many times with different variables, only available in VSSCRIPT_API_MINOR 1 and later.
+    * Use getError() to check if compilation succeeded and freeScript() to release the handle, it can't be passed to any other function.
+    * Each evaluateCompiled() call returns a new handle with its own environment and core that works exactly like one returned by
+    * evaluateBuffer(), the compiled handle is left untouched and can be reused for as long as it exists. Combine with ccfLazyPluginLoading
+    * in the core creation flags to avoid loading every plugin again for each evaluation.
+    */
+    VSScript *(VS_CC *compileBuffer)(const char *buffer, const char *scriptFilename) VS_NOEXCEPT;
+    VSScript *(VS_CC *evaluateCompiled)(VSScript *compiled, const VSMap *vars, const VSScriptOptions *options) VS_NOEXCEPT;
 };
 
 VS_API(const VSSCRIPTAPI *) getVSScriptAPI(int version) VS_NOEXCEPT;
@@ -26,10 +26,10 @@
 
 #define VS_MAKE_VERSION(major, minor) (((major) << 16) | (minor))
 #define VAPOURSYNTH_API_MAJOR 4
-#define VAPOURSYNTH_API_MINOR 0
+#define VAPOURSYNTH_API_MINOR 1
 #define VAPOURSYNTH_API_VERSION VS_MAKE_VERSION(VAPOURSYNTH_API_MAJOR, VAPOURSYNTH_API_MINOR)
 
-#define VS_AUDIO_FRAME_SAMPLES 3072
+#define VS_AUDIO_FRAME_SAMPLES 3072 /* the default number of samples in an audio frame, see setAudioFrameSamples() */
 
 /* Convenience for C++ users. */
 #ifdef __cplusplus
@@ -74,6 +74,8 @@ typedef struct VSFunction VSFunction;
 typedef struct VSMap VSMap;
 typedef struct VSLogHandle VSLogHandle;
 typedef struct VSFrameContext VSFrameContext;
+typedef struct VSSharedThreadPool VSSharedThreadPool;
+typedef struct VSAsyncRequest VSAsyncRequest;
 typedef struct VSPLUGINAPI VSPLUGINAPI;
 typedef struct VSAPI VSAPI;
 
@@ -239,6 +241,21 @@ typedef enum VSMapAppendMode {
     maAppend  = 1
 } VSMapAppendMode;
 
+/* Reserved frame properties that can be accessed without a key lookup through mapGetReservedInt() and mapSetReservedInt() */
+typedef enum VSReservedFrameProperty {
+    rfpChromaLocation = 0,
+    rfpColorRange = 1,
+    rfpPrimaries = 2,
+    rfpMatrix = 3,
+    rfpTransfer = 4,
+    rfpFieldBased = 5,
+    rfpField = 6,
+    rfpDurationNum = 7,
+    rfpDurationDen = 8,
+    rfpSARNum = 9,
+    rfpSARDen = 10
+} VSReservedFrameProperty;
+
 typedef struct VSCoreInfo {
     const char *versionString;
     int core;
@@ -267,6 +284,7 @@ typedef struct VSAudioInfo {
 typedef enum VSActivationReason {
     arInitial = 0,
     arAllFramesReady = 1,
+    arFrameReady = 2, /* only for nodes that enabled it with setNodeFrameReadyActivation() */
     arError = -1
 } VSActivationReason;
 
@@ -281,7 +299,29 @@ typedef enum VSMessageType {
 typedef enum VSCoreCreationFlags {
     ccfEnableGraphInspection = 1,
     ccfDisableAutoLoading = 2,
-    ccfDisableLibraryUnloading = 4
+    ccfDisableLibraryUnloading = 4,
+    ccfEnableWorkStealing = 8, /* use per thread task queues and work stealing instead of a single global task list, scales better with high thread counts */
+    ccfCostAwareEviction = 16, /* when over the memory limit evict the cached frames across all nodes that are cheapest to recompute per byte first instead of shrinking every cache equally */
+    ccfEnableHugePages = 32, /* back big frame planes with huge pages, transparent huge pages on linux and large pages on windows where the process needs the lock pages privilege */
+    ccfNUMALocalFrames = 64, /* allocate frame planes on the numa node of the thread creating the frame */
+    ccfPinWorkerThreads = 128, /* pin the worker threads to the numa nodes in a round robin fashion, best combined with ccfNUMALocalFrames */
+    ccfFusePointwiseFilters = 256, /* merge chains of expr filters with float intermediate formats into a single expr when they are created */
+    ccfMergeIdenticalFilters = 512, /* invoking a function that creates filters with the same arguments and input nodes as an existing instance returns the existing nodes */
+    ccfEnableTracing = 1024, /* record which thread processed which frame of which node, time spent queued, frame requests, cache hits and serial lock contention, see writeTrace() */
+    ccfLazyPluginLoading = 2048, /* autoloaded plugins are created from an on-disk cache of their functions and the library is only loaded when one of them is invoked */
+    ccfAutoTuneThreads = 4096, /* adjust the number of worker threads while running */
+    ccfLookaheadPrefetch = 8192, /* idle workers prefetch the frames after outstanding requests */
+    ccfDeduplicateFrames = 16384, /* hash the planes of video frames as they're added to a cache and let frames with identical content share the same plane memory, shared planes are copied on write like any other */
+    ccfCompressEvictedFrames = 32768, /* keep frequently requested evicted frames losslessly compressed */
+    ccfFuseResizeChains = 65536, /* merge crops and same family conversions into the following resizer */
+    ccfAsyncLogging = 131072, /* deliver log messages from a background thread */
+    ccfFuseSpatialFilters = 262144, /* run chains of simple spatial filters in strips as a single node */
+    ccfPadStrides = 524288, /* add a cache line to plane strides that would be a multiple of 4096 bytes, such as 8 bit 4096 or 16 bit 2048 pixel wide planes, so vertical filters don't suffer from cache set conflicts */
+    ccfPreferPerformanceCores = 1048576, /* run the first workers and serial filters on performance cores */
+    ccfOneThreadPerCore = 2097152, /* bind every worker to its own physical core and default to one worker per physical core instead of one per logical cpu, mostly useful for avx-512 heavy scripts on cpus with smt, takes precedence over ccfPinWorkerThreads */
+    ccfWriteJITSymbols = 4194304, /* name the code generated by Expr in /tmp/perf-<pid>.map for profilers */
+    ccfFrameProcessingTime = 8388608, /* attach _VSProcessingTime and _VSCacheHits to output frames */
+    ccfLiveMode = 16777216 /* caches keep only the most recent frames of live sources */
 } VSCoreCreationFlags;
 
 typedef enum VSPluginConfigFlags {
@@ -300,6 +340,34 @@ typedef enum VSRequestPattern {
     rpStrictSpatial = 2 /* Always (and only) requests frame n from input clip when generating output frame n, never requests frames beyond the end of the clip */
 } VSRequestPattern;
 
+typedef enum VSRequestPriority {
+    prBulk = 0, /* The default, requests are processed in the order they were made */
+    prInteractive = 1 /* Processed before all bulk requests, meant for the frame that is currently being looked at */
+} VSRequestPriority;
+
+typedef enum VSMemoryDomain {
+    mdHost = 0, /* Regular memory allocated by the core or passed to newVideoFrameFromBuffers() */
+    mdPinnedHost = 1, /* Host memory from a gpu api that can be transferred to the device without an extra copy, read and written like mdHost */
+    mdDevice = 2 /* Device memory only reachable through the handle, copied to the host the first time a read or write pointer is requested */
+} VSMemoryDomain;
+
+typedef enum VSVideoOutputFlags {
+    vofY4M = 1, /* Starts with a y4m stream header and puts a FRAME line in front of every frame, only gray and yuv formats can be written this way */
+    vofGBROrder = 2 /* Writes the planes of rgb formats in the gbr order vspipe uses instead of rgb */
+} VSVideoOutputFlags;
+
+/*
+ * Describes how the core handles the planes of frames created with newVideoFrameFromDevice(), the struct has to stay valid as long as there are
+ * frames using it so it's usually a static constant. deviceType identifies the api and device the handles belong to, pick something unlikely to clash
+ * with other plugins such as a fourcc. download copies size bytes of the plane to dst and returns zero on success, it's only called for mdDevice planes
+ * and may be called from any thread. free releases a plane once no frame uses it anymore.
+ */
+typedef struct VSDeviceMemoryFunctions {
+    int deviceType;
+    int (VS_CC *download)(void *handle, uint8_t *dst, size_t size, void *userData);
+    void (VS_CC *free)(void *handle, void *userData);
+} VSDeviceMemoryFunctions;
+
 /* Core entry point */
 typedef const VSAPI *(VS_CC *VSGetVapourSynthAPI)(int version);
 
@@ -309,11 +377,15 @@ typedef void (VS_CC *VSInitPlugin)(VSPlugin *plugin, const VSPLUGINAPI *vspapi);
 typedef void (VS_CC *VSFreeFunctionData)(void *userData);
 typedef const VSFrame *(VS_CC *VSFilterGetFrame)(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi);
 typedef void (VS_CC *VSFilterFree)(void *instanceData, VSCore *core, const VSAPI *vsapi);
+typedef void (VS_CC *VSSliceFunction)(int start, int end, void *userData);
+typedef void (VS_CC *VSFreeFrameBuffer)(void *userData);
+typedef void (VS_CC *VSFreeDataBuffer)(void *userData);
 
 /* Other */
 typedef void (VS_CC *VSFrameDoneCallback)(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg);
 typedef void (VS_CC *VSLogHandler)(int msgType, const char *msg, void *userData);
 typedef void (VS_CC *VSLogHandlerFree)(void *userData);
+typedef int (VS_CC *VSOutputProgressCallback)(void *userData, int written, int total); /* return zero to stop */
 
 struct VSPLUGINAPI {
     int (VS_CC *getAPIVersion)(void) VS_NOEXCEPT; /* returns VAPOURSYNTH_API_VERSION of the library */
@@ -462,7 +534,6 @@ struct VSAPI {
     VSLogHandle *(VS_CC *addLogHandler)(VSLogHandler handler, VSLogHandlerFree free, void *userData, VSCore *core) VS_NOEXCEPT; /* free and userData can be NULL, returns a handle that can be passed to removeLogHandler */
     int (VS_CC *removeLogHandler)(VSLogHandle *handle, VSCore *core) VS_NOEXCEPT; /* returns non-zero if successfully removed */
     
-#ifdef VS_GRAPH_API
     /* Graph information */
 
     /* 
@@ -480,7 +551,341 @@ struct VSAPI {
     int64_t (VS_CC *getNodeFilterTime)(VSNode *node) VS_NOEXCEPT; /* time spent processing frames in nanoseconds */
     const VSFilterDependency *(VS_CC *getNodeDependencies)(VSNode *node) VS_NOEXCEPT;
     int (VS_CC *getNumNodeDependencies)(VSNode *node) VS_NOEXCEPT;
-#endif
+
+    /* Added in API 4.1 */
+
+    /*
+     * Adds scheduler and memory statistics about the core to stats. Times are in nanoseconds and sizes in bytes.
+     *   schedulingTime, filterTime: total time worker threads have spent in the scheduler and in filter code, only measured with ccfEnableGraphInspection
+     *   bufferPoolHits, bufferPoolMisses: plane allocations that were and weren't served from recycled buffers
+     *   bufferPoolSize: memory in unused recycled buffers
+     *   dedupSharedPlanes, dedupSharedBytes: planes replaced by an identical one with ccfDeduplicateFrames
+     *   dedupRegisteredPlanes: planes currently available for sharing with ccfDeduplicateFrames
+     *   compressedCacheSize: memory used by frames compressed with ccfCompressEvictedFrames
+     *   scratchMemory: memory held by the allocScratchMemory() arenas
+     *   memoryUsed, memoryLimit: framebuffer cache usage and its limit
+     *   memoryHardLimit: the limit set with setMemoryHardLimit()
+     *   activeThreads, idleThreads, queuedTasks: snapshot of the thread pool taken without stopping it
+     *   deferredStarts: times the scheduler started holding back new requests because of memory use
+     *   watchdogReports: warnings logged by the watchdog started with setWatchdog()
+     *   cacheAdjustments, cacheAdjustmentTime: times the cache sizes were reevaluated and the time spent doing it
+     *   startupTime, startupThreadPoolTime, startupInternalPluginsTime, startupAutoloadTime: time spent creating the core and its parts
+     */
+    void (VS_CC *getCoreStatistics)(VSCore *core, VSMap *stats) VS_NOEXCEPT;
+
+    /*
+     * Splits [0, count) into ranges of at least minSliceSize items and calls func(start, end, userData) once for every range, idle worker threads
+     * help with the processing and the function returns once all ranges have been processed. Only for use in arAllFramesReady, func may be called
+     * concurrently from several threads and must not call any API functions that request or return frames.
+     */
+    void (VS_CC *processSlices)(int count, int minSliceSize, VSSliceFunction func, void *userData, VSFrameContext *frameCtx) VS_NOEXCEPT;
+
+    /*
+     * Returns a frame that shares the plane data of f and shows the width x height area starting at left, top. With field set to 0 or 1 only the even
+     * or odd lines of the area starting at top are used and height is the height of the result. Nothing is copied until a write pointer is requested.
+     * Returns NULL when the area is out of bounds, not aligned to the subsampling or when the planes of the view would not be aligned in memory, the
+     * caller then has to copy the pixels itself.
+     */
+    VSFrame *(VS_CC *newVideoFrameView)(const VSFrame *f, int left, int top, int width, int height, int field, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Writes all events recorded so far in the chrome trace event format which can be opened in chrome://tracing or https://ui.perfetto.dev.
+     * Returns zero if the core wasn't created with ccfEnableTracing or the file couldn't be written.
+     */
+    int (VS_CC *writeTrace)(const char *filename, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Adds statistics about a node to stats. latencyP50, latencyP95 and latencyP99 are percentiles of the time in nanoseconds filter calls that
+     * returned a frame took and are only measured with ccfEnableGraphInspection. initialCalls, allFramesReadyCalls and errorCalls count the calls per
+     * activation reason. cacheHits, cacheNearMisses and cacheMisses count cache lookups where a near miss is a recently evicted frame, cacheFrames and
+     * cacheBytes are the current contents of the cache. With ccfCompressEvictedFrames cacheCompressedHits counts the near misses served by
+     * decompressing a frame and cacheCompressedFrames and cacheCompressedBytes are the current contents of the compressed tier. serialLockFailures
+     * counts how often the scheduler had to skip a frame because the filter was busy and serialLockWaitTime is the total time in nanoseconds frames
+     * waited for it because of that. framesProduced counts the frames returned by the filter and processingTime is the total time in nanoseconds spent
+     * in its getframe function, it's only measured with ccfEnableGraphInspection or ccfCostAwareEviction. With ccfEnableGraphInspection
+     * uniqueFramesProduced counts the distinct frame numbers returned, the difference to framesProduced is the number of frames that had to be
+     * recomputed after being evicted from the cache.
+     * memoryLiveBytes is the plane memory allocated by the filter's getframe function that's still referenced, no matter if by the cache of this or
+     * another node or by a frame held outside the graph, and memoryPeakBytes is the most it has been so far. Compare it with cacheBytes when tuning
+     * setCacheOptions(). With ccfEnableGraphInspection dependencyRequests holds the number of frames requested from every dependency in the order
+     * returned by getNodeDependencies().
+     */
+    void (VS_CC *getNodeStatistics)(VSNode *node, VSMap *stats) VS_NOEXCEPT;
+
+    /*
+     * Creates a frame that uses existing memory for its planes instead of copying it. Every plane pointer and stride has to be aligned to the
+     * frame alignment, 64 bytes is always enough. The memory must stay valid until free is called with userData, which happens once when no
+     * frame uses it anymore. Planes are only written to directly when writable is non-zero, otherwise requesting a write pointer copies them.
+     * Returns NULL without calling free when the memory isn't aligned.
+     */
+    VSFrame *(VS_CC *newVideoFrameFromBuffers)(const VSVideoFormat *format, int width, int height, uint8_t * const *planes, const ptrdiff_t *strides, int writable, VSFreeFrameBuffer free, void *userData, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Requests count frames starting at start and then every step frames, step may be negative. Works like calling getFrameAsync() for each of the
+     * frames in order except that the thread pool only has to be locked once for the whole range. The callback is invoked once per frame.
+     */
+    void (VS_CC *getFramesAsync)(int start, int count, int step, VSNode *node, VSFrameDoneCallback callback, void *userData) VS_NOEXCEPT;
+
+    /*
+     * Cancels all outstanding getFrameAsync() and getFramesAsync() requests that were made with this callback and userData. The callback is still
+     * invoked exactly once for every request, canceled ones get the error "Frame request canceled" unless their frame was already available.
+     * Frames that were only needed by canceled requests are dropped before their filters start working on them.
+     * Returns the number of requests that were canceled.
+     */
+    int (VS_CC *cancelFrameRequests)(VSFrameDoneCallback callback, void *userData, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Works like getFrameAsync() but with a priority class (VSRequestPriority). Frames requested with a higher priority and every frame they depend on
+     * are processed before frames requested with a lower priority, within the same class requests are processed in the order they were made.
+     */
+    void (VS_CC *getFrameAsyncPriority)(int n, VSNode *node, int priority, VSFrameDoneCallback callback, void *userData) VS_NOEXCEPT;
+
+    /*
+     * A shared thread pool limits how many worker threads of all the cores attached to it run at the same time, threads <= 0 uses the number of
+     * logical cpus. When more threads want to run than the pool allows each core gets a share proportional to its weight. The thread count of an
+     * attached core is the most threads it may use at once. The pool is freed when it has been passed to freeSharedThreadPool() and all cores
+     * attached to it have been freed. A core can only be attached to one pool, attaching it again to the same pool changes its weight.
+     * Returns zero if the core is already attached to a different pool or weight is less than one.
+     */
+    VSSharedThreadPool *(VS_CC *createSharedThreadPool)(int threads) VS_NOEXCEPT;
+    void (VS_CC *freeSharedThreadPool)(VSSharedThreadPool *pool) VS_NOEXCEPT;
+    int (VS_CC *attachSharedThreadPool)(VSSharedThreadPool *pool, int weight, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Limits how many frames of the node are processed at the same time, frames beyond the limit stay queued until a running one is done.
+     * maxConcurrency is the limit itself and frameScratchSize together with maxScratchSize is a memory budget where at most
+     * maxScratchSize / frameScratchSize frames (but always at least one) are processed at once, the lower of the two limits is used.
+     * 0 means no limit and passing -1 means no change. Can be called by filters after creating their node or at any later point.
+     */
+    void (VS_CC *setNodeConcurrency)(VSNode *node, int maxConcurrency, int64_t frameScratchSize, int64_t maxScratchSize) VS_NOEXCEPT;
+
+    /*
+     * Sets the number of samples in every audio frame except the last one of a clip. Larger frames mean fewer frames, cache entries and requests
+     * for long audio clips. samples must be a multiple of 1024 between 1024 and 1048576 and the size can only be changed before the first audio
+     * filter is created, afterwards it's fixed for the lifetime of the core. Filters that use VS_AUDIO_FRAME_SAMPLES instead of
+     * getAudioFrameSamples() only work with the default size. Returns the frame size in use.
+     */
+    int (VS_CC *setAudioFrameSamples)(int samples, VSCore *core) VS_NOEXCEPT;
+    int (VS_CC *getAudioFrameSamples)(VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Returns an audio frame that shares the samples [start, start + numSamples) of every channel of f. Nothing is copied until a write pointer is
+     * requested. Returns NULL when the range is out of bounds or the channels of the view would not be aligned in memory, the caller then has to copy
+     * the samples itself.
+     */
+    VSFrame *(VS_CC *newAudioFrameView)(const VSFrame *f, int start, int numSamples, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Work exactly like mapGetInt() and mapSetInt() with the name of the VSReservedFrameProperty but every map keeps a direct reference to
+     * the values of these properties so no key lookup is needed. Mixing them with the name based functions is fine.
+     */
+    int64_t (VS_CC *mapGetReservedInt)(const VSMap *map, int property, int index, int *error) VS_NOEXCEPT;
+    int (VS_CC *mapSetReservedInt)(VSMap *map, int property, int64_t i, int append) VS_NOEXCEPT;
+
+    /*
+     * Only use inside a filter's getframe function. Works like getFrameFilter() but returns a frame that may be modified and hands over
+     * the frame context's reference so the same frame can only be retrieved once. When nothing else references the frame it's returned
+     * as is and getWritePtr() writes to the planes in place, otherwise a copy is returned just like copyFrame() would. Frames produced by a
+     * node with an enabled cache are always copied, a node whose output is consumed by a single filter requesting it with rpStrictSpatial or
+     * rpNoFrameReuse normally has no cache, setCacheMode() can be used to disable it in other cases.
+     */
+    VSFrame *(VS_CC *takeFrameFilter)(int n, VSNode *node, VSFrameContext *frameCtx, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Copies the cached frames of the graph ending in src into the matching nodes of the graph ending in dst, meant for reloading an edited
+     * script without throwing away the frames of the parts that didn't change. Two nodes match when they were created by the same function
+     * with identical arguments from matching inputs, so a changed filter and everything after it starts out empty. Both graphs have to
+     * come from cores created with ccfEnableGraphInspection since the creation arguments aren't recorded otherwise. The nodes may belong to
+     * different cores, the moved frames stay accounted to the memory of the core that created them. Returns the number of frames copied.
+     */
+    int (VS_CC *transferCaches)(VSNode *dst, VSNode *src) VS_NOEXCEPT;
+
+    /*
+     * Only use inside a filter's getframe function together with requestFrameFilter(). Offers the area of dst starting at left, top as the
+     * output buffer for frame n of node, when the filter producing it allocates a frame of the same format with newVideoFrame() it gets a view
+     * of dst instead so nothing has to be copied afterwards. Compare the read pointers of the returned frame with the area in dst to find out
+     * if the offer was used. Until the getframe function is called again dst may be written without copying the planes, writes must stay
+     * outside of the offered areas. Returns non-zero if the offer was registered, frames already offered by another filter aren't.
+     */
+    int (VS_CC *offerFrameDestination)(int n, VSNode *node, VSFrame *dst, int left, int top, VSFrameContext *frameCtx, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Sets size bytes at data as a data property without copying them. Copies of the map, such as the properties of frames made with
+     * copyFrameProps() or newVideoFrame() with a property source, share the memory. It must stay valid and unchanged until free is called
+     * with userData, which happens once no map references it anymore, or right away if the property can't be set. Unlike with mapSetData()
+     * the data isn't null terminated. Returns 0 on success.
+     */
+    int (VS_CC *mapSetDataExternal)(VSMap *map, const char *key, const char *data, int size, int type, VSFreeDataBuffer free, void *userData, int append) VS_NOEXCEPT;
+
+    /*
+     * Adds an uninitialized data property of size bytes and returns a pointer to it so it can be built in place. The data is null
+     * terminated. The pointer may only be written to until the map is copied or passed on. Returns NULL if the property can't be set.
+     */
+    char *(VS_CC *mapAllocData)(VSMap *map, const char *key, int size, int type, int append) VS_NOEXCEPT;
+
+    /*
+     * Sets the frame memory use above which the scheduler only starts new frame requests when nothing else is running, so only the frames
+     * needed to finish a single request at a time can take it further. Above the cache size set with setMaxCacheSize() new output frame
+     * requests already wait while the ones in progress are completed. Pass 0 to remove the limit or a negative number to only query it.
+     * Returns the current limit.
+     */
+    int64_t (VS_CC *setMemoryHardLimit)(int64_t bytes, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Lets the filter look at the frames it requested as they arrive instead of only once all of them are there. While requests are still
+     * outstanding getFrame is called with arFrameReady after one or more of them have completed, the new frames can be retrieved with
+     * getFrameFilter() which returns NULL for the ones that haven't arrived yet. frameData is kept between the calls and the filter may not
+     * request frames or return a frame in arFrameReady, setting an error is allowed and turns the final call into arError.
+     * Frames released early with takeFrameFilter() no longer count against the memory use. The arAllFramesReady call follows
+     * as usual once everything has arrived. Calls for the same frame never overlap and fmParallelRequests filters are called
+     * with the same serialization as for arAllFramesReady. Only for use right after creating the node.
+     */
+    void (VS_CC *setNodeFrameReadyActivation)(VSNode *node, int enable) VS_NOEXCEPT;
+
+    /*
+     * Lets a filter wait for work done outside of the thread pool, such as file or network reads, without keeping a worker thread busy.
+     * Only for use in arInitial. The returned request counts like a requested frame and getFrame is called with arAllFramesReady once
+     * completeAsyncRequest() has been called for every request and all requested frames have arrived. Returning a frame while requests
+     * are outstanding is not allowed and a filter that sets an error is called with arError once they're done, so buffers used by the
+     * outstanding work stay valid until then.
+     */
+    VSAsyncRequest *(VS_CC *beginAsyncRequest)(VSFrameContext *frameCtx) VS_NOEXCEPT;
+
+    /*
+     * Completes a request from beginAsyncRequest(), may be called from any thread and even before the filter has returned. Pass NULL
+     * as errorMessage on success, otherwise the frame fails with the message. The request is freed by this function.
+     */
+    void (VS_CC *completeAsyncRequest)(VSAsyncRequest *request, const char *errorMessage) VS_NOEXCEPT;
+
+    /*
+     * Reads size bytes starting at offset from the file into the data property "data" of result on a dedicated i/o thread, a negative
+     * size reads to the end of the file. Works like beginAsyncRequest() and completeAsyncRequest(), so it's only for use in arInitial.
+     * result must not be touched until getFrame is called again. A failed read fails the frame and getFrame is called with arError.
+     * filename is utf-8 encoded.
+     */
+    void (VS_CC *readFileAsync)(const char *filename, int64_t offset, int64_t size, VSMap *result, VSFrameContext *frameCtx) VS_NOEXCEPT;
+
+    /*
+     * Returns size bytes of memory aligned to 64 bytes that stays valid until the getFrame function, or the slice function passed to
+     * processSlices(), that called it returns. It must not be freed. The memory comes from an arena kept per thread that's reused by later
+     * calls so filters that need temporary buffers don't have to allocate them for every frame. It's counted as used memory and reported
+     * as scratchMemory by getCoreStatistics(). Returns NULL when called from anywhere else or if the memory couldn't be allocated.
+     */
+    void *(VS_CC *allocScratchMemory)(size_t size, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Starts a background thread that checks the thread pool a few times per threshold milliseconds and logs a warning when a frame has
+     * been in progress for longer than threshold, saying whether it's running in the filter, queued, waiting for the serial lock of the
+     * filter or waiting for the frames it requested, and when all worker threads have been idle for that long while requests are queued.
+     * Every frame is only reported once. Pass 0 to stop the watchdog. The number of reports is counted as watchdogReports by getCoreStatistics().
+     */
+    void (VS_CC *setWatchdog)(int64_t threshold, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Creates a frame whose planes live in memory owned by a gpu api so chained gpu filters can pass them on without transfers. For mdPinnedHost
+     * every handle is a host pointer with the same alignment requirements as for newVideoFrameFromBuffers(). For mdDevice it's an opaque handle
+     * and the plane is only downloaded into regular memory once a filter asks for a read or write pointer, the handle stays valid until the frame
+     * is written to. strides are the pitch of the planes which has to be a multiple of the frame alignment, a plane takes stride * height bytes.
+     * functions->free is called with the handle and userData for every plane once it's no longer used, also when NULL is returned because of
+     * invalid arguments.
+     */
+    VSFrame *(VS_CC *newVideoFrameFromDevice)(const VSVideoFormat *format, int width, int height, void * const *handles, const ptrdiff_t *strides, int domain, const VSDeviceMemoryFunctions *functions, void *userData, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT;
+    int (VS_CC *getFrameMemoryDomain)(const VSFrame *f, int plane) VS_NOEXCEPT; /* returns VSMemoryDomain */
+    void *(VS_CC *getFrameDeviceHandle)(const VSFrame *f, int plane, int deviceType) VS_NOEXCEPT; /* returns the handle of an mdDevice plane created with the same deviceType, NULL for everything else including views */
+
+    /*
+     * Gives an fmUnordered or fmFrameState node a thread of its own that processes all of its frames, the worker threads skip them instead of
+     * competing for the filter's lock. Whenever the thread has nothing else to do it works ahead on the frames following the last one requested
+     * and keeps up to queueSize of them ready, so a source that's read in order is never left waiting for a worker. Pass 0 to stop the thread.
+     * Calls for nodes in other filter modes are ignored. Must not be called from the getframe function of the node itself.
+     */
+    void (VS_CC *setNodeDedicatedThread)(VSNode *node, int queueSize) VS_NOEXCEPT;
+
+    /*
+     * Graph inspection additions with the same restrictions as the other graph information functions. getNodeCreationFunctionPlugin()
+     * returns the plugin of the function at the given level. getNodeCreationFunctionOutput() returns the key and stores the index under
+     * which the level 0 function returned the node, invoking it again with the same arguments gives back an equivalent node at the same
+     * place. Returns NULL if the function didn't return the node itself.
+     */
+    VSPlugin *(VS_CC *getNodeCreationFunctionPlugin)(VSNode *node, int level) VS_NOEXCEPT;
+    const char *(VS_CC *getNodeCreationFunctionOutput)(VSNode *node, int *index) VS_NOEXCEPT;
+
+    /*
+     * Plane demand. The core tracks which planes of every video node any consumer may read, getFrameDemandedPlanes() returns them as a
+     * bitmask (bit n for plane n) inside a getframe function and the filter may leave the other planes of its output frame unprocessed,
+     * preferably by copying them from a source frame. Requests from outside of filters and from filters that don't list the node as a
+     * dependency demand all planes.
+     *
+     * setFilterPlaneDependency() declares which planes of the source at index in the dependencies passed when creating node each of its
+     * 3 output planes reads, planes[n] is the bitmask of source planes for output plane n. Without it every output plane reads all planes
+     * of the source. It may only be called by the function creating node before it's returned. Returns 0 if index is out of range.
+     *
+     * When a consumer added later demands more planes than before the caches of the affected nodes are cleared, frames that are already
+     * being processed at that point may still have been made for the old demand.
+     */
+    int (VS_CC *setFilterPlaneDependency)(VSNode *node, int index, const int *planes) VS_NOEXCEPT;
+    int (VS_CC *getFrameDemandedPlanes)(VSFrameContext *frameCtx) VS_NOEXCEPT;
+
+    /*
+     * Constant planes. setFramePlaneConstant() marks a video plane the caller has already filled with a single value, value holds the
+     * raw bits of a sample (the integer itself or the bits of a half or single precision float). The mark travels with the plane to every
+     * frame sharing it and is removed as soon as getWritePtr() is called for it. getFramePlaneConstant() returns non-zero and stores the
+     * value if the plane is marked, filters can then compute their result once instead of for every sample. The plane content is always
+     * valid so filters that don't check can read it as usual. Audio frames are never marked.
+     */
+    void (VS_CC *setFramePlaneConstant)(VSFrame *f, int plane, uint32_t value) VS_NOEXCEPT;
+    int (VS_CC *getFramePlaneConstant)(const VSFrame *f, int plane, uint32_t *value) VS_NOEXCEPT;
+
+    /*
+     * Request recording. recordFrameRequests() starts writing every frame request made from outside of filters with getFrame(),
+     * getFrameAsync(), getFramesAsync() and getFrameAsyncPriority() to filename, together with its priority and the time since the
+     * previous request, so vspipe --replay-requests can issue the same pattern against a script again. Starting a new recording ends
+     * the previous one and passing NULL ends it, returns zero if the file couldn't be opened or written. Canceled requests are recorded
+     * like any other.
+     *
+     * Nodes are identified by the script output they were set as with setNodeOutputIndex(), alpha is non-zero for the alpha clip of the
+     * output. The Python set_output() does this for all outputs, requests for nodes that were never set as an output are recorded as
+     * output -1.
+     */
+    int (VS_CC *recordFrameRequests)(const char *filename, VSCore *core) VS_NOEXCEPT;
+    void (VS_CC *setNodeOutputIndex)(VSNode *node, int index, int alpha) VS_NOEXCEPT;
+
+    /*
+     * Works like getFrameAsyncPriority() but the request fails with an error if the frame isn't done within timeout microseconds, 0 or less means
+     * no deadline. The deadline is passed on to every frame the request depends on. Within a priority class frames with an earlier deadline are
+     * processed first, frames without one come last. Once the deadline has passed filters that haven't started on a frame aren't called for it
+     * anymore and filters that are waiting for their source frames are called with arError, but a filter that's already running isn't interrupted.
+     * Frames that are also needed by a request with a later deadline or without one are processed as usual. Useful for previews that would
+     * rather show an older frame than wait.
+     */
+    void (VS_CC *getFrameAsyncDeadline)(int n, VSNode *node, int priority, int64_t timeout, VSFrameDoneCallback callback, void *userData) VS_NOEXCEPT;
+
+    /*
+     * Cache size hints. saveCacheSizes() writes the size every cache has grown or shrunk to, keyed by a signature made from the filter
+     * name, output properties, inputs and creation order of its node, so the signatures stay the same as long as the script does.
+     * loadCacheSizes() reads such a file back, caches with a stored size start at it as soon as they're enabled instead of adjusting
+     * from the default size over the first frames, this includes caches of nodes that already exist. Caches with a fixed size aren't
+     * saved or changed. Stored sizes of nodes that didn't exist in the run are saved again. Both return zero on failure.
+     */
+    int (VS_CC *saveCacheSizes)(const char *filename, VSCore *core) VS_NOEXCEPT;
+    int (VS_CC *loadCacheSizes)(const char *filename, VSCore *core) VS_NOEXCEPT;
+
+    /*
+     * Marks a node as lightweight, meant for filters that only pass on or reference their input frames and are cheaper to call than to queue.
+     * A lightweight node never has a cache and setCacheMode() is ignored for it, its frames are processed right away by the thread that
+     * requested them or completed the frames they were waiting for. Only fmParallel nodes can be marked, calls for other filter modes are
+     * ignored. Typically called right after creating the filter.
+     */
+    void (VS_CC *setNodeLightweight)(VSNode *node, int enable) VS_NOEXCEPT;
+
+    /*
+     * Writes all frames of a video node with a constant format to file, a file descriptor or a HANDLE on windows, the same way vspipe does.
+     * Every frame is written as its planes in order with the rows packed. Up to prefetch frames are requested ahead, 0 or less uses the
+     * number of threads. The writes happen on the calling thread, progress is called there after every written frame and stops the output
+     * when it returns zero, it may be NULL. flags is a combination of VSVideoOutputFlags. Returns zero on failure with the reason in errorMsg.
+     * Only for external applications, don't use it in a filter.
+     */
+    int (VS_CC *outputVideoNode)(VSNode *node, intptr_t file, int flags, int prefetch, VSOutputProgressCallback progress, void *userData, char *errorMsg, int bufSize) VS_NOEXCEPT;
 };
 
 VS_API(const VSAPI *) getVapourSynthAPI(int version) VS_NOEXCEPT;
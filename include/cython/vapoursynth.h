@@ -23,6 +23,8 @@ __PYX_EXTERN_C int vpy_evaluateScript(VSScript *, char const *, char const *, in
 __PYX_EXTERN_C int vpy_evaluateFile(VSScript *, char const *, int);
 __PYX_EXTERN_C int vpy4_evaluateBuffer(VSScript *, char const *, char const *, VSMap const *, VSScriptOptions const *);
 __PYX_EXTERN_C int vpy4_evaluateFile(VSScript *, char const *, VSMap const *, VSScriptOptions const *);
+__PYX_EXTERN_C int vpy4_compileBuffer(VSScript *, char const *, char const *);
+__PYX_EXTERN_C int vpy4_evaluateCompiled(VSScript *, VSScript *, VSMap const *, VSScriptOptions const *);
 __PYX_EXTERN_C int vpy4_clearLogHandler(VSScript *);
 __PYX_EXTERN_C void vpy4_freeScript(VSScript *);
 __PYX_EXTERN_C char const *vpy4_getError(VSScript *);
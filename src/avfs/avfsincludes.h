@@ -14,6 +14,8 @@
 #include <new>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <string>
 #include <fstream>
 #include <vector>
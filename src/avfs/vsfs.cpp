@@ -61,9 +61,29 @@ class VapourSynther final :
 
     std::vector<uint8_t> packedFrame;
 
-    // Frame read ahead.
+    // Frame read ahead. Sequential reads request the next frames asynchronously
+    // and they're packed on the worker thread that delivers them, so reads can be
+    // served by swapping the ready buffer with packedFrame.
+    struct PrefetchedFrame {
+        int n = -1; // -1 when the slot is free
+        bool done = false;
+        const VSFrame *frame = nullptr; // nullptr when done and the request failed
+        std::vector<uint8_t> packed;
+    };
+
     int prefetchFrames = 0;
     std::atomic<int> pendingRequests;
+    std::mutex prefetchLock;
+    std::condition_variable prefetchDone;
+    std::vector<PrefetchedFrame> prefetchRing;
+
+    // Audio read ahead works the same way with the frames packed into interleaved
+    // PCM when they arrive. The ring is sized in seconds and the frame that was read
+    // last stays in packedAudio since reads rarely end on a frame boundary.
+    int prefetchAudioFrames = 0;
+    std::vector<PrefetchedFrame> prefetchAudioRing;
+    int packedAudioPosition = -1;
+    std::vector<uint8_t> packedAudio;
 
     // Cache last accessed frame, to reduce interference with read-ahead.
     int lastPosition = -1;
@@ -86,6 +106,23 @@ class VapourSynther final :
     // Print the VideoInfo contents to the log file.
     void reportFormat(AvfsLog_* log);
 
+    // Pack a frame into the layout of the virtual file if it needs it
+    void PackFrame(const VSFrame *f, uint8_t *dst);
+
+    // Pack all samples of an audio frame into interleaved little endian PCM
+    void PackAudioFrame(const VSFrame *f, uint8_t *dst);
+
+    // Request frames after n of a node that aren't already in its prefetch ring
+    void Prefetch(std::vector<PrefetchedFrame> &ring, VSNode *node, int numFrames, int count, int n);
+
+    // Take frame n from the prefetch ring, waits if it was requested but isn't done yet
+    const VSFrame *TakePrefetched(int n);
+
+    // Make packedAudio hold audio frame n, from the prefetch ring if possible
+    bool LoadPackedAudio(int n);
+
+    void freePrefetched();
+
     static void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *, const char *errorMsg);
 public:
 
@@ -118,12 +155,147 @@ public:
 /*---------------------------------------------------------
 ---------------------------------------------------------*/
 
-void VS_CC VapourSynther::frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *, const char *errorMsg) {
+void VS_CC VapourSynther::frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg) {
     VapourSynther *vsynther = static_cast<VapourSynther *>(userData);
-    vsynther->vsapi->freeFrame(f);
+    bool isAudio = (node == vsynther->audioNode);
+
+    PrefetchedFrame *slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(vsynther->prefetchLock);
+        for (auto &iter : isAudio ? vsynther->prefetchAudioRing : vsynther->prefetchRing) {
+            if (iter.n == n && !iter.done) {
+                slot = &iter;
+                break;
+            }
+        }
+    }
+
+    // the slot belongs to this request until it's marked as done
+    if (slot && f && isAudio) {
+        slot->packed.resize(vsynther->vsapi->getFrameLength(f) * static_cast<size_t>((vsynther->ai->format.bitsPerSample + 7) / 8) * vsynther->ai->format.numChannels);
+        vsynther->PackAudioFrame(f, slot->packed.data());
+    } else if (slot && f && NeedsPacking(vsynther->vi->format)) {
+        vsynther->PackFrame(f, slot->packed.data());
+    }
+
+    if (slot) {
+        std::lock_guard<std::mutex> lock(vsynther->prefetchLock);
+        slot->frame = f;
+        slot->done = true;
+        vsynther->prefetchDone.notify_all();
+    } else {
+        vsynther->vsapi->freeFrame(f);
+    }
+
     --vsynther->pendingRequests;
 }
 
+void VapourSynther::Prefetch(std::vector<PrefetchedFrame> &ring, VSNode *node, int numFrames, int count, int n) {
+    std::lock_guard<std::mutex> lock(prefetchLock);
+
+    int end = std::min(n + 1 + count, numFrames);
+
+    for (int i = n + 1; i < end; i++) {
+        PrefetchedFrame *slot = nullptr;
+        bool requested = false;
+
+        // finished frames outside of the window can be reused, pending ones have to complete first
+        for (auto &iter : ring) {
+            if (iter.n == i) {
+                requested = true;
+                break;
+            } else if (!slot && (iter.n < 0 || (iter.done && (iter.n <= n || iter.n >= end)))) {
+                slot = &iter;
+            }
+        }
+
+        if (requested)
+            continue;
+        if (!slot)
+            break;
+
+        vsapi->freeFrame(slot->frame);
+        slot->frame = nullptr;
+        slot->done = false;
+        slot->n = i;
+        if (node == videoNode && NeedsPacking(vi->format))
+            slot->packed.resize(BMPSize());
+
+        ++pendingRequests;
+        vsapi->getFrameAsync(i, node, VapourSynther::frameDoneCallback, static_cast<void *>(this));
+    }
+}
+
+const VSFrame *VapourSynther::TakePrefetched(int n) {
+    std::unique_lock<std::mutex> lock(prefetchLock);
+
+    for (auto &iter : prefetchRing) {
+        if (iter.n == n) {
+            prefetchDone.wait(lock, [&iter] { return iter.done; });
+
+            const VSFrame *f = iter.frame;
+            if (f && NeedsPacking(vi->format))
+                packedFrame.swap(iter.packed);
+            iter.frame = nullptr;
+            iter.done = false;
+            iter.n = -1;
+            return f;
+        }
+    }
+
+    return nullptr;
+}
+
+bool VapourSynther::LoadPackedAudio(int n) {
+    if (n == packedAudioPosition)
+        return true;
+    packedAudioPosition = -1;
+
+    {
+        std::unique_lock<std::mutex> lock(prefetchLock);
+
+        for (auto &iter : prefetchAudioRing) {
+            if (iter.n == n) {
+                prefetchDone.wait(lock, [&iter] { return iter.done; });
+
+                bool success = !!iter.frame;
+                if (success) {
+                    packedAudio.swap(iter.packed);
+                    packedAudioPosition = n;
+                }
+                vsapi->freeFrame(iter.frame);
+                iter.frame = nullptr;
+                iter.done = false;
+                iter.n = -1;
+                if (success)
+                    return true;
+                break;
+            }
+        }
+    }
+
+    const VSFrame *f = vsapi->getFrame(n, audioNode, nullptr, 0);
+    if (!f)
+        return false;
+    packedAudio.resize(vsapi->getFrameLength(f) * static_cast<size_t>((ai->format.bitsPerSample + 7) / 8) * ai->format.numChannels);
+    PackAudioFrame(f, packedAudio.data());
+    packedAudioPosition = n;
+    vsapi->freeFrame(f);
+    return true;
+}
+
+void VapourSynther::freePrefetched() {
+    while (pendingRequests > 0) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+
+    for (auto &iter : prefetchRing)
+        vsapi->freeFrame(iter.frame);
+    prefetchRing.clear();
+    for (auto &iter : prefetchAudioRing)
+        vsapi->freeFrame(iter.frame);
+    prefetchAudioRing.clear();
+    packedAudioPosition = -1;
+}
+
 /*---------------------------------------------------------
 ---------------------------------------------------------*/
 
@@ -254,56 +426,152 @@ void VapourSynther::reportFormat(AvfsLog_* log) {
 /*---------------------------------------------------------
 ---------------------------------------------------------*/
 
-bool VapourSynther::GetAudio(AvfsLog_ *log, void *buf, __int64 start, unsigned count) {
+void VapourSynther::PackAudioFrame(const VSFrame *f, uint8_t *dst) {
     const VSAudioFormat &af = ai->format;
+    int length = vsapi->getFrameLength(f);
 
-    uint8_t *dst = reinterpret_cast<uint8_t *>(buf);
-
-    int startFrame = static_cast<int>(start / VS_AUDIO_FRAME_SAMPLES);
-    int endFrame = static_cast<int>((start + count - 1) / VS_AUDIO_FRAME_SAMPLES);
-    
     std::vector<const uint8_t *> tmp;
     tmp.resize(af.numChannels);
+    for (int c = 0; c < af.numChannels; c++)
+        tmp[c] = vsapi->getReadPtr(f, c);
 
     size_t bytesPerOutputSample = (af.bitsPerSample + 7) / 8;
 
+    if (bytesPerOutputSample == 2)
+        PackChannels16to16le(tmp.data(), dst, length, af.numChannels);
+    else if (bytesPerOutputSample == 3)
+        PackChannels32to24le(tmp.data(), dst, length, af.numChannels);
+    else if (bytesPerOutputSample == 4)
+        PackChannels32to32le(tmp.data(), dst, length, af.numChannels);
+}
+
+bool VapourSynther::GetAudio(AvfsLog_ *log, void *buf, __int64 start, unsigned count) {
+    const VSAudioFormat &af = ai->format;
+
+    uint8_t *dst = reinterpret_cast<uint8_t *>(buf);
+
+    int frameSamples = vsapi->getAudioFrameSamples(vssapi->getCore(se));
+    int startFrame = static_cast<int>(start / frameSamples);
+    int endFrame = static_cast<int>((start + count - 1) / frameSamples);
+
+    // only read ahead when continuing from where the last read ended
+    bool doPrefetch = (packedAudioPosition >= 0 && (startFrame == packedAudioPosition || startFrame == packedAudioPosition + 1));
+
+    size_t bytesPerPackedSample = ((af.bitsPerSample + 7) / 8) * static_cast<size_t>(af.numChannels);
+
     for (int i = startFrame; i <= endFrame; i++) {
-        const VSFrame *f = vsapi->getFrame(i, audioNode, nullptr, 0);
-        int64_t firstFrameSample = i * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
+        if (!LoadPackedAudio(i)) {
+            log->Printf(L"GetAudio: failed to get audio frame %d\n", i);
+            return false;
+        }
+
+        int64_t firstFrameSample = i * static_cast<int64_t>(frameSamples);
         size_t offset = 0;
-        int copyLength = VS_AUDIO_FRAME_SAMPLES;
+        int copyLength = frameSamples;
         if (firstFrameSample < start) {
-            offset = (start - firstFrameSample) * af.bytesPerSample;
-            copyLength -= (start - firstFrameSample);
+            offset = static_cast<size_t>(start - firstFrameSample);
+            copyLength -= static_cast<int>(start - firstFrameSample);
         }
 
         if (copyLength > count)
             copyLength = count;
 
-        for (int c = 0; c < af.numChannels; c++)
-            tmp[c] = vsapi->getReadPtr(f, c) + offset;
-
         assert(copyLength > 0);
 
-        if (bytesPerOutputSample == 2)
-            PackChannels16to16le(tmp.data(), dst, copyLength, af.numChannels);
-        else if (bytesPerOutputSample == 3)
-            PackChannels32to24le(tmp.data(), dst, copyLength, af.numChannels);
-        else if (bytesPerOutputSample == 4)
-            PackChannels32to32le(tmp.data(), dst, copyLength, af.numChannels);
+        memcpy(dst, packedAudio.data() + offset * bytesPerPackedSample, copyLength * bytesPerPackedSample);
 
-        dst += copyLength * bytesPerOutputSample * af.numChannels;
+        dst += copyLength * bytesPerPackedSample;
         count -= copyLength;
-
-        vsapi->freeFrame(f);
     }
 
     assert(count == 0);
 
-    // FIXME, maybe do error handling
+    if (doPrefetch)
+        Prefetch(prefetchAudioRing, audioNode, ai->numFrames, prefetchAudioFrames, endFrame);
+
     return true;
 }
 
+void VapourSynther::PackFrame(const VSFrame *f, uint8_t *dst) {
+    if (!NeedsPacking(vi->format))
+        return;
+
+    const VSVideoFormat &fi = *vsapi->getVideoFrameFormat(f);
+
+    p2p_buffer_param p = {};
+    p.width = vsapi->getFrameWidth(f, 0);
+    p.height = vsapi->getFrameHeight(f, 0);
+    p.dst[0] = dst;
+    // Used by most
+    p.dst_stride[0] = p.width * 4 * fi.bytesPerSample;
+
+    for (int plane = 0; plane < fi.numPlanes; plane++) {
+        p.src[plane] = vsapi->getReadPtr(f, plane);
+        p.src_stride[plane] = vsapi->getStride(f, plane);
+    }
+
+    if (IsSameVideoFormat(fi, cfRGB, stInteger, 8)) {
+        p.packing = p2p_argb32_le;
+        for (int plane = 0; plane < 3; plane++) {
+            p.src[plane] = vsapi->getReadPtr(f, plane) + vsapi->getStride(f, plane) * (vsapi->getFrameHeight(f, plane) - 1);
+            p.src_stride[plane] = -vsapi->getStride(f, plane);
+        }
+        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
+    } else if (IsSameVideoFormat(fi, cfRGB, stInteger, 10)) {
+        p.packing = p2p_rgb30_be;
+        p.dst_stride[0] = ((p.width + 63) / 64) * 256;
+        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
+    } else if (IsSameVideoFormat(fi, cfRGB, stInteger, 16)) {
+        p.packing = p2p_argb64_be;
+        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
+    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 0, 0)) {
+        p.packing = p2p_y410_le;
+        p.dst_stride[0] = p.width * 2 * fi.bytesPerSample;
+        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
+    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 0, 0)) {
+        p.packing = p2p_y416_le;
+        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
+    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0) && enable_v210) {
+        p.packing = p2p_v210_le;
+        p.dst_stride[0] = ((16 * ((p.width + 5) / 6) + 127) & ~127);
+        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
+    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 1) || IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 0) || IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 1) || IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0)) {
+        if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 1))
+            p.packing = p2p_p016_le;
+        else if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 0))
+            p.packing = p2p_p216_le;
+        else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 1))
+            p.packing = p2p_p010_le;
+        else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0))
+            p.packing = p2p_p210_le;
+        p.dst_stride[0] = p.width * fi.bytesPerSample;
+        p.dst_stride[1] = p.width * fi.bytesPerSample;
+        p.dst[1] = dst + p.dst_stride[0] * p.height;
+        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
+    } else {
+        const ptrdiff_t stride = vsapi->getStride(f, 0);
+        const int height = vsapi->getFrameHeight(f, 0);
+        int row_size = vsapi->getFrameWidth(f, 0) * fi.bytesPerSample;
+        if (fi.numPlanes == 1) {
+            bitblt(dst, (row_size + 3) & ~3, vsapi->getReadPtr(f, 0), stride, row_size, height);
+        } else if (fi.numPlanes == 3) {
+            int row_size23 = vsapi->getFrameWidth(f, 1) * fi.bytesPerSample;
+
+            bitblt(dst, row_size, vsapi->getReadPtr(f, 0), stride, row_size, height);
+
+            bitblt(dst + (row_size*height),
+                row_size23, vsapi->getReadPtr(f, 2),
+                vsapi->getStride(f, 2), vsapi->getFrameWidth(f, 2),
+                vsapi->getFrameHeight(f, 2));
+
+            bitblt(dst + (row_size*height + vsapi->getFrameHeight(f, 1)*row_size23),
+                row_size23, vsapi->getReadPtr(f, 1),
+                vsapi->getStride(f, 1), vsapi->getFrameWidth(f, 1),
+                vsapi->getFrameHeight(f, 1));
+        }
+    }
+}
+
 // Exception protected PVideoFrame->GetFrame()
 const VSFrame *VapourSynther::GetFrame(AvfsLog_* log, int n, bool *_success) {
 
@@ -322,89 +590,16 @@ const VSFrame *VapourSynther::GetFrame(AvfsLog_* log, int n, bool *_success) {
         lastFrame = nullptr;
 
         if (videoNode) {
-            char errMsg[512];
-            f = vsapi->getFrame(n, videoNode, errMsg, sizeof(errMsg));
+            f = TakePrefetched(n);
             success = !!f;
-            if (success) {
-                if (NeedsPacking(vi->format)) {
-                    const VSVideoFormat &fi = *vsapi->getVideoFrameFormat(f);
-
-                    p2p_buffer_param p = {};
-                    p.width = vsapi->getFrameWidth(f, 0);
-                    p.height = vsapi->getFrameHeight(f, 0);
-                    p.dst[0] = packedFrame.data();
-                    // Used by most
-                    p.dst_stride[0] = p.width * 4 * fi.bytesPerSample;
-
-                    for (int plane = 0; plane < fi.numPlanes; plane++) {
-                        p.src[plane] = vsapi->getReadPtr(f, plane);
-                        p.src_stride[plane] = vsapi->getStride(f, plane);
-                    }
-
-                    if (IsSameVideoFormat(fi, cfRGB, stInteger, 8)) {
-                        p.packing = p2p_argb32_le;
-                        for (int plane = 0; plane < 3; plane++) {
-                            p.src[plane] = vsapi->getReadPtr(f, plane) + vsapi->getStride(f, plane) * (vsapi->getFrameHeight(f, plane) - 1);
-                            p.src_stride[plane] = -vsapi->getStride(f, plane);
-                        }
-                        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-                    } else if (IsSameVideoFormat(fi, cfRGB, stInteger, 10)) {
-                        p.packing = p2p_rgb30_be;
-                        p.dst_stride[0] = ((p.width + 63) / 64) * 256;
-                        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-                    } else if (IsSameVideoFormat(fi, cfRGB, stInteger, 16)) {
-                        p.packing = p2p_argb64_be;
-                        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-                    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 0, 0)) {
-                        p.packing = p2p_y410_le;
-                        p.dst_stride[0] = p.width * 2 * fi.bytesPerSample;
-                        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-                    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 0, 0)) {
-                        p.packing = p2p_y416_le;
-                        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-                    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0) && enable_v210) {
-                        p.packing = p2p_v210_le;
-                        p.dst_stride[0] = ((16 * ((p.width + 5) / 6) + 127) & ~127);
-                        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-                    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 1) || IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 0) || IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 1) || IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0)) {
-                        if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 1))
-                            p.packing = p2p_p016_le;
-                        else if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 1, 0))
-                            p.packing = p2p_p216_le;
-                        else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 1))
-                            p.packing = p2p_p010_le;
-                        else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0))
-                            p.packing = p2p_p210_le;
-                        p.dst_stride[0] = p.width * fi.bytesPerSample;
-                        p.dst_stride[1] = p.width * fi.bytesPerSample;
-                        p.dst[1] = (uint8_t *)packedFrame.data() + p.dst_stride[0] * p.height;
-                        p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-                    } else {
-                        const ptrdiff_t stride = vsapi->getStride(f, 0);
-                        const int height = vsapi->getFrameHeight(f, 0);
-                        int row_size = vsapi->getFrameWidth(f, 0) * fi.bytesPerSample;
-                        if (fi.numPlanes == 1) {
-                            bitblt(packedFrame.data(), (row_size + 3) & ~3, vsapi->getReadPtr(f, 0), stride, row_size, height);
-                        } else if (fi.numPlanes == 3) {
-                            int row_size23 = vsapi->getFrameWidth(f, 1) * fi.bytesPerSample;
-
-                            bitblt(packedFrame.data(), row_size, vsapi->getReadPtr(f, 0), stride, row_size, height);
-
-                            bitblt((uint8_t *)packedFrame.data() + (row_size*height),
-                                row_size23, vsapi->getReadPtr(f, 2),
-                                vsapi->getStride(f, 2), vsapi->getFrameWidth(f, 2),
-                                vsapi->getFrameHeight(f, 2));
-
-                            bitblt((uint8_t *)packedFrame.data() + (row_size*height + vsapi->getFrameHeight(f, 1)*row_size23),
-                                row_size23, vsapi->getReadPtr(f, 1),
-                                vsapi->getStride(f, 1), vsapi->getFrameWidth(f, 1),
-                                vsapi->getFrameHeight(f, 1));
-                        }
-                    }
-
-                }
-            } else {
-                setError(errMsg);
+            if (!success) {
+                char errMsg[512];
+                f = vsapi->getFrame(n, videoNode, errMsg, sizeof(errMsg));
+                success = !!f;
+                if (success)
+                    PackFrame(f, packedFrame.data());
+                else
+                    setError(errMsg);
             }
         }
         if (!success) {
@@ -417,12 +612,8 @@ const VSFrame *VapourSynther::GetFrame(AvfsLog_* log, int n, bool *_success) {
 
     if (_success) *_success = success;
 
-    if (success && doPrefetch) {
-        for (int i = n + 1; i < std::min(n + prefetchFrames, vi->numFrames); i++) {
-            ++pendingRequests;
-            vsapi->getFrameAsync(i, videoNode, VapourSynther::frameDoneCallback, static_cast<void *>(this));
-        }
-    }
+    if (success && doPrefetch)
+        Prefetch(prefetchRing, videoNode, vi->numFrames, prefetchFrames, n);
 
     return f;
 }
@@ -506,10 +697,12 @@ const wchar_t* VapourSynther::getError() {
 
 void VapourSynther::free() {
     if (ai) {
+        freePrefetched();
         vsapi->freeNode(audioNode);
         audioNode = nullptr;
     }
     if (vi) {
+        freePrefetched();
         vsapi->freeFrame(lastFrame);
         lastFrame = nullptr;
         vsapi->freeNode(videoNode);
@@ -571,6 +764,15 @@ int/*error*/ VapourSynther::Init(
         prefetchFrames = GetVarAsInt("AVFS_ReadAheadFrameCount", -1);
         if (prefetchFrames < 0)
             prefetchFrames = info.numThreads;
+        prefetchRing.resize(prefetchFrames);
+
+        // audio is read ahead by time since the frame length doesn't depend on the script
+        if (ai) {
+            int seconds = GetVarAsInt("AVFS_ReadAheadAudioSeconds", 2);
+            int frameSamples = vsapi->getAudioFrameSamples(vssapi->getCore(se));
+            prefetchAudioFrames = static_cast<int>(std::max<int64_t>(seconds, 0) * ai->sampleRate / frameSamples + (seconds > 0));
+            prefetchAudioRing.resize(prefetchAudioFrames);
+        }
     }
 
     return error;
@@ -24,6 +24,7 @@
 #include "../core/version.h"
 #include "avisynth_compat.h"
 #include <algorithm>
+#include <cctype>
 #include <cstdarg>
 #include <limits>
 #include "../common/vsutf16.h"
@@ -241,7 +242,7 @@ static VSNode *VS_CC unpackYUY2Create(VSNode *node, VSCore *core, const VSAPI *v
     vsapi->getVideoFormatByID(&d->vi.format, pfYUV422P8, core);
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    VSNode *ret = vsapi->createVideoFilter2("UnpackRGB32", &d->vi, unpackYUY2GetFrame, filterFree<UnpackYUY2Data>, fmParallel, deps, 1, d.get(), core);
+    VSNode *ret = vsapi->createVideoFilter2("UnpackYUY2", &d->vi, unpackYUY2GetFrame, filterFree<UnpackYUY2Data>, fmParallel, deps, 1, d.get(), core);
     d.release();
     return ret;
 }
@@ -358,12 +359,16 @@ static VSNode *VS_CC unpackRGB32Create(VSNode *node, VSCore *core, const VSAPI *
 
 //////////////////////////////////////////
 
+thread_local int FakeAvisynth::uglyN = -1;
+thread_local VSFrameContext *FakeAvisynth::uglyCtx = nullptr;
+
 const VSFrame *FakeAvisynth::avsToVSFrame(VideoFrame *frame) {
+    std::lock_guard<std::mutex> lock(ownedFramesLock);
     const VSFrame *ref = nullptr;
     std::map<VideoFrame *, const VSFrame *>::iterator it = ownedFrames.find(frame);
 
     if (it != ownedFrames.end()) {
-        ref = vsapi->addFrameRef(it->second);
+        ref = viewFrames.count(frame) ? copyView(frame, it->second) : vsapi->addFrameRef(it->second);
     } else {
         vsapi->logMessage(mtFatal, "unreachable condition", core);
         assert(false);
@@ -373,6 +378,7 @@ const VSFrame *FakeAvisynth::avsToVSFrame(VideoFrame *frame) {
 
     while (it != ownedFrames.end()) {
         if (it->first->refcount == 0 || it->first->refcount == 9000) {
+            viewFrames.erase(it->first);
             delete it->first;
             vsapi->freeFrame(it->second);
             it = ownedFrames.erase(it);
@@ -385,6 +391,48 @@ const VSFrame *FakeAvisynth::avsToVSFrame(VideoFrame *frame) {
     return ref;
 }
 
+PVideoFrame FakeAvisynth::makeView(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV, bool planar) {
+    VideoFrame *srcFrame = (VideoFrame *)(void *)src;
+    // the view gets the same base pointer as the source so offsets keep working for views of views
+    BYTE *base = const_cast<BYTE *>(srcFrame->GetReadPtr()) - srcFrame->offset;
+    VideoFrame *vfb;
+
+    if (planar)
+        vfb = new VideoFrame(base, false, srcFrame->offset + rel_offset, new_pitch, new_row_size, new_height,
+            srcFrame->offsetU + rel_offsetU, srcFrame->offsetV + rel_offsetV, new_pitchUV,
+            srcFrame->row_size ? srcFrame->row_sizeUV * new_row_size / srcFrame->row_size : 0,
+            srcFrame->height ? srcFrame->heightUV * new_height / srcFrame->height : 0);
+    else
+        vfb = new VideoFrame(base, false, srcFrame->offset + rel_offset, new_pitch, new_row_size, new_height, 0, 0, 0, 0, 0);
+
+    PVideoFrame pvf(vfb);
+    std::lock_guard<std::mutex> lock(ownedFramesLock);
+    auto it = ownedFrames.find(srcFrame);
+    assert(it != ownedFrames.end());
+    ownedFrames.insert(std::make_pair(vfb, vsapi->addFrameRef(it->second)));
+    viewFrames.insert(vfb);
+    return pvf;
+}
+
+VSFrame *FakeAvisynth::copyView(VideoFrame *frame, const VSFrame *backing) {
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(backing);
+
+    if (fi->numPlanes > 1 && !frame->pitchUV)
+        vsapi->logMessage(mtFatal, "Avisynth Compat: a planar frame created with Subframe() has no chroma planes", core);
+
+    VSFrame *dst = vsapi->newVideoFrame(fi, frame->row_size / fi->bytesPerSample, frame->height, backing, core);
+
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        const BYTE *srcp = frame->GetReadPtr() - frame->offset + (plane == 0 ? frame->offset : (plane == 1 ? frame->offsetU : frame->offsetV));
+        int srcPitch = plane ? frame->pitchUV : frame->pitch;
+        int rowSize = std::min(plane ? frame->row_sizeUV : frame->row_size, vsapi->getFrameWidth(dst, plane) * fi->bytesPerSample);
+        int height = std::min(plane ? frame->heightUV : frame->height, vsapi->getFrameHeight(dst, plane));
+        BitBlt(vsapi->getWritePtr(dst, plane), static_cast<int>(vsapi->getStride(dst, plane)), srcp, srcPitch, rowSize, height);
+    }
+
+    return dst;
+}
+
 FakeAvisynth::~FakeAvisynth() {
     std::map<VideoFrame *, const VSFrame *>::iterator it = ownedFrames.begin();
 
@@ -395,6 +443,7 @@ FakeAvisynth::~FakeAvisynth() {
     }
 
     ownedFrames.clear();
+    viewFrames.clear();
 }
 
 int FakeAvisynth::GetCPUFlags() {
@@ -417,6 +466,7 @@ int FakeAvisynth::GetCPUFlags() {
 }
 
 char *FakeAvisynth::SaveString(const char *s, int length) {
+    std::lock_guard<std::mutex> lock(savedStringsLock);
     auto strIter = (length >= 0) ? savedStrings.emplace(s, length) : savedStrings.emplace(s);
     // UGLY
     // Cast away the const because nobody would actually try to write to a saved string (except possibly an avisynth plugin developer)
@@ -471,35 +521,59 @@ std::string FakeAvisynth::charToFilterArgumentString(char c) {
     }
 }
 
+// Returns a new reference to the packed node behind an UnpackYUY2 or UnpackRGB32 filter
+static VSNode *getPackedSource(VSNode *node, const VSAPI *vsapi) {
+    std::string name = vsapi->getNodeName(node);
+    if ((name != "UnpackYUY2" && name != "UnpackRGB32") || vsapi->getNumNodeDependencies(node) != 1)
+        return nullptr;
+
+    VSNode *source = vsapi->getNodeDependencies(node)[0].source;
+    const VSVideoFormat &f = vsapi->getVideoInfo(source)->format;
+    if (!IsSameVideoFormat(f, cfGray, stInteger, (name == "UnpackYUY2") ? 16 : 32))
+        return nullptr;
+
+    return vsapi->addNodeRef(source);
+}
+
 VSClip::VSClip(VSNode *inclip, FakeAvisynth *fakeEnv, bool pack, const VSAPI *vsapi)
     : clip(inclip), fakeEnv(fakeEnv), vsapi(vsapi), numSlowWarnings(0) {
-    const VSVideoInfo *srcVi = vsapi->getVideoInfo(clip);
+    const VSVideoInfo srcVi = *vsapi->getVideoInfo(clip);
 
     if (pack) {
-        if (IsSameVideoFormat(srcVi->format, cfRGB, stInteger, 8, 0, 0)) {
+        // When the input is the unpacked output of another wrapped filter its packed frames can be used directly
+        VSNode *packed = getPackedSource(clip, vsapi);
+
+        if (packed) {
+            vsapi->freeNode(clip);
+            clip = packed;
+        } else if (IsSameVideoFormat(srcVi.format, cfRGB, stInteger, 8, 0, 0)) {
             clip = packRGB32Create(clip, fakeEnv->core, vsapi);
             assert(clip);
-        } else if (IsSameVideoFormat(srcVi->format, cfYUV, stInteger, 8, 1, 0)) {
+        } else if (IsSameVideoFormat(srcVi.format, cfYUV, stInteger, 8, 1, 0)) {
             clip = packYUY2Create(clip, fakeEnv->core, vsapi);
             assert(clip);
         }
     }
 
     vi = {};
-    vi.width = srcVi->width;
-    vi.height = srcVi->height;
+    vi.width = srcVi.width;
+    vi.height = srcVi.height;
 
-    vi.pixel_type = VSFormatToAVSPixelType(srcVi->format, pack);
+    vi.pixel_type = VSFormatToAVSPixelType(srcVi.format, pack);
     if (!vi.pixel_type)
         vsapi->logMessage(mtFatal, "Bad colorspace", fakeEnv->core);
 
     vi.image_type = VideoInfo::IT_BFF;
-    vi.fps_numerator = int64ToIntS(srcVi->fpsNum);
-    vi.fps_denominator = int64ToIntS(srcVi->fpsDen);
-    vi.num_frames = srcVi->numFrames;
+    vi.fps_numerator = int64ToIntS(srcVi.fpsNum);
+    vi.fps_denominator = int64ToIntS(srcVi.fpsDen);
+    vi.num_frames = srcVi.numFrames;
     vi.sample_type = SAMPLE_INT16;
 }
 
+VSClip::VSClip(const VSClip &other, FakeAvisynth *fakeEnv)
+    : clip(other.vsapi->addNodeRef(other.clip)), fakeEnv(fakeEnv), vsapi(other.vsapi), numSlowWarnings(0), vi(other.vi) {
+}
+
 PVideoFrame VSClip::GetFrame(int n, IScriptEnvironment *env) {
     const VSFrame *ref;
     n = std::min(std::max(0, n), vi.num_frames - 1);
@@ -541,6 +615,7 @@ PVideoFrame VSClip::GetFrame(int n, IScriptEnvironment *env) {
         vsapi->getFrameWidth(ref, 1) * vsapi->getVideoFrameFormat(ref)->bytesPerSample,
         vsapi->getFrameHeight(ref, 1));
     PVideoFrame pvf(vfb);
+    std::lock_guard<std::mutex> lock(fakeEnv->ownedFramesLock);
     fakeEnv->ownedFrames.insert(std::make_pair(vfb, ref));
     return pvf;
 }
@@ -549,6 +624,35 @@ WrappedClip::WrappedClip(const std::string &filterName, const PClip &clip, const
     : filterName(filterName), prefetchInfo(prefetchInfo), preFetchClips(preFetchClips), clip(clip), fakeEnv(fakeEnv) {
 }
 
+void WrappedClip::addInstance(const FilterInstance &instance) {
+    if (extraInstances.empty())
+        idleInstances.push_back({ clip, fakeEnv });
+    extraInstances.push_back(instance);
+    idleInstances.push_back(instance);
+}
+
+FilterInstance WrappedClip::acquireInstance() {
+    if (extraInstances.empty())
+        return { clip, fakeEnv };
+
+    std::unique_lock<std::mutex> lock(instanceLock);
+    instanceReleased.wait(lock, [this] { return !idleInstances.empty(); });
+    FilterInstance instance = idleInstances.back();
+    idleInstances.pop_back();
+    return instance;
+}
+
+void WrappedClip::releaseInstance(const FilterInstance &instance) {
+    if (extraInstances.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(instanceLock);
+        idleInstances.push_back(instance);
+    }
+    instanceReleased.notify_one();
+}
+
 static void prefetchHelper(int n, VSNode *node, const PrefetchInfo &p, VSFrameContext *frameCtx, const VSAPI *vsapi) {
     n /= p.div;
     n *= p.mul;
@@ -749,15 +853,17 @@ static const VSFrame *VS_CC avisynthFilterGetFrame(int n, int activationReason,
     n = std::min(n, clip->clip->GetVideoInfo().num_frames - 1);
 
     if (activationReason == arAllFramesReady || (activationReason == arInitial && (clip->preFetchClips.empty() || clip->prefetchInfo.from > clip->prefetchInfo.to))) {
+        FilterInstance instance = clip->acquireInstance();
+
         // Ready the global stuff needed to make things work behind the scenes, the locking model makes this technically safe but quite ugly.
         // The frame number is needed to pass through frame attributes for filters that create a new frame to return, the context is for GetFrame().
         if (!clip->preFetchClips.empty()) {
-            clip->fakeEnv->uglyN = n;
-            clip->fakeEnv->uglyCtx = frameCtx;
+            FakeAvisynth::uglyN = n;
+            FakeAvisynth::uglyCtx = frameCtx;
         }
 
         try {
-            frame = clip->clip->GetFrame(n, clip->fakeEnv);
+            frame = instance.clip->GetFrame(n, instance.fakeEnv);
 
             if (!frame)
                 vsapi->logMessage(mtFatal, "Avisynth Error: no frame returned", core);
@@ -769,22 +875,24 @@ static const VSFrame *VS_CC avisynthFilterGetFrame(int n, int activationReason,
             vsapi->logMessage(mtFatal, "Avisynth Error: avisynth errors are unrecoverable, crashing...", core);
         }
 
-        clip->fakeEnv->uglyCtx = nullptr;
+        FakeAvisynth::uglyCtx = nullptr;
+
+        // Enjoy the casting to trigger the void * operator. Please contact me if you can make it pretty.
+
+        const VSFrame *ref = nullptr;
+
+        if (frame)
+            ref = instance.fakeEnv->avsToVSFrame((VideoFrame *)((void *)frame));
+
+        frame = nullptr;
+        clip->releaseInstance(instance);
+        return ref;
     } else if (activationReason == arInitial) {
         for (VSNode *c : clip->preFetchClips)
             prefetchHelper(n, c, clip->prefetchInfo, frameCtx, vsapi);
-    } else if (activationReason == arError) {
-        return nullptr;
     }
 
-    // Enjoy the casting to trigger the void * operator. Please contact me if you can make it pretty.
-
-    const VSFrame *ref = nullptr;
-
-    if (frame)
-        ref = clip->fakeEnv->avsToVSFrame((VideoFrame *)((void *)frame));
-
-    return ref;
+    return nullptr;
 }
 
 static void VS_CC avisynthFilterFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
@@ -805,6 +913,7 @@ static void VS_CC fakeAvisynthFunctionWrapper(const VSMap *in, VSMap *out, void
     WrappedFunction *wf = (WrappedFunction *)userData;
     std::unique_ptr<FakeAvisynth> fakeEnv(new FakeAvisynth(wf->interfaceVersion, core, vsapi));
     std::vector<AVSValue> inArgs(wf->parsedArgs.size());
+    std::vector<VSClip *> inClips(wf->parsedArgs.size());
     std::vector<VSNode *> preFetchClips;
 
     int err;
@@ -838,6 +947,7 @@ static void VS_CC fakeAvisynthFunctionWrapper(const VSMap *in, VSMap *out, void
 
                 VSClip *tmpclip = new VSClip(cr, fakeEnv.get(), pack, vsapi);
                 preFetchClips.push_back(tmpclip->GetVSNode());
+                inClips[i] = tmpclip;
                 inArgs[i] = tmpclip;
                 break;
             }
@@ -867,6 +977,39 @@ static void VS_CC fakeAvisynthFunctionWrapper(const VSMap *in, VSMap *out, void
         if (!filterData->preFetchClips.empty())
             filterData->fakeEnv->uglyNode = filterData->preFetchClips.front();
 
+        if (wf->mtMode == MT_MULTI_INSTANCE) {
+            // Create one more instance for every extra thread, the input clips share the already packed nodes so prefetching still applies to them
+            VSCoreInfo ci;
+            vsapi->getCoreInfo(core, &ci);
+
+            for (int i = 1; i < ci.numThreads; i++) {
+                std::unique_ptr<FakeAvisynth> instanceEnv(new FakeAvisynth(wf->interfaceVersion, core, vsapi));
+                std::vector<AVSValue> instanceArgs(inArgs);
+
+                for (size_t j = 0; j < inClips.size(); j++)
+                    if (inClips[j])
+                        instanceArgs[j] = new VSClip(*inClips[j], instanceEnv.get());
+
+                AVSValue instanceRet;
+
+                try {
+                    instanceRet = wf->apply(AVSValue(instanceArgs.data(), static_cast<int>(instanceArgs.size())), wf->avsUserData, instanceEnv.get());
+                } catch (const AvisynthError &e) {
+                    vsapi->logMessage(mtWarning, ("Avisynth Compat: failed to create another instance of " + wf->name + ", " + e.msg).c_str(), core);
+                    break;
+                } catch (const IScriptEnvironment::NotFound &) {
+                    vsapi->logMessage(mtFatal, "Avisynth Error: escaped IScriptEnvironment::NotFound exceptions are non-recoverable, crashing... ", core);
+                }
+
+                if (!instanceRet.IsClip())
+                    break;
+
+                instanceEnv->initializing = false;
+                instanceEnv->uglyNode = filterData->fakeEnv->uglyNode;
+                filterData->addInstance({ instanceRet.AsClip(), instanceEnv.release() });
+            }
+        }
+
         const VideoInfo &viAvs = filterData->clip->GetVideoInfo();
         VSVideoInfo vi;
         vi.height = viAvs.height;
@@ -891,7 +1034,7 @@ static void VS_CC fakeAvisynthFunctionWrapper(const VSMap *in, VSMap *out, void
                                     &vi,
                                     avisynthFilterGetFrame,
                                     avisynthFilterFree,
-                                    (preFetchClips.empty() || prefetchInfo.from > prefetchInfo.to) ? fmFrameState : fmParallelRequests,
+                                    (wf->mtMode == MT_NICE_FILTER || !filterData->extraInstances.empty()) ? fmParallel : (preFetchClips.empty() || prefetchInfo.from > prefetchInfo.to) ? fmFrameState : fmParallelRequests,
                                     deps.data(),
                                     preFetchClips.size(),
                                     filterData.release(),
@@ -983,8 +1126,11 @@ void FakeAvisynth::AddFunction(const char *name, const char *params, ApplyFunc a
     }
 
     registeredFunctions.insert(fname);
+    WrappedFunction *wf = new WrappedFunction(fname, apply, parsedArgs, user_data, interfaceVersion);
+    wf->mtMode = getFilterMTMode(name);
+    addedFunctions.push_back(std::make_pair(std::string(name), wf));
     // Simply assume a single video node is returned
-    vsapi->registerFunction(fname.c_str(), newArgs.c_str(), "clip:vnode;", fakeAvisynthFunctionWrapper, new WrappedFunction(fname, apply, parsedArgs, user_data, interfaceVersion), vsapi->getPluginByID("com.vapoursynth.avisynth", core));
+    vsapi->registerFunction(fname.c_str(), newArgs.c_str(), "clip:vnode;", fakeAvisynthFunctionWrapper, wf, vsapi->getPluginByID("com.vapoursynth.avisynth", core));
 }
 
 bool FakeAvisynth::FunctionExists(const char *name) {
@@ -1071,6 +1217,7 @@ PVideoFrame FakeAvisynth::NewVideoFrame(const VideoInfo &vi, int align) {
         vsapi->getFrameHeight(ref, 1));
 
     PVideoFrame pvf(vfb);
+    std::lock_guard<std::mutex> lock(ownedFramesLock);
     ownedFrames.insert(std::make_pair(vfb, ref));
     return pvf;
 }
@@ -1078,9 +1225,11 @@ PVideoFrame FakeAvisynth::NewVideoFrame(const VideoInfo &vi, int align) {
 bool FakeAvisynth::MakeWritable(PVideoFrame *pvf) {
     // Find the backing frame, copy it, wrap the new frame into a avisynth PVideoFrame
     VideoFrame *vfb = (VideoFrame *)(void *)(*pvf);
+    std::lock_guard<std::mutex> lock(ownedFramesLock);
     auto it = ownedFrames.find(vfb);
     assert(it != ownedFrames.end());
-    VSFrame *ref = vsapi->copyFrame(it->second, core);
+    // views only copy the part they cover
+    VSFrame *ref = viewFrames.count(vfb) ? copyView(vfb, it->second) : vsapi->copyFrame(it->second, core);
     uint8_t *firstPlanePtr = vsapi->getWritePtr(ref, 0);
     VideoFrame *newVfb = new VideoFrame(
         // the data will never be modified due to the writable protections embedded in this mess
@@ -1122,20 +1271,7 @@ void FakeAvisynth::CheckVersion(int version) {
 }
 
 PVideoFrame FakeAvisynth::Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height) {
-    vsapi->logMessage(mtFatal, "Subframe not implemented", core);
-    if (src->row_size != new_row_size)
-        vsapi->logMessage(mtFatal, "Subframe only partially implemented (row_size != new_row_size)", core);
-    // not pretty at all, but the underlying frame has to be fished out to have any idea what the input really is
-    const VSFrame *f = avsToVSFrame((VideoFrame *)(void *)src);
-    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(f);
-    VideoInfo vi;
-    vi.height = new_height;
-    vi.width = vsapi->getFrameWidth(f, 0);
-
-    PVideoFrame dst = NewVideoFrame(vi);
-    BitBlt(dst->GetWritePtr(), dst->GetPitch(), src->GetReadPtr() + rel_offset, new_pitch, new_row_size, new_height);
-
-    return dst;
+    return makeView(src, rel_offset, new_pitch, new_row_size, new_height, 0, 0, 0, false);
 }
 
 int FakeAvisynth::SetMemoryMax(int mem) {
@@ -1159,8 +1295,7 @@ bool FakeAvisynth::PlanarChromaAlignment(PlanarChromaAlignmentMode key) {
 }
 
 PVideoFrame FakeAvisynth::SubframePlanar(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV) {
-    vsapi->logMessage(mtFatal, "SubframePlanar not implemented", core);
-    return nullptr;
+    return makeView(src, rel_offset, new_pitch, new_row_size, new_height, rel_offsetU, rel_offsetV, new_pitchUV, true);
 }
 
 void FakeAvisynth::DeleteScriptEnvironment() {
@@ -1247,8 +1382,28 @@ bool FakeAvisynth::InternalFunctionExists(const char* name) {
     return false;
 }
 
+static std::string lowerCaseName(const std::string &name) {
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lower;
+}
+
+MtMode FakeAvisynth::getFilterMTMode(const std::string &name) const {
+    auto it = filterMTModes.find(lowerCaseName(name));
+    if (it == filterMTModes.end())
+        it = filterMTModes.find("default_mt_mode");
+    return (it != filterMTModes.end()) ? it->second : MT_SERIALIZED;
+}
+
 void FakeAvisynth::SetFilterMTMode(const char* filter, MtMode mode, bool force) {
-    // do nothing
+    // Only calls made while a plugin is loading have an effect, the mode is stored in the functions it added
+    std::string name = lowerCaseName(filter);
+    if (!force && filterMTModes.count(name))
+        return;
+
+    filterMTModes[name] = mode;
+    for (auto &iter : addedFunctions)
+        iter.second->mtMode = getFilterMTMode(iter.first);
 }
 
 IJobCompletion* FakeAvisynth::NewCompletion(size_t capacity) {
@@ -1281,8 +1436,8 @@ void FakeAvisynth::Free(void* ptr) {
 
 PVideoFrame FakeAvisynth::SubframePlanarA(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
     int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV, int rel_offsetA) {
-    vsapi->logMessage(mtFatal, "SubframePlanarA not implemented", core);
-    return PVideoFrame();
+    // frames never have an alpha plane
+    return makeView(src, rel_offset, new_pitch, new_row_size, new_height, rel_offsetU, rel_offsetV, new_pitchUV, true);
 }
 
 static void VS_CC avsLoadPlugin(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
@@ -1346,7 +1501,7 @@ static void VS_CC avsLoadPlugin(const VSMap *in, VSMap *out, void *userData, VSC
 }
 
 WrappedFunction::WrappedFunction(const std::string &name, FakeAvisynth::ApplyFunc apply, const std::vector<AvisynthArgs> &parsedArgs, void *avsUserData, int interfaceVersion) :
-    name(name), apply(apply), parsedArgs(parsedArgs), avsUserData(avsUserData), interfaceVersion(interfaceVersion) {
+    name(name), apply(apply), parsedArgs(parsedArgs), avsUserData(avsUserData), interfaceVersion(interfaceVersion), mtMode(MT_SERIALIZED) {
 }
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
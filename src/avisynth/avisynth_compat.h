@@ -29,10 +29,12 @@
 #include <vector>
 #include <string>
 #include <mutex>
+#include <condition_variable>
 
 namespace AvisynthCompat {
 
 struct WrappedClip;
+struct WrappedFunction;
 
 class FakeAvisynth : public IScriptEnvironment2 {
     friend class VSClip;
@@ -42,21 +44,31 @@ private:
     std::set<std::string> savedStrings;
     const VSAPI *vsapi;
     std::map<VideoFrame *, const VSFrame *> ownedFrames;
+    // frames created by Subframe() that point into the data of another owned frame
+    std::set<VideoFrame *> viewFrames;
+    std::mutex ownedFramesLock;
+    std::mutex savedStringsLock;
     int interfaceVersion;
     std::string charToFilterArgumentString(char c);
     std::mutex registerFunctionLock;
     std::set<std::string> registeredFunctions;
+    // lower case filter name to the mode set with SetFilterMTMode(), "default_mt_mode" applies to everything else
+    std::map<std::string, MtMode> filterMTModes;
+    std::vector<std::pair<std::string, WrappedFunction *>> addedFunctions;
+    MtMode getFilterMTMode(const std::string &name) const;
+    PVideoFrame makeView(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV, bool planar);
+    VSFrame *copyView(VideoFrame *frame, const VSFrame *backing);
 public:
     const VSFrame *avsToVSFrame(VideoFrame *frame);
 
-    // ugly, but unfortunately the best place to put the pseudo global variables, actually they're per context
-    // the locking prevents multiple accesses at once
+    // ugly, but unfortunately the best place to put the pseudo global variables
+    // uglyN and uglyCtx are per thread since MT_NICE_FILTER filters can be called from several threads at once
     bool initializing;
-    int uglyN;
     VSNode *uglyNode;
-    VSFrameContext *uglyCtx;
+    static thread_local int uglyN;
+    static thread_local VSFrameContext *uglyCtx;
 
-    FakeAvisynth(int interfaceVersion, VSCore *core, const VSAPI *vsapi) : core(core), vsapi(vsapi), interfaceVersion(interfaceVersion), initializing(true), uglyN(-1), uglyNode(nullptr), uglyCtx(nullptr) {}
+    FakeAvisynth(int interfaceVersion, VSCore *core, const VSAPI *vsapi) : core(core), vsapi(vsapi), interfaceVersion(interfaceVersion), initializing(true), uglyNode(nullptr) {}
     // virtual avisynth functions
     AVSC_CC ~FakeAvisynth();
 
@@ -168,6 +180,7 @@ private:
     VideoInfo vi;
 public:
     VSClip(VSNode *inclip, FakeAvisynth *fakeEnv, bool pack, const VSAPI *vsapi);
+    VSClip(const VSClip &other, FakeAvisynth *fakeEnv);
     PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment *env);
     bool __stdcall GetParity(int n) {
         return true;
@@ -197,14 +210,32 @@ struct PrefetchInfo {
     PrefetchInfo(int div, int mul, int from, int to) : div(div), mul(mul), from(from), to(to) { }
 };
 
+struct FilterInstance {
+    PClip clip;
+    FakeAvisynth *fakeEnv;
+};
+
 struct WrappedClip {
     std::string filterName;
     PrefetchInfo prefetchInfo;
     std::vector<VSNode *> preFetchClips;
     PClip clip;
     FakeAvisynth *fakeEnv;
+    // MT_MULTI_INSTANCE filters get one more instance per extra thread, the ones not in use wait in idleInstances
+    std::vector<FilterInstance> extraInstances;
+    std::vector<FilterInstance> idleInstances;
+    std::mutex instanceLock;
+    std::condition_variable instanceReleased;
     WrappedClip(const std::string &filterName, const PClip &clip, const std::vector<VSNode *> &preFetchClips, const PrefetchInfo &prefetchInfo, FakeAvisynth *fakeEnv);
+    void addInstance(const FilterInstance &instance);
+    FilterInstance acquireInstance();
+    void releaseInstance(const FilterInstance &instance);
     ~WrappedClip() {
+        idleInstances.clear();
+        for (FilterInstance &instance : extraInstances) {
+            instance.clip = nullptr;
+            delete instance.fakeEnv;
+        }
         clip = nullptr;
         delete fakeEnv;
     }
@@ -223,6 +254,7 @@ struct WrappedFunction {
     std::vector<AvisynthArgs> parsedArgs;
     void *avsUserData;
     int interfaceVersion;
+    MtMode mtMode;
     WrappedFunction(const std::string &name, FakeAvisynth::ApplyFunc apply, const std::vector<AvisynthArgs> &parsedArgs, void *avsUserData, int interfaceVersion);
 };
 
@@ -0,0 +1,334 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+// Evaluates a script once for every framebuffer cache limit given and pulls all frames of
+// an output through getFrameAsync. For every limit the fps, the peak framebuffer usage, the
+// frames that had to be recomputed because they were no longer cached and the time spent
+// reevaluating the cache sizes are reported, which shows how small setMaxCacheSize() can be
+// made on a host before the recomputation starts to cost more than the memory saves.
+//
+// Usage: cachebench [--json] [--threads n] [--requests n] [--output n] script limit_mb...
+// Recomputed frames are the frames a node returned minus the distinct frame numbers among
+// them, the per node numbers are only listed in the json report.
+
+#include "VapourSynth4.h"
+#include "VSScript4.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+const VSAPI *vsapi = nullptr;
+const VSSCRIPTAPI *vssapi = nullptr;
+
+struct Options {
+    std::string script;
+    std::vector<int64_t> limits;
+    int threads = 0;
+    int requests = 0;
+    int outputIndex = 0;
+    bool json = false;
+};
+
+struct NodeResult {
+    std::string name;
+    int64_t produced;
+    int64_t recomputed;
+};
+
+struct LimitResult {
+    int64_t limit;
+    int frames;
+    double fps;
+    int64_t peakMemory;
+    int64_t recomputed;
+    int64_t cacheAdjustments;
+    double cacheAdjustmentTime;
+    std::vector<NodeResult> nodes;
+};
+
+// Keeps a fixed number of frames in flight the same way vspipe does
+struct Run {
+    std::mutex lock;
+    std::condition_variable done;
+    VSNode *node;
+    VSCore *core;
+    int total;
+    int requested = 0;
+    int completed = 0;
+    int64_t peakMemory = 0;
+    std::string error;
+};
+
+void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg) {
+    Run *r = reinterpret_cast<Run *>(userData);
+    vsapi->freeFrame(f);
+
+    VSCoreInfo info;
+    vsapi->getCoreInfo(r->core, &info);
+
+    int next = -1;
+    {
+        std::lock_guard<std::mutex> guard(r->lock);
+        r->peakMemory = std::max(r->peakMemory, info.usedFramebufferSize);
+        if (errorMsg && r->error.empty())
+            r->error = "frame " + std::to_string(n) + ": " + errorMsg;
+        r->completed++;
+        if (r->requested < r->total && r->error.empty())
+            next = r->requested++;
+        else if (r->completed == r->requested)
+            r->done.notify_one();
+    }
+
+    // the callback may be invoked from inside getFrameAsync so the lock can't be held here
+    if (next >= 0)
+        vsapi->getFrameAsync(next, r->node, frameDoneCallback, r);
+}
+
+int64_t getStat(const VSMap *stats, const char *key) {
+    int err;
+    int64_t v = vsapi->mapGetInt(stats, key, 0, &err);
+    return err ? 0 : v;
+}
+
+// every node in the graph once, references are added to the returned nodes
+void collectNodes(VSNode *node, std::unordered_set<VSNode *> &visited, std::vector<VSNode *> &nodes) {
+    if (!visited.insert(node).second)
+        return;
+    nodes.push_back(vsapi->addNodeRef(node));
+    const VSFilterDependency *deps = vsapi->getNodeDependencies(node);
+    int numDeps = vsapi->getNumNodeDependencies(node);
+    for (int i = 0; i < numDeps; i++)
+        collectNodes(deps[i].source, visited, nodes);
+}
+
+bool runLimit(const Options &opts, int64_t limit, LimitResult &result, std::string &error) {
+    VSScriptOptions scriptOpts = { sizeof(VSScriptOptions), ccfEnableGraphInspection, nullptr, nullptr, nullptr };
+    VSScript *se = vssapi->evaluateFile(opts.script.c_str(), nullptr, &scriptOpts);
+    if (vssapi->getError(se)) {
+        error = std::string("script evaluation failed: ") + vssapi->getError(se);
+        vssapi->freeScript(se);
+        return false;
+    }
+
+    VSNode *node = vssapi->getOutputNode(se, opts.outputIndex);
+    if (!node) {
+        error = "failed to retrieve output node " + std::to_string(opts.outputIndex);
+        vssapi->freeScript(se);
+        return false;
+    }
+
+    VSCore *core = vssapi->getCore(se);
+    // set after evaluation so it also overrides a limit set by the script itself
+    vsapi->setMaxCacheSize(limit, core);
+    if (opts.threads > 0)
+        vsapi->setThreadCount(opts.threads, core);
+
+    VSCoreInfo info;
+    vsapi->getCoreInfo(core, &info);
+
+    std::vector<VSNode *> nodes;
+    {
+        std::unordered_set<VSNode *> visited;
+        collectNodes(node, visited, nodes);
+    }
+
+    Run r;
+    r.node = node;
+    r.core = core;
+    r.total = (vsapi->getNodeType(node) == mtVideo) ? vsapi->getVideoInfo(node)->numFrames : vsapi->getAudioInfo(node)->numFrames;
+
+    auto start = std::chrono::steady_clock::now();
+    int initial = std::min(r.total, (opts.requests > 0) ? opts.requests : info.numThreads * 2);
+    for (int i = 0; i < initial; i++) {
+        int n;
+        {
+            std::lock_guard<std::mutex> guard(r.lock);
+            n = r.requested++;
+        }
+        vsapi->getFrameAsync(n, node, frameDoneCallback, &r);
+    }
+    {
+        std::unique_lock<std::mutex> guard(r.lock);
+        r.done.wait(guard, [&r]() { return r.completed == r.requested && (r.requested == r.total || !r.error.empty()); });
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (r.error.empty()) {
+        result.limit = limit;
+        result.frames = r.total;
+        result.fps = r.total / elapsed;
+        result.peakMemory = r.peakMemory;
+        result.recomputed = 0;
+
+        VSMap *stats = vsapi->createMap();
+        vsapi->getCoreStatistics(core, stats);
+        result.cacheAdjustments = getStat(stats, "cacheAdjustments");
+        result.cacheAdjustmentTime = getStat(stats, "cacheAdjustmentTime") / 1e9;
+
+        for (auto iter : nodes) {
+            vsapi->clearMap(stats);
+            vsapi->getNodeStatistics(iter, stats);
+            int64_t produced = getStat(stats, "framesProduced");
+            int64_t recomputed = produced - getStat(stats, "uniqueFramesProduced");
+            result.recomputed += recomputed;
+            result.nodes.push_back({ vsapi->getNodeName(iter), produced, recomputed });
+        }
+        vsapi->freeMap(stats);
+    } else {
+        error = r.error;
+    }
+
+    for (auto iter : nodes)
+        vsapi->freeNode(iter);
+    vsapi->freeNode(node);
+    vssapi->freeScript(se);
+    return r.error.empty();
+}
+
+std::string jsonString(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void printJSON(const std::vector<LimitResult> &results) {
+    printf("[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const LimitResult &r = results[i];
+        printf("  {\n");
+        printf("    \"limit\": %lld,\n", static_cast<long long>(r.limit));
+        printf("    \"frames\": %d,\n", r.frames);
+        printf("    \"fps\": %.3f,\n", r.fps);
+        printf("    \"peakFramebufferSize\": %lld,\n", static_cast<long long>(r.peakMemory));
+        printf("    \"recomputedFrames\": %lld,\n", static_cast<long long>(r.recomputed));
+        printf("    \"cacheAdjustments\": %lld,\n", static_cast<long long>(r.cacheAdjustments));
+        printf("    \"cacheAdjustmentTime\": %.6f,\n", r.cacheAdjustmentTime);
+        printf("    \"nodes\": [");
+        bool first = true;
+        for (const auto &iter : r.nodes) {
+            if (!iter.recomputed)
+                continue;
+            printf("%s\n      { \"name\": %s, \"framesProduced\": %lld, \"recomputedFrames\": %lld }", first ? "" : ",", jsonString(iter.name).c_str(), static_cast<long long>(iter.produced), static_cast<long long>(iter.recomputed));
+            first = false;
+        }
+        printf("%s]\n", first ? "" : "\n    ");
+        printf("  }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    printf("]\n");
+}
+
+bool parseInt(const char *s, int &value) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (!*s || *end)
+        return false;
+    value = static_cast<int>(v);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options opts;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--json")) {
+            opts.json = true;
+        } else if ((!strcmp(argv[i], "--threads") || !strcmp(argv[i], "--requests") || !strcmp(argv[i], "--output")) && i + 1 < argc) {
+            int &value = !strcmp(argv[i], "--threads") ? opts.threads : (!strcmp(argv[i], "--requests") ? opts.requests : opts.outputIndex);
+            if (!parseInt(argv[i + 1], value)) {
+                fprintf(stderr, "Couldn't convert %s to an integer (%s)\n", argv[i + 1], argv[i] + 2);
+                return 1;
+            }
+            i++;
+        } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            printf("Usage: cachebench [--json] [--threads n] [--requests n] [--output n] script limit_mb...\n");
+            return 0;
+        } else if (opts.script.empty()) {
+            opts.script = argv[i];
+        } else {
+            int mb;
+            if (!parseInt(argv[i], mb) || mb <= 0) {
+                fprintf(stderr, "Invalid cache limit: %s\n", argv[i]);
+                return 1;
+            }
+            opts.limits.push_back(static_cast<int64_t>(mb) * 1024 * 1024);
+        }
+    }
+
+    if (opts.script.empty() || opts.limits.empty()) {
+        fprintf(stderr, "Usage: cachebench [--json] [--threads n] [--requests n] [--output n] script limit_mb...\n");
+        return 1;
+    }
+
+    vssapi = getVSScriptAPI(VSSCRIPT_API_VERSION);
+    if (!vssapi) {
+        fprintf(stderr, "Failed to initialize VSScript\n");
+        return 1;
+    }
+
+    vsapi = vssapi->getVSAPI(VAPOURSYNTH_API_VERSION);
+    if (!vsapi) {
+        fprintf(stderr, "Failed to get VapourSynth API pointer\n");
+        return 1;
+    }
+
+    std::vector<LimitResult> results;
+    if (!opts.json)
+        printf("%10s %10s %10s %12s %12s\n", "limit MB", "fps", "peak MB", "recomputed", "adjust ms");
+    for (int64_t limit : opts.limits) {
+        LimitResult result;
+        std::string error;
+        if (!runLimit(opts, limit, result, error)) {
+            fprintf(stderr, "%lld MB: %s\n", static_cast<long long>(limit / (1024 * 1024)), error.c_str());
+            return 1;
+        }
+        if (!opts.json) {
+            printf("%10lld %10.1f %10.1f %12lld %12.1f\n", static_cast<long long>(limit / (1024 * 1024)), result.fps, result.peakMemory / (1024.0 * 1024.0), static_cast<long long>(result.recomputed), result.cacheAdjustmentTime * 1000);
+            fflush(stdout);
+        }
+        results.push_back(std::move(result));
+    }
+
+    if (opts.json)
+        printJSON(results);
+
+    return 0;
+}
@@ -21,9 +21,15 @@
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <iterator>
 #include "p2p.h"
 #include "p2p_api.h"
 
+#ifdef VS_TARGET_CPU_X86
+  #include "p2p_x86.h"
+  #include "../core/cpufeatures.h"
+#endif
+
 #ifdef P2P_USER_NAMESPACE
   #error API build must not use custom namespace
 #endif
@@ -78,12 +84,71 @@ const packing_traits traits_table[] = {
 #undef CASE2
 #undef CASE
 
+#ifdef VS_TARGET_CPU_X86
+// Copy of traits_table with the line functions of the little endian packings
+// replaced by the best SIMD version the CPU supports.
+struct x86_traits_table {
+	packing_traits table[sizeof(traits_table) / sizeof(traits_table[0])];
+
+	void set(enum p2p_packing packing, p2p_unpack_func unpack, p2p_pack_func pack, p2p_pack_func pack_one_fill)
+	{
+		table[packing].unpack = unpack;
+		table[packing].pack = pack;
+		table[packing].pack_one_fill = pack_one_fill;
+	}
+
+	x86_traits_table()
+	{
+		std::copy(std::begin(traits_table), std::end(traits_table), table);
+
+		const CPUFeatures *cpu = getCPUFeatures();
+
+#define P2P_SET(packing, x, isa) set(packing, p2p_x86::unpack_##x##_##isa, p2p_x86::pack_##x##_##isa, p2p_x86::pack_##x##_##isa)
+		if (cpu->sse4_1) {
+			P2P_SET(p2p_yuy2, yuy2, sse41);
+			P2P_SET(p2p_uyvy, uyvy, sse41);
+			P2P_SET(p2p_p010_le, p010, sse41);
+			P2P_SET(p2p_p210_le, p010, sse41);
+			P2P_SET(p2p_p016_le, p016, sse41);
+			P2P_SET(p2p_p216_le, p016, sse41);
+			P2P_SET(p2p_rgb24_le, rgb24, sse41);
+			P2P_SET(p2p_v210_le, v210, sse41);
+			set(p2p_argb32_le, p2p_x86::unpack_argb32_sse41, p2p_x86::pack_argb32_sse41, p2p_x86::pack_argb32_one_fill_sse41);
+		}
+
+		if (cpu->avx2) {
+			P2P_SET(p2p_yuy2, yuy2, avx2);
+			P2P_SET(p2p_uyvy, uyvy, avx2);
+			P2P_SET(p2p_p010_le, p010, avx2);
+			P2P_SET(p2p_p210_le, p010, avx2);
+			P2P_SET(p2p_p016_le, p016, avx2);
+			P2P_SET(p2p_p216_le, p016, avx2);
+			set(p2p_argb32_le, p2p_x86::unpack_argb32_avx2, p2p_x86::pack_argb32_avx2, p2p_x86::pack_argb32_one_fill_avx2);
+		}
+#undef P2P_SET
+
+		// x86 is little endian so the native packings are the same as the _le ones.
+		const enum p2p_packing native[][2] = {
+			{ p2p_rgb24, p2p_rgb24_le }, { p2p_argb32, p2p_argb32_le }, { p2p_p010, p2p_p010_le },
+			{ p2p_p016, p2p_p016_le }, { p2p_p210, p2p_p210_le }, { p2p_p216, p2p_p216_le },
+		};
+		for (const auto &n : native)
+			set(n[0], table[n[1]].unpack, table[n[1]].pack, table[n[1]].pack_one_fill);
+	}
+};
+#endif
+
 const packing_traits &lookup_traits(enum p2p_packing packing)
 {
 	assert(packing >= 0);
 	assert(packing < sizeof(traits_table) / sizeof(traits_table[0]));
 
+#ifdef VS_TARGET_CPU_X86
+	static const x86_traits_table x86_table;
+	const packing_traits &traits = x86_table.table[packing];
+#else
 	const packing_traits &traits = traits_table[packing];
+#endif
 	assert(traits.packing == packing);
 	assert(traits.subsample_h == 0 || traits.is_nv);
 	return traits;
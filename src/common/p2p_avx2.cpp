@@ -0,0 +1,276 @@
+/*
+* Copyright (c) 2018 Hoppsan G. Pig
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <immintrin.h>
+#include "p2p.h"
+#include "p2p_x86.h"
+
+// The AVX2 versions handle twice as many pixels per iteration as the SSE4.1
+// ones and leave the rest of the line to them.
+
+namespace p2p_x86 {
+
+namespace {
+
+template <bool UYVY>
+void unpack_422_8(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_y = static_cast<uint8_t *>(dst[0]);
+	uint8_t *dst_u = static_cast<uint8_t *>(dst[1]);
+	uint8_t *dst_v = static_cast<uint8_t *>(dst[2]);
+	const __m256i lo_mask = _mm256_set1_epi16(0x00FF);
+	unsigned i = left;
+
+	for (; i + 32 <= right; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src_p + i * 2));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src_p + i * 2 + 32));
+
+		__m256i ya = UYVY ? _mm256_srli_epi16(a, 8) : _mm256_and_si256(a, lo_mask);
+		__m256i yb = UYVY ? _mm256_srli_epi16(b, 8) : _mm256_and_si256(b, lo_mask);
+		__m256i ca = UYVY ? _mm256_and_si256(a, lo_mask) : _mm256_srli_epi16(a, 8);
+		__m256i cb = UYVY ? _mm256_and_si256(b, lo_mask) : _mm256_srli_epi16(b, 8);
+
+		// The packs work within 128 bit lanes, the permutes restore pixel order.
+		__m256i y = _mm256_permute4x64_epi64(_mm256_packus_epi16(ya, yb), 0xD8);
+		__m256i c = _mm256_permute4x64_epi64(_mm256_packus_epi16(ca, cb), 0xD8);
+		__m256i uv = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(c, lo_mask), _mm256_srli_epi16(c, 8)), 0xD8);
+
+		_mm256_storeu_si256((__m256i *)(dst_y + i), y);
+		_mm_storeu_si128((__m128i *)(dst_u + i / 2), _mm256_castsi256_si128(uv));
+		_mm_storeu_si128((__m128i *)(dst_v + i / 2), _mm256_extracti128_si256(uv, 1));
+	}
+
+	if (i < right) {
+		if (UYVY)
+			unpack_uyvy_sse41(src, dst, i, right);
+		else
+			unpack_yuy2_sse41(src, dst, i, right);
+	}
+}
+
+template <bool UYVY>
+void pack_422_8(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint8_t *src_y = static_cast<const uint8_t *>(src[0]);
+	const uint8_t *src_u = static_cast<const uint8_t *>(src[1]);
+	const uint8_t *src_v = static_cast<const uint8_t *>(src[2]);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	unsigned i = left;
+
+	for (; i + 32 <= right; i += 32) {
+		__m256i y = _mm256_loadu_si256((const __m256i *)(src_y + i));
+		__m128i u = _mm_loadu_si128((const __m128i *)(src_u + i / 2));
+		__m128i v = _mm_loadu_si128((const __m128i *)(src_v + i / 2));
+		__m256i uv = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(u, v)), _mm_unpackhi_epi8(u, v), 1);
+
+		__m256i lo = UYVY ? _mm256_unpacklo_epi8(uv, y) : _mm256_unpacklo_epi8(y, uv);
+		__m256i hi = UYVY ? _mm256_unpackhi_epi8(uv, y) : _mm256_unpackhi_epi8(y, uv);
+
+		_mm256_storeu_si256((__m256i *)(dst_p + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst_p + i * 2 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	if (i < right) {
+		if (UYVY)
+			pack_uyvy_sse41(src, dst, i, right);
+		else
+			pack_yuy2_sse41(src, dst, i, right);
+	}
+}
+
+template <unsigned Shift>
+void unpack_nv_16(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	uint16_t *dst_u = static_cast<uint16_t *>(dst[1]);
+	uint16_t *dst_v = static_cast<uint16_t *>(dst[2]);
+	const __m256i lo_mask = _mm256_set1_epi32(0xFFFF);
+	unsigned i = left;
+
+	for (; i + 32 <= right; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src_p + i / 2));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src_p + i / 2 + 8));
+		__m256i u = _mm256_packus_epi32(_mm256_and_si256(a, lo_mask), _mm256_and_si256(b, lo_mask));
+		__m256i v = _mm256_packus_epi32(_mm256_srli_epi32(a, 16), _mm256_srli_epi32(b, 16));
+
+		_mm256_storeu_si256((__m256i *)(dst_u + i / 2), _mm256_srli_epi16(_mm256_permute4x64_epi64(u, 0xD8), Shift));
+		_mm256_storeu_si256((__m256i *)(dst_v + i / 2), _mm256_srli_epi16(_mm256_permute4x64_epi64(v, 0xD8), Shift));
+	}
+
+	if (i < right) {
+		if (Shift)
+			unpack_p010_sse41(src, dst, i, right);
+		else
+			unpack_p016_sse41(src, dst, i, right);
+	}
+}
+
+template <unsigned Shift>
+void pack_nv_16(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint16_t *src_u = static_cast<const uint16_t *>(src[1]);
+	const uint16_t *src_v = static_cast<const uint16_t *>(src[2]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+	unsigned i = left;
+
+	for (; i + 32 <= right; i += 32) {
+		__m256i u = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i *)(src_u + i / 2)), Shift);
+		__m256i v = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i *)(src_v + i / 2)), Shift);
+		__m256i lo = _mm256_unpacklo_epi16(u, v);
+		__m256i hi = _mm256_unpackhi_epi16(u, v);
+
+		_mm256_storeu_si256((__m256i *)(dst_p + i / 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst_p + i / 2 + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	if (i < right) {
+		if (Shift)
+			pack_p010_sse41(src, dst, i, right);
+		else
+			pack_p016_sse41(src, dst, i, right);
+	}
+}
+
+template <bool AlphaOneFill>
+void pack_argb32_le(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint8_t *src_p[4] = { static_cast<const uint8_t *>(src[0]), static_cast<const uint8_t *>(src[1]), static_cast<const uint8_t *>(src[2]), static_cast<const uint8_t *>(src[3]) };
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	const __m256i fill = AlphaOneFill ? _mm256_set1_epi8(-1) : _mm256_setzero_si256();
+	unsigned i = left;
+
+	for (; i + 32 <= right; i += 32) {
+		__m256i r = _mm256_loadu_si256((const __m256i *)(src_p[p2p::C_R] + i));
+		__m256i g = _mm256_loadu_si256((const __m256i *)(src_p[p2p::C_G] + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src_p[p2p::C_B] + i));
+		__m256i a = src_p[p2p::C_A] ? _mm256_loadu_si256((const __m256i *)(src_p[p2p::C_A] + i)) : fill;
+
+		__m256i bg_lo = _mm256_unpacklo_epi8(b, g);
+		__m256i bg_hi = _mm256_unpackhi_epi8(b, g);
+		__m256i ra_lo = _mm256_unpacklo_epi8(r, a);
+		__m256i ra_hi = _mm256_unpackhi_epi8(r, a);
+
+		// Pixels 0-3 16-19, 4-7 20-23, 8-11 24-27 and 12-15 28-31
+		__m256i t0 = _mm256_unpacklo_epi16(bg_lo, ra_lo);
+		__m256i t1 = _mm256_unpackhi_epi16(bg_lo, ra_lo);
+		__m256i t2 = _mm256_unpacklo_epi16(bg_hi, ra_hi);
+		__m256i t3 = _mm256_unpackhi_epi16(bg_hi, ra_hi);
+
+		_mm256_storeu_si256((__m256i *)(dst_p + i * 4), _mm256_permute2x128_si256(t0, t1, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst_p + i * 4 + 32), _mm256_permute2x128_si256(t2, t3, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst_p + i * 4 + 64), _mm256_permute2x128_si256(t0, t1, 0x31));
+		_mm256_storeu_si256((__m256i *)(dst_p + i * 4 + 96), _mm256_permute2x128_si256(t2, t3, 0x31));
+	}
+
+	if (i < right) {
+		if (AlphaOneFill)
+			pack_argb32_one_fill_sse41(src, dst, i, right);
+		else
+			pack_argb32_sse41(src, dst, i, right);
+	}
+}
+
+} // namespace
+
+
+void unpack_yuy2_avx2(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_422_8<false>(src, dst, left, right);
+}
+
+void pack_yuy2_avx2(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_422_8<false>(src, dst, left, right);
+}
+
+void unpack_uyvy_avx2(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_422_8<true>(src, dst, left, right);
+}
+
+void pack_uyvy_avx2(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_422_8<true>(src, dst, left, right);
+}
+
+void unpack_p010_avx2(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_nv_16<6>(src, dst, left, right);
+}
+
+void pack_p010_avx2(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_nv_16<6>(src, dst, left, right);
+}
+
+void unpack_p016_avx2(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_nv_16<0>(src, dst, left, right);
+}
+
+void pack_p016_avx2(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_nv_16<0>(src, dst, left, right);
+}
+
+void unpack_argb32_avx2(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p[4] = { static_cast<uint8_t *>(dst[0]), static_cast<uint8_t *>(dst[1]), static_cast<uint8_t *>(dst[2]), static_cast<uint8_t *>(dst[3]) };
+	const __m256i shuffle = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+	                                         0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	unsigned i = left;
+
+	for (; i + 32 <= right; i += 32) {
+		__m256i t0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src_p + i * 4)), shuffle);
+		__m256i t1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src_p + i * 4 + 32)), shuffle);
+		__m256i t2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src_p + i * 4 + 64)), shuffle);
+		__m256i t3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src_p + i * 4 + 96)), shuffle);
+
+		__m256i bg01 = _mm256_unpacklo_epi32(t0, t1);
+		__m256i ra01 = _mm256_unpackhi_epi32(t0, t1);
+		__m256i bg23 = _mm256_unpacklo_epi32(t2, t3);
+		__m256i ra23 = _mm256_unpackhi_epi32(t2, t3);
+
+		// Each DWORD holds 4 pixels of one component in the order 0 8 16 24 4 12 20 28
+		_mm256_storeu_si256((__m256i *)(dst_p[p2p::C_B] + i), _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(bg01, bg23), order));
+		_mm256_storeu_si256((__m256i *)(dst_p[p2p::C_G] + i), _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(bg01, bg23), order));
+		_mm256_storeu_si256((__m256i *)(dst_p[p2p::C_R] + i), _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(ra01, ra23), order));
+		if (dst_p[p2p::C_A])
+			_mm256_storeu_si256((__m256i *)(dst_p[p2p::C_A] + i), _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(ra01, ra23), order));
+	}
+
+	if (i < right)
+		unpack_argb32_sse41(src, dst, i, right);
+}
+
+void pack_argb32_avx2(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_argb32_le<false>(src, dst, left, right);
+}
+
+void pack_argb32_one_fill_avx2(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_argb32_le<true>(src, dst, left, right);
+}
+
+} // namespace p2p_x86
@@ -0,0 +1,434 @@
+/*
+* Copyright (c) 2018 Hoppsan G. Pig
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <smmintrin.h>
+#include "p2p.h"
+#include "p2p_x86.h"
+
+namespace p2p_x86 {
+
+namespace {
+
+// [Y8] [U8] [Y8] [V8] and [U8] [Y8] [V8] [Y8], 16 pixels at a time.
+template <bool UYVY>
+void unpack_422_8(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_y = static_cast<uint8_t *>(dst[0]);
+	uint8_t *dst_u = static_cast<uint8_t *>(dst[1]);
+	uint8_t *dst_v = static_cast<uint8_t *>(dst[2]);
+	const __m128i lo_mask = _mm_set1_epi16(0x00FF);
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src_p + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src_p + i * 2 + 16));
+
+		// Luma is in the low byte of every word for YUY2 and in the high byte for UYVY.
+		__m128i ya = UYVY ? _mm_srli_epi16(a, 8) : _mm_and_si128(a, lo_mask);
+		__m128i yb = UYVY ? _mm_srli_epi16(b, 8) : _mm_and_si128(b, lo_mask);
+		__m128i ca = UYVY ? _mm_and_si128(a, lo_mask) : _mm_srli_epi16(a, 8);
+		__m128i cb = UYVY ? _mm_and_si128(b, lo_mask) : _mm_srli_epi16(b, 8);
+
+		// U0 V0 U1 V1 ... -> U0 U1 ... V0 V1 ...
+		__m128i c = _mm_packus_epi16(ca, cb);
+		__m128i uv = _mm_packus_epi16(_mm_and_si128(c, lo_mask), _mm_srli_epi16(c, 8));
+
+		_mm_storeu_si128((__m128i *)(dst_y + i), _mm_packus_epi16(ya, yb));
+		_mm_storel_epi64((__m128i *)(dst_u + i / 2), uv);
+		_mm_storel_epi64((__m128i *)(dst_v + i / 2), _mm_unpackhi_epi64(uv, uv));
+	}
+
+	if (i < right) {
+		if (UYVY)
+			p2p::packed_to_planar<p2p::packed_uyvy>::unpack(src, dst, i, right);
+		else
+			p2p::packed_to_planar<p2p::packed_yuy2>::unpack(src, dst, i, right);
+	}
+}
+
+template <bool UYVY>
+void pack_422_8(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint8_t *src_y = static_cast<const uint8_t *>(src[0]);
+	const uint8_t *src_u = static_cast<const uint8_t *>(src[1]);
+	const uint8_t *src_v = static_cast<const uint8_t *>(src[2]);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i y = _mm_loadu_si128((const __m128i *)(src_y + i));
+		__m128i u = _mm_loadl_epi64((const __m128i *)(src_u + i / 2));
+		__m128i v = _mm_loadl_epi64((const __m128i *)(src_v + i / 2));
+		__m128i uv = _mm_unpacklo_epi8(u, v);
+
+		_mm_storeu_si128((__m128i *)(dst_p + i * 2), UYVY ? _mm_unpacklo_epi8(uv, y) : _mm_unpacklo_epi8(y, uv));
+		_mm_storeu_si128((__m128i *)(dst_p + i * 2 + 16), UYVY ? _mm_unpackhi_epi8(uv, y) : _mm_unpackhi_epi8(y, uv));
+	}
+
+	if (i < right) {
+		if (UYVY)
+			p2p::planar_to_packed<p2p::packed_uyvy>::pack(src, dst, i, right);
+		else
+			p2p::planar_to_packed<p2p::packed_yuy2>::pack(src, dst, i, right);
+	}
+}
+
+// [U16] [V16] chroma pairs of P016 and P010, 16 pixels (8 pairs) at a time.
+// P010 keeps the samples in the high 10 bits of each word.
+template <unsigned Shift>
+void unpack_nv_16(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	uint16_t *dst_u = static_cast<uint16_t *>(dst[1]);
+	uint16_t *dst_v = static_cast<uint16_t *>(dst[2]);
+	const __m128i lo_mask = _mm_set1_epi32(0xFFFF);
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src_p + i / 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src_p + i / 2 + 4));
+		__m128i u = _mm_packus_epi32(_mm_and_si128(a, lo_mask), _mm_and_si128(b, lo_mask));
+		__m128i v = _mm_packus_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+
+		_mm_storeu_si128((__m128i *)(dst_u + i / 2), _mm_srli_epi16(u, Shift));
+		_mm_storeu_si128((__m128i *)(dst_v + i / 2), _mm_srli_epi16(v, Shift));
+	}
+
+	if (i < right) {
+		if (Shift)
+			p2p::packed_to_planar<p2p::packed_p010_le>::unpack(src, dst, i, right);
+		else
+			p2p::packed_to_planar<p2p::packed_p016_le>::unpack(src, dst, i, right);
+	}
+}
+
+template <unsigned Shift>
+void pack_nv_16(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint16_t *src_u = static_cast<const uint16_t *>(src[1]);
+	const uint16_t *src_v = static_cast<const uint16_t *>(src[2]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i u = _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(src_u + i / 2)), Shift);
+		__m128i v = _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(src_v + i / 2)), Shift);
+
+		_mm_storeu_si128((__m128i *)(dst_p + i / 2), _mm_unpacklo_epi16(u, v));
+		_mm_storeu_si128((__m128i *)(dst_p + i / 2 + 4), _mm_unpackhi_epi16(u, v));
+	}
+
+	if (i < right) {
+		if (Shift)
+			p2p::planar_to_packed<p2p::packed_p010_le>::pack(src, dst, i, right);
+		else
+			p2p::planar_to_packed<p2p::packed_p016_le>::pack(src, dst, i, right);
+	}
+}
+
+// Splits 16 pixels stored as B G R A bytes into one vector per component.
+void split_bgra(__m128i t0, __m128i t1, __m128i t2, __m128i t3, __m128i &r, __m128i &g, __m128i &b, __m128i &a)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+	t0 = _mm_shuffle_epi8(t0, shuffle);
+	t1 = _mm_shuffle_epi8(t1, shuffle);
+	t2 = _mm_shuffle_epi8(t2, shuffle);
+	t3 = _mm_shuffle_epi8(t3, shuffle);
+
+	__m128i bg01 = _mm_unpacklo_epi32(t0, t1);
+	__m128i ra01 = _mm_unpackhi_epi32(t0, t1);
+	__m128i bg23 = _mm_unpacklo_epi32(t2, t3);
+	__m128i ra23 = _mm_unpackhi_epi32(t2, t3);
+
+	b = _mm_unpacklo_epi64(bg01, bg23);
+	g = _mm_unpackhi_epi64(bg01, bg23);
+	r = _mm_unpacklo_epi64(ra01, ra23);
+	a = _mm_unpackhi_epi64(ra01, ra23);
+}
+
+// Interleaves 16 pixels into B G R A bytes.
+void merge_bgra(__m128i r, __m128i g, __m128i b, __m128i a, __m128i &t0, __m128i &t1, __m128i &t2, __m128i &t3)
+{
+	__m128i bg_lo = _mm_unpacklo_epi8(b, g);
+	__m128i bg_hi = _mm_unpackhi_epi8(b, g);
+	__m128i ra_lo = _mm_unpacklo_epi8(r, a);
+	__m128i ra_hi = _mm_unpackhi_epi8(r, a);
+
+	t0 = _mm_unpacklo_epi16(bg_lo, ra_lo);
+	t1 = _mm_unpackhi_epi16(bg_lo, ra_lo);
+	t2 = _mm_unpacklo_epi16(bg_hi, ra_hi);
+	t3 = _mm_unpackhi_epi16(bg_hi, ra_hi);
+}
+
+// [A8-R8-G8-B8] little endian, 16 pixels at a time.
+void unpack_argb32_le(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p[4] = { static_cast<uint8_t *>(dst[0]), static_cast<uint8_t *>(dst[1]), static_cast<uint8_t *>(dst[2]), static_cast<uint8_t *>(dst[3]) };
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i r, g, b, a;
+
+		split_bgra(_mm_loadu_si128((const __m128i *)(src_p + i * 4)), _mm_loadu_si128((const __m128i *)(src_p + i * 4 + 16)),
+		           _mm_loadu_si128((const __m128i *)(src_p + i * 4 + 32)), _mm_loadu_si128((const __m128i *)(src_p + i * 4 + 48)), r, g, b, a);
+
+		_mm_storeu_si128((__m128i *)(dst_p[p2p::C_R] + i), r);
+		_mm_storeu_si128((__m128i *)(dst_p[p2p::C_G] + i), g);
+		_mm_storeu_si128((__m128i *)(dst_p[p2p::C_B] + i), b);
+		if (dst_p[p2p::C_A])
+			_mm_storeu_si128((__m128i *)(dst_p[p2p::C_A] + i), a);
+	}
+
+	if (i < right)
+		p2p::packed_to_planar<p2p::packed_argb32_le>::unpack(src, dst, i, right);
+}
+
+template <bool AlphaOneFill>
+void pack_argb32_le(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint8_t *src_p[4] = { static_cast<const uint8_t *>(src[0]), static_cast<const uint8_t *>(src[1]), static_cast<const uint8_t *>(src[2]), static_cast<const uint8_t *>(src[3]) };
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	const __m128i fill = AlphaOneFill ? _mm_set1_epi8(-1) : _mm_setzero_si128();
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i r = _mm_loadu_si128((const __m128i *)(src_p[p2p::C_R] + i));
+		__m128i g = _mm_loadu_si128((const __m128i *)(src_p[p2p::C_G] + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src_p[p2p::C_B] + i));
+		__m128i a = src_p[p2p::C_A] ? _mm_loadu_si128((const __m128i *)(src_p[p2p::C_A] + i)) : fill;
+		__m128i t0, t1, t2, t3;
+
+		merge_bgra(r, g, b, a, t0, t1, t2, t3);
+
+		_mm_storeu_si128((__m128i *)(dst_p + i * 4), t0);
+		_mm_storeu_si128((__m128i *)(dst_p + i * 4 + 16), t1);
+		_mm_storeu_si128((__m128i *)(dst_p + i * 4 + 32), t2);
+		_mm_storeu_si128((__m128i *)(dst_p + i * 4 + 48), t3);
+	}
+
+	if (i < right)
+		p2p::planar_to_packed<p2p::packed_argb32_le, AlphaOneFill>::pack(src, dst, i, right);
+}
+
+// [R8-G8-B8] little endian, 16 pixels (48 bytes) at a time. The pixels are
+// widened to B G R x and then handled like argb32.
+void unpack_rgb24_le(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p[3] = { static_cast<uint8_t *>(dst[0]), static_cast<uint8_t *>(dst[1]), static_cast<uint8_t *>(dst[2]) };
+	const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i in0 = _mm_loadu_si128((const __m128i *)(src_p + i * 3));
+		__m128i in1 = _mm_loadu_si128((const __m128i *)(src_p + i * 3 + 16));
+		__m128i in2 = _mm_loadu_si128((const __m128i *)(src_p + i * 3 + 32));
+		__m128i r, g, b, a;
+
+		split_bgra(_mm_shuffle_epi8(in0, expand), _mm_shuffle_epi8(_mm_alignr_epi8(in1, in0, 12), expand),
+		           _mm_shuffle_epi8(_mm_alignr_epi8(in2, in1, 8), expand), _mm_shuffle_epi8(_mm_srli_si128(in2, 4), expand), r, g, b, a);
+
+		_mm_storeu_si128((__m128i *)(dst_p[p2p::C_R] + i), r);
+		_mm_storeu_si128((__m128i *)(dst_p[p2p::C_G] + i), g);
+		_mm_storeu_si128((__m128i *)(dst_p[p2p::C_B] + i), b);
+	}
+
+	if (i < right)
+		p2p::packed_to_planar<p2p::packed_rgb24_le>::unpack(src, dst, i, right);
+}
+
+void pack_rgb24_le(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint8_t *src_p[3] = { static_cast<const uint8_t *>(src[0]), static_cast<const uint8_t *>(src[1]), static_cast<const uint8_t *>(src[2]) };
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	const __m128i compact = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	unsigned i = left;
+
+	for (; i + 16 <= right; i += 16) {
+		__m128i r = _mm_loadu_si128((const __m128i *)(src_p[p2p::C_R] + i));
+		__m128i g = _mm_loadu_si128((const __m128i *)(src_p[p2p::C_G] + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src_p[p2p::C_B] + i));
+		__m128i t0, t1, t2, t3;
+
+		merge_bgra(r, g, b, _mm_setzero_si128(), t0, t1, t2, t3);
+
+		// 4 x 12 bytes -> 3 x 16 bytes
+		t0 = _mm_shuffle_epi8(t0, compact);
+		t1 = _mm_shuffle_epi8(t1, compact);
+		t2 = _mm_shuffle_epi8(t2, compact);
+		t3 = _mm_shuffle_epi8(t3, compact);
+
+		_mm_storeu_si128((__m128i *)(dst_p + i * 3), _mm_or_si128(t0, _mm_slli_si128(t1, 12)));
+		_mm_storeu_si128((__m128i *)(dst_p + i * 3 + 16), _mm_or_si128(_mm_srli_si128(t1, 4), _mm_slli_si128(t2, 8)));
+		_mm_storeu_si128((__m128i *)(dst_p + i * 3 + 32), _mm_or_si128(_mm_srli_si128(t2, 8), _mm_slli_si128(t3, 4)));
+	}
+
+	if (i < right)
+		p2p::planar_to_packed<p2p::packed_rgb24_le>::pack(src, dst, i, right);
+}
+
+// v210 with little endian DWORDs, 6 pixels in 4 DWORDs at a time. The stores
+// write 2 luma and 1 chroma sample past the group, which the next group
+// overwrites, so the loop stops while there's still room for that.
+void unpack_v210_le(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	uint16_t *dst_y = static_cast<uint16_t *>(dst[0]);
+	uint16_t *dst_u = static_cast<uint16_t *>(dst[1]);
+	uint16_t *dst_v = static_cast<uint16_t *>(dst[2]);
+	const __m128i mask = _mm_set1_epi32(0x3FF);
+	// w0 = U0 Y0 V0, w1 = Y1 U1 Y2, w2 = V1 Y3 U2, w3 = Y4 V2 Y5 from the LSB
+	const __m128i y_from_ab = _mm_setr_epi8(8, 9, 2, 3, -1, -1, 12, 13, 6, 7, -1, -1, -1, -1, -1, -1);
+	const __m128i y_from_c = _mm_setr_epi8(-1, -1, -1, -1, 2, 3, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1);
+	const __m128i uv_from_ab = _mm_setr_epi8(0, 1, 10, 11, -1, -1, -1, -1, -1, -1, 4, 5, 14, 15, -1, -1);
+	const __m128i uv_from_c = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1, 0, 1, -1, -1, -1, -1, -1, -1);
+	unsigned i = left;
+
+	for (; i % 6 == 0 && i + 8 <= right; i += 6) {
+		__m128i w = _mm_loadu_si128((const __m128i *)(src_p + i / 6 * 4));
+		__m128i ab = _mm_packus_epi32(_mm_and_si128(w, mask), _mm_and_si128(_mm_srli_epi32(w, 10), mask));
+		__m128i c = _mm_and_si128(_mm_srli_epi32(w, 20), mask);
+		c = _mm_packus_epi32(c, c);
+
+		__m128i y = _mm_or_si128(_mm_shuffle_epi8(ab, y_from_ab), _mm_shuffle_epi8(c, y_from_c));
+		__m128i uv = _mm_or_si128(_mm_shuffle_epi8(ab, uv_from_ab), _mm_shuffle_epi8(c, uv_from_c));
+
+		_mm_storeu_si128((__m128i *)(dst_y + i), y);
+		_mm_storel_epi64((__m128i *)(dst_u + i / 2), uv);
+		_mm_storel_epi64((__m128i *)(dst_v + i / 2), _mm_unpackhi_epi64(uv, uv));
+	}
+
+	if (i < right)
+		p2p::packed_to_planar<p2p::packed_v210_le>::unpack(src, dst, i, right);
+}
+
+void pack_v210_le(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	const uint16_t *src_y = static_cast<const uint16_t *>(src[0]);
+	const uint16_t *src_u = static_cast<const uint16_t *>(src[1]);
+	const uint16_t *src_v = static_cast<const uint16_t *>(src[2]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+	const __m128i mask = _mm_set1_epi32(0x3FF);
+	// The 3 fields of each DWORD as 32 bit lanes, uv holds U0-U3 and V0-V3
+	const __m128i a_from_y = _mm_setr_epi8(-1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1);
+	const __m128i a_from_uv = _mm_setr_epi8(0, 1, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1);
+	const __m128i b_from_y = _mm_setr_epi8(0, 1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1);
+	const __m128i b_from_uv = _mm_setr_epi8(-1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 12, 13, -1, -1);
+	const __m128i c_from_y = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1);
+	const __m128i c_from_uv = _mm_setr_epi8(8, 9, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1);
+	unsigned i = left;
+
+	for (; i % 6 == 0 && i + 8 <= right; i += 6) {
+		__m128i y = _mm_loadu_si128((const __m128i *)(src_y + i));
+		__m128i uv = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(src_u + i / 2)), _mm_loadl_epi64((const __m128i *)(src_v + i / 2)));
+
+		__m128i a = _mm_and_si128(_mm_or_si128(_mm_shuffle_epi8(y, a_from_y), _mm_shuffle_epi8(uv, a_from_uv)), mask);
+		__m128i b = _mm_and_si128(_mm_or_si128(_mm_shuffle_epi8(y, b_from_y), _mm_shuffle_epi8(uv, b_from_uv)), mask);
+		__m128i c = _mm_and_si128(_mm_or_si128(_mm_shuffle_epi8(y, c_from_y), _mm_shuffle_epi8(uv, c_from_uv)), mask);
+
+		_mm_storeu_si128((__m128i *)(dst_p + i / 6 * 4), _mm_or_si128(a, _mm_or_si128(_mm_slli_epi32(b, 10), _mm_slli_epi32(c, 20))));
+	}
+
+	if (i < right)
+		p2p::planar_to_packed<p2p::packed_v210_le>::pack(src, dst, i, right);
+}
+
+} // namespace
+
+
+void unpack_yuy2_sse41(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_422_8<false>(src, dst, left, right);
+}
+
+void pack_yuy2_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_422_8<false>(src, dst, left, right);
+}
+
+void unpack_uyvy_sse41(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_422_8<true>(src, dst, left, right);
+}
+
+void pack_uyvy_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_422_8<true>(src, dst, left, right);
+}
+
+void unpack_p010_sse41(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_nv_16<6>(src, dst, left, right);
+}
+
+void pack_p010_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_nv_16<6>(src, dst, left, right);
+}
+
+void unpack_p016_sse41(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_nv_16<0>(src, dst, left, right);
+}
+
+void pack_p016_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_nv_16<0>(src, dst, left, right);
+}
+
+void unpack_rgb24_sse41(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_rgb24_le(src, dst, left, right);
+}
+
+void pack_rgb24_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_rgb24_le(src, dst, left, right);
+}
+
+void unpack_argb32_sse41(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_argb32_le(src, dst, left, right);
+}
+
+void pack_argb32_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_argb32_le<false>(src, dst, left, right);
+}
+
+void pack_argb32_one_fill_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_argb32_le<true>(src, dst, left, right);
+}
+
+void unpack_v210_sse41(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	unpack_v210_le(src, dst, left, right);
+}
+
+void pack_v210_sse41(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	pack_v210_le(src, dst, left, right);
+}
+
+} // namespace p2p_x86
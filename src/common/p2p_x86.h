@@ -0,0 +1,58 @@
+/*
+* Copyright (c) 2018 Hoppsan G. Pig
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef P2P_X86_H_
+#define P2P_X86_H_
+
+#include "p2p_api.h"
+
+/**
+ * SIMD line functions for the most common packings. They have the same
+ * signature and results as the generic templates in p2p.h and hand the last
+ * partial vector of each line to them. Only the little endian (x86 native)
+ * layouts have versions.
+ */
+namespace p2p_x86 {
+
+#define P2P_DECL_LINE(isa, x) \
+	void unpack_##x##_##isa(const void *src, void * const dst[4], unsigned left, unsigned right); \
+	void pack_##x##_##isa(const void * const src[4], void *dst, unsigned left, unsigned right);
+
+P2P_DECL_LINE(sse41, yuy2)
+P2P_DECL_LINE(sse41, uyvy)
+P2P_DECL_LINE(sse41, p010)
+P2P_DECL_LINE(sse41, p016)
+P2P_DECL_LINE(sse41, rgb24)
+P2P_DECL_LINE(sse41, argb32)
+P2P_DECL_LINE(sse41, v210)
+void pack_argb32_one_fill_sse41(const void * const src[4], void *dst, unsigned left, unsigned right);
+
+P2P_DECL_LINE(avx2, yuy2)
+P2P_DECL_LINE(avx2, uyvy)
+P2P_DECL_LINE(avx2, p010)
+P2P_DECL_LINE(avx2, p016)
+P2P_DECL_LINE(avx2, argb32)
+void pack_argb32_one_fill_avx2(const void * const src[4], void *dst, unsigned left, unsigned right);
+
+#undef P2P_DECL_LINE
+
+} // namespace p2p_x86
+
+#endif // P2P_X86_H_
@@ -0,0 +1,136 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef PLANECODER_H
+#define PLANECODER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Lossless plane coder used by the compressed cache tier and the remote frame transport. Every sample is predicted
+// from its neighbours with the median predictor from LOCO-I and the zigzag coded residuals are bit packed in groups
+// of 16 behind a one byte bit width. Float samples are coded as their bit patterns so nothing is lost.
+
+static constexpr int planeCoderGroupSize = 16;
+
+template<typename T>
+static inline T predictSample(const T *row, const T *above, int x) noexcept {
+    if (!above)
+        return x ? row[x - 1] : 0;
+    if (!x)
+        return above[0];
+    // the median of a, b and a + b - c written without branches
+    int64_t a = row[x - 1];
+    int64_t b = above[x];
+    int64_t c = above[x - 1];
+    return static_cast<T>(std::max(std::min(a, b), std::min(std::max(a, b), a + b - c)));
+}
+
+static inline uint8_t *packGroup(const uint32_t *z, uint8_t *dst) noexcept {
+    uint32_t any = 0;
+    for (int i = 0; i < planeCoderGroupSize; i++)
+        any |= z[i];
+
+    int bits = 0;
+    for (int step = 16; step > 0; step >>= 1) {
+        if (any >> (bits + step - 1) >> 1)
+            bits += step;
+    }
+    bits += !!(any >> bits);
+    *dst++ = static_cast<uint8_t>(bits);
+
+    // 16 values always fill a whole number of bytes
+    uint64_t acc = 0;
+    int fill = 0;
+    for (int i = 0; i < planeCoderGroupSize; i++) {
+        acc |= static_cast<uint64_t>(z[i]) << fill;
+        fill += bits;
+        while (fill >= 8) {
+            *dst++ = static_cast<uint8_t>(acc);
+            acc >>= 8;
+            fill -= 8;
+        }
+    }
+    return dst;
+}
+
+static inline const uint8_t *unpackGroup(const uint8_t *src, uint32_t *z) noexcept {
+    int bits = *src++;
+    uint64_t mask = (static_cast<uint64_t>(1) << bits) - 1;
+    uint64_t acc = 0;
+    int fill = 0;
+    for (int i = 0; i < planeCoderGroupSize; i++) {
+        while (fill < bits) {
+            acc |= static_cast<uint64_t>(*src++) << fill;
+            fill += 8;
+        }
+        z[i] = static_cast<uint32_t>(acc & mask);
+        acc >>= bits;
+        fill -= bits;
+    }
+    return src;
+}
+
+template<typename T>
+static uint8_t *compressPlane(const uint8_t *srcp, ptrdiff_t stride, int width, int height, uint8_t *dst, uint32_t *residuals) noexcept {
+    typedef typename std::make_signed<T>::type S;
+    int paddedWidth = (width + planeCoderGroupSize - 1) / planeCoderGroupSize * planeCoderGroupSize;
+    std::fill(residuals + width, residuals + paddedWidth, 0);
+
+    const T *above = nullptr;
+    for (int y = 0; y < height; y++) {
+        const T *row = reinterpret_cast<const T *>(srcp + y * stride);
+        for (int x = 0; x < width; x++) {
+            int32_t s = static_cast<S>(static_cast<T>(row[x] - predictSample(row, above, x)));
+            residuals[x] = (static_cast<uint32_t>(s) << 1) ^ static_cast<uint32_t>(s >> 31);
+        }
+        for (int x = 0; x < paddedWidth; x += planeCoderGroupSize)
+            dst = packGroup(residuals + x, dst);
+        above = row;
+    }
+    return dst;
+}
+
+template<typename T>
+static const uint8_t *decompressPlane(const uint8_t *src, uint8_t *dstp, ptrdiff_t stride, int width, int height, uint32_t *residuals) noexcept {
+    int paddedWidth = (width + planeCoderGroupSize - 1) / planeCoderGroupSize * planeCoderGroupSize;
+
+    const T *above = nullptr;
+    for (int y = 0; y < height; y++) {
+        T *row = reinterpret_cast<T *>(dstp + y * stride);
+        for (int x = 0; x < paddedWidth; x += planeCoderGroupSize)
+            src = unpackGroup(src, residuals + x);
+        for (int x = 0; x < width; x++) {
+            uint32_t s = (residuals[x] >> 1) ^ (0 - (residuals[x] & 1));
+            row[x] = static_cast<T>(predictSample(row, above, x) + s);
+        }
+        above = row;
+    }
+    return src;
+}
+
+// the most bytes compressPlane() can write for a plane
+static inline size_t planeCoderBound(int width, int height) noexcept {
+    return static_cast<size_t>((width + planeCoderGroupSize - 1) / planeCoderGroupSize) * height * (1 + planeCoderGroupSize * 4);
+}
+
+#endif
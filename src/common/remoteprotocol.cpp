@@ -0,0 +1,378 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "remoteprotocol.h"
+#include "planecoder.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef SOCKET socket_t;
+typedef WSABUF RemoteBuffer;
+static void setBuffer(RemoteBuffer &b, const void *data, size_t size) { b.buf = static_cast<char *>(const_cast<void *>(data)); b.len = static_cast<ULONG>(size); }
+static void advanceBuffer(RemoteBuffer &b, size_t n) { b.buf += n; b.len -= static_cast<ULONG>(n); }
+static size_t bufferSize(const RemoteBuffer &b) { return b.len; }
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+typedef int socket_t;
+typedef iovec RemoteBuffer;
+static void setBuffer(RemoteBuffer &b, const void *data, size_t size) { b.iov_base = const_cast<void *>(data); b.iov_len = size; }
+static void advanceBuffer(RemoteBuffer &b, size_t n) { b.iov_base = static_cast<uint8_t *>(b.iov_base) + n; b.iov_len -= n; }
+static size_t bufferSize(const RemoteBuffer &b) { return b.iov_len; }
+#endif
+
+static socket_t toSocket(RemoteSocket s) {
+    return static_cast<socket_t>(s);
+}
+
+// frames are sent as a few large writes so there's nothing to gain from delaying the small messages
+static void setNoDelay(socket_t s) {
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof(noDelay));
+}
+
+bool remoteStartup() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    return !WSAStartup(MAKEWORD(2, 2), &wsaData);
+#else
+    return true;
+#endif
+}
+
+void remoteCleanup() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+RemoteSocket remoteConnect(const std::string &host, int port, std::string &error) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) || !addresses) {
+        error = "Failed to resolve " + host;
+        return invalidRemoteSocket;
+    }
+
+    RemoteSocket result = invalidRemoteSocket;
+    for (addrinfo *iter = addresses; iter && result == invalidRemoteSocket; iter = iter->ai_next) {
+        socket_t s = socket(iter->ai_family, iter->ai_socktype, iter->ai_protocol);
+        if (static_cast<RemoteSocket>(s) == invalidRemoteSocket)
+            continue;
+        if (connect(s, iter->ai_addr, static_cast<int>(iter->ai_addrlen))) {
+            remoteClose(static_cast<RemoteSocket>(s));
+            continue;
+        }
+        setNoDelay(s);
+        result = static_cast<RemoteSocket>(s);
+    }
+    freeaddrinfo(addresses);
+
+    if (result == invalidRemoteSocket)
+        error = "Failed to connect to " + host + ":" + std::to_string(port);
+    return result;
+}
+
+RemoteSocket remoteListen(int port, std::string &error) {
+    socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (static_cast<RemoteSocket>(s) == invalidRemoteSocket) {
+        error = "Failed to create socket";
+        return invalidRemoteSocket;
+    }
+
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) || listen(s, 4)) {
+        remoteClose(static_cast<RemoteSocket>(s));
+        error = "Failed to listen on port " + std::to_string(port);
+        return invalidRemoteSocket;
+    }
+
+    return static_cast<RemoteSocket>(s);
+}
+
+RemoteSocket remoteAccept(RemoteSocket s) {
+    socket_t client = accept(toSocket(s), nullptr, nullptr);
+    if (static_cast<RemoteSocket>(client) == invalidRemoteSocket)
+        return invalidRemoteSocket;
+    setNoDelay(client);
+    return static_cast<RemoteSocket>(client);
+}
+
+void remoteShutdown(RemoteSocket s) {
+#ifdef _WIN32
+    shutdown(toSocket(s), SD_BOTH);
+#else
+    shutdown(toSocket(s), SHUT_RDWR);
+#endif
+}
+
+void remoteClose(RemoteSocket s) {
+#ifdef _WIN32
+    closesocket(toSocket(s));
+#else
+    close(toSocket(s));
+#endif
+}
+
+// sends all buffers, they're modified to keep track of partial sends
+static bool sendBuffers(socket_t s, RemoteBuffer *buffers, size_t count) {
+    while (count > 0) {
+#ifdef _WIN32
+        DWORD sent = 0;
+        if (WSASend(s, buffers, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr))
+            return false;
+        size_t n = sent;
+#else
+        msghdr msg = {};
+        msg.msg_iov = buffers;
+        msg.msg_iovlen = count;
+        ssize_t result = sendmsg(s, &msg, MSG_NOSIGNAL);
+        if (result <= 0)
+            return false;
+        size_t n = static_cast<size_t>(result);
+#endif
+        while (count > 0 && n >= bufferSize(*buffers)) {
+            n -= bufferSize(*buffers);
+            buffers++;
+            count--;
+        }
+        if (count > 0)
+            advanceBuffer(*buffers, n);
+    }
+    return true;
+}
+
+bool remoteSend(RemoteSocket s, const void *data, size_t size) {
+    RemoteBuffer buffer;
+    setBuffer(buffer, data, size);
+    return sendBuffers(toSocket(s), &buffer, 1);
+}
+
+bool remoteSendRows(RemoteSocket s, const uint8_t *data, ptrdiff_t stride, size_t rowSize, int height) {
+    if (stride == static_cast<ptrdiff_t>(rowSize))
+        return remoteSend(s, data, rowSize * height);
+
+    // the rows are gathered by the kernel in batches that stay below every platform's limit
+    static const int batchSize = 64;
+    RemoteBuffer buffers[batchSize];
+    for (int y = 0; y < height; y += batchSize) {
+        int count = std::min(batchSize, height - y);
+        for (int i = 0; i < count; i++)
+            setBuffer(buffers[i], data + (y + i) * stride, rowSize);
+        if (!sendBuffers(toSocket(s), buffers, count))
+            return false;
+    }
+    return true;
+}
+
+bool remoteRecv(RemoteSocket s, void *data, size_t size) {
+    uint8_t *dst = static_cast<uint8_t *>(data);
+    while (size > 0) {
+        int n = recv(toSocket(s), reinterpret_cast<char *>(dst), static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+        if (n <= 0)
+            return false;
+        dst += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool remoteRecvRows(RemoteSocket s, uint8_t *data, ptrdiff_t stride, size_t rowSize, int height) {
+    if (stride == static_cast<ptrdiff_t>(rowSize))
+        return remoteRecv(s, data, rowSize * height);
+
+    for (int y = 0; y < height; y++) {
+        if (!remoteRecv(s, data + y * stride, rowSize))
+            return false;
+    }
+    return true;
+}
+
+bool remoteSendMessage(RemoteSocket s, RemoteMessageType type, int n, const void *payload, size_t size) {
+    RemoteMessageHeader header = { type, n, size };
+    RemoteBuffer buffers[2];
+    setBuffer(buffers[0], &header, sizeof(header));
+    setBuffer(buffers[1], payload, size);
+    return sendBuffers(toSocket(s), buffers, size ? 2 : 1);
+}
+
+static void put(std::vector<uint8_t> &buffer, const void *data, size_t size) {
+    buffer.insert(buffer.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+}
+
+template<typename T>
+static void put(std::vector<uint8_t> &buffer, T value) {
+    put(buffer, &value, sizeof(value));
+}
+
+// properties are stored as the number of keys followed by the key length, key, type and number of elements for every key,
+// ints and floats are stored as int64_t and double and data as the type hint, the size and the bytes
+void remoteWriteProperties(std::vector<uint8_t> &buffer, const VSMap *map, const VSAPI *vsapi) {
+    size_t countPos = buffer.size();
+    uint32_t count = 0;
+    put(buffer, count);
+
+    int numKeys = vsapi->mapNumKeys(map);
+    for (int i = 0; i < numKeys; i++) {
+        const char *key = vsapi->mapGetKey(map, i);
+        int type = vsapi->mapGetType(map, key);
+        if (type != ptInt && type != ptFloat && type != ptData)
+            continue;
+
+        uint32_t numElements = vsapi->mapNumElements(map, key);
+        put(buffer, static_cast<uint32_t>(strlen(key)));
+        put(buffer, key, strlen(key));
+        put(buffer, static_cast<uint32_t>(type));
+        put(buffer, numElements);
+
+        if (type == ptInt) {
+            put(buffer, vsapi->mapGetIntArray(map, key, nullptr), numElements * sizeof(int64_t));
+        } else if (type == ptFloat) {
+            put(buffer, vsapi->mapGetFloatArray(map, key, nullptr), numElements * sizeof(double));
+        } else {
+            for (uint32_t j = 0; j < numElements; j++) {
+                put(buffer, static_cast<int32_t>(vsapi->mapGetDataTypeHint(map, key, j, nullptr)));
+                put(buffer, static_cast<uint32_t>(vsapi->mapGetDataSize(map, key, j, nullptr)));
+                put(buffer, vsapi->mapGetData(map, key, j, nullptr), vsapi->mapGetDataSize(map, key, j, nullptr));
+            }
+        }
+        count++;
+    }
+
+    memcpy(buffer.data() + countPos, &count, sizeof(count));
+}
+
+namespace {
+
+class PropertyReader {
+    const uint8_t *data;
+    size_t size;
+public:
+    PropertyReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    const uint8_t *take(size_t n) {
+        if (n > size)
+            return nullptr;
+        const uint8_t *result = data;
+        data += n;
+        size -= n;
+        return result;
+    }
+
+    template<typename T>
+    bool read(T &value) {
+        const uint8_t *p = take(sizeof(T));
+        if (p)
+            memcpy(&value, p, sizeof(T));
+        return !!p;
+    }
+};
+
+}
+
+bool remoteReadProperties(const uint8_t *data, size_t size, VSMap *map, const VSAPI *vsapi) {
+    PropertyReader reader(data, size);
+    uint32_t count;
+    if (!reader.read(count))
+        return false;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t keyLength, type, numElements;
+        if (!reader.read(keyLength))
+            return false;
+        const uint8_t *keyData = reader.take(keyLength);
+        if (!keyData || !reader.read(type) || !reader.read(numElements))
+            return false;
+        std::string key(reinterpret_cast<const char *>(keyData), keyLength);
+
+        if (type == ptInt || type == ptFloat) {
+            const uint8_t *values = reader.take(static_cast<size_t>(numElements) * 8);
+            if (!values)
+                return false;
+            // the values aren't necessarily aligned in the buffer
+            if (type == ptInt) {
+                std::vector<int64_t> ints(numElements);
+                memcpy(ints.data(), values, numElements * sizeof(int64_t));
+                vsapi->mapSetIntArray(map, key.c_str(), ints.data(), numElements);
+            } else {
+                std::vector<double> floats(numElements);
+                memcpy(floats.data(), values, numElements * sizeof(double));
+                vsapi->mapSetFloatArray(map, key.c_str(), floats.data(), numElements);
+            }
+        } else if (type == ptData) {
+            for (uint32_t j = 0; j < numElements; j++) {
+                int32_t hint;
+                uint32_t dataSize;
+                if (!reader.read(hint) || !reader.read(dataSize))
+                    return false;
+                const uint8_t *bytes = reader.take(dataSize);
+                if (!bytes)
+                    return false;
+                vsapi->mapSetData(map, key.c_str(), reinterpret_cast<const char *>(bytes), dataSize, hint, maAppend);
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t remoteCompressPlane(const uint8_t *srcp, ptrdiff_t stride, int width, int height, int bytesPerSample, uint8_t *dst) {
+    std::vector<uint32_t> residuals((width + planeCoderGroupSize - 1) / planeCoderGroupSize * planeCoderGroupSize);
+    uint8_t *end;
+    if (bytesPerSample == 1)
+        end = compressPlane<uint8_t>(srcp, stride, width, height, dst, residuals.data());
+    else if (bytesPerSample == 2)
+        end = compressPlane<uint16_t>(srcp, stride, width, height, dst, residuals.data());
+    else
+        end = compressPlane<uint32_t>(srcp, stride, width, height, dst, residuals.data());
+    return end - dst;
+}
+
+void remoteDecompressPlane(const uint8_t *src, uint8_t *dstp, ptrdiff_t stride, int width, int height, int bytesPerSample) {
+    std::vector<uint32_t> residuals((width + planeCoderGroupSize - 1) / planeCoderGroupSize * planeCoderGroupSize);
+    if (bytesPerSample == 1)
+        decompressPlane<uint8_t>(src, dstp, stride, width, height, residuals.data());
+    else if (bytesPerSample == 2)
+        decompressPlane<uint16_t>(src, dstp, stride, width, height, residuals.data());
+    else
+        decompressPlane<uint32_t>(src, dstp, stride, width, height, residuals.data());
+}
@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef REMOTEPROTOCOL_H
+#define REMOTEPROTOCOL_H
+
+#include "VapourSynth4.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Wire format shared by vspipe --serve and remote.Source. Every message starts with a RemoteMessageHeader and is
+// followed by size bytes of payload. Everything is sent in the native byte order so both ends have to be little
+// endian, which all supported platforms are. There is no authentication, only serve scripts to trusted networks.
+//
+// The client starts with rmHello containing a RemoteHello and the server answers with rmInfo containing a
+// RemoteVideoInfo or rmError with a message if the output can't be served. After that the client sends any number of
+// rmRequest messages without waiting and the server answers every one of them with rmFrame or rmError in the order
+// the frames are done. The frame number is in the header of all three.
+//
+// An rmFrame payload is a uint32_t with the size of the serialized properties, the properties and one RemotePlaneHeader
+// per plane followed by its size bytes. Raw planes are packed rows without padding, compressed planes are coded with
+// planecoder.h.
+
+static const uint32_t remoteMagic = 0x4E525356; // VSRN
+static const uint32_t remoteVersion = 1;
+static const uint32_t remoteFlagCompress = 1;
+
+enum RemoteMessageType : uint32_t {
+    rmHello = 1,
+    rmInfo = 2,
+    rmRequest = 3,
+    rmFrame = 4,
+    rmError = 5
+};
+
+struct RemoteMessageHeader {
+    uint32_t type;
+    int32_t n;
+    uint64_t size;
+};
+
+struct RemoteHello {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+};
+
+struct RemoteVideoInfo {
+    int32_t colorFamily;
+    int32_t sampleType;
+    int32_t bitsPerSample;
+    int32_t subSamplingW;
+    int32_t subSamplingH;
+    int32_t width;
+    int32_t height;
+    int32_t numFrames;
+    int64_t fpsNum;
+    int64_t fpsDen;
+};
+
+enum RemotePlaneCoding : uint32_t {
+    rpRaw = 0,
+    rpCompressed = 1
+};
+
+struct RemotePlaneHeader {
+    uint32_t coding;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+typedef intptr_t RemoteSocket;
+static const RemoteSocket invalidRemoteSocket = -1;
+
+// the socket functions return false or invalidRemoteSocket on failure and put the reason in error where there's one
+bool remoteStartup();
+void remoteCleanup();
+RemoteSocket remoteConnect(const std::string &host, int port, std::string &error);
+RemoteSocket remoteListen(int port, std::string &error);
+RemoteSocket remoteAccept(RemoteSocket s);
+// makes blocked sends and receives on the socket return so another thread can be stopped before closing it
+void remoteShutdown(RemoteSocket s);
+void remoteClose(RemoteSocket s);
+bool remoteSend(RemoteSocket s, const void *data, size_t size);
+// sends height rows of rowSize bytes without copying them into a buffer first
+bool remoteSendRows(RemoteSocket s, const uint8_t *data, ptrdiff_t stride, size_t rowSize, int height);
+bool remoteRecv(RemoteSocket s, void *data, size_t size);
+bool remoteRecvRows(RemoteSocket s, uint8_t *data, ptrdiff_t stride, size_t rowSize, int height);
+bool remoteSendMessage(RemoteSocket s, RemoteMessageType type, int n, const void *payload, size_t size);
+
+// only int, float and data properties can be sent, the others are skipped
+void remoteWriteProperties(std::vector<uint8_t> &buffer, const VSMap *map, const VSAPI *vsapi);
+bool remoteReadProperties(const uint8_t *data, size_t size, VSMap *map, const VSAPI *vsapi);
+
+// returns the coded size, dst has to hold planeCoderBound() bytes
+size_t remoteCompressPlane(const uint8_t *srcp, ptrdiff_t stride, int width, int height, int bytesPerSample, uint8_t *dst);
+void remoteDecompressPlane(const uint8_t *src, uint8_t *dstp, ptrdiff_t stride, int width, int height, int bytesPerSample);
+
+#endif
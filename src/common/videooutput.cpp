@@ -0,0 +1,258 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "videooutput.h"
+#include "VSHelper4.h"
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+#ifdef VS_TARGET_OS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+static std::string floatBitsToLetter(int bits) {
+    switch (bits) {
+    case 16:
+        return "h";
+    case 32:
+        return "s";
+    case 64:
+        return "d";
+    default:
+        assert(false);
+        return "u";
+    }
+}
+
+bool getY4MHeader(const VSVideoInfo *vi, std::string &header, std::string &error) {
+    std::string y4mFormat;
+
+    if (vi->format.colorFamily == cfGray) {
+        y4mFormat = "mono";
+        if (vi->format.bitsPerSample > 8)
+            y4mFormat = y4mFormat + std::to_string(vi->format.bitsPerSample);
+    } else if (vi->format.colorFamily == cfYUV) {
+        if (vi->format.subSamplingW == 1 && vi->format.subSamplingH == 1)
+            y4mFormat = "420";
+        else if (vi->format.subSamplingW == 1 && vi->format.subSamplingH == 0)
+            y4mFormat = "422";
+        else if (vi->format.subSamplingW == 0 && vi->format.subSamplingH == 0)
+            y4mFormat = "444";
+        else if (vi->format.subSamplingW == 2 && vi->format.subSamplingH == 2)
+            y4mFormat = "410";
+        else if (vi->format.subSamplingW == 2 && vi->format.subSamplingH == 0)
+            y4mFormat = "411";
+        else if (vi->format.subSamplingW == 0 && vi->format.subSamplingH == 1)
+            y4mFormat = "440";
+        else {
+            error = "no y4m identifier exists for current format";
+            return false;
+        }
+
+        if (vi->format.bitsPerSample > 8 && vi->format.sampleType == stInteger)
+            y4mFormat += "p" + std::to_string(vi->format.bitsPerSample);
+        else if (vi->format.sampleType == stFloat)
+            y4mFormat += "p" + floatBitsToLetter(vi->format.bitsPerSample);
+    } else {
+        error = "no y4m identifier exists for current format";
+        return false;
+    }
+
+    header = "YUV4MPEG2 C" + y4mFormat
+        + " W" + std::to_string(vi->width)
+        + " H" + std::to_string(vi->height)
+        + " F" + std::to_string(vi->fpsNum) + ":" + std::to_string(vi->fpsDen)
+        + " Ip A0:0"
+        + " XLENGTH=" + std::to_string(vi->numFrames) + "\n";
+    return true;
+}
+
+void addVideoFrameSegments(const VSFrame *frame, std::vector<OutputSegment> &segments, uint8_t *packBuffer, size_t &bufferOffset, bool packAll, bool gbrOrder, const VSAPI *vsapi) {
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(frame);
+    const int rgbRemap[] = { 1, 2, 0 };
+    for (int rp = 0; rp < fi->numPlanes; rp++) {
+        int p = (gbrOrder && fi->colorFamily == cfRGB) ? rgbRemap[rp] : rp;
+        ptrdiff_t stride = vsapi->getStride(frame, p);
+        const uint8_t *readPtr = vsapi->getReadPtr(frame, p);
+        size_t rowSize = vsapi->getFrameWidth(frame, p) * fi->bytesPerSample;
+        int height = vsapi->getFrameHeight(frame, p);
+
+        if (packAll || static_cast<ptrdiff_t>(rowSize) != stride) {
+            vsh::bitblt(packBuffer + bufferOffset, rowSize, readPtr, stride, rowSize, height);
+            readPtr = packBuffer + bufferOffset;
+            bufferOffset += rowSize * height;
+        }
+
+        segments.push_back({ readPtr, rowSize * height });
+    }
+}
+
+bool writeOutputSegments(VideoOutputFile file, const std::vector<OutputSegment> &segments) {
+#ifdef VS_TARGET_OS_WINDOWS
+    HANDLE handle = reinterpret_cast<HANDLE>(file);
+    for (const auto &iter : segments) {
+        size_t written = 0;
+        while (written < iter.size) {
+            DWORD result = 0;
+            if (!WriteFile(handle, iter.data + written, static_cast<DWORD>(std::min<size_t>(iter.size - written, 0x40000000)), &result, nullptr))
+                return false;
+            written += result;
+        }
+    }
+    return true;
+#else
+    std::vector<iovec> iov;
+    iov.reserve(segments.size());
+    for (const auto &iter : segments)
+        iov.push_back({ const_cast<uint8_t *>(iter.data), iter.size });
+
+    // writev() may write less than everything to pipes so continue where it stopped
+    size_t first = 0;
+    int fd = static_cast<int>(file);
+    while (first < iov.size()) {
+        ssize_t written = writev(fd, iov.data() + first, static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX)));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        while (first < iov.size() && static_cast<size_t>(written) >= iov[first].iov_len) {
+            written -= iov[first].iov_len;
+            first++;
+        }
+
+        if (first < iov.size()) {
+            iov[first].iov_base = reinterpret_cast<uint8_t *>(iov[first].iov_base) + written;
+            iov[first].iov_len -= written;
+        }
+    }
+    return true;
+#endif
+}
+
+static std::string getWriteError() {
+#ifdef VS_TARGET_OS_WINDOWS
+    return "error: " + std::to_string(GetLastError());
+#else
+    return "errno: " + std::to_string(errno);
+#endif
+}
+
+namespace {
+
+struct VideoOutputState {
+    std::mutex lock;
+    std::condition_variable frameDone;
+    std::map<int, const VSFrame *> frames; // done but not written yet
+    int outstanding = 0;
+    std::string error;
+};
+
+}
+
+static void VS_CC videoOutputFrameDone(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg) {
+    VideoOutputState *state = reinterpret_cast<VideoOutputState *>(userData);
+    std::lock_guard<std::mutex> lock(state->lock);
+    if (f)
+        state->frames[n] = f;
+    else if (state->error.empty())
+        state->error = "Failed to retrieve frame " + std::to_string(n) + (errorMsg ? std::string(" with error: ") + errorMsg : std::string());
+    --state->outstanding;
+    state->frameDone.notify_one();
+}
+
+bool outputVideoFrames(VSNode *node, VideoOutputFile file, bool y4m, bool gbrOrder, int prefetch, VSOutputProgressCallback progress, void *userData, std::string &error, const VSAPI *vsapi) {
+    const VSVideoInfo *vi = vsapi->getVideoInfo(node);
+    if (!vsh::isConstantVideoFormat(vi)) {
+        error = "Only clips with constant format and dimensions can be output";
+        return false;
+    }
+
+    if (y4m) {
+        std::string header;
+        if (!getY4MHeader(vi, header, error))
+            return false;
+        if (!writeOutputSegments(file, { { reinterpret_cast<const uint8_t *>(header.data()), header.size() } })) {
+            error = "Write failed when writing initial header, " + getWriteError();
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> buffer(static_cast<size_t>(vi->width) * vi->height * vi->format.bytesPerSample * vi->format.numPlanes);
+    std::vector<OutputSegment> segments;
+    VideoOutputState state;
+    prefetch = std::max(prefetch, 1);
+    int requested = 0;
+
+    std::unique_lock<std::mutex> lock(state.lock);
+    for (int n = 0; n < vi->numFrames; n++) {
+        for (; requested < vi->numFrames && requested < n + prefetch; requested++) {
+            ++state.outstanding;
+            lock.unlock();
+            vsapi->getFrameAsync(requested, node, videoOutputFrameDone, &state);
+            lock.lock();
+        }
+
+        state.frameDone.wait(lock, [&] { return !state.error.empty() || state.frames.count(n); });
+        if (!state.error.empty())
+            break;
+
+        auto iter = state.frames.find(n);
+        const VSFrame *frame = iter->second;
+        state.frames.erase(iter);
+        lock.unlock();
+
+        // the frames are written from the calling thread so the writes always happen in order
+        segments.clear();
+        size_t bufferOffset = 0;
+        if (y4m)
+            segments.push_back({ reinterpret_cast<const uint8_t *>(y4mFrameHeader), y4mFrameHeaderSize });
+        addVideoFrameSegments(frame, segments, buffer.data(), bufferOffset, false, gbrOrder, vsapi);
+        bool written = writeOutputSegments(file, segments);
+        std::string writeError = written ? std::string() : getWriteError();
+        vsapi->freeFrame(frame);
+        bool stopped = written && progress && !progress(userData, n + 1, vi->numFrames);
+
+        lock.lock();
+        if (!written || stopped) {
+            if (state.error.empty())
+                state.error = written ? "Output stopped at frame " + std::to_string(n) : "Write failed when writing frame: " + std::to_string(n) + ", " + writeError;
+            break;
+        }
+    }
+
+    // the callbacks of the outstanding requests still use the state
+    state.frameDone.wait(lock, [&] { return state.outstanding == 0; });
+    for (auto &iter : state.frames)
+        vsapi->freeFrame(iter.second);
+
+    error = state.error;
+    return error.empty();
+}
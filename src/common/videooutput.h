@@ -0,0 +1,60 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef VIDEOOUTPUT_H
+#define VIDEOOUTPUT_H
+
+#include "VapourSynth4.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Raw and y4m video output shared by vspipe and the core, which uses it for outputVideoNode() and through that for
+// VideoNode.output() in the Python module. A frame is written as its planes one after another with the rows packed
+// and y4m adds a FRAME line in front of every frame.
+
+// a file descriptor or a HANDLE on windows
+typedef intptr_t VideoOutputFile;
+
+// A piece of output written in a single call together with the rest of the frame
+struct OutputSegment {
+    const uint8_t *data;
+    size_t size;
+};
+
+static const char y4mFrameHeader[] = "FRAME\n";
+static const size_t y4mFrameHeaderSize = 6;
+
+// fails for formats y4m has no identifier for, alpha isn't checked since it's a separate node
+bool getY4MHeader(const VSVideoInfo *vi, std::string &header, std::string &error);
+
+// adds the planes of a video frame to segments, rgb is added in gbr order when gbrOrder is set. Planes where the stride
+// differs from the row size are packed into packBuffer at bufferOffset, with packAll set every plane is packed.
+void addVideoFrameSegments(const VSFrame *frame, std::vector<OutputSegment> &segments, uint8_t *packBuffer, size_t &bufferOffset, bool packAll, bool gbrOrder, const VSAPI *vsapi);
+
+// writes everything or fails with the reason in errno or GetLastError()
+bool writeOutputSegments(VideoOutputFile file, const std::vector<OutputSegment> &segments);
+
+// Requests the frames of node with up to prefetch of them outstanding and writes them to file in order. progress is
+// called on the calling thread after every written frame and stops the output when it returns zero.
+bool outputVideoFrames(VSNode *node, VideoOutputFile file, bool y4m, bool gbrOrder, int prefetch, VSOutputProgressCallback progress, void *userData, std::string &error, const VSAPI *vsapi);
+
+#endif
@@ -22,6 +22,12 @@
 #include <cstring>
 #include <bitset>
 
+// wave.cpp is also built into tools that have no cpu dispatch, so only use sse2 when the compiler may assume it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef _WIN32
 #define WAVE_LITTLE_ENDIAN
 #elif defined(__BYTE_ORDER__)
@@ -42,10 +48,93 @@
 #define WAVE_SWAP32(x) __builtin_bswap32(x)
 #endif // WAVE_BIG_ENDIAN
 
+#ifdef WAVE_SSE2
+// Interleaves 8 samples of channels c to c + 7 with an 8x8 transpose.
+static void Pack8x8Words(const uint16_t *const *const S, uint16_t *D, size_t i, size_t c, size_t Channels) {
+    __m128i a[8], b[8];
+    for (int k = 0; k < 8; k++)
+        a[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + k] + i));
+    for (int k = 0; k < 4; k++) {
+        b[k * 2 + 0] = _mm_unpacklo_epi16(a[k * 2], a[k * 2 + 1]);
+        b[k * 2 + 1] = _mm_unpackhi_epi16(a[k * 2], a[k * 2 + 1]);
+    }
+    for (int k = 0; k < 2; k++) {
+        a[k * 4 + 0] = _mm_unpacklo_epi32(b[k * 4 + 0], b[k * 4 + 2]);
+        a[k * 4 + 1] = _mm_unpackhi_epi32(b[k * 4 + 0], b[k * 4 + 2]);
+        a[k * 4 + 2] = _mm_unpacklo_epi32(b[k * 4 + 1], b[k * 4 + 3]);
+        a[k * 4 + 3] = _mm_unpackhi_epi32(b[k * 4 + 1], b[k * 4 + 3]);
+    }
+    for (int k = 0; k < 4; k++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(D + (k * 2 + 0) * Channels + c), _mm_unpacklo_epi64(a[k], a[k + 4]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(D + (k * 2 + 1) * Channels + c), _mm_unpackhi_epi64(a[k], a[k + 4]));
+    }
+}
+
+// Interleaves 8 samples of channels c to c + 3.
+static void Pack4x8Words(const uint16_t *const *const S, uint16_t *D, size_t i, size_t c, size_t Channels) {
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 0] + i));
+    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 1] + i));
+    __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 2] + i));
+    __m128i a3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 3] + i));
+    __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+    __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+    __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+    __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+    __m128i r[4] = { _mm_unpacklo_epi32(b0, b2), _mm_unpackhi_epi32(b0, b2), _mm_unpacklo_epi32(b1, b3), _mm_unpackhi_epi32(b1, b3) };
+    for (int k = 0; k < 4; k++) {
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(D + (k * 2 + 0) * Channels + c), r[k]);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(D + (k * 2 + 1) * Channels + c), _mm_unpackhi_epi64(r[k], r[k]));
+    }
+}
+
+// Interleaves 4 samples of channels c to c + 3 with a 4x4 transpose.
+static void Pack4x4Dwords(const uint32_t *const *const S, uint32_t *D, size_t i, size_t c, size_t Channels) {
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 0] + i));
+    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 1] + i));
+    __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 2] + i));
+    __m128i a3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[c + 3] + i));
+    __m128i b0 = _mm_unpacklo_epi32(a0, a1);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a1);
+    __m128i b2 = _mm_unpacklo_epi32(a2, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a2, a3);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 0 * Channels + c), _mm_unpacklo_epi64(b0, b2));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 1 * Channels + c), _mm_unpackhi_epi64(b0, b2));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 2 * Channels + c), _mm_unpacklo_epi64(b1, b3));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 3 * Channels + c), _mm_unpackhi_epi64(b1, b3));
+}
+#endif
+
 void PackChannels16to16le(const uint8_t *const *const Src, uint8_t *Dst, size_t Length, size_t Channels) {
     const uint16_t *const *const S = reinterpret_cast<const uint16_t *const *>(Src);
     uint16_t *D = reinterpret_cast<uint16_t *>(Dst);
-    for (size_t i = 0; i < Length; i++) {
+    size_t i = 0;
+#ifdef WAVE_SSE2
+    if (Channels == 2) {
+        for (; i + 8 <= Length; i += 8) {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[0] + i));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[1] + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 0), _mm_unpacklo_epi16(a0, a1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 8), _mm_unpackhi_epi16(a0, a1));
+            D += 16;
+        }
+    }
+
+    // Groups of 8 and then 4 channels are interleaved 8 samples at a time, the rest is done one by one.
+    size_t VecChannels = Channels & ~static_cast<size_t>(3);
+    for (; i + 8 <= Length && VecChannels; i += 8) {
+        size_t c = 0;
+        for (; c + 8 <= VecChannels; c += 8)
+            Pack8x8Words(S, D, i, c, Channels);
+        if (c < VecChannels)
+            Pack4x8Words(S, D, i, c, Channels);
+        for (size_t k = 0; k < 8; k++) {
+            for (c = VecChannels; c < Channels; c++)
+                D[k * Channels + c] = S[c][i + k];
+        }
+        D += Channels * 8;
+    }
+#endif
+    for (; i < Length; i++) {
         for (size_t c = 0; c < Channels; c++)
             D[c] = WAVE_SWAP16(S[c][i]);
         D += Channels;
@@ -55,7 +144,31 @@ void PackChannels16to16le(const uint8_t *const *const Src, uint8_t *Dst, size_t
 void PackChannels32to32le(const uint8_t *const *const Src, uint8_t *Dst, size_t Length, size_t Channels) {
     const uint32_t *const *const S = reinterpret_cast<const uint32_t *const *>(Src);
     uint32_t *D = reinterpret_cast<uint32_t *>(Dst);
-    for (size_t i = 0; i < Length; i++) {
+    size_t i = 0;
+#ifdef WAVE_SSE2
+    if (Channels == 2) {
+        for (; i + 4 <= Length; i += 4) {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[0] + i));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S[1] + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 0), _mm_unpacklo_epi32(a0, a1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(D + 4), _mm_unpackhi_epi32(a0, a1));
+            D += 8;
+        }
+    }
+
+    // Groups of 4 channels are interleaved 4 samples at a time, the rest is done one by one.
+    size_t VecChannels = Channels & ~static_cast<size_t>(3);
+    for (; i + 4 <= Length && VecChannels; i += 4) {
+        for (size_t c = 0; c < VecChannels; c += 4)
+            Pack4x4Dwords(S, D, i, c, Channels);
+        for (size_t k = 0; k < 4; k++) {
+            for (size_t c = VecChannels; c < Channels; c++)
+                D[k * Channels + c] = S[c][i + k];
+        }
+        D += Channels * 4;
+    }
+#endif
+    for (; i < Length; i++) {
         for (size_t c = 0; c < Channels; c++)
             D[c] = WAVE_SWAP32(S[c][i]);
         D += Channels;
@@ -68,9 +181,9 @@ void PackChannels32to24le(const uint8_t *const *const Src, uint8_t *Dst, size_t
 #ifdef WAVE_LITTLE_ENDIAN
             memcpy(Dst + c * 3, Src[c] + i * 4 + 1, 3);
 #else
-            Dst[c * 3 + 0] = Src[c] + i * 4 + 2;
-            Dst[c * 3 + 1] = Src[c] + i * 4 + 1;
-            Dst[c * 3 + 2] = Src[c] + i * 4 + 0;
+            Dst[c * 3 + 0] = Src[c][i * 4 + 2];
+            Dst[c * 3 + 1] = Src[c][i * 4 + 1];
+            Dst[c * 3 + 2] = Src[c][i * 4 + 0];
 #endif
         }
         Dst += Channels * 3;
@@ -27,12 +27,27 @@
 #include <algorithm>
 #include <vector>
 #include <set>
+#include <cmath>
 #include "internalfilters.h"
 #include "VSHelper4.h"
 #include "filtershared.h"
+#include "cpufeatures.h"
+#include "kernel/audio.h"
+#include "kernel/cpulevel.h"
 
 using namespace vsh;
 
+// Returns the samples [start, start + length) of src as src itself or a view of it, nullptr means the
+// samples have to be copied and src is only freed when something is returned
+static const VSFrame *getAudioRange(const VSFrame *src, int start, int length, VSCore *core, const VSAPI *vsapi) {
+    if (start == 0 && length == vsapi->getFrameLength(src))
+        return src;
+    const VSFrame *view = vsapi->newAudioFrameView(src, start, length, nullptr, core);
+    if (view)
+        vsapi->freeFrame(src);
+    return view;
+}
+
 //////////////////////////////////////////
 // AudioTrim
 
@@ -45,18 +60,19 @@ typedef SingleNodeData<AudioTrimDataExtra> AudioTrimData;
 
 static const VSFrame *VS_CC audioTrimGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     AudioTrimData *d = reinterpret_cast<AudioTrimData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
 
-    int64_t startSample = n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES) + d->first;
-    int startFrame = (int)(startSample / VS_AUDIO_FRAME_SAMPLES);
-    int length = static_cast<int>(std::min<int64_t>(d->ai.numSamples - n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES), VS_AUDIO_FRAME_SAMPLES));
+    int64_t startSample = n * static_cast<int64_t>(frameSamples) + d->first;
+    int startFrame = (int)(startSample / frameSamples);
+    int length = static_cast<int>(std::min<int64_t>(d->ai.numSamples - n * static_cast<int64_t>(frameSamples), frameSamples));
 
-    if (startSample % VS_AUDIO_FRAME_SAMPLES == 0 && n != d->ai.numFrames - 1) { // pass through audio frames when possible
+    if (startSample % frameSamples == 0 && n != d->ai.numFrames - 1) { // pass through audio frames when possible
         if (activationReason == arInitial) {
             vsapi->requestFrameFilter(startFrame, d->node, frameCtx);
         } else if (activationReason == arAllFramesReady) {
             const VSFrame *src = vsapi->getFrameFilter(startFrame, d->node, frameCtx);
-            if (length == vsapi->getFrameLength(src))
-                return src;
+            if (const VSFrame *range = getAudioRange(src, 0, length, core, vsapi))
+                return range;
             VSFrame *dst = vsapi->newAudioFrame(&d->ai.format, length, src, core);
             for (int channel = 0; channel < d->ai.format.numChannels; channel++)
                 memcpy(vsapi->getWritePtr(dst, channel), vsapi->getReadPtr(src, channel), length * d->ai.format.bytesPerSample);
@@ -64,16 +80,20 @@ static const VSFrame *VS_CC audioTrimGetframe(int n, int activationReason, void
             return dst;
         }
     } else {
-        int numSrc1Samples = VS_AUDIO_FRAME_SAMPLES - (startSample % VS_AUDIO_FRAME_SAMPLES);
+        int numSrc1Samples = frameSamples - (startSample % frameSamples);
         if (activationReason == arInitial) {
             vsapi->requestFrameFilter(startFrame, d->node, frameCtx);
             if (numSrc1Samples < length)
                 vsapi->requestFrameFilter(startFrame + 1, d->node, frameCtx);
         } else if (activationReason == arAllFramesReady) {
             const VSFrame *src1 = vsapi->getFrameFilter(startFrame, d->node, frameCtx);
+            if (length <= numSrc1Samples) {
+                if (const VSFrame *range = getAudioRange(src1, frameSamples - numSrc1Samples, length, core, vsapi))
+                    return range;
+            }
             VSFrame *dst = vsapi->newAudioFrame(&d->ai.format, length, src1, core);
             for (int channel = 0; channel < d->ai.format.numChannels; channel++)
-                memcpy(vsapi->getWritePtr(dst, channel), vsapi->getReadPtr(src1, channel) + (VS_AUDIO_FRAME_SAMPLES - numSrc1Samples) * d->ai.format.bytesPerSample, numSrc1Samples * d->ai.format.bytesPerSample);
+                memcpy(vsapi->getWritePtr(dst, channel), vsapi->getReadPtr(src1, channel) + (frameSamples - numSrc1Samples) * d->ai.format.bytesPerSample, numSrc1Samples * d->ai.format.bytesPerSample);
             vsapi->freeFrame(src1);
 
             if (length > numSrc1Samples) {
@@ -157,19 +177,20 @@ typedef VariableNodeData<AudioSpliceDataExtra> AudioSpliceData;
 
 static const VSFrame *VS_CC audioSpliceGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     AudioSpliceData *d = reinterpret_cast<AudioSpliceData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
 
-    int64_t sampleStart = n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
-    int remainingSamples = static_cast<int>(std::min<int64_t>(VS_AUDIO_FRAME_SAMPLES, d->ai.numSamples - sampleStart));
+    int64_t sampleStart = n * static_cast<int64_t>(frameSamples);
+    int remainingSamples = static_cast<int>(std::min<int64_t>(frameSamples, d->ai.numSamples - sampleStart));
 
     if (activationReason == arInitial) {
         for (size_t i = 0; i < d->cumSamples.size(); i++) {
             if (d->cumSamples[i] > sampleStart) {
                 int64_t currentStartSample = sampleStart - ((i > 0) ? d->cumSamples[i - 1] : 0);
-                int64_t reqStartOffset = currentStartSample % VS_AUDIO_FRAME_SAMPLES;
-                int reqFrame = static_cast<int>(currentStartSample / VS_AUDIO_FRAME_SAMPLES);
+                int64_t reqStartOffset = currentStartSample % frameSamples;
+                int reqFrame = static_cast<int>(currentStartSample / frameSamples);
                 do {
-                    int64_t reqStart = reqFrame * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
-                    int reqSamples = static_cast<int>(std::min<int64_t>(VS_AUDIO_FRAME_SAMPLES - reqStartOffset, d->numSamples[i] - reqStart));
+                    int64_t reqStart = reqFrame * static_cast<int64_t>(frameSamples);
+                    int reqSamples = static_cast<int>(std::min<int64_t>(frameSamples - reqStartOffset, d->numSamples[i] - reqStart));
                     reqStartOffset = 0;
                     vsapi->requestFrameFilter(reqFrame, d->nodes[i], frameCtx);
                     remainingSamples -= reqSamples;
@@ -191,13 +212,19 @@ static const VSFrame *VS_CC audioSpliceGetframe(int n, int activationReason, voi
         for (size_t i = 0; i < d->cumSamples.size(); i++) {
             if (d->cumSamples[i] > sampleStart) {
                 int64_t currentStartSample = sampleStart - ((i > 0) ? d->cumSamples[i - 1] : 0);
-                int reqStartOffset = static_cast<int>(currentStartSample % VS_AUDIO_FRAME_SAMPLES);
-                int reqFrame = static_cast<int>(currentStartSample / VS_AUDIO_FRAME_SAMPLES);
+                int reqStartOffset = static_cast<int>(currentStartSample % frameSamples);
+                int reqFrame = static_cast<int>(currentStartSample / frameSamples);
                 do {
                     const VSFrame *src = vsapi->getFrameFilter(reqFrame++, d->nodes[i], frameCtx);
                     int length = vsapi->getFrameLength(src) - reqStartOffset;
-                    if (!dst)
+                    if (!dst) {
+                        // the whole output frame is in one source frame
+                        if (length >= remainingSamples) {
+                            if (const VSFrame *range = getAudioRange(src, reqStartOffset, remainingSamples, core, vsapi))
+                                return range;
+                        }
                         dst = vsapi->newAudioFrame(&d->ai.format, remainingSamples, src, core);
+                    }
 
                     for (int p = 0; p < d->ai.format.numChannels; p++)
                         memcpy(vsapi->getWritePtr(dst, p) + dstOffset, vsapi->getReadPtr(src, p) + reqStartOffset * d->ai.format.bytesPerSample, std::min(length, remainingSamples) * d->ai.format.bytesPerSample);
@@ -249,10 +276,11 @@ static void VS_CC audioSpliceCreate(const VSMap *in, VSMap *out, void *userData,
         d->ai.numSamples += ai->numSamples;
     }
 
+    int frameSamples = vsapi->getAudioFrameSamples(core);
     d->cumSamples.push_back(d->numSamples[0]);
     for (int i = 1; i < numNodes; i++) {
         int64_t totalSamples = d->cumSamples.back() + d->numSamples[i];
-        if (totalSamples > std::numeric_limits<int>::max() * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES))
+        if (totalSamples > std::numeric_limits<int>::max() * static_cast<int64_t>(frameSamples))
             RETERROR("AudioSplice: the resulting clip is too long");
         d->cumSamples.push_back(totalSamples);
     }
@@ -277,17 +305,18 @@ typedef SingleNodeData<AudioLoopDataExtra> AudioLoopData;
 
 static const VSFrame *VS_CC audioLoopGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     AudioLoopData *d = reinterpret_cast<AudioLoopData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
 
-    int64_t reqStart = n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
+    int64_t reqStart = n * static_cast<int64_t>(frameSamples);
     reqStart = reqStart % d->srcSamples;
-    int reqStartFrame = static_cast<int>(reqStart / VS_AUDIO_FRAME_SAMPLES);
+    int reqStartFrame = static_cast<int>(reqStart / frameSamples);
     int reqFrame = reqStartFrame;
-    int reqStartOffset = static_cast<int>(reqStart % VS_AUDIO_FRAME_SAMPLES);
-    int remainingSamples = static_cast<int>(std::min<int64_t>(VS_AUDIO_FRAME_SAMPLES, d->ai.numSamples - n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES)));
+    int reqStartOffset = static_cast<int>(reqStart % frameSamples);
+    int remainingSamples = static_cast<int>(std::min<int64_t>(frameSamples, d->ai.numSamples - n * static_cast<int64_t>(frameSamples)));
 
     if (activationReason == arInitial) {
         do {
-            int reqSamples = static_cast<int>(std::min<int64_t>(VS_AUDIO_FRAME_SAMPLES - reqStartOffset, d->srcSamples - reqStart));
+            int reqSamples = static_cast<int>(std::min<int64_t>(frameSamples - reqStartOffset, d->srcSamples - reqStart));
             reqStartOffset = 0;
             vsapi->requestFrameFilter(reqFrame++, d->node, frameCtx);
             remainingSamples -= reqSamples;
@@ -305,8 +334,14 @@ static const VSFrame *VS_CC audioLoopGetFrame(int n, int activationReason, void
             const VSFrame *src = vsapi->getFrameFilter(reqFrame++, d->node, frameCtx);
             int length = vsapi->getFrameLength(src) - reqStartOffset;
 
-            if (!dst)
+            if (!dst) {
+                // the whole output frame is in one source frame
+                if (length >= remainingSamples) {
+                    if (const VSFrame *range = getAudioRange(src, reqStartOffset, remainingSamples, core, vsapi))
+                        return range;
+                }
                 dst = vsapi->newAudioFrame(&d->ai.format, remainingSamples, src, core);
+            }
 
             for (int p = 0; p < d->ai.format.numChannels; p++)
                 memcpy(vsapi->getWritePtr(dst, p) + dstOffset, vsapi->getReadPtr(src, p) + reqStartOffset * d->ai.format.bytesPerSample, std::min<int>(length, remainingSamples) * d->ai.format.bytesPerSample);
@@ -328,6 +363,7 @@ static const VSFrame *VS_CC audioLoopGetFrame(int n, int activationReason, void
 static void VS_CC audioLoopCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     int error;
     std::unique_ptr<AudioLoopData> d(new AudioLoopData(vsapi));
+    int frameSamples = vsapi->getAudioFrameSamples(core);
     int64_t times = vsapi->mapGetInt(in, "times", 0, &error);
     if (times < 0)
         RETERROR("AudioLoop: cannot repeat clip a negative number of times");
@@ -344,11 +380,11 @@ static void VS_CC audioLoopCreate(const VSMap *in, VSMap *out, void *userData, V
     }
 
     if (times > 0) {
-        if (d->ai.numSamples > (std::numeric_limits<int>::max() * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES)) / times)
+        if (d->ai.numSamples > (std::numeric_limits<int>::max() * static_cast<int64_t>(frameSamples)) / times)
             RETERROR("AudioLoop: resulting clip is too long");
         d->ai.numSamples *= times;
     } else {
-        d->ai.numSamples = std::numeric_limits<int>::max() * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
+        d->ai.numSamples = std::numeric_limits<int>::max() * static_cast<int64_t>(frameSamples);
     }
 
     VSFilterDependency deps[] = {{d->node, rpGeneral}};
@@ -368,19 +404,20 @@ typedef SingleNodeData<AudioReverseDataExtra> AudioReverseData;
 template<typename T>
 static const VSFrame *VS_CC audioReverseGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     AudioReverseData *d = reinterpret_cast<AudioReverseData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
     int n1 = d->ai->numFrames - 1 - n;
     int n2 = std::max(d->ai->numFrames - 2 - n, 0);
 
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n1, d->node, frameCtx);
-        if (d->ai->numSamples % VS_AUDIO_FRAME_SAMPLES != 0)
+        if (d->ai->numSamples % frameSamples != 0)
             vsapi->requestFrameFilter(n2, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        int dstLength = static_cast<int>(std::min<int64_t>(VS_AUDIO_FRAME_SAMPLES, d->ai->numSamples - n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES)));
+        int dstLength = static_cast<int>(std::min<int64_t>(frameSamples, d->ai->numSamples - n * static_cast<int64_t>(frameSamples)));
         const VSFrame *src1 = vsapi->getFrameFilter(n1, d->node, frameCtx);
         size_t l1 = vsapi->getFrameLength(src1);
-        size_t s1offset = l1 - (d->ai->numSamples % VS_AUDIO_FRAME_SAMPLES);
-        if (s1offset == VS_AUDIO_FRAME_SAMPLES)
+        size_t s1offset = l1 - (d->ai->numSamples % frameSamples);
+        if (s1offset == static_cast<size_t>(frameSamples))
             s1offset = 0;
         size_t s1samples = vsapi->getFrameLength(src1) - s1offset;
 
@@ -430,14 +467,51 @@ static void VS_CC audioReverseCreate(const VSMap *in, VSMap *out, void *userData
 //////////////////////////////////////////
 // AudioGain
 
+typedef decltype(&vs_audio_gain_int16_c) AudioGainKernel;
+typedef decltype(&vs_audio_mix_int16_c) AudioMixKernel;
+
+static int audioKernelIndex(const VSAudioFormat &f) {
+    return (f.sampleType == stFloat) ? 2 : (f.bytesPerSample == 2) ? 0 : 1;
+}
+
+static AudioGainKernel selectAudioGainKernel(const VSAudioFormat &f, int cpulevel) {
+    int idx = audioKernelIndex(f);
+#ifdef VS_TARGET_CPU_X86
+    static const AudioGainKernel avx2[] = { vs_audio_gain_int16_avx2, vs_audio_gain_int32_avx2, vs_audio_gain_float_avx2 };
+    static const AudioGainKernel sse2[] = { vs_audio_gain_int16_sse2, vs_audio_gain_int32_sse2, vs_audio_gain_float_sse2 };
+
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
+        return avx2[idx];
+    if (cpulevel >= VS_CPU_LEVEL_SSE2)
+        return sse2[idx];
+#endif
+    static const AudioGainKernel c[] = { vs_audio_gain_int16_c, vs_audio_gain_int32_c, vs_audio_gain_float_c };
+    return c[idx];
+}
+
+static AudioMixKernel selectAudioMixKernel(const VSAudioFormat &f, int cpulevel) {
+    int idx = audioKernelIndex(f);
+#ifdef VS_TARGET_CPU_X86
+    static const AudioMixKernel avx2[] = { vs_audio_mix_int16_avx2, vs_audio_mix_int32_avx2, vs_audio_mix_float_avx2 };
+    static const AudioMixKernel sse2[] = { vs_audio_mix_int16_sse2, vs_audio_mix_int32_sse2, vs_audio_mix_float_sse2 };
+
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
+        return avx2[idx];
+    if (cpulevel >= VS_CPU_LEVEL_SSE2)
+        return sse2[idx];
+#endif
+    static const AudioMixKernel c[] = { vs_audio_mix_int16_c, vs_audio_mix_int32_c, vs_audio_mix_float_c };
+    return c[idx];
+}
+
 struct AudioGainDataExtra {
     std::vector<double> gain;
     const VSAudioInfo *ai;
+    AudioGainKernel kernel;
 };
 
 typedef SingleNodeData<AudioGainDataExtra> AudioGainData;
 
-template<typename T>
 static const VSFrame *VS_CC audioGainGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     AudioGainData *d = reinterpret_cast<AudioGainData *>(instanceData);
 
@@ -450,10 +524,7 @@ static const VSFrame *VS_CC audioGainGetFrame(int n, int activationReason, void
 
         for (int p = 0; p < d->ai->format.numChannels; p++) {
             double gain = d->gain[(d->gain.size() > 1) ? p : 0];
-            const T *srcPtr = reinterpret_cast<const T *>(vsapi->getReadPtr(src, p));
-            T *dstPtr = reinterpret_cast<T *>(vsapi->getWritePtr(dst, p));
-            for (int i = 0; i < length; i++)
-                dstPtr[i] = static_cast<T>(srcPtr[i] * gain);
+            d->kernel(vsapi->getReadPtr(src, p), vsapi->getWritePtr(dst, p), gain, length);
         }
 
         vsapi->freeFrame(src);
@@ -475,19 +546,18 @@ static void VS_CC audioGainCreate(const VSMap *in, VSMap *out, void *userData, V
     if (numGainValues != 1 && numGainValues != d->ai->format.numChannels)
         RETERROR("AudioGain: must provide one gain value per channel or a single value used for all channels");
 
+    d->kernel = selectAudioGainKernel(d->ai->format, vs_get_cpulevel(core));
+
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    if (d->ai->format.bytesPerSample == 4 && d->ai->format.sampleType == stFloat)
-        vsapi->createAudioFilter(out, "AudioGain", d->ai, audioGainGetFrame<float>, filterFree<AudioGainData>, fmParallel, deps, 1, d.get(), core);
-    else if (d->ai->format.bytesPerSample == 2)
-        vsapi->createAudioFilter(out, "AudioGain", d->ai, audioGainGetFrame<int16_t>, filterFree<AudioGainData>, fmParallel, deps, 1, d.get(), core);
-    else
-        vsapi->createAudioFilter(out, "AudioGain", d->ai, audioGainGetFrame<int32_t>, filterFree<AudioGainData>, fmParallel, deps, 1, d.get(), core);
+    vsapi->createAudioFilter(out, "AudioGain", d->ai, audioGainGetFrame, filterFree<AudioGainData>, fmParallel, deps, 1, d.get(), core);
     d.release();
 }
 
 //////////////////////////////////////////
 // AudioMix
 
+static bool getShuffleChannelsSource(VSNode *node, int idx, VSNode *&source, int &sourceIdx, const VSAPI *vsapi);
+
 struct AudioMixDataNode {
     VSNode *node;
     int idx;
@@ -498,44 +568,63 @@ struct AudioMixDataNode {
 struct AudioMixData {
     std::vector<VSNode *> reqNodes; // a list of all distinct nodes in sourceNodes to reduce function calls
     std::vector<AudioMixDataNode> sourceNodes;
+    std::vector<bool> sourceUsed; // the first source is always fetched since the frame properties and length come from it
     std::vector<int> outputIdx;
+    std::vector<std::vector<int>> outputSources; // the sources with a non-zero weight for each output channel
+    std::vector<std::vector<double>> outputWeights; // and their weights
+    std::vector<int> outputRoute; // the source copied unchanged to each output channel, -1 when it has to be mixed
+    bool passthrough; // the output is the frames of the only source node with all channels in place
     VSAudioInfo ai;
+    AudioMixKernel kernel;
 };
 
-template<typename T>
 static const VSFrame *VS_CC audioMixGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     AudioMixData *d = reinterpret_cast<AudioMixData *>(instanceData);
 
     if (activationReason == arInitial) {
         for (const auto &iter : d->reqNodes)
             vsapi->requestFrameFilter(n, iter, frameCtx);
-    } else if (activationReason == arAllFramesReady) {     
+    } else if (activationReason == arAllFramesReady) {
+        if (d->passthrough)
+            return vsapi->getFrameFilter(n, d->reqNodes[0], frameCtx);
+
         int numOutChannels = d->ai.format.numChannels;
-        std::vector<const T *> srcPtrs;
-        std::vector<const VSFrame *> srcFrames;
-        srcPtrs.reserve(d->sourceNodes.size());
-        srcFrames.reserve(d->sourceNodes.size());
+        std::vector<const void *> srcPtrs(d->sourceNodes.size());
+        std::vector<const VSFrame *> srcFrames(d->sourceNodes.size());
         for (size_t idx = 0; idx < d->sourceNodes.size(); idx++) {
-            const VSFrame *src = vsapi->getFrameFilter(n, d->sourceNodes[idx].node, frameCtx);                
-            srcPtrs.push_back(reinterpret_cast<const T *>(vsapi->getReadPtr(src, d->sourceNodes[idx].idx)));
-            srcFrames.push_back(src);
+            if (!d->sourceUsed[idx])
+                continue;
+            srcFrames[idx] = vsapi->getFrameFilter(n, d->sourceNodes[idx].node, frameCtx);
+            srcPtrs[idx] = vsapi->getReadPtr(srcFrames[idx], d->sourceNodes[idx].idx);
         }
 
-        int srcLength = vsapi->getFrameLength(srcFrames[0]);
-        VSFrame *dst = vsapi->newAudioFrame(&d->ai.format, srcLength, srcFrames[0], core);
-
-        std::vector<T *> dstPtrs;
-        dstPtrs.resize(numOutChannels);
-        for (int idx = 0; idx < numOutChannels; idx++)
-            dstPtrs[idx] = reinterpret_cast<T *>(vsapi->getWritePtr(dst, d->outputIdx[idx]));
-
-        for (int i = 0; i < srcLength; i++) {
-            for (size_t dstIdx = 0; dstIdx < static_cast<size_t>(numOutChannels); dstIdx++) {
-                double tmp = 0;
-                for (size_t srcIdx = 0; srcIdx < srcPtrs.size(); srcIdx++)
-                    tmp += static_cast<double>(srcPtrs[srcIdx][i]) * d->sourceNodes[srcIdx].weights[dstIdx];
+        // routed channels are filled in when the frame is created
+        std::vector<const VSFrame *> channelSrc(numOutChannels);
+        std::vector<int> channels(numOutChannels);
+        for (int dstIdx = 0; dstIdx < numOutChannels; dstIdx++) {
+            int route = d->outputRoute[dstIdx];
+            if (route >= 0) {
+                channelSrc[d->outputIdx[dstIdx]] = srcFrames[route];
+                channels[d->outputIdx[dstIdx]] = d->sourceNodes[route].idx;
+            }
+        }
 
-                dstPtrs[dstIdx][i] = static_cast<T>(tmp);
+        int srcLength = vsapi->getFrameLength(srcFrames[0]);
+        VSFrame *dst = vsapi->newAudioFrame2(&d->ai.format, srcLength, channelSrc.data(), channels.data(), srcFrames[0], core);
+
+        std::vector<const void *> mixPtrs;
+        for (int dstIdx = 0; dstIdx < numOutChannels; dstIdx++) {
+            if (d->outputRoute[dstIdx] >= 0)
+                continue;
+            uint8_t *dstp = vsapi->getWritePtr(dst, d->outputIdx[dstIdx]);
+            const std::vector<int> &sources = d->outputSources[dstIdx];
+            if (sources.empty()) {
+                memset(dstp, 0, srcLength * d->ai.format.bytesPerSample);
+            } else {
+                mixPtrs.clear();
+                for (int src : sources)
+                    mixPtrs.push_back(srcPtrs[src]);
+                d->kernel(mixPtrs.data(), d->outputWeights[dstIdx].data(), static_cast<unsigned>(mixPtrs.size()), dstp, srcLength);
             }
         }
 
@@ -628,21 +717,59 @@ static void VS_CC audioMixCreate(const VSMap *in, VSMap *out, void *userData, VS
         return;
     }
 
+    // a channel taken from ShuffleChannels or SplitChannels can be read from its source directly as long as the source
+    // isn't zero extended, the first source also decides the frame properties so it has to stay the shuffle's first channel
+    for (size_t i = 0; i < d->sourceNodes.size(); i++) {
+        AudioMixDataNode &src = d->sourceNodes[i];
+        VSNode *shuffleSource;
+        int shuffleIdx;
+        while ((i > 0 || src.idx == 0) && getShuffleChannelsSource(src.node, src.idx, shuffleSource, shuffleIdx, vsapi)) {
+            shuffleSource = vsapi->addNodeRef(shuffleSource);
+            vsapi->freeNode(src.node);
+            src.node = shuffleSource;
+            src.idx = shuffleIdx;
+            src.numFrames = vsapi->getAudioInfo(shuffleSource)->numFrames;
+        }
+    }
+
+    // zero weights are skipped and an output channel that's a single source with a weight of one is only copied
+    d->sourceUsed.resize(d->sourceNodes.size());
+    d->sourceUsed[0] = true;
+    d->outputSources.resize(numDstChannels);
+    d->outputWeights.resize(numDstChannels);
+    d->outputRoute.resize(numDstChannels, -1);
+    for (int j = 0; j < numDstChannels; j++) {
+        for (size_t i = 0; i < d->sourceNodes.size(); i++) {
+            if (d->sourceNodes[i].weights[j] != 0) {
+                d->outputSources[j].push_back(static_cast<int>(i));
+                d->outputWeights[j].push_back(d->sourceNodes[i].weights[j]);
+                d->sourceUsed[i] = true;
+            }
+        }
+        if (d->outputSources[j].size() == 1 && d->outputWeights[j][0] == 1)
+            d->outputRoute[j] = d->outputSources[j][0];
+    }
+
     std::set<VSNode *> nodeSet;
-    for (const auto &iter : d->sourceNodes)
-        nodeSet.insert(iter.node);
+    for (size_t i = 0; i < d->sourceNodes.size(); i++)
+        if (d->sourceUsed[i])
+            nodeSet.insert(d->sourceNodes[i].node);
     for (const auto &iter : nodeSet)
         d->reqNodes.push_back(iter);
 
+    // routing every channel of a clip to the same place in the same layout leaves its frames unchanged
+    d->passthrough = (d->reqNodes.size() == 1 && vsapi->getAudioInfo(d->reqNodes[0])->format.channelLayout == d->ai.format.channelLayout);
+    for (int j = 0; j < numDstChannels && d->passthrough; j++) {
+        int route = d->outputRoute[j];
+        d->passthrough = (route >= 0 && d->sourceNodes[route].idx == d->outputIdx[j]);
+    }
+
+    d->kernel = selectAudioMixKernel(d->ai.format, vs_get_cpulevel(core));
+
     std::vector<VSFilterDependency> deps;
     for (const auto &iter : d->reqNodes)
         deps.push_back({iter, rpStrictSpatial});
-    if (d->ai.format.sampleType == stFloat)
-        vsapi->createAudioFilter(out, "AudioMix", &d->ai, audioMixGetFrame<float>, audioMixFree, fmParallel, deps.data(), static_cast<int>(deps.size()), d.get(), core);
-    else if (d->ai.format.bytesPerSample == 2)
-        vsapi->createAudioFilter(out, "AudioMix", &d->ai, audioMixGetFrame<int16_t>, audioMixFree, fmParallel, deps.data(), static_cast<int>(deps.size()), d.get(), core);
-    else
-        vsapi->createAudioFilter(out, "AudioMix", &d->ai, audioMixGetFrame<int32_t>, audioMixFree, fmParallel, deps.data(), static_cast<int>(deps.size()), d.get(), core);
+    vsapi->createAudioFilter(out, "AudioMix", &d->ai, audioMixGetFrame, audioMixFree, fmParallel, deps.data(), static_cast<int>(deps.size()), d.get(), core);
     d.release();
 }
 
@@ -668,13 +795,14 @@ struct ShuffleChannelsData {
 
 static const VSFrame *VS_CC shuffleChannelsGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     ShuffleChannelsData *d = reinterpret_cast<ShuffleChannelsData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
 
     if (activationReason == arInitial) {
         for (const auto &iter : d->reqNodes)
             vsapi->requestFrameFilter(n, iter, frameCtx);
     } else if (activationReason == arAllFramesReady) {
         VSFrame *dst = nullptr;
-        int dstLength = static_cast<int>(std::min<int64_t>(d->ai.numSamples - n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES), VS_AUDIO_FRAME_SAMPLES));
+        int dstLength = static_cast<int>(std::min<int64_t>(d->ai.numSamples - n * static_cast<int64_t>(frameSamples), frameSamples));
         for (int idx = 0; idx < static_cast<int>(d->sourceNodes.size()); idx++) {
             const VSFrame *src = vsapi->getFrameFilter(n, d->sourceNodes[idx].node, frameCtx);;
             int srcLength = (n < d->sourceNodes[idx].numFrames) ? vsapi->getFrameLength(src) : 0;
@@ -784,6 +912,16 @@ static void VS_CC shuffleChannelsCreate(const VSMap *in, VSMap *out, void *userD
     d.release();
 }
 
+// Returns where channel idx of a ShuffleChannels node comes from if its source isn't zero extended
+static bool getShuffleChannelsSource(VSNode *node, int idx, VSNode *&source, int &sourceIdx, const VSAPI *vsapi) {
+    const ShuffleChannelsData *d = reinterpret_cast<const ShuffleChannelsData *>(vs_get_filter_instance_data(node, shuffleChannelsGetFrame));
+    if (!d || vsapi->getAudioInfo(d->sourceNodes[idx].node)->numSamples != d->ai.numSamples)
+        return false;
+    source = d->sourceNodes[idx].node;
+    sourceIdx = d->sourceNodes[idx].idx;
+    return true;
+}
+
 //////////////////////////////////////////
 // SplitChannels
 
@@ -816,6 +954,222 @@ static void VS_CC splitChannelsCreate(const VSMap *in, VSMap *out, void *userDat
     vsapi->freeMap(map);
 }
 
+//////////////////////////////////////////
+// AudioResample
+
+typedef decltype(&vs_audio_resample_c) AudioResampleKernel;
+
+static AudioResampleKernel selectAudioResampleKernel(int cpulevel) {
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && getCPUFeatures()->fma3 && cpulevel >= VS_CPU_LEVEL_AVX2)
+        return vs_audio_resample_avx2;
+#endif
+    return vs_audio_resample_c;
+}
+
+// Ratios with more output positions per input sample than this share a quantized coefficient table
+static const int64_t resampleMaxTablePhases = 4096;
+// Number of sinc zero crossings on each side of the center, widened when downsampling
+static const int resampleZeroCrossings = 16;
+static const double resampleKaiserBeta = 9.0;
+static const double resampleRolloff = 0.95;
+
+struct AudioResampleDataExtra {
+    VSAudioInfo ai;
+    int64_t srcNumSamples;
+    int64_t num; // num output samples are produced for every den input samples
+    int64_t den;
+    int taps;
+    int tablePhases;
+    std::vector<float> coeffs;
+    AudioResampleKernel kernel;
+};
+
+typedef SingleNodeData<AudioResampleDataExtra> AudioResampleData;
+
+static double besselI0(double x) {
+    double sum = 1;
+    double term = 1;
+    for (int k = 1; k < 100 && term > sum * 1e-17; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static int64_t greatestCommonDivisor(int64_t a, int64_t b) {
+    while (b) {
+        int64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Builds tablePhases + 1 rows of Kaiser windowed sinc coefficients, row r is for an output position
+// r / tablePhases of the way between the input samples half - 1 and half of the window
+static void buildResampleTable(AudioResampleData *d) {
+    double cutoff = std::min<double>(1.0, static_cast<double>(d->num) / d->den) * resampleRolloff;
+    int half = static_cast<int>(std::ceil(resampleZeroCrossings / cutoff));
+    d->taps = (2 * half + 7) & ~7;
+    half = d->taps / 2;
+    d->tablePhases = static_cast<int>(std::min(d->num, resampleMaxTablePhases));
+    d->coeffs.resize((d->tablePhases + 1) * static_cast<size_t>(d->taps));
+
+    const double pi = 3.14159265358979323846;
+    double windowScale = 1 / besselI0(resampleKaiserBeta);
+
+    for (int r = 0; r <= d->tablePhases; r++) {
+        float *row = d->coeffs.data() + r * static_cast<size_t>(d->taps);
+        double frac = static_cast<double>(r) / d->tablePhases;
+        std::vector<double> h(d->taps);
+        double sum = 0;
+
+        for (int k = 0; k < d->taps; k++) {
+            double x = frac + (half - 1) - k;
+            double t = x / half;
+            if (std::abs(t) >= 1)
+                continue;
+            double sinc = (x == 0) ? 1 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+            h[k] = cutoff * sinc * besselI0(resampleKaiserBeta * std::sqrt(1 - t * t)) * windowScale;
+            sum += h[k];
+        }
+
+        // Unity gain at DC for every phase
+        for (int k = 0; k < d->taps; k++)
+            row[k] = static_cast<float>(h[k] / sum);
+    }
+}
+
+// The input sample at or before output sample n, the filter is centered on it so the delay is always zero
+static int64_t resampleInputPosition(const AudioResampleData *d, int64_t n, unsigned &phase) {
+    int64_t rem = (n % d->num) * d->den;
+    phase = static_cast<unsigned>(rem % d->num);
+    return (n / d->num) * d->den + rem / d->num;
+}
+
+template<typename T>
+static inline T resampleStore(float x) {
+    double v = std::round(static_cast<double>(x));
+    return static_cast<T>(std::min<double>(std::max<double>(v, std::numeric_limits<T>::min()), std::numeric_limits<T>::max()));
+}
+
+template<>
+inline float resampleStore<float>(float x) {
+    return x;
+}
+
+template<typename T>
+static const VSFrame *VS_CC audioResampleGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    AudioResampleData *d = reinterpret_cast<AudioResampleData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
+    int64_t startSample = n * static_cast<int64_t>(frameSamples);
+    int length = static_cast<int>(std::min<int64_t>(frameSamples, d->ai.numSamples - startSample));
+    int half = d->taps / 2;
+
+    unsigned phase, lastPhase;
+    int64_t firstInput = resampleInputPosition(d, startSample, phase) - (half - 1);
+    int64_t lastInput = resampleInputPosition(d, startSample + length - 1, lastPhase) + half;
+    int firstFrame = static_cast<int>(std::max<int64_t>(firstInput, 0) / frameSamples);
+    int lastFrame = static_cast<int>(std::min(lastInput, d->srcNumSamples - 1) / frameSamples);
+
+    if (activationReason == arInitial) {
+        for (int i = firstFrame; i <= lastFrame; i++)
+            vsapi->requestFrameFilter(i, d->node, frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        int numChannels = d->ai.format.numChannels;
+        size_t bufferLength = static_cast<size_t>(lastInput - firstInput + 1);
+        // Samples outside of the clip are zero
+        std::vector<float> input(bufferLength * numChannels);
+        std::vector<float> output(static_cast<size_t>(length) * numChannels);
+        std::vector<const float *> srcs(numChannels);
+        std::vector<float *> dsts(numChannels);
+        const VSFrame *propSrc = nullptr;
+
+        for (int i = firstFrame; i <= lastFrame; i++) {
+            const VSFrame *src = vsapi->getFrameFilter(i, d->node, frameCtx);
+            int64_t frameStart = i * static_cast<int64_t>(frameSamples);
+            int64_t copyStart = std::max(frameStart, firstInput);
+            int64_t copyEnd = std::min(frameStart + vsapi->getFrameLength(src), lastInput + 1);
+
+            for (int p = 0; p < numChannels; p++) {
+                const T *srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, p)) + (copyStart - frameStart);
+                float *dstp = input.data() + p * bufferLength + (copyStart - firstInput);
+                for (int64_t j = 0; j < copyEnd - copyStart; j++)
+                    dstp[j] = static_cast<float>(srcp[j]);
+            }
+
+            if (i == firstFrame)
+                propSrc = src;
+            else
+                vsapi->freeFrame(src);
+        }
+
+        for (int p = 0; p < numChannels; p++) {
+            srcs[p] = input.data() + p * bufferLength;
+            dsts[p] = output.data() + p * static_cast<size_t>(length);
+        }
+
+        d->kernel(srcs.data(), dsts.data(), numChannels, length, d->coeffs.data(), d->taps, d->tablePhases, phase, static_cast<unsigned>(d->num), static_cast<unsigned>(d->den));
+
+        VSFrame *dst = vsapi->newAudioFrame(&d->ai.format, length, propSrc, core);
+        vsapi->freeFrame(propSrc);
+
+        for (int p = 0; p < numChannels; p++) {
+            T *dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, p));
+            for (int j = 0; j < length; j++)
+                dstp[j] = resampleStore<T>(dsts[p][j]);
+        }
+
+        return dst;
+    }
+
+    return nullptr;
+}
+
+static void VS_CC audioResampleCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    std::unique_ptr<AudioResampleData> d(new AudioResampleData(vsapi));
+
+    d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
+    d->ai = *vsapi->getAudioInfo(d->node);
+    d->srcNumSamples = d->ai.numSamples;
+
+    int sampleRate = vsapi->mapGetIntSaturated(in, "samplerate", 0, nullptr);
+    if (sampleRate < 1)
+        RETERROR("AudioResample: invalid samplerate specified");
+
+    // early termination for the trivial case
+    if (sampleRate == d->ai.sampleRate) {
+        vsapi->mapSetNode(out, "clip", d->node, maReplace);
+        return;
+    }
+
+    int64_t g = greatestCommonDivisor(sampleRate, d->ai.sampleRate);
+    d->num = sampleRate / g;
+    d->den = d->ai.sampleRate / g;
+
+    int frameSamples = vsapi->getAudioFrameSamples(core);
+    int64_t maxSamples = std::numeric_limits<int>::max() * static_cast<int64_t>(frameSamples);
+    if (d->srcNumSamples / d->den > maxSamples / d->num)
+        RETERROR("AudioResample: resulting clip is too long");
+    d->ai.numSamples = (d->srcNumSamples / d->den) * d->num + ((d->srcNumSamples % d->den) * d->num + d->den - 1) / d->den;
+    if (d->ai.numSamples > maxSamples)
+        RETERROR("AudioResample: resulting clip is too long");
+    d->ai.sampleRate = sampleRate;
+
+    buildResampleTable(d.get());
+    d->kernel = selectAudioResampleKernel(vs_get_cpulevel(core));
+
+    VSFilterDependency deps[] = {{d->node, rpGeneral}};
+    if (d->ai.format.sampleType == stFloat)
+        vsapi->createAudioFilter(out, "AudioResample", &d->ai, audioResampleGetFrame<float>, filterFree<AudioResampleData>, fmParallel, deps, 1, d.get(), core);
+    else if (d->ai.format.bytesPerSample == 2)
+        vsapi->createAudioFilter(out, "AudioResample", &d->ai, audioResampleGetFrame<int16_t>, filterFree<AudioResampleData>, fmParallel, deps, 1, d.get(), core);
+    else
+        vsapi->createAudioFilter(out, "AudioResample", &d->ai, audioResampleGetFrame<int32_t>, filterFree<AudioResampleData>, fmParallel, deps, 1, d.get(), core);
+    d.release();
+}
+
 //////////////////////////////////////////
 // AssumeSampleRate
 
@@ -876,11 +1230,12 @@ typedef struct {
 
 static const VSFrame *VS_CC blankAudioGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     BlankAudioData *d = reinterpret_cast<BlankAudioData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
 
     if (activationReason == arInitial) {
         VSFrame *frame = nullptr;
         if (!d->f) {
-            int samples = static_cast<int>(std::min<int64_t>(VS_AUDIO_FRAME_SAMPLES, d->ai.numSamples - n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES)));
+            int samples = static_cast<int>(std::min<int64_t>(frameSamples, d->ai.numSamples - n * static_cast<int64_t>(frameSamples)));
             frame = vsapi->newAudioFrame(&d->ai.format, samples, nullptr, core);
             for (int channel = 0; channel < d->ai.format.numChannels; channel++)
                 memset(vsapi->getWritePtr(frame, channel), 0, samples * d->ai.format.bytesPerSample);
@@ -989,10 +1344,11 @@ typedef struct {
 
 static const VSFrame *VS_CC testAudioGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     TestAudioData *d = reinterpret_cast<TestAudioData *>(instanceData);
+    int frameSamples = vsapi->getAudioFrameSamples(core);
 
     if (activationReason == arInitial) {
-        int64_t startSample = n * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
-        int samples = static_cast<int>(std::min<int64_t>(VS_AUDIO_FRAME_SAMPLES, d->ai.numSamples - startSample));
+        int64_t startSample = n * static_cast<int64_t>(frameSamples);
+        int samples = static_cast<int>(std::min<int64_t>(frameSamples, d->ai.numSamples - startSample));
         VSFrame *frame = vsapi->newAudioFrame(&d->ai.format, samples, nullptr, core);
         for (int channel = 0; channel < d->ai.format.numChannels; channel++) {
             uint16_t *w = reinterpret_cast<uint16_t *>(vsapi->getWritePtr(frame, channel));
@@ -1056,6 +1412,7 @@ void VS_CC audioInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->registerFunction("AudioMix", "clips:anode[];matrix:float[];channels_out:int[];", "clip:anode;", audioMixCreate, 0, plugin);
     vspapi->registerFunction("ShuffleChannels", "clip:anode[];channels_in:int[];channels_out:int[];", "clip:anode;", shuffleChannelsCreate, 0, plugin);
     vspapi->registerFunction("SplitChannels", "clip:anode;", "clip:anode[];", splitChannelsCreate, 0, plugin);
+    vspapi->registerFunction("AudioResample", "clip:anode;samplerate:int;", "clip:anode;", audioResampleCreate, 0, plugin);
     vspapi->registerFunction("AssumeSampleRate", "clip:anode;src:anode:opt;samplerate:int:opt;", "clip:anode;", assumeSampleRateCreate, 0, plugin);
     vspapi->registerFunction("BlankAudio", "clip:anode:opt;channels:int:opt;bits:int:opt;sampletype:int:opt;samplerate:int:opt;length:int:opt;keep:int:opt;", "clip:anode;", blankAudioCreate, 0, plugin);
     vspapi->registerFunction("TestAudio", "channels:int:opt;bits:int:opt;isfloat:int:opt;samplerate:int:opt;length:int:opt;", "clip:anode;", testAudioCreate, 0, plugin);
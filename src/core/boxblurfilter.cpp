@@ -26,6 +26,13 @@
 #include "internalfilters.h"
 #include "VSHelper4.h"
 #include "filtershared.h"
+#include "kernel/cpulevel.h"
+#include "kernel/boxblur.h"
+#include "kernel/transpose.h"
+
+#ifdef VS_TARGET_CPU_X86
+#include "cpufeatures.h"
+#endif
 
 namespace {
 std::string operator""_s(const char *str, size_t len) { return{ str, len }; }
@@ -37,8 +44,72 @@ std::string operator""_s(const char *str, size_t len) { return{ str, len }; }
 struct BoxBlurData {
     VSNode *node;
     int radius, passes;
+    bool vertical;
+    int cpulevel;
 };
 
+typedef decltype(&vs_boxblur_v_byte_c) BoxBlurVFunc;
+typedef decltype(&vs_transpose_plane_byte_c) TransposeFunc;
+
+static BoxBlurVFunc selectBoxBlurV(int bytesPerSample, int cpulevel) {
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        switch (bytesPerSample) {
+        case 1: return vs_boxblur_v_byte_avx2;
+        case 2: return vs_boxblur_v_word_avx2;
+        case 4: return vs_boxblur_v_float_avx2;
+        }
+    }
+    if (cpulevel >= VS_CPU_LEVEL_SSE2) {
+        switch (bytesPerSample) {
+        case 1: return vs_boxblur_v_byte_sse2;
+        case 2: return vs_boxblur_v_word_sse2;
+        case 4: return vs_boxblur_v_float_sse2;
+        }
+    }
+#endif
+    switch (bytesPerSample) {
+    case 1: return vs_boxblur_v_byte_c;
+    case 2: return vs_boxblur_v_word_c;
+    default: return vs_boxblur_v_float_c;
+    }
+}
+
+// Runs all passes down the columns. The first pass rounds up and the following ones alternate like the horizontal version.
+static void processPlaneV(BoxBlurVFunc func, const uint8_t *src, uint8_t *dst, ptrdiff_t stride, int width, int height, int passes, int radius, uint8_t *tmp, void *acc) {
+    const unsigned round = radius * 2;
+    uint8_t *dst1 = (passes & 1) ? dst : tmp;
+    uint8_t *dst2 = (passes & 1) ? tmp : dst;
+    func(src, stride, dst1, stride, acc, width, height, radius, round);
+    for (int p = 1; p < passes; p++) {
+        func(dst1, stride, dst2, stride, acc, width, height, radius, (p & 1) ? 0 : round);
+        std::swap(dst1, dst2);
+    }
+}
+
+#ifdef VS_TARGET_CPU_X86
+// Number of rows blurred at once by the horizontal vector path.
+static const int HStripRows = 32;
+
+// Transposes strips of rows so every row becomes a lane and the running sum can be done for all of them at once by the vertical kernel.
+static void processPlaneHStrips(BoxBlurVFunc func, TransposeFunc transpose, int bytesPerSample, const uint8_t *src, uint8_t *dst, ptrdiff_t stride, int width, int height, int passes, int radius, uint8_t *buf1, uint8_t *buf2, void *acc) {
+    const unsigned round = radius * 2;
+    const ptrdiff_t bufStride = HStripRows * bytesPerSample;
+
+    for (int y = 0; y < height; y += HStripRows) {
+        int rows = std::min(HStripRows, height - y);
+        uint8_t *b1 = buf1;
+        uint8_t *b2 = buf2;
+        transpose(src + y * stride, stride, b1, bufStride, width, rows);
+        for (int p = 0; p < passes; p++) {
+            func(b1, bufStride, b2, bufStride, acc, rows, width, radius, (p & 1) ? 0 : round);
+            std::swap(b1, b2);
+        }
+        transpose(b1, bufStride, dst + y * stride, stride, rows, width);
+    }
+}
+#endif
+
 template<typename T>
 static void blurH(const T * VS_RESTRICT src, T * VS_RESTRICT dst, const int width, const int radius, const unsigned div, const unsigned round) {
     unsigned acc = radius * src[0];
@@ -243,7 +314,6 @@ static const VSFrame *VS_CC boxBlurGetframe(int n, int activationReason, void *i
         VSFrame *dst = vsapi->newVideoFrame(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), src, core);
         int bytesPerSample = fi->bytesPerSample;
         int radius = d->radius;
-        uint8_t *tmp = (radius > 1 && d->passes > 1) ? new uint8_t[bytesPerSample * vsapi->getFrameWidth(src, 0)] : nullptr;
 
         const uint8_t *srcp = vsapi->getReadPtr(src, 0);
         ptrdiff_t stride = vsapi->getStride(src, 0);
@@ -251,7 +321,25 @@ static const VSFrame *VS_CC boxBlurGetframe(int n, int activationReason, void *i
         int h = vsapi->getFrameHeight(src, 0);
         int w = vsapi->getFrameWidth(src, 0);
 
-        if (radius == 1) {
+        if (d->vertical) {
+            BoxBlurVFunc func = selectBoxBlurV(bytesPerSample, d->cpulevel);
+            uint8_t *tmp = (d->passes > 1) ? static_cast<uint8_t *>(vsapi->allocScratchMemory(stride * h, core)) : nullptr;
+            void *acc = vsapi->allocScratchMemory(sizeof(uint32_t) * w, core);
+            processPlaneV(func, srcp, dstp, stride, w, h, d->passes, radius, tmp, acc);
+#ifdef VS_TARGET_CPU_X86
+        } else if (d->cpulevel >= VS_CPU_LEVEL_SSE2) {
+            BoxBlurVFunc func = selectBoxBlurV(bytesPerSample, d->cpulevel);
+            TransposeFunc transpose;
+            if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2)
+                transpose = (bytesPerSample == 1) ? vs_transpose_plane_byte_avx2 : (bytesPerSample == 2) ? vs_transpose_plane_word_avx2 : vs_transpose_plane_dword_avx2;
+            else
+                transpose = (bytesPerSample == 1) ? vs_transpose_plane_byte_sse2 : (bytesPerSample == 2) ? vs_transpose_plane_word_sse2 : vs_transpose_plane_dword_sse2;
+            size_t bufSize = static_cast<size_t>(HStripRows) * bytesPerSample * w;
+            uint8_t *buf1 = static_cast<uint8_t *>(vsapi->allocScratchMemory(bufSize * 2, core));
+            void *acc = vsapi->allocScratchMemory(sizeof(uint32_t) * HStripRows, core);
+            processPlaneHStrips(func, transpose, bytesPerSample, srcp, dstp, stride, w, h, d->passes, radius, buf1, buf1 + bufSize, acc);
+#endif
+        } else if (radius == 1) {
             if (bytesPerSample == 1)
                 processPlaneR1<uint8_t>(srcp, dstp, stride, w, h, d->passes);
             else if (bytesPerSample == 2)
@@ -259,6 +347,7 @@ static const VSFrame *VS_CC boxBlurGetframe(int n, int activationReason, void *i
             else
                 processPlaneR1F<float>(srcp, dstp, stride, w, h, d->passes);
         } else {
+            uint8_t *tmp = (d->passes > 1) ? static_cast<uint8_t *>(vsapi->allocScratchMemory(bytesPerSample * w, core)) : nullptr;
             if (bytesPerSample == 1)
                 processPlane<uint8_t>(srcp, dstp, stride, w, h, d->passes, radius, tmp);
             else if (bytesPerSample == 2)
@@ -267,8 +356,6 @@ static const VSFrame *VS_CC boxBlurGetframe(int n, int activationReason, void *i
                 processPlaneF<float>(srcp, dstp, stride, w, h, d->passes, radius, tmp);
         }
 
-        delete[] tmp;
-
         vsapi->freeFrame(src);
         return dst;
     }
@@ -282,29 +369,19 @@ static void VS_CC boxBlurFree(void *instanceData, VSCore *core, const VSAPI *vsa
     delete d;
 }
 
-static VSNode *applyBoxBlurPlaneFiltering(VSPlugin *stdplugin, VSNode *node, int hradius, int hpasses, int vradius, int vpasses, VSCore *core, const VSAPI *vsapi) {
+static VSNode *applyBoxBlurPlaneFiltering(VSNode *node, int hradius, int hpasses, int vradius, int vpasses, VSCore *core, const VSAPI *vsapi) {
     bool hblur = (hradius > 0) && (hpasses > 0);
     bool vblur = (vradius > 0) && (vpasses > 0);
+    int cpulevel = vs_get_cpulevel(core);
 
     if (hblur) {
         VSFilterDependency deps[] = {{node, rpStrictSpatial}};
-        node = vsapi->createVideoFilter2("BoxBlur", vsapi->getVideoInfo(node), boxBlurGetframe, boxBlurFree, fmParallel, deps, 1, new BoxBlurData{node, hradius, hpasses}, core);
+        node = vsapi->createVideoFilter2("BoxBlur", vsapi->getVideoInfo(node), boxBlurGetframe, boxBlurFree, fmParallel, deps, 1, new BoxBlurData{node, hradius, hpasses, false, cpulevel}, core);
     }
 
     if (vblur) {
-        VSMap *vtmp1 = vsapi->createMap();
-        vsapi->mapConsumeNode(vtmp1, "clip", node, maAppend);
-        VSMap *vtmp2 = vsapi->invoke(stdplugin, "Transpose", vtmp1);
-        vsapi->clearMap(vtmp1);
-        node = vsapi->mapGetNode(vtmp2, "clip", 0, nullptr);
-        vsapi->clearMap(vtmp2);
         VSFilterDependency deps[] = {{node, rpStrictSpatial}};
-        vsapi->createVideoFilter(vtmp2, "BoxBlur", vsapi->getVideoInfo(node), boxBlurGetframe, boxBlurFree, fmParallel, deps, 1, new BoxBlurData{ node, vradius, vpasses }, core);
-        vsapi->freeMap(vtmp1);
-        vtmp1 = vsapi->invoke(stdplugin, "Transpose", vtmp2);
-        vsapi->freeMap(vtmp2);
-        node = vsapi->mapGetNode(vtmp1, "clip", 0, nullptr);
-        vsapi->freeMap(vtmp1);
+        node = vsapi->createVideoFilter2("BoxBlur", vsapi->getVideoInfo(node), boxBlurGetframe, boxBlurFree, fmParallel, deps, 1, new BoxBlurData{node, vradius, vpasses, true, cpulevel}, core);
     }
 
     return node;
@@ -354,7 +431,7 @@ static void VS_CC boxBlurCreate(const VSMap *in, VSMap *out, void *userData, VSC
         VSPlugin *stdplugin = vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core);
 
         if (vi->format.numPlanes == 1) {
-            VSNode *tmpnode = applyBoxBlurPlaneFiltering(stdplugin, node, hradius, hpasses, vradius, vpasses, core, vsapi);
+            VSNode *tmpnode = applyBoxBlurPlaneFiltering(node, hradius, hpasses, vradius, vpasses, core, vsapi);
             node = nullptr;
             vsapi->mapSetNode(out, "clip", tmpnode, maAppend);
             vsapi->freeNode(tmpnode);
@@ -374,7 +451,7 @@ static void VS_CC boxBlurCreate(const VSMap *in, VSMap *out, void *userData, VSC
                     vsapi->freeMap(vtmp1);
                     VSNode *tmpnode = vsapi->mapGetNode(vtmp2, "clip", 0, nullptr);
                     vsapi->freeMap(vtmp2);
-                    tmpnode = applyBoxBlurPlaneFiltering(stdplugin, tmpnode, hradius, hpasses, vradius, vpasses, core, vsapi);
+                    tmpnode = applyBoxBlurPlaneFiltering(tmpnode, hradius, hpasses, vradius, vpasses, core, vsapi);
                     vsapi->mapConsumeNode(mergeargs, "clips", tmpnode, maAppend);
                 } else {
                     vsapi->mapSetNode(mergeargs, "clips", node, maAppend);
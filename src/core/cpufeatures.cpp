@@ -102,6 +102,12 @@ static void doGetCPUFeatures(CPUFeatures *cpuFeatures) {
         }
     }
 }
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+static void doGetCPUFeatures(CPUFeatures *cpuFeatures) {
+    memset(cpuFeatures, 0, sizeof(CPUFeatures));
+    cpuFeatures->can_run_vs = 1;
+    cpuFeatures->neon = 1;
+}
 #else
 static void doGetCPUFeatures(CPUFeatures *cpuFeatures) {
     memset(cpuFeatures, 0, sizeof(CPUFeatures));
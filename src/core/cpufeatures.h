@@ -47,6 +47,9 @@ typedef struct CPUFeatures {
     char avx512_bw;
     char avx512_dq;
     char avx512_vl;
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    // Advanced SIMD is a mandatory part of AArch64.
+    char neon;
 #endif
 } CPUFeatures;
 
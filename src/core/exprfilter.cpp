@@ -19,6 +19,7 @@
 */
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <functional>
 #include <iostream>
@@ -26,6 +27,7 @@
 #include <locale>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -54,10 +56,14 @@ using namespace vsh;
 namespace {
 
 #define MAX_EXPR_INPUTS 26
+#define MAX_EXPR_ROWS 32 // distinct (clip, row offset) pairs read by relative pixel loads in one plane
+#define MAX_EXPR_OUTPUTS 8 // outputs written by one ExprMulti program
+#define MAX_EXPR_POINTERS (((MAX_EXPR_INPUTS + MAX_EXPR_ROWS + MAX_EXPR_OUTPUTS + 1) + 7) & ~7) // dst, inputs, relative rows, the property values and the other outputs
+#define EXPR_MIN_SLICE_PIXELS (256 * 1024) // smallest amount of work worth handing to another thread
 
 enum class ExprOpType {
     // Terminals.
-    MEM_LOAD_U8, MEM_LOAD_U16, MEM_LOAD_F16, MEM_LOAD_F32, CONSTANT,
+    MEM_LOAD_U8, MEM_LOAD_U16, MEM_LOAD_F16, MEM_LOAD_F32, CONSTANT, PROP_LOAD,
     MEM_STORE_U8, MEM_STORE_U16, MEM_STORE_F16, MEM_STORE_F32,
 
     // Arithmetic primitives.
@@ -119,11 +125,14 @@ union ExprUnion {
 struct ExprOp {
     ExprOpType type;
     ExprUnion imm;
+    // Pixel offset of memory loads relative to the current pixel
+    int dx;
+    int dy;
 
-    ExprOp(ExprOpType type, ExprUnion param = {}) : type(type), imm(param) {}
+    ExprOp(ExprOpType type, ExprUnion param = {}) : type(type), imm(param), dx(), dy() {}
 };
 
-bool operator==(const ExprOp &lhs, const ExprOp &rhs) { return lhs.type == rhs.type && lhs.imm.u == rhs.imm.u; }
+bool operator==(const ExprOp &lhs, const ExprOp &rhs) { return lhs.type == rhs.type && lhs.imm.u == rhs.imm.u && lhs.dx == rhs.dx && lhs.dy == rhs.dy; }
 bool operator!=(const ExprOp &lhs, const ExprOp &rhs) { return !(lhs == rhs); }
 
 struct ExprInstruction {
@@ -132,41 +141,107 @@ struct ExprInstruction {
     int src1;
     int src2;
     int src3;
+    int output; // the output written by stores
 
-    ExprInstruction(ExprOp op) : op(op), dst(-1), src1(-1), src2(-1), src3(-1) {}
+    ExprInstruction(ExprOp op) : op(op), dst(-1), src1(-1), src2(-1), src3(-1), output() {}
+};
+
+// Programs lowered by lowerToInteger() are evaluated in 16-bit lanes. Max,
+// min, the rounding shift and the stores use the unsigned instructions when
+// isUnsigned is set, everything else is the same for both.
+enum class ExprIntOpType {
+    LOAD_U8, LOAD_U16, CONSTANT, STORE_U8, STORE_U16,
+    ADD, SUB, MUL, MAX, MIN, ABS, NEG,
+
+    // Rounds to nearest even after dividing by 1 << imm, like a float store.
+    ROUND_SHIFT,
+};
+
+struct ExprIntInstruction {
+    ExprIntOpType type;
+    int imm; // the pointer slot of loads, the value of constants, the shift or the bit depth of 16-bit stores
+    int dx;
+    int dst;
+    int src1;
+    int src2;
+    int output;
+    bool isUnsigned;
 };
 
 enum PlaneOp {
     poProcess, poCopy, poUndefined
 };
 
-struct ExprData {
-    VSNode *node[MAX_EXPR_INPUTS];
-    VSVideoInfo vi;
-    std::vector<ExprInstruction> bytecode[3];
-    int plane[3];
-    int numInputs;
-    typedef void (*ProcessLineProc)(void *rwptrs, intptr_t ptroff[MAX_EXPR_INPUTS + 1], intptr_t niter);
-    ProcessLineProc proc[3];
-    size_t procSize[3];
+// A source row read by relative pixel loads. Rows read with horizontal offsets
+// are copied with pad replicated pixels on both sides before processing.
+struct ExprRowSource {
+    int clip;
+    int dy;
+    int pad;
+    int bytesPerSample;
+};
+
+struct ExprPropRef {
+    int clip;
+    std::string key;
+};
 
-    ExprData() : node(), vi(), plane(), numInputs(), proc() {}
+// The compiled form of one plane expression. Programs are shared between all
+// Expr instances that end up with identical bytecode, see getProgram().
+struct ExprProgram {
+    typedef void (*ProcessLineProc)(void *rwptrs, intptr_t ptroff[MAX_EXPR_POINTERS], intptr_t niter);
 
-    ~ExprData() {
+    std::vector<ExprInstruction> bytecode;
+    std::vector<ExprRowSource> rows;
+    ProcessLineProc proc;
+    size_t procSize;
+    int procStep;
+
+    ExprProgram() : proc(), procSize(), procStep() {}
+    ExprProgram(const ExprProgram &) = delete;
+    ExprProgram &operator=(const ExprProgram &) = delete;
+
+    ~ExprProgram() {
 #ifdef VS_TARGET_CPU_X86
-        for (int i = 0; i < 3; i++) {
-            if (proc[i]) {
+        if (proc) {
 #ifdef VS_TARGET_OS_WINDOWS
-                VirtualFree((LPVOID)proc[i], 0, MEM_RELEASE);
+            VirtualFree((LPVOID)proc, 0, MEM_RELEASE);
 #else
-                munmap((void *)proc[i], procSize[i]);
+            munmap((void *)proc, procSize);
 #endif
-            }
         }
 #endif
     }
 };
 
+struct ExprData {
+    VSNode *node[MAX_EXPR_INPUTS];
+    VSVideoInfo vi;
+    std::shared_ptr<const ExprProgram> program[3];
+    std::vector<ExprPropRef> props;
+    int plane[3];
+    int numInputs;
+    int numOutputs; // ExprMulti stacks the outputs vertically in one frame
+    bool fast; // lower degree approximations for the transcendental functions
+    std::string expr[3]; // the processed planes' expressions after fusion
+    const VSNode *self; // set when other Expr instances may fuse this one
+
+    ExprData() : node(), vi(), plane(), numInputs(), numOutputs(1), fast(), self() {}
+};
+
+// The first output is written through the dst pointer, the others follow the
+// property pointer after the inputs. numInputs includes the relative rows.
+static int exprOutputSlot(int numInputs, int output)
+{
+    return output ? numInputs + 1 + output : 0;
+}
+
+// The last pointer slot advanced after every iteration
+static int exprLastSlot(int numInputs, int numOutputs)
+{
+    return numOutputs > 1 ? numInputs + numOutputs : numInputs;
+}
+
 #ifdef VS_TARGET_CPU_X86
 class ExprCompiler {
     virtual void load8(const ExprInstruction &insn) = 0;
@@ -174,6 +249,7 @@ class ExprCompiler {
     virtual void loadF16(const ExprInstruction &insn) = 0;
     virtual void loadF32(const ExprInstruction &insn) = 0;
     virtual void loadConst(const ExprInstruction &insn) = 0;
+    virtual void loadProp(const ExprInstruction &insn) = 0;
     virtual void store8(const ExprInstruction &insn) = 0;
     virtual void store16(const ExprInstruction &insn) = 0;
     virtual void storeF16(const ExprInstruction &insn) = 0;
@@ -208,6 +284,7 @@ public:
         case ExprOpType::MEM_LOAD_F16: loadF16(insn); break;
         case ExprOpType::MEM_LOAD_F32: loadF32(insn); break;
         case ExprOpType::CONSTANT: loadConst(insn); break;
+        case ExprOpType::PROP_LOAD: loadProp(insn); break;
         case ExprOpType::MEM_STORE_U8: store8(insn); break;
         case ExprOpType::MEM_STORE_U16: store16(insn); break;
         case ExprOpType::MEM_STORE_F16: storeF16(insn); break;
@@ -238,7 +315,9 @@ public:
     }
 
     virtual ~ExprCompiler() {}
-    virtual std::pair<ExprData::ProcessLineProc, size_t> getCode() = 0;
+    // Number of pixels processed by each iteration of the generated loop
+    virtual int getStep() const = 0;
+    virtual std::pair<ExprProgram::ProcessLineProc, size_t> getCode() = 0;
 };
 
 class ExprCompiler128 : public ExprCompiler, private jitasm::function<void, ExprCompiler128, uint8_t *, const intptr_t *, intptr_t> {
@@ -247,7 +326,7 @@ class ExprCompiler128 : public ExprCompiler, private jitasm::function<void, Expr
     friend struct jitasm::function_cdecl<void, ExprCompiler128, uint8_t *, const intptr_t *, intptr_t>;
 
 #define SPLAT(x) { (x), (x), (x), (x) }
-    static constexpr ExprUnion constData alignas(16)[53][4] = {
+    static constexpr ExprUnion constData alignas(16)[66][4] = {
         SPLAT(0x7FFFFFFF), // absmask
         SPLAT(0x80000000), // negmask
         SPLAT(0x7F), // x7F
@@ -301,6 +380,19 @@ class ExprCompiler128 : public ExprCompiler, private jitasm::function<void, Expr
         SPLAT(0x3D2AA73C), // float_cosC4
         SPLAT(static_cast<int32_t>(0XBAB58D50)), // float_cosC6
         SPLAT(0x37C1AD76), // float_cosC8
+        SPLAT(4.1277747308e-02f), // exp_f0
+        SPLAT(1.6753513923e-01f), // exp_f1
+        SPLAT(5.0005116024e-01f), // exp_f2
+        SPLAT(-1.4592516771e-01f), // log_f0
+        SPLAT(2.1776510287e-01f), // log_f1
+        SPLAT(-2.5244997329e-01f), // log_f2
+        SPLAT(3.3285471016e-01f), // log_f3
+        SPLAT(-1.6665853253e-01f), // float_sinF3
+        SPLAT(8.3142747471e-03f), // float_sinF5
+        SPLAT(-1.8542222951e-04f), // float_sinF7
+        SPLAT(-4.9993563074e-01f), // float_cosF2
+        SPLAT(4.1507066867e-02f), // float_cosF4
+        SPLAT(-1.2757519893e-03f), // float_cosF6
     };
 
     struct ConstantIndex {
@@ -359,6 +451,15 @@ class ExprCompiler128 : public ExprCompiler, private jitasm::function<void, Expr
         static constexpr int float_cosC4 = float_cosC2 + 1;
         static constexpr int float_cosC6 = float_cosC2 + 2;
         static constexpr int float_cosC8 = float_cosC2 + 3;
+        // lower degree coefficients for the fast approximations
+        static constexpr int exp_f0 = 53;
+        static constexpr int exp_f2 = exp_f0 + 2;
+        static constexpr int log_f0 = 56;
+        static constexpr int log_f3 = log_f0 + 3;
+        static constexpr int float_sinF3 = 60;
+        static constexpr int float_sinF7 = float_sinF3 + 2;
+        static constexpr int float_cosF2 = 63;
+        static constexpr int float_cosF6 = float_cosF2 + 2;
     };
 #undef SPLAT
 
@@ -367,6 +468,7 @@ class ExprCompiler128 : public ExprCompiler, private jitasm::function<void, Expr
 
     CPUFeatures cpuFeatures;
     int numInputs;
+    int numOutputs;
     int curLabel;
 
 #define EMIT() [this, insn](Reg regptrs, XmmReg zero, Reg constants, std::unordered_map<int, std::pair<XmmReg, XmmReg>> &bytecodeRegs)
@@ -428,7 +530,7 @@ do { \
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            VEX1(movq, t1.first, mmword_ptr[a]);
+            VEX1(movq, t1.first, mmword_ptr[a + insn.op.dx]);
             VEX2(punpcklbw, t1.first, t1.first, zero);
             VEX2(punpckhwd, t1.second, t1.first, zero);
             VEX2(punpcklwd, t1.first, t1.first, zero);
@@ -444,7 +546,10 @@ do { \
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            VEX1(movdqa, t1.first, xmmword_ptr[a]);
+            if (insn.op.dx)
+                VEX1(movdqu, t1.first, xmmword_ptr[a + insn.op.dx * 2]);
+            else
+                VEX1(movdqa, t1.first, xmmword_ptr[a]);
             VEX2(punpckhwd, t1.second, t1.first, zero);
             VEX2(punpcklwd, t1.first, t1.first, zero);
             VEX1(cvtdq2ps, t1.first, t1.first);
@@ -459,8 +564,8 @@ do { \
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            vcvtph2ps(t1.first, qword_ptr[a]);
-            vcvtph2ps(t1.second, qword_ptr[a + 8]);
+            vcvtph2ps(t1.first, qword_ptr[a + insn.op.dx * 2]);
+            vcvtph2ps(t1.second, qword_ptr[a + insn.op.dx * 2 + 8]);
         });
     }
 
@@ -471,8 +576,13 @@ do { \
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            VEX1(movdqa, t1.first, xmmword_ptr[a]);
-            VEX1(movdqa, t1.second, xmmword_ptr[a + 16]);
+            if (insn.op.dx) {
+                VEX1(movdqu, t1.first, xmmword_ptr[a + insn.op.dx * 4]);
+                VEX1(movdqu, t1.second, xmmword_ptr[a + insn.op.dx * 4 + 16]);
+            } else {
+                VEX1(movdqa, t1.first, xmmword_ptr[a]);
+                VEX1(movdqa, t1.second, xmmword_ptr[a + 16]);
+            }
         });
     }
 
@@ -496,6 +606,19 @@ do { \
         });
     }
 
+    void loadProp(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (numInputs + 1)]);
+            VEX1(movss, t1.first, dword_ptr[a + sizeof(float) * insn.op.imm.u]);
+            VEX2IMM(shufps, t1.first, t1.first, t1.first, 0);
+            VEX1(movaps, t1.second, t1.first);
+        });
+    }
+
     void store8(const ExprInstruction &insn) override
     {
         deferred.push_back(EMIT()
@@ -510,7 +633,7 @@ do { \
             VEX1(cvtps2dq, r2, r2);
             VEX2(packssdw, r1, r1, r2);
             VEX2(packuswb, r1, r1, zero);
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             VEX1(movq, mmword_ptr[a], r1);
         });
     }
@@ -542,7 +665,7 @@ do { \
                 if (depth >= 16)
                     VEX2(psubw, r1, r1, xmmword_ptr[constants + ConstantIndex::i16min_epi16 * 16]);
             }
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             VEX1(movaps, xmmword_ptr[a], r1);
         });
     }
@@ -554,7 +677,7 @@ do { \
             auto t1 = bytecodeRegs[insn.src1];
 
             Reg a;
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             vcvtps2ph(qword_ptr[a], t1.first, 0);
             vcvtps2ph(qword_ptr[a + 8], t1.second, 0);
         });
@@ -567,7 +690,7 @@ do { \
             auto t1 = bytecodeRegs[insn.src1];
 
             Reg a;
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             VEX1(movaps, xmmword_ptr[a], t1.first);
             VEX1(movaps, xmmword_ptr[a + 16], t1.second);
         });
@@ -832,7 +955,7 @@ do { \
         });
     }
 
-    void exp_(XmmReg x, XmmReg one, Reg constants)
+    void exp_(XmmReg x, XmmReg one, Reg constants, bool fast)
     {
         XmmReg fx, emm0, etmp, y, mask, z;
         VEX2(minps, x, x, xmmword_ptr[constants + ConstantIndex::exp_hi * 16]);
@@ -849,16 +972,14 @@ do { \
         VEX2(subps, x, x, etmp);
         VEX2(subps, x, x, z);
         VEX2(mulps, z, x, x);
-        VEX2(mulps, y, x, xmmword_ptr[constants + ConstantIndex::exp_p0 * 16]);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::exp_p1 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::exp_p2 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::exp_p3 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::exp_p4 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::exp_p5 * 16]);
+        int first = fast ? ConstantIndex::exp_f0 : ConstantIndex::exp_p0;
+        int last = fast ? ConstantIndex::exp_f2 : ConstantIndex::exp_p5;
+        VEX2(mulps, y, x, xmmword_ptr[constants + first * 16]);
+        for (int i = first + 1; i < last; i++) {
+            VEX2(addps, y, y, xmmword_ptr[constants + i * 16]);
+            VEX2(mulps, y, y, x);
+        }
+        VEX2(addps, y, y, xmmword_ptr[constants + last * 16]);
         VEX2(mulps, y, y, z);
         VEX2(addps, y, y, x);
         VEX2(addps, y, y, one);
@@ -868,7 +989,7 @@ do { \
         VEX2(mulps, x, y, emm0);
     }
 
-    void log_(XmmReg x, XmmReg zero, XmmReg one, Reg constants)
+    void log_(XmmReg x, XmmReg zero, XmmReg one, Reg constants, bool fast)
     {
         XmmReg emm0, invalid_mask, mask, y, etmp, z;
         VEX2IMM(cmpps, invalid_mask, zero, x, _CMP_NLT_US);
@@ -886,23 +1007,13 @@ do { \
         VEX2(subps, emm0, emm0, mask);
         VEX2(addps, x, x, etmp);
         VEX2(mulps, z, x, x);
-        VEX2(mulps, y, x, xmmword_ptr[constants + ConstantIndex::log_p0 * 16]);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p1 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p2 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p3 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p4 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p5 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p6 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p7 * 16]);
-        VEX2(mulps, y, y, x);
-        VEX2(addps, y, y, xmmword_ptr[constants + ConstantIndex::log_p8 * 16]);
-        VEX2(mulps, y, y, x);
+        int first = fast ? ConstantIndex::log_f0 : ConstantIndex::log_p0;
+        int last = fast ? ConstantIndex::log_f3 : ConstantIndex::log_p8;
+        VEX2(mulps, y, x, xmmword_ptr[constants + first * 16]);
+        for (int i = first + 1; i <= last; i++) {
+            VEX2(addps, y, y, xmmword_ptr[constants + i * 16]);
+            VEX2(mulps, y, y, x);
+        }
         VEX2(mulps, y, y, z);
         VEX2(mulps, etmp, emm0, xmmword_ptr[constants + ConstantIndex::log_q1 * 16]);
         VEX2(addps, y, y, etmp);
@@ -934,7 +1045,7 @@ do { \
 
             L(label);
 
-            exp_(r1, one, constants);
+            exp_(r1, one, constants, insn.op.imm.u != 0);
             VEX1(movaps, t2.first, t2.second);
             VEX1(movaps, t2.second, r1);
             VEX1(movaps, r1, r2);
@@ -964,7 +1075,7 @@ do { \
 
             L(label);
 
-            log_(r1, zero, one, constants);
+            log_(r1, zero, one, constants, insn.op.imm.u != 0);
             VEX1(movaps, t2.first, t2.second);
             VEX1(movaps, t2.second, r1);
             VEX1(movaps, r1, r2);
@@ -998,9 +1109,9 @@ do { \
 
             L(label);
 
-            log_(r1, zero, one, constants);
+            log_(r1, zero, one, constants, insn.op.imm.u != 0);
             VEX2(mulps, r1, r1, r3);
-            exp_(r1, one, constants);
+            exp_(r1, one, constants, insn.op.imm.u != 0);
 
             VEX1(movaps, t3.first, t3.second);
             VEX1(movaps, t3.second, r1);
@@ -1012,7 +1123,7 @@ do { \
         });
     }
 
-    void sincos_(bool issin, XmmReg y, XmmReg x, Reg constants)
+    void sincos_(bool issin, XmmReg y, XmmReg x, Reg constants, bool fast)
     {
         XmmReg t1, sign, t2, t3, t4;
         // Remove sign
@@ -1048,44 +1159,44 @@ do { \
         }
         if (issin) {
             // Evaluate minimax polynomial for sin(x) in [-pi/2, pi/2] interval
-            // Y <- X + X * X^2 * (C3 + X^2 * (C5 + X^2 * (C7 + X^2 * C9)))
+            // Y <- X + X * X^2 * (C3 + X^2 * (C5 + X^2 * (C7 + X^2 * C9))), the fast version stops at C7
+            int first = fast ? ConstantIndex::float_sinF3 : ConstantIndex::float_sinC3;
+            int last = fast ? ConstantIndex::float_sinF7 : ConstantIndex::float_sinC9;
             VEX2(mulps, t2, t1, t1);
             if (cpuFeatures.fma3) {
-                vmovaps(t3, xmmword_ptr[constants + ConstantIndex::float_sinC7 * 16]);
-                vfmadd231ps(t3, t2, xmmword_ptr[constants + ConstantIndex::float_sinC9 * 16]);
-                vfmadd213ps(t3, t2, xmmword_ptr[constants + ConstantIndex::float_sinC5 * 16]);
-                vfmadd213ps(t3, t2, xmmword_ptr[constants + ConstantIndex::float_sinC3 * 16]);
+                vmovaps(t3, xmmword_ptr[constants + (last - 1) * 16]);
+                vfmadd231ps(t3, t2, xmmword_ptr[constants + last * 16]);
+                for (int i = last - 2; i >= first; i--)
+                    vfmadd213ps(t3, t2, xmmword_ptr[constants + i * 16]);
                 VEX2(mulps, t3, t3, t2);
                 vfmadd231ps(t1, t1, t3);
             } else {
-                VEX2(mulps, t3, t2, xmmword_ptr[constants + ConstantIndex::float_sinC9 * 16]);
-                VEX2(addps, t3, t3, xmmword_ptr[constants + ConstantIndex::float_sinC7 * 16]);
-                VEX2(mulps, t3, t3, t2);
-                VEX2(addps, t3, t3, xmmword_ptr[constants + ConstantIndex::float_sinC5 * 16]);
-                VEX2(mulps, t3, t3, t2);
-                VEX2(addps, t3, t3, xmmword_ptr[constants + ConstantIndex::float_sinC3 * 16]);
-                VEX2(mulps, t3, t3, t2);
+                VEX2(mulps, t3, t2, xmmword_ptr[constants + last * 16]);
+                for (int i = last - 1; i >= first; i--) {
+                    VEX2(addps, t3, t3, xmmword_ptr[constants + i * 16]);
+                    VEX2(mulps, t3, t3, t2);
+                }
                 VEX2(mulps, t3, t3, t1);
                 VEX2(addps, t1, t1, t3);
             }
         } else {
             // Evaluate minimax polynomial for cos(x) in [-pi/2, pi/2] interval
-            // Y <- 1 + X^2 * (C2 + X^2 * (C4 + X^2 * (C6 + X^2 * C8)))
+            // Y <- 1 + X^2 * (C2 + X^2 * (C4 + X^2 * (C6 + X^2 * C8))), the fast version stops at C6
+            int first = fast ? ConstantIndex::float_cosF2 : ConstantIndex::float_cosC2;
+            int last = fast ? ConstantIndex::float_cosF6 : ConstantIndex::float_cosC8;
             VEX2(mulps, t2, t1, t1);
             if (cpuFeatures.fma3) {
-                vmovaps(t1, xmmword_ptr[constants + ConstantIndex::float_cosC6 * 16]);
-                vfmadd231ps(t1, t2, xmmword_ptr[constants + ConstantIndex::float_cosC8 * 16]);
-                vfmadd213ps(t1, t2, xmmword_ptr[constants + ConstantIndex::float_cosC4 * 16]);
-                vfmadd213ps(t1, t2, xmmword_ptr[constants + ConstantIndex::float_cosC2 * 16]);
+                vmovaps(t1, xmmword_ptr[constants + (last - 1) * 16]);
+                vfmadd231ps(t1, t2, xmmword_ptr[constants + last * 16]);
+                for (int i = last - 2; i >= first; i--)
+                    vfmadd213ps(t1, t2, xmmword_ptr[constants + i * 16]);
                 vfmadd213ps(t1, t2, xmmword_ptr[constants + ConstantIndex::float_one * 16]);
             } else {
-                VEX2(mulps, t1, t2, xmmword_ptr[constants + ConstantIndex::float_cosC8 * 16]);
-                VEX2(addps, t1, t1, xmmword_ptr[constants + ConstantIndex::float_cosC6 * 16]);
-                VEX2(mulps, t1, t1, t2);
-                VEX2(addps, t1, t1, xmmword_ptr[constants + ConstantIndex::float_cosC4 * 16]);
-                VEX2(mulps, t1, t1, t2);
-                VEX2(addps, t1, t1, xmmword_ptr[constants + ConstantIndex::float_cosC2 * 16]);
-                VEX2(mulps, t1, t1, t2);
+                VEX2(mulps, t1, t2, xmmword_ptr[constants + last * 16]);
+                for (int i = last - 1; i >= first; i--) {
+                    VEX2(addps, t1, t1, xmmword_ptr[constants + i * 16]);
+                    VEX2(mulps, t1, t1, t2);
+                }
                 VEX2(addps, t1, t1, xmmword_ptr[constants + ConstantIndex::float_one * 16]);
             }
         }
@@ -1113,7 +1224,7 @@ do { \
 
             L(label);
 
-            sincos_(issin, r1, r1, constants);
+            sincos_(issin, r1, r1, constants, insn.op.imm.u != 0);
             VEX1(movaps, t3.first, t3.second);
             VEX1(movaps, t3.second, r1);
             VEX1(movaps, r1, r2);
@@ -1148,7 +1259,7 @@ do { \
         }
 
 #if UINTPTR_MAX > UINT32_MAX
-        for (int i = 0; i < numInputs / 2 + 1; i++) {
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 2 + 1; i++) {
             XmmReg r1, r2;
             VEX1(movdqu, r1, xmmword_ptr[regptrs + 16 * i]);
             VEX1(movdqu, r2, xmmword_ptr[regoffs + 16 * i]);
@@ -1156,7 +1267,7 @@ do { \
             VEX1(movdqu, xmmword_ptr[regptrs + 16 * i], r1);
         }
 #else
-        for (int i = 0; i < numInputs / 4 + 1; i++) {
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 4 + 1; i++) {
             XmmReg r1, r2;
             VEX1(movdqu, r1, xmmword_ptr[regptrs + 16 * i]);
             VEX1(movdqu, r2, xmmword_ptr[regoffs + 16 * i]);
@@ -1170,9 +1281,11 @@ do { \
     }
 
 public:
-    explicit ExprCompiler128(int numInputs) : cpuFeatures(*getCPUFeatures()), numInputs(numInputs), curLabel() {}
+    ExprCompiler128(int numInputs, int numOutputs) : cpuFeatures(*getCPUFeatures()), numInputs(numInputs), numOutputs(numOutputs), curLabel() {}
+
+    int getStep() const override { return 8; }
 
-    std::pair<ExprData::ProcessLineProc, size_t> getCode() override
+    std::pair<ExprProgram::ProcessLineProc, size_t> getCode() override
     {
         size_t size;
         if (jit::GetCode() && (size = GetCodeSize())) {
@@ -1182,7 +1295,7 @@ public:
             void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE, 0, 0);
 #endif
             memcpy(ptr, jit::GetCode(), size);
-            return {reinterpret_cast<ExprData::ProcessLineProc>(ptr), size};
+            return {reinterpret_cast<ExprProgram::ProcessLineProc>(ptr), size};
         }
         return {nullptr, 0};
     }
@@ -1193,7 +1306,7 @@ public:
 #undef EMIT
 };
 
-constexpr ExprUnion ExprCompiler128::constData alignas(16)[53][4];
+constexpr ExprUnion ExprCompiler128::constData alignas(16)[66][4];
 
 class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, ExprCompiler256, uint8_t *, const intptr_t *, intptr_t> {
     typedef jitasm::function<void, ExprCompiler256, uint8_t *, const intptr_t *, intptr_t> jit;
@@ -1201,7 +1314,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
     friend struct jitasm::function_cdecl<void, ExprCompiler256, uint8_t *, const intptr_t *, intptr_t>;
 
 #define SPLAT(x) { (x), (x), (x), (x), (x), (x), (x), (x) }
-    static constexpr ExprUnion constData alignas(32)[53][8] = {
+    static constexpr ExprUnion constData alignas(32)[66][8] = {
         SPLAT(0x7FFFFFFF), // absmask
         SPLAT(0x80000000), // negmask
         SPLAT(0x7F), // x7F
@@ -1255,6 +1368,19 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
         SPLAT(0x3D2AA73C), // float_cosC4
         SPLAT(static_cast<int32_t>(0XBAB58D50)), // float_cosC6
         SPLAT(0x37C1AD76), // float_cosC8
+        SPLAT(4.1277747308e-02f), // exp_f0
+        SPLAT(1.6753513923e-01f), // exp_f1
+        SPLAT(5.0005116024e-01f), // exp_f2
+        SPLAT(-1.4592516771e-01f), // log_f0
+        SPLAT(2.1776510287e-01f), // log_f1
+        SPLAT(-2.5244997329e-01f), // log_f2
+        SPLAT(3.3285471016e-01f), // log_f3
+        SPLAT(-1.6665853253e-01f), // float_sinF3
+        SPLAT(8.3142747471e-03f), // float_sinF5
+        SPLAT(-1.8542222951e-04f), // float_sinF7
+        SPLAT(-4.9993563074e-01f), // float_cosF2
+        SPLAT(4.1507066867e-02f), // float_cosF4
+        SPLAT(-1.2757519893e-03f), // float_cosF6
     };
 
     struct ConstantIndex {
@@ -1313,6 +1439,15 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
         static constexpr int float_cosC4 = float_cosC2 + 1;
         static constexpr int float_cosC6 = float_cosC2 + 2;
         static constexpr int float_cosC8 = float_cosC2 + 3;
+        // lower degree coefficients for the fast approximations
+        static constexpr int exp_f0 = 53;
+        static constexpr int exp_f2 = exp_f0 + 2;
+        static constexpr int log_f0 = 56;
+        static constexpr int log_f3 = log_f0 + 3;
+        static constexpr int float_sinF3 = 60;
+        static constexpr int float_sinF7 = float_sinF3 + 2;
+        static constexpr int float_cosF2 = 63;
+        static constexpr int float_cosF6 = float_cosF2 + 2;
     };
 #undef SPLAT
 
@@ -1321,6 +1456,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
 
     CPUFeatures cpuFeatures;
     int numInputs;
+    int numOutputs;
     int curLabel;
 
 #define EMIT() [this, insn](Reg regptrs, YmmReg zero, Reg constants, std::unordered_map<int, YmmReg> &bytecodeRegs)
@@ -1332,7 +1468,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            vpmovzxbd(t1, mmword_ptr[a]);
+            vpmovzxbd(t1, mmword_ptr[a + insn.op.dx]);
             vcvtdq2ps(t1, t1);
         });
     }
@@ -1344,7 +1480,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            vpmovzxwd(t1, xmmword_ptr[a]);
+            vpmovzxwd(t1, xmmword_ptr[a + insn.op.dx * 2]);
             vcvtdq2ps(t1, t1);
         });
     }
@@ -1356,7 +1492,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            vcvtph2ps(t1, xmmword_ptr[a]);
+            vcvtph2ps(t1, xmmword_ptr[a + insn.op.dx * 2]);
         });
     }
 
@@ -1367,7 +1503,10 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
             auto t1 = bytecodeRegs[insn.dst];
             Reg a;
             mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
-            vmovaps(t1, ymmword_ptr[a]);
+            if (insn.op.dx)
+                vmovups(t1, ymmword_ptr[a + insn.op.dx * 4]);
+            else
+                vmovaps(t1, ymmword_ptr[a]);
         });
     }
 
@@ -1390,6 +1529,17 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
         });
     }
 
+    void loadProp(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (numInputs + 1)]);
+            vbroadcastss(t1, dword_ptr[a + sizeof(float) * insn.op.imm.u]);
+        });
+    }
+
     void store8(const ExprInstruction &insn) override
     {
         deferred.push_back(EMIT()
@@ -1402,7 +1552,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
             vpackssdw(r1, r1, r1);
             vpermq(r1, r1, 0x08);
             vpackuswb(r1, r1, zero);
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             vmovq(qword_ptr[a], r1.as128());
         });
     }
@@ -1419,7 +1569,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
             vcvtps2dq(r1, r1);
             vpackusdw(r1, r1, r1);
             vpermq(r1, r1, 0x08);
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             vmovaps(xmmword_ptr[a], r1.as128());
         });
     }
@@ -1430,7 +1580,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
         {
             auto t1 = bytecodeRegs[insn.src1];
             Reg a;
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             vcvtps2ph(xmmword_ptr[a], t1, 0);
         });
     }
@@ -1441,7 +1591,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
         {
             auto t1 = bytecodeRegs[insn.src1];
             Reg a;
-            mov(a, ptr[regptrs]);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
             vmovaps(ymmword_ptr[a], t1);
         });
     }
@@ -1643,7 +1793,7 @@ do { \
         });
     }
 
-    void exp_(YmmReg x, YmmReg one, Reg constants)
+    void exp_(YmmReg x, YmmReg one, Reg constants, bool fast)
     {
         YmmReg fx, emm0, etmp, y, mask, z;
         vminps(x, x, ymmword_ptr[constants + ConstantIndex::exp_hi * 32]);
@@ -1658,12 +1808,11 @@ do { \
         vfnmadd231ps(x, fx, ymmword_ptr[constants + ConstantIndex::exp_c1 * 32]);
         vfnmadd231ps(x, fx, ymmword_ptr[constants + ConstantIndex::exp_c2 * 32]);
         vmulps(z, x, x);
-        vmovaps(y, ymmword_ptr[constants + ConstantIndex::exp_p0 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::exp_p1 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::exp_p2 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::exp_p3 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::exp_p4 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::exp_p5 * 32]);
+        int first = fast ? ConstantIndex::exp_f0 : ConstantIndex::exp_p0;
+        int last = fast ? ConstantIndex::exp_f2 : ConstantIndex::exp_p5;
+        vmovaps(y, ymmword_ptr[constants + first * 32]);
+        for (int i = first + 1; i <= last; i++)
+            vfmadd213ps(y, x, ymmword_ptr[constants + i * 32]);
         vfmadd213ps(y, z, x);
         vaddps(y, y, one);
         vcvttps2dq(emm0, fx);
@@ -1672,7 +1821,7 @@ do { \
         vmulps(x, y, emm0);
     }
 
-    void log_(YmmReg x, YmmReg zero, YmmReg one, Reg constants)
+    void log_(YmmReg x, YmmReg zero, YmmReg one, Reg constants, bool fast)
     {
         YmmReg emm0, invalid_mask, mask, y, etmp, z;
         vcmpps(invalid_mask, zero, x, _CMP_NLT_US);
@@ -1690,15 +1839,11 @@ do { \
         vsubps(emm0, emm0, mask);
         vaddps(x, x, etmp);
         vmulps(z, x, x);
-        vmovaps(y, ymmword_ptr[constants + ConstantIndex::log_p0 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p1 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p2 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p3 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p4 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p5 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p6 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p7 * 32]);
-        vfmadd213ps(y, x, ymmword_ptr[constants + ConstantIndex::log_p8 * 32]);
+        int first = fast ? ConstantIndex::log_f0 : ConstantIndex::log_p0;
+        int last = fast ? ConstantIndex::log_f3 : ConstantIndex::log_p8;
+        vmovaps(y, ymmword_ptr[constants + first * 32]);
+        for (int i = first + 1; i <= last; i++)
+            vfmadd213ps(y, x, ymmword_ptr[constants + i * 32]);
         vmulps(y, y, x);
         vmulps(y, y, z);
         vfmadd231ps(y, emm0, ymmword_ptr[constants + ConstantIndex::log_q1 * 32]);
@@ -1716,8 +1861,8 @@ do { \
             auto t2 = bytecodeRegs[insn.dst];
             YmmReg one;
             vmovaps(one, ymmword_ptr[constants + ConstantIndex::float_one * 32]);
-            vmovaps(t1, t2);
-            exp_(t1, one, constants);
+            vmovaps(t2, t1);
+            exp_(t2, one, constants, insn.op.imm.u != 0);
         });
     }
 
@@ -1729,8 +1874,8 @@ do { \
             auto t2 = bytecodeRegs[insn.dst];
             YmmReg one;
             vmovaps(one, ymmword_ptr[constants + ConstantIndex::float_one * 32]);
-            vmovaps(t1, t2);
-            log_(t1, zero, one, constants);
+            vmovaps(t2, t1);
+            log_(t2, zero, one, constants, insn.op.imm.u != 0);
         });
     }
 
@@ -1745,15 +1890,16 @@ do { \
             YmmReg r1, one;
             vmovaps(one, ymmword_ptr[constants + ConstantIndex::float_one * 32]);
             vmovaps(r1, t1);
-            log_(r1, zero, one, constants);
+            log_(r1, zero, one, constants, insn.op.imm.u != 0);
             vmulps(r1, r1, t2);
-            exp_(r1, one, constants);
+            exp_(r1, one, constants, insn.op.imm.u != 0);
             vmovaps(t3, r1);
         });
     }
 
     void sincos_(bool issin, const ExprInstruction &insn, Reg constants, std::unordered_map<int, YmmReg> &bytecodeRegs)
     {
+        bool fast = insn.op.imm.u != 0;
         auto x = bytecodeRegs[insn.src1];
         auto y = bytecodeRegs[insn.dst];
         YmmReg t1, sign, t2, t3, t4;
@@ -1779,22 +1925,26 @@ do { \
         vfnmadd231ps(t1, t2, ymmword_ptr[constants + ConstantIndex::float_pi4 * 32]);
         if (issin) {
             // Evaluate minimax polynomial for sin(x) in [-pi/2, pi/2] interval
-            // Y <- X + X * X^2 * (C3 + X^2 * (C5 + X^2 * (C7 + X^2 * C9)))
+            // Y <- X + X * X^2 * (C3 + X^2 * (C5 + X^2 * (C7 + X^2 * C9))), the fast version stops at C7
+            int first = fast ? ConstantIndex::float_sinF3 : ConstantIndex::float_sinC3;
+            int last = fast ? ConstantIndex::float_sinF7 : ConstantIndex::float_sinC9;
             vmulps(t2, t1, t1);
-            vmovaps(t3, ymmword_ptr[constants + ConstantIndex::float_sinC7 * 32]);
-            vfmadd231ps(t3, t2, ymmword_ptr[constants + ConstantIndex::float_sinC9 * 32]);
-            vfmadd213ps(t3, t2, ymmword_ptr[constants + ConstantIndex::float_sinC5 * 32]);
-            vfmadd213ps(t3, t2, ymmword_ptr[constants + ConstantIndex::float_sinC3 * 32]);
+            vmovaps(t3, ymmword_ptr[constants + (last - 1) * 32]);
+            vfmadd231ps(t3, t2, ymmword_ptr[constants + last * 32]);
+            for (int i = last - 2; i >= first; i--)
+                vfmadd213ps(t3, t2, ymmword_ptr[constants + i * 32]);
             vmulps(t3, t3, t2);
             vfmadd231ps(t1, t1, t3);
         } else {
             // Evaluate minimax polynomial for cos(x) in [-pi/2, pi/2] interval
-            // Y <- 1 + X^2 * (C2 + X^2 * (C4 + X^2 * (C6 + X^2 * C8)))
+            // Y <- 1 + X^2 * (C2 + X^2 * (C4 + X^2 * (C6 + X^2 * C8))), the fast version stops at C6
+            int first = fast ? ConstantIndex::float_cosF2 : ConstantIndex::float_cosC2;
+            int last = fast ? ConstantIndex::float_cosF6 : ConstantIndex::float_cosC8;
             vmulps(t2, t1, t1);
-            vmovaps(t1, ymmword_ptr[constants + ConstantIndex::float_cosC6 * 32]);
-            vfmadd231ps(t1, t2, ymmword_ptr[constants + ConstantIndex::float_cosC8 * 32]);
-            vfmadd213ps(t1, t2, ymmword_ptr[constants + ConstantIndex::float_cosC4 * 32]);
-            vfmadd213ps(t1, t2, ymmword_ptr[constants + ConstantIndex::float_cosC2 * 32]);
+            vmovaps(t1, ymmword_ptr[constants + (last - 1) * 32]);
+            vfmadd231ps(t1, t2, ymmword_ptr[constants + last * 32]);
+            for (int i = last - 2; i >= first; i--)
+                vfmadd213ps(t1, t2, ymmword_ptr[constants + i * 32]);
             vfmadd213ps(t1, t2, ymmword_ptr[constants + ConstantIndex::float_one * 32]);
         }
         // Apply sign
@@ -1832,7 +1982,7 @@ do { \
         }
 
 #if UINTPTR_MAX > UINT32_MAX
-        for (int i = 0; i < numInputs / 4 + 1; i++) {
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 4 + 1; i++) {
             YmmReg r1, r2;
             vmovdqu(r1, ymmword_ptr[regptrs + 32 * i]);
             vmovdqu(r2, ymmword_ptr[regoffs + 32 * i]);
@@ -1840,7 +1990,7 @@ do { \
             vmovdqu(ymmword_ptr[regptrs + 32 * i], r1);
         }
 #else
-        for (int i = 0; i < numInputs / 8 + 1; i++) {
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 8 + 1; i++) {
             YmmReg r1, r2;
             vmovdqu(r1, ymmword_ptr[regptrs + 32 * i]);
             vmovdqu(r2, ymmword_ptr[regoffs + 32 * i]);
@@ -1854,9 +2004,11 @@ do { \
     }
 
 public:
-    explicit ExprCompiler256(int numInputs) : cpuFeatures(*getCPUFeatures()), numInputs(numInputs) {}
+    ExprCompiler256(int numInputs, int numOutputs) : cpuFeatures(*getCPUFeatures()), numInputs(numInputs), numOutputs(numOutputs) {}
+
+    int getStep() const override { return 8; }
 
-    std::pair<ExprData::ProcessLineProc, size_t> getCode() override
+    std::pair<ExprProgram::ProcessLineProc, size_t> getCode() override
     {
         size_t size;
         if (jit::GetCode(true) && (size = GetCodeSize())) {
@@ -1866,124 +2018,1277 @@ public:
             void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE, 0, 0);
 #endif
             memcpy(ptr, jit::GetCode(true), size);
-            return {reinterpret_cast<ExprData::ProcessLineProc>(ptr), size};
+            return {reinterpret_cast<ExprProgram::ProcessLineProc>(ptr), size};
         }
         return {nullptr, 0};
     }
 #undef EMIT
 };
 
-constexpr ExprUnion ExprCompiler256::constData alignas(32)[53][8];
+constexpr ExprUnion ExprCompiler256::constData alignas(32)[66][8];
 
-std::unique_ptr<ExprCompiler> make_compiler(int numInputs, int cpulevel)
-{
-    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
-        return std::unique_ptr<ExprCompiler>(new ExprCompiler256(numInputs));
-    else
-        return std::unique_ptr<ExprCompiler>(new ExprCompiler128(numInputs));
-}
-#endif
+class ExprCompiler512 : public ExprCompiler, private jitasm::function<void, ExprCompiler512, uint8_t *, const intptr_t *, intptr_t> {
+    typedef jitasm::function<void, ExprCompiler512, uint8_t *, const intptr_t *, intptr_t> jit;
+    friend struct jitasm::function<void, ExprCompiler512, uint8_t *, const intptr_t *, intptr_t>;
+    friend struct jitasm::function_cdecl<void, ExprCompiler512, uint8_t *, const intptr_t *, intptr_t>;
 
-class ExprInterpreter {
-    const ExprInstruction *bytecode;
-    size_t numInsns;
-    std::vector<float> registers;
+#define SPLAT(x) { (x), (x), (x), (x), (x), (x), (x), (x), (x), (x), (x), (x), (x), (x), (x), (x) }
+    static constexpr ExprUnion constData alignas(64)[66][16] = {
+        SPLAT(0x7FFFFFFF), // absmask
+        SPLAT(0x80000000), // negmask
+        SPLAT(0x7F), // x7F
+        SPLAT(0x00800000), // min_norm_pos
+        SPLAT(~0x7F800000), // inv_mant_mask
+        SPLAT(1.0f), // float_one
+        SPLAT(0.5f), // float_half
+        SPLAT(255.0f), // float_255
+        SPLAT(511.0f), // float_511
+        SPLAT(1023.0f), // float_1023
+        SPLAT(2047.0f), // float_2047
+        SPLAT(4095.0f), // float_4095
+        SPLAT(8191.0f), // float_8191
+        SPLAT(16383.0f), // float_16383
+        SPLAT(32767.0f), // float_32767
+        SPLAT(65535.0f), // float_65535
+        SPLAT(static_cast<int32_t>(0x80008000)), // i16min_epi16
+        SPLAT(static_cast<int32_t>(0xFFFF8000)), // i16min_epi32
+        SPLAT(88.3762626647949f), // exp_hi
+        SPLAT(-88.3762626647949f), // exp_lo
+        SPLAT(1.44269504088896341f), // log2e
+        SPLAT(0.693359375f), // exp_c1
+        SPLAT(-2.12194440e-4f), // exp_c2
+        SPLAT(1.9875691500E-4f), // exp_p0
+        SPLAT(1.3981999507E-3f), // exp_p1
+        SPLAT(8.3334519073E-3f), // exp_p2
+        SPLAT(4.1665795894E-2f), // exp_p3
+        SPLAT(1.6666665459E-1f), // exp_p4
+        SPLAT(5.0000001201E-1f), // exp_p5
+        SPLAT(0.707106781186547524f), // sqrt_1_2
+        SPLAT(7.0376836292E-2f), // log_p0
+        SPLAT(-1.1514610310E-1f), // log_p1
+        SPLAT(1.1676998740E-1f), // log_p2
+        SPLAT(-1.2420140846E-1f), // log_p3
+        SPLAT(+1.4249322787E-1f), // log_p4
+        SPLAT(-1.6668057665E-1f), // log_p5
+        SPLAT(+2.0000714765E-1f), // log_p6
+        SPLAT(-2.4999993993E-1f), // log_p7
+        SPLAT(+3.3333331174E-1f), // log_p8
+        SPLAT(0x3ea2f983), // float_invpi, 1/pi
+        SPLAT(0x4b400000), // float_rintf
+        SPLAT(0x40490000), // float_pi1
+        SPLAT(0x3a7da000), // float_pi2
+        SPLAT(0x34222000), // float_pi3
+        SPLAT(0x2cb4611a), // float_pi4
+        SPLAT(0xbe2aaaa6), // float_sinC3
+        SPLAT(0x3c08876a), // float_sinC5
+        SPLAT(0xb94fb7ff), // float_sinC7
+        SPLAT(0x362edef8), // float_sinC9
+        SPLAT(static_cast<int32_t>(0xBEFFFFE2)), // float_cosC2
+        SPLAT(0x3D2AA73C), // float_cosC4
+        SPLAT(static_cast<int32_t>(0XBAB58D50)), // float_cosC6
+        SPLAT(0x37C1AD76), // float_cosC8
+        SPLAT(4.1277747308e-02f), // exp_f0
+        SPLAT(1.6753513923e-01f), // exp_f1
+        SPLAT(5.0005116024e-01f), // exp_f2
+        SPLAT(-1.4592516771e-01f), // log_f0
+        SPLAT(2.1776510287e-01f), // log_f1
+        SPLAT(-2.5244997329e-01f), // log_f2
+        SPLAT(3.3285471016e-01f), // log_f3
+        SPLAT(-1.6665853253e-01f), // float_sinF3
+        SPLAT(8.3142747471e-03f), // float_sinF5
+        SPLAT(-1.8542222951e-04f), // float_sinF7
+        SPLAT(-4.9993563074e-01f), // float_cosF2
+        SPLAT(4.1507066867e-02f), // float_cosF4
+        SPLAT(-1.2757519893e-03f), // float_cosF6
+    };
 
-    template <class T>
-    static T clamp_int(float x, int depth = std::numeric_limits<T>::digits)
+    struct ConstantIndex {
+        static constexpr int absmask = 0;
+        static constexpr int negmask = 1;
+        static constexpr int x7F = 2;
+        static constexpr int min_norm_pos = 3;
+        static constexpr int inv_mant_mask = 4;
+        static constexpr int float_one = 5;
+        static constexpr int float_half = 6;
+        static constexpr int float_255 = 7;
+        static constexpr int float_511 = 8;
+        static constexpr int float_1023 = 9;
+        static constexpr int float_2047 = 10;
+        static constexpr int float_4095 = 11;
+        static constexpr int float_8191 = 12;
+        static constexpr int float_16383 = 13;
+        static constexpr int float_32767 = 14;
+        static constexpr int float_65535 = 15;
+        static constexpr int i16min_epi16 = 16;
+        static constexpr int i16min_epi32 = 17;
+        static constexpr int exp_hi = 18;
+        static constexpr int exp_lo = 19;
+        static constexpr int log2e = 20;
+        static constexpr int exp_c1 = 21;
+        static constexpr int exp_c2 = 22;
+        static constexpr int exp_p0 = 23;
+        static constexpr int exp_p1 = 24;
+        static constexpr int exp_p2 = 25;
+        static constexpr int exp_p3 = 26;
+        static constexpr int exp_p4 = 27;
+        static constexpr int exp_p5 = 28;
+        static constexpr int sqrt_1_2 = 29;
+        static constexpr int log_p0 = 30;
+        static constexpr int log_p1 = 31;
+        static constexpr int log_p2 = 32;
+        static constexpr int log_p3 = 33;
+        static constexpr int log_p4 = 34;
+        static constexpr int log_p5 = 35;
+        static constexpr int log_p6 = 36;
+        static constexpr int log_p7 = 37;
+        static constexpr int log_p8 = 38;
+        static constexpr int log_q1 = exp_c2;
+        static constexpr int log_q2 = exp_c1;
+        static constexpr int float_invpi = 39;
+        static constexpr int float_rintf = 40;
+        static constexpr int float_pi1 = 41;
+        static constexpr int float_pi2 = float_pi1 + 1;
+        static constexpr int float_pi3 = float_pi1 + 2;
+        static constexpr int float_pi4 = float_pi1 + 3;
+        static constexpr int float_sinC3 = 45;
+        static constexpr int float_sinC5 = float_sinC3 + 1;
+        static constexpr int float_sinC7 = float_sinC3 + 2;
+        static constexpr int float_sinC9 = float_sinC3 + 3;
+        static constexpr int float_cosC2 = 49;
+        static constexpr int float_cosC4 = float_cosC2 + 1;
+        static constexpr int float_cosC6 = float_cosC2 + 2;
+        static constexpr int float_cosC8 = float_cosC2 + 3;
+        // lower degree coefficients for the fast approximations
+        static constexpr int exp_f0 = 53;
+        static constexpr int exp_f2 = exp_f0 + 2;
+        static constexpr int log_f0 = 56;
+        static constexpr int log_f3 = log_f0 + 3;
+        static constexpr int float_sinF3 = 60;
+        static constexpr int float_sinF7 = float_sinF3 + 2;
+        static constexpr int float_cosF2 = 63;
+        static constexpr int float_cosF6 = float_cosF2 + 2;
+    };
+#undef SPLAT
+
+    // JitASM compiles everything from main(), so record the operations for later.
+    std::vector<std::function<void(Reg, ZmmReg, Reg, std::unordered_map<int, ZmmReg> &)>> deferred;
+
+    CPUFeatures cpuFeatures;
+    int numInputs;
+    int numOutputs;
+
+#define EMIT() [this, insn](Reg regptrs, ZmmReg zero, Reg constants, std::unordered_map<int, ZmmReg> &bytecodeRegs)
+
+    void load8(const ExprInstruction &insn) override
     {
-        float maxval = static_cast<float>((1U << depth) - 1);
-        return static_cast<T>(std::lrint(std::min(std::max(x, static_cast<float>(std::numeric_limits<T>::min())), maxval)));
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
+            vpmovzxbd(t1, xmmword_ptr[a + insn.op.dx]);
+            vcvtdq2ps(t1, t1);
+        });
     }
 
-    static float bool2float(bool x) { return x ? 1.0f : 0.0f; }
-    static bool float2bool(float x) { return x > 0.0f; }
-public:
-    ExprInterpreter(const ExprInstruction *bytecode, size_t numInsns) : bytecode(bytecode), numInsns(numInsns)
+    void load16(const ExprInstruction &insn) override
     {
-        int maxreg = 0;
-        for (size_t i = 0; i < numInsns; ++i) {
-            maxreg = std::max(maxreg, bytecode[i].dst);
-        }
-        registers.resize(maxreg + 1);
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
+            vpmovzxwd(t1, ymmword_ptr[a + insn.op.dx * 2]);
+            vcvtdq2ps(t1, t1);
+        });
     }
 
-    void eval(const uint8_t * const *srcp, uint8_t *dstp, int x)
+    void loadF16(const ExprInstruction &insn) override
     {
-        for (size_t i = 0; i < numInsns; ++i) {
-            const ExprInstruction &insn = bytecode[i];
-
-#define SRC1 registers[insn.src1]
-#define SRC2 registers[insn.src2]
-#define SRC3 registers[insn.src3]
-#define DST registers[insn.dst]
-            switch (insn.op.type) {
-            case ExprOpType::MEM_LOAD_U8: DST = reinterpret_cast<const uint8_t *>(srcp[insn.op.imm.u])[x]; break;
-            case ExprOpType::MEM_LOAD_U16: DST = reinterpret_cast<const uint16_t *>(srcp[insn.op.imm.u])[x]; break;
-            case ExprOpType::MEM_LOAD_F16: DST = 0; break;
-            case ExprOpType::MEM_LOAD_F32: DST = reinterpret_cast<const float *>(srcp[insn.op.imm.u])[x]; break;
-            case ExprOpType::CONSTANT: DST = insn.op.imm.f; break;
-            case ExprOpType::ADD: DST = SRC1 + SRC2; break;
-            case ExprOpType::SUB: DST = SRC1 - SRC2; break;
-            case ExprOpType::MUL: DST = SRC1 * SRC2; break;
-            case ExprOpType::DIV: DST = SRC1 / SRC2; break;
-            case ExprOpType::FMA:
-                switch (static_cast<FMAType>(insn.op.imm.u)) {
-                case FMAType::FMADD: DST = SRC2 * SRC3 + SRC1; break;
-                case FMAType::FMSUB: DST = SRC2 * SRC3 - SRC1; break;
-                case FMAType::FNMADD: DST = -(SRC2 * SRC3) + SRC1; break;
-                case FMAType::FNMSUB: DST = -(SRC2 * SRC3) - SRC1; break;
-                };
-                break;
-            case ExprOpType::MAX: DST = std::max(SRC1, SRC2); break;
-            case ExprOpType::MIN: DST = std::min(SRC1, SRC2); break;
-            case ExprOpType::EXP: DST = std::exp(SRC1); break;
-            case ExprOpType::LOG: DST = std::log(SRC1); break;
-            case ExprOpType::POW: DST = std::pow(SRC1, SRC2); break;
-            case ExprOpType::SQRT: DST = std::sqrt(SRC1); break;
-            case ExprOpType::SIN: DST = std::sin(SRC1); break;
-            case ExprOpType::COS: DST = std::cos(SRC1); break;
-            case ExprOpType::ABS: DST = std::fabs(SRC1); break;
-            case ExprOpType::NEG: DST = -SRC1; break;
-            case ExprOpType::CMP:
-                switch (static_cast<ComparisonType>(insn.op.imm.u)) {
-                case ComparisonType::EQ: DST = bool2float(SRC1 == SRC2); break;
-                case ComparisonType::LT: DST = bool2float(SRC1 < SRC2); break;
-                case ComparisonType::LE: DST = bool2float(SRC1 <= SRC2); break;
-                case ComparisonType::NEQ: DST = bool2float(SRC1 != SRC2); break;
-                case ComparisonType::NLT: DST = bool2float(SRC1 >= SRC2); break;
-                case ComparisonType::NLE: DST = bool2float(SRC1 > SRC2); break;
-                }
-                break;
-            case ExprOpType::TERNARY: DST = float2bool(SRC1) ? SRC2 : SRC3; break;
-            case ExprOpType::AND: DST = bool2float((float2bool(SRC1) && float2bool(SRC2))); break;
-            case ExprOpType::OR:  DST = bool2float((float2bool(SRC1) || float2bool(SRC2))); break;
-            case ExprOpType::XOR: DST = bool2float((float2bool(SRC1) != float2bool(SRC2))); break;
-            case ExprOpType::NOT: DST = bool2float(!float2bool(SRC1)); break;
-            case ExprOpType::MEM_STORE_U8:  reinterpret_cast<uint8_t *>(dstp)[x] = clamp_int<uint8_t>(SRC1); return;
-            case ExprOpType::MEM_STORE_U16: reinterpret_cast<uint16_t *>(dstp)[x] = clamp_int<uint16_t>(SRC1, insn.op.imm.u); return;
-            case ExprOpType::MEM_STORE_F16: reinterpret_cast<uint16_t *>(dstp)[x] = 0; return;
-            case ExprOpType::MEM_STORE_F32: reinterpret_cast<float *>(dstp)[x] = SRC1; return;
-            default: fprintf(stderr, "%s", "illegal opcode\n"); std::terminate(); return;
-            }
-#undef DST
-#undef SRC3
-#undef SRC2
-#undef SRC1
-        }
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
+            vcvtph2ps(t1, ymmword_ptr[a + insn.op.dx * 2]);
+        });
     }
-};
-
-struct ExpressionTreeNode {
-    ExpressionTreeNode *parent;
-    ExpressionTreeNode *left;
-    ExpressionTreeNode *right;
-    ExprOp op;
-    int valueNum;
 
-    explicit ExpressionTreeNode(ExprOp op) : parent(), left(), right(), op(op), valueNum(-1) {}
-
-    void setLeft(ExpressionTreeNode *node)
+    void loadF32(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.op.imm.u + 1)]);
+            if (insn.op.dx)
+                vmovups(t1, zmmword_ptr[a + insn.op.dx * 4]);
+            else
+                vmovaps(t1, zmmword_ptr[a]);
+        });
+    }
+
+    void loadConst(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+
+            if (insn.op.imm.f == 0.0f) {
+                vmovaps(t1, zero);
+                return;
+            }
+
+            XmmReg r1;
+            Reg32 a;
+            mov(a, insn.op.imm.u);
+            vmovd(r1, a);
+            vbroadcastss(t1, r1);
+        });
+    }
+
+    void loadProp(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.dst];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (numInputs + 1)]);
+            vbroadcastss(t1, dword_ptr[a + sizeof(float) * insn.op.imm.u]);
+        });
+    }
+
+    // There is no signed to unsigned saturating pack, so clamp to [0, max] before narrowing.
+    void store8(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            ZmmReg r1;
+            Reg a;
+            vminps(r1, t1, zmmword_ptr[constants + ConstantIndex::float_255 * 64]);
+            vmaxps(r1, r1, zero);
+            vcvtps2dq(r1, r1);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            vpmovusdb(xmmword_ptr[a], r1);
+        });
+    }
+
+    void store16(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            int depth = insn.op.imm.u;
+            auto t1 = bytecodeRegs[insn.src1];
+            ZmmReg r1;
+            Reg a;
+            vminps(r1, t1, zmmword_ptr[constants + (ConstantIndex::float_255 + depth - 8) * 64]);
+            vmaxps(r1, r1, zero);
+            vcvtps2dq(r1, r1);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            vpmovusdw(ymmword_ptr[a], r1);
+        });
+    }
+
+    void storeF16(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            vcvtps2ph(ymmword_ptr[a], t1, 0);
+        });
+    }
+
+    void storeF32(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            vmovaps(zmmword_ptr[a], t1);
+        });
+    }
+
+#define BINARYOP(op) \
+do { \
+  auto t1 = bytecodeRegs[insn.src1]; \
+  auto t2 = bytecodeRegs[insn.src2]; \
+  auto t3 = bytecodeRegs[insn.dst]; \
+  op(t3, t1, t2); \
+} while (0)
+    void add(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            BINARYOP(vaddps);
+        });
+    }
+
+    void sub(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            BINARYOP(vsubps);
+        });
+    }
+
+    void mul(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            BINARYOP(vmulps);
+        });
+    }
+
+    void div(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            BINARYOP(vdivps);
+        });
+    }
+
+    void fma(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            FMAType type = static_cast<FMAType>(insn.op.imm.u);
+
+            // t1 + t2 * t3
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.src2];
+            auto t3 = bytecodeRegs[insn.src3];
+            auto t4 = bytecodeRegs[insn.dst];
+
+#define FMA3(op) \
+do { \
+  if (insn.dst == insn.src1) { \
+    op##231ps(t1, t2, t3); \
+  } else if (insn.dst == insn.src2) { \
+    op##132ps(t2, t1, t3); \
+  } else if (insn.dst == insn.src3) { \
+    op##132ps(t3, t1, t2); \
+  } else { \
+    vmovaps(t4, t1); \
+    op##231ps(t4, t2, t3); \
+  } \
+} while (0)
+            switch (type) {
+            case FMAType::FMADD: FMA3(vfmadd); break;
+            case FMAType::FMSUB: FMA3(vfmsub); break;
+            case FMAType::FNMADD: FMA3(vfnmadd); break;
+            case FMAType::FNMSUB: FMA3(vfnmsub); break;
+            }
+#undef FMA3
+        });
+    }
+
+    void max(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            BINARYOP(vmaxps);
+        });
+    }
+
+    void min(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            BINARYOP(vminps);
+        });
+    }
+#undef BINARYOP
+
+    void sqrt(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            vmaxps(t2, t1, zero);
+            vsqrtps(t2, t2);
+        });
+    }
+
+    // The floating point logic instructions need AVX512DQ, the integer ones only need AVX512F.
+    void abs(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            vpandd(t2, t1, zmmword_ptr[constants + ConstantIndex::absmask * 64]);
+        });
+    }
+
+    void neg(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            vpxord(t2, t1, zmmword_ptr[constants + ConstantIndex::negmask * 64]);
+        });
+    }
+
+    // Comparisons produce opmasks, a zero masked load of 1.0 turns them into the boolean result.
+    void not_(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            KReg k1;
+            vcmpps(k1, t1, zero, _CMP_LE_OS);
+            vmovaps_z(t2, k1, zmmword_ptr[constants + ConstantIndex::float_one * 64]);
+        });
+    }
+
+#define LOGICOP(op) \
+do { \
+  auto t1 = bytecodeRegs[insn.src1]; \
+  auto t2 = bytecodeRegs[insn.src2]; \
+  auto t3 = bytecodeRegs[insn.dst]; \
+  KReg k1, k2; \
+  vcmpps(k1, t1, zero, _CMP_NLE_US); \
+  vcmpps(k2, t2, zero, _CMP_NLE_US); \
+  op(k1, k1, k2); \
+  vmovaps_z(t3, k1, zmmword_ptr[constants + ConstantIndex::float_one * 64]); \
+} while (0)
+
+    void and_(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            LOGICOP(kandw);
+        });
+    }
+
+    void or_(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            LOGICOP(korw);
+        });
+    }
+
+    void xor_(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            LOGICOP(kxorw);
+        });
+    }
+#undef LOGICOP
+
+    void cmp(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.src2];
+            auto t3 = bytecodeRegs[insn.dst];
+            KReg k1;
+            vcmpps(k1, t1, t2, insn.op.imm.u);
+            vmovaps_z(t3, k1, zmmword_ptr[constants + ConstantIndex::float_one * 64]);
+        });
+    }
+
+    void ternary(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.src2];
+            auto t3 = bytecodeRegs[insn.src3];
+            auto t4 = bytecodeRegs[insn.dst];
+            KReg k1;
+            vcmpps(k1, t1, zero, _CMP_NLE_US);
+            vblendmps(t4, k1, t3, t2);
+        });
+    }
+
+    void exp_(ZmmReg x, ZmmReg one, Reg constants, bool fast)
+    {
+        ZmmReg fx, emm0, etmp, y, z;
+        KReg mask;
+        vminps(x, x, zmmword_ptr[constants + ConstantIndex::exp_hi * 64]);
+        vmaxps(x, x, zmmword_ptr[constants + ConstantIndex::exp_lo * 64]);
+        vmovaps(fx, zmmword_ptr[constants + ConstantIndex::log2e * 64]);
+        vfmadd213ps(fx, x, zmmword_ptr[constants + ConstantIndex::float_half * 64]);
+        vcvttps2dq(emm0, fx);
+        vcvtdq2ps(etmp, emm0);
+        vcmpps(mask, etmp, fx, _CMP_NLE_US);
+        vmovaps(fx, etmp);
+        vsubps(fx, mask, fx, one);
+        vfnmadd231ps(x, fx, zmmword_ptr[constants + ConstantIndex::exp_c1 * 64]);
+        vfnmadd231ps(x, fx, zmmword_ptr[constants + ConstantIndex::exp_c2 * 64]);
+        vmulps(z, x, x);
+        int first = fast ? ConstantIndex::exp_f0 : ConstantIndex::exp_p0;
+        int last = fast ? ConstantIndex::exp_f2 : ConstantIndex::exp_p5;
+        vmovaps(y, zmmword_ptr[constants + first * 64]);
+        for (int i = first + 1; i <= last; i++)
+            vfmadd213ps(y, x, zmmword_ptr[constants + i * 64]);
+        vfmadd213ps(y, z, x);
+        vaddps(y, y, one);
+        vcvttps2dq(emm0, fx);
+        vpaddd(emm0, emm0, zmmword_ptr[constants + ConstantIndex::x7F * 64]);
+        vpslld(emm0, emm0, 23);
+        vmulps(x, y, emm0);
+    }
+
+    void log_(ZmmReg x, ZmmReg zero, ZmmReg one, Reg constants, bool fast)
+    {
+        ZmmReg emm0, y, etmp, z;
+        KReg invalid_mask, mask;
+        vcmpps(invalid_mask, zero, x, _CMP_NLT_US);
+        vmaxps(x, x, zmmword_ptr[constants + ConstantIndex::min_norm_pos * 64]);
+        vpsrld(emm0, x, 23);
+        vpandd(x, x, zmmword_ptr[constants + ConstantIndex::inv_mant_mask * 64]);
+        vpord(x, x, zmmword_ptr[constants + ConstantIndex::float_half * 64]);
+        vpsubd(emm0, emm0, zmmword_ptr[constants + ConstantIndex::x7F * 64]);
+        vcvtdq2ps(emm0, emm0);
+        vaddps(emm0, emm0, one);
+        vcmpps(mask, x, zmmword_ptr[constants + ConstantIndex::sqrt_1_2 * 64], _CMP_LT_OS);
+        vmovaps_z(etmp, mask, x);
+        vsubps(x, x, one);
+        vsubps(emm0, mask, emm0, one);
+        vaddps(x, x, etmp);
+        vmulps(z, x, x);
+        int first = fast ? ConstantIndex::log_f0 : ConstantIndex::log_p0;
+        int last = fast ? ConstantIndex::log_f3 : ConstantIndex::log_p8;
+        vmovaps(y, zmmword_ptr[constants + first * 64]);
+        for (int i = first + 1; i <= last; i++)
+            vfmadd213ps(y, x, zmmword_ptr[constants + i * 64]);
+        vmulps(y, y, x);
+        vmulps(y, y, z);
+        vfmadd231ps(y, emm0, zmmword_ptr[constants + ConstantIndex::log_q1 * 64]);
+        vfnmadd231ps(y, z, zmmword_ptr[constants + ConstantIndex::float_half * 64]);
+        vaddps(x, x, y);
+        vfmadd231ps(x, emm0, zmmword_ptr[constants + ConstantIndex::log_q2 * 64]);
+        // all bits set (NaN) for the invalid lanes
+        vpternlogd(x, invalid_mask, x, x, 0xFF);
+    }
+
+    void exp(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            ZmmReg one;
+            vmovaps(one, zmmword_ptr[constants + ConstantIndex::float_one * 64]);
+            vmovaps(t2, t1);
+            exp_(t2, one, constants, insn.op.imm.u != 0);
+        });
+    }
+
+    void log(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            ZmmReg one;
+            vmovaps(one, zmmword_ptr[constants + ConstantIndex::float_one * 64]);
+            vmovaps(t2, t1);
+            log_(t2, zero, one, constants, insn.op.imm.u != 0);
+        });
+    }
+
+    void pow(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.src2];
+            auto t3 = bytecodeRegs[insn.dst];
+
+            ZmmReg r1, one;
+            vmovaps(one, zmmword_ptr[constants + ConstantIndex::float_one * 64]);
+            vmovaps(r1, t1);
+            log_(r1, zero, one, constants, insn.op.imm.u != 0);
+            vmulps(r1, r1, t2);
+            exp_(r1, one, constants, insn.op.imm.u != 0);
+            vmovaps(t3, r1);
+        });
+    }
+
+    void sincos_(bool issin, const ExprInstruction &insn, Reg constants, std::unordered_map<int, ZmmReg> &bytecodeRegs)
+    {
+        bool fast = insn.op.imm.u != 0;
+        auto x = bytecodeRegs[insn.src1];
+        auto y = bytecodeRegs[insn.dst];
+        ZmmReg t1, sign, t2, t3, t4;
+        // Remove sign
+        vmovaps(t1, zmmword_ptr[constants + ConstantIndex::absmask * 64]);
+        if (issin) {
+            vmovaps(sign, t1);
+            vpandnd(sign, sign, x);
+        } else {
+            vpxord(sign, sign, sign);
+        }
+        vpandd(t1, t1, x);
+        // Range reduction
+        vmovaps(t3, zmmword_ptr[constants + ConstantIndex::float_rintf * 64]);
+        vmulps(t2, t1, zmmword_ptr[constants + ConstantIndex::float_invpi * 64]);
+        vaddps(t2, t2, t3);
+        vpslld(t4, t2, 31);
+        vpxord(sign, sign, t4);
+        vsubps(t2, t2, t3);
+        vfnmadd231ps(t1, t2, zmmword_ptr[constants + ConstantIndex::float_pi1 * 64]);
+        vfnmadd231ps(t1, t2, zmmword_ptr[constants + ConstantIndex::float_pi2 * 64]);
+        vfnmadd231ps(t1, t2, zmmword_ptr[constants + ConstantIndex::float_pi3 * 64]);
+        vfnmadd231ps(t1, t2, zmmword_ptr[constants + ConstantIndex::float_pi4 * 64]);
+        if (issin) {
+            // Evaluate minimax polynomial for sin(x) in [-pi/2, pi/2] interval
+            // Y <- X + X * X^2 * (C3 + X^2 * (C5 + X^2 * (C7 + X^2 * C9))), the fast version stops at C7
+            int first = fast ? ConstantIndex::float_sinF3 : ConstantIndex::float_sinC3;
+            int last = fast ? ConstantIndex::float_sinF7 : ConstantIndex::float_sinC9;
+            vmulps(t2, t1, t1);
+            vmovaps(t3, zmmword_ptr[constants + (last - 1) * 64]);
+            vfmadd231ps(t3, t2, zmmword_ptr[constants + last * 64]);
+            for (int i = last - 2; i >= first; i--)
+                vfmadd213ps(t3, t2, zmmword_ptr[constants + i * 64]);
+            vmulps(t3, t3, t2);
+            vfmadd231ps(t1, t1, t3);
+        } else {
+            // Evaluate minimax polynomial for cos(x) in [-pi/2, pi/2] interval
+            // Y <- 1 + X^2 * (C2 + X^2 * (C4 + X^2 * (C6 + X^2 * C8))), the fast version stops at C6
+            int first = fast ? ConstantIndex::float_cosF2 : ConstantIndex::float_cosC2;
+            int last = fast ? ConstantIndex::float_cosF6 : ConstantIndex::float_cosC8;
+            vmulps(t2, t1, t1);
+            vmovaps(t1, zmmword_ptr[constants + (last - 1) * 64]);
+            vfmadd231ps(t1, t2, zmmword_ptr[constants + last * 64]);
+            for (int i = last - 2; i >= first; i--)
+                vfmadd213ps(t1, t2, zmmword_ptr[constants + i * 64]);
+            vfmadd213ps(t1, t2, zmmword_ptr[constants + ConstantIndex::float_one * 64]);
+        }
+        // Apply sign
+        vpxord(y, t1, sign);
+    }
+
+    void sin(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            sincos_(true, insn, constants, bytecodeRegs);
+        });
+    }
+
+    void cos(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            sincos_(false, insn, constants, bytecodeRegs);
+        });
+    }
+
+    void main(Reg regptrs, Reg regoffs, Reg niter)
+    {
+        std::unordered_map<int, ZmmReg> bytecodeRegs;
+        ZmmReg zero;
+        vpxord(zero, zero, zero);
+        Reg constants;
+        mov(constants, (uintptr_t)constData);
+
+        L("wloop");
+
+        for (const auto &f : deferred) {
+            f(regptrs, zero, constants, bytecodeRegs);
+        }
+
+#if UINTPTR_MAX > UINT32_MAX
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 4 + 1; i++) {
+            YmmReg r1, r2;
+            vmovdqu(r1, ymmword_ptr[regptrs + 32 * i]);
+            vmovdqu(r2, ymmword_ptr[regoffs + 32 * i]);
+            vpaddq(r1, r1, r2);
+            vmovdqu(ymmword_ptr[regptrs + 32 * i], r1);
+        }
+#else
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 8 + 1; i++) {
+            YmmReg r1, r2;
+            vmovdqu(r1, ymmword_ptr[regptrs + 32 * i]);
+            vmovdqu(r2, ymmword_ptr[regoffs + 32 * i]);
+            vpaddd(r1, r1, r2);
+            vmovdqu(ymmword_ptr[regptrs + 32 * i], r1);
+        }
+#endif
+
+        jit::sub(niter, 1);
+        jnz("wloop");
+    }
+
+public:
+    ExprCompiler512(int numInputs, int numOutputs) : cpuFeatures(*getCPUFeatures()), numInputs(numInputs), numOutputs(numOutputs) {}
+
+    int getStep() const override { return 16; }
+
+    std::pair<ExprProgram::ProcessLineProc, size_t> getCode() override
+    {
+        size_t size;
+        if (jit::GetCode(true) && (size = GetCodeSize())) {
+#ifdef VS_TARGET_OS_WINDOWS
+            void *ptr = VirtualAlloc(nullptr, size, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+            void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE, 0, 0);
+#endif
+            memcpy(ptr, jit::GetCode(true), size);
+            return {reinterpret_cast<ExprProgram::ProcessLineProc>(ptr), size};
+        }
+        return {nullptr, 0};
+    }
+#undef EMIT
+};
+
+constexpr ExprUnion ExprCompiler512::constData alignas(64)[66][16];
+
+class ExprIntCompiler {
+public:
+    virtual ~ExprIntCompiler() {}
+    virtual int getStep() const = 0;
+    virtual std::pair<ExprProgram::ProcessLineProc, size_t> getCode() = 0;
+};
+
+// Needs SSE4.1 for the zero extending byte loads and the unsigned max and min.
+class ExprIntCompiler128 : public ExprIntCompiler, private jitasm::function<void, ExprIntCompiler128, uint8_t *, const intptr_t *, intptr_t> {
+    typedef jitasm::function<void, ExprIntCompiler128, uint8_t *, const intptr_t *, intptr_t> jit;
+    friend struct jitasm::function<void, ExprIntCompiler128, uint8_t *, const intptr_t *, intptr_t>;
+    friend struct jitasm::function_cdecl<void, ExprIntCompiler128, uint8_t *, const intptr_t *, intptr_t>;
+
+    std::vector<ExprIntInstruction> code;
+    CPUFeatures cpuFeatures;
+    int numInputs;
+    int numOutputs;
+
+#define VEX1(op, arg1, arg2) \
+do { \
+  if (cpuFeatures.avx) \
+    v##op(arg1, arg2); \
+  else \
+    op(arg1, arg2); \
+} while (0)
+#define VEX1IMM(op, arg1, arg2, imm) \
+do { \
+  if (cpuFeatures.avx) { \
+    v##op(arg1, arg2, imm); \
+  } else if (arg1 == arg2) { \
+    op(arg2, imm); \
+  } else { \
+    movdqa(arg1, arg2); \
+    op(arg1, imm); \
+  } \
+} while (0)
+#define VEX2(op, arg1, arg2, arg3) \
+do { \
+  if (cpuFeatures.avx) { \
+    v##op(arg1, arg2, arg3); \
+  } else if (arg1 == arg2) { \
+    op(arg2, arg3); \
+  } else if (arg1 != arg3) { \
+    movdqa(arg1, arg2); \
+    op(arg1, arg3); \
+  } else { \
+    XmmReg tmp; \
+    movdqa(tmp, arg2); \
+    op(tmp, arg3); \
+    movdqa(arg1, tmp); \
+  } \
+} while (0)
+
+    void splat(XmmReg dst, int value)
+    {
+        Reg32 a;
+        mov(a, static_cast<uint32_t>(static_cast<uint16_t>(value)) * 0x10001);
+        VEX1(movd, dst, a);
+        if (cpuFeatures.avx)
+            vpshufd(dst, dst, 0);
+        else
+            pshufd(dst, dst, 0);
+    }
+
+    void emit(const ExprIntInstruction &insn, Reg regptrs, XmmReg zero, std::unordered_map<int, XmmReg> &regs)
+    {
+        // every result gets a new register so a destination that's also a source can't confuse the allocator
+        XmmReg d;
+        switch (insn.type) {
+        case ExprIntOpType::LOAD_U8: {
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.imm + 1)]);
+            VEX1(pmovzxbw, d, mmword_ptr[a + insn.dx]);
+            break;
+        }
+        case ExprIntOpType::LOAD_U16: {
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.imm + 1)]);
+            if (insn.dx)
+                VEX1(movdqu, d, xmmword_ptr[a + insn.dx * 2]);
+            else
+                VEX1(movdqa, d, xmmword_ptr[a]);
+            break;
+        }
+        case ExprIntOpType::CONSTANT:
+            if (insn.imm)
+                splat(d, insn.imm);
+            else
+                VEX1(movdqa, d, zero);
+            break;
+        case ExprIntOpType::STORE_U8: {
+            XmmReg r;
+            Reg a;
+            if (insn.isUnsigned) {
+                splat(r, 255);
+                VEX2(pminuw, r, regs[insn.src1], r);
+            } else {
+                VEX1(movdqa, r, regs[insn.src1]);
+            }
+            VEX2(packuswb, r, r, zero);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            VEX1(movq, mmword_ptr[a], r);
+            break;
+        }
+        case ExprIntOpType::STORE_U16: {
+            XmmReg r, limit;
+            Reg a;
+            if (insn.isUnsigned) {
+                VEX1(movdqa, r, regs[insn.src1]);
+                if (insn.imm < 16) {
+                    splat(limit, (1 << insn.imm) - 1);
+                    VEX2(pminuw, r, r, limit);
+                }
+            } else {
+                VEX2(pmaxsw, r, regs[insn.src1], zero);
+                if (insn.imm < 16) {
+                    splat(limit, (1 << insn.imm) - 1);
+                    VEX2(pminsw, r, r, limit);
+                }
+            }
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            VEX1(movdqa, xmmword_ptr[a], r);
+            break;
+        }
+        case ExprIntOpType::ADD: VEX2(paddw, d, regs[insn.src1], regs[insn.src2]); break;
+        case ExprIntOpType::SUB: VEX2(psubw, d, regs[insn.src1], regs[insn.src2]); break;
+        case ExprIntOpType::MUL: VEX2(pmullw, d, regs[insn.src1], regs[insn.src2]); break;
+        case ExprIntOpType::MAX:
+            if (insn.isUnsigned)
+                VEX2(pmaxuw, d, regs[insn.src1], regs[insn.src2]);
+            else
+                VEX2(pmaxsw, d, regs[insn.src1], regs[insn.src2]);
+            break;
+        case ExprIntOpType::MIN:
+            if (insn.isUnsigned)
+                VEX2(pminuw, d, regs[insn.src1], regs[insn.src2]);
+            else
+                VEX2(pminsw, d, regs[insn.src1], regs[insn.src2]);
+            break;
+        case ExprIntOpType::ABS: VEX1(pabsw, d, regs[insn.src1]); break;
+        case ExprIntOpType::NEG: VEX2(psubw, d, zero, regs[insn.src1]); break;
+        case ExprIntOpType::ROUND_SHIFT: {
+            // (x + half - 1 + ((x >> shift) & 1)) >> shift rounds ties to the even result
+            XmmReg t, c;
+            if (insn.isUnsigned)
+                VEX1IMM(psrlw, t, regs[insn.src1], insn.imm);
+            else
+                VEX1IMM(psraw, t, regs[insn.src1], insn.imm);
+            splat(c, 1);
+            VEX2(pand, t, t, c);
+            VEX2(paddw, t, t, regs[insn.src1]);
+            if (insn.imm > 1) {
+                splat(c, (1 << (insn.imm - 1)) - 1);
+                VEX2(paddw, t, t, c);
+            }
+            if (insn.isUnsigned)
+                VEX1IMM(psrlw, d, t, insn.imm);
+            else
+                VEX1IMM(psraw, d, t, insn.imm);
+            break;
+        }
+        }
+
+        if (insn.dst >= 0)
+            regs[insn.dst] = d;
+    }
+
+    void main(Reg regptrs, Reg regoffs, Reg niter)
+    {
+        std::unordered_map<int, XmmReg> regs;
+        XmmReg zero;
+        VEX2(pxor, zero, zero, zero);
+
+        L("wloop");
+
+        for (const auto &insn : code)
+            emit(insn, regptrs, zero, regs);
+
+#if UINTPTR_MAX > UINT32_MAX
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 2 + 1; i++) {
+            XmmReg r1, r2;
+            VEX1(movdqu, r1, xmmword_ptr[regptrs + 16 * i]);
+            VEX1(movdqu, r2, xmmword_ptr[regoffs + 16 * i]);
+            VEX2(paddq, r1, r1, r2);
+            VEX1(movdqu, xmmword_ptr[regptrs + 16 * i], r1);
+        }
+#else
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 4 + 1; i++) {
+            XmmReg r1, r2;
+            VEX1(movdqu, r1, xmmword_ptr[regptrs + 16 * i]);
+            VEX1(movdqu, r2, xmmword_ptr[regoffs + 16 * i]);
+            VEX2(paddd, r1, r1, r2);
+            VEX1(movdqu, xmmword_ptr[regptrs + 16 * i], r1);
+        }
+#endif
+
+        jit::sub(niter, 1);
+        jnz("wloop");
+    }
+
+public:
+    ExprIntCompiler128(std::vector<ExprIntInstruction> code, int numInputs, int numOutputs) : code(std::move(code)), cpuFeatures(*getCPUFeatures()), numInputs(numInputs), numOutputs(numOutputs) {}
+
+    int getStep() const override { return 8; }
+
+    std::pair<ExprProgram::ProcessLineProc, size_t> getCode() override
+    {
+        size_t size;
+        if (jit::GetCode() && (size = GetCodeSize())) {
+#ifdef VS_TARGET_OS_WINDOWS
+            void *ptr = VirtualAlloc(nullptr, size, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+            void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE, 0, 0);
+#endif
+            memcpy(ptr, jit::GetCode(), size);
+            return {reinterpret_cast<ExprProgram::ProcessLineProc>(ptr), size};
+        }
+        return {nullptr, 0};
+    }
+#undef VEX2
+#undef VEX1IMM
+#undef VEX1
+};
+
+class ExprIntCompiler256 : public ExprIntCompiler, private jitasm::function<void, ExprIntCompiler256, uint8_t *, const intptr_t *, intptr_t> {
+    typedef jitasm::function<void, ExprIntCompiler256, uint8_t *, const intptr_t *, intptr_t> jit;
+    friend struct jitasm::function<void, ExprIntCompiler256, uint8_t *, const intptr_t *, intptr_t>;
+    friend struct jitasm::function_cdecl<void, ExprIntCompiler256, uint8_t *, const intptr_t *, intptr_t>;
+
+    std::vector<ExprIntInstruction> code;
+    int numInputs;
+    int numOutputs;
+
+    void splat(YmmReg dst, int value)
+    {
+        XmmReg r;
+        Reg32 a;
+        mov(a, static_cast<uint32_t>(static_cast<uint16_t>(value)));
+        vmovd(r, a);
+        vpbroadcastw(dst, r);
+    }
+
+    void emit(const ExprIntInstruction &insn, Reg regptrs, YmmReg zero, std::unordered_map<int, YmmReg> &regs)
+    {
+        // every result gets a new register so a destination that's also a source can't confuse the allocator
+        YmmReg d;
+        switch (insn.type) {
+        case ExprIntOpType::LOAD_U8: {
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.imm + 1)]);
+            vpmovzxbw(d, xmmword_ptr[a + insn.dx]);
+            break;
+        }
+        case ExprIntOpType::LOAD_U16: {
+            Reg a;
+            mov(a, ptr[regptrs + sizeof(void *) * (insn.imm + 1)]);
+            if (insn.dx)
+                vmovdqu(d, ymmword_ptr[a + insn.dx * 2]);
+            else
+                vmovdqa(d, ymmword_ptr[a]);
+            break;
+        }
+        case ExprIntOpType::CONSTANT:
+            if (insn.imm)
+                splat(d, insn.imm);
+            else
+                vmovdqa(d, zero);
+            break;
+        case ExprIntOpType::STORE_U8: {
+            YmmReg r;
+            Reg a;
+            if (insn.isUnsigned) {
+                splat(r, 255);
+                vpminuw(r, regs[insn.src1], r);
+                vpackuswb(r, r, r);
+            } else {
+                vpackuswb(r, regs[insn.src1], regs[insn.src1]);
+            }
+            vpermq(r, r, 0x08);
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            vmovdqa(xmmword_ptr[a], r.as128());
+            break;
+        }
+        case ExprIntOpType::STORE_U16: {
+            YmmReg r, limit;
+            Reg a;
+            if (insn.isUnsigned) {
+                vmovdqa(r, regs[insn.src1]);
+                if (insn.imm < 16) {
+                    splat(limit, (1 << insn.imm) - 1);
+                    vpminuw(r, r, limit);
+                }
+            } else {
+                vpmaxsw(r, regs[insn.src1], zero);
+                if (insn.imm < 16) {
+                    splat(limit, (1 << insn.imm) - 1);
+                    vpminsw(r, r, limit);
+                }
+            }
+            mov(a, ptr[regptrs + sizeof(void *) * exprOutputSlot(numInputs, insn.output)]);
+            vmovdqa(ymmword_ptr[a], r);
+            break;
+        }
+        case ExprIntOpType::ADD: vpaddw(d, regs[insn.src1], regs[insn.src2]); break;
+        case ExprIntOpType::SUB: vpsubw(d, regs[insn.src1], regs[insn.src2]); break;
+        case ExprIntOpType::MUL: vpmullw(d, regs[insn.src1], regs[insn.src2]); break;
+        case ExprIntOpType::MAX:
+            if (insn.isUnsigned)
+                vpmaxuw(d, regs[insn.src1], regs[insn.src2]);
+            else
+                vpmaxsw(d, regs[insn.src1], regs[insn.src2]);
+            break;
+        case ExprIntOpType::MIN:
+            if (insn.isUnsigned)
+                vpminuw(d, regs[insn.src1], regs[insn.src2]);
+            else
+                vpminsw(d, regs[insn.src1], regs[insn.src2]);
+            break;
+        case ExprIntOpType::ABS: vpabsw(d, regs[insn.src1]); break;
+        case ExprIntOpType::NEG: vpsubw(d, zero, regs[insn.src1]); break;
+        case ExprIntOpType::ROUND_SHIFT: {
+            // (x + half - 1 + ((x >> shift) & 1)) >> shift rounds ties to the even result
+            YmmReg t, c;
+            if (insn.isUnsigned)
+                vpsrlw(t, regs[insn.src1], insn.imm);
+            else
+                vpsraw(t, regs[insn.src1], insn.imm);
+            splat(c, 1);
+            vpand(t, t, c);
+            vpaddw(t, t, regs[insn.src1]);
+            if (insn.imm > 1) {
+                splat(c, (1 << (insn.imm - 1)) - 1);
+                vpaddw(t, t, c);
+            }
+            if (insn.isUnsigned)
+                vpsrlw(d, t, insn.imm);
+            else
+                vpsraw(d, t, insn.imm);
+            break;
+        }
+        }
+
+        if (insn.dst >= 0)
+            regs[insn.dst] = d;
+    }
+
+    void main(Reg regptrs, Reg regoffs, Reg niter)
+    {
+        std::unordered_map<int, YmmReg> regs;
+        YmmReg zero;
+        vpxor(zero, zero, zero);
+
+        L("wloop");
+
+        for (const auto &insn : code)
+            emit(insn, regptrs, zero, regs);
+
+#if UINTPTR_MAX > UINT32_MAX
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 4 + 1; i++) {
+            YmmReg r1, r2;
+            vmovdqu(r1, ymmword_ptr[regptrs + 32 * i]);
+            vmovdqu(r2, ymmword_ptr[regoffs + 32 * i]);
+            vpaddq(r1, r1, r2);
+            vmovdqu(ymmword_ptr[regptrs + 32 * i], r1);
+        }
+#else
+        for (int i = 0; i < exprLastSlot(numInputs, numOutputs) / 8 + 1; i++) {
+            YmmReg r1, r2;
+            vmovdqu(r1, ymmword_ptr[regptrs + 32 * i]);
+            vmovdqu(r2, ymmword_ptr[regoffs + 32 * i]);
+            vpaddd(r1, r1, r2);
+            vmovdqu(ymmword_ptr[regptrs + 32 * i], r1);
+        }
+#endif
+
+        jit::sub(niter, 1);
+        jnz("wloop");
+    }
+
+public:
+    ExprIntCompiler256(std::vector<ExprIntInstruction> code, int numInputs, int numOutputs) : code(std::move(code)), numInputs(numInputs), numOutputs(numOutputs) {}
+
+    int getStep() const override { return 16; }
+
+    std::pair<ExprProgram::ProcessLineProc, size_t> getCode() override
+    {
+        size_t size;
+        if (jit::GetCode(true) && (size = GetCodeSize())) {
+#ifdef VS_TARGET_OS_WINDOWS
+            void *ptr = VirtualAlloc(nullptr, size, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+            void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE, 0, 0);
+#endif
+            memcpy(ptr, jit::GetCode(true), size);
+            return {reinterpret_cast<ExprProgram::ProcessLineProc>(ptr), size};
+        }
+        return {nullptr, 0};
+    }
+};
+
+// numInputs counts every pointer slot read through the input pointers, the
+// relative row slots included. The frame property pointer follows them.
+std::unique_ptr<ExprCompiler> make_compiler(int numInputs, int numOutputs, int cpulevel)
+{
+    if (getCPUFeatures()->avx512_f && cpulevel >= VS_CPU_LEVEL_AVX512)
+        return std::unique_ptr<ExprCompiler>(new ExprCompiler512(numInputs, numOutputs));
+    else if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
+        return std::unique_ptr<ExprCompiler>(new ExprCompiler256(numInputs, numOutputs));
+    else
+        return std::unique_ptr<ExprCompiler>(new ExprCompiler128(numInputs, numOutputs));
+}
+
+// Returns null where the float code is at least as wide, AVX-512 already
+// processes 16 pixels per iteration.
+std::unique_ptr<ExprIntCompiler> make_int_compiler(std::vector<ExprIntInstruction> code, int numInputs, int numOutputs, int cpulevel)
+{
+    if (getCPUFeatures()->avx512_f && cpulevel >= VS_CPU_LEVEL_AVX512)
+        return nullptr;
+    else if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
+        return std::unique_ptr<ExprIntCompiler>(new ExprIntCompiler256(std::move(code), numInputs, numOutputs));
+    else if (getCPUFeatures()->sse4_1)
+        return std::unique_ptr<ExprIntCompiler>(new ExprIntCompiler128(std::move(code), numInputs, numOutputs));
+    else
+        return nullptr;
+}
+#endif
+
+// Evaluates the bytecode for blocks of up to blockSize pixels at a time. Every
+// instruction is a simple loop over the block, which the compiler vectorizes
+// on targets without a JIT.
+class ExprInterpreter {
+public:
+    static constexpr int blockSize = 64;
+private:
+    const ExprInstruction *bytecode;
+    size_t numInsns;
+    std::vector<float> registers;
+
+    template <class T>
+    static T clamp_int(float x, int depth = std::numeric_limits<T>::digits)
+    {
+        float maxval = static_cast<float>((1U << depth) - 1);
+        return static_cast<T>(std::lrint(std::min(std::max(x, static_cast<float>(std::numeric_limits<T>::min())), maxval)));
+    }
+
+    static float bool2float(bool x) { return x ? 1.0f : 0.0f; }
+    static bool float2bool(float x) { return x > 0.0f; }
+public:
+    ExprInterpreter(const ExprInstruction *bytecode, size_t numInsns) : bytecode(bytecode), numInsns(numInsns)
+    {
+        int maxreg = 0;
+        for (size_t i = 0; i < numInsns; ++i) {
+            maxreg = std::max(maxreg, bytecode[i].dst);
+        }
+        registers.resize((maxreg + 1) * blockSize);
+    }
+
+    // Processes the n <= blockSize pixels starting at x. dstp holds one row per output.
+    void eval(const uint8_t * const *srcp, uint8_t * const *dstp, const float *props, int x, int n)
+    {
+        for (size_t k = 0; k < numInsns; ++k) {
+            const ExprInstruction &insn = bytecode[k];
+            float *dst = registers.data() + insn.dst * blockSize;
+            const float *src1 = insn.src1 >= 0 ? registers.data() + insn.src1 * blockSize : nullptr;
+            const float *src2 = insn.src2 >= 0 ? registers.data() + insn.src2 * blockSize : nullptr;
+            const float *src3 = insn.src3 >= 0 ? registers.data() + insn.src3 * blockSize : nullptr;
+
+#define EXPR_LOOP(...) for (int i = 0; i < n; ++i) { __VA_ARGS__; }
+#define SRC1 src1[i]
+#define SRC2 src2[i]
+#define SRC3 src3[i]
+#define DST dst[i]
+            switch (insn.op.type) {
+            case ExprOpType::MEM_LOAD_U8: EXPR_LOOP(DST = reinterpret_cast<const uint8_t *>(srcp[insn.op.imm.u])[x + i + insn.op.dx]); break;
+            case ExprOpType::MEM_LOAD_U16: EXPR_LOOP(DST = reinterpret_cast<const uint16_t *>(srcp[insn.op.imm.u])[x + i + insn.op.dx]); break;
+            case ExprOpType::MEM_LOAD_F16: EXPR_LOOP(DST = 0); break;
+            case ExprOpType::MEM_LOAD_F32: EXPR_LOOP(DST = reinterpret_cast<const float *>(srcp[insn.op.imm.u])[x + i + insn.op.dx]); break;
+            case ExprOpType::CONSTANT: EXPR_LOOP(DST = insn.op.imm.f); break;
+            case ExprOpType::PROP_LOAD: EXPR_LOOP(DST = props[insn.op.imm.u]); break;
+            case ExprOpType::ADD: EXPR_LOOP(DST = SRC1 + SRC2); break;
+            case ExprOpType::SUB: EXPR_LOOP(DST = SRC1 - SRC2); break;
+            case ExprOpType::MUL: EXPR_LOOP(DST = SRC1 * SRC2); break;
+            case ExprOpType::DIV: EXPR_LOOP(DST = SRC1 / SRC2); break;
+            case ExprOpType::FMA:
+                switch (static_cast<FMAType>(insn.op.imm.u)) {
+                case FMAType::FMADD: EXPR_LOOP(DST = SRC2 * SRC3 + SRC1); break;
+                case FMAType::FMSUB: EXPR_LOOP(DST = SRC2 * SRC3 - SRC1); break;
+                case FMAType::FNMADD: EXPR_LOOP(DST = -(SRC2 * SRC3) + SRC1); break;
+                case FMAType::FNMSUB: EXPR_LOOP(DST = -(SRC2 * SRC3) - SRC1); break;
+                };
+                break;
+            case ExprOpType::MAX: EXPR_LOOP(DST = std::max(SRC1, SRC2)); break;
+            case ExprOpType::MIN: EXPR_LOOP(DST = std::min(SRC1, SRC2)); break;
+            case ExprOpType::EXP: EXPR_LOOP(DST = std::exp(SRC1)); break;
+            case ExprOpType::LOG: EXPR_LOOP(DST = std::log(SRC1)); break;
+            case ExprOpType::POW: EXPR_LOOP(DST = std::pow(SRC1, SRC2)); break;
+            case ExprOpType::SQRT: EXPR_LOOP(DST = std::sqrt(SRC1)); break;
+            case ExprOpType::SIN: EXPR_LOOP(DST = std::sin(SRC1)); break;
+            case ExprOpType::COS: EXPR_LOOP(DST = std::cos(SRC1)); break;
+            case ExprOpType::ABS: EXPR_LOOP(DST = std::fabs(SRC1)); break;
+            case ExprOpType::NEG: EXPR_LOOP(DST = -SRC1); break;
+            case ExprOpType::CMP:
+                switch (static_cast<ComparisonType>(insn.op.imm.u)) {
+                case ComparisonType::EQ: EXPR_LOOP(DST = bool2float(SRC1 == SRC2)); break;
+                case ComparisonType::LT: EXPR_LOOP(DST = bool2float(SRC1 < SRC2)); break;
+                case ComparisonType::LE: EXPR_LOOP(DST = bool2float(SRC1 <= SRC2)); break;
+                case ComparisonType::NEQ: EXPR_LOOP(DST = bool2float(SRC1 != SRC2)); break;
+                case ComparisonType::NLT: EXPR_LOOP(DST = bool2float(SRC1 >= SRC2)); break;
+                case ComparisonType::NLE: EXPR_LOOP(DST = bool2float(SRC1 > SRC2)); break;
+                }
+                break;
+            case ExprOpType::TERNARY: EXPR_LOOP(DST = float2bool(SRC1) ? SRC2 : SRC3); break;
+            case ExprOpType::AND: EXPR_LOOP(DST = bool2float((float2bool(SRC1) && float2bool(SRC2)))); break;
+            case ExprOpType::OR:  EXPR_LOOP(DST = bool2float((float2bool(SRC1) || float2bool(SRC2)))); break;
+            case ExprOpType::XOR: EXPR_LOOP(DST = bool2float((float2bool(SRC1) != float2bool(SRC2)))); break;
+            case ExprOpType::NOT: EXPR_LOOP(DST = bool2float(!float2bool(SRC1))); break;
+            case ExprOpType::MEM_STORE_U8:  EXPR_LOOP(reinterpret_cast<uint8_t *>(dstp[insn.output])[x + i] = clamp_int<uint8_t>(SRC1)); break;
+            case ExprOpType::MEM_STORE_U16: EXPR_LOOP(reinterpret_cast<uint16_t *>(dstp[insn.output])[x + i] = clamp_int<uint16_t>(SRC1, insn.op.imm.u)); break;
+            case ExprOpType::MEM_STORE_F16: EXPR_LOOP(reinterpret_cast<uint16_t *>(dstp[insn.output])[x + i] = 0); break;
+            case ExprOpType::MEM_STORE_F32: EXPR_LOOP(reinterpret_cast<float *>(dstp[insn.output])[x + i] = SRC1); break;
+            default: fprintf(stderr, "%s", "illegal opcode\n"); std::terminate(); return;
+            }
+#undef DST
+#undef SRC3
+#undef SRC2
+#undef SRC1
+#undef EXPR_LOOP
+        }
+    }
+};
+
+struct ExpressionTreeNode {
+    ExpressionTreeNode *parent;
+    ExpressionTreeNode *left;
+    ExpressionTreeNode *right;
+    ExprOp op;
+    int valueNum;
+
+    explicit ExpressionTreeNode(ExprOp op) : parent(), left(), right(), op(op), valueNum(-1) {}
+
+    void setLeft(ExpressionTreeNode *node)
     {
         if (left)
             left->parent = nullptr;
@@ -2066,7 +3371,7 @@ bool equalSubTree(const ExpressionTreeNode *lhs, const ExpressionTreeNode *rhs)
 {
     if (lhs->valueNum >= 0 && rhs->valueNum >= 0)
         return lhs->valueNum == rhs->valueNum;
-    if (lhs->op.type != rhs->op.type || lhs->op.imm.u != rhs->op.imm.u)
+    if (lhs->op != rhs->op)
         return false;
     if (!!lhs->left != !!rhs->left || !!lhs->right != !!rhs->right)
         return false;
@@ -2099,7 +3404,7 @@ std::vector<std::string> tokenize(const std::string &expr)
     return tokens;
 }
 
-ExprOp decodeToken(const std::string &token)
+ExprOp decodeToken(const std::string &token, std::vector<ExprPropRef> &props)
 {
     static const std::unordered_map<std::string, ExprOp> simple{
         { "+",    { ExprOpType::ADD } },
@@ -2129,11 +3434,28 @@ ExprOp decodeToken(const std::string &token)
         { "swap", { ExprOpType::SWAP, 1 } },
     };
 
+    auto clipIndex = [](char c) { return c >= 'x' ? c - 'x' : c - 'a' + 3; };
+
     auto it = simple.find(token);
     if (it != simple.end()) {
         return it->second;
     } else if (token.size() == 1 && token[0] >= 'a' && token[0] <= 'z') {
-        return{ ExprOpType::MEM_LOAD_U8, token[0] >= 'x' ? token[0] - 'x' : token[0] - 'a' + 3 };
+        return{ ExprOpType::MEM_LOAD_U8, clipIndex(token[0]) };
+    } else if (token.size() > 1 && token[0] >= 'a' && token[0] <= 'z' && token[1] == '[') {
+        ExprOp op{ ExprOpType::MEM_LOAD_U8, clipIndex(token[0]) };
+        char comma = 0, close = 0;
+        std::string s;
+        std::istringstream offStream(token.substr(2));
+        offStream.imbue(std::locale::classic());
+        if (!(offStream >> op.dx >> comma >> op.dy >> close) || comma != ',' || close != ']' || offStream >> s)
+            throw std::runtime_error("illegal relative pixel access: " + token);
+        return op;
+    } else if (token.size() > 2 && token[0] >= 'a' && token[0] <= 'z' && token[1] == '.') {
+        ExprPropRef ref{ clipIndex(token[0]), token.substr(2) };
+        auto pit = std::find_if(props.begin(), props.end(), [&](const ExprPropRef &p) { return p.clip == ref.clip && p.key == ref.key; });
+        if (pit == props.end())
+            pit = props.insert(props.end(), ref);
+        return{ ExprOpType::PROP_LOAD, static_cast<int>(pit - props.begin()) };
     } else if (token.substr(0, 3) == "dup" || token.substr(0, 4) == "swap") {
         size_t prefix = token[0] == 'd' ? 3 : 4;
         size_t count = 0;
@@ -2161,7 +3483,7 @@ ExprOp decodeToken(const std::string &token)
     }
 }
 
-ExpressionTree parseExpr(const std::string &expr, const VSVideoInfo * const *vi, int numInputs)
+ExpressionTree parseExpr(const std::string &expr, const VSVideoInfo * const *vi, int numInputs, std::vector<ExprPropRef> &props)
 {
     constexpr unsigned char numOperands[] = {
         0, // MEM_LOAD_U8
@@ -2169,6 +3491,7 @@ ExpressionTree parseExpr(const std::string &expr, const VSVideoInfo * const *vi,
         0, // MEM_LOAD_F16
         0, // MEM_LOAD_F32
         0, // CONSTANT
+        0, // PROP_LOAD
         0, // MEM_STORE_U8
         0, // MEM_STORE_U16
         0, // MEM_STORE_F16
@@ -2206,11 +3529,13 @@ ExpressionTree parseExpr(const std::string &expr, const VSVideoInfo * const *vi,
     std::vector<ExpressionTreeNode *> stack;
 
     for (const std::string &tok : tokens) {
-        ExprOp op = decodeToken(tok);
+        ExprOp op = decodeToken(tok, props);
 
         // Check validity.
         if (op.type == ExprOpType::MEM_LOAD_U8 && op.imm.i >= numInputs)
             throw std::runtime_error("reference to undefined clip: " + tok);
+        if (op.type == ExprOpType::PROP_LOAD && props[op.imm.u].clip >= numInputs)
+            throw std::runtime_error("reference to undefined clip: " + tok);
         if ((op.type == ExprOpType::DUP || op.type == ExprOpType::SWAP) && op.imm.u >= stack.size())
             throw std::runtime_error("insufficient values on stack: " + tok);
         if (stack.size() < numOperands[static_cast<size_t>(op.type)])
@@ -2290,6 +3615,7 @@ bool isConstantExpr(const ExpressionTreeNode &node)
     case ExprOpType::MEM_LOAD_U16:
     case ExprOpType::MEM_LOAD_F16:
     case ExprOpType::MEM_LOAD_F32:
+    case ExprOpType::PROP_LOAD:
         return false;
     case ExprOpType::CONSTANT:
         return true;
@@ -2378,6 +3704,16 @@ bool isInteger(float x)
     return std::floor(x) == x;
 }
 
+// Stops counting at limit so asking about a huge subtree is cheap.
+size_t countNodes(const ExpressionTreeNode *node, size_t limit)
+{
+    if (!node || !limit)
+        return 0;
+
+    size_t count = 1 + countNodes(node->left, limit - 1);
+    return count + countNodes(node->right, limit - std::min(count, limit));
+}
+
 void replaceNode(ExpressionTreeNode &node, const ExpressionTreeNode &replacement)
 {
     node.op = replacement.op;
@@ -2391,31 +3727,42 @@ void swapNodeContents(ExpressionTreeNode &lhs, ExpressionTreeNode &rhs)
     std::swap(lhs.parent, rhs.parent);
 }
 
-void applyValueNumbering(ExpressionTree &tree)
+// Numbers the nodes of several trees together so subtrees shared between
+// them get the same value.
+void applyValueNumbering(ExpressionTree *trees, int numTrees)
 {
     std::vector<ExpressionTreeNode *> numbered;
     int valueNum = 0;
 
-    tree.getRoot()->postorder([&](ExpressionTreeNode &node)
-    {
-        node.valueNum = -1;
-    });
-
-    tree.getRoot()->postorder([&](ExpressionTreeNode &node)
-    {
-        if (node.op.type == ExprOpType::MUX)
-            return;
+    for (int i = 0; i < numTrees; i++) {
+        trees[i].getRoot()->postorder([&](ExpressionTreeNode &node)
+        {
+            node.valueNum = -1;
+        });
+    }
 
-        for (ExpressionTreeNode *testnode : numbered) {
-            if (equalSubTree(&node, testnode)) {
-                node.valueNum = testnode->valueNum;
+    for (int i = 0; i < numTrees; i++) {
+        trees[i].getRoot()->postorder([&](ExpressionTreeNode &node)
+        {
+            if (node.op.type == ExprOpType::MUX)
                 return;
+
+            for (ExpressionTreeNode *testnode : numbered) {
+                if (equalSubTree(&node, testnode)) {
+                    node.valueNum = testnode->valueNum;
+                    return;
+                }
             }
-        }
 
-        node.valueNum = valueNum++;
-        numbered.push_back(&node);
-    });
+            node.valueNum = valueNum++;
+            numbered.push_back(&node);
+        });
+    }
+}
+
+void applyValueNumbering(ExpressionTree &tree)
+{
+    applyValueNumbering(&tree, 1);
 }
 
 ExpressionTreeNode *emitIntegerPow(ExpressionTree &tree, const ExpressionTreeNode &node, int exponent)
@@ -2456,12 +3803,12 @@ class ExponentMap {
             // Ordering criteria for each category:
             //
             // constants: order by value
-            // memory: order by variable name
+            // memory: order by variable name and offset
             // other: order by value number (unstable)
             if (lhsCategory == 2)
                 return lhsNode->op.imm.f < rhsNode->op.imm.f;
             else if (lhsCategory == 1)
-                return lhsNode->op.imm.u < rhsNode->op.imm.f;
+                return std::make_tuple(lhsNode->op.imm.u, lhsNode->op.dy, lhsNode->op.dx) < std::make_tuple(rhsNode->op.imm.u, rhsNode->op.dy, rhsNode->op.dx);
             else
                 return lhs.first < rhs.first;
         };
@@ -3105,8 +4452,8 @@ bool applyStrengthReduction(ExpressionTree &tree)
             changed = true;
         }
 
-        // x * 2 = x + x
-        if (node.op == ExprOpType::MUL && isConstant(*node.right, 2.0f) && (!node.parent || node.parent->op != ExprOpType::ADD)) {
+        // x * 2 = x + x, nested the copies would make the tree grow exponentially so only small x are copied
+        if (node.op == ExprOpType::MUL && isConstant(*node.right, 2.0f) && (!node.parent || node.parent->op != ExprOpType::ADD) && countNodes(node.left, 17) <= 16) {
             ExpressionTreeNode *replacement = tree.clone(node.left);
             node.op = ExprOpType::ADD;
             replaceNode(*node.right, *replacement);
@@ -3170,6 +4517,16 @@ bool applyStrengthReduction(ExpressionTree &tree)
             changed = true;
         }
 
+        // x ** (n / 4) = sqrt(sqrt(x ** n)), only for small n so x ** n stays in range for 16 bit inputs
+        if (node.op == ExprOpType::POW && isConstant(*node.right) && !isInteger(node.right->op.imm.f * 2.0f) && isInteger(node.right->op.imm.f * 4.0f) && std::fabs(node.right->op.imm.f) < 2.0f) {
+            ExpressionTreeNode *dup = tree.clone(&node);
+            replaceNode(node, ExpressionTreeNode{ ExprOpType::SQRT });
+            node.setLeft(tree.makeNode({ ExprOpType::SQRT }));
+            node.left->setLeft(dup);
+            node.left->left->right->op.imm.f *= 4.0f;
+            changed = true;
+        }
+
         // x ** (n / 2) = sqrt(x ** n)
         if (node.op == ExprOpType::POW && isConstant(*node.right) && !isInteger(node.right->op.imm.f) && isInteger(node.right->op.imm.f * 2.0f)) {
             ExpressionTreeNode *dup = tree.clone(&node);
@@ -3280,8 +4637,16 @@ bool applyOpFusion(ExpressionTree &tree)
 void renameRegisters(std::vector<ExprInstruction> &code)
 {
     std::unordered_map<int, int> table;
+    std::unordered_map<int, size_t> lastUse;
     std::set<int> freeList;
 
+    for (size_t i = 0; i < code.size(); ++i) {
+        for (int reg : { code[i].src1, code[i].src2, code[i].src3 }) {
+            if (reg >= 0)
+                lastUse[reg] = i;
+        }
+    }
+
     for (size_t i = 0; i < code.size(); ++i) {
         ExprInstruction &insn = code[i];
         int origRegs[4] = { insn.dst, insn.src1, insn.src2, insn.src3 };
@@ -3295,17 +4660,7 @@ void renameRegisters(std::vector<ExprInstruction> &code)
             if (it != table.end())
                 renamed[n] = it->second;
 
-            bool dead = true;
-
-            for (size_t j = i + 1; j < code.size(); ++j) {
-                const ExprInstruction &insn2 = code[j];
-                if (insn2.src1 == origRegs[n] || insn2.src2 == origRegs[n] || insn2.src3 == origRegs[n]) {
-                    dead = false;
-                    break;
-                }
-            }
-
-            if (dead)
+            if (lastUse[origRegs[n]] == i)
                 freeList.insert(renamed[n]);
         }
 
@@ -3323,73 +4678,545 @@ void renameRegisters(std::vector<ExprInstruction> &code)
     }
 }
 
-std::vector<ExprInstruction> compile(ExpressionTree &tree, const VSVideoFormat &format)
+// Generated expressions can have thousands of nodes. Every optimization round
+// numbers and traverses the whole tree and nested sums and products can need
+// a round per level so trees past the size limit skip the additive and
+// multiplicative analysis and stop after a fixed number of rounds. The result
+// is still correct, only less optimized.
+constexpr size_t exprLargeTreeNodes = 1024;
+constexpr int exprLargeTreeRounds = 16;
+
+// Compiles one tree per output into a single program. Every tree is optimized
+// on its own and then numbered together with the others so the loads and
+// subexpressions they have in common are only evaluated once. With fast set
+// the transcendental functions use the lower degree approximations.
+std::vector<ExprInstruction> compile(ExpressionTree *trees, int numOutputs, const VSVideoFormat &format, bool fast)
 {
     std::vector<ExprInstruction> code;
     std::unordered_set<int> found;
 
-    if (!tree.getRoot())
-        return code;
+    for (int i = 0; i < numOutputs; i++) {
+        if (!trees[i].getRoot())
+            return code;
+    }
+
+    for (int i = 0; i < numOutputs; i++) {
+        ExpressionTree &tree = trees[i];
+        bool large = countNodes(tree.getRoot(), exprLargeTreeNodes + 1) > exprLargeTreeNodes;
+        int maxRounds = large ? exprLargeTreeRounds : std::numeric_limits<int>::max();
+
+        for (int round = 0; round < maxRounds; round++) {
+            if (!applyLocalOptimizations(tree) && (large || !applyAlgebraicOptimizations(tree)) && !applyComparisonOptimizations(tree))
+                break;
+        }
+
+        for (int round = 0; round < maxRounds; round++) {
+            if (!applyAlgebraicCleanup(tree) && !applyStrengthReduction(tree) && !applyOpFusion(tree))
+                break;
+        }
+
+        // The approximation is selected by the immediate which these operations don't use otherwise.
+        if (fast) {
+            tree.getRoot()->postorder([](ExpressionTreeNode &node)
+            {
+                if (node.op.type == ExprOpType::EXP || node.op.type == ExprOpType::LOG || node.op.type == ExprOpType::POW || node.op.type == ExprOpType::SIN || node.op.type == ExprOpType::COS)
+                    node.op.imm.u = 1;
+            });
+        }
+    }
+
+    applyValueNumbering(trees, numOutputs);
+
+    auto emit = [&](ExpressionTreeNode &node)
+    {
+        if (node.op.type == ExprOpType::MUX)
+            return;
+        if (found.find(node.valueNum) != found.end())
+            return;
+
+        ExprInstruction opcode(node.op);
+        opcode.dst = node.valueNum;
+
+        if (node.left) {
+            assert(node.left->valueNum >= 0);
+            opcode.src1 = node.left->valueNum;
+        }
+        if (node.right) {
+            if (node.right->op.type == ExprOpType::MUX) {
+                assert(node.right->left->valueNum >= 0);
+                assert(node.right->right->valueNum >= 0);
+                opcode.src2 = node.right->left->valueNum;
+                opcode.src3 = node.right->right->valueNum;
+            } else {
+                assert(node.right->valueNum >= 0);
+                opcode.src2 = node.right->valueNum;
+            }
+        }
+
+        code.push_back(opcode);
+        found.insert(node.valueNum);
+    };
+
+    ExprInstruction store(ExprOpType::MEM_STORE_U8);
+
+    if (format.sampleType == stInteger && format.bytesPerSample == 1)
+        store.op.type = ExprOpType::MEM_STORE_U8;
+    else if (format.sampleType == stInteger && format.bytesPerSample == 2)
+        store.op.type = ExprOpType::MEM_STORE_U16;
+    else if (format.sampleType == stFloat && format.bytesPerSample == 2)
+        store.op.type = ExprOpType::MEM_STORE_F16;
+    else if (format.sampleType == stFloat && format.bytesPerSample == 4)
+        store.op.type = ExprOpType::MEM_STORE_F32;
+
+    if (store.op.type == ExprOpType::MEM_STORE_U16)
+        store.op.imm.u = format.bitsPerSample;
+
+    for (int i = 0; i < numOutputs; i++) {
+        trees[i].getRoot()->postorder(emit);
+        store.src1 = trees[i].getRoot()->valueNum;
+        store.output = i;
+        code.push_back(store);
+    }
+
+    renameRegisters(code);
+    return code;
+}
+
+std::vector<ExprInstruction> compile(ExpressionTree &tree, const VSVideoFormat &format, bool fast)
+{
+    return compile(&tree, 1, format, fast);
+}
+
+// Moves loads with a pixel offset to their own pointer slots after the inputs,
+// one slot for every distinct vertical offset of a clip.
+void assignRowSlots(std::vector<ExprInstruction> &code, int numInputs, std::vector<ExprRowSource> &rows)
+{
+    for (ExprInstruction &insn : code) {
+        int bytesPerSample;
+
+        switch (insn.op.type) {
+        case ExprOpType::MEM_LOAD_U8: bytesPerSample = 1; break;
+        case ExprOpType::MEM_LOAD_U16: bytesPerSample = 2; break;
+        case ExprOpType::MEM_LOAD_F16: bytesPerSample = 2; break;
+        case ExprOpType::MEM_LOAD_F32: bytesPerSample = 4; break;
+        default: continue;
+        }
+
+        if (!insn.op.dx && !insn.op.dy)
+            continue;
+
+        int clip = insn.op.imm.i;
+        auto it = std::find_if(rows.begin(), rows.end(), [&](const ExprRowSource &r) { return r.clip == clip && r.dy == insn.op.dy; });
+        if (it == rows.end()) {
+            if (rows.size() >= MAX_EXPR_ROWS)
+                throw std::runtime_error("too many distinct relative pixel rows");
+            it = rows.insert(rows.end(), { clip, insn.op.dy, 0, bytesPerSample });
+        }
+
+        it->pad = std::max(it->pad, std::abs(insn.op.dx));
+        insn.op.imm.u = numInputs + static_cast<unsigned>(it - rows.begin());
+    }
+}
+
+// Compiled programs shared between Expr instances. The bytecode is the
+// linearized optimized tree and its loads and store encode the input and
+// output formats, so together with the cpu level it identifies the generated
+// code. Entries expire when the last instance using them is freed.
+class ExprProgramCache {
+    std::mutex lock;
+    std::unordered_map<std::string, std::weak_ptr<const ExprProgram>> programs;
+public:
+    std::shared_ptr<const ExprProgram> find(const std::string &key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = programs.find(key);
+        return it != programs.end() ? it->second.lock() : nullptr;
+    }
+
+    // Returns the already cached program if another instance got there first.
+    std::shared_ptr<const ExprProgram> insert(const std::string &key, std::shared_ptr<const ExprProgram> program)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto it = programs.begin(); it != programs.end();) {
+            if (it->second.expired())
+                it = programs.erase(it);
+            else
+                ++it;
+        }
+
+        auto &entry = programs[key];
+        if (auto existing = entry.lock())
+            return existing;
+        entry = program;
+        return program;
+    }
+};
+
+ExprProgramCache &getProgramCache()
+{
+    static ExprProgramCache cache;
+    return cache;
+}
+
+// The range a value can have when a program is lowered to 16-bit integers.
+// Fractions are constants that aren't integers, they're only usable as a
+// power of two multiplier. Rounded values are the result of such a
+// multiplication and may only go through max and min before being stored,
+// since rounding commutes with those but not with anything else.
+struct ExprIntRange {
+    int64_t lo;
+    int64_t hi;
+    bool rounded;
+    bool fraction;
+    float value;
+};
+
+static bool fitsSigned16(int64_t lo, int64_t hi)
+{
+    return lo >= INT16_MIN && hi <= INT16_MAX;
+}
+
+static bool fitsUnsigned16(int64_t lo, int64_t hi)
+{
+    return lo >= 0 && hi <= UINT16_MAX;
+}
+
+// Returns k for 1 / (1 << k) and 0 for everything else.
+static int inversePowerOfTwo(float x)
+{
+    int e;
+    if (x <= 0.0f || std::frexp(x, &e) != 0.5f || e > 0 || e < -14)
+        return 0;
+    return 1 - e;
+}
+
+static int64_t floorShift(int64_t x, int k)
+{
+    return x >= 0 ? x >> k : -((-x + (INT64_C(1) << k) - 1) >> k);
+}
+
+// Lowers programs that only do exact integer arithmetic on 8 and 16-bit
+// samples to 16-bit lanes. Every value must be an integer that fits a 16-bit
+// lane, signed or unsigned, for all possible inputs so the stored result is
+// bit identical to the float code. Loads of 16-bit clips are assumed to use
+// all 16 bits since nothing stops a filter from exceeding the nominal depth.
+bool lowerToInteger(const std::vector<ExprInstruction> &code, std::vector<ExprIntInstruction> &intCode)
+{
+    std::unordered_map<int, ExprIntRange> ranges;
+    int nextTemp = 0;
+    for (const ExprInstruction &insn : code)
+        nextTemp = std::max({ nextTemp, insn.dst + 1, insn.src1 + 1, insn.src2 + 1, insn.src3 + 1 });
+
+    auto push = [&](ExprIntOpType type, int dst, int src1, int src2, int imm, bool isUnsigned) {
+        intCode.push_back({ type, imm, 0, dst, src1, src2, 0, isUnsigned });
+    };
+
+    // integer results of operations that don't care about signedness
+    auto setExact = [&](int dst, int64_t lo, int64_t hi) {
+        if (!fitsSigned16(lo, hi) && !fitsUnsigned16(lo, hi))
+            return false;
+        ranges[dst] = { lo, hi, false, false, 0.0f };
+        return true;
+    };
+
+    auto isExact = [](const ExprIntRange &r) { return !r.rounded && !r.fraction; };
+
+    intCode.clear();
+
+    for (const ExprInstruction &insn : code) {
+        ExprIntRange a = insn.src1 >= 0 ? ranges[insn.src1] : ExprIntRange{};
+        ExprIntRange b = insn.src2 >= 0 ? ranges[insn.src2] : ExprIntRange{};
+
+        switch (insn.op.type) {
+        case ExprOpType::MEM_LOAD_U8:
+        case ExprOpType::MEM_LOAD_U16: {
+            bool is8 = insn.op.type == ExprOpType::MEM_LOAD_U8;
+            intCode.push_back({ is8 ? ExprIntOpType::LOAD_U8 : ExprIntOpType::LOAD_U16, static_cast<int>(insn.op.imm.u), insn.op.dx, insn.dst, -1, -1, 0, false });
+            ranges[insn.dst] = { 0, is8 ? UINT8_MAX : UINT16_MAX, false, false, 0.0f };
+            break;
+        }
+        case ExprOpType::CONSTANT: {
+            float v = insn.op.imm.f;
+            if (!std::isfinite(v))
+                return false;
+            if (!isInteger(v)) {
+                ranges[insn.dst] = { 0, 0, false, true, v };
+                break;
+            }
+            if (!setExact(insn.dst, static_cast<int64_t>(v), static_cast<int64_t>(v)))
+                return false;
+            push(ExprIntOpType::CONSTANT, insn.dst, -1, -1, static_cast<int>(v), false);
+            break;
+        }
+        case ExprOpType::MEM_STORE_U8:
+        case ExprOpType::MEM_STORE_U16:
+            if (a.fraction)
+                return false;
+            intCode.push_back({ insn.op.type == ExprOpType::MEM_STORE_U8 ? ExprIntOpType::STORE_U8 : ExprIntOpType::STORE_U16, static_cast<int>(insn.op.imm.u), 0, -1, insn.src1, -1, insn.output, !fitsSigned16(a.lo, a.hi) });
+            break;
+        case ExprOpType::ADD:
+        case ExprOpType::SUB:
+            if (!isExact(a) || !isExact(b))
+                return false;
+            if (insn.op.type == ExprOpType::ADD ? !setExact(insn.dst, a.lo + b.lo, a.hi + b.hi) : !setExact(insn.dst, a.lo - b.hi, a.hi - b.lo))
+                return false;
+            push(insn.op.type == ExprOpType::ADD ? ExprIntOpType::ADD : ExprIntOpType::SUB, insn.dst, insn.src1, insn.src2, 0, false);
+            break;
+        case ExprOpType::MUL: {
+            int valueReg = insn.src1;
+            if (a.fraction) {
+                std::swap(a, b);
+                valueReg = insn.src2;
+            }
+            if (!isExact(a))
+                return false;
+
+            if (b.fraction) {
+                int k = inversePowerOfTwo(b.value);
+                int64_t half = INT64_C(1) << (k - 1);
+                if (!k)
+                    return false;
+                // the rounding adds up to half before shifting so that has to fit as well
+                bool isUnsigned = fitsUnsigned16(a.lo, a.hi + half);
+                if (!isUnsigned && !fitsSigned16(a.lo, a.hi + half))
+                    return false;
+                ranges[insn.dst] = { floorShift(a.lo, k), -floorShift(-a.hi, k), true, false, 0.0f };
+                push(ExprIntOpType::ROUND_SHIFT, insn.dst, valueReg, -1, k, isUnsigned);
+                break;
+            }
+
+            if (!isExact(b))
+                return false;
+            int64_t p[4] = { a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi };
+            if (!setExact(insn.dst, *std::min_element(p, p + 4), *std::max_element(p, p + 4)))
+                return false;
+            push(ExprIntOpType::MUL, insn.dst, insn.src1, insn.src2, 0, false);
+            break;
+        }
+        case ExprOpType::FMA: {
+            ExprIntRange c = ranges[insn.src3];
+            if (!isExact(a) || !isExact(b) || !isExact(c))
+                return false;
+            int64_t p[4] = { b.lo * c.lo, b.lo * c.hi, b.hi * c.lo, b.hi * c.hi };
+            int64_t plo = *std::min_element(p, p + 4);
+            int64_t phi = *std::max_element(p, p + 4);
+            int product = nextTemp++;
+            if (!setExact(product, plo, phi))
+                return false;
+            push(ExprIntOpType::MUL, product, insn.src2, insn.src3, 0, false);
+
+            switch (static_cast<FMAType>(insn.op.imm.u)) {
+            case FMAType::FMADD:
+                if (!setExact(insn.dst, plo + a.lo, phi + a.hi))
+                    return false;
+                push(ExprIntOpType::ADD, insn.dst, product, insn.src1, 0, false);
+                break;
+            case FMAType::FMSUB:
+                if (!setExact(insn.dst, plo - a.hi, phi - a.lo))
+                    return false;
+                push(ExprIntOpType::SUB, insn.dst, product, insn.src1, 0, false);
+                break;
+            case FMAType::FNMADD:
+                if (!setExact(insn.dst, a.lo - phi, a.hi - plo))
+                    return false;
+                push(ExprIntOpType::SUB, insn.dst, insn.src1, product, 0, false);
+                break;
+            case FMAType::FNMSUB: {
+                int negated = nextTemp++;
+                if (!setExact(negated, -phi, -plo) || !setExact(insn.dst, -phi - a.hi, -plo - a.lo))
+                    return false;
+                push(ExprIntOpType::NEG, negated, product, -1, 0, false);
+                push(ExprIntOpType::SUB, insn.dst, negated, insn.src1, 0, false);
+                break;
+            }
+            }
+            break;
+        }
+        case ExprOpType::MAX:
+        case ExprOpType::MIN: {
+            if (a.fraction || b.fraction)
+                return false;
+            bool isUnsigned = !fitsSigned16(a.lo, a.hi) || !fitsSigned16(b.lo, b.hi);
+            if (isUnsigned && (!fitsUnsigned16(a.lo, a.hi) || !fitsUnsigned16(b.lo, b.hi)))
+                return false;
+            bool isMax = insn.op.type == ExprOpType::MAX;
+            ranges[insn.dst] = { isMax ? std::max(a.lo, b.lo) : std::min(a.lo, b.lo), isMax ? std::max(a.hi, b.hi) : std::min(a.hi, b.hi), a.rounded || b.rounded, false, 0.0f };
+            push(isMax ? ExprIntOpType::MAX : ExprIntOpType::MIN, insn.dst, insn.src1, insn.src2, 0, isUnsigned);
+            break;
+        }
+        case ExprOpType::ABS:
+            if (!isExact(a) || !fitsSigned16(a.lo, a.hi) || a.lo == INT16_MIN)
+                return false;
+            ranges[insn.dst] = { a.lo >= 0 ? a.lo : (a.hi <= 0 ? -a.hi : 0), std::max(-a.lo, a.hi), false, false, 0.0f };
+            push(ExprIntOpType::ABS, insn.dst, insn.src1, -1, 0, false);
+            break;
+        case ExprOpType::NEG:
+            if (!isExact(a) || !setExact(insn.dst, -a.hi, -a.lo))
+                return false;
+            push(ExprIntOpType::NEG, insn.dst, insn.src1, -1, 0, false);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::shared_ptr<const ExprProgram> getProgram(std::vector<ExprInstruction> bytecode, int numInputs, int numOutputs, int cpulevel, const std::string &name, VSCore *core, const VSAPI *vsapi)
+{
+    std::string key;
+    auto append = [&](int32_t v) { key.append(reinterpret_cast<const char *>(&v), sizeof(v)); };
+
+    append(numInputs);
+    append(numOutputs);
+    append(cpulevel);
+    for (const ExprInstruction &insn : bytecode) {
+        append(static_cast<int32_t>(insn.op.type));
+        append(insn.op.imm.i);
+        append(insn.op.dx);
+        append(insn.op.dy);
+        append(insn.dst);
+        append(insn.src1);
+        append(insn.src2);
+        append(insn.src3);
+        append(insn.output);
+    }
+
+    ExprProgramCache &cache = getProgramCache();
+    if (auto program = cache.find(key))
+        return program;
+
+    std::shared_ptr<ExprProgram> program = std::make_shared<ExprProgram>();
+    program->bytecode = std::move(bytecode);
+    assignRowSlots(program->bytecode, numInputs, program->rows);
+
+    if (cpulevel > VS_CPU_LEVEL_NONE) {
+#ifdef VS_TARGET_CPU_X86
+        int numSlots = numInputs + static_cast<int>(program->rows.size());
+        std::vector<ExprIntInstruction> intCode;
+        std::unique_ptr<ExprIntCompiler> intCompiler = lowerToInteger(program->bytecode, intCode) ? make_int_compiler(std::move(intCode), numSlots, numOutputs, cpulevel) : nullptr;
+
+        if (intCompiler) {
+            std::tie(program->proc, program->procSize) = intCompiler->getCode();
+            program->procStep = intCompiler->getStep();
+        } else {
+            std::unique_ptr<ExprCompiler> compiler = make_compiler(numSlots, numOutputs, cpulevel);
+            for (auto op : program->bytecode) {
+                compiler->addInstruction(op, core, vsapi);
+            }
+
+            std::tie(program->proc, program->procSize) = compiler->getCode();
+            program->procStep = compiler->getStep();
+        }
+        vs_register_jit_code(core, reinterpret_cast<const void *>(program->proc), program->procSize, name);
+#endif
+    }
+
+    return cache.insert(key, std::move(program));
+}
 
-    while (applyLocalOptimizations(tree) || applyAlgebraicOptimizations(tree) || applyComparisonOptimizations(tree)) {
-        // ...
-    }
+struct ExprPlaneSlice {
+    const ExprData *d;
+    int plane;
+    int width;
+    int height;
+    const float *props;
+    const uint8_t *srcp[MAX_EXPR_INPUTS];
+    ptrdiff_t src_stride[MAX_EXPR_INPUTS];
+    uint8_t *dstp; // the outputs follow each other every height rows
+    ptrdiff_t dst_stride;
+    const intptr_t *ptroffsets;
+};
 
-    while (applyAlgebraicCleanup(tree) || applyStrengthReduction(tree) || applyOpFusion(tree)) {
-        // ...
+static void VS_CC exprProcessRows(int start, int end, void *userData) {
+    const ExprPlaneSlice *s = static_cast<const ExprPlaneSlice *>(userData);
+    const ExprData *d = s->d;
+    const ExprProgram &program = *d->program[s->plane];
+    const std::vector<ExprRowSource> &rows = program.rows;
+    int numInputs = d->numInputs;
+    int numOutputs = d->numOutputs;
+    int numRows = static_cast<int>(rows.size());
+    int w = s->width;
+    int step = program.proc ? program.procStep : 1;
+
+    // Padded copies of the rows read with horizontal offsets. Every row starts
+    // on a 64 byte boundary and has room for the vector tail on the right.
+    size_t rowOffset[MAX_EXPR_ROWS] = {};
+    size_t bufSize = 0;
+    for (int k = 0; k < numRows; k++) {
+        if (!rows[k].pad)
+            continue;
+        size_t lead = (rows[k].pad * rows[k].bytesPerSample + 63) & ~static_cast<size_t>(63);
+        rowOffset[k] = bufSize + lead;
+        bufSize += (lead + static_cast<size_t>(w + rows[k].pad + step) * rows[k].bytesPerSample + 63) & ~static_cast<size_t>(63);
     }
+    std::unique_ptr<uint8_t, decltype(&vsh_aligned_free)> buf(bufSize ? vsh_aligned_malloc<uint8_t>(bufSize, 64) : nullptr, vsh_aligned_free);
 
-    applyValueNumbering(tree);
-
-    tree.getRoot()->postorder([&](ExpressionTreeNode &node)
-    {
-        if (node.op.type == ExprOpType::MUX)
-            return;
-        if (found.find(node.valueNum) != found.end())
-            return;
+    ExprInterpreter interpreter(program.bytecode.data(), program.bytecode.size());
 
-        ExprInstruction opcode(node.op);
-        opcode.dst = node.valueNum;
+    for (int y = start; y < end; y++) {
+        alignas(32) uint8_t *rwptrs[MAX_EXPR_POINTERS] = { s->dstp + s->dst_stride * y };
+        for (int i = 0; i < numInputs; i++) {
+            if (s->srcp[i])
+                rwptrs[i + 1] = const_cast<uint8_t *>(s->srcp[i] + s->src_stride[i] * y);
+        }
 
-        if (node.left) {
-            assert(node.left->valueNum >= 0);
-            opcode.src1 = node.left->valueNum;
+        uint8_t *dstp[MAX_EXPR_OUTPUTS] = { rwptrs[0] };
+        for (int k = 1; k < numOutputs; k++) {
+            dstp[k] = s->dstp + s->dst_stride * (y + static_cast<ptrdiff_t>(k) * s->height);
+            rwptrs[exprOutputSlot(numInputs + numRows, k)] = dstp[k];
         }
-        if (node.right) {
-            if (node.right->op.type == ExprOpType::MUX) {
-                assert(node.right->left->valueNum >= 0);
-                assert(node.right->right->valueNum >= 0);
-                opcode.src2 = node.right->left->valueNum;
-                opcode.src3 = node.right->right->valueNum;
+
+        for (int k = 0; k < numRows; k++) {
+            const ExprRowSource &row = rows[k];
+            int sy = std::min(std::max(y + row.dy, 0), s->height - 1);
+            const uint8_t *srcRow = s->srcp[row.clip] + s->src_stride[row.clip] * sy;
+
+            if (row.pad) {
+                int bps = row.bytesPerSample;
+                uint8_t *dstRow = buf.get() + rowOffset[k];
+                memcpy(dstRow, srcRow, static_cast<size_t>(w) * bps);
+                for (int x = 1; x <= row.pad; x++)
+                    memcpy(dstRow - x * bps, srcRow, bps);
+                for (int x = w; x < w + row.pad + step; x++)
+                    memcpy(dstRow + x * bps, srcRow + (w - 1) * bps, bps);
+                rwptrs[numInputs + k + 1] = dstRow;
             } else {
-                assert(node.right->valueNum >= 0);
-                opcode.src2 = node.right->valueNum;
+                rwptrs[numInputs + k + 1] = const_cast<uint8_t *>(srcRow);
             }
         }
 
-        code.push_back(opcode);
-        found.insert(node.valueNum);
-    });
-
-    ExprInstruction store(ExprOpType::MEM_STORE_U8);
-
-    if (format.sampleType == stInteger && format.bytesPerSample == 1)
-        store.op.type = ExprOpType::MEM_STORE_U8;
-    else if (format.sampleType == stInteger && format.bytesPerSample == 2)
-        store.op.type = ExprOpType::MEM_STORE_U16;
-    else if (format.sampleType == stFloat && format.bytesPerSample == 2)
-        store.op.type = ExprOpType::MEM_STORE_F16;
-    else if (format.sampleType == stFloat && format.bytesPerSample == 4)
-        store.op.type = ExprOpType::MEM_STORE_F32;
-
-    if (store.op.type == ExprOpType::MEM_STORE_U16)
-        store.op.imm.u = format.bitsPerSample;
-
-    store.src1 = code.back().dst;
-    code.push_back(store);
+        if (program.proc) {
+            int niterations = (w + step - 1) / step;
+            // The property slot has a zero offset so it stays put.
+            rwptrs[numInputs + numRows + 1] = reinterpret_cast<uint8_t *>(const_cast<float *>(s->props));
+            program.proc(rwptrs, const_cast<intptr_t *>(s->ptroffsets), niterations);
+        } else {
+            for (int x = 0; x < w; x += ExprInterpreter::blockSize) {
+                interpreter.eval(rwptrs + 1, dstp, s->props, x, std::min(w - x, ExprInterpreter::blockSize));
+            }
+        }
+    }
+}
 
-    renameRegisters(code);
-    return code;
+// Missing and non-numeric properties evaluate to NaN.
+static void loadExprProps(const std::vector<ExprPropRef> &refs, const VSFrame * const *src, std::vector<float> &props, const VSAPI *vsapi) {
+    props.assign(refs.size(), std::numeric_limits<float>::quiet_NaN());
+    for (size_t i = 0; i < refs.size(); i++) {
+        const VSMap *m = vsapi->getFramePropertiesRO(src[refs[i].clip]);
+        const char *key = refs[i].key.c_str();
+        int err;
+        if (vsapi->mapGetType(m, key) == ptInt) {
+            int64_t v = vsapi->mapGetInt(m, key, 0, &err);
+            if (!err)
+                props[i] = static_cast<float>(v);
+        } else if (vsapi->mapGetType(m, key) == ptFloat) {
+            double v = vsapi->mapGetFloat(m, key, 0, &err);
+            if (!err)
+                props[i] = static_cast<float>(v);
+        }
+    }
 }
 
 static const VSFrame *VS_CC exprGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
@@ -3408,59 +5235,52 @@ static const VSFrame *VS_CC exprGetFrame(int n, int activationReason, void *inst
         int width = vsapi->getFrameWidth(src[0], 0);
         int planes[3] = { 0, 1, 2 };
         const VSFrame *srcf[3] = { d->plane[0] != poCopy ? nullptr : src[0], d->plane[1] != poCopy ? nullptr : src[0], d->plane[2] != poCopy ? nullptr : src[0] };
-        VSFrame *dst = vsapi->newVideoFrame2(&d->vi.format, width, height, srcf, planes, src[0], core);
+        VSFrame *dst = vsapi->newVideoFrame2(&d->vi.format, width, height * d->numOutputs, srcf, planes, src[0], core);
+
+        std::vector<float> props;
+        loadExprProps(d->props, src, props, vsapi);
 
-        const uint8_t *srcp[MAX_EXPR_INPUTS] = {};
-        ptrdiff_t src_stride[MAX_EXPR_INPUTS] = {};
-        alignas(32) intptr_t ptroffsets[((MAX_EXPR_INPUTS + 1) + 7) & ~7] = { d->vi.format.bytesPerSample * 8 };
+        // planes no consumer reads are left undefined
+        int demanded = vsapi->getFrameDemandedPlanes(frameCtx);
 
         for (int plane = 0; plane < d->vi.format.numPlanes; plane++) {
-            if (d->plane[plane] != poProcess)
+            if (d->plane[plane] != poProcess || !(demanded & (1 << plane)))
                 continue;
 
+            const ExprProgram &program = *d->program[plane];
+            int step = program.procStep;
+            alignas(32) intptr_t ptroffsets[MAX_EXPR_POINTERS] = { d->vi.format.bytesPerSample * step };
+
             for (int i = 0; i < numInputs; i++) {
-                if (d->node[i]) {
-                    srcp[i] = vsapi->getReadPtr(src[i], plane);
-                    src_stride[i] = vsapi->getStride(src[i], plane);
-                    ptroffsets[i + 1] = vsapi->getVideoFrameFormat(src[i])->bytesPerSample * 8;
-                }
+                if (d->node[i])
+                    ptroffsets[i + 1] = vsapi->getVideoFrameFormat(src[i])->bytesPerSample * step;
             }
+            for (size_t k = 0; k < program.rows.size(); k++)
+                ptroffsets[numInputs + k + 1] = program.rows[k].bytesPerSample * step;
+            for (int k = 1; k < d->numOutputs; k++)
+                ptroffsets[exprOutputSlot(numInputs + static_cast<int>(program.rows.size()), k)] = d->vi.format.bytesPerSample * step;
 
-            uint8_t *dstp = vsapi->getWritePtr(dst, plane);
-            ptrdiff_t dst_stride = vsapi->getStride(dst, plane);
-            int h = vsapi->getFrameHeight(dst, plane);
-            int w = vsapi->getFrameWidth(dst, plane);
-
-            if (d->proc[plane]) {
-                ExprData::ProcessLineProc proc = d->proc[plane];
-                int niterations = (w + 7) / 8;
+            ExprPlaneSlice slice = {};
+            slice.d = d;
+            slice.plane = plane;
+            slice.props = props.data();
+            slice.ptroffsets = ptroffsets;
 
-                for (int i = 0; i < numInputs; i++) {
-                    if (d->node[i])
-                        ptroffsets[i + 1] = vsapi->getVideoFrameFormat(src[i])->bytesPerSample * 8;
-                }
-
-                for (int y = 0; y < h; y++) {
-                    alignas(32) uint8_t *rwptrs[((MAX_EXPR_INPUTS + 1) + 7) & ~7] = { dstp + dst_stride * y };
-                    for (int i = 0; i < numInputs; i++) {
-                        rwptrs[i + 1] = const_cast<uint8_t *>(srcp[i] + src_stride[i] * y);
-                    }
-                    proc(rwptrs, ptroffsets, niterations);
+            for (int i = 0; i < numInputs; i++) {
+                if (d->node[i]) {
+                    slice.srcp[i] = vsapi->getReadPtr(src[i], plane);
+                    slice.src_stride[i] = vsapi->getStride(src[i], plane);
                 }
-            } else {
-                ExprInterpreter interpreter(d->bytecode[plane].data(), d->bytecode[plane].size());
+            }
 
-                for (int y = 0; y < h; y++) {
-                    for (int x = 0; x < w; x++) {
-                        interpreter.eval(srcp, dstp, x);
-                    }
+            slice.dstp = vsapi->getWritePtr(dst, plane);
+            slice.dst_stride = vsapi->getStride(dst, plane);
+            slice.width = vsapi->getFrameWidth(dst, plane);
+            slice.height = vsapi->getFrameHeight(dst, plane) / d->numOutputs;
+            int h = slice.height;
 
-                    for (int i = 0; i < numInputs; i++) {
-                        srcp[i] += src_stride[i];
-                    }
-                    dstp += dst_stride;
-                }
-            }
+            // rows are independent so big planes can be split between idle worker threads
+            vsapi->processSlices(h, std::max(EXPR_MIN_SLICE_PIXELS / slice.width, 1), exprProcessRows, &slice, frameCtx);
         }
 
         for (int i = 0; i < MAX_EXPR_INPUTS; i++) {
@@ -3472,15 +5292,177 @@ static const VSFrame *VS_CC exprGetFrame(int n, int activationReason, void *inst
     return nullptr;
 }
 
+// Expr instances with a float output that may be fused into the Expr
+// instances using them, keyed by their output node.
+class ExprFusionRegistry {
+    std::mutex lock;
+    std::unordered_map<const VSNode *, const ExprData *> instances;
+public:
+    void add(const VSNode *node, const ExprData *d)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        instances[node] = d;
+    }
+
+    void remove(const VSNode *node)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        instances.erase(node);
+    }
+
+    const ExprData *find(const VSNode *node)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = instances.find(node);
+        return it != instances.end() ? it->second : nullptr;
+    }
+};
+
+ExprFusionRegistry &getFusionRegistry()
+{
+    static ExprFusionRegistry registry;
+    return registry;
+}
+
+bool isClipToken(const std::string &tok)
+{
+    return tok[0] >= 'a' && tok[0] <= 'z' && (tok.size() == 1 || tok[1] == '[' || tok[1] == '.');
+}
+
+int clipIndexFromName(char c)
+{
+    return c >= 'x' ? c - 'x' : c - 'a' + 3;
+}
+
+char clipNameFromIndex(int idx)
+{
+    return static_cast<char>(idx < 3 ? 'x' + idx : 'a' + idx - 3);
+}
+
+// Replaces inputs that are themselves Expr instances with a 32 bit float
+// output by the inputs of that Expr and substitutes its expression for the
+// clip's loads. Float intermediates are stored without clamping or rounding so
+// the fused expression computes the same values in a single pass. Inputs that
+// are loaded with a pixel offset or whose properties are read are left alone.
+bool fuseInputs(ExprData *d, std::string expr[3], const VSAPI *vsapi)
+{
+    const ExprData *producer[MAX_EXPR_INPUTS] = {};
+    std::vector<std::vector<std::string>> tokens(3);
+    bool found = false;
+
+    for (int p = 0; p < d->vi.format.numPlanes; p++) {
+        if (d->plane[p] == poProcess)
+            tokens[p] = tokenize(expr[p]);
+    }
+
+    for (int i = 0; i < d->numInputs; i++) {
+        const ExprData *prod = getFusionRegistry().find(d->node[i]);
+        if (!prod || prod->fast != d->fast)
+            continue;
+
+        bool ok = true;
+        for (int p = 0; p < d->vi.format.numPlanes; p++) {
+            // Planes copied from the first clip need its frames.
+            if (d->plane[p] != poProcess && i == 0)
+                ok = false;
+            if (d->plane[p] == poProcess && prod->plane[p] == poUndefined)
+                ok = false;
+            for (const std::string &tok : tokens[p]) {
+                if (isClipToken(tok) && clipIndexFromName(tok[0]) == i && tok.size() > 1)
+                    ok = false;
+            }
+        }
+
+        if (ok) {
+            producer[i] = prod;
+            found = true;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    std::vector<VSNode *> nodes;
+    auto addInput = [&](VSNode *node) {
+        auto it = std::find(nodes.begin(), nodes.end(), node);
+        if (it == nodes.end())
+            it = nodes.insert(nodes.end(), node);
+        return static_cast<int>(it - nodes.begin());
+    };
+
+    std::vector<std::vector<int>> mapping(d->numInputs);
+    for (int i = 0; i < d->numInputs; i++) {
+        if (producer[i]) {
+            for (int j = 0; j < producer[i]->numInputs; j++)
+                mapping[i].push_back(addInput(producer[i]->node[j]));
+        } else {
+            mapping[i].push_back(addInput(d->node[i]));
+        }
+    }
+
+    if (nodes.size() > MAX_EXPR_INPUTS)
+        return false;
+
+    // Appends the tokens with clip j renamed to the new input map[j].
+    auto renameTokens = [](const std::vector<std::string> &in, const std::vector<int> &map, std::string &out) {
+        for (const std::string &tok : in) {
+            if (!out.empty())
+                out += ' ';
+            if (isClipToken(tok))
+                out += clipNameFromIndex(map[clipIndexFromName(tok[0])]) + tok.substr(1);
+            else
+                out += tok;
+        }
+    };
+
+    std::string fused[3];
+    for (int p = 0; p < d->vi.format.numPlanes; p++) {
+        if (d->plane[p] != poProcess)
+            continue;
+
+        for (const std::string &tok : tokens[p]) {
+            int i = isClipToken(tok) ? clipIndexFromName(tok[0]) : -1;
+            if (i >= 0 && producer[i]) {
+                if (producer[i]->plane[p] == poProcess)
+                    renameTokens(tokenize(producer[i]->expr[p]), mapping[i], fused[p]);
+                else
+                    renameTokens({ "x" }, mapping[i], fused[p]);
+            } else if (i >= 0) {
+                renameTokens({ std::string(1, 'x') + tok.substr(1) }, mapping[i], fused[p]);
+            } else {
+                renameTokens({ tok }, {}, fused[p]);
+            }
+        }
+
+        // Keeps repeated uses of a fused clip from growing without bound.
+        if (fused[p].size() > 65536)
+            return false;
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++)
+        vsapi->addNodeRef(nodes[i]);
+    for (int i = 0; i < d->numInputs; i++)
+        vsapi->freeNode(d->node[i]);
+    for (int i = 0; i < MAX_EXPR_INPUTS; i++)
+        d->node[i] = i < static_cast<int>(nodes.size()) ? nodes[i] : nullptr;
+    d->numInputs = static_cast<int>(nodes.size());
+
+    for (int p = 0; p < 3; p++)
+        expr[p] = fused[p];
+    return true;
+}
+
 static void VS_CC exprFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
     ExprData *d = static_cast<ExprData *>(instanceData);
+    if (d->self)
+        getFusionRegistry().remove(d->self);
     for (int i = 0; i < MAX_EXPR_INPUTS; i++)
         vsapi->freeNode(d->node[i]);
     delete d;
 }
 
-static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
-    std::unique_ptr<ExprData> d(new ExprData);
+// Reads the input clips and the output format shared by Expr and ExprMulti.
+static void getExprInputs(ExprData *d, const VSVideoInfo **vi, const VSMap *in, VSCore *core, const VSAPI *vsapi) {
     int err;
 
 #ifdef VS_TARGET_CPU_X86
@@ -3490,54 +5472,71 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 #   define EXPR_F16C_TEST (false)
 #endif
 
-    try {
-        d->numInputs = vsapi->mapNumElements(in, "clips");
-        if (d->numInputs > 26)
-            throw std::runtime_error("More than 26 input clips provided");
+    d->numInputs = vsapi->mapNumElements(in, "clips");
+    if (d->numInputs > 26)
+        throw std::runtime_error("More than 26 input clips provided");
 
-        for (int i = 0; i < d->numInputs; i++) {
-            d->node[i] = vsapi->mapGetNode(in, "clips", i, &err);
-        }
+    for (int i = 0; i < d->numInputs; i++) {
+        d->node[i] = vsapi->mapGetNode(in, "clips", i, &err);
+    }
 
-        const VSVideoInfo *vi[MAX_EXPR_INPUTS] = {};
-        for (int i = 0; i < d->numInputs; i++) {
-            if (d->node[i])
-                vi[i] = vsapi->getVideoInfo(d->node[i]);
-        }
-
-        for (int i = 0; i < d->numInputs; i++) {
-            if (!isConstantVideoFormat(vi[i]))
-                throw std::runtime_error("Only clips with constant format and dimensions allowed");
-            if (vi[0]->format.numPlanes != vi[i]->format.numPlanes
-                || vi[0]->format.subSamplingW != vi[i]->format.subSamplingW
-                || vi[0]->format.subSamplingH != vi[i]->format.subSamplingH
-                || vi[0]->width != vi[i]->width
-                || vi[0]->height != vi[i]->height)
-            {
-                throw std::runtime_error("All inputs must have the same number of planes and the same dimensions, subsampling included");
-            }
+    for (int i = 0; i < d->numInputs; i++) {
+        if (d->node[i])
+            vi[i] = vsapi->getVideoInfo(d->node[i]);
+    }
 
-            if (EXPR_F16C_TEST) {
-                if ((vi[i]->format.bitsPerSample > 16 && vi[i]->format.sampleType == stInteger)
-                    || (vi[i]->format.bitsPerSample != 16 && vi[i]->format.bitsPerSample != 32 && vi[i]->format.sampleType == stFloat))
-                    throw std::runtime_error("Input clips must be 8-16 bit integer or 16/32 bit float format");
-            } else {
-                if ((vi[i]->format.bitsPerSample > 16 && vi[i]->format.sampleType == stInteger)
-                    || (vi[i]->format.bitsPerSample != 32 && vi[i]->format.sampleType == stFloat))
-                    throw std::runtime_error("Input clips must be 8-16 bit integer or 32 bit float format");
-            }
+    for (int i = 0; i < d->numInputs; i++) {
+        if (!isConstantVideoFormat(vi[i]))
+            throw std::runtime_error("Only clips with constant format and dimensions allowed");
+        if (vi[0]->format.numPlanes != vi[i]->format.numPlanes
+            || vi[0]->format.subSamplingW != vi[i]->format.subSamplingW
+            || vi[0]->format.subSamplingH != vi[i]->format.subSamplingH
+            || vi[0]->width != vi[i]->width
+            || vi[0]->height != vi[i]->height)
+        {
+            throw std::runtime_error("All inputs must have the same number of planes and the same dimensions, subsampling included");
         }
 
-        d->vi = *vi[0];
-        int format = vsapi->mapGetIntSaturated(in, "format", 0, &err);
-        if (!err) {
-            VSVideoFormat f;
-            if (vsapi->getVideoFormatByID(&f, format, core) && f.colorFamily != cfUndefined) {
-                if (d->vi.format.numPlanes != f.numPlanes)
-                    throw std::runtime_error("The number of planes in the inputs and output must match");
-                vsapi->queryVideoFormat(&d->vi.format, d->vi.format.colorFamily, f.sampleType, f.bitsPerSample, d->vi.format.subSamplingW, d->vi.format.subSamplingH, core);
-            }
+        if (EXPR_F16C_TEST) {
+            if ((vi[i]->format.bitsPerSample > 16 && vi[i]->format.sampleType == stInteger)
+                || (vi[i]->format.bitsPerSample != 16 && vi[i]->format.bitsPerSample != 32 && vi[i]->format.sampleType == stFloat))
+                throw std::runtime_error("Input clips must be 8-16 bit integer or 16/32 bit float format");
+        } else {
+            if ((vi[i]->format.bitsPerSample > 16 && vi[i]->format.sampleType == stInteger)
+                || (vi[i]->format.bitsPerSample != 32 && vi[i]->format.sampleType == stFloat))
+                throw std::runtime_error("Input clips must be 8-16 bit integer or 32 bit float format");
+        }
+    }
+
+    d->vi = *vi[0];
+    int format = vsapi->mapGetIntSaturated(in, "format", 0, &err);
+    if (!err) {
+        VSVideoFormat f;
+        if (vsapi->getVideoFormatByID(&f, format, core) && f.colorFamily != cfUndefined) {
+            if (d->vi.format.numPlanes != f.numPlanes)
+                throw std::runtime_error("The number of planes in the inputs and output must match");
+            vsapi->queryVideoFormat(&d->vi.format, d->vi.format.colorFamily, f.sampleType, f.bitsPerSample, d->vi.format.subSamplingW, d->vi.format.subSamplingH, core);
         }
+    }
+
+    d->fast = !!vsapi->mapGetInt(in, "fast", 0, &err);
+}
+
+// Parsing, optimizing and jitting huge generated expressions can take a
+// noticeable part of the script load time so it's logged for every program.
+static void logCompileTime(std::chrono::steady_clock::time_point start, const std::string &name, const ExprProgram &program, VSCore *core, const VSAPI *vsapi) {
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), " instructions in %.2f ms: ", ms);
+    vsapi->logMessage(mtDebug, ("Compiled " + std::to_string(program.bytecode.size()) + buffer + name).c_str(), core);
+}
+
+static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    std::unique_ptr<ExprData> d(new ExprData);
+
+    try {
+        const VSVideoInfo *vi[MAX_EXPR_INPUTS] = {};
+        getExprInputs(d.get(), vi, in, core, vsapi);
 
         int nexpr = vsapi->mapNumElements(in, "expr");
         if (nexpr > d->vi.format.numPlanes)
@@ -3560,24 +5559,26 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
                 else
                     d->plane[i] = poUndefined;
             }
+        }
+
+        // Every pass fuses one more level of the chain.
+        if (vs_fuse_pointwise_filters(core)) {
+            while (fuseInputs(d.get(), expr, vsapi)) {
+            }
+            for (int i = 0; i < MAX_EXPR_INPUTS; i++)
+                vi[i] = d->node[i] ? vsapi->getVideoInfo(d->node[i]) : nullptr;
+        }
 
+        for (int i = 0; i < d->vi.format.numPlanes; i++) {
             if (d->plane[i] != poProcess)
                 continue;
 
-            auto tree = parseExpr(expr[i], vi, d->numInputs);
-            d->bytecode[i] = compile(tree, d->vi.format);
-
-            int cpulevel = vs_get_cpulevel(core);
-            if (cpulevel > VS_CPU_LEVEL_NONE) {
-#ifdef VS_TARGET_CPU_X86
-                std::unique_ptr<ExprCompiler> compiler = make_compiler(d->numInputs, cpulevel);
-                for (auto op : d->bytecode[i]) {
-                    compiler->addInstruction(op, core, vsapi);
-                }
-
-                std::tie(d->proc[i], d->procSize[i]) = compiler->getCode();
-#endif
-            }
+            d->expr[i] = expr[i];
+            auto start = std::chrono::steady_clock::now();
+            std::string name = "Expr[plane=" + std::to_string(i) + "] " + expr[i];
+            auto tree = parseExpr(expr[i], vi, d->numInputs, d->props);
+            d->program[i] = getProgram(compile(tree, d->vi.format, d->fast), d->numInputs, 1, vs_get_cpulevel(core), name, core, vsapi);
+            logCompileTime(start, name, *d->program[i], core, vsapi);
         }
 #ifdef VS_TARGET_OS_WINDOWS
         FlushInstructionCache(GetCurrentProcess(), nullptr, 0);
@@ -3594,7 +5595,102 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
     for (int i = 0; i < d->numInputs; i++)
         deps.push_back({d->node[i], (d->vi.numFrames <= vsapi->getVideoInfo(d->node[i])->numFrames) ? rpStrictSpatial : rpGeneral});
     vsapi->createVideoFilter(out, "Expr", &d->vi, exprGetFrame, exprFree, fmParallel, deps.data(), d->numInputs, d.get(), core);
+
+    // expressions only ever load the plane they're evaluated for
+    {
+        int err;
+        VSNode *self = vsapi->mapGetNode(out, "clip", 0, &err);
+        if (self) {
+            setSamePlaneDependencies(self, d->numInputs, vsapi);
+            vsapi->freeNode(self);
+        }
+    }
+
+    if (vs_fuse_pointwise_filters(core) && d->vi.format.sampleType == stFloat && d->vi.format.bitsPerSample == 32) {
+        VSNode *self = vsapi->mapGetNode(out, "clip", 0, nullptr);
+        if (self) {
+            d->self = self;
+            getFusionRegistry().add(self, d.get());
+            vsapi->freeNode(self);
+        }
+    }
+    d.release();
+}
+
+// All expressions are compiled into one program per plane that writes every
+// output, so loads and subexpressions they share are evaluated once per pixel.
+// The outputs are stacked vertically in the frames of an internal node and
+// each returned clip is a crop of it that doesn't copy anything.
+static void VS_CC exprMultiCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    std::unique_ptr<ExprData> d(new ExprData);
+
+    try {
+        const VSVideoInfo *vi[MAX_EXPR_INPUTS] = {};
+        getExprInputs(d.get(), vi, in, core, vsapi);
+
+        d->numOutputs = vsapi->mapNumElements(in, "expr");
+        if (d->numOutputs > MAX_EXPR_OUTPUTS)
+            throw std::runtime_error("More than " + std::to_string(MAX_EXPR_OUTPUTS) + " expressions provided");
+
+        std::vector<std::string> expr;
+        for (int i = 0; i < d->numOutputs; i++) {
+            expr.push_back(vsapi->mapGetData(in, "expr", i, nullptr));
+            if (expr.back().empty())
+                throw std::runtime_error("Empty expressions are not allowed");
+        }
+
+        std::string name;
+        for (const auto &e : expr)
+            name += (name.empty() ? "" : ", ") + e;
+
+        // Each expression is used for all planes. Compiling optimizes the
+        // trees in place so every plane parses its own.
+        for (int i = 0; i < d->vi.format.numPlanes; i++) {
+            d->plane[i] = poProcess;
+            auto start = std::chrono::steady_clock::now();
+            std::string planeName = "ExprMulti[plane=" + std::to_string(i) + "] " + name;
+            std::vector<ExpressionTree> trees;
+            for (int j = 0; j < d->numOutputs; j++)
+                trees.push_back(parseExpr(expr[j], vi, d->numInputs, d->props));
+            d->program[i] = getProgram(compile(trees.data(), d->numOutputs, d->vi.format, d->fast), d->numInputs, d->numOutputs, vs_get_cpulevel(core), planeName, core, vsapi);
+            logCompileTime(start, planeName, *d->program[i], core, vsapi);
+        }
+#ifdef VS_TARGET_OS_WINDOWS
+        FlushInstructionCache(GetCurrentProcess(), nullptr, 0);
+#endif
+    } catch (std::runtime_error &e) {
+        for (int i = 0; i < MAX_EXPR_INPUTS; i++) {
+            vsapi->freeNode(d->node[i]);
+        }
+        vsapi->mapSetError(out, (std::string{ "ExprMulti: " } + e.what()).c_str());
+        return;
+    }
+
+    VSVideoInfo stacked = d->vi;
+    stacked.height *= d->numOutputs;
+    int width = d->vi.width;
+    int height = d->vi.height;
+    int numOutputs = d->numOutputs;
+
+    std::vector<VSFilterDependency> deps;
+    for (int i = 0; i < d->numInputs; i++)
+        deps.push_back({d->node[i], (d->vi.numFrames <= vsapi->getVideoInfo(d->node[i])->numFrames) ? rpStrictSpatial : rpGeneral});
+    VSNode *node = vsapi->createVideoFilter2("ExprMulti", &stacked, exprGetFrame, exprFree, fmParallel, deps.data(), d->numInputs, d.get(), core);
     d.release();
+
+    VSMap *args = vsapi->createMap();
+    vsapi->mapConsumeNode(args, "clip", node, maAppend);
+    vsapi->mapSetInt(args, "width", width, maAppend);
+    vsapi->mapSetInt(args, "height", height, maAppend);
+
+    for (int i = 0; i < numOutputs; i++) {
+        vsapi->mapSetInt(args, "top", static_cast<int64_t>(i) * height, maReplace);
+        VSMap *tmp = vsapi->invoke(vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core), "CropAbs", args);
+        vsapi->mapConsumeNode(out, "clip", vsapi->mapGetNode(tmp, "clip", 0, nullptr), maAppend);
+        vsapi->freeMap(tmp);
+    }
+
+    vsapi->freeMap(args);
 }
 
 } // namespace
@@ -3603,6 +5699,142 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 //////////////////////////////////////////
 // Init
 
+//////////////////////////////////////////
+// SelectByProp
+
+// The expression only sees the frame properties of the control clips and is
+// evaluated once per frame by the interpreter, its result picks the clip the
+// frame is taken from. Only the chosen clip is ever asked for the frame.
+struct SelectByPropData {
+    std::vector<VSNode *> clips;
+    std::vector<VSNode *> control;
+    std::vector<ExprPropRef> props;
+    std::vector<ExprInstruction> bytecode;
+    VSVideoInfo vi;
+};
+
+static const VSFrame *VS_CC selectByPropGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    SelectByPropData *d = static_cast<SelectByPropData *>(instanceData);
+
+    if (activationReason == arInitial) {
+        for (auto iter : d->control)
+            vsapi->requestFrameFilter(n, iter, frameCtx);
+    } else if (activationReason == arAllFramesReady && !*frameData) {
+        const VSFrame *src[MAX_EXPR_INPUTS] = {};
+        for (size_t i = 0; i < d->control.size(); i++)
+            src[i] = vsapi->getFrameFilter(n, d->control[i], frameCtx);
+
+        std::vector<float> props;
+        loadExprProps(d->props, src, props, vsapi);
+        for (size_t i = 0; i < d->control.size(); i++)
+            vsapi->freeFrame(src[i]);
+
+        float result = 0;
+        uint8_t *dstp[] = { reinterpret_cast<uint8_t *>(&result) };
+        ExprInterpreter interpreter(d->bytecode.data(), d->bytecode.size());
+        interpreter.eval(nullptr, dstp, props.data(), 0, 1);
+
+        // NaN selects the first clip
+        int index = 0;
+        if (result >= 0)
+            index = static_cast<int>(std::min<float>(std::floor(result), static_cast<float>(d->clips.size() - 1)));
+
+        frameData[0] = reinterpret_cast<void *>(static_cast<intptr_t>(index + 1));
+        vsapi->requestFrameFilter(n, d->clips[index], frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        int index = static_cast<int>(reinterpret_cast<intptr_t>(frameData[0])) - 1;
+        return vsapi->getFrameFilter(n, d->clips[index], frameCtx);
+    }
+
+    return nullptr;
+}
+
+static void VS_CC selectByPropFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    SelectByPropData *d = static_cast<SelectByPropData *>(instanceData);
+    for (auto iter : d->clips)
+        vsapi->freeNode(iter);
+    for (auto iter : d->control)
+        vsapi->freeNode(iter);
+    delete d;
+}
+
+static void VS_CC selectByPropCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    std::unique_ptr<SelectByPropData> d(new SelectByPropData);
+
+    int numClips = vsapi->mapNumElements(in, "clips");
+    for (int i = 0; i < numClips; i++)
+        d->clips.push_back(vsapi->mapGetNode(in, "clips", i, nullptr));
+    int numControl = vsapi->mapNumElements(in, "control");
+    for (int i = 0; i < numControl; i++)
+        d->control.push_back(vsapi->mapGetNode(in, "control", i, nullptr));
+
+    auto freeNodes = [&]() {
+        for (auto iter : d->clips)
+            vsapi->freeNode(iter);
+        for (auto iter : d->control)
+            vsapi->freeNode(iter);
+    };
+
+    if (numControl > MAX_EXPR_INPUTS) {
+        freeNodes();
+        vsapi->mapSetError(out, ("SelectByProp: at most " + std::to_string(MAX_EXPR_INPUTS) + " control clips can be used").c_str());
+        return;
+    }
+
+    d->vi = *vsapi->getVideoInfo(d->clips[0]);
+    for (int i = 1; i < numClips; i++) {
+        const VSVideoInfo *vi = vsapi->getVideoInfo(d->clips[i]);
+        if (!isSameVideoFormat(&vi->format, &d->vi.format) || vi->width != d->vi.width || vi->height != d->vi.height) {
+            freeNodes();
+            vsapi->mapSetError(out, "SelectByProp: all clips must have the same format and dimensions");
+            return;
+        }
+        d->vi.numFrames = std::max(d->vi.numFrames, vi->numFrames);
+    }
+
+    try {
+        const VSVideoInfo *vi[MAX_EXPR_INPUTS] = {};
+        for (int i = 0; i < numControl; i++)
+            vi[i] = vsapi->getVideoInfo(d->control[i]);
+
+        ExpressionTree tree = parseExpr(vsapi->mapGetData(in, "expr", 0, nullptr), vi, numControl, d->props);
+        tree.getRoot()->postorder([](ExpressionTreeNode &node) {
+            if (node.op.type == ExprOpType::MEM_LOAD_U8 || node.op.type == ExprOpType::MEM_LOAD_U16 || node.op.type == ExprOpType::MEM_LOAD_F16 || node.op.type == ExprOpType::MEM_LOAD_F32)
+                throw std::runtime_error("only frame properties can be used, not pixel values");
+        });
+
+        VSVideoFormat format = {};
+        vsapi->queryVideoFormat(&format, cfGray, stFloat, 32, 0, 0, core);
+        d->bytecode = compile(tree, format, false);
+    } catch (std::runtime_error &e) {
+        freeNodes();
+        vsapi->mapSetError(out, (std::string{ "SelectByProp: " } + e.what()).c_str());
+        return;
+    }
+
+    std::vector<VSFilterDependency> deps;
+    for (int i = 0; i < numControl; i++)
+        deps.push_back({d->control[i], (d->vi.numFrames <= vsapi->getVideoInfo(d->control[i])->numFrames) ? rpStrictSpatial : rpGeneral});
+    for (int i = 0; i < numClips; i++)
+        deps.push_back({d->clips[i], rpGeneral});
+    vsapi->createVideoFilter(out, "SelectByProp", &d->vi, selectByPropGetFrame, selectByPropFree, fmParallel, deps.data(), static_cast<int>(deps.size()), d.get(), core);
+
+    // the control clips are only looked at for their properties
+    int err;
+    VSNode *node = vsapi->mapGetNode(out, "clip", 0, &err);
+    if (node) {
+        static const int noPlanes[3] = {};
+        static const int samePlane[3] = { 1 << 0, 1 << 1, 1 << 2 };
+        for (int i = 0; i < numControl + numClips; i++)
+            vsapi->setFilterPlaneDependency(node, i, (i < numControl) ? noPlanes : samePlane);
+        vsapi->freeNode(node);
+    }
+
+    d.release();
+}
+
 void VS_CC exprInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
-    vspapi->registerFunction("Expr", "clips:vnode[];expr:data[];format:int:opt;", "clip:vnode;", exprCreate, nullptr, plugin);
+    vspapi->registerFunction("Expr", "clips:vnode[];expr:data[];format:int:opt;fast:int:opt;", "clip:vnode;", exprCreate, nullptr, plugin);
+    vspapi->registerFunction("ExprMulti", "clips:vnode[];expr:data[];format:int:opt;fast:int:opt;", "clip:vnode[];", exprMultiCreate, nullptr, plugin);
+    vspapi->registerFunction("SelectByProp", "clips:vnode[];control:vnode[];expr:data;", "clip:vnode;", selectByPropCreate, nullptr, plugin);
 }
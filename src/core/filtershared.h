@@ -118,6 +118,84 @@ static void VS_CC filterFree(void *instanceData, VSCore *core, const VSAPI *vsap
     delete reinterpret_cast<T *>(instanceData);
 }
 
+// declares that every output plane of node only reads the same plane of each dependency
+static inline void setSamePlaneDependencies(VSNode *node, int numDeps, const VSAPI *vsapi) {
+    static const int samePlane[3] = { 1 << 0, 1 << 1, 1 << 2 };
+    for (int i = 0; i < numDeps; i++)
+        vsapi->setFilterPlaneDependency(node, i, samePlane);
+}
+
+// createVideoFilter() for filters that process every plane on its own, planes no consumer reads are then not demanded from the sources either
+static inline void createSamePlaneVideoFilter(VSMap *out, const char *name, const VSVideoInfo *vi, VSFilterGetFrame getFrame, VSFilterFree free, int filterMode, const VSFilterDependency *dependencies, int numDeps, void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    vsapi->createVideoFilter(out, name, vi, getFrame, free, filterMode, dependencies, numDeps, instanceData, core);
+    int err;
+    VSNode *node = vsapi->mapGetNode(out, "clip", vsapi->mapNumElements(out, "clip") - 1, &err);
+    if (node) {
+        setSamePlaneDependencies(node, numDeps, vsapi);
+        vsapi->freeNode(node);
+    }
+}
+
+// createVideoFilter() for fmParallel filters that only pass on or reference their input frames, they're never cached and run right away
+// where the frames are needed
+static inline void createLightweightVideoFilter(VSMap *out, const char *name, const VSVideoInfo *vi, VSFilterGetFrame getFrame, VSFilterFree free, const VSFilterDependency *dependencies, int numDeps, void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    vsapi->createVideoFilter(out, name, vi, getFrame, free, fmParallel, dependencies, numDeps, instanceData, core);
+    int err;
+    VSNode *node = vsapi->mapGetNode(out, "clip", vsapi->mapNumElements(out, "clip") - 1, &err);
+    if (node) {
+        vsapi->setNodeLightweight(node, 1);
+        vsapi->freeNode(node);
+    }
+}
+
+// the planes a getframe function has to process, the ones no consumer reads are left to be copied from the source
+static inline void getDemandedProcessPlanes(const bool process[3], bool demanded[3], VSFrameContext *frameCtx, const VSAPI *vsapi) {
+    int planes = vsapi->getFrameDemandedPlanes(frameCtx);
+    for (int i = 0; i < 3; i++)
+        demanded[i] = process[i] && (planes & (1 << i));
+}
+
+// the raw bits of a sample as used by setFramePlaneConstant()
+static inline uint32_t constantBits(uint8_t v) {
+    return v;
+}
+
+static inline uint32_t constantBits(uint16_t v) {
+    return v;
+}
+
+static inline uint32_t constantBits(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+// fills the visible part of a plane with value and marks it as constant
+static inline void fillConstantPlane(VSFrame *dst, int plane, uint32_t value, const VSAPI *vsapi) {
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(dst);
+    uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+    ptrdiff_t stride = vsapi->getStride(dst, plane);
+    int w = vsapi->getFrameWidth(dst, plane);
+    int h = vsapi->getFrameHeight(dst, plane);
+
+    for (int y = 0; y < h; y++) {
+        if (fi->bytesPerSample == 1) {
+            memset(dstp, value, w);
+        } else if (fi->bytesPerSample == 2) {
+            uint16_t *row = reinterpret_cast<uint16_t *>(dstp);
+            for (int x = 0; x < w; x++)
+                row[x] = static_cast<uint16_t>(value);
+        } else {
+            uint32_t *row = reinterpret_cast<uint32_t *>(dstp);
+            for (int x = 0; x < w; x++)
+                row[x] = value;
+        }
+        dstp += stride;
+    }
+
+    vsapi->setFramePlaneConstant(dst, plane, value);
+}
+
 static inline bool getProcessPlanesArg(const VSMap *in, VSMap *out, const char *filterName, bool process[3], const VSAPI *vsapi) {
     int m = vsapi->mapNumElements(in, "planes");
 
@@ -153,6 +231,16 @@ static bool is8to16orFloatFormat(const VSVideoFormat &fi, bool allowVariable = f
     return true;
 }
 
+static bool is8to16orHalfOrFloatFormat(const VSVideoFormat &fi, bool allowVariable = false) {
+    if (fi.colorFamily == cfUndefined && !allowVariable)
+        return false;
+
+    if ((fi.sampleType == stInteger && fi.bitsPerSample > 16) || (fi.sampleType == stFloat && fi.bitsPerSample != 16 && fi.bitsPerSample != 32))
+        return false;
+
+    return true;
+}
+
 template<typename T>
 static inline void vs_memset(void *ptr, T value, size_t num) {
     T *dstPtr = reinterpret_cast<T *>(ptr);
@@ -0,0 +1,101 @@
+/*
+* Copyright (c) 2012-2021 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "vscore.h"
+#include "../common/planecoder.h"
+
+VSCompressedFrame *VSCompressedFrame::compress(const VSFrame *frame, MemoryUse &mem) {
+    if (frame->getFrameType() != mtVideo)
+        return nullptr;
+
+    const VSVideoFormat *fi = frame->getVideoFormat();
+    int bytesPerSample = fi->bytesPerSample;
+    if (bytesPerSample != 1 && bytesPerSample != 2 && bytesPerSample != 4)
+        return nullptr;
+
+    size_t rawSize = 0;
+    size_t worstSize = 0;
+    int maxWidth = 0;
+    for (int p = 0; p < fi->numPlanes; p++) {
+        int w = frame->getWidth(p);
+        int h = frame->getHeight(p);
+        rawSize += static_cast<size_t>(w) * bytesPerSample * h;
+        worstSize += planeCoderBound(w, h);
+        maxWidth = std::max(maxWidth, w);
+    }
+
+    std::vector<uint32_t> residuals((maxWidth + planeCoderGroupSize - 1) / planeCoderGroupSize * planeCoderGroupSize);
+    std::vector<uint8_t> buffer(worstSize);
+    uint8_t *dst = buffer.data();
+    for (int p = 0; p < fi->numPlanes; p++) {
+        const uint8_t *srcp = frame->getReadPtr(p);
+        ptrdiff_t stride = frame->getStride(p);
+        int w = frame->getWidth(p);
+        int h = frame->getHeight(p);
+        if (bytesPerSample == 1)
+            dst = compressPlane<uint8_t>(srcp, stride, w, h, dst, residuals.data());
+        else if (bytesPerSample == 2)
+            dst = compressPlane<uint16_t>(srcp, stride, w, h, dst, residuals.data());
+        else
+            dst = compressPlane<uint32_t>(srcp, stride, w, h, dst, residuals.data());
+    }
+
+    // noisy content isn't worth keeping around if it barely shrinks
+    size_t size = dst - buffer.data();
+    if (size > rawSize - rawSize / 4)
+        return nullptr;
+
+    if (!mem.reserveCompressed(size))
+        return nullptr;
+
+    buffer.resize(size);
+    buffer.shrink_to_fit();
+    return new VSCompressedFrame(frame, std::move(buffer), mem);
+}
+
+VSCompressedFrame::VSCompressedFrame(const VSFrame *frame, std::vector<uint8_t> &&data, MemoryUse &mem) : format(*frame->getVideoFormat()), width(frame->getWidth(0)), height(frame->getHeight(0)), properties(&frame->getConstProperties()), data(std::move(data)), mem(mem) {
+}
+
+VSCompressedFrame::~VSCompressedFrame() {
+    mem.releaseCompressed(data.size());
+}
+
+PVSFrame VSCompressedFrame::decompress(VSCore *core) const {
+    PVSFrame frame(new VSFrame(format, width, height, nullptr, core));
+    frame->setProperties(properties);
+
+    std::vector<uint32_t> residuals((width + planeCoderGroupSize - 1) / planeCoderGroupSize * planeCoderGroupSize);
+    const uint8_t *src = data.data();
+    for (int p = 0; p < format.numPlanes; p++) {
+        uint8_t *dstp = frame->getWritePtr(p);
+        ptrdiff_t stride = frame->getStride(p);
+        int w = frame->getWidth(p);
+        int h = frame->getHeight(p);
+        if (format.bytesPerSample == 1)
+            src = decompressPlane<uint8_t>(src, dstp, stride, w, h, residuals.data());
+        else if (format.bytesPerSample == 2)
+            src = decompressPlane<uint16_t>(src, dstp, stride, w, h, residuals.data());
+        else
+            src = decompressPlane<uint32_t>(src, dstp, stride, w, h, residuals.data());
+    }
+    assert(src == data.data() + data.size());
+
+    return frame;
+}
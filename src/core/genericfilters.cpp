@@ -25,6 +25,7 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <string>
@@ -36,12 +37,7 @@
 #include "internalfilters.h"
 #include "kernel/cpulevel.h"
 #include "kernel/generic.h"
-
-#ifdef _MSC_VER
-#define FORCE_INLINE inline __forceinline
-#else
-#define FORCE_INLINE inline __attribute__((always_inline))
-#endif
+#include "kernel/lut.h"
 
 namespace {
 std::string operator""_s(const char *str, size_t len) { return{ str, len }; }
@@ -107,7 +103,19 @@ enum GenericOperations {
 enum ConvolutionTypes {
     ConvolutionSquare,
     ConvolutionHorizontal,
-    ConvolutionVertical
+    ConvolutionVertical,
+    ConvolutionSeparable,
+    ConvolutionLargeSeparable
+};
+
+typedef void (*GenericKernel)(const void *, ptrdiff_t, void *, ptrdiff_t, const vs_generic_params *, unsigned, unsigned);
+
+// one filter of a chain run in strips, everything is copied from the filter so its node doesn't have to be kept around
+struct GenericStage {
+    GenericKernel kernel;
+    bool process[3];
+    vs_generic_params params[3];
+    int radius; // the number of rows above and below an output row that it depends on
 };
 
 struct GenericDataExtra {
@@ -128,19 +136,65 @@ struct GenericDataExtra {
 
     // Convolution
     ConvolutionTypes convolution_type;
-    int matrix[25];
-    float matrixf[25];
+    int matrix[65];
+    float matrixf[65];
     int matrix_sum;
     int matrix_elements;
+    int matrix_h[5];
+    int matrix_v[5];
+    float matrixf_h[5];
+    float matrixf_v[5];
+    // the filters too big for the exact integer kernels, done in float, a direction with a single tap of 1 is left as is
+    int sep_size_h;
+    int sep_size_v;
+    float sepf_h[65];
+    float sepf_v[65];
     float rdiv;
     float bias;
     bool saturate;
 
-    int cpulevel;
+    // the format is constant so the kernel is picked once when the filter is created
+    GenericKernel kernel;
+
+    // with ccfFuseSpatialFilters a chain of generic filters is run by the last one in horizontal strips so the intermediate
+    // results stay in the cache, the stages are in the order they're applied and node is the source of the first one
+    std::vector<GenericStage> stages;
+    GenericStage self;
 };
 
 typedef SingleNodeData<GenericDataExtra> GenericData;
 
+typedef decltype(&vs_generic_invert_byte_c) PointKernel;
+
+// Indexed by instruction set (C, SSE2, AVX2, AVX-512) and bytesPerSample / 2.
+typedef PointKernel PointKernelTable[4][3];
+
+#ifdef VS_TARGET_CPU_X86
+#define POINT_KERNELS(op) { \
+    { vs_generic_##op##_byte_c, vs_generic_##op##_word_c, vs_generic_##op##_float_c }, \
+    { vs_generic_##op##_byte_sse2, vs_generic_##op##_word_sse2, vs_generic_##op##_float_sse2 }, \
+    { vs_generic_##op##_byte_avx2, vs_generic_##op##_word_avx2, vs_generic_##op##_float_avx2 }, \
+    { vs_generic_##op##_byte_avx512, vs_generic_##op##_word_avx512, vs_generic_##op##_float_avx512 } }
+#else
+#define POINT_KERNELS(op) { \
+    { vs_generic_##op##_byte_c, vs_generic_##op##_word_c, vs_generic_##op##_float_c }, \
+    { vs_generic_##op##_byte_c, vs_generic_##op##_word_c, vs_generic_##op##_float_c }, \
+    { vs_generic_##op##_byte_c, vs_generic_##op##_word_c, vs_generic_##op##_float_c }, \
+    { vs_generic_##op##_byte_c, vs_generic_##op##_word_c, vs_generic_##op##_float_c } }
+#endif
+
+static int pointKernelIsa(int cpulevel) {
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx512_f && getCPUFeatures()->avx512_bw && getCPUFeatures()->avx512_dq && cpulevel >= VS_CPU_LEVEL_AVX512)
+        return 3;
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
+        return 2;
+    if (cpulevel >= VS_CPU_LEVEL_SSE2)
+        return 1;
+#endif
+    return 0;
+}
+
 template<typename T, typename OP>
 static const VSFrame *VS_CC singlePixelGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     T *d = reinterpret_cast<T *>(instanceData);
@@ -148,6 +202,8 @@ static const VSFrame *VS_CC singlePixelGetFrame(int n, int activationReason, voi
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
+        bool process[3];
+        getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src);
 
@@ -159,32 +215,19 @@ static const VSFrame *VS_CC singlePixelGetFrame(int n, int activationReason, voi
 
         const int pl[] = { 0, 1, 2 };
         const VSFrame *fr[] = {
-            d->process[0] ? nullptr : src,
-            d->process[1] ? nullptr : src,
-            d->process[2] ? nullptr : src
+            process[0] ? nullptr : src,
+            process[1] ? nullptr : src,
+            process[2] ? nullptr : src
         };
 
         VSFrame *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
 
+        PointKernel func = OP::kernels[pointKernelIsa(d->cpulevel)][fi->bytesPerSample / 2];
+
         for (int plane = 0; plane < fi->numPlanes; plane++) {
-            if (d->process[plane]) {
-                OP opts(d, fi, plane);
-                uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
-                const uint8_t * VS_RESTRICT srcp = vsapi->getReadPtr(src, plane);
-                int width = vsapi->getFrameWidth(src, plane);
-                int height = vsapi->getFrameHeight(src, plane);
-                ptrdiff_t stride = vsapi->getStride(src, plane);
-
-                for (int h = 0; h < height; h++) {
-                    if (fi->bytesPerSample == 1)
-                        OP::template processPlane<uint8_t>(srcp, dstp, width, opts);
-                    else if (fi->bytesPerSample == 2)
-                        OP::template processPlane<uint16_t>(reinterpret_cast<const uint16_t *>(srcp), reinterpret_cast<uint16_t *>(dstp), width, opts);
-                    else if (fi->bytesPerSample == 4)
-                        OP::template processPlaneF<float>(reinterpret_cast<const float *>(srcp), reinterpret_cast<float *>(dstp), width, opts);
-                    srcp += stride;
-                    dstp += stride;
-                }
+            if (process[plane]) {
+                vs_generic_params params = OP::params(d, fi, plane);
+                func(vsapi->getReadPtr(src, plane), vsapi->getStride(src, plane), vsapi->getWritePtr(dst, plane), vsapi->getStride(dst, plane), &params, vsapi->getFrameWidth(src, plane), vsapi->getFrameHeight(src, plane));
             }
         }
 
@@ -218,12 +261,26 @@ vs_generic_params make_generic_params(const GenericData *d, const VSVideoFormat
     params.thresholdf = d->thf;
     params.stencil = d->enable;
 
-    for (int i = 0; i < d->matrix_elements; ++i) {
+    for (int i = 0; i < std::min(d->matrix_elements, 25); ++i) {
         params.matrix[i] = d->matrix[i];
         params.matrixf[i] = d->matrixf[i];
     }
     params.matrixsize = d->matrix_elements;
 
+    for (int i = 0; i < 5; ++i) {
+        params.matrix_h[i] = d->matrix_h[i];
+        params.matrix_v[i] = d->matrix_v[i];
+        params.matrixf_h[i] = d->matrixf_h[i];
+        params.matrixf_v[i] = d->matrixf_v[i];
+    }
+
+    params.sepsize_h = d->sep_size_h;
+    params.sepsize_v = d->sep_size_v;
+    for (int i = 0; i < d->sep_size_h; ++i)
+        params.sepf_h[i] = d->sepf_h[i];
+    for (int i = 0; i < d->sep_size_v; ++i)
+        params.sepf_v[i] = d->sepf_v[i];
+
     params.div = d->rdiv;
     params.bias = d->bias;
     params.saturate = d->saturate;
@@ -232,6 +289,60 @@ vs_generic_params make_generic_params(const GenericData *d, const VSVideoFormat
 }
 
 #ifdef VS_TARGET_CPU_X86
+template <GenericOperations op>
+static decltype(&vs_generic_3x3_conv_byte_c) genericSelectAVX512(const VSVideoFormat *fi, GenericData *d) {
+    if (fi->sampleType == stInteger && fi->bytesPerSample == 1) {
+        switch (op) {
+        case GenericPrewitt: return vs_generic_3x3_prewitt_byte_avx512;
+        case GenericSobel: return vs_generic_3x3_sobel_byte_avx512;
+        case GenericMinimum: return vs_generic_3x3_min_byte_avx512;
+        case GenericMaximum: return vs_generic_3x3_max_byte_avx512;
+        case GenericMedian: return vs_generic_3x3_median_byte_avx512;
+        case GenericDeflate: return vs_generic_3x3_deflate_byte_avx512;
+        case GenericInflate: return vs_generic_3x3_inflate_byte_avx512;
+        case GenericConvolution:
+            if (d->convolution_type == ConvolutionSquare && d->matrix_elements == 9)
+                return vs_generic_3x3_conv_byte_avx512;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_byte_avx512;
+            break;
+        }
+    } else if (fi->sampleType == stInteger && fi->bytesPerSample == 2) {
+        switch (op) {
+        case GenericPrewitt: return vs_generic_3x3_prewitt_word_avx512;
+        case GenericSobel: return vs_generic_3x3_sobel_word_avx512;
+        case GenericMinimum: return vs_generic_3x3_min_word_avx512;
+        case GenericMaximum: return vs_generic_3x3_max_word_avx512;
+        case GenericMedian: return vs_generic_3x3_median_word_avx512;
+        case GenericDeflate: return vs_generic_3x3_deflate_word_avx512;
+        case GenericInflate: return vs_generic_3x3_inflate_word_avx512;
+        case GenericConvolution:
+            if (d->convolution_type == ConvolutionSquare && d->matrix_elements == 9)
+                return vs_generic_3x3_conv_word_avx512;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_word_avx512;
+            break;
+        }
+    } else if (fi->sampleType == stFloat && fi->bytesPerSample == 4) {
+        switch (op) {
+        case GenericPrewitt: return vs_generic_3x3_prewitt_float_avx512;
+        case GenericSobel: return vs_generic_3x3_sobel_float_avx512;
+        case GenericMinimum: return vs_generic_3x3_min_float_avx512;
+        case GenericMaximum: return vs_generic_3x3_max_float_avx512;
+        case GenericMedian: return vs_generic_3x3_median_float_avx512;
+        case GenericDeflate: return vs_generic_3x3_deflate_float_avx512;
+        case GenericInflate: return vs_generic_3x3_inflate_float_avx512;
+        case GenericConvolution:
+            if (d->convolution_type == ConvolutionSquare && d->matrix_elements == 9)
+                return vs_generic_3x3_conv_float_avx512;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_float_avx512;
+            break;
+        }
+    }
+    return nullptr;
+}
+
 template <GenericOperations op>
 static decltype(&vs_generic_3x3_conv_byte_c) genericSelectAVX2(const VSVideoFormat *fi, GenericData *d) {
     if (fi->sampleType == stInteger && fi->bytesPerSample == 1) {
@@ -246,6 +357,10 @@ static decltype(&vs_generic_3x3_conv_byte_c) genericSelectAVX2(const VSVideoForm
         case GenericConvolution:
             if (d->convolution_type == ConvolutionSquare && d->matrix_elements == 9)
                 return vs_generic_3x3_conv_byte_avx2;
+            else if (d->convolution_type == ConvolutionSeparable)
+                return vs_generic_5x5_conv_sep_byte_avx2;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_byte_avx2;
             break;
         }
     } else if (fi->sampleType == stInteger && fi->bytesPerSample == 2) {
@@ -260,6 +375,10 @@ static decltype(&vs_generic_3x3_conv_byte_c) genericSelectAVX2(const VSVideoForm
         case GenericConvolution:
             if (d->convolution_type == ConvolutionSquare && d->matrix_elements == 9)
                 return vs_generic_3x3_conv_word_avx2;
+            else if (d->convolution_type == ConvolutionSeparable)
+                return vs_generic_5x5_conv_sep_word_avx2;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_word_avx2;
             break;
         }
     } else if (fi->sampleType == stFloat && fi->bytesPerSample == 4) {
@@ -274,6 +393,10 @@ static decltype(&vs_generic_3x3_conv_byte_c) genericSelectAVX2(const VSVideoForm
         case GenericConvolution:
             if (d->convolution_type == ConvolutionSquare && d->matrix_elements == 9)
                 return vs_generic_3x3_conv_float_avx2;
+            else if (d->convolution_type == ConvolutionSeparable)
+                return vs_generic_5x5_conv_sep_float_avx2;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_float_avx2;
             break;
         }
     }
@@ -349,6 +472,10 @@ static decltype(&vs_generic_3x3_conv_byte_c) genericSelectC(const VSVideoFormat
                 return vs_generic_1d_conv_h_byte_c;
             else if (d->convolution_type == ConvolutionVertical)
                 return vs_generic_1d_conv_v_byte_c;
+            else if (d->convolution_type == ConvolutionSeparable)
+                return vs_generic_5x5_conv_sep_byte_c;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_byte_c;
             break;
         }
     } else if (fi->sampleType == stInteger && fi->bytesPerSample == 2) {
@@ -369,6 +496,10 @@ static decltype(&vs_generic_3x3_conv_byte_c) genericSelectC(const VSVideoFormat
                 return vs_generic_1d_conv_h_word_c;
             else if (d->convolution_type == ConvolutionVertical)
                 return vs_generic_1d_conv_v_word_c;
+            else if (d->convolution_type == ConvolutionSeparable)
+                return vs_generic_5x5_conv_sep_word_c;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_word_c;
             break;
         }
     } else if (fi->sampleType == stFloat && fi->bytesPerSample == 4) {
@@ -389,12 +520,77 @@ static decltype(&vs_generic_3x3_conv_byte_c) genericSelectC(const VSVideoFormat
                 return vs_generic_1d_conv_h_float_c;
             else if (d->convolution_type == ConvolutionVertical)
                 return vs_generic_1d_conv_v_float_c;
+            else if (d->convolution_type == ConvolutionSeparable)
+                return vs_generic_5x5_conv_sep_float_c;
+            else if (d->convolution_type == ConvolutionLargeSeparable)
+                return vs_generic_conv_sep_float_c;
             break;
         }
     }
     return nullptr;
 }
 
+template <GenericOperations op>
+static decltype(&vs_generic_3x3_conv_byte_c) genericSelect(const VSVideoFormat *fi, GenericData *d, int cpulevel) {
+    decltype(&vs_generic_3x3_conv_byte_c) func = nullptr;
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx512_f && getCPUFeatures()->avx512_bw && getCPUFeatures()->avx512_dq && cpulevel >= VS_CPU_LEVEL_AVX512)
+        func = genericSelectAVX512<op>(fi, d);
+    if (!func && getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
+        func = genericSelectAVX2<op>(fi, d);
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2)
+        func = genericSelectSSE2<op>(fi, d);
+#endif
+    if (!func)
+        func = genericSelectC<op>(fi, d);
+    return func;
+}
+
+// strips are sized to keep the two intermediate buffers in the l2 cache, the edges of every strip get the rows
+// the remaining stages need as context and the rows that come out wrong from being near the edge of a strip are thrown away
+static constexpr size_t stripBufferSize = 128 * 1024;
+static constexpr int minStripRows = 16;
+
+static void processStages(const std::vector<GenericStage> &stages, int plane, const uint8_t *srcp, ptrdiff_t src_stride, uint8_t *dstp, ptrdiff_t dst_stride, size_t rowsize, int width, int height) {
+    int context = 0;
+    for (const auto &iter : stages)
+        if (iter.kernel && iter.process[plane])
+            context += iter.radius;
+
+    int stripRows = std::max(minStripRows, static_cast<int>(stripBufferSize / dst_stride) - 2 * context);
+    if (stripRows >= height)
+        stripRows = height;
+    int bufRows = std::min(height, stripRows + 2 * context + minStripRows);
+    uint8_t *buf = vsh::vsh_aligned_malloc<uint8_t>(2 * bufRows * dst_stride, 64);
+
+    for (int y0 = 0; y0 < height;) {
+        int y1 = y0 + stripRows;
+        // a short remainder is added to the last strip instead so no kernel sees too few rows
+        if (height - y1 < minStripRows)
+            y1 = height;
+        int a0 = std::max(0, y0 - context);
+        int a1 = std::min(height, y1 + context);
+
+        const uint8_t *in = srcp + a0 * src_stride;
+        ptrdiff_t in_stride = src_stride;
+        int current = 0;
+        for (const auto &iter : stages) {
+            if (!iter.kernel || !iter.process[plane])
+                continue;
+            uint8_t *out = buf + current * bufRows * dst_stride;
+            iter.kernel(in, in_stride, out, dst_stride, &iter.params[plane], width, a1 - a0);
+            in = out;
+            in_stride = dst_stride;
+            current ^= 1;
+        }
+
+        vsh::bitblt(dstp + y0 * dst_stride, dst_stride, in + (y0 - a0) * in_stride, in_stride, rowsize, y1 - y0);
+        y0 = y1;
+    }
+
+    vsh::vsh_aligned_free(buf);
+}
+
 template <GenericOperations op>
 static const VSFrame *VS_CC genericGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     GenericData *d = static_cast<GenericData *>(instanceData);
@@ -402,6 +598,8 @@ static const VSFrame *VS_CC genericGetframe(int n, int activationReason, void *i
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
+        bool process[3];
+        getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src);
 
@@ -419,26 +617,20 @@ static const VSFrame *VS_CC genericGetframe(int n, int activationReason, void *i
 
         const int pl[] = { 0, 1, 2 };
         const VSFrame *fr[] = {
-            d->process[0] ? nullptr : src,
-            d->process[1] ? nullptr : src,
-            d->process[2] ? nullptr : src
+            process[0] ? nullptr : src,
+            process[1] ? nullptr : src,
+            process[2] ? nullptr : src
         };
 
         VSFrame *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
 
-        void (*func)(const void *, ptrdiff_t, void *, ptrdiff_t, const vs_generic_params *, unsigned, unsigned) = nullptr;
-
-#ifdef VS_TARGET_CPU_X86
-        if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2)
-            func = genericSelectAVX2<op>(fi, d);
-        if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2)
-            func = genericSelectSSE2<op>(fi, d);
-#endif
-        if (!func)
-            func = genericSelectC<op>(fi, d);
-
         for (int plane = 0; plane < fi->numPlanes; plane++) {
-            if (func && d->process[plane]) {
+            if (!d->stages.empty() && process[plane]) {
+                uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+                const uint8_t *srcp = vsapi->getReadPtr(src, plane);
+                int width = vsapi->getFrameWidth(src, plane);
+                processStages(d->stages, plane, srcp, vsapi->getStride(src, plane), dstp, vsapi->getStride(dst, plane), width * fi->bytesPerSample, width, vsapi->getFrameHeight(src, plane));
+            } else if (d->kernel && process[plane]) {
                 uint8_t *dstp = vsapi->getWritePtr(dst, plane);
                 const uint8_t *srcp = vsapi->getReadPtr(src, plane);
                 int width = vsapi->getFrameWidth(src, plane);
@@ -447,7 +639,7 @@ static const VSFrame *VS_CC genericGetframe(int n, int activationReason, void *i
                 ptrdiff_t dst_stride = vsapi->getStride(dst, plane);
 
                 vs_generic_params params = make_generic_params(d, fi, plane);
-                func(srcp, src_stride, dstp, dst_stride, &params, width, height);
+                d->kernel(srcp, src_stride, dstp, dst_stride, &params, width, height);
             }
         }
 
@@ -467,6 +659,134 @@ static inline int64_t floatToInt64S(float f) {
         return static_cast<int64_t>(llround(f));
 }
 
+// Splits a 5x5 matrix into a column and a row vector whose outer product
+// gives back the matrix. Integer matrices only split when the result is exact,
+// so the separable kernels produce the same sums as the 5x5 ones.
+static bool splitMatrix5x5(const int *m, int *v, int *h) {
+    int p = 0;
+    while (p < 5 && !m[p * 5 + 0] && !m[p * 5 + 1] && !m[p * 5 + 2] && !m[p * 5 + 3] && !m[p * 5 + 4])
+        p++;
+    if (p == 5)
+        return false;
+
+    int g = 0;
+    for (int j = 0; j < 5; j++) {
+        int a = std::abs(m[p * 5 + j]);
+        while (a) {
+            int t = g % a;
+            g = a;
+            a = t;
+        }
+    }
+
+    int j0 = -1;
+    for (int j = 0; j < 5; j++) {
+        h[j] = m[p * 5 + j] / g;
+        if (j0 < 0 && h[j])
+            j0 = j;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        if (m[i * 5 + j0] % h[j0])
+            return false;
+        v[i] = m[i * 5 + j0] / h[j0];
+        for (int j = 0; j < 5; j++) {
+            if (v[i] * h[j] != m[i * 5 + j])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool splitMatrix5x5(const float *m, float *v, float *h) {
+    int p = 0;
+    int j0 = 0;
+    float maxabs = 0;
+    for (int i = 0; i < 25; i++) {
+        if (std::fabs(m[i]) > maxabs) {
+            maxabs = std::fabs(m[i]);
+            p = i / 5;
+            j0 = i % 5;
+        }
+    }
+    if (maxabs == 0)
+        return false;
+
+    for (int j = 0; j < 5; j++)
+        h[j] = m[p * 5 + j];
+
+    for (int i = 0; i < 5; i++) {
+        v[i] = m[i * 5 + j0] / h[j0];
+        for (int j = 0; j < 5; j++) {
+            if (std::fabs(v[i] * h[j] - m[i * 5 + j]) > maxabs * 1e-6f)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static const GenericData *getGenericData(VSNode *node) {
+    static const VSFilterGetFrame getFrames[] = {
+        genericGetframe<GenericPrewitt>, genericGetframe<GenericSobel>, genericGetframe<GenericMinimum>, genericGetframe<GenericMaximum>,
+        genericGetframe<GenericMedian>, genericGetframe<GenericDeflate>, genericGetframe<GenericInflate>, genericGetframe<GenericConvolution>
+    };
+
+    for (auto iter : getFrames) {
+        void *data = vs_get_filter_instance_data(node, iter);
+        if (data)
+            return static_cast<const GenericData *>(data);
+    }
+    return nullptr;
+}
+
+template <GenericOperations op>
+static int genericRadius(const GenericData *d) {
+    if (op != GenericConvolution)
+        return 1;
+    if (d->convolution_type == ConvolutionHorizontal)
+        return 0;
+    if (d->convolution_type == ConvolutionVertical)
+        return d->matrix_elements / 2;
+    if (d->convolution_type == ConvolutionLargeSeparable)
+        return d->sep_size_v / 2;
+    return (d->matrix_elements == 25) ? 2 : 1;
+}
+
+template <GenericOperations op>
+static GenericStage makeGenericStage(const GenericData *d) {
+    GenericStage stage = {};
+    stage.kernel = d->kernel;
+    for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
+        stage.process[plane] = d->process[plane];
+        stage.params[plane] = make_generic_params(d, &d->vi->format, plane);
+    }
+    stage.radius = genericRadius<op>(d);
+    return stage;
+}
+
+// takes over the stages of a generic filter in front so a single node runs the whole chain
+static void fuseGenericChain(GenericData *d, const VSAPI *vsapi) {
+    const GenericData *inner = getGenericData(d->node);
+    if (!inner)
+        return;
+
+    if (inner->stages.empty())
+        d->stages.push_back(inner->self);
+    else
+        d->stages = inner->stages;
+    d->stages.push_back(d->self);
+
+    VSNode *node = vsapi->addNodeRef(inner->node);
+    vsapi->freeNode(d->node);
+    d->node = node;
+    d->vi = vsapi->getVideoInfo(d->node);
+    // planes untouched by every stage are still copied from the source
+    for (int plane = 0; plane < 3; plane++)
+        d->process[plane] = d->process[plane] || inner->process[plane];
+}
+
 template <GenericOperations op>
 static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<GenericData> d(new GenericData(vsapi));
@@ -540,7 +860,16 @@ static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSC
             d->matrix_elements = vsapi->mapNumElements(in, "matrix");
 
             const char *mode = vsapi->mapGetData(in, "mode", 0, &err);
-            if (err || mode[0] == 's') {
+            bool hv = !err && !strcmp(mode, "hv");
+            if (hv) {
+                d->convolution_type = ConvolutionLargeSeparable;
+
+                if (d->matrix_elements < 3 || d->matrix_elements > 65)
+                    throw std::runtime_error("When mode is 'hv', matrix must contain between 3 and 65 numbers.");
+
+                if (d->matrix_elements % 2 == 0)
+                    throw std::runtime_error("matrix must contain an odd number of numbers.");
+            } else if (err || mode[0] == 's') {
                 d->convolution_type = ConvolutionSquare;
 
                 if (d->matrix_elements != 9 && d->matrix_elements != 25)
@@ -551,13 +880,13 @@ static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSC
                 else
                     d->convolution_type = ConvolutionVertical;
 
-                if (d->matrix_elements < 3 || d->matrix_elements > 25)
-                    throw std::runtime_error("When mode starts with 'h' or 'v', matrix must contain between 3 and 25 numbers.");
+                if (d->matrix_elements < 3 || d->matrix_elements > 65)
+                    throw std::runtime_error("When mode starts with 'h' or 'v', matrix must contain between 3 and 65 numbers.");
 
                 if (d->matrix_elements % 2 == 0)
                     throw std::runtime_error("matrix must contain an odd number of numbers.");
             } else {
-                throw std::runtime_error("mode must start with 's', 'h', or 'v'.");
+                throw std::runtime_error("mode must be 'hv' or start with 's', 'h', or 'v'.");
             }
 
             float matrix_sumf = 0;
@@ -578,9 +907,49 @@ static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSC
                 d->matrix_sum += d->matrix[i];
             }
 
+            // the vector is applied in both directions so the matrix it stands for sums to the square
+            if (hv)
+                matrix_sumf *= matrix_sumf;
+
             if (std::abs(matrix_sumf) < std::numeric_limits<float>::epsilon())
                 matrix_sumf = 1.0;
 
+            if (hv) {
+                // small filters become the matrix they stand for when it's still exact, bigger ones are done in float
+                bool fits = d->matrix_elements <= 5;
+                for (int i = 0; i < d->matrix_elements && fits; i++)
+                    for (int j = 0; j < d->matrix_elements && fits; j++)
+                        fits = d->vi->format.sampleType != stInteger || std::abs(d->matrix[i] * d->matrix[j]) <= 1023;
+
+                if (fits) {
+                    int n = d->matrix_elements;
+                    int vm[5];
+                    float vmf[5];
+                    std::copy(d->matrix, d->matrix + n, vm);
+                    std::copy(d->matrixf, d->matrixf + n, vmf);
+                    for (int i = 0; i < n; i++) {
+                        for (int j = 0; j < n; j++) {
+                            d->matrix[i * n + j] = vm[i] * vm[j];
+                            d->matrixf[i * n + j] = vmf[i] * vmf[j];
+                        }
+                    }
+                    d->convolution_type = ConvolutionSquare;
+                    d->matrix_elements = n * n;
+                } else {
+                    d->sep_size_h = d->matrix_elements;
+                    d->sep_size_v = d->matrix_elements;
+                    std::copy(d->matrixf, d->matrixf + d->matrix_elements, d->sepf_h);
+                    std::copy(d->matrixf, d->matrixf + d->matrix_elements, d->sepf_v);
+                }
+            } else if ((d->convolution_type == ConvolutionHorizontal || d->convolution_type == ConvolutionVertical) && d->matrix_elements > 25) {
+                bool horizontal = (d->convolution_type == ConvolutionHorizontal);
+                d->convolution_type = ConvolutionLargeSeparable;
+                d->sep_size_h = horizontal ? d->matrix_elements : 1;
+                d->sep_size_v = horizontal ? 1 : d->matrix_elements;
+                std::copy(d->matrixf, d->matrixf + d->matrix_elements, horizontal ? d->sepf_h : d->sepf_v);
+                (horizontal ? d->sepf_v : d->sepf_h)[0] = 1.0f;
+            }
+
             d->rdiv = static_cast<float>(vsapi->mapGetFloat(in, "divisor", 0, &err));
             if (d->rdiv == 0.0f)
                 d->rdiv = static_cast<float>(matrix_sumf);
@@ -631,6 +1000,14 @@ static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSC
                 d->matrixf[5] = 0.f;
                 d->matrixf[6] = 0.f;
                 d->matrixf[8] = 0.f;
+            } else if (op == GenericConvolution && d->convolution_type == ConvolutionSquare && d->matrix_elements == 25) {
+                bool separable;
+                if (d->vi->format.sampleType == stInteger)
+                    separable = splitMatrix5x5(d->matrix, d->matrix_v, d->matrix_h);
+                else
+                    separable = splitMatrix5x5(d->matrixf, d->matrixf_v, d->matrixf_h);
+                if (separable)
+                    d->convolution_type = ConvolutionSeparable;
             }
         }
 
@@ -638,15 +1015,22 @@ static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSC
             throw std::runtime_error("Width must be bigger than convolution radius.");
         if (op == GenericConvolution && d->convolution_type == ConvolutionVertical && d->matrix_elements / 2 >= planeHeight(d->vi, d->vi->format.numPlanes - 1))
             throw std::runtime_error("Height must be bigger than convolution radius.");
+        if (op == GenericConvolution && d->convolution_type == ConvolutionLargeSeparable && d->sep_size_h / 2 >= planeWidth(d->vi, d->vi->format.numPlanes - 1))
+            throw std::runtime_error("Width must be bigger than convolution radius.");
+        if (op == GenericConvolution && d->convolution_type == ConvolutionLargeSeparable && d->sep_size_v / 2 >= planeHeight(d->vi, d->vi->format.numPlanes - 1))
+            throw std::runtime_error("Height must be bigger than convolution radius.");
 
-        d->cpulevel = vs_get_cpulevel(core);
+        d->kernel = genericSelect<op>(&d->vi->format, d.get(), vs_get_cpulevel(core));
+        d->self = makeGenericStage<op>(d.get());
+        if (vs_fuse_spatial_filters(core))
+            fuseGenericChain(d.get(), vsapi);
     } catch (const std::runtime_error &error) {
         vsapi->mapSetError(out, (d->filter_name + ": "_s + error.what()).c_str());
         return;
     }
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, d->filter_name, d->vi, genericGetframe<op>, filterFree<GenericData>, fmParallel, deps, 1, d.get(), core);
+    createSamePlaneVideoFilter(out, d->filter_name, d->vi, genericGetframe<op>, filterFree<GenericData>, fmParallel, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -658,50 +1042,39 @@ struct InvertDataExtra {
     const char *name;
     bool process[3];
     bool mask;
+    int cpulevel;
 };
 
 typedef SingleNodeData<InvertDataExtra> InvertData;
 
 struct InvertOp {
-    uint16_t max;
-    bool uv;
-
-    InvertOp(InvertData *d, const VSVideoFormat *fi, int plane) {
-        uv = (!d->mask) && (fi->colorFamily == cfYUV) && (plane > 0);
-        max = (1LL << fi->bitsPerSample) - 1;
-    }
-
-    template<typename T>
-    static FORCE_INLINE void processPlane(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const InvertOp &opts) {
-        for (unsigned w = 0; w < width; w++)
-            dst[w] = static_cast<T>(opts.max) - std::min(src[w], static_cast<T>(opts.max));
-    }
-
-    template<typename T>
-    static FORCE_INLINE void processPlaneF(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const InvertOp &opts) {
-        if (opts.uv) {
-            for (unsigned w = 0; w < width; w++)
-                dst[w] = -src[w];
-        } else {
-            for (unsigned w = 0; w < width; w++)
-                dst[w] = 1 - src[w];
-        }
+    static const PointKernelTable kernels;
+
+    static vs_generic_params params(const InvertData *d, const VSVideoFormat *fi, int plane) {
+        vs_generic_params params{};
+        bool uv = (!d->mask) && (fi->colorFamily == cfYUV) && (plane > 0);
+        params.maxval = static_cast<uint16_t>((1LL << fi->bitsPerSample) - 1);
+        params.hif = uv ? 0.f : 1.f;
+        return params;
     }
 };
 
+const PointKernelTable InvertOp::kernels = POINT_KERNELS(invert);
+
 static void VS_CC invertCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<InvertData> d(new InvertData(vsapi));
 
     try {
         templateInit(d, userData ? "InvertMask" : "Invert", true, in, out, vsapi);
         d->mask = !!userData;
+        d->cpulevel = vs_get_cpulevel(core);
     } catch (const std::runtime_error &error) {
         vsapi->mapSetError(out, (d->name + ": "_s + error.what()).c_str());
         return;
     }
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, d->name, d->vi, singlePixelGetFrame<InvertData, InvertOp>, filterFree<InvertData>, fmParallel, deps, 1, d.get(), core);
+    createSamePlaneVideoFilter(out, d->name, d->vi, singlePixelGetFrame<InvertData, InvertOp>, filterFree<InvertData>, fmParallel, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -713,34 +1086,26 @@ struct LimitDataExtra {
     bool process[3];
     uint16_t max[3], min[3];
     float maxf[3], minf[3];
+    int cpulevel;
 };
 
 typedef SingleNodeData<LimitDataExtra> LimitData;
 
 struct LimitOp {
-    uint16_t max, min;
-    float maxf, minf;
-
-    LimitOp(LimitData *d, const VSVideoFormat *fi, int plane) {
-        max = d->max[plane];
-        min = d->min[plane];
-        maxf = d->maxf[plane];
-        minf = d->minf[plane];
-    }
-
-    template<typename T>
-    static FORCE_INLINE void processPlane(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const LimitOp &opts) {
-        for (unsigned w = 0; w < width; w++)
-            dst[w] = std::min(static_cast<T>(opts.max), std::max(static_cast<T>(opts.min), src[w]));
-    }
-
-    template<typename T>
-    static FORCE_INLINE void processPlaneF(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const LimitOp &opts) {
-        for (unsigned w = 0; w < width; w++)
-            dst[w] = std::min(opts.maxf, std::max(opts.minf, src[w]));
+    static const PointKernelTable kernels;
+
+    static vs_generic_params params(const LimitData *d, const VSVideoFormat *fi, int plane) {
+        vs_generic_params params{};
+        params.lo = d->min[plane];
+        params.hi = d->max[plane];
+        params.lof = d->minf[plane];
+        params.hif = d->maxf[plane];
+        return params;
     }
 };
 
+const PointKernelTable LimitOp::kernels = POINT_KERNELS(limit);
+
 static void VS_CC limitCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<LimitData> d(new LimitData(vsapi));
 
@@ -751,13 +1116,14 @@ static void VS_CC limitCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         for (int i = 0; i < 3; i++)
             if (((d->vi->format.sampleType == stInteger) && (d->min[i] > d->max[i])) || ((d->vi->format.sampleType == stFloat) && (d->minf[i] > d->maxf[i])))
                 throw std::runtime_error("min bigger than max");
+        d->cpulevel = vs_get_cpulevel(core);
     } catch (const std::runtime_error &error) {
         vsapi->mapSetError(out, (d->name + ": "_s + error.what()).c_str());
         return;
     }
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, d->name, d->vi, singlePixelGetFrame<LimitData, LimitOp>, filterFree<LimitData>, fmParallel, deps, 1, d.get(), core);
+    createSamePlaneVideoFilter(out, d->name, d->vi, singlePixelGetFrame<LimitData, LimitOp>, filterFree<LimitData>, fmParallel, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -769,42 +1135,28 @@ struct BinarizeDataExtra {
     bool process[3];
     uint16_t v0[3], v1[3], thr[3];
     float v0f[3], v1f[3], thrf[3];
+    int cpulevel;
 };
 
 typedef SingleNodeData<BinarizeDataExtra> BinarizeData;
 
 struct BinarizeOp {
-    uint16_t v0, v1, thr;
-    float v0f, v1f, thrf;
-
-    BinarizeOp(BinarizeData *d, const VSVideoFormat *fi, int plane) {
-        v0 = d->v0[plane];
-        v1 = d->v1[plane];
-        v0f = d->v0f[plane];
-        v1f = d->v1f[plane];
-        thr = d->thr[plane];
-        thrf = d->thrf[plane];
-    }
-
-    template<typename T>
-    static FORCE_INLINE void processPlane(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const BinarizeOp &opts) {
-        for (unsigned w = 0; w < width; w++)
-            if (src[w] < opts.thr)
-                dst[w] = static_cast<T>(opts.v0);
-            else
-                dst[w] = static_cast<T>(opts.v1);
-    }
-
-    template<typename T>
-    static FORCE_INLINE void processPlaneF(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const BinarizeOp &opts) {
-        for (unsigned w = 0; w < width; w++)
-            if (src[w] < opts.thrf)
-                dst[w] = opts.v0f;
-            else
-                dst[w] = opts.v1f;
+    static const PointKernelTable kernels;
+
+    static vs_generic_params params(const BinarizeData *d, const VSVideoFormat *fi, int plane) {
+        vs_generic_params params{};
+        params.lo = d->v0[plane];
+        params.hi = d->v1[plane];
+        params.threshold = d->thr[plane];
+        params.lof = d->v0f[plane];
+        params.hif = d->v1f[plane];
+        params.thresholdf = d->thrf[plane];
+        return params;
     }
 };
 
+const PointKernelTable BinarizeOp::kernels = POINT_KERNELS(binarize);
+
 static void VS_CC binarizeCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<BinarizeData> d(new BinarizeData(vsapi));
 
@@ -813,13 +1165,14 @@ static void VS_CC binarizeCreate(const VSMap *in, VSMap *out, void *userData, VS
         getPlanePixelRangeArgs(d->vi->format, in, "v0", d->v0, d->v0f, RangeLower, !!userData, vsapi);
         getPlanePixelRangeArgs(d->vi->format, in, "v1", d->v1, d->v1f, RangeUpper, !!userData, vsapi);
         getPlanePixelRangeArgs(d->vi->format, in, "threshold", d->thr, d->thrf, RangeMiddle, !!userData, vsapi);
+        d->cpulevel = vs_get_cpulevel(core);
     } catch (const std::runtime_error &error) {
         vsapi->mapSetError(out, (d->name + ": "_s + error.what()).c_str());
         return;
     }
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, d->name, d->vi, singlePixelGetFrame<BinarizeData, BinarizeOp>, filterFree<BinarizeData>, fmParallel, deps, 1, d.get(), core);
+    createSamePlaneVideoFilter(out, d->name, d->vi, singlePixelGetFrame<BinarizeData, BinarizeOp>, filterFree<BinarizeData>, fmParallel, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -833,10 +1186,13 @@ struct LevelsDataExtra {
     float gamma;
     float max_in, max_out, min_in, min_out;
     std::vector<uint8_t> lut;
+    int cpulevel;
 };
 
 typedef SingleNodeData<LevelsDataExtra> LevelsData;
 
+typedef void (*LevelsLutKernel)(const void *src, void *dst, const void *lut, unsigned maxval, unsigned n);
+
 template<typename T>
 static const VSFrame *VS_CC levelsGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     LevelsData *d = reinterpret_cast<LevelsData *>(instanceData);
@@ -844,14 +1200,22 @@ static const VSFrame *VS_CC levelsGetframe(int n, int activationReason, void *in
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
+        bool process[3];
+        getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src);
         const int pl[] = { 0, 1, 2 };
-        const VSFrame *fr[] = { d->process[0] ? 0 : src, d->process[1] ? 0 : src, d->process[2] ? 0 : src };
+        const VSFrame *fr[] = { process[0] ? 0 : src, process[1] ? 0 : src, process[2] ? 0 : src };
         VSFrame *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
 
+        LevelsLutKernel kernel = nullptr;
+#ifdef VS_TARGET_CPU_X86
+        if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2)
+            kernel = (sizeof(T) == 1) ? vs_lut_byte_byte_avx2 : vs_lut_word_word_avx2;
+#endif
+
         for (int plane = 0; plane < fi->numPlanes; plane++) {
-            if (d->process[plane]) {
+            if (process[plane]) {
                 const T * VS_RESTRICT srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, plane));
                 ptrdiff_t src_stride = vsapi->getStride(src, plane);
                 T * VS_RESTRICT dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, plane));
@@ -863,8 +1227,12 @@ static const VSFrame *VS_CC levelsGetframe(int n, int activationReason, void *in
                 const T * VS_RESTRICT lut = reinterpret_cast<const T *>(d->lut.data());
 
                 for (int hl = 0; hl < h; hl++) {
-                    for (int x = 0; x < w; x++)
-                        dstp[x] = lut[std::min(srcp[x], maxval)];
+                    if (kernel) {
+                        kernel(srcp, dstp, lut, maxval, w);
+                    } else {
+                        for (int x = 0; x < w; x++)
+                            dstp[x] = lut[std::min(srcp[x], maxval)];
+                    }
 
                     dstp += dst_stride / sizeof(T);
                     srcp += src_stride / sizeof(T);
@@ -879,55 +1247,43 @@ static const VSFrame *VS_CC levelsGetframe(int n, int activationReason, void *in
     return nullptr;
 }
 
-template<typename T>
 static const VSFrame *VS_CC levelsGetframeF(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     LevelsData *d = reinterpret_cast<LevelsData *>(instanceData);
 
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
+        bool process[3];
+        getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src);
         const int pl[] = { 0, 1, 2 };
-        const VSFrame *fr[] = { d->process[0] ? 0 : src, d->process[1] ? 0 : src, d->process[2] ? 0 : src };
+        const VSFrame *fr[] = { process[0] ? 0 : src, process[1] ? 0 : src, process[2] ? 0 : src };
         VSFrame *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
 
-        for (int plane = 0; plane < fi->numPlanes; plane++) {
-            if (d->process[plane]) {
-                const T * VS_RESTRICT srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, plane));
-                ptrdiff_t src_stride = vsapi->getStride(src, plane);
-                T * VS_RESTRICT dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, plane));
-                ptrdiff_t dst_stride = vsapi->getStride(dst, plane);
-                int h = vsapi->getFrameHeight(src, plane);
-                int w = vsapi->getFrameWidth(src, plane);
+        vs_generic_params params{};
+        params.gamma = d->gamma;
+        params.min_in = d->min_in;
+        params.max_in = d->max_in;
+        params.min_out = d->min_out;
+        params.max_out = d->max_out;
 
-                T gamma = d->gamma;
-                T range_in = 1.f / (d->max_in - d->min_in);
-                T range_out = d->max_out - d->min_out;
-                T min_in = d->min_in;
-                T min_out = d->min_out;
-                T max_in = d->max_in;
-
-                if (std::abs(d->gamma - static_cast<T>(1.0)) < std::numeric_limits<T>::epsilon()) {
-                    T range_scale = range_out / (d->max_in - d->min_in);
-                    for (int hl = 0; hl < h; hl++) {
-                        for (int x = 0; x < w; x++)
-                            dstp[x] = (std::max(std::min(srcp[x], max_in) - min_in, 0.f)) * range_scale + min_out;
-
-                        dstp += dst_stride / sizeof(T);
-                        srcp += src_stride / sizeof(T);
-                    }
-                } else {
-                    for (int hl = 0; hl < h; hl++) {
-                        for (int x = 0; x < w; x++)
-                            dstp[x] = std::pow((std::max(std::min(srcp[x], max_in) - min_in, 0.f)) * range_in, gamma) * range_out + min_out;
-
-                        dstp += dst_stride / sizeof(T);
-                        srcp += src_stride / sizeof(T);
-                    }
-                }
+        PointKernel func = vs_generic_levels_float_c;
+#ifdef VS_TARGET_CPU_X86
+        // The vectorized pow needs a non-negative base.
+        if (d->max_in > d->min_in) {
+            switch (pointKernelIsa(d->cpulevel)) {
+            case 3: func = vs_generic_levels_float_avx512; break;
+            case 2: func = vs_generic_levels_float_avx2; break;
+            case 1: func = vs_generic_levels_float_sse2; break;
             }
         }
+#endif
+
+        for (int plane = 0; plane < fi->numPlanes; plane++) {
+            if (process[plane])
+                func(vsapi->getReadPtr(src, plane), vsapi->getStride(src, plane), vsapi->getWritePtr(dst, plane), vsapi->getStride(dst, plane), &params, vsapi->getFrameWidth(src, plane), vsapi->getFrameHeight(src, plane));
+        }
 
         vsapi->freeFrame(src);
         return dst;
@@ -941,6 +1297,7 @@ static void VS_CC levelsCreate(const VSMap *in, VSMap *out, void *userData, VSCo
 
     try {
         templateInit(d, "Levels", false, in, out, vsapi);
+        d->cpulevel = vs_get_cpulevel(core);
     } catch (const std::runtime_error &error) {
         vsapi->mapSetError(out, (d->name + ": "_s + error.what()).c_str());
         return;
@@ -968,7 +1325,7 @@ static void VS_CC levelsCreate(const VSMap *in, VSMap *out, void *userData, VSCo
     // Implement with simple lut for integer
     if (d->vi->format.sampleType == stInteger) {
         int maxval = (1 << d->vi->format.bitsPerSample) - 1;
-        d->lut.resize(d->vi->format.bytesPerSample * (1 << d->vi->format.bitsPerSample));
+        d->lut.resize(d->vi->format.bytesPerSample * (1 << d->vi->format.bitsPerSample) + VS_LUT_PADDING);
 
         d->min_in = std::round(d->min_in);
         d->min_out = std::round(d->min_out);
@@ -987,11 +1344,11 @@ static void VS_CC levelsCreate(const VSMap *in, VSMap *out, void *userData, VSCo
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
     if (d->vi->format.bytesPerSample == 1)
-        vsapi->createVideoFilter(out, d->name, d->vi, levelsGetframe<uint8_t>, filterFree<LevelsData>, fmParallel, deps, 1, d.get(), core);
+        createSamePlaneVideoFilter(out, d->name, d->vi, levelsGetframe<uint8_t>, filterFree<LevelsData>, fmParallel, deps, 1, d.get(), core, vsapi);
     else if (d->vi->format.bytesPerSample == 2)
-        vsapi->createVideoFilter(out, d->name, d->vi, levelsGetframe<uint16_t>, filterFree<LevelsData>, fmParallel, deps, 1, d.get(), core);
+        createSamePlaneVideoFilter(out, d->name, d->vi, levelsGetframe<uint16_t>, filterFree<LevelsData>, fmParallel, deps, 1, d.get(), core, vsapi);
     else
-        vsapi->createVideoFilter(out, d->name, d->vi, levelsGetframeF<float>, filterFree<LevelsData>, fmParallel, deps, 1, d.get(), core);
+        createSamePlaneVideoFilter(out, d->name, d->vi, levelsGetframeF, filterFree<LevelsData>, fmParallel, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -22,6 +22,7 @@
 #define INTERNALFILTERS_H
 
 #include "VapourSynth4.h"
+#include <string>
 
 #ifdef VS_USE_MIMALLOC
 #   include <mimalloc-override.h>
@@ -37,5 +38,18 @@ void VS_CC genericInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi);
 void VS_CC lutInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi);
 void VS_CC boxBlurInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi);
 void VS_CC resizeInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi);
+void VS_CC remoteInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi);
+
+bool vs_fuse_pointwise_filters(const VSCore *core);
+bool vs_fuse_resize_chains(const VSCore *core);
+bool vs_fuse_spatial_filters(const VSCore *core);
+// writes a symbol for generated code with ccfWriteJITSymbols so profilers can name it
+void vs_register_jit_code(const VSCore *core, const void *code, size_t size, const std::string &name);
+// returns the clip node crops from and the position of the cropped area if node is a Crop of a constant format clip
+bool vs_get_crop_source(const VSNode *node, VSNode **source, int *left, int *top);
+// returns the instance data of node if it was created with getFrame so filters can recognize and merge with their own instances
+void *vs_get_filter_instance_data(const VSNode *node, VSFilterGetFrame getFrame);
+// returns an id that is never given to another function so it can be used as a cache key
+uint64_t vs_get_function_id(const VSFunction *func);
 
 #endif // INTERNALFILTERS_H
@@ -51,11 +51,20 @@ public:
     }
 
     vs_intrusive_ptr &operator=(vs_intrusive_ptr const &ptr) noexcept {
+        if (ptr.obj)
+            ptr.obj->add_ref();
         if (obj)
             obj->release();
         obj = ptr.obj;
-        if (obj)
-            obj->add_ref();
+        return *this;
+    }
+
+    vs_intrusive_ptr &operator=(vs_intrusive_ptr &&ptr) noexcept {
+        if (this != &ptr) {
+            reset();
+            obj = ptr.obj;
+            ptr.obj = nullptr;
+        }
         return *this;
     }
 
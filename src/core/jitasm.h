@@ -181,6 +181,8 @@ enum PhysicalRegID
 	MM0=0, MM1, MM2, MM3, MM4, MM5, MM6, MM7,
 	XMM0=0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
 	YMM0=0, YMM1, YMM2, YMM3, YMM4, YMM5, YMM6, YMM7, YMM8, YMM9, YMM10, YMM11, YMM12, YMM13, YMM14, YMM15,
+	ZMM0=0, ZMM1, ZMM2, ZMM3, ZMM4, ZMM5, ZMM6, ZMM7, ZMM8, ZMM9, ZMM10, ZMM11, ZMM12, ZMM13, ZMM14, ZMM15,
+	K0=0, K1, K2, K3, K4, K5, K6, K7,
 };
 
 enum
@@ -211,7 +213,12 @@ enum RegType
 	R_TYPE_SYMBOLIC_GP,		///< Symbolic general purpose register
 	R_TYPE_SYMBOLIC_MMX,	///< Symbolic MMX register
 	R_TYPE_SYMBOLIC_XMM,	///< Symbolic XMM register
-	R_TYPE_SYMBOLIC_YMM		///< Symbolic YMM register
+	R_TYPE_SYMBOLIC_YMM,	///< Symbolic YMM register
+	// The symbolic type is always the physical type + R_TYPE_SYMBOLIC_GP
+	R_TYPE_ZMM = 9,			///< ZMM register
+	R_TYPE_K = 10,			///< AVX-512 opmask register
+	R_TYPE_SYMBOLIC_ZMM = R_TYPE_ZMM + R_TYPE_SYMBOLIC_GP,	///< Symbolic ZMM register
+	R_TYPE_SYMBOLIC_K = R_TYPE_K + R_TYPE_SYMBOLIC_GP		///< Symbolic opmask register
 };
 
 /// Register identifier
@@ -224,7 +231,7 @@ struct RegID
 	bool operator!=(const RegID& rhs) const {return !(*this == rhs);}
 	bool operator<(const RegID& rhs) const {return type != rhs.type ? type < rhs.type : id < rhs.id;}
 	bool IsInvalid() const	{return type == R_TYPE_GP && id == INVALID;}
-	bool IsSymbolic() const {return type == R_TYPE_SYMBOLIC_GP || type == R_TYPE_SYMBOLIC_MMX || type == R_TYPE_SYMBOLIC_XMM || type == R_TYPE_SYMBOLIC_YMM;}
+	bool IsSymbolic() const {return type == R_TYPE_SYMBOLIC_GP || type == R_TYPE_SYMBOLIC_MMX || type == R_TYPE_SYMBOLIC_XMM || type == R_TYPE_SYMBOLIC_YMM || type == R_TYPE_SYMBOLIC_ZMM || type == R_TYPE_SYMBOLIC_K;}
 	RegType GetType() const {return static_cast<RegType>(type);}
 
 	static RegID Invalid() {
@@ -273,6 +280,7 @@ enum OpdSize
 	O_SIZE_128,
 	O_SIZE_224,
 	O_SIZE_256,
+	O_SIZE_512,
 	O_SIZE_864,
 	O_SIZE_4096
 };
@@ -325,6 +333,8 @@ namespace detail
 		bool	IsMmxReg() const	{return IsReg() && (reg_.type == R_TYPE_MMX || reg_.type == R_TYPE_SYMBOLIC_MMX);}
 		bool	IsXmmReg() const	{return IsReg() && (reg_.type == R_TYPE_XMM || reg_.type == R_TYPE_SYMBOLIC_XMM);}
 		bool	IsYmmReg() const	{return IsReg() && (reg_.type == R_TYPE_YMM || reg_.type == R_TYPE_SYMBOLIC_YMM);}
+		bool	IsZmmReg() const	{return IsReg() && (reg_.type == R_TYPE_ZMM || reg_.type == R_TYPE_SYMBOLIC_ZMM);}
+		bool	IsKReg() const		{return IsReg() && (reg_.type == R_TYPE_K || reg_.type == R_TYPE_SYMBOLIC_K);}
 		bool	IsMem() const		{return (opdtype_ & O_TYPE_TYPE_MASK) == O_TYPE_MEM;}
 		bool	IsImm() const		{return (opdtype_ & O_TYPE_TYPE_MASK) == O_TYPE_IMM;}
 		bool	IsDummy() const		{return (opdtype_ & O_TYPE_DUMMY) != 0;}
@@ -406,6 +416,7 @@ namespace detail
 	template<> inline OpdSize ToOpdSize<128>() {return O_SIZE_128;}
 	template<> inline OpdSize ToOpdSize<224>() {return O_SIZE_224;}
 	template<> inline OpdSize ToOpdSize<256>() {return O_SIZE_256;}
+	template<> inline OpdSize ToOpdSize<512>() {return O_SIZE_512;}
 	template<> inline OpdSize ToOpdSize<864>() {return O_SIZE_864;}
 	template<> inline OpdSize ToOpdSize<4096>() {return O_SIZE_4096;}
 
@@ -434,6 +445,7 @@ typedef detail::OpdT<80>	Opd80;
 typedef detail::OpdT<128>	Opd128;
 typedef detail::OpdT<224>	Opd224;		// FPU environment
 typedef detail::OpdT<256>	Opd256;
+typedef detail::OpdT<512>	Opd512;
 typedef detail::OpdT<864>	Opd864;		// FPU state
 typedef detail::OpdT<4096>	Opd4096;	// FPU, MMX, XMM, MXCSR state
 
@@ -482,12 +494,33 @@ struct XmmReg : Opd128 {
 struct YmmReg : Opd256 {
 	YmmReg() : Opd256(RegID::CreateSymbolicRegID(R_TYPE_SYMBOLIC_YMM)) {}
 	explicit YmmReg(PhysicalRegID id) : Opd256(RegID::CreatePhysicalRegID(R_TYPE_YMM, id)) {}
+	explicit YmmReg(RegID reg_id) : Opd256(reg_id) {}
 	XmmReg as128() const {
 		RegID id = reg_;
 		id.type = R_TYPE_SYMBOLIC_XMM;
 		return XmmReg(id);
 	}
 };
+/// ZMM register
+struct ZmmReg : Opd512 {
+	ZmmReg() : Opd512(RegID::CreateSymbolicRegID(R_TYPE_SYMBOLIC_ZMM)) {}
+	explicit ZmmReg(PhysicalRegID id) : Opd512(RegID::CreatePhysicalRegID(R_TYPE_ZMM, id)) {}
+	XmmReg as128() const {
+		RegID id = reg_;
+		id.type = R_TYPE_SYMBOLIC_XMM;
+		return XmmReg(id);
+	}
+	YmmReg as256() const {
+		RegID id = reg_;
+		id.type = R_TYPE_SYMBOLIC_YMM;
+		return YmmReg(id);
+	}
+};
+/// AVX-512 opmask register, k0 can't be used as a write mask
+struct KReg : Opd64 {
+	KReg() : Opd64(RegID::CreateSymbolicRegID(R_TYPE_SYMBOLIC_K)) {}
+	explicit KReg(PhysicalRegID id) : Opd64(RegID::CreatePhysicalRegID(R_TYPE_K, id)) {}
+};
 
 struct FpuReg_st0 : FpuReg {FpuReg_st0() : FpuReg(ST0) {}};
 
@@ -504,6 +537,7 @@ typedef MemT<Opd80>		Mem80;
 typedef MemT<Opd128>	Mem128;
 typedef MemT<Opd224>	Mem224;		// FPU environment
 typedef MemT<Opd256>	Mem256;
+typedef MemT<Opd512>	Mem512;
 typedef MemT<Opd864>	Mem864;		// FPU state
 typedef MemT<Opd4096>	Mem4096;	// FPU, MMX, XMM, MXCSR state
 
@@ -935,6 +969,10 @@ enum InstrID
 	I_VEXTRACTI128, I_VINSERTI128, I_VMASKMOVD, I_VMASKMOVQ, I_VPSLLVD, I_VPSLLVQ, I_VPSRAVD, I_VPSRLVD, I_VPSRLVQ,
 	I_VGATHERDPS, I_VGATHERQPS, I_VGATHERDPD, I_VGATHERQPD, I_VPGATHERDD, I_VPGATHERQD, I_VPGATHERDQ, I_VPGATHERQQ,
 
+	// AVX-512
+	I_VBLENDMPS, I_VPTERNLOGD, I_VPMOVUSDB, I_VPMOVUSDW,
+	I_KANDW, I_KORW, I_KXORW, I_KXNORW, I_KNOTW, I_KMOVW,
+
 	// jitasm compiler instructions
 	I_COMPILER_DECLARE_REG_ARG,		///< Declare register argument
 	I_COMPILER_DECLARE_STACK_ARG,	///< Declare stack argument
@@ -977,6 +1015,9 @@ enum EncodingFlags
 	E_VEX_F2				= 3 << E_VEX_PP_SHIFT,
 	E_XOP_P00				= 0 << E_VEX_PP_SHIFT,
 	E_XOP_P01				= 1 << E_VEX_PP_SHIFT,
+	E_EVEX					= 1 << 18,	///< EVEX prefix, uses the VEX fields above and E_VEX_L for 256 bit
+	E_EVEX_L2				= 1 << 19,	///< EVEX 512 bit vector length
+	E_EVEX_Z				= 1 << 20,	///< Zero masking instead of merge masking
 
 	E_VEX_128		= E_VEX,
 	E_VEX_256		= E_VEX | E_VEX_L,
@@ -1012,6 +1053,14 @@ enum EncodingFlags
 	E_VEX_256_66_0F38_W1 = E_VEX_256 | E_VEX_66_0F38 | E_VEX_W1,
 	E_VEX_128_66_0F3A_W0 = E_VEX_128 | E_VEX_66_0F3A | E_VEX_W0,
 	E_VEX_256_66_0F3A_W0 = E_VEX_256 | E_VEX_66_0F3A | E_VEX_W0,
+	E_EVEX_512		= E_EVEX | E_EVEX_L2,
+	E_EVEX_512_0F_W0 = E_EVEX_512 | E_VEX_0F | E_VEX_W0,
+	E_EVEX_512_66_0F_W0 = E_EVEX_512 | E_VEX_66_0F | E_VEX_W0,
+	E_EVEX_512_66_0F_W1 = E_EVEX_512 | E_VEX_66_0F | E_VEX_W1,
+	E_EVEX_512_F3_0F_W0 = E_EVEX_512 | E_VEX_F3_0F | E_VEX_W0,
+	E_EVEX_512_66_0F38_W0 = E_EVEX_512 | E_VEX_66_0F38 | E_VEX_W0,
+	E_EVEX_512_F3_0F38_W0 = E_EVEX_512 | E_VEX_F3_0F38 | E_VEX_W0,
+	E_EVEX_512_66_0F3A_W0 = E_EVEX_512 | E_VEX_66_0F3A | E_VEX_W0,
 };
 
 /// Instruction
@@ -1081,9 +1130,24 @@ struct Backend
 		return wrxb;
 	}
 
-	void EncodePrefixes(uint32 flag, const detail::Opd& reg, const detail::Opd& r_m, const detail::Opd& vex)
+	void EncodePrefixes(uint32 flag, const detail::Opd& reg, const detail::Opd& r_m, const detail::Opd& vex, const detail::Opd& mask = detail::Opd())
 	{
-		if (flag & (E_VEX | E_XOP)) {
+		if (flag & E_EVEX) {
+			// Encode EVEX prefix, only the first 16 vector registers are supported so R', X (for registers) and V' are always set
+#ifdef JITASM64
+			if (r_m.IsMem() && r_m.GetAddressBaseSize() != O_SIZE_64) db(0x67);
+#endif
+			uint8 vvvv = vex.IsReg() ? 0xF - (uint8) vex.GetReg().id : 0xF;
+			uint8 mm = (flag & E_VEX_MMMMM_MASK) >> E_VEX_MMMMM_SHIFT;
+			uint8 pp = static_cast<uint8>((flag & E_VEX_PP_MASK) >> E_VEX_PP_SHIFT);
+			uint8 wrxb = GetWRXB(flag & E_VEX_W, reg, r_m);
+			uint8 ll = (flag & E_EVEX_L2) ? 2 : (flag & E_VEX_L) ? 1 : 0;
+			uint8 aaa = mask.IsReg() ? (uint8) mask.GetReg().id : 0;
+			db(0x62);
+			db((~wrxb & 7) << 5 | 0x10 | mm);
+			db((wrxb & 8) << 4 | vvvv << 3 | 4 | pp);
+			db((flag & E_EVEX_Z ? 0x80 : 0) | ll << 5 | 8 | aaa);
+		} else if (flag & (E_VEX | E_XOP)) {
 			// Encode VEX prefix
 #ifdef JITASM64
 			if (r_m.IsMem() && r_m.GetAddressBaseSize() != O_SIZE_64) db(0x67);
@@ -1136,7 +1200,8 @@ struct Backend
 		}
 	}
 
-	void EncodeModRM(uint8 reg, const detail::Opd& r_m)
+	/// disp8_scale is the EVEX compressed displacement factor
+	void EncodeModRM(uint8 reg, const detail::Opd& r_m, sint64 disp8_scale = 1)
 	{
 		reg &= 0x7;
 
@@ -1166,9 +1231,10 @@ struct Backend
 				bool sib = index != INVALID || r_m.GetScale() || base == ESP;
 
 				// ModR/M
+				const bool disp8 = r_m.GetDisp() % disp8_scale == 0 && detail::IsInt8(r_m.GetDisp() / disp8_scale);
 				uint8 mod = 0;
 				if (r_m.GetDisp() == 0 || (sib && base == INVALID)) mod = base != EBP ? 0 : 1;
-				else if (detail::IsInt8(r_m.GetDisp())) mod = 1;
+				else if (disp8) mod = 1;
 				else if (detail::IsInt32(r_m.GetDisp())) mod = 2;
 				else JITASM_ASSERT(0);
 				db(mod << 6 | reg << 3 | (sib ? 4 : base));
@@ -1194,7 +1260,7 @@ struct Backend
 
 				// Displacement
 				if (mod == 0 && sib && base == INVALID) dd(r_m.GetDisp());
-				if (mod == 1) db(r_m.GetDisp());
+				if (mod == 1) db(r_m.GetDisp() / disp8_scale);
 				if (mod == 2) dd(r_m.GetDisp());
 			}
 		} else {
@@ -1228,6 +1294,8 @@ struct Backend
 		const detail::Opd& opd2 = instr.GetOpd(1).IsDummy() ? detail::Opd() : instr.GetOpd(1);	JITASM_ASSERT(!(opd2.IsReg() && opd2.GetReg().IsSymbolic()));
 		const detail::Opd& opd3 = instr.GetOpd(2).IsDummy() ? detail::Opd() : instr.GetOpd(2);	JITASM_ASSERT(!(opd3.IsReg() && opd3.GetReg().IsSymbolic()));
 		const detail::Opd& opd4 = instr.GetOpd(3).IsDummy() ? detail::Opd() : instr.GetOpd(3);	JITASM_ASSERT(!(opd4.IsReg() && opd4.GetReg().IsSymbolic()));
+		// the EVEX write mask is always the 5th operand
+		const detail::Opd& mask = (instr.encoding_flag_ & E_EVEX) ? instr.GetOpd(4) : detail::Opd();		JITASM_ASSERT(!(mask.IsReg() && mask.GetReg().IsSymbolic()));
 
 		// +rb, +rw, +rd, +ro
 		if (opd1.IsReg() && (opd2.IsNone() || opd2.IsImm())) {
@@ -1238,9 +1306,9 @@ struct Backend
 			const detail::Opd& reg = opd1;
 			const detail::Opd& r_m = opd2;
 			const detail::Opd& vex = opd3;
-			EncodePrefixes(instr.encoding_flag_, reg, r_m, vex);
+			EncodePrefixes(instr.encoding_flag_, reg, r_m, vex, mask);
 			EncodeOpcode(opcode);
-			EncodeModRM((uint8) (reg.IsImm() ? reg.GetImm() : reg.GetReg().id), r_m);
+			EncodeModRM((uint8) (reg.IsImm() ? reg.GetImm() : reg.GetReg().id), r_m, (instr.encoding_flag_ & E_EVEX) && r_m.IsMem() ? GetMemOpdBytes(r_m) : 1);
 
 			// /is4
 			if (opd4.IsReg()) {
@@ -1260,6 +1328,21 @@ struct Backend
 		if (opd4.IsImm())	EncodeImm(opd4);
 	}
 
+	/// Memory operand size in bytes which is the EVEX disp8 scale for the full/half/quarter and scalar tuple types
+	static sint64 GetMemOpdBytes(const detail::Opd& mem)
+	{
+		switch (mem.GetSize()) {
+		case O_SIZE_8:		return 1;
+		case O_SIZE_16:		return 2;
+		case O_SIZE_32:		return 4;
+		case O_SIZE_64:		return 8;
+		case O_SIZE_128:	return 16;
+		case O_SIZE_256:	return 32;
+		case O_SIZE_512:	return 64;
+		default:			return 1;
+		}
+	}
+
 	void EncodeALU(const Instr& instr, uint32 opcode)
 	{
 		const detail::Opd& reg = instr.GetOpd(1);
@@ -1611,6 +1694,8 @@ struct Frontend
 	typedef jitasm::MmxReg	MmxReg;
 	typedef jitasm::XmmReg	XmmReg;
 	typedef jitasm::YmmReg	YmmReg;
+	typedef jitasm::ZmmReg	ZmmReg;
+	typedef jitasm::KReg	KReg;
 
 	static Reg8			al, cl, dl, bl, ah, ch, dh, bh;
 	static Reg16		ax, cx, dx, bx, sp, bp, si, di;
@@ -1636,6 +1721,7 @@ struct Frontend
 	AddressingPtr<Opd64>	mmword_ptr;
 	AddressingPtr<Opd128>	xmmword_ptr;
 	AddressingPtr<Opd256>	ymmword_ptr;
+	AddressingPtr<Opd512>	zmmword_ptr;
 	AddressingPtr<Opd32>	real4_ptr;
 	AddressingPtr<Opd64>	real8_ptr;
 	AddressingPtr<Opd80>	real10_ptr;
@@ -5658,6 +5744,105 @@ struct Frontend
 	void vpxor(const YmmReg& dst, const YmmReg& src1, const YmmReg& src2)		{AppendInstr(I_PXOR,	0xEF, E_VEX_256_66_0F_WIG, W(dst), R(src2), R(src1));}
 	void vpxor(const YmmReg& dst, const YmmReg& src1, const Mem256& src2)		{AppendInstr(I_PXOR,	0xEF, E_VEX_256_66_0F_WIG, W(dst), R(src2), R(src1));}
 
+	// AVX-512F, only the 512 bit forms needed by the users of this header. Masked forms take the mask
+	// after the destination and the _z suffix selects zero masking instead of merge masking.
+	void vaddps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_ADDPS, 0x58, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vaddps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_ADDPS, 0x58, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vsubps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_SUBPS, 0x5C, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vsubps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_SUBPS, 0x5C, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vsubps(const ZmmReg& dst, const KReg& mask, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_SUBPS, 0x5C, E_EVEX_512_0F_W0, RW(dst), R(src2), R(src1), detail::Opd(), R(mask));}
+	void vmulps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_MULPS, 0x59, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vmulps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_MULPS, 0x59, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vdivps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_DIVPS, 0x5E, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vdivps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_DIVPS, 0x5E, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vminps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_MINPS, 0x5D, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vminps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_MINPS, 0x5D, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vmaxps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_MAXPS, 0x5F, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vmaxps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_MAXPS, 0x5F, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1));}
+	void vsqrtps(const ZmmReg& dst, const ZmmReg& src)	{AppendInstr(I_SQRTPS, 0x51, E_EVEX_512_0F_W0, W(dst), R(src));}
+	void vsqrtps(const ZmmReg& dst, const Mem512& src)	{AppendInstr(I_SQRTPS, 0x51, E_EVEX_512_0F_W0, W(dst), R(src));}
+	void vcmpps(const KReg& dst, const ZmmReg& src1, const ZmmReg& src2, const Imm8& imm)	{AppendInstr(I_CMPPS, 0xC2, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1), imm);}
+	void vcmpps(const KReg& dst, const ZmmReg& src1, const Mem512& src2, const Imm8& imm)	{AppendInstr(I_CMPPS, 0xC2, E_EVEX_512_0F_W0, W(dst), R(src2), R(src1), imm);}
+	void vblendmps(const ZmmReg& dst, const KReg& mask, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VBLENDMPS, 0x65, E_EVEX_512_66_0F38_W0, W(dst), R(src2), R(src1), detail::Opd(), R(mask));}
+	void vblendmps(const ZmmReg& dst, const KReg& mask, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VBLENDMPS, 0x65, E_EVEX_512_66_0F38_W0, W(dst), R(src2), R(src1), detail::Opd(), R(mask));}
+	void vmovaps(const ZmmReg& dst, const ZmmReg& src)	{AppendInstr(I_MOVAPS, 0x28, E_EVEX_512_0F_W0, W(dst), R(src));}
+	void vmovaps(const ZmmReg& dst, const Mem512& src)	{AppendInstr(I_MOVAPS, 0x28, E_EVEX_512_0F_W0, W(dst), R(src));}
+	void vmovaps(const Mem512& dst, const ZmmReg& src)	{AppendInstr(I_MOVAPS, 0x29, E_EVEX_512_0F_W0, R(src), W(dst));}
+	void vmovaps(const ZmmReg& dst, const KReg& mask, const ZmmReg& src)	{AppendInstr(I_MOVAPS, 0x28, E_EVEX_512_0F_W0, RW(dst), R(src), detail::Opd(), detail::Opd(), R(mask));}
+	void vmovaps_z(const ZmmReg& dst, const KReg& mask, const ZmmReg& src)	{AppendInstr(I_MOVAPS, 0x28, E_EVEX_512_0F_W0 | E_EVEX_Z, W(dst), R(src), detail::Opd(), detail::Opd(), R(mask));}
+	void vmovaps_z(const ZmmReg& dst, const KReg& mask, const Mem512& src)	{AppendInstr(I_MOVAPS, 0x28, E_EVEX_512_0F_W0 | E_EVEX_Z, W(dst), R(src), detail::Opd(), detail::Opd(), R(mask));}
+	void vmovups(const ZmmReg& dst, const Mem512& src)	{AppendInstr(I_MOVUPS, 0x10, E_EVEX_512_0F_W0, W(dst), R(src));}
+	void vmovups(const Mem512& dst, const ZmmReg& src)	{AppendInstr(I_MOVUPS, 0x11, E_EVEX_512_0F_W0, R(src), W(dst));}
+	void vbroadcastss(const ZmmReg& dst, const XmmReg& src)	{AppendInstr(I_VBROADCASTSS, 0x18, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vbroadcastss(const ZmmReg& dst, const Mem32& src)	{AppendInstr(I_VBROADCASTSS, 0x18, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vcvtdq2ps(const ZmmReg& dst, const ZmmReg& src)	{AppendInstr(I_CVTDQ2PS, 0x5B, E_EVEX_512_0F_W0, W(dst), R(src));}
+	void vcvtps2dq(const ZmmReg& dst, const ZmmReg& src)	{AppendInstr(I_CVTPS2DQ, 0x5B, E_EVEX_512_66_0F_W0, W(dst), R(src));}
+	void vcvttps2dq(const ZmmReg& dst, const ZmmReg& src)	{AppendInstr(I_CVTTPS2DQ, 0x5B, E_EVEX_512_F3_0F_W0, W(dst), R(src));}
+	void vcvtph2ps(const ZmmReg& dst, const YmmReg& src)	{AppendInstr(I_VCVTPH2PS, 0x13, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vcvtph2ps(const ZmmReg& dst, const Mem256& src)	{AppendInstr(I_VCVTPH2PS, 0x13, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vcvtps2ph(const YmmReg& dst, const ZmmReg& src, const Imm8& rc)	{AppendInstr(I_VCVTPS2PH, 0x1D, E_EVEX_512_66_0F3A_W0, R(src), W(dst), rc);}
+	void vcvtps2ph(const Mem256& dst, const ZmmReg& src, const Imm8& rc)	{AppendInstr(I_VCVTPS2PH, 0x1D, E_EVEX_512_66_0F3A_W0, R(src), W(dst), rc);}
+	void vpmovzxbd(const ZmmReg& dst, const XmmReg& src)	{AppendInstr(I_PMOVZXBD, 0x31, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vpmovzxbd(const ZmmReg& dst, const Mem128& src)	{AppendInstr(I_PMOVZXBD, 0x31, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vpmovzxwd(const ZmmReg& dst, const YmmReg& src)	{AppendInstr(I_PMOVZXWD, 0x33, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vpmovzxwd(const ZmmReg& dst, const Mem256& src)	{AppendInstr(I_PMOVZXWD, 0x33, E_EVEX_512_66_0F38_W0, W(dst), R(src));}
+	void vpmovusdb(const XmmReg& dst, const ZmmReg& src)	{AppendInstr(I_VPMOVUSDB, 0x11, E_EVEX_512_F3_0F38_W0, R(src), W(dst));}
+	void vpmovusdb(const Mem128& dst, const ZmmReg& src)	{AppendInstr(I_VPMOVUSDB, 0x11, E_EVEX_512_F3_0F38_W0, R(src), W(dst));}
+	void vpmovusdw(const YmmReg& dst, const ZmmReg& src)	{AppendInstr(I_VPMOVUSDW, 0x13, E_EVEX_512_F3_0F38_W0, R(src), W(dst));}
+	void vpmovusdw(const Mem256& dst, const ZmmReg& src)	{AppendInstr(I_VPMOVUSDW, 0x13, E_EVEX_512_F3_0F38_W0, R(src), W(dst));}
+	void vpaddd(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_PADDD, 0xFE, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpaddd(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_PADDD, 0xFE, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpaddq(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_PADDQ, 0xD4, E_EVEX_512_66_0F_W1, W(dst), R(src2), R(src1));}
+	void vpaddq(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_PADDQ, 0xD4, E_EVEX_512_66_0F_W1, W(dst), R(src2), R(src1));}
+	void vpsubd(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_PSUBD, 0xFA, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpsubd(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_PSUBD, 0xFA, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpslld(const ZmmReg& dst, const ZmmReg& src, const Imm8& count)	{AppendInstr(I_PSLLD, 0x72, E_EVEX_512_66_0F_W0, Imm8(6), R(src), W(dst), count);}
+	void vpsrld(const ZmmReg& dst, const ZmmReg& src, const Imm8& count)	{AppendInstr(I_PSRLD, 0x72, E_EVEX_512_66_0F_W0, Imm8(2), R(src), W(dst), count);}
+	void vpandd(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_PAND, 0xDB, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpandd(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_PAND, 0xDB, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpandnd(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_PANDN, 0xDF, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpandnd(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_PANDN, 0xDF, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpord(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_POR, 0xEB, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpord(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_POR, 0xEB, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpxord(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_PXOR, 0xEF, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpxord(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_PXOR, 0xEF, E_EVEX_512_66_0F_W0, W(dst), R(src2), R(src1));}
+	void vpternlogd(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2, const Imm8& imm)	{AppendInstr(I_VPTERNLOGD, 0x25, E_EVEX_512_66_0F3A_W0, RW(dst), R(src2), R(src1), imm);}
+	void vpternlogd(const ZmmReg& dst, const KReg& mask, const ZmmReg& src1, const ZmmReg& src2, const Imm8& imm)	{AppendInstr(I_VPTERNLOGD, 0x25, E_EVEX_512_66_0F3A_W0, RW(dst), R(src2), R(src1), imm, R(mask));}
+	void vfmadd132ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFMADD132PS, 0x98, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmadd132ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFMADD132PS, 0x98, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmadd213ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFMADD213PS, 0xA8, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmadd213ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFMADD213PS, 0xA8, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmadd231ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFMADD231PS, 0xB8, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmadd231ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFMADD231PS, 0xB8, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmsub132ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFMSUB132PS, 0x9A, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmsub132ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFMSUB132PS, 0x9A, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmsub213ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFMSUB213PS, 0xAA, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmsub213ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFMSUB213PS, 0xAA, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmsub231ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFMSUB231PS, 0xBA, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfmsub231ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFMSUB231PS, 0xBA, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmadd132ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFNMADD132PS, 0x9C, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmadd132ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFNMADD132PS, 0x9C, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmadd213ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFNMADD213PS, 0xAC, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmadd213ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFNMADD213PS, 0xAC, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmadd231ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFNMADD231PS, 0xBC, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmadd231ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFNMADD231PS, 0xBC, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmsub132ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFNMSUB132PS, 0x9E, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmsub132ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFNMSUB132PS, 0x9E, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmsub213ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFNMSUB213PS, 0xAE, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmsub213ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFNMSUB213PS, 0xAE, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmsub231ps(const ZmmReg& dst, const ZmmReg& src1, const ZmmReg& src2)	{AppendInstr(I_VFNMSUB231PS, 0xBE, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void vfnmsub231ps(const ZmmReg& dst, const ZmmReg& src1, const Mem512& src2)	{AppendInstr(I_VFNMSUB231PS, 0xBE, E_EVEX_512_66_0F38_W0, RW(dst), R(src2), R(src1));}
+	void kandw(const KReg& dst, const KReg& src1, const KReg& src2)	{AppendInstr(I_KANDW, 0x41, E_VEX_256 | E_VEX_0F | E_VEX_W0, W(dst), R(src2), R(src1));}
+	void korw(const KReg& dst, const KReg& src1, const KReg& src2)	{AppendInstr(I_KORW, 0x45, E_VEX_256 | E_VEX_0F | E_VEX_W0, W(dst), R(src2), R(src1));}
+	void kxorw(const KReg& dst, const KReg& src1, const KReg& src2)	{AppendInstr(I_KXORW, 0x47, E_VEX_256 | E_VEX_0F | E_VEX_W0, W(dst), R(src2), R(src1));}
+	void kxnorw(const KReg& dst, const KReg& src1, const KReg& src2)	{AppendInstr(I_KXNORW, 0x46, E_VEX_256 | E_VEX_0F | E_VEX_W0, W(dst), R(src2), R(src1));}
+	void knotw(const KReg& dst, const KReg& src)	{AppendInstr(I_KNOTW, 0x44, E_VEX_128 | E_VEX_0F | E_VEX_W0, W(dst), R(src));}
+	void kmovw(const KReg& dst, const KReg& src)	{AppendInstr(I_KMOVW, 0x90, E_VEX_128 | E_VEX_0F | E_VEX_W0, W(dst), R(src));}
+	void kmovw(const KReg& dst, const Mem16& src)	{AppendInstr(I_KMOVW, 0x90, E_VEX_128 | E_VEX_0F | E_VEX_W0, W(dst), R(src));}
+	void kmovw(const Mem16& dst, const KReg& src)	{AppendInstr(I_KMOVW, 0x91, E_VEX_128 | E_VEX_0F | E_VEX_W0, R(src), W(dst));}
+	void kmovw(const KReg& dst, const Reg32& src)	{AppendInstr(I_KMOVW, 0x92, E_VEX_128 | E_VEX_0F | E_VEX_W0, W(dst), R(src));}
+	void kmovw(const Reg32& dst, const KReg& src)	{AppendInstr(I_KMOVW, 0x93, E_VEX_128 | E_VEX_0F | E_VEX_W0, W(dst), R(src));}
+
 
 	struct ControlState
 	{
@@ -5998,10 +6183,14 @@ namespace compiler
 			case R_TYPE_MMX:			return 1;
 			case R_TYPE_XMM:			return 2;
 			case R_TYPE_YMM:			return 2;
+			case R_TYPE_ZMM:			return 2;
+			case R_TYPE_K:				return 3;
 			case R_TYPE_SYMBOLIC_GP:	return 0;
 			case R_TYPE_SYMBOLIC_MMX:	return 1;
 			case R_TYPE_SYMBOLIC_XMM:	return 2;
 			case R_TYPE_SYMBOLIC_YMM:	return 2;
+			case R_TYPE_SYMBOLIC_ZMM:	return 2;
+			case R_TYPE_SYMBOLIC_K:		return 3;
 			case R_TYPE_FPU:
 			default:
 				JITASM_ASSERT(0);
@@ -6021,10 +6210,14 @@ namespace compiler
 		else if (type == R_TYPE_MMX)			{name.assign("mm");}
 		else if (type == R_TYPE_XMM)			{name.assign("xmm");}
 		else if (type == R_TYPE_YMM)			{name.assign("ymm");}
+		else if (type == R_TYPE_ZMM)			{name.assign("zmm");}
+		else if (type == R_TYPE_K)				{name.assign("k");}
 		else if (type == R_TYPE_SYMBOLIC_GP)	{name.assign("gpsym"); reg_idx -= NUM_OF_PHYSICAL_REG;}
 		else if (type == R_TYPE_SYMBOLIC_MMX)	{name.assign("mmsym"); reg_idx -= NUM_OF_PHYSICAL_REG;}
 		else if (type == R_TYPE_SYMBOLIC_XMM)	{name.assign("xmmsym"); reg_idx -= NUM_OF_PHYSICAL_REG;}
 		else if (type == R_TYPE_SYMBOLIC_YMM)	{name.assign("ymmsym"); reg_idx -= NUM_OF_PHYSICAL_REG;}
+		else if (type == R_TYPE_SYMBOLIC_ZMM)	{name.assign("zmmsym"); reg_idx -= NUM_OF_PHYSICAL_REG;}
+		else if (type == R_TYPE_SYMBOLIC_K)		{name.assign("ksym"); reg_idx -= NUM_OF_PHYSICAL_REG;}
 		detail::append_num(name, reg_idx);
 		return name;
 	}
@@ -6042,7 +6235,7 @@ namespace compiler
 	class VariableManager
 	{
 	private:
-		std::vector<VarAttribute> attributes_[3];	// GP, MMX, XMM/YMM
+		std::vector<VarAttribute> attributes_[4];	// GP, MMX, XMM/YMM/ZMM, K
 
 	public:
 		std::vector<VarAttribute>& GetAttributes(size_t reg_family) {return attributes_[reg_family];}
@@ -6086,6 +6279,13 @@ namespace compiler
 		/// Allocate stack of spill slots
 		void AllocSpillSlots(detail::StackManager& stack_manager)
 		{
+			// ZMM
+			for (size_t i = 0; i < attributes_[2].size(); ++i) {
+				if (attributes_[2][i].spill && attributes_[2][i].size == O_SIZE_512 && attributes_[2][i].stack_slot.reg_.IsInvalid()) {
+					attributes_[2][i].stack_slot = stack_manager.Alloc(512 / 8, 32); // unaligned moves are used for zmm spills
+				}
+			}
+
 			// YMM
 			for (size_t i = 0; i < attributes_[2].size(); ++i) {
 				if (attributes_[2][i].spill && attributes_[2][i].size == O_SIZE_256 && attributes_[2][i].stack_slot.reg_.IsInvalid()) {
@@ -6100,6 +6300,13 @@ namespace compiler
 				}
 			}
 
+			// K
+			for (size_t i = 0; i < attributes_[3].size(); ++i) {
+				if (attributes_[3][i].spill && attributes_[3][i].stack_slot.reg_.IsInvalid()) {
+					attributes_[3][i].stack_slot = stack_manager.Alloc(16 / 8, 2);
+				}
+			}
+
 			// MMX
 			for (size_t i = 0; i < attributes_[1].size(); ++i) {
 				if (attributes_[1][i].spill && attributes_[1][i].stack_slot.reg_.IsInvalid()) {
@@ -6586,7 +6793,7 @@ namespace compiler
 		BasicBlock *dfs_parent;				///< Depth-first search tree parent
 		BasicBlock *immediate_dominator;	///< Immediate dominator
 		size_t loop_depth;					///< Loop nesting depth
-		Lifetime lifetime[3];				///< Variable lifetime (0: GP, 1: MMX, 2: XMM/YMM)
+		Lifetime lifetime[4];				///< Variable lifetime (0: GP, 1: MMX, 2: XMM/YMM/ZMM, 3: K)
 
 		BasicBlock(size_t instr_begin_, size_t instr_end_, BasicBlock *successor0 = NULL, BasicBlock *successor1 = NULL) : instr_begin(instr_begin_), instr_end(instr_end_), depth((size_t)-1), dfs_parent(NULL), immediate_dominator(NULL), loop_depth(0) {
 			successor[0] = successor0;
@@ -6874,7 +7081,7 @@ namespace compiler
 				BasicBlock *block = *it;
 				std::string live_in = "live in:";
 				std::string live_out = "live out:";
-				for (size_t reg_family = 0; reg_family < 3; ++reg_family) {
+				for (size_t reg_family = 0; reg_family < 4; ++reg_family) {
 					for (size_t i = 0; i < block->lifetime[reg_family].live_in.size_bit(); ++i) {
 						if (block->lifetime[reg_family].live_in.get_bit(i)) {
 							live_in.append(" ");
@@ -6992,7 +7199,7 @@ namespace compiler
 	 * \param[out]     need_reg_alloc			Register allocation is needed or not
 	 * \return There is any compile process if it is true.
 	 */
-	inline bool PrepareCompile(Frontend::InstrList& instrs, uint32 (&modified_physical_reg)[3], bool (&need_reg_alloc)[3])
+	inline bool PrepareCompile(Frontend::InstrList& instrs, uint32 (&modified_physical_reg)[4], bool (&need_reg_alloc)[4])
 	{
 		struct RegIDMap {
 			int next_id_;
@@ -7006,9 +7213,9 @@ namespace compiler
 				return new_id;
 			}
 		};
-		RegIDMap reg_id_map[3];		// GP, MMX, XMM/YMM
-		modified_physical_reg[0] = modified_physical_reg[1] = modified_physical_reg[2] = 0;
-		need_reg_alloc[0] = need_reg_alloc[1] = need_reg_alloc[2] = false;
+		RegIDMap reg_id_map[4];		// GP, MMX, XMM/YMM/ZMM, K
+		modified_physical_reg[0] = modified_physical_reg[1] = modified_physical_reg[2] = modified_physical_reg[3] = 0;
+		need_reg_alloc[0] = need_reg_alloc[1] = need_reg_alloc[2] = need_reg_alloc[3] = false;
 		bool compile_process = false;
 
 		for (Frontend::InstrList::iterator it = instrs.begin(); it != instrs.end(); ++it) {
@@ -7050,13 +7257,13 @@ namespace compiler
 			}
 		}
 
-		for (size_t i = 0; i < 3; ++i) {
+		for (size_t i = 0; i < 4; ++i) {
 			if (!need_reg_alloc[i] && reg_id_map[i].next_id_ > NUM_OF_PHYSICAL_REG) {
 				need_reg_alloc[i] = true;
 			}
 		}
 
-		return compile_process || need_reg_alloc[0] || need_reg_alloc[1] || need_reg_alloc[2];
+		return compile_process || need_reg_alloc[0] || need_reg_alloc[1] || need_reg_alloc[2] || need_reg_alloc[3];
 	}
 
 	/// Check the instruction if it break register dependence
@@ -7153,7 +7360,7 @@ namespace compiler
 					// Add each use point of all operands
 					for (size_t j = 0; j < Instr::MAX_OPERAND_COUNT; ++j) {
 						const detail::Opd& opd = instr.GetOpd(j);
-						if (opd.IsGpReg() || opd.IsMmxReg() || opd.IsXmmReg() || opd.IsYmmReg()) {
+						if (opd.IsGpReg() || opd.IsMmxReg() || opd.IsXmmReg() || opd.IsYmmReg() || opd.IsZmmReg() || opd.IsKReg()) {
 							// Register operand
 							const RegID& reg = opd.GetReg();
 							block->GetLifetime(reg.GetType()).AddUsePoint(instr_offset, reg, opd.GetType(), opd.GetSize(), opd.reg_assignable_);
@@ -7176,7 +7383,7 @@ namespace compiler
 			}
 
 			// Make GEN and KILL set
-			for (size_t reg_family = 0; reg_family < 3; ++reg_family) {
+			for (size_t reg_family = 0; reg_family < 4; ++reg_family) {
 				Lifetime& lifetime = block->lifetime[reg_family];
 				const size_t num_of_used_reg = lifetime.use_points.size();
 				for (size_t i = 0; i < num_of_used_reg; ++i) {
@@ -7198,7 +7405,7 @@ namespace compiler
 		while (!update_target.empty()) {
 			BasicBlock *block = update_target.back();
 			update_target.pop_back();
-			for (size_t reg_family = 0; reg_family < 3; ++reg_family) {
+			for (size_t reg_family = 0; reg_family < 4; ++reg_family) {
 				Lifetime& lifetime = block->lifetime[reg_family];
 				if (lifetime.dirty_live_out) {
 					// live_out is the union of the live_in of the successors
@@ -7347,6 +7554,8 @@ namespace compiler
 					f_->movaps(XmmReg(dst_reg), XmmReg(src_reg));
 			} else if (size == O_SIZE_256) {
 				f_->vmovaps(YmmReg(dst_reg), YmmReg(src_reg));
+			} else if (size == O_SIZE_512) {
+				f_->vmovaps(ZmmReg(dst_reg), ZmmReg(src_reg));
 			} else {
 				JITASM_ASSERT(0);
 			}
@@ -7368,6 +7577,10 @@ namespace compiler
 				f_->vxorps(YmmReg(reg1), YmmReg(reg1), YmmReg(reg2));
 				f_->vxorps(YmmReg(reg2), YmmReg(reg1), YmmReg(reg2));
 				f_->vxorps(YmmReg(reg1), YmmReg(reg1), YmmReg(reg2));
+			} else if (size == O_SIZE_512) {
+				f_->vpxord(ZmmReg(reg1), ZmmReg(reg1), ZmmReg(reg2));
+				f_->vpxord(ZmmReg(reg2), ZmmReg(reg1), ZmmReg(reg2));
+				f_->vpxord(ZmmReg(reg1), ZmmReg(reg1), ZmmReg(reg2));
 			} else {
 				JITASM_ASSERT(0);
 			}
@@ -7383,6 +7596,8 @@ namespace compiler
 					f_->movaps(XmmReg(dst_reg), f_->xmmword_ptr[var_manager_->GetSpillSlot(2, var)]);
 			} else if (size == O_SIZE_256) {
 				f_->vmovaps(YmmReg(dst_reg), f_->ymmword_ptr[var_manager_->GetSpillSlot(2, var)]);
+			} else if (size == O_SIZE_512) {
+				f_->vmovups(ZmmReg(dst_reg), f_->zmmword_ptr[var_manager_->GetSpillSlot(2, var)]);
 			} else {
 				JITASM_ASSERT(0);
 			}
@@ -7398,12 +7613,45 @@ namespace compiler
 					f_->movaps(f_->xmmword_ptr[var_manager_->GetSpillSlot(2, var)], XmmReg(src_reg));
 			} else if (size == O_SIZE_256) {
 				f_->vmovaps(f_->ymmword_ptr[var_manager_->GetSpillSlot(2, var)], YmmReg(src_reg));
+			} else if (size == O_SIZE_512) {
+				f_->vmovups(f_->zmmword_ptr[var_manager_->GetSpillSlot(2, var)], ZmmReg(src_reg));
 			} else {
 				JITASM_ASSERT(0);
 			}
 		}
 	};
 
+	/// Opmask register operator
+	struct KRegOperator
+	{
+		Frontend *f_;
+		const VariableManager *var_manager_;
+
+		KRegOperator(Frontend *f, const VariableManager *var_manager) : f_(f), var_manager_(var_manager) {}
+
+		void Move(PhysicalRegID dst_reg, PhysicalRegID src_reg, OpdSize /*size*/)
+		{
+			f_->kmovw(KReg(dst_reg), KReg(src_reg));
+		}
+
+		void Swap(PhysicalRegID reg1, PhysicalRegID reg2, OpdSize /*size*/)
+		{
+			f_->kxorw(KReg(reg1), KReg(reg1), KReg(reg2));
+			f_->kxorw(KReg(reg2), KReg(reg1), KReg(reg2));
+			f_->kxorw(KReg(reg1), KReg(reg1), KReg(reg2));
+		}
+
+		void Load(PhysicalRegID dst_reg, int var)
+		{
+			f_->kmovw(KReg(dst_reg), f_->word_ptr[var_manager_->GetSpillSlot(3, var)]);
+		}
+
+		void Store(int var, PhysicalRegID src_reg)
+		{
+			f_->kmovw(f_->word_ptr[var_manager_->GetSpillSlot(3, var)], KReg(src_reg));
+		}
+	};
+
 	/// Strongly connected components finder
 	/**
 	 * Tarjan's algorithm
@@ -7621,10 +7869,14 @@ namespace compiler
 			JITASM_TRACE("---- XMM/YMM register ----\n");
 			GenerateInterIntervalInstr(first_block->lifetime[2].intervals.back(), second_block->lifetime[2].intervals.front(), var_manager.GetAttributes(2), XmmRegOperator(&f, &var_manager));
 		}
+		if (!first_block->lifetime[3].intervals.empty() && !second_block->lifetime[3].intervals.empty()) {
+			JITASM_TRACE("---- Opmask register ----\n");
+			GenerateInterIntervalInstr(first_block->lifetime[3].intervals.back(), second_block->lifetime[3].intervals.front(), var_manager.GetAttributes(3), KRegOperator(&f, &var_manager));
+		}
 	}
 
 	/// Generate prolog instructions
-	inline void GenerateProlog(Frontend& f, const uint32 (&preserved_reg)[3], const Addr& preserved_reg_stack)
+	inline void GenerateProlog(Frontend& f, const uint32 (&preserved_reg)[4], const Addr& preserved_reg_stack)
 	{
 		avoid_unused_warn(preserved_reg_stack);
 
@@ -7706,7 +7958,7 @@ namespace compiler
 	}
 
 	/// Generate epilog instructions
-	inline void GenerateEpilog(Frontend& f, const uint32 (&preserved_reg)[3], const Addr& preserved_reg_stack)
+	inline void GenerateEpilog(Frontend& f, const uint32 (&preserved_reg)[4], const Addr& preserved_reg_stack)
 	{
 		avoid_unused_warn(preserved_reg_stack);
 
@@ -7781,7 +8033,7 @@ namespace compiler
 	 * - Generate instructions for register move and spill
 	 * - Generate function prolog and epilog
 	 */
-	inline void RewriteInstructions(Frontend& f, const ControlFlowGraph& cfg, const VariableManager& var_manager, const uint32 (&preserved_reg)[3], const Addr& preserved_reg_stack)
+	inline void RewriteInstructions(Frontend& f, const ControlFlowGraph& cfg, const VariableManager& var_manager, const uint32 (&preserved_reg)[4], const Addr& preserved_reg_stack)
 	{
 		// Prepare instruction number ordered labels for adjusting label position
 		std::vector<OrderedLabel> orderd_labels;	// instruction number order
@@ -7815,8 +8067,8 @@ namespace compiler
 			}
 
 			// Initialize interval_range
-			detail::ConstRange< std::vector<Lifetime::Interval> > interval_range[3];
-			for (size_t reg_family = 0; reg_family < 3; ++reg_family) {
+			detail::ConstRange< std::vector<Lifetime::Interval> > interval_range[4];
+			for (size_t reg_family = 0; reg_family < 4; ++reg_family) {
 				interval_range[reg_family].first = block->lifetime[reg_family].intervals.begin();
 				interval_range[reg_family].second = block->lifetime[reg_family].intervals.end();
 			}
@@ -7841,6 +8093,11 @@ namespace compiler
 					const Lifetime::Interval& first_interval = *interval_range[2].first;
 					GenerateInterIntervalInstr(first_interval, *++interval_range[2].first, var_manager.GetAttributes(2), XmmRegOperator(&f, &var_manager));
 				}
+				if (interval_range[3].size() > 1 && detail::next(interval_range[3].first)->instr_idx_offset == instr_offset) {
+					JITASM_TRACE("---- Opmask register ----\n");
+					const Lifetime::Interval& first_interval = *interval_range[3].first;
+					GenerateInterIntervalInstr(first_interval, *++interval_range[3].first, var_manager.GetAttributes(3), KRegOperator(&f, &var_manager));
+				}
 
 				const size_t cur_instr_index = f.instrs_.size();
 				const InstrID instr_id = org_instrs[org_instr_index].GetID();
@@ -7950,26 +8207,26 @@ namespace compiler
 	inline void Compile(Frontend& f)
 	{
 #ifdef JITASM64
-		// Available registers : rax, rcx, rdx, rsi, rdi, r8 ~ r15, mm0 ~ mm7, xmm0/ymm0 ~ xmm15/ymm15
-		const uint32 available_reg[3] = {0xFFC7, 0xFF, 0xFFFF};
+		// Available registers : rax, rcx, rdx, rsi, rdi, r8 ~ r15, mm0 ~ mm7, xmm0/ymm0/zmm0 ~ xmm15/ymm15/zmm15, k1 ~ k7
+		const uint32 available_reg[4] = {0xFFC7, 0xFF, 0xFFFF, 0xFE};
 
 #ifdef JITASM_WIN
 		// Win64 preserved registers : rbx, rsi, rdi, r12 ~ r15, xmm6 ~ xmm15
-		uint32 preserved_reg[3] = {(1<<RBX)|(1<<RSI)|(1<<RDI)|(1<<R12)|(1<<R13)|(1<<R14)|(1<<R15), 0, 0xFFC0};
+		uint32 preserved_reg[4] = {(1<<RBX)|(1<<RSI)|(1<<RDI)|(1<<R12)|(1<<R13)|(1<<R14)|(1<<R15), 0, 0xFFC0, 0};
 #else
 		// x64 Linux preserved registers : rbx, r12 ~ r15, xmm6 ~ xmm15
-		uint32 preserved_reg[3] = {(1<<RBX)|(1<<R12)|(1<<R13)|(1<<R14)|(1<<R15), 0, 0xFFC0};
+		uint32 preserved_reg[4] = {(1<<RBX)|(1<<R12)|(1<<R13)|(1<<R14)|(1<<R15), 0, 0xFFC0, 0};
 #endif
 #else
-		// Available registers : eax, ecx, edx, esi, edi, mm0 ~ mm7, xmm0/ymm0 ~ xmm7/ymm7
-		const uint32 available_reg[3] = {(1<<EAX)|(1<<ECX)|(1<<EDX)|(1<<ESI)|(1<<EDI), 0xFF, 0xFF};
+		// Available registers : eax, ecx, edx, esi, edi, mm0 ~ mm7, xmm0/ymm0/zmm0 ~ xmm7/ymm7/zmm7, k1 ~ k7
+		const uint32 available_reg[4] = {(1<<EAX)|(1<<ECX)|(1<<EDX)|(1<<ESI)|(1<<EDI), 0xFF, 0xFF, 0xFE};
 
 		// Preserved registers : ebx, esi, edi
-		uint32 preserved_reg[3] = {(1<<EBX)|(1<<ESI)|(1<<EDI), 0, 0};
+		uint32 preserved_reg[4] = {(1<<EBX)|(1<<ESI)|(1<<EDI), 0, 0, 0};
 #endif
 
-		uint32 used_physical_reg[3];
-		bool need_reg_alloc[3];
+		uint32 used_physical_reg[4];
+		bool need_reg_alloc[4];
 		if (!PrepareCompile(f.instrs_, used_physical_reg, need_reg_alloc)) {
 			// No compile process
 			return;
@@ -7978,7 +8235,7 @@ namespace compiler
 		VariableManager var_manager;
 		ControlFlowGraph cfg;
 
-		if (need_reg_alloc[0] || need_reg_alloc[1] || need_reg_alloc[2]) {
+		if (need_reg_alloc[0] || need_reg_alloc[1] || need_reg_alloc[2] || need_reg_alloc[3]) {
 			// Register allocation process
 
 			// Build CFG including loop detection
@@ -7988,7 +8245,7 @@ namespace compiler
 			LiveVariableAnalysis(f, cfg, var_manager);
 
 			// Linear scan register allocation
-			for (size_t reg_family = 0; reg_family < 3; ++reg_family) {
+			for (size_t reg_family = 0; reg_family < 4; ++reg_family) {
 				if (need_reg_alloc[reg_family]) {
 					used_physical_reg[reg_family] = LinearScanRegisterAlloc(cfg, reg_family, available_reg[reg_family], var_manager.GetAttributes(reg_family));
 				}
@@ -8007,6 +8264,7 @@ namespace compiler
 		preserved_reg[0] &= used_physical_reg[0];
 		preserved_reg[1] &= used_physical_reg[1];
 		preserved_reg[2] &= used_physical_reg[2];
+		preserved_reg[3] &= used_physical_reg[3];
 
 		// Reserve stack for saving xmm register
 		Addr preserved_reg_stack(RegID::Invalid(), 0);
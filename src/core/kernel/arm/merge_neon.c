@@ -0,0 +1,373 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <arm_neon.h>
+#define VS_MERGE_IMPL
+#include "../merge.h"
+#include "VSHelper4.h"
+
+#define MERGESHIFT 15
+
+void vs_merge_byte_neon(const void *src1, const void *src2, void *dst, union vs_merge_weight weight, unsigned n)
+{
+    const uint8_t *srcp1 = src1;
+    const uint8_t *srcp2 = src2;
+    uint8_t *dstp = dst;
+    unsigned i;
+
+    int16x8_t w = vdupq_n_s16(weight.u);
+
+    for (i = 0; i < n; i += 16) {
+        uint8x16_t v1 = vld1q_u8(srcp1 + i);
+        uint8x16_t v2 = vld1q_u8(srcp2 + i);
+
+        int16x8_t difflo = vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(v2), vget_low_u8(v1)));
+        int16x8_t diffhi = vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(v2), vget_high_u8(v1)));
+
+        // (diff * w + ROUND) >> MERGESHIFT, the difference never reaches INT16_MIN so vqrdmulh can't saturate
+        int16x8_t tmplo = vaddq_s16(vqrdmulhq_s16(difflo, w), vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v1))));
+        int16x8_t tmphi = vaddq_s16(vqrdmulhq_s16(diffhi, w), vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v1))));
+
+        vst1q_u8(dstp + i, vcombine_u8(vqmovun_s16(tmplo), vqmovun_s16(tmphi)));
+    }
+}
+
+void vs_merge_word_neon(const void *src1, const void *src2, void *dst, union vs_merge_weight weight, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    int32_t w = weight.u;
+
+    for (i = 0; i < n; i += 8) {
+        uint16x8_t v1 = vld1q_u16(srcp1 + i);
+        uint16x8_t v2 = vld1q_u16(srcp2 + i);
+
+        // 65535 * 32767 + ROUND still fits in a signed 32-bit lane
+        int32x4_t difflo = vreinterpretq_s32_u32(vsubl_u16(vget_low_u16(v2), vget_low_u16(v1)));
+        int32x4_t diffhi = vreinterpretq_s32_u32(vsubl_u16(vget_high_u16(v2), vget_high_u16(v1)));
+
+        int32x4_t tmplo = vaddq_s32(vrshrq_n_s32(vmulq_n_s32(difflo, w), MERGESHIFT), vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v1))));
+        int32x4_t tmphi = vaddq_s32(vrshrq_n_s32(vmulq_n_s32(diffhi, w), MERGESHIFT), vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v1))));
+
+        vst1q_u16(dstp + i, vcombine_u16(vqmovun_s32(tmplo), vqmovun_s32(tmphi)));
+    }
+}
+
+void vs_merge_float_neon(const void *src1, const void *src2, void *dst, union vs_merge_weight weight, unsigned n)
+{
+    const float *srcp1 = src1;
+    const float *srcp2 = src2;
+    float *dstp = dst;
+    unsigned i;
+
+    float w = weight.f;
+
+    for (i = 0; i < n; i += 4) {
+        float32x4_t v1 = vld1q_f32(srcp1 + i);
+        float32x4_t v2 = vld1q_f32(srcp2 + i);
+        vst1q_f32(dstp + i, vmlaq_n_f32(v1, vsubq_f32(v2, v1), w));
+    }
+}
+
+
+// Rounded division by 255, exact for x <= 255 * 255.
+static uint8x8_t div255_u16(uint16x8_t x)
+{
+    return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+}
+
+// (x * div_table[depth - 9]) >> (32 + shift_table[depth - 9]), see merge.h.
+static uint32x4_t divX_u32(uint32x4_t x, uint32x2_t div, int64x2_t shift)
+{
+    uint64x2_t lo = vshlq_u64(vmull_u32(vget_low_u32(x), div), shift);
+    uint64x2_t hi = vshlq_u64(vmull_u32(vget_high_u32(x), div), shift);
+    return vcombine_u32(vmovn_u64(lo), vmovn_u64(hi));
+}
+
+void vs_mask_merge_byte_neon(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint8_t *srcp1 = src1;
+    const uint8_t *srcp2 = src2;
+    const uint8_t *maskp = mask;
+    uint8_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+
+    for (i = 0; i < n; i += 16) {
+        uint8x16_t v1 = vld1q_u8(srcp1 + i);
+        uint8x16_t v2 = vld1q_u8(srcp2 + i);
+        uint8x16_t w2 = vld1q_u8(maskp + i);
+        uint8x16_t w1 = vmvnq_u8(w2);
+
+        uint16x8_t tmplo = vmlal_u8(vmull_u8(vget_low_u8(v1), vget_low_u8(w1)), vget_low_u8(v2), vget_low_u8(w2));
+        uint16x8_t tmphi = vmlal_u8(vmull_u8(vget_high_u8(v1), vget_high_u8(w1)), vget_high_u8(v2), vget_high_u8(w2));
+
+        vst1q_u8(dstp + i, vcombine_u8(div255_u16(tmplo), div255_u16(tmphi)));
+    }
+}
+
+void vs_mask_merge_word_neon(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    const uint16_t *maskp = mask;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    uint16x8_t maxval = vdupq_n_u16((1U << depth) - 1);
+    uint32x4_t round = vdupq_n_u32(((1U << depth) - 1) / 2);
+    uint32x2_t div = vdup_n_u32(div_table[depth - 9]);
+    int64x2_t shift = vdupq_n_s64(-(32 + shift_table[depth - 9]));
+
+    (void)offset;
+
+    for (i = 0; i < n; i += 8) {
+        uint16x8_t v1 = vld1q_u16(srcp1 + i);
+        uint16x8_t v2 = vld1q_u16(srcp2 + i);
+        uint16x8_t w2 = vld1q_u16(maskp + i);
+        uint16x8_t w1 = vsubq_u16(maxval, w2);
+
+        uint32x4_t tmplo = vmlal_u16(vmull_u16(vget_low_u16(v1), vget_low_u16(w1)), vget_low_u16(v2), vget_low_u16(w2));
+        uint32x4_t tmphi = vmlal_u16(vmull_u16(vget_high_u16(v1), vget_high_u16(w1)), vget_high_u16(v2), vget_high_u16(w2));
+
+        tmplo = divX_u32(vaddq_u32(tmplo, round), div, shift);
+        tmphi = divX_u32(vaddq_u32(tmphi, round), div, shift);
+
+        vst1q_u16(dstp + i, vcombine_u16(vmovn_u32(tmplo), vmovn_u32(tmphi)));
+    }
+}
+
+void vs_mask_merge_float_neon(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const float *srcp1 = src1;
+    const float *srcp2 = src2;
+    const float *maskp = mask;
+    float *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+
+    for (i = 0; i < n; i += 4) {
+        float32x4_t v1 = vld1q_f32(srcp1 + i);
+        float32x4_t v2 = vld1q_f32(srcp2 + i);
+        float32x4_t w = vld1q_f32(maskp + i);
+        vst1q_f32(dstp + i, vmlaq_f32(v1, vsubq_f32(v2, v1), w));
+    }
+}
+
+void vs_mask_merge_premul_byte_neon(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint8_t *srcp1 = src1;
+    const uint8_t *srcp2 = src2;
+    const uint8_t *maskp = mask;
+    uint8_t *dstp = dst;
+    unsigned i;
+
+    uint8x8_t off = vdup_n_u8(offset);
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 16) {
+        uint8x16_t v1 = vld1q_u8(srcp1 + i);
+        uint8x16_t v2 = vld1q_u8(srcp2 + i);
+        uint8x16_t w1 = vmvnq_u8(vld1q_u8(maskp + i));
+
+        int16x8_t difflo = vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(v1), off));
+        int16x8_t diffhi = vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(v1), off));
+
+        // Scale the magnitude so that the rounding is symmetric around the offset.
+        uint16x8_t tmplo = vmulq_u16(vreinterpretq_u16_s16(vabsq_s16(difflo)), vmovl_u8(vget_low_u8(w1)));
+        uint16x8_t tmphi = vmulq_u16(vreinterpretq_u16_s16(vabsq_s16(diffhi)), vmovl_u8(vget_high_u8(w1)));
+        int16x8_t reslo = vreinterpretq_s16_u16(vmovl_u8(div255_u16(tmplo)));
+        int16x8_t reshi = vreinterpretq_s16_u16(vmovl_u8(div255_u16(tmphi)));
+
+        reslo = vbslq_s16(vcltzq_s16(difflo), vnegq_s16(reslo), reslo);
+        reshi = vbslq_s16(vcltzq_s16(diffhi), vnegq_s16(reshi), reshi);
+
+        reslo = vaddq_s16(reslo, vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v2))));
+        reshi = vaddq_s16(reshi, vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v2))));
+
+        vst1q_u8(dstp + i, vcombine_u8(vmovn_u16(vreinterpretq_u16_s16(reslo)), vmovn_u16(vreinterpretq_u16_s16(reshi))));
+    }
+}
+
+void vs_mask_merge_premul_word_neon(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    const uint16_t *maskp = mask;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    uint16x4_t off = vdup_n_u16(offset);
+    uint16x8_t maxval = vdupq_n_u16((1U << depth) - 1);
+    uint32x4_t round = vdupq_n_u32(((1U << depth) - 1) / 2);
+    uint32x2_t div = vdup_n_u32(div_table[depth - 9]);
+    int64x2_t shift = vdupq_n_s64(-(32 + shift_table[depth - 9]));
+
+    for (i = 0; i < n; i += 8) {
+        uint16x8_t v1 = vld1q_u16(srcp1 + i);
+        uint16x8_t v2 = vld1q_u16(srcp2 + i);
+        uint16x8_t w1 = vsubq_u16(maxval, vld1q_u16(maskp + i));
+
+        int32x4_t difflo = vreinterpretq_s32_u32(vsubl_u16(vget_low_u16(v1), off));
+        int32x4_t diffhi = vreinterpretq_s32_u32(vsubl_u16(vget_high_u16(v1), off));
+
+        uint32x4_t tmplo = vmulq_u32(vreinterpretq_u32_s32(vabsq_s32(difflo)), vmovl_u16(vget_low_u16(w1)));
+        uint32x4_t tmphi = vmulq_u32(vreinterpretq_u32_s32(vabsq_s32(diffhi)), vmovl_u16(vget_high_u16(w1)));
+        int32x4_t reslo = vreinterpretq_s32_u32(divX_u32(vaddq_u32(tmplo, round), div, shift));
+        int32x4_t reshi = vreinterpretq_s32_u32(divX_u32(vaddq_u32(tmphi, round), div, shift));
+
+        reslo = vbslq_s32(vcltzq_s32(difflo), vnegq_s32(reslo), reslo);
+        reshi = vbslq_s32(vcltzq_s32(diffhi), vnegq_s32(reshi), reshi);
+
+        reslo = vaddq_s32(reslo, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v2))));
+        reshi = vaddq_s32(reshi, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v2))));
+
+        vst1q_u16(dstp + i, vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(reslo)), vmovn_u32(vreinterpretq_u32_s32(reshi))));
+    }
+}
+
+void vs_mask_merge_premul_float_neon(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const float *srcp1 = src1;
+    const float *srcp2 = src2;
+    const float *maskp = mask;
+    float *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+
+    for (i = 0; i < n; i += 4) {
+        float32x4_t v1 = vld1q_f32(srcp1 + i);
+        float32x4_t v2 = vld1q_f32(srcp2 + i);
+        float32x4_t w1 = vsubq_f32(vdupq_n_f32(1.0f), vld1q_f32(maskp + i));
+        vst1q_f32(dstp + i, vmlaq_f32(v2, w1, v1));
+    }
+}
+
+void vs_makediff_byte_neon(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint8_t *srcp1 = src1;
+    const uint8_t *srcp2 = src2;
+    uint8_t *dstp = dst;
+    unsigned i;
+
+    uint8x16_t bias = vdupq_n_u8(0x80);
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 16) {
+        int8x16_t v1 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(srcp1 + i), bias));
+        int8x16_t v2 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(srcp2 + i), bias));
+        vst1q_u8(dstp + i, veorq_u8(vreinterpretq_u8_s8(vqsubq_s8(v1, v2)), bias));
+    }
+}
+
+void vs_makediff_word_neon(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    int32x4_t half = vdupq_n_s32(1U << (depth - 1));
+    uint16x8_t maxval = vdupq_n_u16((1U << depth) - 1);
+
+    for (i = 0; i < n; i += 8) {
+        uint16x8_t v1 = vld1q_u16(srcp1 + i);
+        uint16x8_t v2 = vld1q_u16(srcp2 + i);
+        int32x4_t tmplo = vaddq_s32(vreinterpretq_s32_u32(vsubl_u16(vget_low_u16(v1), vget_low_u16(v2))), half);
+        int32x4_t tmphi = vaddq_s32(vreinterpretq_s32_u32(vsubl_u16(vget_high_u16(v1), vget_high_u16(v2))), half);
+        vst1q_u16(dstp + i, vminq_u16(vcombine_u16(vqmovun_s32(tmplo), vqmovun_s32(tmphi)), maxval));
+    }
+}
+
+void vs_makediff_float_neon(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const float *srcp1 = src1;
+    const float *srcp2 = src2;
+    float *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 4) {
+        vst1q_f32(dstp + i, vsubq_f32(vld1q_f32(srcp1 + i), vld1q_f32(srcp2 + i)));
+    }
+}
+
+void vs_mergediff_byte_neon(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint8_t *srcp1 = src1;
+    const uint8_t *srcp2 = src2;
+    uint8_t *dstp = dst;
+    unsigned i;
+
+    uint8x16_t bias = vdupq_n_u8(0x80);
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 16) {
+        int8x16_t v1 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(srcp1 + i), bias));
+        int8x16_t v2 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(srcp2 + i), bias));
+        vst1q_u8(dstp + i, veorq_u8(vreinterpretq_u8_s8(vqaddq_s8(v1, v2)), bias));
+    }
+}
+
+void vs_mergediff_word_neon(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    int32x4_t half = vdupq_n_s32(1U << (depth - 1));
+    uint16x8_t maxval = vdupq_n_u16((1U << depth) - 1);
+
+    for (i = 0; i < n; i += 8) {
+        uint16x8_t v1 = vld1q_u16(srcp1 + i);
+        uint16x8_t v2 = vld1q_u16(srcp2 + i);
+        int32x4_t tmplo = vsubq_s32(vreinterpretq_s32_u32(vaddl_u16(vget_low_u16(v1), vget_low_u16(v2))), half);
+        int32x4_t tmphi = vsubq_s32(vreinterpretq_s32_u32(vaddl_u16(vget_high_u16(v1), vget_high_u16(v2))), half);
+        vst1q_u16(dstp + i, vminq_u16(vcombine_u16(vqmovun_s32(tmplo), vqmovun_s32(tmphi)), maxval));
+    }
+}
+
+void vs_mergediff_float_neon(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const float *srcp1 = src1;
+    const float *srcp2 = src2;
+    float *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 4) {
+        vst1q_f32(dstp + i, vaddq_f32(vld1q_f32(srcp1 + i), vld1q_f32(srcp2 + i)));
+    }
+}
@@ -0,0 +1,104 @@
+/*
+* Copyright (c) 2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <stdint.h>
+#include "audio.h"
+
+static int16_t to_int16(double x)
+{
+    return x < INT16_MIN ? INT16_MIN : x > INT16_MAX ? INT16_MAX : (int16_t)x;
+}
+
+static int32_t to_int32(double x)
+{
+    return x < INT32_MIN ? INT32_MIN : x > INT32_MAX ? INT32_MAX : (int32_t)x;
+}
+
+static float to_float(double x)
+{
+    return (float)x;
+}
+
+#define AUDIO_KERNELS(sample, T) \
+void vs_audio_gain_##sample##_c(const void *src, void *dst, double gain, size_t length) \
+{ \
+    const T *srcp = src; \
+    T *dstp = dst; \
+    size_t i; \
+\
+    for (i = 0; i < length; i++) \
+        dstp[i] = to_##sample(srcp[i] * gain); \
+} \
+\
+void vs_audio_mix_##sample##_c(const void * const *srcs, const double *weights, unsigned num_srcs, void *dst, size_t length) \
+{ \
+    T *dstp = dst; \
+    size_t i; \
+    unsigned k; \
+\
+    for (i = 0; i < length; i++) { \
+        double tmp = 0; \
+        for (k = 0; k < num_srcs; k++) \
+            tmp += ((const T *)srcs[k])[i] * weights[k]; \
+        dstp[i] = to_##sample(tmp); \
+    } \
+}
+
+AUDIO_KERNELS(int16, int16_t)
+AUDIO_KERNELS(int32, int32_t)
+AUDIO_KERNELS(float, float)
+
+#undef AUDIO_KERNELS
+
+static size_t resample_row(unsigned phase, unsigned table_phases, unsigned num_phases)
+{
+    if (table_phases == num_phases)
+        return phase;
+    return (size_t)(((uint64_t)phase * table_phases + num_phases / 2) / num_phases);
+}
+
+void vs_audio_resample_c(const float * const *srcs, float * const *dsts, unsigned num_channels, size_t length, const float *coeffs, unsigned taps, unsigned table_phases, unsigned phase, unsigned num_phases, unsigned step)
+{
+    unsigned step_int = step / num_phases;
+    unsigned step_frac = step % num_phases;
+    size_t pos = 0;
+    size_t i;
+    unsigned c, k;
+
+    for (i = 0; i < length; i++) {
+        const float *w = coeffs + resample_row(phase, table_phases, num_phases) * taps;
+
+        for (c = 0; c < num_channels; c++) {
+            const float *srcp = srcs[c] + pos;
+            float tmp = 0;
+
+            for (k = 0; k < taps; k++)
+                tmp += srcp[k] * w[k];
+            dsts[c][i] = tmp;
+        }
+
+        pos += step_int;
+        phase += step_frac;
+        if (phase >= num_phases) {
+            phase -= num_phases;
+            pos++;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/*
+* Copyright (c) 2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * All arithmetic is done in double precision. Integer results are truncated
+ * towards zero and clamped to the range of the sample type, float results are
+ * rounded to float.
+ *
+ * gain multiplies length samples of one channel by gain.
+ *
+ * mix produces length samples of one output channel, sample i is the sum of
+ * srcs[k][i] * weights[k] for k = 0 ... num_srcs - 1, added up in that order.
+ *
+ * resample is the exception and works on float samples in single precision.
+ * It runs a polyphase FIR filter over num_channels channels that share the
+ * same coefficients. coeffs holds table_phases + 1 rows of taps values each,
+ * taps must be a multiple of 8. Output sample i of channel c is the sum of
+ * srcs[c][pos + k] * coeffs[row * taps + k] for k = 0 ... taps - 1 where pos
+ * starts at 0 and row is phase scaled from num_phases to table_phases and
+ * rounded. After each output sample phase is advanced by step and pos by the
+ * whole multiples of num_phases that were passed. The order of the additions
+ * is unspecified.
+ */
+#define DECL_GAIN(sample, isa) void vs_audio_gain_##sample##_##isa(const void *src, void *dst, double gain, size_t length);
+#define DECL_MIX(sample, isa) void vs_audio_mix_##sample##_##isa(const void * const *srcs, const double *weights, unsigned num_srcs, void *dst, size_t length);
+#define DECL_RESAMPLE(isa) void vs_audio_resample_##isa(const float * const *srcs, float * const *dsts, unsigned num_channels, size_t length, const float *coeffs, unsigned taps, unsigned table_phases, unsigned phase, unsigned num_phases, unsigned step);
+
+DECL_GAIN(int16, c)
+DECL_GAIN(int32, c)
+DECL_GAIN(float, c)
+
+DECL_MIX(int16, c)
+DECL_MIX(int32, c)
+DECL_MIX(float, c)
+
+DECL_RESAMPLE(c)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_GAIN(int16, sse2)
+DECL_GAIN(int32, sse2)
+DECL_GAIN(float, sse2)
+
+DECL_MIX(int16, sse2)
+DECL_MIX(int32, sse2)
+DECL_MIX(float, sse2)
+
+DECL_GAIN(int16, avx2)
+DECL_GAIN(int32, avx2)
+DECL_GAIN(float, avx2)
+
+DECL_MIX(int16, avx2)
+DECL_MIX(int32, avx2)
+DECL_MIX(float, avx2)
+
+DECL_RESAMPLE(avx2)
+#endif
+
+#undef DECL_RESAMPLE
+#undef DECL_MIX
+#undef DECL_GAIN
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_H
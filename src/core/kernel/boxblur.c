@@ -0,0 +1,93 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#define VS_BOXBLUR_IMPL
+#include "boxblur.h"
+#include "VSHelper4.h"
+
+#define ROW(p, stride, y) ((const void *)((const uint8_t *)(p) + (ptrdiff_t)(y) * (stride)))
+
+#define BOXBLUR_V_INT(pixel, T) \
+void vs_boxblur_v_##pixel##_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round) \
+{ \
+    uint32_t * VS_RESTRICT accp = acc; \
+    struct vs_boxblur_div div = vs_boxblur_div_init(radius * 2 + 1); \
+    unsigned x, y; \
+\
+    { \
+        const T *srcp = src; \
+        for (x = 0; x < width; x++) \
+            accp[x] = radius * srcp[x]; \
+    } \
+    for (y = 0; y < radius; y++) { \
+        const T *srcp = ROW(src, src_stride, VSMIN(y, height - 1)); \
+        for (x = 0; x < width; x++) \
+            accp[x] += srcp[x]; \
+    } \
+\
+    for (y = 0; y < height; y++) { \
+        const T * VS_RESTRICT addp = ROW(src, src_stride, VSMIN(y + radius, height - 1)); \
+        const T * VS_RESTRICT subp = ROW(src, src_stride, y > radius ? y - radius : 0); \
+        T * VS_RESTRICT dstp = (T *)((uint8_t *)dst + (ptrdiff_t)y * dst_stride); \
+\
+        for (x = 0; x < width; x++) { \
+            uint32_t a = accp[x] + addp[x]; \
+            dstp[x] = (T)vs_boxblur_div_apply(a + round, div); \
+            accp[x] = a - subp[x]; \
+        } \
+    } \
+}
+
+BOXBLUR_V_INT(byte, uint8_t)
+BOXBLUR_V_INT(word, uint16_t)
+
+#undef BOXBLUR_V_INT
+
+void vs_boxblur_v_float_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round)
+{
+    float * VS_RESTRICT accp = acc;
+    float div = 1.0f / (radius * 2 + 1);
+    unsigned x, y;
+
+    (void)round;
+
+    {
+        const float *srcp = src;
+        for (x = 0; x < width; x++)
+            accp[x] = radius * srcp[x];
+    }
+    for (y = 0; y < radius; y++) {
+        const float *srcp = ROW(src, src_stride, VSMIN(y, height - 1));
+        for (x = 0; x < width; x++)
+            accp[x] += srcp[x];
+    }
+
+    for (y = 0; y < height; y++) {
+        const float * VS_RESTRICT addp = ROW(src, src_stride, VSMIN(y + radius, height - 1));
+        const float * VS_RESTRICT subp = ROW(src, src_stride, y > radius ? y - radius : 0);
+        float * VS_RESTRICT dstp = (float *)((uint8_t *)dst + (ptrdiff_t)y * dst_stride);
+
+        for (x = 0; x < width; x++) {
+            float a = accp[x] + addp[x];
+            dstp[x] = a * div;
+            accp[x] = a - subp[x];
+        }
+    }
+}
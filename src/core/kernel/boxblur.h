@@ -0,0 +1,98 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef BOXBLUR_H
+#define BOXBLUR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Box blurs every column of a width x height plane using a running sum that
+ * is kept for all columns of a row at once, so each step is a plain vertical
+ * operation. Rows outside the plane repeat the edge rows. The acc buffer must
+ * hold width 32-bit values. Integer sums have round added before they are
+ * divided by radius * 2 + 1, float ignores round.
+ */
+#define DECL_V(pixel, isa) void vs_boxblur_v_##pixel##_##isa(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round);
+
+DECL_V(byte, c)
+DECL_V(word, c)
+DECL_V(float, c)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_V(byte, sse2)
+DECL_V(word, sse2)
+DECL_V(float, sse2)
+
+DECL_V(byte, avx2)
+DECL_V(word, avx2)
+DECL_V(float, avx2)
+#endif
+
+#undef DECL_V
+
+#ifdef VS_BOXBLUR_IMPL
+// Division of any 32-bit value by an odd divisor > 1 with a multiply and shifts.
+// From libdivide's branchfree unsigned 32-bit algorithm.
+struct vs_boxblur_div {
+    uint32_t magic;
+    unsigned shift;
+};
+
+static inline struct vs_boxblur_div vs_boxblur_div_init(uint32_t div)
+{
+    struct vs_boxblur_div d;
+    uint64_t num;
+    uint32_t m, rem, twice_rem;
+    unsigned shift = 0;
+
+    while ((div >> shift) > 1)
+        shift++;
+
+    num = (uint64_t)1 << (32 + shift);
+    m = (uint32_t)(num / div);
+    rem = (uint32_t)(num - (uint64_t)m * div);
+    m += m;
+    twice_rem = rem + rem;
+    if (twice_rem >= div || twice_rem < rem)
+        m += 1;
+
+    d.magic = m + 1;
+    d.shift = shift;
+    return d;
+}
+
+static inline uint32_t vs_boxblur_div_apply(uint32_t x, struct vs_boxblur_div d)
+{
+    uint32_t q = (uint32_t)(((uint64_t)x * d.magic) >> 32);
+    return (((x - q) >> 1) + q) >> d.shift;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOXBLUR_H
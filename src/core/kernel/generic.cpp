@@ -20,10 +20,12 @@
 
 #include <algorithm>
 #include <array>
+#include <climits>
 #include <cmath>
 #include <cstdint>
 #include <limits>
 #include <type_traits>
+#include <vector>
 #include "generic.h"
 
 namespace {
@@ -310,7 +312,7 @@ void conv_plane_5x5(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t
         T *dst_p = static_cast<T *>(line_ptr(dst, i, dst_stride));
 
         for (unsigned j = 0; j < std::min(width, 2U); ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
             unsigned idx[5];
 
             idx[0] = j < 2 ? std::min(2 - j, width - 1) : j - 2;
@@ -351,7 +353,7 @@ void conv_plane_5x5(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t
         }
 
         for (unsigned j = std::max(2U, width - std::min(width, 2U)); j < width; ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
             unsigned idx[5];
 
             idx[0] = j < 2 ? std::min(2 - j, width - 1) : j - 2;
@@ -377,6 +379,77 @@ void conv_plane_5x5(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t
     }
 }
 
+// Position of tap k of a 5 tap filter centered on i, mirrored at the edges like conv_plane_5x5 does.
+unsigned mirror_5(unsigned i, unsigned k, unsigned n)
+{
+    unsigned dist_from_end = n - 1 - i;
+
+    if (k < 2)
+        return i < 2 - k ? std::min(2 - k - i, n - 1) : i - 2 + k;
+    else
+        return dist_from_end < k - 2 ? i - std::min(k - 2 - dist_from_end, i) : i - 2 + k;
+}
+
+// The horizontal pass of each source row is stored in a ring of 5 rows and reused by the 5 output rows that
+// need it, so the intermediate stays in cache. Integer sums are exact, so the result is identical to conv_plane_5x5.
+template <class T>
+void conv_plane_5x5_sep(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    typedef typename std::conditional<std::is_integral<T>::value, int32_t, float>::type Accum;
+    typedef typename std::conditional<std::is_integral<T>::value, int16_t, float>::type Weight;
+
+    const Weight *coeffs_h = std::is_integral<T>::value ? (const Weight *)params.matrix_h : (const Weight *)params.matrixf_h;
+    const Weight *coeffs_v = std::is_integral<T>::value ? (const Weight *)params.matrix_v : (const Weight *)params.matrixf_v;
+    uint16_t maxval = params.maxval;
+    float div = params.div;
+    float bias = params.bias;
+    bool saturate = params.saturate;
+
+    std::vector<Accum> ring(5 * static_cast<size_t>(width));
+    unsigned ring_row[5] = { UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX };
+
+    for (unsigned i = 0; i < height; ++i) {
+        const Accum *rows[5];
+
+        for (unsigned k = 0; k < 5; ++k) {
+            unsigned r = mirror_5(i, k, height);
+            Accum *tmp = ring.data() + (r % 5) * static_cast<size_t>(width);
+
+            if (ring_row[r % 5] != r) {
+                const T *srcp = static_cast<const T *>(line_ptr(src, r, src_stride));
+
+                for (unsigned j = 0; j < width; ++j) {
+                    Accum accum = 0;
+
+                    if (j >= 2 && j + 2 < width) {
+                        for (unsigned m = 0; m < 5; ++m)
+                            accum += coeffs_h[m] * static_cast<Accum>(srcp[j - 2 + m]);
+                    } else {
+                        for (unsigned m = 0; m < 5; ++m)
+                            accum += coeffs_h[m] * static_cast<Accum>(srcp[mirror_5(j, m, width)]);
+                    }
+                    tmp[j] = accum;
+                }
+                ring_row[r % 5] = r;
+            }
+            rows[k] = tmp;
+        }
+
+        T *dstp = static_cast<T *>(line_ptr(dst, i, dst_stride));
+
+        for (unsigned j = 0; j < width; ++j) {
+            Accum accum = 0;
+
+            for (unsigned k = 0; k < 5; ++k)
+                accum += coeffs_v[k] * rows[k][j];
+
+            float tmp = static_cast<float>(accum) * div + bias;
+            tmp = saturate ? tmp : std::fabs(tmp);
+            dstp[j] = limit(xrint<T>(tmp), maxval);
+        }
+    }
+}
+
 template <class T>
 void conv_plane_h(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
 {
@@ -397,7 +470,7 @@ void conv_plane_h(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t ds
         T *dstp = static_cast<T *>(line_ptr(dst, i, dst_stride));
 
         for (unsigned j = 0; j < std::min(width, support); ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
 
             Accum accum = 0;
 
@@ -429,7 +502,7 @@ void conv_plane_h(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t ds
         }
 
         for (unsigned j = std::max(support, width - std::min(width, support)); j < width; ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
 
             Accum accum = 0;
 
@@ -531,6 +604,126 @@ void conv_plane_v(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t ds
     }
 }
 
+// Position i reflected back into [0, n) without repeating the edge pixel.
+unsigned reflect(int i, unsigned n)
+{
+    if (i < 0)
+        return std::min(static_cast<unsigned>(-i), n - 1);
+    if (i >= static_cast<int>(n))
+        return static_cast<unsigned>(std::max(2 * static_cast<int>(n - 1) - i, 0));
+    return static_cast<unsigned>(i);
+}
+
+// The plane is processed in columns narrow enough that the ring of horizontally filtered rows stays in the L1 cache
+// even for the largest vertical filters. Every source row is filtered once per column and kept until the last output
+// row that needs it, the tiling doesn't change the result.
+template <class T>
+void conv_plane_sep(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    unsigned taps_h = params.sepsize_h;
+    unsigned taps_v = params.sepsize_v;
+    unsigned support_h = taps_h / 2;
+    unsigned support_v = taps_v / 2;
+    unsigned tile = std::min(width, std::max(64U, 32768 / (taps_v * 4) & ~15U));
+
+    uint16_t maxval = params.maxval;
+    float div = params.div;
+    float bias = params.bias;
+    bool saturate = params.saturate;
+
+    std::vector<float> row(tile + 2 * support_h);
+    std::vector<float> ring(static_cast<size_t>(taps_v) * tile);
+    std::vector<unsigned> ring_row(taps_v);
+
+    for (unsigned x0 = 0; x0 < width; x0 += tile) {
+        unsigned w = std::min(tile, width - x0);
+
+        std::fill(ring_row.begin(), ring_row.end(), UINT_MAX);
+
+        for (unsigned i = 0; i < height; ++i) {
+            const float *rows[65];
+
+            for (unsigned k = 0; k < taps_v; ++k) {
+                unsigned r = reflect(static_cast<int>(i + k) - static_cast<int>(support_v), height);
+                float *tmp = ring.data() + (r % taps_v) * static_cast<size_t>(tile);
+
+                if (ring_row[r % taps_v] != r) {
+                    const T *srcp = static_cast<const T *>(line_ptr(src, r, src_stride));
+
+                    for (unsigned j = 0; j < w + 2 * support_h; ++j)
+                        row[j] = static_cast<float>(srcp[reflect(static_cast<int>(x0 + j) - static_cast<int>(support_h), width)]);
+
+                    for (unsigned j = 0; j < w; ++j) {
+                        float accum = 0;
+
+                        for (unsigned m = 0; m < taps_h; ++m)
+                            accum += params.sepf_h[m] * row[j + m];
+                        tmp[j] = accum;
+                    }
+                    ring_row[r % taps_v] = r;
+                }
+                rows[k] = tmp;
+            }
+
+            T *dstp = static_cast<T *>(line_ptr(dst, i, dst_stride)) + x0;
+
+            for (unsigned j = 0; j < w; ++j) {
+                float accum = 0;
+
+                for (unsigned k = 0; k < taps_v; ++k)
+                    accum += params.sepf_v[k] * rows[k][j];
+
+                float tmp = accum * div + bias;
+                tmp = saturate ? tmp : std::fabs(tmp);
+                dstp[j] = limit(xrint<T>(tmp), maxval);
+            }
+        }
+    }
+}
+
+template <class T>
+struct InvertOp {
+    static T op(T x, const vs_generic_params &params) { return static_cast<T>(params.maxval - std::min(x, static_cast<T>(params.maxval))); }
+};
+
+template <>
+struct InvertOp<float> {
+    static float op(float x, const vs_generic_params &params) { return params.hif - x; }
+};
+
+template <class T>
+struct LimitOp {
+    static T op(T x, const vs_generic_params &params) { return std::min(static_cast<T>(params.hi), std::max(static_cast<T>(params.lo), x)); }
+};
+
+template <>
+struct LimitOp<float> {
+    static float op(float x, const vs_generic_params &params) { return std::min(params.hif, std::max(params.lof, x)); }
+};
+
+template <class T>
+struct BinarizeOp {
+    static T op(T x, const vs_generic_params &params) { return static_cast<T>(x < params.threshold ? params.lo : params.hi); }
+};
+
+template <>
+struct BinarizeOp<float> {
+    static float op(float x, const vs_generic_params &params) { return x < params.thresholdf ? params.lof : params.hif; }
+};
+
+template <class T, class Op>
+void point_plane(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    for (unsigned i = 0; i < height; ++i) {
+        const T *srcp = line_ptr(static_cast<const T *>(src), i, src_stride);
+        T *dstp = line_ptr(static_cast<T *>(dst), i, dst_stride);
+
+        for (unsigned j = 0; j < width; ++j) {
+            dstp[j] = Op::op(srcp[j], params);
+        }
+    }
+}
+
 } // namespace
 
 
@@ -669,6 +862,36 @@ void vs_generic_5x5_conv_float_c(const void *src, ptrdiff_t src_stride, void *ds
     conv_plane_5x5<float>(src, src_stride, dst, dst_stride, *params, width, height);
 }
 
+void vs_generic_5x5_conv_sep_byte_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_5x5_sep<uint8_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_5x5_conv_sep_word_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_5x5_sep<uint16_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_5x5_conv_sep_float_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_5x5_sep<float>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_byte_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<uint8_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_word_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<uint16_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_float_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<float>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
 void vs_generic_1d_conv_h_byte_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
 {
     conv_plane_h<uint8_t>(src, src_stride, dst, dst_stride, *params, width, height);
@@ -697,3 +920,80 @@ void vs_generic_1d_conv_v_float_c(const void *src, ptrdiff_t src_stride, void *d
 {
     conv_plane_v<float>(src, src_stride, dst, dst_stride, *params, width, height);
 }
+
+void vs_generic_invert_byte_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<uint8_t, InvertOp<uint8_t>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_word_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<uint16_t, InvertOp<uint16_t>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_float_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<float, InvertOp<float>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_byte_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<uint8_t, LimitOp<uint8_t>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_word_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<uint16_t, LimitOp<uint16_t>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_float_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<float, LimitOp<float>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_byte_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<uint8_t, BinarizeOp<uint8_t>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_word_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<uint16_t, BinarizeOp<uint16_t>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_float_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<float, BinarizeOp<float>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_levels_float_c(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    float gamma = params->gamma;
+    float min_in = params->min_in;
+    float max_in = params->max_in;
+    float min_out = params->min_out;
+    float range_in = 1.0f / (max_in - min_in);
+    float range_out = params->max_out - min_out;
+
+    if (std::abs(gamma - 1.0f) < std::numeric_limits<float>::epsilon()) {
+        float range_scale = range_out / (max_in - min_in);
+
+        for (unsigned i = 0; i < height; ++i) {
+            const float *srcp = line_ptr(static_cast<const float *>(src), i, src_stride);
+            float *dstp = line_ptr(static_cast<float *>(dst), i, dst_stride);
+
+            for (unsigned j = 0; j < width; ++j) {
+                dstp[j] = std::max(std::min(srcp[j], max_in) - min_in, 0.0f) * range_scale + min_out;
+            }
+        }
+    } else {
+        for (unsigned i = 0; i < height; ++i) {
+            const float *srcp = line_ptr(static_cast<const float *>(src), i, src_stride);
+            float *dstp = line_ptr(static_cast<float *>(dst), i, dst_stride);
+
+            for (unsigned j = 0; j < width; ++j) {
+                dstp[j] = std::pow(std::max(std::min(srcp[j], max_in) - min_in, 0.0f) * range_in, gamma) * range_out + min_out;
+            }
+        }
+    }
+}
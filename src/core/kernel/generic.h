@@ -34,7 +34,7 @@ struct vs_generic_params {
 	/* Prewitt, Sobel. */
 	float scale;
 
-	/* Minimum, Maximum, Deflate, Inflate. */
+	/* Minimum, Maximum, Deflate, Inflate, Binarize. */
 	uint16_t threshold;
 	float thresholdf;
 
@@ -48,11 +48,51 @@ struct vs_generic_params {
 	float div;
 	float bias;
 	uint8_t saturate;
+
+	/* Separable 5x5 convolution, the matrix is the outer product of matrix_v and matrix_h. */
+	int16_t matrix_h[5];
+	int16_t matrix_v[5];
+	float matrixf_h[5];
+	float matrixf_v[5];
+
+	/* Separable convolution with up to 65 taps in each direction, done in float for all formats. A size of 1 with a
+	 * coefficient of 1 leaves that direction unfiltered. */
+	unsigned sepsize_h;
+	unsigned sepsize_v;
+	float sepf_h[65];
+	float sepf_v[65];
+
+	/* Invert, Limiter, Binarize. */
+	uint16_t lo;
+	uint16_t hi;
+	float lof;
+	float hif;
+
+	/* Levels. */
+	float gamma;
+	float min_in;
+	float max_in;
+	float min_out;
+	float max_out;
 };
 
 #define DECL(kernel, pixel, isa) void vs_generic_##kernel##_##pixel##_##isa(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height);
 #define DECL_3x3(kernel, pixel, isa) DECL(3x3_##kernel, pixel, isa)
 
+/*
+ * Single pixel operations, src and dst may be the same plane.
+ * invert: maxval - min(x, maxval), float is hif - x.
+ * limit: x clamped to [lo, hi] or [lof, hif].
+ * binarize: lo where x < threshold (thresholdf), hi otherwise.
+ * levels: pow((clamp(x, min_in, max_in) - min_in) / (max_in - min_in), gamma) * (max_out - min_out) + min_out.
+ * The SIMD levels evaluate pow with a polynomial log2/exp2 pair, so they
+ * only match the C version within a few ulp and require max_in > min_in.
+ */
+#define DECL_POINT(pixel, isa) \
+    DECL(invert, pixel, isa) \
+    DECL(limit, pixel, isa) \
+    DECL(binarize, pixel, isa)
+
 DECL_3x3(prewitt, byte, c)
 DECL_3x3(prewitt, word, c)
 DECL_3x3(prewitt, float, c)
@@ -89,6 +129,14 @@ DECL(5x5_conv, byte, c)
 DECL(5x5_conv, word, c)
 DECL(5x5_conv, float, c)
 
+DECL(5x5_conv_sep, byte, c)
+DECL(5x5_conv_sep, word, c)
+DECL(5x5_conv_sep, float, c)
+
+DECL(conv_sep, byte, c)
+DECL(conv_sep, word, c)
+DECL(conv_sep, float, c)
+
 DECL(1d_conv_h, byte, c)
 DECL(1d_conv_h, word, c)
 DECL(1d_conv_h, float, c)
@@ -97,6 +145,11 @@ DECL(1d_conv_v, byte, c)
 DECL(1d_conv_v, word, c)
 DECL(1d_conv_v, float, c)
 
+DECL_POINT(byte, c)
+DECL_POINT(word, c)
+DECL_POINT(float, c)
+DECL(levels, float, c)
+
 #ifdef VS_TARGET_CPU_X86
 DECL_3x3(prewitt, byte, sse2)
 DECL_3x3(prewitt, word, sse2)
@@ -130,6 +183,11 @@ DECL_3x3(conv, byte, sse2)
 DECL_3x3(conv, word, sse2)
 DECL_3x3(conv, float, sse2)
 
+DECL_POINT(byte, sse2)
+DECL_POINT(word, sse2)
+DECL_POINT(float, sse2)
+DECL(levels, float, sse2)
+
 DECL_3x3(prewitt, byte, avx2)
 DECL_3x3(prewitt, word, avx2)
 DECL_3x3(prewitt, float, avx2)
@@ -161,8 +219,63 @@ DECL_3x3(inflate, float, avx2)
 DECL_3x3(conv, byte, avx2)
 DECL_3x3(conv, word, avx2)
 DECL_3x3(conv, float, avx2)
+
+DECL(5x5_conv_sep, byte, avx2)
+DECL(5x5_conv_sep, word, avx2)
+DECL(5x5_conv_sep, float, avx2)
+
+DECL(conv_sep, byte, avx2)
+DECL(conv_sep, word, avx2)
+DECL(conv_sep, float, avx2)
+
+DECL_POINT(byte, avx2)
+DECL_POINT(word, avx2)
+DECL_POINT(float, avx2)
+DECL(levels, float, avx2)
+
+DECL_3x3(prewitt, byte, avx512)
+DECL_3x3(prewitt, word, avx512)
+DECL_3x3(prewitt, float, avx512)
+
+DECL_3x3(sobel, byte, avx512)
+DECL_3x3(sobel, word, avx512)
+DECL_3x3(sobel, float, avx512)
+
+DECL_3x3(min, byte, avx512)
+DECL_3x3(min, word, avx512)
+DECL_3x3(min, float, avx512)
+
+DECL_3x3(max, byte, avx512)
+DECL_3x3(max, word, avx512)
+DECL_3x3(max, float, avx512)
+
+DECL_3x3(median, byte, avx512)
+DECL_3x3(median, word, avx512)
+DECL_3x3(median, float, avx512)
+
+DECL_3x3(deflate, byte, avx512)
+DECL_3x3(deflate, word, avx512)
+DECL_3x3(deflate, float, avx512)
+
+DECL_3x3(inflate, byte, avx512)
+DECL_3x3(inflate, word, avx512)
+DECL_3x3(inflate, float, avx512)
+
+DECL_3x3(conv, byte, avx512)
+DECL_3x3(conv, word, avx512)
+DECL_3x3(conv, float, avx512)
+
+DECL(conv_sep, byte, avx512)
+DECL(conv_sep, word, avx512)
+DECL(conv_sep, float, avx512)
+
+DECL_POINT(byte, avx512)
+DECL_POINT(word, avx512)
+DECL_POINT(float, avx512)
+DECL(levels, float, avx512)
 #endif
 
+#undef DECL_POINT
 #undef DECL_3x3
 #undef DECL
 
@@ -0,0 +1,90 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef HALF_H
+#define HALF_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Conversions between half and single precision used by the reference kernels. They round to nearest even and
+// handle denormals, infinity and NaN the same way as the F16C instructions so all code paths give the same result.
+
+static inline float vs_half_to_float(uint16_t h)
+{
+    const uint32_t shifted_exp = 0x7C00U << 13;
+    uint32_t bits = (uint32_t)(h & 0x7FFF) << 13;
+    uint32_t exp = bits & shifted_exp;
+    float f;
+
+    bits += (127U - 15U) << 23;
+    if (exp == shifted_exp) {
+        // infinity and NaN
+        bits += (128U - 16U) << 23;
+    } else if (exp == 0) {
+        // zero and denormals are renormalized by the subtraction
+        const uint32_t magic_bits = 113U << 23;
+        float magic;
+        bits += 1U << 23;
+        memcpy(&f, &bits, sizeof(f));
+        memcpy(&magic, &magic_bits, sizeof(magic));
+        f -= magic;
+        memcpy(&bits, &f, sizeof(bits));
+    }
+
+    bits |= (uint32_t)(h & 0x8000) << 16;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline uint16_t vs_float_to_half(float v)
+{
+    const uint32_t f32infty = 255U << 23;
+    const uint32_t f16max = (127U + 16U) << 23;
+    const uint32_t denorm_magic_bits = ((127U - 15U) + (23U - 10U) + 1U) << 23;
+    uint32_t bits;
+    uint32_t sign;
+    uint16_t h;
+
+    memcpy(&bits, &v, sizeof(bits));
+    sign = bits & 0x80000000U;
+    bits ^= sign;
+
+    if (bits >= f16max) {
+        h = bits > f32infty ? 0x7E00 : 0x7C00;
+    } else if (bits < (113U << 23)) {
+        // the addition shifts the mantissa into place and rounds it
+        float f, denorm_magic;
+        memcpy(&f, &bits, sizeof(f));
+        memcpy(&denorm_magic, &denorm_magic_bits, sizeof(denorm_magic));
+        f += denorm_magic;
+        memcpy(&bits, &f, sizeof(bits));
+        h = (uint16_t)(bits - denorm_magic_bits);
+    } else {
+        uint32_t mant_odd = (bits >> 13) & 1;
+        bits += ((uint32_t)(15 - 127) << 23) + 0xFFF;
+        bits += mant_odd;
+        h = (uint16_t)(bits >> 13);
+    }
+
+    return h | (uint16_t)(sign >> 16);
+}
+
+#endif // HALF_H
@@ -0,0 +1,71 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#ifndef LUT_H
+#define LUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Table lookups of n pixels. Indices are clamped to maxval first, for Lut2 the
+ * index is (y << shift) + x. The gather based kernels read 32 bits at a time,
+ * so the table must stay readable for VS_LUT_PADDING bytes past its end.
+ */
+#define VS_LUT_PADDING 4
+
+#define DECL_LUT(in, out, isa) void vs_lut_##in##_##out##_##isa(const void *src, void *dst, const void *lut, unsigned maxval, unsigned n);
+#define DECL_LUT2(inx, iny, out, isa) void vs_lut2_##inx##_##iny##_##out##_##isa(const void *srcx, const void *srcy, void *dst, const void *lut, unsigned maxvalx, unsigned maxvaly, unsigned shift, unsigned n);
+
+#ifdef VS_TARGET_CPU_X86
+DECL_LUT(byte, byte, avx2)
+DECL_LUT(byte, word, avx2)
+DECL_LUT(byte, float, avx2)
+DECL_LUT(word, byte, avx2)
+DECL_LUT(word, word, avx2)
+DECL_LUT(word, float, avx2)
+
+DECL_LUT2(byte, byte, byte, avx2)
+DECL_LUT2(byte, byte, word, avx2)
+DECL_LUT2(byte, byte, float, avx2)
+DECL_LUT2(byte, word, byte, avx2)
+DECL_LUT2(byte, word, word, avx2)
+DECL_LUT2(byte, word, float, avx2)
+DECL_LUT2(word, byte, byte, avx2)
+DECL_LUT2(word, byte, word, avx2)
+DECL_LUT2(word, byte, float, avx2)
+DECL_LUT2(word, word, byte, avx2)
+DECL_LUT2(word, word, word, avx2)
+DECL_LUT2(word, word, float, avx2)
+#endif
+
+#undef DECL_LUT2
+#undef DECL_LUT
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LUT_H
@@ -19,6 +19,7 @@
 */
 
 #define VS_MERGE_IMPL
+#include "half.h"
 #include "merge.h"
 #include "VSHelper4.h"
 
@@ -70,6 +71,21 @@ void vs_merge_float_c(const void *src1, const void *src2, void *dst, union vs_me
     }
 }
 
+void vs_merge_half_c(const void *src1, const void *src2, void *dst, union vs_merge_weight weight, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    float w = weight.f;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        float v1 = vs_half_to_float(srcp1[i]);
+        float v2 = vs_half_to_float(srcp2[i]);
+        dstp[i] = vs_float_to_half(v1 + (v2 - v1) * w);
+    }
+}
+
 
 void vs_mask_merge_byte_c(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
 {
@@ -134,6 +150,24 @@ void vs_mask_merge_float_c(const void *src1, const void *src2, const void *mask,
     }
 }
 
+void vs_mask_merge_half_c(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    const uint16_t *maskp = mask;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+
+    for (i = 0; i < n; i++) {
+        float v1 = vs_half_to_float(srcp1[i]);
+        float v2 = vs_half_to_float(srcp2[i]);
+        dstp[i] = vs_float_to_half(v1 + (v2 - v1) * vs_half_to_float(maskp[i]));
+    }
+}
+
 void vs_mask_merge_premul_byte_c(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
 {
     const uint8_t *srcp1 = src1;
@@ -209,6 +243,90 @@ void vs_mask_merge_premul_float_c(const void *src1, const void *src2, const void
     }
 }
 
+void vs_mask_merge_premul_half_c(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    const uint16_t *maskp = mask;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+
+    for (i = 0; i < n; i++) {
+        float v1 = vs_half_to_float(srcp1[i]);
+        float v2 = vs_half_to_float(srcp2[i]);
+        dstp[i] = vs_float_to_half((1.0f - vs_half_to_float(maskp[i])) * v1 + v2);
+    }
+}
+
+// The alpha value is scaled so the maximum becomes a power of 2 and the division a shift. Chroma is centered
+// around offset and truncated instead of rounded. Only the low bits of the intermediate result are needed so
+// it may wrap around.
+void vs_premultiply_byte_c(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint8_t *srcp = src;
+    const uint8_t *alphap = alpha;
+    uint8_t *dstp = dst;
+    unsigned round = chroma ? 0 : 128;
+    unsigned i;
+
+    (void)depth;
+
+    for (i = 0; i < n; i++) {
+        unsigned a = alphap[i];
+        unsigned m = a + ((a >> 1) & 1);
+        dstp[i] = (uint8_t)((((srcp[i] - offset) * m + round) >> 8) + offset);
+    }
+}
+
+void vs_premultiply_word_c(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint16_t *srcp = src;
+    const uint16_t *alphap = alpha;
+    uint16_t *dstp = dst;
+    unsigned maxval = (1U << depth) - 1;
+    unsigned round = chroma ? 0 : (1U << (depth - 1));
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        unsigned a = alphap[i] < maxval ? alphap[i] : maxval;
+        unsigned m = a + ((a >> 1) & 1);
+        dstp[i] = (uint16_t)((((srcp[i] - offset) * m + round) >> depth) + offset);
+    }
+}
+
+void vs_premultiply_float_c(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const float *srcp = src;
+    const float *alphap = alpha;
+    float *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+    (void)chroma;
+
+    for (i = 0; i < n; i++)
+        dstp[i] = srcp[i] * alphap[i];
+}
+
+void vs_premultiply_half_c(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint16_t *srcp = src;
+    const uint16_t *alphap = alpha;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+    (void)chroma;
+
+    for (i = 0; i < n; i++)
+        dstp[i] = vs_float_to_half(vs_half_to_float(srcp[i]) * vs_half_to_float(alphap[i]));
+}
+
 void vs_makediff_byte_c(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
 {
     const uint8_t *srcp1 = src1;
@@ -257,6 +375,20 @@ void vs_makediff_float_c(const void *src1, const void *src2, void *dst, unsigned
     }
 }
 
+void vs_makediff_half_c(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+
+    for (i = 0; i < n; i++) {
+        dstp[i] = vs_float_to_half(vs_half_to_float(srcp1[i]) - vs_half_to_float(srcp2[i]));
+    }
+}
+
 void vs_mergediff_byte_c(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
 {
     const uint8_t *srcp1 = src1;
@@ -304,3 +436,17 @@ void vs_mergediff_float_c(const void *src1, const void *src2, void *dst, unsigne
         dstp[i] = srcp1[i] + srcp2[i];
     }
 }
+
+void vs_mergediff_half_c(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+
+    for (i = 0; i < n; i++) {
+        dstp[i] = vs_float_to_half(vs_half_to_float(srcp1[i]) + vs_half_to_float(srcp2[i]));
+    }
+}
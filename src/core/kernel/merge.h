@@ -36,28 +36,39 @@ union vs_merge_weight {
 #define DECL_MERGE(pixel, isa) void vs_merge_##pixel##_##isa(const void *src1, const void *src2, void *dst, union vs_merge_weight weight, unsigned n);
 #define DECL_MASK_MERGE(pixel, isa) void vs_mask_merge_##pixel##_##isa(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n);
 #define DECL_MASK_MERGE_PREMUL(pixel, isa) void vs_mask_merge_premul_##pixel##_##isa(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n);
+#define DECL_PREMULTIPLY(pixel, isa) void vs_premultiply_##pixel##_##isa(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n);
 #define DECL_MAKEDIFF(pixel, isa) void vs_makediff_##pixel##_##isa(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n);
 #define DECL_MERGEDIFF(pixel, isa) void vs_mergediff_##pixel##_##isa(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n);
 
 DECL_MERGE(byte, c)
 DECL_MERGE(word, c)
 DECL_MERGE(float, c)
+DECL_MERGE(half, c)
 
 DECL_MASK_MERGE(byte, c)
 DECL_MASK_MERGE(word, c)
 DECL_MASK_MERGE(float, c)
+DECL_MASK_MERGE(half, c)
 
 DECL_MASK_MERGE_PREMUL(byte, c)
 DECL_MASK_MERGE_PREMUL(word, c)
 DECL_MASK_MERGE_PREMUL(float, c)
+DECL_MASK_MERGE_PREMUL(half, c)
+
+DECL_PREMULTIPLY(byte, c)
+DECL_PREMULTIPLY(word, c)
+DECL_PREMULTIPLY(float, c)
+DECL_PREMULTIPLY(half, c)
 
 DECL_MAKEDIFF(byte, c)
 DECL_MAKEDIFF(word, c)
 DECL_MAKEDIFF(float, c)
+DECL_MAKEDIFF(half, c)
 
 DECL_MERGEDIFF(byte, c)
 DECL_MERGEDIFF(word, c)
 DECL_MERGEDIFF(float, c)
+DECL_MERGEDIFF(half, c)
 
 #ifdef VS_TARGET_CPU_X86
 DECL_MERGE(byte, sse2);
@@ -72,6 +83,10 @@ DECL_MASK_MERGE_PREMUL(byte, sse2)
 DECL_MASK_MERGE_PREMUL(word, sse2)
 DECL_MASK_MERGE_PREMUL(float, sse2)
 
+DECL_PREMULTIPLY(byte, sse2)
+DECL_PREMULTIPLY(word, sse2)
+DECL_PREMULTIPLY(float, sse2)
+
 DECL_MAKEDIFF(byte, sse2)
 DECL_MAKEDIFF(word, sse2)
 DECL_MAKEDIFF(float, sse2)
@@ -83,26 +98,59 @@ DECL_MERGEDIFF(float, sse2)
 DECL_MERGE(byte, avx2);
 DECL_MERGE(word, avx2);
 DECL_MERGE(float, avx2);
+DECL_MERGE(half, avx2);
 
 DECL_MASK_MERGE(byte, avx2)
 DECL_MASK_MERGE(word, avx2)
 DECL_MASK_MERGE(float, avx2)
+DECL_MASK_MERGE(half, avx2)
 
 DECL_MASK_MERGE_PREMUL(byte, avx2)
 DECL_MASK_MERGE_PREMUL(word, avx2)
 DECL_MASK_MERGE_PREMUL(float, avx2)
+DECL_MASK_MERGE_PREMUL(half, avx2)
+
+DECL_PREMULTIPLY(byte, avx2)
+DECL_PREMULTIPLY(word, avx2)
+DECL_PREMULTIPLY(float, avx2)
+DECL_PREMULTIPLY(half, avx2)
 
 DECL_MAKEDIFF(byte, avx2)
 DECL_MAKEDIFF(word, avx2)
 DECL_MAKEDIFF(float, avx2)
+DECL_MAKEDIFF(half, avx2)
 
 DECL_MERGEDIFF(byte, avx2)
 DECL_MERGEDIFF(word, avx2)
 DECL_MERGEDIFF(float, avx2)
+DECL_MERGEDIFF(half, avx2)
+#endif
+
+#ifdef VS_TARGET_CPU_ARM_NEON
+DECL_MERGE(byte, neon)
+DECL_MERGE(word, neon)
+DECL_MERGE(float, neon)
+
+DECL_MASK_MERGE(byte, neon)
+DECL_MASK_MERGE(word, neon)
+DECL_MASK_MERGE(float, neon)
+
+DECL_MASK_MERGE_PREMUL(byte, neon)
+DECL_MASK_MERGE_PREMUL(word, neon)
+DECL_MASK_MERGE_PREMUL(float, neon)
+
+DECL_MAKEDIFF(byte, neon)
+DECL_MAKEDIFF(word, neon)
+DECL_MAKEDIFF(float, neon)
+
+DECL_MERGEDIFF(byte, neon)
+DECL_MERGEDIFF(word, neon)
+DECL_MERGEDIFF(float, neon)
 #endif
 
 #undef DECL_MERGEDIFF
 #undef DECL_MAKEDIFF
+#undef DECL_PREMULTIPLY
 #undef DECL_MASK_MERGE_PREMUL
 #undef DECL_MASK_MERGE
 #undef DECL_MERGE
@@ -19,6 +19,7 @@
 */
 
 #include <limits.h>
+#include "half.h"
 #include "planestats.h"
 #include "VSHelper4.h"
 
@@ -91,6 +92,29 @@ void vs_plane_stats_1_float_c(union vs_plane_stats *stats, const void *src, ptrd
     stats->f.acc = facc;
 }
 
+void vs_plane_stats_1_half_c(union vs_plane_stats *stats, const void *src, ptrdiff_t stride, unsigned width, unsigned height)
+{
+    const uint8_t *srcp = src;
+    unsigned x, y;
+    float fmin = INFINITY;
+    float fmax = -INFINITY;
+    double facc = 0;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            float v = vs_half_to_float(((const uint16_t *)srcp)[x]);
+            fmin = VSMIN(fmin, v);
+            fmax = VSMAX(fmax, v);
+            facc += v;
+        }
+        srcp += stride;
+    }
+
+    stats->f.min = fmin;
+    stats->f.max = fmax;
+    stats->f.acc = facc;
+}
+
 void vs_plane_stats_2_byte_c(union vs_plane_stats *stats, const void *src1, ptrdiff_t src1_stride, const void *src2, ptrdiff_t src2_stride, unsigned width, unsigned height)
 {
     const uint8_t *srcp1 = src1;
@@ -171,4 +195,38 @@ void vs_plane_stats_2_float_c(union vs_plane_stats *stats, const void *src1, ptr
         srcp1 += src1_stride;
         srcp2 += src2_stride;
     }
+
+    stats->f.min = fmin;
+    stats->f.max = fmax;
+    stats->f.acc = facc;
+    stats->f.diffacc = fdiffacc;
+}
+
+void vs_plane_stats_2_half_c(union vs_plane_stats *stats, const void *src1, ptrdiff_t src1_stride, const void *src2, ptrdiff_t src2_stride, unsigned width, unsigned height)
+{
+    const uint8_t *srcp1 = src1;
+    const uint8_t *srcp2 = src2;
+    unsigned x, y;
+    float fmin = INFINITY;
+    float fmax = -INFINITY;
+    double facc = 0;
+    double fdiffacc = 0;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            float v = vs_half_to_float(((const uint16_t *)srcp1)[x]);
+            float t = vs_half_to_float(((const uint16_t *)srcp2)[x]);
+            fmin = VSMIN(fmin, v);
+            fmax = VSMAX(fmax, v);
+            facc += v;
+            fdiffacc += fabsf(v - t);
+        }
+        srcp1 += src1_stride;
+        srcp2 += src2_stride;
+    }
+
+    stats->f.min = fmin;
+    stats->f.max = fmax;
+    stats->f.acc = facc;
+    stats->f.diffacc = fdiffacc;
 }
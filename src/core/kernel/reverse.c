@@ -0,0 +1,69 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#include <string.h>
+#include "reverse.h"
+#include "VSHelper4.h"
+
+#define REVERSE(pixel, T) \
+void vs_reverse_##pixel##_c(const void *src, void *dst, unsigned n) \
+{ \
+    const T * VS_RESTRICT srcp = src; \
+    T * VS_RESTRICT dstp = dst; \
+    unsigned x; \
+\
+    for (x = 0; x < n; x++) \
+        dstp[n - 1 - x] = srcp[x]; \
+}
+
+REVERSE(byte, uint8_t)
+REVERSE(word, uint16_t)
+REVERSE(dword, uint32_t)
+
+#undef REVERSE
+
+void vs_fill_byte_c(void *dst, uint32_t value, size_t n)
+{
+    memset(dst, (uint8_t)value, n);
+}
+
+void vs_fill_word_c(void *dst, uint32_t value, size_t n)
+{
+    uint16_t *dstp = dst;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        dstp[i] = (uint16_t)value;
+}
+
+void vs_fill_dword_c(void *dst, uint32_t value, size_t n)
+{
+    uint32_t *dstp = dst;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        dstp[i] = value;
+}
+
+void vs_copy_stream_c(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, src, n);
+}
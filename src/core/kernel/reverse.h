@@ -0,0 +1,71 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#ifndef REVERSE_H
+#define REVERSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Writes the n samples of src to dst in reverse order. */
+#define DECL_REVERSE(pixel, isa) void vs_reverse_##pixel##_##isa(const void *src, void *dst, unsigned n);
+
+/* Sets n samples of dst to value. */
+#define DECL_FILL(pixel, isa) void vs_fill_##pixel##_##isa(void *dst, uint32_t value, size_t n);
+
+/* Copies n bytes with stores that bypass the cache, only worth it when the copy is much larger than the cache. */
+#define DECL_COPY_STREAM(isa) void vs_copy_stream_##isa(void *dst, const void *src, size_t n);
+
+DECL_REVERSE(byte, c)
+DECL_REVERSE(word, c)
+DECL_REVERSE(dword, c)
+
+DECL_FILL(byte, c)
+DECL_FILL(word, c)
+DECL_FILL(dword, c)
+
+DECL_COPY_STREAM(c)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_REVERSE(byte, sse2)
+DECL_REVERSE(word, sse2)
+DECL_REVERSE(dword, sse2)
+
+DECL_FILL(byte, sse2)
+DECL_FILL(word, sse2)
+DECL_FILL(dword, sse2)
+
+DECL_COPY_STREAM(sse2)
+#endif
+
+#undef DECL_COPY_STREAM
+#undef DECL_FILL
+#undef DECL_REVERSE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REVERSE_H
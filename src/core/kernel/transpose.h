@@ -37,6 +37,10 @@ void vs_transpose_plane_dword_c(const void * VS_RESTRICT src, ptrdiff_t src_stri
 void vs_transpose_plane_byte_sse2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height);
 void vs_transpose_plane_word_sse2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height);
 void vs_transpose_plane_dword_sse2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height);
+
+void vs_transpose_plane_byte_avx2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height);
+void vs_transpose_plane_word_avx2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height);
+void vs_transpose_plane_dword_avx2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height);
 #endif
 
 /* Implementation details. */
@@ -138,9 +142,9 @@ static void transpose_plane_dword(const void * VS_RESTRICT src, ptrdiff_t src_st
     const uint32_t *src_p = src;
     uint32_t *dst_p = dst;
 
-    unsigned width_floor = width - width % BLOCK_WIDTH_BYTE;
-    unsigned height_floor = height - height % CACHELINE_SIZE_BYTE;
-    unsigned height_floor2 = height - height % BLOCK_HEIGHT_BYTE;
+    unsigned width_floor = width - width % BLOCK_WIDTH_DWORD;
+    unsigned height_floor = height - height % CACHELINE_SIZE_DWORD;
+    unsigned height_floor2 = height - height % BLOCK_HEIGHT_DWORD;
     unsigned i, j, ii;
 
     for (i = 0; i < height_floor; i += CACHELINE_SIZE_DWORD) {
@@ -0,0 +1,201 @@
+/*
+* Copyright (c) 2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <stdint.h>
+#include <immintrin.h>
+#include "../audio.h"
+
+static int16_t to_int16(double x)
+{
+    return x < INT16_MIN ? INT16_MIN : x > INT16_MAX ? INT16_MAX : (int16_t)x;
+}
+
+static int32_t to_int32(double x)
+{
+    return x < INT32_MIN ? INT32_MIN : x > INT32_MAX ? INT32_MAX : (int32_t)x;
+}
+
+static float to_float(double x)
+{
+    return (float)x;
+}
+
+// Loads 8 samples as 4 + 4 doubles.
+static void load8_int16(const void *p, __m256d *lo, __m256d *hi)
+{
+    __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p));
+    *lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(x));
+    *hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1));
+}
+
+static void load8_int32(const void *p, __m256d *lo, __m256d *hi)
+{
+    __m256i x = _mm256_loadu_si256((const __m256i *)p);
+    *lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(x));
+    *hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1));
+}
+
+static void load8_float(const void *p, __m256d *lo, __m256d *hi)
+{
+    __m256 x = _mm256_loadu_ps((const float *)p);
+    *lo = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+    *hi = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+}
+
+static void store8_int16(void *p, __m256d lo, __m256d hi)
+{
+    __m256d minval = _mm256_set1_pd(INT16_MIN);
+    __m256d maxval = _mm256_set1_pd(INT16_MAX);
+
+    lo = _mm256_min_pd(_mm256_max_pd(lo, minval), maxval);
+    hi = _mm256_min_pd(_mm256_max_pd(hi, minval), maxval);
+    _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(_mm256_cvttpd_epi32(lo), _mm256_cvttpd_epi32(hi)));
+}
+
+static void store8_int32(void *p, __m256d lo, __m256d hi)
+{
+    __m256d minval = _mm256_set1_pd(INT32_MIN);
+    __m256d maxval = _mm256_set1_pd(INT32_MAX);
+
+    lo = _mm256_min_pd(_mm256_max_pd(lo, minval), maxval);
+    hi = _mm256_min_pd(_mm256_max_pd(hi, minval), maxval);
+    _mm_storeu_si128((__m128i *)p + 0, _mm256_cvttpd_epi32(lo));
+    _mm_storeu_si128((__m128i *)p + 1, _mm256_cvttpd_epi32(hi));
+}
+
+static void store8_float(void *p, __m256d lo, __m256d hi)
+{
+    _mm_storeu_ps((float *)p + 0, _mm256_cvtpd_ps(lo));
+    _mm_storeu_ps((float *)p + 4, _mm256_cvtpd_ps(hi));
+}
+
+// Multiplies and adds are kept separate so the sums match the C version.
+#define AUDIO_KERNELS(sample, T) \
+void vs_audio_gain_##sample##_avx2(const void *src, void *dst, double gain, size_t length) \
+{ \
+    const T *srcp = src; \
+    T *dstp = dst; \
+    size_t vec_end = length & ~(size_t)7; \
+    size_t i; \
+\
+    __m256d g = _mm256_set1_pd(gain); \
+\
+    for (i = 0; i < vec_end; i += 8) { \
+        __m256d lo, hi; \
+        load8_##sample(srcp + i, &lo, &hi); \
+        store8_##sample(dstp + i, _mm256_mul_pd(lo, g), _mm256_mul_pd(hi, g)); \
+    } \
+    for (i = vec_end; i < length; i++) \
+        dstp[i] = to_##sample(srcp[i] * gain); \
+} \
+\
+void vs_audio_mix_##sample##_avx2(const void * const *srcs, const double *weights, unsigned num_srcs, void *dst, size_t length) \
+{ \
+    T *dstp = dst; \
+    size_t vec_end = length & ~(size_t)7; \
+    size_t i; \
+    unsigned k; \
+\
+    for (i = 0; i < vec_end; i += 8) { \
+        __m256d acc_lo = _mm256_setzero_pd(); \
+        __m256d acc_hi = _mm256_setzero_pd(); \
+\
+        for (k = 0; k < num_srcs; k++) { \
+            __m256d w = _mm256_set1_pd(weights[k]); \
+            __m256d lo, hi; \
+            load8_##sample((const T *)srcs[k] + i, &lo, &hi); \
+            acc_lo = _mm256_add_pd(acc_lo, _mm256_mul_pd(lo, w)); \
+            acc_hi = _mm256_add_pd(acc_hi, _mm256_mul_pd(hi, w)); \
+        } \
+        store8_##sample(dstp + i, acc_lo, acc_hi); \
+    } \
+    for (i = vec_end; i < length; i++) { \
+        double tmp = 0; \
+        for (k = 0; k < num_srcs; k++) \
+            tmp += ((const T *)srcs[k])[i] * weights[k]; \
+        dstp[i] = to_##sample(tmp); \
+    } \
+}
+
+AUDIO_KERNELS(int16, int16_t)
+AUDIO_KERNELS(int32, int32_t)
+AUDIO_KERNELS(float, float)
+
+#undef AUDIO_KERNELS
+
+static float hsum_ps(__m256 x)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+static size_t resample_row(unsigned phase, unsigned table_phases, unsigned num_phases)
+{
+    if (table_phases == num_phases)
+        return phase;
+    return (size_t)(((uint64_t)phase * table_phases + num_phases / 2) / num_phases);
+}
+
+// Up to 4 channels are filtered together so every coefficient load is shared.
+static inline void resample_batch(const float * const *srcs, float * const *dsts, unsigned num_channels, size_t length, const float *coeffs, unsigned taps, unsigned table_phases, unsigned phase, unsigned num_phases, unsigned step)
+{
+    unsigned step_int = step / num_phases;
+    unsigned step_frac = step % num_phases;
+    size_t pos = 0;
+    size_t i;
+    unsigned c, k;
+
+    for (i = 0; i < length; i++) {
+        const float *w = coeffs + resample_row(phase, table_phases, num_phases) * taps;
+        __m256 acc[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+
+        for (k = 0; k < taps; k += 8) {
+            __m256 coeff = _mm256_loadu_ps(w + k);
+
+            for (c = 0; c < num_channels; c++)
+                acc[c] = _mm256_fmadd_ps(_mm256_loadu_ps(srcs[c] + pos + k), coeff, acc[c]);
+        }
+        for (c = 0; c < num_channels; c++)
+            dsts[c][i] = hsum_ps(acc[c]);
+
+        pos += step_int;
+        phase += step_frac;
+        if (phase >= num_phases) {
+            phase -= num_phases;
+            pos++;
+        }
+    }
+}
+
+void vs_audio_resample_avx2(const float * const *srcs, float * const *dsts, unsigned num_channels, size_t length, const float *coeffs, unsigned taps, unsigned table_phases, unsigned phase, unsigned num_phases, unsigned step)
+{
+    unsigned c;
+
+    for (c = 0; c + 4 <= num_channels; c += 4)
+        resample_batch(srcs + c, dsts + c, 4, length, coeffs, taps, table_phases, phase, num_phases, step);
+
+    switch (num_channels - c) {
+    case 3: resample_batch(srcs + c, dsts + c, 3, length, coeffs, taps, table_phases, phase, num_phases, step); break;
+    case 2: resample_batch(srcs + c, dsts + c, 2, length, coeffs, taps, table_phases, phase, num_phases, step); break;
+    case 1: resample_batch(srcs + c, dsts + c, 1, length, coeffs, taps, table_phases, phase, num_phases, step); break;
+    }
+}
@@ -0,0 +1,141 @@
+/*
+* Copyright (c) 2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <stdint.h>
+#include <emmintrin.h>
+#include "../audio.h"
+
+static int16_t to_int16(double x)
+{
+    return x < INT16_MIN ? INT16_MIN : x > INT16_MAX ? INT16_MAX : (int16_t)x;
+}
+
+static int32_t to_int32(double x)
+{
+    return x < INT32_MIN ? INT32_MIN : x > INT32_MAX ? INT32_MAX : (int32_t)x;
+}
+
+static float to_float(double x)
+{
+    return (float)x;
+}
+
+// Loads 4 samples as 2 + 2 doubles.
+static void load4_int16(const void *p, __m128d *lo, __m128d *hi)
+{
+    __m128i x = _mm_loadl_epi64((const __m128i *)p);
+    x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    *lo = _mm_cvtepi32_pd(x);
+    *hi = _mm_cvtepi32_pd(_mm_srli_si128(x, 8));
+}
+
+static void load4_int32(const void *p, __m128d *lo, __m128d *hi)
+{
+    __m128i x = _mm_loadu_si128((const __m128i *)p);
+    *lo = _mm_cvtepi32_pd(x);
+    *hi = _mm_cvtepi32_pd(_mm_srli_si128(x, 8));
+}
+
+static void load4_float(const void *p, __m128d *lo, __m128d *hi)
+{
+    __m128 x = _mm_loadu_ps((const float *)p);
+    *lo = _mm_cvtps_pd(x);
+    *hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+}
+
+static void store4_int16(void *p, __m128d lo, __m128d hi)
+{
+    __m128d minval = _mm_set1_pd(INT16_MIN);
+    __m128d maxval = _mm_set1_pd(INT16_MAX);
+    __m128i x;
+
+    lo = _mm_min_pd(_mm_max_pd(lo, minval), maxval);
+    hi = _mm_min_pd(_mm_max_pd(hi, minval), maxval);
+    x = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+    _mm_storel_epi64((__m128i *)p, _mm_packs_epi32(x, x));
+}
+
+static void store4_int32(void *p, __m128d lo, __m128d hi)
+{
+    __m128d minval = _mm_set1_pd(INT32_MIN);
+    __m128d maxval = _mm_set1_pd(INT32_MAX);
+
+    lo = _mm_min_pd(_mm_max_pd(lo, minval), maxval);
+    hi = _mm_min_pd(_mm_max_pd(hi, minval), maxval);
+    _mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi)));
+}
+
+static void store4_float(void *p, __m128d lo, __m128d hi)
+{
+    _mm_storeu_ps((float *)p, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+}
+
+#define AUDIO_KERNELS(sample, T) \
+void vs_audio_gain_##sample##_sse2(const void *src, void *dst, double gain, size_t length) \
+{ \
+    const T *srcp = src; \
+    T *dstp = dst; \
+    size_t vec_end = length & ~(size_t)3; \
+    size_t i; \
+\
+    __m128d g = _mm_set1_pd(gain); \
+\
+    for (i = 0; i < vec_end; i += 4) { \
+        __m128d lo, hi; \
+        load4_##sample(srcp + i, &lo, &hi); \
+        store4_##sample(dstp + i, _mm_mul_pd(lo, g), _mm_mul_pd(hi, g)); \
+    } \
+    for (i = vec_end; i < length; i++) \
+        dstp[i] = to_##sample(srcp[i] * gain); \
+} \
+\
+void vs_audio_mix_##sample##_sse2(const void * const *srcs, const double *weights, unsigned num_srcs, void *dst, size_t length) \
+{ \
+    T *dstp = dst; \
+    size_t vec_end = length & ~(size_t)3; \
+    size_t i; \
+    unsigned k; \
+\
+    for (i = 0; i < vec_end; i += 4) { \
+        __m128d acc_lo = _mm_setzero_pd(); \
+        __m128d acc_hi = _mm_setzero_pd(); \
+\
+        for (k = 0; k < num_srcs; k++) { \
+            __m128d w = _mm_set1_pd(weights[k]); \
+            __m128d lo, hi; \
+            load4_##sample((const T *)srcs[k] + i, &lo, &hi); \
+            acc_lo = _mm_add_pd(acc_lo, _mm_mul_pd(lo, w)); \
+            acc_hi = _mm_add_pd(acc_hi, _mm_mul_pd(hi, w)); \
+        } \
+        store4_##sample(dstp + i, acc_lo, acc_hi); \
+    } \
+    for (i = vec_end; i < length; i++) { \
+        double tmp = 0; \
+        for (k = 0; k < num_srcs; k++) \
+            tmp += ((const T *)srcs[k])[i] * weights[k]; \
+        dstp[i] = to_##sample(tmp); \
+    } \
+}
+
+AUDIO_KERNELS(int16, int16_t)
+AUDIO_KERNELS(int32, int32_t)
+AUDIO_KERNELS(float, float)
+
+#undef AUDIO_KERNELS
@@ -0,0 +1,187 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <immintrin.h>
+#define VS_BOXBLUR_IMPL
+#include "../boxblur.h"
+#include "VSHelper4.h"
+
+#define ROW(p, stride, y) ((const void *)((const uint8_t *)(p) + (ptrdiff_t)(y) * (stride)))
+
+static __m256i mulhi_epu32(__m256i x, __m256i m)
+{
+    __m256i lo = _mm256_srli_epi64(_mm256_mul_epu32(x, m), 32);
+    __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m);
+    return _mm256_blend_epi32(lo, hi, 0xAA);
+}
+
+static __m256i div_epu32(__m256i x, __m256i magic, __m128i shift)
+{
+    __m256i q = mulhi_epu32(x, magic);
+    return _mm256_srl_epi32(_mm256_add_epi32(_mm256_srli_epi32(_mm256_sub_epi32(x, q), 1), q), shift);
+}
+
+static void init_acc_byte(uint32_t *acc, const void *src, ptrdiff_t src_stride, unsigned width, unsigned height, unsigned radius)
+{
+    unsigned x, y;
+
+    for (x = 0; x < width; x++)
+        acc[x] = radius * ((const uint8_t *)src)[x];
+    for (y = 0; y < radius; y++) {
+        const uint8_t *srcp = ROW(src, src_stride, VSMIN(y, height - 1));
+        for (x = 0; x < width; x++)
+            acc[x] += srcp[x];
+    }
+}
+
+static void init_acc_word(uint32_t *acc, const void *src, ptrdiff_t src_stride, unsigned width, unsigned height, unsigned radius)
+{
+    unsigned x, y;
+
+    for (x = 0; x < width; x++)
+        acc[x] = radius * ((const uint16_t *)src)[x];
+    for (y = 0; y < radius; y++) {
+        const uint16_t *srcp = ROW(src, src_stride, VSMIN(y, height - 1));
+        for (x = 0; x < width; x++)
+            acc[x] += srcp[x];
+    }
+}
+
+static void init_acc_float(float *acc, const void *src, ptrdiff_t src_stride, unsigned width, unsigned height, unsigned radius)
+{
+    unsigned x, y;
+
+    for (x = 0; x < width; x++)
+        acc[x] = radius * ((const float *)src)[x];
+    for (y = 0; y < radius; y++) {
+        const float *srcp = ROW(src, src_stride, VSMIN(y, height - 1));
+        for (x = 0; x < width; x++)
+            acc[x] += srcp[x];
+    }
+}
+
+void vs_boxblur_v_byte_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round)
+{
+    uint32_t *accp = acc;
+    struct vs_boxblur_div div = vs_boxblur_div_init(radius * 2 + 1);
+    unsigned vec_end = width & ~15;
+    unsigned x, y;
+
+    __m256i magic = _mm256_set1_epi32(div.magic);
+    __m128i shift = _mm_cvtsi32_si128(div.shift);
+    __m256i rnd = _mm256_set1_epi32(round);
+
+    init_acc_byte(accp, src, src_stride, width, height, radius);
+
+    for (y = 0; y < height; y++) {
+        const uint8_t *addp = ROW(src, src_stride, VSMIN(y + radius, height - 1));
+        const uint8_t *subp = ROW(src, src_stride, y > radius ? y - radius : 0);
+        uint8_t *dstp = (uint8_t *)dst + (ptrdiff_t)y * dst_stride;
+
+        for (x = 0; x < vec_end; x += 16) {
+            __m256i a0 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(accp + x + 0)), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(addp + x + 0))));
+            __m256i a1 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(accp + x + 8)), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(addp + x + 8))));
+            __m256i q0 = div_epu32(_mm256_add_epi32(a0, rnd), magic, shift);
+            __m256i q1 = div_epu32(_mm256_add_epi32(a1, rnd), magic, shift);
+            __m256i q = _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q1), _MM_SHUFFLE(3, 1, 2, 0));
+
+            _mm_storeu_si128((__m128i *)(dstp + x), _mm_packus_epi16(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1)));
+
+            _mm256_storeu_si256((__m256i *)(accp + x + 0), _mm256_sub_epi32(a0, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(subp + x + 0)))));
+            _mm256_storeu_si256((__m256i *)(accp + x + 8), _mm256_sub_epi32(a1, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(subp + x + 8)))));
+        }
+        for (x = vec_end; x < width; x++) {
+            uint32_t a = accp[x] + addp[x];
+            dstp[x] = (uint8_t)vs_boxblur_div_apply(a + round, div);
+            accp[x] = a - subp[x];
+        }
+    }
+}
+
+void vs_boxblur_v_word_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round)
+{
+    uint32_t *accp = acc;
+    struct vs_boxblur_div div = vs_boxblur_div_init(radius * 2 + 1);
+    unsigned vec_end = width & ~15;
+    unsigned x, y;
+
+    __m256i magic = _mm256_set1_epi32(div.magic);
+    __m128i shift = _mm_cvtsi32_si128(div.shift);
+    __m256i rnd = _mm256_set1_epi32(round);
+
+    init_acc_word(accp, src, src_stride, width, height, radius);
+
+    for (y = 0; y < height; y++) {
+        const uint16_t *addp = ROW(src, src_stride, VSMIN(y + radius, height - 1));
+        const uint16_t *subp = ROW(src, src_stride, y > radius ? y - radius : 0);
+        uint16_t *dstp = (uint16_t *)((uint8_t *)dst + (ptrdiff_t)y * dst_stride);
+
+        for (x = 0; x < vec_end; x += 16) {
+            __m256i a0 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(accp + x + 0)), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(addp + x + 0))));
+            __m256i a1 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(accp + x + 8)), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(addp + x + 8))));
+            __m256i q0 = div_epu32(_mm256_add_epi32(a0, rnd), magic, shift);
+            __m256i q1 = div_epu32(_mm256_add_epi32(a1, rnd), magic, shift);
+
+            _mm256_storeu_si256((__m256i *)(dstp + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(q0, q1), _MM_SHUFFLE(3, 1, 2, 0)));
+
+            _mm256_storeu_si256((__m256i *)(accp + x + 0), _mm256_sub_epi32(a0, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(subp + x + 0)))));
+            _mm256_storeu_si256((__m256i *)(accp + x + 8), _mm256_sub_epi32(a1, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(subp + x + 8)))));
+        }
+        for (x = vec_end; x < width; x++) {
+            uint32_t a = accp[x] + addp[x];
+            dstp[x] = (uint16_t)vs_boxblur_div_apply(a + round, div);
+            accp[x] = a - subp[x];
+        }
+    }
+}
+
+void vs_boxblur_v_float_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round)
+{
+    float *accp = acc;
+    float div = 1.0f / (radius * 2 + 1);
+    unsigned vec_end = width & ~15;
+    unsigned x, y;
+
+    __m256 mdiv = _mm256_set1_ps(div);
+
+    (void)round;
+
+    init_acc_float(accp, src, src_stride, width, height, radius);
+
+    for (y = 0; y < height; y++) {
+        const float *addp = ROW(src, src_stride, VSMIN(y + radius, height - 1));
+        const float *subp = ROW(src, src_stride, y > radius ? y - radius : 0);
+        float *dstp = (float *)((uint8_t *)dst + (ptrdiff_t)y * dst_stride);
+
+        for (x = 0; x < vec_end; x += 16) {
+            __m256 a0 = _mm256_add_ps(_mm256_loadu_ps(accp + x + 0), _mm256_loadu_ps(addp + x + 0));
+            __m256 a1 = _mm256_add_ps(_mm256_loadu_ps(accp + x + 8), _mm256_loadu_ps(addp + x + 8));
+            _mm256_storeu_ps(dstp + x + 0, _mm256_mul_ps(a0, mdiv));
+            _mm256_storeu_ps(dstp + x + 8, _mm256_mul_ps(a1, mdiv));
+            _mm256_storeu_ps(accp + x + 0, _mm256_sub_ps(a0, _mm256_loadu_ps(subp + x + 0)));
+            _mm256_storeu_ps(accp + x + 8, _mm256_sub_ps(a1, _mm256_loadu_ps(subp + x + 8)));
+        }
+        for (x = vec_end; x < width; x++) {
+            float a = accp[x] + addp[x];
+            dstp[x] = a * div;
+            accp[x] = a - subp[x];
+        }
+    }
+}
@@ -0,0 +1,205 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <emmintrin.h>
+#define VS_BOXBLUR_IMPL
+#include "../boxblur.h"
+#include "VSHelper4.h"
+
+#define ROW(p, stride, y) ((const void *)((const uint8_t *)(p) + (ptrdiff_t)(y) * (stride)))
+
+static __m128i mulhi_epu32(__m128i x, __m128i m)
+{
+    __m128i lo = _mm_srli_epi64(_mm_mul_epu32(x, m), 32);
+    __m128i hi = _mm_mul_epu32(_mm_srli_epi64(x, 32), m);
+    return _mm_or_si128(lo, _mm_and_si128(hi, _mm_set_epi32(-1, 0, -1, 0)));
+}
+
+static __m128i div_epu32(__m128i x, __m128i magic, __m128i shift)
+{
+    __m128i q = mulhi_epu32(x, magic);
+    return _mm_srl_epi32(_mm_add_epi32(_mm_srli_epi32(_mm_sub_epi32(x, q), 1), q), shift);
+}
+
+static void init_acc_byte(uint32_t *acc, const void *src, ptrdiff_t src_stride, unsigned width, unsigned height, unsigned radius)
+{
+    unsigned x, y;
+
+    for (x = 0; x < width; x++)
+        acc[x] = radius * ((const uint8_t *)src)[x];
+    for (y = 0; y < radius; y++) {
+        const uint8_t *srcp = ROW(src, src_stride, VSMIN(y, height - 1));
+        for (x = 0; x < width; x++)
+            acc[x] += srcp[x];
+    }
+}
+
+static void init_acc_word(uint32_t *acc, const void *src, ptrdiff_t src_stride, unsigned width, unsigned height, unsigned radius)
+{
+    unsigned x, y;
+
+    for (x = 0; x < width; x++)
+        acc[x] = radius * ((const uint16_t *)src)[x];
+    for (y = 0; y < radius; y++) {
+        const uint16_t *srcp = ROW(src, src_stride, VSMIN(y, height - 1));
+        for (x = 0; x < width; x++)
+            acc[x] += srcp[x];
+    }
+}
+
+static void init_acc_float(float *acc, const void *src, ptrdiff_t src_stride, unsigned width, unsigned height, unsigned radius)
+{
+    unsigned x, y;
+
+    for (x = 0; x < width; x++)
+        acc[x] = radius * ((const float *)src)[x];
+    for (y = 0; y < radius; y++) {
+        const float *srcp = ROW(src, src_stride, VSMIN(y, height - 1));
+        for (x = 0; x < width; x++)
+            acc[x] += srcp[x];
+    }
+}
+
+void vs_boxblur_v_byte_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round)
+{
+    uint32_t *accp = acc;
+    struct vs_boxblur_div div = vs_boxblur_div_init(radius * 2 + 1);
+    unsigned vec_end = width & ~15;
+    unsigned x, y;
+
+    __m128i magic = _mm_set1_epi32(div.magic);
+    __m128i shift = _mm_cvtsi32_si128(div.shift);
+    __m128i rnd = _mm_set1_epi32(round);
+
+    init_acc_byte(accp, src, src_stride, width, height, radius);
+
+    for (y = 0; y < height; y++) {
+        const uint8_t *addp = ROW(src, src_stride, VSMIN(y + radius, height - 1));
+        const uint8_t *subp = ROW(src, src_stride, y > radius ? y - radius : 0);
+        uint8_t *dstp = (uint8_t *)dst + (ptrdiff_t)y * dst_stride;
+
+        for (x = 0; x < vec_end; x += 16) {
+            __m128i addb = _mm_loadu_si128((const __m128i *)(addp + x));
+            __m128i subb = _mm_loadu_si128((const __m128i *)(subp + x));
+            __m128i addw_lo = _mm_unpacklo_epi8(addb, _mm_setzero_si128());
+            __m128i addw_hi = _mm_unpackhi_epi8(addb, _mm_setzero_si128());
+            __m128i subw_lo = _mm_unpacklo_epi8(subb, _mm_setzero_si128());
+            __m128i subw_hi = _mm_unpackhi_epi8(subb, _mm_setzero_si128());
+            __m128i a[4], q[4];
+            int i;
+
+            a[0] = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(accp + x + 0)), _mm_unpacklo_epi16(addw_lo, _mm_setzero_si128()));
+            a[1] = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(accp + x + 4)), _mm_unpackhi_epi16(addw_lo, _mm_setzero_si128()));
+            a[2] = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(accp + x + 8)), _mm_unpacklo_epi16(addw_hi, _mm_setzero_si128()));
+            a[3] = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(accp + x + 12)), _mm_unpackhi_epi16(addw_hi, _mm_setzero_si128()));
+
+            for (i = 0; i < 4; i++)
+                q[i] = div_epu32(_mm_add_epi32(a[i], rnd), magic, shift);
+
+            _mm_storeu_si128((__m128i *)(dstp + x), _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3])));
+
+            _mm_storeu_si128((__m128i *)(accp + x + 0), _mm_sub_epi32(a[0], _mm_unpacklo_epi16(subw_lo, _mm_setzero_si128())));
+            _mm_storeu_si128((__m128i *)(accp + x + 4), _mm_sub_epi32(a[1], _mm_unpackhi_epi16(subw_lo, _mm_setzero_si128())));
+            _mm_storeu_si128((__m128i *)(accp + x + 8), _mm_sub_epi32(a[2], _mm_unpacklo_epi16(subw_hi, _mm_setzero_si128())));
+            _mm_storeu_si128((__m128i *)(accp + x + 12), _mm_sub_epi32(a[3], _mm_unpackhi_epi16(subw_hi, _mm_setzero_si128())));
+        }
+        for (x = vec_end; x < width; x++) {
+            uint32_t a = accp[x] + addp[x];
+            dstp[x] = (uint8_t)vs_boxblur_div_apply(a + round, div);
+            accp[x] = a - subp[x];
+        }
+    }
+}
+
+void vs_boxblur_v_word_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round)
+{
+    uint32_t *accp = acc;
+    struct vs_boxblur_div div = vs_boxblur_div_init(radius * 2 + 1);
+    unsigned vec_end = width & ~7;
+    unsigned x, y;
+
+    __m128i magic = _mm_set1_epi32(div.magic);
+    __m128i shift = _mm_cvtsi32_si128(div.shift);
+    __m128i rnd = _mm_set1_epi32(round);
+
+    init_acc_word(accp, src, src_stride, width, height, radius);
+
+    for (y = 0; y < height; y++) {
+        const uint16_t *addp = ROW(src, src_stride, VSMIN(y + radius, height - 1));
+        const uint16_t *subp = ROW(src, src_stride, y > radius ? y - radius : 0);
+        uint16_t *dstp = (uint16_t *)((uint8_t *)dst + (ptrdiff_t)y * dst_stride);
+
+        for (x = 0; x < vec_end; x += 8) {
+            __m128i addw = _mm_loadu_si128((const __m128i *)(addp + x));
+            __m128i subw = _mm_loadu_si128((const __m128i *)(subp + x));
+            __m128i a_lo = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(accp + x + 0)), _mm_unpacklo_epi16(addw, _mm_setzero_si128()));
+            __m128i a_hi = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(accp + x + 4)), _mm_unpackhi_epi16(addw, _mm_setzero_si128()));
+            __m128i q_lo = div_epu32(_mm_add_epi32(a_lo, rnd), magic, shift);
+            __m128i q_hi = div_epu32(_mm_add_epi32(a_hi, rnd), magic, shift);
+
+            // No unsigned 32 to 16-bit pack in sse2, bias into the signed range instead.
+            q_lo = _mm_sub_epi32(q_lo, _mm_set1_epi32(0x8000));
+            q_hi = _mm_sub_epi32(q_hi, _mm_set1_epi32(0x8000));
+            _mm_storeu_si128((__m128i *)(dstp + x), _mm_add_epi16(_mm_packs_epi32(q_lo, q_hi), _mm_set1_epi16(INT16_MIN)));
+
+            _mm_storeu_si128((__m128i *)(accp + x + 0), _mm_sub_epi32(a_lo, _mm_unpacklo_epi16(subw, _mm_setzero_si128())));
+            _mm_storeu_si128((__m128i *)(accp + x + 4), _mm_sub_epi32(a_hi, _mm_unpackhi_epi16(subw, _mm_setzero_si128())));
+        }
+        for (x = vec_end; x < width; x++) {
+            uint32_t a = accp[x] + addp[x];
+            dstp[x] = (uint16_t)vs_boxblur_div_apply(a + round, div);
+            accp[x] = a - subp[x];
+        }
+    }
+}
+
+void vs_boxblur_v_float_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, void *acc, unsigned width, unsigned height, unsigned radius, unsigned round)
+{
+    float *accp = acc;
+    float div = 1.0f / (radius * 2 + 1);
+    unsigned vec_end = width & ~7;
+    unsigned x, y;
+
+    __m128 mdiv = _mm_set_ps1(div);
+
+    (void)round;
+
+    init_acc_float(accp, src, src_stride, width, height, radius);
+
+    for (y = 0; y < height; y++) {
+        const float *addp = ROW(src, src_stride, VSMIN(y + radius, height - 1));
+        const float *subp = ROW(src, src_stride, y > radius ? y - radius : 0);
+        float *dstp = (float *)((uint8_t *)dst + (ptrdiff_t)y * dst_stride);
+
+        for (x = 0; x < vec_end; x += 8) {
+            __m128 a0 = _mm_add_ps(_mm_loadu_ps(accp + x + 0), _mm_loadu_ps(addp + x + 0));
+            __m128 a1 = _mm_add_ps(_mm_loadu_ps(accp + x + 4), _mm_loadu_ps(addp + x + 4));
+            _mm_storeu_ps(dstp + x + 0, _mm_mul_ps(a0, mdiv));
+            _mm_storeu_ps(dstp + x + 4, _mm_mul_ps(a1, mdiv));
+            _mm_storeu_ps(accp + x + 0, _mm_sub_ps(a0, _mm_loadu_ps(subp + x + 0)));
+            _mm_storeu_ps(accp + x + 4, _mm_sub_ps(a1, _mm_loadu_ps(subp + x + 4)));
+        }
+        for (x = vec_end; x < width; x++) {
+            float a = accp[x] + addp[x];
+            dstp[x] = a * div;
+            accp[x] = a - subp[x];
+        }
+    }
+}
@@ -19,7 +19,11 @@
 */
 
 #include <algorithm>
+#include <cfloat>
+#include <climits>
 #include <cmath>
+#include <type_traits>
+#include <vector>
 #include <immintrin.h>
 #include "../generic.h"
 
@@ -1019,6 +1023,531 @@ void filter_plane_3x3(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_
 #undef INVOKE
 }
 
+unsigned mirror_5(unsigned i, unsigned k, unsigned n)
+{
+    unsigned dist_from_end = n - 1 - i;
+
+    if (k < 2)
+        return i < 2 - k ? std::min(2 - k - i, n - 1) : i - 2 + k;
+    else
+        return dist_from_end < k - 2 ? i - std::min(k - 2 - dist_from_end, i) : i - 2 + k;
+}
+
+FORCE_INLINE __m256i load8_epi32(const uint8_t *ptr) { return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)ptr)); }
+FORCE_INLINE __m256i load8_epi32(const uint16_t *ptr) { return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)ptr)); }
+
+FORCE_INLINE void store8_epi32(uint8_t *ptr, __m256i x)
+{
+    __m128i w = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(x, x), _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm_storel_epi64((__m128i *)ptr, _mm_packus_epi16(w, w));
+}
+
+FORCE_INLINE void store8_epi32(uint16_t *ptr, __m256i x)
+{
+    _mm_storeu_si128((__m128i *)ptr, _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(x, x), _MM_SHUFFLE(3, 1, 2, 0))));
+}
+
+template <class T>
+void conv_row_h_5_sep(const T *srcp, int32_t *dstp, const vs_generic_params &params, unsigned width)
+{
+    __m256i c[5];
+    unsigned vec_end = width >= 4 ? 2 + (width - 4) / 8 * 8 : 0;
+
+    for (unsigned k = 0; k < 5; ++k) {
+        c[k] = _mm256_set1_epi32(params.matrix_h[k]);
+    }
+
+    for (unsigned j = 2; j < vec_end; j += 8) {
+        __m256i accum = _mm256_mullo_epi32(c[0], load8_epi32(srcp + j - 2));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[1], load8_epi32(srcp + j - 1)));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[2], load8_epi32(srcp + j + 0)));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[3], load8_epi32(srcp + j + 1)));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[4], load8_epi32(srcp + j + 2)));
+        _mm256_storeu_si256((__m256i *)(dstp + j), accum);
+    }
+
+    for (unsigned j = 0; j < width; j = (j == 1 && vec_end > 2) ? vec_end : j + 1) {
+        int32_t accum = 0;
+
+        for (unsigned k = 0; k < 5; ++k) {
+            accum += params.matrix_h[k] * static_cast<int32_t>(srcp[mirror_5(j, k, width)]);
+        }
+        dstp[j] = accum;
+    }
+}
+
+void conv_row_h_5_sep(const float *srcp, float *dstp, const vs_generic_params &params, unsigned width)
+{
+    __m256 c[5];
+    unsigned vec_end = width >= 4 ? 2 + (width - 4) / 8 * 8 : 0;
+
+    for (unsigned k = 0; k < 5; ++k) {
+        c[k] = _mm256_set1_ps(params.matrixf_h[k]);
+    }
+
+    for (unsigned j = 2; j < vec_end; j += 8) {
+        __m256 accum = _mm256_mul_ps(c[0], _mm256_loadu_ps(srcp + j - 2));
+        accum = _mm256_fmadd_ps(c[1], _mm256_loadu_ps(srcp + j - 1), accum);
+        accum = _mm256_fmadd_ps(c[2], _mm256_loadu_ps(srcp + j + 0), accum);
+        accum = _mm256_fmadd_ps(c[3], _mm256_loadu_ps(srcp + j + 1), accum);
+        accum = _mm256_fmadd_ps(c[4], _mm256_loadu_ps(srcp + j + 2), accum);
+        _mm256_storeu_ps(dstp + j, accum);
+    }
+
+    for (unsigned j = 0; j < width; j = (j == 1 && vec_end > 2) ? vec_end : j + 1) {
+        float accum = 0;
+
+        for (unsigned k = 0; k < 5; ++k) {
+            accum += params.matrixf_h[k] * srcp[mirror_5(j, k, width)];
+        }
+        dstp[j] = accum;
+    }
+}
+
+template <class T>
+void conv_row_v_5_sep(const int32_t * const *rows, T *dstp, const vs_generic_params &params, unsigned width)
+{
+    __m256i c[5];
+    __m256 div = _mm256_set1_ps(params.div);
+    __m256 bias = _mm256_set1_ps(params.bias);
+    __m256 saturate_mask = _mm256_castsi256_ps(_mm256_set1_epi32(params.saturate ? 0xFFFFFFFF : 0x7FFFFFFF));
+    __m256 maxval = _mm256_set1_ps(params.maxval);
+    unsigned vec_end = width & ~7U;
+
+    for (unsigned k = 0; k < 5; ++k) {
+        c[k] = _mm256_set1_epi32(params.matrix_v[k]);
+    }
+
+    for (unsigned j = 0; j < vec_end; j += 8) {
+        __m256i accum = _mm256_mullo_epi32(c[0], _mm256_loadu_si256((const __m256i *)(rows[0] + j)));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[1], _mm256_loadu_si256((const __m256i *)(rows[1] + j))));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[2], _mm256_loadu_si256((const __m256i *)(rows[2] + j))));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[3], _mm256_loadu_si256((const __m256i *)(rows[3] + j))));
+        accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(c[4], _mm256_loadu_si256((const __m256i *)(rows[4] + j))));
+
+        __m256 tmp = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(accum), div), bias);
+        tmp = _mm256_and_ps(tmp, saturate_mask);
+        tmp = _mm256_min_ps(_mm256_max_ps(tmp, _mm256_setzero_ps()), maxval);
+        store8_epi32(dstp + j, _mm256_cvtps_epi32(tmp));
+    }
+
+    for (unsigned j = vec_end; j < width; ++j) {
+        int32_t accum = 0;
+
+        for (unsigned k = 0; k < 5; ++k) {
+            accum += params.matrix_v[k] * rows[k][j];
+        }
+
+        float tmp = static_cast<float>(accum) * params.div + params.bias;
+        tmp = params.saturate ? tmp : std::fabs(tmp);
+        dstp[j] = static_cast<T>(std::lrint(std::min(std::max(tmp, 0.0f), static_cast<float>(params.maxval))));
+    }
+}
+
+void conv_row_v_5_sep(const float * const *rows, float *dstp, const vs_generic_params &params, unsigned width)
+{
+    __m256 c[5];
+    __m256 div = _mm256_set1_ps(params.div);
+    __m256 bias = _mm256_set1_ps(params.bias);
+    __m256 saturate_mask = _mm256_castsi256_ps(_mm256_set1_epi32(params.saturate ? 0xFFFFFFFF : 0x7FFFFFFF));
+    unsigned vec_end = width & ~7U;
+
+    for (unsigned k = 0; k < 5; ++k) {
+        c[k] = _mm256_set1_ps(params.matrixf_v[k]);
+    }
+
+    for (unsigned j = 0; j < vec_end; j += 8) {
+        __m256 accum = _mm256_mul_ps(c[0], _mm256_loadu_ps(rows[0] + j));
+        accum = _mm256_fmadd_ps(c[1], _mm256_loadu_ps(rows[1] + j), accum);
+        accum = _mm256_fmadd_ps(c[2], _mm256_loadu_ps(rows[2] + j), accum);
+        accum = _mm256_fmadd_ps(c[3], _mm256_loadu_ps(rows[3] + j), accum);
+        accum = _mm256_fmadd_ps(c[4], _mm256_loadu_ps(rows[4] + j), accum);
+
+        __m256 tmp = _mm256_add_ps(_mm256_mul_ps(accum, div), bias);
+        _mm256_storeu_ps(dstp + j, _mm256_and_ps(tmp, saturate_mask));
+    }
+
+    for (unsigned j = vec_end; j < width; ++j) {
+        float accum = 0;
+
+        for (unsigned k = 0; k < 5; ++k) {
+            accum += params.matrixf_v[k] * rows[k][j];
+        }
+
+        float tmp = accum * params.div + params.bias;
+        dstp[j] = params.saturate ? tmp : std::fabs(tmp);
+    }
+}
+
+// Same ring of horizontally filtered rows as the C version, see there.
+template <class T>
+void conv_plane_5x5_sep(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    typedef typename std::conditional<std::is_integral<T>::value, int32_t, float>::type Accum;
+
+    std::vector<Accum> ring(5 * static_cast<size_t>(width));
+    unsigned ring_row[5] = { UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX };
+
+    for (unsigned i = 0; i < height; ++i) {
+        const Accum *rows[5];
+
+        for (unsigned k = 0; k < 5; ++k) {
+            unsigned r = mirror_5(i, k, height);
+            Accum *tmp = ring.data() + (r % 5) * static_cast<size_t>(width);
+
+            if (ring_row[r % 5] != r) {
+                conv_row_h_5_sep(line_ptr(static_cast<const T *>(src), r, src_stride), tmp, params, width);
+                ring_row[r % 5] = r;
+            }
+            rows[k] = tmp;
+        }
+
+        conv_row_v_5_sep(rows, line_ptr(static_cast<T *>(dst), i, dst_stride), params, width);
+    }
+}
+
+unsigned reflect(int i, unsigned n)
+{
+    if (i < 0)
+        return std::min(static_cast<unsigned>(-i), n - 1);
+    if (i >= static_cast<int>(n))
+        return static_cast<unsigned>(std::max(2 * static_cast<int>(n - 1) - i, 0));
+    return static_cast<unsigned>(i);
+}
+
+FORCE_INLINE __m256 load8_sep(const uint8_t *ptr) { return _mm256_cvtepi32_ps(load8_epi32(ptr)); }
+FORCE_INLINE __m256 load8_sep(const uint16_t *ptr) { return _mm256_cvtepi32_ps(load8_epi32(ptr)); }
+FORCE_INLINE __m256 load8_sep(const float *ptr) { return _mm256_loadu_ps(ptr); }
+
+// Converts n pixels starting at x, which may lie outside the row, to float.
+template <class T>
+void load_row_sep(const T *srcp, float *dstp, int x, unsigned n, unsigned width)
+{
+    unsigned j0 = std::min(n, static_cast<unsigned>(std::max(-x, 0)));
+    unsigned j1 = std::max(j0, std::min(n, static_cast<unsigned>(std::max(static_cast<int>(width) - x, 0))));
+    unsigned j = 0;
+
+    for (; j < j0; ++j)
+        dstp[j] = static_cast<float>(srcp[reflect(x + static_cast<int>(j), width)]);
+    for (; j + 8 <= j1; j += 8)
+        _mm256_storeu_ps(dstp + j, load8_sep(srcp + x + j));
+    for (; j < n; ++j)
+        dstp[j] = static_cast<float>(srcp[reflect(x + static_cast<int>(j), width)]);
+}
+
+template <class T>
+void store_row_sep(T *dstp, const float * const *rows, const __m256 *c, const vs_generic_params &params, unsigned width)
+{
+    __m256 div = _mm256_set1_ps(params.div);
+    __m256 bias = _mm256_set1_ps(params.bias);
+    __m256 saturate_mask = _mm256_castsi256_ps(_mm256_set1_epi32(params.saturate ? 0xFFFFFFFF : 0x7FFFFFFF));
+    __m256 maxval = _mm256_set1_ps(params.maxval);
+    unsigned taps = params.sepsize_v;
+    unsigned vec_end = width & ~7U;
+
+    for (unsigned j = 0; j < vec_end; j += 8) {
+        __m256 accum = _mm256_mul_ps(c[0], _mm256_loadu_ps(rows[0] + j));
+        for (unsigned k = 1; k < taps; ++k)
+            accum = _mm256_fmadd_ps(c[k], _mm256_loadu_ps(rows[k] + j), accum);
+
+        __m256 tmp = _mm256_and_ps(_mm256_add_ps(_mm256_mul_ps(accum, div), bias), saturate_mask);
+        tmp = _mm256_min_ps(_mm256_max_ps(tmp, _mm256_setzero_ps()), maxval);
+        store8_epi32(dstp + j, _mm256_cvtps_epi32(tmp));
+    }
+
+    for (unsigned j = vec_end; j < width; ++j) {
+        float accum = 0;
+
+        for (unsigned k = 0; k < taps; ++k)
+            accum += params.sepf_v[k] * rows[k][j];
+
+        float tmp = accum * params.div + params.bias;
+        tmp = params.saturate ? tmp : std::fabs(tmp);
+        dstp[j] = static_cast<T>(std::lrint(std::min(std::max(tmp, 0.0f), static_cast<float>(params.maxval))));
+    }
+}
+
+void store_row_sep(float *dstp, const float * const *rows, const __m256 *c, const vs_generic_params &params, unsigned width)
+{
+    __m256 div = _mm256_set1_ps(params.div);
+    __m256 bias = _mm256_set1_ps(params.bias);
+    __m256 saturate_mask = _mm256_castsi256_ps(_mm256_set1_epi32(params.saturate ? 0xFFFFFFFF : 0x7FFFFFFF));
+    unsigned taps = params.sepsize_v;
+    unsigned vec_end = width & ~7U;
+
+    for (unsigned j = 0; j < vec_end; j += 8) {
+        __m256 accum = _mm256_mul_ps(c[0], _mm256_loadu_ps(rows[0] + j));
+        for (unsigned k = 1; k < taps; ++k)
+            accum = _mm256_fmadd_ps(c[k], _mm256_loadu_ps(rows[k] + j), accum);
+
+        __m256 tmp = _mm256_add_ps(_mm256_mul_ps(accum, div), bias);
+        _mm256_storeu_ps(dstp + j, _mm256_and_ps(tmp, saturate_mask));
+    }
+
+    for (unsigned j = vec_end; j < width; ++j) {
+        float accum = 0;
+
+        for (unsigned k = 0; k < taps; ++k)
+            accum += params.sepf_v[k] * rows[k][j];
+
+        float tmp = accum * params.div + params.bias;
+        dstp[j] = params.saturate ? tmp : std::fabs(tmp);
+    }
+}
+
+// Same column tiles and ring of horizontally filtered rows as the C version, see there. The buffers are padded to
+// whole vectors so the horizontal pass never needs a scalar tail.
+template <class T>
+void conv_plane_sep(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    unsigned taps_h = params.sepsize_h;
+    unsigned taps_v = params.sepsize_v;
+    unsigned support_h = taps_h / 2;
+    unsigned support_v = taps_v / 2;
+    unsigned tile = std::min(width, std::max(64U, 32768 / (taps_v * 4) & ~15U));
+    unsigned tile_pad = (tile + 7) & ~7U;
+
+    __m256 c_h[65];
+    __m256 c_v[65];
+    for (unsigned m = 0; m < taps_h; ++m)
+        c_h[m] = _mm256_set1_ps(params.sepf_h[m]);
+    for (unsigned k = 0; k < taps_v; ++k)
+        c_v[k] = _mm256_set1_ps(params.sepf_v[k]);
+
+    std::vector<float> row(tile_pad + 2 * support_h);
+    std::vector<float> ring(static_cast<size_t>(taps_v) * tile_pad);
+    std::vector<unsigned> ring_row(taps_v);
+
+    for (unsigned x0 = 0; x0 < width; x0 += tile) {
+        unsigned w = std::min(tile, width - x0);
+
+        std::fill(ring_row.begin(), ring_row.end(), UINT_MAX);
+
+        for (unsigned i = 0; i < height; ++i) {
+            const float *rows[65];
+
+            for (unsigned k = 0; k < taps_v; ++k) {
+                unsigned r = reflect(static_cast<int>(i + k) - static_cast<int>(support_v), height);
+                float *tmp = ring.data() + (r % taps_v) * static_cast<size_t>(tile_pad);
+
+                if (ring_row[r % taps_v] != r) {
+                    load_row_sep(line_ptr(static_cast<const T *>(src), r, src_stride), row.data(), static_cast<int>(x0) - static_cast<int>(support_h), w + 2 * support_h, width);
+
+                    for (unsigned j = 0; j < w; j += 8) {
+                        __m256 accum = _mm256_mul_ps(c_h[0], _mm256_loadu_ps(row.data() + j));
+                        for (unsigned m = 1; m < taps_h; ++m)
+                            accum = _mm256_fmadd_ps(c_h[m], _mm256_loadu_ps(row.data() + j + m), accum);
+                        _mm256_storeu_ps(tmp + j, accum);
+                    }
+                    ring_row[r % taps_v] = r;
+                }
+                rows[k] = tmp;
+            }
+
+            store_row_sep(line_ptr(static_cast<T *>(dst), i, dst_stride) + x0, rows, c_v, params, w);
+        }
+    }
+}
+
+struct InvertByte : ByteTraits {
+    __m256i maxval;
+
+    explicit InvertByte(const vs_generic_params &params) : maxval{ _mm256_set1_epi8(static_cast<uint8_t>(params.maxval)) } {}
+
+    FORCE_INLINE __m256i op(__m256i x) const { return _mm256_sub_epi8(maxval, _mm256_min_epu8(x, maxval)); }
+};
+
+struct InvertWord : WordTraits {
+    __m256i maxval;
+
+    explicit InvertWord(const vs_generic_params &params) : maxval{ _mm256_set1_epi16(params.maxval) } {}
+
+    FORCE_INLINE __m256i op(__m256i x) const { return _mm256_sub_epi16(maxval, _mm256_min_epu16(x, maxval)); }
+};
+
+struct InvertFloat : FloatTraits {
+    __m256 offset;
+
+    explicit InvertFloat(const vs_generic_params &params) : offset{ _mm256_set1_ps(params.hif) } {}
+
+    FORCE_INLINE __m256 op(__m256 x) const { return _mm256_sub_ps(offset, x); }
+};
+
+struct LimitByte : ByteTraits {
+    __m256i lo;
+    __m256i hi;
+
+    explicit LimitByte(const vs_generic_params &params) : lo{ _mm256_set1_epi8(static_cast<uint8_t>(params.lo)) }, hi{ _mm256_set1_epi8(static_cast<uint8_t>(params.hi)) } {}
+
+    FORCE_INLINE __m256i op(__m256i x) const { return _mm256_min_epu8(_mm256_max_epu8(x, lo), hi); }
+};
+
+struct LimitWord : WordTraits {
+    __m256i lo;
+    __m256i hi;
+
+    explicit LimitWord(const vs_generic_params &params) : lo{ _mm256_set1_epi16(params.lo) }, hi{ _mm256_set1_epi16(params.hi) } {}
+
+    FORCE_INLINE __m256i op(__m256i x) const { return _mm256_min_epu16(_mm256_max_epu16(x, lo), hi); }
+};
+
+struct LimitFloat : FloatTraits {
+    __m256 lo;
+    __m256 hi;
+
+    explicit LimitFloat(const vs_generic_params &params) : lo{ _mm256_set1_ps(params.lof) }, hi{ _mm256_set1_ps(params.hif) } {}
+
+    FORCE_INLINE __m256 op(__m256 x) const { return _mm256_min_ps(_mm256_max_ps(x, lo), hi); }
+};
+
+struct BinarizeByte : ByteTraits {
+    __m256i threshold;
+    __m256i lo;
+    __m256i hi;
+
+    explicit BinarizeByte(const vs_generic_params &params) :
+        threshold{ _mm256_set1_epi8(static_cast<uint8_t>(params.threshold)) },
+        lo{ _mm256_set1_epi8(static_cast<uint8_t>(params.lo)) },
+        hi{ _mm256_set1_epi8(static_cast<uint8_t>(params.hi)) }
+    {}
+
+    FORCE_INLINE __m256i op(__m256i x) const { return _mm256_blendv_epi8(lo, hi, _mm256_cmpeq_epi8(_mm256_max_epu8(x, threshold), x)); }
+};
+
+struct BinarizeWord : WordTraits {
+    __m256i threshold;
+    __m256i lo;
+    __m256i hi;
+
+    explicit BinarizeWord(const vs_generic_params &params) :
+        threshold{ _mm256_set1_epi16(params.threshold) },
+        lo{ _mm256_set1_epi16(params.lo) },
+        hi{ _mm256_set1_epi16(params.hi) }
+    {}
+
+    FORCE_INLINE __m256i op(__m256i x) const { return _mm256_blendv_epi8(lo, hi, _mm256_cmpeq_epi16(_mm256_max_epu16(x, threshold), x)); }
+};
+
+struct BinarizeFloat : FloatTraits {
+    __m256 threshold;
+    __m256 lo;
+    __m256 hi;
+
+    explicit BinarizeFloat(const vs_generic_params &params) : threshold{ _mm256_set1_ps(params.thresholdf) }, lo{ _mm256_set1_ps(params.lof) }, hi{ _mm256_set1_ps(params.hif) } {}
+
+    FORCE_INLINE __m256 op(__m256 x) const { return _mm256_blendv_ps(hi, lo, _mm256_cmp_ps(x, threshold, _CMP_LT_OQ)); }
+};
+
+// log2 of a positive normal number. The mantissa is reduced to [sqrt(0.5), sqrt(2)) and fed to the Cephes logf polynomial.
+FORCE_INLINE __m256 mm256_log2_ps(__m256 x)
+{
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+
+    e = _mm256_sub_epi32(e, _mm256_castps_si256(big));
+    m = _mm256_sub_ps(_mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big), _mm256_set1_ps(1.0f));
+
+    __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.1514610310e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.1676998740e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.2420140846e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.4249322787e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.6668057665e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(2.0000714765e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-2.4999993993e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(3.3333331174e-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+
+    return _mm256_fmadd_ps(_mm256_add_ps(m, y), _mm256_set1_ps(1.44269504f), _mm256_cvtepi32_ps(e));
+}
+
+// 2^x with the Cephes exp2f polynomial on [-0.5, 0.5]. Results flush to zero below 2^-126 and saturate to infinity.
+FORCE_INLINE __m256 mm256_exp2_ps(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-127.0f)), _mm256_set1_ps(128.0f));
+
+    __m256i n = _mm256_cvtps_epi32(x);
+    __m256 f = _mm256_sub_ps(x, _mm256_cvtepi32_ps(n));
+    __m256 p = _mm256_set1_ps(1.535336188319500e-4f);
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.339887440266574e-3f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(9.618437357674640e-3f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(5.550332471162809e-2f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(2.402264791363012e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(6.931472028550421e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23)));
+}
+
+struct LevelsTraits {
+    float min_in;
+    float max_in;
+    float min_out;
+    float range_in;
+    float range_out;
+    float range_scale;
+    float gamma;
+    float pow0;
+
+    explicit LevelsTraits(const vs_generic_params &params) :
+        min_in{ params.min_in },
+        max_in{ params.max_in },
+        min_out{ params.min_out },
+        range_in{ 1.0f / (params.max_in - params.min_in) },
+        range_out{ params.max_out - params.min_out },
+        range_scale{ range_out / (params.max_in - params.min_in) },
+        gamma{ params.gamma },
+        pow0{ std::pow(0.0f, params.gamma) }
+    {}
+};
+
+struct LevelsLinearFloat : LevelsTraits, FloatTraits {
+    using LevelsTraits::LevelsTraits;
+
+    FORCE_INLINE __m256 op(__m256 x) const
+    {
+        __m256 t = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(x, _mm256_set1_ps(max_in)), _mm256_set1_ps(min_in)), _mm256_setzero_ps());
+        return _mm256_fmadd_ps(t, _mm256_set1_ps(range_scale), _mm256_set1_ps(min_out));
+    }
+};
+
+struct LevelsFloat : LevelsTraits, FloatTraits {
+    using LevelsTraits::LevelsTraits;
+
+    FORCE_INLINE __m256 op(__m256 x) const
+    {
+        __m256 t = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(x, _mm256_set1_ps(max_in)), _mm256_set1_ps(min_in)), _mm256_setzero_ps());
+        t = _mm256_mul_ps(t, _mm256_set1_ps(range_in));
+
+        // Zero and denormal inputs take the value of pow(0, gamma) since the log2 above only handles normal numbers.
+        __m256 normal = _mm256_cmp_ps(t, _mm256_set1_ps(FLT_MIN), _CMP_GE_OQ);
+        __m256 p = mm256_exp2_ps(_mm256_mul_ps(mm256_log2_ps(t), _mm256_set1_ps(gamma)));
+        p = _mm256_blendv_ps(_mm256_set1_ps(pow0), p, normal);
+
+        return _mm256_fmadd_ps(p, _mm256_set1_ps(range_out), _mm256_set1_ps(min_out));
+    }
+};
+
+template <class Traits>
+void point_plane(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    typedef typename Traits::T T;
+    Traits traits(params);
+
+    for (unsigned i = 0; i < height; ++i) {
+        const T *srcp = line_ptr(static_cast<const T *>(src), i, src_stride);
+        T *dstp = line_ptr(static_cast<T *>(dst), i, dst_stride);
+
+        for (unsigned j = 0; j < width; j += Traits::vec_len) {
+            Traits::store(dstp + j, traits.op(Traits::load(srcp + j)));
+        }
+    }
+}
+
 } // namespace
 
 
@@ -1237,3 +1766,86 @@ void vs_generic_3x3_conv_float_avx2(const void *src, ptrdiff_t src_stride, void
 {
     filter_plane_3x3<ConvolutionFloat>(src, src_stride, dst, dst_stride, *params, width, height);
 }
+
+void vs_generic_5x5_conv_sep_byte_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_5x5_sep<uint8_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_5x5_conv_sep_word_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_5x5_sep<uint16_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_5x5_conv_sep_float_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_5x5_sep<float>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_byte_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<uint8_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_word_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<uint16_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_float_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<float>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_byte_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_word_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_float_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_byte_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_word_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_float_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_byte_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_word_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_float_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_levels_float_avx2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    if (std::abs(params->gamma - 1.0f) < FLT_EPSILON)
+        point_plane<LevelsLinearFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+    else
+        point_plane<LevelsFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
@@ -0,0 +1,1588 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <vector>
+#include <immintrin.h>
+#include "../generic.h"
+
+#ifdef _MSC_VER
+#define FORCE_INLINE inline __forceinline
+#else
+#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace {
+
+template <class T>
+T *line_ptr(T *ptr, unsigned i, ptrdiff_t stride)
+{
+    return (T *)(((unsigned char *)ptr) + static_cast<ptrdiff_t>(i) * stride);
+}
+
+// Unlike the SSE2 and AVX2 versions nothing is read or written past the end of a row, the edges and the last partial
+// vector of each row are handled with masked loads and stores instead of shifting pixels into place.
+
+struct ByteTraits {
+    typedef uint8_t T;
+    typedef __m512i vec_type;
+    typedef __mmask64 mask_type;
+    static constexpr unsigned vec_len = 64;
+
+    static mask_type mask(unsigned n) { return n >= 64 ? ~static_cast<mask_type>(0) : (static_cast<mask_type>(1) << n) - 1; }
+
+    static __m512i load(const uint8_t *ptr) { return _mm512_load_si512((const void *)ptr); }
+    static __m512i loadu(const uint8_t *ptr) { return _mm512_loadu_si512((const void *)ptr); }
+    static __m512i load_mask(__m512i fill, mask_type m, const uint8_t *ptr) { return _mm512_mask_loadu_epi8(fill, m, ptr); }
+    static __m512i set1(uint8_t x) { return _mm512_set1_epi8(x); }
+    static void store(uint8_t *ptr, __m512i x) { _mm512_store_si512((void *)ptr, x); }
+    static void store_mask(uint8_t *ptr, mask_type m, __m512i x) { _mm512_mask_storeu_epi8(ptr, m, x); }
+};
+
+struct WordTraits {
+    typedef uint16_t T;
+    typedef __m512i vec_type;
+    typedef __mmask32 mask_type;
+    static constexpr unsigned vec_len = 32;
+
+    static mask_type mask(unsigned n) { return n >= 32 ? ~static_cast<mask_type>(0) : (static_cast<mask_type>(1) << n) - 1; }
+
+    static __m512i load(const uint16_t *ptr) { return _mm512_load_si512((const void *)ptr); }
+    static __m512i loadu(const uint16_t *ptr) { return _mm512_loadu_si512((const void *)ptr); }
+    static __m512i load_mask(__m512i fill, mask_type m, const uint16_t *ptr) { return _mm512_mask_loadu_epi16(fill, m, ptr); }
+    static __m512i set1(uint16_t x) { return _mm512_set1_epi16(x); }
+    static void store(uint16_t *ptr, __m512i x) { _mm512_store_si512((void *)ptr, x); }
+    static void store_mask(uint16_t *ptr, mask_type m, __m512i x) { _mm512_mask_storeu_epi16(ptr, m, x); }
+};
+
+struct FloatTraits {
+    typedef float T;
+    typedef __m512 vec_type;
+    typedef __mmask16 mask_type;
+    static constexpr unsigned vec_len = 16;
+
+    static mask_type mask(unsigned n) { return n >= 16 ? static_cast<mask_type>(0xFFFF) : static_cast<mask_type>((1U << n) - 1); }
+
+    static __m512 load(const float *ptr) { return _mm512_load_ps(ptr); }
+    static __m512 loadu(const float *ptr) { return _mm512_loadu_ps(ptr); }
+    static __m512 load_mask(__m512 fill, mask_type m, const float *ptr) { return _mm512_mask_loadu_ps(fill, m, ptr); }
+    static __m512 set1(float x) { return _mm512_set1_ps(x); }
+    static void store(float *ptr, __m512 x) { _mm512_store_ps(ptr, x); }
+    static void store_mask(float *ptr, mask_type m, __m512 x) { _mm512_mask_storeu_ps(ptr, m, x); }
+};
+
+
+// MSVC 32-bit only allows up to 3 vector arguments to be passed by value.
+#define OP_ARGS const vec_type &a00_, const vec_type &a01_, const vec_type &a02_, const vec_type &a10_, const vec_type &a11_, const vec_type &a12_, const vec_type &a20_, const vec_type &a21_, const vec_type &a22_
+#define PROLOGUE() \
+  auto a00 = a00_; auto a01 = a01_; auto a02 = a02_; \
+  auto a10 = a10_; auto a11 = a11_; auto a12 = a12_; \
+  auto a20 = a20_; auto a21 = a21_; auto a22 = a22_;
+
+struct PrewittSobelTraits {
+    float scale;
+
+    explicit PrewittSobelTraits(const vs_generic_params &params) : scale{ params.scale } {}
+};
+
+template <bool Sobel>
+struct PrewittSobelByte : PrewittSobelTraits, ByteTraits {
+    using PrewittSobelTraits::PrewittSobelTraits;
+
+    FORCE_INLINE __m512i op(OP_ARGS)
+    {
+        PROLOGUE();
+        (void)a11;
+
+#define UNPCKLO(x) (_mm512_unpacklo_epi8(x, _mm512_setzero_si512()))
+#define UNPCKHI(x) (_mm512_unpackhi_epi8(x, _mm512_setzero_si512()))
+        __m512i gx_lo = _mm512_sub_epi16(UNPCKLO(a22), UNPCKLO(a00));
+        __m512i gx_hi = _mm512_sub_epi16(UNPCKHI(a22), UNPCKHI(a00));
+        __m512i gy_lo = gx_lo;
+        __m512i gy_hi = gx_hi;
+
+        gx_lo = _mm512_add_epi16(gx_lo, UNPCKLO(a20));
+        gx_lo = _mm512_add_epi16(gx_lo, Sobel ? _mm512_slli_epi16(UNPCKLO(a21), 1) : UNPCKLO(a21));
+        gx_lo = _mm512_sub_epi16(gx_lo, Sobel ? _mm512_slli_epi16(UNPCKLO(a01), 1) : UNPCKLO(a01));
+        gx_lo = _mm512_sub_epi16(gx_lo, UNPCKLO(a02));
+
+        gx_hi = _mm512_add_epi16(gx_hi, UNPCKHI(a20));
+        gx_hi = _mm512_add_epi16(gx_hi, Sobel ? _mm512_slli_epi16(UNPCKHI(a21), 1) : UNPCKHI(a21));
+        gx_hi = _mm512_sub_epi16(gx_hi, Sobel ? _mm512_slli_epi16(UNPCKHI(a01), 1) : UNPCKHI(a01));
+        gx_hi = _mm512_sub_epi16(gx_hi, UNPCKHI(a02));
+
+        gy_lo = _mm512_add_epi16(gy_lo, UNPCKLO(a02));
+        gy_lo = _mm512_add_epi16(gy_lo, Sobel ? _mm512_slli_epi16(UNPCKLO(a12), 1) : UNPCKLO(a12));
+        gy_lo = _mm512_sub_epi16(gy_lo, Sobel ? _mm512_slli_epi16(UNPCKLO(a10), 1) : UNPCKLO(a10));
+        gy_lo = _mm512_sub_epi16(gy_lo, UNPCKLO(a20));
+
+        gy_hi = _mm512_add_epi16(gy_hi, UNPCKHI(a02));
+        gy_hi = _mm512_add_epi16(gy_hi, Sobel ? _mm512_slli_epi16(UNPCKHI(a12), 1) : UNPCKHI(a12));
+        gy_hi = _mm512_sub_epi16(gy_hi, Sobel ? _mm512_slli_epi16(UNPCKHI(a10), 1) : UNPCKHI(a10));
+        gy_hi = _mm512_sub_epi16(gy_hi, UNPCKHI(a20));
+
+        __m512i gxy_lolo = _mm512_unpacklo_epi16(gx_lo, gy_lo);
+        __m512i gxy_lohi = _mm512_unpackhi_epi16(gx_lo, gy_lo);
+        __m512i gxy_hilo = _mm512_unpacklo_epi16(gx_hi, gy_hi);
+        __m512i gxy_hihi = _mm512_unpackhi_epi16(gx_hi, gy_hi);
+        gxy_lolo = _mm512_madd_epi16(gxy_lolo, gxy_lolo);
+        gxy_lohi = _mm512_madd_epi16(gxy_lohi, gxy_lohi);
+        gxy_hilo = _mm512_madd_epi16(gxy_hilo, gxy_hilo);
+        gxy_hihi = _mm512_madd_epi16(gxy_hihi, gxy_hihi);
+
+        __m512 tmpf_lolo = _mm512_sqrt_ps(_mm512_cvtepi32_ps(gxy_lolo));
+        __m512 tmpf_lohi = _mm512_sqrt_ps(_mm512_cvtepi32_ps(gxy_lohi));
+        __m512 tmpf_hilo = _mm512_sqrt_ps(_mm512_cvtepi32_ps(gxy_hilo));
+        __m512 tmpf_hihi = _mm512_sqrt_ps(_mm512_cvtepi32_ps(gxy_hihi));
+        tmpf_lolo = _mm512_mul_ps(tmpf_lolo, _mm512_set1_ps(scale));
+        tmpf_lohi = _mm512_mul_ps(tmpf_lohi, _mm512_set1_ps(scale));
+        tmpf_hilo = _mm512_mul_ps(tmpf_hilo, _mm512_set1_ps(scale));
+        tmpf_hihi = _mm512_mul_ps(tmpf_hihi, _mm512_set1_ps(scale));
+
+        __m512i tmpi_lo = _mm512_packs_epi32(_mm512_cvtps_epi32(tmpf_lolo), _mm512_cvtps_epi32(tmpf_lohi));
+        __m512i tmpi_hi = _mm512_packs_epi32(_mm512_cvtps_epi32(tmpf_hilo), _mm512_cvtps_epi32(tmpf_hihi));
+        return _mm512_packus_epi16(tmpi_lo, tmpi_hi);
+#undef UNPCKHI
+#undef UNPCKLO
+    }
+};
+
+template <bool Sobel>
+struct PrewittSobelWord : PrewittSobelTraits, WordTraits {
+    __m512i maxval;
+
+    explicit PrewittSobelWord(const vs_generic_params &params) :
+        PrewittSobelTraits(params),
+        maxval(_mm512_set1_epi16(params.maxval))
+    {}
+
+    FORCE_INLINE __m512i op(OP_ARGS)
+    {
+        PROLOGUE();
+        (void)a11;
+
+#define UNPCKLO(x) (_mm512_unpacklo_epi16(x, _mm512_setzero_si512()))
+#define UNPCKHI(x) (_mm512_unpackhi_epi16(x, _mm512_setzero_si512()))
+        __m512i gx_lo = _mm512_sub_epi32(UNPCKLO(a22), UNPCKLO(a00));
+        __m512i gx_hi = _mm512_sub_epi32(UNPCKHI(a22), UNPCKHI(a00));
+        __m512i gy_lo = gx_lo;
+        __m512i gy_hi = gx_hi;
+
+        gx_lo = _mm512_add_epi32(gx_lo, UNPCKLO(a20));
+        gx_lo = _mm512_add_epi32(gx_lo, Sobel ? _mm512_slli_epi32(UNPCKLO(a21), 1) : UNPCKLO(a21));
+        gx_lo = _mm512_sub_epi32(gx_lo, Sobel ? _mm512_slli_epi32(UNPCKLO(a01), 1) : UNPCKLO(a01));
+        gx_lo = _mm512_sub_epi32(gx_lo, UNPCKLO(a02));
+
+        gx_hi = _mm512_add_epi32(gx_hi, UNPCKHI(a20));
+        gx_hi = _mm512_add_epi32(gx_hi, Sobel ? _mm512_slli_epi32(UNPCKHI(a21), 1) : UNPCKHI(a21));
+        gx_hi = _mm512_sub_epi32(gx_hi, Sobel ? _mm512_slli_epi32(UNPCKHI(a01), 1) : UNPCKHI(a01));
+        gx_hi = _mm512_sub_epi32(gx_hi, UNPCKHI(a02));
+
+        gy_lo = _mm512_add_epi32(gy_lo, UNPCKLO(a02));
+        gy_lo = _mm512_add_epi32(gy_lo, Sobel ? _mm512_slli_epi32(UNPCKLO(a12), 1) : UNPCKLO(a12));
+        gy_lo = _mm512_sub_epi32(gy_lo, Sobel ? _mm512_slli_epi32(UNPCKLO(a10), 1) : UNPCKLO(a10));
+        gy_lo = _mm512_sub_epi32(gy_lo, UNPCKLO(a20));
+
+        gy_hi = _mm512_add_epi32(gy_hi, UNPCKHI(a02));
+        gy_hi = _mm512_add_epi32(gy_hi, Sobel ? _mm512_slli_epi32(UNPCKHI(a12), 1) : UNPCKHI(a12));
+        gy_hi = _mm512_sub_epi32(gy_hi, Sobel ? _mm512_slli_epi32(UNPCKHI(a10), 1) : UNPCKHI(a10));
+        gy_hi = _mm512_sub_epi32(gy_hi, UNPCKHI(a20));
+
+        __m512 gxsq_lo = _mm512_cvtepi32_ps(gx_lo);
+        __m512 gxsq_hi = _mm512_cvtepi32_ps(gx_hi);
+        __m512 gysq_lo = _mm512_cvtepi32_ps(gy_lo);
+        __m512 gysq_hi = _mm512_cvtepi32_ps(gy_hi);
+        gxsq_lo = _mm512_mul_ps(gxsq_lo, gxsq_lo);
+        gxsq_hi = _mm512_mul_ps(gxsq_hi, gxsq_hi);
+        gysq_lo = _mm512_mul_ps(gysq_lo, gysq_lo);
+        gysq_hi = _mm512_mul_ps(gysq_hi, gysq_hi);
+
+        __m512 gxy_lo = _mm512_add_ps(gxsq_lo, gysq_lo);
+        __m512 gxy_hi = _mm512_add_ps(gxsq_hi, gysq_hi);
+        gxy_lo = _mm512_sqrt_ps(gxy_lo);
+        gxy_lo = _mm512_mul_ps(gxy_lo, _mm512_set1_ps(scale));
+        gxy_hi = _mm512_sqrt_ps(gxy_hi);
+        gxy_hi = _mm512_mul_ps(gxy_hi, _mm512_set1_ps(scale));
+
+        __m512i tmpi_lo = _mm512_cvtps_epi32(gxy_lo);
+        __m512i tmpi_hi = _mm512_cvtps_epi32(gxy_hi);
+        __m512i tmp = _mm512_packus_epi32(tmpi_lo, tmpi_hi);
+        tmp = _mm512_min_epu16(tmp, maxval);
+        return tmp;
+#undef UNPCKHI
+#undef UNPCKLO
+    }
+};
+
+template <bool Sobel>
+struct PrewittSobelFloat : PrewittSobelTraits, FloatTraits {
+    using PrewittSobelTraits::PrewittSobelTraits;
+
+    FORCE_INLINE __m512 op(OP_ARGS)
+    {
+        PROLOGUE();
+        (void)a11;
+
+        __m512 gx = _mm512_sub_ps(a22, a00);
+        __m512 gy = gx;
+
+        gx = _mm512_add_ps(gx, a20);
+        gx = _mm512_add_ps(gx, Sobel ? _mm512_mul_ps(a21, _mm512_set1_ps(2.0f)) : a21);
+        gx = _mm512_sub_ps(gx, Sobel ? _mm512_mul_ps(a01, _mm512_set1_ps(2.0f)) : a01);
+        gx = _mm512_sub_ps(gx, a02);
+
+        gy = _mm512_add_ps(gy, a02);
+        gy = _mm512_add_ps(gy, Sobel ? _mm512_mul_ps(a12, _mm512_set1_ps(2.0f)) : a12);
+        gy = _mm512_sub_ps(gy, Sobel ? _mm512_mul_ps(a10, _mm512_set1_ps(2.0f)) : a10);
+        gy = _mm512_sub_ps(gy, a20);
+
+        gx = _mm512_mul_ps(gx, gx);
+        gy = _mm512_mul_ps(gy, gy);
+
+        __m512 tmp = _mm512_add_ps(gx, gy);
+        tmp = _mm512_sqrt_ps(tmp);
+        tmp = _mm512_mul_ps(tmp, _mm512_set1_ps(scale));
+        return tmp;
+    }
+};
+
+// the stencil is applied with write masks so disabled neighbours simply leave the accumulated value unchanged
+template <class Derived, class mask_type>
+struct MinMaxTraits {
+    mask_type mask00;
+    mask_type mask01;
+    mask_type mask02;
+    mask_type mask10;
+    mask_type mask12;
+    mask_type mask20;
+    mask_type mask21;
+    mask_type mask22;
+
+    static mask_type stencil_mask(const vs_generic_params &params, uint8_t bit) { return (params.stencil & bit) ? static_cast<mask_type>(~static_cast<mask_type>(0)) : 0; }
+
+    explicit MinMaxTraits(const vs_generic_params &params) :
+        mask00(stencil_mask(params, 0x01)),
+        mask01(stencil_mask(params, 0x02)),
+        mask02(stencil_mask(params, 0x04)),
+        mask10(stencil_mask(params, 0x08)),
+        mask12(stencil_mask(params, 0x10)),
+        mask20(stencil_mask(params, 0x20)),
+        mask21(stencil_mask(params, 0x40)),
+        mask22(stencil_mask(params, 0x80))
+    {}
+
+    template <class vec_type>
+    FORCE_INLINE vec_type apply_stencil(OP_ARGS)
+    {
+        PROLOGUE();
+
+        vec_type val = a11;
+        val = Derived::reduce(val, a00, mask00);
+        val = Derived::reduce(val, a01, mask01);
+        val = Derived::reduce(val, a02, mask02);
+        val = Derived::reduce(val, a10, mask10);
+        val = Derived::reduce(val, a12, mask12);
+        val = Derived::reduce(val, a20, mask20);
+        val = Derived::reduce(val, a21, mask21);
+        val = Derived::reduce(val, a22, mask22);
+        return val;
+    }
+};
+
+template <bool Max>
+static __m512i limit_diff_epu8(__m512i val, __m512i orig, __m512i threshold)
+{
+    __m512i limit = Max ? _mm512_adds_epu8(orig, threshold) : _mm512_subs_epu8(orig, threshold);
+    val = Max ? _mm512_min_epu8(val, limit) : _mm512_max_epu8(val, limit);
+    return val;
+}
+
+template <bool Max>
+static __m512i limit_diff_epu16(__m512i val, __m512i orig, __m512i threshold)
+{
+    __m512i limit = Max ? _mm512_adds_epu16(orig, threshold) : _mm512_subs_epu16(orig, threshold);
+    val = Max ? _mm512_min_epu16(val, limit) : _mm512_max_epu16(val, limit);
+    return val;
+}
+
+template <bool Max>
+static __m512 limit_diff_ps(__m512 val, __m512 orig, __m512 threshold)
+{
+    __m512 limit = Max ? _mm512_add_ps(orig, threshold) : _mm512_sub_ps(orig, threshold);
+    val = Max ? _mm512_min_ps(val, limit) : _mm512_max_ps(val, limit);
+    return val;
+}
+
+template <bool Max>
+struct MinMaxByte : MinMaxTraits<MinMaxByte<Max>, __mmask64>, ByteTraits {
+    typedef MinMaxTraits<MinMaxByte<Max>, __mmask64> MinMaxTraitsT;
+    __m512i threshold;
+
+    static FORCE_INLINE __m512i reduce(__m512i lhs, __m512i rhs, __mmask64 mask)
+    {
+        return Max ? _mm512_mask_max_epu8(lhs, mask, lhs, rhs) : _mm512_mask_min_epu8(lhs, mask, lhs, rhs);
+    }
+
+    explicit MinMaxByte(const vs_generic_params &params) :
+        MinMaxTraitsT(params),
+        threshold(_mm512_set1_epi8(static_cast<uint8_t>(std::min(params.threshold, static_cast<uint16_t>(UINT8_MAX)))))
+    {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512i val = MinMaxTraitsT::template apply_stencil<__m512i>(a00, a01, a02, a10, a11, a12, a20, a21, a22);
+        return limit_diff_epu8<Max>(val, a11, threshold);
+    }
+};
+
+template <bool Max>
+struct MinMaxWord : MinMaxTraits<MinMaxWord<Max>, __mmask32>, WordTraits {
+    typedef MinMaxTraits<MinMaxWord<Max>, __mmask32> MinMaxTraitsT;
+    __m512i threshold;
+
+    static FORCE_INLINE __m512i reduce(__m512i lhs, __m512i rhs, __mmask32 mask)
+    {
+        return Max ? _mm512_mask_max_epu16(lhs, mask, lhs, rhs) : _mm512_mask_min_epu16(lhs, mask, lhs, rhs);
+    }
+
+    explicit MinMaxWord(const vs_generic_params &params) :
+        MinMaxTraitsT(params),
+        threshold(_mm512_set1_epi16(params.threshold))
+    {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512i val = MinMaxTraitsT::template apply_stencil<__m512i>(a00, a01, a02, a10, a11, a12, a20, a21, a22);
+        return limit_diff_epu16<Max>(val, a11, threshold);
+    }
+};
+
+template <bool Max>
+struct MinMaxFloat : MinMaxTraits<MinMaxFloat<Max>, __mmask16>, FloatTraits {
+    typedef MinMaxTraits<MinMaxFloat<Max>, __mmask16> MinMaxTraitsT;
+    __m512 threshold;
+
+    static FORCE_INLINE __m512 reduce(__m512 lhs, __m512 rhs, __mmask16 mask)
+    {
+        return Max ? _mm512_mask_max_ps(lhs, mask, lhs, rhs) : _mm512_mask_min_ps(lhs, mask, lhs, rhs);
+    }
+
+    explicit MinMaxFloat(const vs_generic_params &params) :
+        MinMaxTraitsT(params),
+        threshold(_mm512_set1_ps(params.thresholdf))
+    {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512 val = MinMaxTraitsT::template apply_stencil<__m512>(a00, a01, a02, a10, a11, a12, a20, a21, a22);
+        return limit_diff_ps<Max>(val, a11, threshold);
+    }
+};
+
+constexpr uint8_t STENCIL_ALL = 0xFF;
+constexpr uint8_t STENCIL_H = 0x18;
+constexpr uint8_t STENCIL_V = 0x42;
+constexpr uint8_t STENCIL_PLUS = STENCIL_H | STENCIL_V;
+
+template <uint8_t Stencil, class Derived, class vec_type>
+struct MinMaxFixedTraits {
+    static FORCE_INLINE vec_type apply_stencil(OP_ARGS)
+    {
+        PROLOGUE();
+
+        vec_type val = a11;
+        val = (Stencil & 0x01) ? Derived::reduce(val, a00) : val;
+        val = (Stencil & 0x02) ? Derived::reduce(val, a01) : val;
+        val = (Stencil & 0x04) ? Derived::reduce(val, a02) : val;
+        val = (Stencil & 0x08) ? Derived::reduce(val, a10) : val;
+        val = (Stencil & 0x10) ? Derived::reduce(val, a12) : val;
+        val = (Stencil & 0x20) ? Derived::reduce(val, a20) : val;
+        val = (Stencil & 0x40) ? Derived::reduce(val, a21) : val;
+        val = (Stencil & 0x80) ? Derived::reduce(val, a22) : val;
+        return val;
+    }
+};
+
+template <uint8_t Stencil, bool Max>
+struct MinMaxFixedByte : MinMaxFixedTraits<Stencil, MinMaxFixedByte<Stencil, Max>, __m512i>, ByteTraits {
+    typedef MinMaxFixedTraits<Stencil, MinMaxFixedByte, __m512i> MinMaxFixedTraitsT;
+    __m512i threshold;
+
+    static __m512i reduce(__m512i lhs, __m512i rhs)
+    {
+        return Max ? _mm512_max_epu8(lhs, rhs) : _mm512_min_epu8(lhs, rhs);
+    }
+
+    explicit MinMaxFixedByte(const vs_generic_params &params) :
+        threshold(_mm512_set1_epi8(static_cast<uint8_t>(std::min(params.threshold, static_cast<uint16_t>(UINT8_MAX)))))
+    {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512i val = MinMaxFixedTraitsT::apply_stencil(a00, a01, a02, a10, a11, a12, a20, a21, a22);
+        return limit_diff_epu8<Max>(val, a11, threshold);
+    }
+};
+
+template <uint8_t Stencil, bool Max>
+struct MinMaxFixedWord : MinMaxFixedTraits<Stencil, MinMaxFixedWord<Stencil, Max>, __m512i>, WordTraits {
+    typedef MinMaxFixedTraits<Stencil, MinMaxFixedWord, __m512i> MinMaxFixedTraitsT;
+    __m512i threshold;
+
+    static __m512i reduce(__m512i lhs, __m512i rhs)
+    {
+        return Max ? _mm512_max_epu16(lhs, rhs) : _mm512_min_epu16(lhs, rhs);
+    }
+
+    explicit MinMaxFixedWord(const vs_generic_params &params) :
+        threshold(_mm512_set1_epi16(params.threshold))
+    {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512i val = MinMaxFixedTraitsT::apply_stencil(a00, a01, a02, a10, a11, a12, a20, a21, a22);
+        return limit_diff_epu16<Max>(val, a11, threshold);
+    }
+};
+
+template <uint8_t Stencil, bool Max>
+struct MinMaxFixedFloat : MinMaxFixedTraits<Stencil, MinMaxFixedFloat<Stencil, Max>, __m512>, FloatTraits {
+    typedef MinMaxFixedTraits<Stencil, MinMaxFixedFloat<Stencil, Max>, __m512> MinMaxFixedTraitsT;
+    __m512 threshold;
+
+    FORCE_INLINE static __m512 reduce(__m512 lhs, __m512 rhs)
+    {
+        return Max ? _mm512_max_ps(lhs, rhs) : _mm512_min_ps(lhs, rhs);
+    }
+
+    explicit MinMaxFixedFloat(const vs_generic_params &params) : threshold(_mm512_set1_ps(params.thresholdf)) {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512 val = MinMaxFixedTraitsT::apply_stencil(a00, a01, a02, a10, a11, a12, a20, a21, a22);
+        return limit_diff_ps<Max>(val, a11, threshold);
+    }
+};
+
+template <class Derived, class vec_type>
+struct MedianTraits {
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        Derived::compare_exchange(a00, a01);
+        Derived::compare_exchange(a02, a10);
+        Derived::compare_exchange(a12, a20);
+        Derived::compare_exchange(a21, a22);
+
+        Derived::compare_exchange(a00, a02);
+        Derived::compare_exchange(a01, a10);
+        Derived::compare_exchange(a12, a21);
+        Derived::compare_exchange(a20, a22);
+
+        Derived::compare_exchange(a01, a02);
+        Derived::compare_exchange(a20, a21);
+
+        a12 = Derived::max(a00, a12);
+        a20 = Derived::max(a01, a20);
+        a02 = Derived::min(a02, a21);
+        a10 = Derived::min(a10, a22);
+
+        a12 = Derived::max(a02, a12);
+        a10 = Derived::min(a10, a20);
+
+        Derived::compare_exchange(a10, a12);
+
+        a11 = Derived::max(a10, a11);
+        a11 = Derived::min(a11, a12);
+        return a11;
+    }
+};
+
+struct MedianByte : MedianTraits<MedianByte, __m512i>, ByteTraits {
+    static __m512i min(__m512i lhs, __m512i rhs) { return _mm512_min_epu8(lhs, rhs); }
+    static __m512i max(__m512i lhs, __m512i rhs) { return _mm512_max_epu8(lhs, rhs); }
+
+    static FORCE_INLINE void compare_exchange(__m512i &lhs, __m512i &rhs)
+    {
+        __m512i a = lhs;
+        __m512i b = rhs;
+        lhs = _mm512_min_epu8(a, b);
+        rhs = _mm512_max_epu8(a, b);
+    }
+
+    explicit MedianByte(const vs_generic_params &) {}
+};
+
+struct MedianWord : MedianTraits<MedianWord, __m512i>, WordTraits {
+    static __m512i min(__m512i lhs, __m512i rhs) { return _mm512_min_epu16(lhs, rhs); }
+    static __m512i max(__m512i lhs, __m512i rhs) { return _mm512_max_epu16(lhs, rhs); }
+
+    static FORCE_INLINE void compare_exchange(__m512i &lhs, __m512i &rhs)
+    {
+        __m512i a = lhs;
+        __m512i b = rhs;
+        lhs = _mm512_min_epu16(a, b);
+        rhs = _mm512_max_epu16(a, b);
+    }
+
+    explicit MedianWord(const vs_generic_params &) {}
+};
+
+struct MedianFloat : MedianTraits<MedianFloat, __m512>, FloatTraits {
+    static __m512 min(__m512 lhs, __m512 rhs) { return _mm512_min_ps(lhs, rhs); }
+    static __m512 max(__m512 lhs, __m512 rhs) { return _mm512_max_ps(lhs, rhs); }
+
+    static FORCE_INLINE void compare_exchange(__m512 &lhs, __m512 &rhs)
+    {
+        __m512 a = lhs;
+        __m512 b = rhs;
+        lhs = _mm512_min_ps(a, b);
+        rhs = _mm512_max_ps(a, b);
+    }
+
+    explicit MedianFloat(const vs_generic_params &) {}
+};
+
+template <bool Inflate>
+struct DeflateInflateByte : ByteTraits {
+    __m512i threshold;
+
+    explicit DeflateInflateByte(const vs_generic_params &params) :
+        threshold(_mm512_set1_epi8(static_cast<uint8_t>(std::min(params.threshold, static_cast<uint16_t>(UINT8_MAX)))))
+    {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+#define UNPCKLO(x) (_mm512_unpacklo_epi8(x, _mm512_setzero_si512()))
+#define UNPCKHI(x) (_mm512_unpackhi_epi8(x, _mm512_setzero_si512()))
+        __m512i accum_lo = UNPCKLO(a00);
+        __m512i accum_hi = UNPCKHI(a00);
+        accum_lo = _mm512_add_epi16(accum_lo, UNPCKLO(a01));
+        accum_hi = _mm512_add_epi16(accum_hi, UNPCKHI(a01));
+        accum_lo = _mm512_add_epi16(accum_lo, UNPCKLO(a02));
+        accum_hi = _mm512_add_epi16(accum_hi, UNPCKHI(a02));
+        accum_lo = _mm512_add_epi16(accum_lo, UNPCKLO(a10));
+        accum_hi = _mm512_add_epi16(accum_hi, UNPCKHI(a10));
+        accum_lo = _mm512_add_epi16(accum_lo, UNPCKLO(a12));
+        accum_hi = _mm512_add_epi16(accum_hi, UNPCKHI(a12));
+        accum_lo = _mm512_add_epi16(accum_lo, UNPCKLO(a20));
+        accum_hi = _mm512_add_epi16(accum_hi, UNPCKHI(a20));
+        accum_lo = _mm512_add_epi16(accum_lo, UNPCKLO(a21));
+        accum_hi = _mm512_add_epi16(accum_hi, UNPCKHI(a21));
+        accum_lo = _mm512_add_epi16(accum_lo, UNPCKLO(a22));
+        accum_hi = _mm512_add_epi16(accum_hi, UNPCKHI(a22));
+        accum_lo = _mm512_add_epi16(accum_lo, _mm512_set1_epi16(4));
+        accum_hi = _mm512_add_epi16(accum_hi, _mm512_set1_epi16(4));
+
+        accum_lo = _mm512_srli_epi16(accum_lo, 3);
+        accum_hi = _mm512_srli_epi16(accum_hi, 3);
+
+        __m512i tmp = _mm512_packus_epi16(accum_lo, accum_hi);
+        tmp = Inflate ? _mm512_max_epu8(tmp, a11) : _mm512_min_epu8(tmp, a11);
+
+        __m512i limit = Inflate ? _mm512_adds_epu8(a11, threshold) : _mm512_subs_epu8(a11, threshold);
+        tmp = Inflate ? _mm512_min_epu8(tmp, limit) : _mm512_max_epu8(tmp, limit);
+
+        return tmp;
+#undef UNPCKHI
+#undef UNPCKLO
+    }
+};
+
+template <bool Inflate>
+struct DeflateInflateWord : WordTraits {
+    __m512i threshold;
+
+    explicit DeflateInflateWord(const vs_generic_params &params) : threshold(_mm512_set1_epi16(params.threshold)) {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+#define UNPCKLO(x) (_mm512_unpacklo_epi16(x, _mm512_setzero_si512()))
+#define UNPCKHI(x) (_mm512_unpackhi_epi16(x, _mm512_setzero_si512()))
+        __m512i accum_lo = UNPCKLO(a00);
+        __m512i accum_hi = UNPCKHI(a00);
+        accum_lo = _mm512_add_epi32(accum_lo, UNPCKLO(a01));
+        accum_hi = _mm512_add_epi32(accum_hi, UNPCKHI(a01));
+        accum_lo = _mm512_add_epi32(accum_lo, UNPCKLO(a02));
+        accum_hi = _mm512_add_epi32(accum_hi, UNPCKHI(a02));
+        accum_lo = _mm512_add_epi32(accum_lo, UNPCKLO(a10));
+        accum_hi = _mm512_add_epi32(accum_hi, UNPCKHI(a10));
+        accum_lo = _mm512_add_epi32(accum_lo, UNPCKLO(a12));
+        accum_hi = _mm512_add_epi32(accum_hi, UNPCKHI(a12));
+        accum_lo = _mm512_add_epi32(accum_lo, UNPCKLO(a20));
+        accum_hi = _mm512_add_epi32(accum_hi, UNPCKHI(a20));
+        accum_lo = _mm512_add_epi32(accum_lo, UNPCKLO(a21));
+        accum_hi = _mm512_add_epi32(accum_hi, UNPCKHI(a21));
+        accum_lo = _mm512_add_epi32(accum_lo, UNPCKLO(a22));
+        accum_hi = _mm512_add_epi32(accum_hi, UNPCKHI(a22));
+        accum_lo = _mm512_add_epi32(accum_lo, _mm512_set1_epi32(4));
+        accum_hi = _mm512_add_epi32(accum_hi, _mm512_set1_epi32(4));
+
+        accum_lo = _mm512_srli_epi32(accum_lo, 3);
+        accum_hi = _mm512_srli_epi32(accum_hi, 3);
+
+        __m512i tmp = _mm512_packus_epi32(accum_lo, accum_hi);
+        tmp = Inflate ? _mm512_max_epu16(tmp, a11) : _mm512_min_epu16(tmp, a11);
+
+        __m512i limit = Inflate ? _mm512_adds_epu16(a11, threshold) : _mm512_subs_epu16(a11, threshold);
+        tmp = Inflate ? _mm512_min_epu16(tmp, limit) : _mm512_max_epu16(tmp, limit);
+
+        return tmp;
+#undef UNPCKHI
+#undef UNPCKLO
+    }
+};
+
+template <bool Inflate>
+struct DeflateInflateFloat : FloatTraits {
+    __m512 threshold;
+
+    explicit DeflateInflateFloat(const vs_generic_params &params) : threshold(_mm512_set1_ps(params.thresholdf)) {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512 accum0 = _mm512_add_ps(a00, a01);
+        __m512 accum1 = _mm512_add_ps(a02, a10);
+        accum0 = _mm512_add_ps(accum0, a12);
+        accum1 = _mm512_add_ps(accum1, a20);
+        accum0 = _mm512_add_ps(accum0, a21);
+        accum1 = _mm512_add_ps(accum1, a22);
+
+        __m512 tmp = _mm512_add_ps(accum0, accum1);
+        tmp = _mm512_mul_ps(tmp, _mm512_set1_ps(1.0f / 8.0f));
+        tmp = Inflate ? _mm512_max_ps(tmp, a11) : _mm512_min_ps(tmp, a11);
+
+        __m512 limit = Inflate ? _mm512_add_ps(a11, threshold) : _mm512_sub_ps(a11, threshold);
+        tmp = Inflate ? _mm512_min_ps(tmp, limit) : _mm512_max_ps(tmp, limit);
+
+        return tmp;
+    }
+};
+
+struct ConvolutionTraits {
+    __m512 div;
+    __m512 bias;
+    __m512 saturate_mask;
+
+    explicit ConvolutionTraits(const vs_generic_params &params) :
+        div(_mm512_set1_ps(params.div)),
+        bias(_mm512_set1_ps(params.bias)),
+        saturate_mask(_mm512_castsi512_ps(_mm512_set1_epi32(params.saturate ? 0xFFFFFFFF : 0x7FFFFFFF)))
+    {}
+};
+
+struct ConvolutionIntTraits : ConvolutionTraits {
+    __m512i c00_01, c02_10, c11_12, c20_21, c22_xx;
+
+    static uint32_t interleave(int16_t a, int16_t b) { return (static_cast<uint32_t>(b) << 16) | static_cast<uint16_t>(a); }
+
+    explicit ConvolutionIntTraits(const vs_generic_params &params) :
+        ConvolutionTraits(params),
+        c00_01(_mm512_set1_epi32(interleave(params.matrix[0], params.matrix[1]))),
+        c02_10(_mm512_set1_epi32(interleave(params.matrix[2], params.matrix[3]))),
+        c11_12(_mm512_set1_epi32(interleave(params.matrix[4], params.matrix[5]))),
+        c20_21(_mm512_set1_epi32(interleave(params.matrix[6], params.matrix[7]))),
+        c22_xx(_mm512_set1_epi32(interleave(params.matrix[8], 0)))
+    {}
+};
+
+struct ConvolutionByte : ConvolutionIntTraits, ByteTraits {
+    using ConvolutionIntTraits::ConvolutionIntTraits;
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+#define UNPCKLO(x) (_mm512_unpacklo_epi8(x, _mm512_setzero_si512()))
+#define UNPCKHI(x) (_mm512_unpackhi_epi8(x, _mm512_setzero_si512()))
+        __m512i accum_lolo, accum_lohi, accum_hilo, accum_hihi;
+        __m512i tmp0_lo, tmp0_hi, tmp1_lo, tmp1_hi;
+
+        tmp0_lo = UNPCKLO(a00);
+        tmp0_hi = UNPCKHI(a00);
+        tmp1_lo = UNPCKLO(a01);
+        tmp1_hi = UNPCKHI(a01);
+        accum_lolo = _mm512_madd_epi16(c00_01, _mm512_unpacklo_epi16(tmp0_lo, tmp1_lo));
+        accum_lohi = _mm512_madd_epi16(c00_01, _mm512_unpackhi_epi16(tmp0_lo, tmp1_lo));
+        accum_hilo = _mm512_madd_epi16(c00_01, _mm512_unpacklo_epi16(tmp0_hi, tmp1_hi));
+        accum_hihi = _mm512_madd_epi16(c00_01, _mm512_unpackhi_epi16(tmp0_hi, tmp1_hi));
+
+        tmp0_lo = UNPCKLO(a02);
+        tmp0_hi = UNPCKHI(a02);
+        tmp1_lo = UNPCKLO(a10);
+        tmp1_hi = UNPCKHI(a10);
+        accum_lolo = _mm512_add_epi32(accum_lolo, _mm512_madd_epi16(c02_10, _mm512_unpacklo_epi16(tmp0_lo, tmp1_lo)));
+        accum_lohi = _mm512_add_epi32(accum_lohi, _mm512_madd_epi16(c02_10, _mm512_unpackhi_epi16(tmp0_lo, tmp1_lo)));
+        accum_hilo = _mm512_add_epi32(accum_hilo, _mm512_madd_epi16(c02_10, _mm512_unpacklo_epi16(tmp0_hi, tmp1_hi)));
+        accum_hihi = _mm512_add_epi32(accum_hihi, _mm512_madd_epi16(c02_10, _mm512_unpackhi_epi16(tmp0_hi, tmp1_hi)));
+
+        tmp0_lo = UNPCKLO(a11);
+        tmp0_hi = UNPCKHI(a11);
+        tmp1_lo = UNPCKLO(a12);
+        tmp1_hi = UNPCKHI(a12);
+        accum_lolo = _mm512_add_epi32(accum_lolo, _mm512_madd_epi16(c11_12, _mm512_unpacklo_epi16(tmp0_lo, tmp1_lo)));
+        accum_lohi = _mm512_add_epi32(accum_lohi, _mm512_madd_epi16(c11_12, _mm512_unpackhi_epi16(tmp0_lo, tmp1_lo)));
+        accum_hilo = _mm512_add_epi32(accum_hilo, _mm512_madd_epi16(c11_12, _mm512_unpacklo_epi16(tmp0_hi, tmp1_hi)));
+        accum_hihi = _mm512_add_epi32(accum_hihi, _mm512_madd_epi16(c11_12, _mm512_unpackhi_epi16(tmp0_hi, tmp1_hi)));
+
+        tmp0_lo = UNPCKLO(a20);
+        tmp0_hi = UNPCKHI(a20);
+        tmp1_lo = UNPCKLO(a21);
+        tmp1_hi = UNPCKHI(a21);
+        accum_lolo = _mm512_add_epi32(accum_lolo, _mm512_madd_epi16(c20_21, _mm512_unpacklo_epi16(tmp0_lo, tmp1_lo)));
+        accum_lohi = _mm512_add_epi32(accum_lohi, _mm512_madd_epi16(c20_21, _mm512_unpackhi_epi16(tmp0_lo, tmp1_lo)));
+        accum_hilo = _mm512_add_epi32(accum_hilo, _mm512_madd_epi16(c20_21, _mm512_unpacklo_epi16(tmp0_hi, tmp1_hi)));
+        accum_hihi = _mm512_add_epi32(accum_hihi, _mm512_madd_epi16(c20_21, _mm512_unpackhi_epi16(tmp0_hi, tmp1_hi)));
+
+        tmp0_lo = UNPCKLO(a22);
+        tmp0_hi = UNPCKHI(a22);
+        accum_lolo = _mm512_add_epi32(accum_lolo, _mm512_madd_epi16(c22_xx, _mm512_unpacklo_epi16(tmp0_lo, _mm512_setzero_si512())));
+        accum_lohi = _mm512_add_epi32(accum_lohi, _mm512_madd_epi16(c22_xx, _mm512_unpackhi_epi16(tmp0_lo, _mm512_setzero_si512())));
+        accum_hilo = _mm512_add_epi32(accum_hilo, _mm512_madd_epi16(c22_xx, _mm512_unpacklo_epi16(tmp0_hi, _mm512_setzero_si512())));
+        accum_hihi = _mm512_add_epi32(accum_hihi, _mm512_madd_epi16(c22_xx, _mm512_unpackhi_epi16(tmp0_hi, _mm512_setzero_si512())));
+
+        __m512 tmpf_lolo = _mm512_cvtepi32_ps(accum_lolo);
+        __m512 tmpf_lohi = _mm512_cvtepi32_ps(accum_lohi);
+        __m512 tmpf_hilo = _mm512_cvtepi32_ps(accum_hilo);
+        __m512 tmpf_hihi = _mm512_cvtepi32_ps(accum_hihi);
+        tmpf_lolo = _mm512_fmadd_ps(tmpf_lolo, div, bias);
+        tmpf_lohi = _mm512_fmadd_ps(tmpf_lohi, div, bias);
+        tmpf_hilo = _mm512_fmadd_ps(tmpf_hilo, div, bias);
+        tmpf_hihi = _mm512_fmadd_ps(tmpf_hihi, div, bias);
+        tmpf_lolo = _mm512_and_ps(tmpf_lolo, saturate_mask);
+        tmpf_lohi = _mm512_and_ps(tmpf_lohi, saturate_mask);
+        tmpf_hilo = _mm512_and_ps(tmpf_hilo, saturate_mask);
+        tmpf_hihi = _mm512_and_ps(tmpf_hihi, saturate_mask);
+
+        accum_lolo = _mm512_cvtps_epi32(tmpf_lolo);
+        accum_lohi = _mm512_cvtps_epi32(tmpf_lohi);
+        accum_hilo = _mm512_cvtps_epi32(tmpf_hilo);
+        accum_hihi = _mm512_cvtps_epi32(tmpf_hihi);
+
+        accum_lolo = _mm512_packs_epi32(accum_lolo, accum_lohi);
+        accum_hilo = _mm512_packs_epi32(accum_hilo, accum_hihi);
+        accum_lolo = _mm512_packus_epi16(accum_lolo, accum_hilo);
+        return accum_lolo;
+#undef UNPCKHI
+#undef UNPCKLO
+    }
+};
+
+struct ConvolutionWord : ConvolutionIntTraits, WordTraits {
+    __m512i maxval;
+
+    explicit ConvolutionWord(const vs_generic_params &params) :
+        ConvolutionIntTraits(params),
+        maxval(_mm512_set1_epi16(params.maxval))
+    {
+        int32_t x = 0;
+
+        for (unsigned i = 0; i < 9; ++i) {
+            x += params.matrix[i];
+        }
+
+        // Use the 10th weight to subtract the bias "INT16_MIN * sum(matrix)"
+        c22_xx = _mm512_set1_epi32(interleave(params.matrix[8], static_cast<int16_t>(-x)));
+    }
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512i accum_lo, accum_hi;
+
+        a00 = _mm512_add_epi16(a00, _mm512_set1_epi16(INT16_MIN));
+        a01 = _mm512_add_epi16(a01, _mm512_set1_epi16(INT16_MIN));
+        a02 = _mm512_add_epi16(a02, _mm512_set1_epi16(INT16_MIN));
+        a10 = _mm512_add_epi16(a10, _mm512_set1_epi16(INT16_MIN));
+        a11 = _mm512_add_epi16(a11, _mm512_set1_epi16(INT16_MIN));
+        a12 = _mm512_add_epi16(a12, _mm512_set1_epi16(INT16_MIN));
+        a20 = _mm512_add_epi16(a20, _mm512_set1_epi16(INT16_MIN));
+        a21 = _mm512_add_epi16(a21, _mm512_set1_epi16(INT16_MIN));
+        a22 = _mm512_add_epi16(a22, _mm512_set1_epi16(INT16_MIN));
+
+        accum_lo = _mm512_madd_epi16(c00_01, _mm512_unpacklo_epi16(a00, a01));
+        accum_hi = _mm512_madd_epi16(c00_01, _mm512_unpackhi_epi16(a00, a01));
+        accum_lo = _mm512_add_epi32(accum_lo, _mm512_madd_epi16(c02_10, _mm512_unpacklo_epi16(a02, a10)));
+        accum_hi = _mm512_add_epi32(accum_hi, _mm512_madd_epi16(c02_10, _mm512_unpackhi_epi16(a02, a10)));
+        accum_lo = _mm512_add_epi32(accum_lo, _mm512_madd_epi16(c11_12, _mm512_unpacklo_epi16(a11, a12)));
+        accum_hi = _mm512_add_epi32(accum_hi, _mm512_madd_epi16(c11_12, _mm512_unpackhi_epi16(a11, a12)));
+        accum_lo = _mm512_add_epi32(accum_lo, _mm512_madd_epi16(c20_21, _mm512_unpacklo_epi16(a20, a21)));
+        accum_hi = _mm512_add_epi32(accum_hi, _mm512_madd_epi16(c20_21, _mm512_unpackhi_epi16(a20, a21)));
+        accum_lo = _mm512_add_epi32(accum_lo, _mm512_madd_epi16(c22_xx, _mm512_unpacklo_epi16(a22, _mm512_set1_epi16(INT16_MIN))));
+        accum_hi = _mm512_add_epi32(accum_hi, _mm512_madd_epi16(c22_xx, _mm512_unpackhi_epi16(a22, _mm512_set1_epi16(INT16_MIN))));
+
+        __m512 tmpf_lo = _mm512_cvtepi32_ps(accum_lo);
+        __m512 tmpf_hi = _mm512_cvtepi32_ps(accum_hi);
+        tmpf_lo = _mm512_fmadd_ps(tmpf_lo, div, bias);
+        tmpf_hi = _mm512_fmadd_ps(tmpf_hi, div, bias);
+        tmpf_lo = _mm512_and_ps(tmpf_lo, saturate_mask);
+        tmpf_hi = _mm512_and_ps(tmpf_hi, saturate_mask);
+
+        accum_lo = _mm512_cvtps_epi32(tmpf_lo);
+        accum_hi = _mm512_cvtps_epi32(tmpf_hi);
+
+        __m512i tmp = _mm512_packus_epi32(accum_lo, accum_hi);
+        return _mm512_min_epu16(tmp, maxval);
+    }
+};
+
+struct ConvolutionFloat : ConvolutionTraits, FloatTraits {
+    __m512 c00, c01, c02, c10, c11, c12, c20, c21, c22;
+
+    explicit ConvolutionFloat(const vs_generic_params &params) :
+        ConvolutionTraits(params),
+        c00(_mm512_set1_ps(params.matrixf[0] * params.div)),
+        c01(_mm512_set1_ps(params.matrixf[1] * params.div)),
+        c02(_mm512_set1_ps(params.matrixf[2] * params.div)),
+        c10(_mm512_set1_ps(params.matrixf[3] * params.div)),
+        c11(_mm512_set1_ps(params.matrixf[4] * params.div)),
+        c12(_mm512_set1_ps(params.matrixf[5] * params.div)),
+        c20(_mm512_set1_ps(params.matrixf[6] * params.div)),
+        c21(_mm512_set1_ps(params.matrixf[7] * params.div)),
+        c22(_mm512_set1_ps(params.matrixf[8] * params.div))
+    {}
+
+    FORCE_INLINE vec_type op(OP_ARGS)
+    {
+        PROLOGUE();
+
+        __m512 accum0 = _mm512_mul_ps(c00, a00);
+        __m512 accum1 = _mm512_mul_ps(c01, a01);
+        accum0 = _mm512_fmadd_ps(c02, a02, accum0);
+        accum1 = _mm512_fmadd_ps(c10, a10, accum1);
+        accum0 = _mm512_fmadd_ps(c11, a11, accum0);
+        accum1 = _mm512_fmadd_ps(c12, a12, accum1);
+        accum0 = _mm512_fmadd_ps(c20, a20, accum0);
+        accum1 = _mm512_fmadd_ps(c21, a21, accum1);
+        accum0 = _mm512_fmadd_ps(c22, a22, accum0);
+        accum1 = _mm512_add_ps(accum1, bias);
+
+        __m512 tmp = _mm512_add_ps(accum0, accum1);
+        tmp = _mm512_and_ps(tmp, saturate_mask);
+        return tmp;
+    }
+};
+#undef PROLOGUE
+#undef OP_ARGS
+
+
+template <class Traits>
+void filter_plane_3x3(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    typedef typename Traits::T T;
+    typedef typename Traits::vec_type vec_type;
+    typedef typename Traits::mask_type mask_type;
+
+    Traits traits{ params };
+
+    // the vector holding the last pixel also needs the mirrored pixel to its right so it's always handled separately
+    unsigned vec_end = (width - 1) & ~(Traits::vec_len - 1);
+    unsigned tail = width - vec_end;
+    mask_type tail_mask = Traits::mask(tail);
+
+#define INVOKE(p0, p1, p2) (traits.op(Traits::loadu(p0 - 1), Traits::load(p0), Traits::loadu(p0 + 1), Traits::loadu(p1 - 1), Traits::load(p1), Traits::loadu(p1 + 1), Traits::loadu(p2 - 1), Traits::load(p2), Traits::loadu(p2 + 1)))
+    for (unsigned i = 0; i < height; ++i) {
+        unsigned above_idx = i == 0 ? std::min(1U, height - 1) : i - 1;
+        unsigned below_idx = i == height - 1 ? height - std::min(2U, height) : i + 1;
+
+        const T *srcp0 = static_cast<const T *>(line_ptr(src, above_idx, src_stride));
+        const T *srcp1 = static_cast<const T *>(line_ptr(src, i, src_stride));
+        const T *srcp2 = static_cast<const T *>(line_ptr(src, below_idx, src_stride));
+        T *dstp = static_cast<T *>(line_ptr(dst, i, dst_stride));
+
+        // the left neighbour of the first pixel is the mirrored second pixel, a masked load puts it in the first element
+        // and fills the rest from the row
+        mask_type first_mask = Traits::mask(vec_end ? Traits::vec_len : tail);
+        mask_type left_mask = first_mask & ~static_cast<mask_type>(1);
+
+        if (vec_end) {
+            vec_type a00 = Traits::load_mask(Traits::set1(srcp0[1]), left_mask, srcp0 - 1);
+            vec_type a10 = Traits::load_mask(Traits::set1(srcp1[1]), left_mask, srcp1 - 1);
+            vec_type a20 = Traits::load_mask(Traits::set1(srcp2[1]), left_mask, srcp2 - 1);
+
+            vec_type val = traits.op(a00, Traits::load(srcp0), Traits::loadu(srcp0 + 1), a10, Traits::load(srcp1), Traits::loadu(srcp1 + 1), a20, Traits::load(srcp2), Traits::loadu(srcp2 + 1));
+            Traits::store(dstp, val);
+        }
+
+        for (unsigned j = Traits::vec_len; j < vec_end; j += Traits::vec_len) {
+            vec_type val = INVOKE(srcp0 + j, srcp1 + j, srcp2 + j);
+            Traits::store(dstp + j, val);
+        }
+
+        {
+            // the right neighbour of the last pixel is the mirrored second to last pixel, nothing past the end of the row is read
+            mask_type right_mask = Traits::mask(tail - 1);
+            T right0 = srcp0[width - std::min(2U, width)];
+            T right1 = srcp1[width - std::min(2U, width)];
+            T right2 = srcp2[width - std::min(2U, width)];
+
+            vec_type a00, a10, a20;
+            if (vec_end) {
+                a00 = Traits::load_mask(Traits::set1(0), tail_mask, srcp0 + vec_end - 1);
+                a10 = Traits::load_mask(Traits::set1(0), tail_mask, srcp1 + vec_end - 1);
+                a20 = Traits::load_mask(Traits::set1(0), tail_mask, srcp2 + vec_end - 1);
+            } else {
+                a00 = Traits::load_mask(Traits::set1(srcp0[std::min(1U, width - 1)]), left_mask, srcp0 - 1);
+                a10 = Traits::load_mask(Traits::set1(srcp1[std::min(1U, width - 1)]), left_mask, srcp1 - 1);
+                a20 = Traits::load_mask(Traits::set1(srcp2[std::min(1U, width - 1)]), left_mask, srcp2 - 1);
+            }
+
+            vec_type a01 = Traits::load_mask(Traits::set1(0), tail_mask, srcp0 + vec_end);
+            vec_type a11 = Traits::load_mask(Traits::set1(0), tail_mask, srcp1 + vec_end);
+            vec_type a21 = Traits::load_mask(Traits::set1(0), tail_mask, srcp2 + vec_end);
+
+            vec_type a02 = Traits::load_mask(Traits::set1(right0), right_mask, srcp0 + vec_end + 1);
+            vec_type a12 = Traits::load_mask(Traits::set1(right1), right_mask, srcp1 + vec_end + 1);
+            vec_type a22 = Traits::load_mask(Traits::set1(right2), right_mask, srcp2 + vec_end + 1);
+
+            vec_type val = traits.op(a00, a01, a02, a10, a11, a12, a20, a21, a22);
+            Traits::store_mask(dstp + vec_end, tail_mask, val);
+        }
+    }
+#undef INVOKE
+}
+
+unsigned reflect(int i, unsigned n)
+{
+    if (i < 0)
+        return std::min(static_cast<unsigned>(-i), n - 1);
+    if (i >= static_cast<int>(n))
+        return static_cast<unsigned>(std::max(2 * static_cast<int>(n - 1) - i, 0));
+    return static_cast<unsigned>(i);
+}
+
+FORCE_INLINE __m512 load16_sep(const uint8_t *ptr) { return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)ptr))); }
+FORCE_INLINE __m512 load16_sep(const uint16_t *ptr) { return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)ptr))); }
+FORCE_INLINE __m512 load16_sep(const float *ptr) { return _mm512_loadu_ps(ptr); }
+
+FORCE_INLINE void store16_sep(uint8_t *ptr, __mmask16 mask, __m512 x, __m512 maxval)
+{
+    __m512i v = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()), maxval));
+    _mm512_mask_cvtusepi32_storeu_epi8(ptr, mask, v);
+}
+
+FORCE_INLINE void store16_sep(uint16_t *ptr, __mmask16 mask, __m512 x, __m512 maxval)
+{
+    __m512i v = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()), maxval));
+    _mm512_mask_cvtusepi32_storeu_epi16(ptr, mask, v);
+}
+
+FORCE_INLINE void store16_sep(float *ptr, __mmask16 mask, __m512 x, __m512)
+{
+    _mm512_mask_storeu_ps(ptr, mask, x);
+}
+
+// Converts n pixels starting at x, which may lie outside the row, to float.
+template <class T>
+void load_row_sep(const T *srcp, float *dstp, int x, unsigned n, unsigned width)
+{
+    unsigned j0 = std::min(n, static_cast<unsigned>(std::max(-x, 0)));
+    unsigned j1 = std::max(j0, std::min(n, static_cast<unsigned>(std::max(static_cast<int>(width) - x, 0))));
+    unsigned j = 0;
+
+    for (; j < j0; ++j)
+        dstp[j] = static_cast<float>(srcp[reflect(x + static_cast<int>(j), width)]);
+    for (; j + 16 <= j1; j += 16)
+        _mm512_storeu_ps(dstp + j, load16_sep(srcp + x + j));
+    for (; j < n; ++j)
+        dstp[j] = static_cast<float>(srcp[reflect(x + static_cast<int>(j), width)]);
+}
+
+// Same column tiles and ring of horizontally filtered rows as the C version, see there. The intermediate buffers are
+// padded to whole vectors, only the stores to the destination are masked.
+template <class T>
+void conv_plane_sep(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    unsigned taps_h = params.sepsize_h;
+    unsigned taps_v = params.sepsize_v;
+    unsigned support_h = taps_h / 2;
+    unsigned support_v = taps_v / 2;
+    unsigned tile = std::min(width, std::max(64U, 32768 / (taps_v * 4) & ~15U));
+    unsigned tile_pad = (tile + 15) & ~15U;
+
+    __m512 c_h[65];
+    __m512 c_v[65];
+    for (unsigned m = 0; m < taps_h; ++m)
+        c_h[m] = _mm512_set1_ps(params.sepf_h[m]);
+    for (unsigned k = 0; k < taps_v; ++k)
+        c_v[k] = _mm512_set1_ps(params.sepf_v[k]);
+
+    __m512 div = _mm512_set1_ps(params.div);
+    __m512 bias = _mm512_set1_ps(params.bias);
+    __m512 maxval = _mm512_set1_ps(params.maxval);
+    __m512i saturate_mask = _mm512_set1_epi32(params.saturate ? 0xFFFFFFFF : 0x7FFFFFFF);
+
+    std::vector<float> row(tile_pad + 2 * support_h);
+    std::vector<float> ring(static_cast<size_t>(taps_v) * tile_pad);
+    std::vector<unsigned> ring_row(taps_v);
+
+    for (unsigned x0 = 0; x0 < width; x0 += tile) {
+        unsigned w = std::min(tile, width - x0);
+
+        std::fill(ring_row.begin(), ring_row.end(), UINT_MAX);
+
+        for (unsigned i = 0; i < height; ++i) {
+            const float *rows[65];
+
+            for (unsigned k = 0; k < taps_v; ++k) {
+                unsigned r = reflect(static_cast<int>(i + k) - static_cast<int>(support_v), height);
+                float *tmp = ring.data() + (r % taps_v) * static_cast<size_t>(tile_pad);
+
+                if (ring_row[r % taps_v] != r) {
+                    load_row_sep(line_ptr(static_cast<const T *>(src), r, src_stride), row.data(), static_cast<int>(x0) - static_cast<int>(support_h), w + 2 * support_h, width);
+
+                    for (unsigned j = 0; j < w; j += 16) {
+                        __m512 accum = _mm512_mul_ps(c_h[0], _mm512_loadu_ps(row.data() + j));
+                        for (unsigned m = 1; m < taps_h; ++m)
+                            accum = _mm512_fmadd_ps(c_h[m], _mm512_loadu_ps(row.data() + j + m), accum);
+                        _mm512_storeu_ps(tmp + j, accum);
+                    }
+                    ring_row[r % taps_v] = r;
+                }
+                rows[k] = tmp;
+            }
+
+            T *dstp = line_ptr(static_cast<T *>(dst), i, dst_stride) + x0;
+
+            for (unsigned j = 0; j < w; j += 16) {
+                __m512 accum = _mm512_mul_ps(c_v[0], _mm512_loadu_ps(rows[0] + j));
+                for (unsigned k = 1; k < taps_v; ++k)
+                    accum = _mm512_fmadd_ps(c_v[k], _mm512_loadu_ps(rows[k] + j), accum);
+
+                __m512 val = _mm512_add_ps(_mm512_mul_ps(accum, div), bias);
+                val = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(val), saturate_mask));
+                __mmask16 mask = w - j >= 16 ? 0xFFFF : static_cast<__mmask16>((1U << (w - j)) - 1);
+                store16_sep(dstp + j, mask, val, maxval);
+            }
+        }
+    }
+}
+
+struct InvertByte : ByteTraits {
+    __m512i maxval;
+
+    explicit InvertByte(const vs_generic_params &params) : maxval{ _mm512_set1_epi8(static_cast<uint8_t>(params.maxval)) } {}
+
+    FORCE_INLINE __m512i op(__m512i x) const { return _mm512_sub_epi8(maxval, _mm512_min_epu8(x, maxval)); }
+};
+
+struct InvertWord : WordTraits {
+    __m512i maxval;
+
+    explicit InvertWord(const vs_generic_params &params) : maxval{ _mm512_set1_epi16(params.maxval) } {}
+
+    FORCE_INLINE __m512i op(__m512i x) const { return _mm512_sub_epi16(maxval, _mm512_min_epu16(x, maxval)); }
+};
+
+struct InvertFloat : FloatTraits {
+    __m512 offset;
+
+    explicit InvertFloat(const vs_generic_params &params) : offset{ _mm512_set1_ps(params.hif) } {}
+
+    FORCE_INLINE __m512 op(__m512 x) const { return _mm512_sub_ps(offset, x); }
+};
+
+struct LimitByte : ByteTraits {
+    __m512i lo;
+    __m512i hi;
+
+    explicit LimitByte(const vs_generic_params &params) : lo{ _mm512_set1_epi8(static_cast<uint8_t>(params.lo)) }, hi{ _mm512_set1_epi8(static_cast<uint8_t>(params.hi)) } {}
+
+    FORCE_INLINE __m512i op(__m512i x) const { return _mm512_min_epu8(_mm512_max_epu8(x, lo), hi); }
+};
+
+struct LimitWord : WordTraits {
+    __m512i lo;
+    __m512i hi;
+
+    explicit LimitWord(const vs_generic_params &params) : lo{ _mm512_set1_epi16(params.lo) }, hi{ _mm512_set1_epi16(params.hi) } {}
+
+    FORCE_INLINE __m512i op(__m512i x) const { return _mm512_min_epu16(_mm512_max_epu16(x, lo), hi); }
+};
+
+struct LimitFloat : FloatTraits {
+    __m512 lo;
+    __m512 hi;
+
+    explicit LimitFloat(const vs_generic_params &params) : lo{ _mm512_set1_ps(params.lof) }, hi{ _mm512_set1_ps(params.hif) } {}
+
+    FORCE_INLINE __m512 op(__m512 x) const { return _mm512_min_ps(_mm512_max_ps(x, lo), hi); }
+};
+
+struct BinarizeByte : ByteTraits {
+    __m512i threshold;
+    __m512i lo;
+    __m512i hi;
+
+    explicit BinarizeByte(const vs_generic_params &params) :
+        threshold{ _mm512_set1_epi8(static_cast<uint8_t>(params.threshold)) },
+        lo{ _mm512_set1_epi8(static_cast<uint8_t>(params.lo)) },
+        hi{ _mm512_set1_epi8(static_cast<uint8_t>(params.hi)) }
+    {}
+
+    FORCE_INLINE __m512i op(__m512i x) const { return _mm512_mask_blend_epi8(_mm512_cmpge_epu8_mask(x, threshold), lo, hi); }
+};
+
+struct BinarizeWord : WordTraits {
+    __m512i threshold;
+    __m512i lo;
+    __m512i hi;
+
+    explicit BinarizeWord(const vs_generic_params &params) :
+        threshold{ _mm512_set1_epi16(params.threshold) },
+        lo{ _mm512_set1_epi16(params.lo) },
+        hi{ _mm512_set1_epi16(params.hi) }
+    {}
+
+    FORCE_INLINE __m512i op(__m512i x) const { return _mm512_mask_blend_epi16(_mm512_cmpge_epu16_mask(x, threshold), lo, hi); }
+};
+
+struct BinarizeFloat : FloatTraits {
+    __m512 threshold;
+    __m512 lo;
+    __m512 hi;
+
+    explicit BinarizeFloat(const vs_generic_params &params) : threshold{ _mm512_set1_ps(params.thresholdf) }, lo{ _mm512_set1_ps(params.lof) }, hi{ _mm512_set1_ps(params.hif) } {}
+
+    FORCE_INLINE __m512 op(__m512 x) const { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, threshold, _CMP_LT_OQ), hi, lo); }
+};
+
+// log2 of a positive number. getexp/getmant also take care of denormals, the mantissa is reduced to
+// [sqrt(0.5), sqrt(2)) and fed to the Cephes logf polynomial.
+FORCE_INLINE __m512 mm512_log2_ps(__m512 x)
+{
+    __m512 e = _mm512_getexp_ps(x);
+    __m512 m = _mm512_getmant_ps(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero);
+    __mmask16 big = _mm512_cmp_ps_mask(m, _mm512_set1_ps(1.41421356f), _CMP_GT_OQ);
+
+    e = _mm512_mask_add_ps(e, big, e, _mm512_set1_ps(1.0f));
+    m = _mm512_sub_ps(_mm512_mask_mul_ps(m, big, m, _mm512_set1_ps(0.5f)), _mm512_set1_ps(1.0f));
+
+    __m512 z = _mm512_mul_ps(m, m);
+    __m512 y = _mm512_set1_ps(7.0376836292e-2f);
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-1.1514610310e-1f));
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(1.1676998740e-1f));
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-1.2420140846e-1f));
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(1.4249322787e-1f));
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-1.6668057665e-1f));
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(2.0000714765e-1f));
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-2.4999993993e-1f));
+    y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(3.3333331174e-1f));
+    y = _mm512_mul_ps(_mm512_mul_ps(y, m), z);
+    y = _mm512_fnmadd_ps(z, _mm512_set1_ps(0.5f), y);
+
+    return _mm512_fmadd_ps(_mm512_add_ps(m, y), _mm512_set1_ps(1.44269504f), e);
+}
+
+// 2^x with the Cephes exp2f polynomial on [-0.5, 0.5], scalef takes care of overflow and underflow.
+FORCE_INLINE __m512 mm512_exp2_ps(__m512 x)
+{
+    __m512 n = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 f = _mm512_sub_ps(x, n);
+    __m512 p = _mm512_set1_ps(1.535336188319500e-4f);
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.339887440266574e-3f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(9.618437357674640e-3f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(5.550332471162809e-2f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(2.402264791363012e-1f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(6.931472028550421e-1f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f));
+
+    return _mm512_scalef_ps(p, n);
+}
+
+struct LevelsTraits {
+    float min_in;
+    float max_in;
+    float min_out;
+    float range_in;
+    float range_out;
+    float range_scale;
+    float gamma;
+    float pow0;
+
+    explicit LevelsTraits(const vs_generic_params &params) :
+        min_in{ params.min_in },
+        max_in{ params.max_in },
+        min_out{ params.min_out },
+        range_in{ 1.0f / (params.max_in - params.min_in) },
+        range_out{ params.max_out - params.min_out },
+        range_scale{ range_out / (params.max_in - params.min_in) },
+        gamma{ params.gamma },
+        pow0{ std::pow(0.0f, params.gamma) }
+    {}
+};
+
+struct LevelsLinearFloat : LevelsTraits, FloatTraits {
+    using LevelsTraits::LevelsTraits;
+
+    FORCE_INLINE __m512 op(__m512 x) const
+    {
+        __m512 t = _mm512_max_ps(_mm512_sub_ps(_mm512_min_ps(x, _mm512_set1_ps(max_in)), _mm512_set1_ps(min_in)), _mm512_setzero_ps());
+        return _mm512_fmadd_ps(t, _mm512_set1_ps(range_scale), _mm512_set1_ps(min_out));
+    }
+};
+
+struct LevelsFloat : LevelsTraits, FloatTraits {
+    using LevelsTraits::LevelsTraits;
+
+    FORCE_INLINE __m512 op(__m512 x) const
+    {
+        __m512 t = _mm512_max_ps(_mm512_sub_ps(_mm512_min_ps(x, _mm512_set1_ps(max_in)), _mm512_set1_ps(min_in)), _mm512_setzero_ps());
+        t = _mm512_mul_ps(t, _mm512_set1_ps(range_in));
+
+        __mmask16 nonzero = _mm512_cmp_ps_mask(t, _mm512_setzero_ps(), _CMP_GT_OQ);
+        __m512 p = mm512_exp2_ps(_mm512_mul_ps(mm512_log2_ps(t), _mm512_set1_ps(gamma)));
+        p = _mm512_mask_blend_ps(nonzero, _mm512_set1_ps(pow0), p);
+
+        return _mm512_fmadd_ps(p, _mm512_set1_ps(range_out), _mm512_set1_ps(min_out));
+    }
+};
+
+template <class Traits>
+void point_plane(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    typedef typename Traits::T T;
+    typedef typename Traits::mask_type mask_type;
+    Traits traits(params);
+
+    unsigned vec_end = width - width % Traits::vec_len;
+    mask_type tail_mask = Traits::mask(width - vec_end);
+
+    for (unsigned i = 0; i < height; ++i) {
+        const T *srcp = line_ptr(static_cast<const T *>(src), i, src_stride);
+        T *dstp = line_ptr(static_cast<T *>(dst), i, dst_stride);
+
+        for (unsigned j = 0; j < vec_end; j += Traits::vec_len) {
+            Traits::store(dstp + j, traits.op(Traits::load(srcp + j)));
+        }
+        if (vec_end < width)
+            Traits::store_mask(dstp + vec_end, tail_mask, traits.op(Traits::load_mask(Traits::set1(0), tail_mask, srcp + vec_end)));
+    }
+}
+
+} // namespace
+
+
+void vs_generic_3x3_prewitt_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<PrewittSobelByte<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_prewitt_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<PrewittSobelWord<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_prewitt_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<PrewittSobelFloat<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_sobel_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<PrewittSobelByte<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_sobel_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<PrewittSobelWord<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_sobel_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<PrewittSobelFloat<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_min_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    switch (params->stencil) {
+    case STENCIL_H:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_H, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_V:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_V, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_PLUS:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_PLUS, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_ALL:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_ALL, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    default:
+        filter_plane_3x3<MinMaxByte<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    }
+}
+
+void vs_generic_3x3_min_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    switch (params->stencil) {
+    case STENCIL_H:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_H, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_V:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_V, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_PLUS:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_PLUS, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_ALL:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_ALL, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    default:
+        filter_plane_3x3<MinMaxWord<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    }
+}
+
+void vs_generic_3x3_min_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    switch (params->stencil) {
+    case STENCIL_H:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_H, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_V:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_V, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_PLUS:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_PLUS, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_ALL:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_ALL, false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    default:
+        filter_plane_3x3<MinMaxFloat<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    }
+}
+
+void vs_generic_3x3_max_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    switch (params->stencil) {
+    case STENCIL_H:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_H, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_V:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_V, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_PLUS:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_PLUS, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_ALL:
+        filter_plane_3x3<MinMaxFixedByte<STENCIL_ALL, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    default:
+        filter_plane_3x3<MinMaxByte<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    }
+}
+
+void vs_generic_3x3_max_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    switch (params->stencil) {
+    case STENCIL_H:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_H, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_V:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_V, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_PLUS:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_PLUS, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_ALL:
+        filter_plane_3x3<MinMaxFixedWord<STENCIL_ALL, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    default:
+        filter_plane_3x3<MinMaxWord<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    }
+}
+
+void vs_generic_3x3_max_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    switch (params->stencil) {
+    case STENCIL_H:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_H, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_V:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_V, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_PLUS:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_PLUS, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    case STENCIL_ALL:
+        filter_plane_3x3<MinMaxFixedFloat<STENCIL_ALL, true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    default:
+        filter_plane_3x3<MinMaxFloat<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+        break;
+    }
+}
+
+void vs_generic_3x3_median_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<MedianByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_median_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<MedianWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_median_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<MedianFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_deflate_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<DeflateInflateByte<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_deflate_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<DeflateInflateWord<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_deflate_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<DeflateInflateFloat<false>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_inflate_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<DeflateInflateByte<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_inflate_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<DeflateInflateWord<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_inflate_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<DeflateInflateFloat<true>>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_conv_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<ConvolutionByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_conv_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<ConvolutionWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_3x3_conv_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    filter_plane_3x3<ConvolutionFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<uint8_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<uint16_t>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_conv_sep_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    conv_plane_sep<float>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_byte_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_word_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_levels_float_avx512(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    if (std::abs(params->gamma - 1.0f) < FLT_EPSILON)
+        point_plane<LevelsLinearFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+    else
+        point_plane<LevelsFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
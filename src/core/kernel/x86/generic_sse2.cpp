@@ -19,6 +19,7 @@
 */
 
 #include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <emmintrin.h>
 #include "../generic.h"
@@ -1045,6 +1046,215 @@ void filter_plane_3x3(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_
 #undef INVOKE
 }
 
+struct InvertByte : ByteTraits {
+    __m128i maxval;
+
+    explicit InvertByte(const vs_generic_params &params) : maxval{ _mm_set1_epi8(static_cast<uint8_t>(params.maxval)) } {}
+
+    FORCE_INLINE __m128i op(__m128i x) const { return _mm_sub_epi8(maxval, _mm_min_epu8(x, maxval)); }
+};
+
+struct InvertWord : WordTraits {
+    __m128i maxval;
+
+    explicit InvertWord(const vs_generic_params &params) : maxval{ _mm_set1_epi16(params.maxval) } {}
+
+    // min(x, maxval) is x - (x -sat maxval).
+    FORCE_INLINE __m128i op(__m128i x) const { return _mm_sub_epi16(maxval, _mm_sub_epi16(x, _mm_subs_epu16(x, maxval))); }
+};
+
+struct InvertFloat : FloatTraits {
+    __m128 offset;
+
+    explicit InvertFloat(const vs_generic_params &params) : offset{ _mm_set_ps1(params.hif) } {}
+
+    FORCE_INLINE __m128 op(__m128 x) const { return _mm_sub_ps(offset, x); }
+};
+
+struct LimitByte : ByteTraits {
+    __m128i lo;
+    __m128i hi;
+
+    explicit LimitByte(const vs_generic_params &params) : lo{ _mm_set1_epi8(static_cast<uint8_t>(params.lo)) }, hi{ _mm_set1_epi8(static_cast<uint8_t>(params.hi)) } {}
+
+    FORCE_INLINE __m128i op(__m128i x) const { return _mm_min_epu8(_mm_max_epu8(x, lo), hi); }
+};
+
+struct LimitWord : WordTraits {
+    __m128i lo;
+    __m128i hi;
+
+    explicit LimitWord(const vs_generic_params &params) : lo{ _mm_set1_epi16(params.lo) }, hi{ _mm_set1_epi16(params.hi) } {}
+
+    FORCE_INLINE __m128i op(__m128i x) const
+    {
+        x = _mm_add_epi16(lo, _mm_subs_epu16(x, lo));
+        return _mm_sub_epi16(x, _mm_subs_epu16(x, hi));
+    }
+};
+
+struct LimitFloat : FloatTraits {
+    __m128 lo;
+    __m128 hi;
+
+    explicit LimitFloat(const vs_generic_params &params) : lo{ _mm_set_ps1(params.lof) }, hi{ _mm_set_ps1(params.hif) } {}
+
+    FORCE_INLINE __m128 op(__m128 x) const { return _mm_min_ps(_mm_max_ps(x, lo), hi); }
+};
+
+struct BinarizeByte : ByteTraits {
+    __m128i threshold;
+    __m128i lo;
+    __m128i hi;
+
+    explicit BinarizeByte(const vs_generic_params &params) :
+        threshold{ _mm_set1_epi8(static_cast<uint8_t>(params.threshold)) },
+        lo{ _mm_set1_epi8(static_cast<uint8_t>(params.lo)) },
+        hi{ _mm_set1_epi8(static_cast<uint8_t>(params.hi)) }
+    {}
+
+    // threshold -sat x is zero exactly where x >= threshold.
+    FORCE_INLINE __m128i op(__m128i x) const { return mm_blendv_epi8(lo, hi, _mm_cmpeq_epi8(_mm_subs_epu8(threshold, x), _mm_setzero_si128())); }
+};
+
+struct BinarizeWord : WordTraits {
+    __m128i threshold;
+    __m128i lo;
+    __m128i hi;
+
+    explicit BinarizeWord(const vs_generic_params &params) :
+        threshold{ _mm_set1_epi16(params.threshold) },
+        lo{ _mm_set1_epi16(params.lo) },
+        hi{ _mm_set1_epi16(params.hi) }
+    {}
+
+    FORCE_INLINE __m128i op(__m128i x) const { return mm_blendv_epi8(lo, hi, _mm_cmpeq_epi16(_mm_subs_epu16(threshold, x), _mm_setzero_si128())); }
+};
+
+struct BinarizeFloat : FloatTraits {
+    __m128 threshold;
+    __m128 lo;
+    __m128 hi;
+
+    explicit BinarizeFloat(const vs_generic_params &params) : threshold{ _mm_set_ps1(params.thresholdf) }, lo{ _mm_set_ps1(params.lof) }, hi{ _mm_set_ps1(params.hif) } {}
+
+    FORCE_INLINE __m128 op(__m128 x) const
+    {
+        __m128 mask = _mm_cmplt_ps(x, threshold);
+        return _mm_or_ps(_mm_and_ps(mask, lo), _mm_andnot_ps(mask, hi));
+    }
+};
+
+// log2 of a positive normal number. The mantissa is reduced to [sqrt(0.5), sqrt(2)) and fed to the Cephes logf polynomial.
+FORCE_INLINE __m128 mm_log2_ps(__m128 x)
+{
+    __m128i bits = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+    __m128 big = _mm_cmpgt_ps(m, _mm_set_ps1(1.41421356f));
+
+    e = _mm_sub_epi32(e, _mm_castps_si128(big));
+    m = _mm_sub_ps(_mm_or_ps(_mm_and_ps(big, _mm_mul_ps(m, _mm_set_ps1(0.5f))), _mm_andnot_ps(big, m)), _mm_set_ps1(1.0f));
+
+    __m128 z = _mm_mul_ps(m, m);
+    __m128 y = _mm_set_ps1(7.0376836292e-2f);
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(-1.1514610310e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(1.1676998740e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(-1.2420140846e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(1.4249322787e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(-1.6668057665e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(2.0000714765e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(-2.4999993993e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set_ps1(3.3333331174e-1f));
+    y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set_ps1(0.5f)));
+
+    return _mm_add_ps(_mm_mul_ps(_mm_add_ps(m, y), _mm_set_ps1(1.44269504f)), _mm_cvtepi32_ps(e));
+}
+
+// 2^x with the Cephes exp2f polynomial on [-0.5, 0.5]. Results flush to zero below 2^-126 and saturate to infinity.
+FORCE_INLINE __m128 mm_exp2_ps(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set_ps1(-127.0f)), _mm_set_ps1(128.0f));
+
+    __m128i n = _mm_cvtps_epi32(x);
+    __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+    __m128 p = _mm_set_ps1(1.535336188319500e-4f);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set_ps1(1.339887440266574e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set_ps1(9.618437357674640e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set_ps1(5.550332471162809e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set_ps1(2.402264791363012e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set_ps1(6.931472028550421e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set_ps1(1.0f));
+
+    return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)));
+}
+
+struct LevelsTraits {
+    float min_in;
+    float max_in;
+    float min_out;
+    float range_in;
+    float range_out;
+    float range_scale;
+    float gamma;
+    float pow0;
+
+    explicit LevelsTraits(const vs_generic_params &params) :
+        min_in{ params.min_in },
+        max_in{ params.max_in },
+        min_out{ params.min_out },
+        range_in{ 1.0f / (params.max_in - params.min_in) },
+        range_out{ params.max_out - params.min_out },
+        range_scale{ range_out / (params.max_in - params.min_in) },
+        gamma{ params.gamma },
+        pow0{ std::pow(0.0f, params.gamma) }
+    {}
+};
+
+struct LevelsLinearFloat : LevelsTraits, FloatTraits {
+    using LevelsTraits::LevelsTraits;
+
+    FORCE_INLINE __m128 op(__m128 x) const
+    {
+        __m128 t = _mm_max_ps(_mm_sub_ps(_mm_min_ps(x, _mm_set_ps1(max_in)), _mm_set_ps1(min_in)), _mm_setzero_ps());
+        return _mm_add_ps(_mm_mul_ps(t, _mm_set_ps1(range_scale)), _mm_set_ps1(min_out));
+    }
+};
+
+struct LevelsFloat : LevelsTraits, FloatTraits {
+    using LevelsTraits::LevelsTraits;
+
+    FORCE_INLINE __m128 op(__m128 x) const
+    {
+        __m128 t = _mm_max_ps(_mm_sub_ps(_mm_min_ps(x, _mm_set_ps1(max_in)), _mm_set_ps1(min_in)), _mm_setzero_ps());
+        t = _mm_mul_ps(t, _mm_set_ps1(range_in));
+
+        // Zero and denormal inputs take the value of pow(0, gamma) since the log2 above only handles normal numbers.
+        __m128 normal = _mm_cmpge_ps(t, _mm_set_ps1(FLT_MIN));
+        __m128 p = mm_exp2_ps(_mm_mul_ps(mm_log2_ps(t), _mm_set_ps1(gamma)));
+        p = _mm_or_ps(_mm_and_ps(normal, p), _mm_andnot_ps(normal, _mm_set_ps1(pow0)));
+
+        return _mm_add_ps(_mm_mul_ps(p, _mm_set_ps1(range_out)), _mm_set_ps1(min_out));
+    }
+};
+
+template <class Traits>
+void point_plane(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const vs_generic_params &params, unsigned width, unsigned height)
+{
+    typedef typename Traits::T T;
+    Traits traits(params);
+
+    for (unsigned i = 0; i < height; ++i) {
+        const T *srcp = line_ptr(static_cast<const T *>(src), i, src_stride);
+        T *dstp = line_ptr(static_cast<T *>(dst), i, dst_stride);
+
+        for (unsigned j = 0; j < width; j += Traits::vec_len) {
+            Traits::store(dstp + j, traits.op(Traits::load(srcp + j)));
+        }
+    }
+}
+
 } // namespace
 
 
@@ -1263,3 +1473,56 @@ void vs_generic_3x3_conv_float_sse2(const void *src, ptrdiff_t src_stride, void
 {
     filter_plane_3x3<ConvolutionFloat>(src, src_stride, dst, dst_stride, *params, width, height);
 }
+
+void vs_generic_invert_byte_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_word_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_invert_float_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<InvertFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_byte_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_word_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_limit_float_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<LimitFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_byte_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeByte>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_word_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeWord>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_binarize_float_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    point_plane<BinarizeFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
+
+void vs_generic_levels_float_sse2(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, const struct vs_generic_params *params, unsigned width, unsigned height)
+{
+    if (std::abs(params->gamma - 1.0f) < FLT_EPSILON)
+        point_plane<LevelsLinearFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+    else
+        point_plane<LevelsFloat>(src, src_stride, dst, dst_stride, *params, width, height);
+}
@@ -0,0 +1,167 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#include <immintrin.h>
+#include "../lut.h"
+
+// Widens 16 pixels to two vectors of 32-bit indices clamped to maxval.
+static void load_idx_byte(const void *p, __m256i maxval, __m256i *lo, __m256i *hi)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    *lo = _mm256_min_epu32(_mm256_cvtepu8_epi32(v), maxval);
+    *hi = _mm256_min_epu32(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), maxval);
+}
+
+static void load_idx_word(const void *p, __m256i maxval, __m256i *lo, __m256i *hi)
+{
+    *lo = _mm256_min_epu32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p + 0)), maxval);
+    *hi = _mm256_min_epu32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p + 1)), maxval);
+}
+
+static void gather_store_byte(const void *lut, __m256i lo, __m256i hi, void *dst)
+{
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i v0 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)lut, lo, 1), mask);
+    __m256i v1 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)lut, hi, 1), mask);
+    __m256i w = _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1)));
+}
+
+static void gather_store_word(const void *lut, __m256i lo, __m256i hi, void *dst)
+{
+    __m256i mask = _mm256_set1_epi32(0xFFFF);
+    __m256i v0 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)lut, lo, 2), mask);
+    __m256i v1 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)lut, hi, 2), mask);
+    _mm256_storeu_si256((__m256i *)dst, _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+static void gather_store_float(const void *lut, __m256i lo, __m256i hi, void *dst)
+{
+    _mm256_storeu_ps((float *)dst + 0, _mm256_i32gather_ps((const float *)lut, lo, 4));
+    _mm256_storeu_ps((float *)dst + 8, _mm256_i32gather_ps((const float *)lut, hi, 4));
+}
+
+// Each half of the 256 entry table is looked up with vpshufb in 8 steps of 16
+// entries. The tables hold the xor of neighbouring rows so that xoring all
+// steps with a non-negative index (sample - 16 * step) leaves the right row.
+void vs_lut_byte_byte_avx2(const void *src, void *dst, const void *lut, unsigned maxval, unsigned n)
+{
+    const uint8_t *srcp = src;
+    uint8_t *dstp = dst;
+    const uint8_t *lutp = lut;
+    __m256i tbl[16];
+    unsigned i, k;
+
+    (void)maxval;
+
+    for (k = 0; k < 16; k++) {
+        __m128i t = _mm_loadu_si128((const __m128i *)(lutp + k * 16));
+        if (k % 8)
+            t = _mm_xor_si128(t, _mm_loadu_si128((const __m128i *)(lutp + (k - 1) * 16)));
+        tbl[k] = _mm256_broadcastsi128_si256(t);
+    }
+
+    for (i = 0; i < (n & ~31); i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(srcp + i));
+        __m256i idx_lo = v;
+        __m256i idx_hi = _mm256_xor_si256(v, _mm256_set1_epi8((char)0x80));
+        __m256i r_lo = _mm256_setzero_si256();
+        __m256i r_hi = _mm256_setzero_si256();
+
+        for (k = 0; k < 8; k++) {
+            r_lo = _mm256_xor_si256(r_lo, _mm256_shuffle_epi8(tbl[k], idx_lo));
+            r_hi = _mm256_xor_si256(r_hi, _mm256_shuffle_epi8(tbl[k + 8], idx_hi));
+            idx_lo = _mm256_sub_epi8(idx_lo, _mm256_set1_epi8(16));
+            idx_hi = _mm256_sub_epi8(idx_hi, _mm256_set1_epi8(16));
+        }
+
+        // Each half is only valid for samples from that half.
+        _mm256_storeu_si256((__m256i *)(dstp + i), _mm256_blendv_epi8(r_lo, r_hi, v));
+    }
+    for (; i < n; i++)
+        dstp[i] = lutp[srcp[i]];
+}
+
+#define LUT(in, out, in_t, out_t) \
+void vs_lut_##in##_##out##_avx2(const void *src, void *dst, const void *lut, unsigned maxval, unsigned n) \
+{ \
+    const in_t *srcp = src; \
+    out_t *dstp = dst; \
+    const out_t *lutp = lut; \
+    __m256i mmax = _mm256_set1_epi32(maxval); \
+    unsigned i; \
+\
+    for (i = 0; i < (n & ~15); i += 16) { \
+        __m256i lo, hi; \
+        load_idx_##in(srcp + i, mmax, &lo, &hi); \
+        gather_store_##out(lut, lo, hi, dstp + i); \
+    } \
+    for (; i < n; i++) \
+        dstp[i] = lutp[srcp[i] < maxval ? srcp[i] : maxval]; \
+}
+
+LUT(byte, word, uint8_t, uint16_t)
+LUT(byte, float, uint8_t, float)
+LUT(word, byte, uint16_t, uint8_t)
+LUT(word, word, uint16_t, uint16_t)
+LUT(word, float, uint16_t, float)
+
+#undef LUT
+
+#define LUT2(inx, iny, out, inx_t, iny_t, out_t) \
+void vs_lut2_##inx##_##iny##_##out##_avx2(const void *srcx, const void *srcy, void *dst, const void *lut, unsigned maxvalx, unsigned maxvaly, unsigned shift, unsigned n) \
+{ \
+    const inx_t *srcpx = srcx; \
+    const iny_t *srcpy = srcy; \
+    out_t *dstp = dst; \
+    const out_t *lutp = lut; \
+    __m256i mmaxx = _mm256_set1_epi32(maxvalx); \
+    __m256i mmaxy = _mm256_set1_epi32(maxvaly); \
+    __m128i mshift = _mm_cvtsi32_si128(shift); \
+    unsigned i; \
+\
+    for (i = 0; i < (n & ~15); i += 16) { \
+        __m256i xlo, xhi, ylo, yhi; \
+        load_idx_##inx(srcpx + i, mmaxx, &xlo, &xhi); \
+        load_idx_##iny(srcpy + i, mmaxy, &ylo, &yhi); \
+        gather_store_##out(lut, _mm256_add_epi32(_mm256_sll_epi32(ylo, mshift), xlo), _mm256_add_epi32(_mm256_sll_epi32(yhi, mshift), xhi), dstp + i); \
+    } \
+    for (; i < n; i++) { \
+        unsigned x = srcpx[i] < maxvalx ? srcpx[i] : maxvalx; \
+        unsigned y = srcpy[i] < maxvaly ? srcpy[i] : maxvaly; \
+        dstp[i] = lutp[(y << shift) + x]; \
+    } \
+}
+
+LUT2(byte, byte, byte, uint8_t, uint8_t, uint8_t)
+LUT2(byte, byte, word, uint8_t, uint8_t, uint16_t)
+LUT2(byte, byte, float, uint8_t, uint8_t, float)
+LUT2(byte, word, byte, uint8_t, uint16_t, uint8_t)
+LUT2(byte, word, word, uint8_t, uint16_t, uint16_t)
+LUT2(byte, word, float, uint8_t, uint16_t, float)
+LUT2(word, byte, byte, uint16_t, uint8_t, uint8_t)
+LUT2(word, byte, word, uint16_t, uint8_t, uint16_t)
+LUT2(word, byte, float, uint16_t, uint8_t, float)
+LUT2(word, word, byte, uint16_t, uint16_t, uint8_t)
+LUT2(word, word, word, uint16_t, uint16_t, uint16_t)
+LUT2(word, word, float, uint16_t, uint16_t, float)
+
+#undef LUT2
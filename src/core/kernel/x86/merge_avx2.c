@@ -104,6 +104,23 @@ void vs_merge_float_avx2(const void *src1, const void *src2, void *dst, union vs
     }
 }
 
+void vs_merge_half_avx2(const void *src1, const void *src2, void *dst, union vs_merge_weight weight, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    __m256 w = _mm256_set1_ps(weight.f);
+
+    for (i = 0; i < n; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp2 + i)));
+        __m256 result = _mm256_add_ps(v1, _mm256_mul_ps(_mm256_sub_ps(v2, v1), w));
+        _mm_store_si128((__m128i *)(dstp + i), _mm256_cvtps_ph(result, _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
 
 static __m256i div255_epu16(__m256i x)
 {
@@ -214,6 +231,26 @@ void vs_mask_merge_float_avx2(const void *src1, const void *src2, const void *ma
     }
 }
 
+void vs_mask_merge_half_avx2(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    const uint16_t *maskp = mask;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+
+    for (i = 0; i < n; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp2 + i)));
+        __m256 w2 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(maskp + i)));
+        __m256 result = _mm256_add_ps(v1, _mm256_mul_ps(_mm256_sub_ps(v2, v1), w2));
+        _mm_store_si128((__m128i *)(dstp + i), _mm256_cvtps_ph(result, _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
 void vs_mask_merge_premul_byte_avx2(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
 {
     const uint8_t *srcp1 = src1;
@@ -312,6 +349,130 @@ void vs_mask_merge_premul_float_avx2(const void *src1, const void *src2, const v
     }
 }
 
+void vs_mask_merge_premul_half_avx2(const void *src1, const void *src2, const void *mask, void *dst, unsigned depth, unsigned offset, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    const uint16_t *maskp = mask;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+
+    for (i = 0; i < n; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp2 + i)));
+        __m256 w1 = _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(maskp + i))));
+        __m256 result = _mm256_add_ps(_mm256_mul_ps(w1, v1), v2);
+        _mm_store_si128((__m128i *)(dstp + i), _mm256_cvtps_ph(result, _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
+static __m256i premultiply_epi8(__m256i v, __m256i a, __m256i offset, __m256i round)
+{
+    __m256i m = _mm256_add_epi16(a, _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi16(1)));
+    // only bits 8 to 15 of the product are kept so it may wrap around
+    __m256i tmp = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(v, offset), m), round);
+    tmp = _mm256_add_epi16(_mm256_srli_epi16(tmp, 8), offset);
+    return _mm256_and_si256(tmp, _mm256_set1_epi16(UINT8_MAX));
+}
+
+void vs_premultiply_byte_avx2(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint8_t *srcp = src;
+    const uint8_t *alphap = alpha;
+    uint8_t *dstp = dst;
+    unsigned i;
+
+    __m256i off = _mm256_set1_epi16(offset);
+    __m256i round = _mm256_set1_epi16(chroma ? 0 : 128);
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 16) {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_load_si128((const __m128i *)(srcp + i)));
+        __m256i a = _mm256_cvtepu8_epi16(_mm_load_si128((const __m128i *)(alphap + i)));
+        __m256i tmp = premultiply_epi8(v, a, off, round);
+
+        tmp = _mm256_packus_epi16(tmp, tmp);
+        tmp = _mm256_permute4x64_epi64(tmp, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_store_si128((__m128i *)(dstp + i), _mm256_castsi256_si128(tmp));
+    }
+}
+
+void vs_premultiply_word_avx2(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint16_t *srcp = src;
+    const uint16_t *alphap = alpha;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    __m256i maxval = _mm256_set1_epi16((1U << depth) - 1);
+    __m256i off = _mm256_set1_epi16(offset);
+    __m256i round = _mm256_set1_epi16(chroma ? 0 : (1U << (depth - 1)));
+    __m128i shiftlo = _mm_cvtsi32_si128(depth);
+    __m128i shifthi = _mm_cvtsi32_si128(16 - depth);
+
+    for (i = 0; i < n; i += 16) {
+        __m256i v = _mm256_load_si256((const __m256i *)(srcp + i));
+        __m256i a = _mm256_load_si256((const __m256i *)(alphap + i));
+        __m256i m, mhi, nonneg, tmp, lo, hi, carry;
+
+        // m = min(a, maxval) + bit 1, only 65535 at 16 bit makes it overflow to 65536
+        a = _mm256_min_epu16(a, maxval);
+        mhi = _mm256_cmpeq_epi16(a, _mm256_set1_epi16(-1));
+        m = _mm256_add_epi16(a, _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi16(1)));
+
+        // the 32 bit product of the signed difference split into 16 bit halves, wrapping like the c version
+        nonneg = _mm256_cmpeq_epi16(_mm256_max_epu16(v, off), v);
+        tmp = _mm256_sub_epi16(v, off);
+        lo = _mm256_mullo_epi16(tmp, m);
+        hi = _mm256_mulhi_epu16(tmp, m);
+        hi = _mm256_add_epi16(hi, _mm256_and_si256(mhi, tmp));
+        hi = _mm256_sub_epi16(hi, _mm256_andnot_si256(nonneg, m));
+
+        tmp = _mm256_add_epi16(lo, round);
+        carry = _mm256_cmpgt_epi16(_mm256_xor_si256(lo, _mm256_set1_epi16(INT16_MIN)), _mm256_xor_si256(tmp, _mm256_set1_epi16(INT16_MIN)));
+        hi = _mm256_sub_epi16(hi, carry);
+
+        tmp = _mm256_or_si256(_mm256_sll_epi16(hi, shifthi), _mm256_srl_epi16(tmp, shiftlo));
+        _mm256_store_si256((__m256i *)(dstp + i), _mm256_add_epi16(tmp, off));
+    }
+}
+
+void vs_premultiply_float_avx2(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const float *srcp = src;
+    const float *alphap = alpha;
+    float *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+    (void)chroma;
+
+    for (i = 0; i < n; i += 8)
+        _mm256_store_ps(dstp + i, _mm256_mul_ps(_mm256_load_ps(srcp + i), _mm256_load_ps(alphap + i)));
+}
+
+void vs_premultiply_half_avx2(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint16_t *srcp = src;
+    const uint16_t *alphap = alpha;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+    (void)chroma;
+
+    for (i = 0; i < n; i += 8) {
+        __m256 result = _mm256_mul_ps(_mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp + i))), _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(alphap + i))));
+        _mm_store_si128((__m128i *)(dstp + i), _mm256_cvtps_ph(result, _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
 void vs_makediff_byte_avx2(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
 {
     const uint8_t *srcp1 = src1;
@@ -366,6 +527,22 @@ void vs_makediff_float_avx2(const void *src1, const void *src2, void *dst, unsig
     }
 }
 
+void vs_makediff_half_avx2(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp2 + i)));
+        _mm_store_si128((__m128i *)(dstp + i), _mm256_cvtps_ph(_mm256_sub_ps(v1, v2), _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
 void vs_mergediff_byte_avx2(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
 {
     const uint8_t *srcp1 = src1;
@@ -419,3 +596,19 @@ void vs_mergediff_float_avx2(const void *src1, const void *src2, void *dst, unsi
         _mm256_store_ps(dstp + i, _mm256_add_ps(v1, v2));
     }
 }
+
+void vs_mergediff_half_avx2(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
+{
+    const uint16_t *srcp1 = src1;
+    const uint16_t *srcp2 = src2;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_load_si128((const __m128i *)(srcp2 + i)));
+        _mm_store_si128((__m128i *)(dstp + i), _mm256_cvtps_ph(_mm256_add_ps(v1, v2), _MM_FROUND_TO_NEAREST_INT));
+    }
+}
@@ -323,6 +323,92 @@ void vs_mask_merge_premul_float_sse2(const void *src1, const void *src2, const v
     }
 }
 
+static __m128i premultiply_epi8(__m128i v, __m128i a, __m128i offset, __m128i round)
+{
+    __m128i m = _mm_add_epi16(a, _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi16(1)));
+    // only bits 8 to 15 of the product are kept so it may wrap around
+    __m128i tmp = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(v, offset), m), round);
+    tmp = _mm_add_epi16(_mm_srli_epi16(tmp, 8), offset);
+    return _mm_and_si128(tmp, _mm_set1_epi16(UINT8_MAX));
+}
+
+void vs_premultiply_byte_sse2(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint8_t *srcp = src;
+    const uint8_t *alphap = alpha;
+    uint8_t *dstp = dst;
+    unsigned i;
+
+    __m128i off = _mm_set1_epi16(offset);
+    __m128i round = _mm_set1_epi16(chroma ? 0 : 128);
+
+    (void)depth;
+
+    for (i = 0; i < n; i += 16) {
+        __m128i v = _mm_load_si128((const __m128i *)(srcp + i));
+        __m128i a = _mm_load_si128((const __m128i *)(alphap + i));
+
+        __m128i lo = premultiply_epi8(_mm_unpacklo_epi8(v, _mm_setzero_si128()), _mm_unpacklo_epi8(a, _mm_setzero_si128()), off, round);
+        __m128i hi = premultiply_epi8(_mm_unpackhi_epi8(v, _mm_setzero_si128()), _mm_unpackhi_epi8(a, _mm_setzero_si128()), off, round);
+        _mm_store_si128((__m128i *)(dstp + i), _mm_packus_epi16(lo, hi));
+    }
+}
+
+void vs_premultiply_word_sse2(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const uint16_t *srcp = src;
+    const uint16_t *alphap = alpha;
+    uint16_t *dstp = dst;
+    unsigned i;
+
+    __m128i maxval = _mm_set1_epi16((1U << depth) - 1);
+    __m128i off = _mm_set1_epi16(offset);
+    __m128i round = _mm_set1_epi16(chroma ? 0 : (1U << (depth - 1)));
+    __m128i shiftlo = _mm_cvtsi32_si128(depth);
+    __m128i shifthi = _mm_cvtsi32_si128(16 - depth);
+
+    for (i = 0; i < n; i += 8) {
+        __m128i v = _mm_load_si128((const __m128i *)(srcp + i));
+        __m128i a = _mm_load_si128((const __m128i *)(alphap + i));
+        __m128i m, mhi, nonneg, tmp, lo, hi, carry;
+
+        // m = min(a, maxval) + bit 1, only 65535 at 16 bit makes it overflow to 65536
+        a = _mm_sub_epi16(a, _mm_subs_epu16(a, maxval));
+        mhi = _mm_cmpeq_epi16(a, _mm_set1_epi16(-1));
+        m = _mm_add_epi16(a, _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi16(1)));
+
+        // the 32 bit product of the signed difference split into 16 bit halves, wrapping like the c version
+        nonneg = _mm_cmpeq_epi16(_mm_subs_epu16(off, v), _mm_setzero_si128());
+        tmp = _mm_sub_epi16(v, off);
+        lo = _mm_mullo_epi16(tmp, m);
+        hi = _mm_mulhi_epu16(tmp, m);
+        hi = _mm_add_epi16(hi, _mm_and_si128(mhi, tmp));
+        hi = _mm_sub_epi16(hi, _mm_andnot_si128(nonneg, m));
+
+        tmp = _mm_add_epi16(lo, round);
+        carry = _mm_cmpgt_epi16(_mm_xor_si128(lo, _mm_set1_epi16(INT16_MIN)), _mm_xor_si128(tmp, _mm_set1_epi16(INT16_MIN)));
+        hi = _mm_sub_epi16(hi, carry);
+
+        tmp = _mm_or_si128(_mm_sll_epi16(hi, shifthi), _mm_srl_epi16(tmp, shiftlo));
+        _mm_store_si128((__m128i *)(dstp + i), _mm_add_epi16(tmp, off));
+    }
+}
+
+void vs_premultiply_float_sse2(const void *src, const void *alpha, void *dst, unsigned depth, unsigned offset, unsigned chroma, unsigned n)
+{
+    const float *srcp = src;
+    const float *alphap = alpha;
+    float *dstp = dst;
+    unsigned i;
+
+    (void)depth;
+    (void)offset;
+    (void)chroma;
+
+    for (i = 0; i < n; i += 4)
+        _mm_store_ps(dstp + i, _mm_mul_ps(_mm_load_ps(srcp + i), _mm_load_ps(alphap + i)));
+}
+
 void vs_makediff_byte_sse2(const void *src1, const void *src2, void *dst, unsigned depth, unsigned n)
 {
     const uint8_t *srcp1 = src1;
@@ -0,0 +1,133 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#include <emmintrin.h>
+#include <string.h>
+#include "../reverse.h"
+
+static __m128i reverse_words(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+void vs_reverse_byte_sse2(const void *src, void *dst, unsigned n)
+{
+    const uint8_t *srcp = src;
+    uint8_t *dstp = dst;
+    unsigned x;
+
+    for (x = 0; x + 16 <= n; x += 16) {
+        __m128i v = reverse_words(_mm_loadu_si128((const __m128i *)(srcp + x)));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(dstp + n - x - 16), v);
+    }
+    for (; x < n; x++)
+        dstp[n - 1 - x] = srcp[x];
+}
+
+void vs_reverse_word_sse2(const void *src, void *dst, unsigned n)
+{
+    const uint16_t *srcp = src;
+    uint16_t *dstp = dst;
+    unsigned x;
+
+    for (x = 0; x + 8 <= n; x += 8)
+        _mm_storeu_si128((__m128i *)(dstp + n - x - 8), reverse_words(_mm_loadu_si128((const __m128i *)(srcp + x))));
+    for (; x < n; x++)
+        dstp[n - 1 - x] = srcp[x];
+}
+
+void vs_reverse_dword_sse2(const void *src, void *dst, unsigned n)
+{
+    const uint32_t *srcp = src;
+    uint32_t *dstp = dst;
+    unsigned x;
+
+    for (x = 0; x + 4 <= n; x += 4)
+        _mm_storeu_si128((__m128i *)(dstp + n - x - 4), _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(srcp + x)), _MM_SHUFFLE(0, 1, 2, 3)));
+    for (; x < n; x++)
+        dstp[n - 1 - x] = srcp[x];
+}
+
+static void fill_vector(uint8_t *dstp, __m128i v, size_t bytes)
+{
+    size_t i;
+
+    for (i = 0; i + 64 <= bytes; i += 64) {
+        _mm_storeu_si128((__m128i *)(dstp + i + 0), v);
+        _mm_storeu_si128((__m128i *)(dstp + i + 16), v);
+        _mm_storeu_si128((__m128i *)(dstp + i + 32), v);
+        _mm_storeu_si128((__m128i *)(dstp + i + 48), v);
+    }
+    for (; i + 16 <= bytes; i += 16)
+        _mm_storeu_si128((__m128i *)(dstp + i), v);
+    /* The remainder is shorter than a vector and made of whole samples, so it repeats the same pattern. */
+    memcpy(dstp + i, &v, bytes - i);
+}
+
+void vs_fill_byte_sse2(void *dst, uint32_t value, size_t n)
+{
+    memset(dst, (uint8_t)value, n);
+}
+
+void vs_fill_word_sse2(void *dst, uint32_t value, size_t n)
+{
+    fill_vector(dst, _mm_set1_epi16((short)value), n * 2);
+}
+
+void vs_fill_dword_sse2(void *dst, uint32_t value, size_t n)
+{
+    fill_vector(dst, _mm_set1_epi32((int)value), n * 4);
+}
+
+void vs_copy_stream_sse2(void *dst, const void *src, size_t n)
+{
+    const uint8_t *srcp = src;
+    uint8_t *dstp = dst;
+    size_t head = (16 - ((uintptr_t)dstp & 15)) & 15;
+    size_t i;
+
+    if (head > n)
+        head = n;
+    memcpy(dstp, srcp, head);
+    srcp += head;
+    dstp += head;
+    n -= head;
+
+    for (i = 0; i + 64 <= n; i += 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(srcp + i + 0));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(srcp + i + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(srcp + i + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *)(srcp + i + 48));
+        _mm_stream_si128((__m128i *)(dstp + i + 0), v0);
+        _mm_stream_si128((__m128i *)(dstp + i + 16), v1);
+        _mm_stream_si128((__m128i *)(dstp + i + 32), v2);
+        _mm_stream_si128((__m128i *)(dstp + i + 48), v3);
+    }
+    for (; i + 16 <= n; i += 16)
+        _mm_stream_si128((__m128i *)(dstp + i), _mm_loadu_si128((const __m128i *)(srcp + i)));
+    memcpy(dstp + i, srcp + i, n - i);
+
+    /* Streaming stores are weakly ordered, the copy has to be visible before the plane is handed to another thread. */
+    _mm_sfence();
+}
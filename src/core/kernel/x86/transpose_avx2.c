@@ -0,0 +1,202 @@
+/*
+* Copyright (c) 2012-2019 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#ifdef VS_TARGET_CPU_X86
+
+#include <stddef.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+#define VS_TRANSPOSE_IMPL
+#define BLOCK_WIDTH_BYTE 16
+#define BLOCK_HEIGHT_BYTE 16
+#define BLOCK_WIDTH_WORD 8
+#define BLOCK_HEIGHT_WORD 16
+#define BLOCK_WIDTH_DWORD 8
+#define BLOCK_HEIGHT_DWORD 8
+#include "../transpose.h"
+
+#define LOAD_ROWS_128(src, stride, r0, r1) \
+    _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)ADD_OFFSET(src, (r0) * (stride)))), \
+                            _mm_loadu_si128((const __m128i *)ADD_OFFSET(src, (r1) * (stride))), 1)
+
+/* Rows i and i + 8 share a register, each lane is transposed like the sse2 8x16 block. */
+static void transpose_block_byte(const uint8_t * VS_RESTRICT src, ptrdiff_t src_stride, uint8_t * VS_RESTRICT dst, ptrdiff_t dst_stride)
+{
+    __m256i row0 = LOAD_ROWS_128(src, src_stride, 0, 8);
+    __m256i row1 = LOAD_ROWS_128(src, src_stride, 1, 9);
+    __m256i row2 = LOAD_ROWS_128(src, src_stride, 2, 10);
+    __m256i row3 = LOAD_ROWS_128(src, src_stride, 3, 11);
+    __m256i row4 = LOAD_ROWS_128(src, src_stride, 4, 12);
+    __m256i row5 = LOAD_ROWS_128(src, src_stride, 5, 13);
+    __m256i row6 = LOAD_ROWS_128(src, src_stride, 6, 14);
+    __m256i row7 = LOAD_ROWS_128(src, src_stride, 7, 15);
+
+    __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+    __m256i tt0, tt1, tt2, tt3, tt4, tt5, tt6, tt7;
+
+    t0 = _mm256_unpacklo_epi8(row0, row1);
+    t1 = _mm256_unpacklo_epi8(row2, row3);
+    t2 = _mm256_unpacklo_epi8(row4, row5);
+    t3 = _mm256_unpacklo_epi8(row6, row7);
+    t4 = _mm256_unpackhi_epi8(row0, row1);
+    t5 = _mm256_unpackhi_epi8(row2, row3);
+    t6 = _mm256_unpackhi_epi8(row4, row5);
+    t7 = _mm256_unpackhi_epi8(row6, row7);
+
+    tt0 = _mm256_unpacklo_epi16(t0, t1);
+    tt1 = _mm256_unpackhi_epi16(t0, t1);
+    tt2 = _mm256_unpacklo_epi16(t2, t3);
+    tt3 = _mm256_unpackhi_epi16(t2, t3);
+    tt4 = _mm256_unpacklo_epi16(t4, t5);
+    tt5 = _mm256_unpackhi_epi16(t4, t5);
+    tt6 = _mm256_unpacklo_epi16(t6, t7);
+    tt7 = _mm256_unpackhi_epi16(t6, t7);
+
+    /* Each lane now holds two 8 byte output rows, gather the halves of each row together. */
+    row0 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi32(tt0, tt2), _MM_SHUFFLE(3, 1, 2, 0));
+    row1 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi32(tt0, tt2), _MM_SHUFFLE(3, 1, 2, 0));
+    row2 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi32(tt1, tt3), _MM_SHUFFLE(3, 1, 2, 0));
+    row3 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi32(tt1, tt3), _MM_SHUFFLE(3, 1, 2, 0));
+    row4 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi32(tt4, tt6), _MM_SHUFFLE(3, 1, 2, 0));
+    row5 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi32(tt4, tt6), _MM_SHUFFLE(3, 1, 2, 0));
+    row6 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi32(tt5, tt7), _MM_SHUFFLE(3, 1, 2, 0));
+    row7 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi32(tt5, tt7), _MM_SHUFFLE(3, 1, 2, 0));
+
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 0 * dst_stride), _mm256_castsi256_si128(row0));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 1 * dst_stride), _mm256_extracti128_si256(row0, 1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 2 * dst_stride), _mm256_castsi256_si128(row1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 3 * dst_stride), _mm256_extracti128_si256(row1, 1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 4 * dst_stride), _mm256_castsi256_si128(row2));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 5 * dst_stride), _mm256_extracti128_si256(row2, 1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 6 * dst_stride), _mm256_castsi256_si128(row3));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 7 * dst_stride), _mm256_extracti128_si256(row3, 1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 8 * dst_stride), _mm256_castsi256_si128(row4));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 9 * dst_stride), _mm256_extracti128_si256(row4, 1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 10 * dst_stride), _mm256_castsi256_si128(row5));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 11 * dst_stride), _mm256_extracti128_si256(row5, 1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 12 * dst_stride), _mm256_castsi256_si128(row6));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 13 * dst_stride), _mm256_extracti128_si256(row6, 1));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 14 * dst_stride), _mm256_castsi256_si128(row7));
+    _mm_storeu_si128((__m128i *)ADD_OFFSET(dst, 15 * dst_stride), _mm256_extracti128_si256(row7, 1));
+}
+
+/* Rows i and i + 8 share a register, so each output row of 16 words is one lane-wise 8x8 transpose. */
+static void transpose_block_word(const uint16_t * VS_RESTRICT src, ptrdiff_t src_stride, uint16_t * VS_RESTRICT dst, ptrdiff_t dst_stride)
+{
+    __m256i row0 = LOAD_ROWS_128(src, src_stride, 0, 8);
+    __m256i row1 = LOAD_ROWS_128(src, src_stride, 1, 9);
+    __m256i row2 = LOAD_ROWS_128(src, src_stride, 2, 10);
+    __m256i row3 = LOAD_ROWS_128(src, src_stride, 3, 11);
+    __m256i row4 = LOAD_ROWS_128(src, src_stride, 4, 12);
+    __m256i row5 = LOAD_ROWS_128(src, src_stride, 5, 13);
+    __m256i row6 = LOAD_ROWS_128(src, src_stride, 6, 14);
+    __m256i row7 = LOAD_ROWS_128(src, src_stride, 7, 15);
+
+    __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+    __m256i tt0, tt1, tt2, tt3, tt4, tt5, tt6, tt7;
+
+    t0 = _mm256_unpacklo_epi16(row0, row1);
+    t1 = _mm256_unpacklo_epi16(row2, row3);
+    t2 = _mm256_unpacklo_epi16(row4, row5);
+    t3 = _mm256_unpacklo_epi16(row6, row7);
+    t4 = _mm256_unpackhi_epi16(row0, row1);
+    t5 = _mm256_unpackhi_epi16(row2, row3);
+    t6 = _mm256_unpackhi_epi16(row4, row5);
+    t7 = _mm256_unpackhi_epi16(row6, row7);
+
+    tt0 = _mm256_unpacklo_epi32(t0, t1);
+    tt1 = _mm256_unpackhi_epi32(t0, t1);
+    tt2 = _mm256_unpacklo_epi32(t2, t3);
+    tt3 = _mm256_unpackhi_epi32(t2, t3);
+    tt4 = _mm256_unpacklo_epi32(t4, t5);
+    tt5 = _mm256_unpackhi_epi32(t4, t5);
+    tt6 = _mm256_unpacklo_epi32(t6, t7);
+    tt7 = _mm256_unpackhi_epi32(t6, t7);
+
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 0 * dst_stride), _mm256_unpacklo_epi64(tt0, tt2));
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 1 * dst_stride), _mm256_unpackhi_epi64(tt0, tt2));
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 2 * dst_stride), _mm256_unpacklo_epi64(tt1, tt3));
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 3 * dst_stride), _mm256_unpackhi_epi64(tt1, tt3));
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 4 * dst_stride), _mm256_unpacklo_epi64(tt4, tt6));
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 5 * dst_stride), _mm256_unpackhi_epi64(tt4, tt6));
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 6 * dst_stride), _mm256_unpacklo_epi64(tt5, tt7));
+    _mm256_storeu_si256((__m256i *)ADD_OFFSET(dst, 7 * dst_stride), _mm256_unpackhi_epi64(tt5, tt7));
+}
+
+static void transpose_block_dword(const uint32_t * VS_RESTRICT src, ptrdiff_t src_stride, uint32_t * VS_RESTRICT dst, ptrdiff_t dst_stride)
+{
+    __m256 row0 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 0 * src_stride));
+    __m256 row1 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 1 * src_stride));
+    __m256 row2 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 2 * src_stride));
+    __m256 row3 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 3 * src_stride));
+    __m256 row4 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 4 * src_stride));
+    __m256 row5 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 5 * src_stride));
+    __m256 row6 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 6 * src_stride));
+    __m256 row7 = _mm256_loadu_ps((const float *)ADD_OFFSET(src, 7 * src_stride));
+
+    __m256 t0, t1, t2, t3, t4, t5, t6, t7;
+    __m256 tt0, tt1, tt2, tt3, tt4, tt5, tt6, tt7;
+
+    t0 = _mm256_unpacklo_ps(row0, row1);
+    t1 = _mm256_unpackhi_ps(row0, row1);
+    t2 = _mm256_unpacklo_ps(row2, row3);
+    t3 = _mm256_unpackhi_ps(row2, row3);
+    t4 = _mm256_unpacklo_ps(row4, row5);
+    t5 = _mm256_unpackhi_ps(row4, row5);
+    t6 = _mm256_unpacklo_ps(row6, row7);
+    t7 = _mm256_unpackhi_ps(row6, row7);
+
+    tt0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    tt1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    tt2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    tt3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    tt4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    tt5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    tt6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    tt7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 0 * dst_stride), _mm256_permute2f128_ps(tt0, tt4, 0x20));
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 1 * dst_stride), _mm256_permute2f128_ps(tt1, tt5, 0x20));
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 2 * dst_stride), _mm256_permute2f128_ps(tt2, tt6, 0x20));
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 3 * dst_stride), _mm256_permute2f128_ps(tt3, tt7, 0x20));
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 4 * dst_stride), _mm256_permute2f128_ps(tt0, tt4, 0x31));
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 5 * dst_stride), _mm256_permute2f128_ps(tt1, tt5, 0x31));
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 6 * dst_stride), _mm256_permute2f128_ps(tt2, tt6, 0x31));
+    _mm256_storeu_ps((float *)ADD_OFFSET(dst, 7 * dst_stride), _mm256_permute2f128_ps(tt3, tt7, 0x31));
+}
+
+void vs_transpose_plane_byte_avx2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height)
+{
+    transpose_plane_byte(src, src_stride, dst, dst_stride, width, height);
+}
+
+void vs_transpose_plane_word_avx2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height)
+{
+    transpose_plane_word(src, src_stride, dst, dst_stride, width, height);
+}
+
+void vs_transpose_plane_dword_avx2(const void * VS_RESTRICT src, ptrdiff_t src_stride, void * VS_RESTRICT dst, ptrdiff_t dst_stride, unsigned width, unsigned height)
+{
+    transpose_plane_dword(src, src_stride, dst, dst_stride, width, height);
+}
+
+#endif
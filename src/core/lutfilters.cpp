@@ -25,23 +25,122 @@
 #include <limits>
 #include <string>
 #include <algorithm>
+#include <type_traits>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include "internalfilters.h"
 #include "VSHelper4.h"
+#include "cpufeatures.h"
 #include "filtershared.h"
+#include "kernel/cpulevel.h"
+#include "kernel/lut.h"
 
 using namespace vsh;
 
+//////////////////////////////////////////
+// Table cache
+
+// Tables generated by calling a function are shared between all Lut and Lut2
+// instances built from the same function with the same input and output formats
+// since every call can be a slow round-trip into a script. The function id is
+// never reused so an entry can't be mistaken for one made from a freed function.
+// Entries expire when the last instance using them is freed.
+
+namespace {
+
+typedef std::tuple<uint64_t, int, int, int, int> LutTableKey; // function id, x bits, y bits (0 for Lut), output bits, output sample type
+
+class LutTableCache {
+    std::mutex lock;
+    std::map<LutTableKey, std::weak_ptr<void>> tables;
+public:
+    std::shared_ptr<void> find(const LutTableKey &key) {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = tables.find(key);
+        return it != tables.end() ? it->second.lock() : nullptr;
+    }
+
+    // Returns the already cached table if another instance got there first.
+    std::shared_ptr<void> insert(const LutTableKey &key, std::shared_ptr<void> table) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto it = tables.begin(); it != tables.end();) {
+            if (it->second.expired())
+                it = tables.erase(it);
+            else
+                ++it;
+        }
+
+        auto &entry = tables[key];
+        if (auto existing = entry.lock())
+            return existing;
+        entry = table;
+        return table;
+    }
+};
+
+LutTableCache &getTableCache() {
+    static LutTableCache cache;
+    return cache;
+}
+
+std::shared_ptr<void> allocateTable(size_t size) {
+    return std::shared_ptr<void>(malloc(size + VS_LUT_PADDING), free);
+}
+
+} // namespace
+
 //////////////////////////////////////////
 // Lut
 
+typedef void (*LutKernel)(const void *src, void *dst, const void *lut, unsigned maxval, unsigned n);
+typedef void (*Lut2Kernel)(const void *srcx, const void *srcy, void *dst, const void *lut, unsigned maxvalx, unsigned maxvaly, unsigned shift, unsigned n);
+
+static int lutOutIndex(const VSVideoFormat &fi) {
+    return (fi.sampleType == stFloat) ? 2 : (fi.bytesPerSample == 2) ? 1 : 0;
+}
+
+static LutKernel selectLutKernel(const VSVideoFormat &in, const VSVideoFormat &out, VSCore *core) {
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && vs_get_cpulevel(core) >= VS_CPU_LEVEL_AVX2) {
+        static const LutKernel kernels[2][3] = {
+            { vs_lut_byte_byte_avx2, vs_lut_byte_word_avx2, vs_lut_byte_float_avx2 },
+            { vs_lut_word_byte_avx2, vs_lut_word_word_avx2, vs_lut_word_float_avx2 }
+        };
+        return kernels[in.bytesPerSample - 1][lutOutIndex(out)];
+    }
+#endif
+    return nullptr;
+}
+
+static Lut2Kernel selectLut2Kernel(const VSVideoFormat &inx, const VSVideoFormat &iny, const VSVideoFormat &out, VSCore *core) {
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && vs_get_cpulevel(core) >= VS_CPU_LEVEL_AVX2) {
+        static const Lut2Kernel kernels[2][2][3] = {
+            {
+                { vs_lut2_byte_byte_byte_avx2, vs_lut2_byte_byte_word_avx2, vs_lut2_byte_byte_float_avx2 },
+                { vs_lut2_byte_word_byte_avx2, vs_lut2_byte_word_word_avx2, vs_lut2_byte_word_float_avx2 }
+            },
+            {
+                { vs_lut2_word_byte_byte_avx2, vs_lut2_word_byte_word_avx2, vs_lut2_word_byte_float_avx2 },
+                { vs_lut2_word_word_byte_avx2, vs_lut2_word_word_word_avx2, vs_lut2_word_word_float_avx2 }
+            }
+        };
+        return kernels[inx.bytesPerSample - 1][iny.bytesPerSample - 1][lutOutIndex(out)];
+    }
+#endif
+    return nullptr;
+}
+
 namespace {
 
 typedef struct LutDataExtra {
     VSVideoInfo vi_out;
     const VSVideoInfo *vi;
+    std::shared_ptr<void> table;
     void *lut;
     bool process[3];
-    ~LutDataExtra() { free(lut); };
+    LutKernel kernel;
 } LutDataExtra;
 
 typedef SingleNodeData<LutDataExtra> LutData;
@@ -57,15 +156,27 @@ static const VSFrame *VS_CC lutGetframe(int n, int activationReason, void *insta
     } else if (activationReason == arAllFramesReady) {
         const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         const VSVideoFormat &fi = d->vi_out.format;
+        // planes can only be skipped when they can be copied from the source
+        bool process[3] = { d->process[0], d->process[1], d->process[2] };
+        if (vsh::isSameVideoFormat(&fi, &d->vi->format))
+            getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const int pl[] = {0, 1, 2};
-        const VSFrame *fr[] = {d->process[0] ? 0 : src, d->process[1] ? 0 : src, d->process[2] ? 0 : src};
+        const VSFrame *fr[] = {process[0] ? 0 : src, process[1] ? 0 : src, process[2] ? 0 : src};
         VSFrame *dst = vsapi->newVideoFrame2(&fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
 
         T maxval = static_cast<T>((static_cast<int64_t>(1) << fi.bitsPerSample) - 1);
 
         for (int plane = 0; plane < fi.numPlanes; plane++) {
 
-            if (d->process[plane]) {
+            if (process[plane]) {
+                uint32_t value;
+                // a constant plane only needs a single lookup
+                if (vsapi->getFramePlaneConstant(src, plane, &value)) {
+                    const U *lut = reinterpret_cast<const U *>(d->lut);
+                    fillConstantPlane(dst, plane, constantBits(lut[std::min(static_cast<T>(value), maxval)]), vsapi);
+                    continue;
+                }
+
                 const T * VS_RESTRICT srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, plane));
                 ptrdiff_t src_stride = vsapi->getStride(src, plane);
                 U * VS_RESTRICT dstp = reinterpret_cast<U *>(vsapi->getWritePtr(dst, plane));
@@ -76,8 +187,12 @@ static const VSFrame *VS_CC lutGetframe(int n, int activationReason, void *insta
                 const U * VS_RESTRICT lut = reinterpret_cast<const U *>(d->lut);
 
                 for (int hl = 0; hl < h; hl++) {
-                    for (int x = 0; x < w; x++)
-                        dstp[x] =  lut[std::min(srcp[x], maxval)];
+                    if (d->kernel) {
+                        d->kernel(srcp, dstp, lut, maxval, w);
+                    } else {
+                        for (int x = 0; x < w; x++)
+                            dstp[x] =  lut[std::min(srcp[x], maxval)];
+                    }
 
                     dstp += dst_stride / sizeof(U);
                     srcp += src_stride / sizeof(T);
@@ -144,16 +259,23 @@ static void lutCreateHelper(const VSMap *in, VSMap *out, VSFunction *func, std::
     int inrange = 1 << d->vi->format.bitsPerSample;
     int maxval = 1 << d->vi_out.format.bitsPerSample;
 
-    d->lut = malloc(inrange * sizeof(U));
-
     if (func) {
-        std::string errstr;
-        funcToLut<U>(inrange, maxval, d->lut, func, vsapi, errstr);
+        LutTableKey key(vs_get_function_id(func), d->vi->format.bitsPerSample, 0, d->vi_out.format.bitsPerSample, d->vi_out.format.sampleType);
+        d->table = getTableCache().find(key);
+        if (!d->table) {
+            std::shared_ptr<void> table = allocateTable(inrange * sizeof(U));
+            std::string errstr;
+            if (!funcToLut<U>(inrange, maxval, table.get(), func, vsapi, errstr)) {
+                vsapi->freeFunction(func);
+                RETERROR(errstr.c_str());
+            }
+            d->table = getTableCache().insert(key, table);
+        }
+        d->lut = d->table.get();
         vsapi->freeFunction(func);
-
-        if (!errstr.empty())
-            RETERROR(errstr.c_str());
     } else {
+        d->table = allocateTable(inrange * sizeof(U));
+        d->lut = d->table.get();
 
         U *lut = reinterpret_cast<U *>(d->lut);
 
@@ -176,8 +298,23 @@ static void lutCreateHelper(const VSMap *in, VSMap *out, VSFunction *func, std::
         }
     }
 
+    // pass through luts that map every valid value to itself
+    if (std::is_same<T, U>::value && d->vi->format.bitsPerSample == d->vi_out.format.bitsPerSample) {
+        const U *lut = reinterpret_cast<const U *>(d->lut);
+        int i = 0;
+        while (i < inrange && lut[i] == static_cast<U>(i))
+            i++;
+
+        if (i == inrange || !(d->process[0] || d->process[1] || d->process[2])) {
+            vsapi->mapSetNode(out, "clip", d->node, maReplace);
+            return;
+        }
+    }
+
+    d->kernel = selectLutKernel(d->vi->format, d->vi_out.format, core);
+
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "Lut", &d->vi_out, lutGetframe<T, U>, filterFree<LutData>, fmParallel, deps, 1, d.get(), core);
+    createSamePlaneVideoFilter(out, "Lut", &d->vi_out, lutGetframe<T, U>, filterFree<LutData>, fmParallel, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -270,9 +407,10 @@ static void VS_CC lutCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 struct Lut2DataExtra {
     VSVideoInfo vi_out;
     const VSVideoInfo *vi[2];
+    std::shared_ptr<void> table;
     void *lut;
     bool process[3];
-    ~Lut2DataExtra() { free(lut); };
+    Lut2Kernel kernel;
 };
 
 typedef DualNodeData<Lut2DataExtra> Lut2Data;
@@ -288,8 +426,12 @@ static const VSFrame *VS_CC lut2Getframe(int n, int activationReason, void *inst
         const VSFrame *srcx = vsapi->getFrameFilter(n, d->node1, frameCtx);
         const VSFrame *srcy = vsapi->getFrameFilter(n, d->node2, frameCtx);
         const VSVideoFormat &fi = d->vi_out.format;
+        // planes can only be skipped when they can be copied from the first clip
+        bool process[3] = { d->process[0], d->process[1], d->process[2] };
+        if (vsh::isSameVideoFormat(&fi, &d->vi[0]->format))
+            getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const int pl[] = {0, 1, 2};
-        const VSFrame *fr[] = {d->process[0] ? 0 : srcx, d->process[1] ? 0 : srcx, d->process[2] ? 0 : srcx};
+        const VSFrame *fr[] = {process[0] ? 0 : srcx, process[1] ? 0 : srcx, process[2] ? 0 : srcx};
         VSFrame *dst = vsapi->newVideoFrame2(&fi, vsapi->getFrameWidth(srcx, 0), vsapi->getFrameHeight(srcx, 0), fr, pl, srcx, core);
 
         int shift = vsapi->getVideoFrameFormat(srcx)->bitsPerSample;
@@ -298,7 +440,14 @@ static const VSFrame *VS_CC lut2Getframe(int n, int activationReason, void *inst
 
         for (int plane = 0; plane < fi.numPlanes; plane++) {
 
-            if (d->process[plane]) {
+            if (process[plane]) {
+                uint32_t valuex, valuey;
+                if (vsapi->getFramePlaneConstant(srcx, plane, &valuex) && vsapi->getFramePlaneConstant(srcy, plane, &valuey)) {
+                    const V *lut = reinterpret_cast<const V *>(d->lut);
+                    fillConstantPlane(dst, plane, constantBits(lut[(std::min(static_cast<U>(valuey), maxvaly) << shift) + std::min(static_cast<T>(valuex), maxvalx)]), vsapi);
+                    continue;
+                }
+
                 const T * VS_RESTRICT srcpx = reinterpret_cast<const T *>(vsapi->getReadPtr(srcx, plane));
                 const U * VS_RESTRICT srcpy = reinterpret_cast<const U *>(vsapi->getReadPtr(srcy, plane));
                 ptrdiff_t srcx_stride = vsapi->getStride(srcx, plane);
@@ -310,8 +459,12 @@ static const VSFrame *VS_CC lut2Getframe(int n, int activationReason, void *inst
                 int w = vsapi->getFrameWidth(srcx, plane);
 
                 for (int hl = 0; hl < h; hl++) {
-                    for (int x = 0; x < w; x++)
-                        dstp[x] =  lut[(std::min(srcpy[x], maxvaly) << shift) + std::min(srcpx[x], maxvalx)];
+                    if (d->kernel) {
+                        d->kernel(srcpx, srcpy, dstp, lut, maxvalx, maxvaly, shift, w);
+                    } else {
+                        for (int x = 0; x < w; x++)
+                            dstp[x] =  lut[(std::min(srcpy[x], maxvaly) << shift) + std::min(srcpx[x], maxvalx)];
+                    }
                     srcpx += srcx_stride / sizeof(T);
                     srcpy += srcy_stride / sizeof(U);
                     dstp += dst_stride / sizeof(V);
@@ -386,16 +539,23 @@ static void lut2CreateHelper(const VSMap *in, VSMap *out, VSFunction *func, std:
     int inrange = (1 << d->vi[0]->format.bitsPerSample) * (1 << d->vi[1]->format.bitsPerSample);
     int maxval = 1 << d->vi_out.format.bitsPerSample;
 
-    d->lut = malloc(inrange * sizeof(V));
-
     if (func) {
-        std::string errstr;
-        funcToLut2<V>(1 << d->vi[0]->format.bitsPerSample, 1 << d->vi[1]->format.bitsPerSample, maxval, d->lut, func, vsapi, errstr);
+        LutTableKey key(vs_get_function_id(func), d->vi[0]->format.bitsPerSample, d->vi[1]->format.bitsPerSample, d->vi_out.format.bitsPerSample, d->vi_out.format.sampleType);
+        d->table = getTableCache().find(key);
+        if (!d->table) {
+            std::shared_ptr<void> table = allocateTable(inrange * sizeof(V));
+            std::string errstr;
+            if (!funcToLut2<V>(1 << d->vi[0]->format.bitsPerSample, 1 << d->vi[1]->format.bitsPerSample, maxval, table.get(), func, vsapi, errstr)) {
+                vsapi->freeFunction(func);
+                RETERROR(errstr.c_str());
+            }
+            d->table = getTableCache().insert(key, table);
+        }
+        d->lut = d->table.get();
         vsapi->freeFunction(func);
-
-        if (!errstr.empty())
-            RETERROR(errstr.c_str());
     } else {
+        d->table = allocateTable(inrange * sizeof(V));
+        d->lut = d->table.get();
 
         V *lut = reinterpret_cast<V *>(d->lut);
 
@@ -418,8 +578,10 @@ static void lut2CreateHelper(const VSMap *in, VSMap *out, VSFunction *func, std:
         }
     }
 
+    d->kernel = selectLut2Kernel(d->vi[0]->format, d->vi[1]->format, d->vi_out.format, core);
+
     VSFilterDependency deps[] = {{ d->node1, rpStrictSpatial }, { d->node2, (d->vi[0]->numFrames <= d->vi[1]->numFrames) ? rpStrictSpatial : rpGeneral }};
-    vsapi->createVideoFilter(out, "Lut2", &d->vi_out, lut2Getframe<T, U, V>, filterFree<Lut2Data>, fmParallel, deps, 2, d.get(), core);
+    createSamePlaneVideoFilter(out, "Lut2", &d->vi_out, lut2Getframe<T, U, V>, filterFree<Lut2Data>, fmParallel, deps, 2, d.get(), core, vsapi);
     d.release();
 }
 
@@ -35,7 +35,14 @@ using namespace vsh;
 // PreMultiply
 
 
-typedef VariableNodeData<VIPointerData> PreMultiplyData;
+typedef void (*PreMultiplyKernel)(const void *, const void *, void *, unsigned, unsigned, unsigned, unsigned);
+
+typedef struct {
+    const VSVideoInfo *vi;
+    PreMultiplyKernel func;
+} PreMultiplyDataExtra;
+
+typedef VariableNodeData<PreMultiplyDataExtra> PreMultiplyData;
 
 static int getLimitedRangeOffset(const VSFrame *f, const VSVideoInfo *vi, const VSAPI *vsapi) {
     int err;
@@ -45,6 +52,42 @@ static int getLimitedRangeOffset(const VSFrame *f, const VSVideoInfo *vi, const
     return (limited ? (16 << (vi->format.bitsPerSample - 8)) : 0);
 }
 
+static PreMultiplyKernel selectPreMultiplyKernel(const VSVideoFormat *fi, int cpulevel) {
+    PreMultiplyKernel func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_premultiply_byte_avx2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_premultiply_word_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_premultiply_float_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2 && getCPUFeatures()->f16c)
+            func = vs_premultiply_half_avx2;
+    }
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_premultiply_byte_sse2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_premultiply_word_sse2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_premultiply_float_sse2;
+    }
+#endif
+    if (!func) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_premultiply_byte_c;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_premultiply_word_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_premultiply_float_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2)
+            func = vs_premultiply_half_c;
+    }
+    return func;
+}
+
 static const VSFrame *VS_CC preMultiplyGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     PreMultiplyData *d = reinterpret_cast<PreMultiplyData *>(instanceData);
 
@@ -60,6 +103,8 @@ static const VSFrame *VS_CC preMultiplyGetFrame(int n, int activationReason, voi
         if (d->nodes[2])
             src2_23 = vsapi->getFrameFilter(n, d->nodes[2], frameCtx);
         VSFrame *dst = vsapi->newVideoFrame(&d->vi->format, d->vi->width, d->vi->height, src1, core);
+        int offset = getLimitedRangeOffset(src1, d->vi, vsapi);
+        int depth = d->vi->format.bitsPerSample;
         for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
             int h = vsapi->getFrameHeight(src1, plane);
             int w = vsapi->getFrameWidth(src1, plane);
@@ -68,71 +113,12 @@ static const VSFrame *VS_CC preMultiplyGetFrame(int n, int activationReason, voi
             const uint8_t *srcp2 = vsapi->getReadPtr(plane > 0 ? src2_23 : src2, 0);
             uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
             bool yuvhandling = (plane > 0) && (d->vi->format.colorFamily == cfYUV);
-            int offset = getLimitedRangeOffset(src1, d->vi, vsapi);
-
-            if (d->vi->format.sampleType == stInteger) {
-                if (d->vi->format.bytesPerSample == 1) {
-                    if (yuvhandling) {
-                        for (int y = 0; y < h; y++) {
-                            for (int x = 0; x < w; x++) {
-                                uint8_t s1 = srcp1[x];
-                                uint8_t s2 = srcp2[x];
-                                dstp[x] = ((((s1 - 128) * (((s2 >> 1) & 1) + s2))) >> 8) + 128;
-                            }
-                            srcp1 += stride;
-                            srcp2 += stride;
-                            dstp += stride;
-                        }
-                    } else {
-                        for (int y = 0; y < h; y++) {
-                            for (int x = 0; x < w; x++) {
-                                uint8_t s1 = srcp1[x];
-                                uint8_t s2 = srcp2[x];
-                                dstp[x] = ((((s1 - offset) * (((s2 >> 1) & 1) + s2)) + 128) >> 8) + offset;
-                            }
-                            srcp1 += stride;
-                            srcp2 += stride;
-                            dstp += stride;
-                        }
-                    }
-                } else if (d->vi->format.bytesPerSample == 2) {
-                    const unsigned shift = d->vi->format.bitsPerSample;
-                    const int halfpoint = 1 << (shift - 1);
-                    const int maxvalue = (1 << shift) - 1;
-                    if (yuvhandling) {
-                        for (int y = 0; y < h; y++) {
-                            for (int x = 0; x < w; x++) {
-                                uint16_t s1 = ((const uint16_t *)srcp1)[x];
-                                uint16_t s2 = std::min<uint16_t>(((const uint16_t *)srcp2)[x], maxvalue);
-                                ((uint16_t *)dstp)[x] = (((s1 - halfpoint) * (((s2 >> 1) & 1) + s2)) >> shift) + halfpoint;
-                            }
-                            srcp1 += stride;
-                            srcp2 += stride;
-                            dstp += stride;
-                        }
-                    } else {
-                        for (int y = 0; y < h; y++) {
-                            for (int x = 0; x < w; x++) {
-                                uint16_t s1 = ((const uint16_t *)srcp1)[x];
-                                uint16_t s2 = ((const uint16_t *)srcp2)[x];
-                                ((uint16_t *)dstp)[x] = ((((s1 - offset) * (((s2 >> 1) & 1) + s2)) + halfpoint) >> shift) + offset;
-                            }
-                            srcp1 += stride;
-                            srcp2 += stride;
-                            dstp += stride;
-                        }
-                    }
-                }
-            } else if (d->vi->format.sampleType == stFloat) {
-                if (d->vi->format.bytesPerSample == 4) {
-                    for (int y = 0; y < h; y++) {
-                        for (int x = 0; x < w; x++)
-                            ((float *)dstp)[x] = ((const float *)srcp1)[x] * ((const float *)srcp2)[x];
-                        srcp1 += stride;
-                        srcp2 += stride;
-                        dstp += stride;
-                    }
-                }
+
+            for (int y = 0; y < h; y++) {
+                d->func(srcp1, srcp2, dstp, depth, yuvhandling ? (1 << (depth - 1)) : offset, yuvhandling, w);
+                srcp1 += stride;
+                srcp2 += stride;
+                dstp += stride;
             }
         }
 
@@ -162,8 +148,8 @@ static void VS_CC preMultiplyCreate(const VSMap *in, VSMap *out, void *userData,
     if (!isConstantVideoFormat(d->vi) || !isConstantVideoFormat(alphavi) || d->vi->width != alphavi->width || d->vi->height != alphavi->height)
         RETERROR("PreMultiply: both clips must have the same constant format and dimensions");
 
-    if (!is8to16orFloatFormat(d->vi->format))
-        RETERROR("PreMultiply: only 8-16 bit integer and 32 bit float input supported");
+    if (!is8to16orHalfOrFloatFormat(d->vi->format))
+        RETERROR("PreMultiply: only 8-16 bit integer and 16/32 bit float input supported");
 
     // do we need to resample the first mask plane and use it for all the planes?
     if ((d->vi->format.numPlanes > 1) && (d->vi->format.subSamplingH > 0 || d->vi->format.subSamplingW > 0)) {
@@ -179,6 +165,8 @@ static void VS_CC preMultiplyCreate(const VSMap *in, VSMap *out, void *userData,
         d->nodes[2] = vsapi->addNodeRef(d->nodes[1]);
     }
 
+    d->func = selectPreMultiplyKernel(&d->vi->format, vs_get_cpulevel(core));
+
     VSFilterDependency deps[] = {{ d->nodes[0], rpStrictSpatial }, { d->nodes[1], (d->vi->numFrames <= vsapi->getVideoInfo(d->nodes[1])->numFrames) ? rpStrictSpatial : rpGeneral }, { d->nodes[2], (d->vi->numFrames <= vsapi->getVideoInfo(d->nodes[1])->numFrames) ? rpStrictSpatial : rpGeneral }};
     vsapi->createVideoFilter(out, "PreMultiply", d->vi, preMultiplyGetFrame, filterFree<PreMultiplyData>, fmParallel, deps, d->nodes[2] ? 3 : 2, d.get(), core);
     d.release();
@@ -187,18 +175,101 @@ static void VS_CC preMultiplyCreate(const VSMap *in, VSMap *out, void *userData,
 //////////////////////////////////////////
 // Merge
 
+typedef void (*MergeKernel)(const void *, const void *, void *, union vs_merge_weight, unsigned);
+
 typedef struct {
     const VSVideoInfo *vi;
     unsigned weight[3];
     float fweight[3];
     int process[3];
-    int cpulevel;
+    MergeKernel func;
 } MergeDataExtra;
 
 typedef DualNodeData<MergeDataExtra> MergeData;
 
 const unsigned MergeShift = 15;
 
+// the merge filters only accept constant formats so their kernels are picked once when the filter is created
+static MergeKernel selectMergeKernel(const VSVideoFormat *fi, int cpulevel) {
+    MergeKernel func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_merge_byte_avx2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_merge_word_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_merge_float_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2 && getCPUFeatures()->f16c)
+            func = vs_merge_half_avx2;
+    }
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_merge_byte_sse2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_merge_word_sse2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_merge_float_sse2;
+    }
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    if (cpulevel >= VS_CPU_LEVEL_NEON) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_merge_byte_neon;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_merge_word_neon;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_merge_float_neon;
+    }
+#endif
+    if (!func) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_merge_byte_c;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_merge_word_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_merge_float_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2)
+            func = vs_merge_half_c;
+    }
+    return func;
+}
+
+static union vs_merge_weight getMergeWeight(const MergeData *d, int plane) {
+    union vs_merge_weight weight;
+    if (d->vi->format.sampleType == stInteger)
+        weight.u = d->weight[plane];
+    else
+        weight.f = d->fweight[plane];
+    return weight;
+}
+
+// merges a single sample with the reference kernels so the result matches the optimized ones
+static bool mergeConstant(const VSVideoFormat *fi, uint32_t v1, uint32_t v2, union vs_merge_weight weight, uint32_t &result) {
+    if (fi->sampleType == stInteger && fi->bytesPerSample == 1) {
+        uint8_t a = v1, b = v2, r;
+        vs_merge_byte_c(&a, &b, &r, weight, 1);
+        result = r;
+    } else if (fi->sampleType == stInteger && fi->bytesPerSample == 2) {
+        uint16_t a = v1, b = v2, r;
+        vs_merge_word_c(&a, &b, &r, weight, 1);
+        result = r;
+    } else if (fi->sampleType == stFloat && fi->bytesPerSample == 2) {
+        uint16_t a = v1, b = v2, r;
+        vs_merge_half_c(&a, &b, &r, weight, 1);
+        result = r;
+    } else if (fi->sampleType == stFloat && fi->bytesPerSample == 4) {
+        float a, b, r;
+        memcpy(&a, &v1, sizeof(a));
+        memcpy(&b, &v2, sizeof(b));
+        vs_merge_float_c(&a, &b, &r, weight, 1);
+        result = constantBits(r);
+    } else {
+        return false;
+    }
+    return true;
+}
+
 static const VSFrame *VS_CC mergeGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     MergeData *d = reinterpret_cast<MergeData *>(instanceData);
 
@@ -209,58 +280,43 @@ static const VSFrame *VS_CC mergeGetFrame(int n, int activationReason, void *ins
         const VSFrame *src1 = vsapi->getFrameFilter(n, d->node1, frameCtx);
         const VSFrame *src2 = vsapi->getFrameFilter(n, d->node2, frameCtx);
         const int pl[] = {0, 1, 2};
+        // planes nothing reads are copied from the first clip instead of being merged
+        int demanded = vsapi->getFrameDemandedPlanes(frameCtx);
+        int process[3];
+        for (int i = 0; i < 3; i++)
+            process[i] = (demanded & (1 << i)) ? d->process[i] : 1;
+        // two constant planes are merged once, the result is shared with a source plane when it's the same
+        bool constant[3] = {};
+        uint32_t constantValue[3];
+        for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
+            uint32_t v1, v2;
+            if (process[plane] == 0 && vsapi->getFramePlaneConstant(src1, plane, &v1) && vsapi->getFramePlaneConstant(src2, plane, &v2)
+                && mergeConstant(&d->vi->format, v1, v2, getMergeWeight(d, plane), constantValue[plane])) {
+                if (constantValue[plane] == v1)
+                    process[plane] = 1;
+                else if (constantValue[plane] == v2)
+                    process[plane] = 2;
+                else
+                    constant[plane] = true;
+            }
+        }
         const VSFrame *fs[] = { 0, src1, src2 };
-        const VSFrame *fr[] = {fs[d->process[0]], fs[d->process[1]], fs[d->process[2]]};
+        const VSFrame *fr[] = {fs[process[0]], fs[process[1]], fs[process[2]]};
         VSFrame *dst = vsapi->newVideoFrame2(&d->vi->format, d->vi->width, d->vi->height, fr, pl, src1, core);
         for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
-            if (d->process[plane] == 0) {
+            if (constant[plane]) {
+                fillConstantPlane(dst, plane, constantValue[plane], vsapi);
+            } else if (process[plane] == 0) {
                 int h = vsapi->getFrameHeight(src1, plane);
                 int w = vsapi->getFrameWidth(src2, plane);
                 ptrdiff_t stride = vsapi->getStride(src1, plane);
                 const uint8_t *srcp1 = vsapi->getReadPtr(src1, plane);
                 const uint8_t *srcp2 = vsapi->getReadPtr(src2, plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
-
-                void (*func)(const void *, const void *, void *, union vs_merge_weight, unsigned) = 0;
-                union vs_merge_weight weight;
-
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_merge_byte_avx2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_merge_word_avx2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_merge_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_merge_byte_sse2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_merge_word_sse2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_merge_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_merge_byte_c;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_merge_word_c;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_merge_float_c;
-                }
-
-                if (!func)
-                    continue;
-
-                if (d->vi->format.sampleType == stInteger)
-                    weight.u = d->weight[plane];
-                else
-                    weight.f = d->fweight[plane];
+                union vs_merge_weight weight = getMergeWeight(d, plane);
 
                 for (int y = 0; y < h; ++y) {
-                    func(srcp1, srcp2, dstp, weight, w);
+                    d->func(srcp1, srcp2, dstp, weight, w);
                     srcp1 += stride;
                     srcp2 += stride;
                     dstp += stride;
@@ -317,35 +373,84 @@ static void VS_CC mergeCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         }
     }
 
-    d->cpulevel = vs_get_cpulevel(core);
-
     if (!isConstantVideoFormat(d->vi) || !isSameVideoInfo(d->vi, vsapi->getVideoInfo(d->node2)))
         RETERROR("Merge: both clips must have constant format and dimensions, and the same format and dimensions");
 
-    if (!is8to16orFloatFormat(d->vi->format))
-        RETERROR("Merge: only 8-16 bit integer and 32 bit float input supported");
+    if (!is8to16orHalfOrFloatFormat(d->vi->format))
+        RETERROR("Merge: only 8-16 bit integer and 16/32 bit float input supported");
+
+    d->func = selectMergeKernel(&d->vi->format, vs_get_cpulevel(core));
 
     if (nweight > d->vi->format.numPlanes)
         RETERROR("Merge: more weights given than the number of planes to merge");
 
     VSFilterDependency deps[] = {{d->node1, rpStrictSpatial}, {d->node2, (d->vi->numFrames <= vsapi->getVideoInfo(d->node2)->numFrames) ? rpStrictSpatial : rpGeneral}};
-    vsapi->createVideoFilter(out, "Merge", d->vi, mergeGetFrame, filterFree<MergeData>, fmParallel, deps, 2, d.get(), core);
+    createSamePlaneVideoFilter(out, "Merge", d->vi, mergeGetFrame, filterFree<MergeData>, fmParallel, deps, 2, d.get(), core, vsapi);
     d.release();
 }
 
 //////////////////////////////////////////
 // MaskedMerge
 
+typedef void (*MaskedMergeKernel)(const void *, const void *, const void *, void *, unsigned, unsigned, unsigned);
+
 typedef struct {
     const VSVideoInfo *vi;
     bool premultiplied;
+    bool premultiply;
     bool first_plane;
     bool process[3];
-    int cpulevel;
+    MaskedMergeKernel func;
+    PreMultiplyKernel premultiplyFunc;
 } MaskedMergeDataExtra;
 
 typedef VariableNodeData<MaskedMergeDataExtra> MaskedMergeData;
 
+static MaskedMergeKernel selectMaskedMergeKernel(const VSVideoFormat *fi, bool premultiplied, int cpulevel) {
+    MaskedMergeKernel func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = premultiplied ? vs_mask_merge_premul_byte_avx2 : vs_mask_merge_byte_avx2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = premultiplied ? vs_mask_merge_premul_word_avx2 : vs_mask_merge_word_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = premultiplied ? vs_mask_merge_premul_float_avx2 : vs_mask_merge_float_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2 && getCPUFeatures()->f16c)
+            func = premultiplied ? vs_mask_merge_premul_half_avx2 : vs_mask_merge_half_avx2;
+    }
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = premultiplied ? vs_mask_merge_premul_byte_sse2 : vs_mask_merge_byte_sse2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = premultiplied ? vs_mask_merge_premul_word_sse2 : vs_mask_merge_word_sse2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = premultiplied ? vs_mask_merge_premul_float_sse2 : vs_mask_merge_float_sse2;
+    }
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    if (cpulevel >= VS_CPU_LEVEL_NEON) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = premultiplied ? vs_mask_merge_premul_byte_neon : vs_mask_merge_byte_neon;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = premultiplied ? vs_mask_merge_premul_word_neon : vs_mask_merge_word_neon;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = premultiplied ? vs_mask_merge_premul_float_neon : vs_mask_merge_float_neon;
+    }
+#endif
+    if (!func) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = premultiplied ? vs_mask_merge_premul_byte_c : vs_mask_merge_byte_c;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = premultiplied ? vs_mask_merge_premul_word_c : vs_mask_merge_word_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = premultiplied ? vs_mask_merge_premul_float_c : vs_mask_merge_float_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2)
+            func = premultiplied ? vs_mask_merge_premul_half_c : vs_mask_merge_half_c;
+    }
+    return func;
+}
+
 static const VSFrame *VS_CC maskedMergeGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     MaskedMergeData *d = reinterpret_cast<MaskedMergeData *>(instanceData);
 
@@ -363,13 +468,41 @@ static const VSFrame *VS_CC maskedMergeGetFrame(int n, int activationReason, voi
         int offset1 = getLimitedRangeOffset(src1, d->vi, vsapi);
         int offset2 = getLimitedRangeOffset(src2, d->vi, vsapi);
 
-        const int pl[] = {0, 1, 2};
-        const VSFrame *fr[] = {d->process[0] ? 0 : src1, d->process[1] ? 0 : src1, d->process[2] ? 0 : src1};
-        VSFrame *dst = vsapi->newVideoFrame2(&d->vi->format, d->vi->width, d->vi->height, fr, pl, src1, core);
         if (d->nodes[3])
            mask23 = vsapi->getFrameFilter(n, d->nodes[3], frameCtx);
+
+        bool process[3];
+        getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
+        const int pl[] = {0, 1, 2};
+        const VSFrame *fr[] = {process[0] ? 0 : src1, process[1] ? 0 : src1, process[2] ? 0 : src1};
+
+        // planes where a constant mask or identical constant clips decide the result are taken from one of the clips
+        for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
+            uint32_t maskValue, v1, v2;
+            if (!process[plane] || d->premultiply)
+                continue;
+            if (vsapi->getFramePlaneConstant((plane && mask23) ? mask23 : mask, d->first_plane ? 0 : plane, &maskValue)) {
+                uint32_t maxValue;
+                if (d->vi->format.sampleType == stInteger)
+                    maxValue = (1U << d->vi->format.bitsPerSample) - 1;
+                else
+                    maxValue = (d->vi->format.bytesPerSample == 2) ? 0x3C00 : constantBits(1.0f);
+                if (maskValue == 0 && !d->premultiplied)
+                    fr[plane] = src1;
+                else if (maskValue == maxValue && (d->premultiplied || d->vi->format.sampleType == stInteger))
+                    fr[plane] = src2;
+            } else if (!d->premultiplied && vsapi->getFramePlaneConstant(src1, plane, &v1) && vsapi->getFramePlaneConstant(src2, plane, &v2) && v1 == v2) {
+                fr[plane] = src1;
+            }
+            if (fr[plane])
+                process[plane] = false;
+        }
+
+        VSFrame *dst = vsapi->newVideoFrame2(&d->vi->format, d->vi->width, d->vi->height, fr, pl, src1, core);
+        // clipb is premultiplied one row at a time right before it's merged
+        uint8_t *premultiplied = d->premultiply ? static_cast<uint8_t *>(vsapi->allocScratchMemory(vsapi->getStride(src2, 0), core)) : nullptr;
         for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
-            if (d->process[plane]) {
+            if (process[plane]) {
                 int h = vsapi->getFrameHeight(src1, plane);
                 int w = vsapi->getFrameWidth(src2, plane);
                 ptrdiff_t stride = vsapi->getStride(src1, plane);
@@ -378,7 +511,6 @@ static const VSFrame *VS_CC maskedMergeGetFrame(int n, int activationReason, voi
                 const uint8_t *maskp = vsapi->getReadPtr((plane && mask23) ? mask23 : mask, d->first_plane ? 0 : plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
 
-                void (*func)(const void *, const void *, const void *, void *, unsigned, unsigned, unsigned) = 0;
                 int yuvhandling = (plane > 0) && (d->vi->format.colorFamily == cfYUV);
 
                 if (d->premultiplied && d->vi->format.sampleType == stInteger && offset1 != offset2) {
@@ -391,40 +523,16 @@ static const VSFrame *VS_CC maskedMergeGetFrame(int n, int activationReason, voi
                     return nullptr;
                 }
 
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = d->premultiplied ? vs_mask_merge_premul_byte_avx2 : vs_mask_merge_byte_avx2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = d->premultiplied ? vs_mask_merge_premul_word_avx2 : vs_mask_merge_word_avx2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = d->premultiplied ? vs_mask_merge_premul_float_avx2 : vs_mask_merge_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = d->premultiplied ? vs_mask_merge_premul_byte_sse2 : vs_mask_merge_byte_sse2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = d->premultiplied ? vs_mask_merge_premul_word_sse2 : vs_mask_merge_word_sse2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = d->premultiplied ? vs_mask_merge_premul_float_sse2 : vs_mask_merge_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = d->premultiplied ? (yuvhandling ? vs_mask_merge_premul_byte_c : vs_mask_merge_premul_byte_c) : vs_mask_merge_byte_c;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = d->premultiplied ? (yuvhandling ? vs_mask_merge_premul_word_c : vs_mask_merge_premul_word_c) : vs_mask_merge_word_c;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = d->premultiplied ? vs_mask_merge_premul_float_c : vs_mask_merge_float_c;
-                }
-
-                if (!func)
-                    continue;
-
                 int depth = d->vi->format.bitsPerSample;
+                unsigned offset = yuvhandling ? (1 << (depth - 1)) : offset1;
 
                 for (int y = 0; y < h; y++) {
-                    func(srcp1, srcp2, maskp, dstp, depth, yuvhandling ? (1 << (depth - 1)) : offset1, w);
+                    if (premultiplied) {
+                        d->premultiplyFunc(srcp2, maskp, premultiplied, depth, offset, yuvhandling, w);
+                        d->func(srcp1, premultiplied, maskp, dstp, depth, offset, w);
+                    } else {
+                        d->func(srcp1, srcp2, maskp, dstp, depth, offset, w);
+                    }
                     srcp1 += stride;
                     srcp2 += stride;
                     maskp += stride;
@@ -455,6 +563,9 @@ static void VS_CC maskedMergeCreate(const VSMap *in, VSMap *out, void *userData,
     const VSVideoInfo *maskvi = vsapi->getVideoInfo(d->nodes[2]);
     d->first_plane = !!vsapi->mapGetInt(in, "first_plane", 0, &err);
     d->premultiplied = !!vsapi->mapGetInt(in, "premultiplied", 0, &err);
+    d->premultiply = !!vsapi->mapGetInt(in, "premultiply", 0, &err);
+    if (d->premultiply)
+        d->premultiplied = true;
     // always use the first mask plane for all planes when it is the only one
     if (maskvi->format.numPlanes == 1)
         d->first_plane = 1;
@@ -462,8 +573,8 @@ static void VS_CC maskedMergeCreate(const VSMap *in, VSMap *out, void *userData,
     if (!isConstantVideoFormat(d->vi) || !isSameVideoInfo(d->vi, vsapi->getVideoInfo(d->nodes[1])))
         RETERROR("MaskedMerge: both clips must have constant format and dimensions, and the same format and dimensions");
 
-    if (!is8to16orFloatFormat(d->vi->format))
-        RETERROR("MaskedMerge: only 8-16 bit integer and 32 bit float input supported");
+    if (!is8to16orHalfOrFloatFormat(d->vi->format))
+        RETERROR("MaskedMerge: only 8-16 bit integer and 16/32 bit float input supported");
 
     if (maskvi->width != d->vi->width || maskvi->height != d->vi->height || maskvi->format.bitsPerSample != d->vi->format.bitsPerSample
         || (!isSameVideoFormat(&maskvi->format, &d->vi->format) && maskvi->format.colorFamily != cfGray && !d->first_plane))
@@ -498,24 +609,90 @@ static void VS_CC maskedMergeCreate(const VSMap *in, VSMap *out, void *userData,
         vsapi->freeMap(min);
     }
 
-    d->cpulevel = vs_get_cpulevel(core);
+    d->func = selectMaskedMergeKernel(&d->vi->format, d->premultiplied, vs_get_cpulevel(core));
+    d->premultiplyFunc = selectPreMultiplyKernel(&d->vi->format, vs_get_cpulevel(core));
 
     VSFilterDependency deps[] = {{ d->nodes[0], rpStrictSpatial }, { d->nodes[1], (d->vi->numFrames <= vsapi->getVideoInfo(d->nodes[1])->numFrames) ? rpStrictSpatial : rpGeneral }, { d->nodes[2], (d->vi->numFrames <= vsapi->getVideoInfo(d->nodes[2])->numFrames) ? rpStrictSpatial : rpGeneral }, { d->nodes[3], (d->vi->numFrames <= vsapi->getVideoInfo(d->nodes[2])->numFrames) ? rpStrictSpatial : rpGeneral }};
     vsapi->createVideoFilter(out, "MaskedMerge", d->vi, maskedMergeGetFrame, filterFree<MaskedMergeData>, fmParallel, deps, d->nodes[3] ? 4 : 3, d.get(), core);
+
+    // the clips are read plane by plane, the mask may only have its first plane read
+    VSNode *node = vsapi->mapGetNode(out, "clip", 0, &err);
+    if (node) {
+        setSamePlaneDependencies(node, 2, vsapi);
+        if (d->first_plane) {
+            const int maskPlanes[3] = { 1, d->nodes[3] ? 0 : 1, d->nodes[3] ? 0 : 1 };
+            vsapi->setFilterPlaneDependency(node, 2, maskPlanes);
+            if (d->nodes[3]) {
+                const int mask23Planes[3] = { 0, 1, 1 };
+                vsapi->setFilterPlaneDependency(node, 3, mask23Planes);
+            }
+        } else {
+            const int maskPlanes[3] = { 1 << 0, 1 << 1, 1 << 2 };
+            vsapi->setFilterPlaneDependency(node, 2, maskPlanes);
+        }
+        vsapi->freeNode(node);
+    }
     d.release();
 }
 
 //////////////////////////////////////////
 // MakeDiff
 
+typedef void (*DiffKernel)(const void *, const void *, void *, unsigned, unsigned);
+
 typedef struct {
     const VSVideoInfo *vi;
     bool process[3];
-    int cpulevel;
+    DiffKernel func;
 } MakeDiffDataExtra;
 
 typedef DualNodeData<MakeDiffDataExtra> MakeDiffData;
 
+static DiffKernel selectMakeDiffKernel(const VSVideoFormat *fi, int cpulevel) {
+    DiffKernel func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_makediff_byte_avx2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_makediff_word_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_makediff_float_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2 && getCPUFeatures()->f16c)
+            func = vs_makediff_half_avx2;
+    }
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_makediff_byte_sse2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_makediff_word_sse2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_makediff_float_sse2;
+    }
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    if (cpulevel >= VS_CPU_LEVEL_NEON) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_makediff_byte_neon;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_makediff_word_neon;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_makediff_float_neon;
+    }
+#endif
+    if (!func) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_makediff_byte_c;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_makediff_word_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_makediff_float_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2)
+            func = vs_makediff_half_c;
+    }
+    return func;
+}
+
 static const VSFrame *VS_CC makeDiffGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     MakeDiffData *d = reinterpret_cast<MakeDiffData *>(instanceData);
 
@@ -525,11 +702,13 @@ static const VSFrame *VS_CC makeDiffGetFrame(int n, int activationReason, void *
     } else if (activationReason == arAllFramesReady) {
         const VSFrame *src1 = vsapi->getFrameFilter(n, d->node1, frameCtx);
         const VSFrame *src2 = vsapi->getFrameFilter(n, d->node2, frameCtx);
+        bool process[3];
+        getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const int pl[] = { 0, 1, 2 };
-        const VSFrame *fr[] = { d->process[0] ? 0 : src1, d->process[1] ? 0 : src1, d->process[2] ? 0 : src1 };
+        const VSFrame *fr[] = { process[0] ? 0 : src1, process[1] ? 0 : src1, process[2] ? 0 : src1 };
         VSFrame *dst = vsapi->newVideoFrame2(&d->vi->format, d->vi->width, d->vi->height, fr, pl, src1, core);
         for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
-            if (d->process[plane]) {
+            if (process[plane]) {
                 int h = vsapi->getFrameHeight(src1, plane);
                 int w = vsapi->getFrameWidth(src2, plane);
                 ptrdiff_t stride = vsapi->getStride(src1, plane);
@@ -537,42 +716,10 @@ static const VSFrame *VS_CC makeDiffGetFrame(int n, int activationReason, void *
                 const uint8_t *srcp2 = vsapi->getReadPtr(src2, plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
 
-                void (*func)(const void *, const void *, void *, unsigned, unsigned) = 0;
-
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_makediff_byte_avx2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_makediff_word_avx2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_makediff_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_makediff_byte_sse2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_makediff_word_sse2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_makediff_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_makediff_byte_c;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_makediff_word_c;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_makediff_float_c;
-                }
-
-                if (!func)
-                    continue;
-
                 int depth = d->vi->format.bitsPerSample;
 
                 for (int y = 0; y < h; ++y) {
-                    func(srcp1, srcp2, dstp, depth, w);
+                    d->func(srcp1, srcp2, dstp, depth, w);
                     srcp1 += stride;
                     srcp2 += stride;
                     dstp += stride;
@@ -598,16 +745,16 @@ static void VS_CC makeDiffCreate(const VSMap *in, VSMap *out, void *userData, VS
     if (!isConstantVideoFormat(d->vi) || !isSameVideoInfo(d->vi, vsapi->getVideoInfo(d->node2))) 
         RETERROR("MakeDiff: both clips must have constant format and dimensions, and the same format and dimensions");
 
-    if (!is8to16orFloatFormat(d->vi->format))
-        RETERROR("MakeDiff: only 8-16 bit integer and 32 bit float input supported");
+    if (!is8to16orHalfOrFloatFormat(d->vi->format))
+        RETERROR("MakeDiff: only 8-16 bit integer and 16/32 bit float input supported");
 
     if (!getProcessPlanesArg(in, out, "MakeDiff", d->process, vsapi))
         return;
 
-    d->cpulevel = vs_get_cpulevel(core);
+    d->func = selectMakeDiffKernel(&d->vi->format, vs_get_cpulevel(core));
 
     VSFilterDependency deps[] = {{d->node1, rpStrictSpatial}, {d->node2, (d->vi->numFrames <= vsapi->getVideoInfo(d->node2)->numFrames) ? rpStrictSpatial : rpGeneral}};
-    vsapi->createVideoFilter(out, "MakeDiff", d->vi, makeDiffGetFrame, filterFree<MakeDiffData>, fmParallel, deps, 2, d.get(), core);
+    createSamePlaneVideoFilter(out, "MakeDiff", d->vi, makeDiffGetFrame, filterFree<MakeDiffData>, fmParallel, deps, 2, d.get(), core, vsapi);
     d.release();
 }
 
@@ -617,11 +764,56 @@ static void VS_CC makeDiffCreate(const VSMap *in, VSMap *out, void *userData, VS
 struct MergeDiffDataExtra {
     const VSVideoInfo *vi;
     bool process[3];
-    int cpulevel;
+    DiffKernel func;
 };
 
 typedef DualNodeData<MergeDiffDataExtra> MergeDiffData;
 
+static DiffKernel selectMergeDiffKernel(const VSVideoFormat *fi, int cpulevel) {
+    DiffKernel func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_mergediff_byte_avx2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_mergediff_word_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_mergediff_float_avx2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2 && getCPUFeatures()->f16c)
+            func = vs_mergediff_half_avx2;
+    }
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_mergediff_byte_sse2;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_mergediff_word_sse2;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_mergediff_float_sse2;
+    }
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    if (cpulevel >= VS_CPU_LEVEL_NEON) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_mergediff_byte_neon;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_mergediff_word_neon;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_mergediff_float_neon;
+    }
+#endif
+    if (!func) {
+        if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+            func = vs_mergediff_byte_c;
+        else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+            func = vs_mergediff_word_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+            func = vs_mergediff_float_c;
+        else if (fi->sampleType == stFloat && fi->bytesPerSample == 2)
+            func = vs_mergediff_half_c;
+    }
+    return func;
+}
+
 static const VSFrame *VS_CC mergeDiffGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     MergeDiffData *d = reinterpret_cast<MergeDiffData *>(instanceData);
 
@@ -631,11 +823,13 @@ static const VSFrame *VS_CC mergeDiffGetFrame(int n, int activationReason, void
     } else if (activationReason == arAllFramesReady) {
         const VSFrame *src1 = vsapi->getFrameFilter(n, d->node1, frameCtx);
         const VSFrame *src2 = vsapi->getFrameFilter(n, d->node2, frameCtx);
+        bool process[3];
+        getDemandedProcessPlanes(d->process, process, frameCtx, vsapi);
         const int pl[] = { 0, 1, 2 };
-        const VSFrame *fr[] = { d->process[0] ? 0 : src1, d->process[1] ? 0 : src1, d->process[2] ? 0 : src1 };
+        const VSFrame *fr[] = { process[0] ? 0 : src1, process[1] ? 0 : src1, process[2] ? 0 : src1 };
         VSFrame *dst = vsapi->newVideoFrame2(&d->vi->format, d->vi->width, d->vi->height, fr, pl, src1, core);
         for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
-            if (d->process[plane]) {
+            if (process[plane]) {
                 int h = vsapi->getFrameHeight(src1, plane);
                 int w = vsapi->getFrameWidth(src1, plane);
                 ptrdiff_t stride = vsapi->getStride(src1, plane);
@@ -643,42 +837,10 @@ static const VSFrame *VS_CC mergeDiffGetFrame(int n, int activationReason, void
                 const uint8_t *srcp2 = vsapi->getReadPtr(src2, plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
 
-                void (*func)(const void *, const void *, void *, unsigned, unsigned) = 0;
-
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_mergediff_byte_avx2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_mergediff_word_avx2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_mergediff_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_mergediff_byte_sse2;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_mergediff_word_sse2;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_mergediff_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 1)
-                        func = vs_mergediff_byte_c;
-                    else if (d->vi->format.sampleType == stInteger && d->vi->format.bytesPerSample == 2)
-                        func = vs_mergediff_word_c;
-                    else if (d->vi->format.sampleType == stFloat && d->vi->format.bytesPerSample == 4)
-                        func = vs_mergediff_float_c;
-                }
-
-                if (!func)
-                    continue;
-
                 int depth = d->vi->format.bitsPerSample;
 
                 for (int y = 0; y < h; ++y) {
-                    func(srcp1, srcp2, dstp, depth, w);
+                    d->func(srcp1, srcp2, dstp, depth, w);
                     srcp1 += stride;
                     srcp2 += stride;
                     dstp += stride;
@@ -704,16 +866,16 @@ static void VS_CC mergeDiffCreate(const VSMap *in, VSMap *out, void *userData, V
     if (!isConstantVideoFormat(d->vi) || !isSameVideoInfo(d->vi, vsapi->getVideoInfo(d->node2)))
         RETERROR("MergeDiff: both clips must have constant format and dimensions, and the same format and dimensions");
 
-    if (!is8to16orFloatFormat(d->vi->format))
-        RETERROR("MergeDiff: only 8-16 bit integer and 32 bit float input supported");
+    if (!is8to16orHalfOrFloatFormat(d->vi->format))
+        RETERROR("MergeDiff: only 8-16 bit integer and 16/32 bit float input supported");
 
     if (!getProcessPlanesArg(in, out, "MergeDiff", d->process, vsapi))
         return;
 
-    d->cpulevel = vs_get_cpulevel(core);
+    d->func = selectMergeDiffKernel(&d->vi->format, vs_get_cpulevel(core));
 
     VSFilterDependency deps[] = {{d->node1, rpStrictSpatial}, {d->node2, (d->vi->numFrames <= vsapi->getVideoInfo(d->node2)->numFrames) ? rpStrictSpatial : rpGeneral}};
-    vsapi->createVideoFilter(out, "MergeDiff", d->vi, mergeDiffGetFrame, filterFree<MergeDiffData>, fmParallel, deps, 2, d.get(), core);
+    createSamePlaneVideoFilter(out, "MergeDiff", d->vi, mergeDiffGetFrame, filterFree<MergeDiffData>, fmParallel, deps, 2, d.get(), core, vsapi);
     d.release();
 }
 
@@ -723,7 +885,7 @@ static void VS_CC mergeDiffCreate(const VSMap *in, VSMap *out, void *userData, V
 void VS_CC mergeInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->registerFunction("PreMultiply", "clip:vnode;alpha:vnode;", "clip:vnode;", preMultiplyCreate, 0, plugin);
     vspapi->registerFunction("Merge", "clipa:vnode;clipb:vnode;weight:float[]:opt;", "clip:vnode;", mergeCreate, 0, plugin);
-    vspapi->registerFunction("MaskedMerge", "clipa:vnode;clipb:vnode;mask:vnode;planes:int[]:opt;first_plane:int:opt;premultiplied:int:opt;", "clip:vnode;", maskedMergeCreate, 0, plugin);
+    vspapi->registerFunction("MaskedMerge", "clipa:vnode;clipb:vnode;mask:vnode;planes:int[]:opt;first_plane:int:opt;premultiplied:int:opt;premultiply:int:opt;", "clip:vnode;", maskedMergeCreate, 0, plugin);
     vspapi->registerFunction("MakeDiff", "clipa:vnode;clipb:vnode;planes:int[]:opt;", "clip:vnode;", makeDiffCreate, 0, plugin);
     vspapi->registerFunction("MergeDiff", "clipa:vnode;clipb:vnode;planes:int[]:opt;", "clip:vnode;", mergeDiffCreate, 0, plugin);
 }
@@ -0,0 +1,286 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VapourSynth4.h"
+#include "VSHelper4.h"
+#include "version.h"
+#include "filtershared.h"
+#include "internalfilters.h"
+#include "../common/planecoder.h"
+#include "../common/remoteprotocol.h"
+
+//////////////////////////////////////////
+// Source
+
+// A frame request waiting for the server, it's the frame data of the request
+struct RemoteWaiter {
+    VSAsyncRequest *request;
+    const VSFrame *frame;
+};
+
+struct RemoteSourceData {
+    VSVideoInfo vi;
+    RemoteSocket socket;
+    std::thread receiver;
+    VSCore *core;
+    const VSAPI *vsapi;
+
+    // protects everything below and keeps the requests from different threads from being interleaved on the socket
+    std::mutex lock;
+    // a frame is only requested once from the server no matter how many requests wait for it
+    std::map<int, std::vector<RemoteWaiter *>> waiters;
+    std::string error;
+};
+
+static void completeWaiters(std::vector<RemoteWaiter *> &waiters, const VSFrame *f, const char *errorMessage, const VSAPI *vsapi) {
+    for (auto iter : waiters) {
+        if (f)
+            iter->frame = vsapi->addFrameRef(f);
+        vsapi->completeAsyncRequest(iter->request, errorMessage);
+    }
+}
+
+// fails everything that's waiting and every later request, the connection is gone for good
+static void failConnection(RemoteSourceData *d, const std::string &error) {
+    std::map<int, std::vector<RemoteWaiter *>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(d->lock);
+        if (d->error.empty())
+            d->error = error;
+        waiters.swap(d->waiters);
+    }
+
+    for (auto &iter : waiters)
+        completeWaiters(iter.second, nullptr, error.c_str(), d->vsapi);
+}
+
+static bool receiveFrame(RemoteSourceData *d, int n, uint64_t size, std::string &error) {
+    const VSAPI *vsapi = d->vsapi;
+    const VSVideoFormat &fi = d->vi.format;
+
+    uint32_t propsSize;
+    if (size < sizeof(propsSize) || !remoteRecv(d->socket, &propsSize, sizeof(propsSize)))
+        return false;
+    std::vector<uint8_t> props(propsSize);
+    if (!remoteRecv(d->socket, props.data(), propsSize))
+        return false;
+
+    VSFrame *f = vsapi->newVideoFrame(&fi, d->vi.width, d->vi.height, nullptr, d->core);
+    std::unique_ptr<VSFrame, decltype(vsapi->freeFrame)> frameGuard(f, vsapi->freeFrame);
+    if (!remoteReadProperties(props.data(), propsSize, vsapi->getFramePropertiesRW(f), vsapi)) {
+        error = "Remote: received invalid frame properties";
+        return false;
+    }
+
+    std::vector<uint8_t> coded;
+    for (int p = 0; p < fi.numPlanes; p++) {
+        RemotePlaneHeader header;
+        if (!remoteRecv(d->socket, &header, sizeof(header)))
+            return false;
+
+        int width = vsapi->getFrameWidth(f, p);
+        int height = vsapi->getFrameHeight(f, p);
+        size_t rowSize = static_cast<size_t>(width) * fi.bytesPerSample;
+        uint8_t *dstp = vsapi->getWritePtr(f, p);
+        ptrdiff_t stride = vsapi->getStride(f, p);
+
+        if (header.coding == rpRaw && header.size == rowSize * height) {
+            // the rows go straight into the frame
+            if (!remoteRecvRows(d->socket, dstp, stride, rowSize, height))
+                return false;
+        } else if (header.coding == rpCompressed && header.size <= planeCoderBound(width, height)) {
+            coded.resize(planeCoderBound(width, height));
+            if (!remoteRecv(d->socket, coded.data(), static_cast<size_t>(header.size)))
+                return false;
+            remoteDecompressPlane(coded.data(), dstp, stride, width, height, fi.bytesPerSample);
+        } else {
+            error = "Remote: received a plane of the wrong size";
+            return false;
+        }
+    }
+
+    std::vector<RemoteWaiter *> waiters;
+    {
+        std::lock_guard<std::mutex> lock(d->lock);
+        auto iter = d->waiters.find(n);
+        if (iter != d->waiters.end()) {
+            waiters.swap(iter->second);
+            d->waiters.erase(iter);
+        }
+    }
+
+    completeWaiters(waiters, f, nullptr, vsapi);
+    return true;
+}
+
+static void receiveFrames(RemoteSourceData *d) {
+    std::string error;
+    RemoteMessageHeader header;
+    while (remoteRecv(d->socket, &header, sizeof(header))) {
+        if (header.type == rmFrame) {
+            if (!receiveFrame(d, header.n, header.size, error))
+                break;
+        } else if (header.type == rmError && header.size < 65536) {
+            std::string message(static_cast<size_t>(header.size), '\0');
+            if (!remoteRecv(d->socket, &message[0], message.size()))
+                break;
+
+            std::vector<RemoteWaiter *> waiters;
+            {
+                std::lock_guard<std::mutex> lock(d->lock);
+                auto iter = d->waiters.find(header.n);
+                if (iter != d->waiters.end()) {
+                    waiters.swap(iter->second);
+                    d->waiters.erase(iter);
+                }
+            }
+            completeWaiters(waiters, nullptr, ("Remote: " + message).c_str(), d->vsapi);
+        } else {
+            error = "Remote: received an invalid message";
+            break;
+        }
+    }
+
+    failConnection(d, error.empty() ? "Remote: lost the connection to the server" : error);
+}
+
+static const VSFrame *VS_CC remoteSourceGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    RemoteSourceData *d = reinterpret_cast<RemoteSourceData *>(instanceData);
+    RemoteWaiter *waiter = reinterpret_cast<RemoteWaiter *>(*frameData);
+
+    if (activationReason == arInitial) {
+        std::unique_lock<std::mutex> lock(d->lock);
+        if (!d->error.empty()) {
+            vsapi->setFilterError(d->error.c_str(), frameCtx);
+            return nullptr;
+        }
+
+        waiter = new RemoteWaiter{ vsapi->beginAsyncRequest(frameCtx), nullptr };
+        *frameData = waiter;
+
+        std::vector<RemoteWaiter *> &waiting = d->waiters[n];
+        waiting.push_back(waiter);
+        if (waiting.size() == 1 && !remoteSendMessage(d->socket, rmRequest, n, nullptr, 0)) {
+            lock.unlock();
+            failConnection(d, "Remote: lost the connection to the server");
+        }
+    } else if (activationReason == arAllFramesReady) {
+        const VSFrame *f = waiter->frame;
+        delete waiter;
+        return f;
+    } else if (activationReason == arError && waiter) {
+        vsapi->freeFrame(waiter->frame);
+        delete waiter;
+    }
+
+    return nullptr;
+}
+
+static void VS_CC remoteSourceFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    RemoteSourceData *d = reinterpret_cast<RemoteSourceData *>(instanceData);
+    remoteShutdown(d->socket);
+    if (d->receiver.joinable())
+        d->receiver.join();
+    remoteClose(d->socket);
+    remoteCleanup();
+    delete d;
+}
+
+static void VS_CC remoteSourceCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    int err;
+    std::string host = vsapi->mapGetData(in, "host", 0, nullptr);
+    int port = vsapi->mapGetIntSaturated(in, "port", 0, &err);
+    if (err)
+        port = 14322;
+    bool compress = !!vsapi->mapGetInt(in, "compress", 0, &err);
+    if (err)
+        compress = true;
+
+    if (port < 1 || port > 65535)
+        RETERROR("Source: invalid port");
+
+    if (!remoteStartup())
+        RETERROR("Source: failed to initialize sockets");
+
+    std::string error;
+    RemoteSocket s = remoteConnect(host, port, error);
+    if (s == invalidRemoteSocket) {
+        remoteCleanup();
+        RETERROR(("Source: " + error).c_str());
+    }
+
+    auto fail = [&](const std::string &message) {
+        remoteClose(s);
+        remoteCleanup();
+        vsapi->mapSetError(out, ("Source: " + message).c_str());
+    };
+
+    RemoteHello hello = { remoteMagic, remoteVersion, compress ? remoteFlagCompress : 0 };
+    RemoteMessageHeader header;
+    if (!remoteSendMessage(s, rmHello, 0, &hello, sizeof(hello)) || !remoteRecv(s, &header, sizeof(header)))
+        return fail("the server closed the connection");
+
+    if (header.type == rmError && header.size < 65536) {
+        std::string message(static_cast<size_t>(header.size), '\0');
+        remoteRecv(s, &message[0], message.size());
+        return fail(message);
+    }
+
+    RemoteVideoInfo info;
+    if (header.type != rmInfo || header.size != sizeof(info) || !remoteRecv(s, &info, sizeof(info)))
+        return fail("the server doesn't speak the same protocol");
+
+    std::unique_ptr<RemoteSourceData> d(new RemoteSourceData());
+    if (!vsapi->queryVideoFormat(&d->vi.format, info.colorFamily, info.sampleType, info.bitsPerSample, info.subSamplingW, info.subSamplingH, core) || info.width <= 0 || info.height <= 0 || info.numFrames <= 0)
+        return fail("the server sent an invalid clip");
+
+    d->vi.width = info.width;
+    d->vi.height = info.height;
+    d->vi.numFrames = info.numFrames;
+    d->vi.fpsNum = info.fpsNum;
+    d->vi.fpsDen = info.fpsDen;
+    d->socket = s;
+    d->core = core;
+    d->vsapi = vsapi;
+    d->receiver = std::thread(receiveFrames, d.get());
+
+    // the server handles any number of outstanding requests so it's just as parallel as the remote graph
+    vsapi->createVideoFilter(out, "Source", &d->vi, remoteSourceGetFrame, remoteSourceFree, fmParallel, nullptr, 0, d.get(), core);
+    d.release();
+}
+
+//////////////////////////////////////////
+// Init
+
+void VS_CC remoteInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
+    vspapi->configPlugin(VSH_REMOTE_PLUGIN_ID, "remote", "VapourSynth Remote Nodes", VAPOURSYNTH_INTERNAL_PLUGIN_VERSION, VAPOURSYNTH_API_VERSION, 0, plugin);
+    vspapi->registerFunction("Source",
+        "host:data;"
+        "port:int:opt;"
+        "compress:int:opt;",
+        "clip:vnode;",
+        remoteSourceCreate, nullptr, plugin);
+}
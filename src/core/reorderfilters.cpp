@@ -31,6 +31,10 @@ using namespace vsh;
 //////////////////////////////////////////
 // Shared
 
+// Filters that would otherwise request their source frames backwards or out of order request this many of
+// them together in ascending order, the others are then found in the source's cache
+static const int requestWindowSize = 8;
+
 enum class MismatchCauses {
     Match,
     DifferentDimensions,
@@ -156,8 +160,17 @@ static void VS_CC trimCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 
     vi.numFrames = trimlen;
 
+    // a trim of a trim only needs to request frames from the original clip
+    const TrimData *inner = reinterpret_cast<const TrimData *>(vs_get_filter_instance_data(d->node, trimGetframe));
+    if (inner) {
+        VSNode *node = vsapi->addNodeRef(inner->node);
+        d->first += inner->first;
+        vsapi->freeNode(d->node);
+        d->node = node;
+    }
+
     VSFilterDependency deps[] = {{d->node, rpNoFrameReuse}};
-    vsapi->createVideoFilter(out, "Trim", &vi, trimGetframe, filterFree<TrimData>, fmParallel, deps, 1, d.release(), core);
+    createLightweightVideoFilter(out, "Trim", &vi, trimGetframe, filterFree<TrimData>, deps, 1, d.release(), core, vsapi);
 }
 
 //////////////////////////////////////////
@@ -248,9 +261,10 @@ static void VS_CC interleaveCreate(const VSMap *in, VSMap *out, void *userData,
         if (d->modifyDuration)
             muldivRational(&d->vi.fpsNum, &d->vi.fpsDen, d->numclips, 1);
 
+        // frame n / numclips is requested so it's not strict spatial and lookahead prefetching doesn't apply
         std::vector<VSFilterDependency> deps;
         for (int i = 0; i < d->numclips; i++)
-            deps.push_back({d->nodes[i], (maxNumFrames <= vsapi->getVideoInfo(d->nodes[i])->numFrames) ? rpStrictSpatial : rpGeneral});
+            deps.push_back({d->nodes[i], (maxNumFrames <= vsapi->getVideoInfo(d->nodes[i])->numFrames) ? rpNoFrameReuse : rpGeneral});
         vsapi->createVideoFilter(out, "Interleave", &d->vi, interleaveGetframe, filterFree<InterleaveData>, fmParallel, deps.data(), d->numclips, d.get(), core);
         d.release();
     }
@@ -265,7 +279,10 @@ static const VSFrame *VS_CC reverseGetframe(int n, int activationReason, void *i
     ReverseData *d = reinterpret_cast<ReverseData *>(instanceData);
 
     if (activationReason == arInitial) {
-        vsapi->requestFrameFilter(std::max(d->vi->numFrames - n - 1, 0), d->node, frameCtx);
+        int src = std::max(d->vi->numFrames - n - 1, 0);
+        int first = (n % requestWindowSize == 0) ? std::max(src - requestWindowSize + 1, 0) : src;
+        for (int i = first; i <= src; i++)
+            vsapi->requestFrameFilter(i, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
         return vsapi->getFrameFilter(std::max(d->vi->numFrames - n - 1, 0), d->node, frameCtx);
     }
@@ -279,7 +296,8 @@ static void VS_CC reverseCreate(const VSMap *in, VSMap *out, void *userData, VSC
     d->node = vsapi->mapGetNode(in, "clip", 0, 0);
     d->vi = vsapi->getVideoInfo(d->node);
 
-    VSFilterDependency deps[] = {{ d->node, rpNoFrameReuse }};
+    // the frames of a window are requested again from the cache
+    VSFilterDependency deps[] = {{ d->node, rpGeneral }};
     vsapi->createVideoFilter(out, "Reverse", d->vi, reverseGetframe, filterFree<ReverseData>, fmParallel, deps, 1, d.get(), core);
     d.release();
 }
@@ -336,8 +354,10 @@ static void VS_CC loopCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 
 typedef struct {
     std::vector<int> offsets;
+    std::vector<int> sortedOffsets; // only set when offsets isn't strictly increasing
     int cycle;
     int num;
+    int numFrames;
     bool modifyDuration;
 } SelectEveryDataExtra;
 
@@ -347,7 +367,14 @@ static const VSFrame *VS_CC selectEveryGetframe(int n, int activationReason, voi
     SelectEveryData *d = reinterpret_cast<SelectEveryData *>(instanceData);
 
     if (activationReason == arInitial) {
-        n = (n / d->num) * d->cycle + d->offsets[n % d->num];
+        int cycleStart = (n / d->num) * d->cycle;
+        // the first output of a cycle requests everything the cycle needs in ascending order
+        if (!d->sortedOffsets.empty() && n % d->num == 0) {
+            for (int offset : d->sortedOffsets)
+                if (cycleStart + offset < d->numFrames)
+                    vsapi->requestFrameFilter(cycleStart + offset, d->node, frameCtx);
+        }
+        n = cycleStart + d->offsets[n % d->num];
         frameData[0] = reinterpret_cast<void *>(static_cast<intptr_t>(n));
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
@@ -396,10 +423,20 @@ static void VS_CC selectEveryCreate(const VSMap *in, VSMap *out, void *userData,
             RETERROR("SelectEvery: invalid offset specified");
     }
 
+    bool increasing = true;
+    for (int i = 1; i < d->num; i++)
+        increasing = increasing && (d->offsets[i - 1] < d->offsets[i]);
+    if (!increasing) {
+        d->sortedOffsets = d->offsets;
+        std::sort(d->sortedOffsets.begin(), d->sortedOffsets.end());
+        d->sortedOffsets.erase(std::unique(d->sortedOffsets.begin(), d->sortedOffsets.end()), d->sortedOffsets.end());
+    }
+
     d->node = vsapi->mapGetNode(in, "clip", 0, 0);
 
     VSVideoInfo vi = *vsapi->getVideoInfo(d->node);
     int inputnframes = vi.numFrames;
+    d->numFrames = inputnframes;
     if (inputnframes) {
         vi.numFrames = (inputnframes / d->cycle) * d->num;
         for (int i = 0; i < d->num; i++)
@@ -413,7 +450,8 @@ static void VS_CC selectEveryCreate(const VSMap *in, VSMap *out, void *userData,
     if (d->modifyDuration)
         muldivRational(&vi.fpsNum, &vi.fpsDen, d->num, d->cycle);
 
-    VSFilterDependency deps[] = {{d->node, rpNoFrameReuse}};
+    // out of order and repeated offsets get their frames from the cache
+    VSFilterDependency deps[] = {{d->node, increasing ? rpNoFrameReuse : rpGeneral}};
     vsapi->createVideoFilter(out, "SelectEvery", &vi, selectEveryGetframe, filterFree<SelectEveryData>, fmParallel, deps, 1, d.release(), core);
 }
 
@@ -421,7 +459,7 @@ static void VS_CC selectEveryCreate(const VSMap *in, VSMap *out, void *userData,
 // Splice
 
 typedef struct {
-    std::vector<int> numframes;
+    std::vector<int> firstframe; // the output frame each clip starts at
     int numclips;
 } SpliceDataExtra;
 
@@ -431,19 +469,9 @@ static const VSFrame *VS_CC spliceGetframe(int n, int activationReason, void *in
     SpliceData *d = reinterpret_cast<SpliceData *>(instanceData);
 
     if (activationReason == arInitial) {
-        int frame = 0;
-        int idx = 0;
-        int cumframe = 0;
-
-        for (int i = 0; i < d->numclips; i++) {
-            if ((n >= cumframe && n < cumframe + d->numframes[i]) || i == d->numclips - 1) {
-                idx = i;
-                frame = n - cumframe;
-                break;
-            }
-
-            cumframe += d->numframes[i];
-        }
+        // the last clip starting at or before n, frames past the end are requested from the last clip
+        int idx = static_cast<int>(std::upper_bound(d->firstframe.begin() + 1, d->firstframe.end(), n) - d->firstframe.begin()) - 1;
+        int frame = n - d->firstframe[idx];
 
         frameData[0] = d->nodes[idx];
         frameData[1] = reinterpret_cast<void *>(static_cast<intptr_t>(frame));
@@ -477,18 +505,37 @@ static void VS_CC spliceCreate(const VSMap *in, VSMap *out, void *userData, VSCo
         if (mismatchCause != MismatchCauses::Match && !mismatch && !isSameVideoInfo(&vi, vsapi->getVideoInfo(d->nodes[0])))
             RETERROR(("Splice: " + mismatchToText(mismatchCause)).c_str());
 
-        d->numframes.resize(d->numclips);
         vi.numFrames = 0;
 
         for (int i = 0; i < d->numclips; i++) {
-            d->numframes[i] = (vsapi->getVideoInfo(d->nodes[i]))->numFrames;
-            vi.numFrames += d->numframes[i];
+            int numframes = (vsapi->getVideoInfo(d->nodes[i]))->numFrames;
+            vi.numFrames += numframes;
 
             // did it overflow?
-            if (vi.numFrames < d->numframes[i])
+            if (vi.numFrames < numframes)
                 RETERROR("Splice: the resulting clip is too long");
         }
 
+        // a splice of splices only needs to request frames from the innermost clips, this keeps long edit lists
+        // built one segment at a time from turning into deep chains
+        std::vector<VSNode *> flattened;
+        for (int i = 0; i < d->numclips; i++) {
+            const SpliceData *inner = reinterpret_cast<const SpliceData *>(vs_get_filter_instance_data(d->nodes[i], spliceGetframe));
+            if (inner) {
+                for (auto iter : inner->nodes)
+                    flattened.push_back(vsapi->addNodeRef(iter));
+                vsapi->freeNode(d->nodes[i]);
+            } else {
+                flattened.push_back(d->nodes[i]);
+            }
+        }
+        d->nodes = std::move(flattened);
+        d->numclips = static_cast<int>(d->nodes.size());
+
+        d->firstframe.resize(d->numclips);
+        for (int i = 1; i < d->numclips; i++)
+            d->firstframe[i] = d->firstframe[i - 1] + vsapi->getVideoInfo(d->nodes[i - 1])->numFrames;
+
         std::vector<VSFilterDependency> deps;
         for (int i = 0; i < d->numclips; i++)
             deps.push_back({ d->nodes[i], rpNoFrameReuse });
@@ -501,7 +548,7 @@ static void VS_CC spliceCreate(const VSMap *in, VSMap *out, void *userData, VSCo
 // DuplicateFrames
 
 typedef struct {
-    std::vector<int> dups;
+    std::vector<int> dups; // sorted and offset by their index so the source frame can be found with a binary search
     int num_dups;
 } DuplicateFramesDataExtra;
 
@@ -511,11 +558,7 @@ static const VSFrame *VS_CC duplicateFramesGetFrame(int n, int activationReason,
     DuplicateFramesData *d = reinterpret_cast<DuplicateFramesData *>(instanceData);
 
     if (activationReason == arInitial) {
-        for (int i = 0; i < d->num_dups; i++)
-            if (n > d->dups[i])
-                n--;
-            else
-                break;
+        n -= static_cast<int>(std::lower_bound(d->dups.begin(), d->dups.end(), n) - d->dups.begin());
 
         frameData[0] = reinterpret_cast<void *>(static_cast<intptr_t>(n));
 
@@ -551,6 +594,10 @@ static void VS_CC duplicateFramesCreate(const VSMap *in, VSMap *out, void *userD
 
     vi.numFrames += d->num_dups;
 
+    // the ith duplicate ends up at dups[i] + i in the output
+    for (int i = 0; i < d->num_dups; i++)
+        d->dups[i] += i;
+
     VSFilterDependency deps[] = {{d->node, rpGeneral}};
     vsapi->createVideoFilter(out, "DuplicateFrames", &vi, duplicateFramesGetFrame, filterFree<DuplicateFramesData>, fmParallel, deps, 1, d.release(), core);
 }
@@ -559,7 +606,7 @@ static void VS_CC duplicateFramesCreate(const VSMap *in, VSMap *out, void *userD
 // DeleteFrames
 
 typedef struct {
-    std::vector<int> del;
+    std::vector<int> del; // sorted and offset by their index so the source frame can be found with a binary search
     int num_delete;
 } DeleteFramesDataExtra;
 
@@ -569,11 +616,7 @@ static const VSFrame *VS_CC deleteFramesGetFrame(int n, int activationReason, vo
     DeleteFramesData *d = reinterpret_cast<DeleteFramesData *>(instanceData);
 
     if (activationReason == arInitial) {
-        for (int i = 0; i < d->num_delete; i++)
-            if (n >= d->del[i])
-                n++;
-            else
-                break;
+        n += static_cast<int>(std::upper_bound(d->del.begin(), d->del.end(), n) - d->del.begin());
         frameData[0] = reinterpret_cast<void *>(static_cast<intptr_t>(n));
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
@@ -613,6 +656,10 @@ static void VS_CC deleteFramesCreate(const VSMap *in, VSMap *out, void *userData
             RETERROR("DeleteFrames: can't delete all frames");
     }
 
+    // output frame n comes after the ith deleted frame when n >= del[i] - i
+    for (int i = 0; i < d->num_delete; i++)
+        d->del[i] -= i;
+
     VSFilterDependency deps[] = {{d->node, rpNoFrameReuse}};
     vsapi->createVideoFilter(out, "DeleteFrames", &vi, deleteFramesGetFrame, filterFree<DeleteFramesData>, fmParallel, deps, 1, d.release(), core);
 }
@@ -639,12 +686,10 @@ static const VSFrame *VS_CC freezeFramesGetFrame(int n, int activationReason, vo
     FreezeFramesData *d = reinterpret_cast<FreezeFramesData *>(instanceData);
 
     if (activationReason == arInitial) {
-        if (n >= d->freeze.front().first && n <= d->freeze.back().last)
-            for (auto &iter : d->freeze)
-                if (n >= iter.first && n <= iter.last) {
-                    n = iter.replacement;
-                    break;
-                }
+        // the ranges don't overlap so only the last one starting at or before n can contain it
+        auto iter = std::upper_bound(d->freeze.begin(), d->freeze.end(), n, [](int frame, const Freeze &f) { return frame < f.first; });
+        if (iter != d->freeze.begin() && n <= (--iter)->last)
+            n = iter->replacement;
 
         frameData[0] = reinterpret_cast<void *>(static_cast<intptr_t>(n));
 
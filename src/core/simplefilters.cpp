@@ -25,15 +25,32 @@
 #include <cstring>
 #include <memory>
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
 #include "VSHelper4.h"
 #include "cpufeatures.h"
 #include "internalfilters.h"
 #include "filtershared.h"
 #include "kernel/cpulevel.h"
 #include "kernel/planestats.h"
+#include "kernel/reverse.h"
 #include "kernel/transpose.h"
 #include "VapourSynth3.h" // only used for old colorfamily constant conversion in ShufflePlanes
 
+#ifdef VS_TARGET_OS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include "../common/vsutf16.h"
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace vsh;
 
 static inline uint32_t doubleToUInt32S(double v) {
@@ -44,6 +61,16 @@ static inline uint32_t doubleToUInt32S(double v) {
     return (uint32_t)(v + 0.5);
 }
 
+typedef void (*FillFunc)(void *dst, uint32_t value, size_t n);
+
+static FillFunc selectFill(int bytesPerSample, int cpulevel) {
+#ifdef VS_TARGET_CPU_X86
+    if (cpulevel >= VS_CPU_LEVEL_SSE2)
+        return (bytesPerSample == 1) ? vs_fill_byte_sse2 : (bytesPerSample == 2) ? vs_fill_word_sse2 : vs_fill_dword_sse2;
+#endif
+    return (bytesPerSample == 1) ? vs_fill_byte_c : (bytesPerSample == 2) ? vs_fill_word_c : vs_fill_dword_c;
+}
+
 static inline uint32_t bit_cast_uint32(float v) {
     uint32_t ret;
     memcpy(&ret, &v, sizeof(ret));
@@ -136,10 +163,418 @@ static inline uint16_t doubleToHalfPixelValue(double v, int *err) {
 }
 
 //////////////////////////////////////////
-// Cache compatibility filter, does nothing
+// Cache compatibility filter, does nothing unless persistent is set
+
+// With persistent the frames are written to a memory mapped file with one fixed size slot per frame and served from
+// it on later runs and cache misses. The header records a hash of the upstream graph and the clip properties and a
+// file made for anything else is started over.
+
+static const char persistentCacheMagic[8] = { 'V', 'S', 'P', 'C', 'A', 'C', 'H', '1' };
+static const size_t persistentCachePageSize = 4096;
+static const size_t persistentCacheMaxProps = 16 * 1024 - 64;
+
+struct PersistentCacheHeader {
+    char magic[8];
+    uint64_t graphHash;
+    uint32_t formatID;
+    int32_t width;
+    int32_t height;
+    int32_t numFrames;
+    uint64_t slotSize;
+};
+
+// the props and plane data follow, planes are stored without padding
+struct PersistentCacheSlot {
+    std::atomic<uint32_t> present; // set after everything else has been written
+    uint32_t propsSize;
+};
+
+static inline void hashBytes(uint64_t &h, const void *data, size_t size) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ p[i]) * UINT64_C(0x100000001B3);
+}
+
+template<typename T>
+static inline void hashValue(uint64_t &h, T v) {
+    hashBytes(h, &v, sizeof(v));
+}
+
+static inline void hashString(uint64_t &h, const char *str) {
+    size_t len = str ? strlen(str) : 0;
+    hashValue(h, len);
+    hashBytes(h, str, len);
+}
+
+// covers the filter names, creation arguments, clip properties and the shape of the graph, nodes reached more than
+// once are only hashed the first time
+static uint64_t hashUpstreamGraph(VSNode *node, std::map<VSNode *, uint64_t> &seen, const VSAPI *vsapi) {
+    auto iter = seen.find(node);
+    if (iter != seen.end())
+        return iter->second;
+
+    uint64_t h = UINT64_C(0xCBF29CE484222325);
+    hashString(h, vsapi->getNodeName(node));
+    int mediaType = vsapi->getNodeType(node);
+    hashValue(h, mediaType);
+    if (mediaType == mtVideo) {
+        const VSVideoInfo *vi = vsapi->getVideoInfo(node);
+        hashValue(h, vsapi->queryVideoFormatID(vi->format.colorFamily, vi->format.sampleType, vi->format.bitsPerSample, vi->format.subSamplingW, vi->format.subSamplingH, nullptr));
+        hashValue(h, vi->fpsNum);
+        hashValue(h, vi->fpsDen);
+        hashValue(h, vi->width);
+        hashValue(h, vi->height);
+        hashValue(h, vi->numFrames);
+    } else {
+        const VSAudioInfo *ai = vsapi->getAudioInfo(node);
+        hashValue(h, ai->format.sampleType);
+        hashValue(h, ai->format.bitsPerSample);
+        hashValue(h, ai->format.channelLayout);
+        hashValue(h, ai->sampleRate);
+        hashValue(h, ai->numSamples);
+    }
+
+    const char *funcName = vsapi->getNodeCreationFunctionName(node, 0);
+    const VSMap *args = vsapi->getNodeCreationFunctionArguments(node, 0);
+    hashString(h, funcName);
+    if (args) {
+        int numKeys = vsapi->mapNumKeys(args);
+        for (int i = 0; i < numKeys; i++) {
+            const char *key = vsapi->mapGetKey(args, i);
+            int type = vsapi->mapGetType(args, key);
+            int numElements = vsapi->mapNumElements(args, key);
+            hashString(h, key);
+            hashValue(h, type);
+            hashValue(h, numElements);
+            for (int j = 0; j < numElements; j++) {
+                switch (type) {
+                case ptInt:
+                    hashValue(h, vsapi->mapGetInt(args, key, j, nullptr));
+                    break;
+                case ptFloat:
+                    hashValue(h, vsapi->mapGetFloat(args, key, j, nullptr));
+                    break;
+                case ptData: {
+                    int size = vsapi->mapGetDataSize(args, key, j, nullptr);
+                    hashValue(h, size);
+                    hashBytes(h, vsapi->mapGetData(args, key, j, nullptr), size);
+                    break;
+                }
+                case ptVideoNode:
+                case ptAudioNode: {
+                    VSNode *arg = vsapi->mapGetNode(args, key, j, nullptr);
+                    hashValue(h, hashUpstreamGraph(arg, seen, vsapi));
+                    vsapi->freeNode(arg);
+                    break;
+                }
+                default:; // frames and functions have no stable representation
+                }
+            }
+        }
+    }
+
+    int numDeps = vsapi->getNumNodeDependencies(node);
+    const VSFilterDependency *deps = vsapi->getNodeDependencies(node);
+    for (int i = 0; i < numDeps; i++) {
+        hashValue(h, hashUpstreamGraph(deps[i].source, seen, vsapi));
+        hashValue(h, deps[i].requestPattern);
+    }
+
+    vsapi->freeMap(const_cast<VSMap *>(args));
+    seen[node] = h;
+    return h;
+}
+
+template<typename T>
+static inline void appendValue(std::vector<uint8_t> &buf, T v) {
+    size_t pos = buf.size();
+    buf.resize(pos + sizeof(v));
+    memcpy(buf.data() + pos, &v, sizeof(v));
+}
+
+// returns false for properties that can't be stored such as clips and frames
+static bool serializeFrameProps(const VSMap *props, std::vector<uint8_t> &buf, const VSAPI *vsapi) {
+    int numKeys = vsapi->mapNumKeys(props);
+    appendValue<int32_t>(buf, numKeys);
+    for (int i = 0; i < numKeys; i++) {
+        const char *key = vsapi->mapGetKey(props, i);
+        int type = vsapi->mapGetType(props, key);
+        int numElements = vsapi->mapNumElements(props, key);
+        if (type != ptInt && type != ptFloat && type != ptData)
+            return false;
+        uint32_t keyLen = static_cast<uint32_t>(strlen(key));
+        appendValue(buf, keyLen);
+        buf.insert(buf.end(), key, key + keyLen);
+        appendValue<int32_t>(buf, type);
+        appendValue<int32_t>(buf, numElements);
+        for (int j = 0; j < numElements; j++) {
+            if (type == ptInt) {
+                appendValue(buf, vsapi->mapGetInt(props, key, j, nullptr));
+            } else if (type == ptFloat) {
+                appendValue(buf, vsapi->mapGetFloat(props, key, j, nullptr));
+            } else {
+                int size = vsapi->mapGetDataSize(props, key, j, nullptr);
+                const uint8_t *data = reinterpret_cast<const uint8_t *>(vsapi->mapGetData(props, key, j, nullptr));
+                appendValue<int32_t>(buf, vsapi->mapGetDataTypeHint(props, key, j, nullptr));
+                appendValue<int32_t>(buf, size);
+                buf.insert(buf.end(), data, data + size);
+            }
+        }
+    }
+    return true;
+}
+
+template<typename T>
+static inline bool readValue(const uint8_t *&p, const uint8_t *end, T &v) {
+    if (static_cast<size_t>(end - p) < sizeof(v))
+        return false;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return true;
+}
+
+static bool deserializeFrameProps(const uint8_t *p, size_t size, VSMap *props, const VSAPI *vsapi) {
+    const uint8_t *end = p + size;
+    int32_t numKeys;
+    if (!readValue(p, end, numKeys))
+        return false;
+    for (int i = 0; i < numKeys; i++) {
+        uint32_t keyLen;
+        int32_t type, numElements;
+        if (!readValue(p, end, keyLen) || static_cast<size_t>(end - p) < keyLen)
+            return false;
+        std::string key(reinterpret_cast<const char *>(p), keyLen);
+        p += keyLen;
+        if (!readValue(p, end, type) || !readValue(p, end, numElements))
+            return false;
+        for (int j = 0; j < numElements; j++) {
+            if (type == ptInt) {
+                int64_t v;
+                if (!readValue(p, end, v))
+                    return false;
+                vsapi->mapSetInt(props, key.c_str(), v, maAppend);
+            } else if (type == ptFloat) {
+                double v;
+                if (!readValue(p, end, v))
+                    return false;
+                vsapi->mapSetFloat(props, key.c_str(), v, maAppend);
+            } else if (type == ptData) {
+                int32_t hint, dataSize;
+                if (!readValue(p, end, hint) || !readValue(p, end, dataSize) || dataSize < 0 || end - p < dataSize)
+                    return false;
+                vsapi->mapSetData(props, key.c_str(), reinterpret_cast<const char *>(p), dataSize, hint, maAppend);
+                p += dataSize;
+            } else {
+                return false;
+            }
+        }
+    }
+    return p == end;
+}
+
+struct PersistentCacheData {
+    VSNode *node = nullptr;
+    const VSVideoInfo *vi = nullptr;
+    const VSAPI *vsapi;
+    uint8_t *mapping = nullptr;
+    size_t mappingSize = 0;
+    size_t slotSize = 0;
+    size_t planeOffset[3] = {};
+#ifdef VS_TARGET_OS_WINDOWS
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#endif
+
+    explicit PersistentCacheData(const VSAPI *vsapi) noexcept : vsapi(vsapi) {
+    }
+
+    ~PersistentCacheData() {
+#ifdef VS_TARGET_OS_WINDOWS
+        if (mapping)
+            UnmapViewOfFile(mapping);
+        if (mappingHandle)
+            CloseHandle(mappingHandle);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if (mapping)
+            munmap(mapping, mappingSize);
+#endif
+        vsapi->freeNode(node);
+    }
+
+    PersistentCacheSlot *getSlot(int n) {
+        return reinterpret_cast<PersistentCacheSlot *>(mapping + persistentCachePageSize + slotSize * n);
+    }
+};
+
+// maps the whole file and throws away the old content when the size doesn't match the expected one, files that
+// weren't created by this filter are never touched
+static bool openPersistentCache(PersistentCacheData *d, const std::string &path, std::string &error) {
+    bool recreate = false;
+#ifdef VS_TARGET_OS_WINDOWS
+    d->file = CreateFileW(utf16_from_utf8(path).c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (d->file == INVALID_HANDLE_VALUE) {
+        error = "failed to open " + path + ", error: " + std::to_string(GetLastError());
+        return false;
+    }
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(d->file, &fileSize);
+    char magic[sizeof(persistentCacheMagic)] = {};
+    DWORD bytesRead = 0;
+    if (fileSize.QuadPart > 0 && (!ReadFile(d->file, magic, sizeof(magic), &bytesRead, nullptr) || bytesRead != sizeof(magic) || memcmp(magic, persistentCacheMagic, sizeof(magic)))) {
+        error = path + " exists and isn't a frame cache";
+        return false;
+    }
+    if (static_cast<uint64_t>(fileSize.QuadPart) != d->mappingSize) {
+        LARGE_INTEGER pos = {};
+        pos.QuadPart = 0;
+        bool success = SetFilePointerEx(d->file, pos, nullptr, FILE_BEGIN) && SetEndOfFile(d->file);
+        pos.QuadPart = d->mappingSize;
+        success = success && SetFilePointerEx(d->file, pos, nullptr, FILE_BEGIN) && SetEndOfFile(d->file);
+        if (!success) {
+            error = "failed to resize " + path + ", error: " + std::to_string(GetLastError());
+            return false;
+        }
+        recreate = true;
+    }
+    d->mappingHandle = CreateFileMappingW(d->file, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(d->mappingSize) >> 32), static_cast<DWORD>(d->mappingSize & 0xFFFFFFFF), nullptr);
+    if (d->mappingHandle)
+        d->mapping = reinterpret_cast<uint8_t *>(MapViewOfFile(d->mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, d->mappingSize));
+    if (!d->mapping) {
+        error = "failed to map " + path + ", error: " + std::to_string(GetLastError());
+        return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        error = "failed to open " + path + ", errno: " + std::to_string(errno);
+        return false;
+    }
+    struct stat st = {};
+    fstat(fd, &st);
+    char magic[sizeof(persistentCacheMagic)] = {};
+    if (st.st_size > 0 && (read(fd, magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, persistentCacheMagic, sizeof(magic)))) {
+        error = path + " exists and isn't a frame cache";
+        close(fd);
+        return false;
+    }
+    if (static_cast<uint64_t>(st.st_size) != d->mappingSize) {
+        if (ftruncate(fd, 0) || ftruncate(fd, d->mappingSize)) {
+            error = "failed to resize " + path + ", errno: " + std::to_string(errno);
+            close(fd);
+            return false;
+        }
+        recreate = true;
+    }
+    void *ptr = mmap(nullptr, d->mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        error = "failed to map " + path + ", errno: " + std::to_string(errno);
+        return false;
+    }
+    d->mapping = reinterpret_cast<uint8_t *>(ptr);
+#endif
+    return !recreate;
+}
+
+static const VSFrame *VS_CC persistentCacheGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    PersistentCacheData *d = reinterpret_cast<PersistentCacheData *>(instanceData);
+    PersistentCacheSlot *slot = d->getSlot(n);
+    const uint8_t *slotData = reinterpret_cast<const uint8_t *>(slot);
+
+    if (activationReason == arInitial) {
+        if (slot->present.load(std::memory_order_acquire)) {
+            VSFrame *dst = vsapi->newVideoFrame(&d->vi->format, d->vi->width, d->vi->height, nullptr, core);
+            if (deserializeFrameProps(slotData + sizeof(PersistentCacheSlot), slot->propsSize, vsapi->getFramePropertiesRW(dst), vsapi)) {
+                for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
+                    size_t rowSize = static_cast<size_t>(vsapi->getFrameWidth(dst, plane)) * d->vi->format.bytesPerSample;
+                    vsh::bitblt(vsapi->getWritePtr(dst, plane), vsapi->getStride(dst, plane), slotData + d->planeOffset[plane], rowSize, rowSize, vsapi->getFrameHeight(dst, plane));
+                }
+                return dst;
+            }
+            vsapi->freeFrame(dst);
+        }
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+
+        std::vector<uint8_t> props;
+        if (!slot->present.load(std::memory_order_acquire) && serializeFrameProps(vsapi->getFramePropertiesRO(src), props, vsapi) && props.size() <= persistentCacheMaxProps) {
+            uint8_t *dstData = reinterpret_cast<uint8_t *>(slot);
+            memcpy(dstData + sizeof(PersistentCacheSlot), props.data(), props.size());
+            slot->propsSize = static_cast<uint32_t>(props.size());
+            for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
+                size_t rowSize = static_cast<size_t>(vsapi->getFrameWidth(src, plane)) * d->vi->format.bytesPerSample;
+                vsh::bitblt(dstData + d->planeOffset[plane], rowSize, vsapi->getReadPtr(src, plane), vsapi->getStride(src, plane), rowSize, vsapi->getFrameHeight(src, plane));
+            }
+            slot->present.store(1, std::memory_order_release);
+        }
+
+        return src;
+    }
+
+    return nullptr;
+}
 
 static void VS_CC createCacheFilter(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
-    vsapi->mapConsumeNode(out, "clip", vsapi->mapGetNode(in, "clip", 0, nullptr), maAppend);
+    int err;
+    const char *persistent = vsapi->mapGetData(in, "persistent", 0, &err);
+    if (err || !persistent[0]) {
+        vsapi->mapConsumeNode(out, "clip", vsapi->mapGetNode(in, "clip", 0, nullptr), maAppend);
+        return;
+    }
+
+    std::unique_ptr<PersistentCacheData> d(new PersistentCacheData(vsapi));
+    d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
+    d->vi = vsapi->getVideoInfo(d->node);
+
+    if (!isConstantVideoFormat(d->vi))
+        RETERROR("Cache: persistent storage requires constant format and dimensions");
+
+    if (sizeof(void *) < 8)
+        RETERROR("Cache: persistent storage requires a 64 bit address space");
+
+    // without the creation arguments a changed filter argument upstream would go unnoticed and stale frames be returned
+    if (!vsapi->getNodeCreationFunctionName(d->node, 0))
+        RETERROR("Cache: persistent storage requires a core created with ccfEnableGraphInspection");
+
+    PersistentCacheHeader header = {};
+    memcpy(header.magic, persistentCacheMagic, sizeof(header.magic));
+    std::map<VSNode *, uint64_t> seen;
+    header.graphHash = hashUpstreamGraph(d->node, seen, vsapi);
+    header.formatID = vsapi->queryVideoFormatID(d->vi->format.colorFamily, d->vi->format.sampleType, d->vi->format.bitsPerSample, d->vi->format.subSamplingW, d->vi->format.subSamplingH, core);
+    header.width = d->vi->width;
+    header.height = d->vi->height;
+    header.numFrames = d->vi->numFrames;
+
+    size_t offset = sizeof(PersistentCacheSlot) + persistentCacheMaxProps;
+    for (int plane = 0; plane < d->vi->format.numPlanes; plane++) {
+        d->planeOffset[plane] = offset;
+        offset += static_cast<size_t>(planeWidth(d->vi, plane)) * d->vi->format.bytesPerSample * planeHeight(d->vi, plane);
+    }
+    d->slotSize = (offset + persistentCachePageSize - 1) / persistentCachePageSize * persistentCachePageSize;
+    header.slotSize = d->slotSize;
+    d->mappingSize = persistentCachePageSize + d->slotSize * d->vi->numFrames;
+
+    std::string error;
+    bool reuse = openPersistentCache(d.get(), persistent, error);
+    if (!d->mapping)
+        RETERROR(("Cache: " + error).c_str());
+
+    // a stale file is cleared by the resize so writing the header is all that's left to do
+    PersistentCacheHeader *mapped = reinterpret_cast<PersistentCacheHeader *>(d->mapping);
+    if (!reuse || memcmp(mapped, &header, sizeof(header))) {
+        if (reuse) {
+            for (int i = 0; i < d->vi->numFrames; i++)
+                d->getSlot(i)->present.store(0, std::memory_order_relaxed);
+        }
+        memcpy(mapped, &header, sizeof(header));
+    }
+
+    VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
+    vsapi->createVideoFilter(out, "Cache", d->vi, persistentCacheGetframe, filterFree<PersistentCacheData>, fmParallel, deps, 1, d.get(), core);
+    d.release();
 }
 
 //////////////////////////////////////////
@@ -203,16 +638,21 @@ static const VSFrame *VS_CC cropGetframe(int n, int activationReason, void *inst
             return nullptr;
         }
 
-        VSFrame *dst = vsapi->newVideoFrame(fi, d->width, d->height, src, core);
+        // views are only possible when the cropped planes stay aligned
+        VSFrame *dst = vsapi->newVideoFrameView(src, d->x, d->y, d->width, d->height, -1, src, core);
 
-        for (int plane = 0; plane < fi->numPlanes; plane++) {
-            ptrdiff_t srcstride = vsapi->getStride(src, plane);
-            ptrdiff_t dststride = vsapi->getStride(dst, plane);
-            const uint8_t *srcdata = vsapi->getReadPtr(src, plane);
-            uint8_t *dstdata = vsapi->getWritePtr(dst, plane);
-            srcdata += srcstride * (d->y >> (plane ? fi->subSamplingH : 0));
-            srcdata += (d->x >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample;
-            bitblt(dstdata, dststride, srcdata, srcstride, (d->width >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample, vsapi->getFrameHeight(dst, plane));
+        if (!dst) {
+            dst = vsapi->newVideoFrame(fi, d->width, d->height, src, core);
+
+            for (int plane = 0; plane < fi->numPlanes; plane++) {
+                ptrdiff_t srcstride = vsapi->getStride(src, plane);
+                ptrdiff_t dststride = vsapi->getStride(dst, plane);
+                const uint8_t *srcdata = vsapi->getReadPtr(src, plane);
+                uint8_t *dstdata = vsapi->getWritePtr(dst, plane);
+                srcdata += srcstride * (d->y >> (plane ? fi->subSamplingH : 0));
+                srcdata += (d->x >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample;
+                bitblt(dstdata, dststride, srcdata, srcstride, (d->width >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample, vsapi->getFrameHeight(dst, plane));
+            }
         }
 
         vsapi->freeFrame(src);
@@ -231,6 +671,42 @@ static const VSFrame *VS_CC cropGetframe(int n, int activationReason, void *inst
     return nullptr;
 }
 
+bool vs_get_crop_source(const VSNode *node, VSNode **source, int *left, int *top) {
+    const CropData *d = reinterpret_cast<const CropData *>(vs_get_filter_instance_data(node, cropGetframe));
+    if (!d || !isConstantVideoFormat(d->vi))
+        return false;
+    *source = d->node;
+    *left = d->x;
+    *top = d->y;
+    return true;
+}
+
+static void createCropFilter(std::unique_ptr<CropData> &d, VSMap *out, VSCore *core, const VSAPI *vsapi) {
+    // passthrough for the no cropping case
+    if (d->x == 0 && d->y == 0 && d->width == d->vi->width && d->height == d->vi->height) {
+        vsapi->mapSetNode(out, "clip", d->node, maReplace);
+        return;
+    }
+
+    // a crop of a crop can copy from the original clip directly, the offsets are already verified to be aligned
+    const CropData *inner = reinterpret_cast<const CropData *>(vs_get_filter_instance_data(d->node, cropGetframe));
+    if (inner && isConstantVideoFormat(inner->vi)) {
+        VSNode *node = vsapi->addNodeRef(inner->node);
+        d->x += inner->x;
+        d->y += inner->y;
+        d->vi = inner->vi;
+        vsapi->freeNode(d->node);
+        d->node = node;
+    }
+
+    VSVideoInfo vi = *d->vi;
+    vi.height = d->height;
+    vi.width = d->width;
+
+    VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
+    vsapi->createVideoFilter(out, "Crop", &vi, cropGetframe, filterFree<CropData>, fmParallel, deps, 1, d.release(), core);
+}
+
 static void VS_CC cropAbsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<CropData> d(new CropData(vsapi));
     char msg[150];
@@ -252,12 +728,7 @@ static void VS_CC cropAbsCreate(const VSMap *in, VSMap *out, void *userData, VSC
     if (cropVerify(d->x, d->y, d->width, d->height, d->vi->width, d->vi->height, &d->vi->format, msg, sizeof(msg)))
         RETERROR(msg);
 
-    VSVideoInfo vi = *d->vi;
-    vi.height = d->height;
-    vi.width = d->width;
-
-    VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "Crop", &vi, cropGetframe, filterFree<CropData>, fmParallel, deps, 1, d.release(), core);
+    createCropFilter(d, out, core, vsapi);
 }
 
 static void VS_CC cropRelCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
@@ -277,21 +748,10 @@ static void VS_CC cropRelCreate(const VSMap *in, VSMap *out, void *userData, VSC
     d->height = d->vi->height - d->y - vsapi->mapGetIntSaturated(in, "bottom", 0, &err);
     d->width = d->vi->width - d->x - vsapi->mapGetIntSaturated(in, "right", 0, &err);
 
-    // passthrough for the no cropping case
-    if (d->x == 0 && d->y == 0 && d->width == d->vi->width && d->height == d->vi->height) {
-        vsapi->mapSetNode(out, "clip", d->node, maReplace);
-        return;
-    }
-
     if (cropVerify(d->x, d->y, d->width, d->height, d->vi->width, d->vi->height, &d->vi->format, msg, sizeof(msg)))
         RETERROR(msg);
 
-    VSVideoInfo vi = *d->vi;
-    vi.height = d->height;
-    vi.width = d->width;
-
-    VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "Crop", &vi, cropGetframe, filterFree<CropData>, fmParallel, deps, 1, d.release(), core);
+    createCropFilter(d, out, core, vsapi);
 }
 
 //////////////////////////////////////////
@@ -303,6 +763,7 @@ typedef struct {
     int top;
     int bottom;
     uint32_t color[3];
+    int cpulevel;
 } AddBordersDataExtra;
 
 typedef SingleNodeData<AddBordersDataExtra> AddBordersData;
@@ -347,6 +808,7 @@ static const VSFrame *VS_CC addBordersGetframe(int n, int activationReason, void
         dst = vsapi->newVideoFrame(fi, vsapi->getFrameWidth(src, 0) + d->left + d->right, vsapi->getFrameHeight(src, 0) + d->top + d->bottom, src, core);
 
         int bytesPerSample = fi->bytesPerSample;
+        FillFunc fill = selectFill(bytesPerSample, d->cpulevel);
 
         // now that argument validation is over we can spend the next few lines actually adding borders
         for (int plane = 0; plane < fi->numPlanes; plane++) {
@@ -362,53 +824,19 @@ static const VSFrame *VS_CC addBordersGetframe(int n, int activationReason, void
             int padr = (d->right >> (plane ? fi->subSamplingW : 0)) * bytesPerSample;
             uint32_t color = d->color[plane];
 
-            switch (bytesPerSample) {
-            case 1:
-                vs_memset<uint8_t>(dstdata, color, padt * dststride);
-                break;
-            case 2:
-                vs_memset<uint16_t>(dstdata, color, padt * dststride / 2);
-                break;
-            case 4:
-                vs_memset<uint32_t>(dstdata, color, padt * dststride / 4);
-                break;
-            }
+            fill(dstdata, color, padt * dststride / bytesPerSample);
             dstdata += padt * dststride;
 
             for (int hloop = 0; hloop < srcheight; hloop++) {
-                switch (bytesPerSample) {
-                case 1:
-                    vs_memset<uint8_t>(dstdata, color, padl);
-                    memcpy(dstdata + padl, srcdata, rowsize);
-                    vs_memset<uint8_t>(dstdata + padl + rowsize, color, padr);
-                    break;
-                case 2:
-                    vs_memset<uint16_t>(dstdata, color, padl / 2);
-                    memcpy(dstdata + padl, srcdata, rowsize);
-                    vs_memset<uint16_t>(dstdata + padl + rowsize, color, padr / 2);
-                    break;
-                case 4:
-                    vs_memset<uint32_t>(dstdata, color, padl / 4);
-                    memcpy(dstdata + padl, srcdata, rowsize);
-                    vs_memset<uint32_t>(dstdata + padl + rowsize, color, padr / 4);
-                    break;
-                }
+                fill(dstdata, color, padl / bytesPerSample);
+                memcpy(dstdata + padl, srcdata, rowsize);
+                fill(dstdata + padl + rowsize, color, padr / bytesPerSample);
 
                 dstdata += dststride;
                 srcdata += srcstride;
             }
 
-            switch (bytesPerSample) {
-            case 1:
-                vs_memset<uint8_t>(dstdata, color, padb * dststride);
-                break;
-            case 2:
-                vs_memset<uint16_t>(dstdata, color, padb * dststride / 2);
-                break;
-            case 4:
-                vs_memset<uint32_t>(dstdata, color, padb * dststride / 4);
-                break;
-            }
+            fill(dstdata, color, padb * dststride / bytesPerSample);
         }
 
         vsapi->freeFrame(src);
@@ -481,6 +909,20 @@ static void VS_CC addBordersCreate(const VSMap *in, VSMap *out, void *userData,
     vi.height += vi.height ? (d->top + d->bottom) : 0;
     vi.width += vi.width ? (d->left + d->right) : 0;
 
+    // borders of the same color added to a clip with borders can be added to the original clip in one step
+    const AddBordersData *inner = reinterpret_cast<const AddBordersData *>(vs_get_filter_instance_data(d->node, addBordersGetframe));
+    if (inner && std::equal(d->color, d->color + numcomponents, inner->color)) {
+        VSNode *node = vsapi->addNodeRef(inner->node);
+        d->left += inner->left;
+        d->right += inner->right;
+        d->top += inner->top;
+        d->bottom += inner->bottom;
+        vsapi->freeNode(d->node);
+        d->node = node;
+    }
+
+    d->cpulevel = vs_get_cpulevel(core);
+
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
     vsapi->createVideoFilter(out, "AddBorders", &vi, addBordersGetframe, filterFree<AddBordersData>, fmParallel, deps, 1, d.release(), core);
 }
@@ -602,6 +1044,24 @@ static void VS_CC shufflePlanesCreate(const VSMap *in, VSMap *out, void *userDat
             RETERROR("ShufflePlanes: invalid plane specified");
     }
 
+    // planes of another shuffle can be taken from its source clips directly unless that changes the length, frame rate or
+    // which clip the frame properties come from
+    for (int i = 0; i < outplanes; i++) {
+        const ShufflePlanesData *inner = reinterpret_cast<const ShufflePlanesData *>(vs_get_filter_instance_data(d->nodes[i], shufflePlanesGetframe));
+        if (!inner)
+            continue;
+
+        VSNode *node = inner->nodes[d->plane[i]];
+        const VSVideoInfo *vi = vsapi->getVideoInfo(node);
+        if ((i == 0 && node != inner->nodes[0]) || !isConstantVideoFormat(vi) || vi->numFrames != inner->vi.numFrames || vi->fpsNum != inner->vi.fpsNum || vi->fpsDen != inner->vi.fpsDen)
+            continue;
+
+        node = vsapi->addNodeRef(node);
+        d->plane[i] = inner->plane[d->plane[i]];
+        vsapi->freeNode(d->nodes[i]);
+        d->nodes[i] = node;
+    }
+
     d->vi = *vsapi->getVideoInfo(d->nodes[0]);
 
     // compatible format checks
@@ -650,12 +1110,38 @@ static void VS_CC shufflePlanesCreate(const VSMap *in, VSMap *out, void *userDat
         vsapi->queryVideoFormat(&d->vi.format, d->format, d->vi.format.sampleType, d->vi.format.bitsPerSample, ssW, ssH, core);
     }
 
+    // pass through when all planes end up where they came from
+    bool identity = isSameVideoInfo(&d->vi, vsapi->getVideoInfo(d->nodes[0])) && d->vi.numFrames == vsapi->getVideoInfo(d->nodes[0])->numFrames;
+    for (int i = 0; i < outplanes; i++)
+        identity = identity && d->nodes[i] == d->nodes[0] && d->plane[i] == i;
+
+    if (identity) {
+        vsapi->mapSetNode(out, "clip", d->nodes[0], maReplace);
+        return;
+    }
+
     if (d->format == cfGray) {
         VSFilterDependency deps1[] = {{ d->nodes[0], rpStrictSpatial }};
         vsapi->createVideoFilter(out, "ShufflePlanes", &d->vi, shufflePlanesGetframe, filterFree<ShufflePlanesData>, fmParallel, deps1, 1, d.get(), core);
+        VSNode *node = vsapi->mapGetNode(out, "clip", 0, &err);
+        if (node) {
+            const int planes[3] = { 1 << d->plane[0], 0, 0 };
+            vsapi->setFilterPlaneDependency(node, 0, planes);
+            vsapi->freeNode(node);
+        }
     } else {
         VSFilterDependency deps3[] = {{ d->nodes[0], (d->vi.numFrames <= vsapi->getVideoInfo(d->nodes[0])->numFrames) ? rpStrictSpatial : rpGeneral }, { d->nodes[1], (d->vi.numFrames <= vsapi->getVideoInfo(d->nodes[1])->numFrames) ? rpStrictSpatial : rpGeneral }, { d->nodes[2], (d->vi.numFrames <= vsapi->getVideoInfo(d->nodes[2])->numFrames) ? rpStrictSpatial : rpGeneral }};
         vsapi->createVideoFilter(out, "ShufflePlanes", &d->vi, shufflePlanesGetframe, filterFree<ShufflePlanesData>, fmParallel, deps3, 3, d.get(), core);
+        // every output plane comes from a single plane of one clip, the first clip is still requested for its properties
+        VSNode *node = vsapi->mapGetNode(out, "clip", 0, &err);
+        if (node) {
+            for (int i = 0; i < 3; i++) {
+                int planes[3] = {};
+                planes[i] = 1 << d->plane[i];
+                vsapi->setFilterPlaneDependency(node, i, planes);
+            }
+            vsapi->freeNode(node);
+        }
     }
 
     d.release();
@@ -727,20 +1213,24 @@ static const VSFrame *VS_CC separateFieldsGetframe(int n, int activationReason,
             return nullptr;
         }
 
-        VSFrame *dst = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, src, core);
-        const VSVideoFormat *fi = vsapi->getVideoFrameFormat(dst);
+        VSFrame *dst = vsapi->newVideoFrameView(src, 0, 0, d->vi.width, d->vi.height, !((n & 1) ^ effectiveTFF), src, core);
 
-        for (int plane = 0; plane < fi->numPlanes; plane++) {
-            const uint8_t *srcp = vsapi->getReadPtr(src, plane);
-            ptrdiff_t src_stride = vsapi->getStride(src, plane);
-            uint8_t *dstp = vsapi->getWritePtr(dst, plane);
-            ptrdiff_t dst_stride = vsapi->getStride(dst, plane);
+        if (!dst) {
+            dst = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, src, core);
+            const VSVideoFormat *fi = vsapi->getVideoFrameFormat(dst);
 
-            if (!((n & 1) ^ effectiveTFF))
-                srcp += src_stride;
-            src_stride *= 2;
+            for (int plane = 0; plane < fi->numPlanes; plane++) {
+                const uint8_t *srcp = vsapi->getReadPtr(src, plane);
+                ptrdiff_t src_stride = vsapi->getStride(src, plane);
+                uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+                ptrdiff_t dst_stride = vsapi->getStride(dst, plane);
+
+                if (!((n & 1) ^ effectiveTFF))
+                    srcp += src_stride;
+                src_stride *= 2;
 
-            bitblt(dstp, dst_stride, srcp, src_stride, vsapi->getFrameWidth(dst, plane) * fi->bytesPerSample, vsapi->getFrameHeight(dst, plane));
+                bitblt(dstp, dst_stride, srcp, src_stride, vsapi->getFrameWidth(dst, plane) * fi->bytesPerSample, vsapi->getFrameHeight(dst, plane));
+            }
         }
 
         vsapi->freeFrame(src);
@@ -949,12 +1439,12 @@ static void VS_CC flipVerticalCreate(const VSMap *in, VSMap *out, void *userData
 
 typedef struct {
     bool flip;
+    int cpulevel;
 } FlipHorizontalDataExtra;
 
 typedef SingleNodeData<FlipHorizontalDataExtra> FlipHorizontalData;
 
 static const VSFrame *VS_CC flipHorizontalGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
-    // optimize, pshufb, pshufw, palignr could make flipping a lot faster
     FlipHorizontalData *d = reinterpret_cast<FlipHorizontalData *>(instanceData);
 
     if (activationReason == arInitial) {
@@ -962,6 +1452,31 @@ static const VSFrame *VS_CC flipHorizontalGetframe(int n, int activationReason,
     } else if (activationReason == arAllFramesReady) {
         const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src);
+        void (*func)(const void *, void *, unsigned) = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+        if (d->cpulevel >= VS_CPU_LEVEL_SSE2) {
+            switch (fi->bytesPerSample) {
+            case 1: func = vs_reverse_byte_sse2; break;
+            case 2: func = vs_reverse_word_sse2; break;
+            case 4: func = vs_reverse_dword_sse2; break;
+            }
+        }
+#endif
+        if (!func) {
+            switch (fi->bytesPerSample) {
+            case 1: func = vs_reverse_byte_c; break;
+            case 2: func = vs_reverse_word_c; break;
+            case 4: func = vs_reverse_dword_c; break;
+            }
+        }
+
+        if (!func) {
+            vsapi->freeFrame(src);
+            vsapi->setFilterError("FlipHorizontal: Unsupported sample size", frameCtx);
+            return nullptr;
+        }
+
         VSFrame *dst = vsapi->newVideoFrame(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), src, core);
 
         for (int plane = 0; plane < fi->numPlanes; plane++) {
@@ -970,59 +1485,18 @@ static const VSFrame *VS_CC flipHorizontalGetframe(int n, int activationReason,
             uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
             ptrdiff_t dst_stride = vsapi->getStride(dst, plane);
             int h = vsapi->getFrameHeight(src, plane);
-            int hl;
-            int w = vsapi->getFrameWidth(src, plane) - 1;
-            int x;
+            int w = vsapi->getFrameWidth(src, plane);
 
             if (d->flip) {
                 dstp += dst_stride * (h - 1);
                 dst_stride = -dst_stride;
             }
 
-            switch (fi->bytesPerSample) {
-            case 1:
-                for (hl = 0; hl < h; hl++) {
-                    for (x = 0; x <= w; x++)
-                        dstp[w - x] = srcp[x];
-
-                    dstp += dst_stride;
-                    srcp += src_stride;
-                }
-
-                break;
-            case 2:
-                for (hl = 0; hl < h; hl++) {
-                    const int16_t * VS_RESTRICT srcp16 = (const int16_t *)srcp;
-                    int16_t * VS_RESTRICT dstp16 = (int16_t *)dstp;
-
-                    for (x = 0; x <= w; x++)
-                        dstp16[w - x] = srcp16[x];
-
-                    dstp += dst_stride;
-                    srcp += src_stride;
-                }
-
-                break;
-            case 4:
-                for (hl = 0; hl < h; hl++) {
-                    const int32_t * VS_RESTRICT srcp32 = (const int32_t *)srcp;
-                    int32_t * VS_RESTRICT dstp32 = (int32_t *)dstp;
-
-                    for (x = 0; x <= w; x++)
-                        dstp32[w - x] = srcp32[x];
-
-                    dstp += dst_stride;
-                    srcp += src_stride;
-                }
-
-                break;
-            default:
-                vsapi->freeFrame(src);
-                vsapi->freeFrame(dst);
-                vsapi->setFilterError("FlipHorizontal: Unsupported sample size", frameCtx);
-                return nullptr;
+            for (int hl = 0; hl < h; hl++) {
+                func(srcp, dstp, w);
+                dstp += dst_stride;
+                srcp += src_stride;
             }
-
         }
 
         vsapi->freeFrame(src);
@@ -1037,6 +1511,7 @@ static void VS_CC flipHorizontalCreate(const VSMap *in, VSMap *out, void *userDa
     std::unique_ptr<FlipHorizontalData> d(new FlipHorizontalData(vsapi));
     d->flip = !!userData;
     d->node = vsapi->mapGetNode(in, "clip", 0, 0);
+    d->cpulevel = vs_get_cpulevel(core);
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
     vsapi->createVideoFilter(out, d->flip ? "Turn180" : "FlipHorizontal", vsapi->getVideoInfo(d->node), flipHorizontalGetframe, filterFree<FlipHorizontalData>, fmParallel, deps, 1, d.get(), core);
     d.release();
@@ -1056,11 +1531,25 @@ static const VSFrame *VS_CC stackGetframe(int n, int activationReason, void *ins
     StackData *d = reinterpret_cast<StackData *>(instanceData);
 
     if (activationReason == arInitial) {
-        for (auto iter: d->nodes)
+        // the inputs are offered their part of the output so filters allocating a new frame write their result in place
+        VSFrame *dst = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, nullptr, core);
+        frameData[0] = dst;
+
+        int offset = 0;
+        for (auto iter : d->nodes) {
             vsapi->requestFrameFilter(n, iter, frameCtx);
+            vsapi->offerFrameDestination(n, iter, dst, d->vertical ? 0 : offset, d->vertical ? offset : 0, frameCtx, core);
+            const VSVideoInfo *vi = vsapi->getVideoInfo(iter);
+            offset += d->vertical ? vi->height : vi->width;
+        }
     } else if (activationReason == arAllFramesReady) {
+        VSFrame *dst = reinterpret_cast<VSFrame *>(frameData[0]);
+        frameData[0] = nullptr;
+
         const VSFrame *src = vsapi->getFrameFilter(n, d->nodes[0], frameCtx);
-        VSFrame *dst = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, src, core);
+        VSMap *dstProps = vsapi->getFramePropertiesRW(dst);
+        vsapi->clearMap(dstProps);
+        vsapi->copyMap(vsapi->getFramePropertiesRO(src), dstProps);
         vsapi->freeFrame(src);
 
         for (int plane = 0; plane < d->vi.format.numPlanes; plane++) {
@@ -1069,20 +1558,22 @@ static const VSFrame *VS_CC stackGetframe(int n, int activationReason, void *ins
 
             for (auto iter : d->nodes) {
                 src = vsapi->getFrameFilter(n, iter, frameCtx);
+                const uint8_t *srcp = vsapi->getReadPtr(src, plane);
+                bool inPlace = (srcp == dstp);
 
                 if (d->vertical) {
-                    const uint8_t *srcp = vsapi->getReadPtr(src, plane);
                     size_t size = dst_stride * vsapi->getFrameHeight(src, plane);
-                    memcpy(dstp, srcp, size);
+                    if (!inPlace)
+                        memcpy(dstp, srcp, size);
                     dstp += size;
                 } else {
-                    const uint8_t *srcp = vsapi->getReadPtr(src, plane);
                     ptrdiff_t src_stride = vsapi->getStride(src, plane);
                     size_t rowsize = vsapi->getFrameWidth(src, plane) * d->vi.format.bytesPerSample;
-                    bitblt(dstp, dst_stride,
-                        srcp, src_stride,
-                        rowsize,
-                        vsapi->getFrameHeight(src, plane));
+                    if (!inPlace)
+                        bitblt(dstp, dst_stride,
+                            srcp, src_stride,
+                            rowsize,
+                            vsapi->getFrameHeight(src, plane));
                     dstp += rowsize;
                 }
 
@@ -1091,6 +1582,8 @@ static const VSFrame *VS_CC stackGetframe(int n, int activationReason, void *ins
         }
 
         return dst;
+    } else if (activationReason == arError) {
+        vsapi->freeFrame(reinterpret_cast<VSFrame *>(frameData[0]));
     }
 
     return nullptr;
@@ -1154,39 +1647,13 @@ static const VSFrame *VS_CC blankClipGetframe(int n, int activationReason, void
     BlankClipData *d = reinterpret_cast<BlankClipData *>(instanceData);
 
     if (activationReason == arInitial) {
-        VSFrame *frame = nullptr;
-        if (!d->f) {
-            frame = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, 0, core);
-            int bytesPerSample = d->vi.format.bytesPerSample;
-
-            for (int plane = 0; plane < d->vi.format.numPlanes; plane++) {
-                switch (bytesPerSample) {
-                case 1:
-                    vs_memset<uint8_t>(vsapi->getWritePtr(frame, plane), d->color[plane], vsapi->getStride(frame, plane) * vsapi->getFrameHeight(frame, plane));
-                    break;
-                case 2:
-                    vs_memset<uint16_t>(vsapi->getWritePtr(frame, plane), d->color[plane], (vsapi->getStride(frame, plane) * vsapi->getFrameHeight(frame, plane)) / 2);
-                    break;
-                case 4:
-                    vs_memset<uint32_t>(vsapi->getWritePtr(frame, plane), d->color[plane], (vsapi->getStride(frame, plane) * vsapi->getFrameHeight(frame, plane)) / 4);
-                    break;
-                }
-            }
-
-            if (d->vi.fpsNum > 0) {
-                VSMap *frameProps = vsapi->getFramePropertiesRW(frame);
-                vsapi->mapSetInt(frameProps, "_DurationNum", d->vi.fpsDen, maReplace);
-                vsapi->mapSetInt(frameProps, "_DurationDen", d->vi.fpsNum, maReplace);
-            }
-        }
-
-        if (d->keep) {
-            if (frame)
-                d->f = frame;
+        if (d->keep)
             return vsapi->addFrameRef(d->f);
-        } else {
-            return frame;
-        }
+
+        // a new frame that shares the already filled planes, they're only copied if someone writes to them
+        const VSFrame *fr[] = {d->f, d->f, d->f};
+        const int pl[] = {0, 1, 2};
+        return vsapi->newVideoFrame2(&d->vi.format, d->vi.width, d->vi.height, fr, pl, d->f, core);
     }
 
     return nullptr;
@@ -1313,7 +1780,21 @@ static void VS_CC blankClipCreate(const VSMap *in, VSMap *out, void *userData, V
 
     d->keep = !!vsapi->mapGetInt(in, "keep", 0, &err);
 
-    vsapi->createVideoFilter(out, "BlankClip", &d->vi, blankClipGetframe, blankClipFree, d->keep ? fmUnordered : fmParallel, nullptr, 0, d.get(), core);
+    d->f = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, nullptr, core);
+    FillFunc fill = selectFill(d->vi.format.bytesPerSample, vs_get_cpulevel(core));
+
+    for (int plane = 0; plane < d->vi.format.numPlanes; plane++) {
+        fill(vsapi->getWritePtr(d->f, plane), d->color[plane], (vsapi->getStride(d->f, plane) * vsapi->getFrameHeight(d->f, plane)) / d->vi.format.bytesPerSample);
+        vsapi->setFramePlaneConstant(d->f, plane, d->color[plane]);
+    }
+
+    if (d->vi.fpsNum > 0) {
+        VSMap *frameProps = vsapi->getFramePropertiesRW(d->f);
+        vsapi->mapSetInt(frameProps, "_DurationNum", d->vi.fpsDen, maReplace);
+        vsapi->mapSetInt(frameProps, "_DurationDen", d->vi.fpsNum, maReplace);
+    }
+
+    vsapi->createVideoFilter(out, "BlankClip", &d->vi, blankClipGetframe, blankClipFree, fmParallel, nullptr, 0, d.get(), core);
     d.release();
 }
 
@@ -1383,21 +1864,41 @@ static void VS_CC assumeFPSCreate(const VSMap *in, VSMap *out, void *userData, V
     reduceRational(&d->vi.fpsNum, &d->vi.fpsDen);
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "AssumeFPS", &d->vi, assumeFPSGetframe, filterFree<AssumeFPSData>, fmParallel, deps, 1, d.get(), core);
+    createLightweightVideoFilter(out, "AssumeFPS", &d->vi, assumeFPSGetframe, filterFree<AssumeFPSData>, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
 //////////////////////////////////////////
 // FrameEval
 
+// The number of distinct clips returned by the function that are kept referenced
+static const size_t frameEvalRememberedNodes = 8;
+
 typedef struct {
     VSVideoInfo vi;
     VSFunction *func;
     std::vector<VSNode *> propsrc;
     VSMap *in;
     VSMap *out;
+    std::vector<VSNode *> returned; // most recently returned first
 } FrameEvalData;
 
+// Keeps the clips the function returned alive so a clip it returns again still has its cache, the
+// argument maps are only accessed from one thread at a time so the same holds for this
+static void frameEvalRemember(FrameEvalData *d, VSNode *node, const VSAPI *vsapi) {
+    auto iter = std::find(d->returned.begin(), d->returned.end(), node);
+    if (iter != d->returned.end()) {
+        std::rotate(d->returned.begin(), iter, iter + 1);
+        return;
+    }
+
+    if (d->returned.size() == frameEvalRememberedNodes) {
+        vsapi->freeNode(d->returned.back());
+        d->returned.pop_back();
+    }
+    d->returned.insert(d->returned.begin(), vsapi->addNodeRef(node));
+}
+
 static const VSFrame *VS_CC frameEvalGetFrameWithProps(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     FrameEvalData *d = reinterpret_cast<FrameEvalData *>(instanceData);
 
@@ -1406,14 +1907,15 @@ static const VSFrame *VS_CC frameEvalGetFrameWithProps(int n, int activationReas
             vsapi->requestFrameFilter(n, iter, frameCtx);
     } else if (activationReason == arAllFramesReady && !*frameData) {
         int err;
-        vsapi->mapSetInt(d->in, "n", n, maAppend);
+        // the arrays in the argument map are refilled in place, only the frames are dropped after the call
+        vsapi->mapSetInt(d->in, "n", n, maReplace);
         for (auto iter : d->propsrc) {
             const VSFrame *f = vsapi->getFrameFilter(n, iter, frameCtx);
             vsapi->mapSetFrame(d->in, "f", f, maAppend);
             vsapi->freeFrame(f);
         }
         vsapi->callFunction(d->func, d->in, d->out);
-        vsapi->clearMap(d->in);
+        vsapi->mapDeleteKey(d->in, "f");
         if (vsapi->mapGetError(d->out)) {
             vsapi->setFilterError(vsapi->mapGetError(d->out), frameCtx);
             vsapi->clearMap(d->out);
@@ -1428,6 +1930,7 @@ static const VSFrame *VS_CC frameEvalGetFrameWithProps(int n, int activationReas
             return nullptr;
         }
 
+        frameEvalRemember(d, node, vsapi);
         frameData[0] = node;
 
         vsapi->requestFrameFilter(n, node, frameCtx);
@@ -1466,9 +1969,8 @@ static const VSFrame *VS_CC frameEvalGetFrameNoProps(int n, int activationReason
     if (activationReason == arInitial) {
 
         int err;
-        vsapi->mapSetInt(d->in, "n", n, maAppend);
+        vsapi->mapSetInt(d->in, "n", n, maReplace);
         vsapi->callFunction(d->func, d->in, d->out);
-        vsapi->clearMap(d->in);
         if (vsapi->mapGetError(d->out)) {
             vsapi->setFilterError(vsapi->mapGetError(d->out), frameCtx);
             vsapi->clearMap(d->out);
@@ -1483,6 +1985,7 @@ static const VSFrame *VS_CC frameEvalGetFrameNoProps(int n, int activationReason
             return nullptr;
         }
 
+        frameEvalRemember(d, node, vsapi);
         frameData[0] = node;
 
         vsapi->requestFrameFilter(n, node, frameCtx);
@@ -1518,6 +2021,8 @@ static void VS_CC frameEvalFree(void *instanceData, VSCore *core, const VSAPI *v
     FrameEvalData *d = reinterpret_cast<FrameEvalData *>(instanceData);
     for (auto iter : d->propsrc)
         vsapi->freeNode(iter);
+    for (auto iter : d->returned)
+        vsapi->freeNode(iter);
     vsapi->freeFunction(d->func);
     vsapi->freeMap(d->in);
     vsapi->freeMap(d->out);
@@ -1581,7 +2086,8 @@ static const VSFrame *VS_CC modifyFrameGetFrame(int n, int activationReason, voi
     } else if (activationReason == arAllFramesReady) {
         int err;
 
-        vsapi->mapSetInt(d->in, "n", n, maAppend);
+        // the arrays in the argument map are refilled in place, only the frames are dropped after the call
+        vsapi->mapSetInt(d->in, "n", n, maReplace);
 
         for (auto iter : d->node) {
             const VSFrame *f = vsapi->getFrameFilter(n, iter, frameCtx);
@@ -1590,7 +2096,7 @@ static const VSFrame *VS_CC modifyFrameGetFrame(int n, int activationReason, voi
         }
 
         vsapi->callFunction(d->func, d->in, d->out);
-        vsapi->clearMap(d->in);
+        vsapi->mapDeleteKey(d->in, "f");
 
         if (vsapi->mapGetError(d->out)) {
             vsapi->setFilterError(vsapi->mapGetError(d->out), frameCtx);
@@ -1684,7 +2190,13 @@ static const VSFrame *VS_CC transposeGetFrame(int n, int activationReason, void
         void (*func)(const void *, ptrdiff_t, void *, ptrdiff_t, unsigned, unsigned) = nullptr;
 
 #ifdef VS_TARGET_CPU_X86
-        if (d->cpulevel >= VS_CPU_LEVEL_SSE2) {
+        if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
+            switch (d->vi.format.bytesPerSample) {
+            case 1: func = vs_transpose_plane_byte_avx2; break;
+            case 2: func = vs_transpose_plane_word_avx2; break;
+            case 4: func = vs_transpose_plane_dword_avx2; break;
+            }
+        } else if (d->cpulevel >= VS_CPU_LEVEL_SSE2) {
             switch (d->vi.format.bytesPerSample) {
             case 1: func = vs_transpose_plane_byte_sse2; break;
             case 2: func = vs_transpose_plane_word_sse2; break;
@@ -1877,12 +2389,112 @@ typedef struct {
     std::string propMin;
     std::string propMax;
     std::string propDiff;
-    int plane;
+    std::vector<int> planes;
     int cpulevel;
 } PlaneStatsDataExtra;
 
 typedef DualNodeData<PlaneStatsDataExtra> PlaneStatsData;
 
+static decltype(&vs_plane_stats_1_byte_c) planeStatsSelect1(const VSVideoFormat *fi, int cpulevel) {
+    decltype(&vs_plane_stats_1_byte_c) func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx512_f && getCPUFeatures()->avx512_bw && getCPUFeatures()->avx512_dq && cpulevel >= VS_CPU_LEVEL_AVX512) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_1_byte_avx512; break;
+        case 2: if (fi->sampleType == stInteger) func = vs_plane_stats_1_word_avx512; break;
+        case 4: func = vs_plane_stats_1_float_avx512; break;
+        }
+    }
+    if (!func && getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_1_byte_avx2; break;
+        case 2:
+            if (fi->sampleType == stInteger)
+                func = vs_plane_stats_1_word_avx2;
+            else if (getCPUFeatures()->f16c)
+                func = vs_plane_stats_1_half_avx2;
+            break;
+        case 4: func = vs_plane_stats_1_float_avx2; break;
+        }
+    }
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_1_byte_sse2; break;
+        case 2: if (fi->sampleType == stInteger) func = vs_plane_stats_1_word_sse2; break;
+        case 4: func = vs_plane_stats_1_float_sse2; break;
+        }
+    }
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    if (cpulevel >= VS_CPU_LEVEL_NEON) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_1_byte_neon; break;
+        case 2: if (fi->sampleType == stInteger) func = vs_plane_stats_1_word_neon; break;
+        case 4: func = vs_plane_stats_1_float_neon; break;
+        }
+    }
+#endif
+    if (!func) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_1_byte_c; break;
+        case 2: func = (fi->sampleType == stInteger) ? vs_plane_stats_1_word_c : vs_plane_stats_1_half_c; break;
+        case 4: func = vs_plane_stats_1_float_c; break;
+        }
+    }
+
+    return func;
+}
+
+static decltype(&vs_plane_stats_2_byte_c) planeStatsSelect2(const VSVideoFormat *fi, int cpulevel) {
+    decltype(&vs_plane_stats_2_byte_c) func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx512_f && getCPUFeatures()->avx512_bw && getCPUFeatures()->avx512_dq && cpulevel >= VS_CPU_LEVEL_AVX512) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_avx512; break;
+        case 2: if (fi->sampleType == stInteger) func = vs_plane_stats_2_word_avx512; break;
+        case 4: func = vs_plane_stats_2_float_avx512; break;
+        }
+    }
+    if (!func && getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_avx2; break;
+        case 2:
+            if (fi->sampleType == stInteger)
+                func = vs_plane_stats_2_word_avx2;
+            else if (getCPUFeatures()->f16c)
+                func = vs_plane_stats_2_half_avx2;
+            break;
+        case 4: func = vs_plane_stats_2_float_avx2; break;
+        }
+    }
+    if (!func && cpulevel >= VS_CPU_LEVEL_SSE2) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_sse2; break;
+        case 2: if (fi->sampleType == stInteger) func = vs_plane_stats_2_word_sse2; break;
+        case 4: func = vs_plane_stats_2_float_sse2; break;
+        }
+    }
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    if (cpulevel >= VS_CPU_LEVEL_NEON) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_neon; break;
+        case 2: if (fi->sampleType == stInteger) func = vs_plane_stats_2_word_neon; break;
+        case 4: func = vs_plane_stats_2_float_neon; break;
+        }
+    }
+#endif
+    if (!func) {
+        switch (fi->bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_c; break;
+        case 2: func = (fi->sampleType == stInteger) ? vs_plane_stats_2_word_c : vs_plane_stats_2_half_c; break;
+        case 4: func = vs_plane_stats_2_float_c; break;
+        }
+    }
+
+    return func;
+}
+
 static const VSFrame *VS_CC planeStatsGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     PlaneStatsData *d = reinterpret_cast<PlaneStatsData *>(instanceData);
 
@@ -1893,102 +2505,56 @@ static const VSFrame *VS_CC planeStatsGetFrame(int n, int activationReason, void
     } else if (activationReason == arAllFramesReady) {
         const VSFrame *src1 = vsapi->getFrameFilter(n, d->node1, frameCtx);
         const VSFrame *src2 = d->node2 ? vsapi->getFrameFilter(n, d->node2, frameCtx) : nullptr;
+        // Only the properties are written, the planes stay shared with src1.
         VSFrame *dst = vsapi->copyFrame(src1, core);
         const VSVideoFormat *fi = vsapi->getVideoFrameFormat(dst);
-        int width = vsapi->getFrameWidth(src1, d->plane);
-        int height = vsapi->getFrameHeight(src1, d->plane);
-        const uint8_t *srcp = vsapi->getReadPtr(src1, d->plane);
-        ptrdiff_t src_stride = vsapi->getStride(src1, d->plane);
-        union vs_plane_stats stats = {};
+        VSMap *dstProps = vsapi->getFramePropertiesRW(dst);
+        auto func1 = planeStatsSelect1(fi, d->cpulevel);
+        auto func2 = planeStatsSelect2(fi, d->cpulevel);
 
-        if (src2) {
-            const void *srcp2 = vsapi->getReadPtr(src2, d->plane);
-            ptrdiff_t src2_stride = vsapi->getStride(src2, d->plane);
-            void (*func)(union vs_plane_stats *, const void *, ptrdiff_t, const void *, ptrdiff_t, unsigned, unsigned) = nullptr;
+        vsapi->mapDeleteKey(dstProps, d->propMin.c_str());
+        vsapi->mapDeleteKey(dstProps, d->propMax.c_str());
+        vsapi->mapDeleteKey(dstProps, d->propAverage.c_str());
+        if (d->node2)
+            vsapi->mapDeleteKey(dstProps, d->propDiff.c_str());
 
-#ifdef VS_TARGET_CPU_X86
-            if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_2_byte_avx2; break;
-                case 2: func = vs_plane_stats_2_word_avx2; break;
-                case 4: func = vs_plane_stats_2_float_avx2; break;
-                }
-            }
-            if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_2_byte_sse2; break;
-                case 2: func = vs_plane_stats_2_word_sse2; break;
-                case 4: func = vs_plane_stats_2_float_sse2; break;
-                }
-            }
-#endif
-            if (!func) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_2_byte_c; break;
-                case 2: func = vs_plane_stats_2_word_c; break;
-                case 4: func = vs_plane_stats_2_float_c; break;
-                }
-            }
+        for (int plane : d->planes) {
+            int width = vsapi->getFrameWidth(src1, plane);
+            int height = vsapi->getFrameHeight(src1, plane);
+            const uint8_t *srcp = vsapi->getReadPtr(src1, plane);
+            ptrdiff_t src_stride = vsapi->getStride(src1, plane);
+            union vs_plane_stats stats = {};
 
-            if (func)
-                func(&stats, srcp, src_stride, srcp2, src2_stride, width, height);
-        } else {
-            void (*func)(union vs_plane_stats *, const void *, ptrdiff_t, unsigned, unsigned) = nullptr;
+            if (src2)
+                func2(&stats, srcp, src_stride, vsapi->getReadPtr(src2, plane), vsapi->getStride(src2, plane), width, height);
+            else
+                func1(&stats, srcp, src_stride, width, height);
 
-#ifdef VS_TARGET_CPU_X86
-            if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_1_byte_avx2; break;
-                case 2: func = vs_plane_stats_1_word_avx2; break;
-                case 4: func = vs_plane_stats_1_float_avx2; break;
-                }
-            }
-            if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_1_byte_sse2; break;
-                case 2: func = vs_plane_stats_1_word_sse2; break;
-                case 4: func = vs_plane_stats_1_float_sse2; break;
-                }
-            }
-#endif
-            if (!func) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_1_byte_c; break;
-                case 2: func = vs_plane_stats_1_word_c; break;
-                case 4: func = vs_plane_stats_1_float_c; break;
-                }
+            if (fi->sampleType == stInteger) {
+                vsapi->mapSetInt(dstProps, d->propMin.c_str(), stats.i.min, maAppend);
+                vsapi->mapSetInt(dstProps, d->propMax.c_str(), stats.i.max, maAppend);
+            } else {
+                vsapi->mapSetFloat(dstProps, d->propMin.c_str(), stats.f.min, maAppend);
+                vsapi->mapSetFloat(dstProps, d->propMax.c_str(), stats.f.max, maAppend);
             }
 
-            if (func)
-                func(&stats, srcp, src_stride, width, height);
-        }
-
-        VSMap *dstProps = vsapi->getFramePropertiesRW(dst);
-
-        if (fi->sampleType == stInteger) {
-            vsapi->mapSetInt(dstProps, d->propMin.c_str(), stats.i.min, maReplace);
-            vsapi->mapSetInt(dstProps, d->propMax.c_str(), stats.i.max, maReplace);
-        } else {
-            vsapi->mapSetFloat(dstProps, d->propMin.c_str(), stats.f.min, maReplace);
-            vsapi->mapSetFloat(dstProps, d->propMax.c_str(), stats.f.max, maReplace);
-        }
+            double avg = 0.0;
+            double diff = 0.0;
+            if (fi->sampleType == stInteger) {
+                avg = stats.i.acc / (double)((int64_t)width * height * (((int64_t)1 << fi->bitsPerSample) - 1));
+                if (d->node2)
+                    diff = stats.i.diffacc / (double)((int64_t)width * height * (((int64_t)1 << fi->bitsPerSample) - 1));
+            } else {
+                avg = stats.f.acc / (double)((int64_t)width * height);
+                if (d->node2)
+                    diff = stats.f.diffacc / (double)((int64_t)width * height);
+            }
 
-        double avg = 0.0;
-        double diff = 0.0;
-        if (fi->sampleType == stInteger) {
-            avg = stats.i.acc / (double)((int64_t)width * height * (((int64_t)1 << fi->bitsPerSample) - 1));
-            if (d->node2)
-                diff = stats.i.diffacc / (double)((int64_t)width * height * (((int64_t)1 << fi->bitsPerSample) - 1));
-        } else {
-            avg = stats.f.acc / (double)((int64_t)width * height);
+            vsapi->mapSetFloat(dstProps, d->propAverage.c_str(), avg, maAppend);
             if (d->node2)
-                diff = stats.f.diffacc / (double)((int64_t)width * height);
+                vsapi->mapSetFloat(dstProps, d->propDiff.c_str(), diff, maAppend);
         }
 
-        vsapi->mapSetFloat(dstProps, d->propAverage.c_str(), avg, maReplace);
-        if (d->node2)
-            vsapi->mapSetFloat(dstProps, d->propDiff.c_str(), diff, maReplace);
-
         vsapi->freeFrame(src1);
         vsapi->freeFrame(src2);
         return dst;
@@ -2003,12 +2569,20 @@ static void VS_CC planeStatsCreate(const VSMap *in, VSMap *out, void *userData,
     d->node1 = vsapi->mapGetNode(in, "clipa", 0, 0);
     const VSVideoInfo *vi = vsapi->getVideoInfo(d->node1);
 
-    if (!is8to16orFloatFormat(vi->format))
-        RETERROR("PlaneStats: clip must be constant format and of integer 8-16 bit type or 32 bit float");
+    if (!is8to16orHalfOrFloatFormat(vi->format))
+        RETERROR("PlaneStats: clip must be constant format and of integer 8-16 bit type or 16/32 bit float");
 
-    d->plane = vsapi->mapGetIntSaturated(in, "plane", 0, &err);
-    if (d->plane < 0 || d->plane >= vi->format.numPlanes)
-        RETERROR("PlaneStats: invalid plane specified");
+    int numPlanes = vsapi->mapNumElements(in, "plane");
+    if (numPlanes <= 0)
+        d->planes.push_back(0);
+    for (int i = 0; i < numPlanes; i++) {
+        int plane = vsapi->mapGetIntSaturated(in, "plane", i, nullptr);
+        if (plane < 0 || plane >= vi->format.numPlanes)
+            RETERROR("PlaneStats: invalid plane specified");
+        if (std::find(d->planes.begin(), d->planes.end(), plane) != d->planes.end())
+            RETERROR("PlaneStats: plane specified twice");
+        d->planes.push_back(plane);
+    }
 
     d->node2 = vsapi->mapGetNode(in, "clipb", 0, &err);
     if (d->node2) {
@@ -2233,7 +2807,7 @@ static void VS_CC setFramePropCreate(const VSMap *in, VSMap *out, void *userData
     }
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "SetFrameProp", vsapi->getVideoInfo(d->node), setFramePropGetFrame, filterFree<SetFramePropData>, fmParallel, deps, 1, d.get(), core);
+    createLightweightVideoFilter(out, "SetFrameProp", vsapi->getVideoInfo(d->node), setFramePropGetFrame, filterFree<SetFramePropData>, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -2282,7 +2856,7 @@ static void VS_CC setFramePropsCreate(const VSMap *in, VSMap *out, void *userDat
     vsapi->mapDeleteKey(d->props, "clip");
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "SetFrameProps", vsapi->getVideoInfo(d->node), setFramePropsGetFrame, filterFree<SetFramePropsData>, fmParallel, deps, 1, d.get(), core);
+    createLightweightVideoFilter(out, "SetFrameProps", vsapi->getVideoInfo(d->node), setFramePropsGetFrame, filterFree<SetFramePropsData>, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -2335,7 +2909,7 @@ static void VS_CC removeFramePropsCreate(const VSMap *in, VSMap *out, void *user
     d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "RemoveFrameProps", vsapi->getVideoInfo(d->node), removeFramePropsGetFrame, filterFree<RemoveFramePropsData>, fmParallel, deps, 1, d.get(), core);
+    createLightweightVideoFilter(out, "RemoveFrameProps", vsapi->getVideoInfo(d->node), removeFramePropsGetFrame, filterFree<RemoveFramePropsData>, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -2377,7 +2951,7 @@ static void VS_CC setFieldBasedCreate(const VSMap *in, VSMap *out, void *userDat
     d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
 
     VSFilterDependency deps[] = {{d->node, rpStrictSpatial}};
-    vsapi->createVideoFilter(out, "SetFieldBased", vsapi->getVideoInfo(d->node), setFieldBasedGetFrame, filterFree<SetFieldBasedData>, fmParallel, deps, 1, d.get(), core);
+    createLightweightVideoFilter(out, "SetFieldBased", vsapi->getVideoInfo(d->node), setFieldBasedGetFrame, filterFree<SetFieldBasedData>, deps, 1, d.get(), core, vsapi);
     d.release();
 }
 
@@ -2414,7 +2988,7 @@ static void VS_CC copyFramePropsCreate(const VSMap *in, VSMap *out, void *userDa
     d->node2 = vsapi->mapGetNode(in, "prop_src", 0, nullptr);
 
     VSFilterDependency deps[] = {{d->node1, rpStrictSpatial}, {d->node2, (vsapi->getVideoInfo(d->node1)->numFrames <= vsapi->getVideoInfo(d->node2)->numFrames) ? rpStrictSpatial : rpGeneral}};
-    vsapi->createVideoFilter(out, "CopyFrameProps", vsapi->getVideoInfo(d->node1), copyFramePropsGetFrame, filterFree<CopyFramePropsData>, fmParallel, deps, 2, d.get(), core);
+    createLightweightVideoFilter(out, "CopyFrameProps", vsapi->getVideoInfo(d->node1), copyFramePropsGetFrame, filterFree<CopyFramePropsData>, deps, 2, d.get(), core, vsapi);
     d.release();
 }
 
@@ -2454,7 +3028,7 @@ static void VS_CC setMaxCpu(const VSMap *in, VSMap *out, void *userData, VSCore
 // Init
 
 void VS_CC stdlibInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
-    vspapi->registerFunction("Cache", "clip:vnode;size:int:opt;fixed:int:opt;make_linear:int:opt;", "clip:vnode;", createCacheFilter, nullptr, plugin); 
+    vspapi->registerFunction("Cache", "clip:vnode;size:int:opt;fixed:int:opt;make_linear:int:opt;persistent:data:opt;", "clip:vnode;", createCacheFilter, nullptr, plugin); 
     vspapi->registerFunction("CropAbs", "clip:vnode;width:int;height:int;left:int:opt;top:int:opt;x:int:opt;y:int:opt;", "clip:vnode;", cropAbsCreate, 0, plugin);
     vspapi->registerFunction("CropRel", "clip:vnode;left:int:opt;right:int:opt;top:int:opt;bottom:int:opt;", "clip:vnode;", cropRelCreate, 0, plugin);
     vspapi->registerFunction("Crop", "clip:vnode;left:int:opt;right:int:opt;top:int:opt;bottom:int:opt;", "clip:vnode;", cropRelCreate, 0, plugin);
@@ -2474,7 +3048,7 @@ void VS_CC stdlibInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->registerFunction("ModifyFrame", "clip:vnode;clips:vnode[];selector:func;", "clip:vnode;", modifyFrameCreate, 0, plugin);
     vspapi->registerFunction("Transpose", "clip:vnode;", "clip:vnode;", transposeCreate, 0, plugin);
     vspapi->registerFunction("PEMVerifier", "clip:vnode;upper:float[]:opt;lower:float[]:opt;", "clip:vnode;", pemVerifierCreate, 0, plugin);
-    vspapi->registerFunction("PlaneStats", "clipa:vnode;clipb:vnode:opt;plane:int:opt;prop:data:opt;", "clip:vnode;", planeStatsCreate, 0, plugin);
+    vspapi->registerFunction("PlaneStats", "clipa:vnode;clipb:vnode:opt;plane:int[]:opt;prop:data:opt;", "clip:vnode;", planeStatsCreate, 0, plugin);
     vspapi->registerFunction("ClipToProp", "clip:vnode;mclip:vnode;prop:data:opt;", "clip:vnode;", clipToPropCreate, 0, plugin);
     vspapi->registerFunction("PropToClip", "clip:vnode;prop:data:opt;", "clip:vnode;", propToClipCreate, 0, plugin);
     vspapi->registerFunction("SetFrameProp", "clip:vnode;prop:data;intval:int[]:opt;floatval:float[]:opt;data:data[]:opt;", "clip:vnode;", setFramePropCreate, 0, plugin);
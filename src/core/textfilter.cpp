@@ -23,6 +23,9 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <cstring>
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
 #include "version.h"
@@ -39,54 +42,67 @@ std::string operator""_s(const char *str, size_t len) { return{ str, len }; }
 typedef std::vector<std::string> stringlist;
 } // namespace
 
-static void scrawl_character_int(unsigned char c, uint8_t *image, ptrdiff_t stride, int dest_x, int dest_y, int bitsPerSample, int scale) {
-    int black = 16 << (bitsPerSample - 8);
-    int white = 235 << (bitsPerSample - 8);
-    int x, y;
-    if (bitsPerSample == 8) {
-        for (y = 0; y < character_height * scale; y++) {
-            for (x = 0; x < character_width * scale; x++) {
-                if (__font_bitmap__[c * character_height + y/scale] & (1 << (7 - x/scale))) {
-                    image[dest_y*stride + dest_x + x] = white;
-                } else {
-                    image[dest_y*stride + dest_x + x] = black;
-                }
-            }
+namespace {
 
-            dest_y++;
-        }
-    } else {
-        for (y = 0; y < character_height * scale; y++) {
-            for (x = 0; x < character_width * scale; x++) {
-                if (__font_bitmap__[c * character_height + y/scale] & (1 << (7 - x/scale))) {
-                    reinterpret_cast<uint16_t *>(image)[dest_y*stride/2 + dest_x + x] = white;
-                } else {
-                    reinterpret_cast<uint16_t *>(image)[dest_y*stride/2 + dest_x + x] = black;
-                }
-            }
+// All glyphs of the font pre-rendered at one scale in one sample format. The rows of
+// glyph c start at row c * character_height * scale and are rowSize bytes each.
+struct GlyphAtlas {
+    size_t rowSize;
+    std::vector<uint8_t> data;
+};
 
-            dest_y++;
-        }
-    }
-}
+struct TextLine {
+    int x;
+    int y;
+    size_t rowSize;
+    std::vector<uint8_t> data;
+};
 
+// A fully laid out and rendered piece of text, it's reused for as long as the text,
+// frame dimensions and format stay the same
+struct TextBlock {
+    std::string text;
+    int width;
+    int height;
+    int formatKey;
+    std::vector<TextLine> lines;
+};
 
-static void scrawl_character_float(unsigned char c, uint8_t *image, ptrdiff_t stride, int dest_x, int dest_y, int scale) {
-    float white = 1.0f;
-    float black = 0.0f;
-    int x, y;
+} // namespace
 
-    for (y = 0; y < character_height * scale; y++) {
-        for (x = 0; x < character_width * scale; x++) {
-            if (__font_bitmap__[c * character_height + y/scale] & (1 << (7 - x/scale))) {
-                reinterpret_cast<float *>(image)[dest_y*stride/4 + dest_x + x] = white;
-            } else {
-                reinterpret_cast<float *>(image)[dest_y*stride/4 + dest_x + x] = black;
-            }
+static int format_key(const VSVideoFormat *format) {
+    return format->sampleType * 64 + format->bitsPerSample;
+}
+
+template<typename T>
+static void render_glyphs(T *dst, int scale, T black, T white) {
+    const int num_glyphs = sizeof(__font_bitmap__) / character_height;
+
+    for (int c = 0; c < num_glyphs; c++) {
+        for (int y = 0; y < character_height * scale; y++) {
+            unsigned char bits = __font_bitmap__[c * character_height + y/scale];
+            for (int x = 0; x < character_width * scale; x++)
+                *dst++ = (bits & (1 << (7 - x/scale))) ? white : black;
         }
+    }
+}
 
-        dest_y++;
+static std::shared_ptr<const GlyphAtlas> build_atlas(const VSVideoFormat *format, int scale) {
+    const int num_glyphs = sizeof(__font_bitmap__) / character_height;
+    std::shared_ptr<GlyphAtlas> atlas = std::make_shared<GlyphAtlas>();
+    atlas->rowSize = character_width * scale * format->bytesPerSample;
+    atlas->data.resize(atlas->rowSize * character_height * scale * num_glyphs);
+
+    if (format->sampleType == stFloat) {
+        render_glyphs<float>(reinterpret_cast<float *>(atlas->data.data()), scale, 0.0f, 1.0f);
+    } else if (format->bitsPerSample == 8) {
+        render_glyphs<uint8_t>(atlas->data.data(), scale, 16, 235);
+    } else {
+        int shift = format->bitsPerSample - 8;
+        render_glyphs<uint16_t>(reinterpret_cast<uint16_t *>(atlas->data.data()), scale, 16 << shift, 235 << shift);
     }
+
+    return atlas;
 }
 
 static void sanitise_text(std::string& txt) {
@@ -162,11 +178,14 @@ static stringlist split_text(const std::string& txt, int width, int height, int
 }
 
 
-static void scrawl_text(std::string txt, int alignment, int scale, VSFrame *frame, const VSAPI *vsapi) {
-    const VSVideoFormat *frame_format = vsapi->getVideoFrameFormat(frame);
-    int width = vsapi->getFrameWidth(frame, 0);
-    int height = vsapi->getFrameHeight(frame, 0);
+static std::shared_ptr<const TextBlock> layout_text(const std::string &text, const GlyphAtlas &atlas, int format_key, int width, int height, int alignment, int scale) {
+    std::shared_ptr<TextBlock> block = std::make_shared<TextBlock>();
+    block->text = text;
+    block->width = width;
+    block->height = height;
+    block->formatKey = format_key;
 
+    std::string txt = text;
     sanitise_text(txt);
 
     stringlist lines = split_text(txt, width - margin_h*2, height - margin_v*2, scale);
@@ -211,58 +230,73 @@ static void scrawl_text(std::string txt, int alignment, int scale, VSFrame *fram
             break;
         }
 
-        for (size_t i = 0; i < iter.size(); i++) {
-            int dest_x = start_x + static_cast<int>(i)*character_width*scale;
-            int dest_y = start_y;
+        TextLine line;
+        line.x = start_x;
+        line.y = start_y;
+        line.rowSize = iter.size() * atlas.rowSize;
+        line.data.resize(line.rowSize * character_height * scale);
+
+        uint8_t *dst = line.data.data();
+        for (int y = 0; y < character_height * scale; y++) {
+            for (size_t i = 0; i < iter.size(); i++) {
+                const uint8_t *glyph = atlas.data.data() + (static_cast<unsigned char>(iter[i]) * character_height * scale + y) * atlas.rowSize;
+                memcpy(dst, glyph, atlas.rowSize);
+                dst += atlas.rowSize;
+            }
+        }
+
+        block->lines.push_back(std::move(line));
+        start_y += character_height * scale;
+    }
+
+    return block;
+}
 
-            if (frame_format->colorFamily == cfRGB) {
-                for (int plane = 0; plane < frame_format->numPlanes; plane++) {
-                    uint8_t *image = vsapi->getWritePtr(frame, plane);
-                    ptrdiff_t stride = vsapi->getStride(frame, plane);
 
-                    if (frame_format->sampleType == stInteger) {
-                        scrawl_character_int(iter[i], image, stride, dest_x, dest_y, frame_format->bitsPerSample, scale);
-                    } else {
-                        scrawl_character_float(iter[i], image, stride, dest_x, dest_y, scale);
-                    }
-                }
+static void fill_neutral_chroma(uint8_t *image, ptrdiff_t stride, int x, int y, int w, int h, const VSVideoFormat *format) {
+    for (int i = 0; i < h; i++) {
+        uint8_t *row = image + (y + i) * stride;
+        if (format->bitsPerSample == 8)
+            vs_memset<uint8_t>(row + x, 128, w);
+        else if (format->bitsPerSample <= 16)
+            vs_memset<uint16_t>(reinterpret_cast<uint16_t *>(row) + x, 128 << (format->bitsPerSample - 8), w);
+        else
+            vs_memset<float>(reinterpret_cast<float *>(row) + x, 0.0f, w);
+    }
+}
+
+
+static void blit_text(const TextBlock &block, int scale, VSFrame *frame, const VSAPI *vsapi) {
+    const VSVideoFormat *frame_format = vsapi->getVideoFrameFormat(frame);
+    int glyph_width = character_width * scale;
+    int glyph_height = character_height * scale;
+
+    for (int plane = 0; plane < frame_format->numPlanes; plane++) {
+        uint8_t *image = vsapi->getWritePtr(frame, plane);
+        ptrdiff_t stride = vsapi->getStride(frame, plane);
+
+        for (const auto &line : block.lines) {
+            if (plane == 0 || frame_format->colorFamily == cfRGB) {
+                uint8_t *dst = image + line.y * stride + line.x * frame_format->bytesPerSample;
+                for (int y = 0; y < glyph_height; y++)
+                    memcpy(dst + y * stride, line.data.data() + y * line.rowSize, line.rowSize);
             } else {
-                for (int plane = 0; plane < frame_format->numPlanes; plane++) {
-                    uint8_t *image = vsapi->getWritePtr(frame, plane);
-                    ptrdiff_t stride = vsapi->getStride(frame, plane);
-
-                    if (plane == 0) {
-                        if (frame_format->sampleType == stInteger) {
-                            scrawl_character_int(iter[i], image, stride, dest_x, dest_y, frame_format->bitsPerSample, scale);
-                        } else {
-                            scrawl_character_float(iter[i], image, stride, dest_x, dest_y, scale);
-                        }
-                    } else {
-                        int sub_w = scale * character_width  >> frame_format->subSamplingW;
-                        int sub_h = scale * character_height >> frame_format->subSamplingH;
-                        int sub_dest_x = dest_x >> frame_format->subSamplingW;
-                        int sub_dest_y = dest_y >> frame_format->subSamplingH;
-                        int y;
-
-                        if (frame_format->bitsPerSample == 8) {
-                            for (y = 0; y < sub_h; y++) {
-                                vs_memset<uint8_t>(image + (y+sub_dest_y)*stride + sub_dest_x, 128, sub_w);
-                            }
-                        } else if (frame_format->bitsPerSample <= 16) {
-                            for (y = 0; y < sub_h; y++) {
-                                vs_memset<uint16_t>(reinterpret_cast<uint16_t *>(image) + (y+sub_dest_y)*stride/2 + sub_dest_x, 128 << (frame_format->bitsPerSample - 8), sub_w);
-                            }
-                        } else {
-                            for (y = 0; y < sub_h; y++) {
-                                vs_memset<float>(reinterpret_cast<float *>(image) + (y+sub_dest_y)*stride/4 + sub_dest_x, 0.0f, sub_w);
-                            }
-                        }
-                    } // if plane
-                } // for plane in planes
-            } // if colorFamily
-        } // for i in line
-        start_y += character_height * scale;
-    } // for iter in lines
+                int length = static_cast<int>(line.rowSize / (glyph_width * frame_format->bytesPerSample));
+                int sub_w = glyph_width >> frame_format->subSamplingW;
+                int sub_h = glyph_height >> frame_format->subSamplingH;
+                int sub_dest_y = line.y >> frame_format->subSamplingH;
+
+                // Neighbouring characters only cover a contiguous chroma span when the
+                // glyph width is a multiple of the subsampling
+                if (glyph_width % (1 << frame_format->subSamplingW) == 0) {
+                    fill_neutral_chroma(image, stride, line.x >> frame_format->subSamplingW, sub_dest_y, sub_w * length, sub_h, frame_format);
+                } else {
+                    for (int i = 0; i < length; i++)
+                        fill_neutral_chroma(image, stride, (line.x + i * glyph_width) >> frame_format->subSamplingW, sub_dest_y, sub_w, sub_h, frame_format);
+                }
+            }
+        }
+    }
 }
 
 
@@ -287,10 +321,44 @@ typedef struct {
     intptr_t filter;
     stringlist props;
     std::string instanceName;
+
+    std::mutex cacheLock;
+    std::map<int, std::shared_ptr<const GlyphAtlas>> atlases;
+    std::shared_ptr<const TextBlock> lastBlock;
 } TextData;
 
 } // namespace
 
+static void scrawl_text(TextData *d, const std::string &txt, VSFrame *frame, const VSAPI *vsapi) {
+    const VSVideoFormat *frame_format = vsapi->getVideoFrameFormat(frame);
+    int width = vsapi->getFrameWidth(frame, 0);
+    int height = vsapi->getFrameHeight(frame, 0);
+    int key = format_key(frame_format);
+
+    std::shared_ptr<const TextBlock> block;
+    std::shared_ptr<const GlyphAtlas> atlas;
+    {
+        std::lock_guard<std::mutex> guard(d->cacheLock);
+        const std::shared_ptr<const TextBlock> &last = d->lastBlock;
+        if (last && last->width == width && last->height == height && last->formatKey == key && last->text == txt) {
+            block = last;
+        } else {
+            std::shared_ptr<const GlyphAtlas> &entry = d->atlases[key];
+            if (!entry)
+                entry = build_atlas(frame_format, d->scale);
+            atlas = entry;
+        }
+    }
+
+    if (!block) {
+        block = layout_text(txt, *atlas, key, width, height, d->alignment, d->scale);
+        std::lock_guard<std::mutex> guard(d->cacheLock);
+        d->lastBlock = block;
+    }
+
+    blit_text(*block, d->scale, frame, vsapi);
+}
+
 static void append_prop(std::string &text, const std::string &key, const VSMap *map, const VSAPI *vsapi) {
     char type = vsapi->mapGetType(map, key.c_str());
     int numElements = vsapi->mapNumElements(map, key.c_str());
@@ -493,7 +561,9 @@ static const VSFrame *VS_CC textGetFrame(int n, int activationReason, void *inst
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+        // the text is drawn in place when nothing else holds on to the source frame
+        VSFrame *dst = vsapi->takeFrameFilter(n, d->node, frameCtx, core);
+        const VSFrame *src = dst;
 
         const VSVideoFormat *frame_format = vsapi->getVideoFrameFormat(src);
         if ((frame_format->sampleType == stInteger && frame_format->bitsPerSample > 16) ||
@@ -515,10 +585,8 @@ static const VSFrame *VS_CC textGetFrame(int n, int activationReason, void *inst
             return nullptr;
         }
 
-        VSFrame *dst = vsapi->copyFrame(src, core);
-
         if (d->filter == FILTER_FRAMENUM) {
-            scrawl_text(std::to_string(n), d->alignment, d->scale, dst, vsapi);
+            scrawl_text(d, std::to_string(n), dst, vsapi);
         } else if (d->filter == FILTER_FRAMEPROPS) {
             const VSMap *props = vsapi->getFramePropertiesRO(dst);
             int numKeys = vsapi->mapNumKeys(props);
@@ -536,7 +604,7 @@ static const VSFrame *VS_CC textGetFrame(int n, int activationReason, void *inst
                 }
             }
 
-            scrawl_text(text, d->alignment, d->scale, dst, vsapi);
+            scrawl_text(d, text, dst, vsapi);
         } else if (d->filter == FILTER_COREINFO) {
             VSCoreInfo ci;
             vsapi->getCoreInfo(core, &ci);
@@ -547,7 +615,7 @@ static const VSFrame *VS_CC textGetFrame(int n, int activationReason, void *inst
             text.append("Maximum framebuffer cache size: ").append(std::to_string(ci.maxFramebufferSize)).append(" bytes\n");
             text.append("Used framebuffer cache size: ").append(std::to_string(ci.usedFramebufferSize)).append(" bytes");
 
-            scrawl_text(text, d->alignment, d->scale, dst, vsapi);
+            scrawl_text(d, text, dst, vsapi);
         } else if (d->filter == FILTER_CLIPINFO) {
             const VSMap *props = vsapi->getFramePropertiesRO(src);
             std::string text = "Clip info:\n";
@@ -625,12 +693,11 @@ static const VSFrame *VS_CC textGetFrame(int n, int activationReason, void *inst
                 text += "Frame duration: " + std::to_string(fn) + "/" + std::to_string(fd) + " (" + std::to_string(static_cast<double>(fn) / fd) + ")\n";
             }
 
-            scrawl_text(text, d->alignment, d->scale, dst, vsapi);
+            scrawl_text(d, text, dst, vsapi);
         } else {
-            scrawl_text(d->text, d->alignment, d->scale, dst, vsapi);
+            scrawl_text(d, d->text, dst, vsapi);
         }
 
-        vsapi->freeFrame(src);
         return dst;
     }
 
@@ -37,10 +37,15 @@
 #define STR(x) #x
 #define VAPOURSYNTH_CORE_VERSION 55
 #define VAPOURSYNTH_INTERNAL_PLUGIN_VERSION VS_MAKE_VERSION(VAPOURSYNTH_CORE_VERSION, 0)
+#if defined(VS_FRAME_GUARD_SAMPLE_INTERVAL)
+#define VS_FRAME_GUARD_TEXT "Frame Guard (1 in " XSTR(VS_FRAME_GUARD_SAMPLE_INTERVAL) ")"
+#else
+#define VS_FRAME_GUARD_TEXT "Frame Guard"
+#endif
 #if defined(VS_FRAME_GUARD) && !defined(NDEBUG)
-#define VS_OPTIONS_TEXT "Options: Frame Guard + Extra Assertions\n"
+#define VS_OPTIONS_TEXT "Options: " VS_FRAME_GUARD_TEXT " + Extra Assertions\n"
 #elif defined(VS_FRAME_GUARD)
-#define VS_OPTIONS_TEXT "Options: Frame Guard\n"
+#define VS_OPTIONS_TEXT "Options: " VS_FRAME_GUARD_TEXT "\n"
 #elif !defined(NDEBUG)
 #define VS_OPTIONS_TEXT "Options: Extra Assertions\n"
 #else
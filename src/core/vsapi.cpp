@@ -21,8 +21,10 @@
 #include "vscore.h"
 #include "cpufeatures.h"
 #include "vslog.h"
+#include "../common/videooutput.h"
 #include "VSHelper4.h"
 #include <cassert>
+#include <climits>
 #include <cstring>
 #include <string>
 
@@ -88,14 +90,34 @@ static uint8_t *VS_CC getWritePtr(VSFrame *frame, int plane) VS_NOEXCEPT {
 static void VS_CC getFrameAsync(int n, VSNode *clip, VSFrameDoneCallback fdc, void *userData) VS_NOEXCEPT {
     assert(clip && fdc);
     int numFrames = (clip->getNodeType() == mtVideo) ? clip->getVideoInfo().numFrames : clip->getAudioInfo().numFrames;
-    VSFrameContext *ctx = new VSFrameContext(n, clip, fdc, userData, true);
+    VSFrameContext *ctx = VSFrameContext::create(n, clip, fdc, userData, true);
 
     if (n < 0 || (numFrames && n >= numFrames))
         ctx->setError("Invalid frame number " + std::to_string(n) + " requested, clip only has " + std::to_string(numFrames) + " frames");
 
+    clip->recordRequest(n, prBulk);
     clip->getFrame(ctx);
 }
 
+static void VS_CC getFramesAsync(int start, int count, int step, VSNode *node, VSFrameDoneCallback callback, void *userData) VS_NOEXCEPT {
+    assert(node && callback);
+    if (count <= 0)
+        return;
+    int numFrames = (node->getNodeType() == mtVideo) ? node->getVideoInfo().numFrames : node->getAudioInfo().numFrames;
+    std::vector<PVSFrameContext> contexts;
+    contexts.reserve(count);
+    int64_t n = start;
+    for (int i = 0; i < count; i++, n += step) {
+        VSFrameContext *ctx = VSFrameContext::create(static_cast<int>(n), node, callback, userData, true);
+        if (n < 0 || n > INT_MAX || (numFrames && n >= numFrames))
+            ctx->setError("Invalid frame number " + std::to_string(n) + " requested, clip only has " + std::to_string(numFrames) + " frames");
+        node->recordRequest(static_cast<int>(n), prBulk);
+        contexts.emplace_back(ctx);
+    }
+
+    node->getFrames(contexts);
+}
+
 struct GetFrameWaiter {
     std::mutex b;
     std::condition_variable a;
@@ -126,7 +148,8 @@ static const VSFrame *VS_CC getFrame(int n, VSNode *node, char *errorMsg, int bu
     bool isWorker = node->isWorkerThread();
     if (isWorker)
         node->releaseThread();
-    node->getFrame(new VSFrameContext(n, node, &frameWaiterCallback, &g, false));
+    node->recordRequest(n, prBulk);
+    node->getFrame(VSFrameContext::create(n, node, &frameWaiterCallback, &g, false));
     g.a.wait(l);
     if (isWorker)
         node->reserveThread();
@@ -138,6 +161,9 @@ static void VS_CC requestFrameFilter(int n, VSNode *node, VSFrameContext *frameC
     int numFrames = (node->getNodeType() == mtVideo) ? node->getVideoInfo().numFrames : node->getAudioInfo().numFrames;
     if (n >= numFrames)
         n = numFrames - 1;
+    // the planes demanded from a node only follow the dependencies of its consumers
+    if (node->getDemandedPlanes() != VSNode::allPlanes && !frameCtx->key.first->hasDependency(node))
+        node->addDemandedPlanes(VSNode::allPlanes);
     frameCtx->reqList.emplace_back(NodeOutputKey(node, n));
 }
 
@@ -158,6 +184,42 @@ static const VSFrame *VS_CC getFrameFilter(int n, VSNode *node, VSFrameContext *
     return nullptr;
 }
 
+static VSFrame *VS_CC takeFrameFilter(int n, VSNode *node, VSFrameContext *frameCtx, VSCore *core) VS_NOEXCEPT {
+    assert(node && frameCtx && core);
+
+    int numFrames = (node->getNodeType() == mtVideo) ? node->getVideoInfo().numFrames : node->getAudioInfo().numFrames;
+    if (numFrames && n >= numFrames)
+        n = numFrames - 1;
+    auto key = NodeOutputKey(node, n);
+    for (size_t i = 0; i < frameCtx->availableFrames.size(); i++) {
+        auto &tmp = frameCtx->availableFrames[i];
+        if (tmp.first == key) {
+            PVSFrame f = std::move(tmp.second);
+            tmp.first = NodeOutputKey(nullptr, -1);
+            if (!f->unique())
+                return new VSFrame(*f);
+            f->add_ref();
+            return f.get();
+        }
+    }
+    return nullptr;
+}
+
+static int VS_CC offerFrameDestination(int n, VSNode *node, VSFrame *dst, int left, int top, VSFrameContext *frameCtx, VSCore *core) VS_NOEXCEPT {
+    assert(node && dst && frameCtx && core);
+    if (node->getNodeType() != mtVideo || dst->getFrameType() != mtVideo || !node->isRightCore(core))
+        return 0;
+    int numFrames = node->getVideoInfo().numFrames;
+    if (n >= numFrames)
+        n = numFrames - 1;
+    return core->offerDestination(NodeOutputKey(node, n), dst, left, top, frameCtx);
+}
+
+static int VS_CC transferCaches(VSNode *dst, VSNode *src) VS_NOEXCEPT {
+    assert(dst && src);
+    return VSCore::transferCaches(dst, src);
+}
+
 static void VS_CC freeFrame(const VSFrame *frame) VS_NOEXCEPT {
     if (frame)
         const_cast<VSFrame *>(frame)->release();
@@ -170,6 +232,10 @@ static void VS_CC freeNode(VSNode *clip) VS_NOEXCEPT {
 
 static VSFrame *VS_CC newVideoFrame(const VSVideoFormat *format, int width, int height, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT {
     assert(format && core);
+    // the consumer of the frame being produced may have offered an area of its own output to write to
+    VSFrame *dst = core->takeDestination(*format, width, height, propSrc);
+    if (dst)
+        return dst;
     return new VSFrame(*format, width, height, propSrc, core);
 }
 
@@ -335,8 +401,9 @@ static char VS_CC propGetType3(const VSMap *map, const char *key) VS_NOEXCEPT {
     }
 }
 
-static VSArrayBase *propGetShared(const VSMap *map, const char *key, int index, int *error, VSPropertyType propType) noexcept {
-    assert(map && key && index >= 0);
+// the checks of a property read once the array for the key has been found
+static VSArrayBase *propCheckShared(const VSMap *map, VSArrayBase *arr, const char *key, int index, int *error, VSPropertyType propType) noexcept {
+    assert(index >= 0);
 
     if (error)
         *error = peSuccess;
@@ -349,8 +416,6 @@ static VSArrayBase *propGetShared(const VSMap *map, const char *key, int index,
         return nullptr;
     }
 
-    VSArrayBase *arr = map->find(key);
-
     if (!arr) {
         if (error)
             *error = peUnset;
@@ -378,6 +443,11 @@ static VSArrayBase *propGetShared(const VSMap *map, const char *key, int index,
     return arr;
 }
 
+static VSArrayBase *propGetShared(const VSMap *map, const char *key, int index, int *error, VSPropertyType propType) noexcept {
+    assert(map && key);
+    return propCheckShared(map, map->hasError() ? nullptr : map->find(key), key, index, error, propType);
+}
+
 static int64_t VS_CC mapGetInt(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT {
     VSArrayBase *arr = propGetShared(map, key, index, error, ptInt);
     if (arr)
@@ -405,7 +475,7 @@ static float VS_CC mapGetFloatSaturated(const VSMap *map, const char *key, int i
 static const char *VS_CC mapGetData(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT {
     VSArrayBase *arr = propGetShared(map, key, index, error, ptData);
     if (arr)
-        return reinterpret_cast<const VSDataArray *>(arr)->at(index).data.c_str();
+        return reinterpret_cast<const VSDataArray *>(arr)->at(index).data();
     else
         return nullptr;
 }
@@ -413,7 +483,7 @@ static const char *VS_CC mapGetData(const VSMap *map, const char *key, int index
 static int VS_CC mapGetDataSize(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT {
     VSArrayBase *arr = propGetShared(map, key, index, error, ptData);
     if (arr)
-        return static_cast<int>(reinterpret_cast<const VSDataArray *>(arr)->at(index).data.size());
+        return static_cast<int>(reinterpret_cast<const VSDataArray *>(arr)->at(index).size());
     else
         return -1;
 }
@@ -547,6 +617,14 @@ bool propSetShared(VSMap *map, const char *key, const T &val, int append) {
     std::string skey = key;
 
     if (append == maReplace) {
+        // refill an array only this map references instead of allocating a new one
+        VSArrayBase *arr = map->find(skey);
+        if (arr && arr->type() == propType && arr->unique()) {
+            VSArray<T, propType> *v = reinterpret_cast<VSArray<T, propType> *>(map->detach(skey));
+            v->clear();
+            v->push_back(val);
+            return true;
+        }
         VSArray<T, propType> *v = new VSArray<T, propType>();
         v->push_back(val);
         map->insert(key, v);
@@ -574,12 +652,58 @@ static int VS_CC mapSetInt(VSMap *map, const char *key, int64_t i, int append) V
     return !propSetShared<int64_t, ptInt>(map, key, i, append);
 }
 
+static int64_t VS_CC mapGetReservedInt(const VSMap *map, int property, int index, int *error) VS_NOEXCEPT {
+    assert(map);
+    if (property < 0 || property >= VSMapStorage::numReservedKeys)
+        VS_FATAL_ERROR("Invalid reserved property passed to mapGetReservedInt()");
+    VSArrayBase *arr = propCheckShared(map, map->hasError() ? nullptr : map->findReserved(property), VSMapStorage::reservedKeys[property], index, error, ptInt);
+    if (arr)
+        return reinterpret_cast<const VSIntArray *>(arr)->at(index);
+    else
+        return 0;
+}
+
+static int VS_CC mapSetReservedInt(VSMap *map, int property, int64_t i, int append) VS_NOEXCEPT {
+    assert(map);
+    if (property < 0 || property >= VSMapStorage::numReservedKeys)
+        VS_FATAL_ERROR("Invalid reserved property passed to mapSetReservedInt()");
+    if (append == maReplace) {
+        // refill the existing array in place when nothing else references it, exactly like propSetShared() does
+        map->detach();
+        VSArrayBase *arr = map->findReserved(property);
+        if (arr && arr->type() == ptInt && arr->unique()) {
+            VSIntArray *v = reinterpret_cast<VSIntArray *>(arr);
+            v->clear();
+            v->push_back(i);
+            return 0;
+        }
+    }
+    return !propSetShared<int64_t, ptInt>(map, VSMapStorage::reservedKeys[property], i, append);
+}
+
 static int VS_CC mapSetFloat(VSMap *map, const char *key, double d, int append) VS_NOEXCEPT {
     return !propSetShared<double, ptFloat>(map, key, d, append);
 }
 
 static int VS_CC mapSetData(VSMap *map, const char *key, const char *d, int length, int type, int append) VS_NOEXCEPT {
-    return !propSetShared<VSMapData, ptData>(map, key, { static_cast<VSDataTypeHint>(type), (length >= 0) ? std::string(d, length) : std::string(d) }, append);
+    return !propSetShared<VSMapData, ptData>(map, key, VSMapData(static_cast<VSDataTypeHint>(type), d, (length >= 0) ? length : strlen(d)), append);
+}
+
+static int VS_CC mapSetDataExternal(VSMap *map, const char *key, const char *data, int size, int type, VSFreeDataBuffer free, void *userData, int append) VS_NOEXCEPT {
+    assert(data && size >= 0);
+    // the deleter runs when the last copy of the entry goes away or right away if it can't be set
+    std::shared_ptr<const char> buffer(data, [free, userData](const char *) { if (free) free(userData); });
+    return !propSetShared<VSMapData, ptData>(map, key, VSMapData(static_cast<VSDataTypeHint>(type), std::move(buffer), size), append);
+}
+
+static char *VS_CC mapAllocData(VSMap *map, const char *key, int size, int type, int append) VS_NOEXCEPT {
+    assert(size >= 0);
+    VSMapData d;
+    d.typeHint = static_cast<VSDataTypeHint>(type);
+    char *p = d.allocate(size);
+    if (!propSetShared<VSMapData, ptData>(map, key, d, append))
+        return nullptr;
+    return p;
 }
 
 static int VS_CC propSetData3(VSMap *map, const char *key, const char *d, int length, int append) VS_NOEXCEPT {
@@ -804,6 +928,11 @@ static int64_t VS_CC setMaxCacheSize(int64_t bytes, VSCore *core) VS_NOEXCEPT {
     return core->memory->setMaxMemoryUse(bytes);
 }
 
+static int64_t VS_CC setMemoryHardLimit(int64_t bytes, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return core->memory->setHardLimit(bytes);
+}
+
 static int VS_CC getOutputIndex(VSFrameContext *frameCtx) VS_NOEXCEPT {
     assert(frameCtx);
     assert(false);
@@ -1043,6 +1172,238 @@ static int VS_CC getNumNodeDependencies(VSNode *node) VS_NOEXCEPT {
     return static_cast<int>(node->getNumDependencies());
 }
 
+static void VS_CC getCoreStatistics(VSCore *core, VSMap *stats) VS_NOEXCEPT {
+    assert(core && stats);
+    core->threadPool->getStatistics(stats);
+    core->memory->getStatistics(stats);
+    core->getStartupStatistics(stats);
+}
+
+static void VS_CC getFrameAsyncPriority(int n, VSNode *node, int priority, VSFrameDoneCallback callback, void *userData) VS_NOEXCEPT {
+    assert(node && callback);
+    int numFrames = (node->getNodeType() == mtVideo) ? node->getVideoInfo().numFrames : node->getAudioInfo().numFrames;
+    VSFrameContext *ctx = VSFrameContext::create(n, node, callback, userData, true, std::min(std::max(priority, static_cast<int>(prBulk)), static_cast<int>(prInteractive)));
+
+    if (n < 0 || (numFrames && n >= numFrames))
+        ctx->setError("Invalid frame number " + std::to_string(n) + " requested, clip only has " + std::to_string(numFrames) + " frames");
+
+    node->recordRequest(n, priority);
+    node->getFrame(ctx);
+}
+
+static void VS_CC getFrameAsyncDeadline(int n, VSNode *node, int priority, int64_t timeout, VSFrameDoneCallback callback, void *userData) VS_NOEXCEPT {
+    assert(node && callback);
+    int numFrames = (node->getNodeType() == mtVideo) ? node->getVideoInfo().numFrames : node->getAudioInfo().numFrames;
+    int64_t deadline = noDeadline;
+    if (timeout > 0)
+        deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() + std::min<int64_t>(timeout, INT64_MAX / 2000) * 1000;
+    VSFrameContext *ctx = VSFrameContext::create(n, node, callback, userData, true, std::min(std::max(priority, static_cast<int>(prBulk)), static_cast<int>(prInteractive)), deadline);
+
+    if (n < 0 || (numFrames && n >= numFrames))
+        ctx->setError("Invalid frame number " + std::to_string(n) + " requested, clip only has " + std::to_string(numFrames) + " frames");
+
+    node->recordRequest(n, priority);
+    node->getFrame(ctx);
+}
+
+static int VS_CC cancelFrameRequests(VSFrameDoneCallback callback, void *userData, VSCore *core) VS_NOEXCEPT {
+    assert(callback && core);
+    return core->threadPool->cancelRequests(callback, userData);
+}
+
+static VSSharedThreadPool *VS_CC createSharedThreadPool(int threads) VS_NOEXCEPT {
+    return new VSSharedThreadPool(threads > 0 ? threads : 0);
+}
+
+static void VS_CC freeSharedThreadPool(VSSharedThreadPool *pool) VS_NOEXCEPT {
+    if (pool)
+        pool->release();
+}
+
+static int VS_CC attachSharedThreadPool(VSSharedThreadPool *pool, int weight, VSCore *core) VS_NOEXCEPT {
+    assert(pool && core);
+    if (weight < 1)
+        return 0;
+    return core->threadPool->attachSharedPool(pool, weight);
+}
+
+static void VS_CC setNodeConcurrency(VSNode *node, int maxConcurrency, int64_t frameScratchSize, int64_t maxScratchSize) VS_NOEXCEPT {
+    assert(node);
+    node->setConcurrency(maxConcurrency, frameScratchSize, maxScratchSize);
+}
+
+static void VS_CC setNodeFrameReadyActivation(VSNode *node, int enable) VS_NOEXCEPT {
+    assert(node);
+    // the api3 activation reasons have no room for it
+    if (node->getApiMajor() == VAPOURSYNTH_API_MAJOR)
+        node->setFrameReadyActivation(!!enable);
+}
+
+static VSAsyncRequest *VS_CC beginAsyncRequest(VSFrameContext *frameCtx) VS_NOEXCEPT {
+    assert(frameCtx);
+    return frameCtx->key.first->beginAsyncRequest(frameCtx);
+}
+
+static void VS_CC completeAsyncRequest(VSAsyncRequest *request, const char *errorMessage) VS_NOEXCEPT {
+    assert(request);
+    request->pool->completeAsyncRequest(request, errorMessage);
+}
+
+static void VS_CC readFileAsync(const char *filename, int64_t offset, int64_t size, VSMap *result, VSFrameContext *frameCtx) VS_NOEXCEPT {
+    assert(filename && result && frameCtx);
+    frameCtx->key.first->readFileAsync(filename, offset, size, result, frameCtx);
+}
+
+static void *VS_CC allocScratchMemory(size_t size, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return VSScratchArena::current().alloc(size, core->memory);
+}
+
+static void VS_CC setWatchdog(int64_t threshold, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    core->threadPool->setWatchdog(threshold);
+}
+
+static int VS_CC setAudioFrameSamples(int samples, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return core->setAudioFrameSamples(samples);
+}
+
+static int VS_CC getAudioFrameSamples(VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return core->getAudioFrameSamples();
+}
+
+static void VS_CC processSlices(int count, int minSliceSize, VSSliceFunction func, void *userData, VSFrameContext *frameCtx) VS_NOEXCEPT {
+    assert(func && frameCtx);
+    frameCtx->key.first->processSlices(count, minSliceSize, func, userData);
+}
+
+static VSFrame *VS_CC newVideoFrameView(const VSFrame *f, int left, int top, int width, int height, int field, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT {
+    assert(f && core);
+    if (f->getFrameType() != mtVideo)
+        return nullptr;
+    return VSFrame::createView(f, left, top, width, height, field, propSrc);
+}
+
+static VSFrame *VS_CC newAudioFrameView(const VSFrame *f, int start, int numSamples, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT {
+    assert(f && core);
+    if (f->getFrameType() != mtAudio)
+        return nullptr;
+    return VSFrame::createAudioView(f, start, numSamples, propSrc);
+}
+
+static int VS_CC writeTrace(const char *filename, VSCore *core) VS_NOEXCEPT {
+    assert(filename && core);
+    return core->tracer ? core->tracer->write(filename) : 0;
+}
+
+static int VS_CC recordFrameRequests(const char *filename, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return filename ? core->requestRecorder.start(filename) : core->requestRecorder.stop();
+}
+
+static void VS_CC setNodeOutputIndex(VSNode *node, int index, int alpha) VS_NOEXCEPT {
+    assert(node);
+    node->setOutputIndex(index, !!alpha);
+}
+
+static int VS_CC saveCacheSizes(const char *filename, VSCore *core) VS_NOEXCEPT {
+    assert(filename && core);
+    return core->saveCacheSizes(filename);
+}
+
+static int VS_CC loadCacheSizes(const char *filename, VSCore *core) VS_NOEXCEPT {
+    assert(filename && core);
+    return core->loadCacheSizes(filename);
+}
+
+static void VS_CC setNodeLightweight(VSNode *node, int enable) VS_NOEXCEPT {
+    assert(node);
+    node->setLightweight(!!enable);
+}
+
+static int VS_CC outputVideoNode(VSNode *node, intptr_t file, int flags, int prefetch, VSOutputProgressCallback progress, void *userData, char *errorMsg, int bufSize) VS_NOEXCEPT {
+    assert(node);
+    std::string error;
+    bool success = false;
+    if (node->getNodeType() != mtVideo)
+        error = "Only video nodes can be output";
+    else
+        success = outputVideoFrames(node, file, !!(flags & vofY4M), !!(flags & vofGBROrder), (prefetch > 0) ? prefetch : static_cast<int>(node->threadCount()), progress, userData, error, &vs_internal_vsapi);
+
+    if (!success && errorMsg && bufSize > 0) {
+        memset(errorMsg, 0, bufSize);
+        strncpy(errorMsg, error.c_str(), bufSize);
+        errorMsg[bufSize - 1] = 0;
+    }
+    return success;
+}
+
+static void VS_CC getNodeStatistics(VSNode *node, VSMap *stats) VS_NOEXCEPT {
+    assert(node && stats);
+    node->getStatistics(stats);
+}
+
+static VSFrame *VS_CC newVideoFrameFromBuffers(const VSVideoFormat *format, int width, int height, uint8_t * const *planes, const ptrdiff_t *strides, int writable, VSFreeFrameBuffer free, void *userData, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT {
+    assert(format && planes && strides && core);
+    if (!core->isValidVideoFormat(format->colorFamily, format->sampleType, format->bitsPerSample, format->subSamplingW, format->subSamplingH))
+        core->logFatal("newVideoFrameFromBuffers: invalid format passed");
+    return VSFrame::createFromBuffers(*format, width, height, planes, strides, !!writable, free, userData, propSrc, core);
+}
+
+static VSFrame *VS_CC newVideoFrameFromDevice(const VSVideoFormat *format, int width, int height, void * const *handles, const ptrdiff_t *strides, int domain, const VSDeviceMemoryFunctions *functions, void *userData, const VSFrame *propSrc, VSCore *core) VS_NOEXCEPT {
+    assert(format && handles && strides && functions && core);
+    if (!core->isValidVideoFormat(format->colorFamily, format->sampleType, format->bitsPerSample, format->subSamplingW, format->subSamplingH))
+        core->logFatal("newVideoFrameFromDevice: invalid format passed");
+    return VSFrame::createFromDevice(*format, width, height, handles, strides, static_cast<VSMemoryDomain>(domain), functions, userData, propSrc, core);
+}
+
+static int VS_CC getFrameMemoryDomain(const VSFrame *f, int plane) VS_NOEXCEPT {
+    assert(f);
+    return f->getMemoryDomain(plane);
+}
+
+static void *VS_CC getFrameDeviceHandle(const VSFrame *f, int plane, int deviceType) VS_NOEXCEPT {
+    assert(f);
+    return f->getDeviceHandle(plane, deviceType);
+}
+
+static void VS_CC setNodeDedicatedThread(VSNode *node, int queueSize) VS_NOEXCEPT {
+    assert(node);
+    node->setDedicatedThread(queueSize);
+}
+
+static VSPlugin *VS_CC getNodeCreationFunctionPlugin(VSNode *node, int level) VS_NOEXCEPT {
+    assert(node);
+    return node->getCreationFunctionPlugin(level);
+}
+
+static const char *VS_CC getNodeCreationFunctionOutput(VSNode *node, int *index) VS_NOEXCEPT {
+    assert(node);
+    return node->getCreationFunctionOutput(index);
+}
+
+static int VS_CC setFilterPlaneDependency(VSNode *node, int index, const int *planes) VS_NOEXCEPT {
+    assert(node && planes);
+    return node->setPlaneDependency(index, planes);
+}
+
+static int VS_CC getFrameDemandedPlanes(VSFrameContext *frameCtx) VS_NOEXCEPT {
+    assert(frameCtx);
+    return frameCtx->key.first->getDemandedPlanes();
+}
+
+static void VS_CC setFramePlaneConstant(VSFrame *f, int plane, uint32_t value) VS_NOEXCEPT {
+    assert(f);
+    f->setPlaneConstant(plane, value);
+}
+
+static int VS_CC getFramePlaneConstant(const VSFrame *f, int plane, uint32_t *value) VS_NOEXCEPT {
+    assert(f && value);
+    return f->getPlaneConstant(plane, *value);
+}
+
 const VSPLUGINAPI vs_internal_vspapi {
     &getAPIVersion,
     &configPlugin,
@@ -1182,7 +1543,55 @@ const VSAPI vs_internal_vsapi = {
     &getNodeFilterMode,
     &getNodeFilterTime,
     &getNodeDependencies,
-    &getNumNodeDependencies
+    &getNumNodeDependencies,
+
+    &getCoreStatistics,
+    &processSlices,
+    &newVideoFrameView,
+    &writeTrace,
+    &getNodeStatistics,
+    &newVideoFrameFromBuffers,
+    &getFramesAsync,
+    &cancelFrameRequests,
+    &getFrameAsyncPriority,
+    &createSharedThreadPool,
+    &freeSharedThreadPool,
+    &attachSharedThreadPool,
+    &setNodeConcurrency,
+    &setAudioFrameSamples,
+    &getAudioFrameSamples,
+    &newAudioFrameView,
+    &mapGetReservedInt,
+    &mapSetReservedInt,
+    &takeFrameFilter,
+    &transferCaches,
+    &offerFrameDestination,
+    &mapSetDataExternal,
+    &mapAllocData,
+    &setMemoryHardLimit,
+    &setNodeFrameReadyActivation,
+    &beginAsyncRequest,
+    &completeAsyncRequest,
+    &readFileAsync,
+    &allocScratchMemory,
+    &setWatchdog,
+    &newVideoFrameFromDevice,
+    &getFrameMemoryDomain,
+    &getFrameDeviceHandle,
+    &setNodeDedicatedThread,
+    &getNodeCreationFunctionPlugin,
+    &getNodeCreationFunctionOutput,
+    &setFilterPlaneDependency,
+    &getFrameDemandedPlanes,
+    &setFramePlaneConstant,
+    &getFramePlaneConstant,
+    &recordFrameRequests,
+    &setNodeOutputIndex,
+    &getFrameAsyncDeadline,
+    &saveCacheSizes,
+    &loadCacheSizes,
+    &setNodeLightweight,
+    &outputVideoNode
 };
 
 const vs3::VSAPI3 vs_internal_vsapi3 = {
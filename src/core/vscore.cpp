@@ -27,10 +27,21 @@
 #include <cstddef>
 #include <unistd.h>
 #include "settings.h"
+#include "kernel/reverse.h"
+#endif
+#ifdef VS_TARGET_OS_LINUX
+#include <fstream>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #endif
 #include <cassert>
+#include <cmath>
 #include <queue>
 #include <bitset>
+#include <unordered_set>
+#include <cstdio>
+#include <sys/stat.h>
 
 #ifdef VS_TARGET_CPU_X86
 #include "x86utils.h"
@@ -92,13 +103,129 @@ static std::wstring readRegistryValue(const wchar_t *keyName, const wchar_t *val
 }
 #endif
 
-VSFrameContext::VSFrameContext(NodeOutputKey key, const PVSFrameContext &notify) :
-    refcount(1), reqOrder(notify->reqOrder), external(false), lockOnOutput(true), frameDone(nullptr),  userData(nullptr), key(key), frameContext() {
-    notifyCtxList.push_back(notify);
+namespace {
+
+// contexts are usually released on the same worker threads that request new ones so a small
+// per-thread list is enough, anything beyond the limit goes back to the heap
+struct FrameContextFreeList {
+    static constexpr size_t maxEntries = 256;
+    std::vector<VSFrameContext *> entries;
+    bool alive = true;
+
+    ~FrameContextFreeList() {
+        alive = false;
+        for (auto iter : entries)
+            delete iter;
+    }
+};
+
+thread_local FrameContextFreeList frameContextFreeList;
+
+// the memory counters of the node whose getframe function is running on this thread, new planes are attributed to it,
+// with ccfAsyncLogging the pointer also identifies the node that logged a message
+thread_local const std::shared_ptr<VSNodeMemory> *currentNodeMemory = nullptr;
+
+// the output the getframe function running on this thread is producing, only used to find offered destinations
+thread_local NodeOutputKey currentOutputKey(nullptr, -1);
+
+// ccfAsyncLogging limits
+constexpr size_t maxQueuedLogMessages = 10000;
+constexpr int64_t logRepeatWindow = 1000000000;
+
 }
 
-VSFrameContext::VSFrameContext(int n, VSNode *node, VSFrameDoneCallback frameDone, void *userData, bool lockOnOutput) :
-    refcount(1), reqOrder(0), external(true), lockOnOutput(lockOnOutput), frameDone(frameDone), userData(userData), key(node, n), frameContext() {
+VSFrameContext *VSFrameContext::allocate() {
+    FrameContextFreeList &freeList = frameContextFreeList;
+    if (!freeList.entries.empty()) {
+        VSFrameContext *ctx = freeList.entries.back();
+        freeList.entries.pop_back();
+        return ctx;
+    }
+    return new VSFrameContext();
+}
+
+void VSFrameContext::recycle(VSFrameContext *ctx) noexcept {
+    // a context that ended with an error or was canceled may never have been called again
+    if (!ctx->offeredDestinations.empty())
+        ctx->destinationCore->withdrawDestinations(ctx);
+
+    // releasing the notify contexts and frames may recursively recycle more contexts
+    ctx->notifyCtxList.clear();
+    ctx->availableFrames.clear();
+    ctx->reqList.clear();
+    ctx->errorMessage.clear();
+    ctx->prefetchedFrame.reset();
+    ctx->pendingFrames.clear();
+    ctx->pendingErrorMessage.clear();
+
+    FrameContextFreeList &freeList = frameContextFreeList;
+    if (freeList.alive && freeList.entries.size() < FrameContextFreeList::maxEntries) {
+        try {
+            freeList.entries.push_back(ctx);
+            return;
+        } catch (...) {
+        }
+    }
+    delete ctx;
+}
+
+void VSFrameContext::reset(int priority, size_t reqOrder, bool external, bool lockOnOutput, VSFrameDoneCallback frameDone, void *userData, NodeOutputKey key) noexcept {
+    this->refcount = 1;
+    this->priority = priority;
+    this->deadline = noDeadline;
+    this->abortDeadline = noDeadline;
+    this->expired = false;
+    this->reqOrder = reqOrder;
+    this->numFrameRequests = 0;
+    this->queueIndex = -1;
+    this->queueSeq = 0;
+    this->traceId = 0;
+    this->traceFlow = false;
+    this->lockWaitStart = 0;
+    this->runningSince = 0;
+    this->subgraphTime = 0;
+    this->subgraphCacheHits = 0;
+    this->countedRunning = false;
+    this->prefetch = false;
+    this->frameReadyState = frNone;
+    this->pendingError = false;
+    this->asyncGuard = false;
+    this->error = false;
+    this->first = true;
+    this->canceled = false;
+    this->prevExternal = nullptr;
+    this->nextExternal = nullptr;
+    this->external = external;
+    this->lockOnOutput = lockOnOutput;
+    this->frameDone = frameDone;
+    this->userData = userData;
+    this->key = key;
+    for (auto &iter : frameContext)
+        iter = nullptr;
+}
+
+VSFrameContext *VSFrameContext::create(NodeOutputKey key, const PVSFrameContext &notify) {
+    VSFrameContext *ctx = allocate();
+    ctx->reset(notify->priority, notify->reqOrder, false, true, nullptr, nullptr, key);
+    ctx->deadline = notify->deadline;
+    ctx->abortDeadline = notify->abortDeadline.load();
+    ctx->notifyCtxList.push_back(notify);
+    return ctx;
+}
+
+VSFrameContext *VSFrameContext::create(int n, VSNode *node, VSFrameDoneCallback frameDone, void *userData, bool lockOnOutput, int priority, int64_t deadline) {
+    VSFrameContext *ctx = allocate();
+    ctx->reset(priority, 0, true, lockOnOutput, frameDone, userData, NodeOutputKey(node, n));
+    ctx->deadline = deadline;
+    ctx->abortDeadline = deadline;
+    return ctx;
+}
+
+VSFrameContext *VSFrameContext::createPrefetch(NodeOutputKey key, size_t reqOrder) {
+    VSFrameContext *ctx = allocate();
+    ctx->reset(prPrefetch, reqOrder, false, true, nullptr, nullptr, key);
+    ctx->prefetch = true;
+    return ctx;
 }
 
 bool VSFrameContext::setError(const std::string &errorMsg) {
@@ -111,15 +238,128 @@ bool VSFrameContext::setError(const std::string &errorMsg) {
 
 ///////////////
 
+const char VSMapStorage::reservedKeys[VSMapStorage::numReservedKeys][VSMapStorage::reservedKeySize] = {
+    "_ChromaLocation", "_ColorRange", "_Primaries", "_Matrix", "_Transfer", "_FieldBased", "_Field", "_DurationNum", "_DurationDen", "_SARNum", "_SARDen"
+};
+
+// the table is split into several parts to keep threads setting properties from contending
+namespace {
+struct KeyTable {
+    std::mutex lock;
+    std::unordered_set<std::string> keys;
+};
+}
+
+static KeyTable &getKeyTable(const char *key) {
+    static KeyTable tables[16];
+    size_t hash = 0;
+    for (const char *c = key; *c; c++)
+        hash = hash * 31 + static_cast<unsigned char>(*c);
+    return tables[hash % 16];
+}
+
+static const char *findReservedKey(const char *key) {
+    if (key[0] == '_') {
+        for (const auto &iter : VSMapStorage::reservedKeys) {
+            if (!strcmp(iter, key))
+                return iter;
+        }
+    }
+    return nullptr;
+}
+
+const char *VSMapStorage::internKey(const char *key) {
+    if (const char *reservedKey = findReservedKey(key))
+        return reservedKey;
+    KeyTable &table = getKeyTable(key);
+    std::lock_guard<std::mutex> lock(table.lock);
+    return table.keys.insert(key).first->c_str();
+}
+
+const char *VSMapStorage::findInternedKey(const char *key) {
+    if (const char *reservedKey = findReservedKey(key))
+        return reservedKey;
+    KeyTable &table = getKeyTable(key);
+    std::lock_guard<std::mutex> lock(table.lock);
+    auto iter = table.keys.find(key);
+    return (iter != table.keys.end()) ? iter->c_str() : nullptr;
+}
+
+void VSMapStorage::insertAt(size_t pos, const char *key, const PVSArrayBase &val) {
+    if (const char *interned = findInternedKey(key)) {
+        insertAt(pos, { interned, val, nullptr });
+    } else {
+        PVSMapKey ownedKey(new VSMapKey(key));
+        insertAt(pos, { ownedKey->name.c_str(), val, ownedKey });
+    }
+}
+
+void VSMapStorage::insertAt(size_t pos, const VSMapEntry &entry) {
+    assert(pos <= count);
+    if (large.empty() && count < inlineEntries) {
+        for (size_t i = count; i > pos; i--) {
+            small[i].key = small[i - 1].key;
+            small[i].value.swap(small[i - 1].value);
+            small[i].ownedKey.swap(small[i - 1].ownedKey);
+        }
+        small[pos] = entry;
+    } else {
+        if (large.empty()) {
+            large.reserve(inlineEntries * 2);
+            for (size_t i = 0; i < count; i++) {
+                large.push_back({ small[i].key, nullptr, nullptr });
+                large.back().value.swap(small[i].value);
+                large.back().ownedKey.swap(small[i].ownedKey);
+                small[i].key = nullptr;
+            }
+        }
+        large.insert(large.begin() + pos, entry);
+    }
+    updateReserved(entry.key, entry.value.get());
+    count++;
+}
+
+void VSMapStorage::eraseAt(size_t pos) noexcept {
+    assert(pos < count);
+    updateReserved(at(pos).key, nullptr);
+    if (large.empty()) {
+        for (size_t i = pos; i + 1 < count; i++) {
+            small[i].key = small[i + 1].key;
+            small[i].value.swap(small[i + 1].value);
+            small[i].ownedKey.swap(small[i + 1].ownedKey);
+        }
+        small[count - 1].key = nullptr;
+        small[count - 1].value.reset();
+        small[count - 1].ownedKey.reset();
+    } else {
+        large.erase(large.begin() + pos);
+    }
+    count--;
+}
+
+void VSMapStorage::clear() noexcept {
+    for (size_t i = 0; i < count && large.empty(); i++) {
+        small[i].key = nullptr;
+        small[i].value.reset();
+        small[i].ownedKey.reset();
+    }
+    large.clear();
+    count = 0;
+    std::fill(reserved, reserved + numReservedKeys, nullptr);
+    validatedFor.store(nullptr, std::memory_order_relaxed);
+}
+
 bool VSMap::isV3Compatible() const noexcept {
-    for (const auto &iter : data->data) {
-        if (iter.second->type() == ptAudioNode || iter.second->type() == ptAudioFrame || iter.second->type() == ptUnset)
+    for (const auto &iter : *data) {
+        if (iter.value->type() == ptAudioNode || iter.value->type() == ptAudioFrame || iter.value->type() == ptUnset)
             return false;
     }
     return true;
 }
 
-VSFunction::VSFunction(VSPublicFunction func, void *userData, VSFreeFunctionData freeFunction, VSCore *core, int apiMajor) : refcount(1), func(func), userData(userData), freeFunction(freeFunction), core(core), apiMajor(apiMajor) {
+static std::atomic<uint64_t> nextFunctionId(1);
+
+VSFunction::VSFunction(VSPublicFunction func, void *userData, VSFreeFunctionData freeFunction, VSCore *core, int apiMajor) : refcount(1), func(func), userData(userData), freeFunction(freeFunction), core(core), apiMajor(apiMajor), id(nextFunctionId++) {
     core->functionInstanceCreated();
 }
 
@@ -162,17 +402,434 @@ int64_t MemoryUse::setMaxMemoryUse(int64_t bytes) {
     return maxMemoryUse;
 }
 
+int64_t MemoryUse::setHardLimit(int64_t bytes) {
+    if (bytes >= 0 && static_cast<uint64_t>(bytes) <= SIZE_MAX)
+        hardLimit.store(static_cast<size_t>(bytes), std::memory_order_seq_cst);
+    return hardLimit;
+}
+
+// a hard limit below the cache size also makes the caches shrink to it
 bool MemoryUse::isOverLimit() {
-    return used.load(std::memory_order_relaxed) > maxMemoryUse.load(std::memory_order_relaxed);
+    size_t limit = maxMemoryUse.load(std::memory_order_relaxed);
+    size_t hard = hardLimit.load(std::memory_order_relaxed);
+    return used.load(std::memory_order_relaxed) > ((hard && hard < limit) ? hard : limit);
+}
+
+bool MemoryUse::isOverHardLimit() {
+    size_t hard = hardLimit.load(std::memory_order_relaxed);
+    return hard && used.load(std::memory_order_relaxed) > hard;
+}
+
+bool MemoryUse::usePageAllocation(size_t bytes) const {
+    // only worth it for buffers that span many pages
+    return (hugePages || numaLocal) && bytes >= 256 * 1024;
+}
+
+uint8_t *MemoryUse::allocateMemory(size_t bytes, int node) {
+#if defined(VS_TARGET_OS_WINDOWS)
+    if (usePageAllocation(bytes)) {
+        DWORD preferredNode = (node >= 0) ? static_cast<DWORD>(node) : NUMA_NO_PREFERRED_NODE;
+        void *buf = nullptr;
+        size_t largePage = hugePages ? GetLargePageMinimum() : 0;
+        if (largePage)
+            buf = VirtualAllocExNuma(GetCurrentProcess(), nullptr, (bytes + largePage - 1) & ~(largePage - 1), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, preferredNode);
+        if (!buf)
+            buf = VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, preferredNode);
+        return static_cast<uint8_t *>(buf);
+    }
+#elif defined(VS_TARGET_OS_LINUX)
+    if (usePageAllocation(bytes)) {
+        const size_t hugePageSize = 2 * 1024 * 1024;
+        size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        uint8_t *buf = vsh_aligned_malloc<uint8_t>(bytes, std::max<size_t>((hugePages && bytes >= hugePageSize) ? hugePageSize : pageSize, VSFrame::alignment));
+        if (buf) {
+            size_t length = bytes & ~(pageSize - 1);
+            if (hugePages)
+                madvise(buf, length, MADV_HUGEPAGE);
+#ifdef SYS_mbind
+            // MPOL_PREFERRED and MPOL_MF_MOVE, memory reused by malloc may already have been touched on another node
+            if (numaLocal && node >= 0 && node < static_cast<int>(sizeof(unsigned long) * 8)) {
+                unsigned long mask = 1UL << node;
+                syscall(SYS_mbind, buf, length, 1, &mask, sizeof(mask) * 8 + 1, 2);
+            }
+#endif
+        }
+        return buf;
+    }
+#endif
+    return vsh_aligned_malloc<uint8_t>(bytes, VSFrame::alignment);
+}
+
+void MemoryUse::freeMemory(uint8_t *buf, size_t bytes) {
+#ifdef VS_TARGET_OS_WINDOWS
+    if (usePageAllocation(bytes)) {
+        VirtualFree(buf, 0, MEM_RELEASE);
+        return;
+    }
+#endif
+    vsh_aligned_free(buf);
+}
+
+void MemoryUse::detectTopology() {
+    nodeCPUs.clear();
+    cpuNodes.clear();
+#if defined(VS_TARGET_OS_WINDOWS)
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode))
+        nodeCPUs.resize(highestNode + 1);
+#elif defined(VS_TARGET_OS_LINUX)
+    // every node directory has a cpulist file in the format 0-3,8-11
+    for (int node = 0;; node++) {
+        std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!cpuList)
+            break;
+
+        std::vector<int> cpus;
+        std::string range;
+        while (std::getline(cpuList, range, ',')) {
+            int first = 0, last = 0;
+            int n = sscanf(range.c_str(), "%d-%d", &first, &last);
+            if (n == 1)
+                last = first;
+            for (int cpu = first; n >= 1 && cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+                if (cpuNodes.size() <= static_cast<size_t>(cpu))
+                    cpuNodes.resize(cpu + 1, -1);
+                cpuNodes[cpu] = node;
+            }
+        }
+        nodeCPUs.push_back(cpus);
+    }
+#endif
+}
+
+void MemoryUse::setAllocationOptions(bool hugePages, bool numaLocal, bool needTopology) {
+    this->hugePages = hugePages;
+    if (numaLocal || needTopology)
+        detectTopology();
+    // there's nothing to gain on a single node system
+    this->numaLocal = numaLocal && nodeCPUs.size() > 1;
+}
+
+void MemoryUse::setDeduplication(bool enable) {
+    deduplicate = enable;
+}
+
+// only the visible part of each row is hashed and compared, the padding up to the stride is never looked at
+static uint64_t hashPlaneRows(const uint8_t *ptr, ptrdiff_t stride, size_t rowSize, int height) noexcept {
+    const uint64_t k = 0x9E3779B97F4A7C15ULL;
+    uint64_t h[4] = { k, k ^ rowSize, k ^ static_cast<uint64_t>(height), k ^ static_cast<uint64_t>(stride) };
+
+    auto mix = [](uint64_t h, uint64_t v) {
+        h = (h ^ v) * 0xFF51AFD7ED558CCDULL;
+        return h ^ (h >> 29);
+    };
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = ptr + y * stride;
+        size_t x = 0;
+        for (; x + 32 <= rowSize; x += 32) {
+            uint64_t v[4];
+            memcpy(v, row + x, sizeof(v));
+            for (int i = 0; i < 4; i++)
+                h[i] = mix(h[i], v[i]);
+        }
+        for (; x < rowSize; x += 8) {
+            uint64_t v = 0;
+            memcpy(&v, row + x, std::min<size_t>(8, rowSize - x));
+            h[0] = mix(h[0], v);
+        }
+    }
+
+    return mix(mix(h[0], h[1]), mix(h[2], h[3]));
+}
+
+void MemoryUse::deduplicatePlane(VSPlaneData *&plane, ptrdiff_t stride, size_t rowSize, int height) {
+    if (plane->isExternal() || plane->dedupRegistered)
+        return;
+
+    const uint8_t *ptr = plane->data + VSFrame::guardSpace;
+    uint64_t hash = hashPlaneRows(ptr, stride, rowSize, height);
+
+    // candidates that are being freed can still be in the registry so only the ones a reference can be taken to are considered,
+    // the actual comparison happens without the lock held
+    std::vector<VSPlaneData *> candidates;
+    {
+        std::lock_guard<std::mutex> lock(dedupLock);
+        auto range = dedupPlanes.equal_range(hash);
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            VSPlaneData *c = iter->second;
+            if (c->size == plane->size && c->dedupStride == stride && c->dedupRowSize == rowSize && c->dedupHeight == height && c->tryAddRef())
+                candidates.push_back(c);
+        }
+    }
+
+    VSPlaneData *match = nullptr;
+    for (VSPlaneData *c : candidates) {
+        if (!match) {
+            const uint8_t *cptr = c->data + VSFrame::guardSpace;
+            bool equal = true;
+            for (int y = 0; y < height && equal; y++)
+                equal = !memcmp(ptr + y * stride, cptr + y * stride, rowSize);
+            if (equal) {
+                match = c;
+                continue;
+            }
+        }
+        c->release();
+    }
+
+    if (match) {
+        dedupShared++;
+        dedupSharedBytes += plane->size;
+        plane->release();
+        plane = match;
+    } else {
+        plane->dedupHash = hash;
+        plane->dedupStride = stride;
+        plane->dedupRowSize = rowSize;
+        plane->dedupHeight = height;
+        plane->dedupRegistered = true;
+        std::lock_guard<std::mutex> lock(dedupLock);
+        dedupPlanes.emplace(hash, plane);
+    }
+}
+
+bool MemoryUse::reserveCompressed(size_t bytes) {
+    size_t limit = getLimit() / 8;
+    size_t current = compressedUsed.load();
+    do {
+        if (current + bytes > limit)
+            return false;
+    } while (!compressedUsed.compare_exchange_weak(current, current + bytes));
+    return true;
+}
+
+void MemoryUse::releaseCompressed(size_t bytes) {
+    compressedUsed -= bytes;
+}
+
+uint8_t *MemoryUse::allocScratch(size_t bytes) {
+    uint8_t *buf = vsh_aligned_malloc<uint8_t>(bytes, 64);
+    if (buf) {
+        scratchUsed += bytes;
+        add(bytes);
+    }
+    return buf;
+}
+
+void MemoryUse::freeScratch(uint8_t *buf, size_t bytes) {
+    vsh_aligned_free(buf);
+    scratchUsed -= bytes;
+    subtract(bytes);
+}
+
+VSScratchArena &VSScratchArena::current() {
+    static thread_local VSScratchArena arena;
+    return arena;
+}
+
+VSScratchArena::Mark VSScratchArena::enter() noexcept {
+    depth++;
+    return { chunk, offset };
+}
+
+void VSScratchArena::leave(const Mark &mark) {
+    chunk = mark.chunk;
+    offset = mark.offset;
+    if (--depth == 0 && chunks.size() > 1) {
+        // the new chunk is allocated first so the memory use never drops to zero which could free it
+        size_t total = 0;
+        for (const auto &iter : chunks)
+            total += iter.size;
+        uint8_t *data = mem->allocScratch(total);
+        release();
+        if (data)
+            chunks.push_back({ data, total });
+    }
+}
+
+void VSScratchArena::release() {
+    for (const auto &iter : chunks)
+        mem->freeScratch(iter.data, iter.size);
+    chunks.clear();
+    chunk = 0;
+    offset = 0;
+}
+
+void *VSScratchArena::alloc(size_t bytes, MemoryUse *m) {
+    if (!depth)
+        return nullptr;
+
+    // only switched when nothing is in use, a thread from a shared pool can run filters from several cores
+    if (m != mem && !chunk && !offset) {
+        release();
+        mem = m;
+    }
+
+    // rounded up so the next allocation is aligned as well
+    bytes = std::max<size_t>((bytes + 63) & ~static_cast<size_t>(63), 64);
+
+    while (chunk < chunks.size()) {
+        if (chunks[chunk].size - offset >= bytes) {
+            void *result = chunks[chunk].data + offset;
+            offset += bytes;
+            return result;
+        }
+        if (chunk + 1 == chunks.size())
+            break;
+        chunk++;
+        offset = 0;
+    }
+
+    size_t total = 0;
+    for (const auto &iter : chunks)
+        total += iter.size;
+    size_t size = std::max(bytes, total);
+    uint8_t *data = mem->allocScratch(size);
+    if (!data)
+        return nullptr;
+    chunks.push_back({ data, size });
+    chunk = chunks.size() - 1;
+    offset = bytes;
+    return data;
+}
+
+VSScratchArena::~VSScratchArena() {
+    release();
+}
+
+void MemoryUse::forgetPlane(VSPlaneData *plane) {
+    std::lock_guard<std::mutex> lock(dedupLock);
+    auto range = dedupPlanes.equal_range(plane->dedupHash);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+        if (iter->second == plane) {
+            dedupPlanes.erase(iter);
+            break;
+        }
+    }
+}
+
+int MemoryUse::getCurrentNUMANode() const {
+#if defined(VS_TARGET_OS_WINDOWS)
+    PROCESSOR_NUMBER processor;
+    USHORT node;
+    GetCurrentProcessorNumberEx(&processor);
+    if (GetNumaProcessorNodeEx(&processor, &node))
+        return node;
+#elif defined(VS_TARGET_OS_LINUX)
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && static_cast<size_t>(cpu) < cpuNodes.size())
+        return cpuNodes[cpu];
+#endif
+    return -1;
+}
+
+size_t MemoryUse::getNUMANodeCount() const {
+    return nodeCPUs.size();
+}
+
+bool MemoryUse::bindCurrentThreadToNode(int node) const {
+    if (node < 0 || static_cast<size_t>(node) >= nodeCPUs.size())
+        return false;
+#if defined(VS_TARGET_OS_WINDOWS)
+    GROUP_AFFINITY affinity;
+    return GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) && SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#elif defined(VS_TARGET_OS_LINUX)
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    for (int cpu : nodeCPUs[node])
+        CPU_SET(cpu, &affinity);
+    return sched_setaffinity(0, sizeof(affinity), &affinity) == 0;
+#else
+    return false;
+#endif
+}
+
+uint8_t *MemoryUse::allocBuffer(size_t bytes, int &node) {
+    node = numaLocal ? getCurrentNUMANode() : -1;
+    {
+        std::lock_guard<std::mutex> lock(bufferLock);
+        auto iter = buffers.find(std::make_pair(bytes, node));
+        if (iter != buffers.end()) {
+            uint8_t *buf = iter->second;
+            buffers.erase(iter);
+            unusedBufferSize -= bytes;
+            ++bufferHits;
+            return buf;
+        }
+    }
+
+    ++bufferMisses;
+    uint8_t *buf = allocateMemory(bytes, node);
+    if (buf)
+        add(bytes);
+    return buf;
+}
+
+void MemoryUse::freeBuffer(uint8_t *buf, size_t bytes, int node) {
+    {
+        // keep at most 1/8 of the memory limit around in unused buffers
+        std::lock_guard<std::mutex> lock(bufferLock);
+        if (!freeOnZero && unusedBufferSize + bytes <= getLimit() / 8) {
+            buffers.insert(std::make_pair(std::make_pair(bytes, node), buf));
+            unusedBufferSize += bytes;
+            return;
+        }
+    }
+
+    freeMemory(buf, bytes);
+    subtract(bytes);
+}
+
+void MemoryUse::trimBuffers(size_t maxUnused) {
+    std::vector<std::pair<size_t, uint8_t *>> freed;
+    {
+        std::lock_guard<std::mutex> lock(bufferLock);
+        // the biggest buffers are released first since they give back the most memory
+        while (unusedBufferSize > maxUnused) {
+            auto iter = std::prev(buffers.end());
+            unusedBufferSize -= iter->first.first;
+            freed.push_back(std::make_pair(iter->first.first, iter->second));
+            buffers.erase(iter);
+        }
+    }
+
+    for (const auto &iter : freed) {
+        freeMemory(iter.second, iter.first);
+        subtract(iter.first);
+    }
+}
+
+void MemoryUse::getStatistics(VSMap *stats) {
+    vs_internal_vsapi.mapSetInt(stats, "bufferPoolHits", bufferHits, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "bufferPoolMisses", bufferMisses, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "dedupSharedPlanes", dedupShared, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "dedupSharedBytes", dedupSharedBytes, maReplace);
+    {
+        std::lock_guard<std::mutex> lock(dedupLock);
+        vs_internal_vsapi.mapSetInt(stats, "dedupRegisteredPlanes", dedupPlanes.size(), maReplace);
+    }
+    vs_internal_vsapi.mapSetInt(stats, "compressedCacheSize", compressedUsed, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "scratchMemory", scratchUsed, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "memoryUsed", used, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "memoryLimit", getLimit(), maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "memoryHardLimit", hardLimit, maReplace);
+    std::lock_guard<std::mutex> lock(bufferLock);
+    vs_internal_vsapi.mapSetInt(stats, "bufferPoolSize", unusedBufferSize, maReplace);
 }
 
 void MemoryUse::signalFree() {
-    freeOnZero = true;
+    trimBuffers(0);
+    {
+        std::lock_guard<std::mutex> lock(bufferLock);
+        freeOnZero = true;
+    }
     if (!used)
         delete this;
 }
 
-MemoryUse::MemoryUse() : used(0), freeOnZero(false) {
+MemoryUse::MemoryUse() : used(0), hardLimit(0), freeOnZero(false), unusedBufferSize(0), bufferHits(0), bufferMisses(0), hugePages(false), numaLocal(false), deduplicate(false), dedupShared(0), dedupSharedBytes(0), compressedUsed(0), scratchUsed(0) {
     // 1GB
     setMaxMemoryUse(1024 * 1024 * 1024);
 
@@ -183,13 +840,30 @@ MemoryUse::MemoryUse() : used(0), freeOnZero(false) {
 
 ///////////////
 
+void VSNodeMemory::add(size_t bytes) noexcept {
+    int64_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void VSNodeMemory::subtract(size_t bytes) noexcept {
+    liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+///////////////
+
 VSPlaneData::VSPlaneData(size_t dataSize, MemoryUse &mem) noexcept : refcount(1), mem(mem), size(dataSize + 2 * VSFrame::guardSpace) {
-    data = vsh_aligned_malloc<uint8_t>(size + 2 * VSFrame::guardSpace, VSFrame::alignment);
+    data = mem.allocBuffer(size, node);
     assert(data);
     if (!data)
         VS_FATAL_ERROR("Failed to allocate memory for plane. Out of memory.");
 
-    mem.add(size);
+    if (currentNodeMemory) {
+        owner = *currentNodeMemory;
+        owner->add(size);
+    }
+
 #ifdef VS_FRAME_GUARD
     for (size_t i = 0; i < VSFrame::guardSpace / sizeof(VS_FRAME_GUARD_PATTERN); i++) {
         reinterpret_cast<uint32_t *>(data)[i] = VS_FRAME_GUARD_PATTERN;
@@ -198,47 +872,168 @@ VSPlaneData::VSPlaneData(size_t dataSize, MemoryUse &mem) noexcept : refcount(1)
 #endif
 }
 
+// copies this large would push a good part of the last level cache out and most of the plane isn't read again soon, so
+// they're written around the cache instead of evicting the working sets of other threads
+static const size_t streamCopyThreshold = 4 * 1024 * 1024;
+// planes of 8k frames and up are also split into blocks that idle workers help copying
+static const size_t parallelCopyThreshold = 32 * 1024 * 1024;
+static const size_t parallelCopyBlockSize = 1024 * 1024;
+
+struct PlaneCopyData {
+    uint8_t *dst;
+    const uint8_t *src;
+    size_t size;
+};
+
+static void copyPlaneBlocks(uint8_t *dst, const uint8_t *src, size_t size) {
+#ifdef VS_TARGET_CPU_X86
+    vs_copy_stream_sse2(dst, src, size);
+#else
+    vs_copy_stream_c(dst, src, size);
+#endif
+}
+
+static void VS_CC copyPlaneSlice(int start, int end, void *userData) {
+    const PlaneCopyData *d = reinterpret_cast<const PlaneCopyData *>(userData);
+    size_t offset = static_cast<size_t>(start) * parallelCopyBlockSize;
+    size_t last = std::min(static_cast<size_t>(end) * parallelCopyBlockSize, d->size);
+    copyPlaneBlocks(d->dst + offset, d->src + offset, last - offset);
+}
+
+static void copyPlane(uint8_t *dst, const uint8_t *src, size_t size) {
+    if (size < streamCopyThreshold) {
+        memcpy(dst, src, size);
+    } else if (size >= parallelCopyThreshold && currentOutputKey.first) {
+        // only possible inside a getframe function since the slices are run by the thread pool
+        PlaneCopyData d = { dst, src, size };
+        int blocks = static_cast<int>((size + parallelCopyBlockSize - 1) / parallelCopyBlockSize);
+        currentOutputKey.first->processSlices(blocks, static_cast<int>(parallelCopyThreshold / (2 * parallelCopyBlockSize)), copyPlaneSlice, &d);
+    } else {
+        copyPlaneBlocks(dst, src, size);
+    }
+}
+
 VSPlaneData::VSPlaneData(const VSPlaneData &d) noexcept : refcount(1), mem(d.mem), size(d.size) {
-    data = vsh_aligned_malloc<uint8_t>(size, VSFrame::alignment);
+    data = mem.allocBuffer(size, node);
     assert(data);
     if (!data)
         VS_FATAL_ERROR("Failed to allocate memory for plane in copy constructor. Out of memory.");
 
-    mem.add(size);
-    memcpy(data, d.data, size);
+    // copies are made when a filter writes to a shared plane so they belong to the writer
+    if (currentNodeMemory) {
+        owner = *currentNodeMemory;
+        owner->add(size);
+    }
+
+    copyPlane(data, d.data, size);
+}
+
+// the data pointer is moved back by the guard space so plane pointers work the same as for allocated memory
+VSPlaneData::VSPlaneData(uint8_t *externalData, size_t dataSize, bool writable, const std::shared_ptr<void> &owner, MemoryUse &mem, bool pinned) noexcept : refcount(1), mem(mem), node(0), externalOwner(owner), externalWritable(writable), pinned(pinned), data(externalData - VSFrame::guardSpace), size(dataSize + 2 * VSFrame::guardSpace) {
+}
+
+VSPlaneData::VSPlaneData(void *handle, size_t dataSize, const VSDeviceMemoryFunctions *functions, void *userData, const std::shared_ptr<void> &owner, MemoryUse &mem) noexcept : refcount(1), mem(mem), node(0), externalOwner(owner), deviceHandle(handle), deviceFunctions(functions), deviceUserData(userData), data(nullptr), size(dataSize + 2 * VSFrame::guardSpace) {
+}
+
+// the host copy is made once and kept next to the device memory since the plane can't change anymore, it counts like any other plane
+void VSPlaneData::download() noexcept {
+    std::call_once(downloaded, [this]() {
+        uint8_t *buffer = mem.allocBuffer(size, node);
+        if (!buffer)
+            VS_FATAL_ERROR("Failed to allocate memory for downloading a device plane. Out of memory.");
+        if (deviceFunctions->download(deviceHandle, buffer + VSFrame::guardSpace, size - 2 * VSFrame::guardSpace, deviceUserData))
+            VS_FATAL_ERROR("Failed to download a device plane.");
+        data = buffer;
+    });
 }
 
 VSPlaneData::~VSPlaneData() {
-    vsh_aligned_free(data);
-    mem.subtract(size);
+    if (dedupRegistered)
+        mem.forgetPlane(this);
+    if (!externalOwner || (deviceFunctions && data))
+        mem.freeBuffer(data, size, node);
+    if (owner)
+        owner->subtract(size);
+}
+
+size_t VSFrame::getPlaneDataSize() const noexcept {
+    size_t bytes = 0;
+    for (int i = 0; i < 3; i++) {
+        if (data[i])
+            bytes += data[i]->size;
+    }
+    return bytes;
+}
+
+size_t VSFrame::getReclaimableSize() const noexcept {
+    if (refcount != 1)
+        return 0;
+
+    size_t bytes = 0;
+    for (int i = 0; i < 3; i++) {
+        if (data[i] && data[i]->onlyReference())
+            bytes += data[i]->size;
+    }
+    return bytes;
+}
+
+void VSFrame::deduplicatePlanes() noexcept {
+    if (refcount != 1 || contentType != mtVideo)
+        return;
+
+    for (int i = 0; i < numPlanes; i++) {
+        // views share their plane with the frame they were made from and only cover part of it
+        if (offset[i])
+            continue;
+        core->memory->deduplicatePlane(data[i], stride[i], static_cast<size_t>(getWidth(i)) * format.vf.bytesPerSample, getHeight(i));
+    }
 }
 
 bool VSPlaneData::unique() noexcept {
-    return (refcount == 1);
+    return (refcount == 1) && !dedupRegistered && (!externalOwner || externalWritable);
 }
 
 void VSPlaneData::add_ref() noexcept {
-    ++refcount;
+    refcount.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool VSPlaneData::tryAddRef() noexcept {
+    long count = refcount.load();
+    while (count > 0) {
+        if (refcount.compare_exchange_weak(count, count + 1))
+            return true;
+    }
+    return false;
 }
 
 void VSPlaneData::release() noexcept {
-    if (!--refcount)
+    // unlike frames the count can't be read first since the deduplication registry may revive a plane with tryAddRef()
+    if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
         delete this;
 }
 
 ///////////////
 
-VSFrame::VSFrame(const VSVideoFormat &f, int width, int height, const VSFrame *propSrc, VSCore *core) noexcept : refcount(1), contentType(mtVideo), v3format(nullptr), width(width), height(height), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
+// with ccfPadStrides a stride that's a multiple of 4096 bytes gets an extra cache line, otherwise every row of the plane
+// maps to the same cache sets and vertical kernels keep evicting the rows they're about to read
+static int planeStride(int rowSize, const VSCore *core) noexcept {
+    int stride = (rowSize + (VSFrame::alignment - 1)) & ~(VSFrame::alignment - 1);
+    if (core->padStrides && !(stride % 4096))
+        stride += std::max(VSFrame::alignment, 64);
+    return stride;
+}
+
+VSFrame::VSFrame(const VSVideoFormat &f, int width, int height, const VSFrame *propSrc, VSCore *core) noexcept : refcount(1), contentType(mtVideo), width(width), height(height), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
     if (width <= 0 || height <= 0)
         core->logFatal("Error in frame creation: dimensions are negative (" + std::to_string(width) + "x" + std::to_string(height) + ")");
 
     format.vf = f;
     numPlanes = format.vf.numPlanes;
 
-    stride[0] = (width * (f.bytesPerSample) + (alignment - 1)) & ~(alignment - 1);
+    stride[0] = planeStride(width * format.vf.bytesPerSample, core);
 
     if (numPlanes == 3) {
-        int plane23 = ((width >> format.vf.subSamplingW) * (format.vf.bytesPerSample) + (alignment - 1)) & ~(alignment - 1);
+        int plane23 = planeStride((width >> format.vf.subSamplingW) * format.vf.bytesPerSample, core);
         stride[1] = plane23;
         stride[2] = plane23;
     } else {
@@ -254,17 +1049,17 @@ VSFrame::VSFrame(const VSVideoFormat &f, int width, int height, const VSFrame *p
     }
 }
 
-VSFrame::VSFrame(const VSVideoFormat &f, int width, int height, const VSFrame * const *planeSrc, const int *plane, const VSFrame *propSrc, VSCore *core) noexcept : refcount(1), contentType(mtVideo), v3format(nullptr), width(width), height(height), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
+VSFrame::VSFrame(const VSVideoFormat &f, int width, int height, const VSFrame * const *planeSrc, const int *plane, const VSFrame *propSrc, VSCore *core) noexcept : refcount(1), contentType(mtVideo), width(width), height(height), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
     if (width <= 0 || height <= 0)
         core->logFatal("Error in frame creation: dimensions are negative " + std::to_string(width) + "x" + std::to_string(height));
 
     format.vf = f;
     numPlanes = format.vf.numPlanes;
 
-    stride[0] = (width * (format.vf.bytesPerSample) + (alignment - 1)) & ~(alignment - 1);
+    stride[0] = planeStride(width * format.vf.bytesPerSample, core);
 
     if (numPlanes == 3) {
-        int plane23 = ((width >> format.vf.subSamplingW) * (format.vf.bytesPerSample) + (alignment - 1)) & ~(alignment - 1);
+        int plane23 = planeStride((width >> format.vf.subSamplingW) * format.vf.bytesPerSample, core);
         stride[1] = plane23;
         stride[2] = plane23;
     } else {
@@ -280,6 +1075,8 @@ VSFrame::VSFrame(const VSVideoFormat &f, int width, int height, const VSFrame *
                 core->logFatal("Error in frame creation: dimensions of plane " + std::to_string(plane[i]) + " do not match. Source: " + std::to_string(planeSrc[i]->getWidth(plane[i])) + "x" + std::to_string(planeSrc[i]->getHeight(plane[i])) + "; destination: " + std::to_string(getWidth(i)) + "x" + std::to_string(getHeight(i)));
             data[i] = planeSrc[i]->data[plane[i]];
             data[i]->add_ref();
+            stride[i] = planeSrc[i]->stride[plane[i]];
+            offset[i] = planeSrc[i]->offset[plane[i]];
         } else {
             if (i == 0) {
                 data[i] = new VSPlaneData(stride[i] * height, *core->memory);
@@ -291,7 +1088,7 @@ VSFrame::VSFrame(const VSVideoFormat &f, int width, int height, const VSFrame *
 }
 
 VSFrame::VSFrame(const VSAudioFormat &f, int numSamples, const VSFrame *propSrc, VSCore *core) noexcept
-    : refcount(1), contentType(mtAudio), v3format(nullptr), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
+    : refcount(1), contentType(mtAudio), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
     if (numSamples <= 0)
         core->logFatal("Error in frame creation: bad number of samples (" + std::to_string(numSamples) + ")");
     
@@ -300,13 +1097,13 @@ VSFrame::VSFrame(const VSAudioFormat &f, int numSamples, const VSFrame *propSrc,
 
     width = numSamples;
 
-    stride[0] = format.af.bytesPerSample * VS_AUDIO_FRAME_SAMPLES;
+    stride[0] = format.af.bytesPerSample * core->getAudioFrameSamples();
 
     data[0] = new VSPlaneData(stride[0] * format.af.numChannels, *core->memory);
 }
 
 VSFrame::VSFrame(const VSAudioFormat &f, int numSamples, const VSFrame * const *channelSrc, const int *channel, const VSFrame *propSrc, VSCore *core) noexcept
-    : refcount(1), contentType(mtAudio), v3format(nullptr), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
+    : refcount(1), contentType(mtAudio), properties(propSrc ? &propSrc->properties : nullptr), core(core) {
     if (numSamples <= 0)
         core->logFatal("Error in frame creation: bad number of samples (" + std::to_string(numSamples) + ")");
 
@@ -315,7 +1112,7 @@ VSFrame::VSFrame(const VSAudioFormat &f, int numSamples, const VSFrame * const *
 
     width = numSamples;
 
-    stride[0] = format.af.bytesPerSample * VS_AUDIO_FRAME_SAMPLES;
+    stride[0] = format.af.bytesPerSample * core->getAudioFrameSamples();
 
     data[0] = new VSPlaneData(stride[0] * format.af.numChannels, *core->memory);
 
@@ -330,7 +1127,7 @@ VSFrame::VSFrame(const VSAudioFormat &f, int numSamples, const VSFrame * const *
     }
 }
 
-VSFrame::VSFrame(const VSFrame &f) noexcept : refcount(1), v3format(nullptr) {
+VSFrame::VSFrame(const VSFrame &f) noexcept : refcount(1) {
     contentType = f.contentType;
     data[0] = f.data[0];
     data[1] = f.data[1];
@@ -347,10 +1144,131 @@ VSFrame::VSFrame(const VSFrame &f) noexcept : refcount(1), v3format(nullptr) {
     stride[0] = f.stride[0];
     stride[1] = f.stride[1];
     stride[2] = f.stride[2];
+    offset[0] = f.offset[0];
+    offset[1] = f.offset[1];
+    offset[2] = f.offset[2];
     properties = f.properties;
     core = f.core;
 }
 
+VSFrame::VSFrame(const VSFrame &f, VSCore *core) noexcept : VSFrame(f) {
+    this->core = core;
+}
+
+VSFrame *VSFrame::createView(const VSFrame *src, int left, int top, int width, int height, int field, const VSFrame *propSrc) noexcept {
+    assert(src->contentType == mtVideo);
+    const VSVideoFormat &f = src->format.vf;
+    int rowStep = (field >= 0) ? 2 : 1;
+
+    if (left < 0 || top < 0 || width <= 0 || height <= 0 || field < -1 || field > 1)
+        return nullptr;
+    if (left % (1 << f.subSamplingW) || top % (1 << f.subSamplingH) || width % (1 << f.subSamplingW) || height % (1 << f.subSamplingH))
+        return nullptr;
+
+    ptrdiff_t newOffset[3] = {};
+    for (int i = 0; i < src->numPlanes; i++) {
+        int ssW = i ? f.subSamplingW : 0;
+        int ssH = i ? f.subSamplingH : 0;
+        int firstRow = (top >> ssH) + std::max(field, 0);
+        if ((left >> ssW) + (width >> ssW) > src->getWidth(i) || firstRow + ((height >> ssH) - 1) * rowStep >= src->getHeight(i))
+            return nullptr;
+        newOffset[i] = src->offset[i] + firstRow * src->stride[i] + (left >> ssW) * f.bytesPerSample;
+        // filters may rely on aligned planes so unaligned views are left to the caller to copy
+        if (newOffset[i] % alignment || (src->stride[i] * rowStep) % alignment)
+            return nullptr;
+    }
+
+    VSFrame *view = new VSFrame(*src);
+    view->width = width;
+    view->height = height;
+    for (int i = 0; i < src->numPlanes; i++) {
+        view->offset[i] = newOffset[i];
+        view->stride[i] = src->stride[i] * rowStep;
+    }
+    view->properties = propSrc ? propSrc->properties : src->properties;
+    return view;
+}
+
+VSFrame *VSFrame::createAudioView(const VSFrame *src, int start, int numSamples, const VSFrame *propSrc) noexcept {
+    assert(src->contentType == mtAudio);
+
+    if (start < 0 || numSamples <= 0 || start + static_cast<int64_t>(numSamples) > src->width)
+        return nullptr;
+
+    ptrdiff_t newOffset = src->offset[0] + static_cast<ptrdiff_t>(start) * src->format.af.bytesPerSample;
+    // the same as for video views, channels that aren't aligned are left to the caller to copy
+    if (newOffset % alignment)
+        return nullptr;
+
+    VSFrame *view = new VSFrame(*src);
+    view->width = numSamples;
+    view->offset[0] = newOffset;
+    view->properties = propSrc ? propSrc->properties : src->properties;
+    return view;
+}
+
+VSFrame *VSFrame::createFromBuffers(const VSVideoFormat &f, int width, int height, uint8_t * const *planes, const ptrdiff_t *strides, bool writable, VSFreeFrameBuffer free, void *userData, const VSFrame *propSrc, VSCore *core) noexcept {
+    if (width <= 0 || height <= 0 || width % (1 << f.subSamplingW) || height % (1 << f.subSamplingH))
+        return nullptr;
+
+    for (int i = 0; i < f.numPlanes; i++) {
+        if (!planes[i] || reinterpret_cast<uintptr_t>(planes[i]) % alignment || strides[i] % alignment || strides[i] < static_cast<ptrdiff_t>(width >> (i ? f.subSamplingW : 0)) * f.bytesPerSample)
+            return nullptr;
+    }
+
+    // all planes share one owner so free is only called after the last of them is gone
+    std::shared_ptr<void> owner(userData, [free](void *p) {
+        if (free)
+            free(p);
+    });
+
+    // the regular plane data is allocated by the constructor and replaced right away, it's small enough not to matter compared to keeping the frame layout in one place
+    VSFrame *frame = new VSFrame(f, (1 << f.subSamplingW), (1 << f.subSamplingH), propSrc, core);
+    frame->width = width;
+    frame->height = height;
+    for (int i = 0; i < f.numPlanes; i++) {
+        frame->data[i]->release();
+        frame->stride[i] = strides[i];
+        frame->data[i] = new VSPlaneData(planes[i], strides[i] * frame->getHeight(i), writable, owner, *core->memory);
+    }
+    return frame;
+}
+
+VSFrame *VSFrame::createFromDevice(const VSVideoFormat &f, int width, int height, void * const *handles, const ptrdiff_t *strides, VSMemoryDomain domain, const VSDeviceMemoryFunctions *functions, void *userData, const VSFrame *propSrc, VSCore *core) noexcept {
+    // every plane is released on its own since a write only replaces the plane it's for
+    std::shared_ptr<void> owners[3];
+    for (int i = 0; i < f.numPlanes; i++) {
+        void *handle = handles[i];
+        owners[i] = std::shared_ptr<void>(handle, [functions, userData](void *p) {
+            functions->free(p, userData);
+        });
+    }
+
+    if (width <= 0 || height <= 0 || width % (1 << f.subSamplingW) || height % (1 << f.subSamplingH) || (domain != mdPinnedHost && domain != mdDevice))
+        return nullptr;
+
+    for (int i = 0; i < f.numPlanes; i++) {
+        if (!handles[i] || strides[i] % alignment || strides[i] < static_cast<ptrdiff_t>(width >> (i ? f.subSamplingW : 0)) * f.bytesPerSample)
+            return nullptr;
+        if (domain == mdPinnedHost && reinterpret_cast<uintptr_t>(handles[i]) % alignment)
+            return nullptr;
+    }
+
+    VSFrame *frame = new VSFrame(f, (1 << f.subSamplingW), (1 << f.subSamplingH), propSrc, core);
+    frame->width = width;
+    frame->height = height;
+    for (int i = 0; i < f.numPlanes; i++) {
+        frame->data[i]->release();
+        frame->stride[i] = strides[i];
+        size_t planeSize = strides[i] * frame->getHeight(i);
+        if (domain == mdPinnedHost)
+            frame->data[i] = new VSPlaneData(static_cast<uint8_t *>(handles[i]), planeSize, false, owners[i], *core->memory, true);
+        else
+            frame->data[i] = new VSPlaneData(handles[i], planeSize, functions, userData, owners[i], *core->memory);
+    }
+    return frame;
+}
+
 VSFrame::~VSFrame() {
     data[0]->release();
     if (data[1]) {
@@ -361,9 +1279,7 @@ VSFrame::~VSFrame() {
 
 const vs3::VSVideoFormat *VSFrame::getVideoFormatV3() const noexcept {
     assert(contentType == mtVideo);
-    if (!v3format)
-        v3format = core->VideoFormatToV3(format.vf);
-    return v3format;
+    return core->VideoFormatToV3(format.vf);
 }
 
 ptrdiff_t VSFrame::getStride(int plane) const {
@@ -378,9 +1294,36 @@ const uint8_t *VSFrame::getReadPtr(int plane) const {
         return nullptr;
 
     if (contentType == mtVideo)
-        return data[plane]->data + guardSpace;
+        return data[plane]->getHostData() + guardSpace + offset[plane];
     else
-        return data[0]->data + guardSpace + plane * stride[0];
+        return data[0]->data + guardSpace + offset[0] + plane * stride[0];
+}
+
+// the value is stored with the plane data so frames and views sharing it keep knowing it's constant
+void VSFrame::setPlaneConstant(int plane, uint32_t value) noexcept {
+    if (plane < 0 || plane >= numPlanes || contentType != mtVideo)
+        return;
+    data[plane]->constantValue = value;
+    data[plane]->constant.store(true, std::memory_order_release);
+}
+
+bool VSFrame::getPlaneConstant(int plane, uint32_t &value) const noexcept {
+    if (plane < 0 || plane >= numPlanes || contentType != mtVideo || !data[plane]->constant.load(std::memory_order_acquire))
+        return false;
+    value = data[plane]->constantValue;
+    return true;
+}
+
+VSMemoryDomain VSFrame::getMemoryDomain(int plane) const {
+    if (plane < 0 || plane >= numPlanes || contentType != mtVideo)
+        return mdHost;
+    return data[plane]->getDomain();
+}
+
+void *VSFrame::getDeviceHandle(int plane, int deviceType) const {
+    if (plane < 0 || plane >= numPlanes || contentType != mtVideo || offset[plane])
+        return nullptr;
+    return data[plane]->getDeviceHandle(deviceType);
 }
 
 uint8_t *VSFrame::getWritePtr(int plane) {
@@ -389,27 +1332,49 @@ uint8_t *VSFrame::getWritePtr(int plane) {
 
     // copy the plane data if this isn't the only reference
     if (contentType == mtVideo) {
-        if (!data[plane]->unique()) {
+        if (!writeInPlace && !data[plane]->unique()) {
             VSPlaneData *old = data[plane];
-            data[plane] = new VSPlaneData(*data[plane]);
+            size_t viewSize = stride[plane] * getHeight(plane);
+            if (offset[plane] || old->isExternal() || old->size != viewSize + 2 * guardSpace) {
+                // only copy the visible part of views and keep the stride unchanged
+                data[plane] = new VSPlaneData(viewSize, *core->memory);
+                size_t rowSize = getWidth(plane) * format.vf.bytesPerSample;
+                const uint8_t *src = old->getHostData() + guardSpace + offset[plane];
+                for (int y = 0; y < getHeight(plane); y++)
+                    memcpy(data[plane]->data + guardSpace + y * stride[plane], src + y * stride[plane], rowSize);
+                offset[plane] = 0;
+            } else {
+                data[plane] = new VSPlaneData(*data[plane]);
+            }
             old->release();
         }
 
-        return data[plane]->data + guardSpace;
+        data[plane]->constant.store(false, std::memory_order_relaxed);
+        return data[plane]->data + guardSpace + offset[plane];
     } else {
         if (!data[0]->unique()) {
             VSPlaneData *old = data[0];
-            data[0] = new VSPlaneData(*data[0]);
+            if (offset[0]) {
+                // only copy the samples a view covers
+                data[0] = new VSPlaneData(stride[0] * numPlanes, *core->memory);
+                for (int i = 0; i < numPlanes; i++)
+                    memcpy(data[0]->data + guardSpace + i * stride[0], old->data + guardSpace + offset[0] + i * stride[0], width * format.af.bytesPerSample);
+                offset[0] = 0;
+            } else {
+                data[0] = new VSPlaneData(*data[0]);
+            }
             old->release();
         }
 
-        return data[0]->data + guardSpace + plane * stride[0];
+        return data[0]->data + guardSpace + offset[0] + plane * stride[0];
     }
 }
 
 #ifdef VS_FRAME_GUARD
 bool VSFrame::verifyGuardPattern() const {
     for (int p = 0; p < ((contentType == mtVideo) ? numPlanes : 1); p++) {
+        if (data[p]->isExternal())
+            continue;
         for (size_t i = 0; i < guardSpace / sizeof(VS_FRAME_GUARD_PATTERN); i++) {
             uint32_t p1 = reinterpret_cast<uint32_t *>(data[p]->data)[i];
             uint32_t p2 = reinterpret_cast<uint32_t *>(data[p]->data + data[p]->size - guardSpace)[i];
@@ -525,73 +1490,205 @@ void VSPluginFunction::parseArgString(const std::string &argString, std::vector<
 
 VSPluginFunction::VSPluginFunction(const std::string &name, const std::string &argString, const std::string &returnType, VSPublicFunction func, void *functionData, VSPlugin *plugin)
     : func(func), functionData(functionData), plugin(plugin), name(name), argString(argString), returnType(returnType) {
-    parseArgString(argString, inArgs, plugin->apiMajor);
+    // V3 plugins always need the arguments parsed to construct the V4 equivalent arg string
+    if (!plugin->deferArgParsing || plugin->apiMajor == 3) {
+        parseArgString(argString, inArgs, plugin->apiMajor);
+        if (returnType != "any")
+            parseArgString(returnType, retArgs, plugin->apiMajor);
+        bindArgs();
+        std::call_once(argsParsed, []() {});
+    }
     if (plugin->apiMajor == 3)
         this->argString = getV4ArgString(); // construct to V4 equivalent arg string
-    if (returnType != "any")
-        parseArgString(returnType, retArgs, plugin->apiMajor);
 }
 
-VSMap *VSPluginFunction::invoke(const VSMap &args) {
-    VSMap *v = new VSMap;
+void VSPluginFunction::parseArgs() const {
+    std::call_once(argsParsed, [this]() {
+        parseArgString(argString, inArgs, plugin->apiMajor);
+        if (returnType != "any")
+            parseArgString(returnType, retArgs, plugin->apiMajor);
+        bindArgs();
+    });
+}
 
-    try {
-        std::set<std::string> remainingArgs;
-        for (size_t i = 0; i < args.size(); i++)
-            remainingArgs.insert(args.key(i));
-
-        for (const FilterArgument &fa : inArgs) {
-            // ptUnset as an argument type means any value is accepted beyond the declared ones
-            if (fa.type == ptUnset) {
-                // this will always be the last argument, therefore it's safe to clear out the remaining ones since they'll
-                // already have been checked
-                remainingArgs.clear();
-                continue;
-            }
+void VSPluginFunction::bindArgs() const {
+    argBindings.clear();
+    for (size_t i = 0; i < inArgs.size(); i++) {
+        // ptUnset as an argument type means any value is accepted beyond the declared ones
+        if (inArgs[i].type == ptUnset)
+            acceptsAnyArgs = true;
+        else
+            argBindings.emplace_back(VSMapStorage::internKey(inArgs[i].name.c_str()), i);
+    }
+    std::sort(argBindings.begin(), argBindings.end(), [](const std::pair<const char *, size_t> &a, const std::pair<const char *, size_t> &b) { return strcmp(a.first, b.first) < 0; });
+}
+
+// Walks the map keys and the declared arguments in the same order so no lookups are needed, the
+// reported error is the same one a check of the arguments in declaration order would find first
+void VSPluginFunction::validateArgs(const VSMap &args) const {
+    size_t errorIndex = SIZE_MAX;
+    std::string error;
+    auto setError = [&errorIndex, &error](size_t index, const std::string &message) {
+        if (index < errorIndex) {
+            errorIndex = index;
+            error = message;
+        }
+    };
+    auto checkMissing = [this, &setError](size_t index) {
+        if (!inArgs[index].opt)
+            setError(index, name + ": argument " + inArgs[index].name + " is required");
+    };
+
+    std::string unknownArgs;
+    size_t b = 0;
+    for (size_t i = 0; i < args.size(); i++) {
+        const char *key = args.key(i);
+        while (b < argBindings.size() && argBindings[b].first != key && strcmp(argBindings[b].first, key) < 0)
+            checkMissing(argBindings[b++].second);
+
+        if (b < argBindings.size() && (argBindings[b].first == key || !strcmp(argBindings[b].first, key))) {
+            size_t index = argBindings[b++].second;
+            const FilterArgument &fa = inArgs[index];
+            VSArrayBase *arr = args.value(i);
+
+            if (fa.type != arr->type())
+                setError(index, name + ": argument " + fa.name + " is not of the correct type");
+            else if (!fa.arr && arr->size() > 1)
+                setError(index, name + ": argument " + fa.name + " is not of array type but more than one value was supplied");
+            else if (!fa.empty && arr->size() < 1)
+                setError(index, name + ": argument " + fa.name + " does not accept empty arrays");
+        } else if (!acceptsAnyArgs) {
+            if (!unknownArgs.empty())
+                unknownArgs += ", ";
+            unknownArgs += key;
+        }
+    }
+    while (b < argBindings.size())
+        checkMissing(argBindings[b++].second);
 
-            int propType = vs_internal_vsapi.mapGetType(&args, fa.name.c_str());
+    if (!error.empty())
+        throw VSException(error);
+    if (!unknownArgs.empty())
+        throw VSException(name + ": no argument(s) named " + unknownArgs);
+}
 
-            if (propType != ptUnset) {
-                remainingArgs.erase(fa.name);
+void VSPluginFunction::setImplementation(VSPublicFunction func, void *functionData) {
+    this->func = func;
+    this->functionData = functionData;
+}
 
-                if (fa.type != propType)
-                    throw VSException(name + ": argument " + fa.name + " is not of the correct type");
+// Identifies an invocation by function and arguments where nodes, frames and functions are compared by address.
+std::string VSPluginFunction::getMergeKey(const VSMap &args) const {
+    std::string key = plugin->getID() + '.' + name;
+    key += '\0';
+    auto append = [&key](const void *data, size_t size) { key.append(reinterpret_cast<const char *>(data), size); };
 
-                VSArrayBase *arr = args.find(fa.name);
+    for (size_t i = 0; i < args.size(); i++) {
+        const char *argName = args.key(i);
+        VSArrayBase *arr = args.find(argName);
+        int type = arr->type();
+        size_t count = arr->size();
+        key += argName;
+        key += '\0';
+        append(&type, sizeof(type));
+        append(&count, sizeof(count));
 
-                if (!fa.arr && arr->size() > 1)
-                    throw VSException(name + ": argument " + fa.name + " is not of array type but more than one value was supplied");
+        for (size_t j = 0; j < count; j++) {
+            switch (type) {
+            case ptInt:
+                append(&reinterpret_cast<VSIntArray *>(arr)->at(j), sizeof(int64_t));
+                break;
+            case ptFloat:
+                append(&reinterpret_cast<VSFloatArray *>(arr)->at(j), sizeof(double));
+                break;
+            case ptData: {
+                const VSMapData &d = reinterpret_cast<VSDataArray *>(arr)->at(j);
+                size_t size = d.size();
+                append(&d.typeHint, sizeof(d.typeHint));
+                append(&size, sizeof(size));
+                key.append(d.data(), size);
+                break;
+            }
+            case ptVideoNode:
+            case ptAudioNode: {
+                const VSNode *node = reinterpret_cast<VSVideoNodeArray *>(arr)->at(j).get();
+                append(&node, sizeof(node));
+                break;
+            }
+            case ptVideoFrame:
+            case ptAudioFrame: {
+                const VSFrame *frame = reinterpret_cast<VSVideoFrameArray *>(arr)->at(j).get();
+                append(&frame, sizeof(frame));
+                break;
+            }
+            case ptFunction: {
+                const VSFunction *func = reinterpret_cast<VSFunctionArray *>(arr)->at(j).get();
+                append(&func, sizeof(func));
+                break;
+            }
+            default:
+                return std::string();
+            }
+        }
+    }
+    return key;
+}
 
-                if (!fa.empty && arr->size() < 1)
-                    throw VSException(name + ": argument " + fa.name + " does not accept empty arrays");
+VSMap *VSPluginFunction::invoke(const VSMap &args) {
+    VSMap *v = new VSMap;
 
-            } else if (!fa.opt) {
-                throw VSException(name + ": argument " + fa.name + " is required");
-            }
+    try {
+        std::string loadError;
+        if (!plugin->ensureLoaded(loadError))
+            throw VSException(name + ": " + loadError);
+        if (!func)
+            throw VSException(name + ": the function is no longer provided by " + plugin->getFilename() + ", the plugin cache is outdated");
+
+        // maps that already passed for this function and weren't modified since don't need to be checked again
+        parseArgs();
+        if (args.validatedFor() != this) {
+            validateArgs(args);
+            args.setValidatedFor(this);
         }
 
-        if (!remainingArgs.empty()) {
-            auto iter = remainingArgs.cbegin();
-            std::string s = *iter;
-            ++iter;
-            for (; iter != remainingArgs.cend(); ++iter)
-                s += ", " + *iter;
-            throw VSException(name + ": no argument(s) named " + s);
+        std::string mergeKey;
+        if (plugin->core->mergeIdenticalFilters) {
+            mergeKey = getMergeKey(args);
+            if (!mergeKey.empty() && plugin->core->findMergedFilter(mergeKey, v))
+                return v;
         }
 
         bool enableGraphInspection = plugin->core->enableGraphInspection;
         if (enableGraphInspection) {
-            plugin->core->functionFrame = std::make_shared<VSFunctionFrame>(name, new VSMap(&args), plugin->core->functionFrame);
+            plugin->core->functionFrame = std::make_shared<VSFunctionFrame>(name, plugin, new VSMap(&args), plugin->core->functionFrame);
         }
         func(&args, v, functionData, plugin->core, getVSAPIInternal(plugin->apiMajor));
         if (enableGraphInspection) {
             assert(plugin->core->functionFrame);
-            plugin->core->functionFrame = plugin->core->functionFrame->next;
+            PVSFunctionFrame frame = plugin->core->functionFrame;
+            plugin->core->functionFrame = frame->next;
+
+            // the nodes created by this call remember where it returned them so the call can be replayed to get them back
+            for (size_t i = 0; i < v->size(); i++) {
+                VSArrayBase *arr = v->find(v->key(i));
+                if (arr->type() != ptVideoNode && arr->type() != ptAudioNode)
+                    continue;
+                for (size_t j = 0; j < arr->size(); j++) {
+                    VSNode *node = reinterpret_cast<VSVideoNodeArray *>(arr)->at(j).get();
+                    if (node->functionFrame == frame && node->creationOutputKey.empty()) {
+                        node->creationOutputKey = v->key(i);
+                        node->creationOutputIndex = static_cast<int>(j);
+                    }
+                }
+            }
         }
 
         if (plugin->apiMajor == VAPOURSYNTH3_API_MAJOR && !args.isV3Compatible())
             plugin->core->logFatal(name + ": filter node returned not yet supported type");
 
+        if (!mergeKey.empty() && !vs_internal_vsapi.mapGetError(v))
+            plugin->core->addMergedFilter(mergeKey, v);
+
     } catch (VSException &e) {
         vs_internal_vsapi.mapSetError(v, e.what());
     }
@@ -600,6 +1697,7 @@ VSMap *VSPluginFunction::invoke(const VSMap &args) {
 }
 
 bool VSPluginFunction::isV3Compatible() const {
+    parseArgs();
     for (const auto &iter : inArgs)
         if (iter.type == ptAudioNode || iter.type == ptAudioFrame)
             return false;
@@ -610,6 +1708,7 @@ bool VSPluginFunction::isV3Compatible() const {
 }
 
 std::string VSPluginFunction::getV4ArgString() const {
+    parseArgs();
     std::string tmp;
     for (const auto &iter : inArgs) {
         assert(iter.type != ptAudioNode && iter.type != ptAudioFrame);
@@ -644,6 +1743,7 @@ std::string VSPluginFunction::getV4ArgString() const {
 }
 
 std::string VSPluginFunction::getV3ArgString() const {
+    parseArgs();
     std::string tmp;
     for (const auto &iter : inArgs) {
         assert(iter.type != ptAudioNode && iter.type != ptAudioFrame);
@@ -690,7 +1790,7 @@ const std::string &VSPluginFunction::getReturnType() const {
 }
 
 VSNode::VSNode(const VSMap *in, VSMap *out, const std::string &name, vs3::VSFilterInit init, VSFilterGetFrame getFrame, VSFilterFree freeFunc, VSFilterMode filterMode, int flags, void *instanceData, int apiMajor, VSCore *core) :
-    refcount(1), nodeType(mtVideo), instanceData(instanceData), name(name), filterGetFrame(getFrame), freeFunc(freeFunc), filterMode(filterMode), apiMajor(apiMajor), core(core), serialFrame(-1) {
+    refcount(1), nodeType(mtVideo), instanceData(instanceData), name(name), filterGetFrame(getFrame), freeFunc(freeFunc), filterMode(filterMode), apiMajor(apiMajor), allFramesReady((apiMajor == VAPOURSYNTH3_API_MAJOR) ? static_cast<int>(vs3::arAllFramesReady) : static_cast<int>(arAllFramesReady)), core(core), serialFrame(-1) {
 
     if (flags & ~(vs3::nfNoCache | vs3::nfIsCache | vs3::nfMakeLinear))
         throw VSException("Filter " + name  + " specified unknown flags");
@@ -714,6 +1814,11 @@ VSNode::VSNode(const VSMap *in, VSMap *out, const std::string &name, vs3::VSFilt
         throw VSException("Filter " + name + " returned zero or negative frame count");
     }
 
+    if (core->compressEvictedFrames)
+        cache.enableCompression(core);
+    if (core->liveMode)
+        cache.setLive();
+
     core->filterInstanceCreated();
 
     // Scan the in map for clips, these are probably the real dependencies
@@ -735,13 +1840,17 @@ VSNode::VSNode(const VSMap *in, VSMap *out, const std::string &name, vs3::VSFilt
         }
     }
 
+    initSignature();
+
     if (core->enableGraphInspection) {
         functionFrame = core->functionFrame;
+        dependencyRequests = std::vector<std::atomic<int64_t>>(this->dependencies.size());
+        producedFrames = std::vector<std::atomic<uint64_t>>((vi.numFrames + 63) / 64);
     }
 }
 
 VSNode::VSNode(const std::string &name, const VSVideoInfo *vi, VSFilterGetFrame getFrame, VSFilterFree freeFunc, VSFilterMode filterMode, const VSFilterDependency *dependencies, int numDeps, void *instanceData, int apiMajor, VSCore *core) :
-    refcount(1), nodeType(mtVideo), instanceData(instanceData), name(name), filterGetFrame(getFrame), freeFunc(freeFunc), filterMode(filterMode), apiMajor(apiMajor), core(core), serialFrame(-1) {
+    refcount(1), nodeType(mtVideo), instanceData(instanceData), name(name), filterGetFrame(getFrame), freeFunc(freeFunc), filterMode(filterMode), apiMajor(apiMajor), allFramesReady((apiMajor == VAPOURSYNTH3_API_MAJOR) ? static_cast<int>(vs3::arAllFramesReady) : static_cast<int>(arAllFramesReady)), core(core), serialFrame(-1) {
 
     if (!core->isValidVideoInfo(*vi))
         throw VSException("The VSVideoInfo structure passed by " + name + " is invalid.");
@@ -749,6 +1858,11 @@ VSNode::VSNode(const std::string &name, const VSVideoInfo *vi, VSFilterGetFrame
     this->vi = *vi;
     this->v3vi = core->VideoInfoToV3(*vi);
 
+    if (core->compressEvictedFrames)
+        cache.enableCompression(core);
+    if (core->liveMode)
+        cache.setLive();
+
     core->filterInstanceCreated();
 
     this->dependencies.reserve(numDeps);
@@ -758,22 +1872,29 @@ VSNode::VSNode(const std::string &name, const VSVideoInfo *vi, VSFilterGetFrame
         dependencies[i].source->addConsumer(this, dependencies[i].requestPattern);
     }
 
+    initSignature();
+
     if (core->enableGraphInspection) {
         functionFrame = core->functionFrame;
+        dependencyRequests = std::vector<std::atomic<int64_t>>(this->dependencies.size());
+        producedFrames = std::vector<std::atomic<uint64_t>>((this->vi.numFrames + 63) / 64);
     }
 }
 
 VSNode::VSNode(const std::string &name, const VSAudioInfo *ai, VSFilterGetFrame getFrame, VSFilterFree freeFunc, VSFilterMode filterMode, const VSFilterDependency *dependencies, int numDeps, void *instanceData, int apiMajor, VSCore *core) :
-    refcount(1), nodeType(mtAudio), instanceData(instanceData), name(name), filterGetFrame(getFrame), freeFunc(freeFunc), filterMode(filterMode), apiMajor(apiMajor), core(core), serialFrame(-1) {
+    refcount(1), nodeType(mtAudio), instanceData(instanceData), name(name), filterGetFrame(getFrame), freeFunc(freeFunc), filterMode(filterMode), apiMajor(apiMajor), allFramesReady((apiMajor == VAPOURSYNTH3_API_MAJOR) ? static_cast<int>(vs3::arAllFramesReady) : static_cast<int>(arAllFramesReady)), core(core), serialFrame(-1) {
 
     if (!core->isValidAudioInfo(*ai))
         throw VSException("The VSAudioInfo structure passed by " + name + " is invalid.");
 
     this->ai = *ai;
-    int64_t maxSamples =  std::numeric_limits<int>::max() * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
+    demandedPlanes = allPlanes;
+    core->audioFrameSamplesLocked = true;
+    int frameSamples = core->getAudioFrameSamples();
+    int64_t maxSamples =  std::numeric_limits<int>::max() * static_cast<int64_t>(frameSamples);
     if (this->ai.numSamples > maxSamples)
         throw VSException("Filter " + name + " specified " + std::to_string(this->ai.numSamples) + " output samples but " + std::to_string(maxSamples) + " samples is the upper limit");
-    this->ai.numFrames = static_cast<int>((this->ai.numSamples + VS_AUDIO_FRAME_SAMPLES - 1) / VS_AUDIO_FRAME_SAMPLES);
+    this->ai.numFrames = static_cast<int>((this->ai.numSamples + frameSamples - 1) / frameSamples);
 
     core->filterInstanceCreated();
 
@@ -784,12 +1905,27 @@ VSNode::VSNode(const std::string &name, const VSAudioInfo *ai, VSFilterGetFrame
         dependencies[i].source->addConsumer(this, dependencies[i].requestPattern);
     }
 
+    initSignature();
+
     if (core->enableGraphInspection) {
         functionFrame = core->functionFrame;
+        dependencyRequests = std::vector<std::atomic<int64_t>>(this->dependencies.size());
+        producedFrames = std::vector<std::atomic<uint64_t>>((this->ai.numFrames + 63) / 64);
     }
 }
 
 VSNode::~VSNode() {
+    // the dedicated thread may be working ahead so it has to be stopped before its prefetches are canceled
+    if (dedicatedQueueSize > 0)
+        core->threadPool->setDedicatedThread(this, 0);
+
+    // prefetches are the only requests that can outlive all consumers of a node
+    if (numPrefetches > 0)
+        core->threadPool->forgetPrefetches(this);
+
+    if (core->mergeIdenticalFilters)
+        core->forgetMergedFilter(this);
+
     registerCache(false);
 
     cache.clear();
@@ -804,10 +1940,51 @@ VSNode::~VSNode() {
 
 void VSNode::registerCache(bool add) {
     std::lock_guard<std::mutex> lock(core->cacheLock);
-    if (add)
-        core->caches.insert(this);
-    else
+    if (add) {
+        if (core->caches.insert(this).second && !core->cacheSizeHints.empty())
+            applyCacheSizeHint();
+    } else {
         core->caches.erase(this);
+    }
+}
+
+// FNV-1a, signatures are stored between runs so std::hash can't be used
+static uint64_t hashSignature(uint64_t h, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ bytes[i]) * UINT64_C(0x100000001B3);
+    return h;
+}
+
+// made from the filter name, the output properties and the signatures of the inputs, nodes that would still be the same
+// are told apart by the order they were created in so the signatures stay the same as long as the script does
+void VSNode::initSignature() {
+    uint64_t h = hashSignature(UINT64_C(0xCBF29CE484222325), name.data(), name.size());
+    if (nodeType == mtVideo) {
+        const int64_t fields[] = { nodeType, vi.format.colorFamily, vi.format.sampleType, vi.format.bitsPerSample, vi.format.subSamplingW, vi.format.subSamplingH, vi.width, vi.height, vi.numFrames, vi.fpsNum, vi.fpsDen };
+        h = hashSignature(h, fields, sizeof(fields));
+    } else {
+        const int64_t fields[] = { nodeType, ai.format.sampleType, ai.format.bitsPerSample, static_cast<int64_t>(ai.format.channelLayout), ai.sampleRate, ai.numSamples };
+        h = hashSignature(h, fields, sizeof(fields));
+    }
+    for (const auto &iter : dependencies) {
+        const uint64_t fields[] = { iter.source->signature, static_cast<uint64_t>(iter.requestPattern) };
+        h = hashSignature(h, fields, sizeof(fields));
+    }
+    signature = core->uniqueSignature(h);
+}
+
+// called with cacheLock held, caches with a size set by the filter or user are left alone
+void VSNode::applyCacheSizeHint() {
+    auto it = core->cacheSizeHints.find(signature);
+    if (it == core->cacheSizeHints.end())
+        return;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!cache.getFixedSize()) {
+        cache.setMaxFrames(it->second.maxSize);
+        cache.setMaxHistory(it->second.maxHistorySize);
+    }
 }
 
 void VSNode::addConsumer(VSNode *consumer, int strictSpatial) {
@@ -815,7 +1992,7 @@ void VSNode::addConsumer(VSNode *consumer, int strictSpatial) {
         std::lock_guard<std::mutex> lock(cacheMutex);
         consumers.push_back({consumer, strictSpatial});
 
-        if (!cacheOverride)
+        if (!cacheOverride && !lightweight)
             cacheEnabled = (consumers.size() > 1) || (consumers.size() == 1 && !consumers[0].requestPattern);
     }
     registerCache(cacheEnabled);
@@ -831,7 +2008,7 @@ void VSNode::removeConsumer(VSNode *consumer, int strictSpatial) {
             }
         }
 
-        if (!cacheOverride)
+        if (!cacheOverride && !lightweight)
             cacheEnabled = (consumers.size() > 1) || (consumers.size() == 1 && !consumers[0].requestPattern);
 
         if (!cacheEnabled)
@@ -840,11 +2017,83 @@ void VSNode::removeConsumer(VSNode *consumer, int strictSpatial) {
     registerCache(cacheEnabled);
 }
 
+void VSNode::setLightweight(bool enable) {
+    // the frames are processed without looking at the filter mode so only filters that can take any number of them at once qualify
+    if (filterMode != fmParallel)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        lightweight = enable;
+        if (enable)
+            cacheEnabled = false;
+        else if (!cacheOverride)
+            cacheEnabled = (consumers.size() > 1) || (consumers.size() == 1 && !consumers[0].requestPattern);
+
+        if (!cacheEnabled)
+            cache.clear();
+    }
+    registerCache(cacheEnabled);
+}
+
+void VSNode::addDemandedPlanes(int planes) {
+    int old = demandedPlanes.fetch_or(planes, std::memory_order_relaxed);
+    if (!(planes & ~old))
+        return;
+
+    // frames made before may have left out the planes that are demanded now, this includes frames only requested for
+    // their properties while no plane was demanded
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache.clear();
+    }
+
+    planes |= old;
+    for (size_t i = 0; i < dependencies.size(); i++) {
+        int sourcePlanes = 0;
+        for (int p = 0; p < 3; p++) {
+            if (planes & (1 << p))
+                sourcePlanes |= dependencyPlanes.empty() ? allPlanes : dependencyPlanes[i * 3 + p];
+        }
+        dependencies[i].source->addDemandedPlanes(sourcePlanes);
+    }
+}
+
+bool VSNode::setPlaneDependency(int index, const int *planes) {
+    if (index < 0 || index >= static_cast<int>(dependencies.size()))
+        return false;
+    if (dependencyPlanes.empty())
+        dependencyPlanes.assign(dependencies.size() * 3, allPlanes);
+    for (int p = 0; p < 3; p++)
+        dependencyPlanes[index * 3 + p] = planes[p] & allPlanes;
+    return true;
+}
+
+bool VSNode::hasDependency(const VSNode *source) const {
+    for (const auto &iter : dependencies) {
+        if (iter.source == source)
+            return true;
+    }
+    return false;
+}
 
+// everything outside of filters may look at every plane
 void VSNode::getFrame(const PVSFrameContext &ct) {
+    addDemandedPlanes(allPlanes);
     core->threadPool->startExternal(ct);
 }
 
+void VSNode::getFrames(const std::vector<PVSFrameContext> &contexts) {
+    addDemandedPlanes(allPlanes);
+    core->threadPool->startExternal(contexts);
+}
+
+// requests made by filters only follow from the external ones and happen again by themselves when those are replayed
+void VSNode::recordRequest(int n, int priority) {
+    if (core->requestRecorder.isActive() && !currentOutputKey.first)
+        core->requestRecorder.add(n, outputIndex, outputAlpha, priority);
+}
+
 const VSVideoInfo &VSNode::getVideoInfo() const {
     return vi;
 }
@@ -881,7 +2130,21 @@ void VSNode::setVideoInfo3(const vs3::VSVideoInfo *vi, int numOutputs) {
     refcount = numOutputs;
 }
 
-const char *VSNode::getCreationFunctionName(int level) const {
+const char *VSNode::getCreationFunctionName(int level) const {
+    if (core->enableGraphInspection) {
+        VSFunctionFrame *frame = functionFrame.get();
+        for (int i = 0; i < level; i++) {
+            if (frame)
+                frame = frame->next.get();
+        }
+
+        if (frame)
+            return frame->name.c_str();
+    }
+    return nullptr;
+}
+
+const VSMap *VSNode::getCreationFunctionArguments(int level) const {
     if (core->enableGraphInspection) {
         VSFunctionFrame *frame = functionFrame.get();
         for (int i = 0; i < level; i++) {
@@ -890,12 +2153,12 @@ const char *VSNode::getCreationFunctionName(int level) const {
         }
 
         if (frame)
-            return frame->name.c_str();
+            return frame->args;
     }
     return nullptr;
 }
 
-const VSMap *VSNode::getCreationFunctionArguments(int level) const {
+VSPlugin *VSNode::getCreationFunctionPlugin(int level) const {
     if (core->enableGraphInspection) {
         VSFunctionFrame *frame = functionFrame.get();
         for (int i = 0; i < level; i++) {
@@ -904,18 +2167,29 @@ const VSMap *VSNode::getCreationFunctionArguments(int level) const {
         }
 
         if (frame)
-            return frame->args;
+            return frame->plugin;
+    }
+    return nullptr;
+}
+
+const char *VSNode::getCreationFunctionOutput(int *index) const {
+    if (core->enableGraphInspection && !creationOutputKey.empty()) {
+        if (index)
+            *index = creationOutputIndex;
+        return creationOutputKey.c_str();
     }
     return nullptr;
 }
 
 int VSNode::setLinear() {
+    // query the thread count before taking the cache lock, the thread pool may look at caches while holding its own locks
+    size_t threadCount = core->threadPool->threadCount();
     std::lock_guard<std::mutex> lock(cacheMutex);
     cacheLinear = true;
     cacheOverride = true;
     cacheEnabled = true;
     cache.setFixedSize(true);   
-    cache.setMaxFrames(core->threadPool->threadCount() * 2 + 20);
+    cache.setMaxFrames(static_cast<int>(threadCount * 2 + 20));
     registerCache(cacheEnabled);
     return cache.getMaxFrames() / 2;
 }
@@ -924,8 +2198,8 @@ void VSNode::setCacheMode(int mode) {
     {
         std::lock_guard<std::mutex> lock(cacheMutex);
 
-        if (cacheLinear || mode < -1 || mode > 1) {
-            // simply disregard cache mode changes for linear filters
+        if (cacheLinear || lightweight || mode < -1 || mode > 1) {
+            // simply disregard cache mode changes for linear and lightweight filters
             return;
         }
 
@@ -944,6 +2218,8 @@ void VSNode::setCacheMode(int mode) {
         cache.setFixedSize(false);
         cache.setMaxFrames(20);
         cache.setMaxHistory(20);
+        if (core->liveMode)
+            cache.setLive();
         if (!cacheEnabled)
             cache.clear();
     }
@@ -960,7 +2236,34 @@ void VSNode::setCacheOptions(int fixedSize, int maxSize, int maxHistorySize) {
         cache.setMaxHistory(maxHistorySize);
 }
 
+void VSNode::setConcurrency(int maxConcurrency, int64_t frameScratchSize, int64_t maxScratchSize) {
+    std::lock_guard<std::mutex> lock(concurrencyMutex);
+    if (maxConcurrency >= 0)
+        this->maxConcurrency = maxConcurrency;
+    if (frameScratchSize >= 0)
+        this->frameScratchSize = frameScratchSize;
+    if (maxScratchSize >= 0)
+        this->maxScratchSize = maxScratchSize;
+
+    int64_t limit = this->maxConcurrency;
+    if (this->frameScratchSize > 0 && this->maxScratchSize > 0) {
+        int64_t scratchLimit = std::max<int64_t>(this->maxScratchSize / this->frameScratchSize, 1);
+        limit = limit ? std::min(limit, scratchLimit) : scratchLimit;
+    }
+    concurrencyLimit = static_cast<int>(std::min<int64_t>(limit, INT_MAX));
+}
+
+void VSNode::setDedicatedThread(int queueSize) {
+    // parallel filters gain nothing from being tied to a single thread
+    if (filterMode == fmUnordered || filterMode == fmFrameState)
+        core->threadPool->setDedicatedThread(this, std::max(queueSize, 0));
+}
+
 PVSFrame VSNode::getCachedFrameInternal(int n) {
+    // only keys that are remembered without a frame need the full cache, they may have a compressed copy
+    PVSFrame f;
+    if (!cacheEnabled || cache.lookup(n, f))
+        return f;
     std::lock_guard<std::mutex> lock(cacheMutex);
     if (cacheEnabled)
         return cache.object(n);
@@ -968,18 +2271,60 @@ PVSFrame VSNode::getCachedFrameInternal(int n) {
         return nullptr;
 }
 
+bool VSNode::isCachedInternal(int n) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cacheEnabled && cache.contains(n);
+}
+
 PVSFrame VSNode::getFrameInternal(int n, int activationReason, VSFrameContext *frameCtx) {
     std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
-    bool enableGraphInspection = core->enableGraphInspection;
-    if (enableGraphInspection)
+    // the time is also needed to estimate the cost of recreating cached frames
+    bool measureTime = core->enableGraphInspection || core->costAwareEviction || core->frameProcessingTime;
+    if (measureTime)
         startTime = std::chrono::high_resolution_clock::now();
 
-    const VSFrame *r = (apiMajor == VAPOURSYNTH_API_MAJOR) ? filterGetFrame(n, activationReason, instanceData, frameCtx->frameContext, frameCtx, core, &vs_internal_vsapi) : reinterpret_cast<vs3::VSFilterGetFrame>(filterGetFrame)(n, activationReason, &instanceData, frameCtx->frameContext, frameCtx, core, &vs_internal_vsapi3);
+    // every frame requested together with the offers has been produced by now
+    if (activationReason != arInitial && activationReason != arFrameReady && !frameCtx->offeredDestinations.empty())
+        core->withdrawDestinations(frameCtx);
+
+    // restored afterwards since getFrame() may run another filter on the same thread
+    const std::shared_ptr<VSNodeMemory> *prevNodeMemory = currentNodeMemory;
+    NodeOutputKey prevOutputKey = currentOutputKey;
+    currentNodeMemory = &memory;
+    currentOutputKey = NodeOutputKey(this, n);
+    const VSFrame *r;
+    {
+        VSScratchScope scratch;
+        r = (apiMajor == VAPOURSYNTH_API_MAJOR) ? filterGetFrame(n, activationReason, instanceData, frameCtx->frameContext, frameCtx, core, &vs_internal_vsapi) : reinterpret_cast<vs3::VSFilterGetFrame>(filterGetFrame)(n, activationReason, &instanceData, frameCtx->frameContext, frameCtx, core, &vs_internal_vsapi3);
+    }
+    currentNodeMemory = prevNodeMemory;
+    currentOutputKey = prevOutputKey;
 
-    if (enableGraphInspection) {
+    // a returned frame is finished, writing to it from now on has to copy the shared planes like for any other frame
+    if (r)
+        const_cast<VSFrame *>(r)->setWriteInPlace(false);
+
+    if (measureTime) {
         std::chrono::nanoseconds duration = std::chrono::high_resolution_clock::now() - startTime;
         processingTime.fetch_add(duration.count(), std::memory_order_relaxed);
+        frameCtx->subgraphTime.fetch_add(duration.count(), std::memory_order_relaxed);
+        if (r && core->enableGraphInspection)
+            addLatency(duration.count());
+    }
+
+    // counted unconditionally so long running cores can be monitored without graph inspection
+    if (r)
+        framesProduced.fetch_add(1, std::memory_order_relaxed);
+
+    // live sources can grow past the size the bitmap was created with, those frames simply aren't counted
+    if (r && static_cast<size_t>(n / 64) < producedFrames.size()) {
+        uint64_t bit = static_cast<uint64_t>(1) << (n % 64);
+        if (!(producedFrames[n / 64].fetch_or(bit, std::memory_order_relaxed) & bit))
+            uniqueFramesProduced.fetch_add(1, std::memory_order_relaxed);
     }
+
+    // the api3 activation reasons only differ for arAllFramesReady
+    activationCalls[(activationReason == arInitial) ? 0 : ((activationReason == arError) ? 2 : 1)].fetch_add(1, std::memory_order_relaxed);
 #ifdef VS_TARGET_OS_WINDOWS
     if (!vs_isSSEStateOk())
         core->logFatal("Bad SSE state detected after return from "+ name);
@@ -998,7 +2343,8 @@ PVSFrame VSNode::getFrameInternal(int n, int activationReason, VSFrameContext *f
         } else {
             const VSAudioFormat *fi = r->getAudioFormat();
 
-            int expectedSamples = (n < ai.numFrames - 1) ? VS_AUDIO_FRAME_SAMPLES : (((ai.numSamples % VS_AUDIO_FRAME_SAMPLES) ? (ai.numSamples % VS_AUDIO_FRAME_SAMPLES) : VS_AUDIO_FRAME_SAMPLES));
+            int frameSamples = core->getAudioFrameSamples();
+            int expectedSamples = (n < ai.numFrames - 1) ? frameSamples : (((ai.numSamples % frameSamples) ? (ai.numSamples % frameSamples) : frameSamples));
 
             if (ai.format.bitsPerSample != fi->bitsPerSample || ai.format.sampleType != fi->sampleType || ai.format.channelLayout != fi->channelLayout) {
                 core->logFatal("Filter " + name + " returned a frame that's not of the declared format");
@@ -1008,12 +2354,21 @@ PVSFrame VSNode::getFrameInternal(int n, int activationReason, VSFrameContext *f
         }
 
 #ifdef VS_FRAME_GUARD
-        if (!r->verifyGuardPattern())
+#ifdef VS_FRAME_GUARD_SAMPLE_INTERVAL
+        // only every nth frame of a node is checked to bound the cost, starting with the first so broken filters are still caught early
+        bool checkGuard = guardChecks.fetch_add(1, std::memory_order_relaxed) % VS_FRAME_GUARD_SAMPLE_INTERVAL == 0;
+#else
+        bool checkGuard = true;
+#endif
+        if (checkGuard && !r->verifyGuardPattern())
             core->logFatal("Guard memory corrupted in frame " + std::to_string(n) + " returned from " + name);
 #endif
 
         PVSFrame ref(const_cast<VSFrame *>(r));
 
+        if (cacheEnabled && core->memory->deduplicationEnabled())
+            ref->deduplicatePlanes();
+
         if (cacheEnabled) {
             std::lock_guard<std::mutex> lock(cacheMutex);
             if (cacheEnabled)
@@ -1044,18 +2399,421 @@ bool VSNode::isWorkerThread() {
     return core->threadPool->isWorkerThread();
 }
 
+size_t VSNode::threadCount() {
+    return core->threadPool->threadCount();
+}
+
+void VSNode::processSlices(int count, int minSliceSize, VSSliceFunction func, void *userData) {
+    core->threadPool->processSlices(count, minSliceSize, func, userData);
+}
+
+VSAsyncRequest *VSNode::beginAsyncRequest(VSFrameContext *ctx) {
+    return core->threadPool->beginAsyncRequest(ctx);
+}
+
+void VSNode::readFileAsync(const std::string &filename, int64_t offset, int64_t size, VSMap *result, VSFrameContext *ctx) {
+    core->threadPool->readFileAsync(filename, offset, size, result, ctx);
+}
+
 void VSNode::notifyCache(bool needMemory) {
     std::lock_guard<std::mutex> lock(cacheMutex);
     cache.adjustSize(needMemory);
 }
 
+void VSNode::addLatency(int64_t nanoseconds) {
+    int bucket = 0;
+    if (nanoseconds >= latencyBucketsPerOctave) {
+        // the octave and the next three bits below the most significant one select the bucket
+        uint64_t v = static_cast<uint64_t>(nanoseconds);
+        int octave = 63;
+        while (!(v >> octave))
+            octave--;
+        bucket = (octave - 2) * latencyBucketsPerOctave + static_cast<int>((v >> (octave - 3)) & (latencyBucketsPerOctave - 1));
+    } else if (nanoseconds > 0) {
+        bucket = static_cast<int>(nanoseconds);
+    }
+    latencyHistogram[std::min(bucket, numLatencyBuckets - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t VSNode::getLatencyPercentile(double percentile) const {
+    uint64_t counts[numLatencyBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < numLatencyBuckets; i++) {
+        counts[i] = latencyHistogram[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile * total));
+    uint64_t seen = 0;
+    int bucket = 0;
+    for (; bucket < numLatencyBuckets - 1; bucket++) {
+        seen += counts[bucket];
+        if (seen >= rank)
+            break;
+    }
+
+    // the middle of the bucket
+    if (bucket < latencyBucketsPerOctave)
+        return bucket;
+    int octave = bucket / latencyBucketsPerOctave + 2;
+    uint64_t low = (static_cast<uint64_t>(latencyBucketsPerOctave + bucket % latencyBucketsPerOctave)) << (octave - 3);
+    return static_cast<int64_t>(low + (1ULL << (octave - 3)) / 2);
+}
+
+void VSNode::VSCache::getStatistics(VSMap *stats) const {
+    int64_t bytes = 0;
+    forEachFrame([&](int n, const PVSFrame &frame) {
+        bytes += frame->getPlaneDataSize();
+    });
+
+    int64_t compressedFrames = 0;
+    int64_t compressedBytes = 0;
+    for (const auto &n : nodes) {
+        if (n.compressed) {
+            compressedFrames++;
+            compressedBytes += n.compressed->size();
+        }
+    }
+
+    vs_internal_vsapi.mapSetInt(stats, "cacheHits", totalHits + pendingHits, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheNearMisses", totalNearMiss, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheMisses", totalFarMiss + pendingFarMisses, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheFrames", lists[T1].size + lists[T2].size, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheBytes", bytes, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheCompressedHits", totalCompressedHits, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheCompressedFrames", compressedFrames, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheCompressedBytes", compressedBytes, maReplace);
+}
+
+void VSNode::getStatistics(VSMap *stats) {
+    vs_internal_vsapi.mapSetInt(stats, "latencyP50", getLatencyPercentile(0.50), maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "latencyP95", getLatencyPercentile(0.95), maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "latencyP99", getLatencyPercentile(0.99), maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "initialCalls", activationCalls[0], maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "allFramesReadyCalls", activationCalls[1], maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "errorCalls", activationCalls[2], maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "serialLockFailures", serialLockFailures, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "serialLockWaitTime", serialLockWaitTime, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "framesProduced", framesProduced, maReplace);
+    if (!producedFrames.empty())
+        vs_internal_vsapi.mapSetInt(stats, "uniqueFramesProduced", uniqueFramesProduced, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "processingTime", processingTime, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "memoryLiveBytes", memory->liveBytes, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "memoryPeakBytes", memory->peakBytes, maReplace);
+    for (const auto &iter : dependencyRequests)
+        vs_internal_vsapi.mapSetInt(stats, "dependencyRequests", iter, maAppend);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.getStatistics(stats);
+}
+
+void VSNode::countRequest(VSNode *source) {
+    for (size_t i = 0; i < dependencyRequests.size(); i++) {
+        if (dependencies[i].source == source) {
+            dependencyRequests[i].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+void VSNode::getEvictionCandidates(std::vector<VSEvictionCandidate> &candidates) {
+    int64_t frames = framesProduced;
+    double costPerFrame = frames > 0 ? static_cast<double>(processingTime) / frames : 0;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.forEachFrame([&](int n, const PVSFrame &frame) {
+        // frames referenced from somewhere else won't free any memory when evicted
+        size_t bytes = frame->getReclaimableSize();
+        if (bytes > 0)
+            candidates.push_back({ costPerFrame / bytes, this, n, bytes });
+    });
+}
+
+bool VSNode::evictCachedFrame(int n) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cache.evictFrame(n);
+}
+
+void VSCore::evictCheapestFrames() {
+    std::vector<VSEvictionCandidate> candidates;
+    for (auto &cache : caches)
+        cache->getEvictionCandidates(candidates);
+
+    std::sort(candidates.begin(), candidates.end(), [](const VSEvictionCandidate &a, const VSEvictionCandidate &b) { return a.costPerByte < b.costPerByte; });
+
+    // free a bit more than strictly needed so this doesn't have to run again for every single request
+    size_t used = memory->memoryUse();
+    size_t limit = memory->getLimit();
+    size_t target = limit - limit / 8;
+
+    for (const auto &iter : candidates) {
+        if (used <= target)
+            break;
+        if (iter.node->evictCachedFrame(iter.n))
+            used -= std::min(used, iter.bytes);
+    }
+}
+
+static void collectGraph(VSNode *node, std::unordered_set<VSNode *> &visited, std::vector<VSNode *> &order) {
+    if (!visited.insert(node).second)
+        return;
+    const VSFilterDependency *deps = node->getDependencies();
+    for (size_t i = 0; i < node->getNumDependencies(); i++)
+        collectGraph(deps[i].source, visited, order);
+    // dependencies always come first
+    order.push_back(node);
+}
+
+// nodes in the arguments only match when they were already matched themselves, frames and functions
+// can't be compared across scripts so only the very same object matches
+static bool isSameArguments(const VSMap &a, const VSMap &b, const std::unordered_map<VSNode *, VSNode *> &matched) {
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++) {
+        const char *key = a.key(i);
+        VSArrayBase *arr1 = a.find(key);
+        VSArrayBase *arr2 = b.find(key);
+        if (!arr2 || arr1->type() != arr2->type() || arr1->size() != arr2->size())
+            return false;
+
+        for (size_t j = 0; j < arr1->size(); j++) {
+            switch (arr1->type()) {
+            case ptInt:
+                if (reinterpret_cast<VSIntArray *>(arr1)->at(j) != reinterpret_cast<VSIntArray *>(arr2)->at(j))
+                    return false;
+                break;
+            case ptFloat: {
+                double d1 = reinterpret_cast<VSFloatArray *>(arr1)->at(j);
+                double d2 = reinterpret_cast<VSFloatArray *>(arr2)->at(j);
+                if (memcmp(&d1, &d2, sizeof(d1)))
+                    return false;
+                break;
+            }
+            case ptData: {
+                const VSMapData &d1 = reinterpret_cast<VSDataArray *>(arr1)->at(j);
+                const VSMapData &d2 = reinterpret_cast<VSDataArray *>(arr2)->at(j);
+                if (!(d1 == d2))
+                    return false;
+                break;
+            }
+            case ptVideoNode:
+            case ptAudioNode: {
+                auto iter = matched.find(reinterpret_cast<VSVideoNodeArray *>(arr1)->at(j).get());
+                if (iter == matched.end() || iter->second != reinterpret_cast<VSVideoNodeArray *>(arr2)->at(j).get())
+                    return false;
+                break;
+            }
+            case ptVideoFrame:
+            case ptAudioFrame:
+                if (reinterpret_cast<VSVideoFrameArray *>(arr1)->at(j).get() != reinterpret_cast<VSVideoFrameArray *>(arr2)->at(j).get())
+                    return false;
+                break;
+            case ptFunction:
+                if (reinterpret_cast<VSFunctionArray *>(arr1)->at(j).get() != reinterpret_cast<VSFunctionArray *>(arr2)->at(j).get())
+                    return false;
+                break;
+            default:
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int VSCore::transferCaches(VSNode *dst, VSNode *src) {
+    std::unordered_set<VSNode *> visited;
+    std::vector<VSNode *> dstNodes;
+    std::vector<VSNode *> srcNodes;
+    collectGraph(dst, visited, dstNodes);
+    visited.clear();
+    collectGraph(src, visited, srcNodes);
+
+    // the function frames are only recorded with graph inspection enabled, without them nothing can be matched
+    std::multimap<std::string, VSNode *> candidates;
+    for (VSNode *node : srcNodes) {
+        if (node->functionFrame)
+            candidates.insert(std::make_pair(node->name, node));
+    }
+
+    std::unordered_map<VSNode *, VSNode *> matched;
+    std::unordered_set<VSNode *> used;
+    int numFrames = 0;
+
+    for (VSNode *node : dstNodes) {
+        if (!node->functionFrame)
+            continue;
+
+        VSNode *match = nullptr;
+        auto range = candidates.equal_range(node->name);
+        for (auto iter = range.first; iter != range.second && !match; ++iter) {
+            VSNode *candidate = iter->second;
+            if (used.count(candidate) || candidate->nodeType != node->nodeType || candidate->functionFrame->name != node->functionFrame->name)
+                continue;
+            if (node->nodeType == mtVideo) {
+                if (!isSameVideoInfo(&node->vi, &candidate->vi) || node->vi.numFrames != candidate->vi.numFrames || node->vi.fpsNum != candidate->vi.fpsNum || node->vi.fpsDen != candidate->vi.fpsDen)
+                    continue;
+            } else if (!isSameAudioInfo(&node->ai, &candidate->ai) || node->ai.numSamples != candidate->ai.numSamples) {
+                continue;
+            }
+            if (node->dependencies.size() != candidate->dependencies.size())
+                continue;
+            bool sameDeps = true;
+            for (size_t i = 0; i < node->dependencies.size() && sameDeps; i++) {
+                auto dep = matched.find(node->dependencies[i].source);
+                sameDeps = dep != matched.end() && dep->second == candidate->dependencies[i].source && node->dependencies[i].requestPattern == candidate->dependencies[i].requestPattern;
+            }
+            if (sameDeps && isSameArguments(*node->functionFrame->args, *candidate->functionFrame->args, matched))
+                match = candidate;
+        }
+
+        if (!match)
+            continue;
+        matched[node] = match;
+        used.insert(match);
+
+        if (!node->cacheEnabled)
+            continue;
+
+        std::vector<std::pair<int, PVSFrame>> frames;
+        {
+            std::lock_guard<std::mutex> lock(match->cacheMutex);
+            match->cache.forEachFrame([&frames](int n, const PVSFrame &frame) { frames.push_back(std::make_pair(n, frame)); });
+        }
+
+        std::lock_guard<std::mutex> lock(node->cacheMutex);
+        for (auto &iter : frames) {
+            if (node->cache.contains(iter.first))
+                continue;
+            // the planes stay accounted to the memory of the core that allocated them
+            if (match->core != node->core)
+                iter.second = PVSFrame(new VSFrame(*iter.second, node->core));
+            node->cache.insert(iter.first, std::move(iter.second));
+            numFrames++;
+        }
+    }
+
+    return numFrames;
+}
+
+bool VSCore::offerDestination(NodeOutputKey key, VSFrame *dst, int left, int top, VSFrameContext *consumer) {
+    std::lock_guard<std::mutex> lock(destinationLock);
+    // only the first offer for a frame is used, the other consumers simply copy it
+    if (!destinations.insert(std::make_pair(key, FrameDestination{ { dst, true }, left, top, consumer, nullptr })).second)
+        return false;
+    numDestinations++;
+    dst->setWriteInPlace(true);
+    consumer->offeredDestinations.push_back(key);
+    consumer->destinationCore = this;
+    return true;
+}
+
+VSFrame *VSCore::takeDestination(const VSVideoFormat &format, int width, int height, const VSFrame *propSrc) {
+    if (!numDestinations.load(std::memory_order_relaxed) || !currentOutputKey.first)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(destinationLock);
+    auto iter = destinations.find(currentOutputKey);
+    if (iter == destinations.end() || iter->second.view)
+        return nullptr;
+
+    FrameDestination &d = iter->second;
+    if (!isSameVideoFormat(&format, d.frame->getVideoFormat()))
+        return nullptr;
+
+    // views that would be unaligned aren't created so the frame is allocated normally and copied by the consumer
+    VSFrame *view = VSFrame::createView(d.frame.get(), d.left, d.top, width, height, -1, propSrc);
+    if (!view)
+        return nullptr;
+    if (!propSrc)
+        view->getProperties().clear();
+    view->setWriteInPlace(true);
+    d.view = PVSFrame(view, true);
+    return view;
+}
+
+void VSCore::withdrawDestinations(VSFrameContext *consumer) {
+    std::lock_guard<std::mutex> lock(destinationLock);
+    for (const auto &key : consumer->offeredDestinations) {
+        auto iter = destinations.find(key);
+        if (iter == destinations.end() || iter->second.consumer != consumer)
+            continue;
+        // a producer that kept the frame for itself has to copy it before writing to it again
+        if (iter->second.view)
+            iter->second.view->setWriteInPlace(false);
+        destinations.erase(iter);
+        numDestinations--;
+    }
+    consumer->offeredDestinations.clear();
+}
+
 void VSCore::notifyCaches(bool needMemory) {
     std::lock_guard<std::mutex> lock(cacheLock);
+    // unused buffers are the cheapest memory to give back
+    if (needMemory) {
+        memory->trimBuffers(0);
+        if (!memory->isOverLimit())
+            return;
+    }
+
+    if (needMemory && costAwareEviction) {
+        evictCheapestFrames();
+        return;
+    }
     for (auto &cache : caches)
         cache->notifyCache(needMemory);
 }
 
+static constexpr int v3FormatFamilies = 5;
+static constexpr int v3FormatPropertySlots = v3FormatFamilies * 2 * 25 * 5 * 5;
+static constexpr int v3FormatIdRange = 128;
+static constexpr int v3FormatFirstGeneratedId = 1000;
+static constexpr int v3FormatIdSlots = v3FormatFamilies * 2 * v3FormatIdRange;
+
+static int v3FamilyIndex(int colorFamily) noexcept {
+    switch (colorFamily) {
+    case vs3::cmGray: return 0;
+    case vs3::cmRGB: return 1;
+    case vs3::cmYUV: return 2;
+    case vs3::cmYCoCg: return 3;
+    case vs3::cmCompat: return 4;
+    default: return -1;
+    }
+}
+
+// every combination of properties registerVideoFormat3() accepts has its own slot
+static int v3FormatPropertySlot(int colorFamily, int sampleType, int bitsPerSample, int subSamplingW, int subSamplingH) noexcept {
+    int family = v3FamilyIndex(colorFamily);
+    if (family < 0 || sampleType < 0 || sampleType > 1 || bitsPerSample < 8 || bitsPerSample > 32 || subSamplingW < 0 || subSamplingW > 4 || subSamplingH < 0 || subSamplingH > 4)
+        return -1;
+    return (((family * 2 + sampleType) * 25 + bitsPerSample - 8) * 5 + subSamplingW) * 5 + subSamplingH;
+}
+
+// the named formats have small offsets from their family and the rest are numbered from v3FormatFirstGeneratedId,
+// ids that don't fit are only found in the locked map
+static int v3FormatIdSlot(int id) noexcept {
+    if (id <= 0)
+        return -1;
+    int offset = id % 1000000;
+    int family = v3FamilyIndex(id - offset);
+    if (family < 0)
+        return -1;
+    if (offset < v3FormatIdRange)
+        return family * 2 * v3FormatIdRange + offset;
+    if (offset >= v3FormatFirstGeneratedId && offset < v3FormatFirstGeneratedId + v3FormatIdRange)
+        return (family * 2 + 1) * v3FormatIdRange + offset - v3FormatFirstGeneratedId;
+    return -1;
+}
+
 const vs3::VSVideoFormat *VSCore::getV3VideoFormat(int id) {
+    std::call_once(videoFormatsRegistered, [this]() { registerFormats(); });
+    int slot = v3FormatIdSlot(id);
+    if (slot >= 0)
+        return v3FormatsById[slot].load(std::memory_order_acquire);
+
     std::lock_guard<std::mutex> lock(videoFormatLock);
 
     auto f = videoFormats.find(id);
@@ -1112,6 +2870,11 @@ uint32_t VSCore::queryVideoFormatID(VSColorFamily colorFamily, VSSampleType samp
 }
 
 const vs3::VSVideoFormat *VSCore::queryVideoFormat3(vs3::VSColorFamily colorFamily, VSSampleType sampleType, int bitsPerSample, int subSamplingW, int subSamplingH, const char *name, int id) noexcept {
+    std::call_once(videoFormatsRegistered, [this]() { registerFormats(); });
+    return registerVideoFormat3(colorFamily, sampleType, bitsPerSample, subSamplingW, subSamplingH, name, id);
+}
+
+const vs3::VSVideoFormat *VSCore::registerVideoFormat3(vs3::VSColorFamily colorFamily, VSSampleType sampleType, int bitsPerSample, int subSamplingW, int subSamplingH, const char *name, int id) noexcept {
     if (subSamplingH < 0 || subSamplingW < 0 || subSamplingH > 4 || subSamplingW > 4)
         return nullptr;
 
@@ -1130,15 +2893,18 @@ const vs3::VSVideoFormat *VSCore::queryVideoFormat3(vs3::VSColorFamily colorFami
     if (colorFamily == vs3::cmCompat && !name)
         return nullptr;
 
-    std::lock_guard<std::mutex> lock(videoFormatLock);
+    int propertySlot = v3FormatPropertySlot(colorFamily, sampleType, bitsPerSample, subSamplingW, subSamplingH);
+    if (propertySlot < 0)
+        return nullptr;
 
-    for (const auto &iter : videoFormats) {
-        const vs3::VSVideoFormat &f = iter.second;
+    if (const vs3::VSVideoFormat *f = v3FormatsByProperties[propertySlot].load(std::memory_order_acquire))
+        return f;
 
-        if (f.colorFamily == colorFamily && f.sampleType == sampleType
-                && f.subSamplingW == subSamplingW && f.subSamplingH == subSamplingH && f.bitsPerSample == bitsPerSample)
-            return &f;
-    }
+    std::lock_guard<std::mutex> lock(videoFormatLock);
+
+    // another thread may have registered it while the lock was being taken
+    if (const vs3::VSVideoFormat *f = v3FormatsByProperties[propertySlot].load(std::memory_order_relaxed))
+        return f;
 
     vs3::VSVideoFormat f{};
 
@@ -1202,8 +2968,12 @@ const vs3::VSVideoFormat *VSCore::queryVideoFormat3(vs3::VSColorFamily colorFami
     f.subSamplingH = subSamplingH;
     f.numPlanes = (colorFamily == vs3::cmGray || colorFamily == vs3::cmCompat) ? 1 : 3;
 
-    videoFormats.insert(std::make_pair(f.id, f));
-    return &videoFormats[f.id];
+    const vs3::VSVideoFormat *registered = &videoFormats.insert(std::make_pair(f.id, f)).first->second;
+    v3FormatsByProperties[propertySlot].store(registered, std::memory_order_release);
+    int idSlot = v3FormatIdSlot(f.id);
+    if (idSlot >= 0)
+        v3FormatsById[idSlot].store(registered, std::memory_order_release);
+    return registered;
 }
 
 bool VSCore::queryAudioFormat(VSAudioFormat &f, VSSampleType sampleType, int bitsPerSample, uint64_t channelLayout) noexcept {
@@ -1227,6 +2997,7 @@ bool VSCore::queryAudioFormat(VSAudioFormat &f, VSSampleType sampleType, int bit
 }
 
 bool VSCore::isValidFormatPointer(const void *f) {
+    std::call_once(videoFormatsRegistered, [this]() { registerFormats(); });
     {
         std::lock_guard<std::mutex> lock(videoFormatLock);
 
@@ -1256,7 +3027,40 @@ bool VSCore::removeLogHandler(VSLogHandle *rec) {
 }
 
 void VSCore::logMessage(VSMessageType type, const char *msg) {
+    if (type != mtFatal && asyncLogging.load(std::memory_order_acquire)) {
+        // a filter stuck logging in a loop would otherwise use up all memory before anything is delivered
+        if (logQueueSize.fetch_add(1, std::memory_order_relaxed) >= maxQueuedLogMessages) {
+            logQueueSize.fetch_sub(1, std::memory_order_relaxed);
+            logDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        LogEntry *entry = new LogEntry{ nullptr, type, currentNodeMemory, msg };
+        LogEntry *head = logQueue.load(std::memory_order_relaxed);
+        do {
+            entry->next = head;
+        } while (!logQueue.compare_exchange_weak(head, entry, std::memory_order_release, std::memory_order_relaxed));
+
+        // the log thread also wakes up regularly so a wakeup lost because the mutex isn't taken only delays delivery
+        if (!head)
+            logWake.notify_one();
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(logMutex);
+    if (type == mtFatal && asyncLogging) {
+        // deliver what's still queued first since it probably explains the fatal error
+        LogEntry *entry = logQueue.exchange(nullptr, std::memory_order_acquire);
+        std::vector<LogEntry *> entries;
+        for (; entry; entry = entry->next)
+            entries.push_back(entry);
+        for (auto iter = entries.rbegin(); iter != entries.rend(); ++iter)
+            deliverLogMessage((*iter)->type, (*iter)->msg.c_str());
+    }
+    deliverLogMessage(type, msg);
+}
+
+void VSCore::deliverLogMessage(VSMessageType type, const char *msg) {
     for (auto iter : messageHandlers)
         iter->handler(type, msg, iter->userData);
 
@@ -1287,6 +3091,79 @@ void VSCore::logMessage(VSMessageType type, const std::string &msg) {
     logMessage(type, msg.c_str());
 }
 
+void VSCore::deliverQueuedLogMessages(bool flushRepeats) {
+    LogEntry *entry = logQueue.exchange(nullptr, std::memory_order_acquire);
+    std::vector<LogEntry *> entries;
+    for (; entry; entry = entry->next)
+        entries.push_back(entry);
+    logQueueSize.fetch_sub(entries.size(), std::memory_order_relaxed);
+
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t dropped = logDropped.exchange(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(logMutex);
+
+    // the stack holds the newest message first
+    for (auto iter = entries.rbegin(); iter != entries.rend(); ++iter) {
+        LogEntry *e = *iter;
+        bool deliver = true;
+        if (e->source) {
+            auto result = logRepeats.insert({ { e->source, e->msg }, LogRepeat{ e->type, now, 0 } });
+            if (!result.second) {
+                LogRepeat &repeat = result.first->second;
+                if (now - repeat.windowStart < logRepeatWindow) {
+                    repeat.suppressed++;
+                    deliver = false;
+                } else {
+                    if (repeat.suppressed)
+                        deliverLogMessage(repeat.type, (e->msg + " (repeated " + std::to_string(repeat.suppressed) + " more times)").c_str());
+                    repeat = LogRepeat{ e->type, now, 0 };
+                }
+            }
+        }
+        if (deliver)
+            deliverLogMessage(e->type, e->msg.c_str());
+        delete e;
+    }
+
+    // report the repeats of messages that stopped and forget them
+    for (auto iter = logRepeats.begin(); iter != logRepeats.end();) {
+        if (flushRepeats || now - iter->second.windowStart >= logRepeatWindow) {
+            if (iter->second.suppressed)
+                deliverLogMessage(iter->second.type, (iter->first.second + " (repeated " + std::to_string(iter->second.suppressed) + " more times)").c_str());
+            iter = logRepeats.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    if (dropped)
+        deliverLogMessage(mtWarning, ("Dropped " + std::to_string(dropped) + " log messages because too many were queued").c_str());
+}
+
+void VSCore::runLogThread() {
+    std::unique_lock<std::mutex> lock(logWakeMutex);
+    while (!stopLogThread) {
+        logWake.wait_for(lock, std::chrono::milliseconds(100), [this] { return stopLogThread || logQueue.load(std::memory_order_relaxed); });
+        lock.unlock();
+        deliverQueuedLogMessages(false);
+        lock.lock();
+    }
+}
+
+void VSCore::stopAsyncLogging() {
+    if (!asyncLogging)
+        return;
+    asyncLogging = false;
+    {
+        std::lock_guard<std::mutex> lock(logWakeMutex);
+        stopLogThread = true;
+    }
+    logWake.notify_one();
+    logThread.join();
+    deliverQueuedLogMessages(true);
+}
+
 [[noreturn]] void VSCore::logFatal(const char *msg) {
     logMessage(mtFatal, msg);
     std::terminate();
@@ -1483,6 +3360,13 @@ void VSCore::getCoreInfo(VSCoreInfo &info) {
     info.usedFramebufferSize = memory->memoryUse();
 }
 
+void VSCore::getStartupStatistics(VSMap *stats) {
+    vs_internal_vsapi.mapSetInt(stats, "startupTime", startupTotalTime, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "startupThreadPoolTime", startupThreadPoolTime, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "startupInternalPluginsTime", startupInternalPluginsTime, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "startupAutoloadTime", startupAutoloadTime, maReplace);
+}
+
 bool VSCore::getAudioFormatName(const VSAudioFormat &format, char *buffer) noexcept {
     if (!isValidAudioFormat(format.sampleType, format.bitsPerSample, format.channelLayout))
         return false;
@@ -1576,53 +3460,56 @@ void VS_CC loadPluginInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
 }
 
 void VSCore::registerFormats() {
+    v3FormatsByProperties.reset(new std::atomic<const vs3::VSVideoFormat *>[v3FormatPropertySlots]());
+    v3FormatsById.reset(new std::atomic<const vs3::VSVideoFormat *>[v3FormatIdSlots]());
+
     // Register known formats with informational names
-    queryVideoFormat3(vs3::cmGray, stInteger,  8, 0, 0, "Gray8", vs3::pfGray8);
-    queryVideoFormat3(vs3::cmGray, stInteger, 16, 0, 0, "Gray16", vs3::pfGray16);
+    registerVideoFormat3(vs3::cmGray, stInteger,  8, 0, 0, "Gray8", vs3::pfGray8);
+    registerVideoFormat3(vs3::cmGray, stInteger, 16, 0, 0, "Gray16", vs3::pfGray16);
 
-    queryVideoFormat3(vs3::cmGray, stFloat,   16, 0, 0, "GrayH", vs3::pfGrayH);
-    queryVideoFormat3(vs3::cmGray, stFloat,   32, 0, 0, "GrayS", vs3::pfGrayS);
+    registerVideoFormat3(vs3::cmGray, stFloat,   16, 0, 0, "GrayH", vs3::pfGrayH);
+    registerVideoFormat3(vs3::cmGray, stFloat,   32, 0, 0, "GrayS", vs3::pfGrayS);
 
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 8, 1, 1, "YUV420P8", vs3::pfYUV420P8);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 8, 1, 0, "YUV422P8", vs3::pfYUV422P8);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 8, 0, 0, "YUV444P8", vs3::pfYUV444P8);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 8, 2, 2, "YUV410P8", vs3::pfYUV410P8);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 8, 2, 0, "YUV411P8", vs3::pfYUV411P8);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 8, 0, 1, "YUV440P8", vs3::pfYUV440P8);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 8, 1, 1, "YUV420P8", vs3::pfYUV420P8);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 8, 1, 0, "YUV422P8", vs3::pfYUV422P8);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 8, 0, 0, "YUV444P8", vs3::pfYUV444P8);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 8, 2, 2, "YUV410P8", vs3::pfYUV410P8);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 8, 2, 0, "YUV411P8", vs3::pfYUV411P8);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 8, 0, 1, "YUV440P8", vs3::pfYUV440P8);
 
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 9, 1, 1, "YUV420P9", vs3::pfYUV420P9);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 9, 1, 0, "YUV422P9", vs3::pfYUV422P9);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 9, 0, 0, "YUV444P9", vs3::pfYUV444P9);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 9, 1, 1, "YUV420P9", vs3::pfYUV420P9);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 9, 1, 0, "YUV422P9", vs3::pfYUV422P9);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 9, 0, 0, "YUV444P9", vs3::pfYUV444P9);
 
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 10, 1, 1, "YUV420P10", vs3::pfYUV420P10);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 10, 1, 0, "YUV422P10", vs3::pfYUV422P10);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 10, 0, 0, "YUV444P10", vs3::pfYUV444P10);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 10, 1, 1, "YUV420P10", vs3::pfYUV420P10);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 10, 1, 0, "YUV422P10", vs3::pfYUV422P10);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 10, 0, 0, "YUV444P10", vs3::pfYUV444P10);
 
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 12, 1, 1, "YUV420P12", vs3::pfYUV420P12);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 12, 1, 0, "YUV422P12", vs3::pfYUV422P12);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 12, 0, 0, "YUV444P12", vs3::pfYUV444P12);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 12, 1, 1, "YUV420P12", vs3::pfYUV420P12);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 12, 1, 0, "YUV422P12", vs3::pfYUV422P12);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 12, 0, 0, "YUV444P12", vs3::pfYUV444P12);
 
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 14, 1, 1, "YUV420P14", vs3::pfYUV420P14);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 14, 1, 0, "YUV422P14", vs3::pfYUV422P14);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 14, 0, 0, "YUV444P14", vs3::pfYUV444P14);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 14, 1, 1, "YUV420P14", vs3::pfYUV420P14);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 14, 1, 0, "YUV422P14", vs3::pfYUV422P14);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 14, 0, 0, "YUV444P14", vs3::pfYUV444P14);
 
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 16, 1, 1, "YUV420P16", vs3::pfYUV420P16);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 16, 1, 0, "YUV422P16", vs3::pfYUV422P16);
-    queryVideoFormat3(vs3::cmYUV,  stInteger, 16, 0, 0, "YUV444P16", vs3::pfYUV444P16);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 16, 1, 1, "YUV420P16", vs3::pfYUV420P16);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 16, 1, 0, "YUV422P16", vs3::pfYUV422P16);
+    registerVideoFormat3(vs3::cmYUV,  stInteger, 16, 0, 0, "YUV444P16", vs3::pfYUV444P16);
 
-    queryVideoFormat3(vs3::cmYUV,  stFloat,   16, 0, 0, "YUV444PH", vs3::pfYUV444PH);
-    queryVideoFormat3(vs3::cmYUV,  stFloat,   32, 0, 0, "YUV444PS", vs3::pfYUV444PS);
+    registerVideoFormat3(vs3::cmYUV,  stFloat,   16, 0, 0, "YUV444PH", vs3::pfYUV444PH);
+    registerVideoFormat3(vs3::cmYUV,  stFloat,   32, 0, 0, "YUV444PS", vs3::pfYUV444PS);
 
-    queryVideoFormat3(vs3::cmRGB,  stInteger, 8, 0, 0, "RGB24", vs3::pfRGB24);
-    queryVideoFormat3(vs3::cmRGB,  stInteger, 9, 0, 0, "RGB27", vs3::pfRGB27);
-    queryVideoFormat3(vs3::cmRGB,  stInteger, 10, 0, 0, "RGB30", vs3::pfRGB30);
-    queryVideoFormat3(vs3::cmRGB,  stInteger, 16, 0, 0, "RGB48", vs3::pfRGB48);
+    registerVideoFormat3(vs3::cmRGB,  stInteger, 8, 0, 0, "RGB24", vs3::pfRGB24);
+    registerVideoFormat3(vs3::cmRGB,  stInteger, 9, 0, 0, "RGB27", vs3::pfRGB27);
+    registerVideoFormat3(vs3::cmRGB,  stInteger, 10, 0, 0, "RGB30", vs3::pfRGB30);
+    registerVideoFormat3(vs3::cmRGB,  stInteger, 16, 0, 0, "RGB48", vs3::pfRGB48);
 
-    queryVideoFormat3(vs3::cmRGB,  stFloat,   16, 0, 0, "RGBH", vs3::pfRGBH);
-    queryVideoFormat3(vs3::cmRGB,  stFloat,   32, 0, 0, "RGBS", vs3::pfRGBS);
+    registerVideoFormat3(vs3::cmRGB,  stFloat,   16, 0, 0, "RGBH", vs3::pfRGBH);
+    registerVideoFormat3(vs3::cmRGB,  stFloat,   32, 0, 0, "RGBS", vs3::pfRGBS);
 
-    queryVideoFormat3(vs3::cmCompat, stInteger, 32, 0, 0, "CompatBGR32", vs3::pfCompatBGR32);
-    queryVideoFormat3(vs3::cmCompat, stInteger, 16, 1, 0, "CompatYUY2", vs3::pfCompatYUY2);
+    registerVideoFormat3(vs3::cmCompat, stInteger, 32, 0, 0, "CompatBGR32", vs3::pfCompatBGR32);
+    registerVideoFormat3(vs3::cmCompat, stInteger, 16, 1, 0, "CompatYUY2", vs3::pfCompatYUY2);
 }
 
 
@@ -1634,6 +3521,8 @@ bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &fi
     if (path.empty())
         return false;
 
+    std::vector<std::string> filenames;
+
 #ifdef VS_TARGET_OS_WINDOWS
     std::wstring wPath = path + L"\\" + filter;
     WIN32_FIND_DATA findData;
@@ -1641,11 +3530,7 @@ bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &fi
     if (findHandle == INVALID_HANDLE_VALUE)
         return false;
     do {
-        try {
-            loadPlugin(utf16_to_utf8(path + L"\\" + findData.cFileName));
-        } catch (VSException &) {
-            // Ignore any errors
-        }
+        filenames.push_back(utf16_to_utf8(path + L"\\" + findData.cFileName));
     } while (FindNextFile(findHandle, &findData));
     FindClose(findHandle);
 #else
@@ -1657,31 +3542,205 @@ bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &fi
     if (name_max == -1)
         name_max = 255;
 
-    while (true) {
-        struct dirent *result = readdir(dir);
-        if (!result) {
-            break;
+    while (true) {
+        struct dirent *result = readdir(dir);
+        if (!result) {
+            break;
+        }
+
+        std::string name(result->d_name);
+        // If name ends with filter
+        if (name.size() >= filter.size() && name.compare(name.size() - filter.size(), filter.size(), filter) == 0) {
+            std::string fullname;
+            fullname.append(path).append("/").append(name);
+            filenames.push_back(fullname);
+        }
+    }
+
+    if (closedir(dir)) {
+        // Shouldn't happen
+    }
+#endif
+
+    loadPlugins(filenames);
+    return true;
+}
+
+static bool getPluginFileInfo(const std::string &filename, std::string &fullPath, int64_t &mtime, int64_t &size) {
+#ifdef VS_TARGET_OS_WINDOWS
+    struct _stat64 st;
+    if (_wstat64(utf16_from_utf8(filename).c_str(), &st))
+        return false;
+    fullPath = filename;
+    for (auto &iter : fullPath)
+        if (iter == '\\')
+            iter = '/';
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st))
+        return false;
+    std::vector<char> fullPathBuffer(PATH_MAX + 1);
+    if (realpath(filename.c_str(), fullPathBuffer.data()))
+        fullPath = fullPathBuffer.data();
+    else
+        fullPath = filename;
+#endif
+    mtime = st.st_mtime;
+    size = st.st_size;
+    return true;
+}
+
+static std::vector<std::string> splitPluginCacheLine(const std::string &line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end - start));
+        if (end == std::string::npos)
+            return fields;
+        start = end + 1;
+    }
+}
+
+static FILE *openPluginCacheFile(const std::string &path, const char *mode) {
+#ifdef VS_TARGET_OS_WINDOWS
+    return _wfopen(utf16_from_utf8(path).c_str(), utf16_from_utf8(mode).c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+// The first line identifies the core since a different core may accept different plugins, followed by a P line
+// with the file information and plugin config for every plugin and one F line for each of its functions
+static const char pluginCacheHeader[] = "VapourSynthPluginCache\t" XSTR(VAPOURSYNTH_CORE_VERSION) "\t" XSTR(VAPOURSYNTH_API_MAJOR) "." XSTR(VAPOURSYNTH_API_MINOR);
+
+void VSCore::readPluginCache() {
+#ifdef VS_TARGET_OS_WINDOWS
+    std::vector<wchar_t> appDataBuffer(MAX_PATH + 1);
+    if (SHGetFolderPath(nullptr, CSIDL_LOCAL_APPDATA, nullptr, SHGFP_TYPE_CURRENT, appDataBuffer.data()) != S_OK)
+        return;
+    pluginCachePath = utf16_to_utf8(appDataBuffer.data()) + "\\VapourSynth\\plugincache";
+#else
+    const char *home = getenv("HOME");
+#ifdef VS_TARGET_OS_DARWIN
+    if (home)
+        pluginCachePath.append(home).append("/Library/Caches/VapourSynth/plugincache");
+#else
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home)
+        pluginCachePath.append(xdg_cache_home).append("/vapoursynth/plugincache");
+    else if (home)
+        pluginCachePath.append(home).append("/.cache/vapoursynth/plugincache");
+#endif
+#endif
+    if (pluginCachePath.empty())
+        return;
+
+    FILE *f = openPluginCacheFile(pluginCachePath, "rb");
+    if (!f)
+        return;
+    std::string data;
+    char buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.append(buffer, read);
+    fclose(f);
+
+    VSPluginCacheEntry *current = nullptr;
+    size_t start = 0;
+    bool first = true;
+    while (start < data.size()) {
+        size_t end = data.find('\n', start);
+        if (end == std::string::npos)
+            end = data.size();
+        std::string line = data.substr(start, end - start);
+        start = end + 1;
+
+        if (first) {
+            if (line != pluginCacheHeader)
+                return;
+            first = false;
+            continue;
         }
 
-        std::string name(result->d_name);
-        // If name ends with filter
-        if (name.size() >= filter.size() && name.compare(name.size() - filter.size(), filter.size(), filter) == 0) {
-            try {
-                std::string fullname;
-                fullname.append(path).append("/").append(name);
-                loadPlugin(fullname);
-            } catch (VSException &) {
-                // Ignore any errors
+        std::vector<std::string> fields = splitPluginCacheLine(line);
+        try {
+            if (fields[0] == "P" && fields.size() == 10) {
+                VSPluginCacheEntry &entry = pluginCache[fields[1]];
+                entry.mtime = std::stoll(fields[2]);
+                entry.size = std::stoll(fields[3]);
+                entry.id = fields[4];
+                entry.fnamespace = fields[5];
+                entry.fullname = fields[6];
+                entry.pluginVersion = std::stoi(fields[7]);
+                entry.apiMajor = std::stoi(fields[8]);
+                entry.apiMinor = std::stoi(fields[9]);
+                current = &entry;
+            } else if (fields[0] == "F" && fields.size() == 4 && current) {
+                current->functions.push_back({ fields[1], fields[2], fields[3] });
+            } else {
+                current = nullptr;
             }
+        } catch (std::logic_error &) {
+            // std::stoi and friends throw for garbage, skip the line and functions belonging to it
+            current = nullptr;
         }
     }
+}
 
-    if (closedir(dir)) {
-        // Shouldn't happen
+void VSCore::writePluginCache() {
+    if (!pluginCacheDirty || pluginCachePath.empty())
+        return;
+    pluginCacheDirty = false;
+
+    std::string data = pluginCacheHeader;
+    data += '\n';
+    auto isSafe = [](const std::string &s) { return s.find_first_of("\t\r\n") == std::string::npos; };
+    for (const auto &iter : pluginCache) {
+        const VSPluginCacheEntry &entry = iter.second;
+        bool safe = isSafe(iter.first) && isSafe(entry.id) && isSafe(entry.fnamespace) && isSafe(entry.fullname);
+        for (const auto &func : entry.functions)
+            safe = safe && isSafe(func[0]) && isSafe(func[1]) && isSafe(func[2]);
+        if (!safe)
+            continue;
+        data += "P\t" + iter.first + "\t" + std::to_string(entry.mtime) + "\t" + std::to_string(entry.size) + "\t" + entry.id + "\t" + entry.fnamespace + "\t" + entry.fullname + "\t" +
+            std::to_string(entry.pluginVersion) + "\t" + std::to_string(entry.apiMajor) + "\t" + std::to_string(entry.apiMinor) + "\n";
+        for (const auto &func : entry.functions)
+            data += "F\t" + func[0] + "\t" + func[1] + "\t" + func[2] + "\n";
+    }
+
+    // several cores may be created at once so write to a temporary file first and replace the cache in one step
+    std::string dir = pluginCachePath.substr(0, pluginCachePath.find_last_of("/\\"));
+#ifdef VS_TARGET_OS_WINDOWS
+    SHCreateDirectoryEx(nullptr, utf16_from_utf8(dir).c_str(), nullptr);
+    std::string tempPath = pluginCachePath + "." + std::to_string(GetCurrentProcessId());
+#else
+    for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1)) {
+        mkdir(dir.substr(0, pos).c_str(), 0755);
+        if (pos == std::string::npos)
+            break;
     }
+    std::string tempPath = pluginCachePath + "." + std::to_string(getpid());
 #endif
 
-    return true;
+    FILE *f = openPluginCacheFile(tempPath, "wb");
+    if (!f) {
+        logMessage(mtWarning, "Failed to write the plugin cache " + pluginCachePath);
+        return;
+    }
+    bool success = (fwrite(data.data(), 1, data.size(), f) == data.size());
+    success = !fclose(f) && success;
+#ifdef VS_TARGET_OS_WINDOWS
+    success = success && MoveFileEx(utf16_from_utf8(tempPath).c_str(), utf16_from_utf8(pluginCachePath).c_str(), MOVEFILE_REPLACE_EXISTING);
+    if (!success)
+        _wremove(utf16_from_utf8(tempPath).c_str());
+#else
+    success = success && !rename(tempPath.c_str(), pluginCachePath.c_str());
+    if (!success)
+        remove(tempPath.c_str());
+#endif
+    if (!success)
+        logMessage(mtWarning, "Failed to write the plugin cache " + pluginCachePath);
 }
 
 void VSCore::functionInstanceCreated() {
@@ -1740,6 +3799,8 @@ VSCore::VSCore(int flags) :
     coreFreed(false),
     videoFormatIdOffset(1000),
     cpuLevel(INT_MAX),
+    audioFrameSamples(VS_AUDIO_FRAME_SAMPLES),
+    audioFrameSamplesLocked(false),
     memory(new MemoryUse()),
     enableGraphInspection(flags & ccfEnableGraphInspection) {
 #ifdef VS_TARGET_OS_WINDOWS
@@ -1747,13 +3808,37 @@ VSCore::VSCore(int flags) :
         logFatal("Bad SSE state detected when creating new core");
 #endif
 
+    auto startTime = std::chrono::steady_clock::now();
+    auto elapsedSince = [](std::chrono::steady_clock::time_point start) {
+        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    };
+
     disableLibraryUnloading = !!(flags & ccfDisableLibraryUnloading);
+    costAwareEviction = !!(flags & ccfCostAwareEviction);
+    compressEvictedFrames = !!(flags & ccfCompressEvictedFrames);
+    fusePointwiseFilters = !!(flags & ccfFusePointwiseFilters);
+    fuseResizeChains = !!(flags & ccfFuseResizeChains);
+    fuseSpatialFilters = !!(flags & ccfFuseSpatialFilters);
+    mergeIdenticalFilters = !!(flags & ccfMergeIdenticalFilters);
+    lazyPluginLoading = !!(flags & ccfLazyPluginLoading);
+    padStrides = !!(flags & ccfPadStrides);
+    writeJITSymbols = !!(flags & ccfWriteJITSymbols);
+    frameProcessingTime = !!(flags & ccfFrameProcessingTime);
+    liveMode = !!(flags & ccfLiveMode);
     bool disableAutoLoading = !!(flags & ccfDisableAutoLoading);
-    threadPool = new VSThreadPool(this);
-
-    registerFormats();
+    memory->setAllocationOptions(!!(flags & ccfEnableHugePages), !!(flags & ccfNUMALocalFrames), !!(flags & ccfPinWorkerThreads));
+    memory->setDeduplication(!!(flags & ccfDeduplicateFrames));
+    if (flags & ccfEnableTracing)
+        tracer.reset(new VSTraceRecorder());
+    if (flags & ccfAsyncLogging) {
+        asyncLogging = true;
+        logThread = std::thread(&VSCore::runLogThread, this);
+    }
+    threadPool = new VSThreadPool(this, !!(flags & ccfEnableWorkStealing), !!(flags & ccfPinWorkerThreads), !!(flags & ccfAutoTuneThreads), !!(flags & ccfLookaheadPrefetch), !!(flags & ccfPreferPerformanceCores), !!(flags & ccfOneThreadPerCore));
+    startupThreadPoolTime = elapsedSince(startTime);
 
     // The internal plugin units, the loading is a bit special so they can get special flags
+    auto internalPluginsStartTime = std::chrono::steady_clock::now();
     VSPlugin *p;
 
     // Initialize internal plugins
@@ -1780,6 +3865,15 @@ VSCore::VSCore(int flags) :
     textInitialize(p, &vs_internal_vspapi);
     plugins.insert(std::make_pair(p->getID(), p));
 
+    p = new VSPlugin(this);
+    remoteInitialize(p, &vs_internal_vspapi);
+    plugins.insert(std::make_pair(p->getID(), p));
+    startupInternalPluginsTime = elapsedSince(internalPluginsStartTime);
+
+    auto autoloadStartTime = std::chrono::steady_clock::now();
+    if (lazyPluginLoading)
+        readPluginCache();
+
 #ifdef VS_TARGET_OS_WINDOWS
 
     const std::wstring filter = L"*.dll";
@@ -1895,6 +3989,10 @@ VSCore::VSCore(int flags) :
 
     vs_internal_vsapi.freeMap(settings);
 #endif
+
+    writePluginCache();
+    startupAutoloadTime = elapsedSince(autoloadStartTime);
+    startupTotalTime = elapsedSince(startTime);
 }
 
 void VSCore::freeCore() {
@@ -1902,6 +4000,8 @@ void VSCore::freeCore() {
         logFatal("Double free of core");
     coreFreed = true;
     threadPool->waitForDone();
+    // everything logged from here on is delivered directly
+    stopAsyncLogging();
     if (numFilterInstances > 1)
         logMessage(mtWarning, "Core freed but " + std::to_string(numFilterInstances.load() - 1) + " filter instance(s) still exist");
     if (memory->memoryUse() > 0)
@@ -1917,6 +4017,7 @@ void VSCore::freeCore() {
 }
 
 VSCore::~VSCore() {
+    stopAsyncLogging();
     memory->signalFree();
     delete threadPool;
     for(const auto &iter : plugins)
@@ -1964,9 +4065,37 @@ VSPlugin *VSCore::getNextPlugin(VSPlugin *plugin) {
     }
 }
 
-void VSCore::loadPlugin(const std::string &filename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath) {
-    std::unique_ptr<VSPlugin> p(new VSPlugin(filename, forcedNamespace, forcedId, altSearchPath, this));
+std::unique_ptr<VSPlugin> VSCore::openPlugin(const std::string &filename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath, bool useCache) {
+    std::unique_ptr<VSPlugin> p;
+    std::string fullPath;
+    VSPluginCacheEntry entry;
+    useCache = useCache && forcedNamespace.empty() && forcedId.empty() && !altSearchPath && getPluginFileInfo(filename, fullPath, entry.mtime, entry.size);
+
+    if (useCache) {
+        std::lock_guard<std::mutex> lock(pluginCacheLock);
+        auto it = pluginCache.find(fullPath);
+        if (it != pluginCache.end() && it->second.mtime == entry.mtime && it->second.size == entry.size) {
+            try {
+                p.reset(new VSPlugin(fullPath, it->second, this));
+            } catch (std::runtime_error &) {
+                // a damaged entry, load the library and replace it
+            }
+        }
+    }
+
+    if (!p) {
+        p.reset(new VSPlugin(filename, forcedNamespace, forcedId, altSearchPath, this));
+        if (useCache && p->getCacheEntry(entry)) {
+            std::lock_guard<std::mutex> lock(pluginCacheLock);
+            pluginCache[fullPath] = entry;
+            pluginCacheDirty = true;
+        }
+    }
+
+    return p;
+}
 
+void VSCore::addPlugin(std::unique_ptr<VSPlugin> p, const std::string &filename) {
     std::lock_guard<std::recursive_mutex> lock(pluginLock);
 
     VSPlugin *already_loaded_plugin = getPluginByID(p->getID());
@@ -1989,6 +4118,45 @@ void VSCore::loadPlugin(const std::string &filename, const std::string &forcedNa
     p.release();
 }
 
+void VSCore::loadPlugin(const std::string &filename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath, bool useCache) {
+    std::lock_guard<std::recursive_mutex> lock(pluginLock);
+    addPlugin(openPlugin(filename, forcedNamespace, forcedId, altSearchPath, useCache), filename);
+}
+
+void VSCore::loadPlugins(const std::vector<std::string> &filenames) {
+    // most of the time goes to the dynamic linker and the init functions which only touch their own plugin,
+    // plugins are still added in the given order so which one wins a duplicate id or namespace doesn't change
+    std::vector<std::unique_ptr<VSPlugin>> opened(filenames.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < filenames.size(); i = next++) {
+            try {
+                opened[i] = openPlugin(filenames[i], std::string(), std::string(), false, lazyPluginLoading);
+            } catch (VSException &) {
+                // Ignore any errors
+            }
+        }
+    };
+
+    size_t numThreads = std::min<size_t>(std::min(std::max(std::thread::hardware_concurrency(), 1U), 8U), filenames.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &iter : threads)
+        iter.join();
+
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (!opened[i])
+            continue;
+        try {
+            addPlugin(std::move(opened[i]), filenames[i]);
+        } catch (VSException &) {
+            // Ignore any errors
+        }
+    }
+}
+
 void VSCore::createFilter3(const VSMap *in, VSMap *out, const std::string &name, vs3::VSFilterInit init, VSFilterGetFrame getFrame, VSFilterFree free, VSFilterMode filterMode, int flags, void *instanceData, int apiMajor) {
     try {
         VSNode *node = new VSNode(in, out, name, init, getFrame, free, filterMode, flags, instanceData, apiMajor, this);
@@ -2040,8 +4208,209 @@ int VSCore::setCpuLevel(int cpu) {
     return cpuLevel.exchange(cpu);
 }
 
+int VSCore::getAudioFrameSamples() const {
+    return audioFrameSamples;
+}
+
+int VSCore::setAudioFrameSamples(int samples) {
+    if (!audioFrameSamplesLocked && samples >= 1024 && samples <= 1024 * 1024 && samples % 1024 == 0)
+        audioFrameSamples = samples;
+    return audioFrameSamples;
+}
+
+bool VSCore::findMergedFilter(const std::string &key, VSMap *out) {
+    std::vector<std::pair<const char *, VSNode *>> nodes;
+    bool complete = true;
+    {
+        std::lock_guard<std::mutex> lock(mergedFiltersLock);
+        auto it = mergedFilters.find(key);
+        if (it == mergedFilters.end())
+            return false;
+        for (const auto &entry : it->second) {
+            for (VSNode *node : entry.second) {
+                if (!node->tryAddRef()) {
+                    complete = false;
+                    break;
+                }
+                nodes.push_back({ entry.first.c_str(), node });
+            }
+        }
+    }
+
+    // references are dropped outside the lock since the last one destroys the node
+    if (complete) {
+        for (const auto &iter : nodes)
+            vs_internal_vsapi.mapConsumeNode(out, iter.first, iter.second, maAppend);
+    } else {
+        for (const auto &iter : nodes)
+            iter.second->release();
+    }
+    return complete;
+}
+
+void VSCore::addMergedFilter(const std::string &key, const VSMap *out) {
+    std::vector<std::pair<std::string, std::vector<VSNode *>>> entries;
+    for (size_t i = 0; i < out->size(); i++) {
+        int type = vs_internal_vsapi.mapGetType(out, out->key(i));
+        if (type != ptVideoNode && type != ptAudioNode)
+            return;
+        entries.push_back({ out->key(i), {} });
+        int numNodes = vs_internal_vsapi.mapNumElements(out, out->key(i));
+        for (int j = 0; j < numNodes; j++)
+            entries.back().second.push_back(vs_internal_vsapi.mapGetNode(out, out->key(i), j, nullptr));
+    }
+
+    if (!entries.empty()) {
+        std::lock_guard<std::mutex> lock(mergedFiltersLock);
+        if (mergedFilters.insert({ key, entries }).second) {
+            for (const auto &entry : entries)
+                for (VSNode *node : entry.second)
+                    mergedFiltersByNode.insert({ node, key });
+        }
+    }
+
+    // mapGetNode returned new references
+    for (const auto &entry : entries)
+        for (VSNode *node : entry.second)
+            node->release();
+}
+
+void VSCore::forgetMergedFilter(const VSNode *node) {
+    std::lock_guard<std::mutex> lock(mergedFiltersLock);
+    auto range = mergedFiltersByNode.equal_range(node);
+    for (auto it = range.first; it != range.second; ++it)
+        mergedFilters.erase(it->second);
+    mergedFiltersByNode.erase(range.first, range.second);
+}
+
+uint64_t VSCore::uniqueSignature(uint64_t signature) {
+    std::lock_guard<std::mutex> lock(signatureLock);
+    int index = signatureCounts[signature]++;
+    return hashSignature(signature, &index, sizeof(index));
+}
+
+// A header line followed by a tab separated line with the signature, the sizes and the filter name for every cache, the
+// name is only there to make the file readable
+static const char cacheSizesHeader[] = "VapourSynthCacheSizes\t1";
+
+bool VSCore::loadCacheSizes(const std::string &filename) {
+    FILE *f = openPluginCacheFile(filename, "rb");
+    if (!f)
+        return false;
+    std::string data;
+    char buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.append(buffer, read);
+    fclose(f);
+
+    std::unordered_map<uint64_t, CacheSizeHint> hints;
+    size_t start = 0;
+    bool first = true;
+    while (start < data.size()) {
+        size_t end = data.find('\n', start);
+        if (end == std::string::npos)
+            end = data.size();
+        std::string line = data.substr(start, end - start);
+        start = end + 1;
+
+        if (first) {
+            if (line != cacheSizesHeader)
+                return false;
+            first = false;
+            continue;
+        }
+
+        std::vector<std::string> fields = splitPluginCacheLine(line);
+        try {
+            if (fields.size() == 4)
+                hints[std::stoull(fields[0], nullptr, 16)] = { std::max(std::stoi(fields[1]), 0), std::max(std::stoi(fields[2]), 0), fields[3] };
+        } catch (std::logic_error &) {
+            // skip lines that don't parse
+        }
+    }
+
+    if (first)
+        return false;
+
+    std::lock_guard<std::mutex> lock(cacheLock);
+    cacheSizeHints.swap(hints);
+    for (VSNode *node : caches)
+        node->applyCacheSizeHint();
+    return true;
+}
+
+// the loaded sizes of caches that weren't used in this run are written again so they aren't lost
+bool VSCore::saveCacheSizes(const std::string &filename) {
+    std::map<uint64_t, CacheSizeHint> sizes;
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        sizes.insert(cacheSizeHints.begin(), cacheSizeHints.end());
+        for (VSNode *node : caches) {
+            std::lock_guard<std::mutex> nodeLock(node->cacheMutex);
+            if (!node->cache.getFixedSize())
+                sizes[node->signature] = { node->cache.getMaxFrames(), node->cache.getMaxHistory(), node->name };
+        }
+    }
+
+    std::string data = cacheSizesHeader;
+    data += '\n';
+    for (const auto &iter : sizes) {
+        char signature[17];
+        snprintf(signature, sizeof(signature), "%016llx", static_cast<unsigned long long>(iter.first));
+        std::string name = iter.second.name;
+        std::replace_if(name.begin(), name.end(), [](char c) { return c == '\t' || c == '\r' || c == '\n'; }, ' ');
+        data += std::string(signature) + "\t" + std::to_string(iter.second.maxSize) + "\t" + std::to_string(iter.second.maxHistorySize) + "\t" + name + "\n";
+    }
+
+    FILE *f = openPluginCacheFile(filename, "wb");
+    if (!f)
+        return false;
+    bool success = (fwrite(data.data(), 1, data.size(), f) == data.size());
+    return !fclose(f) && success;
+}
+
+bool vs_fuse_pointwise_filters(const VSCore *core) {
+    return core->fusePointwiseFilters;
+}
+
+bool vs_fuse_resize_chains(const VSCore *core) {
+    return core->fuseResizeChains;
+}
+
+bool vs_fuse_spatial_filters(const VSCore *core) {
+    return core->fuseSpatialFilters;
+}
+
+void vs_register_jit_code(const VSCore *core, const void *code, size_t size, const std::string &name) {
+#ifndef VS_TARGET_OS_WINDOWS
+    if (!core->writeJITSymbols || !code)
+        return;
+
+    // the perf map format is one line per function so line breaks in the name can't be kept
+    std::string symbol = name;
+    std::replace(symbol.begin(), symbol.end(), '\n', ' ');
+    static std::mutex mapLock;
+    std::lock_guard<std::mutex> lock(mapLock);
+    std::string filename = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    if (FILE *f = fopen(filename.c_str(), "a")) {
+        fprintf(f, "%llx %zx %s\n", static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(code)), size, symbol.c_str());
+        fclose(f);
+    }
+#endif
+}
+
+uint64_t vs_get_function_id(const VSFunction *func) {
+    return func->getId();
+}
+
+void *vs_get_filter_instance_data(const VSNode *node, VSFilterGetFrame getFrame) {
+    return node->getInstanceData(getFrame);
+}
+
+// Only used for the internal plugins so their argument strings don't need to be validated
 VSPlugin::VSPlugin(VSCore *core)
-    : libHandle(0), core(core) {
+    : deferArgParsing(true), libHandle(0), core(core) {
 }
 
 static void VS_CC configPlugin3(const char *identifier, const char *defaultNamespace, const char *name, int apiVersion, int readOnly, VSPlugin *plugin) VS_NOEXCEPT {
@@ -2064,6 +4433,30 @@ VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedName
     for (auto &iter : filename)
         if (iter == '\\')
             iter = '/';
+#else
+    std::vector<char> fullPathBuffer(PATH_MAX + 1);
+    if (realpath(relFilename.c_str(), fullPathBuffer.data()))
+        filename = fullPathBuffer.data();
+    else
+        filename = relFilename;
+#endif
+
+    loadLibrary(relFilename, altSearchPath);
+}
+
+VSPlugin::VSPlugin(const std::string &filename, const VSPluginCacheEntry &entry, VSCore *core)
+    : apiMajor(entry.apiMajor), apiMinor(entry.apiMinor), pluginVersion(entry.pluginVersion), hasConfig(true), readOnly(true), readOnlySet(true), lazy(true),
+    deferArgParsing(true), filename(filename), fullname(entry.fullname), fnamespace(entry.fnamespace), id(entry.id), libHandle(0), registeredFunctions(entry.functions), core(core) {
+    for (const auto &iter : entry.functions)
+        funcs.emplace(std::piecewise_construct, std::forward_as_tuple(iter[0]), std::forward_as_tuple(iter[0], iter[1], iter[2], nullptr, nullptr, this));
+}
+
+void VSPlugin::loadLibrary(const std::string &relFilename, bool altSearchPath) {
+#ifdef VS_TARGET_OS_WINDOWS
+    std::wstring wPath = utf16_from_utf8(filename);
+    for (auto &iter : wPath)
+        if (iter == L'/')
+            iter = L'\\';
 
     libHandle = LoadLibraryEx(wPath.c_str(), nullptr, altSearchPath ? 0 : (LOAD_LIBRARY_SEARCH_DEFAULT_DIRS | LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR));
 
@@ -2090,15 +4483,10 @@ VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedName
     if (!pluginInit && !pluginInit3) {
         if (!core->disableLibraryUnloading)
             FreeLibrary(libHandle);
+        libHandle = 0;
         throw VSException("No entry point found in " + relFilename);
     }
 #else
-    std::vector<char> fullPathBuffer(PATH_MAX + 1);
-    if (realpath(relFilename.c_str(), fullPathBuffer.data()))
-        filename = fullPathBuffer.data();
-    else
-        filename = relFilename;
-
     libHandle = dlopen(filename.c_str(), RTLD_LAZY);
 
     if (!libHandle) {
@@ -2117,6 +4505,7 @@ VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedName
     if (!pluginInit && !pluginInit3) {
         if (!core->disableLibraryUnloading)
             dlclose(libHandle);
+        libHandle = 0;
         throw VSException("No entry point found in " + relFilename);
     }
 
@@ -2145,10 +4534,44 @@ VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedName
         if (!core->disableLibraryUnloading)
             dlclose(libHandle);
 #endif
+        libHandle = 0;
         throw VSException("Core only supports API R" + std::to_string(VAPOURSYNTH_API_MAJOR) + "." + std::to_string(VAPOURSYNTH_API_MINOR) + " but the loaded plugin requires API R" + std::to_string(apiMajor) + "." + std::to_string(apiMinor) + "; Filename: " + relFilename + "; Name: " + fullname);
     }
 }
 
+// Loads the library of a plugin created from the cache, the init function then fills in the already known functions
+bool VSPlugin::ensureLoaded(std::string &error) {
+    std::lock_guard<std::mutex> lock(loadLock);
+    if (!lazy)
+        return true;
+    if (loadError.empty()) {
+        reloading = true;
+        try {
+            loadLibrary(filename, false);
+            lazy = false;
+        } catch (VSException &e) {
+            loadError = e.what();
+        }
+        reloading = false;
+    }
+    error = loadError;
+    return !lazy;
+}
+
+// Plugins that can still register functions later aren't cached since their functions aren't known up front
+bool VSPlugin::getCacheEntry(VSPluginCacheEntry &entry) const {
+    if (!readOnly || filename.empty())
+        return false;
+    entry.id = id;
+    entry.fnamespace = fnamespace;
+    entry.fullname = fullname;
+    entry.pluginVersion = pluginVersion;
+    entry.apiMajor = apiMajor;
+    entry.apiMinor = apiMinor;
+    entry.functions = registeredFunctions;
+    return true;
+}
+
 VSPlugin::~VSPlugin() {
 #ifdef VS_TARGET_OS_WINDOWS
     if (libHandle != INVALID_HANDLE_VALUE && !core->disableLibraryUnloading)
@@ -2160,6 +4583,10 @@ VSPlugin::~VSPlugin() {
 }
 
 bool VSPlugin::configPlugin(const std::string &identifier, const std::string &pluginNamespace, const std::string &fullname, int pluginVersion, int apiVersion, int flags) {
+    // everything is already known from the cache
+    if (reloading)
+        return true;
+
     if (hasConfig)
         core->logFatal("Attempted to configure plugin " + identifier + " twice");
 
@@ -2187,6 +4614,16 @@ bool VSPlugin::configPlugin(const std::string &identifier, const std::string &pl
 }
 
 bool VSPlugin::registerFunction(const std::string &name, const std::string &args, const std::string &returnType, VSPublicFunction argsFunc, void *functionData) {
+    if (reloading) {
+        std::lock_guard<std::mutex> lock(functionLock);
+        auto it = funcs.find(name);
+        if (it != funcs.end())
+            it->second.setImplementation(argsFunc, functionData);
+        else
+            core->logMessage(mtWarning, "Function '" + name + "' of plugin " + id + " isn't in the plugin cache and can't be used until the cache is updated");
+        return true;
+    }
+
     if (readOnly) {
         core->logMessage(mtCritical, "API MISUSE! Tried to register function " + name + " but plugin " + id + " is read only");
         return false;
@@ -2205,7 +4642,8 @@ bool VSPlugin::registerFunction(const std::string &name, const std::string &args
     }
 
     try {
-        funcs.emplace(std::make_pair(name, VSPluginFunction(name, args, returnType, argsFunc, functionData, this)));
+        funcs.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple(name, args, returnType, argsFunc, functionData, this));
+        registeredFunctions.push_back({ name, args, returnType });
     } catch (std::runtime_error &e) {
         core->logMessage(mtCritical, "API MISUSE! Function '" + name + "' failed to register with error: " + e.what());
         return false;
@@ -2290,42 +4728,308 @@ VSNode::VSCache::CacheAction VSNode::VSCache::recommendSize() {
 }
 
 inline VSNode::VSCache::VSCache(int maxSize, int maxHistorySize, bool fixedSize)
-    : maxSize(maxSize), maxHistorySize(maxHistorySize), fixedSize(fixedSize) {
+    : maxSize(maxSize), maxHistorySize(maxHistorySize), target(0), fixedSize(fixedSize), pendingWrite(0), pendingHits(0), pendingFarMisses(0) {
+    for (auto &iter : pendingKeys)
+        iter = -1;
+    reserve(maxSize + maxHistorySize + 1);
     clear();
 }
 
+void VSNode::VSCache::mirror(int key, const PVSFrame &frame) {
+    PVSFrame old;
+    {
+        Shard &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto iter = std::find_if(shard.entries.begin(), shard.entries.end(), [key](const std::pair<int, PVSFrame> &e) { return e.first == key; });
+        if (iter != shard.entries.end()) {
+            old = std::move(iter->second);
+            iter->second = frame;
+        } else {
+            shard.entries.emplace_back(key, frame);
+        }
+    }
+}
+
+void VSNode::VSCache::unmirror(int key) {
+    // the frame is released after unlocking since it may be the last reference
+    PVSFrame old;
+    {
+        Shard &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto iter = std::find_if(shard.entries.begin(), shard.entries.end(), [key](const std::pair<int, PVSFrame> &e) { return e.first == key; });
+        if (iter != shard.entries.end()) {
+            old = std::move(iter->second);
+            *iter = std::move(shard.entries.back());
+            shard.entries.pop_back();
+        }
+    }
+}
+
+bool VSNode::VSCache::lookup(const int key, PVSFrame &frame) {
+    {
+        Shard &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto iter = std::find_if(shard.entries.begin(), shard.entries.end(), [key](const std::pair<int, PVSFrame> &e) { return e.first == key; });
+        if (iter != shard.entries.end()) {
+            if (!iter->second)
+                return false;
+            frame = iter->second;
+        }
+    }
+
+    if (frame) {
+        pendingKeys[pendingWrite.fetch_add(1, std::memory_order_relaxed) % numPendingKeys].store(key, std::memory_order_relaxed);
+        pendingHits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        pendingFarMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// promotes the frames hit through lookup() the same way object() does, only the most recent keys are still queued
+void VSNode::VSCache::applyPending() {
+    if (pendingHits.load(std::memory_order_relaxed)) {
+        int count = pendingHits.exchange(0, std::memory_order_relaxed);
+        hits += count;
+        totalHits += count;
+    }
+    if (pendingFarMisses.load(std::memory_order_relaxed)) {
+        int count = pendingFarMisses.exchange(0, std::memory_order_relaxed);
+        farMiss += count;
+        totalFarMiss += count;
+    }
+
+    uint32_t end = pendingWrite.load(std::memory_order_relaxed);
+    if (end - pendingRead > numPendingKeys)
+        pendingRead = end - numPendingKeys;
+    for (; pendingRead != end; pendingRead++) {
+        int key = pendingKeys[pendingRead % numPendingKeys].exchange(-1, std::memory_order_relaxed);
+        int index = (key >= 0) ? findNode(key) : -1;
+        if (index >= 0 && nodes[index].frame) {
+            detach(index);
+            pushFront(T2, index);
+        }
+    }
+}
+
+void VSNode::VSCache::clear() {
+    for (auto &shard : shards) {
+        std::vector<std::pair<int, PVSFrame>> entries;
+        {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            entries.swap(shard.entries);
+        }
+    }
+    pendingHits = 0;
+    pendingFarMisses = 0;
+    pendingRead = pendingWrite;
+    for (auto &n : nodes) {
+        n.frame.reset();
+        n.compressed.reset();
+    }
+    std::fill(slots.begin(), slots.end(), -1);
+    for (auto &l : lists)
+        l = List();
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; i--) {
+        nodes[i].key = -1;
+        pushFront(Free, i);
+    }
+    target = 0;
+    clearStats();
+}
+
+void VSNode::VSCache::insertSlot(int index) {
+    size_t i = slotFor(nodes[index].key);
+    while (slots[i] >= 0)
+        i = (i + 1) & (slots.size() - 1);
+    slots[i] = index;
+}
+
+void VSNode::VSCache::eraseSlot(int key) {
+    size_t mask = slots.size() - 1;
+    size_t i = slotFor(key);
+    while (nodes[slots[i]].key != key)
+        i = (i + 1) & mask;
+
+    // shift back the following entries in the probe sequence instead of leaving a tombstone
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (slots[j] < 0)
+            break;
+        size_t home = slotFor(nodes[slots[j]].key);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i] = -1;
+}
+
+void VSNode::VSCache::reserve(size_t count) {
+    if (count <= nodes.size())
+        return;
+
+    size_t oldCount = nodes.size();
+    nodes.resize(std::max(count, oldCount * 2));
+    for (size_t i = nodes.size(); i > oldCount; i--)
+        pushFront(Free, static_cast<int>(i - 1));
+
+    size_t numSlots = 16;
+    while (numSlots < nodes.size() * 2)
+        numSlots *= 2;
+    slots.assign(numSlots, -1);
+    for (size_t i = 0; i < oldCount; i++) {
+        if (nodes[i].list != Free)
+            insertSlot(static_cast<int>(i));
+    }
+}
+
+void VSNode::VSCache::evict(int index, ListId ghostList) {
+    detach(index);
+    if (compressCore && ghostList == B2)
+        nodes[index].compressed.reset(VSCompressedFrame::compress(nodes[index].frame.get(), *compressCore->memory));
+    mirror(nodes[index].key, nullptr);
+    nodes[index].frame.reset();
+    pushFront(ghostList, index);
+}
+
+void VSNode::VSCache::drop(int index) {
+    unmirror(nodes[index].key);
+    eraseSlot(nodes[index].key);
+    detach(index);
+    nodes[index].key = -1;
+    nodes[index].frame.reset();
+    nodes[index].compressed.reset();
+    pushFront(Free, index);
+}
+
+void VSNode::VSCache::replace(bool hitInB2) {
+    if (live) {
+        // a ring of the most recent frames, recency of use means nothing when the stream only moves forward
+        int oldest = -1;
+        for (ListId list : { T1, T2 }) {
+            for (int i = lists[list].head; i >= 0; i = nodes[i].next) {
+                if (oldest < 0 || nodes[i].key < nodes[oldest].key)
+                    oldest = i;
+            }
+        }
+        drop(oldest);
+        return;
+    }
+
+    int t1Size = lists[T1].size;
+    if (t1Size > 0 && (t1Size > target || (hitInB2 && t1Size == target) || lists[T2].size == 0))
+        evict(lists[T1].tail, B1);
+    else
+        evict(lists[T2].tail, B2);
+}
+
 inline PVSFrame VSNode::VSCache::object(const int key) {
-    return this->relink(key);
+    applyPending();
+    int index = findNode(key);
+
+    if (index < 0) {
+        farMiss++;
+        totalFarMiss++;
+        return nullptr;
+    }
+
+    Node &n = nodes[index];
+
+    if (!n.frame) {
+        // still counted as a near miss so the cache grows the same way as when the frame has to be recreated
+        nearMiss++;
+        totalNearMiss++;
+        if (!n.compressed)
+            return nullptr;
+
+        totalCompressedHits++;
+        PVSFrame frame = n.compressed->decompress(compressCore);
+        if (maxSize > 0) {
+            n.compressed.reset();
+            target = std::max(target - std::max(lists[B1].size / lists[B2].size, 1), 0);
+            detach(index);
+            n.frame = frame;
+            mirror(key, frame);
+            pushFront(T2, index);
+            while (lists[T1].size + lists[T2].size > maxSize)
+                replace(true);
+        }
+        return frame;
+    }
+
+    hits++;
+    totalHits++;
+    detach(index);
+    pushFront(T2, index);
+    return n.frame;
+}
+
+bool VSNode::VSCache::evictFrame(const int key) {
+    applyPending();
+    int index = findNode(key);
+
+    if (index < 0 || !nodes[index].frame)
+        return false;
+
+    evict(index, nodes[index].list == T1 ? B1 : B2);
+
+    // the memory is needed elsewhere so don't immediately fill the slot again
+    if (!fixedSize)
+        maxSize = std::max(maxSize - 1, 0);
+    target = std::min(target, maxSize);
+    trim(maxSize, maxHistorySize);
+    return true;
 }
 
 inline bool VSNode::VSCache::remove(const int key) {
-    auto i = hash.find(key);
+    int index = findNode(key);
 
-    if (i == hash.end()) {
+    if (index < 0)
         return false;
-    } else {
-        unlink(i->second);
-        return true;
-    }
+
+    drop(index);
+    return true;
 }
 
 
-bool VSNode::VSCache::insert(const int akey, const PVSFrame &aobject) {
+bool VSNode::VSCache::insert(const int akey, PVSFrame aobject) {
     assert(aobject);
     assert(akey >= 0);
-    remove(akey);
-    auto i = hash.insert(std::make_pair(akey, Node(akey, aobject)));
-    currentSize++;
-    Node *n = &i.first->second;
 
-    if (first)
-        first->prevNode = n;
+    applyPending();
+    int index = findNode(akey);
+    bool hitInB2 = false;
+
+    if (index >= 0) {
+        // a frame that was recently evicted from one of the lists is requested again so give that list more space
+        Node &n = nodes[index];
+        if (n.list == B1) {
+            target = std::min(target + std::max(lists[B2].size / lists[B1].size, 1), maxSize);
+        } else if (n.list == B2) {
+            target = std::max(target - std::max(lists[B1].size / lists[B2].size, 1), 0);
+            hitInB2 = true;
+        }
 
-    n->nextNode = first;
-    first = n;
+        detach(index);
+        n.frame = std::move(aobject);
+        n.compressed.reset();
+        mirror(akey, n.frame);
+        pushFront(T2, index);
+    } else {
+        index = lists[Free].head;
+        assert(index >= 0);
+        detach(index);
+        nodes[index].key = akey;
+        nodes[index].frame = std::move(aobject);
+        insertSlot(index);
+        mirror(akey, nodes[index].frame);
+        pushFront(T1, index);
+    }
 
-    if (!last)
-        last = first;
+    while (lists[T1].size + lists[T2].size > maxSize)
+        replace(hitInB2);
 
     trim(maxSize, maxHistorySize);
 
@@ -2334,27 +5038,20 @@ bool VSNode::VSCache::insert(const int akey, const PVSFrame &aobject) {
 
 
 void VSNode::VSCache::trim(int max, int maxHistory) {
-    // first adjust the number of cached frames and extra history length
-    while (currentSize > max) {
-        if (!weakpoint)
-            weakpoint = last;
-        else
-            weakpoint = weakpoint->prevNode;
+    // first adjust the number of cached frames and then the number of remembered keys
+    while (lists[T1].size + lists[T2].size > max)
+        replace(false);
 
-        if (weakpoint)
-            weakpoint->frame.reset();
-
-        currentSize--;
-        historySize++;
-    }
-
-    // remove history until the tail is small enough
-    while (last && historySize > maxHistory) {
-        unlink(*last);
+    while (lists[B1].size + lists[B2].size > maxHistory) {
+        if (lists[B1].size > 0 && (lists[T1].size + lists[B1].size > max || lists[B2].size == 0))
+            drop(lists[B1].tail);
+        else
+            drop(lists[B2].tail);
     }
 }
 
 void VSNode::VSCache::adjustSize(bool needMemory) {
+    applyPending();
     if (!fixedSize) {
         if (!needMemory) {
             switch (recommendSize()) {
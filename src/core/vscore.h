@@ -26,6 +26,7 @@
 #include "vslog.h"
 #include "intrusive_ptr.h"
 #include <cstdlib>
+#include <cstdio>
 #include <stdexcept>
 #include <string>
 #include <cstring>
@@ -45,6 +46,7 @@
 #include <algorithm>
 #include <tuple>
 #include <chrono>
+#include <array>
 
 #ifdef VS_TARGET_OS_WINDOWS
 #    define WIN32_LEAN_AND_MEAN
@@ -92,8 +94,15 @@ typedef std::pair<VSNode *, int> NodeOutputKey;
 
 template<>
 struct std::hash<NodeOutputKey> {
-    inline size_t operator()(const NodeOutputKey &val) const {  
-        return reinterpret_cast<size_t>(std::get<0>(val)) + (static_cast<size_t>(std::get<1>(val)) << 16);
+    inline size_t operator()(const NodeOutputKey &val) const {
+        // nodes are often allocated next to each other and frame numbers are consecutive so all bits have to be mixed
+        uint64_t h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(std::get<0>(val))) ^ (static_cast<uint64_t>(static_cast<uint32_t>(std::get<1>(val))) * UINT64_C(0x9E3779B97F4A7C15));
+        h ^= h >> 33;
+        h *= UINT64_C(0xFF51AFD7ED558CCD);
+        h ^= h >> 33;
+        h *= UINT64_C(0xC4CEB9FE1A85EC53);
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
     }
 };
 
@@ -105,6 +114,7 @@ private:
     VSFreeFunctionData freeFunction;
     VSCore *core;
     int apiMajor;
+    uint64_t id;
     ~VSFunction();
 public:
     void add_ref() noexcept {
@@ -119,6 +129,10 @@ public:
 
     VSFunction(VSPublicFunction func, void *userData, VSFreeFunctionData free, VSCore *core, int apiMajor);
     void call(const VSMap *in, VSMap *out);
+    // unique for the lifetime of the process so it can identify a function even after its address has been reused
+    uint64_t getId() const noexcept {
+        return id;
+    }
 };
 
 class VSArrayBase {
@@ -142,12 +156,12 @@ public:
     }
 
     void add_ref() noexcept {
-        ++refcount;
+        refcount.fetch_add(1, std::memory_order_relaxed);
     }
 
     void release() noexcept {
         assert(refcount > 0);
-        if (--refcount == 0)
+        if (refcount.load(std::memory_order_acquire) == 1 || refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
             delete this;
     }
 
@@ -215,12 +229,64 @@ public:
         else
             return data.at(pos);
     }
+
+    // keeps the allocated storage so the array can be refilled without allocating
+    void clear() noexcept {
+        singleData = T();
+        data.clear();
+        fsize = 0;
+    }
 };
 
+// Data too big to store inline lives in a reference counted buffer so copying a map or an array
+// only adds a reference. The buffer is either owned or memory a plugin attached with its own free function.
 class VSMapData {
+private:
+    static constexpr size_t inlineSize = 16;
+    std::shared_ptr<const char> buffer; // null when the data is stored inline
+    size_t length = 0;
+    char inlineData[inlineSize] = {};
 public:
-    VSDataTypeHint typeHint;
-    std::string data;
+    VSDataTypeHint typeHint = dtUnknown;
+
+    VSMapData() noexcept = default;
+
+    // copies size bytes and adds a null terminator
+    VSMapData(VSDataTypeHint typeHint, const char *data, size_t size) : length(size), typeHint(typeHint) {
+        if (size < inlineSize) {
+            memcpy(inlineData, data, size);
+        } else {
+            char *p = allocate(size);
+            memcpy(p, data, size);
+        }
+    }
+
+    VSMapData(VSDataTypeHint typeHint, const std::string &data) : VSMapData(typeHint, data.data(), data.size()) {}
+
+    // uses the buffer as is, it isn't null terminated unless the memory after the last byte happens to be zero
+    VSMapData(VSDataTypeHint typeHint, std::shared_ptr<const char> external, size_t size) noexcept : buffer(std::move(external)), length(size), typeHint(typeHint) {}
+
+    // makes uninitialized but null terminated data of size bytes and returns where to write it, copies
+    // share the buffer so it may only be written to before the first one is made
+    char *allocate(size_t size) {
+        char *p = new char[size + 1];
+        p[size] = 0;
+        buffer = std::shared_ptr<const char>(p, std::default_delete<const char[]>());
+        length = size;
+        return p;
+    }
+
+    const char *data() const noexcept {
+        return buffer ? buffer.get() : inlineData;
+    }
+
+    size_t size() const noexcept {
+        return length;
+    }
+
+    bool operator==(const VSMapData &other) const noexcept {
+        return typeHint == other.typeHint && length == other.length && (data() == other.data() || !memcmp(data(), other.data(), length));
+    }
 };
 
 
@@ -233,29 +299,166 @@ typedef VSArray<PVSFrame, ptVideoFrame> VSVideoFrameArray;
 typedef VSArray<PVSFrame, ptAudioFrame> VSAudioFrameArray;
 typedef VSArray<PVSFunction, ptFunction> VSFunctionArray;
 
+// a key that isn't interned, shared by the entries of the map copies that have it and freed together with the last one
+class VSMapKey {
+private:
+    std::atomic<long> refcount;
+public:
+    const std::string name;
+
+    explicit VSMapKey(const char *name) : refcount(1), name(name) {
+    }
+
+    void add_ref() noexcept {
+        refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() noexcept {
+        assert(refcount > 0);
+        if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+};
+
+typedef vs_intrusive_ptr<VSMapKey> PVSMapKey;
+
+struct VSMapEntry {
+    const char *key; // either interned so the same key always has the same address or owned through ownedKey
+    PVSArrayBase value;
+    PVSMapKey ownedKey;
+};
+
+// a sorted flat list of entries where the first few are stored inline so most property maps only need a single allocation
 class VSMapStorage {
+public:
+    // the interned keys of the reserved properties in VSReservedFrameProperty order, they live in one array so
+    // the slot of a key is found by its address alone
+    static constexpr int numReservedKeys = rfpSARDen + 1;
+    static constexpr size_t reservedKeySize = 16;
+    static const char reservedKeys[numReservedKeys][reservedKeySize];
 private:
+    static constexpr size_t inlineEntries = 12;
     std::atomic<long> refcount;
+    size_t count;
+    VSMapEntry small[inlineEntries];
+    std::vector<VSMapEntry> large; // all entries are moved here once there are more than fit inline
+    VSArrayBase *reserved[numReservedKeys]; // the values of the reserved keys owned by the entries, or null when not set
+
+    static int reservedIndex(const char *key) noexcept {
+        const char *base = reservedKeys[0];
+        if (key < base || key >= base + sizeof(reservedKeys))
+            return -1;
+        return static_cast<int>((key - base) / reservedKeySize);
+    }
+
+    void updateReserved(const char *key, VSArrayBase *val) noexcept {
+        int index = reservedIndex(key);
+        if (index >= 0)
+            reserved[index] = val;
+    }
+
+    VSMapEntry *entries() noexcept {
+        return large.empty() ? small : large.data();
+    }
+
+    const VSMapEntry *entries() const noexcept {
+        return large.empty() ? small : large.data();
+    }
 public:
-    std::map<std::string, PVSArrayBase> data;
     bool error;
+    std::atomic<const void *> validatedFor; // the plugin function these entries last passed argument validation for
+
+    explicit VSMapStorage() : refcount(1), count(0), reserved(), error(false), validatedFor(nullptr) {
+        for (auto &iter : small)
+            iter.key = nullptr;
+    }
+
+    // the values are shared with s so the reserved slots stay the same
+    explicit VSMapStorage(const VSMapStorage &s) : refcount(1), count(s.count), error(s.error), validatedFor(s.validatedFor.load(std::memory_order_relaxed)) {
+        std::copy(s.reserved, s.reserved + numReservedKeys, reserved);
+        if (s.large.empty()) {
+            for (size_t i = 0; i < inlineEntries; i++)
+                small[i] = s.small[i];
+        } else {
+            for (auto &iter : small)
+                iter.key = nullptr;
+            large = s.large;
+        }
+    }
+
+    // interned keys are never freed so only the reserved keys and the argument names of plugin functions are interned,
+    // findInternedKey() returns null for every other key
+    static const char *internKey(const char *key);
+    static const char *findInternedKey(const char *key);
+
+    size_t size() const noexcept {
+        return count;
+    }
+
+    const VSMapEntry *begin() const noexcept {
+        return entries();
+    }
+
+    const VSMapEntry *end() const noexcept {
+        return entries() + count;
+    }
 
-    explicit VSMapStorage() : refcount(1), error(false) {}
+    VSMapEntry &at(size_t n) noexcept {
+        assert(n < count);
+        return entries()[n];
+    }
 
-    explicit VSMapStorage(const VSMapStorage &s) : refcount(1), data(s.data), error(s.error) {
+    const VSMapEntry &at(size_t n) const noexcept {
+        assert(n < count);
+        return entries()[n];
     }
 
+    // returns the position of the key or where it would have to be inserted
+    size_t lowerBound(const char *key, bool &found) const noexcept {
+        const VSMapEntry *e = entries();
+        size_t first = 0;
+        size_t n = count;
+        while (n > 0) {
+            size_t half = n / 2;
+            if (strcmp(e[first + half].key, key) < 0) {
+                first += half + 1;
+                n -= half + 1;
+            } else {
+                n = half;
+            }
+        }
+        found = (first < count && (e[first].key == key || !strcmp(e[first].key, key)));
+        return first;
+    }
+
+    VSArrayBase *getReserved(int property) const noexcept {
+        assert(property >= 0 && property < numReservedKeys);
+        return reserved[property];
+    }
+
+    void setValue(size_t pos, const PVSArrayBase &val) noexcept {
+        VSMapEntry &e = at(pos);
+        e.value = val;
+        updateReserved(e.key, val.get());
+    }
+
+    // uses the interned key when there is one and otherwise gives the entry its own copy of the key
+    void insertAt(size_t pos, const char *key, const PVSArrayBase &val);
+    void insertAt(size_t pos, const VSMapEntry &entry);
+    void eraseAt(size_t pos) noexcept;
+    void clear() noexcept;
+
     bool unique() noexcept {
         return (refcount == 1);
     };
 
     void add_ref() noexcept {
-        ++refcount;
+        refcount.fetch_add(1, std::memory_order_relaxed);
     }
 
     void release() noexcept {
         assert(refcount > 0);
-        if (--refcount == 0)
+        if (refcount.load(std::memory_order_acquire) == 1 || refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
             delete this;
     }
 };
@@ -274,64 +477,105 @@ public:
         return *this;
     }
 
+    // every modification detaches first so this is also where a previous argument validation is forgotten
     bool detach() {
         if (!data->unique()) {
             data = new VSMapStorage(*data);
+            data->validatedFor.store(nullptr, std::memory_order_relaxed);
             return true;
         }
+        data->validatedFor.store(nullptr, std::memory_order_relaxed);
         return false;
     }
 
+    VSArrayBase *find(const char *key) const {
+        bool found;
+        size_t pos = data->lowerBound(key, found);
+        return found ? data->at(pos).value.get() : nullptr;
+    }
+
     VSArrayBase *find(const std::string &key) const {
-        auto it = data->data.find(key);
-        return (it == data->data.end()) ? nullptr : it->second.get();
+        return find(key.c_str());
     }
 
-    VSArrayBase *detach(const std::string &key) {
-        detach();
-        auto it = data->data.find(key);
-        if (it != data->data.end()) {
-            if (!it->second->unique())
-                it->second = it->second->copy();
-            return it->second.get();
+    // a direct load for the properties in VSReservedFrameProperty
+    VSArrayBase *findReserved(int property) const {
+        return data->getReserved(property);
+    }
+
+    VSArrayBase *detach(const char *key) {
+        bool found;
+        size_t pos = data->lowerBound(key, found);
+        if (found) {
+            detach();
+            const PVSArrayBase &val = data->at(pos).value;
+            if (!val->unique())
+                data->setValue(pos, val->copy());
+            return val.get();
         }
         return nullptr;
     }
 
-    bool erase(const std::string &key) {
-        auto it = data->data.find(key);
-        if (it != data->data.end()) {
-            if (detach())
-                it = data->data.find(key);
-            data->data.erase(it);
+    VSArrayBase *detach(const std::string &key) {
+        return detach(key.c_str());
+    }
+
+    bool erase(const char *key) {
+        bool found;
+        size_t pos = data->lowerBound(key, found);
+        if (found) {
+            detach();
+            data->eraseAt(pos);
             return true;
         }
         return false;
     }
 
-    void insert(const std::string &key, VSArrayBase *val) {
+    void insert(const char *key, VSArrayBase *val) {
+        PVSArrayBase v(val);
         detach();
-        auto it = data->data.find(key);
-        if (it != data->data.end()) {
-            it->second = val;
-        } else {
-            data->data.insert(std::make_pair(key, val));
-        }
+        bool found;
+        size_t pos = data->lowerBound(key, found);
+        if (found)
+            data->setValue(pos, v);
+        else
+            data->insertAt(pos, key, v);
+    }
+
+    void insert(const std::string &key, VSArrayBase *val) {
+        insert(key.c_str(), val);
     }
 
     void copy(const VSMap *src) {
+        if (src->data.get() == data.get())
+            return;
+        if (!size()) {
+            bool error = data->error;
+            data = src->data;
+            if (error != data->error) {
+                detach();
+                data->error = error;
+            }
+            return;
+        }
         detach();
-        for (auto &iter : src->data->data)
-            data->data[iter.first] = iter.second;
+        for (const auto &iter : *src->data) {
+            bool found;
+            size_t pos = data->lowerBound(iter.key, found);
+            if (found)
+                data->setValue(pos, iter.value);
+            else
+                data->insertAt(pos, iter);
+        }
     }
 
     size_t size() const {
-        return data->data.size();
+        return data->size();
     }
 
     void clear() {
         if (data->unique())
-            data->data.clear();
+            data->clear();
         else
             data = new VSMapStorage();
     }
@@ -339,16 +583,27 @@ public:
     const char *key(size_t n) const {
         if (n >= size())
             return nullptr;
-        auto iter = data->data.cbegin();
-        std::advance(iter, n);
-        return iter->first.c_str();
+        return data->at(n).key;
+    }
+
+    VSArrayBase *value(size_t n) const {
+        assert(n < size());
+        return data->at(n).value.get();
+    }
+
+    const void *validatedFor() const {
+        return data->validatedFor.load(std::memory_order_relaxed);
+    }
+
+    void setValidatedFor(const void *func) const {
+        data->validatedFor.store(func, std::memory_order_relaxed);
     }
 
     void setError(const std::string &errMsg) {
         clear();
         VSDataArray *arr = new VSDataArray();
-        arr->push_back({ dtUtf8, errMsg });
-        data->data.insert(std::make_pair("_Error", arr));
+        arr->push_back(VSMapData(dtUtf8, errMsg));
+        insert("_Error", arr);
         data->error = true;
     }
 
@@ -358,7 +613,7 @@ public:
 
     const char *getErrorMessage() const {
         if (data->error) {
-            return reinterpret_cast<VSDataArray *>(data->data.at("_Error").get())->at(0).data.c_str();
+            return reinterpret_cast<VSDataArray *>(find("_Error"))->at(0).data();
         } else {
             return nullptr;
         }
@@ -379,34 +634,178 @@ public:
         : name(name), type(type), arr(arr), empty(empty), opt(opt) {}
 };
 
+class VSPlaneData;
+
 class MemoryUse {
 private:
     std::atomic<size_t> used;
     std::atomic<size_t> maxMemoryUse;
+    std::atomic<size_t> hardLimit; // 0 when not set, new frame requests only start one at a time above it
     bool freeOnZero;
+
+    // freed plane buffers kept around for reuse keyed by size and numa node, they still count as used memory
+    std::mutex bufferLock;
+    std::multimap<std::pair<size_t, int>, uint8_t *> buffers;
+    size_t unusedBufferSize;
+    std::atomic<int64_t> bufferHits;
+    std::atomic<int64_t> bufferMisses;
+
+    // allocation options set at core creation and the numa topology, nodeCPUs is empty when it couldn't be determined
+    bool hugePages;
+    bool numaLocal;
+    std::vector<std::vector<int>> nodeCPUs;
+    std::vector<int> cpuNodes;
+
+    // planes of cached frames keyed by a hash of their visible content, only used with ccfDeduplicateFrames
+    bool deduplicate;
+    std::mutex dedupLock;
+    std::unordered_multimap<uint64_t, VSPlaneData *> dedupPlanes;
+    std::atomic<int64_t> dedupShared;
+    std::atomic<int64_t> dedupSharedBytes;
+
+    // memory held by the compressed cache tier, it isn't part of used and is limited to an eighth of the limit on top of it
+    std::atomic<size_t> compressedUsed;
+
+    // the part of used that's held by the per thread scratch arenas
+    std::atomic<size_t> scratchUsed;
+
+    uint8_t *allocateMemory(size_t bytes, int node);
+    void freeMemory(uint8_t *buf, size_t bytes);
+    bool usePageAllocation(size_t bytes) const;
+    void detectTopology();
 public:
     void add(size_t bytes);
     void subtract(size_t bytes);
+    uint8_t *allocBuffer(size_t bytes, int &node);
+    void freeBuffer(uint8_t *buf, size_t bytes, int node);
+    void setAllocationOptions(bool hugePages, bool numaLocal, bool needTopology);
+    void setDeduplication(bool enable);
+    bool deduplicationEnabled() const {
+        return deduplicate;
+    }
+    void deduplicatePlane(VSPlaneData *&plane, ptrdiff_t stride, size_t rowSize, int height);
+    void forgetPlane(VSPlaneData *plane);
+    bool reserveCompressed(size_t bytes);
+    void releaseCompressed(size_t bytes);
+    uint8_t *allocScratch(size_t bytes);
+    void freeScratch(uint8_t *buf, size_t bytes);
+    int getCurrentNUMANode() const;
+    size_t getNUMANodeCount() const;
+    bool bindCurrentThreadToNode(int node) const;
+    void trimBuffers(size_t maxUnused);
+    void getStatistics(VSMap *stats);
     size_t memoryUse();
     size_t getLimit();
     int64_t setMaxMemoryUse(int64_t bytes);
+    int64_t setHardLimit(int64_t bytes);
     bool isOverLimit();
+    bool isOverHardLimit();
     void signalFree();
     MemoryUse();
 };
 
+// Per thread bump allocator behind allocScratchMemory(). A scope is opened around every getframe and slice function call
+// and everything allocated in it is released when it's closed. The chunks are kept for the next call on the thread and merged
+// into one when the outermost scope closes so a filter that needs the same amount every frame stops allocating after the first.
+class VSScratchArena {
+private:
+    struct Chunk {
+        uint8_t *data;
+        size_t size;
+    };
+
+    MemoryUse *mem = nullptr;
+    std::vector<Chunk> chunks;
+    size_t chunk = 0;
+    size_t offset = 0;
+    int depth = 0;
+
+    void release();
+public:
+    struct Mark {
+        size_t chunk;
+        size_t offset;
+    };
+
+    static VSScratchArena &current();
+    Mark enter() noexcept;
+    void leave(const Mark &mark);
+    void *alloc(size_t bytes, MemoryUse *mem);
+    ~VSScratchArena();
+};
+
+// opens a scratch scope on the current thread for the lifetime of the object
+class VSScratchScope {
+private:
+    VSScratchArena &arena;
+    VSScratchArena::Mark mark;
+public:
+    VSScratchScope() noexcept : arena(VSScratchArena::current()), mark(arena.enter()) {}
+    ~VSScratchScope() { arena.leave(mark); }
+};
+
+// plane memory allocated by a node's getframe function that's still alive, the planes share ownership
+// so the counters stay valid when a frame outlives the node that created it
+struct VSNodeMemory {
+    std::atomic<int64_t> liveBytes {0};
+    std::atomic<int64_t> peakBytes {0};
+    void add(size_t bytes) noexcept;
+    void subtract(size_t bytes) noexcept;
+};
+
 class VSPlaneData {
 private:
     std::atomic<long> refcount;
     MemoryUse &mem;
+    int node;
+    std::shared_ptr<VSNodeMemory> owner; /* the node that allocated the plane, if any */
+    std::shared_ptr<void> externalOwner; /* set for memory that wasn't allocated by the core, released instead of freed */
+    bool externalWritable = false;
+    bool pinned = false;
+    // mdDevice planes only, data stays null until the host needs the content and it's downloaded, the device memory is released by externalOwner
+    void *deviceHandle = nullptr;
+    const VSDeviceMemoryFunctions *deviceFunctions = nullptr;
+    void *deviceUserData = nullptr;
+    std::once_flag downloaded;
+    void download() noexcept;
+    // set once the plane is in the deduplication registry, its content may then be shared with unrelated frames so it's never written in place
+    bool dedupRegistered = false;
+    uint64_t dedupHash = 0;
+    ptrdiff_t dedupStride = 0;
+    size_t dedupRowSize = 0;
+    int dedupHeight = 0;
     ~VSPlaneData();
+    friend class MemoryUse;
 public:
     uint8_t *data;
     const size_t size;
+    // set when every visible sample is known to be constantValue, it's cleared whenever a write pointer to the plane is handed out
+    std::atomic<bool> constant {false};
+    uint32_t constantValue = 0;
     VSPlaneData(size_t dataSize, MemoryUse &mem) noexcept;
     VSPlaneData(const VSPlaneData &d) noexcept;
+    VSPlaneData(uint8_t *externalData, size_t dataSize, bool writable, const std::shared_ptr<void> &owner, MemoryUse &mem, bool pinned = false) noexcept;
+    VSPlaneData(void *handle, size_t dataSize, const VSDeviceMemoryFunctions *functions, void *userData, const std::shared_ptr<void> &owner, MemoryUse &mem) noexcept;
+    bool isExternal() const noexcept {
+        return !!externalOwner;
+    }
+    VSMemoryDomain getDomain() const noexcept {
+        return deviceFunctions ? mdDevice : (pinned ? mdPinnedHost : mdHost);
+    }
+    void *getDeviceHandle(int deviceType) const noexcept {
+        return (deviceFunctions && deviceFunctions->deviceType == deviceType) ? deviceHandle : nullptr;
+    }
+    uint8_t *getHostData() noexcept {
+        if (deviceFunctions)
+            download();
+        return data;
+    }
     bool unique() noexcept;
+    bool onlyReference() const noexcept {
+        return refcount == 1;
+    }
     void add_ref() noexcept;
+    bool tryAddRef() noexcept;
     void release() noexcept;
 };
 
@@ -418,14 +817,17 @@ private:
         VSVideoFormat vf;
         VSAudioFormat af;
     } format;
-    mutable std::atomic<const vs3::VSVideoFormat *> v3format; /* API 3 compatibility */
     VSPlaneData *data[3] = {}; /* only the first data pointer is ever used for audio and is subdivided using the internal offset in height */
     int width; /* stores number of samples for audio */
     int height;
     ptrdiff_t stride[3] = {}; /* stride[0] stores internal offset between audio channels */
+    ptrdiff_t offset[3] = {}; /* start of the plane in the plane data, only non-zero for views, for audio offset[0] applies to every channel */
     int numPlanes;
     VSMap properties;
     VSCore *core;
+    // set on frames offered as a destination and the views created from them while the filters writing to disjoint
+    // areas of them are running, the shared planes are written without being copied first
+    bool writeInPlace = false;
 public:
     static int alignment;
 
@@ -440,18 +842,33 @@ public:
     VSFrame(const VSAudioFormat &f, int numSamples, const VSFrame *propSrc, VSCore *core) noexcept;
     VSFrame(const VSAudioFormat &f, int numSamples, const VSFrame * const *channelSrc, const int *channel, const VSFrame *propSrc, VSCore *core) noexcept;
     VSFrame(const VSFrame &f) noexcept;
+    VSFrame(const VSFrame &f, VSCore *core) noexcept; // shares the planes but belongs to another core
     ~VSFrame();
 
+    static VSFrame *createView(const VSFrame *src, int left, int top, int width, int height, int field, const VSFrame *propSrc) noexcept;
+    static VSFrame *createAudioView(const VSFrame *src, int start, int numSamples, const VSFrame *propSrc) noexcept;
+    static VSFrame *createFromBuffers(const VSVideoFormat &f, int width, int height, uint8_t * const *planes, const ptrdiff_t *strides, bool writable, VSFreeFrameBuffer free, void *userData, const VSFrame *propSrc, VSCore *core) noexcept;
+    static VSFrame *createFromDevice(const VSVideoFormat &f, int width, int height, void * const *handles, const ptrdiff_t *strides, VSMemoryDomain domain, const VSDeviceMemoryFunctions *functions, void *userData, const VSFrame *propSrc, VSCore *core) noexcept;
+
     void add_ref() noexcept {
-        ++refcount;
+        refcount.fetch_add(1, std::memory_order_relaxed);
     }
 
     void release() noexcept {
         assert(refcount > 0);
-        if (--refcount == 0)
+        // nobody else can hold a reference when the count is one so the last release skips the locked decrement
+        if (refcount.load(std::memory_order_acquire) == 1 || refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
             delete this;
     }
 
+    bool unique() const noexcept {
+        return refcount == 1;
+    }
+
+    void setWriteInPlace(bool enable) noexcept {
+        writeInPlace = enable;
+    }
+
     VSMediaType getFrameType() const {
         return contentType;
     }
@@ -491,17 +908,50 @@ public:
         assert(contentType == mtAudio);
         return width;
     }
+    size_t getPlaneDataSize() const noexcept;
+    size_t getReclaimableSize() const noexcept;
+    void deduplicatePlanes() noexcept;
     ptrdiff_t getStride(int plane) const;
     const uint8_t *getReadPtr(int plane) const;
     uint8_t *getWritePtr(int plane);
+    void setPlaneConstant(int plane, uint32_t value) noexcept;
+    bool getPlaneConstant(int plane, uint32_t &value) const noexcept;
+    VSMemoryDomain getMemoryDomain(int plane) const;
+    void *getDeviceHandle(int plane, int deviceType) const;
 
 #ifdef VS_FRAME_GUARD
     bool verifyGuardPattern() const;
 #endif
 };
 
+// a video frame losslessly compressed by the second cache tier enabled with ccfCompressEvictedFrames
+class VSCompressedFrame {
+private:
+    VSVideoFormat format;
+    int width;
+    int height;
+    VSMap properties;
+    std::vector<uint8_t> data;
+    MemoryUse &mem;
+    VSCompressedFrame(const VSFrame *frame, std::vector<uint8_t> &&data, MemoryUse &mem);
+public:
+    // returns nullptr for frames that don't compress well or when the memory set aside for the tier is used up
+    static VSCompressedFrame *compress(const VSFrame *frame, MemoryUse &mem);
+    PVSFrame decompress(VSCore *core) const;
+    size_t size() const {
+        return data.size();
+    }
+    ~VSCompressedFrame();
+};
+
 #define NUM_FRAMECONTEXT_FAST_REQS 10
 
+// internal priority class of frames requested ahead by the prefetcher, below everything that was actually requested
+static constexpr int prPrefetch = -1;
+
+// the deadline of frame requests that don't have one
+static constexpr int64_t noDeadline = INT64_MAX;
+
 template<typename T, size_t staticSize>
 class SemiStaticVector {
 private:
@@ -533,9 +983,9 @@ public:
 
     void push_back(T &&val) noexcept {
         if (numElems < staticSize) {
-            new(&staticData[numElems]) T(val);
+            new(&staticData[numElems]) T(std::move(val));
         } else {
-            dynamicData.push_back(val);
+            dynamicData.push_back(std::move(val));
         }
         numElems++;
     }
@@ -578,11 +1028,62 @@ private:
     size_t reqOrder;
     size_t numFrameRequests = 0;
 
+    /// the highest VSRequestPriority of the requests waiting for the frame, orders tasks before reqOrder does
+    int priority = prBulk;
+
+    /// steady clock in nanoseconds, the earliest deadline of the requests waiting for the frame orders tasks within a priority class
+    /// and the context is aborted once the latest one has passed, expired is set when that happened, abortDeadline is only changed while
+    /// holding taskLock but read by workers before they take it
+    int64_t deadline = noDeadline;
+    std::atomic<int64_t> abortDeadline{ noDeadline };
+    bool expired = false;
+
+    /// scheduling only, the task queue the context is currently in (-1 for none) and the order it was queued in
+    std::atomic<int> queueIndex;
+    size_t queueSeq = 0;
+
+    /// tracing only, identifies the context in queue and request events
+    uint64_t traceId = 0;
+    bool traceFlow = false;
+
+    /// when the scheduler first failed to get the serial lock of the node for the context, steady clock in nanoseconds
+    int64_t lockWaitStart = 0;
+
+    /// when the filter was called for the context if it's running right now, only set while the watchdog is enabled
+    std::atomic<int64_t> runningSince{ 0 };
+
+    /// set while the context is counted in the running frames of a node with a concurrency limit
+    bool countedRunning = false;
+
+    /// set while a context created by the prefetcher is counted in the prefetches of its node, a finished prefetch keeps
+    /// its frame until a request for it queues the context again
+    bool prefetch = false;
+    PVSFrame prefetchedFrame;
+
+    /// nodes with frame ready activation only, protected by taskLock, tells if the context is queued or running for arFrameReady,
+    /// frames and errors that arrive while it runs wait in pendingFrames and pendingErrorMessage until the filter returns
+    enum FrameReadyState { frNone, frQueued, frRunning, frRunningPending };
+    FrameReadyState frameReadyState = frNone;
+    std::vector<std::pair<NodeOutputKey, PVSFrame>> pendingFrames;
+    bool pendingError = false;
+    std::string pendingErrorMessage;
+
+    /// set under taskLock when the filter begins its first async request in a run, it adds one to numFrameRequests until the run is over
+    /// so completions can't queue the context while it's still running, errors that arrive in the meantime wait in pendingErrorMessage
+    bool asyncGuard = false;
+
     bool error = false;
     bool first = true;
     bool external;
     bool lockOnOutput;
 
+    /// set while holding taskLock when nothing is waiting for the frame anymore, turned into an error when the context runs
+    std::atomic<bool> canceled;
+
+    /// external only, links all external contexts that haven't been returned yet so they can be canceled
+    VSFrameContext *prevExternal = nullptr;
+    VSFrameContext *nextExternal = nullptr;
+
     /// internal return only
     SemiStaticVector<PVSFrameContext, NUM_FRAMECONTEXT_FAST_REQS> notifyCtxList;
 
@@ -597,14 +1098,23 @@ public:
     NodeOutputKey key;
     void *frameContext[4];
 
+    /// the frames this context offered as destinations with offerFrameDestination(), withdrawn once they're produced
+    std::vector<NodeOutputKey> offeredDestinations;
+    VSCore *destinationCore = nullptr;
+
+    /// ccfFrameProcessingTime only, the time spent in filters for the frame including the frames it requested and the number
+    /// of requested frames that came from a cache, passed on to the contexts waiting for the frame
+    std::atomic<int64_t> subgraphTime{ 0 };
+    std::atomic<int> subgraphCacheHits{ 0 };
+
     void add_ref() noexcept {
-        ++refcount;
+        refcount.fetch_add(1, std::memory_order_relaxed);
     }
 
     void release() noexcept {
         assert(refcount > 0);
-        if (--refcount == 0)
-            delete this;
+        if (refcount.load(std::memory_order_acquire) == 1 || refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            recycle(this);
     }
 
     bool hasError() const {
@@ -616,8 +1126,21 @@ public:
     }
 
     bool setError(const std::string &errorMsg);
-    VSFrameContext(NodeOutputKey key, const PVSFrameContext &notify);
-    VSFrameContext(int n, VSNode *node, VSFrameDoneCallback frameDone, void *userData, bool lockOnOutput);
+
+    /// contexts are taken from a per-thread free list when possible so the request lists keep their capacity between uses
+    static VSFrameContext *create(NodeOutputKey key, const PVSFrameContext &notify);
+    static VSFrameContext *create(int n, VSNode *node, VSFrameDoneCallback frameDone, void *userData, bool lockOnOutput, int priority = prBulk, int64_t deadline = noDeadline);
+    static VSFrameContext *createPrefetch(NodeOutputKey key, size_t reqOrder);
+private:
+    VSFrameContext() = default;
+    void reset(int priority, size_t reqOrder, bool external, bool lockOnOutput, VSFrameDoneCallback frameDone, void *userData, NodeOutputKey key) noexcept;
+    static VSFrameContext *allocate();
+    static void recycle(VSFrameContext *ctx) noexcept;
+};
+
+struct VSAsyncRequest {
+    PVSFrameContext ctx;
+    VSThreadPool *pool;
 };
 
 struct VSFunctionFrame;
@@ -625,122 +1148,155 @@ typedef std::shared_ptr<VSFunctionFrame> PVSFunctionFrame;
 
 struct VSFunctionFrame {
     std::string name;
+    VSPlugin *plugin;
     const VSMap *args;
-    VSFunctionFrame(const std::string &name, const VSMap *args, PVSFunctionFrame next) : name(name), args(args), next(next) {};
+    VSFunctionFrame(const std::string &name, VSPlugin *plugin, const VSMap *args, PVSFunctionFrame next) : name(name), plugin(plugin), args(args), next(next) {};
     ~VSFunctionFrame() { delete args; }
     PVSFunctionFrame next;
 };
 
 
 
+struct VSEvictionCandidate {
+    double costPerByte;
+    VSNode *node;
+    int n;
+    size_t bytes;
+};
+
 struct VSNode {
     friend class VSThreadPool;
     friend struct VSCore;
+    friend struct VSPluginFunction;
 private:
     class VSCache {
     private:
+        // adaptive replacement cache, frames requested once live in t1 and frames requested more than once in t2
+        // while b1 and b2 remember the keys recently evicted from each of them, a request for a key in b1 means
+        // t1 should have been bigger and the other way around for b2 so the split adapts to scans and reuse
+        enum ListId : uint8_t {
+            T1,
+            T2,
+            B1,
+            B2,
+            Free,
+            NumLists
+        };
+
         struct Node {
-            inline Node() : key(-1) {}
-            inline Node(int key, const PVSFrame &frame) : key(key), frame(frame) {}
-            int key;
+            int key = -1;
+            int prev = -1;
+            int next = -1;
+            ListId list = Free;
             PVSFrame frame;
-            Node *prevNode = nullptr;
-            Node *nextNode = nullptr;
+            std::unique_ptr<VSCompressedFrame> compressed; // only ever set for keys in b2
         };
 
-        Node *first;
-        Node *weakpoint;
-        Node *last;
+        struct List {
+            int head = -1; // most recently used
+            int tail = -1;
+            int size = 0;
+        };
 
-        std::unordered_map<int, Node> hash;
+        // all nodes live in one array linked by index and are found through an open addressing table
+        std::vector<Node> nodes;
+        std::vector<int> slots;
+        List lists[NumLists];
 
         int maxSize;
-        int currentSize;
         int maxHistorySize;
-        int historySize;
+        int target; // the size t1 should have, between 0 and maxSize
 
         bool fixedSize;
+        bool live = false; // ccfLiveMode, frames are only ever requested once in increasing order so the oldest goes first
+
+        // set when frames evicted from t2 are kept compressed, frames only requested once aren't worth the effort
+        VSCore *compressCore = nullptr;
 
         int hits;
         int nearMiss;
         int farMiss;
 
-        inline void unlink(Node &n) {
-            if (&n == weakpoint)
-                weakpoint = weakpoint->nextNode;
-
-            if (n.prevNode)
-                n.prevNode->nextNode = n.nextNode;
-
-            if (n.nextNode)
-                n.nextNode->prevNode = n.prevNode;
-
-            if (last == &n)
-                last = n.prevNode;
-
-            if (first == &n)
-                first = n.nextNode;
+        // the same as above but never reset, only used for statistics
+        int64_t totalHits = 0;
+        int64_t totalNearMiss = 0;
+        int64_t totalFarMiss = 0;
+        int64_t totalCompressedHits = 0;
+
+        // every key in the cache is mirrored in a sharded table together with its frame, if it has one, so the scheduler can
+        // look up frames without cacheMutex, hits found there only queue their key and the lists are updated in a batch by
+        // the next operation that holds cacheMutex, queued keys may be overwritten which only costs an lru promotion
+        static constexpr int numShards = 8;
+        static constexpr uint32_t numPendingKeys = 64;
+
+        struct Shard {
+            std::mutex lock;
+            std::vector<std::pair<int, PVSFrame>> entries;
+        };
 
-            if (n.frame)
-                currentSize--;
-            else
-                historySize--;
+        Shard shards[numShards];
+        std::atomic<int> pendingKeys[numPendingKeys];
+        std::atomic<uint32_t> pendingWrite;
+        uint32_t pendingRead = 0;
+        std::atomic<int> pendingHits;
+        std::atomic<int> pendingFarMisses;
 
-            hash.erase(n.key);
+        inline Shard &shardFor(int key) {
+            return shards[static_cast<uint32_t>(key) % numShards];
         }
 
-        inline PVSFrame relink(const int key) {
-            auto i = hash.find(key);
-
-            if (i == hash.end()) {
-                farMiss++;
-                return nullptr;
-            }
+        void mirror(int key, const PVSFrame &frame);
+        void unmirror(int key);
+        void applyPending();
 
-            Node &n = i->second;
-
-            if (!n.frame) {
-                nearMiss++;
-                return nullptr;
-            }
-
-            hits++;
-            Node *origWeakPoint = weakpoint;
-
-            if (&n == origWeakPoint)
-                weakpoint = weakpoint->nextNode;
-
-            if (first != &n) {
-                if (n.prevNode)
-                    n.prevNode->nextNode = n.nextNode;
-
-                if (n.nextNode)
-                    n.nextNode->prevNode = n.prevNode;
-
-                if (last == &n)
-                    last = n.prevNode;
-
-                n.prevNode = 0;
-                n.nextNode = first;
-                first->prevNode = &n;
-                first = &n;
-            }
+        inline size_t slotFor(int key) const {
+            return (static_cast<uint32_t>(key) * 2654435761U) & (slots.size() - 1);
+        }
 
-            if (!weakpoint) {
-                if (currentSize > maxSize) {
-                    weakpoint = last;
-                    weakpoint->frame.reset();
-                }
-            } else if (&n == origWeakPoint || historySize > maxHistorySize) {
-                weakpoint = weakpoint->prevNode;
-                weakpoint->frame.reset();
+        inline int findNode(int key) const {
+            for (size_t i = slotFor(key); slots[i] >= 0; i = (i + 1) & (slots.size() - 1)) {
+                if (nodes[slots[i]].key == key)
+                    return slots[i];
             }
+            return -1;
+        }
 
-            assert(historySize <= maxHistorySize);
+        inline void detach(int index) {
+            Node &n = nodes[index];
+            List &l = lists[n.list];
+            if (n.prev >= 0)
+                nodes[n.prev].next = n.next;
+            else
+                l.head = n.next;
+            if (n.next >= 0)
+                nodes[n.next].prev = n.prev;
+            else
+                l.tail = n.prev;
+            n.prev = -1;
+            n.next = -1;
+            l.size--;
+        }
 
-            return n.frame;
+        inline void pushFront(ListId list, int index) {
+            Node &n = nodes[index];
+            List &l = lists[list];
+            n.list = list;
+            n.prev = -1;
+            n.next = l.head;
+            if (l.head >= 0)
+                nodes[l.head].prev = index;
+            else
+                l.tail = index;
+            l.head = index;
+            l.size++;
         }
 
+        void insertSlot(int index);
+        void eraseSlot(int key);
+        void reserve(size_t count);
+        void evict(int index, ListId ghostList);
+        void drop(int index);
+        void replace(bool hitInB2);
         void trim(int max, int maxHistory);
     public:
         enum class CacheAction {
@@ -760,8 +1316,14 @@ private:
             return maxSize;
         }
 
+        inline bool getFixedSize() const {
+            return fixedSize;
+        }
+
         inline void setMaxFrames(int m) {
             maxSize = m;
+            target = std::min(target, maxSize);
+            reserve(maxSize + maxHistorySize + 1);
             trim(maxSize, maxHistorySize);
         }
 
@@ -771,6 +1333,7 @@ private:
 
         inline void setMaxHistory(int m) {
             maxHistorySize = m;
+            reserve(maxSize + maxHistorySize + 1);
             trim(maxSize, maxHistorySize);
         }
 
@@ -778,34 +1341,51 @@ private:
             fixedSize = fixed;
         }
 
-        inline size_t size() const {
-            return hash.size();
+        inline void enableCompression(VSCore *core) {
+            compressCore = core;
         }
 
-        inline void clear() {
-            hash.clear();
-            first = nullptr;
-            last = nullptr;
-            weakpoint = nullptr;
-            currentSize = 0;
-            historySize = 0;
-            clearStats();
+        inline void setLive() {
+            live = true;
+            fixedSize = true;
+            setMaxHistory(0);
+        }
+
+        inline size_t size() const {
+            return lists[T1].size + lists[T2].size + lists[B1].size + lists[B2].size;
         }
 
+        void clear();
+
         inline void clearStats() {
             hits = 0;
             nearMiss = 0;
             farMiss = 0;
         }
 
-        bool insert(const int key, const PVSFrame &object);
+        void getStatistics(VSMap *stats) const;
+
+        bool insert(const int key, PVSFrame object);
         PVSFrame object(const int key);
+        // can be called without cacheMutex, returns false when the key is only remembered and object() has to decide
+        bool lookup(const int key, PVSFrame &frame);
         inline bool contains(const int key) const {
-            return hash.count(key) > 0;
+            return findNode(key) >= 0;
         }
 
         bool remove(const int key);
 
+        // drops the frame but remembers the key as recently evicted
+        bool evictFrame(const int key);
+
+        template<typename T>
+        void forEachFrame(T func) const {
+            for (const auto &n : nodes) {
+                if (n.list == T1 || n.list == T2)
+                    func(n.key, n.frame);
+            }
+        }
+
         CacheAction recommendSize();
 
         void adjustSize(bool needMemory);
@@ -821,8 +1401,14 @@ private:
     VSFilterMode filterMode;
 
     int apiMajor;
+    int allFramesReady; // the value of arAllFramesReady in the filter's api version
     VSCore *core;
     PVSFunctionFrame functionFrame;
+    std::string creationOutputKey; // where the function in functionFrame returned the node, empty when it didn't
+    int creationOutputIndex = 0;
+    std::atomic<int> outputIndex {-1}; // the script output the node was set as, only used to label recorded requests
+    std::atomic<bool> outputAlpha {false};
+    uint64_t signature = 0; // identifies the node between runs of the same script, see initSignature()
     VSVideoInfo vi;
     VSAudioInfo ai;
 
@@ -834,7 +1420,64 @@ private:
     std::vector<VSFilterDependency> dependencies;
     std::vector<VSFilterDependency> consumers;
 
-    std::atomic<int64_t> processingTime;
+    std::atomic<int64_t> processingTime {0};
+    std::atomic<int64_t> framesProduced {0};
+
+    // statistics for getNodeStatistics(), the latency of calls that return a frame is only measured with graph inspection
+    // enabled and counted in buckets that are an eighth of an octave wide
+    static constexpr int latencyBucketsPerOctave = 8;
+    static constexpr int numLatencyBuckets = 48 * latencyBucketsPerOctave;
+    std::atomic<uint32_t> latencyHistogram[numLatencyBuckets] = {};
+    std::atomic<int64_t> activationCalls[3] = {}; // arInitial, arAllFramesReady and arError
+    std::atomic<int64_t> serialLockFailures {0};
+    std::atomic<int64_t> serialLockWaitTime {0};
+#ifdef VS_FRAME_GUARD_SAMPLE_INTERVAL
+    std::atomic<uint32_t> guardChecks {0};
+#endif
+    std::shared_ptr<VSNodeMemory> memory = std::make_shared<VSNodeMemory>();
+    // frames requested from each entry in dependencies, only counted with graph inspection enabled
+    std::vector<std::atomic<int64_t>> dependencyRequests;
+    // one bit per frame number the filter has returned, only kept with graph inspection enabled so frames produced more
+    // than once can be told apart from the first time
+    std::vector<std::atomic<uint64_t>> producedFrames;
+    std::atomic<int64_t> uniqueFramesProduced {0};
+    void addLatency(int64_t nanoseconds);
+
+    // the most frames processed at the same time set through setNodeConcurrency(), 0 for no limit, runningFrames
+    // is only counted while there is a limit
+    std::mutex concurrencyMutex;
+    int maxConcurrency = 0;
+    int64_t frameScratchSize = 0;
+    int64_t maxScratchSize = 0;
+    std::atomic<int> concurrencyLimit {0};
+    std::atomic<int> runningFrames {0};
+
+    // set with setNodeFrameReadyActivation(), the filter is called with arFrameReady as its requested frames arrive
+    std::atomic<bool> frameReadyActivation {false};
+
+    // set with setNodeLightweight(), the node never has a cache and its frames are processed by the thread that requested them
+    // or completed what they were waiting for instead of being queued
+    std::atomic<bool> lightweight {false};
+    int64_t getLatencyPercentile(double percentile) const;
+
+    // the serial nodes reached only through rpStrictSpatial dependencies whose frames are fetched ahead with ccfLookaheadPrefetch,
+    // found the first time they're needed, prefetchSources and prefetchSourcesValid are protected by the taskLock of the thread pool,
+    // numPrefetches counts the prefetch contexts of the node that are in progress or hold a frame
+    std::vector<VSNode *> prefetchSources;
+    bool prefetchSourcesValid = false;
+    std::atomic<int> numPrefetches {0};
+
+    // set with setNodeDedicatedThread(), the frames of the node are only processed by a thread of its own which also works on
+    // up to dedicatedQueueSize frames following dedicatedNext, the frame after the last one requested, protected by the taskLock
+    // of the thread pool
+    std::atomic<int> dedicatedQueueSize {0};
+    int dedicatedNext = 0;
+
+    // the planes of the output any consumer may read, it grows as consumers get demanded planes of their own and becomes all planes
+    // with the first request that doesn't come from a consumer, dependencyPlanes holds the source planes read by every output plane
+    // for each entry in dependencies, 3 per entry, and is only set with setFilterPlaneDependency()
+    std::atomic<int> demandedPlanes {0};
+    std::vector<int> dependencyPlanes;
 
     std::mutex cacheMutex;
     bool cacheLinear = false;
@@ -846,7 +1489,10 @@ private:
     vs3::VSVideoInfo v3vi;
 
     void registerCache(bool add);
+    void initSignature();
+    void applyCacheSizeHint();
     PVSFrame getCachedFrameInternal(int n);
+    bool isCachedInternal(int n);
     PVSFrame getFrameInternal(int n, int activationReason, VSFrameContext *frameCtx);
 public:
     VSNode(const VSMap *in, VSMap *out, const std::string &name, vs3::VSFilterInit init, VSFilterGetFrame getFrame, VSFilterFree free, VSFilterMode filterMode, int flags, void *instanceData, int apiMajor, VSCore *core); // V3 compatibility
@@ -857,6 +1503,15 @@ public:
     void addConsumer(VSNode *consumer, int strictSpatial);
     void removeConsumer(VSNode *consumer, int strictSpatial);
 
+    static constexpr int allPlanes = (1 << 3) - 1;
+    void addDemandedPlanes(int planes);
+    bool setPlaneDependency(int index, const int *planes);
+    bool hasDependency(const VSNode *source) const;
+
+    int getDemandedPlanes() const {
+        return demandedPlanes.load(std::memory_order_relaxed);
+    }
+
     void add_ref() noexcept {
         ++refcount;
     }
@@ -867,6 +1522,16 @@ public:
             delete this;
     }
 
+    // only adds a reference if the node isn't already being destroyed
+    bool tryAddRef() noexcept {
+        long count = refcount;
+        while (count > 0) {
+            if (refcount.compare_exchange_weak(count, count + 1))
+                return true;
+        }
+        return false;
+    }
+
     int getApiMajor() const {
         return apiMajor;
     }
@@ -879,6 +1544,10 @@ public:
         return filterMode;
     }
 
+    void *getInstanceData(VSFilterGetFrame getFrame) const {
+        return (filterGetFrame == getFrame) ? instanceData : nullptr;
+    }
+
     int64_t getFilterTime() const {
         return processingTime;
     }
@@ -896,6 +1565,15 @@ public:
     }
 
     void getFrame(const PVSFrameContext &ct);
+    void getFrames(const std::vector<PVSFrameContext> &contexts);
+
+    void setOutputIndex(int index, bool alpha) {
+        outputAlpha = alpha;
+        outputIndex = index;
+    }
+
+    // writes a request made from outside of filters to the request recording of the core if there is one
+    void recordRequest(int n, int priority);
 
     const VSVideoInfo &getVideoInfo() const;
     const vs3::VSVideoInfo &getVideoInfo3() const;
@@ -909,28 +1587,214 @@ public:
 
     const char *getCreationFunctionName(int level) const;
     const VSMap *getCreationFunctionArguments(int level) const;
+    VSPlugin *getCreationFunctionPlugin(int level) const;
+    const char *getCreationFunctionOutput(int *index) const;
 
     int setLinear();
     void setCacheMode(int mode);
     void setCacheOptions(int fixedSize, int maxSize, int maxHistorySize);
+    void setConcurrency(int maxConcurrency, int64_t frameScratchSize, int64_t maxScratchSize);
+    void setFrameReadyActivation(bool enable) {
+        frameReadyActivation = enable;
+    }
+    void setLightweight(bool enable);
+    void setDedicatedThread(int queueSize);
     void cacheFrame(const VSFrame *frame, int n);
 
     // to get around encapsulation a bit, more elegant than making everything friends in this case
     void reserveThread();
     void releaseThread();
     bool isWorkerThread();
+    size_t threadCount();
+    void processSlices(int count, int minSliceSize, VSSliceFunction func, void *userData);
+    VSAsyncRequest *beginAsyncRequest(VSFrameContext *ctx);
+    void readFileAsync(const std::string &filename, int64_t offset, int64_t size, VSMap *result, VSFrameContext *ctx);
 
     void notifyCache(bool needMemory);
+    void getStatistics(VSMap *stats);
+    void countRequest(VSNode *source);
+    void getEvictionCandidates(std::vector<VSEvictionCandidate> &candidates);
+    bool evictCachedFrame(int n);
+};
+
+// Records scheduler events in memory when the core is created with ccfEnableTracing and writes them in the
+// chrome trace event json format understood by chrome://tracing and perfetto. Every thread appends to its own
+// buffer so recording only takes an uncontended lock.
+class VSTraceRecorder {
+private:
+    struct Event {
+        char phase; // X = filter call, i = instant, b/e = time spent queued, s/f = request edge
+        const char *category;
+        std::string name;
+        int64_t timestamp; // in nanoseconds since the recorder was created
+        int64_t duration;
+        uint64_t id;
+        int n;
+        int activationReason;
+    };
+
+    struct ThreadBuffer {
+        std::mutex lock;
+        int tid;
+        std::string name;
+        std::vector<Event> events;
+    };
+
+    const uint64_t recorderId;
+    const std::chrono::steady_clock::time_point startTime;
+    std::mutex lock;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::atomic<uint64_t> idCounter;
+
+    ThreadBuffer *getThreadBuffer();
+public:
+    VSTraceRecorder();
+    int64_t now() const;
+    uint64_t newId() { return ++idCounter; }
+    void nameThread(const std::string &name);
+    void add(char phase, const char *category, const std::string &name, int64_t timestamp, int64_t duration = 0, uint64_t id = 0, int n = -1, int activationReason = -1);
+    bool write(const std::string &filename);
+};
+
+// Records the frame requests made from outside of filters so vspipe --replay-requests can issue the same pattern again
+// later. The file starts with the magic and version followed by a Record for every request in the order they were made,
+// all values are in native byte order.
+class VSRequestRecorder {
+public:
+    static const uint32_t magic = 0x51525356; // VSRQ
+    static const uint32_t version = 1;
+
+    struct Record {
+        uint32_t delay; // microseconds since the previous request or since recording started for the first
+        int32_t n;
+        int32_t outputIndex; // -1 for nodes that aren't a script output
+        uint8_t alpha;
+        uint8_t priority;
+        uint16_t reserved;
+    };
+private:
+    std::mutex lock;
+    FILE *file = nullptr;
+    std::atomic<bool> active;
+    std::chrono::steady_clock::time_point lastRequest;
+public:
+    VSRequestRecorder() : active(false) {}
+    ~VSRequestRecorder();
+    bool start(const std::string &filename);
+    bool stop();
+    bool isActive() const {
+        return active.load(std::memory_order_relaxed);
+    }
+    void add(int n, int outputIndex, bool alpha, int priority);
+};
+
+// maps the frames currently being produced to their contexts so duplicate requests can be merged, uses open
+// addressing with linear probing so requests don't allocate a node, only accessed while holding taskLock
+class VSContextTable {
+private:
+    struct Entry {
+        NodeOutputKey key;
+        PVSFrameContext ctx;
+    };
+    std::vector<Entry> entries;
+    size_t numEntries = 0;
+    void grow();
+public:
+    VSContextTable();
+    PVSFrameContext *find(const NodeOutputKey &key) noexcept;
+    void insert(const NodeOutputKey &key, const PVSFrameContext &ctx);
+    // only erases the entry if it still belongs to ctx, a canceled context may have been replaced by a new one for the same frame
+    void erase(NodeOutputKey key, const VSFrameContext *ctx) noexcept;
+
+    template<typename T>
+    void forEach(T func) {
+        for (auto &iter : entries)
+            if (iter.ctx)
+                func(iter.ctx);
+    }
+
+    size_t size() const noexcept {
+        return numEntries;
+    }
+};
+
+// limits the number of running worker threads across all the thread pools attached to it, the slots
+// are divided between the pools that want to run more threads than there are free slots by weight
+struct VSSharedThreadPool {
+private:
+    struct Member {
+        int weight;
+        size_t running;
+        size_t waiting;
+    };
+
+    std::atomic<long> refcount;
+    std::mutex lock;
+    std::condition_variable slotFreed;
+    size_t numSlots;
+    size_t usedSlots = 0;
+    std::map<const VSThreadPool *, Member> members;
+
+    bool canRun(const Member &member) const;
+    ~VSSharedThreadPool() = default;
+public:
+    // numSlots = 0 uses the number of available logical cpus
+    explicit VSSharedThreadPool(size_t numSlots);
+
+    void add_ref() noexcept {
+        ++refcount;
+    }
+
+    void release() noexcept {
+        assert(refcount > 0);
+        if (--refcount == 0)
+            delete this;
+    }
+
+    void attach(const VSThreadPool *pool, int weight);
+    void detach(const VSThreadPool *pool);
+    void acquireSlot(const VSThreadPool *pool);
+    void releaseSlot(const VSThreadPool *pool);
 };
 
 class VSThreadPool {
 private:
+    struct TaskCmp {
+        bool operator()(const PVSFrameContext &a, const PVSFrameContext &b) const {
+            return taskCmp(a, b);
+        }
+    };
+
+    // ordered by (priority, reqOrder, frame number) so the oldest request of the most urgent class is always first, insertion and
+    // removal are O(log n), the priority, deadline and reqOrder of a context must never be changed while it's in a task set, use updateReqOrder() instead
+    typedef std::set<PVSFrameContext, TaskCmp> TaskSet;
+
+    // a separately locked set of tasks, only used in work stealing mode
+    struct TaskQueue {
+        std::mutex lock;
+        TaskSet tasks;
+    };
+
+    // a range split into slices by processSlices(), the submitting thread and idle workers pick slices until none are left
+    struct SliceJob {
+        VSSliceFunction func;
+        void *userData;
+        int count;
+        int numSlices;
+        std::atomic<int> nextSlice;
+        std::atomic<int> remaining;
+        std::mutex lock;
+        std::condition_variable done;
+        SliceJob(VSSliceFunction func, void *userData, int count, int numSlices) : func(func), userData(userData), count(count), numSlices(numSlices), nextSlice(0), remaining(numSlices) {}
+    };
+
     VSCore *core;
     std::mutex taskLock;
     std::mutex callbackLock;
     std::map<std::thread::id, std::thread *> allThreads;
-    std::list<PVSFrameContext> tasks;
-    std::unordered_map<NodeOutputKey, PVSFrameContext> allContexts;
+    TaskSet tasks;
+    VSContextTable allContexts;
+    VSFrameContext *externalContexts = nullptr;
     std::condition_variable newWork;
     std::condition_variable allIdle;
     std::atomic<size_t> activeThreads;
@@ -939,25 +1803,188 @@ private:
     size_t maxThreads;
     std::atomic<bool> stopThreads;
     std::atomic<size_t> ticks;
-    size_t getNumAvailableThreads();
+    size_t taskSeq;
+
+    // time spent by the workers in the scheduler and in filter code, only measured with graph inspection enabled
+    std::atomic<int64_t> schedulingTime;
+    std::atomic<int64_t> filterTime;
+
+    // work stealing mode, queues[0] receives external requests and everything queued by non-worker threads,
+    // the remaining queues are shared round robin between the worker threads
+    const bool workStealing;
+    const bool pinThreads;
+    std::vector<TaskQueue> queues;
+    std::atomic<size_t> queueGeneration;
+
+    // set once when the core is attached to a shared thread pool, workers hold one of its slots while looking for and running tasks
+    std::atomic<VSSharedThreadPool *> sharedPool;
+
+    // automatic thread count tuning, the counters are collected by the workers and evaluated by whichever worker finishes a task
+    // after the tuning interval has passed, tuneLastTime is protected by taskLock
+    const bool autoTune;
+    size_t tuneMaxThreads;
+    int64_t tuneLastTime;
+    std::atomic<uint64_t> tuneTasks;
+    std::atomic<uint64_t> tuneLockFailures;
+    std::atomic<int64_t> tuneBusyTime;
+    std::atomic<int64_t> tuneCPUTime;
+
+    // lookahead prefetching, finished prefetches that are waiting to be used are kept in order of completion,
+    // everything is protected by taskLock except the flag
+    const bool lookaheadPrefetch;
+    size_t numPrefetching;
+    std::vector<PVSFrameContext> prefetchHeld;
+    std::condition_variable prefetchDone;
+
+    // slice jobs that still have unclaimed slices, protected by sliceLock
+    std::mutex sliceLock;
+    std::list<std::shared_ptr<SliceJob>> sliceJobs;
+    std::atomic<size_t> numSliceJobs;
+
+    // admission control while over the memory limit, see deferStart()
+    std::atomic<int> runningTasks;
+    std::atomic<bool> startsDeferred;
+    std::atomic<int64_t> deferredStarts;
+
+    // worker placement with ccfPreferPerformanceCores and ccfOneThreadPerCore, cpuCores holds the physical cores the process may
+    // run on with the fastest ones first and numPerformanceCores of them belong to the fastest class, it's empty when neither is set
+    struct CPUCore {
+        int group; // the processor group on windows, always 0 elsewhere
+        std::vector<int> cpus;
+        int efficiencyClass; // higher is faster
+    };
+
+    const bool preferPerformanceCores;
+    const bool oneThreadPerCore;
+    std::vector<CPUCore> cpuCores;
+    size_t numPerformanceCores = 0;
+    std::atomic<size_t> idlePerformanceThreads;
+
+    static std::vector<CPUCore> detectCPUCores();
+    bool placeWorker(size_t index);
+    size_t defaultThreadCount() const;
+
+    // the watchdog started by setWatchdog(), watchdogSeen remembers when the contexts in allContexts were first seen and whether
+    // they have been reported already, it's only used by the watchdog thread
+    struct WatchdogEntry {
+        NodeOutputKey key;
+        int64_t firstSeen;
+        bool reported;
+    };
+
+    std::mutex watchdogControl;
+    std::mutex watchdogLock;
+    std::condition_variable watchdogWake;
+    std::thread watchdogThread;
+    std::atomic<int64_t> watchdogThreshold;
+    std::atomic<int64_t> watchdogReports;
+    std::unordered_map<VSFrameContext *, WatchdogEntry> watchdogSeen;
+    int64_t idleStallSince = 0;
+
+    void runWatchdog();
+    void checkStalls(int64_t threshold);
+
+    // cache sizes are adjusted by the maintenance thread so the caches are never walked with taskLock held, requests only count
+    // ticks and set cachePressure when they see the memory limit exceeded, a missed wakeup just waits for the next timer tick
+    std::mutex maintenanceLock;
+    std::condition_variable maintenanceWake;
+    std::thread maintenanceThread;
+    bool stopMaintenance = false;
+    std::atomic<bool> cachePressure;
+    std::atomic<int64_t> cacheAdjustments;
+    std::atomic<int64_t> cacheAdjustmentTime;
+
+    void runMaintenance();
+
+    // threads started by setNodeDedicatedThread(), the workers skip the contexts of these nodes and leave them to the node's own thread
+    // which prefetches the frames following the last request whenever it has nothing else to do, protected by taskLock
+    struct DedicatedThread {
+        VSNode *node;
+        std::thread thread;
+        bool stop = false;
+    };
+
+    std::vector<std::shared_ptr<DedicatedThread>> dedicatedThreads;
+    std::condition_variable dedicatedWork;
+
+    void runDedicated(std::shared_ptr<DedicatedThread> thread);
+    bool findDedicatedTask(VSNode *node, PVSFrameContext &frameContext, PVSFrame &cachedFrame, bool &useSerialLock);
+    bool prefetchDedicated(VSNode *node);
+    void noteRequest(const NodeOutputKey &key);
+
+    // readFileAsync() jobs, the i/o threads are separate from the workers and started on first use, protected by ioLock
+    struct IOJob {
+        std::string filename;
+        int64_t offset;
+        int64_t size;
+        VSMap *result;
+        VSAsyncRequest *request;
+    };
+
+    std::mutex ioLock;
+    std::condition_variable ioWork;
+    std::deque<IOJob> ioJobs;
+    std::vector<std::thread> ioThreads;
+    bool ioStop = false;
+
     void queueTask(const PVSFrameContext &ctx);
+    void scheduleTask(const PVSFrameContext &ctx);
     void wakeThread();
     void startInternalRequest(const PVSFrameContext &notify, NodeOutputKey key);
     void spawnThread();
-    static void runTasksWrapper(VSThreadPool *owner, std::atomic<bool> &stop);
+    static void runTasksWrapper(VSThreadPool *owner, std::atomic<bool> &stop, size_t queueIndex, int node, size_t index);
     void runTasks(std::atomic<bool> &stop);
+    void runTasksWorkStealing(std::atomic<bool> &stop, size_t queueIndex);
+    int memoryPressure();
+    bool deferStart(const VSFrameContext *frameContext, int pressure);
+    bool tryLockNode(VSFrameContext *frameContext, std::set<VSNode *> &seenNodes, bool &useSerialLock);
+    static void releaseRunning(VSFrameContext *frameContext);
+    bool findTask(size_t queueIndex, PVSFrameContext &frameContext, PVSFrame &cachedFrame, bool &useSerialLock);
+    void notifyDependents(VSFrameContext *frameContext, PVSFrame &f); // moves f into the last dependent unless the context is external
+    void returnCachedFrame(const PVSFrameContext &frameContext, PVSFrame &f);
+    void insertTask(TaskSet &taskSet, int queueIndex, const PVSFrameContext &ctx);
+    void updateReqOrder(const PVSFrameContext &ctx, int priority, int64_t deadline, size_t reqOrder);
+    void eraseTask(TaskSet &taskSet, TaskSet::iterator iter);
+    int64_t runTask(const PVSFrameContext &frameContextRef, bool useSerialLock, std::unique_lock<std::mutex> &lock);
     static bool taskCmp(const PVSFrameContext &a, const PVSFrameContext &b);
+    void runSlices(const std::shared_ptr<SliceJob> &job);
+    bool helpWithSlices();
+    void linkExternal(VSFrameContext *ctx);
+    void acquireSharedSlot();
+    void releaseSharedSlot();
+    // taskLock must be held unless in work stealing mode
+    size_t countQueuedTasks();
+    void tuneThreadCount();
+    bool isCanceled(VSFrameContext *ctx, std::unordered_map<VSFrameContext *, bool> &visited);
+    int64_t getAbortDeadline(VSFrameContext *ctx, std::unordered_map<VSFrameContext *, int64_t> &visited);
+    const std::vector<VSNode *> &getPrefetchSources(VSNode *node);
+    bool issuePrefetch();
+    void endPrefetch(VSFrameContext *ctx);
+    void dropHeldPrefetch(size_t index);
+    void runIO();
 public:
-    VSThreadPool(VSCore *core);
+    VSThreadPool(VSCore *core, bool workStealing = false, bool pinThreads = false, bool autoTune = false, bool lookaheadPrefetch = false, bool preferPerformanceCores = false, bool oneThreadPerCore = false);
     ~VSThreadPool();
-    void returnFrame(const VSFrameContext *rCtx, const PVSFrame &f);
+    void returnFrame(VSFrameContext *rCtx, const PVSFrame &f);
     size_t threadCount();
     size_t setThreadCount(size_t threads);
     void startExternal(const PVSFrameContext &context);
+    void startExternal(const std::vector<PVSFrameContext> &contexts);
     void releaseThread();
     void reserveThread();
     bool isWorkerThread();
     void waitForDone();
+    void getStatistics(VSMap *stats);
+    void setWatchdog(int64_t threshold);
+    void processSlices(int count, int minSliceSize, VSSliceFunction func, void *userData);
+    VSAsyncRequest *beginAsyncRequest(VSFrameContext *ctx);
+    void completeAsyncRequest(VSAsyncRequest *request, const char *errorMessage);
+    void readFileAsync(const std::string &filename, int64_t offset, int64_t size, VSMap *result, VSFrameContext *ctx);
+    int cancelRequests(VSFrameDoneCallback frameDone, void *userData);
+    bool attachSharedPool(VSSharedThreadPool *pool, int weight);
+    void forgetPrefetches(VSNode *node);
+    void setDedicatedThread(VSNode *node, int queueSize);
+    static size_t getNumAvailableThreads();
 };
 
 struct VSPluginFunction {
@@ -968,11 +1995,21 @@ private:
     std::string name;
     std::string argString;
     std::string returnType;
-    std::vector<FilterArgument> inArgs;
-    std::vector<FilterArgument> retArgs;
+    // parsed on first use for plugins whose argument strings are already known to be valid
+    mutable std::once_flag argsParsed;
+    mutable std::vector<FilterArgument> inArgs;
+    mutable std::vector<FilterArgument> retArgs;
+    // interned argument names in the same order as map keys so arguments can be matched in a single pass
+    mutable std::vector<std::pair<const char *, size_t>> argBindings;
+    mutable bool acceptsAnyArgs = false;
     static void parseArgString(const std::string &argString, std::vector<FilterArgument> &argsOut, int apiMajor);
+    void parseArgs() const;
+    void bindArgs() const;
+    void validateArgs(const VSMap &args) const;
 public:
     VSPluginFunction(const std::string &name, const std::string &argString, const std::string &returnType, VSPublicFunction func, void *functionData, VSPlugin *plugin);
+    void setImplementation(VSPublicFunction func, void *functionData);
+    std::string getMergeKey(const VSMap &args) const;
     VSMap *invoke(const VSMap &args);
     const std::string &getName() const;
     const std::string &getArguments() const;
@@ -983,6 +2020,20 @@ public:
 };
 
 
+// What the plugin cache of ccfLazyPluginLoading knows about a plugin library, the file size
+// and modification time tell whether it's still valid
+struct VSPluginCacheEntry {
+    int64_t mtime = 0;
+    int64_t size = 0;
+    std::string id;
+    std::string fnamespace;
+    std::string fullname;
+    int pluginVersion = 0;
+    int apiMajor = 0;
+    int apiMinor = 0;
+    std::vector<std::array<std::string, 3>> functions; // name, arguments and return type as passed to registerFunction
+};
+
 struct VSPlugin {
     friend struct VSPluginFunction;
 private:
@@ -992,6 +2043,11 @@ private:
     bool hasConfig = false;
     bool readOnly = false;
     bool readOnlySet = false;
+    bool lazy = false; // created from the plugin cache, the library is loaded the first time a function is invoked
+    bool deferArgParsing = false;
+    bool reloading = false;
+    std::string loadError;
+    std::mutex loadLock;
     std::string filename;
     std::string fullname;
     std::string fnamespace;
@@ -1002,12 +2058,17 @@ private:
     void *libHandle;
 #endif
     std::map<std::string, VSPluginFunction> funcs;
+    std::vector<std::array<std::string, 3>> registeredFunctions;
     std::mutex functionLock;
     VSCore *core;
+    void loadLibrary(const std::string &relFilename, bool altSearchPath);
 public:
     explicit VSPlugin(VSCore *core);
     VSPlugin(const std::string &relFilename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath, VSCore *core);
+    VSPlugin(const std::string &filename, const VSPluginCacheEntry &entry, VSCore *core);
     ~VSPlugin();
+    bool ensureLoaded(std::string &error);
+    bool getCacheEntry(VSPluginCacheEntry &entry) const;
     void lock() { readOnly = true; }
     bool configPlugin(const std::string &identifier, const std::string &pluginsNamespace, const std::string &fullname, int pluginVersion, int apiVersion, int flags);
     bool registerFunction(const std::string &name, const std::string &args, const std::string &returnType, VSPublicFunction argsFunc, void *functionData);
@@ -1043,26 +2104,127 @@ private:
 
     std::map<std::string, VSPlugin *> plugins;
     std::recursive_mutex pluginLock;
-    std::map<int, vs3::VSVideoFormat> videoFormats;
+    std::map<std::string, VSPluginCacheEntry> pluginCache; // keyed by full path, only used with ccfLazyPluginLoading
+    std::string pluginCachePath;
+    bool pluginCacheDirty = false;
+    std::mutex pluginCacheLock; // plugins are opened in parallel when loading a whole directory so the cache needs its own lock
+    std::map<int, vs3::VSVideoFormat> videoFormats; // the named V3 formats are only registered when the first V3 format is needed
+    std::once_flag videoFormatsRegistered;
     std::mutex videoFormatLock;
+    // write once slots filled in as formats are registered so the lookups done for every V3 frame don't need videoFormatLock
+    std::unique_ptr<std::atomic<const vs3::VSVideoFormat *>[]> v3FormatsByProperties;
+    std::unique_ptr<std::atomic<const vs3::VSVideoFormat *>[]> v3FormatsById;
     int videoFormatIdOffset = 1000;
     VSCoreInfo coreInfo; // API3 compatibility
     std::set<VSNode *> caches;
     std::mutex cacheLock;
 
+    struct FrameDestination {
+        PVSFrame frame;
+        int left;
+        int top;
+        VSFrameContext *consumer;
+        PVSFrame view; // set once the producer has taken it
+    };
+
+    std::mutex destinationLock;
+    std::atomic<int> numDestinations {0};
+    std::unordered_map<NodeOutputKey, FrameDestination> destinations;
+
     std::atomic<int> cpuLevel;
 
+    // Fixed once the first audio node has been created
+    std::atomic<int> audioFrameSamples;
+    std::atomic<bool> audioFrameSamplesLocked;
+
     ~VSCore();
 
     void registerFormats();
+    const vs3::VSVideoFormat *registerVideoFormat3(vs3::VSColorFamily colorFamily, VSSampleType sampleType, int bitsPerSample, int subSamplingW, int subSamplingH, const char *name, int id) noexcept;
+
+    // Time spent in the constructor in nanoseconds
+    int64_t startupTotalTime = 0;
+    int64_t startupThreadPoolTime = 0;
+    int64_t startupInternalPluginsTime = 0;
+    int64_t startupAutoloadTime = 0;
+    void readPluginCache();
+    void writePluginCache();
 
     std::mutex logMutex;
     std::set<VSLogHandle *> messageHandlers;
+
+    // ccfAsyncLogging, any thread pushes messages onto logQueue with a single compare and swap and logThread takes the
+    // whole stack at once and delivers it oldest first while holding logMutex, the source is the node whose getframe
+    // function logged the message and is only used to tell filters apart
+    struct LogEntry {
+        LogEntry *next;
+        VSMessageType type;
+        const void *source;
+        std::string msg;
+    };
+
+    struct LogRepeat {
+        VSMessageType type;
+        int64_t windowStart;
+        int64_t suppressed;
+    };
+
+    std::atomic<bool> asyncLogging {false};
+    std::atomic<LogEntry *> logQueue {nullptr};
+    std::atomic<size_t> logQueueSize {0};
+    std::atomic<int64_t> logDropped {0};
+    std::mutex logWakeMutex;
+    std::condition_variable logWake;
+    bool stopLogThread = false; // protected by logWakeMutex
+    std::thread logThread;
+    std::map<std::pair<const void *, std::string>, LogRepeat> logRepeats; // only used by logThread
+
+    void deliverLogMessage(VSMessageType type, const char *msg);
+    void deliverQueuedLogMessages(bool flushRepeats);
+    void runLogThread();
+    void stopAsyncLogging();
 public:
     VSThreadPool *threadPool;
     MemoryUse *memory;
+    std::unique_ptr<VSTraceRecorder> tracer; // only set with ccfEnableTracing
+    VSRequestRecorder requestRecorder;
 
     bool disableLibraryUnloading;
+    bool costAwareEviction;
+    bool compressEvictedFrames;
+    bool fusePointwiseFilters;
+    bool fuseResizeChains;
+    bool fuseSpatialFilters;
+    bool mergeIdenticalFilters;
+    bool lazyPluginLoading;
+    bool padStrides;
+    bool writeJITSymbols;
+    bool frameProcessingTime;
+    bool liveMode;
+
+    // Filter creation results for ccfMergeIdenticalFilters keyed by function and arguments. The nodes
+    // aren't referenced so they're removed again when one of them is destroyed.
+    std::mutex mergedFiltersLock;
+    std::unordered_map<std::string, std::vector<std::pair<std::string, std::vector<VSNode *>>>> mergedFilters;
+    std::unordered_multimap<const VSNode *, std::string> mergedFiltersByNode;
+    bool findMergedFilter(const std::string &key, VSMap *out);
+    void addMergedFilter(const std::string &key, const VSMap *out);
+    void forgetMergedFilter(const VSNode *node);
+
+    // Cache sizes saved by an earlier run of the same script keyed by node signature, protected by cacheLock. A cache
+    // starts at its stored size when it's enabled instead of working its way there from the default size.
+    struct CacheSizeHint {
+        int maxSize;
+        int maxHistorySize;
+        std::string name;
+    };
+
+    std::unordered_map<uint64_t, CacheSizeHint> cacheSizeHints;
+    std::mutex signatureLock;
+    std::unordered_map<uint64_t, int> signatureCounts; // the number of nodes created with each signature so far
+    uint64_t uniqueSignature(uint64_t signature);
+    bool loadCacheSizes(const std::string &filename);
+    bool saveCacheSizes(const std::string &filename);
 
     // Used only for graph inspection
     bool enableGraphInspection; 
@@ -1070,6 +2232,11 @@ public:
     //
 
     void notifyCaches(bool needMemory);
+    void evictCheapestFrames();
+    static int transferCaches(VSNode *dst, VSNode *src);
+    bool offerDestination(NodeOutputKey key, VSFrame *dst, int left, int top, VSFrameContext *consumer);
+    VSFrame *takeDestination(const VSVideoFormat &format, int width, int height, const VSFrame *propSrc);
+    void withdrawDestinations(VSFrameContext *consumer);
     const vs3::VSVideoFormat *getV3VideoFormat(int id);
     const vs3::VSVideoFormat *getVideoFormat3(int id);
     static bool queryVideoFormat(VSVideoFormat &f, VSColorFamily colorFamily, VSSampleType sampleType, int bitsPerSample, int subSamplingW, int subSamplingH) noexcept;
@@ -1101,7 +2268,12 @@ public:
     vs3::VSVideoInfo VideoInfoToV3(const VSVideoInfo &vi) noexcept;
     VSVideoInfo VideoInfoFromV3(const vs3::VSVideoInfo &vi) noexcept;
 
-    void loadPlugin(const std::string &filename, const std::string &forcedNamespace = std::string(), const std::string &forcedId = std::string(), bool altSearchPath = false);
+    // loading is split so the libraries in a directory can be opened and initialized in parallel and then added in order
+    std::unique_ptr<VSPlugin> openPlugin(const std::string &filename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath, bool useCache);
+    void addPlugin(std::unique_ptr<VSPlugin> p, const std::string &filename);
+    void loadPlugins(const std::vector<std::string> &filenames);
+
+    void loadPlugin(const std::string &filename, const std::string &forcedNamespace = std::string(), const std::string &forcedId = std::string(), bool altSearchPath = false, bool useCache = false);
 
 #ifdef VS_TARGET_OS_WINDOWS
     bool loadAllPluginsInPath(const std::wstring &path, const std::wstring &filter);
@@ -1118,6 +2290,9 @@ public:
     int getCpuLevel() const;
     int setCpuLevel(int cpu);
 
+    int getAudioFrameSamples() const;
+    int setAudioFrameSamples(int samples);
+
     VSMap *getPlugins3();
     VSPlugin *getPluginByID(const std::string &identifier);
     VSPlugin *getPluginByNamespace(const std::string &ns);
@@ -1125,6 +2300,7 @@ public:
 
     const VSCoreInfo &getCoreInfo3();
     void getCoreInfo(VSCoreInfo &info);
+    void getStartupStatistics(VSMap *stats);
 
     static bool getAudioFormatName(const VSAudioFormat &format, char *buffer) noexcept;
     static bool getVideoFormatName(const VSVideoFormat &format, char *buffer) noexcept;
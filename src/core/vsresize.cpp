@@ -22,10 +22,14 @@
 #include <cstring>
 #include <algorithm>
 #include <limits>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <exception>
 
 #define ZIMGXX_NAMESPACE vszimgxx
 #include <zimg++.hpp>
@@ -188,13 +192,23 @@ T propGetScalarDef(const VSMap *map, const char *key, T def, const VSAPI *vsapi)
         return def;
 }
 
-template <class T, class U, class Pred>
-void propGetIfValid(const VSMap *map, const char *key, U *out, Pred pred, const VSAPI *vsapi) {
-    if (vsapi->mapNumElements(map, key) > 0) {
-        T x = propGetScalar<T>(map, key, vsapi);
-        if (pred(x))
-            *out = static_cast<U>(x);
-    }
+// the reserved properties are read through their slot, a key that is set but holds something else is still an error
+bool propGetReserved(const VSMap *map, int property, const char *key, int64_t *out, const VSAPI *vsapi) {
+    int err;
+    int64_t x = vsapi->mapGetReservedInt(map, property, 0, &err);
+    if (err == peUnset)
+        return false;
+    else if (err)
+        throw std::runtime_error{ "bad "_s + key + " type" };
+    *out = x;
+    return true;
+}
+
+template <class U, class Pred>
+void propGetReservedIfValid(const VSMap *map, int property, const char *key, U *out, Pred pred, const VSAPI *vsapi) {
+    int64_t x;
+    if (propGetReserved(map, property, key, &x, vsapi) && pred(static_cast<int>(x)))
+        *out = static_cast<U>(x);
 }
 
 
@@ -248,11 +262,10 @@ void translate_vsformat(const VSVideoFormat *vsformat, zimg_image_format *format
 
 
 void import_frame_props(const VSMap *props, zimg_image_format *format, bool *interlaced, const VSAPI *vsapi) {
-    propGetIfValid<int>(props, "_ChromaLocation", &format->chroma_location, [](int x) { return x >= 0; }, vsapi);
-
-    if (vsapi->mapNumElements(props, "_ColorRange") > 0) {
-        int64_t x = vsapi->mapGetInt(props, "_ColorRange", 0, nullptr);
+    propGetReservedIfValid(props, rfpChromaLocation, "_ChromaLocation", &format->chroma_location, [](int x) { return x >= 0; }, vsapi);
 
+    int64_t x;
+    if (propGetReserved(props, rfpColorRange, "_ColorRange", &x, vsapi)) {
         if (x == 0)
             format->pixel_range = ZIMG_RANGE_FULL;
         else if (x == 1)
@@ -262,23 +275,19 @@ void import_frame_props(const VSMap *props, zimg_image_format *format, bool *int
     }
 
     // Ignore UNSPECIFIED values from properties, since the user can specify them.
-    propGetIfValid<int>(props, "_Matrix", &format->matrix_coefficients, [](int x) { return x != ZIMG_MATRIX_UNSPECIFIED; }, vsapi);
-    propGetIfValid<int>(props, "_Transfer", &format->transfer_characteristics, [](int x) { return x != ZIMG_TRANSFER_UNSPECIFIED; }, vsapi);
-    propGetIfValid<int>(props, "_Primaries", &format->color_primaries, [](int x) { return x != ZIMG_PRIMARIES_UNSPECIFIED; }, vsapi);
+    propGetReservedIfValid(props, rfpMatrix, "_Matrix", &format->matrix_coefficients, [](int x) { return x != ZIMG_MATRIX_UNSPECIFIED; }, vsapi);
+    propGetReservedIfValid(props, rfpTransfer, "_Transfer", &format->transfer_characteristics, [](int x) { return x != ZIMG_TRANSFER_UNSPECIFIED; }, vsapi);
+    propGetReservedIfValid(props, rfpPrimaries, "_Primaries", &format->color_primaries, [](int x) { return x != ZIMG_PRIMARIES_UNSPECIFIED; }, vsapi);
 
     bool is_interlaced = false;
-    if (vsapi->mapNumElements(props, "_Field") > 0) {
-        int64_t x = vsapi->mapGetInt(props, "_Field", 0, nullptr);
-
+    if (propGetReserved(props, rfpField, "_Field", &x, vsapi)) {
         if (x == 0)
             format->field_parity = ZIMG_FIELD_BOTTOM;
         else if (x == 1)
             format->field_parity = ZIMG_FIELD_TOP;
         else
             throw std::runtime_error{ "bad _Field value: " + std::to_string(x) };
-    } else if (vsapi->mapNumElements(props, "_FieldBased") > 0) {
-        int64_t x = vsapi->mapGetInt(props, "_FieldBased", 0, nullptr);
-
+    } else if (propGetReserved(props, rfpFieldBased, "_FieldBased", &x, vsapi)) {
         if (x != 0 && x != 1 && x != 2)
             throw std::runtime_error{ "bad _FieldBased value: " + std::to_string(x) };
 
@@ -294,38 +303,36 @@ void import_frame_props(const VSMap *props, zimg_image_format *format, bool *int
 }
 
 void export_frame_props(const zimg_image_format &format, VSMap *props, const VSAPI *vsapi) {
-    auto set_int_if_positive = [&](const char *key, int x) {
+    auto set_int_if_positive = [&](int property, const char *key, int x) {
         if (x >= 0)
-            vsapi->mapSetInt(props, key, x, maReplace);
+            vsapi->mapSetReservedInt(props, property, x, maReplace);
         else
             vsapi->mapDeleteKey(props, key);
     };
 
     if (format.color_family == ZIMG_COLOR_YUV && (format.subsample_w || format.subsample_h))
-        vsapi->mapSetInt(props, "_ChromaLocation", format.chroma_location, maReplace);
+        vsapi->mapSetReservedInt(props, rfpChromaLocation, format.chroma_location, maReplace);
     else
         vsapi->mapDeleteKey(props, "_ChromaLocation");
 
     if (format.pixel_range == ZIMG_RANGE_FULL)
-        vsapi->mapSetInt(props, "_ColorRange", 0, maReplace);
+        vsapi->mapSetReservedInt(props, rfpColorRange, 0, maReplace);
     else if (format.pixel_range == ZIMG_RANGE_LIMITED)
-        vsapi->mapSetInt(props, "_ColorRange", 1, maReplace);
+        vsapi->mapSetReservedInt(props, rfpColorRange, 1, maReplace);
     else
         vsapi->mapDeleteKey(props, "_ColorRange");
 
-    set_int_if_positive("_Matrix", format.matrix_coefficients);
-    set_int_if_positive("_Transfer", format.transfer_characteristics);
-    set_int_if_positive("_Primaries", format.color_primaries);
+    set_int_if_positive(rfpMatrix, "_Matrix", format.matrix_coefficients);
+    set_int_if_positive(rfpTransfer, "_Transfer", format.transfer_characteristics);
+    set_int_if_positive(rfpPrimaries, "_Primaries", format.color_primaries);
 }
 
 void propagate_sar(const VSMap *src_props, VSMap *dst_props, const zimg_image_format &src_format, const zimg_image_format &dst_format, const VSAPI *vsapi) {
     int64_t sar_num = 0;
     int64_t sar_den = 0;
 
-    if (vsapi->mapNumElements(src_props, "_SARNum") > 0)
-        sar_num = vsapi->mapGetInt(src_props, "_SARNum", 0, nullptr);
-    if (vsapi->mapNumElements(dst_props, "_SARDen") > 0)
-        sar_den = vsapi->mapGetInt(dst_props, "_SARDen", 0, nullptr);
+    propGetReserved(src_props, rfpSARNum, "_SARNum", &sar_num, vsapi);
+    propGetReserved(dst_props, rfpSARDen, "_SARDen", &sar_den, vsapi);
 
     if (sar_num <= 0 || sar_den <= 0) {
         vsapi->mapDeleteKey(dst_props, "_SARNum");
@@ -334,8 +341,8 @@ void propagate_sar(const VSMap *src_props, VSMap *dst_props, const zimg_image_fo
         muldivRational(&sar_num, &sar_den, src_format.width, dst_format.width);
         muldivRational(&sar_num, &sar_den, dst_format.height, src_format.height);
 
-        vsapi->mapSetInt(dst_props, "_SARNum", sar_num, maReplace);
-        vsapi->mapSetInt(dst_props, "_SARDen", sar_den, maReplace);
+        vsapi->mapSetReservedInt(dst_props, rfpSARNum, sar_num, maReplace);
+        vsapi->mapSetReservedInt(dst_props, rfpSARDen, sar_den, maReplace);
     }
 }
 
@@ -414,6 +421,40 @@ bool is_shifted(const zimg_image_format &fmt) {
     return ret;
 }
 
+bool same_double(double a, double b) {
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+// operator== leaves out the active region since it's fixed for a single instance, graphs shared between instances need everything
+bool same_graph_formats(const zimg_image_format &a, const zimg_image_format &b) {
+    return a == b &&
+        same_double(a.active_region.left, b.active_region.left) &&
+        same_double(a.active_region.top, b.active_region.top) &&
+        same_double(a.active_region.width, b.active_region.width) &&
+        same_double(a.active_region.height, b.active_region.height);
+}
+
+bool same_graph_params(const zimg_graph_builder_params &a, const zimg_graph_builder_params &b) {
+    return a.resample_filter == b.resample_filter &&
+        same_double(a.filter_param_a, b.filter_param_a) &&
+        same_double(a.filter_param_b, b.filter_param_b) &&
+        a.resample_filter_uv == b.resample_filter_uv &&
+        same_double(a.filter_param_a_uv, b.filter_param_a_uv) &&
+        same_double(a.filter_param_b_uv, b.filter_param_b_uv) &&
+        a.dither_type == b.dither_type &&
+        a.cpu_type == b.cpu_type &&
+        same_double(a.nominal_peak_luminance, b.nominal_peak_luminance) &&
+        a.allow_approximate_gamma == b.allow_approximate_gamma;
+}
+
+// progressive frames are split into up to BAND_MAX_COUNT bands of at least BAND_MIN_HEIGHT rows that can be processed in parallel,
+// band edges are multiples of BAND_ALIGN rows so the ordered and random dither patterns line up with the unsplit frame
+const unsigned BAND_MIN_HEIGHT = 512;
+const unsigned BAND_MAX_COUNT = 8;
+const unsigned BAND_ALIGN = 64;
+
+// the number of compiled graphs kept around for all instances to share
+const size_t SHARED_GRAPH_COUNT = 64;
 
 void VS_CC vszimg_free(void *instanceData, VSCore *core, const VSAPI *vsapi);
 const VSFrame * VS_CC vszimg_get_frame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi);
@@ -454,23 +495,76 @@ class vszimg {
         vszimgxx::FilterGraph graph;
         zimg_image_format src_format;
         zimg_image_format dst_format;
+        zimg_graph_builder_params params;
 
         graph_data(const zimg_image_format &src_format, const zimg_image_format &dst_format, const zimg_graph_builder_params &params) :
             graph(vszimgxx::FilterGraph::build(src_format, dst_format, &params)),
             src_format(src_format),
-            dst_format(dst_format) {}
+            dst_format(dst_format),
+            params(params) {}
+    };
+
+    // A built graph is never modified and can process any number of frames at once so all instances doing the same
+    // conversion share one. Scripts with many identical resizes, for example inside FrameEval, then only build it once.
+    static std::shared_ptr<graph_data> get_shared_graph(const zimg_image_format &src_format, const zimg_image_format &dst_format, const zimg_graph_builder_params &params) {
+        static std::mutex lock;
+        static std::list<std::shared_ptr<graph_data>> graphs; // most recently used first
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (auto it = graphs.begin(); it != graphs.end(); ++it) {
+                const graph_data &data = **it;
+                if (same_graph_formats(data.src_format, src_format) && same_graph_formats(data.dst_format, dst_format) && same_graph_params(data.params, params)) {
+                    graphs.splice(graphs.begin(), graphs, it);
+                    return graphs.front();
+                }
+            }
+        }
+
+        // building takes a while so it's done without holding the lock, at worst the same graph is built twice
+        std::shared_ptr<graph_data> data = std::make_shared<graph_data>(src_format, dst_format, params);
+
+        std::lock_guard<std::mutex> guard(lock);
+        graphs.push_front(data);
+        if (graphs.size() > SHARED_GRAPH_COUNT)
+            graphs.pop_back();
+        return data;
+    }
+
+    // a progressive frame split into horizontal bands that are processed on separate threads
+    struct band_data {
+        zimg_image_format src_format;
+        zimg_image_format dst_format;
+        std::vector<unsigned> rows; // first output row of every band followed by the frame height
+        bool split_src; // no vertical filtering is done so every band only reads the same rows of the source
+        std::vector<std::shared_ptr<graph_data>> graphs;
+    };
+
+    struct band_job {
+        band_data *bands;
+        vszimgxx::zimage_buffer_const src_buffer;
+        vszimgxx::zimage_buffer dst_buffer;
+        unsigned src_num_planes;
+        unsigned dst_num_planes;
+        std::vector<std::exception_ptr> errors;
     };
 
     std::shared_ptr<graph_data> m_graph_data_p;
     std::shared_ptr<graph_data> m_graph_data_t;
     std::shared_ptr<graph_data> m_graph_data_b;
+    std::shared_ptr<band_data> m_band_data;
 
     VSNode *m_node;
     VSVideoInfo m_vi;
     bool m_prefer_props; // If true, frame properties have precedence over filter arguments.
+    int m_bands; // 0 picks the number of bands automatically
     double m_src_left, m_src_top, m_src_width, m_src_height;
     vszimgxx::zfilter_graph_builder_params m_params;
 
+    // the area of a crop in front that was folded into the source region with ccfFuseResizeChains
+    bool m_crop_folded;
+    int m_crop_left, m_crop_top, m_crop_width, m_crop_height;
+
     frame_params m_frame_params;
     frame_params m_frame_params_in;
 
@@ -511,14 +605,93 @@ class vszimg {
             *out = in.get();
     }
 
+    template <class T>
+    static void inherit_if_missing(const optional_of<T> &in, optional_of<T> *out) {
+        if (!out->is_present() && in.is_present())
+            *out = in.get();
+    }
+
+    static bool has_any_param(const frame_params &params) {
+        return params.matrix.is_present() || params.transfer.is_present() || params.primaries.is_present() || params.range.is_present() || params.chromaloc.is_present();
+    }
+
+    void replace_node(VSNode *node, const VSAPI *vsapi) {
+        node = vsapi->addNodeRef(node);
+        vsapi->freeNode(m_node);
+        m_node = node;
+    }
+
+    // only done with ccfFuseResizeChains since the intermediate rounding and the crop edges no longer affect the output
+    void fuse_inputs(const VSAPI *vsapi) {
+        const VSVideoInfo &node_vi = *vsapi->getVideoInfo(m_node);
+        if (!isConstantVideoFormat(&node_vi) || !isConstantVideoFormat(&m_vi))
+            return;
+
+        // a conversion in front that keeps the dimensions, subsampling and color family can be done as part of this one,
+        // its arguments then decide how the source is interpreted and what this one's defaults are
+        const vszimg *inner = reinterpret_cast<const vszimg *>(vs_get_filter_instance_data(m_node, vszimg_get_frame));
+        if (inner && !inner->m_crop_folded && !has_any_param(m_frame_params_in) && same_double(inner->m_params.nominal_peak_luminance, m_params.nominal_peak_luminance) &&
+            std::isnan(inner->m_src_left) && std::isnan(inner->m_src_top) && std::isnan(inner->m_src_width) && std::isnan(inner->m_src_height)) {
+            const VSVideoInfo &inner_vi = *vsapi->getVideoInfo(inner->m_node);
+            if (isConstantVideoFormat(&inner_vi) && inner_vi.width == node_vi.width && inner_vi.height == node_vi.height && inner_vi.format.colorFamily == node_vi.format.colorFamily &&
+                inner_vi.format.subSamplingW == node_vi.format.subSamplingW && inner_vi.format.subSamplingH == node_vi.format.subSamplingH) {
+                m_frame_params_in = inner->m_frame_params_in;
+                m_prefer_props = inner->m_prefer_props;
+                inherit_if_missing(inner->m_frame_params.matrix, &m_frame_params.matrix);
+                inherit_if_missing(inner->m_frame_params.transfer, &m_frame_params.transfer);
+                inherit_if_missing(inner->m_frame_params.primaries, &m_frame_params.primaries);
+                inherit_if_missing(inner->m_frame_params.range, &m_frame_params.range);
+                inherit_if_missing(inner->m_frame_params.chromaloc, &m_frame_params.chromaloc);
+                replace_node(inner->m_node, vsapi);
+            }
+        }
+
+        // an axis that isn't resized would start being resampled because of the offset so the crop has to stay then
+        VSNode *source;
+        int left, top;
+        const VSVideoInfo &crop_vi = *vsapi->getVideoInfo(m_node);
+        if (vs_get_crop_source(m_node, &source, &left, &top)) {
+            const VSVideoInfo &source_vi = *vsapi->getVideoInfo(source);
+            bool fold_w = (left == 0 && crop_vi.width == source_vi.width) || m_vi.width != crop_vi.width;
+            bool fold_h = (top == 0 && crop_vi.height == source_vi.height) || m_vi.height != crop_vi.height;
+            if (fold_w && fold_h) {
+                m_crop_folded = true;
+                m_crop_left = left;
+                m_crop_top = top;
+                m_crop_width = crop_vi.width;
+                m_crop_height = crop_vi.height;
+                replace_node(source, vsapi);
+            }
+        }
+    }
+
+    void apply_folded_crop(zimg_image_format *src_format, bool interlaced) const {
+        // the user's region is relative to the crop and already adjusted for fields here, the crop is
+        // in frame rows and every field only has half of them
+        auto &region = src_format->active_region;
+        double scale_h = interlaced ? 0.5 : 1.0;
+        region.left = m_crop_left + (std::isnan(region.left) ? 0.0 : region.left);
+        region.top = m_crop_top * scale_h + (std::isnan(region.top) ? 0.0 : region.top);
+        if (std::isnan(region.width))
+            region.width = m_crop_width;
+        if (std::isnan(region.height))
+            region.height = m_crop_height * scale_h;
+    }
+
     vszimg(const VSMap *in, void *userData, VSCore *core, const VSAPI *vsapi) :
         m_node{ nullptr },
         m_vi(),
         m_prefer_props(false),
+        m_bands(0),
         m_src_left(),
         m_src_top(),
         m_src_width(),
-        m_src_height()
+        m_src_height(),
+        m_crop_folded(false),
+        m_crop_left(),
+        m_crop_top(),
+        m_crop_width(),
+        m_crop_height()
     {
         try {
             m_node = vsapi->mapGetNode(in, "clip", 0, nullptr);
@@ -566,6 +739,9 @@ class vszimg {
             lookup_enum_str_opt(in, "dither_type", g_dither_type_table, &m_params.dither_type, vsapi);
             lookup_enum_str_opt(in, "cpu_type", g_cpu_type_table, &m_params.cpu_type, vsapi);
             m_prefer_props = !!propGetScalarDef<int>(in, "prefer_props", 0, vsapi);
+            m_bands = propGetScalarDef<int>(in, "bands", 0, vsapi);
+            if (m_bands < 0)
+                throw std::runtime_error{ "bands must not be negative" };
 
             m_src_left = propGetScalarDef<double>(in, "src_left", NAN, vsapi);
             m_src_top = propGetScalarDef<double>(in, "src_top", NAN, vsapi);
@@ -593,6 +769,9 @@ class vszimg {
                     throw std::runtime_error{ "Matrix must be specified when converting to YUV or GRAY from RGB" };
                 }
             }
+
+            if (vs_fuse_resize_chains(core))
+                fuse_inputs(vsapi);
         } catch (...) {
             freeFunc(core, vsapi);
             throw;
@@ -611,13 +790,99 @@ class vszimg {
 
         std::shared_ptr<graph_data> data = std::atomic_load(data_ptr);
         if (!data || data->src_format != src_format || data->dst_format != dst_format) {
-            data = std::make_shared<graph_data>(src_format, dst_format, m_params);
+            data = get_shared_graph(src_format, dst_format, m_params);
             std::atomic_store(data_ptr, data);
         }
 
         return data;
     }
 
+    unsigned get_num_bands(const zimg_image_format &src_format, const zimg_image_format &dst_format) const {
+        // error diffusion carries state from row to row so splitting the frame would leave visible seams
+        if (m_params.dither_type == ZIMG_DITHER_ERROR_DIFFUSION)
+            return 1;
+        if (!std::isnan(src_format.active_region.height) && src_format.active_region.height <= 0)
+            return 1;
+        if (m_bands > 0)
+            return std::max(std::min(dst_format.height / BAND_ALIGN, static_cast<unsigned>(m_bands)), 1U);
+        return std::max(std::min(dst_format.height / BAND_MIN_HEIGHT, BAND_MAX_COUNT), 1U);
+    }
+
+    std::shared_ptr<band_data> get_band_data(const zimg_image_format &src_format, const zimg_image_format &dst_format, unsigned num_bands) {
+        std::shared_ptr<band_data> data = std::atomic_load(&m_band_data);
+        if (data && data->src_format == src_format && data->dst_format == dst_format && data->graphs.size() == num_bands)
+            return data;
+
+        data = std::make_shared<band_data>();
+        data->src_format = src_format;
+        data->dst_format = dst_format;
+
+        // band edges also have to fall on whole chroma rows which the alignment takes care of
+        for (unsigned i = 0; i < num_bands; ++i)
+            data->rows.push_back(static_cast<unsigned>((static_cast<uint64_t>(dst_format.height) * i / num_bands) & ~(BAND_ALIGN - 1)));
+        data->rows.push_back(dst_format.height);
+
+        double src_top = std::isnan(src_format.active_region.top) ? 0.0 : src_format.active_region.top;
+        double src_height = std::isnan(src_format.active_region.height) ? src_format.height : src_format.active_region.height;
+        double scale = src_height / dst_format.height;
+
+        data->split_src = src_top == 0 && src_height == src_format.height && src_format.height == dst_format.height &&
+            src_format.subsample_h == dst_format.subsample_h && (!src_format.subsample_h || src_format.chroma_location == dst_format.chroma_location);
+
+        for (unsigned i = 0; i < num_bands; ++i) {
+            zimg_image_format band_src = src_format;
+            zimg_image_format band_dst = dst_format;
+            band_dst.height = data->rows[i + 1] - data->rows[i];
+
+            if (data->split_src) {
+                band_src.height = band_dst.height;
+                band_src.active_region.top = NAN;
+                band_src.active_region.height = NAN;
+            } else {
+                // the whole source is passed to every band and the active region selects the part needed
+                band_src.active_region.top = src_top + data->rows[i] * scale;
+                band_src.active_region.height = band_dst.height * scale;
+            }
+
+            data->graphs.push_back(get_shared_graph(band_src, band_dst, m_params));
+        }
+
+        std::atomic_store(&m_band_data, data);
+        return data;
+    }
+
+    static void VS_CC process_band(int start, int end, void *userData) {
+        band_job *job = static_cast<band_job *>(userData);
+
+        for (int i = start; i < end; ++i) {
+            try {
+                graph_data &graph = *job->bands->graphs[i];
+                unsigned row = job->bands->rows[i];
+
+                std::unique_ptr<void, decltype(&vsh_aligned_free)> tmp{
+                    vsh_aligned_malloc(graph.graph.get_tmp_size(), 64),
+                    vsh_aligned_free
+                };
+                if (!tmp)
+                    throw std::bad_alloc{};
+
+                vszimgxx::zimage_buffer_const src_buffer = job->src_buffer;
+                if (job->bands->split_src) {
+                    for (unsigned p = 0; p < job->src_num_planes; ++p)
+                        src_buffer.data(p) = src_buffer.line_at(p ? row >> job->bands->src_format.subsample_h : row, p);
+                }
+
+                vszimgxx::zimage_buffer dst_buffer = job->dst_buffer;
+                for (unsigned p = 0; p < job->dst_num_planes; ++p)
+                    dst_buffer.data(p) = dst_buffer.line_at(p ? row >> job->bands->dst_format.subsample_h : row, p);
+
+                graph.graph.process(src_buffer, dst_buffer, tmp.get());
+            } catch (...) {
+                job->errors[i] = std::current_exception();
+            }
+        }
+    }
+
     void set_src_colorspace(zimg_image_format *src_format) {
         propagate_if_present(m_frame_params_in.matrix, &src_format->matrix_coefficients);
         propagate_if_present(m_frame_params_in.transfer, &src_format->transfer_characteristics);
@@ -655,7 +920,7 @@ class vszimg {
         propagate_if_present(m_frame_params.chromaloc, &dst_format->chroma_location);
     }
 
-    const VSFrame *real_get_frame(const VSFrame *src_frame, VSCore *core, const VSAPI *vsapi) {
+    const VSFrame *real_get_frame(const VSFrame *src_frame, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
         VSFrame *dst_frame = nullptr;
         vszimgxx::zimage_format src_format, dst_format;
 
@@ -687,6 +952,9 @@ class vszimg {
                 set_src_colorspace(&src_format);
             }
 
+            if (m_crop_folded)
+                apply_folded_crop(&src_format, interlaced);
+
             set_dst_colorspace(src_format, &dst_format);
 
             if (src_format == dst_format && isSameVideoFormat(src_vsformat, dst_vsformat) && !is_shifted(src_format)) {
@@ -696,6 +964,7 @@ class vszimg {
             }
 
             dst_frame = vsapi->newVideoFrame(dst_vsformat, dst_format.width, dst_format.height, src_frame, core);
+            unsigned num_bands = interlaced ? 1 : get_num_bands(src_format, dst_format);
 
             if (interlaced) {
                 vszimgxx::zimage_format src_format_t = src_format;
@@ -731,6 +1000,17 @@ class vszimg {
                 auto src_buffer_t = get_field_buffer(src_buffer, src_vsformat->numPlanes, ZIMG_FIELD_TOP);
                 auto dst_buffer_t = get_field_buffer(dst_buffer, dst_vsformat->numPlanes, ZIMG_FIELD_TOP);
                 graph_t->graph.process(src_buffer_t, dst_buffer_t, tmp.get());
+            } else if (num_bands > 1) {
+                std::shared_ptr<band_data> bands = get_band_data(src_format, dst_format, num_bands);
+
+                band_job job{ bands.get(), import_frame_as_buffer_const(src_frame, vsapi), import_frame_as_buffer(dst_frame, vsapi),
+                    static_cast<unsigned>(src_vsformat->numPlanes), static_cast<unsigned>(dst_vsformat->numPlanes), std::vector<std::exception_ptr>(num_bands) };
+                vsapi->processSlices(static_cast<int>(num_bands), 1, process_band, &job, frameCtx);
+
+                for (const auto &error : job.errors) {
+                    if (error)
+                        std::rethrow_exception(error);
+                }
             } else {
                 std::shared_ptr<graph_data> graph = get_graph_data(src_format, dst_format);
 
@@ -788,7 +1068,7 @@ public:
                 vsapi->requestFrameFilter(n, m_node, frameCtx);
             } else if (activationReason == arAllFramesReady) {
                 src_frame = vsapi->getFrameFilter(n, m_node, frameCtx);
-                ret = real_get_frame(src_frame, core, vsapi);
+                ret = real_get_frame(src_frame, frameCtx, core, vsapi);
             }
         } catch (const vszimgxx::zerror &e) {
             std::string errmsg = "Resize error " + std::to_string(e.code) + ": " + e.msg;
@@ -853,6 +1133,85 @@ const VSFrame * VS_CC vszimg_get_frame(int n, int activationReason, void *instan
     return static_cast<vszimg *>(instanceData)->get_frame(n, activationReason, frameData, frameCtx, core, vsapi);
 }
 
+// Creates a resize with the given arguments and returns its node, errors are passed on to out as is
+VSNode *create_ladder_step(const VSMap *args, VSMap *out, void *filter, VSCore *core, const VSAPI *vsapi) {
+    VSMap *ret = vsapi->createMap();
+    vszimg::create(args, ret, filter, core, vsapi);
+    VSNode *node = nullptr;
+    if (const char *err = vsapi->mapGetError(ret))
+        vsapi->mapSetError(out, err);
+    else
+        node = vsapi->mapGetNode(ret, "clip", 0, nullptr);
+    vsapi->freeMap(ret);
+    return node;
+}
+
+// The colorspace conversion is done once at the source size into float 4:4:4 of the output color family
+// and every rung only scales, subsamples and dithers from there. The shared step is an ordinary cached
+// node so all rungs asking for the same frame only cause it to be converted once.
+void VS_CC vszimg_ladder_create(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    VSMap *args = vsapi->createMap();
+    VSNode *shared = nullptr;
+
+    try {
+        int num_rungs = vsapi->mapNumElements(in, "width");
+        if (num_rungs != vsapi->mapNumElements(in, "height"))
+            throw std::runtime_error{ "width and height must have the same number of elements" };
+
+        void *filter = reinterpret_cast<void *>(static_cast<intptr_t>(ZIMG_RESIZE_BICUBIC));
+        if (const char *kernel = propGetScalarDef<const char *>(in, "kernel", nullptr, vsapi)) {
+            auto it = g_resample_filter_table.find(kernel);
+            if (it == g_resample_filter_table.end())
+                throw std::runtime_error{ "bad value: kernel" };
+            filter = reinterpret_cast<void *>(static_cast<intptr_t>(it->second));
+        }
+
+        VSNode *node = vsapi->mapGetNode(in, "clip", 0, nullptr);
+        VSVideoFormat format = vsapi->getVideoInfo(node)->format;
+        vsapi->freeNode(node);
+
+        int format_id = propGetScalarDef<int>(in, "format", 0, vsapi);
+        if (format_id)
+            vsapi->getVideoFormatByID(&format, format_id, core);
+        if (format.colorFamily == cfUndefined)
+            throw std::runtime_error{ "the output format must be known, set format for variable format clips" };
+
+        vsapi->copyMap(in, args);
+        for (const char *key : { "width", "height", "kernel", "src_left", "src_top", "src_width", "src_height", "bands" })
+            vsapi->mapDeleteKey(args, key);
+        vsapi->mapSetInt(args, "format", vsapi->queryVideoFormatID(format.colorFamily, stFloat, 32, 0, 0, core), maReplace);
+
+        shared = create_ladder_step(args, out, filter, core, vsapi);
+        if (!shared) {
+            vsapi->freeMap(args);
+            return;
+        }
+
+        // the rungs take the colorspace from the shared step's frame properties
+        vsapi->clearMap(args);
+        vsapi->copyMap(in, args);
+        for (const char *key : { "kernel", "matrix_in", "matrix_in_s", "transfer_in", "transfer_in_s", "primaries_in", "primaries_in_s",
+                                 "range_in", "range_in_s", "chromaloc_in", "chromaloc_in_s", "prefer_props", "nominal_luminance" })
+            vsapi->mapDeleteKey(args, key);
+        vsapi->mapSetNode(args, "clip", shared, maReplace);
+
+        for (int i = 0; i < num_rungs; i++) {
+            vsapi->mapSetInt(args, "width", vsapi->mapGetInt(in, "width", i, nullptr), maReplace);
+            vsapi->mapSetInt(args, "height", vsapi->mapGetInt(in, "height", i, nullptr), maReplace);
+            VSNode *rung = create_ladder_step(args, out, filter, core, vsapi);
+            if (!rung)
+                break;
+            vsapi->mapSetNode(out, "clip", rung, maAppend);
+            vsapi->freeNode(rung);
+        }
+    } catch (const std::exception &e) {
+        vsapi->mapSetError(out, ("Ladder: "_s + e.what()).c_str());
+    }
+
+    vsapi->freeNode(shared);
+    vsapi->freeMap(args);
+}
+
 } // namespace
 
 
@@ -861,40 +1220,53 @@ void VS_CC resizeInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
 #define FLOAT_OPT(x) #x ":float:opt;"
 #define DATA_OPT(x) #x ":data:opt;"
 #define ENUM_OPT(x) INT_OPT(x) DATA_OPT(x ## _s)
+#define FORMAT_ARGUMENTS \
+        INT_OPT(format) \
+        ENUM_OPT(matrix) \
+        ENUM_OPT(transfer) \
+        ENUM_OPT(primaries) \
+        ENUM_OPT(range) \
+        ENUM_OPT(chromaloc) \
+        ENUM_OPT(matrix_in) \
+        ENUM_OPT(transfer_in) \
+        ENUM_OPT(primaries_in) \
+        ENUM_OPT(range_in) \
+        ENUM_OPT(chromaloc_in) \
+        FLOAT_OPT(filter_param_a) \
+        FLOAT_OPT(filter_param_b) \
+        DATA_OPT(resample_filter_uv) \
+        FLOAT_OPT(filter_param_a_uv) \
+        FLOAT_OPT(filter_param_b_uv) \
+        DATA_OPT(dither_type) \
+        DATA_OPT(cpu_type) \
+        INT_OPT(prefer_props) \
+        INT_OPT(bands) \
+        FLOAT_OPT(src_left) \
+        FLOAT_OPT(src_top) \
+        FLOAT_OPT(src_width) \
+        FLOAT_OPT(src_height) \
+        FLOAT_OPT(nominal_luminance)
+
     static const char FORMAT_DEFINITION[] =
         "clip:vnode;"
         INT_OPT(width)
         INT_OPT(height)
-        INT_OPT(format)
-        ENUM_OPT(matrix)
-        ENUM_OPT(transfer)
-        ENUM_OPT(primaries)
-        ENUM_OPT(range)
-        ENUM_OPT(chromaloc)
-        ENUM_OPT(matrix_in)
-        ENUM_OPT(transfer_in)
-        ENUM_OPT(primaries_in)
-        ENUM_OPT(range_in)
-        ENUM_OPT(chromaloc_in)
-        FLOAT_OPT(filter_param_a)
-        FLOAT_OPT(filter_param_b)
-        DATA_OPT(resample_filter_uv)
-        FLOAT_OPT(filter_param_a_uv)
-        FLOAT_OPT(filter_param_b_uv)
-        DATA_OPT(dither_type)
-        DATA_OPT(cpu_type)
-        INT_OPT(prefer_props)
-        FLOAT_OPT(src_left)
-        FLOAT_OPT(src_top)
-        FLOAT_OPT(src_width)
-        FLOAT_OPT(src_height)
-        FLOAT_OPT(nominal_luminance);
+        FORMAT_ARGUMENTS;
+
+    static const char LADDER_DEFINITION[] =
+        "clip:vnode;"
+        "width:int[];"
+        "height:int[];"
+        DATA_OPT(kernel)
+        FORMAT_ARGUMENTS;
+#undef FORMAT_ARGUMENTS
 #undef INT_OPT
 #undef FLOAT_OPT
 #undef DATA_OPT
 #undef ENUM_OPT
 
     static const char RETURN_FORMAT_DEFINITION[] = "clip:vnode;";
+    static const char RETURN_LADDER_DEFINITION[] = "clip:vnode[];";
 
     vspapi->configPlugin(VSH_RESIZE_PLUGIN_ID, "resize", "VapourSynth Resize", VAPOURSYNTH_INTERNAL_PLUGIN_VERSION, VAPOURSYNTH_API_VERSION, 0, plugin);
     vspapi->registerFunction("Bilinear", FORMAT_DEFINITION, RETURN_FORMAT_DEFINITION, vszimg_create, (void *)ZIMG_RESIZE_BILINEAR, plugin);
@@ -904,4 +1276,5 @@ void VS_CC resizeInitialize(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->registerFunction("Spline16", FORMAT_DEFINITION, RETURN_FORMAT_DEFINITION, vszimg_create, (void *)ZIMG_RESIZE_SPLINE16, plugin);
     vspapi->registerFunction("Spline36", FORMAT_DEFINITION, RETURN_FORMAT_DEFINITION, vszimg_create, (void *)ZIMG_RESIZE_SPLINE36, plugin);
     vspapi->registerFunction("Spline64", FORMAT_DEFINITION, RETURN_FORMAT_DEFINITION, vszimg_create, (void *)ZIMG_RESIZE_SPLINE64, plugin);
+    vspapi->registerFunction("Ladder", LADDER_DEFINITION, RETURN_LADDER_DEFINITION, vszimg_ladder_create, nullptr, plugin);
 }
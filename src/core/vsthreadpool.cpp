@@ -20,12 +20,23 @@
 
 #include "vscore.h"
 #include <cassert>
+#include <cinttypes>
+#include <climits>
 #include <bitset>
+#include <algorithm>
+#include <map>
 #ifdef VS_TARGET_CPU_X86
 #include "x86utils.h"
 #endif
+#ifdef VS_TARGET_OS_WINDOWS
+#include "../common/vsutf16.h"
+#endif
+
+#ifdef VS_TARGET_OS_LINUX
+#include <fstream>
+#endif
 
-#if defined(HAVE_SCHED_GETAFFINITY)
+#if defined(HAVE_SCHED_GETAFFINITY) || defined(VS_TARGET_OS_LINUX)
 #include <sched.h>
 #elif defined(HAVE_CPUSET_GETAFFINITY)
 #include <sys/param.h>
@@ -33,6 +44,152 @@
 #include <sys/cpuset.h>
 #endif
 
+static std::atomic<uint64_t> traceRecorderCounter(0);
+
+// the buffer of the recorder the thread last added an event to, recorders are identified by a unique id since
+// a new one may be allocated at the same address
+static thread_local uint64_t currentTraceRecorder = 0;
+static thread_local void *currentTraceBuffer = nullptr;
+
+VSTraceRecorder::VSTraceRecorder() : recorderId(++traceRecorderCounter), startTime(std::chrono::steady_clock::now()), idCounter(0) {
+}
+
+int64_t VSTraceRecorder::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+VSTraceRecorder::ThreadBuffer *VSTraceRecorder::getThreadBuffer() {
+    if (currentTraceRecorder != recorderId) {
+        std::lock_guard<std::mutex> l(lock);
+        buffers.emplace_back(new ThreadBuffer());
+        buffers.back()->tid = static_cast<int>(buffers.size());
+        buffers.back()->name = "thread " + std::to_string(buffers.size());
+        currentTraceRecorder = recorderId;
+        currentTraceBuffer = buffers.back().get();
+    }
+    return reinterpret_cast<ThreadBuffer *>(currentTraceBuffer);
+}
+
+void VSTraceRecorder::nameThread(const std::string &name) {
+    ThreadBuffer *buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> l(buffer->lock);
+    buffer->name = name + " " + std::to_string(buffer->tid);
+}
+
+void VSTraceRecorder::add(char phase, const char *category, const std::string &name, int64_t timestamp, int64_t duration, uint64_t id, int n, int activationReason) {
+    ThreadBuffer *buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> l(buffer->lock);
+    buffer->events.push_back({ phase, category, name, timestamp, duration, id, n, activationReason });
+}
+
+static void writeTraceString(FILE *f, const std::string &s) {
+    fputc('"', f);
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (static_cast<unsigned char>(c) < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+bool VSTraceRecorder::write(const std::string &filename) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(utf16_from_utf8(filename).c_str(), L"wb");
+#else
+    FILE *f = fopen(filename.c_str(), "wb");
+#endif
+    if (!f)
+        return false;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+
+    std::lock_guard<std::mutex> l(lock);
+    for (const auto &buffer : buffers) {
+        std::lock_guard<std::mutex> bl(buffer->lock);
+
+        fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", buffer->tid);
+        writeTraceString(f, buffer->name);
+        fprintf(f, "}}");
+        first = false;
+
+        for (const auto &e : buffer->events) {
+            fprintf(f, ",\n{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":", e.phase, e.category);
+            writeTraceString(f, e.name);
+            fprintf(f, ",\"pid\":1,\"tid\":%d,\"ts\":%" PRId64 ".%03d", buffer->tid, e.timestamp / 1000, static_cast<int>(e.timestamp % 1000));
+            if (e.phase == 'X')
+                fprintf(f, ",\"dur\":%" PRId64 ".%03d", e.duration / 1000, static_cast<int>(e.duration % 1000));
+            else if (e.phase == 'i')
+                fprintf(f, ",\"s\":\"t\"");
+            else if (e.phase == 'f')
+                fprintf(f, ",\"bp\":\"e\"");
+            if (e.phase == 'b' || e.phase == 'e' || e.phase == 's' || e.phase == 'f')
+                fprintf(f, ",\"id\":%" PRIu64, e.id);
+            if (e.n >= 0 && e.activationReason >= 0)
+                fprintf(f, ",\"args\":{\"n\":%d,\"activationReason\":%d}", e.n, e.activationReason);
+            else if (e.n >= 0)
+                fprintf(f, ",\"args\":{\"n\":%d}", e.n);
+            fputc('}', f);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+VSRequestRecorder::~VSRequestRecorder() {
+    stop();
+}
+
+bool VSRequestRecorder::start(const std::string &filename) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(utf16_from_utf8(filename).c_str(), L"wb");
+#else
+    FILE *f = fopen(filename.c_str(), "wb");
+#endif
+    if (!f)
+        return false;
+
+    uint32_t header[2] = { magic, version };
+    if (fwrite(header, sizeof(header), 1, f) != 1) {
+        fclose(f);
+        return false;
+    }
+
+    stop();
+    std::lock_guard<std::mutex> l(lock);
+    file = f;
+    lastRequest = std::chrono::steady_clock::now();
+    active = true;
+    return true;
+}
+
+bool VSRequestRecorder::stop() {
+    std::lock_guard<std::mutex> l(lock);
+    if (!file)
+        return true;
+    active = false;
+    bool success = !ferror(file);
+    success = (fclose(file) == 0) && success;
+    file = nullptr;
+    return success;
+}
+
+void VSRequestRecorder::add(int n, int outputIndex, bool alpha, int priority) {
+    std::lock_guard<std::mutex> l(lock);
+    if (!file)
+        return;
+    // the delay is measured between requests so rounding errors don't accumulate over a long recording
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    int64_t delay = std::chrono::duration_cast<std::chrono::microseconds>(now - lastRequest).count();
+    lastRequest += std::chrono::microseconds(delay);
+    Record r = { static_cast<uint32_t>(std::min<int64_t>(delay, UINT32_MAX)), n, outputIndex, static_cast<uint8_t>(alpha), static_cast<uint8_t>(priority), 0 };
+    fwrite(&r, sizeof(r), 1, file);
+}
+
 size_t VSThreadPool::getNumAvailableThreads() {
     size_t nthreads = std::thread::hardware_concurrency();
 #ifdef _WIN32
@@ -59,11 +216,962 @@ size_t VSThreadPool::getNumAvailableThreads() {
 }
 
 bool VSThreadPool::taskCmp(const PVSFrameContext &a, const PVSFrameContext &b) {
-    return (a->reqOrder < b->reqOrder) || (a->reqOrder == b->reqOrder && a->key.second < b->key.second);
+    // the most recently queued context goes first when everything else is equal since it's most likely to be
+    // deeper in the graph and closer to completing a frame
+    if (a->priority != b->priority)
+        return a->priority > b->priority;
+    if (a->deadline != b->deadline)
+        return a->deadline < b->deadline;
+    if (a->reqOrder != b->reqOrder)
+        return a->reqOrder < b->reqOrder;
+    if (a->key.second != b->key.second)
+        return a->key.second < b->key.second;
+    return a->queueSeq > b->queueSeq;
 }
 
-void VSThreadPool::runTasksWrapper(VSThreadPool *owner, std::atomic<bool> &stop) {
-    owner->runTasks(stop);
+// set for worker threads so queueTask() can put newly ready tasks in the worker's own queue
+static thread_local VSThreadPool *currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+// the shared thread pool a worker currently holds a slot of, if any
+static thread_local VSSharedThreadPool *heldSharedSlot = nullptr;
+
+// cleared for workers placed on efficiency cores, leftForPerformanceCore is set when such a worker skipped a serial filter
+// during its last search for work so it can wake the other workers before going to sleep
+static thread_local bool onPerformanceCore = true;
+static thread_local bool leftForPerformanceCore = false;
+
+// the node whose frames the thread processes when it was started by setNodeDedicatedThread()
+static thread_local VSNode *dedicatedNode = nullptr;
+
+// set while runTask() hands out the frames of a finished task, contexts of lightweight nodes that become ready are
+// collected here and processed by the same thread afterwards instead of being queued
+static thread_local std::vector<PVSFrameContext> *inlineTasks = nullptr;
+
+VSSharedThreadPool::VSSharedThreadPool(size_t numSlots) : refcount(1), numSlots(numSlots ? numSlots : std::max<size_t>(VSThreadPool::getNumAvailableThreads(), 1)) {
+}
+
+bool VSSharedThreadPool::canRun(const Member &member) const {
+    if (usedSlots >= numSlots)
+        return false;
+
+    // a pool that runs fewer threads than its weighted share of the slots always gets the next one, the others
+    // only get it when no pool below its share is waiting
+    uint64_t totalWeight = 0;
+    for (const auto &iter : members)
+        if (iter.second.running || iter.second.waiting)
+            totalWeight += iter.second.weight;
+
+    auto belowShare = [this, totalWeight](const Member &m) {
+        return m.running * totalWeight < numSlots * static_cast<uint64_t>(m.weight);
+    };
+
+    if (belowShare(member))
+        return true;
+
+    for (const auto &iter : members)
+        if (&iter.second != &member && iter.second.waiting && belowShare(iter.second))
+            return false;
+
+    return true;
+}
+
+void VSSharedThreadPool::attach(const VSThreadPool *pool, int weight) {
+    std::lock_guard<std::mutex> l(lock);
+    auto iter = members.find(pool);
+    if (iter != members.end())
+        iter->second.weight = weight;
+    else
+        members.insert(std::make_pair(pool, Member{ weight, 0, 0 }));
+    slotFreed.notify_all();
+}
+
+void VSSharedThreadPool::detach(const VSThreadPool *pool) {
+    std::lock_guard<std::mutex> l(lock);
+    assert(members.count(pool) && members[pool].running == 0 && members[pool].waiting == 0);
+    members.erase(pool);
+    slotFreed.notify_all();
+}
+
+void VSSharedThreadPool::acquireSlot(const VSThreadPool *pool) {
+    std::unique_lock<std::mutex> l(lock);
+    Member &member = members.at(pool);
+    member.waiting++;
+    slotFreed.wait(l, [this, &member] { return canRun(member); });
+    member.waiting--;
+    member.running++;
+    usedSlots++;
+}
+
+void VSSharedThreadPool::releaseSlot(const VSThreadPool *pool) {
+    std::lock_guard<std::mutex> l(lock);
+    Member &member = members.at(pool);
+    assert(member.running > 0 && usedSlots > 0);
+    member.running--;
+    usedSlots--;
+    // the share of every waiting pool may have changed so all of them have to check again
+    slotFreed.notify_all();
+}
+
+void VSThreadPool::acquireSharedSlot() {
+    VSSharedThreadPool *pool = sharedPool;
+    if (pool && !heldSharedSlot) {
+        pool->acquireSlot(this);
+        heldSharedSlot = pool;
+    }
+}
+
+void VSThreadPool::releaseSharedSlot() {
+    if (heldSharedSlot) {
+        heldSharedSlot->releaseSlot(this);
+        heldSharedSlot = nullptr;
+    }
+}
+
+bool VSThreadPool::attachSharedPool(VSSharedThreadPool *pool, int weight) {
+    std::lock_guard<std::mutex> l(taskLock);
+    VSSharedThreadPool *current = sharedPool;
+    if (current && current != pool)
+        return false;
+    // the pool has to know about this one before any worker sees it
+    pool->attach(this, weight);
+    if (!current) {
+        pool->add_ref();
+        sharedPool = pool;
+    }
+    return true;
+}
+
+#ifdef VS_TARGET_OS_LINUX
+// parses the 0-3,8-11 format used by sysfs, an empty list is returned if the file doesn't exist
+static std::vector<int> readCPUList(const std::string &path) {
+    std::vector<int> cpus;
+    std::ifstream cpuList(path);
+    std::string range;
+    while (std::getline(cpuList, range, ',')) {
+        int first = 0, last = 0;
+        int n = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (n == 1)
+            last = first;
+        for (int cpu = first; n >= 1 && cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+#endif
+
+std::vector<VSThreadPool::CPUCore> VSThreadPool::detectCPUCores() {
+    std::vector<CPUCore> cores;
+#if defined(VS_TARGET_OS_WINDOWS)
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+    std::vector<uint8_t> buffer(length);
+    if (length && GetLogicalProcessorInformationEx(RelationProcessorCore, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length)) {
+        for (DWORD offset = 0; offset < length;) {
+            const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data() + offset);
+            const GROUP_AFFINITY &mask = info->Processor.GroupMask[0];
+            CPUCore c = { mask.Group, {}, info->Processor.EfficiencyClass };
+            for (int i = 0; i < static_cast<int>(sizeof(KAFFINITY) * 8); i++) {
+                if (mask.Mask & (static_cast<KAFFINITY>(1) << i))
+                    c.cpus.push_back(i);
+            }
+            cores.push_back(c);
+            offset += info->Size;
+        }
+    }
+#elif defined(VS_TARGET_OS_LINUX)
+    cpu_set_t affinity;
+    if (sched_getaffinity(0, sizeof(affinity), &affinity))
+        return cores;
+
+    // intel hybrid cpus list their performance cores here, other cpus with several core types report a relative capacity per cpu
+    std::vector<int> performanceCPUs = readCPUList("/sys/devices/cpu_core/cpus");
+    std::map<int, size_t> coreIndex;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &affinity))
+            continue;
+
+        std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        std::vector<int> siblings = readCPUList(base + "/topology/thread_siblings_list");
+        int efficiencyClass = 0;
+        if (!performanceCPUs.empty()) {
+            efficiencyClass = std::find(performanceCPUs.begin(), performanceCPUs.end(), cpu) != performanceCPUs.end();
+        } else {
+            std::ifstream capacity(base + "/cpu_capacity");
+            capacity >> efficiencyClass;
+        }
+
+        // the logical cpus of a physical core are identified by the first of its siblings
+        auto iter = coreIndex.find(siblings.empty() ? cpu : siblings[0]);
+        if (iter == coreIndex.end()) {
+            coreIndex.insert(std::make_pair(siblings.empty() ? cpu : siblings[0], cores.size()));
+            cores.push_back({ 0, { cpu }, efficiencyClass });
+        } else {
+            cores[iter->second].cpus.push_back(cpu);
+        }
+    }
+#endif
+    std::stable_sort(cores.begin(), cores.end(), [](const CPUCore &a, const CPUCore &b) { return a.efficiencyClass > b.efficiencyClass; });
+    return cores;
+}
+
+static bool bindCurrentThread(int group, const std::vector<int> &cpus) {
+#if defined(VS_TARGET_OS_WINDOWS)
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = static_cast<WORD>(group);
+    for (int cpu : cpus)
+        affinity.Mask |= static_cast<KAFFINITY>(1) << cpu;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#elif defined(VS_TARGET_OS_LINUX)
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &affinity);
+    return sched_setaffinity(0, sizeof(affinity), &affinity) == 0;
+#else
+    return false;
+#endif
+}
+
+bool VSThreadPool::placeWorker(size_t index) {
+    if (oneThreadPerCore) {
+        index %= cpuCores.size();
+        onPerformanceCore = index < numPerformanceCores;
+        return bindCurrentThread(cpuCores[index].group, cpuCores[index].cpus);
+    }
+
+    // the first workers go to the performance cores, as many as they have logical cpus, and the rest to the efficiency cores,
+    // the os is free to move them around within the class
+    size_t numCPUs = 0;
+    size_t numPerformanceCPUs = 0;
+    for (size_t i = 0; i < cpuCores.size(); i++) {
+        numCPUs += cpuCores[i].cpus.size();
+        if (i < numPerformanceCores)
+            numPerformanceCPUs += cpuCores[i].cpus.size();
+    }
+    onPerformanceCore = index % numCPUs < numPerformanceCPUs;
+
+    size_t first = onPerformanceCore ? 0 : numPerformanceCores;
+    size_t last = onPerformanceCore ? numPerformanceCores : cpuCores.size();
+    // a thread can only be bound to cpus within a single processor group
+    int group = cpuCores[first].group;
+    std::vector<int> cpus;
+    for (size_t i = first; i < last; i++) {
+        if (cpuCores[i].group == group)
+            cpus.insert(cpus.end(), cpuCores[i].cpus.begin(), cpuCores[i].cpus.end());
+    }
+    return bindCurrentThread(group, cpus);
+}
+
+size_t VSThreadPool::defaultThreadCount() const {
+    return (oneThreadPerCore && !cpuCores.empty()) ? cpuCores.size() : getNumAvailableThreads();
+}
+
+void VSThreadPool::runTasksWrapper(VSThreadPool *owner, std::atomic<bool> &stop, size_t queueIndex, int node, size_t index) {
+    if (!owner->cpuCores.empty()) {
+        if (!owner->placeWorker(index))
+            owner->core->logMessage(mtWarning, "Failed to bind worker thread to its cpu cores");
+    } else if (node >= 0 && !owner->core->memory->bindCurrentThreadToNode(node)) {
+        owner->core->logMessage(mtWarning, "Failed to pin worker thread to NUMA node " + std::to_string(node));
+    }
+
+    if (owner->core->tracer)
+        owner->core->tracer->nameThread("worker");
+
+    if (owner->workStealing)
+        owner->runTasksWorkStealing(stop, queueIndex);
+    else
+        owner->runTasks(stop);
+}
+
+static int64_t steadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// cpu time used by the calling thread, 0 if it can't be determined
+static int64_t threadCPUNanoseconds() {
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        int64_t kernel = (static_cast<int64_t>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime;
+        int64_t user = (static_cast<int64_t>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime;
+        return (kernel + user) * 100;
+    }
+    return 0;
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    return 0;
+#endif
+}
+
+void VSThreadPool::releaseRunning(VSFrameContext *frameContext) {
+    if (frameContext->countedRunning) {
+        --frameContext->key.first->runningFrames;
+        frameContext->countedRunning = false;
+    }
+}
+
+// 0 when memory use is within the limits, 1 above the cache size and 2 above the hard limit
+int VSThreadPool::memoryPressure() {
+    if (core->memory->isOverHardLimit())
+        return 2;
+    return core->memory->isOverLimit() ? 1 : 0;
+}
+
+// Contexts that already ran are never held back since completing them releases the frames they requested. Above the
+// cache size new external requests wait until memory drops and above the hard limit no new context starts at all, except
+// when nothing is running since the graph would stall otherwise. That way only a single chain of requests at a time can
+// take memory use further past the hard limit.
+bool VSThreadPool::deferStart(const VSFrameContext *frameContext, int pressure) {
+    if (!pressure || !frameContext->first || (pressure == 1 && !frameContext->external) || runningTasks == 0)
+        return false;
+    if (!startsDeferred.exchange(true))
+        deferredStarts.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool VSThreadPool::tryLockNode(VSFrameContext *frameContext, std::set<VSNode *> &seenNodes, bool &useSerialLock) {
+    VSNode *node = frameContext->key.first;
+    int filterMode = node->filterMode;
+
+    // Nodes with a dedicated thread are only processed by it so nothing else competes for the lock
+    if (node->dedicatedQueueSize > 0 && dedicatedNode != node)
+        return false;
+
+    // Don't try to lock the same node twice since it's likely to fail and will produce more out of order requests as well
+    if (filterMode != fmFrameState && !seenNodes.insert(node).second)
+        return false;
+
+    // Frames beyond the concurrency limit of the node stay queued until one of the running ones is done
+    int limit = node->concurrencyLimit;
+    if (limit > 0) {
+        int running = node->runningFrames;
+        do {
+            if (running >= limit)
+                return false;
+        } while (!node->runningFrames.compare_exchange_weak(running, running + 1));
+        frameContext->countedRunning = true;
+    }
+
+    // Does the filter need the per instance mutex? fmFrameState, fmUnordered and fmParallelRequests (when in the arAllFramesReady state) use this
+    useSerialLock = (filterMode == fmFrameState || filterMode == fmUnordered || (filterMode == fmParallelRequests && !frameContext->first));
+
+    if (useSerialLock) {
+        if (!node->serialMutex.try_lock()) {
+            releaseRunning(frameContext);
+            if (core->tracer)
+                core->tracer->add('i', "lock", node->name, core->tracer->now(), 0, 0, frameContext->key.second);
+            node->serialLockFailures.fetch_add(1, std::memory_order_relaxed);
+            if (autoTune)
+                tuneLockFailures.fetch_add(1, std::memory_order_relaxed);
+            if (!frameContext->lockWaitStart)
+                frameContext->lockWaitStart = steadyNanoseconds();
+            return false;
+        }
+        bool setSerialFrame = false;
+        if (filterMode == fmFrameState) {
+            if (node->serialFrame == -1) {
+                node->serialFrame = frameContext->key.second;
+                // another frame already in progress?
+            } else if (node->serialFrame != frameContext->key.second) {
+                node->serialMutex.unlock();
+                releaseRunning(frameContext);
+                node->serialLockFailures.fetch_add(1, std::memory_order_relaxed);
+                if (autoTune)
+                    tuneLockFailures.fetch_add(1, std::memory_order_relaxed);
+                if (!frameContext->lockWaitStart)
+                    frameContext->lockWaitStart = steadyNanoseconds();
+                return false;
+            }
+            setSerialFrame = true;
+        }
+
+        // serial filters hold up everything after them so they're left to a worker on a performance core whenever one is idle,
+        // it's only done once the lock has been acquired since an idle worker that couldn't take it either would never wake up
+        if (!onPerformanceCore && idlePerformanceThreads > 0 && filterMode != fmParallelRequests) {
+            if (setSerialFrame)
+                node->serialFrame = -1;
+            node->serialMutex.unlock();
+            releaseRunning(frameContext);
+            leftForPerformanceCore = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+VSContextTable::VSContextTable() : entries(256) {
+}
+
+void VSContextTable::grow() {
+    std::vector<Entry> oldEntries(entries.size() * 2);
+    oldEntries.swap(entries);
+    size_t mask = entries.size() - 1;
+    for (auto &iter : oldEntries) {
+        if (!iter.ctx)
+            continue;
+        size_t pos = std::hash<NodeOutputKey>()(iter.key) & mask;
+        while (entries[pos].ctx)
+            pos = (pos + 1) & mask;
+        entries[pos].key = iter.key;
+        entries[pos].ctx.swap(iter.ctx);
+    }
+}
+
+PVSFrameContext *VSContextTable::find(const NodeOutputKey &key) noexcept {
+    size_t mask = entries.size() - 1;
+    for (size_t pos = std::hash<NodeOutputKey>()(key) & mask; entries[pos].ctx; pos = (pos + 1) & mask) {
+        if (entries[pos].key == key)
+            return &entries[pos].ctx;
+    }
+    return nullptr;
+}
+
+void VSContextTable::insert(const NodeOutputKey &key, const PVSFrameContext &ctx) {
+    assert(!find(key));
+    // keep the load factor at or below 1/2 so probe sequences stay short
+    if ((numEntries + 1) * 2 > entries.size())
+        grow();
+    size_t mask = entries.size() - 1;
+    size_t pos = std::hash<NodeOutputKey>()(key) & mask;
+    while (entries[pos].ctx)
+        pos = (pos + 1) & mask;
+    entries[pos].key = key;
+    entries[pos].ctx = ctx;
+    numEntries++;
+}
+
+void VSContextTable::erase(NodeOutputKey key, const VSFrameContext *ctx) noexcept {
+    size_t mask = entries.size() - 1;
+    size_t hole = std::hash<NodeOutputKey>()(key) & mask;
+    while (true) {
+        if (!entries[hole].ctx)
+            return;
+        if (entries[hole].key == key) {
+            if (entries[hole].ctx.get() != ctx)
+                return;
+            break;
+        }
+        hole = (hole + 1) & mask;
+    }
+
+    // shift the following entries of the probe sequence back so no tombstones are needed
+    for (size_t pos = (hole + 1) & mask; entries[pos].ctx; pos = (pos + 1) & mask) {
+        size_t ideal = std::hash<NodeOutputKey>()(entries[pos].key) & mask;
+        if (((pos - ideal) & mask) >= ((pos - hole) & mask)) {
+            entries[hole].key = entries[pos].key;
+            entries[hole].ctx.swap(entries[pos].ctx);
+            hole = pos;
+        }
+    }
+
+    numEntries--;
+    entries[hole].ctx.reset();
+}
+
+void VSThreadPool::notifyDependents(VSFrameContext *frameContext, PVSFrame &f) {
+    size_t numNotify = frameContext->notifyCtxList.size();
+    for (size_t i = 0; i < numNotify; i++) {
+        PVSFrameContext &notify = frameContext->notifyCtxList[i];
+        assert(!notify->asyncGuard);
+        if (core->frameProcessingTime) {
+            notify->subgraphTime.fetch_add(frameContext->subgraphTime, std::memory_order_relaxed);
+            notify->subgraphCacheHits.fetch_add(frameContext->subgraphCacheHits, std::memory_order_relaxed);
+        }
+        if (notify->frameReadyState >= VSFrameContext::frRunning) {
+            // the filter is looking at the earlier frames in arFrameReady so everything new is handed over once it returns
+            if (frameContext->hasError()) {
+                if (!notify->pendingError)
+                    notify->pendingErrorMessage = frameContext->getErrorMessage();
+                notify->pendingError = true;
+            } else {
+                notify->pendingFrames.push_back({frameContext->key, f});
+            }
+            notify->frameReadyState = VSFrameContext::frRunningPending;
+        } else if (frameContext->hasError()) {
+            notify->setError(frameContext->getErrorMessage());
+        } else if (i == numNotify - 1 && !frameContext->external) {
+            notify->availableFrames.push_back({frameContext->key, std::move(f)}); // the last reference is handed over instead of copied
+        } else {
+            notify->availableFrames.push_back({frameContext->key, f});
+        }
+
+        // a context already queued for arFrameReady gets arAllFramesReady instead when it runs after the last frame arrived
+        assert(notify->numFrameRequests > 0);
+        if (--notify->numFrameRequests == 0) {
+            if (notify->frameReadyState == VSFrameContext::frNone)
+                scheduleTask(notify);
+        } else if (notify->frameReadyState == VSFrameContext::frNone && notify->key.first->frameReadyActivation && !notify->hasError()) {
+            notify->frameReadyState = VSFrameContext::frQueued;
+            queueTask(notify);
+        }
+    }
+}
+
+void VSThreadPool::returnCachedFrame(const PVSFrameContext &frameContext, PVSFrame &f) {
+    if (core->tracer) {
+        VSNode *node = frameContext->key.first;
+        int64_t timestamp = core->tracer->now();
+        core->tracer->add('e', "queue", node->name, timestamp, 0, frameContext->traceId, frameContext->key.second);
+        core->tracer->add('i', "cache", node->name, timestamp, 0, 0, frameContext->key.second);
+    }
+
+    // a prefetched frame has already been timed when the prefetch ran the filter
+    if (core->frameProcessingTime && frameContext->first)
+        frameContext->subgraphCacheHits++;
+
+    notifyDependents(frameContext.get(), f);
+
+    allContexts.erase(frameContext->key, frameContext.get());
+    endPrefetch(frameContext.get());
+
+    if (frameContext->external)
+        returnFrame(frameContext.get(), f);
+}
+
+void VSThreadPool::insertTask(TaskSet &taskSet, int queueIndex, const PVSFrameContext &ctx) {
+    assert(ctx->queueIndex == -1);
+    ctx->queueSeq = ++taskSeq;
+    ctx->queueIndex = queueIndex;
+    if (core->tracer) {
+        if (!ctx->traceId)
+            ctx->traceId = core->tracer->newId();
+        core->tracer->add('b', "queue", ctx->key.first->name, core->tracer->now(), 0, ctx->traceId, ctx->key.second);
+    }
+    taskSet.insert(ctx);
+}
+
+void VSThreadPool::eraseTask(TaskSet &taskSet, TaskSet::iterator iter) {
+    (*iter)->queueIndex = -1;
+    taskSet.erase(iter);
+}
+
+void VSThreadPool::updateReqOrder(const PVSFrameContext &ctx, int priority, int64_t deadline, size_t reqOrder) {
+    // a request in a higher priority class takes over the place of the context, otherwise it can only move it forward
+    if (priority < ctx->priority)
+        return;
+    if (priority == ctx->priority)
+        reqOrder = std::min(reqOrder, ctx->reqOrder);
+    deadline = std::min(deadline, ctx->deadline);
+    if (priority == ctx->priority && deadline == ctx->deadline && reqOrder == ctx->reqOrder)
+        return;
+
+    // the context has to be reinserted if it's already queued to keep the set ordered
+    if (!workStealing) {
+        if (ctx->queueIndex >= 0) {
+            tasks.erase(ctx);
+            ctx->priority = priority;
+            ctx->deadline = deadline;
+            ctx->reqOrder = reqOrder;
+            tasks.insert(ctx);
+            return;
+        }
+    } else {
+        // contexts can only be queued while holding taskLock but they can be removed by other workers at any time
+        int index = ctx->queueIndex;
+        if (index >= 0) {
+            TaskQueue &q = queues[index];
+            std::unique_lock<std::mutex> l(q.lock);
+            if (ctx->queueIndex == index) {
+                q.tasks.erase(ctx);
+                ctx->priority = priority;
+                ctx->deadline = deadline;
+                ctx->reqOrder = reqOrder;
+                if (priority > prBulk && index != 0) {
+                    // contexts above bulk have to be in the shared queue where every worker looks for them
+                    ctx->queueIndex = -1;
+                    l.unlock();
+                    std::lock_guard<std::mutex> lq(queues[0].lock);
+                    ctx->queueIndex = 0;
+                    queues[0].tasks.insert(ctx);
+                    ++queueGeneration;
+                } else {
+                    q.tasks.insert(ctx);
+                }
+                return;
+            }
+        }
+    }
+
+    ctx->priority = priority;
+    ctx->deadline = deadline;
+    ctx->reqOrder = reqOrder;
+}
+
+int64_t VSThreadPool::runTask(const PVSFrameContext &frameContextRef, bool useSerialLock, std::unique_lock<std::mutex> &lock) {
+    // the context has already been removed from the task list so nothing else can touch it until it's been processed
+    VSFrameContext *frameContext = frameContextRef.get();
+    VSNode *node = frameContext->key.first;
+    int filterMode = node->filterMode;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Figure out the activation reason
+
+    // a context queued for arFrameReady is only called that way if some of its frames are still outstanding when it starts,
+    // nothing else changes the state while it's queued
+    bool frameReady = false;
+    if (frameContext->frameReadyState == VSFrameContext::frQueued) {
+        lock.lock();
+        frameReady = frameContext->numFrameRequests > 0;
+        frameContext->frameReadyState = frameReady ? VSFrameContext::frRunning : VSFrameContext::frNone;
+        lock.unlock();
+    }
+
+    assert(frameReady || frameContext->numFrameRequests == 0);
+
+    // the flag may be cleared again by a new request for the same frame so it's only turned into an error while holding taskLock,
+    // canceled requests that never started have no frame data to free so the filter isn't called at all
+    bool skipFilter = false;
+    if (frameContext->canceled) {
+        lock.lock();
+        if (frameContext->canceled && !frameContext->hasError())
+            frameContext->setError("Frame request canceled");
+        skipFilter = frameContext->canceled && (frameContext->first || frameReady);
+        lock.unlock();
+    }
+
+    // the filter isn't started for a request whose deadline has passed, a filter that already requested its frames is called with
+    // arError instead so it can free its frame data, requests without a deadline may be waiting for the frame by now so it's checked
+    // again under taskLock
+    if (frameContext->abortDeadline != noDeadline && steadyNanoseconds() >= frameContext->abortDeadline) {
+        lock.lock();
+        if (!frameContext->hasError()) {
+            std::unordered_map<VSFrameContext *, int64_t> visited;
+            frameContext->abortDeadline = getAbortDeadline(frameContext, visited);
+            if (steadyNanoseconds() >= frameContext->abortDeadline) {
+                frameContext->setError("Frame request deadline exceeded");
+                frameContext->expired = true;
+            }
+        }
+        skipFilter = skipFilter || (frameContext->expired && (frameContext->first || frameReady));
+        lock.unlock();
+    }
+
+    int ar = arInitial;
+    if (frameReady) {
+        // an error that's already known is reported in the final call
+        ar = arFrameReady;
+        skipFilter = skipFilter || frameContext->hasError();
+    } else if (frameContext->hasError()) {
+        ar = arError;
+    } else if (!frameContext->first) {
+        ar = node->allFramesReady;
+    } else if (frameContext->first) {
+        frameContext->first = false;
+    }
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Do the actual processing
+
+    if (frameContext->lockWaitStart) {
+        node->serialLockWaitTime.fetch_add(steadyNanoseconds() - frameContext->lockWaitStart, std::memory_order_relaxed);
+        frameContext->lockWaitStart = 0;
+    }
+
+    VSTraceRecorder *tracer = core->tracer.get();
+    int64_t traceStart = 0;
+    if (tracer) {
+        traceStart = tracer->now();
+        tracer->add('e', "queue", node->name, traceStart, 0, frameContext->traceId, frameContext->key.second);
+        if (frameContext->traceFlow) {
+            tracer->add('f', "request", node->name, traceStart, 0, frameContext->traceId);
+            frameContext->traceFlow = false;
+        }
+    }
+
+    bool measureTime = core->enableGraphInspection;
+    std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
+    if (measureTime)
+        startTime = std::chrono::high_resolution_clock::now();
+
+    int64_t tuneWallStart = 0;
+    int64_t tuneCPUStart = 0;
+    if (autoTune) {
+        tuneWallStart = steadyNanoseconds();
+        tuneCPUStart = threadCPUNanoseconds();
+    }
+
+    PVSFrame f;
+    if (!skipFilter) {
+        bool watched = watchdogThreshold.load(std::memory_order_relaxed) > 0;
+        if (watched)
+            frameContext->runningSince.store(steadyNanoseconds(), std::memory_order_relaxed);
+        f = node->getFrameInternal(frameContext->key.second, ar, frameContext);
+        if (watched)
+            frameContext->runningSince.store(0, std::memory_order_relaxed);
+    }
+
+    if (autoTune) {
+        tuneCPUTime.fetch_add(threadCPUNanoseconds() - tuneCPUStart, std::memory_order_relaxed);
+        tuneBusyTime.fetch_add(steadyNanoseconds() - tuneWallStart, std::memory_order_relaxed);
+        tuneTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int64_t duration = 0;
+    if (measureTime) {
+        duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+        filterTime.fetch_add(duration, std::memory_order_relaxed);
+    }
+
+    if (tracer)
+        tracer->add('X', "filter", node->name, traceStart, tracer->now() - traceStart, 0, frameContext->key.second, ar);
+
+    if (frameReady && f)
+        core->logFatal("A frame was returned by " + node->name + " in arFrameReady, this is not allowed");
+    if (frameReady && frameContext->reqList.size() > 0)
+        core->logFatal("Frames were requested by " + node->name + " in arFrameReady, this is not allowed");
+
+    // only this thread sets the guard while the filter runs so it can be read without the lock
+    bool asyncStarted = frameContext->asyncGuard;
+    if (asyncStarted && ar != arInitial)
+        core->logFatal("Async requests were started by " + node->name + " outside of arInitial, this is not allowed");
+    if (asyncStarted && f)
+        core->logFatal("A frame was returned by " + node->name + " but there are still outstanding async requests");
+
+    // an error set while async requests are outstanding is delivered with arError once they're done
+    bool frameProcessingDone = !frameReady && !asyncStarted && (f || frameContext->hasError());
+    if (frameContext->hasError() && f)
+        core->logFatal("A frame was returned by " + node->name + " but an error was also set, this is not allowed");
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Unlock so the next job can run on the context
+    releaseRunning(frameContext);
+
+    if (useSerialLock) {
+        if (frameProcessingDone && filterMode == fmFrameState)
+            node->serialFrame = -1;
+        node->serialMutex.unlock();
+    }
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Handle frames that were requested
+    bool requestedFrames = frameContext->reqList.size() > 0 && !frameProcessingDone && !frameReady;
+    if (f && requestedFrames)
+        core->logFatal("A frame was returned at the end of processing by " + node->name + " but there are still outstanding requests");
+
+    // the dedicated thread of a node is kept for it alone
+    std::vector<PVSFrameContext> inlineList;
+    std::vector<PVSFrameContext> *prevInlineTasks = inlineTasks;
+    inlineTasks = dedicatedNode ? nullptr : &inlineList;
+
+    lock.lock();
+
+    if (requestedFrames) {
+        // the requests are recorded as a separate slice that the request edges start from
+        int64_t requestStart = tracer ? tracer->now() : 0;
+
+        for (size_t i = 0; i < frameContext->reqList.size(); i++) {
+            if (core->enableGraphInspection)
+                node->countRequest(frameContext->reqList[i].first);
+            startInternalRequest(frameContextRef, frameContext->reqList[i]);
+        }
+
+        if (tracer)
+            tracer->add('X', "request", node->name, requestStart, tracer->now() - requestStart, 0, frameContext->key.second);
+
+        frameContext->numFrameRequests += frameContext->reqList.size();
+        frameContext->reqList.clear();
+    }
+
+    if (asyncStarted) {
+        // the async requests may all have completed while the filter ran
+        frameContext->asyncGuard = false;
+        if (frameContext->pendingError) {
+            frameContext->setError(frameContext->pendingErrorMessage);
+            frameContext->pendingError = false;
+            frameContext->pendingErrorMessage.clear();
+        }
+        if (--frameContext->numFrameRequests == 0)
+            queueTask(frameContextRef);
+    }
+
+    if (frameProcessingDone) {
+        // a prefetched frame nothing has asked for yet stays in the context table until it's requested
+        if (f && frameContext->prefetch && frameContext->notifyCtxList.size() == 0 && !frameContext->canceled) {
+            frameContext->prefetchedFrame = f;
+            prefetchHeld.push_back(frameContextRef);
+        } else {
+            allContexts.erase(frameContext->key, frameContext);
+            endPrefetch(frameContext);
+        }
+    }
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Notify all dependent contexts
+
+    if (frameReady) {
+        // hand over what arrived while the filter ran, the context waits for the rest or runs again if anything is new
+        for (auto &iter : frameContext->pendingFrames)
+            frameContext->availableFrames.push_back(std::move(iter));
+        frameContext->pendingFrames.clear();
+        if (frameContext->pendingError) {
+            frameContext->setError(frameContext->pendingErrorMessage);
+            frameContext->pendingError = false;
+            frameContext->pendingErrorMessage.clear();
+        }
+
+        bool pending = frameContext->frameReadyState == VSFrameContext::frRunningPending;
+        frameContext->frameReadyState = VSFrameContext::frNone;
+        if (frameContext->numFrameRequests == 0) {
+            queueTask(frameContextRef);
+        } else if (pending && !frameContext->hasError()) {
+            frameContext->frameReadyState = VSFrameContext::frQueued;
+            queueTask(frameContextRef);
+        }
+    } else if (frameProcessingDone) {
+        notifyDependents(frameContext, f);
+
+        if (frameContext->external)
+            returnFrame(frameContext, f);
+    } else if (requestedFrames || asyncStarted) {
+        // already scheduled, do nothing
+    } else {
+        core->logFatal("No frame returned at the end of processing by " + node->name);
+    }
+
+    // threads that went to sleep because everything left had to wait for memory aren't woken by anything else
+    if (startsDeferred && !memoryPressure()) {
+        startsDeferred = false;
+        newWork.notify_all();
+        dedicatedWork.notify_all();
+    }
+
+    if (autoTune)
+        tuneThreadCount();
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Process the lightweight contexts that became ready, they may make more ready in turn
+
+    inlineTasks = prevInlineTasks;
+    for (auto &iter : inlineList) {
+        lock.unlock();
+        duration += runTask(iter, false, lock);
+    }
+
+    return duration;
+}
+
+void VSThreadPool::tuneThreadCount() {
+    int64_t now = steadyNanoseconds();
+    int64_t interval = now - tuneLastTime;
+    if (interval < 100000000)
+        return;
+    tuneLastTime = now;
+
+    uint64_t numTasks = tuneTasks.exchange(0);
+    uint64_t lockFailures = tuneLockFailures.exchange(0);
+    int64_t busyTime = tuneBusyTime.exchange(0);
+    int64_t cpuTime = tuneCPUTime.exchange(0);
+    if (!numTasks || busyTime <= 0)
+        return;
+
+    size_t queued = countQueuedTasks();
+
+    size_t numCPUs = std::max<size_t>(tuneMaxThreads / 2, 1);
+    double utilization = static_cast<double>(busyTime) / (static_cast<double>(interval) * maxThreads);
+    double cpuShare = static_cast<double>(cpuTime) / busyTime;
+    double contention = static_cast<double>(lockFailures) / numTasks;
+
+    if (contention > 0.5) {
+        // most tasks fail to get the serial lock of fmUnordered and fmFrameState filters such as sources so more threads only add contention
+        if (maxThreads > 1)
+            maxThreads--;
+    } else if (utilization > 0.9 && queued >= maxThreads) {
+        // every thread is busy and there's more work queued, going beyond the number of cpus only helps when the filters spend a
+        // significant part of their time waiting instead of computing
+        if (maxThreads < numCPUs || (cpuShare < 0.75 && maxThreads < tuneMaxThreads)) {
+            maxThreads++;
+            wakeThread();
+        }
+    } else if (maxThreads > numCPUs && cpuShare > 0.9) {
+        // the cpus are oversubscribed by threads that don't wait for anything
+        maxThreads--;
+    }
+}
+
+void VSThreadPool::runSlices(const std::shared_ptr<SliceJob> &job) {
+    while (true) {
+        int slice = job->nextSlice++;
+        if (slice >= job->numSlices) {
+            // everything has been claimed so stop advertising the job
+            std::lock_guard<std::mutex> l(sliceLock);
+            auto iter = std::find(sliceJobs.begin(), sliceJobs.end(), job);
+            if (iter != sliceJobs.end()) {
+                sliceJobs.erase(iter);
+                --numSliceJobs;
+            }
+            break;
+        }
+
+        int start = static_cast<int>((static_cast<int64_t>(job->count) * slice) / job->numSlices);
+        int end = static_cast<int>((static_cast<int64_t>(job->count) * (slice + 1)) / job->numSlices);
+        {
+            VSScratchScope scratch;
+            job->func(start, end, job->userData);
+        }
+
+        if (--job->remaining == 0) {
+            std::lock_guard<std::mutex> l(job->lock);
+            job->done.notify_all();
+        }
+    }
+}
+
+bool VSThreadPool::helpWithSlices() {
+    std::shared_ptr<SliceJob> job;
+    {
+        std::lock_guard<std::mutex> l(sliceLock);
+        if (sliceJobs.empty())
+            return false;
+        job = sliceJobs.front();
+    }
+
+    // slices run by the thread that called processSlices() are already part of its filter time
+    bool measureTime = core->enableGraphInspection;
+    std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
+    if (measureTime)
+        startTime = std::chrono::high_resolution_clock::now();
+
+    runSlices(job);
+
+    if (measureTime)
+        filterTime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count(), std::memory_order_relaxed);
+    return true;
+}
+
+void VSThreadPool::processSlices(int count, int minSliceSize, VSSliceFunction func, void *userData) {
+    if (count <= 0)
+        return;
+
+    int numSlices = std::min<int64_t>(count / std::max(minSliceSize, 1), maxThreads);
+    if (numSlices <= 1) {
+        func(0, count, userData);
+        return;
+    }
+
+    std::shared_ptr<SliceJob> job = std::make_shared<SliceJob>(func, userData, count, numSlices);
+
+    {
+        std::lock_guard<std::mutex> l(taskLock);
+        {
+            std::lock_guard<std::mutex> sl(sliceLock);
+            sliceJobs.push_back(job);
+            ++numSliceJobs;
+        }
+        // sleeping workers only check the generation counter in work stealing mode
+        ++queueGeneration;
+        for (int i = 1; i < numSlices; i++)
+            wakeThread();
+    }
+
+    runSlices(job);
+
+    // the remaining slices are already being processed by other threads
+    std::unique_lock<std::mutex> l(job->lock);
+    job->done.wait(l, [&job] { return job->remaining == 0; });
 }
 
 void VSThreadPool::runTasks(std::atomic<bool> &stop) {
@@ -75,182 +1183,269 @@ void VSThreadPool::runTasks(std::atomic<bool> &stop) {
     std::unique_lock<std::mutex> lock(taskLock);
 
     while (true) {
+        // with a shared thread pool a slot has to be taken before looking for work to keep the total number of running threads within its size
+        if (sharedPool && !heldSharedSlot) {
+            lock.unlock();
+            acquireSharedSlot();
+            lock.lock();
+        }
+
         bool ranTask = false;
+        bool measureTime = core->enableGraphInspection;
+        int64_t taskTime = 0;
+        std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
+        if (measureTime)
+            startTime = std::chrono::high_resolution_clock::now();
 
 /////////////////////////////////////////////////////////////////////////////////////////////
-// Go through all tasks from the top (oldest) and process the first one possible
+// Help another thread finish its current frame first, this counts as running a task so the accounting and the
+// thread limit check below still happen
 
-        std::set<VSNode *> seenNodes;
-
-        for (auto iter = tasks.begin(); iter != tasks.end(); ++iter) {
-            VSFrameContext *frameContext = iter->get();
-            VSNode *node = frameContext->key.first;
+        if (numSliceJobs > 0) {
+            lock.unlock();
+            ranTask = helpWithSlices();
+            lock.lock();
+            if (ranTask && measureTime)
+                taskTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+        }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
-// Fast path if a frame is cached
-
-            if (node->cacheEnabled) {
-                PVSFrame f = node->getCachedFrameInternal(frameContext->key.second);
-
-                if (f) {                    
-                    bool needsSort = false;
-
-                    for (size_t i = 0; i < frameContext->notifyCtxList.size(); i++) {
-                        PVSFrameContext &notify = frameContext->notifyCtxList[i];
-                        notify->availableFrames.push_back({frameContext->key, f});
+// Go through all tasks from the top (oldest) and process the first one possible
 
-                        assert(notify->numFrameRequests > 0);
-                        if (--notify->numFrameRequests == 0) {
-                            queueTask(notify);
-                            needsSort = true;
-                        }
-                    }
+        std::set<VSNode *> seenNodes;
+        leftForPerformanceCore = false;
 
-                    PVSFrameContext mainContextRef = std::move(*iter);
-                    tasks.erase(iter);
-                    allContexts.erase(frameContext->key);
+        // over the memory limit the contexts that already ran get a pass of their own first since completing them frees memory
+        int pressure = memoryPressure();
 
-                    if (frameContext->external)
-                        returnFrame(frameContext, f);
+        for (int pass = pressure ? 0 : 1; pass < 2 && !ranTask; pass++) {
+            for (auto iter = tasks.begin(); iter != tasks.end(); ++iter) {
+                VSFrameContext *frameContext = iter->get();
+                VSNode *node = frameContext->key.first;
 
-                    if (needsSort)
-                        tasks.sort(taskCmp);
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Fast path if a frame is cached or was prefetched
 
+                if (frameContext->prefetchedFrame) {
+                    PVSFrameContext mainContextRef = *iter;
+                    PVSFrame f = std::move(mainContextRef->prefetchedFrame);
+                    eraseTask(tasks, iter);
+                    returnCachedFrame(mainContextRef, f);
                     ranTask = true;
                     break;
                 }
-            }
+
+                if (node->cacheEnabled) {
+                    PVSFrame f = node->getCachedFrameInternal(frameContext->key.second);
+
+                    if (f) {
+                        PVSFrameContext mainContextRef = *iter;
+                        eraseTask(tasks, iter);
+                        returnCachedFrame(mainContextRef, f);
+                        ranTask = true;
+                        break;
+                    }
+                }
+
+                if (frameContext->first && (pass == 0 || deferStart(frameContext, pressure)))
+                    continue;
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 // This part handles the locking for the different filter modes
 
-            int filterMode = node->filterMode;
+                bool useSerialLock = false;
+                if (!tryLockNode(frameContext, seenNodes, useSerialLock))
+                    continue;
 
-            // Don't try to lock the same node twice since it's likely to fail and will produce more out of order requests as well
-            if (filterMode != fmFrameState && !seenNodes.insert(node).second)
-                continue;
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Remove the context from the task list and keep references around until processing is done
 
-            // Does the filter need the per instance mutex? fmFrameState, fmUnordered and fmParallelRequests (when in the arAllFramesReady state) use this
-            bool useSerialLock = (filterMode == fmFrameState || filterMode == fmUnordered || (filterMode == fmParallelRequests && !frameContext->first));
+                PVSFrameContext frameContextRef = *iter;
+                eraseTask(tasks, iter);
 
-            if (useSerialLock) {
-                if (!node->serialMutex.try_lock())
-                    continue;
-                if (filterMode == fmFrameState) {
-                    if (node->serialFrame == -1) {
-                        node->serialFrame = frameContext->key.second;
-                        // another frame already in progress?
-                    } else if (node->serialFrame != frameContext->key.second) {
-                        node->serialMutex.unlock();
-                        continue;
-                    }
-                }
+                ++runningTasks;
+                lock.unlock();
+                taskTime = runTask(frameContextRef, useSerialLock, lock);
+                --runningTasks;
+                ranTask = true;
+                break;
             }
+        }
 
-/////////////////////////////////////////////////////////////////////////////////////////////
-// Remove the context from the task list and keep references around until processing is done
+        releaseSharedSlot();
 
-            PVSFrameContext frameContextRef = std::move(*iter);
-            tasks.erase(iter);
+        if (measureTime)
+            schedulingTime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count() - taskTime, std::memory_order_relaxed);
 
-/////////////////////////////////////////////////////////////////////////////////////////////
-// Figure out the activation reason
+        // idle workers fetch frames ahead of the requests before going to sleep
+        if (!ranTask && lookaheadPrefetch && !stop && activeThreads <= maxThreads && issuePrefetch())
+            continue;
 
-            assert(frameContext->numFrameRequests == 0);
-            int ar = arInitial;
-            if (frameContext->hasError()) {
-                ar = arError;
-            } else if (!frameContext->first) {
-                ar = (node->apiMajor == 3) ? static_cast<int>(vs3::arAllFramesReady) : static_cast<int>(arAllFramesReady);
-            } else if (frameContext->first) {
-                frameContext->first = false;
+        if (!ranTask || activeThreads > maxThreads) {
+            --activeThreads;
+            if (stop) {
+                lock.unlock();
+                break;
             }
+            if (++idleThreads == allThreads.size())
+                allIdle.notify_one();
 
-/////////////////////////////////////////////////////////////////////////////////////////////
-// Do the actual processing
+            // a skipped serial filter is still queued and needs one of the idle workers on a performance core
+            if (leftForPerformanceCore && !ranTask)
+                newWork.notify_all();
+            if (onPerformanceCore)
+                ++idlePerformanceThreads;
+            newWork.wait(lock);
+            if (onPerformanceCore)
+                --idlePerformanceThreads;
+            --idleThreads;
+            ++activeThreads;
+        }
+    }
+}
 
-            lock.unlock();
+bool VSThreadPool::findTask(size_t queueIndex, PVSFrameContext &frameContext, PVSFrame &cachedFrame, bool &useSerialLock) {
+    std::set<VSNode *> seenNodes;
+    leftForPerformanceCore = false;
 
-            PVSFrame f = node->getFrameInternal(frameContext->key.second, ar, frameContext);
-            ranTask = true;
+    // over the memory limit the contexts that already ran get a pass of their own first since completing them frees memory
+    int pressure = memoryPressure();
 
-            bool frameProcessingDone = f || frameContext->hasError();
-            if (frameContext->hasError() && f)
-                core->logFatal("A frame was returned by " + node->name + " but an error was also set, this is not allowed");
+    // takes the context at iter unless it has to stay queued for now
+    auto tryTake = [&](TaskSet &tasks, TaskSet::iterator iter, bool startedOnly) {
+        VSFrameContext *ctx = iter->get();
+        VSNode *node = ctx->key.first;
 
-/////////////////////////////////////////////////////////////////////////////////////////////
-// Unlock so the next job can run on the context
-            if (useSerialLock) {
-                if (frameProcessingDone && filterMode == fmFrameState)
-                    node->serialFrame = -1;
-                node->serialMutex.unlock();
-            }
+        if (ctx->prefetchedFrame) {
+            frameContext = *iter;
+            cachedFrame = std::move(ctx->prefetchedFrame);
+            eraseTask(tasks, iter);
+            return true;
+        }
 
-/////////////////////////////////////////////////////////////////////////////////////////////
-// Handle frames that were requested
-            bool requestedFrames = frameContext->reqList.size() > 0 && !frameProcessingDone;
-            bool needsSort = false;
-            if (f && requestedFrames)
-                core->logFatal("A frame was returned at the end of processing by " + node->name + " but there are still outstanding requests");
+        if (node->cacheEnabled) {
+            PVSFrame f = node->getCachedFrameInternal(ctx->key.second);
 
-            lock.lock();
+            if (f) {
+                frameContext = *iter;
+                eraseTask(tasks, iter);
+                cachedFrame = std::move(f);
+                return true;
+            }
+        }
 
-            if (requestedFrames) {
-                assert(frameContext->numFrameRequests == 0);
+        if (ctx->first && (startedOnly || deferStart(ctx, pressure)))
+            return false;
+
+        if (!tryLockNode(ctx, seenNodes, useSerialLock))
+            return false;
+
+        frameContext = *iter;
+        eraseTask(tasks, iter);
+        return true;
+    };
+
+    for (int pass = pressure ? 0 : 1; pass < 2; pass++) {
+        bool startedOnly = (pass == 0);
+
+        // the thread's own queue and the shared queue are walked together in taskCmp order so a newer context in the
+        // own queue never goes ahead of an older external request
+        {
+            TaskQueue &own = queues[queueIndex];
+            TaskQueue &shared = queues[0];
+            std::unique_lock<std::mutex> ownLock(own.lock, std::defer_lock);
+            std::unique_lock<std::mutex> sharedLock(shared.lock, std::defer_lock);
+            if (queueIndex != 0)
+                std::lock(ownLock, sharedLock);
+            else
+                sharedLock.lock();
+
+            auto a = (queueIndex != 0) ? own.tasks.begin() : own.tasks.end();
+            auto b = shared.tasks.begin();
+            while (a != own.tasks.end() || b != shared.tasks.end()) {
+                bool fromOwn = (b == shared.tasks.end()) || (a != own.tasks.end() && taskCmp(*a, *b));
+                TaskSet::iterator current = fromOwn ? a++ : b++;
+                assert((a == own.tasks.end() || !taskCmp(*a, *current)) && (b == shared.tasks.end() || !taskCmp(*b, *current)));
+                if (tryTake(fromOwn ? own.tasks : shared.tasks, current, startedOnly))
+                    return true;
+            }
+        }
 
-                for (size_t i = 0; i < frameContext->reqList.size(); i++)
-                    startInternalRequest(frameContextRef, frameContext->reqList[i]);
+        // then try to steal from the other workers
+        for (size_t i = 2; i < queues.size(); i++) {
+            size_t victim = (queueIndex + i - 1) % (queues.size() - 1) + 1;
+            if (victim == queueIndex)
+                continue;
 
-                frameContext->numFrameRequests = frameContext->reqList.size();
-                frameContext->reqList.clear();
+            TaskQueue &q = queues[victim];
+            std::lock_guard<std::mutex> l(q.lock);
+            for (auto iter = q.tasks.begin(); iter != q.tasks.end(); ++iter) {
+                if (tryTake(q.tasks, iter, startedOnly))
+                    return true;
             }
+        }
+    }
 
-            if (frameProcessingDone)
-                allContexts.erase(frameContext->key);
-
-/////////////////////////////////////////////////////////////////////////////////////////////
-// Notify all dependent contexts
+    return false;
+}
 
-            if (frameContext->hasError()) {
-                for (size_t i = 0; i < frameContextRef->notifyCtxList.size(); i++) {
-                    PVSFrameContext &notify = frameContextRef->notifyCtxList[i];
-                    notify->setError(frameContextRef->getErrorMessage());
-
-                    assert(notify->numFrameRequests > 0);
-                    if (--notify->numFrameRequests == 0) {
-                        queueTask(notify);
-                        needsSort = true;
-                    }
-                }
+void VSThreadPool::runTasksWorkStealing(std::atomic<bool> &stop, size_t queueIndex) {
+#ifdef VS_TARGET_OS_WINDOWS
+    if (!vs_isSSEStateOk())
+        core->logFatal("Bad SSE state detected after creating new thread");
+#endif
 
-                if (frameContext->external)
-                    returnFrame(frameContext, f);
-            } else if (f) {
-                for (size_t i = 0; i < frameContextRef->notifyCtxList.size(); i++) {
-                    PVSFrameContext &notify = frameContextRef->notifyCtxList[i];
-                    notify->availableFrames.push_back({frameContextRef->key, f});
-
-                    assert(notify->numFrameRequests > 0);
-                    if (--notify->numFrameRequests == 0) {
-                        queueTask(notify);
-                        needsSort = true;
-                    }
-                }
+    currentPool = this;
+    currentQueue = queueIndex;
 
-                if (frameContext->external)
-                    returnFrame(frameContext, f);
-            } else if (requestedFrames) {
-                // already scheduled, do nothing
-            } else {
-                core->logFatal("No frame returned at the end of processing by " + node->name);
-            }
+    // taskLock is only held for the bookkeeping after a task has run, the queues are scanned using their own locks
+    std::unique_lock<std::mutex> lock(taskLock, std::defer_lock);
 
-            if (needsSort)
-                tasks.sort(taskCmp);
-            break;
+    while (true) {
+        acquireSharedSlot();
+
+        bool measureTime = core->enableGraphInspection;
+        int64_t taskTime = 0;
+        std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
+        if (measureTime)
+            startTime = std::chrono::high_resolution_clock::now();
+
+        size_t generation = queueGeneration;
+        // helping with slices counts as running a task so the accounting and the thread limit check below still happen
+        bool helpedWithSlices = numSliceJobs > 0 && helpWithSlices();
+        if (helpedWithSlices && measureTime)
+            taskTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+        PVSFrameContext frameContext;
+        PVSFrame cachedFrame;
+        bool useSerialLock = false;
+        bool ranTask = helpedWithSlices || findTask(queueIndex, frameContext, cachedFrame, useSerialLock);
+
+        if (helpedWithSlices) {
+            lock.lock();
+        } else if (ranTask && cachedFrame) {
+            lock.lock();
+            returnCachedFrame(frameContext, cachedFrame);
+        } else if (ranTask) {
+            ++runningTasks;
+            taskTime = runTask(frameContext, useSerialLock, lock);
+            --runningTasks;
+        } else {
+            lock.lock();
+            // a queued prefetch changes the queue generation so the worker looks for work again instead of sleeping
+            if (lookaheadPrefetch && !stop && activeThreads <= maxThreads)
+                issuePrefetch();
         }
 
-        if (!ranTask || activeThreads > maxThreads) {
+        frameContext.reset();
+        cachedFrame.reset();
+        releaseSharedSlot();
+
+        if (measureTime)
+            schedulingTime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count() - taskTime, std::memory_order_relaxed);
+
+        // only go to sleep if nothing new was queued while looking for work, queueTask() always holds taskLock
+        if ((!ranTask && generation == queueGeneration) || activeThreads > maxThreads) {
             --activeThreads;
             if (stop) {
                 lock.unlock();
@@ -259,15 +1454,37 @@ void VSThreadPool::runTasks(std::atomic<bool> &stop) {
             if (++idleThreads == allThreads.size())
                 allIdle.notify_one();
 
+            // a skipped serial filter is still queued and needs one of the idle workers on a performance core
+            if (leftForPerformanceCore && !ranTask)
+                newWork.notify_all();
+            if (onPerformanceCore)
+                ++idlePerformanceThreads;
             newWork.wait(lock);
+            if (onPerformanceCore)
+                --idlePerformanceThreads;
             --idleThreads;
             ++activeThreads;
         }
+
+        lock.unlock();
     }
+
+    currentPool = nullptr;
 }
 
-VSThreadPool::VSThreadPool(VSCore *core) : core(core), activeThreads(0), idleThreads(0), reqCounter(0), stopThreads(false), ticks(0) {
+VSThreadPool::VSThreadPool(VSCore *core, bool workStealing, bool pinThreads, bool autoTune, bool lookaheadPrefetch, bool preferPerformanceCores, bool oneThreadPerCore) : core(core), activeThreads(0), idleThreads(0), reqCounter(0), stopThreads(false), ticks(0), taskSeq(0), schedulingTime(0), filterTime(0), workStealing(workStealing), pinThreads(pinThreads), queueGeneration(0), sharedPool(nullptr), autoTune(autoTune), tuneMaxThreads(std::max<size_t>(getNumAvailableThreads(), 1) * 2), tuneLastTime(steadyNanoseconds()), tuneTasks(0), tuneLockFailures(0), tuneBusyTime(0), tuneCPUTime(0), lookaheadPrefetch(lookaheadPrefetch), numPrefetching(0), numSliceJobs(0), runningTasks(0), startsDeferred(false), deferredStarts(0), preferPerformanceCores(preferPerformanceCores), oneThreadPerCore(oneThreadPerCore), idlePerformanceThreads(0), watchdogThreshold(0), watchdogReports(0), cachePressure(false), cacheAdjustments(0), cacheAdjustmentTime(0) {
+    if (preferPerformanceCores || oneThreadPerCore) {
+        cpuCores = detectCPUCores();
+        while (numPerformanceCores < cpuCores.size() && cpuCores[numPerformanceCores].efficiencyClass == cpuCores[0].efficiencyClass)
+            numPerformanceCores++;
+        // there's nothing to place when every core is the same
+        if (!oneThreadPerCore && numPerformanceCores == cpuCores.size())
+            cpuCores.clear();
+    }
+    if (workStealing)
+        queues = std::vector<TaskQueue>(std::max<size_t>(getNumAvailableThreads(), 1) + 1);
     setThreadCount(0);
+    maintenanceThread = std::thread(&VSThreadPool::runMaintenance, this);
 }
 
 size_t VSThreadPool::threadCount() {
@@ -276,14 +1493,17 @@ size_t VSThreadPool::threadCount() {
 }
 
 void VSThreadPool::spawnThread() {
-    std::thread *thread = new std::thread(runTasksWrapper, this, std::ref(stopThreads));
+    size_t queueIndex = workStealing ? (allThreads.size() % (queues.size() - 1) + 1) : 0;
+    size_t numNodes = pinThreads ? core->memory->getNUMANodeCount() : 0;
+    int node = numNodes ? static_cast<int>(allThreads.size() % numNodes) : -1;
+    std::thread *thread = new std::thread(runTasksWrapper, this, std::ref(stopThreads), queueIndex, node, allThreads.size());
     allThreads.insert(std::make_pair(thread->get_id(), thread));
     ++activeThreads;
 }
 
 size_t VSThreadPool::setThreadCount(size_t threads) {
     std::lock_guard<std::mutex> l(taskLock);
-    maxThreads = threads > 0 ? threads : getNumAvailableThreads();
+    maxThreads = threads > 0 ? threads : defaultThreadCount();
     if (maxThreads == 0) {
         maxThreads = 1;
         core->logMessage(mtWarning, "Couldn't detect optimal number of threads. Thread count set to 1.");
@@ -293,10 +1513,37 @@ size_t VSThreadPool::setThreadCount(size_t threads) {
 
 void VSThreadPool::queueTask(const PVSFrameContext &ctx) {
     assert(ctx);
-    tasks.push_front(ctx);
+    if (workStealing) {
+        size_t index = (currentPool == this && ctx->priority == prBulk) ? currentQueue : 0;
+        TaskQueue &q = queues[index];
+        std::lock_guard<std::mutex> l(q.lock);
+        insertTask(q.tasks, static_cast<int>(index), ctx);
+        ++queueGeneration;
+    } else {
+        insertTask(tasks, 0, ctx);
+    }
+    if (ctx->key.first->dedicatedQueueSize > 0)
+        dedicatedWork.notify_all();
     wakeThread();
 }
 
+// A lightweight node is cheaper to run than a trip through the queue so it's processed right away when a thread is
+// handing out frames in runTask(), anything that restricts where or when the node may run still goes through the queue
+void VSThreadPool::scheduleTask(const PVSFrameContext &ctx) {
+    VSNode *node = ctx->key.first;
+    if (!inlineTasks || !node->lightweight || node->dedicatedQueueSize > 0 || node->concurrencyLimit > 0 || (ctx->first && memoryPressure())) {
+        queueTask(ctx);
+        return;
+    }
+
+    if (core->tracer) {
+        if (!ctx->traceId)
+            ctx->traceId = core->tracer->newId();
+        core->tracer->add('b', "queue", node->name, core->tracer->now(), 0, ctx->traceId, ctx->key.second);
+    }
+    inlineTasks->push_back(ctx);
+}
+
 void VSThreadPool::wakeThread() {
     if (activeThreads < maxThreads) {
         if (idleThreads == 0) // newly spawned threads are active so no need to notify an additional thread
@@ -308,24 +1555,77 @@ void VSThreadPool::wakeThread() {
 
 void VSThreadPool::releaseThread() {
     --activeThreads;
+    releaseSharedSlot();
 }
 
 void VSThreadPool::reserveThread() {
+    acquireSharedSlot();
     ++activeThreads;
 }
 
+void VSThreadPool::linkExternal(VSFrameContext *ctx) {
+    ctx->nextExternal = externalContexts;
+    if (externalContexts)
+        externalContexts->prevExternal = ctx;
+    externalContexts = ctx;
+}
+
 void VSThreadPool::startExternal(const PVSFrameContext &context) {
     assert(context);
     std::lock_guard<std::mutex> l(taskLock);
+    noteRequest(context->key);
+    linkExternal(context.get());
     context->reqOrder = ++reqCounter;
     assert(context);
-    tasks.push_back(context); // external requests can't be combined so just add to queue
+    if (workStealing) {
+        std::lock_guard<std::mutex> lq(queues[0].lock);
+        insertTask(queues[0].tasks, 0, context);
+        ++queueGeneration;
+    } else {
+        insertTask(tasks, 0, context); // external requests can't be combined so just add to queue
+    }
     wakeThread();
 }
 
-void VSThreadPool::returnFrame(const VSFrameContext *rCtx, const PVSFrame &f) {
+void VSThreadPool::startExternal(const std::vector<PVSFrameContext> &contexts) {
+    std::lock_guard<std::mutex> l(taskLock);
+    // the whole range gets consecutive request orders so it's processed in the order it was requested
+    size_t reqOrder = (reqCounter += contexts.size()) - contexts.size();
+    for (const auto &iter : contexts)
+        noteRequest(iter->key);
+    if (workStealing) {
+        std::lock_guard<std::mutex> lq(queues[0].lock);
+        for (const auto &iter : contexts) {
+            linkExternal(iter.get());
+            iter->reqOrder = ++reqOrder;
+            insertTask(queues[0].tasks, 0, iter);
+        }
+        ++queueGeneration;
+    } else {
+        for (const auto &iter : contexts) {
+            linkExternal(iter.get());
+            iter->reqOrder = ++reqOrder;
+            insertTask(tasks, 0, iter);
+        }
+    }
+    for (size_t i = 0; i < std::min(contexts.size(), maxThreads); i++)
+        wakeThread();
+}
+
+void VSThreadPool::returnFrame(VSFrameContext *rCtx, const PVSFrame &f) {
     assert(rCtx->frameDone);
+    if (rCtx->prevExternal)
+        rCtx->prevExternal->nextExternal = rCtx->nextExternal;
+    else if (externalContexts == rCtx)
+        externalContexts = rCtx->nextExternal;
+    if (rCtx->nextExternal)
+        rCtx->nextExternal->prevExternal = rCtx->prevExternal;
+    rCtx->prevExternal = nullptr;
+    rCtx->nextExternal = nullptr;
+
     bool outputLock = rCtx->lockOnOutput;
+    int64_t subgraphTime = rCtx->subgraphTime;
+    int subgraphCacheHits = rCtx->subgraphCacheHits;
     // we need to unlock here so the callback may request more frames without causing a deadlock
     // AND so that slow callbacks will only block operations in this thread, not all the others
     taskLock.unlock();
@@ -336,10 +1636,17 @@ void VSThreadPool::returnFrame(const VSFrameContext *rCtx, const PVSFrame &f) {
         if (outputLock)
             callbackLock.unlock();
     } else {
-        f->add_ref();
+        // the frame may also be in a cache so the properties go on a copy that shares the planes
+        PVSFrame out = f;
+        if (core->frameProcessingTime) {
+            out = new VSFrame(*f);
+            vs_internal_vsapi.mapSetFloat(&out->getProperties(), "_VSProcessingTime", subgraphTime / 1e9, maReplace);
+            vs_internal_vsapi.mapSetInt(&out->getProperties(), "_VSCacheHits", subgraphCacheHits, maReplace);
+        }
+        out->add_ref();
         if (outputLock)
             callbackLock.lock();
-        rCtx->frameDone(rCtx->userData, f.get(), rCtx->key.second, rCtx->key.first, nullptr);
+        rCtx->frameDone(rCtx->userData, out.get(), rCtx->key.second, rCtx->key.first, nullptr);
         if (outputLock)
             callbackLock.unlock();
     }
@@ -353,34 +1660,638 @@ void VSThreadPool::startInternalRequest(const PVSFrameContext &notify, NodeOutpu
     if (key.second < 0)
         core->logFatal("Negative frame request by: " + notify->key.first->getName());
 
-    // check to see if it's time to reevaluate cache sizes
+    // check to see if it's time to reevaluate cache sizes, the actual work happens in the maintenance thread
     if (core->memory->isOverLimit()) {
-        ticks = 0;
-        core->notifyCaches(true);
-    } else if (++ticks == 500) { // a normal tick for caches to adjust their sizes based on recent history
-        ticks = 0;
-        core->notifyCaches(false);
+        if (!cachePressure.exchange(true, std::memory_order_relaxed))
+            maintenanceWake.notify_one();
+    } else if (++ticks % 500 == 0) { // a normal tick for caches to adjust their sizes based on recent history
+        maintenanceWake.notify_one();
+    }
+
+    noteRequest(key);
+
+    PVSFrameContext *existing = allContexts.find(key);
+
+    // a canceled context can only be reused while it's queued and hasn't turned into an error yet since the
+    // frames it waits for may be canceled as well, otherwise it's replaced by a new context and finishes on its own
+    if (existing && (*existing)->canceled && !notify->canceled) {
+        if ((*existing)->queueIndex >= 0 && !(*existing)->hasError()) {
+            (*existing)->canceled = false;
+        } else {
+            allContexts.erase(key, existing->get());
+            existing = nullptr;
+        }
+    }
+
+    // a context aborted because of its deadline fails everything waiting for it so later requests need a new one
+    if (existing && (*existing)->expired) {
+        allContexts.erase(key, existing->get());
+        existing = nullptr;
     }
 
-        
-    auto it = allContexts.find(key);
-    if (it != allContexts.end()) {
-        PVSFrameContext &ctx = it->second;
+    if (existing) {
+        PVSFrameContext &ctx = *existing;
         ctx->notifyCtxList.push_back(notify);
-        ctx->reqOrder = std::min(ctx->reqOrder, notify->reqOrder);
+        ctx->abortDeadline = std::max(ctx->abortDeadline.load(), notify->abortDeadline.load());
+        updateReqOrder(ctx, notify->priority, notify->deadline, notify->reqOrder);
+        // a finished prefetch is returned by the workers like a cached frame
+        if (ctx->prefetchedFrame) {
+            prefetchHeld.erase(std::find(prefetchHeld.begin(), prefetchHeld.end(), ctx));
+            queueTask(ctx);
+        }
     } else {
-        PVSFrameContext ctx = new VSFrameContext(key, notify);
+        PVSFrameContext ctx = VSFrameContext::create(key, notify);
+        ctx->canceled = notify->canceled.load();
         // create a new context and append it to the tasks
-        allContexts.insert(std::make_pair(key, ctx));
-        queueTask(ctx);
+        allContexts.insert(key, ctx);
+        if (core->tracer) {
+            ctx->traceId = core->tracer->newId();
+            ctx->traceFlow = true;
+            core->tracer->add('s', "request", notify->key.first->name, core->tracer->now(), 0, ctx->traceId);
+        }
+        scheduleTask(ctx);
     } 
 }
 
+VSAsyncRequest *VSThreadPool::beginAsyncRequest(VSFrameContext *ctx) {
+    std::lock_guard<std::mutex> l(taskLock);
+    // the guard is dropped when the filter returns, until then the count can't reach zero
+    if (!ctx->asyncGuard) {
+        ctx->asyncGuard = true;
+        ctx->numFrameRequests++;
+    }
+    ctx->numFrameRequests++;
+    return new VSAsyncRequest{ PVSFrameContext(ctx, true), this };
+}
+
+void VSThreadPool::completeAsyncRequest(VSAsyncRequest *request, const char *errorMessage) {
+    std::lock_guard<std::mutex> l(taskLock);
+    VSFrameContext *ctx = request->ctx.get();
+    if (errorMessage) {
+        if (ctx->asyncGuard || ctx->frameReadyState >= VSFrameContext::frRunning) {
+            if (!ctx->pendingError)
+                ctx->pendingErrorMessage = errorMessage;
+            ctx->pendingError = true;
+        } else {
+            ctx->setError(errorMessage);
+        }
+    }
+
+    if (--ctx->numFrameRequests == 0 && ctx->frameReadyState == VSFrameContext::frNone)
+        queueTask(request->ctx);
+    delete request;
+}
+
+void VSThreadPool::readFileAsync(const std::string &filename, int64_t offset, int64_t size, VSMap *result, VSFrameContext *ctx) {
+    VSAsyncRequest *request = beginAsyncRequest(ctx);
+    {
+        std::lock_guard<std::mutex> l(ioLock);
+        ioJobs.push_back({ filename, offset, size, result, request });
+        // a few threads are enough to keep several reads in flight, they spend their time blocked in the os
+        if (ioThreads.empty()) {
+            for (int i = 0; i < 4; i++)
+                ioThreads.emplace_back(&VSThreadPool::runIO, this);
+        }
+    }
+    ioWork.notify_one();
+}
+
+static bool readFileRange(const std::string &filename, int64_t offset, int64_t size, VSMap *result) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(utf16_from_utf8(filename).c_str(), L"rb");
+    auto seek = [f](int64_t pos, int origin) { return _fseeki64(f, pos, origin); };
+    auto tell = [f]() { return static_cast<int64_t>(_ftelli64(f)); };
+#else
+    FILE *f = fopen(filename.c_str(), "rb");
+    auto seek = [f](int64_t pos, int origin) { return fseeko(f, pos, origin); };
+    auto tell = [f]() { return static_cast<int64_t>(ftello(f)); };
+#endif
+    if (!f)
+        return false;
+
+    bool ok = false;
+    if (size < 0 && !seek(0, SEEK_END))
+        size = tell() - offset;
+    // the data has to fit in a single map entry
+    if (size >= 0 && size <= INT_MAX && !seek(offset, SEEK_SET)) {
+        char *data = vs_internal_vsapi.mapAllocData(result, "data", static_cast<int>(size), dtBinary, maReplace);
+        ok = data && fread(data, 1, static_cast<size_t>(size), f) == static_cast<size_t>(size);
+    }
+    fclose(f);
+    return ok;
+}
+
+void VSThreadPool::runIO() {
+    std::unique_lock<std::mutex> l(ioLock);
+    while (true) {
+        ioWork.wait(l, [this] { return ioStop || !ioJobs.empty(); });
+        if (ioStop)
+            return;
+        IOJob job = std::move(ioJobs.front());
+        ioJobs.pop_front();
+        l.unlock();
+
+        bool ok = readFileRange(job.filename, job.offset, job.size, job.result);
+        completeAsyncRequest(job.request, ok ? nullptr : ("Failed to read " + job.filename).c_str());
+        l.lock();
+    }
+}
+
+bool VSThreadPool::isCanceled(VSFrameContext *ctx, std::unordered_map<VSFrameContext *, bool> &visited) {
+    if (ctx->canceled)
+        return true;
+    if (ctx->external)
+        return false;
+
+    auto iter = visited.find(ctx);
+    if (iter != visited.end())
+        return iter->second;
+
+    // an internal context is only needed as long as one of the contexts it notifies is
+    bool result = true;
+    for (size_t i = 0; i < ctx->notifyCtxList.size() && result; i++)
+        result = isCanceled(ctx->notifyCtxList[i].get(), visited);
+    visited[ctx] = result;
+    return result;
+}
+
+// the abortDeadline stored in an internal context only includes the requests that were waiting for it when it was created or
+// joined, the ones that joined a context waiting for it later are found by following the notify lists up to the external requests
+int64_t VSThreadPool::getAbortDeadline(VSFrameContext *ctx, std::unordered_map<VSFrameContext *, int64_t> &visited) {
+    if (ctx->external || ctx->notifyCtxList.size() == 0)
+        return ctx->abortDeadline;
+
+    auto iter = visited.find(ctx);
+    if (iter != visited.end())
+        return iter->second;
+
+    int64_t result = INT64_MIN;
+    for (size_t i = 0; i < ctx->notifyCtxList.size() && result != noDeadline; i++)
+        result = std::max(result, getAbortDeadline(ctx->notifyCtxList[i].get(), visited));
+    visited[ctx] = result;
+    return result;
+}
+
+int VSThreadPool::cancelRequests(VSFrameDoneCallback frameDone, void *userData) {
+    std::lock_guard<std::mutex> l(taskLock);
+    int numCanceled = 0;
+    for (VSFrameContext *ctx = externalContexts; ctx; ctx = ctx->nextExternal) {
+        if (ctx->frameDone == frameDone && ctx->userData == userData && !ctx->canceled) {
+            ctx->canceled = true;
+            numCanceled++;
+        }
+    }
+
+    if (numCanceled) {
+        std::unordered_map<VSFrameContext *, bool> visited;
+        allContexts.forEach([this, &visited](const PVSFrameContext &ctx) {
+            if (isCanceled(ctx.get(), visited))
+                ctx->canceled = true;
+        });
+
+        // nothing waits for prefetches so they're dropped as well
+        while (!prefetchHeld.empty())
+            dropHeldPrefetch(prefetchHeld.size() - 1);
+    }
+
+    return numCanceled;
+}
+
+static void addPrefetchSources(VSNode *node, std::set<VSNode *> &visited, std::vector<VSNode *> &sources) {
+    const VSFilterDependency *deps = node->getDependencies();
+    for (size_t i = 0; i < node->getNumDependencies(); i++) {
+        // only frame n is requested through a strict spatial dependency so the next frames are known in advance, other
+        // patterns say nothing about how far ahead or behind frames are requested
+        if (deps[i].requestPattern != rpStrictSpatial || !visited.insert(deps[i].source).second)
+            continue;
+        VSNode *source = deps[i].source;
+        int filterMode = source->getFilterMode();
+        if (filterMode == fmUnordered || filterMode == fmFrameState)
+            sources.push_back(source);
+        else
+            addPrefetchSources(source, visited, sources);
+    }
+}
+
+const std::vector<VSNode *> &VSThreadPool::getPrefetchSources(VSNode *node) {
+    if (!node->prefetchSourcesValid) {
+        std::set<VSNode *> visited;
+        addPrefetchSources(node, visited, node->prefetchSources);
+        node->prefetchSourcesValid = true;
+    }
+    return node->prefetchSources;
+}
+
+bool VSThreadPool::issuePrefetch() {
+    if (!externalContexts)
+        return false;
+
+    // prefetched frames can't be freed by the caches so a quarter of the limit is always left for everything else
+    size_t limit = core->memory->getLimit();
+    if (core->memory->memoryUse() >= limit - limit / 4) {
+        while (!prefetchHeld.empty())
+            dropHeldPrefetch(0);
+        return false;
+    }
+
+    // the furthest frame requested from each output node
+    std::vector<std::pair<VSNode *, int>> furthest;
+    for (VSFrameContext *ctx = externalContexts; ctx; ctx = ctx->nextExternal) {
+        if (ctx->canceled)
+            continue;
+        auto iter = std::find_if(furthest.begin(), furthest.end(), [ctx](const std::pair<VSNode *, int> &v) { return v.first == ctx->key.first; });
+        if (iter == furthest.end())
+            furthest.push_back(std::make_pair(ctx->key.first, ctx->key.second));
+        else
+            iter->second = std::max(iter->second, ctx->key.second);
+    }
+
+    // held frames outside the window around the current position of their output node won't be requested anymore,
+    // the window doesn't move for sources that currently have no outstanding requests
+    int lookahead = static_cast<int>(maxThreads);
+    for (size_t i = prefetchHeld.size(); i > 0; i--) {
+        const NodeOutputKey &key = prefetchHeld[i - 1]->key;
+        for (const auto &output : furthest) {
+            const std::vector<VSNode *> &sources = getPrefetchSources(output.first);
+            if (std::find(sources.begin(), sources.end(), key.first) != sources.end() && (key.second < output.second - lookahead || key.second > output.second + lookahead)) {
+                dropHeldPrefetch(i - 1);
+                break;
+            }
+        }
+    }
+
+    if (numPrefetching >= 2 * maxThreads)
+        return false;
+
+    for (const auto &output : furthest) {
+        for (VSNode *source : getPrefetchSources(output.first)) {
+            int numFrames = (source->getNodeType() == mtVideo) ? source->getVideoInfo().numFrames : source->getAudioInfo().numFrames;
+            for (int n = output.second + 1; n <= output.second + lookahead && n < numFrames; n++) {
+                NodeOutputKey key(source, n);
+                if (allContexts.find(key) || source->isCachedInternal(n))
+                    continue;
+
+                PVSFrameContext ctx = VSFrameContext::createPrefetch(key, ++reqCounter);
+                allContexts.insert(key, ctx);
+                ++numPrefetching;
+                ++source->numPrefetches;
+                if (core->tracer)
+                    core->tracer->add('i', "prefetch", source->name, core->tracer->now(), 0, 0, n);
+                queueTask(ctx);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void VSThreadPool::endPrefetch(VSFrameContext *ctx) {
+    if (ctx->prefetch) {
+        ctx->prefetch = false;
+        --numPrefetching;
+        --ctx->key.first->numPrefetches;
+        prefetchDone.notify_all();
+        // a dedicated thread with a full queue can work ahead again
+        if (ctx->key.first->dedicatedQueueSize > 0)
+            dedicatedWork.notify_all();
+    }
+}
+
+void VSThreadPool::dropHeldPrefetch(size_t index) {
+    PVSFrameContext ctx = prefetchHeld[index];
+    prefetchHeld.erase(prefetchHeld.begin() + index);
+    allContexts.erase(ctx->key, ctx.get());
+    ctx->prefetchedFrame.reset();
+    endPrefetch(ctx.get());
+}
+
+void VSThreadPool::forgetPrefetches(VSNode *node) {
+    std::unique_lock<std::mutex> l(taskLock);
+    // the held frames of other nodes are dropped as well since canceling below would make them unusable
+    while (!prefetchHeld.empty())
+        dropHeldPrefetch(prefetchHeld.size() - 1);
+
+    if (node->numPrefetches == 0)
+        return;
+
+    // the node has no consumers left so its remaining prefetches and everything only they wait for are canceled,
+    // this also cancels the prefetches of other nodes that nothing has asked for yet
+    std::unordered_map<VSFrameContext *, bool> visited;
+    allContexts.forEach([this, &visited](const PVSFrameContext &ctx) {
+        if (isCanceled(ctx.get(), visited))
+            ctx->canceled = true;
+    });
+
+    // a worker thread destroying the node lets another thread take its place while waiting
+    bool worker = allThreads.count(std::this_thread::get_id()) > 0;
+    if (worker)
+        releaseThread();
+    wakeThread();
+    prefetchDone.wait(l, [node] { return node->numPrefetches == 0; });
+    l.unlock();
+    if (worker)
+        reserveThread();
+}
+
+void VSThreadPool::noteRequest(const NodeOutputKey &key) {
+    VSNode *node = key.first;
+    if (node->dedicatedQueueSize > 0 && node->dedicatedNext != key.second + 1) {
+        node->dedicatedNext = key.second + 1;
+        dedicatedWork.notify_all();
+    }
+}
+
+bool VSThreadPool::findDedicatedTask(VSNode *node, PVSFrameContext &frameContext, PVSFrame &cachedFrame, bool &useSerialLock) {
+    std::set<VSNode *> seenNodes;
+    int pressure = memoryPressure();
+
+    // the contexts are in the order they should be processed in so prefetches come after everything that has actually been requested
+    auto search = [&](TaskSet &taskSet) {
+        for (auto iter = taskSet.begin(); iter != taskSet.end(); ++iter) {
+            VSFrameContext *ctx = iter->get();
+            if (ctx->key.first != node)
+                continue;
+
+            if (ctx->prefetchedFrame) {
+                frameContext = *iter;
+                cachedFrame = std::move(ctx->prefetchedFrame);
+                eraseTask(taskSet, iter);
+                return true;
+            }
+
+            if (node->cacheEnabled) {
+                PVSFrame f = node->getCachedFrameInternal(ctx->key.second);
+
+                if (f) {
+                    frameContext = *iter;
+                    eraseTask(taskSet, iter);
+                    cachedFrame = std::move(f);
+                    return true;
+                }
+            }
+
+            if (ctx->first && deferStart(ctx, pressure))
+                continue;
+
+            // an fmFrameState filter may still be waiting for the frames requested for another frame
+            if (!tryLockNode(ctx, seenNodes, useSerialLock))
+                continue;
+
+            frameContext = *iter;
+            eraseTask(taskSet, iter);
+            return true;
+        }
+        return false;
+    };
+
+    if (!workStealing)
+        return search(tasks);
+
+    for (auto &q : queues) {
+        std::lock_guard<std::mutex> l(q.lock);
+        if (search(q.tasks))
+            return true;
+    }
+
+    return false;
+}
+
+bool VSThreadPool::prefetchDedicated(VSNode *node) {
+    int queueSize = node->dedicatedQueueSize;
+    int first = node->dedicatedNext;
+
+    // held frames outside the window around the last request won't be asked for anymore
+    for (size_t i = prefetchHeld.size(); i > 0; i--) {
+        const NodeOutputKey &key = prefetchHeld[i - 1]->key;
+        if (key.first == node && (key.second < first - queueSize || key.second >= first + queueSize))
+            dropHeldPrefetch(i - 1);
+    }
+
+    // prefetched frames can't be freed by the caches so a quarter of the limit is always left for everything else
+    size_t limit = core->memory->getLimit();
+    if (node->numPrefetches >= queueSize || core->memory->memoryUse() >= limit - limit / 4)
+        return false;
+
+    int numFrames = (node->getNodeType() == mtVideo) ? node->getVideoInfo().numFrames : node->getAudioInfo().numFrames;
+    for (int n = first; n < first + queueSize && n < numFrames; n++) {
+        NodeOutputKey key(node, n);
+        if (allContexts.find(key) || node->isCachedInternal(n))
+            continue;
+
+        PVSFrameContext ctx = VSFrameContext::createPrefetch(key, ++reqCounter);
+        allContexts.insert(key, ctx);
+        ++numPrefetching;
+        ++node->numPrefetches;
+        if (core->tracer)
+            core->tracer->add('i', "prefetch", node->name, core->tracer->now(), 0, 0, n);
+        queueTask(ctx);
+        return true;
+    }
+
+    return false;
+}
+
+void VSThreadPool::runDedicated(std::shared_ptr<DedicatedThread> thread) {
+    dedicatedNode = thread->node;
+    if (core->tracer)
+        core->tracer->nameThread("dedicated");
+
+    std::unique_lock<std::mutex> lock(taskLock);
+
+    while (!thread->stop) {
+        PVSFrameContext frameContext;
+        PVSFrame cachedFrame;
+        bool useSerialLock = false;
+
+        if (findDedicatedTask(thread->node, frameContext, cachedFrame, useSerialLock)) {
+            if (cachedFrame) {
+                returnCachedFrame(frameContext, cachedFrame);
+            } else {
+                ++runningTasks;
+                lock.unlock();
+                runTask(frameContext, useSerialLock, lock);
+                --runningTasks;
+            }
+        } else if (!prefetchDedicated(thread->node)) {
+            dedicatedWork.wait(lock);
+        }
+    }
+}
+
+void VSThreadPool::setDedicatedThread(VSNode *node, int queueSize) {
+    std::shared_ptr<DedicatedThread> stopped;
+
+    {
+        std::lock_guard<std::mutex> l(taskLock);
+        auto iter = std::find_if(dedicatedThreads.begin(), dedicatedThreads.end(), [node](const std::shared_ptr<DedicatedThread> &t) { return t->node == node; });
+        node->dedicatedQueueSize = queueSize;
+
+        if (queueSize > 0 && iter == dedicatedThreads.end()) {
+            std::shared_ptr<DedicatedThread> thread = std::make_shared<DedicatedThread>();
+            thread->node = node;
+            thread->thread = std::thread(&VSThreadPool::runDedicated, this, thread);
+            dedicatedThreads.push_back(thread);
+        } else if (queueSize == 0 && iter != dedicatedThreads.end()) {
+            stopped = *iter;
+            stopped->stop = true;
+            dedicatedThreads.erase(iter);
+            // the workers take over whatever is still queued
+            wakeThread();
+        }
+
+        dedicatedWork.notify_all();
+    }
+
+    if (stopped) {
+        if (stopped->thread.get_id() == std::this_thread::get_id())
+            stopped->thread.detach();
+        else
+            stopped->thread.join();
+    }
+}
+
 bool VSThreadPool::isWorkerThread() {
     std::lock_guard<std::mutex> m(taskLock);
     return allThreads.count(std::this_thread::get_id()) > 0;
 }
 
+size_t VSThreadPool::countQueuedTasks() {
+    size_t queued = 0;
+    if (workStealing) {
+        for (auto &iter : queues) {
+            std::lock_guard<std::mutex> l(iter.lock);
+            queued += iter.tasks.size();
+        }
+    } else {
+        queued = tasks.size();
+    }
+    return queued;
+}
+
+void VSThreadPool::getStatistics(VSMap *stats) {
+    vs_internal_vsapi.mapSetInt(stats, "schedulingTime", schedulingTime, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "filterTime", filterTime, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "activeThreads", activeThreads, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "idleThreads", idleThreads, maReplace);
+
+    size_t queued;
+    if (workStealing) {
+        queued = countQueuedTasks();
+    } else {
+        std::lock_guard<std::mutex> l(taskLock);
+        queued = countQueuedTasks();
+    }
+    vs_internal_vsapi.mapSetInt(stats, "queuedTasks", queued, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "deferredStarts", deferredStarts, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "watchdogReports", watchdogReports, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheAdjustments", cacheAdjustments, maReplace);
+    vs_internal_vsapi.mapSetInt(stats, "cacheAdjustmentTime", cacheAdjustmentTime, maReplace);
+}
+
+void VSThreadPool::setWatchdog(int64_t threshold) {
+    std::lock_guard<std::mutex> control(watchdogControl);
+    {
+        std::lock_guard<std::mutex> l(watchdogLock);
+        watchdogThreshold = std::max<int64_t>(threshold, 0) * 1000000;
+    }
+    watchdogWake.notify_all();
+
+    if (watchdogThreshold && !watchdogThread.joinable()) {
+        watchdogThread = std::thread(&VSThreadPool::runWatchdog, this);
+    } else if (!watchdogThreshold && watchdogThread.joinable()) {
+        watchdogThread.join();
+        watchdogSeen.clear();
+        idleStallSince = 0;
+    }
+}
+
+void VSThreadPool::runMaintenance() {
+    size_t lastTick = 0;
+    std::unique_lock<std::mutex> l(maintenanceLock);
+    while (!stopMaintenance) {
+        // the timer catches memory that went over the limit without any new requests and wakeups that were missed
+        maintenanceWake.wait_for(l, std::chrono::milliseconds(100));
+        if (stopMaintenance)
+            break;
+        l.unlock();
+        bool needMemory = cachePressure.exchange(false, std::memory_order_relaxed) || core->memory->isOverLimit();
+        size_t currentTick = ticks;
+        if (needMemory || currentTick - lastTick >= 500) {
+            lastTick = currentTick;
+            int64_t start = steadyNanoseconds();
+            core->notifyCaches(needMemory);
+            cacheAdjustmentTime.fetch_add(steadyNanoseconds() - start, std::memory_order_relaxed);
+            ++cacheAdjustments;
+        }
+        l.lock();
+    }
+}
+
+void VSThreadPool::runWatchdog() {
+    std::unique_lock<std::mutex> l(watchdogLock);
+    while (int64_t threshold = watchdogThreshold) {
+        // checking four times per threshold keeps the reports at most a quarter late
+        watchdogWake.wait_for(l, std::chrono::nanoseconds(std::max<int64_t>(threshold / 4, 10000000)));
+        if (!watchdogThreshold)
+            break;
+        l.unlock();
+        checkStalls(watchdogThreshold);
+        l.lock();
+    }
+}
+
+void VSThreadPool::checkStalls(int64_t threshold) {
+    std::vector<std::string> reports;
+    {
+        std::lock_guard<std::mutex> l(taskLock);
+        int64_t now = steadyNanoseconds();
+
+        // contexts are recycled so an entry only carries over when the address still belongs to the same frame
+        std::unordered_map<VSFrameContext *, WatchdogEntry> seen;
+        allContexts.forEach([&](const PVSFrameContext &ctx) {
+            auto iter = watchdogSeen.find(ctx.get());
+            WatchdogEntry entry = (iter != watchdogSeen.end() && iter->second.key == ctx->key) ? iter->second : WatchdogEntry{ ctx->key, now, false };
+            if (!entry.reported && now - entry.firstSeen >= threshold) {
+                entry.reported = true;
+                std::string report = "frame " + std::to_string(ctx->key.second) + " of " + ctx->key.first->getName() + " has been in progress for " + std::to_string((now - entry.firstSeen) / 1000000) + " ms and is ";
+                int64_t running = ctx->runningSince.load(std::memory_order_relaxed);
+                if (running)
+                    report += "running in the filter for " + std::to_string((now - running) / 1000000) + " ms";
+                else if (ctx->queueIndex >= 0 && ctx->lockWaitStart)
+                    report += "queued and has waited " + std::to_string((now - ctx->lockWaitStart) / 1000000) + " ms for the serial lock of the filter";
+                else if (ctx->queueIndex >= 0)
+                    report += "queued";
+                else if (ctx->numFrameRequests)
+                    report += "waiting for " + std::to_string(ctx->numFrameRequests) + " requested frames";
+                else
+                    report += "waiting";
+                reports.push_back(report);
+            }
+            seen.insert(std::make_pair(ctx.get(), entry));
+        });
+        watchdogSeen.swap(seen);
+
+        // nothing can make progress when every worker sleeps while requests are queued
+        size_t queued = countQueuedTasks();
+        if (queued && !allThreads.empty() && idleThreads == allThreads.size()) {
+            if (!idleStallSince)
+                idleStallSince = now;
+            if (idleStallSince > 0 && now - idleStallSince >= threshold) {
+                reports.push_back("all " + std::to_string(allThreads.size()) + " worker threads have been idle for " + std::to_string((now - idleStallSince) / 1000000) + " ms while " + std::to_string(queued) + " frame requests are queued");
+                idleStallSince = -1;
+            }
+        } else {
+            idleStallSince = 0;
+        }
+    }
+
+    for (const auto &iter : reports) {
+        ++watchdogReports;
+        core->logMessage(mtWarning, "Watchdog: " + iter);
+    }
+}
+
 void VSThreadPool::waitForDone() {
     std::unique_lock<std::mutex> m(taskLock);
     if (idleThreads < allThreads.size())
@@ -388,6 +2299,36 @@ void VSThreadPool::waitForDone() {
 }
 
 VSThreadPool::~VSThreadPool() {
+    setWatchdog(0);
+
+    {
+        std::lock_guard<std::mutex> l(maintenanceLock);
+        stopMaintenance = true;
+    }
+    maintenanceWake.notify_all();
+    maintenanceThread.join();
+
+    {
+        std::lock_guard<std::mutex> l(ioLock);
+        ioStop = true;
+    }
+    ioWork.notify_all();
+    for (auto &iter : ioThreads)
+        iter.join();
+    // nothing can wait for the frames anymore
+    for (auto &iter : ioJobs)
+        delete iter.request;
+
+    {
+        std::lock_guard<std::mutex> l(taskLock);
+        for (auto &iter : dedicatedThreads)
+            iter->stop = true;
+        dedicatedWork.notify_all();
+    }
+    for (auto &iter : dedicatedThreads)
+        iter->thread.join();
+    dedicatedThreads.clear();
+
     std::unique_lock<std::mutex> m(taskLock);
     stopThreads = true;
 
@@ -405,4 +2346,10 @@ VSThreadPool::~VSThreadPool() {
 
     assert(activeThreads == 0);
     assert(idleThreads == 0);
+
+    VSSharedThreadPool *shared = sharedPool;
+    if (shared) {
+        shared->detach(this);
+        shared->release();
+    }
 };
@@ -19,7 +19,7 @@
 #
 #cython: language_level=3
 
-from libc.stdint cimport uint8_t, uint32_t, int64_t, uint64_t, uintptr_t
+from libc.stdint cimport uint8_t, uint32_t, int64_t, uint64_t, intptr_t, uintptr_t
 from libc.stddef cimport ptrdiff_t
 
 cdef extern from "include/VapourSynth4.h" nogil:
@@ -46,6 +46,8 @@ cdef extern from "include/VapourSynth4.h" nogil:
         pass
     ctypedef struct VSFrameContext:
         pass
+    ctypedef struct VSSharedThreadPool:
+        pass
         
     cpdef enum MediaType "VSMediaType":
         VIDEO "mtVideo"
@@ -212,6 +214,7 @@ cdef extern from "include/VapourSynth4.h" nogil:
     enum VSActivationReason:
         arInitial
         arAllFramesReady
+        arFrameReady
         arError
 
     cpdef enum MessageType "VSMessageType":
@@ -225,6 +228,28 @@ cdef extern from "include/VapourSynth4.h" nogil:
         ccfEnableGraphInspection
         ccfDisableAutoLoading
         ccfDisableLibraryUnloading
+        ccfEnableWorkStealing
+        ccfCostAwareEviction
+        ccfEnableHugePages
+        ccfNUMALocalFrames
+        ccfPinWorkerThreads
+        ccfFusePointwiseFilters
+        ccfMergeIdenticalFilters
+        ccfEnableTracing
+        ccfLazyPluginLoading
+        ccfAutoTuneThreads
+        ccfLookaheadPrefetch
+        ccfDeduplicateFrames
+        ccfCompressEvictedFrames
+        ccfFuseResizeChains
+        ccfAsyncLogging
+        ccfFuseSpatialFilters
+        ccfPadStrides
+        ccfPreferPerformanceCores
+        ccfOneThreadPerCore
+        ccfWriteJITSymbols
+        ccfFrameProcessingTime
+        ccfLiveMode
 
     enum VSPluginConfigFlags:
         pcModifiable
@@ -234,6 +259,10 @@ cdef extern from "include/VapourSynth4.h" nogil:
         dtBinary
         dtUtf8
 
+    enum VSVideoOutputFlags:
+        vofY4M
+        vofGBROrder
+
 
     ctypedef const VSAPI *(__stdcall *VSGetVapourSynthAPI)(int version)
 
@@ -247,6 +276,8 @@ cdef extern from "include/VapourSynth4.h" nogil:
     ctypedef void (__stdcall *VSFrameDoneCallback)(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg)
     ctypedef void (__stdcall *VSLogHandler)(int msgType, const char *msg, void *userData)
     ctypedef void (__stdcall *VSLogHandlerFree)(void *userData)
+    ctypedef void (__stdcall *VSFreeFrameBuffer)(void *userData)
+    ctypedef int (__stdcall *VSOutputProgressCallback)(void *userData, int written, int total)
 
     ctypedef struct VSPLUGINAPI:
         int getAPIVersion() nogil
@@ -386,5 +417,24 @@ cdef extern from "include/VapourSynth4.h" nogil:
         void logMessage(int msgType, const char *msg, VSCore *core) nogil
         VSLogHandle *addLogHandler(VSLogHandler handler, VSLogHandlerFree free, void *userData, VSCore *core) nogil
         bint removeLogHandler(VSLogHandle *handle, VSCore *core) nogil
+
+        # Frames from external memory
+        VSFrame *newVideoFrameFromBuffers(const VSVideoFormat *format, int width, int height, uint8_t * const *planes, const ptrdiff_t *strides, int writable, VSFreeFrameBuffer free, void *userData, const VSFrame *propSrc, VSCore *core) nogil
+        void getFramesAsync(int start, int count, int step, VSNode *node, VSFrameDoneCallback callback, void *userData) nogil
+        int cancelFrameRequests(VSFrameDoneCallback callback, void *userData, VSCore *core) nogil
+        void getFrameAsyncPriority(int n, VSNode *node, int priority, VSFrameDoneCallback callback, void *userData) nogil
+        VSSharedThreadPool *createSharedThreadPool(int threads) nogil
+        void freeSharedThreadPool(VSSharedThreadPool *pool) nogil
+        int attachSharedThreadPool(VSSharedThreadPool *pool, int weight, VSCore *core) nogil
+        void setNodeConcurrency(VSNode *node, int maxConcurrency, int64_t frameScratchSize, int64_t maxScratchSize) nogil
+        int setAudioFrameSamples(int samples, VSCore *core) nogil
+        int getAudioFrameSamples(VSCore *core) nogil
+        int64_t setMemoryHardLimit(int64_t bytes, VSCore *core) nogil
+        void setNodeDedicatedThread(VSNode *node, int queueSize) nogil
+        int recordFrameRequests(const char *filename, VSCore *core) nogil
+        void setNodeOutputIndex(VSNode *node, int index, int alpha) nogil
+        int saveCacheSizes(const char *filename, VSCore *core) nogil
+        int loadCacheSizes(const char *filename, VSCore *core) nogil
+        int outputVideoNode(VSNode *node, intptr_t file, int flags, int prefetch, VSOutputProgressCallback progress, void *userData, char *errorMsg, int bufSize) nogil
                 
     const VSAPI *getVapourSynthAPI(int version) nogil
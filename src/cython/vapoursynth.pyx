@@ -24,9 +24,12 @@ from vsscript_internal cimport VSScript
 cimport cython.parallel
 from cython cimport view, final
 from libc.stdint cimport intptr_t, int16_t, uint16_t, int32_t, uint32_t
+from libc.stdlib cimport malloc, free
 from cpython.buffer cimport (PyBUF_WRITABLE, PyBUF_FORMAT, PyBUF_STRIDES,
-                             PyBUF_F_CONTIGUOUS)
+                             PyBUF_F_CONTIGUOUS, PyBUF_C_CONTIGUOUS, PyObject_GetBuffer, PyBuffer_Release)
+from cpython.pycapsule cimport PyCapsule_New, PyCapsule_IsValid, PyCapsule_GetPointer, PyCapsule_Destructor
 from cpython.ref cimport Py_INCREF, Py_DECREF
+from libc.string cimport memcpy, strlen
 import os
 import ctypes
 import threading
@@ -609,6 +612,7 @@ cdef FuncData createFuncData(object func, VSCore *core, EnvironmentData env):
 cdef class Func(object):
     cdef const VSAPI *funcs
     cdef VSFunction *ref
+    cdef object __weakref__
     
     def __init__(self):
         raise Error('Class cannot be instantiated directly')
@@ -636,17 +640,27 @@ cdef class Func(object):
             vsapi.freeMap(outm)
             vsapi.freeMap(inm)
         
-cdef Func createFuncPython(object func, VSCore *core, const VSAPI *funcs):
-    cdef Func instance = Func.__new__(Func)
-    instance.funcs = funcs
+# Passing the same callable again reuses its wrapper so filters can recognize it by identity,
+# the wrapper keeps the callable and environment alive so their ids can't be reused while it exists
+_python_funcs = weakref.WeakValueDictionary()
 
+cdef Func createFuncPython(object func, VSCore *core, const VSAPI *funcs):
     cdef EnvironmentData env = _env_current()
     if env is None:
         raise Error('Internal environment id not set. Did the environment die?')
+
+    key = (id(func), id(env), <intptr_t>core)
+    cdef Func instance = _python_funcs.get(key)
+    if instance is not None:
+        return instance
+
+    instance = Func.__new__(Func)
+    instance.funcs = funcs
     fdata = createFuncData(func, core, env)
 
     Py_INCREF(fdata)
     instance.ref = instance.funcs.createFunction(publicFunction, <void *>fdata, freeFunc, core)
+    _python_funcs[key] = instance
     return instance
         
 cdef Func createFuncRef(VSFunction *ref, const VSAPI *funcs):
@@ -747,6 +761,155 @@ cdef void __stdcall frameDoneCallback(void *data, const VSFrame *f, int n, VSNod
         finally:
             Py_DECREF(d)
 
+cdef object createNodeFrame(RawNode node, const VSFrame *f):
+    if isinstance(node, VideoNode):
+        return createConstFrame(f, node.funcs, node.core.core)
+    return createConstAudioFrame(f, node.funcs, node.core.core)
+
+
+cdef class AsyncioCallbackData(object):
+    cdef RawNode node
+    cdef object future
+    cdef object loop
+
+def _set_future_result(future, result):
+    if not future.done():
+        future.set_result(result)
+
+def _set_future_exception(future, exception):
+    if not future.done():
+        future.set_exception(exception)
+
+# Goes straight to the event loop instead of through CallbackData and the environment of the caller
+cdef void __stdcall asyncioFrameDoneCallback(void *data, const VSFrame *f, int n, VSNode *node, const char *errormsg) nogil:
+    with gil:
+        d = <AsyncioCallbackData>data
+        try:
+            if f == NULL:
+                result = 'Internal error - no error message.'
+                if errormsg != NULL:
+                    result = errormsg.decode('utf-8')
+                d.loop.call_soon_threadsafe(_set_future_exception, d.future, Error(result))
+            else:
+                d.loop.call_soon_threadsafe(_set_future_result, d.future, createNodeFrame(d.node, f))
+        except:
+            import traceback
+            traceback.print_exc()
+        finally:
+            Py_DECREF(d)
+
+
+cdef extern from "pythread.h" nogil:
+    ctypedef void *PyThread_type_lock
+    PyThread_type_lock PyThread_allocate_lock()
+    void PyThread_free_lock(PyThread_type_lock lock)
+    int PyThread_acquire_lock(PyThread_type_lock lock, int waitflag)
+    void PyThread_release_lock(PyThread_type_lock lock)
+
+# Shared between frames_batched() and the frame callbacks which never take the GIL,
+# results are kept in a ring indexed by frame number until they're consumed
+cdef struct FrameBatchState:
+    PyThread_type_lock mutex
+    PyThread_type_lock signal # held by the consumer and released by a callback to wake it up
+    int wait_for # frame the consumer is waiting for, -1 for none and -2 for all outstanding requests
+    int outstanding
+    int capacity
+    const VSFrame **frames
+    char **errors
+    bint *done
+
+cdef void __stdcall batchFrameDoneCallback(void *data, const VSFrame *f, int n, VSNode *node, const char *errormsg) nogil:
+    cdef FrameBatchState *state = <FrameBatchState *>data
+    cdef int slot = n % state.capacity
+    cdef size_t length
+    cdef char *error = NULL
+    if f == NULL:
+        if errormsg == NULL:
+            errormsg = b'Internal error - no error message.'
+        length = strlen(errormsg) + 1
+        error = <char *>malloc(length)
+        if error != NULL:
+            memcpy(error, errormsg, length)
+
+    PyThread_acquire_lock(state.mutex, 1)
+    state.frames[slot] = f
+    state.errors[slot] = error
+    state.done[slot] = True
+    state.outstanding -= 1
+    if state.wait_for == n or (state.wait_for == -2 and state.outstanding == 0):
+        state.wait_for = -1
+        PyThread_release_lock(state.signal)
+    PyThread_release_lock(state.mutex)
+
+# Shared between read_frames() and the callbacks that copy the frames into the destination buffer
+cdef struct FrameCopyState:
+    PyThread_type_lock mutex
+    PyThread_type_lock signal # held by read_frames() and released by a callback when it waits for a request to finish
+    bint waiting
+    bint failed
+    int outstanding
+    int start
+    const VSAPI *funcs
+    uint8_t *dst
+    size_t frame_size
+    size_t plane_size
+    size_t row_size
+    int height
+    int num_planes
+    int planes[3]
+    char *error
+
+cdef void __stdcall copyFrameDoneCallback(void *data, const VSFrame *f, int n, VSNode *node, const char *errormsg) nogil:
+    cdef FrameCopyState *state = <FrameCopyState *>data
+    cdef uint8_t *dst
+    cdef const uint8_t *src
+    cdef ptrdiff_t stride
+    cdef int i
+    cdef int y
+    cdef size_t length
+    cdef char *error = NULL
+    if f == NULL:
+        if errormsg == NULL:
+            errormsg = b'Internal error - no error message.'
+        length = strlen(errormsg) + 1
+        error = <char *>malloc(length)
+        if error != NULL:
+            memcpy(error, errormsg, length)
+    else:
+        # every frame has its own part of the destination so the worker threads copy them in parallel
+        dst = state.dst + <size_t>(n - state.start) * state.frame_size
+        for i in range(state.num_planes):
+            src = state.funcs.getReadPtr(f, state.planes[i])
+            stride = state.funcs.getStride(f, state.planes[i])
+            for y in range(state.height):
+                memcpy(dst + y * state.row_size, src + y * stride, state.row_size)
+            dst += state.plane_size
+        state.funcs.freeFrame(f)
+
+    PyThread_acquire_lock(state.mutex, 1)
+    if f == NULL:
+        if not state.failed:
+            state.failed = True
+            state.error = error
+        else:
+            free(error)
+    state.outstanding -= 1
+    if state.waiting:
+        state.waiting = False
+        PyThread_release_lock(state.signal)
+    PyThread_release_lock(state.mutex)
+
+# userData is a list of the progress function and the exception it raised, if any
+cdef int __stdcall outputProgressCallback(void *userData, int written, int total) noexcept nogil:
+    with gil:
+        state = <list>userData
+        try:
+            state[0](written, total)
+            return 1
+        except BaseException as e:
+            state[1] = e
+            return 0
+
 cdef object mapToDict(const VSMap *map, bint flatten, VSCore *core, const VSAPI *funcs):
     cdef int numKeys = funcs.mapNumKeys(map)
     retdict = {}
@@ -837,67 +1000,156 @@ cdef void dictToMap(dict ndict, VSMap *inm, bint simpleTypesOnly, VSCore *core,
                 raise Error('argument ' + key + ' was passed an unsupported type (' + type(v).__name__ + ')')
 
 
-cdef void typedDictToMap(dict ndict, dict atypes, VSMap *inm, VSCore *core, const VSAPI *funcs) except *:
-    for key in ndict:
-        ckey = key.encode('utf-8')
-        val = ndict[key]
-        if val is None:
-            continue
+# The argument types a plugin function signature can contain
+cdef enum:
+    argVideoNode
+    argAudioNode
+    argVideoFrame
+    argAudioFrame
+    argFunction
+    argInt
+    argFloat
+    argData
+    argUnknown
+
+cdef int argTypeFromString(str atype):
+    if atype[:5] == 'vnode':
+        return argVideoNode
+    elif atype[:5] == 'anode':
+        return argAudioNode
+    elif atype[:6] == 'vframe':
+        return argVideoFrame
+    elif atype[:6] == 'aframe':
+        return argAudioFrame
+    elif atype[:4] == 'func':
+        return argFunction
+    elif atype[:3] == 'int':
+        return argInt
+    elif atype[:5] == 'float':
+        return argFloat
+    elif atype[:4] == 'data':
+        return argData
+    else:
+        return argUnknown
 
-        if isinstance(val, (str, bytes, bytearray, VideoNode)) or not isinstance(val, Iterable):
-            val = [val]
+# The arguments of a plugin function parsed once from its signature, calls only look them up by name or position.
+# Bindings are cached per core since plugin functions live as long as it does.
+@final
+cdef class FunctionBinding(object):
+    cdef str name
+    cdef bytes cname
+    cdef str signature
+    cdef str return_signature
+    cdef list keys
+    cdef list ckeys
+    cdef list typenames
+    cdef list types
+    cdef dict positions
+    cdef bint any
+
+cdef FunctionBinding createFunctionBinding(const VSPluginFunction *func, const VSAPI *funcs):
+    cdef FunctionBinding binding = FunctionBinding.__new__(FunctionBinding)
+    binding.cname = funcs.getPluginFunctionName(func)
+    binding.name = binding.cname.decode('utf-8')
+    binding.signature = funcs.getPluginFunctionArguments(func).decode('utf-8')
+    binding.return_signature = funcs.getPluginFunctionReturnType(func).decode('utf-8')
+    binding.keys = []
+    binding.ckeys = []
+    binding.typenames = []
+    binding.types = []
+    binding.positions = {}
+    binding.any = False
+
+    for sig in binding.signature.split(';'):
+        if sig == 'any':
+            binding.any = True
+            continue
+        elif sig == '':
+            continue
+        parts = sig.split(':')
+        binding.positions[parts[0]] = len(binding.keys)
+        binding.keys.append(parts[0])
+        binding.ckeys.append(parts[0].encode('utf-8'))
+        binding.typenames.append(parts[1])
+        binding.types.append(argTypeFromString(parts[1]))
+
+    return binding
+
+cdef void typedValueToMap(FunctionBinding binding, Py_ssize_t index, object val, VSMap *inm, VSCore *core, const VSAPI *funcs) except *:
+    cdef str key = binding.keys[index]
+    cdef bytes ckey = binding.ckeys[index]
+    cdef int atype = binding.types[index]
+    cdef type vtype = type(val)
+
+    # single ints, floats, strings and clips make up almost all arguments so they skip the generic conversion
+    if atype == argInt and vtype is int:
+        funcs.mapSetInt(inm, ckey, val, 1)
+        return
+    elif atype == argFloat and (vtype is float or vtype is int):
+        funcs.mapSetFloat(inm, ckey, val, 1)
+        return
+    elif (atype == argVideoNode and vtype is VideoNode) or (atype == argAudioNode and vtype is AudioNode):
+        funcs.mapSetNode(inm, ckey, (<RawNode>val).node, 1)
+        return
+    elif atype == argData and vtype is str:
+        s = (<str>val).encode('utf-8')
+        funcs.mapSetData(inm, ckey, s, <int>len(s), dtUtf8, 1)
+        return
 
-        for v in val:
-            if (atypes[key][:5] == 'vnode' and isinstance(v, VideoNode)) or (atypes[key][:5] == 'anode' and isinstance(v, AudioNode)):
-                if funcs.mapSetNode(inm, ckey, (<RawNode>v).node, 1) != 0:
-                    raise Error('not all values are of the same type in ' + key)
-            elif ((atypes[key][:6] == 'vframe') and isinstance(v, VideoFrame)) or (atypes[key][:6] == 'aframe' and isinstance(v, AudioFrame)):
-                if funcs.mapSetFrame(inm, ckey, (<RawFrame>v).constf, 1) != 0:
-                    raise Error('not all values are of the same type in ' + key)
-            elif atypes[key][:4] == 'func' and isinstance(v, Func):
-                if funcs.mapSetFunction(inm, ckey, (<Func>v).ref, 1) != 0:
-                    raise Error('not all values are of the same type in ' + key)
-            elif atypes[key][:4] == 'func' and callable(v):
-                tf = createFuncPython(v, core, funcs)
-                if funcs.mapSetFunction(inm, ckey, tf.ref, 1) != 0:
-                    raise Error('not all values are of the same type in ' + key)
-            elif atypes[key][:3] == 'int':
-                if funcs.mapSetInt(inm, ckey, int(v), 1) != 0:
-                    raise Error('not all values are of the same type in ' + key)
-            elif atypes[key][:5] == 'float':
-                if funcs.mapSetFloat(inm, ckey, float(v), 1) != 0:
-                    raise Error('not all values are of the same type in ' + key)
-            elif atypes[key][:4] == 'data':
-                if not isinstance(v, (str, bytes, bytearray)):
-                    v = str(v)
-                if isinstance(v, str):
-                    s = v.encode('utf-8')
-                else:
-                    s = v
-                if funcs.mapSetData(inm, ckey, s, <int>len(s), dtUtf8 if isinstance(v, str) else dtBinary, 1) != 0:
-                    raise Error('not all values are of the same type in ' + key)
-            else:
-                raise Error('argument ' + key + ' was passed an unsupported type (expected ' + atypes[key] + ' compatible type but got ' + type(v).__name__ + ')')
-        if len(val) == 0:
-        # set an empty key if it's an empty array
-            if atypes[key][:5] == 'vnode':
-                funcs.mapSetEmpty(inm, ckey, ptVideoNode)
-            elif atypes[key][:5] == 'anode':
-                funcs.mapSetEmpty(inm, ckey, ptAudioNode)     
-            elif atypes[key][:6] == 'vframe':
-                funcs.mapSetEmpty(inm, ckey, ptVideoFrame)
-            elif atypes[key][:6] == 'aframe':
-                funcs.mapSetEmpty(inm, ckey, ptAudioFrame)   
-            elif atypes[key][:4] == 'func':
-                funcs.mapSetEmpty(inm, ckey, ptFunction)
-            elif atypes[key][:3] == 'int':
-                funcs.mapSetEmpty(inm, ckey, ptInt)
-            elif atypes[key][:5] == 'float':
-                funcs.mapSetEmpty(inm, ckey, ptFloat)
-            elif atypes[key][:4] == 'data':
-                funcs.mapSetEmpty(inm, ckey, ptData)
+    if isinstance(val, (str, bytes, bytearray, VideoNode)) or not isinstance(val, Iterable):
+        val = [val]
+
+    for v in val:
+        if (atype == argVideoNode and isinstance(v, VideoNode)) or (atype == argAudioNode and isinstance(v, AudioNode)):
+            if funcs.mapSetNode(inm, ckey, (<RawNode>v).node, 1) != 0:
+                raise Error('not all values are of the same type in ' + key)
+        elif (atype == argVideoFrame and isinstance(v, VideoFrame)) or (atype == argAudioFrame and isinstance(v, AudioFrame)):
+            if funcs.mapSetFrame(inm, ckey, (<RawFrame>v).constf, 1) != 0:
+                raise Error('not all values are of the same type in ' + key)
+        elif atype == argFunction and isinstance(v, Func):
+            if funcs.mapSetFunction(inm, ckey, (<Func>v).ref, 1) != 0:
+                raise Error('not all values are of the same type in ' + key)
+        elif atype == argFunction and callable(v):
+            tf = createFuncPython(v, core, funcs)
+            if funcs.mapSetFunction(inm, ckey, tf.ref, 1) != 0:
+                raise Error('not all values are of the same type in ' + key)
+        elif atype == argInt:
+            if funcs.mapSetInt(inm, ckey, int(v), 1) != 0:
+                raise Error('not all values are of the same type in ' + key)
+        elif atype == argFloat:
+            if funcs.mapSetFloat(inm, ckey, float(v), 1) != 0:
+                raise Error('not all values are of the same type in ' + key)
+        elif atype == argData:
+            if not isinstance(v, (str, bytes, bytearray)):
+                v = str(v)
+            if isinstance(v, str):
+                s = v.encode('utf-8')
             else:
-                raise Error('argument ' + key + ' has an unknown type: ' + atypes[key])
+                s = v
+            if funcs.mapSetData(inm, ckey, s, <int>len(s), dtUtf8 if isinstance(v, str) else dtBinary, 1) != 0:
+                raise Error('not all values are of the same type in ' + key)
+        else:
+            raise Error('argument ' + key + ' was passed an unsupported type (expected ' + binding.typenames[index] + ' compatible type but got ' + type(v).__name__ + ')')
+    if len(val) == 0:
+    # set an empty key if it's an empty array
+        if atype == argVideoNode:
+            funcs.mapSetEmpty(inm, ckey, ptVideoNode)
+        elif atype == argAudioNode:
+            funcs.mapSetEmpty(inm, ckey, ptAudioNode)
+        elif atype == argVideoFrame:
+            funcs.mapSetEmpty(inm, ckey, ptVideoFrame)
+        elif atype == argAudioFrame:
+            funcs.mapSetEmpty(inm, ckey, ptAudioFrame)
+        elif atype == argFunction:
+            funcs.mapSetEmpty(inm, ckey, ptFunction)
+        elif atype == argInt:
+            funcs.mapSetEmpty(inm, ckey, ptInt)
+        elif atype == argFloat:
+            funcs.mapSetEmpty(inm, ckey, ptFloat)
+        elif atype == argData:
+            funcs.mapSetEmpty(inm, ckey, ptData)
+        else:
+            raise Error('argument ' + key + ' has an unknown type: ' + binding.typenames[index])
 
 cdef class VideoFormat(object):
     cdef readonly uint32_t id
@@ -963,6 +1215,136 @@ cdef VideoFormat createVideoFormat(const VSVideoFormat *f, const VSAPI *funcs, V
     instance.id = funcs.queryVideoFormatID(instance.color_family, instance.sample_type, instance.bits_per_sample, instance.subsampling_w, instance.subsampling_h, core)
     return instance
 
+# A read only view of one int, float or data frame property. It holds its own copy of the property map, copying a map
+# only shares the data so creating a view doesn't depend on the size of the array and later changes to the frame's
+# properties don't affect it.
+cdef class PropArray(object):
+    cdef VSMap *map
+    cdef const VSAPI *funcs
+    cdef bytes key
+    cdef int numelem
+    cdef int proptype
+    cdef Py_ssize_t shape[1]
+    cdef Py_ssize_t strides[1]
+
+    def __init__(self):
+        raise Error('Class cannot be instantiated directly')
+
+    def __dealloc__(self):
+        if self.funcs:
+            self.funcs.freeMap(self.map)
+
+    def __len__(self):
+        return self.numelem
+
+    def __getitem__(self, index):
+        cdef Py_ssize_t i
+
+        if isinstance(index, slice):
+            return [self[j] for j in range(*index.indices(self.numelem))]
+
+        i = index
+        if i < 0:
+            i += self.numelem
+        if i < 0 or i >= self.numelem:
+            raise IndexError('Property index out of range')
+
+        if self.proptype == ptInt:
+            return self.funcs.mapGetIntArray(self.map, self.key, NULL)[i]
+        elif self.proptype == ptFloat:
+            return self.funcs.mapGetFloatArray(self.map, self.key, NULL)[i]
+        else:
+            return memoryview(createPropData(self, <int>i))
+
+    def __repr__(self):
+        return f'<vapoursynth.PropArray {self.key.decode("utf-8")} of {self.numelem} elements>'
+
+    def __getbuffer__(self, Py_buffer* view, int flags):
+        if self.proptype == ptData:
+            raise BufferError('Data properties are exported one element at a time')
+        if flags & PyBUF_WRITABLE:
+            raise BufferError('Object is not writable.')
+
+        if self.proptype == ptInt:
+            view.buf = <void *>self.funcs.mapGetIntArray(self.map, self.key, NULL)
+        else:
+            view.buf = <void *>self.funcs.mapGetFloatArray(self.map, self.key, NULL)
+
+        if not flags & PyBUF_FORMAT:
+            view.format = NULL
+        elif self.proptype == ptInt:
+            view.format = b'q'
+        else:
+            view.format = b'd'
+
+        if flags & PyBUF_STRIDES:
+            view.shape = self.shape
+            view.strides = self.strides
+        else:
+            view.shape = NULL
+            view.strides = NULL
+
+        view.obj = self
+        view.len = self.shape[0] * self.strides[0]
+        view.readonly = 1
+        view.itemsize = self.strides[0]
+        view.ndim = 1
+        view.suboffsets = NULL
+        view.internal = NULL
+
+cdef PropArray createPropArray(const VSMap *props, bytes key, int numelem, int proptype, const VSAPI *funcs):
+    cdef PropArray instance = PropArray.__new__(PropArray)
+    instance.map = funcs.createMap()
+    funcs.copyMap(props, instance.map)
+    instance.funcs = funcs
+    instance.key = key
+    instance.numelem = numelem
+    instance.proptype = proptype
+    instance.shape[0] = numelem
+    instance.strides[0] = 8
+    return instance
+
+# A single element of a data property exported as bytes
+cdef class PropData(object):
+    cdef PropArray array
+    cdef int index
+    cdef Py_ssize_t shape[1]
+
+    def __init__(self):
+        raise Error('Class cannot be instantiated directly')
+
+    def __getbuffer__(self, Py_buffer* view, int flags):
+        if flags & PyBUF_WRITABLE:
+            raise BufferError('Object is not writable.')
+
+        view.buf = <void *>self.array.funcs.mapGetData(self.array.map, self.array.key, self.index, NULL)
+
+        if flags & PyBUF_FORMAT:
+            view.format = b'B'
+        else:
+            view.format = NULL
+
+        if flags & PyBUF_STRIDES:
+            view.shape = self.shape
+        else:
+            view.shape = NULL
+
+        view.strides = NULL
+        view.obj = self
+        view.len = self.shape[0]
+        view.readonly = 1
+        view.itemsize = 1
+        view.ndim = 1
+        view.suboffsets = NULL
+        view.internal = NULL
+
+cdef PropData createPropData(PropArray array, int index):
+    cdef PropData instance = PropData.__new__(PropData)
+    instance.array = array
+    instance.index = index
+    instance.shape[0] = array.funcs.mapGetDataSize(array.map, array.key, index, NULL)
+    return instance
+
 cdef class FrameProps(object):
     cdef const VSFrame *constf
     cdef VSFrame *f
@@ -1024,6 +1406,18 @@ cdef class FrameProps(object):
         else:
             return ol
 
+    def get_view(self, str name):
+        cdef const VSMap *m = self.funcs.getFramePropertiesRO(self.constf)
+        cdef bytes b = name.encode('utf-8')
+        cdef int numelem = self.funcs.mapNumElements(m, b)
+
+        if numelem < 0:
+            raise KeyError('No key named ' + name + ' exists')
+        cdef int t = self.funcs.mapGetType(m, b)
+        if t != ptInt and t != ptFloat and t != ptData:
+            raise Error('Only int, float and data properties can be viewed')
+        return createPropArray(m, b, numelem, t, self.funcs)
+
     def __setitem__(self, str name, value):
         if self.readonly:
             raise Error('Cannot delete properties of a read only object')
@@ -1198,6 +1592,88 @@ cdef FrameProps createFrameProps(RawFrame f):
 # Make sure the FrameProps-Object quacks like a Mapping.
 Mapping.register(FrameProps)
 
+# The DLPack structures, only the unversioned layout every consumer understands is exported
+cdef enum:
+    kDLCPU = 1
+    kDLInt = 0
+    kDLUInt = 1
+    kDLFloat = 2
+
+cdef struct DLDevice:
+    int device_type
+    int32_t device_id
+
+cdef struct DLDataType:
+    uint8_t code
+    uint8_t bits
+    uint16_t lanes
+
+cdef struct DLTensor:
+    void *data
+    DLDevice device
+    int32_t ndim
+    DLDataType dtype
+    int64_t *shape
+    int64_t *strides
+    uint64_t byte_offset
+
+cdef struct DLManagedTensor:
+    DLTensor dl_tensor
+    void *manager_ctx
+    void (*deleter)(DLManagedTensor *self) nogil
+
+# shape and strides are allocated together with the tensor so a single free releases everything
+cdef struct DLPackHolder:
+    DLManagedTensor tensor
+    int64_t shape[2]
+    int64_t strides[2]
+
+cdef void _dlpackDeleter(DLManagedTensor *tensor) nogil:
+    with gil:
+        Py_DECREF(<object>tensor.manager_ctx)
+    free(tensor)
+
+cdef void _dlpackCapsuleDestructor(object capsule):
+    # a consumer renames the capsule once it has taken ownership of the tensor
+    cdef DLManagedTensor *tensor
+    if PyCapsule_IsValid(capsule, b'dltensor'):
+        tensor = <DLManagedTensor *>PyCapsule_GetPointer(capsule, b'dltensor')
+        tensor.deleter(tensor)
+
+cdef str _arrayTypestr(object sample_type, int itemsize, bint signed):
+    cdef str prefix = '|' if itemsize == 1 else ('<' if sys.byteorder == 'little' else '>')
+    if sample_type == FLOAT:
+        return prefix + 'f' + str(itemsize)
+    return prefix + ('i' if signed else 'u') + str(itemsize)
+
+cdef object _createDLPackCapsule(object owner, void *data, int ndim, const Py_ssize_t *shape, const Py_ssize_t *strides, object sample_type, int itemsize, bint signed):
+    cdef DLPackHolder *holder = <DLPackHolder *>malloc(sizeof(DLPackHolder))
+    if holder == NULL:
+        raise MemoryError()
+    cdef int i
+    for i in range(ndim):
+        holder.shape[i] = shape[i]
+        holder.strides[i] = strides[i] // itemsize # dlpack counts strides in elements
+    holder.tensor.dl_tensor.data = data
+    holder.tensor.dl_tensor.device.device_type = kDLCPU
+    holder.tensor.dl_tensor.device.device_id = 0
+    holder.tensor.dl_tensor.ndim = ndim
+    holder.tensor.dl_tensor.dtype.code = kDLFloat if sample_type == FLOAT else (kDLInt if signed else kDLUInt)
+    holder.tensor.dl_tensor.dtype.bits = itemsize * 8
+    holder.tensor.dl_tensor.dtype.lanes = 1
+    holder.tensor.dl_tensor.shape = holder.shape
+    holder.tensor.dl_tensor.strides = holder.strides
+    holder.tensor.dl_tensor.byte_offset = 0
+    holder.tensor.manager_ctx = <void *>owner
+    holder.tensor.deleter = _dlpackDeleter
+    Py_INCREF(owner)
+    try:
+        return PyCapsule_New(holder, b'dltensor', <PyCapsule_Destructor>_dlpackCapsuleDestructor)
+    except:
+        _dlpackDeleter(&holder.tensor)
+        raise
+
+
 cdef class RawFrame(object):
     cdef const VSFrame *constf
     cdef VSFrame *f
@@ -1301,6 +1777,23 @@ cdef class VideoFrame(RawFrame):
         for x in range(self.format.num_planes):
             yield VideoPlane.__new__(VideoPlane, self, x)
 
+    cdef object _single_plane(self):
+        if self.format.num_planes != 1:
+            raise BufferError('Only frames with a single plane can be exported directly, use planes() instead')
+        return VideoPlane.__new__(VideoPlane, self, 0)
+
+    @property
+    def __array_interface__(self):
+        if self.format.num_planes != 1:
+            raise AttributeError('Only frames with a single plane have an array interface, use planes() instead')
+        return self._single_plane().__array_interface__
+
+    def __dlpack__(self, stream=None):
+        return self._single_plane().__dlpack__(stream)
+
+    def __dlpack_device__(self):
+        return (kDLCPU, 0)
+
     def __str__(self):
         cdef str s = 'VideoFrame\n'
         s += '\tFormat: ' + self.format.name + '\n'
@@ -1389,16 +1882,34 @@ cdef class VideoPlane:
             return self.frame.height >> self.frame.format.subsampling_h
         return self.frame.height
 
+    cdef void *_get_data(self):
+        if self.frame.readonly:
+            return <void*> self.frame.funcs.getReadPtr(self.frame.constf, self.plane)
+        return <void*> self.frame.funcs.getWritePtr(self.frame.f, self.plane)
+
+    @property
+    def __array_interface__(self):
+        return {
+            'version': 3,
+            'shape': (self.shape[0], self.shape[1]),
+            'strides': (self.strides[0], self.strides[1]),
+            'typestr': _arrayTypestr(self.frame.format.sample_type, self.strides[1], False),
+            'data': (<uintptr_t> self._get_data(), self.frame.readonly)
+        }
+
+    def __dlpack__(self, stream=None):
+        return _createDLPackCapsule(self, self._get_data(), 2, self.shape, self.strides, self.frame.format.sample_type, self.strides[1], False)
+
+    def __dlpack_device__(self):
+        return (kDLCPU, 0)
+
     def __getbuffer__(self, Py_buffer* view, int flags):
         if (flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS:
             raise BufferError("C-contiguous buffer only.")
 
-        if self.frame.readonly:
-            if flags & PyBUF_WRITABLE:
-                raise BufferError("Object is not writable.")
-            view.buf = (<void*> self.frame.funcs.getReadPtr(self.frame.constf, self.plane))
-        else:
-            view.buf = (<void*> self.frame.funcs.getWritePtr(self.frame.f, self.plane))
+        if self.frame.readonly and flags & PyBUF_WRITABLE:
+            raise BufferError("Object is not writable.")
+        view.buf = self._get_data()
 
         if flags & PyBUF_STRIDES:
             view.shape = self.shape
@@ -1559,16 +2070,34 @@ cdef class AudioChannel:
     def __len__(self):
         return len(self.frame)
 
+    cdef void *_get_data(self):
+        if self.frame.readonly:
+            return <void*> self.frame.funcs.getReadPtr(self.frame.constf, self.channel)
+        return <void*> self.frame.funcs.getWritePtr(self.frame.f, self.channel)
+
+    @property
+    def __array_interface__(self):
+        return {
+            'version': 3,
+            'shape': (self.shape[0],),
+            'strides': (self.strides[0],),
+            'typestr': _arrayTypestr(self.frame.sample_type, self.strides[0], True),
+            'data': (<uintptr_t> self._get_data(), self.frame.readonly)
+        }
+
+    def __dlpack__(self, stream=None):
+        return _createDLPackCapsule(self, self._get_data(), 1, self.shape, self.strides, self.frame.sample_type, self.strides[0], True)
+
+    def __dlpack_device__(self):
+        return (kDLCPU, 0)
+
     def __getbuffer__(self, Py_buffer* view, int flags):
         if (flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS:
             raise BufferError("C-contiguous buffer only.")
 
-        if self.frame.readonly:
-            if flags & PyBUF_WRITABLE:
-                raise BufferError("Object is not writable.")
-            view.buf = (<void*> self.frame.funcs.getReadPtr(self.frame.constf, self.channel))
-        else:
-            view.buf = (<void*> self.frame.funcs.getWritePtr(self.frame.f, self.channel))
+        if self.frame.readonly and flags & PyBUF_WRITABLE:
+            raise BufferError("Object is not writable.")
+        view.buf = self._get_data()
 
         if flags & PyBUF_STRIDES:
             view.shape = self.shape
@@ -1604,6 +2133,13 @@ cdef class RawNode(object):
     cdef ensure_valid_frame_number(self, int n):
         raise NotImplementedError("Needs to be implemented by subclass.")
 
+    def set_concurrency(self, int max_concurrency = -1, int64_t frame_scratch_size = -1, int64_t max_scratch_size = -1):
+        self.funcs.setNodeConcurrency(self.node, max_concurrency, frame_scratch_size, max_scratch_size)
+
+    def set_dedicated_thread(self, int queue_size = 8):
+        with nogil:
+            self.funcs.setNodeDedicatedThread(self.node, queue_size)
+
     def get_frame_async_raw(self, int n, object cb, object future_wrapper=None):
         self.ensure_valid_frame_number(n)
 
@@ -1703,6 +2239,134 @@ cdef class RawNode(object):
             finished = True
             gc.collect()
 
+    def get_frame_asyncio(self, int n):
+        import asyncio
+        self.ensure_valid_frame_number(n)
+
+        cdef AsyncioCallbackData data = AsyncioCallbackData.__new__(AsyncioCallbackData)
+        data.node = self
+        data.loop = asyncio.get_running_loop()
+        data.future = data.loop.create_future()
+        Py_INCREF(data)
+        with nogil:
+            self.funcs.getFrameAsync(n, self.node, asyncioFrameDoneCallback, <void *>data)
+        return data.future
+
+    def frames_batched(self, int batch_size = 1, prefetch = None, bint adaptive = False):
+        cdef int num_frames = self.num_frames
+        cdef int min_prefetch = batch_size
+        cdef int max_prefetch
+        cdef int cur_prefetch
+
+        if batch_size < 1:
+            raise ValueError('batch_size must be at least 1')
+        if prefetch is None or prefetch <= 0:
+            cur_prefetch = self.core.num_threads
+        else:
+            cur_prefetch = prefetch
+        if cur_prefetch < batch_size:
+            cur_prefetch = batch_size
+        # adaptive prefetching can go up to four times the initial depth
+        max_prefetch = cur_prefetch * 4 if adaptive else cur_prefetch
+
+        cdef FrameBatchState *state = <FrameBatchState *>malloc(sizeof(FrameBatchState))
+        if state == NULL:
+            raise MemoryError()
+        state.wait_for = -1
+        state.outstanding = 0
+        state.capacity = max_prefetch
+        state.mutex = PyThread_allocate_lock()
+        state.signal = PyThread_allocate_lock()
+        state.frames = <const VSFrame **>malloc(max_prefetch * sizeof(VSFrame *))
+        state.errors = <char **>malloc(max_prefetch * sizeof(char *))
+        state.done = <bint *>malloc(max_prefetch * sizeof(bint))
+        if state.mutex == NULL or state.signal == NULL or state.frames == NULL or state.errors == NULL or state.done == NULL:
+            # leaks whatever part was allocated, there's nothing sensible left to do at this point anyway
+            raise MemoryError()
+        PyThread_acquire_lock(state.signal, 1)
+
+        cdef int next_request = 0
+        cdef int next_consume = 0
+        cdef int slot
+        cdef int end
+        cdef int count
+        cdef int i
+        cdef bint waited
+        cdef const VSFrame *f
+        cdef VSNode *node = self.node
+        cdef VSCore *vscore = self.core.core
+
+        try:
+            while next_consume < num_frames:
+                end = min(next_consume + batch_size, num_frames)
+                batch = []
+                waited = False
+                while next_consume < end:
+                    slot = next_consume % state.capacity
+                    with nogil:
+                        count = min(num_frames, next_consume + cur_prefetch) - next_request
+                        if count > 0:
+                            for i in range(next_request, next_request + count):
+                                state.done[i % state.capacity] = False
+                            PyThread_acquire_lock(state.mutex, 1)
+                            state.outstanding += count
+                            PyThread_release_lock(state.mutex)
+                            self.funcs.getFramesAsync(next_request, count, 1, node, batchFrameDoneCallback, state)
+                            next_request += count
+
+                        PyThread_acquire_lock(state.mutex, 1)
+                        if not state.done[slot]:
+                            state.wait_for = next_consume
+                            PyThread_release_lock(state.mutex)
+                            PyThread_acquire_lock(state.signal, 1)
+                            waited = True
+                        else:
+                            PyThread_release_lock(state.mutex)
+
+                    f = state.frames[slot]
+                    next_consume += 1
+                    if f == NULL:
+                        error = Error(state.errors[slot].decode('utf-8') if state.errors[slot] != NULL else 'Internal error - no error message.')
+                        free(state.errors[slot])
+                        raise error
+                    batch.append(createNodeFrame(self, f))
+
+                # waiting for frames means rendering can't keep up so more requests are queued, frames that were
+                # already done mean the consumer is the bottleneck and buffering fewer of them saves memory
+                if adaptive:
+                    if waited:
+                        cur_prefetch = min(cur_prefetch + batch_size, max_prefetch)
+                    else:
+                        cur_prefetch = max(cur_prefetch - 1, min_prefetch)
+
+                yield batch
+        finally:
+            with nogil:
+                # frames prefetched for a consumer that stopped early aren't needed anymore
+                if next_request > next_consume:
+                    self.funcs.cancelFrameRequests(batchFrameDoneCallback, state, vscore)
+                PyThread_acquire_lock(state.mutex, 1)
+                if state.outstanding > 0:
+                    state.wait_for = -2
+                    PyThread_release_lock(state.mutex)
+                    PyThread_acquire_lock(state.signal, 1)
+                else:
+                    PyThread_release_lock(state.mutex)
+
+                while next_consume < next_request:
+                    slot = next_consume % state.capacity
+                    self.funcs.freeFrame(state.frames[slot])
+                    free(state.errors[slot])
+                    next_consume += 1
+
+            free(state.frames)
+            free(state.errors)
+            free(state.done)
+            PyThread_release_lock(state.signal)
+            PyThread_free_lock(state.signal)
+            PyThread_free_lock(state.mutex)
+            free(state)
+
     def __dealloc__(self):
         if self.funcs:
             self.funcs.freeNode(self.node)
@@ -1758,6 +2422,104 @@ cdef class VideoNode(RawNode):
         else:
             return createConstVideoFrame(f, self.funcs, self.core.core)
 
+    def read_frames(self, object out not None, int start = 0, int count = -1, object planes = None, prefetch = None):
+        if self.vi.format.colorFamily == UNDEFINED or self.vi.width == 0:
+            raise Error('Only clips with constant format and dimensions can be read into a buffer')
+        if count < 0:
+            count = self.num_frames - start
+        if start < 0 or count < 0 or start + count > self.num_frames:
+            raise ValueError('The frame range is outside the clip')
+
+        if planes is None:
+            planes = range(self.vi.format.numPlanes)
+        elif isinstance(planes, int):
+            planes = [planes]
+        planes = list(planes)
+        if len(planes) == 0 or len(planes) > 3:
+            raise ValueError('Between one and three planes must be selected')
+
+        cdef FrameCopyState state
+        cdef int i
+        cdef int p
+        cdef int width = 0
+        state.num_planes = len(planes)
+        for i in range(state.num_planes):
+            p = planes[i]
+            if p < 0 or p >= self.vi.format.numPlanes:
+                raise ValueError(f'Plane {p} doesn\'t exist')
+            plane_width = self.vi.width >> self.vi.format.subSamplingW if p else self.vi.width
+            plane_height = self.vi.height >> self.vi.format.subSamplingH if p else self.vi.height
+            if i and (plane_width != width or plane_height != state.height):
+                raise ValueError('All selected planes must have the same dimensions')
+            width = plane_width
+            state.height = plane_height
+            state.planes[i] = p
+
+        state.row_size = <size_t>width * self.vi.format.bytesPerSample
+        state.plane_size = state.row_size * state.height
+        state.frame_size = state.plane_size * state.num_planes
+
+        cdef int max_outstanding = self.core.num_threads if prefetch is None or prefetch <= 0 else prefetch
+        cdef int next_request = start
+        cdef int end = start + count
+        cdef int requests
+        cdef VSNode *node = self.node
+        cdef Py_buffer view
+        state.mutex = NULL
+        state.signal = NULL
+        PyObject_GetBuffer(out, &view, PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS)
+        try:
+            if view.itemsize != self.vi.format.bytesPerSample:
+                raise ValueError('The buffer item size doesn\'t match the sample size of the clip')
+            if <size_t>view.len != state.frame_size * count:
+                raise ValueError(f'The buffer has to be exactly {state.frame_size * count} bytes')
+
+            state.dst = <uint8_t *>view.buf
+            state.start = start
+            state.funcs = self.funcs
+            state.waiting = False
+            state.failed = False
+            state.outstanding = 0
+            state.error = NULL
+            state.mutex = PyThread_allocate_lock()
+            state.signal = PyThread_allocate_lock()
+            if state.signal != NULL:
+                PyThread_acquire_lock(state.signal, 1)
+            if state.mutex == NULL or state.signal == NULL:
+                raise MemoryError()
+
+            with nogil:
+                while True:
+                    PyThread_acquire_lock(state.mutex, 1)
+                    # nothing more is requested after an error, only the outstanding requests are waited for
+                    if state.failed:
+                        end = next_request
+                    if next_request == end and state.outstanding == 0:
+                        PyThread_release_lock(state.mutex)
+                        break
+                    requests = min(max_outstanding - state.outstanding, end - next_request)
+                    if requests > 0:
+                        state.outstanding += requests
+                        PyThread_release_lock(state.mutex)
+                        self.funcs.getFramesAsync(next_request, requests, 1, node, copyFrameDoneCallback, &state)
+                        next_request += requests
+                    else:
+                        state.waiting = True
+                        PyThread_release_lock(state.mutex)
+                        PyThread_acquire_lock(state.signal, 1)
+
+            if state.failed:
+                error = Error(state.error.decode('utf-8') if state.error != NULL else 'Internal error - no error message.')
+                free(state.error)
+                raise error
+        finally:
+            if state.signal != NULL:
+                PyThread_release_lock(state.signal)
+                PyThread_free_lock(state.signal)
+            if state.mutex != NULL:
+                PyThread_free_lock(state.mutex)
+            PyBuffer_Release(&view)
+
     def set_output(self, int index = 0, VideoNode alpha = None):
         cdef const VSVideoFormat *aformat = NULL
         clip = self
@@ -1775,8 +2537,18 @@ cdef class VideoNode(RawNode):
             clip = AlphaOutputTuple(self, alpha)
 
         _get_output_dict("set_output")[index] = clip
+        self.funcs.setNodeOutputIndex(self.node, index, 0)
+        if alpha is not None:
+            self.funcs.setNodeOutputIndex(alpha.node, index, 1)
 
     def output(self, object fileobj not None, bint y4m = False, object progress_update = None, int prefetch = 0, int backlog = -1):
+        cdef intptr_t handle
+        cdef int flags = vofY4M if y4m else 0
+        cdef int success
+        cdef char errorMsg[1024]
+        cdef VSOutputProgressCallback progress = NULL
+        cdef list progress_state
+
         if (fileobj is sys.stdout or fileobj is sys.stderr):
             # If you are embedded in a vsscript-application, don't allow outputting to stdout/stderr.
             # This is the responsibility of the application, which does know better where to output it.
@@ -1786,9 +2558,40 @@ cdef class VideoNode(RawNode):
             if hasattr(fileobj, "buffer"):
                 fileobj = fileobj.buffer
 
+        if y4m and self.format is not None and self.format.color_family not in (GRAY, YUV):
+            raise ValueError("Can only use GRAY and YUV for V4M-Streams")
+
         if progress_update is not None:
             progress_update(0, len(self))
 
+        # files and pipes are written by the core the same way as vspipe does it without holding the GIL,
+        # only objects without a file descriptor go through fileobj.write()
+        try:
+            fd = fileobj.fileno()
+        except (AttributeError, OSError, ValueError):
+            fd = -1
+
+        if fd >= 0:
+            # anything python has buffered has to be in the file before the core writes to it
+            if hasattr(fileobj, "flush"):
+                fileobj.flush()
+            if sys.platform == 'win32':
+                import msvcrt
+                handle = msvcrt.get_osfhandle(fd)
+            else:
+                handle = fd
+
+            progress_state = [progress_update, None]
+            if progress_update is not None:
+                progress = outputProgressCallback
+            with nogil:
+                success = self.funcs.outputVideoNode(self.node, handle, flags, prefetch, progress, <void *>progress_state, errorMsg, sizeof(errorMsg))
+            if progress_state[1] is not None:
+                raise progress_state[1]
+            if not success:
+                raise Error(errorMsg.decode('utf-8'))
+            return
+
         if y4m:
             if self.format.color_family == GRAY:
                 y4mformat = 'mono'
@@ -2020,6 +2823,7 @@ cdef class AudioNode(RawNode):
 
     def set_output(self, int index = 0):
         _get_output_dict("set_output")[index] = self
+        self.funcs.setNodeOutputIndex(self.node, index, 0)
             
     def __add__(x, y):
         if not isinstance(x, AudioNode) or not isinstance(y, AudioNode):
@@ -2146,9 +2950,35 @@ cdef void __stdcall log_handler_free(void *userData) nogil:
     with gil:
         Py_DECREF(<LogHandle>userData)
 
+cdef class FrameBufferOwner(object):
+    cdef Py_buffer views[3]
+    cdef int num_views
+
+    def __dealloc__(self):
+        cdef int i
+        for i in range(self.num_views):
+            PyBuffer_Release(&self.views[i])
+
+cdef void __stdcall frame_buffer_free(void *userData) nogil:
+    with gil:
+        Py_DECREF(<FrameBufferOwner>userData)
+
+cdef class SharedThreadPool(object):
+    cdef VSSharedThreadPool *pool
+    cdef const VSAPI *funcs
+
+    def __init__(self, int threads = 0):
+        self.funcs = getVapourSynthAPI(VAPOURSYNTH_API_VERSION)
+        self.pool = self.funcs.createSharedThreadPool(threads)
+
+    def __dealloc__(self):
+        if self.pool:
+            self.funcs.freeSharedThreadPool(self.pool)
+
 cdef class Core(object):
     cdef VSCore *core
     cdef const VSAPI *funcs
+    cdef dict bindings
 
     cdef object __weakref__
 
@@ -2158,6 +2988,15 @@ cdef class Core(object):
     def __dealloc__(self):
         if self.funcs:
             self.funcs.freeCore(self.core)
+
+    cdef FunctionBinding getFunctionBinding(self, const VSPluginFunction *func):
+        if self.bindings is None:
+            self.bindings = {}
+        binding = self.bindings.get(<uintptr_t>func)
+        if binding is None:
+            binding = createFunctionBinding(func, self.funcs)
+            self.bindings[<uintptr_t>func] = binding
+        return binding
             
     property num_threads:
         def __get__(self):
@@ -2184,6 +3023,28 @@ cdef class Core(object):
             new_size = new_size * 1024 * 1024
             self.funcs.setMaxCacheSize(new_size, self.core)
 
+    property max_memory_hard_limit:
+        def __get__(self):
+            cdef int64_t current_size = self.funcs.setMemoryHardLimit(-1, self.core)
+            current_size = current_size + 1024 * 1024 - 1
+            current_size = current_size // <int64_t>(1024 * 1024)
+            return current_size
+
+        def __set__(self, int mb):
+            if mb < 0:
+                raise ValueError('Memory hard limit can\'t be negative')
+            cdef int64_t new_size = mb
+            new_size = new_size * 1024 * 1024
+            self.funcs.setMemoryHardLimit(new_size, self.core)
+
+    property audio_frame_samples:
+        def __get__(self):
+            return self.funcs.getAudioFrameSamples(self.core)
+
+        def __set__(self, int samples):
+            if self.funcs.setAudioFrameSamples(samples, self.core) != samples:
+                raise Error('Audio frame size must be a multiple of 1024 between 1024 and 1048576 and can only be changed before any audio clip is created')
+
     def __getattr__(self, name):
         cdef VSPlugin *plugin
         tname = name.encode('utf-8')
@@ -2263,6 +3124,63 @@ cdef class Core(object):
         import warnings
         warnings.warn("get_format() is deprecated. Use \"get_video_format\" instead.", DeprecationWarning)
         return self.get_video_format(id);
+
+    def attach_shared_thread_pool(self, SharedThreadPool pool not None, int weight = 1):
+        if weight < 1:
+            raise ValueError('weight must be at least 1')
+        if not self.funcs.attachSharedThreadPool(pool.pool, weight, self.core):
+            raise Error('The core is already attached to a different shared thread pool')
+
+    def record_requests(self, object filename = None):
+        cdef int success
+        if filename is None:
+            success = self.funcs.recordFrameRequests(NULL, self.core)
+        else:
+            success = self.funcs.recordFrameRequests(str(filename).encode('utf-8'), self.core)
+        if not success:
+            raise Error('Failed to write request recording')
+
+    def save_cache_sizes(self, object filename):
+        if not self.funcs.saveCacheSizes(str(filename).encode('utf-8'), self.core):
+            raise Error('Failed to write cache sizes')
+
+    def load_cache_sizes(self, object filename):
+        if not self.funcs.loadCacheSizes(str(filename).encode('utf-8'), self.core):
+            raise Error('Failed to read cache sizes')
+
+    def create_video_frame_from_buffers(self, object format, int width, int height, object planes, bint writable = False, RawFrame prop_src = None):
+        cdef VSVideoFormat fmt
+        if not self.funcs.getVideoFormatByID(&fmt, int(format), self.core):
+            raise Error('Invalid format specified')
+        if len(planes) != fmt.numPlanes:
+            raise ValueError('The number of planes doesn\'t match the format')
+
+        cdef FrameBufferOwner owner = FrameBufferOwner.__new__(FrameBufferOwner)
+        cdef uint8_t *ptrs[3]
+        cdef ptrdiff_t strides[3]
+        cdef int flags = PyBUF_STRIDES | PyBUF_FORMAT | (PyBUF_WRITABLE if writable else 0)
+        cdef Py_buffer *view
+        cdef int i
+        for i in range(fmt.numPlanes):
+            view = &owner.views[i]
+            PyObject_GetBuffer(planes[i], view, flags)
+            owner.num_views += 1
+            plane_width = width >> fmt.subSamplingW if i else width
+            plane_height = height >> fmt.subSamplingH if i else height
+            if view.ndim != 2 or view.shape[0] != plane_height or view.shape[1] != plane_width:
+                raise ValueError(f'Plane {i} has the wrong dimensions')
+            if view.itemsize != fmt.bytesPerSample or view.strides[1] != view.itemsize:
+                raise ValueError(f'Plane {i} has the wrong sample size or isn\'t contiguous within rows')
+            ptrs[i] = <uint8_t *>view.buf
+            strides[i] = view.strides[0]
+
+        # the core releases this reference through frame_buffer_free once no frame uses the planes anymore
+        Py_INCREF(owner)
+        cdef VSFrame *f = self.funcs.newVideoFrameFromBuffers(&fmt, width, height, ptrs, strides, writable, frame_buffer_free, <void *>owner, prop_src.constf if prop_src is not None else NULL, self.core)
+        if f == NULL:
+            Py_DECREF(owner)
+            raise ValueError('Plane data and strides must be aligned to 64 bytes')
+        return createVideoFrame(f, self.funcs, self.core)
         
     def log_message(self, MessageType message_type, str message):
         self.funcs.logMessage(message_type, message.encode('utf-8'), self.core)
@@ -2435,6 +3353,7 @@ cdef Plugin createPlugin(VSPlugin *plugin, const VSAPI *funcs, Core core):
 cdef class Function(object):
     cdef const VSAPI *funcs
     cdef const VSPluginFunction *func
+    cdef FunctionBinding binding
     cdef readonly Plugin plugin
     cdef readonly str name
     cdef readonly str signature
@@ -2452,62 +3371,53 @@ cdef class Function(object):
     def __call__(self, *args, **kwargs):
         cdef VSMap *inm
         cdef VSMap *outm
-        cdef char *cname
-        arglist = list(args)
-        if self.plugin.injected_arg is not None:
-            arglist.insert(0, self.plugin.injected_arg)
-        ndict = {}
-        processed = {}
-        atypes = {}
-        # remove _ from all args
-        for key in kwargs:
-            if key[0] == '_':
-                nkey = key[1:]
-            # PEP8 tells us single_trailing_underscore_ for collisions with Python-keywords.
-            elif key[-1] == "_":
-                nkey = key[:-1]
-            else:
-                nkey = key
-            ndict[nkey] = kwargs[key]
+        cdef FunctionBinding binding = self.binding
+        cdef Py_ssize_t numArgs = len(binding.keys)
+        cdef Py_ssize_t pos
+        cdef list values = [_unsetArg] * numArgs
+        cdef dict ndict = None
+
+        for key, val in kwargs.items():
+            pos = binding.positions.get(key, -1)
+            if pos < 0:
+                # remove _ from the name, PEP8 tells us single_trailing_underscore_ for collisions with Python-keywords.
+                if key[0] == '_':
+                    key = key[1:]
+                elif key[-1] == '_':
+                    key = key[:-1]
+                pos = binding.positions.get(key, -1)
+                if pos < 0:
+                    if ndict is None:
+                        ndict = {}
+                    ndict[key] = val
+                    continue
+            values[pos] = val
 
         # match up unnamed arguments to the first unused name in order
-        sigs = self.signature.split(';')
-        any = False
-
-        for sig in sigs:
-            if sig == 'any':
-                any = True
-                continue
-            elif sig == '':
-                continue
-            parts = sig.split(':')
-            # store away the types for later use
-            key = parts[0]
-            atypes[key] = parts[1]
-
-            # the name has already been specified
-            if key in ndict:
-                processed[key] = ndict[key]
-                del ndict[key]
-            else:
-            # fill in with the first unnamed arg until they run out
-                if len(arglist) > 0:
-                    processed[key] = arglist[0]
-                    del arglist[0]
-
-        if len(arglist) > 0:
-            raise Error(self.name + ': Too many unnamed arguments specified')
-
-        if (len(ndict) > 0) and not any:
-            raise Error(self.name + ': Function does not take argument(s) named ' + ', '.join(ndict.keys()))          
+        pos = 0
+        if self.plugin.injected_arg is not None:
+            args = (self.plugin.injected_arg,) + args
+        for val in args:
+            while pos < numArgs and values[pos] is not _unsetArg:
+                pos += 1
+            if pos == numArgs:
+                raise Error(self.name + ': Too many unnamed arguments specified')
+            values[pos] = val
+            pos += 1
+
+        if ndict is not None and not binding.any:
+            raise Error(self.name + ': Function does not take argument(s) named ' + ', '.join(ndict.keys()))
 
         inm = self.funcs.createMap()
 
         dtomsuccess = True
         dtomexceptmsg = ''
         try:
-            typedDictToMap(processed, atypes, inm, self.plugin.core.core, self.funcs)
-            if any:
+            for pos in range(numArgs):
+                val = values[pos]
+                if val is not _unsetArg and val is not None:
+                    typedValueToMap(binding, pos, val, inm, self.plugin.core.core, self.funcs)
+            if ndict is not None:
                 dictToMap(ndict, inm, False, self.plugin.core.core, self.funcs)
         except Error as e:
             self.funcs.freeMap(inm)
@@ -2517,9 +3427,12 @@ cdef class Function(object):
         if dtomsuccess == False:
             raise Error(self.name + ': ' + dtomexceptmsg)
 
-        tname = self.name.encode('utf-8')
-        cname = tname
-        outm = self.funcs.invoke(self.plugin.plugin, cname, inm)
+        # source filters can spend a long time opening files when created, without the gil other threads and scripts
+        # evaluated at the same time keep running and frames requested by the filter can still use python callbacks
+        cdef VSPlugin *plugin = self.plugin.plugin
+        cdef const char *cname = binding.cname
+        with nogil:
+            outm = self.funcs.invoke(plugin, cname, inm)
         self.funcs.freeMap(inm)
         cdef const char *err = self.funcs.mapGetError(outm)
         cdef bytes emsg
@@ -2533,11 +3446,15 @@ cdef class Function(object):
         self.funcs.freeMap(outm)
         return retdict
 
+# marks arguments not given in a call, None can't be used since it's passed to leave out an argument
+_unsetArg = object()
+
 cdef Function createFunction(VSPluginFunction *func, Plugin plugin, const VSAPI *funcs):
     cdef Function instance = Function.__new__(Function)
-    instance.name = funcs.getPluginFunctionName(func).decode('utf-8')
-    instance.signature = funcs.getPluginFunctionArguments(func).decode('utf-8')
-    instance.return_signature = funcs.getPluginFunctionReturnType(func).decode('utf-8')
+    instance.binding = plugin.core.getFunctionBinding(func)
+    instance.name = instance.binding.name
+    instance.signature = instance.binding.signature
+    instance.return_signature = instance.binding.return_signature
     instance.plugin = plugin
     instance.funcs = funcs
     instance.func = func
@@ -2761,7 +3678,7 @@ cdef void _vpy_replace_pyenvdict(VSScript *se, dict pyenvdict):
         se.pyenvdict = <void*>pyenvdict
 
 
-cdef int _vpy_evaluate(VSScript *se, bytes script, str filename, const VSScriptOptions* options):
+cdef int _vpy_evaluate(VSScript *se, object script, str filename, const VSScriptOptions* options):
     try:
         pyenvdict = {}
         if se.pyenvdict:
@@ -2770,7 +3687,11 @@ cdef int _vpy_evaluate(VSScript *se, bytes script, str filename, const VSScriptO
             _vpy_replace_pyenvdict(se, pyenvdict)
         
         pyenvdict["__name__"] = "__vapoursynth__"
-        code = compile(script, filename=filename, dont_inherit=True, mode="exec")
+        # a code object comes from vpy4_compileBuffer and is shared by every evaluation of the template
+        if isinstance(script, bytes):
+            code = compile(script, filename=filename, dont_inherit=True, mode="exec")
+        else:
+            code = script
 
         if filename is None or (filename.startswith("<") and filename.endswith(">")):
             filename = "<string>"
@@ -2904,6 +3825,57 @@ cdef public api int vpy4_evaluateFile(VSScript *se, const char *scriptFilename,
             se.errstr = <void *>errstr
             return 1
             
+cdef public api int vpy4_compileBuffer(VSScript *se, const char *buffer, const char *scriptFilename) nogil:
+    with gil:
+        try:
+            if buffer == NULL:
+                raise RuntimeError("NULL buffer passed.")
+
+            # only needed so the handle can be freed like any other
+            if not se.pyenvdict:
+                _vpy_replace_pyenvdict(se, {})
+
+            fn = None
+            if scriptFilename:
+                fn = scriptFilename.decode('utf-8')
+
+            compiled = (compile(buffer, filename=fn, dont_inherit=True, mode="exec"), fn)
+            Py_INCREF(compiled)
+            se.code = <void *>compiled
+            return 0
+
+        except BaseException, e:
+            errstr = 'Python exception: ' + str(e) + '\n\n' + traceback.format_exc()
+            errstr = errstr.encode('utf-8')
+            Py_INCREF(errstr)
+            se.errstr = <void *>errstr
+            return 2
+
+cdef public api int vpy4_evaluateCompiled(VSScript *se, VSScript *compiled, const VSMap *vars, const VSScriptOptions *options) nogil:
+    with gil:
+        try:
+            if not compiled.code:
+                raise RuntimeError("Handle doesn't hold a compiled script.")
+
+            if not se.pyenvdict:
+                _vpy_replace_pyenvdict(se, {})
+            pyenvdict = <dict>se.pyenvdict
+
+            if vars:
+                if getVSAPIInternal() == NULL:
+                    raise RuntimeError("Failed to retrieve VSAPI pointer.")
+                pyenvdict.update(mapToDict(vars, False, NULL, getVSAPIInternal()))
+
+            code, fn = <tuple>compiled.code
+            return _vpy_evaluate(se, code, fn, options)
+
+        except BaseException, e:
+            errstr = 'Python exception: ' + str(e) + '\n\n' + traceback.format_exc()
+            errstr = errstr.encode('utf-8')
+            Py_INCREF(errstr)
+            se.errstr = <void *>errstr
+            return 2
+
 cdef public api int vpy4_clearLogHandler(VSScript *se) nogil:
     with gil:
         if not _get_vsscript_policy().has_environment(se.id):
@@ -2927,6 +3899,12 @@ cdef public api void vpy4_freeScript(VSScript *se) nogil:
             Py_DECREF(errstr)
             errstr = None
 
+        if se.code:
+            compiled = <tuple>se.code
+            se.code = NULL
+            Py_DECREF(compiled)
+            compiled = None
+
         try:
             _get_vsscript_policy()._free_environment(se.id)
         except:
@@ -25,3 +25,4 @@ cdef extern from "src/vsscript/vsscript_internal.h" nogil:
         void *errstr
         int id
         int exitCode
+        void *code
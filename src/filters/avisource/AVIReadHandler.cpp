@@ -281,8 +281,90 @@ public:
     VDFile        mFile;
     VDFile        mFileUnbuffered;
     sint64        mFileSize;
+    VDStringW    mPath;
+
+    // Local files are mapped as a whole when there's enough address space and
+    // read without going through the stream cache. Files on network drives are
+    // read ahead in large blocks instead since every page fault would become a
+    // small network request.
+    HANDLE        mhMapping;
+    const char    *mpView;
+    bool        mbRemote;
+
+    AVIFileDesc() : mFileSize(0), mhMapping(nullptr), mpView(nullptr), mbRemote(false) {}
+    ~AVIFileDesc();
 };
 
+AVIFileDesc::~AVIFileDesc() {
+    if (mpView)
+        UnmapViewOfFile(mpView);
+
+    if (mhMapping)
+        CloseHandle(mhMapping);
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// Copies from a mapped view. An I/O error raises an exception when the pages
+// are touched so it has to be caught here, no C++ objects may live in this
+// function because of __try.
+static bool VDCopyFromMappedView(void *dst, const void *src, size_t len) {
+    __try {
+        memcpy(dst, src, len);
+    } __except(GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool VDIsRemotePath(const wchar_t *path) {
+    wchar_t root[MAX_PATH];
+
+    if (!GetVolumePathNameW(path, root, MAX_PATH))
+        return false;
+
+    return GetDriveTypeW(root) == DRIVE_REMOTE;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// The index of OpenDML files and of files that had to be scanned is stored
+// next to them so that opening them again doesn't read every index block or
+// chunk header. It's only used while the size and modification time of the
+// file match.
+
+static const wchar_t kIndexCacheSuffix[] = L".vsindex";
+
+enum {
+    kIndexCacheMagic            = VDMAKEFOURCC('V', 'S', 'A', 'I'),
+    kIndexCacheVersion            = 1,
+
+    kIndexCacheFlagAggressive    = 1,
+    kIndexCacheFlagFakeIndex    = 2,
+    kIndexCacheFlagPaletteChanges = 4
+};
+
+struct AVIIndexCacheHeader {
+    uint32    mMagic;
+    uint32    mVersion;
+    sint64    mFileSize;
+    uint64    mLastWriteTime;
+    uint32    mStreamCount;
+    uint32    mFlags;
+};
+
+static bool VDGetIndexCacheKey(const wchar_t *path, sint64& fileSize, uint64& lastWriteTime) {
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &attr))
+        return false;
+
+    fileSize = ((sint64)attr.nFileSizeHigh << 32) + attr.nFileSizeLow;
+    lastWriteTime = ((uint64)attr.ftLastWriteTime.dwHighDateTime << 32) + attr.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
 class AVIStreamNode;
 
 class AVIReadHandler : public IAVIReadHandler, public IAVIReadCacheSource {
@@ -317,11 +399,14 @@ private:
 
     bool ReadChunkHeader(uint32& type, uint32& size);
     void SelectFile(int file);
+    bool IsMapped() const;
+    const void *GetMappedData(sint64 position, long len) const;
 
 //    enum { STREAM_SIZE = 65536 };
     enum { STREAM_SIZE = 1048576 };
     enum { STREAM_RT_SIZE = 65536 };
     enum { STREAM_BLOCK_SIZE = 4096 };
+    enum { READAHEAD_SIZE = 8388608 };
 
     int            mRefCount;
     sint64        i64StreamPosition;
@@ -357,7 +442,20 @@ private:
     List2<AVIStreamNode>        listStreams;
     vdfastvector<AVIFileDesc *>    mFiles;
 
+    // Sequential read-ahead for files on network drives
+    vdfastvector<char>    mReadAheadBuffer;
+    sint64        mReadAheadPos;
+    long        mReadAheadSize;
+    sint64        mLastReadEnd;
+
+    // Set while the indices come from an index cache
+    bool        mbSkipIndexParse;
+
     void        _construct(const wchar_t *pszFile);
+    void        _openFile(AVIFileDesc *pDesc, const wchar_t *pszFile);
+    bool        _readIndexCache(vdfastvector<uint8>& cache);
+    bool        _restoreIndexCache(List2<AVIStreamNode>& streams, const vdfastvector<uint8>& cache, bool& bAggressive);
+    void        _writeIndexCache(List2<AVIStreamNode>& streams, bool bAggressive, bool bFakeIndex);
     void        _parseFile(List2<AVIStreamNode>& streams);
     bool        _parseStreamHeader(List2<AVIStreamNode>& streams, uint32 dwLengthLeft, bool& bIndexDamaged);
     bool        _parseIndexBlock(List2<AVIStreamNode>& streams, int count, sint64);
@@ -385,6 +483,7 @@ public:
     sint32 Info(VDAVIStreamInfo *pasi);
     bool IsKeyFrame(VDPosition lFrame);
     sint32 Read(VDPosition lStart, long lSamples, void *lpBuffer, long cbBuffer, long *plBytes, long *plSamples);
+    const void *ReadDirect(VDPosition lStart, long *plBytes);
     VDPosition Start();
     VDPosition End();
     VDPosition PrevKeyFrame(VDPosition lFrame);
@@ -473,7 +572,8 @@ sint32 AVIReadStream::BeginStreaming(VDPosition lStart, VDPosition lEnd, long lR
     } else
         fRealTime = false;
 
-    if (parent->fDisableFastIO)
+    // Mapped files are read directly, streaming would only add a copy
+    if (parent->fDisableFastIO || parent->IsMapped())
         return 0;
 
     if (!psnData->streaming_count) {
@@ -779,6 +879,26 @@ sint32 AVIReadStream::Read(VDPosition lStart, long lSamples, void *lpBuffer, lon
     return 0;
 }
 
+const void *AVIReadStream::ReadDirect(VDPosition lStart, long *plBytes) {
+    if (sampsize || lStart < 0 || lStart >= length)
+        return nullptr;
+
+    VDAVIReadIndexIterator it;
+    mpIndex->FindSampleRange(it, lStart, 1);
+
+    sint64 chunkPos;
+    uint32 chunkOffset;
+    uint32 byteSize;
+    mpIndex->GetNextSampleRange(it, chunkPos, chunkOffset, byteSize);
+
+    // the 16 guard bytes lie past the end of the sample, refuse samples at the very end of the file
+    const void *p = parent->GetMappedData(chunkPos + chunkOffset, byteSize + 16);
+    if (p && plBytes)
+        *plBytes = byteSize;
+
+    return p;
+}
+
 sint64 AVIReadStream::getSampleBytePosition(VDPosition pos) {
     if (pos < 0 || pos >= length)
         return -1;
@@ -944,6 +1064,10 @@ AVIReadHandler::AVIReadHandler(const wchar_t *s)
     fFakeIndex = false;
     nFiles = 1;
     pSegmentHint = nullptr;
+    mReadAheadPos = -1;
+    mReadAheadSize = 0;
+    mLastReadEnd = -1;
+    mbSkipIndexParse = false;
 
     _construct(s);
 }
@@ -962,9 +1086,7 @@ void AVIReadHandler::_construct(const wchar_t *pszFile) {
             throw MyMemoryError();
 
         // open file
-        pDesc->mFile.open(pszFile, nsVDFile::kRead | nsVDFile::kDenyWrite | nsVDFile::kOpenExisting | nsVDFile::kSequential);
-        pDesc->mFileUnbuffered.openNT(pszFile, nsVDFile::kRead | nsVDFile::kDenyWrite | nsVDFile::kOpenExisting | nsVDFile::kUnbuffered);
-        pDesc->mFileSize = pDesc->mFile.size();
+        _openFile(pDesc, pszFile);
 
         mpCurrentFile = pDesc;
         mCurrentFile = -1;
@@ -980,6 +1102,137 @@ void AVIReadHandler::_construct(const wchar_t *pszFile) {
     }
 }
 
+void AVIReadHandler::_openFile(AVIFileDesc *pDesc, const wchar_t *pszFile) {
+    pDesc->mFile.open(pszFile, nsVDFile::kRead | nsVDFile::kDenyWrite | nsVDFile::kOpenExisting | nsVDFile::kSequential);
+    pDesc->mFileUnbuffered.openNT(pszFile, nsVDFile::kRead | nsVDFile::kDenyWrite | nsVDFile::kOpenExisting | nsVDFile::kUnbuffered);
+    pDesc->mFileSize = pDesc->mFile.size();
+    pDesc->mPath = pszFile;
+    pDesc->mbRemote = VDIsRemotePath(pszFile);
+
+    // Failing to map the file isn't an error, it's read normally then.
+    // 32 bit processes only map files that leave most of the address space free.
+    const sint64 maxMappedSize = sizeof(void *) >= 8 ? VD64(0x7FFFFFFFFFFFFFFF) : VD64(0x20000000);
+
+    if (!pDesc->mbRemote && pDesc->mFileSize > 0 && pDesc->mFileSize <= maxMappedSize) {
+        pDesc->mhMapping = CreateFileMappingW((HANDLE)pDesc->mFile.getRawHandle(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (pDesc->mhMapping) {
+            pDesc->mpView = (const char *)MapViewOfFile(pDesc->mhMapping, FILE_MAP_READ, 0, 0, 0);
+
+            if (!pDesc->mpView) {
+                CloseHandle(pDesc->mhMapping);
+                pDesc->mhMapping = nullptr;
+            }
+        }
+    }
+}
+
+bool AVIReadHandler::_readIndexCache(vdfastvector<uint8>& cache) {
+    sint64 fileSize;
+    uint64 lastWriteTime;
+
+    if (!VDGetIndexCacheKey(mpCurrentFile->mPath.c_str(), fileSize, lastWriteTime))
+        return false;
+
+    try {
+        VDFile file;
+
+        if (!file.openNT((mpCurrentFile->mPath + kIndexCacheSuffix).c_str(), nsVDFile::kRead | nsVDFile::kDenyWrite | nsVDFile::kOpenExisting))
+            return false;
+
+        sint64 size = file.size();
+        if (size < (sint64)sizeof(AVIIndexCacheHeader) || size > 0x7FFFFFFF)
+            return false;
+
+        cache.resize((size_t)size);
+        file.read(cache.data(), (long)size);
+    } catch(const MyError&) {
+        return false;
+    }
+
+    AVIIndexCacheHeader hdr;
+    memcpy(&hdr, cache.data(), sizeof hdr);
+
+    return hdr.mMagic == kIndexCacheMagic && hdr.mVersion == kIndexCacheVersion
+        && hdr.mFileSize == fileSize && hdr.mLastWriteTime == lastWriteTime;
+}
+
+bool AVIReadHandler::_restoreIndexCache(List2<AVIStreamNode>& streamlist, const vdfastvector<uint8>& cache, bool& bAggressive) {
+    AVIIndexCacheHeader hdr;
+    memcpy(&hdr, cache.data(), sizeof hdr);
+
+    const uint8 *src = cache.data() + sizeof hdr;
+    const uint8 *srcEnd = cache.data() + cache.size();
+
+    AVIStreamNode *pasn, *pasn_next;
+    uint32 streamCount = 0;
+
+    for(pasn = streamlist.AtHead(); pasn_next = pasn->NextFromHead(); pasn = pasn_next)
+        ++streamCount;
+
+    if (streamCount != hdr.mStreamCount)
+        return false;
+
+    for(pasn = streamlist.AtHead(); pasn_next = pasn->NextFromHead(); pasn = pasn_next) {
+        if (srcEnd - src < 8)
+            return false;
+
+        memcpy(&pasn->bytes, src, 8);
+        src += 8;
+
+        if (!pasn->mIndex.Deserialize(src, srcEnd))
+            return false;
+    }
+
+    if (hdr.mFlags & kIndexCacheFlagAggressive)
+        bAggressive = true;
+
+    if (hdr.mFlags & kIndexCacheFlagFakeIndex)
+        fFakeIndex = true;
+
+    if (hdr.mFlags & kIndexCacheFlagPaletteChanges)
+        mbPaletteChangesDetected = true;
+
+    return true;
+}
+
+void AVIReadHandler::_writeIndexCache(List2<AVIStreamNode>& streamlist, bool bAggressive, bool bFakeIndex) {
+    AVIIndexCacheHeader hdr = {};
+
+    if (!VDGetIndexCacheKey(mpCurrentFile->mPath.c_str(), hdr.mFileSize, hdr.mLastWriteTime))
+        return;
+
+    hdr.mMagic = kIndexCacheMagic;
+    hdr.mVersion = kIndexCacheVersion;
+    hdr.mFlags = (bAggressive ? kIndexCacheFlagAggressive : 0)
+        | (bFakeIndex ? kIndexCacheFlagFakeIndex : 0)
+        | (mbPaletteChangesDetected ? kIndexCacheFlagPaletteChanges : 0);
+
+    vdfastvector<uint8> cache(sizeof hdr);
+
+    AVIStreamNode *pasn, *pasn_next;
+
+    for(pasn = streamlist.AtHead(); pasn_next = pasn->NextFromHead(); pasn = pasn_next) {
+        size_t pos = cache.size();
+        cache.resize(pos + 8);
+        memcpy(cache.data() + pos, &pasn->bytes, 8);
+
+        pasn->mIndex.Serialize(cache);
+        ++hdr.mStreamCount;
+    }
+
+    memcpy(cache.data(), &hdr, sizeof hdr);
+
+    // The cache is only an optimization, read-only directories are fine
+    try {
+        VDFile file((mpCurrentFile->mPath + kIndexCacheSuffix).c_str(), nsVDFile::kWrite | nsVDFile::kDenyAll | nsVDFile::kCreateAlways);
+
+        file.write(cache.data(), (long)cache.size());
+        file.close();
+    } catch(const MyError&) {
+    }
+}
+
 bool AVIReadHandler::AppendFile(const wchar_t *pszFile) {
     List2<AVIStreamNode> newstreams;
     AVIStreamNode *pasn_old, *pasn_new, *pasn_old_next=nullptr, *pasn_new_next=nullptr;
@@ -991,9 +1244,7 @@ bool AVIReadHandler::AppendFile(const wchar_t *pszFile) {
     if (!pDesc)
         throw MyMemoryError();
 
-    pDesc->mFile.open(pszFile, nsVDFile::kRead | nsVDFile::kDenyWrite | nsVDFile::kOpenExisting | nsVDFile::kSequential);
-    pDesc->mFileUnbuffered.openNT(pszFile, nsVDFile::kRead | nsVDFile::kDenyWrite | nsVDFile::kOpenExisting | nsVDFile::kUnbuffered);
-    pDesc->mFileSize = pDesc->mFile.size();
+    _openFile(pDesc, pszFile);
     mFiles.push_back(pDesc.release());
 
     mpCurrentFile = mFiles.back();
@@ -1175,6 +1426,12 @@ void AVIReadHandler::_parseFile(List2<AVIStreamNode>& streamlist) {
     sint64    i64ChunkMoviPos = 0;
     uint32    dwChunkMoviLength = 0;
 
+    vdfastvector<uint8> indexCache;
+    bool bIndexCached = _readIndexCache(indexCache);
+    bool bIndexRestored = false;
+
+    mbSkipIndexParse = bIndexCached;
+
     if (!ReadChunkHeader(fccType, dwLength))
         throw MyError("Invalid AVI file: File is less than 8 bytes");
 
@@ -1277,7 +1534,7 @@ void AVIReadHandler::_parseFile(List2<AVIStreamNode>& streamlist) {
 
             switch(fccType) {
             case VDMAKEFOURCC('i', 'd', 'x', '1'):
-                if (!hyperindexed) {
+                if (!hyperindexed && !bIndexCached) {
                     index_found = _parseIndexBlock(streamlist, dwLength/16, i64ChunkMoviPos);
                     dwLength &= 15;
                 }
@@ -1397,7 +1654,13 @@ void AVIReadHandler::_parseFile(List2<AVIStreamNode>& streamlist) {
 
 terminate_scan:
 
-    if (!hyperindexed && !index_found)
+    mbSkipIndexParse = false;
+
+    if (bIndexCached) {
+        // Fall back to scanning if the cache doesn't fit the file after all
+        bIndexRestored = _restoreIndexCache(streamlist, indexCache, bAggressive);
+        bScanRequired = !bIndexRestored;
+    } else if (!hyperindexed && !index_found)
         bScanRequired = true;
 
     if (bScanRequired) {
@@ -1643,6 +1906,9 @@ terminate_scan:
         ++nStream;
     }
 
+    if (!bIndexRestored && (hyperindexed || bScanRequired))
+        _writeIndexCache(streamlist, bAggressive, bScanRequired);
+
 //    throw MyError("Parse complete.  Aborting.");
 }
 
@@ -1753,15 +2019,16 @@ bool AVIReadHandler::_parseStreamHeader(List2<AVIStreamNode>& streamlist, uint32
 
     pasn->mIndex.Init(sampsize);
 
-    if (extendedIndexPos >= 0) {
+    if (extendedIndexPos >= 0 && !mbSkipIndexParse) {
         try {
             _parseExtendedIndexBlock(streamlist, pasn, extendedIndexPos, dwLength);
         } catch(const MyError&) {
             bIndexDamaged = true;
         }
+    }
 
+    if (extendedIndexPos >= 0)
         hyperindexed = true;
-    }
 
     streamlist.AddTail(pasn.release());
 
@@ -2397,11 +2664,84 @@ long AVIReadHandler::ReadData(int stream, void *buffer, sint64 position, long le
 
 //    _RPT3(0,"Reading from file %d, position %I64x, size %d\n", nCurrentFile, position, len);
 
-    if (!mpCurrentFile->mFile.seekNT(position & 0x0000FFFFFFFFFFFFi64))
+    sint64 filePos = position & 0x0000FFFFFFFFFFFFi64;
+
+    if (mpCurrentFile->mpView) {
+        if (filePos >= mpCurrentFile->mFileSize)
+            return 0;
+
+        if (len > mpCurrentFile->mFileSize - filePos)
+            len = (long)(mpCurrentFile->mFileSize - filePos);
+
+        if (!VDCopyFromMappedView(buffer, mpCurrentFile->mpView + filePos, len))
+            return -1;
+
+        return len;
+    }
+
+    if (mpCurrentFile->mbRemote) {
+        // Serve sequential reads from one large read instead of a network
+        // round trip per chunk. Random access still reads only what's needed.
+        bool sequential = mLastReadEnd >= 0 && position >= mLastReadEnd && position - mLastReadEnd < READAHEAD_SIZE / 4;
+        bool buffered = position >= mReadAheadPos && position + len <= mReadAheadPos + mReadAheadSize;
+
+        mLastReadEnd = position + len;
+
+        if (!buffered && sequential && len < READAHEAD_SIZE / 2) {
+            mReadAheadBuffer.resize(READAHEAD_SIZE);
+            mReadAheadPos = -1;
+            mReadAheadSize = 0;
+
+            if (!mpCurrentFile->mFile.seekNT(filePos))
+                return -1;
+
+            long actual = mpCurrentFile->mFile.readData(mReadAheadBuffer.data(), READAHEAD_SIZE);
+            if (actual < 0)
+                return -1;
+
+            mReadAheadPos = position;
+            mReadAheadSize = actual;
+            buffered = true;
+
+            if (len > actual)
+                len = actual;
+        }
+
+        if (buffered) {
+            memcpy(buffer, mReadAheadBuffer.data() + (position - mReadAheadPos), len);
+            return len;
+        }
+    }
+
+    if (!mpCurrentFile->mFile.seekNT(filePos))
         return -1;
     return mpCurrentFile->mFile.readData(buffer, len);
 }
 
+bool AVIReadHandler::IsMapped() const {
+    for(AVIFileDesc *desc : mFiles) {
+        if (!desc->mpView)
+            return false;
+    }
+
+    return true;
+}
+
+const void *AVIReadHandler::GetMappedData(sint64 position, long len) const {
+    int file = (int)(position >> 48);
+
+    if (file >= (int)mFiles.size())
+        return nullptr;
+
+    const AVIFileDesc *desc = mFiles[file];
+    sint64 filePos = position & 0x0000FFFFFFFFFFFFi64;
+
+    if (!desc->mpView || filePos + len > desc->mFileSize)
+        return nullptr;
+
+    return desc->mpView + filePos;
+}
+
 void AVIReadHandler::SelectFile(int file) {
     mCurrentFile = file;
     mpCurrentFile = mFiles[file];
@@ -58,6 +58,12 @@ public:
     virtual sint32 Info(VDAVIStreamInfo *pasi)=0;
     virtual bool IsKeyFrame(VDPosition lFrame)=0;
     virtual sint32 Read(VDPosition lStart, long lSamples, void *lpBuffer, long cbBuffer, long *plBytes, long *plSamples)=0;
+
+    // Returns the sample's data straight from the mapped file, or nullptr if the
+    // file isn't mapped or the stream isn't made of discrete samples. The pointer
+    // stays valid for the lifetime of the handler and has at least 16 readable
+    // bytes past the end of the sample, which aren't guaranteed to be anything.
+    virtual const void *ReadDirect(VDPosition lStart, long *plBytes)=0;
     virtual VDPosition Start()=0;
     virtual VDPosition End()=0;
     virtual VDPosition PrevKeyFrame(VDPosition lFrame)=0;
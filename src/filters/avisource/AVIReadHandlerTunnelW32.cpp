@@ -75,6 +75,7 @@ public:
     sint32 Info(VDAVIStreamInfo *pasi);
     bool IsKeyFrame(VDPosition lFrame);
     sint32 Read(VDPosition lStart, long lSamples, void *lpBuffer, long cbBuffer, long *plBytes, long *plSamples);
+    const void *ReadDirect(VDPosition lStart, long *plBytes) { return nullptr; }
     VDPosition Start();
     VDPosition End();
     VDPosition PrevKeyFrame(VDPosition lFrame);
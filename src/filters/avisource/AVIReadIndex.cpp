@@ -318,6 +318,62 @@ void VDAVIReadIndex::Finalize() {
     mbFinalized = true;
 }
 
+void VDAVIReadIndex::Serialize(vdfastvector<uint8>& dst) const {
+    VDASSERT(mbFinalized);
+
+    size_t pos = dst.size();
+    dst.resize(pos + 4 + (size_t)mChunkCount * 12);
+
+    uint8 *p = dst.data() + pos;
+    memcpy(p, &mChunkCount, 4);
+    p += 4;
+
+    const SectorEntry *sec = &mSectors[0];
+    uint32 next = sec[1].mChunkOffset;
+    for(uint32 i=0; i<mChunkCount; ++i) {
+        if (i >= next) {
+            ++sec;
+            next = sec[1].mChunkOffset;
+        }
+
+        const IndexEntry& ient = mIndex[i >> kBlockSizeBits][i & kBlockMask];
+
+        sint64 bytePos = sec->mByteOffset + ient.mByteOffset;
+        memcpy(p, &bytePos, 8);
+        memcpy(p + 8, &ient.mSizeAndKeyFrameFlag, 4);
+        p += 12;
+    }
+}
+
+bool VDAVIReadIndex::Deserialize(const uint8 *&src, const uint8 *srcEnd) {
+    uint32 chunkCount;
+
+    if (srcEnd - src < 4)
+        return false;
+
+    memcpy(&chunkCount, src, 4);
+
+    if ((uint64)(srcEnd - src - 4) < (uint64)chunkCount * 12)
+        return false;
+
+    src += 4;
+
+    Clear();
+
+    for(uint32 i=0; i<chunkCount; ++i) {
+        sint64 bytePos;
+        uint32 sizeAndKeyFrameFlag;
+
+        memcpy(&bytePos, src, 8);
+        memcpy(&sizeAndKeyFrameFlag, src + 8, 4);
+        src += 12;
+
+        AddChunk(bytePos, sizeAndKeyFrameFlag);
+    }
+
+    return true;
+}
+
 uint32 VDAVIReadIndex::FindSectorIndexByChunk(uint32 chunk) const {
     uint32 lo = 0;
     uint32 hi = mSectorCount - 1;
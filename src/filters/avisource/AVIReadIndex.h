@@ -65,6 +65,12 @@ public:
     void    Append(const VDAVIReadIndex& src, sint64 bytePosOffset);
     void    Finalize();
 
+    // Stores the chunks of a finalized index so that Deserialize() can rebuild
+    // it without parsing the file again. The sample size isn't stored, the
+    // index has to be initialized with the same one before deserializing.
+    void    Serialize(vdfastvector<uint8>& dst) const;
+    bool    Deserialize(const uint8 *&src, const uint8 *srcEnd);
+
 protected:
     enum {
         kBlockSizeBits    = 10,
@@ -22,6 +22,8 @@
 // been rewritten during the porting
 
 #include <stdexcept>
+#include <mutex>
+#include <vector>
 #include "stdafx.h"
 
 #include "VapourSynth4.h"
@@ -75,6 +77,83 @@ static int ImageSize(const VSVideoInfo *vi, DWORD fourcc, int bitcount = 0) {
     return image_size;
 }
 
+static DWORD UpperFourCC(DWORD fourcc) {
+    DWORD upper = 0;
+    for (int i = 0; i < 32; i += 8) {
+        DWORD c = (fourcc >> i) & 0xFF;
+        if (c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        upper |= c << i;
+    }
+    return upper;
+}
+
+// MPEG-4 ASP decoders read past the end of the frame and rely on the guard bytes after it
+static bool NeedsGuardBytes(DWORD fourcc) {
+    switch (UpperFourCC(fourcc)) {
+    case VS_FCC('XVID'):
+    case VS_FCC('DIVX'):
+    case VS_FCC('DX50'):
+    case VS_FCC('MP4V'):
+    case VS_FCC('FMP4'):
+    case VS_FCC('3IV2'):
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Lossless intra-only codecs, every frame can be decoded on its own by any instance of the decompressor
+static bool IsIntraOnlyCodec(DWORD fourcc) {
+    switch (UpperFourCC(fourcc)) {
+    // HuffYUV, FFmpeg's HuffYUV and Lagarith
+    case VS_FCC('HFYU'):
+    case VS_FCC('FFVH'):
+    case VS_FCC('LAGS'):
+    // UT Video
+    case VS_FCC('ULRG'):
+    case VS_FCC('ULRA'):
+    case VS_FCC('ULY0'):
+    case VS_FCC('ULY2'):
+    case VS_FCC('ULY4'):
+    case VS_FCC('ULH0'):
+    case VS_FCC('ULH2'):
+    case VS_FCC('ULH4'):
+    case VS_FCC('UQY0'):
+    case VS_FCC('UQY2'):
+    case VS_FCC('UQRG'):
+    case VS_FCC('UQRA'):
+    case VS_FCC('UMY2'):
+    case VS_FCC('UMH2'):
+    case VS_FCC('UMY4'):
+    case VS_FCC('UMH4'):
+    case VS_FCC('UMRG'):
+    case VS_FCC('UMRA'):
+    // MagicYUV
+    case VS_FCC('M8RG'):
+    case VS_FCC('M8RA'):
+    case VS_FCC('M8Y0'):
+    case VS_FCC('M8Y2'):
+    case VS_FCC('M8Y4'):
+    case VS_FCC('M8YA'):
+    case VS_FCC('M8G0'):
+    case VS_FCC('M0RG'):
+    case VS_FCC('M0RA'):
+    case VS_FCC('M0R0'):
+    case VS_FCC('M0Y2'):
+    case VS_FCC('M0G0'):
+    case VS_FCC('M2RG'):
+    case VS_FCC('M2RA'):
+    case VS_FCC('M2Y0'):
+    case VS_FCC('M2Y2'):
+    case VS_FCC('M2Y4'):
+    case VS_FCC('M2YA'):
+        return true;
+    default:
+        return false;
+    }
+}
+
 static void unpackframe(const VSVideoInfo *vi, VSFrame *dst, VSFrame *dst_alpha, const uint8_t *srcp, int src_size, DWORD fourcc, int bitcount, bool flip, const VSAPI *vsapi) {
     bool padrows = false;
 
@@ -171,27 +250,52 @@ static void unpackframe(const VSVideoInfo *vi, VSFrame *dst, VSFrame *dst_alpha,
 }
 
 class AVISource {
+    // A decompressor instance and its buffers. The primary one uses hic and pbiSrc,
+    // the ones opened for parallel decoding have their own copy of the format since
+    // biSizeImage is changed for every frame.
+    struct Decoder {
+        HIC hic;
+        BITMAPINFOHEADER* pbiSrc;
+        BYTE* srcbuffer;
+        int srcbuffer_size;
+        BYTE* decbuf;
+    };
+
     IAVIReadHandler *pfile;
     IAVIReadStream *pvideo;
     HIC hic;
     VSVideoInfo vi[2];
-    BYTE* srcbuffer;
-    int srcbuffer_size;
+    Decoder primary;
     BITMAPINFOHEADER* pbiSrc;
+    long pbiSrcSize;
     BITMAPINFOHEADER biDst;
     bool ex;
     bool bIsType1;
     bool bInvertFrames;
+    bool bNeedsGuardBytes;
+    bool bParallel;
     char buf[1024];
-    BYTE* decbuf;
     bool output_alpha;
 
     VSFrame *last_frame;
     VSFrame *last_alpha_frame;
     int last_frame_no;
 
+    // Intra-only streams are decoded in parallel with a pool of decompressors,
+    // the read handler itself can only be used by one thread at a time
+    std::mutex read_lock;
+    std::mutex decoder_lock;
+    std::vector<Decoder *> idle_decoders;
+    std::vector<Decoder *> extra_decoders;
+
     LRESULT DecompressBegin(LPBITMAPINFOHEADER lpbiSrc, LPBITMAPINFOHEADER lpbiDst);
-    LRESULT DecompressFrame(int n, bool preroll, bool &dropped_frame, VSFrame *frame, VSFrame *alpha, VSCore *core, const VSAPI *vsapi);
+    LRESULT DecompressFrame(Decoder &dec, int n, bool preroll, bool &dropped_frame, VSFrame *frame, VSFrame *alpha, VSCore *core, const VSAPI *vsapi);
+    const BYTE *ReadCompressedFrame(Decoder &dec, int n, long &bytes_read);
+    Decoder *CreateDecoder();
+    void FreeDecoder(Decoder *dec);
+    Decoder *AcquireDecoder();
+    void ReleaseDecoder(Decoder *dec);
+    const VSFrame *GetFrameParallel(int n, VSCore *core, const VSAPI *vsapi);
 
     void CheckHresult(HRESULT hr, const char* msg, VSCore *core, const VSAPI *vsapi);
     bool AttemptCodecNegotiation(DWORD fccHandler, BITMAPINFOHEADER* bmih);
@@ -225,8 +329,9 @@ public:
             bool output_alpha = !!vsapi->mapGetInt(in, "alpha", 0, &err);
 
             AVISource *avs = new AVISource(path, pixel_type, fourCC, output_alpha, static_cast<int>(mode), core, vsapi);
-            VSNode *node = vsapi->createVideoFilter2("AVISource", avs->vi, filterGetFrame, filterFree, fmUnordered, nullptr, 0, static_cast<void *>(avs), core);
-            vsapi->setLinearFilter(node);
+            VSNode *node = vsapi->createVideoFilter2("AVISource", avs->vi, filterGetFrame, filterFree, avs->bParallel ? fmParallel : fmUnordered, nullptr, 0, static_cast<void *>(avs), core);
+            if (!avs->bParallel)
+                vsapi->setLinearFilter(node);
             vsapi->mapConsumeNode(out, "clip", node, maAppend);
         } catch (std::runtime_error &e) {
             vsapi->mapSetError(out, e.what());
@@ -293,50 +398,144 @@ LRESULT AVISource::DecompressBegin(LPBITMAPINFOHEADER lpbiSrc, LPBITMAPINFOHEADE
         lpbiDst, 0, 0, 0, lpbiDst->biWidth, lpbiDst->biHeight);
 }
 
-LRESULT AVISource::DecompressFrame(int n, bool preroll, bool &dropped_frame, VSFrame *frame, VSFrame *alpha, VSCore *core, const VSAPI *vsapi) {
+LRESULT AVISource::DecompressFrame(Decoder &dec, int n, bool preroll, bool &dropped_frame, VSFrame *frame, VSFrame *alpha, VSCore *core, const VSAPI *vsapi) {
     _RPT2(0,"AVISource: Decompressing frame %d%s\n", n, preroll ? " (preroll)" : "");
     long bytes_read;
-    if (!hic) {
-        bytes_read = pbiSrc->biSizeImage;
-        pvideo->Read(n, 1, decbuf, pbiSrc->biSizeImage, &bytes_read, nullptr);
+    if (!dec.hic) {
+        // unpacking always reads a whole frame so only complete frames can come straight from the mapped file
+        const uint8_t *direct = static_cast<const uint8_t *>(pvideo->ReadDirect(n, &bytes_read));
+        if (direct && bytes_read == (long)dec.pbiSrc->biSizeImage) {
+            dropped_frame = false;
+            unpackframe(vi, frame, alpha, direct, bytes_read, dec.pbiSrc->biCompression, dec.pbiSrc->biBitCount, bInvertFrames, vsapi);
+            return ICERR_OK;
+        }
+        bytes_read = dec.pbiSrc->biSizeImage;
+        {
+            std::lock_guard<std::mutex> lock(read_lock);
+            pvideo->Read(n, 1, dec.decbuf, dec.pbiSrc->biSizeImage, &bytes_read, nullptr);
+        }
         dropped_frame = !bytes_read;
-        unpackframe(vi, frame, alpha, decbuf, bytes_read, pbiSrc->biCompression, pbiSrc->biBitCount, bInvertFrames, vsapi);
+        unpackframe(vi, frame, alpha, dec.decbuf, bytes_read, dec.pbiSrc->biCompression, dec.pbiSrc->biBitCount, bInvertFrames, vsapi);
         return ICERR_OK;
     }
-    bytes_read = srcbuffer_size;
-    LRESULT err = pvideo->Read(n, 1, srcbuffer, srcbuffer_size, &bytes_read, nullptr);
-    while (err == AVIERR_BUFFERTOOSMALL || (err == 0 && !srcbuffer)) {
-        delete[] srcbuffer;
-        pvideo->Read(n, 1, 0, srcbuffer_size, &bytes_read, nullptr);
-        srcbuffer_size = bytes_read;
-        srcbuffer = new BYTE[bytes_read + 16]; // Provide 16 hidden guard bytes for HuffYUV, Xvid, etc bug
-        err = pvideo->Read(n, 1, srcbuffer, srcbuffer_size, &bytes_read, nullptr);
-    }
+
+    // Decoders that read past the end of the frame expect the guard bytes below to be
+    // filled in, everything else can decompress straight from the mapped file
+    const BYTE *src = nullptr;
+    if (!bNeedsGuardBytes)
+        src = static_cast<const BYTE *>(pvideo->ReadDirect(n, &bytes_read));
+
+    if (!src)
+        src = ReadCompressedFrame(dec, n, bytes_read);
     dropped_frame = !bytes_read;
     if (dropped_frame) return ICERR_OK;  // If frame is 0 bytes (dropped), return instead of attempt decompressing as Vdub.
 
-    // Fill guard bytes with 0xA5's for Xvid bug
-    memset(srcbuffer + bytes_read, 0xA5, 16);
-    // and a Null terminator for good measure
-    srcbuffer[bytes_read + 15] = 0;
-
     int flags = preroll ? ICDECOMPRESS_PREROLL : 0;
     flags |= dropped_frame ? ICDECOMPRESS_NULLFRAME : 0;
     flags |= !pvideo->IsKeyFrame(n) ? ICDECOMPRESS_NOTKEYFRAME : 0;
-    pbiSrc->biSizeImage = bytes_read;
-    LRESULT ret = (!ex ? ICDecompress(hic, flags, pbiSrc, srcbuffer, &biDst, decbuf)
-        : ICDecompressEx(hic, flags, pbiSrc, srcbuffer, 0, 0, vi[0].width, vi[0].height, &biDst, decbuf, 0, 0, vi[0].width, vi[0].height));
+    dec.pbiSrc->biSizeImage = bytes_read;
+    LRESULT ret = (!ex ? ICDecompress(dec.hic, flags, dec.pbiSrc, const_cast<BYTE *>(src), &biDst, dec.decbuf)
+        : ICDecompressEx(dec.hic, flags, dec.pbiSrc, const_cast<BYTE *>(src), 0, 0, vi[0].width, vi[0].height, &biDst, dec.decbuf, 0, 0, vi[0].width, vi[0].height));
 
     if (ret != ICERR_OK)
         return ret;
 
-    unpackframe(vi, frame, alpha, decbuf, 0, biDst.biCompression, biDst.biBitCount, bInvertFrames, vsapi);
+    unpackframe(vi, frame, alpha, dec.decbuf, 0, biDst.biCompression, biDst.biBitCount, bInvertFrames, vsapi);
 
     vsapi->mapSetData(vsapi->getFramePropertiesRW(frame), "_PictType", pvideo->IsKeyFrame(n) ? "I" : "P", 1, dtUtf8, maAppend);
 
     return ICERR_OK;
 }
 
+const BYTE *AVISource::ReadCompressedFrame(Decoder &dec, int n, long &bytes_read) {
+    std::lock_guard<std::mutex> lock(read_lock);
+    bytes_read = dec.srcbuffer_size;
+    LRESULT err = pvideo->Read(n, 1, dec.srcbuffer, dec.srcbuffer_size, &bytes_read, nullptr);
+    while (err == AVIERR_BUFFERTOOSMALL || (err == 0 && !dec.srcbuffer)) {
+        delete[] dec.srcbuffer;
+        pvideo->Read(n, 1, 0, dec.srcbuffer_size, &bytes_read, nullptr);
+        dec.srcbuffer_size = bytes_read;
+        dec.srcbuffer = new BYTE[bytes_read + 16]; // Provide 16 hidden guard bytes for HuffYUV, Xvid, etc bug
+        err = pvideo->Read(n, 1, dec.srcbuffer, dec.srcbuffer_size, &bytes_read, nullptr);
+    }
+    if (!bytes_read)
+        return dec.srcbuffer;
+
+    // Fill guard bytes with 0xA5's for Xvid bug
+    memset(dec.srcbuffer + bytes_read, 0xA5, 16);
+    // and a Null terminator for good measure
+    dec.srcbuffer[bytes_read + 15] = 0;
+
+    return dec.srcbuffer;
+}
+
+AVISource::Decoder *AVISource::CreateDecoder() {
+    Decoder *dec = new Decoder();
+
+    dec->pbiSrc = static_cast<BITMAPINFOHEADER *>(malloc(pbiSrcSize));
+    memcpy(dec->pbiSrc, pbiSrc, pbiSrcSize);
+
+    if (hic) {
+        // open the same driver the primary decompressor came from
+        ICINFO info = {};
+        info.dwSize = sizeof(info);
+        if (ICGetInfo(hic, &info, sizeof(info)))
+            dec->hic = ICOpen(ICTYPE_VIDEO, info.fccHandler, ICMODE_DECOMPRESS);
+
+        LRESULT result = ICERR_ERROR;
+        if (dec->hic)
+            result = !ex ? ICDecompressBegin(dec->hic, dec->pbiSrc, &biDst)
+                : ICDecompressExBegin(dec->hic, 0, dec->pbiSrc, 0, 0, 0, dec->pbiSrc->biWidth, dec->pbiSrc->biHeight, &biDst, 0, 0, 0, biDst.biWidth, biDst.biHeight);
+
+        if (result != ICERR_OK) {
+            if (dec->hic)
+                ICClose(dec->hic);
+            free(dec->pbiSrc);
+            delete dec;
+            return nullptr;
+        }
+    }
+
+    dec->decbuf = vsh_aligned_malloc<BYTE>(hic ? biDst.biSizeImage : pbiSrc->biSizeImage, 32);
+    return dec;
+}
+
+void AVISource::FreeDecoder(Decoder *dec) {
+    if (dec->hic) {
+        !ex ? ICDecompressEnd(dec->hic) : ICDecompressExEnd(dec->hic);
+        ICClose(dec->hic);
+    }
+    free(dec->pbiSrc);
+    delete[] dec->srcbuffer;
+    vsh_aligned_free(dec->decbuf);
+    delete dec;
+}
+
+AVISource::Decoder *AVISource::AcquireDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(decoder_lock);
+        if (!idle_decoders.empty()) {
+            Decoder *dec = idle_decoders.back();
+            idle_decoders.pop_back();
+            return dec;
+        }
+    }
+
+    // Opening a decompressor can take a while so it's done without holding the lock
+    Decoder *dec = CreateDecoder();
+    if (!dec)
+        throw std::runtime_error("AVISource: couldn't open another instance of the video decompressor");
+
+    std::lock_guard<std::mutex> lock(decoder_lock);
+    extra_decoders.push_back(dec);
+    return dec;
+}
+
+void AVISource::ReleaseDecoder(Decoder *dec) {
+    std::lock_guard<std::mutex> lock(decoder_lock);
+    idle_decoders.push_back(dec);
+}
+
 
 void AVISource::CheckHresult(HRESULT hr, const char* msg, VSCore *core, const VSAPI *vsapi) {
     if (SUCCEEDED(hr)) return;
@@ -382,13 +581,13 @@ bool AVISource::AttemptCodecNegotiation(DWORD fccHandler, BITMAPINFOHEADER* bmih
 void AVISource::LocateVideoCodec(const char fourCC[], VSCore *core, const VSAPI *vsapi) {
     VDAVIStreamInfo asi;
     CheckHresult(pvideo->Info(&asi), "couldn't get video info", core, vsapi);
-    long size = sizeof(BITMAPINFOHEADER);
+    pbiSrcSize = sizeof(BITMAPINFOHEADER);
 
     // Read video format.  If it's a
     // type-1 DV, we're going to have to fake it.
 
     if (bIsType1) {
-        pbiSrc = (BITMAPINFOHEADER *)malloc(size);
+        pbiSrc = (BITMAPINFOHEADER *)malloc(pbiSrcSize);
         if (!pbiSrc)
             throw std::runtime_error("AviSource: Could not allocate BITMAPINFOHEADER.");
 
@@ -410,9 +609,9 @@ void AVISource::LocateVideoCodec(const char fourCC[], VSCore *core, const VSAPI
         pbiSrc->biClrImportant  = 0;
 
     } else {
-        CheckHresult(pvideo->ReadFormat(0, 0, &size), "couldn't get video format size", core, vsapi);
-        pbiSrc = (LPBITMAPINFOHEADER)malloc(size);
-        CheckHresult(pvideo->ReadFormat(0, pbiSrc, &size), "couldn't get video format", core, vsapi);
+        CheckHresult(pvideo->ReadFormat(0, 0, &pbiSrcSize), "couldn't get video format size", core, vsapi);
+        pbiSrc = (LPBITMAPINFOHEADER)malloc(pbiSrcSize);
+        CheckHresult(pvideo->ReadFormat(0, pbiSrc, &pbiSrcSize), "couldn't get video format", core, vsapi);
     }
 
     vi[0].width = pbiSrc->biWidth;
@@ -494,10 +693,11 @@ void AVISource::LocateVideoCodec(const char fourCC[], VSCore *core, const VSAPI
 
 
 AVISource::AVISource(const char filename[], const char pixel_type[], const char fourCC[], bool output_alpha, int mode, VSCore *core, const VSAPI *vsapi)
-    : output_alpha(output_alpha), last_frame_no(-1), last_frame(nullptr), last_alpha_frame(nullptr), srcbuffer(nullptr), srcbuffer_size(0), ex(false), pbiSrc(nullptr),
-    pvideo(nullptr), pfile(nullptr), bIsType1(false), hic(0), bInvertFrames(false), decbuf(nullptr)  {
+    : output_alpha(output_alpha), last_frame_no(-1), last_frame(nullptr), last_alpha_frame(nullptr), ex(false), pbiSrc(nullptr), pbiSrcSize(0),
+    pvideo(nullptr), pfile(nullptr), bIsType1(false), hic(0), bInvertFrames(false), bNeedsGuardBytes(true), bParallel(false)  {
     vi[0] = {};
     vi[1] = {};
+    primary = {};
 
     AVIFileInit();
 
@@ -542,6 +742,7 @@ AVISource::AVISource(const char filename[], const char pixel_type[], const char
 
             if (pvideo) {
                 LocateVideoCodec(fourCC, core, vsapi);
+                bNeedsGuardBytes = NeedsGuardBytes(pbiSrc->biCompression);
                 if (hic) {
                     bool forcedType = !(pixel_type[0] == 0);
                     
@@ -645,13 +846,15 @@ AVISource::AVISource(const char filename[], const char pixel_type[], const char
         bool dropped_frame = false;
 
         if (mode != MODE_WAV) {
-            decbuf = vsh_aligned_malloc<BYTE>(hic ? biDst.biSizeImage : pbiSrc->biSizeImage, 32);
+            primary.hic = hic;
+            primary.pbiSrc = pbiSrc;
+            primary.decbuf = vsh_aligned_malloc<BYTE>(hic ? biDst.biSizeImage : pbiSrc->biSizeImage, 32);
             int keyframe = pvideo->NearestKeyFrame(0);
             VSFrame *frame = vsapi->newVideoFrame(&vi[0].format, vi[0].width, vi[0].height, nullptr, core);
             VSFrame *alpha_frame = nullptr;
             if (output_alpha)
                 alpha_frame = vsapi->newVideoFrame(&vi[1].format, vi[1].width, vi[1].height, nullptr, core);
-            LRESULT error = DecompressFrame(keyframe, false, dropped_frame, frame, alpha_frame, core, vsapi);
+            LRESULT error = DecompressFrame(primary, keyframe, false, dropped_frame, frame, alpha_frame, core, vsapi);
             if (error != ICERR_OK)   // shutdown, if init not succesful.
                 throw std::runtime_error("AviSource: Could not decompress frame 0");
 
@@ -659,7 +862,7 @@ AVISource::AVISource(const char filename[], const char pixel_type[], const char
             // frames, just return the first key frame
             if (dropped_frame) {
                 keyframe = pvideo->NextKeyFrame(0);
-                error = DecompressFrame(keyframe, false, dropped_frame, frame, alpha_frame, core, vsapi);
+                error = DecompressFrame(primary, keyframe, false, dropped_frame, frame, alpha_frame, core, vsapi);
                 if (error != ICERR_OK) {   // shutdown, if init not succesful.
                     sprintf(buf, "AviSource: Could not decompress first keyframe %d", keyframe);
                     throw std::runtime_error(buf);
@@ -669,6 +872,18 @@ AVISource::AVISource(const char filename[], const char pixel_type[], const char
             last_frame_no=0;
             last_frame=frame;
             last_alpha_frame = alpha_frame;
+
+            // Every frame of an intra-only stream can be decoded on its own so they're
+            // handed out to a pool of decompressors, if the codec allows opening more
+            if (!bIsType1 && (!hic || pvideo->isKeyframeOnly() || IsIntraOnlyCodec(pbiSrc->biCompression))) {
+                Decoder *dec = CreateDecoder();
+                if (dec) {
+                    extra_decoders.push_back(dec);
+                    idle_decoders.push_back(dec);
+                    idle_decoders.push_back(&primary);
+                    bParallel = true;
+                }
+            }
         }
     } catch (std::runtime_error &) {
         AVISource::CleanUp(vsapi);
@@ -689,8 +904,10 @@ void AVISource::CleanUp(const VSAPI *vsapi) {
         pfile->Release();
     AVIFileExit();
     free(pbiSrc);
-    delete[] srcbuffer;
-    vsh_aligned_free(decbuf);
+    delete[] primary.srcbuffer;
+    vsh_aligned_free(primary.decbuf);
+    for (Decoder *dec : extra_decoders)
+        FreeDecoder(dec);
 
     vsapi->freeFrame(last_frame);
     vsapi->freeFrame(last_alpha_frame);
@@ -698,6 +915,9 @@ void AVISource::CleanUp(const VSAPI *vsapi) {
 
 const VSFrame *AVISource::GetFrame(int n, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     n = min(max(n, 0), vi[0].numFrames - 1);
+    if (bParallel)
+        return GetFrameParallel(n, core, vsapi);
+
     bool dropped_frame = false;
     if (n != last_frame_no || !last_frame) {
         // find the last keyframe
@@ -718,7 +938,7 @@ const VSFrame *AVISource::GetFrame(int n, VSFrameContext *frameCtx, VSCore *core
                     frame = vsapi->newVideoFrame(&vi[0].format, vi[0].width, vi[0].height, nullptr, core);
                 if (output_alpha && !alpha_frame)
                     alpha_frame = vsapi->newVideoFrame(&vi[1].format, vi[1].width, vi[1].height, nullptr, core);
-                LRESULT error = DecompressFrame(i, i != n, dropped_frame, frame, alpha_frame, core, vsapi);
+                LRESULT error = DecompressFrame(primary, i, i != n, dropped_frame, frame, alpha_frame, core, vsapi);
                 if ((!dropped_frame) && (error == ICERR_OK))
                     frameok = true;   // Better safe than sorry
                 if (frameok) {
@@ -757,6 +977,34 @@ const VSFrame *AVISource::GetFrame(int n, VSFrameContext *frameCtx, VSCore *core
     return vsapi->addFrameRef(last_frame);
 }
 
+const VSFrame *AVISource::GetFrameParallel(int n, VSCore *core, const VSAPI *vsapi) {
+    VSFrame *frame = vsapi->newVideoFrame(&vi[0].format, vi[0].width, vi[0].height, nullptr, core);
+    VSFrame *alpha_frame = nullptr;
+    if (output_alpha)
+        alpha_frame = vsapi->newVideoFrame(&vi[1].format, vi[1].width, vi[1].height, nullptr, core);
+
+    Decoder *dec = AcquireDecoder();
+
+    // Dropped frames repeat the closest earlier frame that has data
+    bool dropped_frame = true;
+    LRESULT error = ICERR_OK;
+    for (int i = n; i >= 0 && dropped_frame && error == ICERR_OK; i--)
+        error = DecompressFrame(*dec, i, false, dropped_frame, frame, alpha_frame, core, vsapi);
+
+    ReleaseDecoder(dec);
+
+    if (dropped_frame || error != ICERR_OK) {
+        vsapi->freeFrame(frame);
+        vsapi->freeFrame(alpha_frame);
+        throw std::runtime_error("AVISource: failed to decode frame " + std::to_string(n));
+    }
+
+    if (output_alpha)
+        vsapi->mapConsumeFrame(vsapi->getFramePropertiesRW(frame), "_Alpha", alpha_frame, maAppend);
+
+    return frame;
+}
+
 //////////////////////////////////////////
 // Init
 
@@ -25,13 +25,58 @@
 
 #define _POSIX_C_SOURCE 200112L
 #include <float.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
+#include "eedi3.h"
+#include "../../core/cpufeatures.h"
+#include "../../core/kernel/cpulevel.h"
+
+typedef void (*SadRowFunc)(const uint8_t * const t[3], const uint8_t * const b[3], int nrad, uint16_t *dst, int n);
+typedef void (*CostRowFunc)(const uint16_t *s0, const uint16_t *s1, const uint16_t *s2, const uint8_t *ip0, const uint8_t *ip1,
+                            const uint8_t *c0, const uint8_t *c1, float alpha, float bu, float cv, float *dst, int n);
+typedef void (*PathRowFunc)(const float *ppT, const float *tT, ptrdiff_t tstride, float *pT, int *piT, int umax, int umax2, int r, const float pen[3]);
+
+typedef struct {
+    SadRowFunc sadRow;
+    CostRowFunc costRow;
+    PathRowFunc pathRow;
+} eedi3Kernels;
+
+#ifdef _WIN32
+typedef SRWLOCK eedi3Lock;
+#define eedi3LockInit(l) InitializeSRWLock(l)
+#define eedi3LockDestroy(l) ((void)(l))
+#define eedi3LockAcquire(l) AcquireSRWLockExclusive(l)
+#define eedi3LockRelease(l) ReleaseSRWLockExclusive(l)
+#else
+typedef pthread_mutex_t eedi3Lock;
+#define eedi3LockInit(l) pthread_mutex_init((l), NULL)
+#define eedi3LockDestroy(l) pthread_mutex_destroy(l)
+#define eedi3LockAcquire(l) pthread_mutex_lock(l)
+#define eedi3LockRelease(l) pthread_mutex_unlock(l)
+#endif
+
+// Header of a pooled line workspace, the workspace itself starts WORKSPACE_OFFSET bytes later.
+typedef struct eedi3Workspace {
+    struct eedi3Workspace *next;
+} eedi3Workspace;
+
+#define WORKSPACE_OFFSET 64
+
+// Rough number of cost values (width * directions) a slice should cover so scheduling stays cheap
+#define SLICE_MIN_WORK (1 << 18)
 
 typedef struct {
     VSNode *node;
@@ -43,117 +88,193 @@ typedef struct {
     int planes;
     float alpha, beta, gamma,  vthresh0, vthresh1, vthresh2;
     int field, nrad, mdis, vcheck;
+
+    eedi3Kernels kernels;
+
+    eedi3Lock workspaceLock;
+    eedi3Workspace *workspaces;
 } eedi3Data;
 
+void eedi3_sad_row_c(const uint8_t * const t[3], const uint8_t * const b[3], int nrad, uint16_t *dst, int n)
+{
+    int i, k;
+
+    for(i = 0; i < n; ++i) {
+        int s = 0;
+
+        for(k = i - nrad; k <= i + nrad; ++k)
+            s += abs(t[0][k] - b[0][k]) + abs(t[1][k] - b[1][k]) + abs(t[2][k] - b[2][k]);
+
+        dst[i] = s;
+    }
+}
+
+
+void eedi3_cost_row_c(const uint16_t *s0, const uint16_t *s1, const uint16_t *s2, const uint8_t *ip0, const uint8_t *ip1,
+                      const uint8_t *c0, const uint8_t *c1, float alpha, float bu, float cv, float *dst, int n)
+{
+    int i;
+
+    for(i = 0; i < n; ++i) {
+        const int ip = (ip0[i] + ip1[i] + 1) >> 1; // should use cubic if ucubic=true
+        const int v = abs(c0[i] - ip) + abs(c1[i] - ip);
+
+        if(s1)
+            dst[i] = alpha * (s0[i] + s1[i] + s2[i]) * 0.333333f + bu + cv * v;
+        else
+            dst[i] = alpha * s0[i] + bu + cv * v;
+    }
+}
+
+
+void eedi3_path_row_c(const float *ppT, const float *tT, ptrdiff_t tstride, float *pT, int *piT, int umax, int umax2, int r, const float pen[3])
+{
+    const float maxCost = (float)(FLT_MAX * 0.9);
+    int u, v;
+
+    // float gives the same results as the double precision sums this was
+    // written with, double is wide enough that rounding twice is harmless
+    for(u = -umax; u <= umax; ++u) {
+        int idx = 0;
+        float bval = FLT_MAX;
+
+        for(v = VSMAX(-umax2, u - r); v <= VSMIN(umax2, u + r); ++v) {
+            const float ccost = VSMIN(ppT[v] + pen[abs(u - v)], maxCost);
+
+            if(ccost < bval) {
+                bval = ccost;
+                idx = v;
+            }
+        }
+
+        pT[u] = VSMIN(bval + tT[u * tstride], maxCost);
+
+        piT[u] = idx;
+    }
+}
+
+
+// Connection costs (one row of width per direction), path costs, backtracking
+// and the final path, then two rows of neighborhood sums and the half pel lines.
+static size_t workspaceSize(int width, int mdis, int hp)
+{
+    const size_t tpitch = hp ? mdis * 4 + 1 : mdis * 2 + 1;
+    return (tpitch * 3 + 1) * width * sizeof(float) + (width + mdis * 2) * 2 * sizeof(uint16_t) + (width + 8) * 4;
+}
+
+// Workspaces are kept until the filter is freed so there are never more of them
+// than threads that have worked on the filter at the same time.
+static float *acquireWorkspace(eedi3Data *d)
+{
+    eedi3Workspace *ws;
+
+    eedi3LockAcquire(&d->workspaceLock);
+    ws = d->workspaces;
+    if (ws)
+        d->workspaces = ws->next;
+    eedi3LockRelease(&d->workspaceLock);
+
+    if (!ws) {
+        VSH_ALIGNED_MALLOC((void **)&ws, WORKSPACE_OFFSET + workspaceSize(d->vi.width, d->mdis, d->hp), 64);
+        if (!ws)
+            return NULL;
+    }
+
+    return (float *)((uint8_t *)ws + WORKSPACE_OFFSET);
+}
+
+static void releaseWorkspace(eedi3Data *d, float *workspace)
+{
+    eedi3Workspace *ws = (eedi3Workspace *)((uint8_t *)workspace - WORKSPACE_OFFSET);
+
+    eedi3LockAcquire(&d->workspaceLock);
+    ws->next = d->workspaces;
+    d->workspaces = ws;
+    eedi3LockRelease(&d->workspaceLock);
+}
+
+
 static void interpLineFP(const uint8_t *srcp, const int width, const ptrdiff_t pitch,
                          const float alpha, const float beta, const float gamma, const int nrad,
                          const int mdis, float *temp, uint8_t *dstp, int *dmap, const int ucubic,
-                         const int cost3)
+                         const int cost3, const eedi3Kernels *k)
 {
     const uint8_t *src3p = srcp - 3 * pitch;
     const uint8_t *src1p = srcp - 1 * pitch;
     const uint8_t *src1n = srcp + 1 * pitch;
     const uint8_t *src3n = srcp + 3 * pitch;
     const ptrdiff_t tpitch = mdis * 2 + 1;
+    const float cv = 1.0f - alpha - beta;
     float *ccosts = temp;
     float *pcosts = ccosts + width * tpitch;
     int *pbackt = (int *)(pcosts + width * tpitch);
     int *fpath = pbackt + width * tpitch;
+    uint16_t *sad = (uint16_t *)(fpath + width) + mdis;
+
+    int i, u, x;
 
-    int k, u, v, x;
+    // calculate all connection costs, one direction at a time. The 3 neighborhood
+    // sums of pixel x are the sums of direction u at x + u, x and x + u * 2.
+    for(u = -mdis; u <= mdis; ++u) {
+        const int xlo = abs(u);
+        const int xhi = width - 1 - abs(u);
 
-    // calculate all connection costs
-    if(!cost3) {
-        for(x = 0; x < width; ++x) {
-            const int umax = VSMIN(VSMIN(x, width - 1 - x), mdis);
+        if(xlo > xhi)
+            continue;
 
-            for(u = -umax; u <= umax; ++u) {
-                int s = 0;
+        // the second neighborhood only exists inside [v0, v1), elsewhere the
+        // third one is used twice. The third one always exists.
+        const int v0 = VSMIN(VSMAX(xlo, u * 2), xhi + 1);
+        const int v1 = VSMAX(VSMIN(xhi, width - 1 + u * 2) + 1, v0);
+        int lo = xlo + u, hi = xhi + u;
 
-                for(k = -nrad; k <= nrad; ++k)
-                    s +=
-                        abs(src3p[x + u + k] - src1p[x - u + k]) +
-                        abs(src1p[x + u + k] - src1n[x - u + k]) +
-                        abs(src1n[x + u + k] - src3n[x - u + k]);
+        if(cost3) {
+            lo = VSMIN(lo, xlo + u * 2);
+            hi = VSMAX(hi, xhi + u * 2);
 
-                const int ip = (src1p[x + u] + src1n[x - u] + 1) >> 1; // should use cubic if ucubic=true
-                const int v = abs(src1p[x] - ip) + abs(src1n[x] - ip);
-                ccosts[x * tpitch + mdis + u] = alpha * s + beta * abs(u) + (1.0f - alpha - beta) * v;
+            if(v0 < v1) {
+                lo = VSMIN(lo, v0);
+                hi = VSMAX(hi, v1 - 1);
             }
         }
-    } else {
-        for(x = 0; x < width; ++x) {
-            const int umax = VSMIN(VSMIN(x, width - 1 - x), mdis);
-
-            for(u = -umax; u <= umax; ++u) {
-                int s0 = 0, s1 = -1, s2 = -1;
-
-                for(k = -nrad; k <= nrad; ++k)
-                    s0 +=
-                        abs(src3p[x + u + k] - src1p[x - u + k]) +
-                        abs(src1p[x + u + k] - src1n[x - u + k]) +
-                        abs(src1n[x + u + k] - src3n[x - u + k]);
-
-                if((u >= 0 && x >= u * 2) || (u <= 0 && x < width + u * 2)) {
-                    s1 = 0;
-
-                    for(k = -nrad; k <= nrad; ++k)
-                        s1 +=
-                            abs(src3p[x + k] - src1p[x - u * 2 + k]) +
-                            abs(src1p[x + k] - src1n[x - u * 2 + k]) +
-                            abs(src1n[x + k] - src3n[x - u * 2 + k]);
-                }
 
-                if((u <= 0 && x >= u * 2) || (u >= 0 && x < width + u * 2)) {
-                    s2 = 0;
+        {
+            const uint8_t * const t[3] = { src3p + lo, src1p + lo, src1n + lo };
+            const uint8_t * const b[3] = { src1p + lo - u * 2, src1n + lo - u * 2, src3n + lo - u * 2 };
 
-                    for(k = -nrad; k <= nrad; ++k)
-                        s2 +=
-                            abs(src3p[x + u * 2 + k] - src1p[x + k]) +
-                            abs(src1p[x + u * 2 + k] - src1n[x + k]) +
-                            abs(src1n[x + u * 2 + k] - src3n[x + k]);
-                }
+            k->sadRow(t, b, nrad, sad + lo, hi - lo + 1);
+        }
+
+        float *tT = ccosts + (mdis + u) * width;
+        const float bu = beta * abs(u);
+
+        if(!cost3) {
+            k->costRow(sad + xlo + u, NULL, NULL, src1p + xlo + u, src1n + xlo - u, src1p + xlo, src1n + xlo,
+                    alpha, bu, cv, tT + xlo, xhi - xlo + 1);
+        } else {
+            const int seg[4] = { xlo, v0, v1, xhi + 1 };
+
+            for(i = 0; i < 3; ++i) {
+                const int x0 = seg[i];
 
-                s1 = s1 >= 0 ? s1 : (s2 >= 0 ? s2 : s0);
-                s2 = s2 >= 0 ? s2 : (s1 >= 0 ? s1 : s0);
-                const int ip = (src1p[x + u] + src1n[x - u] + 1) >> 1; // should use cubic if ucubic=true
-                const int v = abs(src1p[x] - ip) + abs(src1n[x] - ip);
-                ccosts[x * tpitch + mdis + u] = alpha * (s0 + s1 + s2) * 0.333333f + beta * abs(u) + (1.0f - alpha - beta) * v;
+                if(seg[i + 1] > x0)
+                    k->costRow(sad + x0 + u, sad + x0 + (i == 1 ? 0 : u * 2), sad + x0 + u * 2, src1p + x0 + u, src1n + x0 - u,
+                            src1p + x0, src1n + x0, alpha, bu, cv, tT + x0, seg[i + 1] - x0);
             }
         }
     }
 
     // calculate path costs
-    pcosts[mdis] = ccosts[mdis];
+    pcosts[mdis] = ccosts[mdis * width];
+
+    const float pen[3] = { gamma * 0, gamma * 1, gamma * 2 };
 
     for(x = 1; x < width; ++x) {
-        float *tT = ccosts + x * tpitch;
-        float *ppT = pcosts + (x - 1) * tpitch;
-        float *pT = pcosts + x * tpitch;
-        int *piT = pbackt + (x - 1) * tpitch;
         const int umax = VSMIN(VSMIN(x, width - 1 - x), mdis);
+        const int umax2 = VSMIN(VSMIN(x - 1, width - x), mdis);
 
-        for(u = -umax; u <= umax; ++u) {
-            int idx = 0;
-            float bval = FLT_MAX;
-            const int umax2 = VSMIN(VSMIN(x - 1, width - x), mdis);
-
-            for(v = VSMAX(-umax2, u - 1); v <= VSMIN(umax2, u + 1); ++v) {
-                const double y = ppT[mdis + v] + gamma * abs(u - v);
-                const float ccost = (float)VSMIN(y, FLT_MAX * 0.9);
-
-                if(ccost < bval) {
-                    bval = ccost;
-                    idx = v;
-                }
-            }
-
-            const double y = bval + tT[mdis + u];
-
-            pT[mdis + u] = (float)VSMIN(y, FLT_MAX * 0.9);
-
-            piT[mdis + u] = idx;
-        }
+        k->pathRow(pcosts + (x - 1) * tpitch + mdis, ccosts + mdis * width + x, width, pcosts + x * tpitch + mdis,
+                   pbackt + (x - 1) * tpitch + mdis, umax, umax2, 1, pen);
     }
 
     // backtrack
@@ -180,27 +301,30 @@ static void interpLineFP(const uint8_t *srcp, const int width, const ptrdiff_t p
 static void interpLineHP(const uint8_t *srcp, const int width, const ptrdiff_t pitch,
                          const float alpha, const float beta, const float gamma, const int nrad,
                          const int mdis, float *temp, uint8_t *dstp, int *dmap, const int ucubic,
-                         const int cost3)
+                         const int cost3, const eedi3Kernels *k)
 {
     const uint8_t *src3p = srcp - 3 * pitch;
     const uint8_t *src1p = srcp - 1 * pitch;
     const uint8_t *src1n = srcp + 1 * pitch;
     const uint8_t *src3n = srcp + 3 * pitch;
     const ptrdiff_t tpitch = mdis * 4 + 1;
+    const float cv = 1.0f - alpha - beta;
     float *ccosts = temp;
     float *pcosts = ccosts + width * tpitch;
     int *pbackt = (int *)(pcosts + width * tpitch);
     int *fpath = pbackt + width * tpitch;
-    // calculate half pel values
-    uint8_t *hp3p = (uint8_t *)fpath;
-    uint8_t *hp1p = hp3p + width;
-    uint8_t *hp1n = hp1p + width;
-    uint8_t *hp3n = hp1n + width;
-
-    int k, u, v, x;
-
-    for(x = 0; x < width - 1; ++x) {
-        if(!ucubic || (x == 0 || x == width - 2)) {
+    uint16_t *sad = (uint16_t *)(fpath + width) + mdis;
+    uint16_t *hsad = sad + width + mdis * 2;
+    // calculate half pel values, with a few extra on each side for the neighborhood windows
+    uint8_t *hp3p = (uint8_t *)(hsad + width + mdis) + 4;
+    uint8_t *hp1p = hp3p + width + 8;
+    uint8_t *hp1n = hp1p + width + 8;
+    uint8_t *hp3n = hp1n + width + 8;
+
+    int i, u, x;
+
+    for(x = -4; x < width + 4; ++x) {
+        if(!ucubic || (x <= 0 || x >= width - 2)) {
             hp3p[x] = (src3p[x] + src3p[x + 1] + 1) >> 1;
             hp1p[x] = (src1p[x] + src1p[x + 1] + 1) >> 1;
             hp1n[x] = (src1n[x] + src1n[x + 1] + 1) >> 1;
@@ -213,123 +337,84 @@ static void interpLineHP(const uint8_t *srcp, const int width, const ptrdiff_t p
         }
     }
 
-    // calculate all connection costs
-    if(!cost3) {
-        for(x = 0; x < width; ++x) {
-            const int umax = VSMIN(VSMIN(x, width - 1 - x), mdis);
-
-            for(u = -umax * 2; u <= umax * 2; ++u) {
-                int s = 0, ip;
-                const int u2 = u >> 1;
-
-                if(!(u & 1)) {
-                    for(k = -nrad; k <= nrad; ++k)
-                        s +=
-                            abs(src3p[x + u2 + k] - src1p[x - u2 + k]) +
-                            abs(src1p[x + u2 + k] - src1n[x - u2 + k]) +
-                            abs(src1n[x + u2 + k] - src3n[x - u2 + k]);
-
-                    ip = (src1p[x + u2] + src1n[x - u2] + 1) >> 1; // should use cubic if ucubic=true
-                } else {
-                    for(k = -nrad; k <= nrad; ++k)
-                        s +=
-                            abs(hp3p[x + u2 + k] - hp1p[x - u2 - 1 + k]) +
-                            abs(hp1p[x + u2 + k] - hp1n[x - u2 - 1 + k]) +
-                            abs(hp1n[x + u2 + k] - hp3n[x - u2 - 1 + k]);
-
-                    ip = (hp1p[x + u2] + hp1n[x - u2 - 1] + 1) >> 1; // should use cubic if ucubic=true
-                }
+    // calculate all connection costs, one direction at a time. The first
+    // neighborhood sum of pixel x is the sum of direction u at x + u / 2, taken
+    // from the half pel lines for odd directions, the other two are the full
+    // pel sums at x and x + u.
+    for(u = -mdis * 2; u <= mdis * 2; ++u) {
+        const int u2 = u >> 1;
+        const int xlo = (abs(u) + 1) >> 1;
+        const int xhi = width - 1 - xlo;
+
+        if(xlo > xhi)
+            continue;
+
+        // the second neighborhood only exists inside [v0, v1), elsewhere the
+        // third one is used twice. The third one always exists.
+        const int v0 = VSMIN(VSMAX(xlo, u), xhi + 1);
+        const int v1 = VSMAX(VSMIN(xhi, width - 1 + u) + 1, v0);
+        const uint16_t *s0 = (u & 1) ? hsad : sad;
+        const uint8_t *ip0 = (u & 1) ? hp1p + u2 : src1p + u2;
+        const uint8_t *ip1 = (u & 1) ? hp1n - u2 - 1 : src1n - u2;
+        int lo = INT_MAX, hi = INT_MIN;
+
+        if(u & 1) {
+            const uint8_t * const t[3] = { hp3p + xlo + u2, hp1p + xlo + u2, hp1n + xlo + u2 };
+            const uint8_t * const b[3] = { hp1p + xlo + u2 - u, hp1n + xlo + u2 - u, hp3n + xlo + u2 - u };
+
+            k->sadRow(t, b, nrad, hsad + xlo + u2, xhi - xlo + 1);
+        } else {
+            lo = xlo + u2;
+            hi = xhi + u2;
+        }
 
-                const int v = abs(src1p[x] - ip) + abs(src1n[x] - ip);
+        if(cost3) {
+            lo = VSMIN(lo, xlo + u);
+            hi = VSMAX(hi, xhi + u);
 
-                ccosts[x * tpitch + mdis * 2 + u] = alpha * s + beta * abs(u) * 0.5f + (1.0f - alpha - beta) * v;
+            if(v0 < v1) {
+                lo = VSMIN(lo, v0);
+                hi = VSMAX(hi, v1 - 1);
             }
         }
-    } else {
-        for(x = 0; x < width; ++x) {
-            const int umax = VSMIN(VSMIN(x, width - 1 - x), mdis);
-
-            for(u = -umax * 2; u <= umax * 2; ++u) {
-                int s0 = 0, s1 = -1, s2 = -1, ip;
-                const int u2 = u >> 1;
-
-                if(!(u & 1)) {
-                    for(k = -nrad; k <= nrad; ++k)
-                        s0 +=
-                            abs(src3p[x + u2 + k] - src1p[x - u2 + k]) +
-                            abs(src1p[x + u2 + k] - src1n[x - u2 + k]) +
-                            abs(src1n[x + u2 + k] - src3n[x - u2 + k]);
-
-                    ip = (src1p[x + u2] + src1n[x - u2] + 1) >> 1; // should use cubic if ucubic=true
-                } else {
-                    for(k = -nrad; k <= nrad; ++k)
-                        s0 +=
-                            abs(hp3p[x + u2 + k] - hp1p[x - u2 - 1 + k]) +
-                            abs(hp1p[x + u2 + k] - hp1n[x - u2 - 1 + k]) +
-                            abs(hp1n[x + u2 + k] - hp3n[x - u2 - 1 + k]);
-
-                    ip = (hp1p[x + u2] + hp1n[x - u2 - 1] + 1) >> 1; // should use cubic if ucubic=true
-                }
 
-                if((u >= 0 && x >= u) || (u <= 0 && x < width + u)) {
-                    s1 = 0;
+        if(lo <= hi) {
+            const uint8_t * const t[3] = { src3p + lo, src1p + lo, src1n + lo };
+            const uint8_t * const b[3] = { src1p + lo - u, src1n + lo - u, src3n + lo - u };
 
-                    for(k = -nrad; k <= nrad; ++k)
-                        s1 +=
-                            abs(src3p[x + k] - src1p[x - u + k]) +
-                            abs(src1p[x + k] - src1n[x - u + k]) +
-                            abs(src1n[x + k] - src3n[x - u + k]);
-                }
+            k->sadRow(t, b, nrad, sad + lo, hi - lo + 1);
+        }
 
-                if((u <= 0 && x >= u) || (u >= 0 && x < width + u)) {
-                    s2 = 0;
+        float *tT = ccosts + (mdis * 2 + u) * width;
+        const float bu = beta * abs(u) * 0.5f;
 
-                    for(k = -nrad; k <= nrad; ++k)
-                        s2 +=
-                            abs(src3p[x + u + k] - src1p[x + k]) +
-                            abs(src1p[x + u + k] - src1n[x + k]) +
-                            abs(src1n[x + u + k] - src3n[x + k]);
-                }
+        if(!cost3) {
+            k->costRow(s0 + xlo + u2, NULL, NULL, ip0 + xlo, ip1 + xlo, src1p + xlo, src1n + xlo,
+                    alpha, bu, cv, tT + xlo, xhi - xlo + 1);
+        } else {
+            const int seg[4] = { xlo, v0, v1, xhi + 1 };
+
+            for(i = 0; i < 3; ++i) {
+                const int x0 = seg[i];
 
-                s1 = s1 >= 0 ? s1 : (s2 >= 0 ? s2 : s0);
-                s2 = s2 >= 0 ? s2 : (s1 >= 0 ? s1 : s0);
-                const int v = abs(src1p[x] - ip) + abs(src1n[x] - ip);
-                ccosts[x * tpitch + mdis * 2 + u] = alpha * (s0 + s1 + s2) * 0.333333f + beta * abs(u) * 0.5f + (1.0f - alpha - beta) * v;
+                if(seg[i + 1] > x0)
+                    k->costRow(s0 + x0 + u2, sad + x0 + (i == 1 ? 0 : u), sad + x0 + u, ip0 + x0, ip1 + x0,
+                            src1p + x0, src1n + x0, alpha, bu, cv, tT + x0, seg[i + 1] - x0);
             }
         }
     }
 
     // calculate path costs
-    pcosts[mdis * 2] = ccosts[mdis * 2];
+    pcosts[mdis * 2] = ccosts[mdis * 2 * width];
+
+    const float pen[3] = { gamma * 0 * 0.5f, gamma * 1 * 0.5f, gamma * 2 * 0.5f };
 
     for(x = 1; x < width; ++x) {
-        float *tT = ccosts + x * tpitch;
-        float *ppT = pcosts + (x - 1) * tpitch;
-        float *pT = pcosts + x * tpitch;
-        int *piT = pbackt + (x - 1) * tpitch;
         const int umax = VSMIN(VSMIN(x, width - 1 - x), mdis);
+        const int umax2 = VSMIN(VSMIN(x - 1, width - x), mdis);
 
-        for(u = -umax * 2; u <= umax * 2; ++u) {
-            int idx = 0;
-            float bval = FLT_MAX;
-            const int umax2 = VSMIN(VSMIN(x - 1, width - x), mdis);
-
-            for(v = VSMAX(-umax2 * 2, u - 2); v <= VSMIN(umax2 * 2, u + 2); ++v) {
-                const double y = ppT[mdis * 2 + v] + gamma * abs(u - v) * 0.5f;
-                const float ccost = (float)VSMIN(y, FLT_MAX * 0.9);
-
-                if(ccost < bval) {
-                    bval = ccost;
-                    idx = v;
-                }
-            }
-
-            const double y = bval + tT[mdis * 2 + u];
-
-            pT[mdis * 2 + u] = (float)VSMIN(y, FLT_MAX * 0.9);
-
-            piT[mdis * 2 + u] = idx;
-        }
+        k->pathRow(pcosts + (x - 1) * tpitch + mdis * 2, ccosts + mdis * 2 * width + x, width, pcosts + x * tpitch + mdis * 2,
+                   pbackt + (x - 1) * tpitch + mdis * 2, umax * 2, umax2 * 2, 2, pen);
     }
 
     // backtrack
@@ -372,6 +457,45 @@ static void interpLineHP(const uint8_t *srcp, const int width, const ptrdiff_t p
 }
 
 
+typedef struct {
+    eedi3Data *d;
+    const uint8_t *srcp;
+    ptrdiff_t spitch;
+    uint8_t *dstp;
+    ptrdiff_t dpitch;
+    int *dmapa;
+    int width;
+    int error;
+} eedi3Band;
+
+// Interpolates the missing lines [start, end) of a plane, the lines only depend on the source so any range can run concurrently
+static void VS_CC interpBand(int start, int end, void *userData)
+{
+    eedi3Band *band = (eedi3Band *)userData;
+    eedi3Data *d = band->d;
+    float *workspace = acquireWorkspace(d);
+    int off;
+
+    if (!workspace) {
+        band->error = 1;
+        return;
+    }
+
+    for (off = start; off < end; ++off) {
+        if (d->hp)
+            interpLineHP(band->srcp + 12 + off * 2 * band->spitch, band->width, band->spitch, d->alpha, d->beta,
+                         d->gamma, d->nrad, d->mdis, workspace, band->dstp + off * 2 * band->dpitch,
+                         band->dmapa + off * band->dpitch, d->ucubic, d->cost3, &d->kernels);
+        else
+            interpLineFP(band->srcp + 12 + off * 2 * band->spitch, band->width, band->spitch, d->alpha, d->beta,
+                         d->gamma, d->nrad, d->mdis, workspace, band->dstp + off * 2 * band->dpitch,
+                         band->dmapa + off * band->dpitch, d->ucubic, d->cost3, &d->kernels);
+    }
+
+    releaseWorkspace(d, workspace);
+}
+
+
 static VSFrame *copyPad(const VSFrame *src, int fn, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi, void *instanceData)
 {
     eedi3Data *d = (eedi3Data *)instanceData;
@@ -484,20 +608,9 @@ static const VSFrame *VS_CC eedi3GetFrame(int n, int activationReason, void *ins
         VSFrame *dst = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, src, core);
         vsapi->freeFrame(src);
 
-        float *workspace = NULL;
-        VSH_ALIGNED_MALLOC((void **)&workspace, d->vi.width * VSMAX(d->mdis * 4 + 1, 16) * 4 * sizeof(float), 16);
-        if (!workspace){
-            vsapi->setFilterError("EEDI3: Memory allocation failed", frameCtx);
-            vsapi->freeFrame(scpPF);
-            vsapi->freeFrame(srcPF);
-            vsapi->freeFrame(dst);
-            return 0;
-        }
-
         int *dmapa = NULL;
         VSH_ALIGNED_MALLOC((void **)&dmapa, vsapi->getStride(dst, 0)*vsapi->getFrameHeight(dst, 0)*sizeof(int), 16);
         if (!dmapa) {
-            VSH_ALIGNED_FREE(workspace);
             vsapi->setFilterError("EEDI3: Memory allocation failed", frameCtx);
             vsapi->freeFrame(scpPF);
             vsapi->freeFrame(srcPF);
@@ -506,6 +619,7 @@ static const VSFrame *VS_CC eedi3GetFrame(int n, int activationReason, void *ins
         }
 
         int b, x, y;
+        int error = 0;
 
         for(b = 0; b < d->vi.format.numPlanes; ++b) {
             if(!(d->planes & (1 << b)))
@@ -524,22 +638,27 @@ static const VSFrame *VS_CC eedi3GetFrame(int n, int activationReason, void *ins
             srcp += (4 + field_n) * spitch;
             dstp += field_n * dpitch;
 
-            // ~99% of the processing time is spent in this loop
-            for(y = 4 + field_n; y < height - 4; y += 2) {
-                const int off = (y - 4 - field_n) >> 1;
-
-                if(d->hp)
-                    interpLineHP(srcp + 12 + off * 2 * spitch, width - 24, spitch, d->alpha, d->beta,
-                                 d->gamma, d->nrad, d->mdis, workspace, dstp + off * 2 * dpitch,
-                                 dmapa + off * dpitch, d->ucubic, d->cost3);
-                else
-                    interpLineFP(srcp + 12 + off * 2 * spitch, width - 24, spitch, d->alpha, d->beta,
-                                 d->gamma, d->nrad, d->mdis, workspace, dstp + off * 2 * dpitch,
-                                 dmapa + off * dpitch, d->ucubic, d->cost3);
+            // ~99% of the processing time is spent interpolating, split it over several threads
+            eedi3Band band = { d, srcp, spitch, dstp, dpitch, dmapa, width - 24, 0 };
+            const int lines = (height - 8 - field_n + 1) >> 1;
+            const int tpitch = d->hp ? d->mdis * 4 + 1 : d->mdis * 2 + 1;
+            vsapi->processSlices(lines, VSMAX(SLICE_MIN_WORK / ((width - 24) * tpitch), 1), interpBand, &band, frameCtx);
+
+            if (band.error) {
+                error = 1;
+                break;
             }
 
+            // Every line is checked against the already checked line above it so this part stays serial
             if(d->vcheck > 0) {
                 int *dstpd = dmapa;
+                uint8_t *tline = (uint8_t *)acquireWorkspace(d);
+
+                if (!tline) {
+                    error = 1;
+                    break;
+                }
+
                 const uint8_t *scpp = NULL;
                 ptrdiff_t scpitch = 0;
 
@@ -556,7 +675,6 @@ static const VSFrame *VS_CC eedi3GetFrame(int n, int activationReason, void *ins
                         const uint8_t *dst1n = dstp + 1 * dpitch;
                         const uint8_t *dst2n = dstp + 2 * dpitch;
                         const uint8_t *dst3n = srcp + 3 * spitch + 12;
-                        uint8_t *tline = (uint8_t *)workspace;
 
                         for(x = 0; x < width - 24; ++x) {
                             const int dirc = dstpd[x];
@@ -638,14 +756,21 @@ static const VSFrame *VS_CC eedi3GetFrame(int n, int activationReason, void *ins
 
                     dstpd += dpitch;
                 }
+
+                releaseWorkspace(d, (float *)tline);
             }
         }
 
         VSH_ALIGNED_FREE(dmapa);
-        VSH_ALIGNED_FREE(workspace);
         vsapi->freeFrame(srcPF);
         vsapi->freeFrame(scpPF);
 
+        if (error) {
+            vsapi->setFilterError("EEDI3: Memory allocation failed", frameCtx);
+            vsapi->freeFrame(dst);
+            return 0;
+        }
+
         if (d->field > 1) {
             VSMap *dst_props = vsapi->getFramePropertiesRW(dst);
             int err_num, err_den;
@@ -670,10 +795,35 @@ static void VS_CC eedi3Free(void *instanceData, VSCore *core, const VSAPI *vsapi
     eedi3Data *d = (eedi3Data *)instanceData;
     vsapi->freeNode(d->node);
     vsapi->freeNode(d->sclip);
+
+    while (d->workspaces) {
+        eedi3Workspace *ws = d->workspaces;
+        d->workspaces = ws->next;
+        VSH_ALIGNED_FREE(ws);
+    }
+    eedi3LockDestroy(&d->workspaceLock);
+
     free(d);
 }
 
 
+static int cpuLevelFromStr(const char *name)
+{
+    if(!strcmp(name, "none"))
+        return VS_CPU_LEVEL_NONE;
+#ifdef VS_TARGET_CPU_X86
+    else if(!strcmp(name, "sse2"))
+        return VS_CPU_LEVEL_SSE2;
+    else if(!strcmp(name, "avx2"))
+        return VS_CPU_LEVEL_AVX2;
+    else if(!strcmp(name, "avx512"))
+        return VS_CPU_LEVEL_AVX512;
+#endif
+    else
+        return VS_CPU_LEVEL_MAX;
+}
+
+
 static void VS_CC eedi3Create(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
 {
     eedi3Data d;
@@ -747,6 +897,29 @@ static void VS_CC eedi3Create(const VSMap *in, VSMap *out, void *userData, VSCor
 
     d.sclip = vsapi->mapGetNode(in, "sclip", 0, &err);
 
+    const char *cpu = vsapi->mapGetData(in, "cpu", 0, &err);
+    const int cpulevel = err ? VS_CPU_LEVEL_MAX : cpuLevelFromStr(cpu);
+
+    d.kernels.sadRow = eedi3_sad_row_c;
+    d.kernels.costRow = eedi3_cost_row_c;
+    d.kernels.pathRow = eedi3_path_row_c;
+
+#ifdef VS_TARGET_CPU_X86
+    if(getCPUFeatures()->avx512_f && getCPUFeatures()->avx512_bw && getCPUFeatures()->avx512_dq && cpulevel >= VS_CPU_LEVEL_AVX512) {
+        d.kernels.sadRow = eedi3_sad_row_avx512;
+        d.kernels.costRow = eedi3_cost_row_avx512;
+        d.kernels.pathRow = eedi3_path_row_avx512;
+    } else if(getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        d.kernels.sadRow = eedi3_sad_row_avx2;
+        d.kernels.costRow = eedi3_cost_row_avx2;
+        d.kernels.pathRow = eedi3_path_row_avx2;
+    } else if(cpulevel >= VS_CPU_LEVEL_SSE2) {
+        d.kernels.sadRow = eedi3_sad_row_sse2;
+        d.kernels.costRow = eedi3_cost_row_sse2;
+        d.kernels.pathRow = eedi3_path_row_sse2;
+    }
+#endif
+
     d.planes = 0;
     int nump = vsapi->mapNumElements(in, "planes");
 
@@ -848,6 +1021,8 @@ static void VS_CC eedi3Create(const VSMap *in, VSMap *out, void *userData, VSCor
 
     data = (eedi3Data *)malloc(sizeof(d));
     *data = d;
+    data->workspaces = NULL;
+    eedi3LockInit(&data->workspaceLock);
 
     VSFilterDependency deps[] = {{d.node, rpStrictSpatial}};
     vsapi->createVideoFilter(out, "eedi3", &data->vi, eedi3GetFrame, eedi3Free, fmParallel, deps, 1, data, core);
@@ -863,6 +1038,6 @@ error:
 VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->configPlugin("com.vapoursynth.eedi3", "eedi3", "EEDI3", VS_MAKE_VERSION(1, 0), VAPOURSYNTH_API_VERSION, 0, plugin);
     vspapi->registerFunction("eedi3", "clip:vnode;field:int;dh:int:opt;planes:int[]:opt;alpha:float:opt;beta:float:opt;gamma:float:opt;nrad:int:opt;mdis:int:opt;" \
-        "hp:int:opt;ucubic:int:opt;cost3:int:opt;vcheck:int:opt;vthresh0:float:opt;vthresh1:float:opt;vthresh2:float:opt;sclip:vnode:opt;", "clip:vnode;",
+        "hp:int:opt;ucubic:int:opt;cost3:int:opt;vcheck:int:opt;vthresh0:float:opt;vthresh1:float:opt;vthresh2:float:opt;sclip:vnode:opt;cpu:data:opt;", "clip:vnode;",
         eedi3Create, NULL, plugin);
 }
@@ -0,0 +1,72 @@
+/*
+**   Copyright (C) 2010 Kevin Stone
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef EEDI3_H
+#define EEDI3_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Neighborhood similarity of n positions. For every position i the absolute
+ * differences between the line pairs t[j] and b[j] (j < 3) are summed over the
+ * window [i - nrad, i + nrad], so the pointers must be readable nrad pixels
+ * before and after the n positions.
+ */
+#define DECL_SAD_ROW(isa) void eedi3_sad_row_##isa(const uint8_t * const t[3], const uint8_t * const b[3], int nrad, uint16_t *dst, int n);
+
+/*
+ * Connection costs of one direction for n pixels. The vertical difference is
+ * abs(c0[i] - ip) + abs(c1[i] - ip) where ip = (ip0[i] + ip1[i] + 1) >> 1.
+ * s1 and s2 are NULL unless the 3 neighborhood cost is used, in which case
+ * the average of the 3 similarity sums is used instead of s0 alone.
+ */
+#define DECL_COST_ROW(isa) void eedi3_cost_row_##isa(const uint16_t *s0, const uint16_t *s1, const uint16_t *s2, const uint8_t *ip0, const uint8_t *ip1, const uint8_t *c0, const uint8_t *c1, float alpha, float bu, float cv, float *dst, int n);
+
+/*
+ * One step of the path cost recursion. For every direction u in [-umax, umax]
+ * the cheapest previous path cost ppT[v] + pen[abs(u - v)] with v in
+ * [u - r, u + r] and [-umax2, umax2] is added to the connection cost
+ * tT[u * tstride], the chosen v (the smallest one on ties) goes to piT[u].
+ * Costs are clamped to FLT_MAX * 0.9.
+ */
+#define DECL_PATH_ROW(isa) void eedi3_path_row_##isa(const float *ppT, const float *tT, ptrdiff_t tstride, float *pT, int *piT, int umax, int umax2, int r, const float pen[3]);
+
+DECL_SAD_ROW(c)
+DECL_COST_ROW(c)
+DECL_PATH_ROW(c)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_SAD_ROW(sse2)
+DECL_COST_ROW(sse2)
+DECL_PATH_ROW(sse2)
+
+DECL_SAD_ROW(avx2)
+DECL_COST_ROW(avx2)
+DECL_PATH_ROW(avx2)
+
+DECL_SAD_ROW(avx512)
+DECL_COST_ROW(avx512)
+DECL_PATH_ROW(avx512)
+#endif
+
+#undef DECL_PATH_ROW
+#undef DECL_COST_ROW
+#undef DECL_SAD_ROW
+
+#endif // EEDI3_H
@@ -0,0 +1,166 @@
+/*
+**   Copyright (C) 2010 Kevin Stone
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <float.h>
+#include <stdlib.h>
+#include <immintrin.h>
+#include "eedi3.h"
+#include "VSHelper4.h"
+
+#define CHUNK 256
+
+static __m256i absdiff_epu8(__m256i a, __m256i b)
+{
+    return _mm256_sub_epi8(_mm256_max_epu8(a, b), _mm256_min_epu8(a, b));
+}
+
+void eedi3_sad_row_avx2(const uint8_t * const t[3], const uint8_t * const b[3], int nrad, uint16_t *dst, int n)
+{
+    // per pixel differences of a chunk and the window around it, summed afterwards
+    uint16_t diff[CHUNK + 8];
+    int x, i, k;
+
+    for(x = 0; x < n; x += CHUNK) {
+        const int m = VSMIN(n - x, CHUNK);
+        const int dn = m + nrad * 2;
+        const int off = x - nrad;
+
+        for(i = 0; i + 32 <= dn; i += 32) {
+            __m256i d0 = absdiff_epu8(_mm256_loadu_si256((const __m256i *)(t[0] + off + i)), _mm256_loadu_si256((const __m256i *)(b[0] + off + i)));
+            __m256i d1 = absdiff_epu8(_mm256_loadu_si256((const __m256i *)(t[1] + off + i)), _mm256_loadu_si256((const __m256i *)(b[1] + off + i)));
+            __m256i d2 = absdiff_epu8(_mm256_loadu_si256((const __m256i *)(t[2] + off + i)), _mm256_loadu_si256((const __m256i *)(b[2] + off + i)));
+            __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(d0)), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(d1))), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(d2)));
+            __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(d0, 1)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(d1, 1))), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(d2, 1)));
+
+            _mm256_storeu_si256((__m256i *)(diff + i + 0), lo);
+            _mm256_storeu_si256((__m256i *)(diff + i + 16), hi);
+        }
+        for(; i < dn; ++i)
+            diff[i] = abs(t[0][off + i] - b[0][off + i]) + abs(t[1][off + i] - b[1][off + i]) + abs(t[2][off + i] - b[2][off + i]);
+
+        for(i = 0; i + 16 <= m; i += 16) {
+            __m256i s = _mm256_loadu_si256((const __m256i *)(diff + i));
+
+            for(k = 1; k <= nrad * 2; ++k)
+                s = _mm256_add_epi16(s, _mm256_loadu_si256((const __m256i *)(diff + i + k)));
+
+            _mm256_storeu_si256((__m256i *)(dst + x + i), s);
+        }
+        for(; i < m; ++i) {
+            int s = 0;
+
+            for(k = 0; k <= nrad * 2; ++k)
+                s += diff[i + k];
+
+            dst[x + i] = s;
+        }
+    }
+}
+
+void eedi3_cost_row_avx2(const uint16_t *s0, const uint16_t *s1, const uint16_t *s2, const uint8_t *ip0, const uint8_t *ip1,
+                         const uint8_t *c0, const uint8_t *c1, float alpha, float bu, float cv, float *dst, int n)
+{
+    const __m256 malpha = _mm256_set1_ps(alpha);
+    const __m256 mthird = _mm256_set1_ps(0.333333f);
+    const __m256 mbu = _mm256_set1_ps(bu);
+    const __m256 mcv = _mm256_set1_ps(cv);
+    int i;
+
+    // multiplies and adds are kept apart to give the same results as the c version
+    for(i = 0; i + 16 <= n; i += 16) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(s0 + i));
+        __m128i ip = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(ip0 + i)), _mm_loadu_si128((const __m128i *)(ip1 + i)));
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(c0 + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(c1 + i));
+        __m256i v = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_sub_epi8(_mm_max_epu8(a0, ip), _mm_min_epu8(a0, ip))),
+                                     _mm256_cvtepu8_epi16(_mm_sub_epi8(_mm_max_epu8(a1, ip), _mm_min_epu8(a1, ip))));
+        __m256 slo, shi, vlo, vhi;
+
+        if(s1)
+            s = _mm256_add_epi16(s, _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(s1 + i)), _mm256_loadu_si256((const __m256i *)(s2 + i))));
+
+        slo = _mm256_mul_ps(malpha, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(s))));
+        shi = _mm256_mul_ps(malpha, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(s, 1))));
+        vlo = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+        vhi = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+
+        if(s1) {
+            slo = _mm256_mul_ps(slo, mthird);
+            shi = _mm256_mul_ps(shi, mthird);
+        }
+
+        _mm256_storeu_ps(dst + i + 0, _mm256_add_ps(_mm256_add_ps(slo, mbu), _mm256_mul_ps(mcv, vlo)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_add_ps(shi, mbu), _mm256_mul_ps(mcv, vhi)));
+    }
+    for(; i < n; ++i) {
+        const int ip = (ip0[i] + ip1[i] + 1) >> 1;
+        const int v = abs(c0[i] - ip) + abs(c1[i] - ip);
+
+        if(s1)
+            dst[i] = alpha * (s0[i] + s1[i] + s2[i]) * 0.333333f + bu + cv * v;
+        else
+            dst[i] = alpha * s0[i] + bu + cv * v;
+    }
+}
+
+void eedi3_path_row_avx2(const float *ppT, const float *tT, ptrdiff_t tstride, float *pT, int *piT, int umax, int umax2, int r, const float pen[3])
+{
+    const float maxCost = (float)(FLT_MAX * 0.9);
+    const __m256 mmax = _mm256_set1_ps(maxCost);
+    const __m256i vlo = _mm256_set1_epi32(-umax2 - 1);
+    const __m256i vhi = _mm256_set1_epi32(umax2 + 1);
+    const __m256i stride = _mm256_set1_epi32((int)tstride);
+    int u, v;
+
+    // all directions of a vector are compared in the same order as the c
+    // version, candidates outside [-umax2, umax2] are masked out
+    for(u = -umax; u + 8 <= umax + 1; u += 8) {
+        const __m256i uv = _mm256_add_epi32(_mm256_set1_epi32(u), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        __m256 bval = _mm256_set1_ps(FLT_MAX);
+        __m256i idx = _mm256_setzero_si256();
+
+        for(v = -r; v <= r; ++v) {
+            const __m256i vv = _mm256_add_epi32(uv, _mm256_set1_epi32(v));
+            const __m256 c = _mm256_min_ps(_mm256_add_ps(_mm256_loadu_ps(ppT + u + v), _mm256_set1_ps(pen[abs(v)])), mmax);
+            const __m256 upd = _mm256_and_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(vv, vlo), _mm256_cmpgt_epi32(vhi, vv))), _mm256_cmp_ps(c, bval, _CMP_LT_OQ));
+
+            bval = _mm256_blendv_ps(bval, c, upd);
+            idx = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(idx), _mm256_castsi256_ps(vv), upd));
+        }
+
+        bval = _mm256_add_ps(bval, _mm256_i32gather_ps(tT, _mm256_mullo_epi32(uv, stride), 4));
+        _mm256_storeu_ps(pT + u, _mm256_min_ps(bval, mmax));
+        _mm256_storeu_si256((__m256i *)(piT + u), idx);
+    }
+    for(; u <= umax; ++u) {
+        int idx = 0;
+        float bval = FLT_MAX;
+
+        for(v = VSMAX(-umax2, u - r); v <= VSMIN(umax2, u + r); ++v) {
+            const float ccost = VSMIN(ppT[v] + pen[abs(u - v)], maxCost);
+
+            if(ccost < bval) {
+                bval = ccost;
+                idx = v;
+            }
+        }
+
+        pT[u] = VSMIN(bval + tT[u * tstride], maxCost);
+        piT[u] = idx;
+    }
+}
@@ -0,0 +1,147 @@
+/*
+**   Copyright (C) 2010 Kevin Stone
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <float.h>
+#include <stdlib.h>
+#include <immintrin.h>
+#include "eedi3.h"
+#include "VSHelper4.h"
+
+#define CHUNK 256
+
+static __m512i absdiff_epu8(__m512i a, __m512i b)
+{
+    return _mm512_sub_epi8(_mm512_max_epu8(a, b), _mm512_min_epu8(a, b));
+}
+
+static __m128i absdiff128_epu8(__m128i a, __m128i b)
+{
+    return _mm_sub_epi8(_mm_max_epu8(a, b), _mm_min_epu8(a, b));
+}
+
+void eedi3_sad_row_avx512(const uint8_t * const t[3], const uint8_t * const b[3], int nrad, uint16_t *dst, int n)
+{
+    // per pixel differences of a chunk and the window around it, summed afterwards
+    uint16_t diff[CHUNK + 8];
+    int x, i, k;
+
+    for(x = 0; x < n; x += CHUNK) {
+        const int m = VSMIN(n - x, CHUNK);
+        const int dn = m + nrad * 2;
+        const int off = x - nrad;
+
+        for(i = 0; i + 64 <= dn; i += 64) {
+            __m512i d0 = absdiff_epu8(_mm512_loadu_si512(t[0] + off + i), _mm512_loadu_si512(b[0] + off + i));
+            __m512i d1 = absdiff_epu8(_mm512_loadu_si512(t[1] + off + i), _mm512_loadu_si512(b[1] + off + i));
+            __m512i d2 = absdiff_epu8(_mm512_loadu_si512(t[2] + off + i), _mm512_loadu_si512(b[2] + off + i));
+            __m512i lo = _mm512_add_epi16(_mm512_add_epi16(_mm512_cvtepu8_epi16(_mm512_castsi512_si256(d0)), _mm512_cvtepu8_epi16(_mm512_castsi512_si256(d1))), _mm512_cvtepu8_epi16(_mm512_castsi512_si256(d2)));
+            __m512i hi = _mm512_add_epi16(_mm512_add_epi16(_mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(d0, 1)), _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(d1, 1))), _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(d2, 1)));
+
+            _mm512_storeu_si512(diff + i + 0, lo);
+            _mm512_storeu_si512(diff + i + 32, hi);
+        }
+        for(; i < dn; ++i)
+            diff[i] = abs(t[0][off + i] - b[0][off + i]) + abs(t[1][off + i] - b[1][off + i]) + abs(t[2][off + i] - b[2][off + i]);
+
+        for(i = 0; i + 32 <= m; i += 32) {
+            __m512i s = _mm512_loadu_si512(diff + i);
+
+            for(k = 1; k <= nrad * 2; ++k)
+                s = _mm512_add_epi16(s, _mm512_loadu_si512(diff + i + k));
+
+            _mm512_storeu_si512(dst + x + i, s);
+        }
+        for(; i < m; ++i) {
+            int s = 0;
+
+            for(k = 0; k <= nrad * 2; ++k)
+                s += diff[i + k];
+
+            dst[x + i] = s;
+        }
+    }
+}
+
+void eedi3_cost_row_avx512(const uint16_t *s0, const uint16_t *s1, const uint16_t *s2, const uint8_t *ip0, const uint8_t *ip1,
+                           const uint8_t *c0, const uint8_t *c1, float alpha, float bu, float cv, float *dst, int n)
+{
+    const __m512 malpha = _mm512_set1_ps(alpha);
+    const __m512 mthird = _mm512_set1_ps(0.333333f);
+    const __m512 mbu = _mm512_set1_ps(bu);
+    const __m512 mcv = _mm512_set1_ps(cv);
+    int i;
+
+    // multiplies and adds are kept apart to give the same results as the c version
+    for(i = 0; i + 16 <= n; i += 16) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(s0 + i));
+        __m128i ip = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(ip0 + i)), _mm_loadu_si128((const __m128i *)(ip1 + i)));
+        __m256i v = _mm256_add_epi16(_mm256_cvtepu8_epi16(absdiff128_epu8(_mm_loadu_si128((const __m128i *)(c0 + i)), ip)),
+                                     _mm256_cvtepu8_epi16(absdiff128_epu8(_mm_loadu_si128((const __m128i *)(c1 + i)), ip)));
+        __m512 fs;
+
+        if(s1)
+            s = _mm256_add_epi16(s, _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(s1 + i)), _mm256_loadu_si256((const __m256i *)(s2 + i))));
+
+        fs = _mm512_mul_ps(malpha, _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(s)));
+
+        if(s1)
+            fs = _mm512_mul_ps(fs, mthird);
+
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_add_ps(fs, mbu), _mm512_mul_ps(mcv, _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(v)))));
+    }
+    for(; i < n; ++i) {
+        const int ip = (ip0[i] + ip1[i] + 1) >> 1;
+        const int v = abs(c0[i] - ip) + abs(c1[i] - ip);
+
+        if(s1)
+            dst[i] = alpha * (s0[i] + s1[i] + s2[i]) * 0.333333f + bu + cv * v;
+        else
+            dst[i] = alpha * s0[i] + bu + cv * v;
+    }
+}
+
+void eedi3_path_row_avx512(const float *ppT, const float *tT, ptrdiff_t tstride, float *pT, int *piT, int umax, int umax2, int r, const float pen[3])
+{
+    const __m512 mmax = _mm512_set1_ps((float)(FLT_MAX * 0.9));
+    const __m512i vlo = _mm512_set1_epi32(-umax2 - 1);
+    const __m512i vhi = _mm512_set1_epi32(umax2 + 1);
+    const __m512i stride = _mm512_set1_epi32((int)tstride);
+    int u, v;
+
+    // all directions of a vector are compared in the same order as the c
+    // version, candidates outside [-umax2, umax2] are masked out
+    for(u = -umax; u <= umax; u += 16) {
+        const __mmask16 lanes = (__mmask16)(umax - u >= 15 ? 0xFFFF : (1U << (umax - u + 1)) - 1);
+        const __m512i uv = _mm512_add_epi32(_mm512_set1_epi32(u), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        __m512 bval = _mm512_set1_ps(FLT_MAX);
+        __m512i idx = _mm512_setzero_si512();
+
+        for(v = -r; v <= r; ++v) {
+            const __m512i vv = _mm512_add_epi32(uv, _mm512_set1_epi32(v));
+            const __m512 c = _mm512_min_ps(_mm512_add_ps(_mm512_maskz_loadu_ps(lanes, ppT + u + v), _mm512_set1_ps(pen[abs(v)])), mmax);
+            const __mmask16 upd = _mm512_cmpgt_epi32_mask(vv, vlo) & _mm512_cmpgt_epi32_mask(vhi, vv) & _mm512_cmp_ps_mask(c, bval, _CMP_LT_OQ);
+
+            bval = _mm512_mask_mov_ps(bval, upd, c);
+            idx = _mm512_mask_mov_epi32(idx, upd, vv);
+        }
+
+        bval = _mm512_add_ps(bval, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), lanes, _mm512_mullo_epi32(uv, stride), tT, 4));
+        _mm512_mask_storeu_ps(pT + u, lanes, _mm512_min_ps(bval, mmax));
+        _mm512_mask_storeu_epi32(piT + u, lanes, idx);
+    }
+}
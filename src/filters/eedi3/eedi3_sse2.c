@@ -0,0 +1,162 @@
+/*
+**   Copyright (C) 2010 Kevin Stone
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <float.h>
+#include <stdlib.h>
+#include <emmintrin.h>
+#include "eedi3.h"
+#include "VSHelper4.h"
+
+#define CHUNK 256
+
+static __m128i absdiff_epu8(__m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+void eedi3_sad_row_sse2(const uint8_t * const t[3], const uint8_t * const b[3], int nrad, uint16_t *dst, int n)
+{
+    // per pixel differences of a chunk and the window around it, summed afterwards
+    uint16_t diff[CHUNK + 8];
+    int x, i, k;
+
+    for(x = 0; x < n; x += CHUNK) {
+        const int m = VSMIN(n - x, CHUNK);
+        const int dn = m + nrad * 2;
+        const int off = x - nrad;
+
+        for(i = 0; i + 16 <= dn; i += 16) {
+            __m128i d0 = absdiff_epu8(_mm_loadu_si128((const __m128i *)(t[0] + off + i)), _mm_loadu_si128((const __m128i *)(b[0] + off + i)));
+            __m128i d1 = absdiff_epu8(_mm_loadu_si128((const __m128i *)(t[1] + off + i)), _mm_loadu_si128((const __m128i *)(b[1] + off + i)));
+            __m128i d2 = absdiff_epu8(_mm_loadu_si128((const __m128i *)(t[2] + off + i)), _mm_loadu_si128((const __m128i *)(b[2] + off + i)));
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(d0, _mm_setzero_si128()), _mm_unpacklo_epi8(d1, _mm_setzero_si128())), _mm_unpacklo_epi8(d2, _mm_setzero_si128()));
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(d0, _mm_setzero_si128()), _mm_unpackhi_epi8(d1, _mm_setzero_si128())), _mm_unpackhi_epi8(d2, _mm_setzero_si128()));
+
+            _mm_storeu_si128((__m128i *)(diff + i + 0), lo);
+            _mm_storeu_si128((__m128i *)(diff + i + 8), hi);
+        }
+        for(; i < dn; ++i)
+            diff[i] = abs(t[0][off + i] - b[0][off + i]) + abs(t[1][off + i] - b[1][off + i]) + abs(t[2][off + i] - b[2][off + i]);
+
+        for(i = 0; i + 8 <= m; i += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i *)(diff + i));
+
+            for(k = 1; k <= nrad * 2; ++k)
+                s = _mm_add_epi16(s, _mm_loadu_si128((const __m128i *)(diff + i + k)));
+
+            _mm_storeu_si128((__m128i *)(dst + x + i), s);
+        }
+        for(; i < m; ++i) {
+            int s = 0;
+
+            for(k = 0; k <= nrad * 2; ++k)
+                s += diff[i + k];
+
+            dst[x + i] = s;
+        }
+    }
+}
+
+void eedi3_cost_row_sse2(const uint16_t *s0, const uint16_t *s1, const uint16_t *s2, const uint8_t *ip0, const uint8_t *ip1,
+                         const uint8_t *c0, const uint8_t *c1, float alpha, float bu, float cv, float *dst, int n)
+{
+    const __m128 malpha = _mm_set_ps1(alpha);
+    const __m128 mthird = _mm_set_ps1(0.333333f);
+    const __m128 mbu = _mm_set_ps1(bu);
+    const __m128 mcv = _mm_set_ps1(cv);
+    int i;
+
+    for(i = 0; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(s0 + i));
+        __m128i ip = _mm_avg_epu8(_mm_loadl_epi64((const __m128i *)(ip0 + i)), _mm_loadl_epi64((const __m128i *)(ip1 + i)));
+        __m128i v = _mm_add_epi16(_mm_unpacklo_epi8(absdiff_epu8(_mm_loadl_epi64((const __m128i *)(c0 + i)), ip), _mm_setzero_si128()),
+                                  _mm_unpacklo_epi8(absdiff_epu8(_mm_loadl_epi64((const __m128i *)(c1 + i)), ip), _mm_setzero_si128()));
+        __m128 slo, shi, vlo, vhi;
+
+        if(s1)
+            s = _mm_add_epi16(s, _mm_add_epi16(_mm_loadu_si128((const __m128i *)(s1 + i)), _mm_loadu_si128((const __m128i *)(s2 + i))));
+
+        slo = _mm_mul_ps(malpha, _mm_cvtepi32_ps(_mm_unpacklo_epi16(s, _mm_setzero_si128())));
+        shi = _mm_mul_ps(malpha, _mm_cvtepi32_ps(_mm_unpackhi_epi16(s, _mm_setzero_si128())));
+        vlo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+        vhi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, _mm_setzero_si128()));
+
+        if(s1) {
+            slo = _mm_mul_ps(slo, mthird);
+            shi = _mm_mul_ps(shi, mthird);
+        }
+
+        _mm_storeu_ps(dst + i + 0, _mm_add_ps(_mm_add_ps(slo, mbu), _mm_mul_ps(mcv, vlo)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_add_ps(shi, mbu), _mm_mul_ps(mcv, vhi)));
+    }
+    for(; i < n; ++i) {
+        const int ip = (ip0[i] + ip1[i] + 1) >> 1;
+        const int v = abs(c0[i] - ip) + abs(c1[i] - ip);
+
+        if(s1)
+            dst[i] = alpha * (s0[i] + s1[i] + s2[i]) * 0.333333f + bu + cv * v;
+        else
+            dst[i] = alpha * s0[i] + bu + cv * v;
+    }
+}
+
+void eedi3_path_row_sse2(const float *ppT, const float *tT, ptrdiff_t tstride, float *pT, int *piT, int umax, int umax2, int r, const float pen[3])
+{
+    const float maxCost = (float)(FLT_MAX * 0.9);
+    const __m128 mmax = _mm_set_ps1(maxCost);
+    const __m128i vlo = _mm_set1_epi32(-umax2 - 1);
+    const __m128i vhi = _mm_set1_epi32(umax2 + 1);
+    int u, v;
+
+    // all directions of a vector are compared in the same order as the c
+    // version, candidates outside [-umax2, umax2] are masked out
+    for(u = -umax; u + 4 <= umax + 1; u += 4) {
+        const __m128i uv = _mm_add_epi32(_mm_set1_epi32(u), _mm_setr_epi32(0, 1, 2, 3));
+        __m128 bval = _mm_set_ps1(FLT_MAX);
+        __m128i idx = _mm_setzero_si128();
+
+        for(v = -r; v <= r; ++v) {
+            const __m128i vv = _mm_add_epi32(uv, _mm_set1_epi32(v));
+            const __m128 c = _mm_min_ps(_mm_add_ps(_mm_loadu_ps(ppT + u + v), _mm_set_ps1(pen[abs(v)])), mmax);
+            const __m128 upd = _mm_and_ps(_mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(vv, vlo), _mm_cmplt_epi32(vv, vhi))), _mm_cmplt_ps(c, bval));
+
+            bval = _mm_or_ps(_mm_and_ps(upd, c), _mm_andnot_ps(upd, bval));
+            idx = _mm_or_si128(_mm_and_si128(_mm_castps_si128(upd), vv), _mm_andnot_si128(_mm_castps_si128(upd), idx));
+        }
+
+        bval = _mm_add_ps(bval, _mm_setr_ps(tT[u * tstride], tT[(u + 1) * tstride], tT[(u + 2) * tstride], tT[(u + 3) * tstride]));
+        _mm_storeu_ps(pT + u, _mm_min_ps(bval, mmax));
+        _mm_storeu_si128((__m128i *)(piT + u), idx);
+    }
+    for(; u <= umax; ++u) {
+        int idx = 0;
+        float bval = FLT_MAX;
+
+        for(v = VSMAX(-umax2, u - r); v <= VSMIN(umax2, u + r); ++v) {
+            const float ccost = VSMIN(ppT[v] + pen[abs(u - v)], maxCost);
+
+            if(ccost < bval) {
+                bval = ccost;
+                idx = v;
+            }
+        }
+
+        pT[u] = VSMIN(bval + tT[u * tstride], maxCost);
+        piT[u] = idx;
+    }
+}
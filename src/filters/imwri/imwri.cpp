@@ -31,15 +31,24 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <windows.h>
+#include <fcntl.h>
+#include <io.h>
 #include "../../common/vsutf16.h"
 #include "../../core/filtershared.h"
 #else
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 #include "../../core/version.h"
@@ -73,6 +82,37 @@ static void initMagick(VSCore *core, const VSAPI *vsapi) {
     Magick::InitializeMagick(path.c_str());
 }
 
+static const char *const channelMaps[] = { "R", "G", "B" };
+
+// Owns an exception for direct MagickCore calls and rethrows it the same way Magick++ does
+class MagickException {
+public:
+    MagickCore::ExceptionInfo *info;
+
+    MagickException() : info(MagickCore::AcquireExceptionInfo()) {}
+
+    ~MagickException() {
+        MagickCore::DestroyExceptionInfo(info);
+    }
+
+    void check(bool quiet) {
+        Magick::throwException(info, quiet);
+    }
+};
+
+// 8 and 16 bit integer and float samples can be converted by ImageMagick straight to and from the
+// frame planes, other bit depths go through a row of quantums
+static MagickCore::StorageType directStorageType(const VSVideoFormat &fi) {
+    if (fi.sampleType == stFloat)
+        return MagickCore::FloatPixel;
+    else if (fi.bitsPerSample == 8)
+        return MagickCore::CharPixel;
+    else if (fi.bitsPerSample == 16)
+        return MagickCore::ShortPixel;
+    else
+        return MagickCore::UndefinedPixel;
+}
+
 static std::string specialPrintf(const std::string &filename, int number) {
     std::string result;
     size_t copyPos = 0;
@@ -141,6 +181,44 @@ static bool fileExists(const std::string &filename) {
     return !!f;
 }
 
+// Asks the os to start reading the file into the page cache in the background
+static void prefetchFile(const std::string &filename) {
+#if defined(POSIX_FADV_WILLNEED)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+#elif defined(F_RDADVISE)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size > 0) {
+            radvisory ra = { 0, static_cast<int>(std::min<off_t>(size, INT_MAX)) };
+            fcntl(fd, F_RDADVISE, &ra);
+        }
+        close(fd);
+    }
+#endif
+}
+
+// Makes sure the written file has reached the disk
+static void syncFile(const std::string &filename) {
+#ifdef _WIN32
+    int fd = _wopen(utf16_from_utf8(filename).c_str(), _O_WRONLY | _O_BINARY);
+    bool success = fd >= 0 && _commit(fd) == 0;
+    if (fd >= 0)
+        _close(fd);
+#else
+    int fd = open(filename.c_str(), O_WRONLY);
+    bool success = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0)
+        close(fd);
+#endif
+    if (!success)
+        throw std::runtime_error("Failed to sync " + filename);
+}
+
 static void getWorkingDir(std::string &path) {
 #ifdef _WIN32
     DWORD size = GetCurrentDirectoryW(0, nullptr);
@@ -163,6 +241,11 @@ static void getWorkingDir(std::string &path) {
 //////////////////////////////////////////
 // Write
 
+struct WriteJob {
+    Magick::Image image;
+    std::string filename;
+};
+
 struct WriteData {
     VSNode *videoNode;
     VSNode *alphaNode;
@@ -175,12 +258,56 @@ struct WriteData {
     MagickCore::CompressionType compressType;
     bool dither;
     bool overwrite;
-
-    WriteData() : videoNode(nullptr), alphaNode(nullptr), vi(nullptr), quality(0), compressType(MagickCore::UndefinedCompression), dither(true) {}
+    bool fsync;
+
+    // Images waiting to be encoded and written by the writer threads, if any
+    std::vector<std::thread> writers;
+    size_t queueSize;
+    std::mutex queueLock;
+    std::condition_variable queueNotEmpty;
+    std::condition_variable queueNotFull;
+    std::deque<WriteJob> queue;
+    std::string writeError; // the first failed write, reported by the next frame
+    bool stopWriters;
+
+    WriteData() : videoNode(nullptr), alphaNode(nullptr), vi(nullptr), quality(0), compressType(MagickCore::UndefinedCompression), dither(true), fsync(false), queueSize(0), stopWriters(false) {}
 };
 
+static void writeImageFile(Magick::Image &image, const std::string &filename, bool fsync) {
+    image.write(filename);
+    if (fsync)
+        syncFile(filename);
+}
+
+static void writerThread(WriteData *d) {
+    std::unique_lock<std::mutex> lock(d->queueLock);
+    while (true) {
+        d->queueNotEmpty.wait(lock, [d] { return d->stopWriters || !d->queue.empty(); });
+        if (d->queue.empty())
+            return;
+
+        WriteJob job = std::move(d->queue.front());
+        d->queue.pop_front();
+        d->queueNotFull.notify_one();
+        lock.unlock();
+
+        std::string error;
+        try {
+            writeImageFile(job.image, job.filename, d->fsync);
+        } catch (Magick::Exception &e) {
+            error = std::string("ImageMagick error: ") + e.what();
+        } catch (std::runtime_error &e) {
+            error = e.what();
+        }
+
+        lock.lock();
+        if (!error.empty() && d->writeError.empty())
+            d->writeError = error;
+    }
+}
+
 template<typename T>
-static void writeImageHelper(const VSFrame *frame, const VSFrame *alphaFrame, bool isGray, Magick::Image &image, int width, int height, int bitsPerSample, const VSAPI *vsapi) {
+static void writeScaleRow(const T *src, Quantum *dst, int width, int bitsPerSample) {
     unsigned prepeat = (MAGICKCORE_QUANTUM_DEPTH - 1) / bitsPerSample;
     unsigned pleftover = MAGICKCORE_QUANTUM_DEPTH - (bitsPerSample * prepeat);
     unsigned shiftFactor = bitsPerSample - pleftover;
@@ -191,56 +318,39 @@ static void writeImageHelper(const VSFrame *frame, const VSFrame *alphaFrame, bo
     }
     scaleFactor <<= pleftover;
 
-    Magick::Pixels pixelCache(image);
-
-    const T * VS_RESTRICT r = reinterpret_cast<const T *>(vsapi->getReadPtr(frame, 0));
-    const T * VS_RESTRICT g = reinterpret_cast<const T *>(vsapi->getReadPtr(frame, isGray ? 0 : 1));
-    const T * VS_RESTRICT b = reinterpret_cast<const T *>(vsapi->getReadPtr(frame, isGray ? 0 : 2));
-    ptrdiff_t strideR = vsapi->getStride(frame, 0);
-    ptrdiff_t strideG = vsapi->getStride(frame, isGray ? 0 : 1);
-    ptrdiff_t strideB = vsapi->getStride(frame, isGray ? 0 : 2);
-    ssize_t rOff = pixelCache.offset(MagickCore::RedPixelChannel);
-    ssize_t gOff = pixelCache.offset(MagickCore::GreenPixelChannel);
-    ssize_t bOff = pixelCache.offset(MagickCore::BluePixelChannel);
-    size_t channels = image.channels();
-
-    if (alphaFrame) {
-        ssize_t aOff = pixelCache.offset(MagickCore::AlphaPixelChannel);
-        ptrdiff_t strideA = vsapi->getStride(alphaFrame, 0);
-        const T * VS_RESTRICT a = reinterpret_cast<const T *>(vsapi->getReadPtr(alphaFrame, 0));
-
-        for (int y = 0; y < height; y++) {
-            MagickCore::Quantum *pixels = pixelCache.get(0, y, width, 1);
-            for (int x = 0; x < width; x++) {
-                pixels[x * channels + rOff] = r[x] * scaleFactor + (r[x] >> shiftFactor);
-                pixels[x * channels + gOff] = g[x] * scaleFactor + (g[x] >> shiftFactor);
-                pixels[x * channels + bOff] = b[x] * scaleFactor + (b[x] >> shiftFactor);
-                pixels[x * channels + aOff] = a[x] * scaleFactor + (a[x] >> shiftFactor);
-            }
-
-            r += strideR / sizeof(T);
-            g += strideG / sizeof(T);
-            b += strideB / sizeof(T);
-            a += strideA / sizeof(T);
+    for (int x = 0; x < width; x++)
+        dst[x] = src[x] * scaleFactor + (src[x] >> shiftFactor);
+}
 
-            pixelCache.sync();
+static void writePlane(Magick::Image &image, const char *map, const VSFrame *frame, int plane, std::vector<Quantum> &buffer, const VSAPI *vsapi) {
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(frame);
+    int width = vsapi->getFrameWidth(frame, plane);
+    int height = vsapi->getFrameHeight(frame, plane);
+    const uint8_t *srcp = vsapi->getReadPtr(frame, plane);
+    ptrdiff_t stride = vsapi->getStride(frame, plane);
+    MagickCore::StorageType type = directStorageType(*fi);
+    MagickException exception;
+
+    if (type != MagickCore::UndefinedPixel) {
+        // Unpadded planes are converted in a single call
+        int rows = (stride == width * fi->bytesPerSample) ? height : 1;
+        for (int y = 0; y < height; y += rows) {
+            MagickCore::ImportImagePixels(image.image(), 0, y, width, rows, map, type, srcp, exception.info);
+            srcp += stride * rows;
         }
     } else {
+        buffer.resize(width);
         for (int y = 0; y < height; y++) {
-            MagickCore::Quantum *pixels = pixelCache.get(0, y, width, 1);
-            for (int x = 0; x < width; x++) {
-                pixels[x * channels + rOff] = r[x] * scaleFactor + (r[x] >> shiftFactor);
-                pixels[x * channels + gOff] = g[x] * scaleFactor + (g[x] >> shiftFactor);
-                pixels[x * channels + bOff] = b[x] * scaleFactor + (b[x] >> shiftFactor);
-            }
-
-            r += strideR / sizeof(T);
-            g += strideG / sizeof(T);
-            b += strideB / sizeof(T);
-
-            pixelCache.sync();
+            if (fi->bytesPerSample == 4)
+                writeScaleRow(reinterpret_cast<const uint32_t *>(srcp), buffer.data(), width, fi->bitsPerSample);
+            else
+                writeScaleRow(reinterpret_cast<const uint16_t *>(srcp), buffer.data(), width, fi->bitsPerSample);
+            MagickCore::ImportImagePixels(image.image(), 0, y, width, 1, map, MagickCore::QuantumPixel, buffer.data(), exception.info);
+            srcp += stride;
         }
     }
+
+    exception.check(image.quiet());
 }
 
 static const VSFrame *VS_CC writeGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
@@ -295,76 +405,29 @@ static const VSFrame *VS_CC writeGetFrame(int n, int activationReason, void *ins
             if (isGray)
                 image.colorSpace(Magick::GRAYColorspace);
 
-            if (fi->bytesPerSample == 4 && fi->sampleType == stFloat) {
+            if (fi->sampleType == stFloat)
                 image.attribute("quantum:format", "floating-point");
-                Magick::Pixels pixelCache(image);
-                const Quantum scaleFactor = QuantumRange;
-
-                const float * VS_RESTRICT r = reinterpret_cast<const float *>(vsapi->getReadPtr(frame, 0));
-                const float * VS_RESTRICT g = reinterpret_cast<const float *>(vsapi->getReadPtr(frame, isGray ? 0 : 1));
-                const float * VS_RESTRICT b = reinterpret_cast<const float *>(vsapi->getReadPtr(frame, isGray ? 0 : 2));
-               
-                ptrdiff_t strideR = vsapi->getStride(frame, 0);
-                ptrdiff_t strideG = vsapi->getStride(frame, isGray ? 0 : 1);
-                ptrdiff_t strideB = vsapi->getStride(frame, isGray ? 0 : 2);
-                    
-                ssize_t rOff = pixelCache.offset(MagickCore::RedPixelChannel);
-                ssize_t gOff = pixelCache.offset(MagickCore::GreenPixelChannel);
-                ssize_t bOff = pixelCache.offset(MagickCore::BluePixelChannel);
-                size_t channels = image.channels();
-
-                if (alphaFrame) {
-                    const float * VS_RESTRICT a = reinterpret_cast<const float *>(vsapi->getReadPtr(alphaFrame, 0));
-                    ptrdiff_t strideA = vsapi->getStride(alphaFrame, 0);
-                    ssize_t aOff = pixelCache.offset(MagickCore::AlphaPixelChannel);
-            
-                    for (int y = 0; y < height; y++) {
-                        MagickCore::Quantum* pixels = pixelCache.get(0, y, width, 1);
-                        for (int x = 0; x < width; x++) {
-                            pixels[x * channels + rOff] = r[x] * scaleFactor;
-                            pixels[x * channels + gOff] = g[x] * scaleFactor;
-                            pixels[x * channels + bOff] = b[x] * scaleFactor;
-                            pixels[x * channels + aOff] = a[x] * scaleFactor;
-                        }
-
-                        r += strideR / sizeof(float);
-                        g += strideG / sizeof(float);
-                        b += strideB / sizeof(float);
-                        a += strideA / sizeof(float);
-
-                        pixelCache.sync();
-                    }
-                } else {
-                    const float *r = reinterpret_cast<const float *>(vsapi->getReadPtr(frame, 0));
-                    const float *g = reinterpret_cast<const float *>(vsapi->getReadPtr(frame, isGray ? 0 : 1));
-                    const float *b = reinterpret_cast<const float *>(vsapi->getReadPtr(frame, isGray ? 0 : 2));
-
-                    for (int y = 0; y < height; y++) {
-                        MagickCore::Quantum* pixels = pixelCache.get(0, y, width, 1);
-                        for (int x = 0; x < width; x++) {
-                            pixels[x * channels + rOff] = r[x] * scaleFactor;
-                            pixels[x * channels + gOff] = g[x] * scaleFactor;
-                            pixels[x * channels + bOff] = b[x] * scaleFactor;
-                        }
-
-                        r += strideR / sizeof(float);
-                        g += strideG / sizeof(float);
-                        b += strideB / sizeof(float);
-
-                        pixelCache.sync();
-                    }
-                }
-            } else if (fi->bytesPerSample == 4) {
-                writeImageHelper<uint32_t>(frame, alphaFrame, isGray, image, width, height, fi->bitsPerSample, vsapi);
-            } else if (fi->bytesPerSample == 2) {
-                writeImageHelper<uint16_t>(frame, alphaFrame, isGray, image, width, height, fi->bitsPerSample, vsapi);
-            } else if (fi->bytesPerSample == 1) {
-                writeImageHelper<uint8_t>(frame, alphaFrame, isGray, image, width, height, fi->bitsPerSample, vsapi);
-            }
+
+            image.modifyImage();
+            std::vector<Quantum> buffer;
+            for (int plane = 0; plane < fi->numPlanes; plane++)
+                writePlane(image, channelMaps[plane], frame, plane, buffer, vsapi);
+            if (alphaFrame)
+                writePlane(image, "A", alphaFrame, 0, buffer, vsapi);
 
             image.strip();
 
-            image.write(filename);
+            if (d->writers.empty()) {
+                writeImageFile(image, filename, d->fsync);
+            } else {
+                // The frame is passed on as soon as the image is queued, errors show up on a later frame
+                std::unique_lock<std::mutex> lock(d->queueLock);
+                d->queueNotFull.wait(lock, [d] { return d->queue.size() < d->queueSize; });
+                if (!d->writeError.empty())
+                    throw std::runtime_error(d->writeError);
+                d->queue.push_back({ image, filename });
+                d->queueNotEmpty.notify_one();
+            }
 
             vsapi->freeFrame(alphaFrame);
             return frame;
@@ -373,6 +436,11 @@ static const VSFrame *VS_CC writeGetFrame(int n, int activationReason, void *ins
             vsapi->freeFrame(frame);
             vsapi->freeFrame(alphaFrame);
             return nullptr;
+        } catch (std::runtime_error &e) {
+            vsapi->setFilterError((std::string("Write: ") + e.what()).c_str(), frameCtx);
+            vsapi->freeFrame(frame);
+            vsapi->freeFrame(alphaFrame);
+            return nullptr;
         }
     }
 
@@ -381,6 +449,18 @@ static const VSFrame *VS_CC writeGetFrame(int n, int activationReason, void *ins
 
 static void VS_CC writeFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
     WriteData *d = static_cast<WriteData *>(instanceData);
+
+    // Finish writing everything that's queued
+    {
+        std::lock_guard<std::mutex> lock(d->queueLock);
+        d->stopWriters = true;
+    }
+    d->queueNotEmpty.notify_all();
+    for (auto &iter : d->writers)
+        iter.join();
+    if (!d->writeError.empty())
+        vsapi->logMessage(mtWarning, ("Write: " + d->writeError).c_str(), core);
+
     vsapi->freeNode(d->videoNode);
     vsapi->freeNode(d->alphaNode);
     delete d;
@@ -477,6 +557,18 @@ static void VS_CC writeCreate(const VSMap *in, VSMap *out, void *userData, VSCor
     if (err)
         d->dither = true;
     d->overwrite = !!vsapi->mapGetInt(in, "overwrite", 0, &err);
+    d->fsync = !!vsapi->mapGetInt(in, "fsync", 0, &err);
+
+    int numWriters = vsapi->mapGetIntSaturated(in, "writer_threads", 0, &err);
+    int queueSize = vsapi->mapGetIntSaturated(in, "queue_size", 0, &err);
+    if (err)
+        queueSize = 2 * numWriters;
+    if (numWriters < 0 || (numWriters > 0 && queueSize < 1)) {
+        vsapi->freeNode(d->videoNode);
+        vsapi->freeNode(d->alphaNode);
+        vsapi->mapSetError(out, "Write: writer_threads can't be negative and queue_size must be at least 1");
+        return;
+    }
 
     d->vi = vsapi->getVideoInfo(d->videoNode);
     if (d->alphaNode) {
@@ -504,6 +596,10 @@ static void VS_CC writeCreate(const VSMap *in, VSMap *out, void *userData, VSCor
 
     getWorkingDir(d->workingDir);
 
+    d->queueSize = queueSize;
+    for (int i = 0; i < numWriters; i++)
+        d->writers.emplace_back(writerThread, d.get());
+
     VSFilterDependency deps[] = {{ d->videoNode, rpStrictSpatial }, { d->alphaNode, rpStrictSpatial }};
     vsapi->createVideoFilter(out, "Write", d->vi, writeGetFrame, writeFree, fmParallelRequests, deps, d->alphaNode ? 2 : 1, d.get(), core);
     d.release();
@@ -521,67 +617,65 @@ struct ReadData {
     bool mismatch;
     bool fileListMode;
     bool floatOutput;
+    int readAhead;
+    std::atomic<int> readAheadEnd; // all frames before it have already been prefetched
 
-    ReadData() : fileListMode(true) {};
+    ReadData() : fileListMode(true), readAhead(0), readAheadEnd(0) {};
 };
 
-template<typename T>
-static void readImageHelper(VSFrame *frame, VSFrame *alphaFrame, bool isGray, Magick::Image &image, int width, int height, int bitsPerSample, const VSAPI *vsapi) {
-    float outScale = ((1 << bitsPerSample) - 1) / static_cast<float>((1 << MAGICKCORE_QUANTUM_DEPTH) - 1);
-    size_t channels = image.channels();
-    Magick::Pixels pixelCache(image);
-
-    T *r = reinterpret_cast<T *>(vsapi->getWritePtr(frame, 0));
-    T *g = reinterpret_cast<T *>(vsapi->getWritePtr(frame, isGray ? 0 : 1));
-    T *b = reinterpret_cast<T *>(vsapi->getWritePtr(frame, isGray ? 0 : 2));
-
-    ptrdiff_t strideR = vsapi->getStride(frame, 0);
-    ptrdiff_t strideG = vsapi->getStride(frame, isGray ? 0 : 1);
-    ptrdiff_t strideB = vsapi->getStride(frame, isGray ? 0 : 2);
-
-    ssize_t rOff = pixelCache.offset(MagickCore::RedPixelChannel);
-    ssize_t gOff = pixelCache.offset(MagickCore::GreenPixelChannel);
-    ssize_t bOff = pixelCache.offset(MagickCore::BluePixelChannel);
-    ssize_t aOff = pixelCache.offset(MagickCore::AlphaPixelChannel);
+static std::string readFilename(const ReadData *d, int n) {
+    std::string filename = d->fileListMode ? d->filenames[n] : specialPrintf(d->filenames[0], n + d->firstNum);
+    if (!isAbsolute(filename))
+        filename = d->workingDir + filename;
+    return filename;
+}
 
-    if (alphaFrame && aOff >= 0) {
-        T *a = reinterpret_cast<T *>(vsapi->getWritePtr(alphaFrame, 0));
-        ptrdiff_t strideA = vsapi->getStride(alphaFrame, 0);
+static void readAheadFiles(ReadData *d, int n) {
+    int end = n + 1 + std::min(d->readAhead, d->vi[0].numFrames - n - 1);
+    int start = d->readAheadEnd.exchange(end);
+    // Only continue where the previous frame left off when reading sequentially
+    if (start <= n || start > end)
+        start = n + 1;
+    for (int i = start; i < end; i++)
+        prefetchFile(readFilename(d, i));
+}
 
-        for (int y = 0; y < height; y++) {
-            const Magick::Quantum *pixels = pixelCache.getConst(0, y, width, 1);
-            for (int x = 0; x < width; x++) {
-                r[x] = (unsigned)(pixels[x * channels + rOff] * outScale + .5f);
-                g[x] = (unsigned)(pixels[x * channels + gOff] * outScale + .5f);
-                b[x] = (unsigned)(pixels[x * channels + bOff] * outScale + .5f);
-                a[x] = (unsigned)(pixels[x * channels + aOff] * outScale + .5f);
-            }
+template<typename T>
+static void readScaleRow(const Quantum *src, T *dst, int width, int bitsPerSample) {
+    float outScale = ((1 << bitsPerSample) - 1) / static_cast<float>((1 << MAGICKCORE_QUANTUM_DEPTH) - 1);
+    for (int x = 0; x < width; x++)
+        dst[x] = (unsigned)(src[x] * outScale + .5f);
+}
 
-            r += strideR / sizeof(T);
-            g += strideG / sizeof(T);
-            b += strideB / sizeof(T);
-            a += strideA / sizeof(T);
+static void readPlane(const Magick::Image &image, const char *map, VSFrame *frame, int plane, std::vector<Quantum> &buffer, const VSAPI *vsapi) {
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(frame);
+    int width = vsapi->getFrameWidth(frame, plane);
+    int height = vsapi->getFrameHeight(frame, plane);
+    uint8_t *dstp = vsapi->getWritePtr(frame, plane);
+    ptrdiff_t stride = vsapi->getStride(frame, plane);
+    MagickCore::StorageType type = directStorageType(*fi);
+    MagickException exception;
+
+    if (type != MagickCore::UndefinedPixel) {
+        // Unpadded planes are converted in a single call
+        int rows = (stride == width * fi->bytesPerSample) ? height : 1;
+        for (int y = 0; y < height; y += rows) {
+            MagickCore::ExportImagePixels(image.constImage(), 0, y, width, rows, map, type, dstp, exception.info);
+            dstp += stride * rows;
         }
     } else {
+        buffer.resize(width);
         for (int y = 0; y < height; y++) {
-            const Magick::Quantum *pixels = pixelCache.getConst(0, y, width, 1);
-            for (int x = 0; x < width; x++) {
-                r[x] = (unsigned)(pixels[x * channels + rOff] * outScale + .5f);
-                g[x] = (unsigned)(pixels[x * channels + gOff] * outScale + .5f);
-                b[x] = (unsigned)(pixels[x * channels + bOff] * outScale + .5f);
-            }
-
-            r += strideR / sizeof(T);
-            g += strideG / sizeof(T);
-            b += strideB / sizeof(T);
-        }
-
-        if (alphaFrame) {
-            T *a = reinterpret_cast<T *>(vsapi->getWritePtr(alphaFrame, 0));
-            ptrdiff_t strideA = vsapi->getStride(alphaFrame, 0);
-            memset(a, 0, strideA  * height);
+            MagickCore::ExportImagePixels(image.constImage(), 0, y, width, 1, map, MagickCore::QuantumPixel, buffer.data(), exception.info);
+            if (fi->bytesPerSample == 4)
+                readScaleRow(buffer.data(), reinterpret_cast<uint32_t *>(dstp), width, fi->bitsPerSample);
+            else
+                readScaleRow(buffer.data(), reinterpret_cast<uint16_t *>(dstp), width, fi->bitsPerSample);
+            dstp += stride;
         }
     }
+
+    exception.check(image.quiet());
 }
 
 static void readSampleTypeDepth(const ReadData *d, const Magick::Image &image, VSSampleType &st, int &depth) {
@@ -615,19 +709,17 @@ static const VSFrame *VS_CC readGetFrame(int n, int activationReason, void *inst
         VSFrame *frame = nullptr;
         VSFrame *alphaFrame = nullptr;
         
-        try {
-            std::string filename = d->fileListMode ? d->filenames[n] : specialPrintf(d->filenames[0], n + d->firstNum);
-            if (!isAbsolute(filename))
-                filename = d->workingDir + filename;
+        if (d->readAhead > 0)
+            readAheadFiles(d, n);
 
-            Magick::Image image(filename);
+        try {
+            Magick::Image image(readFilename(d, n));
             VSColorFamily cf = cfRGB;
             if (image.colorSpace() == Magick::GRAYColorspace)
                 cf = cfGray;
 
             int width = static_cast<int>(image.columns());
             int height = static_cast<int>(image.rows());
-            size_t channels = image.channels();
 
             VSSampleType st;
             int depth;
@@ -650,78 +742,25 @@ static const VSFrame *VS_CC readGetFrame(int n, int activationReason, void *inst
             }
 
             VSVideoFormat fformat;
-            vsapi->queryVideoFormat(&fformat, cf, stInteger, depth, 0, 0, core);
+            vsapi->queryVideoFormat(&fformat, cf, st, depth, 0, 0, core);
             frame = vsapi->newVideoFrame(&fformat, width, height, nullptr, core);
 
             if (d->alpha) {
                 VSVideoFormat aformat;
-                vsapi->queryVideoFormat(&aformat, cfGray, stInteger, depth, 0, 0, core);
+                vsapi->queryVideoFormat(&aformat, cfGray, st, depth, 0, 0, core);
                 alphaFrame = vsapi->newVideoFrame(&aformat, width, height, nullptr, core);
             }
 
             const VSVideoFormat *fi = vsapi->getVideoFrameFormat(frame);
- 
-            bool isGray = fi->colorFamily == cfGray;                
-     
-            if (fi->bytesPerSample == 4 && fi->sampleType == stFloat) {
-                const Quantum scaleFactor = QuantumRange;
-                Magick::Pixels pixelCache(image);
-
-                float *r = reinterpret_cast<float *>(vsapi->getWritePtr(frame, 0));
-                float *g = reinterpret_cast<float *>(vsapi->getWritePtr(frame, isGray ? 0 : 1));
-                float *b = reinterpret_cast<float *>(vsapi->getWritePtr(frame, isGray ? 0 : 2));
-
-                ptrdiff_t strideR = vsapi->getStride(frame, 0);
-                ptrdiff_t strideG = vsapi->getStride(frame, isGray ? 0 : 1);
-                ptrdiff_t strideB = vsapi->getStride(frame, isGray ? 0 : 2);
-
-                ssize_t rOff = pixelCache.offset(MagickCore::RedPixelChannel);
-                ssize_t gOff = pixelCache.offset(MagickCore::GreenPixelChannel);
-                ssize_t bOff = pixelCache.offset(MagickCore::BluePixelChannel);
-
-                if (alphaFrame) {
-                    float *a = reinterpret_cast<float *>(vsapi->getWritePtr(alphaFrame, 0));
-                    ptrdiff_t strideA = vsapi->getStride(alphaFrame, 0);
-                    ssize_t aOff = pixelCache.offset(MagickCore::AlphaPixelChannel);
-
-                    if (aOff >= 0) {
-                        for (int y = 0; y < height; y++) {
-                            const MagickCore::Quantum* pixels = pixelCache.getConst(0, y, width, 1);
-                            for (int x = 0; x < width; x++) {
-                                r[x] = pixels[x * channels + rOff] / scaleFactor;
-                                g[x] = pixels[x * channels + gOff] / scaleFactor;
-                                b[x] = pixels[x * channels + bOff] / scaleFactor;
-                                a[x] = pixels[x * channels + aOff] / scaleFactor;
-                            }
-
-                            r += strideR / sizeof(float);
-                            g += strideG / sizeof(float);
-                            b += strideB / sizeof(float);
-                            a += strideA / sizeof(float);
-                        }
-                    } else {
-                        memset(a, 0, strideA  * height);
-                    }
-                } else {
-                    for (int y = 0; y < height; y++) {
-                        const MagickCore::Quantum* pixels = pixelCache.getConst(0, y, width, 1);
-                        for (int x = 0; x < width; x++) {
-                            r[x] = pixels[x * channels + rOff] / scaleFactor;
-                            g[x] = pixels[x * channels + gOff] / scaleFactor;
-                            b[x] = pixels[x * channels + bOff] / scaleFactor;
-                        }
-
-                        r += strideR / sizeof(float);
-                        g += strideG / sizeof(float);
-                        b += strideB / sizeof(float);
-                    }
-                }
-            } else if (fi->bytesPerSample == 4) {
-                readImageHelper<uint32_t>(frame, alphaFrame, isGray, image, width, height, fi->bitsPerSample, vsapi);
-            } else if (fi->bytesPerSample == 2) {
-                readImageHelper<uint16_t>(frame, alphaFrame, isGray, image, width, height, fi->bitsPerSample, vsapi);
-            } else if (fi->bytesPerSample == 1) {
-                readImageHelper<uint8_t>(frame, alphaFrame, isGray, image, width, height, fi->bitsPerSample, vsapi);
+            std::vector<Quantum> buffer;
+            for (int plane = 0; plane < fi->numPlanes; plane++)
+                readPlane(image, channelMaps[plane], frame, plane, buffer, vsapi);
+
+            if (alphaFrame) {
+                if (image.alpha())
+                    readPlane(image, "A", alphaFrame, 0, buffer, vsapi);
+                else
+                    memset(vsapi->getWritePtr(alphaFrame, 0), 0, vsapi->getStride(alphaFrame, 0) * height);
             }
         } catch (Magick::Exception &e) {
             vsapi->setFilterError((std::string("Read: ImageMagick error: ") + e.what()).c_str(), frameCtx);
@@ -758,6 +797,11 @@ static void VS_CC readCreate(const VSMap *in, VSMap *out, void *userData, VSCore
     d->alpha = !!vsapi->mapGetInt(in, "alpha", 0, &err);
     d->mismatch = !!vsapi->mapGetInt(in, "mismatch", 0, &err);
     d->floatOutput = !!vsapi->mapGetInt(in, "float_output", 0, &err);
+    d->readAhead = vsapi->mapGetIntSaturated(in, "readahead", 0, &err);
+    if (d->readAhead < 0) {
+        vsapi->mapSetError(out, "Read: readahead can't be negative");
+        return;
+    }
 
     int numElem = vsapi->mapNumElements(in, "filename");
     d->filenames.resize(numElem);
@@ -811,7 +855,7 @@ static void VS_CC readCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 
     getWorkingDir(d->workingDir);
 
-    vsapi->createVideoFilter(out, "Read", d->vi, readGetFrame, readFree, fmUnordered, nullptr, 0, d.get(), core);
+    vsapi->createVideoFilter(out, "Read", d->vi, readGetFrame, readFree, fmParallel, nullptr, 0, d.get(), core);
     d.release();
 }
 
@@ -821,6 +865,6 @@ static void VS_CC readCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->configPlugin(IMWRI_ID, IMWRI_NAMESPACE, IMWRI_PLUGIN_NAME, VAPOURSYNTH_INTERNAL_PLUGIN_VERSION, VAPOURSYNTH_API_VERSION, 0, plugin);
-    vspapi->registerFunction("Write", "clip:clip;imgformat:data;filename:data;firstnum:int:opt;quality:int:opt;dither:int:opt;compression_type:data:opt;overwrite:int:opt;alpha:clip:opt;", "clip:vnode;", writeCreate, nullptr, plugin);
-    vspapi->registerFunction("Read", "filename:data[];firstnum:int:opt;mismatch:int:opt;alpha:int:opt;float_output:int:opt;", "clip:vnode;", readCreate, nullptr, plugin);
+    vspapi->registerFunction("Write", "clip:clip;imgformat:data;filename:data;firstnum:int:opt;quality:int:opt;dither:int:opt;compression_type:data:opt;overwrite:int:opt;alpha:clip:opt;writer_threads:int:opt;queue_size:int:opt;fsync:int:opt;", "clip:vnode;", writeCreate, nullptr, plugin);
+    vspapi->registerFunction("Read", "filename:data[];firstnum:int:opt;mismatch:int:opt;alpha:int:opt;float_output:int:opt;readahead:int:opt;", "clip:vnode;", readCreate, nullptr, plugin);
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+/*
+* Copyright (c) 2016 Fredrik Mellbin & other contributors
+*
+* This file is part of VapourSynth's miscellaneous filters package.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef AVERAGEFRAMES_H
+#define AVERAGEFRAMES_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct AverageFramesParams {
+    const int *weights;
+    const float *fweights;
+    size_t numSrcs;
+    float invScale; // 1 / scale, all paths round float(acc) * invScale to nearest even
+    int bitsPerSample;
+    bool chroma; // signed chroma plane, the samples are centered around 1 << (bitsPerSample - 1)
+};
+
+// Sums all numSrcs frames of a plane with their weights. Rows are processed in whole
+// vectors so strides have to be padded to the frame alignment, like all frame planes are.
+// If acc isn't null the integer weighted sums are also stored in it in pixel order with
+// stride / bytesPerSample entries per row. Float formats never store them.
+typedef void (*AverageFramesFunc)(const void * const *srcs, void *dst, int32_t *acc, ptrdiff_t stride, int width, int height, const AverageFramesParams &params);
+
+struct AverageSlideParams {
+    int weight;
+    float invScale;
+    int bitsPerSample;
+    bool chroma;
+};
+
+// Sliding window update for equal integer weights. acc holds the weighted sums of the
+// previous window as stored by an AverageFramesFunc, weight * (in - out) is added to
+// them and the result is rounded exactly like the full summation before it's written
+// to dst.
+typedef void (*AverageSlideFunc)(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params);
+
+#define DECL_AVERAGE(isa) \
+    void averageFramesByte##isa(const void * const *srcs, void *dst, int32_t *acc, ptrdiff_t stride, int width, int height, const AverageFramesParams &params); \
+    void averageFramesWord##isa(const void * const *srcs, void *dst, int32_t *acc, ptrdiff_t stride, int width, int height, const AverageFramesParams &params); \
+    void averageFramesFloat##isa(const void * const *srcs, void *dst, int32_t *acc, ptrdiff_t stride, int width, int height, const AverageFramesParams &params); \
+    void averageSlideByte##isa(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params); \
+    void averageSlideWord##isa(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params);
+
+DECL_AVERAGE(C)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_AVERAGE(SSE2)
+DECL_AVERAGE(AVX2)
+#endif
+
+#undef DECL_AVERAGE
+
+#endif // AVERAGEFRAMES_H
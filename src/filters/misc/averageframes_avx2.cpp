@@ -0,0 +1,272 @@
+/*
+* Copyright (c) 2016 Fredrik Mellbin & other contributors
+*
+* This file is part of VapourSynth's miscellaneous filters package.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <algorithm>
+#include <immintrin.h>
+#include <VSHelper4.h>
+#include "averageframes.h"
+
+// The unpacks work within 128 bit lanes so the four 32 bit sums of 32 bytes cover the pixels
+// 0-3 16-19, 4-7 20-23, 8-11 24-27 and 12-15 28-31, this stores them in pixel order
+static inline void storeAccByte(int32_t *accp, const __m256i *accum) {
+    _mm256_storeu_si256((__m256i *)(accp + 0), _mm256_permute2x128_si256(accum[0], accum[1], 0x20));
+    _mm256_storeu_si256((__m256i *)(accp + 8), _mm256_permute2x128_si256(accum[2], accum[3], 0x20));
+    _mm256_storeu_si256((__m256i *)(accp + 16), _mm256_permute2x128_si256(accum[0], accum[1], 0x31));
+    _mm256_storeu_si256((__m256i *)(accp + 24), _mm256_permute2x128_si256(accum[2], accum[3], 0x31));
+}
+
+static inline void storeAccWord(int32_t *accp, __m256i accum_lo, __m256i accum_hi) {
+    _mm256_storeu_si256((__m256i *)(accp + 0), _mm256_permute2x128_si256(accum_lo, accum_hi, 0x20));
+    _mm256_storeu_si256((__m256i *)(accp + 8), _mm256_permute2x128_si256(accum_lo, accum_hi, 0x31));
+}
+
+static inline __m256i roundScaled(__m256i accum, __m256 scale) {
+    return _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(accum), scale));
+}
+
+static inline void makeWeights(__m256i *weights, const AverageFramesParams &params) {
+    const size_t numSrcs = params.numSrcs;
+
+    for (size_t i = 0; i < (numSrcs & ~1); i += 2) {
+        uint16_t weight_lo = static_cast<int16_t>(params.weights[i]);
+        uint16_t weight_hi = static_cast<int16_t>(params.weights[i + 1]);
+        weights[i / 2] = _mm256_set1_epi32((static_cast<uint32_t>(weight_hi) << 16) | weight_lo);
+    }
+    if (numSrcs % 2)
+        weights[numSrcs / 2] = _mm256_set1_epi32(static_cast<uint16_t>(params.weights[numSrcs - 1]));
+}
+
+void averageFramesByteAVX2(const void * const *srcs, void *dst, int32_t *accp, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    const uint8_t *srcpp[32];
+    const size_t numSrcs = params.numSrcs;
+
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const uint8_t *>(p); });
+    if (numSrcs % 2)
+        srcpp[numSrcs] = srcpp[numSrcs - 1];
+
+    uint8_t * VS_RESTRICT dstp = static_cast<uint8_t *>(dst);
+
+    __m256i weights[16];
+    makeWeights(weights, params);
+
+    __m256 scale = _mm256_set1_ps(params.invScale);
+    __m256i bias = _mm256_set1_epi8(params.chroma ? 128 : 0);
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; w += 32) {
+            __m256i accum[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+            for (size_t i = 0; i < numSrcs; i += 2) {
+                __m256i coeffs = weights[i / 2];
+                __m256i v1 = _mm256_sub_epi8(_mm256_load_si256((const __m256i *)(srcpp[i + 0] + w)), bias);
+                __m256i v2 = _mm256_sub_epi8(_mm256_load_si256((const __m256i *)(srcpp[i + 1] + w)), bias);
+                // Sign extension for chroma, zero extension otherwise
+                __m256i v1_ext = params.chroma ? _mm256_cmpgt_epi8(_mm256_setzero_si256(), v1) : _mm256_setzero_si256();
+                __m256i v2_ext = params.chroma ? _mm256_cmpgt_epi8(_mm256_setzero_si256(), v2) : _mm256_setzero_si256();
+
+                __m256i v1_lo = _mm256_unpacklo_epi8(v1, v1_ext);
+                __m256i v1_hi = _mm256_unpackhi_epi8(v1, v1_ext);
+                __m256i v2_lo = _mm256_unpacklo_epi8(v2, v2_ext);
+                __m256i v2_hi = _mm256_unpackhi_epi8(v2, v2_ext);
+
+                accum[0] = _mm256_add_epi32(accum[0], _mm256_madd_epi16(coeffs, _mm256_unpacklo_epi16(v1_lo, v2_lo)));
+                accum[1] = _mm256_add_epi32(accum[1], _mm256_madd_epi16(coeffs, _mm256_unpackhi_epi16(v1_lo, v2_lo)));
+                accum[2] = _mm256_add_epi32(accum[2], _mm256_madd_epi16(coeffs, _mm256_unpacklo_epi16(v1_hi, v2_hi)));
+                accum[3] = _mm256_add_epi32(accum[3], _mm256_madd_epi16(coeffs, _mm256_unpackhi_epi16(v1_hi, v2_hi)));
+            }
+
+            if (accp)
+                storeAccByte(accp + w, accum);
+
+            __m256i lo = _mm256_packs_epi32(roundScaled(accum[0], scale), roundScaled(accum[1], scale));
+            __m256i hi = _mm256_packs_epi32(roundScaled(accum[2], scale), roundScaled(accum[3], scale));
+            __m256i res = params.chroma ? _mm256_add_epi8(_mm256_packs_epi16(lo, hi), bias) : _mm256_packus_epi16(lo, hi);
+
+            _mm256_store_si256((__m256i *)(dstp + w), res);
+        }
+
+        std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const uint8_t *ptr) { return ptr + stride; });
+        dstp += stride;
+        if (accp)
+            accp += stride;
+    }
+}
+
+void averageFramesWordAVX2(const void * const *srcs, void *dst, int32_t *accp, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    stride /= sizeof(uint16_t);
+
+    const uint16_t *srcpp[32];
+    const size_t numSrcs = params.numSrcs;
+
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const uint16_t *>(p); });
+    if (numSrcs % 2)
+        srcpp[numSrcs] = srcpp[numSrcs - 1];
+
+    uint16_t * VS_RESTRICT dstp = static_cast<uint16_t *>(dst);
+
+    __m256i weights[16];
+    makeWeights(weights, params);
+
+    __m256 scale = _mm256_set1_ps(params.invScale);
+    // Samples are made signed by subtracting the chroma bias or INT16_MIN for madd, the
+    // sums of the weighted INT16_MIN offsets are added back to get the same sums as C
+    __m256i bias = _mm256_set1_epi16(params.chroma ? (1 << (params.bitsPerSample - 1)) : INT16_MIN);
+    __m256i accumbias = _mm256_setzero_si256();
+    __m256i maxVal = _mm256_set1_epi16((1 << params.bitsPerSample) - 1);
+
+    if (!params.chroma) {
+        for (size_t i = 0; i < (numSrcs + 1) / 2; ++i)
+            accumbias = _mm256_add_epi32(accumbias, _mm256_madd_epi16(_mm256_set1_epi16(INT16_MIN), weights[i]));
+    }
+
+    __m256i outbias = _mm256_set1_epi32(params.chroma ? (1 << (params.bitsPerSample - 1)) : 0);
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; w += 16) {
+            __m256i accum_lo = _mm256_setzero_si256();
+            __m256i accum_hi = _mm256_setzero_si256();
+
+            for (size_t i = 0; i < numSrcs; i += 2) {
+                __m256i coeffs = weights[i / 2];
+                __m256i v1 = _mm256_sub_epi16(_mm256_load_si256((const __m256i *)(srcpp[i + 0] + w)), bias);
+                __m256i v2 = _mm256_sub_epi16(_mm256_load_si256((const __m256i *)(srcpp[i + 1] + w)), bias);
+
+                accum_lo = _mm256_add_epi32(accum_lo, _mm256_madd_epi16(coeffs, _mm256_unpacklo_epi16(v1, v2)));
+                accum_hi = _mm256_add_epi32(accum_hi, _mm256_madd_epi16(coeffs, _mm256_unpackhi_epi16(v1, v2)));
+            }
+            accum_lo = _mm256_sub_epi32(accum_lo, accumbias);
+            accum_hi = _mm256_sub_epi32(accum_hi, accumbias);
+
+            if (accp)
+                storeAccWord(accp + w, accum_lo, accum_hi);
+
+            accum_lo = _mm256_add_epi32(roundScaled(accum_lo, scale), outbias);
+            accum_hi = _mm256_add_epi32(roundScaled(accum_hi, scale), outbias);
+
+            _mm256_store_si256((__m256i *)(dstp + w), _mm256_min_epu16(_mm256_packus_epi32(accum_lo, accum_hi), maxVal));
+        }
+
+        std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const uint16_t *ptr) { return ptr + stride; });
+        dstp += stride;
+        if (accp)
+            accp += stride;
+    }
+}
+
+void averageFramesFloatAVX2(const void * const *srcs, void *dst, int32_t *accp, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    stride /= sizeof(float);
+
+    const float *srcpp[32];
+    const size_t numSrcs = params.numSrcs;
+
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const float *>(p); });
+
+    float * VS_RESTRICT dstp = static_cast<float *>(dst);
+
+    __m256 weights[32];
+    __m256 scale = _mm256_set1_ps(params.invScale);
+
+    for (size_t i = 0; i < numSrcs; ++i)
+        weights[i] = _mm256_set1_ps(params.fweights[i]);
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; w += 8) {
+            __m256 acc = _mm256_setzero_ps();
+            for (size_t i = 0; i < numSrcs; ++i)
+                acc = _mm256_fmadd_ps(weights[i], _mm256_load_ps(srcpp[i] + w), acc);
+            _mm256_store_ps(dstp + w, _mm256_mul_ps(acc, scale));
+        }
+
+        std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const float *ptr) { return ptr + stride; });
+        dstp += stride;
+    }
+}
+
+void averageSlideByteAVX2(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params) {
+    const uint8_t *inp = static_cast<const uint8_t *>(in);
+    const uint8_t *outp = static_cast<const uint8_t *>(out);
+    uint8_t * VS_RESTRICT dstp = static_cast<uint8_t *>(dst);
+
+    __m256i weight = _mm256_set1_epi32(params.weight);
+    __m256i bias = _mm256_set1_epi32(params.chroma ? 128 : 0);
+    __m256 scale = _mm256_set1_ps(params.invScale);
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; w += 16) {
+            __m256i res[2];
+
+            for (int i = 0; i < 2; i++) {
+                __m256i v1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(inp + w + i * 8)));
+                __m256i v2 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(outp + w + i * 8)));
+                __m256i accum = _mm256_loadu_si256((const __m256i *)(acc + w + i * 8));
+
+                accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(_mm256_sub_epi32(v1, v2), weight));
+                _mm256_storeu_si256((__m256i *)(acc + w + i * 8), accum);
+                res[i] = _mm256_add_epi32(roundScaled(accum, scale), bias);
+            }
+
+            // The pack works within lanes, the permute puts the 16 words back in order
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(res[0], res[1]), 0xD8);
+            _mm_store_si128((__m128i *)(dstp + w), _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+        }
+
+        acc += stride;
+        inp += stride;
+        outp += stride;
+        dstp += stride;
+    }
+}
+
+void averageSlideWordAVX2(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params) {
+    stride /= sizeof(uint16_t);
+
+    const uint16_t *inp = static_cast<const uint16_t *>(in);
+    const uint16_t *outp = static_cast<const uint16_t *>(out);
+    uint16_t * VS_RESTRICT dstp = static_cast<uint16_t *>(dst);
+
+    __m256i weight = _mm256_set1_epi32(params.weight);
+    __m256i bias = _mm256_set1_epi32(params.chroma ? (1 << (params.bitsPerSample - 1)) : 0);
+    __m256i maxVal = _mm256_set1_epi16((1 << params.bitsPerSample) - 1);
+    __m256 scale = _mm256_set1_ps(params.invScale);
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; w += 16) {
+            __m256i res[2];
+
+            for (int i = 0; i < 2; i++) {
+                __m256i v1 = _mm256_cvtepu16_epi32(_mm_load_si128((const __m128i *)(inp + w + i * 8)));
+                __m256i v2 = _mm256_cvtepu16_epi32(_mm_load_si128((const __m128i *)(outp + w + i * 8)));
+                __m256i accum = _mm256_loadu_si256((const __m256i *)(acc + w + i * 8));
+
+                accum = _mm256_add_epi32(accum, _mm256_mullo_epi32(_mm256_sub_epi32(v1, v2), weight));
+                _mm256_storeu_si256((__m256i *)(acc + w + i * 8), accum);
+                res[i] = _mm256_add_epi32(roundScaled(accum, scale), bias);
+            }
+
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(res[0], res[1]), 0xD8);
+            _mm256_store_si256((__m256i *)(dstp + w), _mm256_min_epu16(packed, maxVal));
+        }
+
+        acc += stride;
+        inp += stride;
+        outp += stride;
+        dstp += stride;
+    }
+}
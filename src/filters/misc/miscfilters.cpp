@@ -19,21 +19,26 @@
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cmath>
 #include <cfloat>
 #include <cstddef>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <vector>
 #include <VapourSynth4.h>
 #include <VSHelper4.h>
 #include "../src/core/filtershared.h"
 #include "../src/core/version.h"
+#include "averageframes.h"
+#include "../../core/kernel/planestats.h"
 
 #ifdef VS_TARGET_CPU_X86
 #include <emmintrin.h>
+#include "../../core/cpufeatures.h"
 #endif
 
 namespace {
@@ -45,81 +50,183 @@ using namespace vsh;
 ///////////////////////////////////////
 // SCDetect
 
+// Differences between neighboring frames are remembered so sequential requests only have
+// to compute one of the two pairs each output frame depends on
+#define SCDETECT_CACHE_SIZE 64
+
+typedef decltype(&vs_plane_stats_2_byte_c) SCDetectPlaneStatsFunc;
+
+struct SCDetectCacheEntry {
+    int n = -1; // the difference is between frame n and n + 1
+    double diff = 0;
+};
+
 typedef struct {
     double threshold;
+    int lastFrame;
+    SCDetectPlaneStatsFunc planeStats;
+    std::mutex cacheLock;
+    SCDetectCacheEntry cache[SCDETECT_CACHE_SIZE];
 } SCDetectDataExtra;
 
-typedef DualNodeData<SCDetectDataExtra> SCDetectData;
+typedef SingleNodeData<SCDetectDataExtra> SCDetectData;
+
+struct SCDetectFrameData {
+    double diff[2]; // previous and next
+    bool known[2];
+};
+
+static bool scDetectLookup(SCDetectData *d, int n, double &diff) {
+    std::lock_guard<std::mutex> lock(d->cacheLock);
+    const SCDetectCacheEntry &entry = d->cache[n % SCDETECT_CACHE_SIZE];
+    if (entry.n != n)
+        return false;
+    diff = entry.diff;
+    return true;
+}
+
+static double scDetectDiff(SCDetectData *d, int n, const VSFrame *frame1, const VSFrame *frame2, const VSAPI *vsapi) {
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(frame1);
+    int width = vsapi->getFrameWidth(frame1, 0);
+    int height = vsapi->getFrameHeight(frame1, 0);
+    vs_plane_stats stats = {};
+    d->planeStats(&stats, vsapi->getReadPtr(frame1, 0), vsapi->getStride(frame1, 0), vsapi->getReadPtr(frame2, 0), vsapi->getStride(frame2, 0), width, height);
+
+    // Normalized the same way as the PlaneStatsDiff property
+    double diff;
+    if (fi->sampleType == stInteger)
+        diff = stats.i.diffacc / (double)((int64_t)width * height * (((int64_t)1 << fi->bitsPerSample) - 1));
+    else
+        diff = stats.f.diffacc / (double)((int64_t)width * height);
+
+    std::lock_guard<std::mutex> lock(d->cacheLock);
+    SCDetectCacheEntry &entry = d->cache[n % SCDETECT_CACHE_SIZE];
+    entry.n = n;
+    entry.diff = diff;
+    return diff;
+}
 
 static const VSFrame *VS_CC scDetectGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     SCDetectData *d = static_cast<SCDetectData *>(instanceData);
 
+    // The previous difference is between frame n - 1 and n, the first frame uses the one
+    // between frame 0 and 1 instead. The last frame has no next difference.
     if (activationReason == arInitial) {
-        vsapi->requestFrameFilter(n, d->node1, frameCtx);
-        vsapi->requestFrameFilter(std::max(n - 1, 0), d->node2, frameCtx);
-        vsapi->requestFrameFilter(n, d->node2, frameCtx);
+        SCDetectFrameData *fd = new SCDetectFrameData();
+        *frameData = fd;
+
+        fd->known[0] = scDetectLookup(d, std::max(n - 1, 0), fd->diff[0]);
+        if (n == d->lastFrame) {
+            fd->known[1] = true;
+            fd->diff[1] = 0;
+        } else if (n == 0) {
+            fd->known[1] = fd->known[0];
+            fd->diff[1] = fd->diff[0];
+        } else {
+            fd->known[1] = scDetectLookup(d, n, fd->diff[1]);
+        }
+
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+        if (!fd->known[0] && n > 0)
+            vsapi->requestFrameFilter(n - 1, d->node, frameCtx);
+        if (!fd->known[1])
+            vsapi->requestFrameFilter(n + 1, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        const VSFrame *src = vsapi->getFrameFilter(n, d->node1, frameCtx);
-        const VSFrame *prevframe = vsapi->getFrameFilter(std::max(n - 1, 0), d->node2, frameCtx);
-        const VSFrame *nextframe = vsapi->getFrameFilter(n, d->node2, frameCtx);
+        SCDetectFrameData *fd = static_cast<SCDetectFrameData *>(*frameData);
+        const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
 
-        double prevdiff = vsapi->mapGetFloat(vsapi->getFramePropertiesRO(prevframe), "SCPlaneStatsDiff", 0, nullptr);
-        double nextdiff = vsapi->mapGetFloat(vsapi->getFramePropertiesRO(nextframe), "SCPlaneStatsDiff", 0, nullptr);
+        if (!fd->known[0] && n > 0) {
+            const VSFrame *prevframe = vsapi->getFrameFilter(n - 1, d->node, frameCtx);
+            fd->diff[0] = scDetectDiff(d, n - 1, prevframe, src, vsapi);
+            vsapi->freeFrame(prevframe);
+        }
+
+        if (!fd->known[1]) {
+            const VSFrame *nextframe = vsapi->getFrameFilter(n + 1, d->node, frameCtx);
+            fd->diff[1] = scDetectDiff(d, n, src, nextframe, vsapi);
+            vsapi->freeFrame(nextframe);
+            if (n == 0)
+                fd->diff[0] = fd->diff[1];
+        }
 
         VSFrame *dst = vsapi->copyFrame(src, core);
         VSMap *rwprops = vsapi->getFramePropertiesRW(dst);
-        vsapi->mapSetInt(rwprops, "_SceneChangePrev", prevdiff > d->threshold, maReplace);
-        vsapi->mapSetInt(rwprops, "_SceneChangeNext", nextdiff > d->threshold, maReplace);
+        vsapi->mapSetInt(rwprops, "_SceneChangePrev", fd->diff[0] > d->threshold, maReplace);
+        vsapi->mapSetInt(rwprops, "_SceneChangeNext", fd->diff[1] > d->threshold, maReplace);
         vsapi->freeFrame(src);
-        vsapi->freeFrame(prevframe);
-        vsapi->freeFrame(nextframe);
+        delete fd;
 
         return dst;
+    } else if (activationReason == arError) {
+        delete static_cast<SCDetectFrameData *>(*frameData);
     }
 
     return nullptr;
 }
 
+static SCDetectPlaneStatsFunc scDetectSelectPlaneStats(const VSVideoFormat &fi) {
+    SCDetectPlaneStatsFunc func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx512_f && getCPUFeatures()->avx512_bw && getCPUFeatures()->avx512_dq) {
+        switch (fi.bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_avx512; break;
+        case 2: func = vs_plane_stats_2_word_avx512; break;
+        case 4: func = vs_plane_stats_2_float_avx512; break;
+        }
+    }
+    if (!func && getCPUFeatures()->avx2) {
+        switch (fi.bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_avx2; break;
+        case 2: func = vs_plane_stats_2_word_avx2; break;
+        case 4: func = vs_plane_stats_2_float_avx2; break;
+        }
+    }
+    if (!func) {
+        switch (fi.bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_sse2; break;
+        case 2: func = vs_plane_stats_2_word_sse2; break;
+        case 4: func = vs_plane_stats_2_float_sse2; break;
+        }
+    }
+#endif
+    if (!func) {
+        switch (fi.bytesPerSample) {
+        case 1: func = vs_plane_stats_2_byte_c; break;
+        case 2: func = vs_plane_stats_2_word_c; break;
+        case 4: func = vs_plane_stats_2_float_c; break;
+        }
+    }
+
+    return func;
+}
+
 static void VS_CC scDetectCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<SCDetectData> d(new SCDetectData(vsapi));
     int err;
     d->threshold = vsapi->mapGetFloat(in, "threshold", 0, &err);
     if (err)
         d->threshold = 0.1;
-    d->node1 = vsapi->mapGetNode(in, "clip", 0, nullptr);
-    const VSVideoInfo *vi = vsapi->getVideoInfo(d->node1);
+    d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
+    const VSVideoInfo *vi = vsapi->getVideoInfo(d->node);
 
     try {
         if (d->threshold < 0.0 || d->threshold > 1.0)
             throw std::runtime_error("threshold must be between 0 and 1");
-        if (!is8to16orFloatFormat(vi->format))
+        if (!isConstantVideoFormat(vi) || !is8to16orFloatFormat(vi->format))
             throw std::runtime_error("clip must be constant format and of integer 8-16 bit type or 32 bit float");
         if (vi->numFrames == 1)
             throw std::runtime_error("clip must have more than one frame");
-
-        VSPlugin *stdplugin = vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core);
-        VSMap *invmap = vsapi->createMap();
-        VSMap *invmap2 = nullptr;
-        vsapi->mapSetNode(invmap, "clip", d->node1, maAppend);
-        vsapi->mapSetInt(invmap, "first", 1, maAppend);
-        invmap2 = vsapi->invoke(stdplugin, "Trim", invmap);
-        vsapi->clearMap(invmap);
-        vsapi->mapSetNode(invmap, "clipa", d->node1, maAppend);
-        vsapi->mapConsumeNode(invmap, "clipb", vsapi->mapGetNode(invmap2, "clip", 0, nullptr), maAppend);
-        vsapi->mapSetData(invmap, "prop", "SCPlaneStats", -1, dtUtf8, maAppend);
-        vsapi->mapSetInt(invmap, "plane", 0, maAppend);
-        vsapi->freeMap(invmap2);
-        invmap2 = vsapi->invoke(stdplugin, "PlaneStats", invmap);
-        vsapi->freeMap(invmap);
-        d->node2 = vsapi->mapGetNode(invmap2, "clip", 0, nullptr);
-        vsapi->freeMap(invmap2);
     } catch (const std::runtime_error &e) {
         vsapi->mapSetError(out, ("SCDetect: "_s + e.what()).c_str());
         return;
     }
 
-    VSFilterDependency deps[] = {{ d->node1, rpStrictSpatial }, { d->node2, rpGeneral }};
-    vsapi->createVideoFilter(out, "SCDetect", vi, scDetectGetFrame, filterFree<SCDetectData>, fmParallel, deps, 2, d.release(), core);
+    d->lastFrame = vi->numFrames - 1;
+    d->planeStats = scDetectSelectPlaneStats(vi->format);
+
+    VSFilterDependency deps[] = {{ d->node, rpGeneral }};
+    vsapi->createVideoFilter(out, "SCDetect", vi, scDetectGetFrame, filterFree<SCDetectData>, fmParallel, deps, 1, d.release(), core);
 }
 
 ///////////////////////////////////////
@@ -134,74 +241,74 @@ typedef struct {
     float fscale;
     bool useSceneChange;
     bool process[3];
+    AverageFramesFunc func;
+    // Only set for integer formats in single clip mode with equal weights and no scenechange.
+    // The weighted sums of the last frame are then kept around so the next frame only has to
+    // add the frame entering the window and subtract the one leaving it.
+    AverageSlideFunc slideFunc;
+    std::atomic<int> lastRequest;
+    std::mutex slideLock;
+    int accFrame;
+    std::vector<int32_t> acc[3];
 } AverageFrameDataExtra;
 
 typedef VariableNodeData<AverageFrameDataExtra> AverageFrameData;
 } // namespace
 
+// The same rounding as cvtps2dq in the simd versions so all of them produce identical output
+static inline int averageRound(int acc, float invScale) {
+    return static_cast<int>(std::lrint(static_cast<float>(acc) * invScale));
+}
+
 template <typename T>
-static void averageFramesI(const AverageFrameData *d, const VSFrame * const *srcs, VSFrame *dst, int plane, const VSAPI *vsapi) {
-    ptrdiff_t stride = vsapi->getStride(dst, plane) / sizeof(T);
-    int width = vsapi->getFrameWidth(dst, plane);
-    int height = vsapi->getFrameHeight(dst, plane);
+static void averageFramesI(const void * const *srcs, void *dst, int32_t *accp, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    stride /= sizeof(T);
 
     const T *srcpp[32];
-    const size_t numSrcs = d->weights.size();
-
-    std::transform(srcs, srcs + numSrcs, srcpp, [=](const VSFrame *f) {
-        return reinterpret_cast<const T *>(vsapi->getReadPtr(f, plane));
-    });
+    const size_t numSrcs = params.numSrcs;
 
-    T * VS_RESTRICT dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, plane));
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const T *>(p); });
 
-    unsigned maxVal = (1U << d->vi.format.bitsPerSample) - 1;
-    unsigned bias = 0;
+    T * VS_RESTRICT dstp = static_cast<T *>(dst);
 
-    if ((plane == 1 || plane == 2) && d->vi.format.colorFamily == cfYUV)
-        bias = 1U << (d->vi.format.bitsPerSample - 1);
-
-    int scale = d->scale;
-    int round = scale / 2;
+    int maxVal = (1 << params.bitsPerSample) - 1;
+    int bias = params.chroma ? (1 << (params.bitsPerSample - 1)) : 0;
 
     for (int h = 0; h < height; ++h) {
         for (int w = 0; w < width; ++w) {
             int acc = 0;
 
-            for (size_t i = 0; i < numSrcs; ++i) {
-                T val = srcpp[i][w] - bias;
-                acc += static_cast<int>(val) * d->weights[i];
-            }
+            for (size_t i = 0; i < numSrcs; ++i)
+                acc += (static_cast<int>(srcpp[i][w]) - bias) * params.weights[i];
 
-            acc = (acc + round) / scale;
-            acc = std::min(std::max(acc, 0), static_cast<int>(maxVal));
-            dstp[w] = static_cast<T>(acc);
+            if (accp)
+                accp[w] = acc;
+            dstp[w] = static_cast<T>(std::min(std::max(averageRound(acc, params.invScale) + bias, 0), maxVal));
         }
 
         std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const T *ptr) { return ptr + stride; });
         dstp += stride;
+        if (accp)
+            accp += stride;
     }
 }
 
-static void averageFramesF(const AverageFrameData *d, const VSFrame * const *srcs, VSFrame *dst, int plane, const VSAPI *vsapi) {
-    ptrdiff_t stride = vsapi->getStride(dst, plane) / sizeof(float);
-    int width = vsapi->getFrameWidth(dst, plane);
-    int height = vsapi->getFrameHeight(dst, plane);
+static void averageFramesF(const void * const *srcs, void *dst, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    stride /= sizeof(float);
 
     const float *srcpp[32];
-    const size_t numSrcs = d->weights.size();
+    const size_t numSrcs = params.numSrcs;
 
-    std::transform(srcs, srcs + numSrcs, srcpp, [=](const VSFrame *f) {
-        return reinterpret_cast<const float *>(vsapi->getReadPtr(f, plane));
-    });
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const float *>(p); });
 
-    float * VS_RESTRICT dstp = reinterpret_cast<float *>(vsapi->getWritePtr(dst, plane));
-    float scale = 1.0f / d->fscale;
+    float * VS_RESTRICT dstp = static_cast<float *>(dst);
+    float scale = params.invScale;
 
     for (int h = 0; h < height; ++h) {
         for (int w = 0; w < width; ++w) {
             float acc = 0;
             for (size_t i = 0; i < numSrcs; ++i)
-                acc += srcpp[i][w] * d->fweights[i];
+                acc += srcpp[i][w] * params.fweights[i];
             dstp[w] = acc * scale;
         }
 
@@ -210,34 +317,74 @@ static void averageFramesF(const AverageFrameData *d, const VSFrame * const *src
     }
 }
 
-#ifdef VS_TARGET_CPU_X86
-static void averageFramesByteSSE2(const AverageFrameData *d, const VSFrame * const *srcs, VSFrame *dst, int plane, const VSAPI *vsapi) {
-    ptrdiff_t stride = vsapi->getStride(dst, plane);
-    int width = vsapi->getFrameWidth(dst, plane);
-    int height = vsapi->getFrameHeight(dst, plane);
+template <typename T>
+static void averageSlideI(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params) {
+    stride /= sizeof(T);
+
+    const T *inp = static_cast<const T *>(in);
+    const T *outp = static_cast<const T *>(out);
+    T * VS_RESTRICT dstp = static_cast<T *>(dst);
+
+    int maxVal = (1 << params.bitsPerSample) - 1;
+    int bias = params.chroma ? (1 << (params.bitsPerSample - 1)) : 0;
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; ++w) {
+            acc[w] += params.weight * (static_cast<int>(inp[w]) - static_cast<int>(outp[w]));
+            dstp[w] = static_cast<T>(std::min(std::max(averageRound(acc[w], params.invScale) + bias, 0), maxVal));
+        }
+
+        acc += stride;
+        inp += stride;
+        outp += stride;
+        dstp += stride;
+    }
+}
+
+void averageFramesByteC(const void * const *srcs, void *dst, int32_t *acc, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    averageFramesI<uint8_t>(srcs, dst, acc, stride, width, height, params);
+}
+
+void averageFramesWordC(const void * const *srcs, void *dst, int32_t *acc, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    averageFramesI<uint16_t>(srcs, dst, acc, stride, width, height, params);
+}
 
+void averageFramesFloatC(const void * const *srcs, void *dst, int32_t *acc, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    averageFramesF(srcs, dst, stride, width, height, params);
+}
+
+void averageSlideByteC(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params) {
+    averageSlideI<uint8_t>(acc, in, out, dst, stride, width, height, params);
+}
+
+void averageSlideWordC(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params) {
+    averageSlideI<uint16_t>(acc, in, out, dst, stride, width, height, params);
+}
+
+#ifdef VS_TARGET_CPU_X86
+void averageFramesByteSSE2(const void * const *srcs, void *dst, int32_t *accp, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
     const uint8_t *srcpp[32];
-    const size_t numSrcs = d->weights.size();
+    const size_t numSrcs = params.numSrcs;
 
-    std::transform(srcs, srcs + numSrcs, srcpp, [=](const VSFrame *f) { return vsapi->getReadPtr(f, plane); });
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const uint8_t *>(p); });
     if (numSrcs % 2)
         srcpp[numSrcs] = srcpp[numSrcs - 1];
 
-    uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
+    uint8_t * VS_RESTRICT dstp = static_cast<uint8_t *>(dst);
 
     __m128i weights[16];
 
     for (size_t i = 0; i < (numSrcs & ~1); i += 2) {
-        uint16_t weight_lo = static_cast<int16_t>(d->weights[i]);
-        uint16_t weight_hi = static_cast<int16_t>(d->weights[i + 1]);
+        uint16_t weight_lo = static_cast<int16_t>(params.weights[i]);
+        uint16_t weight_hi = static_cast<int16_t>(params.weights[i + 1]);
         weights[i / 2] = _mm_set1_epi32((static_cast<uint32_t>(weight_hi) << 16) | weight_lo);
     }
     if (numSrcs % 2)
-        weights[numSrcs / 2] = _mm_set1_epi32(static_cast<uint16_t>(d->weights[numSrcs - 1]));
+        weights[numSrcs / 2] = _mm_set1_epi32(static_cast<uint16_t>(params.weights[numSrcs - 1]));
 
-    __m128 scale = _mm_set_ps1(1.0f / d->scale);
+    __m128 scale = _mm_set_ps1(params.invScale);
 
-    if ((plane == 1 || plane == 2) && d->vi.format.colorFamily == cfYUV) {
+    if (params.chroma) {
         __m128i bias = _mm_set1_epi8(128);
 
         for (int h = 0; h < height; ++h) {
@@ -265,6 +412,13 @@ static void averageFramesByteSSE2(const AverageFrameData *d, const VSFrame * con
                     accum_hihi = _mm_add_epi32(accum_hihi, _mm_madd_epi16(coeffs, _mm_unpackhi_epi16(v1_hi, v2_hi)));
                 }
 
+                if (accp) {
+                    _mm_storeu_si128((__m128i *)(accp + w + 0), accum_lolo);
+                    _mm_storeu_si128((__m128i *)(accp + w + 4), accum_lohi);
+                    _mm_storeu_si128((__m128i *)(accp + w + 8), accum_hilo);
+                    _mm_storeu_si128((__m128i *)(accp + w + 12), accum_hihi);
+                }
+
                 __m128 accumf_lolo = _mm_cvtepi32_ps(accum_lolo);
                 __m128 accumf_lohi = _mm_cvtepi32_ps(accum_lohi);
                 __m128 accumf_hilo = _mm_cvtepi32_ps(accum_hilo);
@@ -289,6 +443,8 @@ static void averageFramesByteSSE2(const AverageFrameData *d, const VSFrame * con
 
             std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const uint8_t *ptr) { return ptr + stride; });
             dstp += stride;
+            if (accp)
+                accp += stride;
         }
     } else {
         for (int h = 0; h < height; ++h) {
@@ -314,6 +470,13 @@ static void averageFramesByteSSE2(const AverageFrameData *d, const VSFrame * con
                     accum_hihi = _mm_add_epi32(accum_hihi, _mm_madd_epi16(coeffs, _mm_unpackhi_epi16(v1_hi, v2_hi)));
                 }
 
+                if (accp) {
+                    _mm_storeu_si128((__m128i *)(accp + w + 0), accum_lolo);
+                    _mm_storeu_si128((__m128i *)(accp + w + 4), accum_lohi);
+                    _mm_storeu_si128((__m128i *)(accp + w + 8), accum_hilo);
+                    _mm_storeu_si128((__m128i *)(accp + w + 12), accum_hihi);
+                }
+
                 __m128 accumf_lolo = _mm_cvtepi32_ps(accum_lolo);
                 __m128 accumf_lohi = _mm_cvtepi32_ps(accum_lohi);
                 __m128 accumf_hilo = _mm_cvtepi32_ps(accum_hilo);
@@ -337,40 +500,38 @@ static void averageFramesByteSSE2(const AverageFrameData *d, const VSFrame * con
 
             std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const uint8_t *ptr) { return ptr + stride; });
             dstp += stride;
+            if (accp)
+                accp += stride;
         }
     }
 }
 
-static void averageFramesWordSSE2(const AverageFrameData *d, const VSFrame * const *srcs, VSFrame *dst, int plane, const VSAPI *vsapi) {
-    ptrdiff_t stride = vsapi->getStride(dst, plane) / sizeof(uint16_t);
-    int width = vsapi->getFrameWidth(dst, plane);
-    int height = vsapi->getFrameHeight(dst, plane);
+void averageFramesWordSSE2(const void * const *srcs, void *dst, int32_t *accp, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    stride /= sizeof(uint16_t);
 
     const uint16_t *srcpp[32];
-    const size_t numSrcs = d->weights.size();
+    const size_t numSrcs = params.numSrcs;
 
-    std::transform(srcs, srcs + numSrcs, srcpp, [=](const VSFrame *f) {
-        return reinterpret_cast<const uint16_t *>(vsapi->getReadPtr(f, plane));
-    });
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const uint16_t *>(p); });
     if (numSrcs % 2)
         srcpp[numSrcs] = srcpp[numSrcs - 1];
 
-    uint16_t * VS_RESTRICT dstp = reinterpret_cast<uint16_t *>(vsapi->getWritePtr(dst, plane));
+    uint16_t * VS_RESTRICT dstp = static_cast<uint16_t *>(dst);
 
     __m128i weights[16];
-    __m128 scale = _mm_set_ps1(1.0f / d->scale);
+    __m128 scale = _mm_set_ps1(params.invScale);
 
     for (size_t i = 0; i < (numSrcs & ~1); i += 2) {
-        uint16_t weight_lo = static_cast<int16_t>(d->weights[i]);
-        uint16_t weight_hi = static_cast<int16_t>(d->weights[i + 1]);
+        uint16_t weight_lo = static_cast<int16_t>(params.weights[i]);
+        uint16_t weight_hi = static_cast<int16_t>(params.weights[i + 1]);
         weights[i / 2] = _mm_set1_epi32((static_cast<uint32_t>(weight_hi) << 16) | weight_lo);
     }
     if (numSrcs % 2)
-        weights[numSrcs / 2] = _mm_set1_epi32(static_cast<uint16_t>(d->weights[numSrcs - 1]));
+        weights[numSrcs / 2] = _mm_set1_epi32(static_cast<uint16_t>(params.weights[numSrcs - 1]));
 
-    if ((plane == 1 || plane == 2) && d->vi.format.colorFamily == cfYUV) {
-        __m128i bias = _mm_set1_epi16(1U << (d->vi.format.bitsPerSample - 1));
-        __m128i maxVal = _mm_sub_epi16(_mm_set1_epi16((1U << d->vi.format.bitsPerSample) - 1), bias);
+    if (params.chroma) {
+        __m128i bias = _mm_set1_epi16(1U << (params.bitsPerSample - 1));
+        __m128i maxVal = _mm_sub_epi16(_mm_set1_epi16((1U << params.bitsPerSample) - 1), bias);
         __m128i minVal = _mm_sub_epi16(_mm_setzero_si128(), bias);
 
         for (int h = 0; h < height; ++h) {
@@ -387,6 +548,11 @@ static void averageFramesWordSSE2(const AverageFrameData *d, const VSFrame * con
                     accum_hi = _mm_add_epi32(accum_hi, _mm_madd_epi16(coeffs, _mm_unpackhi_epi16(v1, v2)));
                 }
 
+                if (accp) {
+                    _mm_storeu_si128((__m128i *)(accp + w + 0), accum_lo);
+                    _mm_storeu_si128((__m128i *)(accp + w + 4), accum_hi);
+                }
+
                 __m128 accumf_lo = _mm_cvtepi32_ps(accum_lo);
                 __m128 accumf_hi = _mm_cvtepi32_ps(accum_hi);
 
@@ -405,10 +571,12 @@ static void averageFramesWordSSE2(const AverageFrameData *d, const VSFrame * con
 
             std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const uint16_t *ptr) { return ptr + stride; });
             dstp += stride;
+            if (accp)
+                accp += stride;
         }
     } else {
         __m128i accumbias = _mm_setzero_si128();
-        __m128i maxVal = _mm_add_epi16(_mm_set1_epi16((1U << d->vi.format.bitsPerSample) - 1), _mm_set1_epi16(INT16_MIN));
+        __m128i maxVal = _mm_add_epi16(_mm_set1_epi16((1U << params.bitsPerSample) - 1), _mm_set1_epi16(INT16_MIN));
 
         for (size_t i = 0; i < (numSrcs + 1) / 2; ++i) {
             accumbias = _mm_add_epi32(accumbias, _mm_madd_epi16(_mm_set1_epi16(INT16_MIN), weights[i]));
@@ -430,6 +598,11 @@ static void averageFramesWordSSE2(const AverageFrameData *d, const VSFrame * con
                 accum_lo = _mm_sub_epi32(accum_lo, accumbias);
                 accum_hi = _mm_sub_epi32(accum_hi, accumbias);
 
+                if (accp) {
+                    _mm_storeu_si128((__m128i *)(accp + w + 0), accum_lo);
+                    _mm_storeu_si128((__m128i *)(accp + w + 4), accum_hi);
+                }
+
                 __m128 accumf_lo = _mm_cvtepi32_ps(accum_lo);
                 __m128 accumf_hi = _mm_cvtepi32_ps(accum_hi);
 
@@ -450,29 +623,27 @@ static void averageFramesWordSSE2(const AverageFrameData *d, const VSFrame * con
 
             std::transform(srcpp, srcpp + numSrcs, srcpp, [=](const uint16_t *ptr) { return ptr + stride; });
             dstp += stride;
+            if (accp)
+                accp += stride;
         }
     }
 }
 
-static void averageFramesFloatSSE2(const AverageFrameData *d, const VSFrame * const *srcs, VSFrame *dst, int plane, const VSAPI *vsapi) {
-    ptrdiff_t stride = vsapi->getStride(dst, plane) / sizeof(float);
-    int width = vsapi->getFrameWidth(dst, plane);
-    int height = vsapi->getFrameHeight(dst, plane);
+void averageFramesFloatSSE2(const void * const *srcs, void *dst, int32_t *accp, ptrdiff_t stride, int width, int height, const AverageFramesParams &params) {
+    stride /= sizeof(float);
 
     const float *srcpp[32];
-    const size_t numSrcs = d->weights.size();
+    const size_t numSrcs = params.numSrcs;
 
-    std::transform(srcs, srcs + numSrcs, srcpp, [=](const VSFrame *f) {
-        return reinterpret_cast<const float *>(vsapi->getReadPtr(f, plane));
-    });
+    std::transform(srcs, srcs + numSrcs, srcpp, [](const void *p) { return static_cast<const float *>(p); });
 
-    float * VS_RESTRICT dstp = reinterpret_cast<float *>(vsapi->getWritePtr(dst, plane));
+    float * VS_RESTRICT dstp = static_cast<float *>(dst);
 
     __m128 weights[32];
-    __m128 scale = _mm_set_ps1(1.0f / d->fscale);
+    __m128 scale = _mm_set_ps1(params.invScale);
 
     for (size_t i = 0; i < numSrcs; ++i)
-        weights[i] = _mm_set_ps1(d->fweights[i]);
+        weights[i] = _mm_set_ps1(params.fweights[i]);
 
     for (int h = 0; h < height; ++h) {
         for (int w = 0; w < width; w += 4) {
@@ -490,17 +661,109 @@ static void averageFramesFloatSSE2(const AverageFrameData *d, const VSFrame * co
         dstp += stride;
     }
 }
+
+void averageSlideByteSSE2(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params) {
+    const uint8_t *inp = static_cast<const uint8_t *>(in);
+    const uint8_t *outp = static_cast<const uint8_t *>(out);
+    uint8_t * VS_RESTRICT dstp = static_cast<uint8_t *>(dst);
+
+    // madd of interleaved (in, out) pairs with (weight, -weight) gives weight * (in - out)
+    __m128i coeffs = _mm_set1_epi32((static_cast<uint32_t>(static_cast<uint16_t>(-params.weight)) << 16) | static_cast<uint16_t>(params.weight));
+    __m128i bias = _mm_set1_epi32(params.chroma ? 128 : 0);
+    __m128 scale = _mm_set_ps1(params.invScale);
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; w += 16) {
+            __m128i v1 = _mm_load_si128((const __m128i *)(inp + w));
+            __m128i v2 = _mm_load_si128((const __m128i *)(outp + w));
+
+            __m128i v1_lo = _mm_unpacklo_epi8(v1, _mm_setzero_si128());
+            __m128i v1_hi = _mm_unpackhi_epi8(v1, _mm_setzero_si128());
+            __m128i v2_lo = _mm_unpacklo_epi8(v2, _mm_setzero_si128());
+            __m128i v2_hi = _mm_unpackhi_epi8(v2, _mm_setzero_si128());
+
+            __m128i accum[4];
+            accum[0] = _mm_madd_epi16(coeffs, _mm_unpacklo_epi16(v1_lo, v2_lo));
+            accum[1] = _mm_madd_epi16(coeffs, _mm_unpackhi_epi16(v1_lo, v2_lo));
+            accum[2] = _mm_madd_epi16(coeffs, _mm_unpacklo_epi16(v1_hi, v2_hi));
+            accum[3] = _mm_madd_epi16(coeffs, _mm_unpackhi_epi16(v1_hi, v2_hi));
+
+            for (int i = 0; i < 4; i++) {
+                accum[i] = _mm_add_epi32(accum[i], _mm_loadu_si128((const __m128i *)(acc + w + i * 4)));
+                _mm_storeu_si128((__m128i *)(acc + w + i * 4), accum[i]);
+                accum[i] = _mm_add_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(accum[i]), scale)), bias);
+            }
+
+            accum[0] = _mm_packs_epi32(accum[0], accum[1]);
+            accum[2] = _mm_packs_epi32(accum[2], accum[3]);
+            _mm_store_si128((__m128i *)(dstp + w), _mm_packus_epi16(accum[0], accum[2]));
+        }
+
+        acc += stride;
+        inp += stride;
+        outp += stride;
+        dstp += stride;
+    }
+}
+
+void averageSlideWordSSE2(int32_t *acc, const void *in, const void *out, void *dst, ptrdiff_t stride, int width, int height, const AverageSlideParams &params) {
+    stride /= sizeof(uint16_t);
+
+    const uint16_t *inp = static_cast<const uint16_t *>(in);
+    const uint16_t *outp = static_cast<const uint16_t *>(out);
+    uint16_t * VS_RESTRICT dstp = static_cast<uint16_t *>(dst);
+
+    // Both samples are offset by INT16_MIN to fit madd, it cancels out in the difference
+    __m128i coeffs = _mm_set1_epi32((static_cast<uint32_t>(static_cast<uint16_t>(-params.weight)) << 16) | static_cast<uint16_t>(params.weight));
+    __m128i bias = _mm_set1_epi32((params.chroma ? (1 << (params.bitsPerSample - 1)) : 0) + INT16_MIN);
+    __m128i maxVal = _mm_add_epi16(_mm_set1_epi16((1U << params.bitsPerSample) - 1), _mm_set1_epi16(INT16_MIN));
+    __m128 scale = _mm_set_ps1(params.invScale);
+
+    for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; w += 8) {
+            __m128i v1 = _mm_add_epi16(_mm_load_si128((const __m128i *)(inp + w)), _mm_set1_epi16(INT16_MIN));
+            __m128i v2 = _mm_add_epi16(_mm_load_si128((const __m128i *)(outp + w)), _mm_set1_epi16(INT16_MIN));
+
+            __m128i accum_lo = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + w + 0)), _mm_madd_epi16(coeffs, _mm_unpacklo_epi16(v1, v2)));
+            __m128i accum_hi = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + w + 4)), _mm_madd_epi16(coeffs, _mm_unpackhi_epi16(v1, v2)));
+            _mm_storeu_si128((__m128i *)(acc + w + 0), accum_lo);
+            _mm_storeu_si128((__m128i *)(acc + w + 4), accum_hi);
+
+            accum_lo = _mm_add_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(accum_lo), scale)), bias);
+            accum_hi = _mm_add_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(accum_hi), scale)), bias);
+            accum_lo = _mm_packs_epi32(accum_lo, accum_hi);
+
+            accum_lo = _mm_min_epi16(accum_lo, maxVal);
+            accum_lo = _mm_sub_epi16(accum_lo, _mm_set1_epi16(INT16_MIN));
+            _mm_store_si128((__m128i *)(dstp + w), accum_lo);
+        }
+
+        acc += stride;
+        inp += stride;
+        outp += stride;
+        dstp += stride;
+    }
+}
 #endif
 
 static const VSFrame *VS_CC averageFramesGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     AverageFrameData *d = static_cast<AverageFrameData *>(instanceData);
     bool singleClipMode = (d->nodes.size() == 1);
-    bool clamp = (n > INT_MAX - 1 - (int)(d->weights.size() / 2));
-    int lastframe = clamp ? INT_MAX - 1 : n + (int)(d->weights.size() / 2);
+    int radius = static_cast<int>(d->weights.size() / 2);
+    bool clamp = (n > INT_MAX - 1 - radius);
+    int lastframe = clamp ? INT_MAX - 1 : n + radius;
 
     if (activationReason == arInitial) {
         if (singleClipMode) {
-            for (int i = std::max(0, n - (int)(d->weights.size() / 2)); i <= lastframe; i++)
+            int firstframe = std::max(0, n - radius);
+
+            // Sequential requests also get the frame leaving the window so the previous sums can be updated
+            if (d->slideFunc && d->lastRequest.exchange(n) == n - 1 && !clamp) {
+                *frameData = reinterpret_cast<void *>(1);
+                firstframe = std::max(0, n - radius - 1);
+            }
+
+            for (int i = firstframe; i <= lastframe; i++)
                 vsapi->requestFrameFilter(i, d->nodes[0], frameCtx);
         } else {
             for (auto iter : d->nodes)
@@ -510,7 +773,7 @@ static const VSFrame *VS_CC averageFramesGetFrame(int n, int activationReason, v
         std::vector<const VSFrame *> frames(d->weights.size());
 
         if (singleClipMode) {
-            int fn = n - (int)(d->weights.size() / 2);
+            int fn = n - radius;
             for (size_t i = 0; i < d->weights.size(); i++) {
                 frames[i] = vsapi->getFrameFilter(std::max(0, fn), d->nodes[0], frameCtx);
                 if (fn < INT_MAX - 1)
@@ -589,28 +852,50 @@ static const VSFrame *VS_CC averageFramesGetFrame(int n, int activationReason, v
             }
         }
 
+        // Whoever holds the sums either slides them along from the previous frame or recomputes
+        // them as part of the full summation, everyone else simply does the full summation
+        const VSFrame *leaving = nullptr;
+        if (*frameData)
+            leaving = vsapi->getFrameFilter(std::max(0, n - radius - 1), d->nodes[0], frameCtx);
+
+        std::unique_lock<std::mutex> slideLock;
+        if (d->slideFunc)
+            slideLock = std::unique_lock<std::mutex>(d->slideLock, std::try_to_lock);
+        bool haveAcc = slideLock.owns_lock();
+        bool slide = haveAcc && leaving && d->accFrame == n - 1;
+
+        AverageFramesParams params = { weights.data(), fweights.data(), weights.size(), 1.0f / (fi->sampleType == stInteger ? d->scale : d->fscale), fi->bitsPerSample, false };
+        AverageSlideParams slideParams = { d->weights[0], params.invScale, fi->bitsPerSample, false };
+
         for (int plane = 0; plane < fi->numPlanes; plane++) {
             if (d->process[plane]) {
-#ifdef VS_TARGET_CPU_X86
-                if (fi->bytesPerSample == 1)
-                    averageFramesByteSSE2(d, frames.data(), dst, plane, vsapi);
-                else if (fi->bytesPerSample == 2)
-                    averageFramesWordSSE2(d, frames.data(), dst, plane, vsapi);
-                else
-                    averageFramesFloatSSE2(d, frames.data(), dst, plane, vsapi);
-#else
-                if (fi->bytesPerSample == 1)
-                    averageFramesI<uint8_t>(d, frames.data(), dst, plane, vsapi);
-                else if (fi->bytesPerSample == 2)
-                    averageFramesI<uint16_t>(d, frames.data(), dst, plane, vsapi);
-                else
-                    averageFramesF(d, frames.data(), dst, plane, vsapi);
-#endif
+                ptrdiff_t stride = vsapi->getStride(dst, plane);
+                int width = vsapi->getFrameWidth(dst, plane);
+                int height = vsapi->getFrameHeight(dst, plane);
+                params.chroma = slideParams.chroma = ((plane == 1 || plane == 2) && fi->colorFamily == cfYUV);
+
+                int32_t *acc = nullptr;
+                if (haveAcc) {
+                    d->acc[plane].resize(stride / fi->bytesPerSample * height);
+                    acc = d->acc[plane].data();
+                }
+
+                if (slide) {
+                    d->slideFunc(acc, vsapi->getReadPtr(frames.back(), plane), vsapi->getReadPtr(leaving, plane), vsapi->getWritePtr(dst, plane), stride, width, height, slideParams);
+                } else {
+                    const void *srcs[32];
+                    std::transform(frames.begin(), frames.end(), srcs, [=](const VSFrame *f) { return vsapi->getReadPtr(f, plane); });
+                    d->func(srcs, vsapi->getWritePtr(dst, plane), acc, stride, width, height, params);
+                }
             }
         }
 
+        if (haveAcc)
+            d->accFrame = n;
+
         for (auto iter : frames)
             vsapi->freeFrame(iter);
+        vsapi->freeFrame(leaving);
 
         return dst;
     }
@@ -699,6 +984,27 @@ static void VS_CC averageFramesCreate(const VSMap *in, VSMap *out, void *userDat
         return;
     }
 
+    int bytesPerSample = d->vi.format.bytesPerSample;
+    bool equalWeights = std::all_of(d->weights.begin(), d->weights.end(), [&](int w) { return w == d->weights[0]; });
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2) {
+        d->func = (bytesPerSample == 1) ? averageFramesByteAVX2 : (bytesPerSample == 2) ? averageFramesWordAVX2 : averageFramesFloatAVX2;
+        d->slideFunc = (bytesPerSample == 1) ? averageSlideByteAVX2 : averageSlideWordAVX2;
+    } else {
+        d->func = (bytesPerSample == 1) ? averageFramesByteSSE2 : (bytesPerSample == 2) ? averageFramesWordSSE2 : averageFramesFloatSSE2;
+        d->slideFunc = (bytesPerSample == 1) ? averageSlideByteSSE2 : averageSlideWordSSE2;
+    }
+#else
+    d->func = (bytesPerSample == 1) ? averageFramesByteC : (bytesPerSample == 2) ? averageFramesWordC : averageFramesFloatC;
+    d->slideFunc = (bytesPerSample == 1) ? averageSlideByteC : averageSlideWordC;
+#endif
+
+    if (numNodes != 1 || d->useSceneChange || d->vi.format.sampleType != stInteger || !equalWeights)
+        d->slideFunc = nullptr;
+    d->lastRequest = -1;
+    d->accFrame = -1;
+
     std::vector<VSFilterDependency> deps;
     if (numNodes == 1) {
         deps.push_back({d->nodes[0], rpGeneral});
@@ -713,72 +1019,190 @@ static void VS_CC averageFramesCreate(const VSMap *in, VSMap *out, void *userDat
 ///////////////////////////////////////
 // Hysteresis
 
+#define HYSTERESIS_MIN_SLICE_PIXELS (256 * 1024)
+
+// Scratch memory for labeling one plane, kept around between frames
+struct HysteresisScratch {
+    std::vector<uint32_t> parent; // union-find forest over the set pixels of clipb, parents always have a smaller index than their children
+    std::vector<uint8_t> seeded; // set on a root if its component contains a pixel of clipa
+    std::vector<uint8_t> sliceStart; // rows that begin a slice and have to be merged with the row above
+};
+
 struct HysteresisExtraData {
     bool process[3];
     uint16_t peak;
-    size_t labelSize;
+    std::mutex scratchLock;
+    std::vector<std::unique_ptr<HysteresisScratch>> scratch;
 };
 
 typedef DualNodeData<HysteresisExtraData> HysteresisData;
 
 template<typename T>
-static void process_frame_hysteresis(const VSFrame * src1, const VSFrame * src2, VSFrame * dst, const VSVideoFormat *fi, const HysteresisData * d, const VSAPI * vsapi) VS_NOEXCEPT {
-    uint8_t * VS_RESTRICT label = nullptr;
+struct HysteresisPlane {
+    const T *srcp1;
+    const T *srcp2;
+    T *dstp;
+    ptrdiff_t stride;
+    int width;
+    T lower;
+    T upper;
+    HysteresisScratch *scratch;
+};
+
+static inline uint32_t hysteresisFind(uint32_t *parent, uint32_t p) {
+    while (parent[p] != p) {
+        parent[p] = parent[parent[p]];
+        p = parent[p];
+    }
+    return p;
+}
+
+static inline void hysteresisUnite(HysteresisScratch *scratch, uint32_t a, uint32_t b) {
+    uint32_t *parent = scratch->parent.data();
+    a = hysteresisFind(parent, a);
+    b = hysteresisFind(parent, b);
+    if (a == b)
+        return;
+    if (a < b)
+        std::swap(a, b);
+    parent[a] = b;
+    scratch->seeded[b] |= scratch->seeded[a];
+}
+
+// Puts p into the component of q, p must not have been labeled yet
+static inline void hysteresisJoin(HysteresisScratch *scratch, uint32_t p, uint32_t q, bool seed) {
+    uint32_t r = hysteresisFind(scratch->parent.data(), q);
+    scratch->parent[p] = r;
+    scratch->seeded[r] |= seed;
+}
+
+// Labels the 8-connected components of clipb within the rows [start, end) without looking at other slices
+template<typename T>
+static void VS_CC hysteresisLabelRows(int start, int end, void *userData) {
+    const HysteresisPlane<T> *d = static_cast<const HysteresisPlane<T> *>(userData);
+    HysteresisScratch *scratch = d->scratch;
+    const int width = d->width;
+    const T lower = d->lower;
+    uint32_t *parent = scratch->parent.data();
+
+    scratch->sliceStart[start] = 1;
+
+    for (int y = start; y < end; y++) {
+        const T *srcp1 = d->srcp1 + d->stride * y;
+        const T *srcp2 = d->srcp2 + d->stride * y;
+        const T *srcp2a = srcp2 - d->stride;
+        const uint32_t row = static_cast<uint32_t>(width) * y;
+
+        for (int x = 0; x < width; x++) {
+            const uint32_t p = row + x;
+
+            if (!(srcp2[x] > lower))
+                continue;
+
+            const bool seed = srcp1[x] > lower;
+            const bool up = y > start && srcp2a[x] > lower;
+            const bool upLeft = y > start && x > 0 && srcp2a[x - 1] > lower;
+            const bool upRight = y > start && x < width - 1 && srcp2a[x + 1] > lower;
+            const bool left = x > 0 && srcp2[x - 1] > lower;
+
+            // The pixel above is already connected to both of its neighbors and the one to the left,
+            // the left and upper left pixels are connected to each other too
+            if (up) {
+                hysteresisJoin(scratch, p, p - width, seed);
+            } else if (left || upLeft) {
+                hysteresisJoin(scratch, p, left ? p - 1 : p - width - 1, seed);
+                if (upRight)
+                    hysteresisUnite(scratch, p, p - width + 1);
+            } else if (upRight) {
+                hysteresisJoin(scratch, p, p - width + 1, seed);
+            } else {
+                parent[p] = p;
+                scratch->seeded[p] = seed;
+            }
+        }
+    }
+}
 
+template<typename T>
+static void VS_CC hysteresisOutputRows(int start, int end, void *userData) {
+    const HysteresisPlane<T> *d = static_cast<const HysteresisPlane<T> *>(userData);
+    const int width = d->width;
+    const uint32_t *parent = d->scratch->parent.data();
+    const uint8_t *seeded = d->scratch->seeded.data();
+
+    for (int y = start; y < end; y++) {
+        const T *srcp2 = d->srcp2 + d->stride * y;
+        T * VS_RESTRICT dstp = d->dstp + d->stride * y;
+        const uint32_t *rowp = parent + static_cast<size_t>(width) * y;
+
+        for (int x = 0; x < width; x++) {
+            if (srcp2[x] > d->lower) {
+                uint32_t r = rowp[x];
+                while (parent[r] != r)
+                    r = parent[r];
+                dstp[x] = seeded[r] ? d->upper : d->lower;
+            } else {
+                dstp[x] = d->lower;
+            }
+        }
+    }
+}
+
+template<typename T>
+static void process_frame_hysteresis(const VSFrame * src1, const VSFrame * src2, VSFrame * dst, const VSVideoFormat *fi, HysteresisScratch *scratch, const HysteresisData * d, VSFrameContext *frameCtx, const VSAPI * vsapi) VS_NOEXCEPT {
     for (int plane = 0; plane < fi->numPlanes; plane++) {
         if (d->process[plane]) {
-            if (!label)
-                label = new uint8_t[d->labelSize]();
             const int width = vsapi->getFrameWidth(src1, plane);
             const int height = vsapi->getFrameHeight(src1, plane);
-            const ptrdiff_t stride = vsapi->getStride(src1, plane) / sizeof(T);
-            const T * srcp1 = reinterpret_cast<const T *>(vsapi->getReadPtr(src1, plane));
-            const T * srcp2 = reinterpret_cast<const T *>(vsapi->getReadPtr(src2, plane));
-            T * VS_RESTRICT dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, plane));
 
-            T lower, upper;
+            HysteresisPlane<T> pd;
+            pd.srcp1 = reinterpret_cast<const T *>(vsapi->getReadPtr(src1, plane));
+            pd.srcp2 = reinterpret_cast<const T *>(vsapi->getReadPtr(src2, plane));
+            pd.dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, plane));
+            pd.stride = vsapi->getStride(src1, plane) / sizeof(T);
+            pd.width = width;
+            pd.scratch = scratch;
+
             if (std::is_integral<T>::value) {
-                lower = 0;
-                upper = d->peak;
+                pd.lower = 0;
+                pd.upper = d->peak;
             } else {
-                lower = 0.f;
-                upper = 1.f;
+                pd.lower = 0.f;
+                pd.upper = 1.f;
             }
 
-            std::fill_n(dstp, stride * height, lower);
+            // Every set pixel of clipb is written by the labeling so only the slice starts need clearing
+            scratch->parent.resize(static_cast<size_t>(width) * height);
+            scratch->seeded.resize(static_cast<size_t>(width) * height);
+            scratch->sliceStart.assign(height, 0);
+
+            const int minRows = std::max(HYSTERESIS_MIN_SLICE_PIXELS / width, 1);
+
+            // Components are labeled in independent horizontal slices and joined across the slice borders afterwards
+            vsapi->processSlices(height, minRows, hysteresisLabelRows<T>, &pd, frameCtx);
+
+            for (int y = 1; y < height; y++) {
+                if (!scratch->sliceStart[y])
+                    continue;
 
-            std::vector<std::pair<int, int>> coordinates;
+                const T *srcp2 = pd.srcp2 + pd.stride * y;
+                const T *srcp2a = srcp2 - pd.stride;
 
-            for (int y = 0; y < height; y++) {
                 for (int x = 0; x < width; x++) {
-                    if (!label[width * y + x] && srcp1[stride * y + x] > lower && srcp2[stride * y + x] > lower) {
-                        label[width * y + x] = std::numeric_limits<uint8_t>::max();
-                        dstp[stride * y + x] = upper;
-
-                        coordinates.emplace_back(std::make_pair(x, y));
-
-                        while (!coordinates.empty()) {
-                            const auto pos = coordinates.back();
-                            coordinates.pop_back();
-
-                            for (int yy = std::max(pos.second - 1, 0); yy <= std::min(pos.second + 1, height - 1); yy++) {
-                                for (int xx = std::max(pos.first - 1, 0); xx <= std::min(pos.first + 1, width - 1); xx++) {
-                                    if (!label[width * yy + xx] && srcp2[stride * yy + xx] > lower) {
-                                        label[width * yy + xx] = std::numeric_limits<uint8_t>::max();
-                                        dstp[stride * yy + xx] = upper;
-
-                                        coordinates.emplace_back(std::make_pair(xx, yy));
-                                    }
-                                }
-                            }
-                        }
+                    if (!(srcp2[x] > pd.lower))
+                        continue;
+
+                    const uint32_t p = static_cast<uint32_t>(width) * y + x;
+                    for (int xx = std::max(x - 1, 0); xx <= std::min(x + 1, width - 1); xx++) {
+                        if (srcp2a[xx] > pd.lower)
+                            hysteresisUnite(scratch, p, p - width + xx - x);
                     }
                 }
             }
+
+            vsapi->processSlices(height, minRows, hysteresisOutputRows<T>, &pd, frameCtx);
         }
     }
-
-    delete[] label;
 }
 
 static const VSFrame *VS_CC hysteresisGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
@@ -795,12 +1219,28 @@ static const VSFrame *VS_CC hysteresisGetFrame(int n, int activationReason, void
         const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src1);
         VSFrame * dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src1, 0), vsapi->getFrameHeight(src1, 0), fr, pl, src1, core);
 
+        std::unique_ptr<HysteresisScratch> scratch;
+        {
+            std::lock_guard<std::mutex> lock(d->scratchLock);
+            if (!d->scratch.empty()) {
+                scratch = std::move(d->scratch.back());
+                d->scratch.pop_back();
+            }
+        }
+        if (!scratch)
+            scratch.reset(new HysteresisScratch());
+
         if (fi->bytesPerSample == 1)
-            process_frame_hysteresis<uint8_t>(src1, src2, dst, fi, d, vsapi);
+            process_frame_hysteresis<uint8_t>(src1, src2, dst, fi, scratch.get(), d, frameCtx, vsapi);
         else if (fi->bytesPerSample == 2)
-            process_frame_hysteresis<uint16_t>(src1, src2, dst, fi, d, vsapi);
+            process_frame_hysteresis<uint16_t>(src1, src2, dst, fi, scratch.get(), d, frameCtx, vsapi);
         else
-            process_frame_hysteresis<float>(src1, src2, dst, fi, d, vsapi);
+            process_frame_hysteresis<float>(src1, src2, dst, fi, scratch.get(), d, frameCtx, vsapi);
+
+        {
+            std::lock_guard<std::mutex> lock(d->scratchLock);
+            d->scratch.push_back(std::move(scratch));
+        }
 
         vsapi->freeFrame(src1);
         vsapi->freeFrame(src2);
@@ -831,8 +1271,6 @@ static void VS_CC hysteresisCreate(const VSMap *in, VSMap *out, void *userData,
             d->peak = (1 << vi->format.bitsPerSample) - 1;
         }
 
-        d->labelSize = vi->width * vi->height;
-
     } catch (const std::runtime_error &e) {
         vsapi->mapSetError(out, ("Hysteresis: "_s + e.what()).c_str());
         return;
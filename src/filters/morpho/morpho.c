@@ -18,14 +18,35 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
 
+#include "../../core/cpufeatures.h"
+#include "../../core/kernel/cpulevel.h"
+
+#include "morpho_kernels.h"
 #include "morpho.h"
 #include "morpho_selems.h"
 #include "morpho_filters.h"
 
+static int cpuLevelFromStr(const char *name)
+{
+    if (!strcmp(name, "none"))
+        return VS_CPU_LEVEL_NONE;
+#ifdef VS_TARGET_CPU_X86
+    else if (!strcmp(name, "sse2"))
+        return VS_CPU_LEVEL_SSE2;
+    else if (!strcmp(name, "avx2"))
+        return VS_CPU_LEVEL_AVX2;
+    else if (!strcmp(name, "avx512"))
+        return VS_CPU_LEVEL_AVX512;
+#endif
+    else
+        return VS_CPU_LEVEL_MAX;
+}
+
 static void VS_CC MorphoCreate(const VSMap *in, VSMap *out, void *userData,
                                VSCore *core, const VSAPI *vsapi)
 {
@@ -84,6 +105,31 @@ static void VS_CC MorphoCreate(const VSMap *in, VSMap *out, void *userData,
 
     SElemFuncs[d.shape](d.selem, d.size);
 
+    if (!MorphoDecompose(&d)) {
+        free(d.selem);
+        free(d.runs);
+        free(d.lengths);
+        sprintf(msg, "Failed to allocate structuring element");
+        goto error;
+    }
+
+    const char *cpu = vsapi->mapGetData(in, "cpu", 0, &err);
+    const int cpulevel = err ? VS_CPU_LEVEL_MAX : cpuLevelFromStr(cpu);
+    const int word = d.vi.format.bytesPerSample == 2;
+
+    d.minRow = word ? morpho_min_word_c : morpho_min_byte_c;
+    d.maxRow = word ? morpho_max_word_c : morpho_max_byte_c;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        d.minRow = word ? morpho_min_word_avx2 : morpho_min_byte_avx2;
+        d.maxRow = word ? morpho_max_word_avx2 : morpho_max_byte_avx2;
+    } else if (cpulevel >= VS_CPU_LEVEL_SSE2) {
+        d.minRow = word ? morpho_min_word_sse2 : morpho_min_byte_sse2;
+        d.maxRow = word ? morpho_max_word_sse2 : morpho_max_byte_sse2;
+    }
+#endif
+
     data = malloc(sizeof(d));
     *data = d;
 
@@ -140,6 +186,8 @@ static void VS_CC MorphoFree(void *instanceData, VSCore *core,
 
     vsapi->freeNode(d->node);
     free(d->selem);
+    free(d->runs);
+    free(d->lengths);
     free(d);
 }
 
@@ -149,5 +197,5 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI
         VAPOURSYNTH_API_VERSION, 0, plugin);
 
     for (uintptr_t i = 0; FilterFuncs[i] && FilterNames[i]; i++)
-        vspapi->registerFunction(FilterNames[i], "clip:vnode;size:int:opt;shape:int:opt", "clip:vnode;", MorphoCreate, (void *)i, plugin);
+        vspapi->registerFunction(FilterNames[i], "clip:vnode;size:int:opt;shape:int:opt;cpu:data:opt;", "clip:vnode;", MorphoCreate, (void *)i, plugin);
 }
@@ -16,6 +16,15 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
+// A horizontal run of len set pixels in row y of the structuring element,
+// starting at offset x from the center. lidx indexes the distinct lengths.
+typedef struct MorphoRun {
+    int y;
+    int x;
+    int len;
+    int lidx;
+} MorphoRun;
+
 typedef struct MorphoData {
     VSNode *node;
     VSVideoInfo vi;
@@ -24,6 +33,15 @@ typedef struct MorphoData {
     int shape;
     int size;
 
+    MorphoRun *runs;
+    int nruns;
+    int *lengths;
+    int nlengths;
+    int rect;
+
+    MorphoRowFunc minRow;
+    MorphoRowFunc maxRow;
+
     uintptr_t filter;
 } MorphoData;
 
@@ -0,0 +1,46 @@
+/*
+ * Simple morphological filters
+ *
+ * Copyright (c) 2014, Martin Herkt <lachs0r@srsfckn.biz>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <immintrin.h>
+#include "VSHelper4.h"
+#include "morpho_kernels.h"
+
+#define MINMAX_ROW(name, T, OP, VOP) \
+void morpho_##name##_avx2(const void *a, const void *b, void *dst, int n) \
+{ \
+    const T *ap = a; \
+    const T *bp = b; \
+    T *dstp = dst; \
+    const int vec_end = n & ~(32 / (int)sizeof(T) - 1); \
+    int x; \
+ \
+    for (x = 0; x < vec_end; x += 32 / sizeof(T)) { \
+        __m256i va = _mm256_loadu_si256((const __m256i *)(ap + x)); \
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(bp + x)); \
+        _mm256_storeu_si256((__m256i *)(dstp + x), VOP(va, vb)); \
+    } \
+    for (x = vec_end; x < n; x++) \
+        dstp[x] = OP(ap[x], bp[x]); \
+}
+
+MINMAX_ROW(min_byte, uint8_t, VSMIN, _mm256_min_epu8)
+MINMAX_ROW(max_byte, uint8_t, VSMAX, _mm256_max_epu8)
+MINMAX_ROW(min_word, uint16_t, VSMIN, _mm256_min_epu16)
+MINMAX_ROW(max_word, uint16_t, VSMAX, _mm256_max_epu16)
+
+#undef MINMAX_ROW
@@ -18,10 +18,13 @@
 
 #include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
 
+#include "morpho_kernels.h"
 #include "morpho.h"
 #include "morpho_filters.h"
 
@@ -45,6 +48,79 @@ const MorphoFilter FilterFuncs[] = {
     NULL
 };
 
+#define MINMAX_ROW(name, T, OP)                                                \
+void morpho_##name##_c(const void *a, const void *b, void *dst, int n)         \
+{                                                                              \
+    const T *ap = a;                                                           \
+    const T *bp = b;                                                           \
+    T *dstp = dst;                                                             \
+    int x;                                                                     \
+                                                                               \
+    for (x = 0; x < n; x++)                                                    \
+        dstp[x] = OP(ap[x], bp[x]);                                            \
+}
+
+MINMAX_ROW(min_byte, uint8_t, VSMIN)
+MINMAX_ROW(max_byte, uint8_t, VSMAX)
+MINMAX_ROW(min_word, uint16_t, VSMIN)
+MINMAX_ROW(max_word, uint16_t, VSMAX)
+
+#undef MINMAX_ROW
+
+int MorphoDecompose(MorphoData *d)
+{
+    int hsize = d->size / 2;
+    int span = hsize * 2 + 1;
+    int i, j, k;
+
+    d->runs = malloc(sizeof(MorphoRun) * span * (hsize + 1));
+    d->lengths = malloc(sizeof(int) * span);
+    d->nruns = 0;
+    d->nlengths = 0;
+    d->rect = 0;
+
+    if (!d->runs || !d->lengths)
+        return 0;
+
+    for (j = -hsize; j <= hsize; j++) {
+        const uint8_t *row = d->selem + hsize + (j + hsize) * d->size;
+
+        for (i = -hsize; i <= hsize; i++) {
+            MorphoRun *r;
+
+            if (!row[i])
+                continue;
+
+            r = &d->runs[d->nruns++];
+            r->y = j;
+            r->x = i;
+
+            while (i < hsize && row[i + 1])
+                i++;
+
+            r->len = i - r->x + 1;
+
+            for (k = 0; k < d->nlengths && d->lengths[k] != r->len; k++);
+
+            if (k == d->nlengths)
+                d->lengths[d->nlengths++] = r->len;
+
+            r->lidx = k;
+        }
+    }
+
+    d->rect = d->nruns > 0;
+
+    for (k = 1; k < d->nruns; k++) {
+        if (d->runs[k].y != d->runs[0].y + k ||
+            d->runs[k].x != d->runs[0].x ||
+            d->runs[k].len != d->runs[0].len)
+            d->rect = 0;
+    }
+
+    return 1;
+}
+
 static inline int Border(int v, int max) {
     if (v < 0)
         v = -v;
@@ -54,6 +130,207 @@ static inline int Border(int v, int max) {
     return v;
 }
 
+static void PadRow(const uint8_t *row, uint8_t *p, int width, int hsize,
+                   int bps)
+{
+    int k;
+
+    memcpy(p + hsize * bps, row, width * bps);
+
+    for (k = 0; k < hsize; k++) {
+        int l = Border(k - hsize, width - 1);
+        int r = Border(width + k, width - 1);
+
+        memcpy(p + k * bps, row + l * bps, bps);
+        memcpy(p + (width + hsize + k) * bps, row + r * bps, bps);
+    }
+}
+
+/*
+ * van Herk/Gil-Werman running min/max. p is split into blocks of len
+ * samples, g holds the running value from the start of each block and s the
+ * one to its end. Every window of len samples spans at most two blocks, so
+ * it is OP(s[k], g[k + len - 1]). The windows starting at [start,
+ * start + count) are stored in dst.
+ */
+typedef void (*HWindowFunc)(const void *p, void *g, void *s, void *dst,
+                            int n, int len, int start, int count);
+
+#define HWINDOW(T, OP)                                                         \
+static void HWindow_##T##_##OP(const void *p, void *g, void *s, void *dst,     \
+                               int n, int len, int start, int count)          \
+{                                                                              \
+    const T *pp = p;                                                           \
+    T *gp = g;                                                                 \
+    T *sp = s;                                                                 \
+    T *dstp = dst;                                                             \
+    int b, k;                                                                  \
+                                                                               \
+    for (b = 0; b < n; b += len) {                                             \
+        int e = VSMIN(b + len, n);                                             \
+                                                                               \
+        gp[b] = pp[b];                                                         \
+        for (k = b + 1; k < e; k++)                                            \
+            gp[k] = OP(gp[k - 1], pp[k]);                                      \
+                                                                               \
+        sp[e - 1] = pp[e - 1];                                                 \
+        for (k = e - 2; k >= b; k--)                                           \
+            sp[k] = OP(sp[k + 1], pp[k]);                                      \
+    }                                                                          \
+                                                                               \
+    for (k = 0; k < count; k++)                                                \
+        dstp[k] = OP(sp[start + k], gp[start + k + len - 1]);                  \
+}
+
+HWINDOW(uint8_t, VSMIN)
+HWINDOW(uint8_t, VSMAX)
+HWINDOW(uint16_t, VSMIN)
+HWINDOW(uint16_t, VSMAX)
+
+#undef HWINDOW
+
+/*
+ * Rectangular elements are separable, the vertical pass uses the same
+ * running min/max on whole rows. Cost per pixel is independent of the size.
+ */
+static void MorphoRect(const uint8_t *src, uint8_t *dst,
+                       int width, int height, ptrdiff_t stride,
+                       const MorphoData *d, HWindowFunc hwindow,
+                       MorphoRowFunc rowop)
+{
+    int bps = d->vi.format.bytesPerSample;
+    int hsize = d->size / 2;
+    int pw = width + hsize * 2;
+    int y0 = d->runs[0].y;
+    int count = d->nruns;
+    int nv = height + count - 1;
+    ptrdiff_t rs = (ptrdiff_t)width * bps;
+    int b, q, y;
+
+    uint8_t *p = malloc(pw * bps * 3);
+    uint8_t *hplane = malloc(rs * height);
+    uint8_t *vs = malloc(rs * nv);
+    uint8_t *cur = malloc(rs);
+
+    for (y = 0; y < height; y++) {
+        PadRow(src + y * stride, p, width, hsize, bps);
+        hwindow(p, p + pw * bps, p + pw * bps * 2, hplane + y * rs, pw,
+                d->runs[0].len, d->runs[0].x + hsize, width);
+    }
+
+#define HROW(q) (hplane + Border((q) + y0, height - 1) * rs)
+
+    // Padded row q is source row q + y0 mirrored at the edges
+    for (b = 0; b < nv; b += count) {
+        int e = VSMIN(b + count, nv);
+
+        memcpy(vs + (e - 1) * rs, HROW(e - 1), rs);
+        for (q = e - 2; q >= b; q--)
+            rowop(vs + (q + 1) * rs, HROW(q), vs + q * rs, width);
+    }
+
+    for (q = 0; q < nv; q++) {
+        if (q % count == 0)
+            memcpy(cur, HROW(q), rs);
+        else
+            rowop(cur, HROW(q), cur, width);
+
+        if (q >= count - 1) {
+            y = q - count + 1;
+            rowop(vs + y * rs, cur, dst + y * stride, width);
+        }
+    }
+
+#undef HROW
+
+    free(p);
+    free(hplane);
+    free(vs);
+    free(cur);
+}
+
+/*
+ * Any other element is handled as a set of horizontal runs. The running
+ * min/max of every distinct run length is calculated once per source row and
+ * kept for the 2 * hsize + 1 rows that can use it, so the cost per pixel
+ * grows with the number of runs instead of the number of pixels.
+ */
+static void MorphoRuns(const uint8_t *src, uint8_t *dst,
+                       int width, int height, ptrdiff_t stride,
+                       const MorphoData *d, HWindowFunc hwindow,
+                       MorphoRowFunc rowop)
+{
+    int bps = d->vi.format.bytesPerSample;
+    int hsize = d->size / 2;
+    int pw = width + hsize * 2;
+    int slots = hsize * 2 + 1;
+    int nl = d->nlengths;
+    ptrdiff_t rs = (ptrdiff_t)width * bps;
+    ptrdiff_t ps = (ptrdiff_t)pw * bps;
+    int next = 0;
+    int k, l, y;
+
+    uint8_t *p = malloc(ps * 3);
+    uint8_t *ring = malloc(ps * slots * nl);
+
+#define RING(r, l) (ring + (((r) % slots) * nl + (l)) * ps)
+
+    for (y = 0; y < height; y++) {
+        int last = VSMIN(y + hsize, height - 1);
+
+        for (; next <= last; next++) {
+            PadRow(src + next * stride, p, width, hsize, bps);
+
+            for (l = 0; l < nl; l++)
+                hwindow(p, p + ps, p + ps * 2, RING(next, l), pw,
+                        d->lengths[l], 0, pw - d->lengths[l] + 1);
+        }
+
+        for (k = 0; k < d->nruns; k++) {
+            const MorphoRun *r = &d->runs[k];
+            const uint8_t *hp = RING(Border(y + r->y, height - 1), r->lidx) +
+                                (r->x + hsize) * bps;
+
+            if (k == 0)
+                memcpy(dst, hp, rs);
+            else
+                rowop(dst, hp, dst, width);
+        }
+
+        dst += stride;
+    }
+
+#undef RING
+
+    free(p);
+    free(ring);
+}
+
+// Returns 0 when the element reaches past a mirrored edge of the plane
+static int MorphoFast(const uint8_t *src, uint8_t *dst,
+                      int width, int height, ptrdiff_t stride,
+                      const MorphoData *d, int dilate)
+{
+    int hsize = d->size / 2;
+    HWindowFunc hwindow;
+    MorphoRowFunc rowop = dilate ? d->maxRow : d->minRow;
+
+    if (d->nruns == 0 || hsize >= width || hsize >= height)
+        return 0;
+
+    if (d->vi.format.bytesPerSample == 1)
+        hwindow = dilate ? HWindow_uint8_t_VSMAX : HWindow_uint8_t_VSMIN;
+    else
+        hwindow = dilate ? HWindow_uint16_t_VSMAX : HWindow_uint16_t_VSMIN;
+
+    if (d->rect)
+        MorphoRect(src, dst, width, height, stride, d, hwindow, rowop);
+    else
+        MorphoRuns(src, dst, width, height, stride, d, hwindow, rowop);
+
+    return 1;
+}
+
 #define MORPHO(T,V,OP)                                                         \
     int x, y;                                                                  \
     int hsize = d->size / 2;                                                   \
@@ -85,6 +362,9 @@ static inline int Border(int v, int max) {
 void MorphoDilate(const uint8_t *src, uint8_t *dst,
                   int width, int height, ptrdiff_t stride, MorphoData *d)
 {
+    if (MorphoFast(src, dst, width, height, stride, d, 1))
+        return;
+
     if (d->vi.format.bytesPerSample == 1) {
         MORPHO(uint8_t, 0, VSMAX);
     } else {
@@ -97,6 +377,9 @@ void MorphoErode(const uint8_t *src, uint8_t *dst,
 {
     int sval = (1 << d->vi.format.bitsPerSample) - 1;
 
+    if (MorphoFast(src, dst, width, height, stride, d, 0))
+        return;
+
     if (d->vi.format.bytesPerSample == 1) {
         MORPHO(uint8_t, sval, VSMIN);
     } else {
@@ -31,5 +31,8 @@ void MorphoTopHat(const uint8_t *src, uint8_t *dst,
 void MorphoBottomHat(const uint8_t *src, uint8_t *dst,
                      int width, int height, ptrdiff_t stride, MorphoData *d);
 
+// Splits the structuring element into horizontal runs, returns 0 on failure
+int MorphoDecompose(MorphoData *d);
+
 extern const char *FilterNames[];
 extern const MorphoFilter FilterFuncs[];
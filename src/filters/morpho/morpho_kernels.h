@@ -0,0 +1,45 @@
+/*
+ * Simple morphological filters
+ *
+ * Copyright (c) 2014, Martin Herkt <lachs0r@srsfckn.biz>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MORPHO_KERNELS_H
+#define MORPHO_KERNELS_H
+
+#include <stdint.h>
+
+/*
+ * dst[x] = min(a[x], b[x]) or max(a[x], b[x]) for n samples. dst may be the
+ * same as a or b.
+ */
+typedef void (*MorphoRowFunc)(const void *a, const void *b, void *dst, int n);
+
+#define DECL_MINMAX_ROW(isa) \
+    void morpho_min_byte_##isa(const void *a, const void *b, void *dst, int n); \
+    void morpho_max_byte_##isa(const void *a, const void *b, void *dst, int n); \
+    void morpho_min_word_##isa(const void *a, const void *b, void *dst, int n); \
+    void morpho_max_word_##isa(const void *a, const void *b, void *dst, int n);
+
+DECL_MINMAX_ROW(c)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_MINMAX_ROW(sse2)
+DECL_MINMAX_ROW(avx2)
+#endif
+
+#undef DECL_MINMAX_ROW
+
+#endif // MORPHO_KERNELS_H
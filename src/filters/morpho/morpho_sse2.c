@@ -0,0 +1,57 @@
+/*
+ * Simple morphological filters
+ *
+ * Copyright (c) 2014, Martin Herkt <lachs0r@srsfckn.biz>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <emmintrin.h>
+#include "VSHelper4.h"
+#include "morpho_kernels.h"
+
+// sse2 has no unsigned 16 bit min and max, a - (a - b) and (a - b) + b saturate to them
+static inline __m128i min_epu16(__m128i a, __m128i b)
+{
+    return _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+}
+
+static inline __m128i max_epu16(__m128i a, __m128i b)
+{
+    return _mm_add_epi16(_mm_subs_epu16(a, b), b);
+}
+
+#define MINMAX_ROW(name, T, OP, VOP) \
+void morpho_##name##_sse2(const void *a, const void *b, void *dst, int n) \
+{ \
+    const T *ap = a; \
+    const T *bp = b; \
+    T *dstp = dst; \
+    const int vec_end = n & ~(16 / (int)sizeof(T) - 1); \
+    int x; \
+ \
+    for (x = 0; x < vec_end; x += 16 / sizeof(T)) { \
+        __m128i va = _mm_loadu_si128((const __m128i *)(ap + x)); \
+        __m128i vb = _mm_loadu_si128((const __m128i *)(bp + x)); \
+        _mm_storeu_si128((__m128i *)(dstp + x), VOP(va, vb)); \
+    } \
+    for (x = vec_end; x < n; x++) \
+        dstp[x] = OP(ap[x], bp[x]); \
+}
+
+MINMAX_ROW(min_byte, uint8_t, VSMIN, _mm_min_epu8)
+MINMAX_ROW(max_byte, uint8_t, VSMAX, _mm_max_epu8)
+MINMAX_ROW(min_word, uint16_t, VSMIN, min_epu16)
+MINMAX_ROW(max_word, uint16_t, VSMAX, max_epu16)
+
+#undef MINMAX_ROW
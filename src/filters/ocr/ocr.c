@@ -18,14 +18,58 @@
 
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #include <tesseract/capi.h>
 
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
 
+#ifdef _WIN32
+typedef SRWLOCK OCRLock;
+#define OCRLockInit(l) InitializeSRWLock(l)
+#define OCRLockDestroy(l) ((void)(l))
+#define OCRLockAcquire(l) AcquireSRWLockExclusive(l)
+#define OCRLockRelease(l) ReleaseSRWLockExclusive(l)
+#else
+typedef pthread_mutex_t OCRLock;
+#define OCRLockInit(l) pthread_mutex_init((l), NULL)
+#define OCRLockDestroy(l) pthread_mutex_destroy(l)
+#define OCRLockAcquire(l) pthread_mutex_lock(l)
+#define OCRLockRelease(l) pthread_mutex_unlock(l)
+#endif
+
+/* An initialized Tesseract instance. Loading the language data is by far the
+   slowest part of OCR so instances are kept until the filter is freed, there
+   are never more of them than frames that were processed at the same time. */
+typedef struct OCREngine {
+    TessBaseAPI *api;
+    struct OCREngine *next;
+} OCREngine;
+
+/* The result for an area that was recognized recently, frames with an
+   identical area reuse it instead of running Tesseract again. */
+typedef struct OCRResult {
+    uint8_t *pixels;
+    int width, height;
+    uint64_t hash;
+    char *text;
+    int length;
+    int *confs;
+    int numConfs;
+} OCRResult;
+
+#define OCR_RESULT_CACHE_SIZE 8
+
 typedef struct OCRData {
     VSNode *node;
     VSVideoInfo vi;
@@ -33,11 +77,40 @@ typedef struct OCRData {
     VSMap *options;
     char *datapath;
     char *language;
+
+    int left, top, width, height; /* zero width and height extend to the frame edge */
+    int reuse;
+
+    OCRLock lock;
+    OCREngine *engines;
+    OCRResult results[OCR_RESULT_CACHE_SIZE];
+    int nextResult;
 } OCRData;
 
+static void freeResult(OCRResult *r) {
+    free(r->pixels);
+    free(r->text);
+    free(r->confs);
+    memset(r, 0, sizeof(*r));
+}
+
 static void VS_CC OCRFree(void *instanceData, VSCore *core,
     const VSAPI *vsapi) {
     OCRData *d = (OCRData *)instanceData;
+    int i;
+
+    while (d->engines) {
+        OCREngine *e = d->engines;
+        d->engines = e->next;
+        TessBaseAPIEnd(e->api);
+        TessBaseAPIDelete(e->api);
+        free(e);
+    }
+
+    for (i = 0; i < OCR_RESULT_CACHE_SIZE; i++)
+        freeResult(&d->results[i]);
+
+    OCRLockDestroy(&d->lock);
 
     vsapi->freeNode(d->node);
     vsapi->freeMap(d->options);
@@ -46,6 +119,165 @@ static void VS_CC OCRFree(void *instanceData, VSCore *core,
     free(d);
 }
 
+/* Returns an engine from the pool or initializes a new one. On failure NULL is
+   returned and msg holds the reason. */
+static OCREngine *acquireEngine(OCRData *d, char *msg, size_t msgSize,
+    const VSAPI *vsapi) {
+    OCREngine *e;
+
+    OCRLockAcquire(&d->lock);
+    e = d->engines;
+    if (e)
+        d->engines = e->next;
+    OCRLockRelease(&d->lock);
+
+    if (e)
+        return e;
+
+    e = malloc(sizeof(OCREngine));
+    if (!e) {
+        snprintf(msg, msgSize, "Failed to allocate memory for Tesseract");
+        return NULL;
+    }
+
+    e->api = TessBaseAPICreate();
+    if (TessBaseAPIInit3(e->api, d->datapath, d->language) == -1) {
+        snprintf(msg, msgSize, "Failed to initialize Tesseract");
+        TessBaseAPIDelete(e->api);
+        free(e);
+        return NULL;
+    }
+
+    if (d->options) {
+        int i, err;
+        int nopts = vsapi->mapNumElements(d->options, "options");
+
+        for (i = 0; i < nopts; i += 2) {
+            const char *key = vsapi->mapGetData(d->options, "options",
+                i, &err);
+            const char *value = vsapi->mapGetData(d->options, "options",
+                i + 1, &err);
+
+            if (!TessBaseAPISetVariable(e->api, key, value)) {
+                snprintf(msg, msgSize,
+                    "Failed to set Tesseract option '%s'", key);
+
+                TessBaseAPIEnd(e->api);
+                TessBaseAPIDelete(e->api);
+                free(e);
+                return NULL;
+            }
+        }
+    }
+
+    return e;
+}
+
+static void releaseEngine(OCRData *d, OCREngine *e) {
+    OCRLockAcquire(&d->lock);
+    e->next = d->engines;
+    d->engines = e;
+    OCRLockRelease(&d->lock);
+}
+
+/* FNV-1a over the rows of the area */
+static uint64_t hashArea(const uint8_t *srcp, ptrdiff_t stride, int width,
+    int height) {
+    uint64_t hash = 14695981039346656037ULL;
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            hash ^= srcp[x];
+            hash *= 1099511628211ULL;
+        }
+        srcp += stride;
+    }
+
+    return hash;
+}
+
+static int sameArea(const uint8_t *pixels, const uint8_t *srcp,
+    ptrdiff_t stride, int width, int height) {
+    int y;
+
+    for (y = 0; y < height; y++) {
+        if (memcmp(pixels + (size_t)y * width, srcp, width))
+            return 0;
+        srcp += stride;
+    }
+
+    return 1;
+}
+
+static void setResultProps(VSMap *m, const char *text, int length,
+    const int *confs, int numConfs, const VSAPI *vsapi) {
+    int i;
+
+    vsapi->mapSetData(m, "OCRString", text, length, dtUtf8, maReplace);
+
+    for (i = 0; i < numConfs; i++) {
+        vsapi->mapSetInt(m, "OCRConfidence", confs[i], maAppend);
+    }
+}
+
+/* Copies the props from a cached result for an identical area, if there is one */
+static int findResult(OCRData *d, uint64_t hash, const uint8_t *srcp,
+    ptrdiff_t stride, int width, int height, VSMap *m, const VSAPI *vsapi) {
+    int i, found = 0;
+
+    OCRLockAcquire(&d->lock);
+    for (i = 0; i < OCR_RESULT_CACHE_SIZE && !found; i++) {
+        OCRResult *r = &d->results[i];
+
+        if (r->pixels && r->hash == hash && r->width == width &&
+            r->height == height &&
+            sameArea(r->pixels, srcp, stride, width, height)) {
+            setResultProps(m, r->text, r->length, r->confs, r->numConfs,
+                vsapi);
+            found = 1;
+        }
+    }
+    OCRLockRelease(&d->lock);
+
+    return found;
+}
+
+/* Remembers a result in place of the oldest one, failed allocations just
+   mean it isn't remembered */
+static void storeResult(OCRData *d, uint64_t hash, const uint8_t *srcp,
+    ptrdiff_t stride, int width, int height, const char *text, int length,
+    const int *confs, int numConfs) {
+    OCRResult r;
+    int y;
+
+    r.width = width;
+    r.height = height;
+    r.hash = hash;
+    r.length = length;
+    r.numConfs = numConfs;
+    r.pixels = malloc((size_t)width * height);
+    r.text = malloc(length + 1);
+    r.confs = malloc((numConfs + 1) * sizeof(int));
+
+    if (!r.pixels || !r.text || !r.confs) {
+        freeResult(&r);
+        return;
+    }
+
+    for (y = 0; y < height; y++)
+        memcpy(r.pixels + (size_t)y * width, srcp + y * stride, width);
+    memcpy(r.text, text, length);
+    r.text[length] = '\0';
+    memcpy(r.confs, confs, numConfs * sizeof(int));
+
+    OCRLockAcquire(&d->lock);
+    freeResult(&d->results[d->nextResult]);
+    d->results[d->nextResult] = r;
+    d->nextResult = (d->nextResult + 1) % OCR_RESULT_CACHE_SIZE;
+    OCRLockRelease(&d->lock);
+}
+
 static const VSFrame *VS_CC OCRGetFrame(int n, int activationReason,
     void *instanceData,
     void **frameData,
@@ -61,71 +293,71 @@ static const VSFrame *VS_CC OCRGetFrame(int n, int activationReason,
         VSFrame *dst = vsapi->copyFrame(src, core);
         VSMap *m = vsapi->getFramePropertiesRW(dst);
 
-        const uint8_t *srcp = vsapi->getReadPtr(src, 0);
-        int width = vsapi->getFrameWidth(src, 0);
-        int height = vsapi->getFrameHeight(src, 0);
         ptrdiff_t stride = vsapi->getStride(src, 0);
-
-        TessBaseAPI *api = TessBaseAPICreate();
-        if (TessBaseAPIInit3(api, d->datapath, d->language) == -1) {
-            vsapi->setFilterError("Failed to initialize Tesseract", frameCtx);
-
-            TessBaseAPIDelete(api);
+        int frameWidth = vsapi->getFrameWidth(src, 0);
+        int frameHeight = vsapi->getFrameHeight(src, 0);
+        int width = d->width ? d->width : frameWidth - d->left;
+        int height = d->height ? d->height : frameHeight - d->top;
+        const uint8_t *srcp;
+        uint64_t hash = 0;
+        OCREngine *e;
+        char msg[200];
+
+        if (width <= 0 || height <= 0 || d->left + width > frameWidth ||
+            d->top + height > frameHeight) {
+            vsapi->setFilterError("The OCR area doesn't fit in the frame",
+                frameCtx);
             vsapi->freeFrame(src);
             vsapi->freeFrame(dst);
 
             return 0;
         }
 
-        if (d->options) {
-            int i, err;
-            int nopts = vsapi->mapNumElements(d->options, "options");
-
-            for (i = 0; i < nopts; i += 2) {
-                const char *key = vsapi->mapGetData(d->options, "options",
-                    i, &err);
-                const char *value = vsapi->mapGetData(d->options, "options",
-                    i + 1, &err);
-
-                if (!TessBaseAPISetVariable(api, key, value)) {
-                    char msg[200];
+        srcp = vsapi->getReadPtr(src, 0) + d->top * stride + d->left;
 
-                    snprintf(msg, 200,
-                        "Failed to set Tesseract option '%s'", key);
+        if (d->reuse) {
+            hash = hashArea(srcp, stride, width, height);
 
-                    vsapi->setFilterError(msg, frameCtx);
+            if (findResult(d, hash, srcp, stride, width, height, m, vsapi)) {
+                vsapi->freeFrame(src);
+                return dst;
+            }
+        }
 
-                    TessBaseAPIEnd(api);
-                    TessBaseAPIDelete(api);
-                    vsapi->freeFrame(src);
-                    vsapi->freeFrame(dst);
+        e = acquireEngine(d, msg, sizeof(msg), vsapi);
+        if (!e) {
+            vsapi->setFilterError(msg, frameCtx);
+            vsapi->freeFrame(src);
+            vsapi->freeFrame(dst);
 
-                    return 0;
-                }
-            }
+            return 0;
         }
 
+        /* Start every frame from the state of a freshly loaded engine */
+        TessBaseAPIClearAdaptiveClassifier(e->api);
+
         {
-            unsigned i;
+            int numConfs;
 
-            char *result = TessBaseAPIRect(api, srcp, 1,
+            char *result = TessBaseAPIRect(e->api, srcp, 1,
                 stride, 0, 0, width, height);
-            int *confs = TessBaseAPIAllWordConfidences(api);
+            int *confs = TessBaseAPIAllWordConfidences(e->api);
             int length = strlen(result);
 
             for (; length > 0 && isspace(result[length - 1]); length--);
-            vsapi->mapSetData(m, "OCRString", result, length, dtUtf8, maReplace);
+            for (numConfs = 0; confs[numConfs] != -1; numConfs++);
 
-            for (i = 0; confs[i] != -1; i++) {
-                vsapi->mapSetInt(m, "OCRConfidence", confs[i], maAppend);
-            }
+            setResultProps(m, result, length, confs, numConfs, vsapi);
+            if (d->reuse)
+                storeResult(d, hash, srcp, stride, width, height, result,
+                    length, confs, numConfs);
 
             free(confs);
             free(result);
         }
 
-        TessBaseAPIEnd(api);
-        TessBaseAPIDelete(api);
+        TessBaseAPIClear(e->api);
+        releaseEngine(d, e);
         vsapi->freeFrame(src);
 
         return dst;
@@ -161,6 +393,7 @@ static void VS_CC OCRCreate(const VSMap *in, VSMap *out, void *userData,
     int size;
     const char *opt;
 
+    memset(&d, 0, sizeof(d));
     d.node = vsapi->mapGetNode(in, "clip", 0, 0);
     d.vi = *vsapi->getVideoInfo(d.node);
     d.options = NULL;
@@ -180,6 +413,23 @@ static void VS_CC OCRCreate(const VSMap *in, VSMap *out, void *userData,
         goto error;
     }
 
+    d.left = vsapi->mapGetIntSaturated(in, "left", 0, &err);
+    d.top = vsapi->mapGetIntSaturated(in, "top", 0, &err);
+    d.width = vsapi->mapGetIntSaturated(in, "width", 0, &err);
+    d.height = vsapi->mapGetIntSaturated(in, "height", 0, &err);
+    d.reuse = !!vsapi->mapGetInt(in, "reuse", 0, &err);
+
+    if (d.left < 0 || d.top < 0 || d.width < 0 || d.height < 0) {
+        msg = "The OCR area can't have negative coordinates or dimensions";
+        goto error;
+    }
+
+    if (d.vi.width && (d.left + (d.width ? d.width : 1) > d.vi.width ||
+        d.top + (d.height ? d.height : 1) > d.vi.height)) {
+        msg = "The OCR area doesn't fit in the frame";
+        goto error;
+    }
+
     if ((nopts = vsapi->mapNumElements(in, "options")) > 0) {
         if (nopts % 2) {
             msg = "Options must be key,value pairs";
@@ -243,6 +493,7 @@ static void VS_CC OCRCreate(const VSMap *in, VSMap *out, void *userData,
 
     data = malloc(sizeof(d));
     *data = d;
+    OCRLockInit(&data->lock);
 
     VSFilterDependency deps[] = {{ d.node, rpStrictSpatial }};
     vsapi->createVideoFilter(out, "OCR", &d.vi,
@@ -262,5 +513,5 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->configPlugin("biz.srsfckn.ocr", "ocr", "Tesseract OCR Filter", VS_MAKE_VERSION(1, 0), VAPOURSYNTH_API_VERSION, 0, plugin);
-    vspapi->registerFunction("Recognize", "clip:vnode;datapath:data:opt;language:data:opt;options:data[]:opt", "clip:vnode;", OCRCreate, 0, plugin);
+    vspapi->registerFunction("Recognize", "clip:vnode;datapath:data:opt;language:data:opt;options:data[]:opt;left:int:opt;top:int:opt;width:int:opt;height:int:opt;reuse:int:opt;", "clip:vnode;", OCRCreate, 0, plugin);
 }
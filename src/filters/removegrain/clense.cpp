@@ -25,11 +25,9 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include <limits>
-#include "shared.h"
+#include "clense.h"
 
 #define CLENSE_RETERROR(x) do { vsapi->mapSetError(out, (x)); vsapi->freeNode(d.cnode); vsapi->freeNode(d.pnode); vsapi->freeNode(d.nnode); return; } while (0)
-#define CLAMP(value, lower, upper) do { if (value < lower) value = lower; else if (value > upper) value = upper; } while(0)
 
 typedef struct {
     VSNode *cnode;
@@ -38,45 +36,16 @@ typedef struct {
     const VSVideoInfo *vi;
     int mode;
     int process[3];
+    ClensePlaneProc proc;
 } ClenseData;
 
-struct PlaneProc {
-    template<typename T>
-    static void clenseProcessPlane(T* VS_RESTRICT pDst, const T* VS_RESTRICT pSrc, const T* VS_RESTRICT pRef1, const T* VS_RESTRICT pRef2, ptrdiff_t stride, int width, int height) {
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x)
-                pDst[x] = std::min(std::max(pSrc[x], std::min(pRef1[x], pRef2[x])), std::max(pRef1[x], pRef2[x]));
-            pDst += stride;
-            pSrc += stride;
-            pRef1 += stride;
-            pRef2 += stride;
-        }
-    }
-};
-
-struct PlaneProcFB {
-    template<typename T>
-    static void clenseProcessPlane(T* VS_RESTRICT pDst, const T* VS_RESTRICT pSrc, const T* VS_RESTRICT pRef1, const T* VS_RESTRICT pRef2, ptrdiff_t stride, int width, int height) {
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                T minref = std::min(pRef1[x], pRef2[x]);
-                T maxref = std::max(pRef1[x], pRef2[x]);
-                int lowref = minref * 2 - pRef2[x];
-                int upref = maxref * 2 - pRef2[x];
-                T src = pSrc[x];
-                CLAMP(src, std::max<int>(lowref, std::numeric_limits<T>::min()), std::min<int>(upref, std::numeric_limits<T>::max()));
-                pDst[x] = src;
-            }
-
-            pDst += stride;
-            pSrc += stride;
-            pRef1 += stride;
-            pRef2 += stride;
-        }
-    }
-};
+static ClensePlaneProc selectPlaneProcCpp(int mode, int bytesPerSample) {
+    if (mode == cmNormal)
+        return (bytesPerSample == 1) ? clense::clenseProcessPlane<uint8_t, clense::PlaneProc> : clense::clenseProcessPlane<uint16_t, clense::PlaneProc>;
+    else
+        return (bytesPerSample == 1) ? clense::clenseProcessPlane<uint8_t, clense::PlaneProcFB> : clense::clenseProcessPlane<uint16_t, clense::PlaneProcFB>;
+}
 
-template<typename T, typename Processor>
 static const VSFrame *VS_CC clenseGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     ClenseData *d = static_cast<ClenseData *>(instanceData);
 
@@ -133,12 +102,12 @@ static const VSFrame *VS_CC clenseGetFrame(int n, int activationReason, void *in
         int numPlanes = d->vi->format.numPlanes;
         for (int i = 0; i < numPlanes; i++) {
             if (d->process[i]) {
-                Processor::template clenseProcessPlane<T>(
-                    reinterpret_cast<T *>(vsapi->getWritePtr(dst, i)),
-                    reinterpret_cast<const T *>(vsapi->getReadPtr(src, i)),
-                    reinterpret_cast<const T *>(vsapi->getReadPtr(frame1, i)),
-                    reinterpret_cast<const T *>(vsapi->getReadPtr(frame2, i)),
-                    vsapi->getStride(dst, i)/sizeof(T),
+                d->proc(
+                    vsapi->getWritePtr(dst, i),
+                    vsapi->getReadPtr(src, i),
+                    vsapi->getReadPtr(frame1, i),
+                    vsapi->getReadPtr(frame2, i),
+                    vsapi->getStride(dst, i),
                     vsapi->getFrameWidth(dst, i),
                     vsapi->getFrameHeight(dst, i));
             }
@@ -208,27 +177,25 @@ void VS_CC clenseCreate(const VSMap *in, VSMap *out, void *userData, VSCore *cor
         d.process[o] = 1;
     }
 
-    VSFilterGetFrame getFrameFunc = nullptr;
-    if (d.vi->format.sampleType == stInteger) {
-        if (d.mode == cmNormal) {
-            switch (d.vi->format.bitsPerSample) {
-            case 8: getFrameFunc = clenseGetFrame<uint8_t, PlaneProc>; break;
-            case 16: getFrameFunc = clenseGetFrame<uint16_t, PlaneProc>; break;
-            }
-        } else {
-            switch (d.vi->format.bitsPerSample) {
-            case 8: getFrameFunc = clenseGetFrame<uint8_t, PlaneProcFB>; break;
-            case 16: getFrameFunc = clenseGetFrame<uint16_t, PlaneProcFB>; break;
-            }
-        }
-    }
-
-    if (!getFrameFunc)
+    if (d.vi->format.sampleType != stInteger || (d.vi->format.bitsPerSample != 8 && d.vi->format.bitsPerSample != 16))
         CLENSE_RETERROR("Clense: only 8 and 16 bit integer input supported");
 
+    const int cpulevel = getCPULevel(in, vsapi);
+
+#ifdef VS_TARGET_CPU_X86
+    if (cpulevel >= VS_CPU_LEVEL_AVX512)
+        d.proc = getClensePlaneProc_avx512(d.mode, d.vi->format.bytesPerSample);
+    else if (cpulevel >= VS_CPU_LEVEL_AVX2)
+        d.proc = getClensePlaneProc_avx2(d.mode, d.vi->format.bytesPerSample);
+    else if (cpulevel >= VS_CPU_LEVEL_SSE2)
+        d.proc = clense::selectPlaneProc<__m128i>(d.mode, d.vi->format.bytesPerSample);
+    else
+#endif
+        d.proc = selectPlaneProcCpp(d.mode, d.vi->format.bytesPerSample);
+
     data = new ClenseData(d);
 
     VSFilterDependency deps3[] = {{d.cnode, rpStrictSpatial}, {d.nnode, rpNoFrameReuse}, {d.pnode, rpNoFrameReuse}};
     VSFilterDependency deps1[] = {{d.cnode, rpGeneral}};
-    vsapi->createVideoFilter(out, "Clense", data->vi, getFrameFunc, clenseFree, fmParallel, (d.mode == cmNormal) ? deps3 : deps1, (d.mode == cmNormal) ? 3 : 1, data, core);
+    vsapi->createVideoFilter(out, "Clense", data->vi, clenseGetFrame, clenseFree, fmParallel, (d.mode == cmNormal) ? deps3 : deps1, (d.mode == cmNormal) ? 3 : 1, data, core);
 }
@@ -0,0 +1,132 @@
+/*
+VapourSynth adaption by Fredrik Mellbin
+
+Copyright(c) 2013 Victor Efimov
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files(the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions :
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CLENSE_H
+#define CLENSE_H
+
+#include <limits>
+#include "shared.h"
+
+namespace clense {
+namespace {
+
+#define CLAMP(value, lower, upper) do { if (value < lower) value = lower; else if (value > upper) value = upper; } while(0)
+
+struct PlaneProc {
+    template<typename T>
+    static __forceinline T clense(T src, T ref1, T ref2) {
+        return std::min(std::max(src, std::min(ref1, ref2)), std::max(ref1, ref2));
+    }
+
+#ifdef VS_TARGET_CPU_X86
+    template<typename T, typename V>
+    static __forceinline V clense(V src, V ref1, V ref2) {
+        return min_px<T>(max_px<T>(src, min_px<T>(ref1, ref2)), max_px<T>(ref1, ref2));
+    }
+#endif
+};
+
+struct PlaneProcFB {
+    template<typename T>
+    static __forceinline T clense(T src, T ref1, T ref2) {
+        T minref = std::min(ref1, ref2);
+        T maxref = std::max(ref1, ref2);
+        int lowref = minref * 2 - ref2;
+        int upref = maxref * 2 - ref2;
+        CLAMP(src, std::max<int>(lowref, std::numeric_limits<T>::min()), std::min<int>(upref, std::numeric_limits<T>::max()));
+        return src;
+    }
+
+#ifdef VS_TARGET_CPU_X86
+    // ref2 lies between minref and maxref so only the outer additions need to saturate.
+    template<typename T, typename V>
+    static __forceinline V clense(V src, V ref1, V ref2) {
+        const V minref = min_px<T>(ref1, ref2);
+        const V maxref = max_px<T>(ref1, ref2);
+        const V lowref = subs_px<T>(minref, subs_px<T>(ref2, minref));
+        const V upref = adds_px<T>(maxref, subs_px<T>(maxref, ref2));
+        return min_px<T>(max_px<T>(src, lowref), upref);
+    }
+#endif
+};
+
+#undef CLAMP
+
+template<typename T, typename Processor>
+static void clenseProcessPlane(void *dst, const void *src, const void *ref1, const void *ref2, ptrdiff_t stride, int width, int height) {
+    T * VS_RESTRICT pDst = static_cast<T *>(dst);
+    const T * VS_RESTRICT pSrc = static_cast<const T *>(src);
+    const T * VS_RESTRICT pRef1 = static_cast<const T *>(ref1);
+    const T * VS_RESTRICT pRef2 = static_cast<const T *>(ref2);
+    stride /= sizeof(T);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x)
+            pDst[x] = Processor::clense(pSrc[x], pRef1[x], pRef2[x]);
+        pDst += stride;
+        pSrc += stride;
+        pRef1 += stride;
+        pRef2 += stride;
+    }
+}
+
+#ifdef VS_TARGET_CPU_X86
+template<typename V, typename T, typename Processor>
+static void clenseProcessPlaneSIMD(void *dst, const void *src, const void *ref1, const void *ref2, ptrdiff_t stride, int width, int height) {
+    T * VS_RESTRICT pDst = static_cast<T *>(dst);
+    const T * VS_RESTRICT pSrc = static_cast<const T *>(src);
+    const T * VS_RESTRICT pRef1 = static_cast<const T *>(ref1);
+    const T * VS_RESTRICT pRef2 = static_cast<const T *>(ref2);
+    const int step = sizeof(V) / sizeof(T);
+    const int wv = width & -step;
+    stride /= sizeof(T);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < wv; x += step)
+            storeu(pDst + x, Processor::template clense<T>(loadu<V>(pSrc + x), loadu<V>(pRef1 + x), loadu<V>(pRef2 + x)));
+        for (int x = wv; x < width; ++x)
+            pDst[x] = Processor::clense(pSrc[x], pRef1[x], pRef2[x]);
+        pDst += stride;
+        pSrc += stride;
+        pRef1 += stride;
+        pRef2 += stride;
+    }
+}
+
+template<typename V>
+static ClensePlaneProc selectPlaneProc(int mode, int bytesPerSample) {
+    if (mode == cmNormal)
+        return (bytesPerSample == 1) ? clenseProcessPlaneSIMD<V, uint8_t, PlaneProc> : clenseProcessPlaneSIMD<V, uint16_t, PlaneProc>;
+    else
+        return (bytesPerSample == 1) ? clenseProcessPlaneSIMD<V, uint8_t, PlaneProcFB> : clenseProcessPlaneSIMD<V, uint16_t, PlaneProcFB>;
+}
+#endif
+
+} // namespace
+} // namespace clense
+
+#endif
@@ -0,0 +1,36 @@
+/*****************************************************************************
+
+        AvsFilterRemoveGrain/Repair16
+        Author: Laurent de Soras, 2012
+        Modified for VapourSynth by Fredrik Mellbin 2013
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+#include "removegrainvs.h"
+#include "repairvs.h"
+#include "clense.h"
+#include "verticalcleaner.h"
+
+RemoveGrainPlaneProc getRemoveGrainPlaneProc_avx2(int mode, int bytesPerSample) {
+    return removegrain::selectPlaneProc<__m256i>(mode, bytesPerSample);
+}
+
+RepairPlaneProc getRepairPlaneProc_avx2(int mode, int bytesPerSample) {
+    return repair::selectPlaneProc<__m256i>(mode, bytesPerSample);
+}
+
+ClensePlaneProc getClensePlaneProc_avx2(int mode, int bytesPerSample) {
+    return clense::selectPlaneProc<__m256i>(mode, bytesPerSample);
+}
+
+VerticalCleanerPlaneProc getVerticalCleanerPlaneProc_avx2(int mode, int bytesPerSample) {
+    return verticalcleaner::selectPlaneProc<__m256i>(mode, bytesPerSample);
+}
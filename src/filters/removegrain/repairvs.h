@@ -0,0 +1,1859 @@
+/*****************************************************************************
+
+        AvsFilterRemoveGrain/Repair16
+        Author: Laurent de Soras, 2012
+        Modified for VapourSynth by Fredrik Mellbin 2013
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+#ifndef REPAIRVS_H
+#define REPAIRVS_H
+
+#include "shared.h"
+
+namespace repair {
+namespace {
+
+
+#ifdef VS_TARGET_CPU_X86
+
+class ConvSigned
+{
+public:
+    template<typename V>
+    static __forceinline V cv (V a, V m)
+    {
+        return (xor_si (a, m));
+    }
+};
+
+
+class ConvUnsigned
+{
+public:
+    template<typename V>
+    static __forceinline V cv (V a, V m)
+    {
+        return (a);
+    }
+};
+
+#define AvsFilterRepair16_READ_PIX    \
+   const ptrdiff_t      om = stride_src2 - 1;     \
+   const ptrdiff_t      o0 = stride_src2    ;     \
+   const ptrdiff_t      op = stride_src2 + 1;     \
+   V              cr = ConvSign::cv (load_px<V> (src1_ptr + 0 ), mask_sign); \
+   V              a1 = ConvSign::cv (load_px<V> (src2_ptr - op), mask_sign); \
+   V              a2 = ConvSign::cv (load_px<V> (src2_ptr - o0), mask_sign); \
+   V              a3 = ConvSign::cv (load_px<V> (src2_ptr - om), mask_sign); \
+   V              a4 = ConvSign::cv (load_px<V> (src2_ptr - 1 ), mask_sign); \
+   V              c  = ConvSign::cv (load_px<V> (src2_ptr + 0 ), mask_sign); \
+   V              a5 = ConvSign::cv (load_px<V> (src2_ptr + 1 ), mask_sign); \
+   V              a6 = ConvSign::cv (load_px<V> (src2_ptr + om), mask_sign); \
+   V              a7 = ConvSign::cv (load_px<V> (src2_ptr + o0), mask_sign); \
+   V              a8 = ConvSign::cv (load_px<V> (src2_ptr + op), mask_sign);
+
+#define AvsFilterRepair16_SORT_AXIS_SSE2   \
+    const V  ma1 = max_epi16(a1, a8); \
+    const V  mi1 = min_epi16(a1, a8); \
+    const V  ma2 = max_epi16(a2, a7); \
+    const V  mi2 = min_epi16(a2, a7); \
+    const V  ma3 = max_epi16(a3, a6); \
+    const V  mi3 = min_epi16(a3, a6); \
+    const V  ma4 = max_epi16(a4, a5); \
+    const V  mi4 = min_epi16(a4, a5);
+
+#else
+
+class ConvSigned
+{
+};
+
+
+class ConvUnsigned
+{
+};
+#endif
+
+#define AvsFilterRepair16_SORT_AXIS_CPP \
+    const int      ma1 = std::max(a1, a8);   \
+    const int      mi1 = std::min(a1, a8);   \
+    const int      ma2 = std::max(a2, a7);   \
+    const int      mi2 = std::min(a2, a7);   \
+    const int      ma3 = std::max(a3, a6);   \
+    const int      mi3 = std::min(a3, a6);   \
+    const int      ma4 = std::max(a4, a5);   \
+    const int      mi4 = std::min(a4, a5);
+
+
+class OpRG01
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg (int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int        mi = std::min (std::min (
+            std::min (std::min (a1, a2), std::min (a3, a4)),
+            std::min (std::min (a5, a6), std::min (a7, a8))
+        ), c);
+        const int        ma = std::max (std::max (
+            std::max (std::max (a1, a2), std::max (a3, a4)),
+            std::max (std::max (a5, a6), std::max (a7, a8))
+        ), c);
+
+        return (limit (cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V    mi = min_epi16 (min_epi16 (
+            min_epi16 (min_epi16 (a1, a2), min_epi16 (a3, a4)),
+            min_epi16 (min_epi16 (a5, a6), min_epi16 (a7, a8))
+        ), c);
+        const V    ma = max_epi16 (max_epi16 (
+            max_epi16 (max_epi16 (a1, a2), max_epi16 (a3, a4)),
+            max_epi16 (max_epi16 (a5, a6), max_epi16 (a7, a8))
+        ), c);
+
+        return (min_epi16 (max_epi16 (cr, mi), ma));
+    }
+#endif
+};
+
+class OpRG02
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg (int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        int                a [9] = { a1, a2, a3, a4, c, a5, a6, a7, a8 };
+
+        std::sort (&a [0], (&a [8]) + 1);
+
+        return (limit (cr, a [2-1], a [7]));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        sort_pair (a1, a8);
+
+        sort_pair (a1,  c);
+        sort_pair (a2, a5);
+        sort_pair (a3, a6);
+        sort_pair (a4, a7);
+        sort_pair ( c, a8);
+
+        sort_pair (a1, a3);
+        sort_pair ( c, a6);
+        sort_pair (a2, a4);
+        sort_pair (a5, a7);
+
+        sort_pair (a3, a8);
+
+        sort_pair (a3,  c);
+        sort_pair (a6, a8);
+        sort_pair (a4, a5);
+
+        a2 = max_epi16 (a1, a2);    // sort_pair (a1, a2);
+        a3 = min_epi16 (a3, a4);    // sort_pair (a3, a4);
+        sort_pair ( c, a5);
+        a7 = max_epi16 (a6, a7);    // sort_pair (a6, a7);
+
+        sort_pair (a2, a8);
+
+        a2 = min_epi16 (a2,  c);    // sort_pair (a2,  c);
+        a8 = max_epi16 (a5, a8);    // sort_pair (a5, a8);
+
+        a2 = min_epi16 (a2, a3);    // sort_pair (a2, a3);
+        a7 = min_epi16 (a7, a8);    // sort_pair (a7, a8);
+
+        return (min_epi16 (max_epi16 (cr, a2), a7));
+    }
+#endif
+};
+
+class OpRG03
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg (int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        int                a [9] = { a1, a2, a3, a4, c, a5, a6, a7, a8 };
+
+        std::sort (&a [0], (&a [8]) + 1);
+
+        return (limit (cr, a [3-1], a [6]));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        sort_pair (a1, a8);
+
+        sort_pair (a1,  c);
+        sort_pair (a2, a5);
+        sort_pair (a3, a6);
+        sort_pair (a4, a7);
+        sort_pair ( c, a8);
+
+        sort_pair (a1, a3);
+        sort_pair ( c, a6);
+        sort_pair (a2, a4);
+        sort_pair (a5, a7);
+
+        sort_pair (a3, a8);
+
+        sort_pair (a3,  c);
+        sort_pair (a6, a8);
+        sort_pair (a4, a5);
+
+        a2 = max_epi16 (a1, a2);    // sort_pair (a1, a2);
+        sort_pair (a3, a4);
+        sort_pair ( c, a5);
+        a6 = min_epi16 (a6, a7);    // sort_pair (a6, a7);
+
+        sort_pair (a2, a8);
+
+        a2 = min_epi16 (a2,  c);    // sort_pair (a2,  c);
+        a6 = max_epi16 (a4, a6);    // sort_pair (a4, a6);
+        a5 = min_epi16 (a5, a8);    // sort_pair (a5, a8);
+
+        a3 = max_epi16 (a2, a3);    // sort_pair (a2, a3);
+        a6 = max_epi16 (a5, a6);    // sort_pair (a5, a6);
+
+        return (min_epi16 (max_epi16 (cr, a3), a6));
+    }
+#endif
+};
+
+class OpRG04
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg (int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        int                a [9] = { a1, a2, a3, a4, c, a5, a6, a7, a8 };
+
+        std::sort (&a [0], (&a [8]) + 1);
+
+        return (limit (cr, a [4-1], a [5]));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        // http://jgamble.ripco.net/cgi-bin/nw.cgi?inputs=9&algorithm=batcher&output=text
+
+        AvsFilterRepair16_READ_PIX
+
+        sort_pair (a1, a8);
+
+        sort_pair (a1,  c);
+        sort_pair (a2, a5);
+        sort_pair (a3, a6);
+        sort_pair (a4, a7);
+        sort_pair ( c, a8);
+
+        sort_pair (a1, a3);
+        sort_pair ( c, a6);
+        sort_pair (a2, a4);
+        sort_pair (a5, a7);
+
+        sort_pair (a3, a8);
+
+        sort_pair (a3,  c);
+        sort_pair (a6, a8);
+        sort_pair (a4, a5);
+
+        a2 = max_epi16 (a1, a2);    // sort_pair (a1, a2);
+        a4 = max_epi16 (a3, a4);    // sort_pair (a3, a4);
+        sort_pair ( c, a5);
+        a6 = min_epi16 (a6, a7);    // sort_pair (a6, a7);
+
+        sort_pair (a2, a8);
+
+        c  = max_epi16 (a2,  c);    // sort_pair (a2,  c);
+        sort_pair (a4, a6);
+        a5 = min_epi16 (a5, a8);    // sort_pair (a5, a8);
+
+        a4 = min_epi16 (a4,  c);    // sort_pair (a4,  c);
+        a5 = min_epi16 (a5, a6);    // sort_pair (a5, a6);
+
+        return (min_epi16 (max_epi16 (cr, a4), a5));
+    }
+#endif
+};
+
+class OpRG05
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int mal1 = std::max(std::max(a1, a8), c);
+        const int mil1 = std::min(std::min(a1, a8), c);
+
+        const int mal2 = std::max(std::max(a2, a7), c);
+        const int mil2 = std::min(std::min(a2, a7), c);
+
+        const int mal3 = std::max(std::max(a3, a6), c);
+        const int mil3 = std::min(std::min(a3, a6), c);
+
+        const int mal4 = std::max(std::max(a4, a5), c);
+        const int mil4 = std::min(std::min(a4, a5), c);
+
+        const int clipped1 = limit(cr, mil1, mal1);
+        const int clipped2 = limit(cr, mil2, mal2);
+        const int clipped3 = limit(cr, mil3, mal3);
+        const int clipped4 = limit(cr, mil4, mal4);
+
+        const int c1 = std::abs(cr - clipped1);
+        const int c2 = std::abs(cr - clipped2);
+        const int c3 = std::abs(cr - clipped3);
+        const int c4 = std::abs(cr - clipped4);
+
+        const int mindiff = std::min(std::min(c1, c2), std::min(c3, c4));
+
+        if (mindiff == c4)
+            return clipped4;
+        else if (mindiff == c2)
+            return clipped2;
+        else if (mindiff == c3)
+            return clipped3;
+        else
+            return clipped1;
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V mal1 = max_epi16(max_epi16(a1, a8), c);
+        const V mil1 = min_epi16(min_epi16(a1, a8), c);
+
+        const V mal2 = max_epi16(max_epi16(a2, a7), c);
+        const V mil2 = min_epi16(min_epi16(a2, a7), c);
+
+        const V mal3 = max_epi16(max_epi16(a3, a6), c);
+        const V mil3 = min_epi16(min_epi16(a3, a6), c);
+
+        const V mal4 = max_epi16(max_epi16(a4, a5), c);
+        const V mil4 = min_epi16(min_epi16(a4, a5), c);
+
+        const V clipped1 = limit_epi16(cr, mil1, mal1);
+        const V clipped2 = limit_epi16(cr, mil2, mal2);
+        const V clipped3 = limit_epi16(cr, mil3, mal3);
+        const V clipped4 = limit_epi16(cr, mil4, mal4);
+
+        const V clipped1u = xor_si(clipped1, mask_sign);
+        const V clipped2u = xor_si(clipped2, mask_sign);
+        const V clipped3u = xor_si(clipped3, mask_sign);
+        const V clipped4u = xor_si(clipped4, mask_sign);
+        const V cru = xor_si(cr, mask_sign);
+
+        const V c1u = abs_dif_epu16(cru, clipped1u);
+        const V c2u = abs_dif_epu16(cru, clipped2u);
+        const V c3u = abs_dif_epu16(cru, clipped3u);
+        const V c4u = abs_dif_epu16(cru, clipped4u);
+
+        const V c1 = xor_si(c1u, mask_sign);
+        const V c2 = xor_si(c2u, mask_sign);
+        const V c3 = xor_si(c3u, mask_sign);
+        const V c4 = xor_si(c4u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(c1, c2), min_epi16(c3, c4));
+
+        V result = select_16_equ(mindiff, c1, clipped1, cr);
+        result = select_16_equ(mindiff, c3, clipped3, result);
+        result = select_16_equ(mindiff, c2, clipped2, result);
+        return select_16_equ(mindiff, c4, clipped4, result);
+}
+#endif
+};
+
+class OpRG06
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int mal1 = std::max(std::max(a1, a8), c);
+        const int mil1 = std::min(std::min(a1, a8), c);
+
+        const int mal2 = std::max(std::max(a2, a7), c);
+        const int mil2 = std::min(std::min(a2, a7), c);
+
+        const int mal3 = std::max(std::max(a3, a6), c);
+        const int mil3 = std::min(std::min(a3, a6), c);
+
+        const int mal4 = std::max(std::max(a4, a5), c);
+        const int mil4 = std::min(std::min(a4, a5), c);
+
+        const int d1 = mal1 - mil1;
+        const int d2 = mal2 - mil2;
+        const int d3 = mal3 - mil3;
+        const int d4 = mal4 - mil4;
+
+        const int clipped1 = limit(cr, mil1, mal1);
+        const int clipped2 = limit(cr, mil2, mal2);
+        const int clipped3 = limit(cr, mil3, mal3);
+        const int clipped4 = limit(cr, mil4, mal4);
+
+        const int c1 = limit((std::abs(cr - clipped1) << 1) + d1, 0, 0xFFFF);
+        const int c2 = limit((std::abs(cr - clipped2) << 1) + d2, 0, 0xFFFF);
+        const int c3 = limit((std::abs(cr - clipped3) << 1) + d3, 0, 0xFFFF);
+        const int c4 = limit((std::abs(cr - clipped4) << 1) + d4, 0, 0xFFFF);
+
+        const int mindiff = std::min(std::min(c1, c2), std::min(c3, c4));
+
+        if (mindiff == c4)
+            return clipped4;
+        else if (mindiff == c2)
+            return clipped2;
+        else if (mindiff == c3)
+            return clipped3;
+        else
+            return clipped1;
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V mal1 = max_epi16(max_epi16(a1, a8), c);
+        const V mil1 = min_epi16(min_epi16(a1, a8), c);
+
+        const V mal2 = max_epi16(max_epi16(a2, a7), c);
+        const V mil2 = min_epi16(min_epi16(a2, a7), c);
+
+        const V mal3 = max_epi16(max_epi16(a3, a6), c);
+        const V mil3 = min_epi16(min_epi16(a3, a6), c);
+
+        const V mal4 = max_epi16(max_epi16(a4, a5), c);
+        const V mil4 = min_epi16(min_epi16(a4, a5), c);
+
+        const V d1 = sub_epi16(mal1, mil1);
+        const V d2 = sub_epi16(mal2, mil2);
+        const V d3 = sub_epi16(mal3, mil3);
+        const V d4 = sub_epi16(mal4, mil4);
+
+        const V clipped1 = limit_epi16(cr, mil1, mal1);
+        const V clipped2 = limit_epi16(cr, mil2, mal2);
+        const V clipped3 = limit_epi16(cr, mil3, mal3);
+        const V clipped4 = limit_epi16(cr, mil4, mal4);
+
+        const V clipped1u = xor_si(clipped1, mask_sign);
+        const V clipped2u = xor_si(clipped2, mask_sign);
+        const V clipped3u = xor_si(clipped3, mask_sign);
+        const V clipped4u = xor_si(clipped4, mask_sign);
+        const V cru = xor_si(cr, mask_sign);
+
+        const V absdiff1 = abs_dif_epu16(cru, clipped1u);
+        const V absdiff2 = abs_dif_epu16(cru, clipped2u);
+        const V absdiff3 = abs_dif_epu16(cru, clipped3u);
+        const V absdiff4 = abs_dif_epu16(cru, clipped4u);
+
+        const V c1u = adds_epu16(adds_epu16(absdiff1, absdiff1), d1);
+        const V c2u = adds_epu16(adds_epu16(absdiff2, absdiff2), d2);
+        const V c3u = adds_epu16(adds_epu16(absdiff3, absdiff3), d3);
+        const V c4u = adds_epu16(adds_epu16(absdiff4, absdiff4), d4);
+
+        const V c1 = xor_si(c1u, mask_sign);
+        const V c2 = xor_si(c2u, mask_sign);
+        const V c3 = xor_si(c3u, mask_sign);
+        const V c4 = xor_si(c4u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(c1, c2), min_epi16(c3, c4));
+
+        V result = select_16_equ(mindiff, c1, clipped1, cr);
+        result = select_16_equ(mindiff, c3, clipped3, result);
+        result = select_16_equ(mindiff, c2, clipped2, result);
+        return select_16_equ(mindiff, c4, clipped4, result);
+    }
+#endif
+};
+
+class OpRG07
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int mal1 = std::max(std::max(a1, a8), c);
+        const int mil1 = std::min(std::min(a1, a8), c);
+
+        const int mal2 = std::max(std::max(a2, a7), c);
+        const int mil2 = std::min(std::min(a2, a7), c);
+
+        const int mal3 = std::max(std::max(a3, a6), c);
+        const int mil3 = std::min(std::min(a3, a6), c);
+
+        const int mal4 = std::max(std::max(a4, a5), c);
+        const int mil4 = std::min(std::min(a4, a5), c);
+
+        const int d1 = mal1 - mil1;
+        const int d2 = mal2 - mil2;
+        const int d3 = mal3 - mil3;
+        const int d4 = mal4 - mil4;
+
+        const int clipped1 = limit(cr, mil1, mal1);
+        const int clipped2 = limit(cr, mil2, mal2);
+        const int clipped3 = limit(cr, mil3, mal3);
+        const int clipped4 = limit(cr, mil4, mal4);
+
+        const int c1 = std::abs(cr - clipped1) + d1;
+        const int c2 = std::abs(cr - clipped2) + d2;
+        const int c3 = std::abs(cr - clipped3) + d3;
+        const int c4 = std::abs(cr - clipped4) + d4;
+
+        const int mindiff = std::min(std::min(c1, c2), std::min(c3, c4));
+
+        if (mindiff == c4)
+            return clipped4;
+        else if (mindiff == c2)
+            return clipped2;
+        else if (mindiff == c3)
+            return clipped3;
+        else
+            return clipped1;
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V mal1 = max_epi16(max_epi16(a1, a8), c);
+        const V mil1 = min_epi16(min_epi16(a1, a8), c);
+
+        const V mal2 = max_epi16(max_epi16(a2, a7), c);
+        const V mil2 = min_epi16(min_epi16(a2, a7), c);
+
+        const V mal3 = max_epi16(max_epi16(a3, a6), c);
+        const V mil3 = min_epi16(min_epi16(a3, a6), c);
+
+        const V mal4 = max_epi16(max_epi16(a4, a5), c);
+        const V mil4 = min_epi16(min_epi16(a4, a5), c);
+
+        const V d1 = sub_epi16(mal1, mil1);
+        const V d2 = sub_epi16(mal2, mil2);
+        const V d3 = sub_epi16(mal3, mil3);
+        const V d4 = sub_epi16(mal4, mil4);
+
+        const V clipped1 = limit_epi16(cr, mil1, mal1);
+        const V clipped2 = limit_epi16(cr, mil2, mal2);
+        const V clipped3 = limit_epi16(cr, mil3, mal3);
+        const V clipped4 = limit_epi16(cr, mil4, mal4);
+
+        const V clipped1u = xor_si(clipped1, mask_sign);
+        const V clipped2u = xor_si(clipped2, mask_sign);
+        const V clipped3u = xor_si(clipped3, mask_sign);
+        const V clipped4u = xor_si(clipped4, mask_sign);
+        const V cru = xor_si(cr, mask_sign);
+
+        //todo: what happens when this overflows?
+        const V c1u = adds_epu16(abs_dif_epu16(cru, clipped1u), d1);
+        const V c2u = adds_epu16(abs_dif_epu16(cru, clipped2u), d2);
+        const V c3u = adds_epu16(abs_dif_epu16(cru, clipped3u), d3);
+        const V c4u = adds_epu16(abs_dif_epu16(cru, clipped4u), d4);
+
+        const V c1 = xor_si(c1u, mask_sign);
+        const V c2 = xor_si(c2u, mask_sign);
+        const V c3 = xor_si(c3u, mask_sign);
+        const V c4 = xor_si(c4u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(c1, c2), min_epi16(c3, c4));
+
+        V result = select_16_equ(mindiff, c1, clipped1, cr);
+        result = select_16_equ(mindiff, c3, clipped3, result);
+        result = select_16_equ(mindiff, c2, clipped2, result);
+        return select_16_equ(mindiff, c4, clipped4, result);
+    }
+#endif
+};
+
+class OpRG08
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int mal1 = std::max(std::max(a1, a8), c);
+        const int mil1 = std::min(std::min(a1, a8), c);
+
+        const int mal2 = std::max(std::max(a2, a7), c);
+        const int mil2 = std::min(std::min(a2, a7), c);
+
+        const int mal3 = std::max(std::max(a3, a6), c);
+        const int mil3 = std::min(std::min(a3, a6), c);
+
+        const int mal4 = std::max(std::max(a4, a5), c);
+        const int mil4 = std::min(std::min(a4, a5), c);
+
+        const int d1 = mal1 - mil1;
+        const int d2 = mal2 - mil2;
+        const int d3 = mal3 - mil3;
+        const int d4 = mal4 - mil4;
+
+        const int clipped1 = limit(cr, mil1, mal1);
+        const int clipped2 = limit(cr, mil2, mal2);
+        const int clipped3 = limit(cr, mil3, mal3);
+        const int clipped4 = limit(cr, mil4, mal4);
+
+        const int c1 = limit(std::abs(cr - clipped1) + (d1 << 1), 0, 0xFFFF);
+        const int c2 = limit(std::abs(cr - clipped2) + (d2 << 1), 0, 0xFFFF);
+        const int c3 = limit(std::abs(cr - clipped3) + (d3 << 1), 0, 0xFFFF);
+        const int c4 = limit(std::abs(cr - clipped4) + (d4 << 1), 0, 0xFFFF);
+
+        const int mindiff = std::min(std::min(c1, c2), std::min(c3, c4));
+
+        if (mindiff == c4)
+            return clipped4;
+        else if (mindiff == c2)
+            return clipped2;
+        else if (mindiff == c3)
+            return clipped3;
+        else
+            return clipped1;
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V mal1 = max_epi16(max_epi16(a1, a8), c);
+        const V mil1 = min_epi16(min_epi16(a1, a8), c);
+
+        const V mal2 = max_epi16(max_epi16(a2, a7), c);
+        const V mil2 = min_epi16(min_epi16(a2, a7), c);
+
+        const V mal3 = max_epi16(max_epi16(a3, a6), c);
+        const V mil3 = min_epi16(min_epi16(a3, a6), c);
+
+        const V mal4 = max_epi16(max_epi16(a4, a5), c);
+        const V mil4 = min_epi16(min_epi16(a4, a5), c);
+
+        const V d1 = sub_epi16(mal1, mil1);
+        const V d2 = sub_epi16(mal2, mil2);
+        const V d3 = sub_epi16(mal3, mil3);
+        const V d4 = sub_epi16(mal4, mil4);
+
+        const V clipped1 = limit_epi16(cr, mil1, mal1);
+        const V clipped2 = limit_epi16(cr, mil2, mal2);
+        const V clipped3 = limit_epi16(cr, mil3, mal3);
+        const V clipped4 = limit_epi16(cr, mil4, mal4);
+
+        const V clipped1u = xor_si(clipped1, mask_sign);
+        const V clipped2u = xor_si(clipped2, mask_sign);
+        const V clipped3u = xor_si(clipped3, mask_sign);
+        const V clipped4u = xor_si(clipped4, mask_sign);
+        const V cru = xor_si(cr, mask_sign);
+
+        const V c1u = adds_epu16(abs_dif_epu16(cru, clipped1u), adds_epu16(d1, d1));
+        const V c2u = adds_epu16(abs_dif_epu16(cru, clipped2u), adds_epu16(d2, d2));
+        const V c3u = adds_epu16(abs_dif_epu16(cru, clipped3u), adds_epu16(d3, d3));
+        const V c4u = adds_epu16(abs_dif_epu16(cru, clipped4u), adds_epu16(d4, d4));
+
+        const V c1 = xor_si(c1u, mask_sign);
+        const V c2 = xor_si(c2u, mask_sign);
+        const V c3 = xor_si(c3u, mask_sign);
+        const V c4 = xor_si(c4u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(c1, c2), min_epi16(c3, c4));
+
+        V result = select_16_equ(mindiff, c1, clipped1, cr);
+        result = select_16_equ(mindiff, c3, clipped3, result);
+        result = select_16_equ(mindiff, c2, clipped2, result);
+        return select_16_equ(mindiff, c4, clipped4, result);
+    }
+#endif
+};
+
+class OpRG09
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int mal1 = std::max(std::max(a1, a8), c);
+        const int mil1 = std::min(std::min(a1, a8), c);
+
+        const int mal2 = std::max(std::max(a2, a7), c);
+        const int mil2 = std::min(std::min(a2, a7), c);
+
+        const int mal3 = std::max(std::max(a3, a6), c);
+        const int mil3 = std::min(std::min(a3, a6), c);
+
+        const int mal4 = std::max(std::max(a4, a5), c);
+        const int mil4 = std::min(std::min(a4, a5), c);
+
+        const int d1 = mal1 - mil1;
+        const int d2 = mal2 - mil2;
+        const int d3 = mal3 - mil3;
+        const int d4 = mal4 - mil4;
+
+        const int mindiff = std::min(std::min(d1, d2), std::min(d3, d4));
+
+        if (mindiff == d4)
+            return limit(cr, mil4, mal4);
+        else if (mindiff == d2)
+            return limit(cr, mil2, mal2);
+        else if (mindiff == d3)
+            return limit(cr, mil3, mal3);
+        else
+            return limit(cr, mil1, mal1);
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V mal1 = max_epi16(max_epi16(a1, a8), c);
+        const V mil1 = min_epi16(min_epi16(a1, a8), c);
+
+        const V mal2 = max_epi16(max_epi16(a2, a7), c);
+        const V mil2 = min_epi16(min_epi16(a2, a7), c);
+
+        const V mal3 = max_epi16(max_epi16(a3, a6), c);
+        const V mil3 = min_epi16(min_epi16(a3, a6), c);
+
+        const V mal4 = max_epi16(max_epi16(a4, a5), c);
+        const V mil4 = min_epi16(min_epi16(a4, a5), c);
+
+        const V d1 = sub_epi16(mal1, mil1);
+        const V d2 = sub_epi16(mal2, mil2);
+        const V d3 = sub_epi16(mal3, mil3);
+        const V d4 = sub_epi16(mal4, mil4);
+
+        const V mindiff = min_epi16(min_epi16(d1, d2), min_epi16(d3, d4));
+
+        V result = select_16_equ(mindiff, d1, limit_epi16(cr, mil1, mal1), cr);
+        result = select_16_equ(mindiff, d3, limit_epi16(cr, mil3, mal3), result);
+        result = select_16_equ(mindiff, d2, limit_epi16(cr, mil2, mal2), result);
+        return select_16_equ(mindiff, d4, limit_epi16(cr, mil4, mal4), result);
+    }
+#endif
+};
+
+class OpRG10
+{
+public:
+    typedef    ConvUnsigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int d1 = std::abs(cr - a1);
+        const int d2 = std::abs(cr - a2);
+        const int d3 = std::abs(cr - a3);
+        const int d4 = std::abs(cr - a4);
+        const int d5 = std::abs(cr - a5);
+        const int d6 = std::abs(cr - a6);
+        const int d7 = std::abs(cr - a7);
+        const int d8 = std::abs(cr - a8);
+        const int dc = std::abs(cr - c);
+
+        const int mindiff = std::min(std::min(std::min(std::min(d1, d2), std::min(d3, d4)), std::min(std::min(d5, d6), std::min(d7, d8))), dc);
+
+        if (mindiff == d7)
+            return a7;
+        else if (mindiff == d8)
+            return a8;
+        else if (mindiff == d6)
+            return a6;
+        else if (mindiff == d2)
+            return a2;
+        else if (mindiff == d3)
+            return a3;
+        else if (mindiff == d1)
+            return a1;
+        else if (mindiff == d5)
+            return a5;
+        else if (mindiff == dc)
+            return c;
+        else
+            return a4;
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V d1u = abs_dif_epu16(cr, a1);
+        const V d2u = abs_dif_epu16(cr, a2);
+        const V d3u = abs_dif_epu16(cr, a3);
+        const V d4u = abs_dif_epu16(cr, a4);
+        const V d5u = abs_dif_epu16(cr, a5);
+        const V d6u = abs_dif_epu16(cr, a6);
+        const V d7u = abs_dif_epu16(cr, a7);
+        const V d8u = abs_dif_epu16(cr, a8);
+        const V dcu = abs_dif_epu16(cr, c);
+
+        const V d1 = xor_si(d1u, mask_sign);
+        const V d2 = xor_si(d2u, mask_sign);
+        const V d3 = xor_si(d3u, mask_sign);
+        const V d4 = xor_si(d4u, mask_sign);
+        const V d5 = xor_si(d5u, mask_sign);
+        const V d6 = xor_si(d6u, mask_sign);
+        const V d7 = xor_si(d7u, mask_sign);
+        const V d8 = xor_si(d8u, mask_sign);
+        const V dc = xor_si(dcu, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(min_epi16(min_epi16(d1, d2), min_epi16(d3, d4)), min_epi16(min_epi16(d5, d6), min_epi16(d7, d8))), dc);
+
+        V result = select_16_equ(mindiff, d4, a4, c);
+        result = select_16_equ(mindiff, dc, c, result);
+        result = select_16_equ(mindiff, d5, a5, result);
+        result = select_16_equ(mindiff, d1, a1, result);
+        result = select_16_equ(mindiff, d3, a3, result);
+        result = select_16_equ(mindiff, d2, a2, result);
+        result = select_16_equ(mindiff, d6, a6, result);
+        result = select_16_equ(mindiff, d8, a8, result);
+        return select_16_equ(mindiff, d7, a7, result);
+    }
+#endif
+};
+
+class OpRG12
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg (int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        int                a [8] = { a1, a2, a3, a4, a5, a6, a7, a8 };
+
+        std::sort (&a [0], (&a [0]) + 8);
+        const int        mi = std::min (a [2-1], c);
+        const int        ma = std::max (a [7-1], c);
+
+        return (limit (cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        sort_pair (a1, a2);
+        sort_pair (a3, a4);
+        sort_pair (a5, a6);
+        sort_pair (a7, a8);
+
+        sort_pair (a1, a3);
+        sort_pair (a2, a4);
+        sort_pair (a5, a7);
+        sort_pair (a6, a8);
+
+        sort_pair (a2, a3);
+        sort_pair (a6, a7);
+
+        a5 = max_epi16 (a1, a5);    // sort_pair (a1, a5);
+        sort_pair (a2, a6);
+        sort_pair (a3, a7);
+        a4 = min_epi16 (a4, a8);    // sort_pair (a4, a8);
+
+        a3 = min_epi16 (a3, a5);    // sort_pair (a3, a5);
+        a6 = max_epi16 (a4, a6);    // sort_pair (a4, a6);
+
+        a2 = min_epi16 (a2, a3);    // sort_pair (a2, a3);
+        a7 = max_epi16 (a6, a7);    // sort_pair (a6, a7);
+
+        const V    mi = min_epi16 (c, a2);
+        const V    ma = max_epi16 (c, a7);
+
+        return (min_epi16 (max_epi16 (cr, mi), ma));
+    }
+#endif
+};
+
+class OpRG13
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg (int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        int                a [8] = { a1, a2, a3, a4, a5, a6, a7, a8 };
+
+        std::sort (&a [0], (&a [0]) + 8);
+        const int        mi = std::min (a [3-1], c);
+        const int        ma = std::max (a [6-1], c);
+
+        return (limit (cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        sort_pair (a1, a2);
+        sort_pair (a3, a4);
+        sort_pair (a5, a6);
+        sort_pair (a7, a8);
+
+        sort_pair (a1, a3);
+        sort_pair (a2, a4);
+        sort_pair (a5, a7);
+        sort_pair (a6, a8);
+
+        sort_pair (a2, a3);
+        sort_pair (a6, a7);
+
+        a5 = max_epi16 (a1, a5);    // sort_pair (a1, a5);
+        sort_pair (a2, a6);
+        sort_pair (a3, a7);
+        a4 = min_epi16 (a4, a8);    // sort_pair (a4, a8);
+
+        a3 = min_epi16 (a3, a5);    // sort_pair (a3, a5);
+        a6 = max_epi16 (a4, a6);    // sort_pair (a4, a6);
+
+        a3 = max_epi16 (a2, a3);    // sort_pair (a2, a3);
+        a6 = min_epi16 (a6, a7);    // sort_pair (a6, a7);
+
+        const V    mi = min_epi16 (c, a3);
+        const V    ma = max_epi16 (c, a6);
+
+        return (min_epi16 (max_epi16 (cr, mi), ma));
+    }
+#endif
+};
+
+class OpRG14
+{
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg (int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        int                a [8] = { a1, a2, a3, a4, a5, a6, a7, a8 };
+
+        std::sort (&a [0], (&a [0]) + 8);
+        const int        mi = std::min (a [4-1], c);
+        const int        ma = std::max (a [5-1], c);
+
+        return (limit (cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        sort_pair (a1, a2);
+        sort_pair (a3, a4);
+        sort_pair (a5, a6);
+        sort_pair (a7, a8);
+
+        sort_pair (a1, a3);
+        sort_pair (a2, a4);
+        sort_pair (a5, a7);
+        sort_pair (a6, a8);
+
+        sort_pair (a2, a3);
+        sort_pair (a6, a7);
+
+        a5 = max_epi16 (a1, a5);    // sort_pair (a1, a5);
+        a6 = max_epi16 (a2, a6);    // sort_pair (a2, a6);
+        a3 = min_epi16 (a3, a7);    // sort_pair (a3, a7);
+        a4 = min_epi16 (a4, a8);    // sort_pair (a4, a8);
+
+        a5 = max_epi16 (a3, a5);    // sort_pair (a3, a5);
+        a4 = min_epi16 (a4, a6);    // sort_pair (a4, a6);
+
+        sort_pair (a4, a5);
+
+        const V    mi = min_epi16 (c, a4);
+        const V    ma = max_epi16 (c, a5);
+
+        return (min_epi16 (max_epi16 (cr, mi), ma));
+    }
+#endif
+};
+
+class OpRG15 {
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        AvsFilterRepair16_SORT_AXIS_CPP
+
+        const int      c1 = std::abs(c - limit(c, mi1, ma1));
+        const int      c2 = std::abs(c - limit(c, mi2, ma2));
+        const int      c3 = std::abs(c - limit(c, mi3, ma3));
+        const int      c4 = std::abs(c - limit(c, mi4, ma4));
+
+        const int      mindiff = std::min(std::min(c1, c2), std::min(c3, c4));
+
+        int            mi;
+        int            ma;
+        if (mindiff == c4) {
+            mi = mi4;
+            ma = ma4;
+        } else if (mindiff == c2) {
+            mi = mi2;
+            ma = ma2;
+        } else if (mindiff == c3) {
+            mi = mi3;
+            ma = ma3;
+        } else {
+            mi = mi1;
+            ma = ma1;
+        }
+
+        mi = std::min(mi, c);
+        ma = std::max(ma, c);
+
+        return (limit(cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+        AvsFilterRepair16_SORT_AXIS_SSE2
+
+        const V cma1 = max_epi16(c, ma1);
+        const V cma2 = max_epi16(c, ma2);
+        const V cma3 = max_epi16(c, ma3);
+        const V cma4 = max_epi16(c, ma4);
+
+        const V cmi1 = min_epi16(c, mi1);
+        const V cmi2 = min_epi16(c, mi2);
+        const V cmi3 = min_epi16(c, mi3);
+        const V cmi4 = min_epi16(c, mi4);
+
+        const V clipped1 = limit_epi16(c, mi1, ma1);
+        const V clipped2 = limit_epi16(c, mi2, ma2);
+        const V clipped3 = limit_epi16(c, mi3, ma3);
+        const V clipped4 = limit_epi16(c, mi4, ma4);
+
+        const V clipped1u = xor_si(clipped1, mask_sign);
+        const V clipped2u = xor_si(clipped2, mask_sign);
+        const V clipped3u = xor_si(clipped3, mask_sign);
+        const V clipped4u = xor_si(clipped4, mask_sign);
+        const V cu = xor_si(c, mask_sign);
+
+        const V c1u = abs_dif_epu16(cu, clipped1u);
+        const V c2u = abs_dif_epu16(cu, clipped2u);
+        const V c3u = abs_dif_epu16(cu, clipped3u);
+        const V c4u = abs_dif_epu16(cu, clipped4u);
+
+        const V c1 = xor_si(c1u, mask_sign);
+        const V c2 = xor_si(c2u, mask_sign);
+        const V c3 = xor_si(c3u, mask_sign);
+        const V c4 = xor_si(c4u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(c1, c2), min_epi16(c3, c4));
+
+        V result = select_16_equ(mindiff, c1, limit_epi16(cr, cmi1, cma1), cr);
+        result = select_16_equ(mindiff, c3, limit_epi16(cr, cmi3, cma3), result);
+        result = select_16_equ(mindiff, c2, limit_epi16(cr, cmi2, cma2), result);
+        return select_16_equ(mindiff, c4, limit_epi16(cr, cmi4, cma4), result);
+    }
+#endif
+};
+
+class OpRG16 {
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        AvsFilterRepair16_SORT_AXIS_CPP
+
+        const int      d1 = ma1 - mi1;
+        const int      d2 = ma2 - mi2;
+        const int      d3 = ma3 - mi3;
+        const int      d4 = ma4 - mi4;
+
+        const int      c1 = limit((std::abs(c - limit(c, mi1, ma1)) << 1) + d1, 0, 0xFFFF);
+        const int      c2 = limit((std::abs(c - limit(c, mi2, ma2)) << 1) + d2, 0, 0xFFFF);
+        const int      c3 = limit((std::abs(c - limit(c, mi3, ma3)) << 1) + d3, 0, 0xFFFF);
+        const int      c4 = limit((std::abs(c - limit(c, mi4, ma4)) << 1) + d4, 0, 0xFFFF);
+
+        const int      mindiff = std::min(std::min(c1, c2), std::min(c3, c4));
+
+        int            mi;
+        int            ma;
+        if (mindiff == c4) {
+            mi = mi4;
+            ma = ma4;
+        } else if (mindiff == c2) {
+            mi = mi2;
+            ma = ma2;
+        } else if (mindiff == c3) {
+            mi = mi3;
+            ma = ma3;
+        } else {
+            mi = mi1;
+            ma = ma1;
+        }
+
+        mi = std::min(mi, c);
+        ma = std::max(ma, c);
+
+        return (limit(cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+        AvsFilterRepair16_SORT_AXIS_SSE2
+
+        const V cma1 = max_epi16(c, ma1);
+        const V cma2 = max_epi16(c, ma2);
+        const V cma3 = max_epi16(c, ma3);
+        const V cma4 = max_epi16(c, ma4);
+
+        const V cmi1 = min_epi16(c, mi1);
+        const V cmi2 = min_epi16(c, mi2);
+        const V cmi3 = min_epi16(c, mi3);
+        const V cmi4 = min_epi16(c, mi4);
+
+        const V d1 = sub_epi16(ma1, mi1);
+        const V d2 = sub_epi16(ma2, mi2);
+        const V d3 = sub_epi16(ma3, mi3);
+        const V d4 = sub_epi16(ma4, mi4);
+
+        const V clipped1 = limit_epi16(c, mi1, ma1);
+        const V clipped2 = limit_epi16(c, mi2, ma2);
+        const V clipped3 = limit_epi16(c, mi3, ma3);
+        const V clipped4 = limit_epi16(c, mi4, ma4);
+
+        const V clipped1u = xor_si(clipped1, mask_sign);
+        const V clipped2u = xor_si(clipped2, mask_sign);
+        const V clipped3u = xor_si(clipped3, mask_sign);
+        const V clipped4u = xor_si(clipped4, mask_sign);
+        const V cu = xor_si(c, mask_sign);
+
+        const V absdiff1 = abs_dif_epu16(cu, clipped1u);
+        const V absdiff2 = abs_dif_epu16(cu, clipped2u);
+        const V absdiff3 = abs_dif_epu16(cu, clipped3u);
+        const V absdiff4 = abs_dif_epu16(cu, clipped4u);
+
+        const V c1u = adds_epu16(adds_epu16(absdiff1, absdiff1), d1);
+        const V c2u = adds_epu16(adds_epu16(absdiff2, absdiff2), d2);
+        const V c3u = adds_epu16(adds_epu16(absdiff3, absdiff3), d3);
+        const V c4u = adds_epu16(adds_epu16(absdiff4, absdiff4), d4);
+
+        const V c1 = xor_si(c1u, mask_sign);
+        const V c2 = xor_si(c2u, mask_sign);
+        const V c3 = xor_si(c3u, mask_sign);
+        const V c4 = xor_si(c4u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(c1, c2), min_epi16(c3, c4));
+
+        V result = select_16_equ(mindiff, c1, limit_epi16(cr, cmi1, cma1), cr);
+        result = select_16_equ(mindiff, c3, limit_epi16(cr, cmi3, cma3), result);
+        result = select_16_equ(mindiff, c2, limit_epi16(cr, cmi2, cma2), result);
+        return select_16_equ(mindiff, c4, limit_epi16(cr, cmi4, cma4), result);
+    }
+#endif
+};
+
+class OpRG17 {
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        AvsFilterRepair16_SORT_AXIS_CPP
+
+        const int      l = std::max(std::max(mi1, mi2), std::max(mi3, mi4));
+        const int      u = std::min(std::min(ma1, ma2), std::min(ma3, ma4));
+
+        const int      mi = std::min(std::min(l, u), c);
+        const int      ma = std::max(std::max(l, u), c);
+
+        return (limit(cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+        AvsFilterRepair16_SORT_AXIS_SSE2
+
+        const V lower = max_epi16(max_epi16(mi1, mi2), max_epi16(mi3, mi4));
+        const V upper = min_epi16(min_epi16(ma1, ma2), min_epi16(ma3, ma4));
+
+        const V real_upper = max_epi16(max_epi16(upper, lower), c);
+        const V real_lower = min_epi16(min_epi16(upper, lower), c);
+
+        return limit_epi16(cr, real_lower, real_upper);
+    }
+#endif
+};
+
+class OpRG18 {
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int      d1 = std::max(std::abs(c - a1), std::abs(c - a8));
+        const int      d2 = std::max(std::abs(c - a2), std::abs(c - a7));
+        const int      d3 = std::max(std::abs(c - a3), std::abs(c - a6));
+        const int      d4 = std::max(std::abs(c - a4), std::abs(c - a5));
+
+        const int      mindiff = std::min(std::min(d1, d2), std::min(d3, d4));
+
+        int            mi;
+        int            ma;
+        if (mindiff == d4) {
+            mi = std::min(a4, a5);
+            ma = std::max(a4, a5);
+        } else if (mindiff == d2) {
+            mi = std::min(a2, a7);
+            ma = std::max(a2, a7);
+        } else if (mindiff == d3) {
+            mi = std::min(a3, a6);
+            ma = std::max(a3, a6);
+        } else {
+            mi = std::min(a1, a8);
+            ma = std::max(a1, a8);
+        }
+
+        mi = std::min(mi, c);
+        ma = std::max(ma, c);
+
+        return (limit(cr, mi, ma));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V a1u = xor_si(a1, mask_sign);
+        const V a2u = xor_si(a2, mask_sign);
+        const V a3u = xor_si(a3, mask_sign);
+        const V a4u = xor_si(a4, mask_sign);
+        const V a5u = xor_si(a5, mask_sign);
+        const V a6u = xor_si(a6, mask_sign);
+        const V a7u = xor_si(a7, mask_sign);
+        const V a8u = xor_si(a8, mask_sign);
+        const V cu = xor_si(c, mask_sign);
+
+        const V absdiff1u = abs_dif_epu16(cu, a1u);
+        const V absdiff2u = abs_dif_epu16(cu, a2u);
+        const V absdiff3u = abs_dif_epu16(cu, a3u);
+        const V absdiff4u = abs_dif_epu16(cu, a4u);
+        const V absdiff5u = abs_dif_epu16(cu, a5u);
+        const V absdiff6u = abs_dif_epu16(cu, a6u);
+        const V absdiff7u = abs_dif_epu16(cu, a7u);
+        const V absdiff8u = abs_dif_epu16(cu, a8u);
+
+        const V absdiff1 = xor_si(absdiff1u, mask_sign);
+        const V absdiff2 = xor_si(absdiff2u, mask_sign);
+        const V absdiff3 = xor_si(absdiff3u, mask_sign);
+        const V absdiff4 = xor_si(absdiff4u, mask_sign);
+        const V absdiff5 = xor_si(absdiff5u, mask_sign);
+        const V absdiff6 = xor_si(absdiff6u, mask_sign);
+        const V absdiff7 = xor_si(absdiff7u, mask_sign);
+        const V absdiff8 = xor_si(absdiff8u, mask_sign);
+
+        const V d1 = max_epi16(absdiff1, absdiff8);
+        const V d2 = max_epi16(absdiff2, absdiff7);
+        const V d3 = max_epi16(absdiff3, absdiff6);
+        const V d4 = max_epi16(absdiff4, absdiff5);
+
+        const V mindiff = min_epi16(min_epi16(d1, d2), min_epi16(d3, d4));
+
+        const V mi1 = min_epi16(c, min_epi16(a1, a8));
+        const V mi2 = min_epi16(c, min_epi16(a2, a7));
+        const V mi3 = min_epi16(c, min_epi16(a3, a6));
+        const V mi4 = min_epi16(c, min_epi16(a4, a5));
+
+        const V ma1 = max_epi16(c, max_epi16(a1, a8));
+        const V ma2 = max_epi16(c, max_epi16(a2, a7));
+        const V ma3 = max_epi16(c, max_epi16(a3, a6));
+        const V ma4 = max_epi16(c, max_epi16(a4, a5));
+
+        const V c1 = limit_epi16(cr, mi1, ma1);
+        const V c2 = limit_epi16(cr, mi2, ma2);
+        const V c3 = limit_epi16(cr, mi3, ma3);
+        const V c4 = limit_epi16(cr, mi4, ma4);
+
+        V result = select_16_equ(mindiff, d1, c1, cr);
+        result = select_16_equ(mindiff, d3, c3, result);
+        result = select_16_equ(mindiff, d2, c2, result);
+        return select_16_equ(mindiff, d4, c4, result);
+    }
+#endif
+};
+
+class OpRG19 {
+public:
+    typedef    ConvUnsigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int d1 = std::abs(c - a1);
+        const int d2 = std::abs(c - a2);
+        const int d3 = std::abs(c - a3);
+        const int d4 = std::abs(c - a4);
+        const int d5 = std::abs(c - a5);
+        const int d6 = std::abs(c - a6);
+        const int d7 = std::abs(c - a7);
+        const int d8 = std::abs(c - a8);
+
+        const int mindiff = std::min(std::min(std::min(d1, d2), std::min(d3, d4)), std::min(std::min(d5, d6), std::min(d7, d8)));
+
+        return limit(cr, limit(c - mindiff, 0, 0xFFFF), limit(c + mindiff, 0, 0xFFFF));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V d1u = abs_dif_epu16(c, a1);
+        const V d2u = abs_dif_epu16(c, a2);
+        const V d3u = abs_dif_epu16(c, a3);
+        const V d4u = abs_dif_epu16(c, a4);
+        const V d5u = abs_dif_epu16(c, a5);
+        const V d6u = abs_dif_epu16(c, a6);
+        const V d7u = abs_dif_epu16(c, a7);
+        const V d8u = abs_dif_epu16(c, a8);
+
+        const V d1 = xor_si(d1u, mask_sign);
+        const V d2 = xor_si(d2u, mask_sign);
+        const V d3 = xor_si(d3u, mask_sign);
+        const V d4 = xor_si(d4u, mask_sign);
+        const V d5 = xor_si(d5u, mask_sign);
+        const V d6 = xor_si(d6u, mask_sign);
+        const V d7 = xor_si(d7u, mask_sign);
+        const V d8 = xor_si(d8u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(min_epi16(d1, d2), min_epi16(d3, d4)), min_epi16(min_epi16(d5, d6), min_epi16(d7, d8)));
+
+        const V mindiffu = xor_si(mindiff, mask_sign);
+
+        const V mi = xor_si(subs_epu16(c, mindiffu), mask_sign);
+        const V ma = xor_si(adds_epu16(c, mindiffu), mask_sign);
+
+        return xor_si(limit_epi16(xor_si(cr, mask_sign), mi, ma), mask_sign);
+    }
+#endif
+};
+
+class OpRG20 {
+public:
+    typedef    ConvUnsigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int d1 = std::abs(c - a1);
+        const int d2 = std::abs(c - a2);
+        const int d3 = std::abs(c - a3);
+        const int d4 = std::abs(c - a4);
+        const int d5 = std::abs(c - a5);
+        const int d6 = std::abs(c - a6);
+        const int d7 = std::abs(c - a7);
+        const int d8 = std::abs(c - a8);
+
+        int mindiff = std::min(d1, d2);
+        int maxdiff = std::max(d1, d2);
+
+        maxdiff = limit(maxdiff, mindiff, d3);
+        mindiff = std::min(mindiff, d3);
+
+        maxdiff = limit(maxdiff, mindiff, d4);
+        mindiff = std::min(mindiff, d4);
+
+        maxdiff = limit(maxdiff, mindiff, d5);
+        mindiff = std::min(mindiff, d5);
+
+        maxdiff = limit(maxdiff, mindiff, d6);
+        mindiff = std::min(mindiff, d6);
+
+        maxdiff = limit(maxdiff, mindiff, d7);
+        mindiff = std::min(mindiff, d7);
+
+        maxdiff = limit(maxdiff, mindiff, d8);
+
+        return limit(cr, limit(c - maxdiff, 0, 0xFFFF), limit(c + maxdiff, 0, 0xFFFF));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V d1u = abs_dif_epu16(c, a1);
+        const V d2u = abs_dif_epu16(c, a2);
+        const V d3u = abs_dif_epu16(c, a3);
+        const V d4u = abs_dif_epu16(c, a4);
+        const V d5u = abs_dif_epu16(c, a5);
+        const V d6u = abs_dif_epu16(c, a6);
+        const V d7u = abs_dif_epu16(c, a7);
+        const V d8u = abs_dif_epu16(c, a8);
+
+        const V d1 = xor_si(d1u, mask_sign);
+        const V d2 = xor_si(d2u, mask_sign);
+        const V d3 = xor_si(d3u, mask_sign);
+        const V d4 = xor_si(d4u, mask_sign);
+        const V d5 = xor_si(d5u, mask_sign);
+        const V d6 = xor_si(d6u, mask_sign);
+        const V d7 = xor_si(d7u, mask_sign);
+        const V d8 = xor_si(d8u, mask_sign);
+
+        V mindiff = min_epi16(d1, d2);
+        V maxdiff = max_epi16(d1, d2);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d3);
+        mindiff = min_epi16(mindiff, d3);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d4);
+        mindiff = min_epi16(mindiff, d4);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d5);
+        mindiff = min_epi16(mindiff, d5);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d6);
+        mindiff = min_epi16(mindiff, d6);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d7);
+        mindiff = min_epi16(mindiff, d7);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d8);
+
+        const V maxdiffu = xor_si(maxdiff, mask_sign);
+
+        const V mi = xor_si(subs_epu16(c, maxdiffu), mask_sign);
+        const V ma = xor_si(adds_epu16(c, maxdiffu), mask_sign);
+
+        return xor_si(limit_epi16(xor_si(cr, mask_sign), mi, ma), mask_sign);
+    }
+#endif
+};
+
+class OpRG21 {
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        AvsFilterRepair16_SORT_AXIS_CPP
+
+        const int d1 = limit(ma1 - c, 0, 0xFFFF);
+        const int d2 = limit(ma2 - c, 0, 0xFFFF);
+        const int d3 = limit(ma3 - c, 0, 0xFFFF);
+        const int d4 = limit(ma4 - c, 0, 0xFFFF);
+
+        const int rd1 = limit(c - mi1, 0, 0xFFFF);
+        const int rd2 = limit(c - mi2, 0, 0xFFFF);
+        const int rd3 = limit(c - mi3, 0, 0xFFFF);
+        const int rd4 = limit(c - mi4, 0, 0xFFFF);
+
+        const int u1 = std::max(d1, rd1);
+        const int u2 = std::max(d2, rd2);
+        const int u3 = std::max(d3, rd3);
+        const int u4 = std::max(d4, rd4);
+
+        const int u = std::min(std::min(u1, u2), std::min(u3, u4));
+
+        return limit(cr, limit(c - u, 0, 0xFFFF), limit(c + u, 0, 0xFFFF));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+        AvsFilterRepair16_SORT_AXIS_SSE2
+
+        const V d1 = subs_epi16(ma1, c);
+        const V d2 = subs_epi16(ma2, c);
+        const V d3 = subs_epi16(ma3, c);
+        const V d4 = subs_epi16(ma4, c);
+
+        const V rd1 = subs_epi16(c, mi1);
+        const V rd2 = subs_epi16(c, mi2);
+        const V rd3 = subs_epi16(c, mi3);
+        const V rd4 = subs_epi16(c, mi4);
+
+        const V u1 = max_epi16(d1, rd1);
+        const V u2 = max_epi16(d2, rd2);
+        const V u3 = max_epi16(d3, rd3);
+        const V u4 = max_epi16(d4, rd4);
+
+        const V u = min_epi16(min_epi16(u1, u2), min_epi16(u3, u4));
+
+        const V mi = subs_epi16(c, u);
+        const V ma = adds_epi16(c, u);
+
+        return limit_epi16(cr, mi, ma);
+    }
+#endif
+};
+
+class OpRG22 {
+public:
+    typedef    ConvUnsigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int d1 = std::abs(cr - a1);
+        const int d2 = std::abs(cr - a2);
+        const int d3 = std::abs(cr - a3);
+        const int d4 = std::abs(cr - a4);
+        const int d5 = std::abs(cr - a5);
+        const int d6 = std::abs(cr - a6);
+        const int d7 = std::abs(cr - a7);
+        const int d8 = std::abs(cr - a8);
+
+        const int mindiff = std::min(std::min(std::min(d1, d2), std::min(d3, d4)), std::min(std::min(d5, d6), std::min(d7, d8)));
+
+        return limit(c, limit(cr - mindiff, 0, 0xFFFF), limit(cr + mindiff, 0, 0xFFFF));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V d1u = abs_dif_epu16(cr, a1);
+        const V d2u = abs_dif_epu16(cr, a2);
+        const V d3u = abs_dif_epu16(cr, a3);
+        const V d4u = abs_dif_epu16(cr, a4);
+        const V d5u = abs_dif_epu16(cr, a5);
+        const V d6u = abs_dif_epu16(cr, a6);
+        const V d7u = abs_dif_epu16(cr, a7);
+        const V d8u = abs_dif_epu16(cr, a8);
+
+        const V d1 = xor_si(d1u, mask_sign);
+        const V d2 = xor_si(d2u, mask_sign);
+        const V d3 = xor_si(d3u, mask_sign);
+        const V d4 = xor_si(d4u, mask_sign);
+        const V d5 = xor_si(d5u, mask_sign);
+        const V d6 = xor_si(d6u, mask_sign);
+        const V d7 = xor_si(d7u, mask_sign);
+        const V d8 = xor_si(d8u, mask_sign);
+
+        const V mindiff = min_epi16(min_epi16(min_epi16(d1, d2), min_epi16(d3, d4)), min_epi16(min_epi16(d5, d6), min_epi16(d7, d8)));
+
+        const V mindiffu = xor_si(mindiff, mask_sign);
+
+        const V mi = xor_si(subs_epu16(cr, mindiffu), mask_sign);
+        const V ma = xor_si(adds_epu16(cr, mindiffu), mask_sign);
+
+        return xor_si(limit_epi16(xor_si(c, mask_sign), mi, ma), mask_sign);
+    }
+#endif
+};
+
+class OpRG23 {
+public:
+    typedef    ConvUnsigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        const int d1 = std::abs(cr - a1);
+        const int d2 = std::abs(cr - a2);
+        const int d3 = std::abs(cr - a3);
+        const int d4 = std::abs(cr - a4);
+        const int d5 = std::abs(cr - a5);
+        const int d6 = std::abs(cr - a6);
+        const int d7 = std::abs(cr - a7);
+        const int d8 = std::abs(cr - a8);
+
+        int mindiff = std::min(d1, d2);
+        int maxdiff = std::max(d1, d2);
+
+        maxdiff = limit(maxdiff, mindiff, d3);
+        mindiff = std::min(mindiff, d3);
+
+        maxdiff = limit(maxdiff, mindiff, d4);
+        mindiff = std::min(mindiff, d4);
+
+        maxdiff = limit(maxdiff, mindiff, d5);
+        mindiff = std::min(mindiff, d5);
+
+        maxdiff = limit(maxdiff, mindiff, d6);
+        mindiff = std::min(mindiff, d6);
+
+        maxdiff = limit(maxdiff, mindiff, d7);
+        mindiff = std::min(mindiff, d7);
+
+        maxdiff = limit(maxdiff, mindiff, d8);
+
+        return limit(c, limit(cr - maxdiff, 0, 0xFFFF), limit(cr + maxdiff, 0, 0xFFFF));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+
+        const V d1u = abs_dif_epu16(cr, a1);
+        const V d2u = abs_dif_epu16(cr, a2);
+        const V d3u = abs_dif_epu16(cr, a3);
+        const V d4u = abs_dif_epu16(cr, a4);
+        const V d5u = abs_dif_epu16(cr, a5);
+        const V d6u = abs_dif_epu16(cr, a6);
+        const V d7u = abs_dif_epu16(cr, a7);
+        const V d8u = abs_dif_epu16(cr, a8);
+
+        const V d1 = xor_si(d1u, mask_sign);
+        const V d2 = xor_si(d2u, mask_sign);
+        const V d3 = xor_si(d3u, mask_sign);
+        const V d4 = xor_si(d4u, mask_sign);
+        const V d5 = xor_si(d5u, mask_sign);
+        const V d6 = xor_si(d6u, mask_sign);
+        const V d7 = xor_si(d7u, mask_sign);
+        const V d8 = xor_si(d8u, mask_sign);
+
+        V mindiff = min_epi16(d1, d2);
+        V maxdiff = max_epi16(d1, d2);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d3);
+        mindiff = min_epi16(mindiff, d3);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d4);
+        mindiff = min_epi16(mindiff, d4);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d5);
+        mindiff = min_epi16(mindiff, d5);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d6);
+        mindiff = min_epi16(mindiff, d6);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d7);
+        mindiff = min_epi16(mindiff, d7);
+
+        maxdiff = limit_epi16(maxdiff, mindiff, d8);
+
+        const V maxdiffu = xor_si(maxdiff, mask_sign);
+
+        const V mi = xor_si(subs_epu16(cr, maxdiffu), mask_sign);
+        const V ma = xor_si(adds_epu16(cr, maxdiffu), mask_sign);
+
+        return xor_si(limit_epi16(xor_si(c, mask_sign), mi, ma), mask_sign);
+    }
+#endif
+};
+
+class OpRG24 {
+public:
+    typedef    ConvSigned    ConvSign;
+    static __forceinline int rg(int cr, int a1, int a2, int a3, int a4, int c, int a5, int a6, int a7, int a8) {
+        AvsFilterRepair16_SORT_AXIS_CPP
+
+        const int d1 = limit(ma1 - cr, 0, 0xFFFF);
+        const int d2 = limit(ma2 - cr, 0, 0xFFFF);
+        const int d3 = limit(ma3 - cr, 0, 0xFFFF);
+        const int d4 = limit(ma4 - cr, 0, 0xFFFF);
+
+        const int rd1 = limit(cr - mi1, 0, 0xFFFF);
+        const int rd2 = limit(cr - mi2, 0, 0xFFFF);
+        const int rd3 = limit(cr - mi3, 0, 0xFFFF);
+        const int rd4 = limit(cr - mi4, 0, 0xFFFF);
+
+        const int u1 = std::max(d1, rd1);
+        const int u2 = std::max(d2, rd2);
+        const int u3 = std::max(d3, rd3);
+        const int u4 = std::max(d4, rd4);
+
+        const int u = std::min(std::min(u1, u2), std::min(u3, u4));
+
+        return limit(c, limit(cr - u, 0, 0xFFFF), limit(cr + u, 0, 0xFFFF));
+    }
+#ifdef VS_TARGET_CPU_X86
+    template<typename V, typename T>
+    static __forceinline V rg (const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src2, V mask_sign) {
+        AvsFilterRepair16_READ_PIX
+        AvsFilterRepair16_SORT_AXIS_SSE2
+
+        const V d1 = subs_epi16(ma1, cr);
+        const V d2 = subs_epi16(ma2, cr);
+        const V d3 = subs_epi16(ma3, cr);
+        const V d4 = subs_epi16(ma4, cr);
+
+        const V rd1 = subs_epi16(cr, mi1);
+        const V rd2 = subs_epi16(cr, mi2);
+        const V rd3 = subs_epi16(cr, mi3);
+        const V rd4 = subs_epi16(cr, mi4);
+
+        const V u1 = max_epi16(d1, rd1);
+        const V u2 = max_epi16(d2, rd2);
+        const V u3 = max_epi16(d3, rd3);
+        const V u4 = max_epi16(d4, rd4);
+
+        const V u = min_epi16(min_epi16(u1, u2), min_epi16(u3, u4));
+
+        const V mi = subs_epi16(cr, u);
+        const V ma = adds_epi16(cr, u);
+
+        return limit_epi16(c, mi, ma);
+    }
+#endif
+};
+
+template <class OP, class T>
+class PlaneProc {
+public:
+
+static void process_subplane_cpp (const T *src1_ptr, const T *src2_ptr, T *dst_ptr, ptrdiff_t stride, int width, int height)
+{
+    const int        y_b = 1;
+    const int        y_e = height - 1;
+
+    dst_ptr += y_b * stride;
+    src1_ptr += y_b * stride;
+    src2_ptr += y_b * stride;
+
+    const int        x_e = width - 1;
+
+    for (int y = y_b; y < y_e; ++y)
+    {
+        dst_ptr [0] = src1_ptr [0];
+
+        process_row_cpp (
+            dst_ptr,
+            src1_ptr,
+            src2_ptr,
+            stride,
+            1,
+            x_e
+        );
+
+        dst_ptr [x_e] = src1_ptr [x_e];
+
+        dst_ptr += stride;
+        src1_ptr += stride;
+        src2_ptr += stride;
+    }
+}
+
+static void process_row_cpp (T *dst_ptr, const T *src1_ptr, const T *src2_ptr, ptrdiff_t stride_src, int x_beg, int x_end)
+{
+    const ptrdiff_t      om = stride_src - 1;
+    const ptrdiff_t      o0 = stride_src    ;
+    const ptrdiff_t      op = stride_src + 1;
+
+    src1_ptr += x_beg;
+    src2_ptr += x_beg;
+
+    for (int x = x_beg; x < x_end; ++x)
+    {
+        const int       cr = src1_ptr [0];
+        const int        a1 = src2_ptr [-op];
+        const int        a2 = src2_ptr [-o0];
+        const int        a3 = src2_ptr [-om];
+        const int        a4 = src2_ptr [-1 ];
+        const int        c  = src2_ptr [ 0 ];
+        const int        a5 = src2_ptr [ 1 ];
+        const int        a6 = src2_ptr [ om];
+        const int        a7 = src2_ptr [ o0];
+        const int        a8 = src2_ptr [ op];
+
+        const int        res = OP::rg (cr, a1, a2, a3, a4, c, a5, a6, a7, a8);
+
+        dst_ptr [x] = res;
+
+        ++ src1_ptr;
+        ++ src2_ptr;
+    }
+}
+
+#ifdef VS_TARGET_CPU_X86
+template <class V>
+static void process_subplane_simd (const T *src1_ptr, const T *src2_ptr, T *dst_ptr, ptrdiff_t stride, int width, int height)
+{
+    const int        y_b = 1;
+    const int        y_e = height - 1;
+
+    dst_ptr += y_b * stride;
+    src1_ptr += y_b * stride;
+    src2_ptr += y_b * stride;
+
+    const V          mask_sign = set1_epi16<V> (-0x8000);
+
+    // Pixels per vector
+    const int        step = sizeof (V) / 2;
+    const int        x_e  =   width - 1;
+    const int        wv   = ((width - 2) & -step) + 1;
+
+    for (int y = y_b; y < y_e; ++y)
+    {
+        dst_ptr [0] = src1_ptr [0];
+
+        for (int x = 1; x < wv; x += step)
+        {
+            V                  res = OP::rg (
+                src1_ptr + x,
+                src2_ptr + x,
+                stride,
+                mask_sign
+            );
+
+            res = OP::ConvSign::cv (res, mask_sign);
+            store_px (dst_ptr + x, res);
+        }
+
+        process_row_cpp (
+            dst_ptr,
+            src1_ptr,
+            src2_ptr,
+            stride,
+            wv,
+            x_e
+        );
+
+        dst_ptr [x_e] = src1_ptr [x_e];
+
+        dst_ptr += stride;
+        src1_ptr += stride;
+        src2_ptr += stride;
+    }
+}
+
+template <class V>
+static void do_process_plane_simd (const void *src1, const void *src2, void *dst, ptrdiff_t stride, int w, int h)
+{
+    T *              dst_ptr       = static_cast<T *>(dst);
+    const T *        src1_ptr      = static_cast<const T *>(src1);
+    const T *        src2_ptr      = static_cast<const T *>(src2);
+
+    // First line
+    memcpy (dst_ptr, src1_ptr, w * sizeof(T));
+
+    // Main content
+    process_subplane_simd<V>(src1_ptr, src2_ptr, dst_ptr, stride/sizeof(T), w, h);
+
+    // Last line
+    const ptrdiff_t  lp = (h - 1) * stride/sizeof(T);
+    memcpy (dst_ptr + lp, src1_ptr + lp, w * sizeof(T));
+}
+#endif
+
+static void do_process_plane_cpp (const void *src1, const void *src2, void *dst, ptrdiff_t stride, int w, int h)
+{
+    T *              dst_ptr       = static_cast<T *>(dst);
+    const T *        src1_ptr      = static_cast<const T *>(src1);
+    const T *        src2_ptr      = static_cast<const T *>(src2);
+
+    // First line
+    memcpy (dst_ptr, src1_ptr, w * sizeof(T));
+
+    // Main content
+    process_subplane_cpp(src1_ptr, src2_ptr, dst_ptr, stride/sizeof(T), w, h);
+
+    // Last line
+    const ptrdiff_t  lp = (h - 1) * stride/sizeof(T);
+    memcpy (dst_ptr + lp, src1_ptr + lp, w * sizeof(T));
+}
+
+};
+
+#ifdef VS_TARGET_CPU_X86
+template <class V>
+static RepairPlaneProc selectPlaneProc (int mode, int bytesPerSample)
+{
+#define PROC_SIMD(op) return (bytesPerSample == 1) ? PlaneProc<op, uint8_t>::template do_process_plane_simd<V> : PlaneProc<op, uint16_t>::template do_process_plane_simd<V>;
+
+    switch (mode)
+    {
+        case  1: PROC_SIMD(OpRG01)
+        case  2: PROC_SIMD(OpRG02)
+        case  3: PROC_SIMD(OpRG03)
+        case  4: PROC_SIMD(OpRG04)
+        case  5: PROC_SIMD(OpRG05)
+        case  6: PROC_SIMD(OpRG06)
+        case  7: PROC_SIMD(OpRG07)
+        case  8: PROC_SIMD(OpRG08)
+        case  9: PROC_SIMD(OpRG09)
+        case 10: PROC_SIMD(OpRG10)
+        case 11: PROC_SIMD(OpRG01)
+        case 12: PROC_SIMD(OpRG12)
+        case 13: PROC_SIMD(OpRG13)
+        case 14: PROC_SIMD(OpRG14)
+        case 15: PROC_SIMD(OpRG15)
+        case 16: PROC_SIMD(OpRG16)
+        case 17: PROC_SIMD(OpRG17)
+        case 18: PROC_SIMD(OpRG18)
+        case 19: PROC_SIMD(OpRG19)
+        case 20: PROC_SIMD(OpRG20)
+        case 21: PROC_SIMD(OpRG21)
+        case 22: PROC_SIMD(OpRG22)
+        case 23: PROC_SIMD(OpRG23)
+        case 24: PROC_SIMD(OpRG24)
+        default: return nullptr;
+    }
+
+#undef PROC_SIMD
+}
+#endif
+
+} // namespace
+} // namespace repair
+
+#endif
@@ -14,17 +14,50 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 
 *Tab=3***********************************************************************/
 
+#include <cstring>
 #include "shared.h"
+#include "../../core/cpufeatures.h"
+
+static int cpuLevelFromStr(const char *name) {
+    if (!strcmp(name, "none"))
+        return VS_CPU_LEVEL_NONE;
+#ifdef VS_TARGET_CPU_X86
+    else if (!strcmp(name, "sse2"))
+        return VS_CPU_LEVEL_SSE2;
+    else if (!strcmp(name, "avx2"))
+        return VS_CPU_LEVEL_AVX2;
+    else if (!strcmp(name, "avx512"))
+        return VS_CPU_LEVEL_AVX512;
+#endif
+    else
+        return VS_CPU_LEVEL_MAX;
+}
+
+int getCPULevel(const VSMap *in, const VSAPI *vsapi) {
+    int err;
+    const char *cpu = vsapi->mapGetData(in, "cpu", 0, &err);
+    int cpulevel = err ? VS_CPU_LEVEL_MAX : cpuLevelFromStr(cpu);
+
+#ifdef VS_TARGET_CPU_X86
+    const CPUFeatures *f = getCPUFeatures();
+    if (cpulevel >= VS_CPU_LEVEL_AVX512 && !(f->avx512_f && f->avx512_bw && f->avx512_dq))
+        cpulevel = VS_CPU_LEVEL_AVX2;
+    if (cpulevel >= VS_CPU_LEVEL_AVX2 && !f->avx2)
+        cpulevel = VS_CPU_LEVEL_SSE2;
+#endif
+
+    return cpulevel;
+}
 
 //////////////////////////////////////////
 // Init
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->configPlugin("com.vapoursynth.removegrainvs", "rgvs", "RemoveGrain VapourSynth Port", VS_MAKE_VERSION(1, 0), VAPOURSYNTH_API_VERSION, 0, plugin);
-    vspapi->registerFunction("RemoveGrain", "clip:vnode;mode:int[];", "clip:vnode;", removeGrainCreate, nullptr, plugin);
-    vspapi->registerFunction("Repair", "clip:vnode;repairclip:vnode;mode:int[];", "clip:vnode;", repairCreate, nullptr, plugin);
-    vspapi->registerFunction("Clense", "clip:vnode;previous:vnode:opt;next:vnode:opt;planes:int[]:opt;", "clip:vnode;", clenseCreate, reinterpret_cast<void *>(cmNormal), plugin);
-    vspapi->registerFunction("ForwardClense", "clip:vnode;planes:int[]:opt;", "clip:vnode;", clenseCreate, reinterpret_cast<void *>(cmForward), plugin);
-    vspapi->registerFunction("BackwardClense", "clip:vnode;planes:int[]:opt;", "clip:vnode;", clenseCreate, reinterpret_cast<void *>(cmBackward), plugin);
-    vspapi->registerFunction("VerticalCleaner", "clip:vnode;mode:int[];", "clip:vnode;", verticalCleanerCreate, nullptr, plugin);
+    vspapi->registerFunction("RemoveGrain", "clip:vnode;mode:int[];cpu:data:opt;", "clip:vnode;", removeGrainCreate, nullptr, plugin);
+    vspapi->registerFunction("Repair", "clip:vnode;repairclip:vnode;mode:int[];cpu:data:opt;", "clip:vnode;", repairCreate, nullptr, plugin);
+    vspapi->registerFunction("Clense", "clip:vnode;previous:vnode:opt;next:vnode:opt;planes:int[]:opt;cpu:data:opt;", "clip:vnode;", clenseCreate, reinterpret_cast<void *>(cmNormal), plugin);
+    vspapi->registerFunction("ForwardClense", "clip:vnode;planes:int[]:opt;cpu:data:opt;", "clip:vnode;", clenseCreate, reinterpret_cast<void *>(cmForward), plugin);
+    vspapi->registerFunction("BackwardClense", "clip:vnode;planes:int[]:opt;cpu:data:opt;", "clip:vnode;", clenseCreate, reinterpret_cast<void *>(cmBackward), plugin);
+    vspapi->registerFunction("VerticalCleaner", "clip:vnode;mode:int[];cpu:data:opt;", "clip:vnode;", verticalCleanerCreate, nullptr, plugin);
 }
@@ -22,21 +22,21 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include <stdint.h>
 #include <algorithm>
 #include <cstdlib>
+#include "../../core/kernel/cpulevel.h"
 #ifdef VS_TARGET_CPU_X86
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#else
 #include <emmintrin.h>
 #endif
+#endif
 
 using namespace vsh;
 
-#if defined(_MSC_VER)
-#define _ALLOW_KEYWORD_MACROS
-#define alignas(x) __declspec(align(x))
-#define ALIGNED_ARRAY(decl, alignment) alignas(alignment) decl
-#else
+#ifndef _MSC_VER
 #ifndef __forceinline
 #define __forceinline inline
 #endif
-#define ALIGNED_ARRAY(decl, alignment) __attribute__((aligned(16))) decl
 #endif
 
 template <class T>
@@ -46,57 +46,229 @@ static __forceinline T limit(T x, T mi, T ma)
 }
 
 #ifdef VS_TARGET_CPU_X86
-static inline __m128i limit_epi16(const __m128i &x, const __m128i &mi, const __m128i &ma) {
-    return (_mm_max_epi16(_mm_min_epi16(x, ma), mi));
+/*
+ * The vector code is written once against the overloads below and
+ * instantiated for __m128i (sse2), __m256i (avx2) and __m512i (avx-512bw).
+ * The wider overloads only exist in the translation units built with the
+ * matching instruction set. All lanes hold 16 bit values, 8 bit pixels are
+ * zero extended on load and packed again on store.
+ */
+
+template <typename V> static V setzero();
+template <typename V> static V set1_epi16(int a);
+template <typename V> static V set1_epi32(int a);
+template <typename V> static V loadu(const void *p);
+template <typename V> static V load_px(const uint8_t *p);
+template <typename V> static V load_px(const uint16_t *p);
+
+template <> __forceinline __m128i setzero<__m128i>() { return _mm_setzero_si128(); }
+template <> __forceinline __m128i set1_epi16<__m128i>(int a) { return _mm_set1_epi16(a); }
+template <> __forceinline __m128i set1_epi32<__m128i>(int a) { return _mm_set1_epi32(a); }
+template <> __forceinline __m128i loadu<__m128i>(const void *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+template <> __forceinline __m128i load_px<__m128i>(const uint8_t *p) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128()); }
+template <> __forceinline __m128i load_px<__m128i>(const uint16_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+
+static __forceinline void storeu(void *p, __m128i a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), a); }
+static __forceinline void store_px(uint8_t *p, __m128i a) { _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(a, a)); }
+static __forceinline void store_px(uint16_t *p, __m128i a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), a); }
+
+static __forceinline __m128i and_si(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+static __forceinline __m128i andnot_si(__m128i a, __m128i b) { return _mm_andnot_si128(a, b); }
+static __forceinline __m128i or_si(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+static __forceinline __m128i xor_si(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+static __forceinline __m128i min_epu8(__m128i a, __m128i b) { return _mm_min_epu8(a, b); }
+static __forceinline __m128i max_epu8(__m128i a, __m128i b) { return _mm_max_epu8(a, b); }
+static __forceinline __m128i adds_epu8(__m128i a, __m128i b) { return _mm_adds_epu8(a, b); }
+static __forceinline __m128i subs_epu8(__m128i a, __m128i b) { return _mm_subs_epu8(a, b); }
+static __forceinline __m128i min_epi16(__m128i a, __m128i b) { return _mm_min_epi16(a, b); }
+static __forceinline __m128i max_epi16(__m128i a, __m128i b) { return _mm_max_epi16(a, b); }
+// No unsigned 16 bit min and max in sse2
+static __forceinline __m128i min_epu16(__m128i a, __m128i b) { return _mm_sub_epi16(a, _mm_subs_epu16(a, b)); }
+static __forceinline __m128i max_epu16(__m128i a, __m128i b) { return _mm_add_epi16(b, _mm_subs_epu16(a, b)); }
+static __forceinline __m128i add_epi16(__m128i a, __m128i b) { return _mm_add_epi16(a, b); }
+static __forceinline __m128i sub_epi16(__m128i a, __m128i b) { return _mm_sub_epi16(a, b); }
+static __forceinline __m128i adds_epi16(__m128i a, __m128i b) { return _mm_adds_epi16(a, b); }
+static __forceinline __m128i subs_epi16(__m128i a, __m128i b) { return _mm_subs_epi16(a, b); }
+static __forceinline __m128i adds_epu16(__m128i a, __m128i b) { return _mm_adds_epu16(a, b); }
+static __forceinline __m128i subs_epu16(__m128i a, __m128i b) { return _mm_subs_epu16(a, b); }
+static __forceinline __m128i avg_epu16(__m128i a, __m128i b) { return _mm_avg_epu16(a, b); }
+static __forceinline __m128i mulhi_epu16(__m128i a, __m128i b) { return _mm_mulhi_epu16(a, b); }
+static __forceinline __m128i mullo_epi16(__m128i a, __m128i b) { return _mm_mullo_epi16(a, b); }
+static __forceinline __m128i add_epi32(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+static __forceinline __m128i sub_epi32(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+template <int N> static __forceinline __m128i slli_epi32(__m128i a) { return _mm_slli_epi32(a, N); }
+template <int N> static __forceinline __m128i srli_epi32(__m128i a) { return _mm_srli_epi32(a, N); }
+template <int N> static __forceinline __m128i srai_epi32(__m128i a) { return _mm_srai_epi32(a, N); }
+static __forceinline __m128i unpacklo_epi16(__m128i a, __m128i b) { return _mm_unpacklo_epi16(a, b); }
+static __forceinline __m128i unpackhi_epi16(__m128i a, __m128i b) { return _mm_unpackhi_epi16(a, b); }
+static __forceinline __m128i packs_epi32(__m128i a, __m128i b) { return _mm_packs_epi32(a, b); }
+
+static __forceinline __m128i select_16_equ(__m128i lhs, __m128i rhs, __m128i v_t, __m128i v_f) {
+    const __m128i cond = _mm_cmpeq_epi16(lhs, rhs);
+
+    return (_mm_or_si128(_mm_andnot_si128(cond, v_f), _mm_and_si128(cond, v_t)));
 }
 
-static inline __m128i abs_dif_epu16(const __m128i &a, const __m128i &b) {
-    const __m128i p = _mm_subs_epu16(a, b);
-    const __m128i n = _mm_subs_epu16(b, a);
+#ifdef __AVX2__
+template <> __forceinline __m256i setzero<__m256i>() { return _mm256_setzero_si256(); }
+template <> __forceinline __m256i set1_epi16<__m256i>(int a) { return _mm256_set1_epi16(a); }
+template <> __forceinline __m256i set1_epi32<__m256i>(int a) { return _mm256_set1_epi32(a); }
+template <> __forceinline __m256i loadu<__m256i>(const void *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+template <> __forceinline __m256i load_px<__m256i>(const uint8_t *p) { return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))); }
+template <> __forceinline __m256i load_px<__m256i>(const uint16_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+
+static __forceinline void storeu(void *p, __m256i a) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a); }
+static __forceinline void store_px(uint8_t *p, __m256i a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1))); }
+static __forceinline void store_px(uint16_t *p, __m256i a) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a); }
+
+static __forceinline __m256i and_si(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+static __forceinline __m256i andnot_si(__m256i a, __m256i b) { return _mm256_andnot_si256(a, b); }
+static __forceinline __m256i or_si(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+static __forceinline __m256i xor_si(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+static __forceinline __m256i min_epu8(__m256i a, __m256i b) { return _mm256_min_epu8(a, b); }
+static __forceinline __m256i max_epu8(__m256i a, __m256i b) { return _mm256_max_epu8(a, b); }
+static __forceinline __m256i adds_epu8(__m256i a, __m256i b) { return _mm256_adds_epu8(a, b); }
+static __forceinline __m256i subs_epu8(__m256i a, __m256i b) { return _mm256_subs_epu8(a, b); }
+static __forceinline __m256i min_epi16(__m256i a, __m256i b) { return _mm256_min_epi16(a, b); }
+static __forceinline __m256i max_epi16(__m256i a, __m256i b) { return _mm256_max_epi16(a, b); }
+static __forceinline __m256i min_epu16(__m256i a, __m256i b) { return _mm256_min_epu16(a, b); }
+static __forceinline __m256i max_epu16(__m256i a, __m256i b) { return _mm256_max_epu16(a, b); }
+static __forceinline __m256i add_epi16(__m256i a, __m256i b) { return _mm256_add_epi16(a, b); }
+static __forceinline __m256i sub_epi16(__m256i a, __m256i b) { return _mm256_sub_epi16(a, b); }
+static __forceinline __m256i adds_epi16(__m256i a, __m256i b) { return _mm256_adds_epi16(a, b); }
+static __forceinline __m256i subs_epi16(__m256i a, __m256i b) { return _mm256_subs_epi16(a, b); }
+static __forceinline __m256i adds_epu16(__m256i a, __m256i b) { return _mm256_adds_epu16(a, b); }
+static __forceinline __m256i subs_epu16(__m256i a, __m256i b) { return _mm256_subs_epu16(a, b); }
+static __forceinline __m256i avg_epu16(__m256i a, __m256i b) { return _mm256_avg_epu16(a, b); }
+static __forceinline __m256i mulhi_epu16(__m256i a, __m256i b) { return _mm256_mulhi_epu16(a, b); }
+static __forceinline __m256i mullo_epi16(__m256i a, __m256i b) { return _mm256_mullo_epi16(a, b); }
+static __forceinline __m256i add_epi32(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+static __forceinline __m256i sub_epi32(__m256i a, __m256i b) { return _mm256_sub_epi32(a, b); }
+template <int N> static __forceinline __m256i slli_epi32(__m256i a) { return _mm256_slli_epi32(a, N); }
+template <int N> static __forceinline __m256i srli_epi32(__m256i a) { return _mm256_srli_epi32(a, N); }
+template <int N> static __forceinline __m256i srai_epi32(__m256i a) { return _mm256_srai_epi32(a, N); }
+// The unpacks and the pack work within 128 bit lanes, used in pairs they keep the pixel order.
+static __forceinline __m256i unpacklo_epi16(__m256i a, __m256i b) { return _mm256_unpacklo_epi16(a, b); }
+static __forceinline __m256i unpackhi_epi16(__m256i a, __m256i b) { return _mm256_unpackhi_epi16(a, b); }
+static __forceinline __m256i packs_epi32(__m256i a, __m256i b) { return _mm256_packs_epi32(a, b); }
 
-    return (_mm_or_si128(p, n));
+static __forceinline __m256i select_16_equ(__m256i lhs, __m256i rhs, __m256i v_t, __m256i v_f) {
+    return (_mm256_blendv_epi8(v_f, v_t, _mm256_cmpeq_epi16(lhs, rhs)));
 }
+#endif
 
-static inline __m128i select(const __m128i &cond, const __m128i &v_t, const __m128i &v_f) {
-    const __m128i cond_1 = _mm_and_si128(cond, v_t);
-    const __m128i cond_0 = _mm_andnot_si128(cond, v_f);
-    const __m128i res = _mm_or_si128(cond_0, cond_1);
+#ifdef __AVX512BW__
+template <> __forceinline __m512i setzero<__m512i>() { return _mm512_setzero_si512(); }
+template <> __forceinline __m512i set1_epi16<__m512i>(int a) { return _mm512_set1_epi16(a); }
+template <> __forceinline __m512i set1_epi32<__m512i>(int a) { return _mm512_set1_epi32(a); }
+template <> __forceinline __m512i loadu<__m512i>(const void *p) { return _mm512_loadu_si512(p); }
+template <> __forceinline __m512i load_px<__m512i>(const uint8_t *p) { return _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))); }
+template <> __forceinline __m512i load_px<__m512i>(const uint16_t *p) { return _mm512_loadu_si512(p); }
 
-    return (res);
+static __forceinline void storeu(void *p, __m512i a) { _mm512_storeu_si512(p, a); }
+static __forceinline void store_px(uint8_t *p, __m512i a) {
+    const __m256i packed = _mm256_packus_epi16(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
 }
+static __forceinline void store_px(uint16_t *p, __m512i a) { _mm512_storeu_si512(p, a); }
 
-static inline __m128i select_16_equ(const __m128i &lhs, const __m128i &rhs, const __m128i &v_t, const __m128i &v_f) {
-    const __m128i cond = _mm_cmpeq_epi16(lhs, rhs);
+static __forceinline __m512i and_si(__m512i a, __m512i b) { return _mm512_and_si512(a, b); }
+static __forceinline __m512i andnot_si(__m512i a, __m512i b) { return _mm512_andnot_si512(a, b); }
+static __forceinline __m512i or_si(__m512i a, __m512i b) { return _mm512_or_si512(a, b); }
+static __forceinline __m512i xor_si(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+static __forceinline __m512i min_epu8(__m512i a, __m512i b) { return _mm512_min_epu8(a, b); }
+static __forceinline __m512i max_epu8(__m512i a, __m512i b) { return _mm512_max_epu8(a, b); }
+static __forceinline __m512i adds_epu8(__m512i a, __m512i b) { return _mm512_adds_epu8(a, b); }
+static __forceinline __m512i subs_epu8(__m512i a, __m512i b) { return _mm512_subs_epu8(a, b); }
+static __forceinline __m512i min_epi16(__m512i a, __m512i b) { return _mm512_min_epi16(a, b); }
+static __forceinline __m512i max_epi16(__m512i a, __m512i b) { return _mm512_max_epi16(a, b); }
+static __forceinline __m512i min_epu16(__m512i a, __m512i b) { return _mm512_min_epu16(a, b); }
+static __forceinline __m512i max_epu16(__m512i a, __m512i b) { return _mm512_max_epu16(a, b); }
+static __forceinline __m512i add_epi16(__m512i a, __m512i b) { return _mm512_add_epi16(a, b); }
+static __forceinline __m512i sub_epi16(__m512i a, __m512i b) { return _mm512_sub_epi16(a, b); }
+static __forceinline __m512i adds_epi16(__m512i a, __m512i b) { return _mm512_adds_epi16(a, b); }
+static __forceinline __m512i subs_epi16(__m512i a, __m512i b) { return _mm512_subs_epi16(a, b); }
+static __forceinline __m512i adds_epu16(__m512i a, __m512i b) { return _mm512_adds_epu16(a, b); }
+static __forceinline __m512i subs_epu16(__m512i a, __m512i b) { return _mm512_subs_epu16(a, b); }
+static __forceinline __m512i avg_epu16(__m512i a, __m512i b) { return _mm512_avg_epu16(a, b); }
+static __forceinline __m512i mulhi_epu16(__m512i a, __m512i b) { return _mm512_mulhi_epu16(a, b); }
+static __forceinline __m512i mullo_epi16(__m512i a, __m512i b) { return _mm512_mullo_epi16(a, b); }
+static __forceinline __m512i add_epi32(__m512i a, __m512i b) { return _mm512_add_epi32(a, b); }
+static __forceinline __m512i sub_epi32(__m512i a, __m512i b) { return _mm512_sub_epi32(a, b); }
+template <int N> static __forceinline __m512i slli_epi32(__m512i a) { return _mm512_slli_epi32(a, N); }
+template <int N> static __forceinline __m512i srli_epi32(__m512i a) { return _mm512_srli_epi32(a, N); }
+template <int N> static __forceinline __m512i srai_epi32(__m512i a) { return _mm512_srai_epi32(a, N); }
+static __forceinline __m512i unpacklo_epi16(__m512i a, __m512i b) { return _mm512_unpacklo_epi16(a, b); }
+static __forceinline __m512i unpackhi_epi16(__m512i a, __m512i b) { return _mm512_unpackhi_epi16(a, b); }
+static __forceinline __m512i packs_epi32(__m512i a, __m512i b) { return _mm512_packs_epi32(a, b); }
+
+static __forceinline __m512i select_16_equ(__m512i lhs, __m512i rhs, __m512i v_t, __m512i v_f) {
+    return (_mm512_mask_blend_epi16(_mm512_cmpeq_epi16_mask(lhs, rhs), v_f, v_t));
+}
+#endif
 
-    return (select(cond, v_t, v_f));
+template <typename V>
+static __forceinline V limit_epi16(const V &x, const V &mi, const V &ma) {
+    return (max_epi16(min_epi16(x, ma), mi));
 }
 
-static inline void add_x16_s32(__m128i &dst0, __m128i &dst1, __m128i src, __m128i msw) {
-    const __m128i res0 = _mm_unpacklo_epi16(src, msw);
-    const __m128i res1 = _mm_unpackhi_epi16(src, msw);
+template <typename V>
+static __forceinline V abs_dif_epu16(const V &a, const V &b) {
+    const V p = subs_epu16(a, b);
+    const V n = subs_epu16(b, a);
 
-    dst0 = _mm_add_epi32(dst0, res0);
-    dst1 = _mm_add_epi32(dst1, res1);
+    return (or_si(p, n));
 }
 
-static inline __m128i mul_s32_s15_s16(__m128i src0, __m128i src1, __m128i coef) {
-    const __m128i hi0 = _mm_mulhi_epu16(src0, coef);
-    const __m128i lo0 = _mm_mullo_epi16(src0, coef);
-    const __m128i hi1 = _mm_mulhi_epu16(src1, coef);
-    const __m128i lo1 = _mm_mullo_epi16(src1, coef);
+template <typename V>
+static __forceinline void add_x16_s32(V &dst0, V &dst1, V src, V msw) {
+    const V res0 = unpacklo_epi16(src, msw);
+    const V res1 = unpackhi_epi16(src, msw);
 
-    const __m128i hi0s = _mm_slli_epi32(hi0, 16);
-    const __m128i hi1s = _mm_slli_epi32(hi1, 16);
+    dst0 = add_epi32(dst0, res0);
+    dst1 = add_epi32(dst1, res1);
+}
+
+template <typename V>
+static __forceinline V mul_s32_s15_s16(V src0, V src1, V coef) {
+    const V hi0 = mulhi_epu16(src0, coef);
+    const V lo0 = mullo_epi16(src0, coef);
+    const V hi1 = mulhi_epu16(src1, coef);
+    const V lo1 = mullo_epi16(src1, coef);
+
+    const V hi0s = slli_epi32<16>(hi0);
+    const V hi1s = slli_epi32<16>(hi1);
 
-    __m128i sum0 = _mm_add_epi32(hi0s, lo0);
-    __m128i sum1 = _mm_add_epi32(hi1s, lo1);
-    sum0 = _mm_srai_epi32(sum0, 16);
-    sum1 = _mm_srai_epi32(sum1, 16);
+    V sum0 = add_epi32(hi0s, lo0);
+    V sum1 = add_epi32(hi1s, lo1);
+    sum0 = srai_epi32<16>(sum0);
+    sum1 = srai_epi32<16>(sum1);
 
-    const __m128i res = _mm_packs_epi32(sum0, sum1);
+    const V res = packs_epi32(sum0, sum1);
 
     return (res);
 }
+
+// Unsigned operations on whole pixels, for the filters that don't widen 8 bit input.
+template <typename T, typename V>
+static __forceinline V min_px(V a, V b) {
+    return (sizeof(T) == 1) ? min_epu8(a, b) : min_epu16(a, b);
+}
+
+template <typename T, typename V>
+static __forceinline V max_px(V a, V b) {
+    return (sizeof(T) == 1) ? max_epu8(a, b) : max_epu16(a, b);
+}
+
+template <typename T, typename V>
+static __forceinline V adds_px(V a, V b) {
+    return (sizeof(T) == 1) ? adds_epu8(a, b) : adds_epu16(a, b);
+}
+
+template <typename T, typename V>
+static __forceinline V subs_px(V a, V b) {
+    return (sizeof(T) == 1) ? subs_epu8(a, b) : subs_epu16(a, b);
+}
 #endif
 
 class LineProcAll {
@@ -113,17 +285,19 @@ public:
 };
 
 #ifdef VS_TARGET_CPU_X86
-static __forceinline void sort_pair(__m128i &a1, __m128i &a2)
+template <typename V>
+static __forceinline void sort_pair(V &a1, V &a2)
 {
-    const __m128i tmp = _mm_min_epi16(a1, a2);
-    a2 = _mm_max_epi16(a1, a2);
+    const V tmp = min_epi16(a1, a2);
+    a2 = max_epi16(a1, a2);
     a1 = tmp;
 }
 
-static __forceinline void sort_pair(__m128i &mi, __m128i &ma, __m128i a1, __m128i a2)
+template <typename V>
+static __forceinline void sort_pair(V &mi, V &ma, V a1, V a2)
 {
-    mi = _mm_min_epi16(a1, a2);
-    ma = _mm_max_epi16(a1, a2);
+    mi = min_epi16(a1, a2);
+    ma = max_epi16(a1, a2);
 }
 #endif
 
@@ -133,6 +307,27 @@ enum cleanseMode {
     cmBackward
 };
 
+// Plane functions, strides are in bytes.
+typedef void (*RemoveGrainPlaneProc)(const void *src, void *dst, ptrdiff_t stride, int width, int height);
+typedef void (*RepairPlaneProc)(const void *src1, const void *src2, void *dst, ptrdiff_t stride, int width, int height);
+typedef void (*ClensePlaneProc)(void *dst, const void *src, const void *ref1, const void *ref2, ptrdiff_t stride, int width, int height);
+typedef void (*VerticalCleanerPlaneProc)(const void *src, void *dst, int width, int height, ptrdiff_t stride, int bitsPerSample);
+
+#ifdef VS_TARGET_CPU_X86
+RemoveGrainPlaneProc getRemoveGrainPlaneProc_avx2(int mode, int bytesPerSample);
+RepairPlaneProc getRepairPlaneProc_avx2(int mode, int bytesPerSample);
+ClensePlaneProc getClensePlaneProc_avx2(int mode, int bytesPerSample);
+VerticalCleanerPlaneProc getVerticalCleanerPlaneProc_avx2(int mode, int bytesPerSample);
+
+RemoveGrainPlaneProc getRemoveGrainPlaneProc_avx512(int mode, int bytesPerSample);
+RepairPlaneProc getRepairPlaneProc_avx512(int mode, int bytesPerSample);
+ClensePlaneProc getClensePlaneProc_avx512(int mode, int bytesPerSample);
+VerticalCleanerPlaneProc getVerticalCleanerPlaneProc_avx512(int mode, int bytesPerSample);
+#endif
+
+// The highest instruction set allowed by the cpu argument that the cpu also supports.
+int getCPULevel(const VSMap *in, const VSAPI *vsapi);
+
 void VS_CC removeGrainCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
 void VS_CC repairCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
 void VS_CC clenseCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
@@ -1,61 +1,18 @@
-#include "shared.h"
+#include "verticalcleaner.h"
 
 struct VerticalCleanerData {
     VSNode * node;
     const VSVideoInfo * vi;
     int mode[3];
+    VerticalCleanerPlaneProc proc[3];
 };
 
-template<typename T>
-static void verticalMedian(const T * VS_RESTRICT srcp, T * VS_RESTRICT dstp, const int width, const int height, const ptrdiff_t stride) {
-    memcpy(dstp, srcp, stride * sizeof(T));
-
-    srcp += stride;
-    dstp += stride;
-
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 0; x < width; x++) {
-            const T up = srcp[x - stride];
-            const T center = srcp[x];
-            const T down = srcp[x + stride];
-            dstp[x] = std::min(std::max(std::min(up, down), center), std::max(up, down));
-        }
-
-        srcp += stride;
-        dstp += stride;
-    }
-
-    memcpy(dstp, srcp, stride * sizeof(T));
-}
-
-template<typename T>
-static void relaxedVerticalMedian(const T * VS_RESTRICT srcp, T * VS_RESTRICT dstp, const int width, const int height, const ptrdiff_t stride, const int bitsPerSample) {
-    const int peak = (1 << bitsPerSample) - 1;
-
-    memcpy(dstp, srcp, stride * sizeof(T) * 2);
-
-    srcp += stride * 2;
-    dstp += stride * 2;
-
-    for (int y = 2; y < height - 2; y++) {
-        for (int x = 0; x < width; x++) {
-            const T p2 = srcp[x - stride * 2];
-            const T p1 = srcp[x - stride];
-            const T c = srcp[x];
-            const T n1 = srcp[x + stride];
-            const T n2 = srcp[x + stride * 2];
-
-            const T upper = std::max<int>(std::max<int>(std::min<int>(limit(limit(p1 - p2, 0, peak) + p1, 0, peak), limit(limit(n1 - n2, 0, peak) + n1, 0, peak)), p1), n1);
-            const T lower = std::min<int>(std::min<int>(p1, n1), std::max<int>(limit(p1 - limit(p2 - p1, 0, peak), 0, peak), limit(n1 - limit(n2 - n1, 0, peak), 0, peak)));
-
-            dstp[x] = limit(c, lower, upper);
-        }
-
-        srcp += stride;
-        dstp += stride;
-    }
-
-    memcpy(dstp, srcp, stride * sizeof(T) * 2);
+static VerticalCleanerPlaneProc selectPlaneProcCpp(int mode, int bytesPerSample) {
+    if (mode == 1)
+        return (bytesPerSample == 1) ? verticalcleaner::verticalMedian<uint8_t> : verticalcleaner::verticalMedian<uint16_t>;
+    else if (mode == 2)
+        return (bytesPerSample == 1) ? verticalcleaner::relaxedVerticalMedian<uint8_t> : verticalcleaner::relaxedVerticalMedian<uint16_t>;
+    return nullptr;
 }
 
 static const VSFrame *VS_CC verticalCleanerGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
@@ -76,17 +33,8 @@ static const VSFrame *VS_CC verticalCleanerGetFrame(int n, int activationReason,
             const uint8_t * srcp = vsapi->getReadPtr(src, plane);
             uint8_t * dstp = vsapi->getWritePtr(dst, plane);
 
-            if (d->mode[plane] == 1) {
-                if (d->vi->format.bytesPerSample == 1)
-                    verticalMedian<uint8_t>(srcp, dstp, width, height, stride);
-                else
-                    verticalMedian<uint16_t>(reinterpret_cast<const uint16_t *>(srcp), reinterpret_cast<uint16_t *>(dstp), width, height, stride / 2);
-            } else if (d->mode[plane] == 2) {
-                if (d->vi->format.bytesPerSample == 1)
-                    relaxedVerticalMedian<uint8_t>(srcp, dstp, width, height, stride, d->vi->format.bitsPerSample);
-                else
-                    relaxedVerticalMedian<uint16_t>(reinterpret_cast<const uint16_t *>(srcp), reinterpret_cast<uint16_t *>(dstp), width, height, stride / 2, d->vi->format.bitsPerSample);
-            }
+            if (d->proc[plane])
+                d->proc[plane](srcp, dstp, width, height, stride, d->vi->format.bitsPerSample);
         }
 
         vsapi->freeFrame(src);
@@ -146,6 +94,21 @@ void VS_CC verticalCleanerCreate(const VSMap *in, VSMap *out, void *userData, VS
         }
     }
 
+    const int cpulevel = getCPULevel(in, vsapi);
+
+    for (int i = 0; i < 3; i++) {
+#ifdef VS_TARGET_CPU_X86
+        if (cpulevel >= VS_CPU_LEVEL_AVX512)
+            d.proc[i] = getVerticalCleanerPlaneProc_avx512(d.mode[i], d.vi->format.bytesPerSample);
+        else if (cpulevel >= VS_CPU_LEVEL_AVX2)
+            d.proc[i] = getVerticalCleanerPlaneProc_avx2(d.mode[i], d.vi->format.bytesPerSample);
+        else if (cpulevel >= VS_CPU_LEVEL_SSE2)
+            d.proc[i] = verticalcleaner::selectPlaneProc<__m128i>(d.mode[i], d.vi->format.bytesPerSample);
+        else
+#endif
+            d.proc[i] = selectPlaneProcCpp(d.mode[i], d.vi->format.bytesPerSample);
+    }
+
     VerticalCleanerData * data = new VerticalCleanerData(d);
 
     VSFilterDependency deps[] = {{d.node, rpStrictSpatial}};
@@ -0,0 +1,157 @@
+#ifndef VERTICALCLEANER_H
+#define VERTICALCLEANER_H
+
+#include "shared.h"
+
+namespace verticalcleaner {
+namespace {
+
+template<typename T>
+static __forceinline T verticalMedianPixel(T up, T center, T down) {
+    return std::min(std::max(std::min(up, down), center), std::max(up, down));
+}
+
+template<typename T>
+static __forceinline T relaxedVerticalMedianPixel(T p2, T p1, T c, T n1, T n2, int peak) {
+    const T upper = std::max<int>(std::max<int>(std::min<int>(limit(limit(p1 - p2, 0, peak) + p1, 0, peak), limit(limit(n1 - n2, 0, peak) + n1, 0, peak)), p1), n1);
+    const T lower = std::min<int>(std::min<int>(p1, n1), std::max<int>(limit(p1 - limit(p2 - p1, 0, peak), 0, peak), limit(n1 - limit(n2 - n1, 0, peak), 0, peak)));
+
+    return limit(c, lower, upper);
+}
+
+template<typename T>
+static void verticalMedian(const void *src, void *dst, const int width, const int height, ptrdiff_t stride, const int bitsPerSample) {
+    const T * VS_RESTRICT srcp = static_cast<const T *>(src);
+    T * VS_RESTRICT dstp = static_cast<T *>(dst);
+    stride /= sizeof(T);
+
+    memcpy(dstp, srcp, stride * sizeof(T));
+
+    srcp += stride;
+    dstp += stride;
+
+    for (int y = 1; y < height - 1; y++) {
+        for (int x = 0; x < width; x++)
+            dstp[x] = verticalMedianPixel(srcp[x - stride], srcp[x], srcp[x + stride]);
+
+        srcp += stride;
+        dstp += stride;
+    }
+
+    memcpy(dstp, srcp, stride * sizeof(T));
+}
+
+template<typename T>
+static void relaxedVerticalMedian(const void *src, void *dst, const int width, const int height, ptrdiff_t stride, const int bitsPerSample) {
+    const T * VS_RESTRICT srcp = static_cast<const T *>(src);
+    T * VS_RESTRICT dstp = static_cast<T *>(dst);
+    const int peak = (1 << bitsPerSample) - 1;
+    stride /= sizeof(T);
+
+    memcpy(dstp, srcp, stride * sizeof(T) * 2);
+
+    srcp += stride * 2;
+    dstp += stride * 2;
+
+    for (int y = 2; y < height - 2; y++) {
+        for (int x = 0; x < width; x++)
+            dstp[x] = relaxedVerticalMedianPixel(srcp[x - stride * 2], srcp[x - stride], srcp[x], srcp[x + stride], srcp[x + stride * 2], peak);
+
+        srcp += stride;
+        dstp += stride;
+    }
+
+    memcpy(dstp, srcp, stride * sizeof(T) * 2);
+}
+
+#ifdef VS_TARGET_CPU_X86
+template<typename V, typename T>
+static void verticalMedianSIMD(const void *src, void *dst, const int width, const int height, ptrdiff_t stride, const int bitsPerSample) {
+    const T * VS_RESTRICT srcp = static_cast<const T *>(src);
+    T * VS_RESTRICT dstp = static_cast<T *>(dst);
+    const int step = sizeof(V) / sizeof(T);
+    const int wv = width & -step;
+    stride /= sizeof(T);
+
+    memcpy(dstp, srcp, stride * sizeof(T));
+
+    srcp += stride;
+    dstp += stride;
+
+    for (int y = 1; y < height - 1; y++) {
+        for (int x = 0; x < wv; x += step) {
+            const V up = loadu<V>(srcp + x - stride);
+            const V center = loadu<V>(srcp + x);
+            const V down = loadu<V>(srcp + x + stride);
+            storeu(dstp + x, min_px<T>(max_px<T>(min_px<T>(up, down), center), max_px<T>(up, down)));
+        }
+        for (int x = wv; x < width; x++)
+            dstp[x] = verticalMedianPixel(srcp[x - stride], srcp[x], srcp[x + stride]);
+
+        srcp += stride;
+        dstp += stride;
+    }
+
+    memcpy(dstp, srcp, stride * sizeof(T));
+}
+
+template<typename V, typename T>
+static void relaxedVerticalMedianSIMD(const void *src, void *dst, const int width, const int height, ptrdiff_t stride, const int bitsPerSample) {
+    const T * VS_RESTRICT srcp = static_cast<const T *>(src);
+    T * VS_RESTRICT dstp = static_cast<T *>(dst);
+    const int peak = (1 << bitsPerSample) - 1;
+    const int step = sizeof(V) / sizeof(T);
+    const int wv = width & -step;
+    const V vpeak = set1_epi16<V>(peak);
+    stride /= sizeof(T);
+
+    memcpy(dstp, srcp, stride * sizeof(T) * 2);
+
+    srcp += stride * 2;
+    dstp += stride * 2;
+
+    for (int y = 2; y < height - 2; y++) {
+        for (int x = 0; x < wv; x += step) {
+            const V p2 = loadu<V>(srcp + x - stride * 2);
+            const V p1 = loadu<V>(srcp + x - stride);
+            const V c = loadu<V>(srcp + x);
+            const V n1 = loadu<V>(srcp + x + stride);
+            const V n2 = loadu<V>(srcp + x + stride * 2);
+
+            V up1 = adds_px<T>(subs_px<T>(p1, p2), p1);
+            V up2 = adds_px<T>(subs_px<T>(n1, n2), n1);
+            // Saturating at the type maximum is enough unless the format has fewer bits
+            if (sizeof(T) == 2 && bitsPerSample < 16) {
+                up1 = min_px<T>(up1, vpeak);
+                up2 = min_px<T>(up2, vpeak);
+            }
+
+            const V upper = max_px<T>(max_px<T>(min_px<T>(up1, up2), p1), n1);
+            const V lower = min_px<T>(min_px<T>(p1, n1), max_px<T>(subs_px<T>(p1, subs_px<T>(p2, p1)), subs_px<T>(n1, subs_px<T>(n2, n1))));
+
+            storeu(dstp + x, min_px<T>(max_px<T>(c, lower), upper));
+        }
+        for (int x = wv; x < width; x++)
+            dstp[x] = relaxedVerticalMedianPixel(srcp[x - stride * 2], srcp[x - stride], srcp[x], srcp[x + stride], srcp[x + stride * 2], peak);
+
+        srcp += stride;
+        dstp += stride;
+    }
+
+    memcpy(dstp, srcp, stride * sizeof(T) * 2);
+}
+
+template<typename V>
+static VerticalCleanerPlaneProc selectPlaneProc(int mode, int bytesPerSample) {
+    if (mode == 1)
+        return (bytesPerSample == 1) ? verticalMedianSIMD<V, uint8_t> : verticalMedianSIMD<V, uint16_t>;
+    else if (mode == 2)
+        return (bytesPerSample == 1) ? relaxedVerticalMedianSIMD<V, uint8_t> : relaxedVerticalMedianSIMD<V, uint16_t>;
+    return nullptr;
+}
+#endif
+
+} // namespace
+} // namespace verticalcleaner
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,35 @@ typedef struct Subtitle {
 } Subtitle;
 
 
+// A decoder and the subtitle it decoded last. PGS needs the previous
+// subtitles to be decoded first so it matters which decoder gets which one.
+typedef struct ImageDecoder {
+    AVCodecContext *avctx;
+    int last_subtitle;
+} ImageDecoder;
+
+
+typedef struct CachedSubtitle {
+    int index;
+    const VSFrame *frame;
+    uint64_t last_use;
+} CachedSubtitle;
+
+
+// Every subtitle is decoded and converted with the palette only once while it's
+// in the cache, all the frames it covers get the same frame. Idle decoders are
+// kept so that several subtitles can be decoded at the same time.
+typedef struct ImageFileState {
+    std::mutex lock;
+    std::vector<ImageDecoder> decoders;
+    std::vector<CachedSubtitle> cache;
+    uint64_t clock;
+} ImageFileState;
+
+
+static const size_t subtitle_cache_size = 8;
+
+
 typedef struct ImageFileData {
     std::string filter_name;
 
@@ -33,12 +63,9 @@ typedef struct ImageFileData {
 
     VSVideoInfo vi;
 
-    VSFrame *blank_rgb;
+    VSFrame *blank_rgb; // with a blank _Alpha attached
     VSFrame *blank_alpha;
 
-    const VSFrame *last_frame;
-    int last_subtitle;
-
     std::vector<Subtitle> subtitles;
 
     std::vector<int64_t> palette;
@@ -47,7 +74,10 @@ typedef struct ImageFileData {
 
     bool flatten;
 
-    AVCodecContext *avctx;
+    const AVCodec *decoder;
+    std::vector<uint8_t> extradata;
+
+    ImageFileState *state;
 } ImageFileData;
 
 
@@ -74,160 +104,259 @@ static void makePaletteGray(uint32_t *palette) {
 }
 
 
-static const VSFrame *VS_CC imageFileGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
-    (void)frameData;
+static AVCodecContext *openDecoder(const AVCodec *decoder, const std::vector<uint8_t> &extradata) {
+    AVCodecContext *avctx = avcodec_alloc_context3(decoder);
+    if (!avctx)
+        return nullptr;
 
-    ImageFileData *d = (ImageFileData *) instanceData;
+    if (extradata.size()) {
+        avctx->extradata_size = (int)extradata.size();
+        avctx->extradata = (uint8_t *)av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+        memcpy(avctx->extradata, extradata.data(), extradata.size());
+    }
 
-    if (activationReason == arInitial) {
-        int subtitle_index;
-        if (d->flatten) {
-            subtitle_index = n;
-        } else {
-            subtitle_index = findSubtitleIndex(n, d->subtitles);
-            if (subtitle_index == d->last_subtitle)
-                return vsapi->addFrameRef(d->last_frame);
-        }
+    if (avcodec_open2(avctx, decoder, nullptr) < 0) {
+        avcodec_free_context(&avctx);
+        return nullptr;
+    }
 
-        VSFrame *rgb = vsapi->copyFrame(d->blank_rgb, core);
-        VSFrame *alpha = vsapi->copyFrame(d->blank_alpha, core);
+    return avctx;
+}
 
-        if (subtitle_index > -1) {
-            if (d->avctx->codec_id == AV_CODEC_ID_HDMV_PGS_SUBTITLE &&
-                d->last_subtitle != subtitle_index - 1) {
-                // Random access in PGS doesn't quite work without decoding some previous subtitles.
-                // 5 was not enough. 10 seems to work.
-                for (int s = std::max(0, subtitle_index - 10); s < subtitle_index; s++) {
-                    const Subtitle &sub = d->subtitles[s];
 
-                    int got_subtitle = 0;
+static VSFrame *decodeSubtitle(const ImageFileData *d, ImageDecoder &decoder, int subtitle_index, std::string &error, VSCore *core, const VSAPI *vsapi) {
+    if (decoder.avctx->codec_id == AV_CODEC_ID_HDMV_PGS_SUBTITLE &&
+        decoder.last_subtitle != subtitle_index - 1) {
+        // Random access in PGS doesn't quite work without decoding some previous subtitles.
+        // 5 was not enough. 10 seems to work.
+        for (int s = std::max(0, subtitle_index - 10); s < subtitle_index; s++) {
+            const Subtitle &sub = d->subtitles[s];
 
-                    AVSubtitle avsub;
+            int got_subtitle = 0;
+
+            AVSubtitle avsub;
 
-                    for (size_t i = 0; i < sub.packets.size(); i++) {
-                        AVPacket packet = sub.packets[i];
+            for (size_t i = 0; i < sub.packets.size(); i++) {
+                AVPacket packet = sub.packets[i];
 
-                        avcodec_decode_subtitle2(d->avctx, &avsub, &got_subtitle, &packet);
+                avcodec_decode_subtitle2(decoder.avctx, &avsub, &got_subtitle, &packet);
 
-                        if (got_subtitle)
-                            avsubtitle_free(&avsub);
-                    }
-                }
+                if (got_subtitle)
+                    avsubtitle_free(&avsub);
             }
+        }
+    }
 
-            d->last_subtitle = subtitle_index;
+    // Decoding the previous subtitles again is the safe choice after a failure.
+    decoder.last_subtitle = INT_MIN;
 
-            const Subtitle &sub = d->subtitles[subtitle_index];
+    const Subtitle &sub = d->subtitles[subtitle_index];
 
-            int got_subtitle = 0;
+    int got_subtitle = 0;
 
-            AVSubtitle avsub;
+    AVSubtitle avsub;
 
-            for (size_t i = 0; i < sub.packets.size(); i++) {
-                AVPacket packet = sub.packets[i];
+    for (size_t i = 0; i < sub.packets.size(); i++) {
+        AVPacket packet = sub.packets[i];
 
-                if (avcodec_decode_subtitle2(d->avctx, &avsub, &got_subtitle, &packet) < 0) {
-                    vsapi->setFilterError((d->filter_name + ": Failed to decode subtitle.").c_str(), frameCtx);
+        if (avcodec_decode_subtitle2(decoder.avctx, &avsub, &got_subtitle, &packet) < 0) {
+            error = d->filter_name + ": Failed to decode subtitle.";
+            return nullptr;
+        }
 
-                    vsapi->freeFrame(rgb);
-                    vsapi->freeFrame(alpha);
+        if (got_subtitle && i < sub.packets.size() - 1) {
+            avsubtitle_free(&avsub);
+            error = d->filter_name + ": Got subtitle sooner than expected.";
+            return nullptr;
+        }
+    }
 
-                    return nullptr;
-                }
+    if (!got_subtitle) {
+        error = d->filter_name + ": Got no subtitle after decoding all the packets.";
+        return nullptr;
+    }
 
-                if (got_subtitle && i < sub.packets.size() - 1) {
-                    vsapi->setFilterError((d->filter_name + ": Got subtitle sooner than expected.").c_str(), frameCtx);
+    if (avsub.num_rects == 0) {
+        avsubtitle_free(&avsub);
+        error = d->filter_name + ": Got subtitle with num_rects=0.";
+        return nullptr;
+    }
 
-                    vsapi->freeFrame(rgb);
-                    vsapi->freeFrame(alpha);
+    decoder.last_subtitle = subtitle_index;
 
-                    return nullptr;
-                }
-            }
+    VSFrame *rgb = vsapi->copyFrame(d->blank_rgb, core);
+    VSFrame *alpha = vsapi->copyFrame(d->blank_alpha, core);
 
-            if (!got_subtitle) {
-                vsapi->setFilterError((d->filter_name + ": Got no subtitle after decoding all the packets.").c_str(), frameCtx);
+    for (unsigned r = 0; r < avsub.num_rects; r++) {
+        AVSubtitleRect *rect = avsub.rects[r];
 
-                vsapi->freeFrame(rgb);
-                vsapi->freeFrame(alpha);
+        if (rect->w <= 0 || rect->h <= 0 || rect->type != SUBTITLE_BITMAP)
+            continue;
 
-                return nullptr;
-            }
+#ifdef VS_HAVE_AVSUBTITLERECT_AVPICTURE
+        uint8_t **rect_data = rect->pict.data;
+        int *rect_linesize = rect->pict.linesize;
+#else
+        uint8_t **rect_data = rect->data;
+        int *rect_linesize = rect->linesize;
+#endif
 
-            if (avsub.num_rects == 0) {
-                vsapi->setFilterError((d->filter_name + ": Got subtitle with num_rects=0.").c_str(), frameCtx);
+        uint32_t palette[AVPALETTE_COUNT];
+        memcpy(palette, rect_data[1], AVPALETTE_SIZE);
+        for (size_t i = 0; i < d->palette.size(); i++)
+            if (d->palette[i] != unused_colour)
+                palette[i] = d->palette[i];
 
-                vsapi->freeFrame(rgb);
-                vsapi->freeFrame(alpha);
+        if (d->gray)
+            makePaletteGray(palette);
 
-                return nullptr;
+        const uint8_t *input = rect_data[0];
+
+        uint8_t *dst_a = vsapi->getWritePtr(alpha, 0);
+        uint8_t *dst_r = vsapi->getWritePtr(rgb, 0);
+        uint8_t *dst_g = vsapi->getWritePtr(rgb, 1);
+        uint8_t *dst_b = vsapi->getWritePtr(rgb, 2);
+        int stride = vsapi->getStride(rgb, 0);
+
+        dst_a += rect->y * stride + rect->x;
+        dst_r += rect->y * stride + rect->x;
+        dst_g += rect->y * stride + rect->x;
+        dst_b += rect->y * stride + rect->x;
+
+        for (int y = 0; y < rect->h; y++) {
+            for (int x = 0; x < rect->w; x++) {
+                uint32_t argb = palette[input[x]];
+
+                dst_a[x] = (argb >> 24) & 0xff;
+                dst_r[x] = (argb >> 16) & 0xff;
+                dst_g[x] = (argb >> 8) & 0xff;
+                dst_b[x] = argb & 0xff;
             }
 
-            for (unsigned r = 0; r < avsub.num_rects; r++) {
-                AVSubtitleRect *rect = avsub.rects[r];
+            input += rect_linesize[0];
+            dst_a += stride;
+            dst_r += stride;
+            dst_g += stride;
+            dst_b += stride;
+        }
+    }
 
-                if (rect->w <= 0 || rect->h <= 0 || rect->type != SUBTITLE_BITMAP)
-                    continue;
+    avsubtitle_free(&avsub);
 
-#ifdef VS_HAVE_AVSUBTITLERECT_AVPICTURE
-                uint8_t **rect_data = rect->pict.data;
-                int *rect_linesize = rect->pict.linesize;
-#else
-                uint8_t **rect_data = rect->data;
-                int *rect_linesize = rect->linesize;
-#endif
+    vsapi->mapConsumeFrame(vsapi->getFramePropertiesRW(rgb), "_Alpha", alpha, maReplace);
 
-                uint32_t palette[AVPALETTE_COUNT];
-                memcpy(palette, rect_data[1], AVPALETTE_SIZE);
-                for (size_t i = 0; i < d->palette.size(); i++)
-                    if (d->palette[i] != unused_colour)
-                        palette[i] = d->palette[i];
+    return rgb;
+}
 
-                if (d->gray)
-                    makePaletteGray(palette);
 
-                const uint8_t *input = rect_data[0];
+static const VSFrame *findCachedSubtitle(ImageFileState *state, int subtitle_index, const VSAPI *vsapi) {
+    std::lock_guard<std::mutex> guard(state->lock);
 
-                uint8_t *dst_a = vsapi->getWritePtr(alpha, 0);
-                uint8_t *dst_r = vsapi->getWritePtr(rgb, 0);
-                uint8_t *dst_g = vsapi->getWritePtr(rgb, 1);
-                uint8_t *dst_b = vsapi->getWritePtr(rgb, 2);
-                int stride = vsapi->getStride(rgb, 0);
+    for (auto &entry : state->cache) {
+        if (entry.index == subtitle_index) {
+            entry.last_use = ++state->clock;
+            return vsapi->addFrameRef(entry.frame);
+        }
+    }
 
-                dst_a += rect->y * stride + rect->x;
-                dst_r += rect->y * stride + rect->x;
-                dst_g += rect->y * stride + rect->x;
-                dst_b += rect->y * stride + rect->x;
+    return nullptr;
+}
 
-                for (int y = 0; y < rect->h; y++) {
-                    for (int x = 0; x < rect->w; x++) {
-                        uint32_t argb = palette[input[x]];
 
-                        dst_a[x] = (argb >> 24) & 0xff;
-                        dst_r[x] = (argb >> 16) & 0xff;
-                        dst_g[x] = (argb >> 8) & 0xff;
-                        dst_b[x] = argb & 0xff;
-                    }
+// Returns the frame that ends up in the cache, it may be one another thread
+// decoded at the same time.
+static const VSFrame *storeCachedSubtitle(ImageFileState *state, int subtitle_index, const VSFrame *frame, const VSAPI *vsapi) {
+    std::lock_guard<std::mutex> guard(state->lock);
+
+    CachedSubtitle *oldest = nullptr;
 
-                    input += rect_linesize[0];
-                    dst_a += stride;
-                    dst_r += stride;
-                    dst_g += stride;
-                    dst_b += stride;
+    for (auto &entry : state->cache) {
+        if (entry.index == subtitle_index) {
+            entry.last_use = ++state->clock;
+            vsapi->freeFrame(frame);
+            return vsapi->addFrameRef(entry.frame);
+        }
+
+        if (!oldest || entry.last_use < oldest->last_use)
+            oldest = &entry;
+    }
+
+    if (state->cache.size() < subtitle_cache_size) {
+        state->cache.push_back({ subtitle_index, vsapi->addFrameRef(frame), ++state->clock });
+    } else {
+        vsapi->freeFrame(oldest->frame);
+        *oldest = { subtitle_index, vsapi->addFrameRef(frame), ++state->clock };
+    }
+
+    return frame;
+}
+
+
+static const VSFrame *VS_CC imageFileGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    (void)frameData;
+
+    ImageFileData *d = (ImageFileData *) instanceData;
+
+    if (activationReason == arInitial) {
+        int subtitle_index;
+        if (d->flatten)
+            subtitle_index = n;
+        else
+            subtitle_index = findSubtitleIndex(n, d->subtitles);
+
+        if (subtitle_index < 0)
+            return vsapi->addFrameRef(d->blank_rgb);
+
+        const VSFrame *cached = findCachedSubtitle(d->state, subtitle_index, vsapi);
+        if (cached)
+            return cached;
+
+        ImageDecoder decoder = { };
+
+        {
+            std::lock_guard<std::mutex> guard(d->state->lock);
+
+            std::vector<ImageDecoder> &decoders = d->state->decoders;
+
+            // Prefer the decoder that decoded the previous subtitle, PGS can continue from it.
+            if (decoders.size()) {
+                size_t i = decoders.size() - 1;
+                for (size_t j = 0; j < decoders.size(); j++) {
+                    if (decoders[j].last_subtitle == subtitle_index - 1) {
+                        i = j;
+                        break;
+                    }
                 }
+
+                decoder = decoders[i];
+                decoders.erase(decoders.begin() + i);
             }
+        }
 
-            avsubtitle_free(&avsub);
+        if (!decoder.avctx) {
+            decoder.avctx = openDecoder(d->decoder, d->extradata);
+            decoder.last_subtitle = INT_MIN;
+
+            if (!decoder.avctx) {
+                vsapi->setFilterError((d->filter_name + ": failed to open AVCodecContext.").c_str(), frameCtx);
+                return nullptr;
+            }
         }
 
-        vsapi->mapConsumeFrame(vsapi->getFramePropertiesRW(rgb), "_Alpha", alpha, maReplace);
+        std::string error;
+        VSFrame *rgb = decodeSubtitle(d, decoder, subtitle_index, error, core, vsapi);
 
-        if (subtitle_index > -1) {
-            vsapi->freeFrame(d->last_frame);
-            d->last_frame = vsapi->addFrameRef(rgb);
+        {
+            std::lock_guard<std::mutex> guard(d->state->lock);
+            d->state->decoders.push_back(decoder);
         }
 
-        return rgb;
+        if (!rgb) {
+            vsapi->setFilterError(error.c_str(), frameCtx);
+            return nullptr;
+        }
+
+        return storeCachedSubtitle(d->state, subtitle_index, rgb, vsapi);
     }
 
     return nullptr;
@@ -243,15 +372,19 @@ static void VS_CC imageFileFree(void *instanceData, VSCore *core, const VSAPI *v
 
     vsapi->freeFrame(d->blank_rgb);
     vsapi->freeFrame(d->blank_alpha);
-    vsapi->freeFrame(d->last_frame);
+
+    for (auto &entry : d->state->cache)
+        vsapi->freeFrame(entry.frame);
+
+    for (auto &decoder : d->state->decoders)
+        avcodec_free_context(&decoder.avctx);
+
+    delete d->state;
 
     for (auto sub = d->subtitles.begin(); sub != d->subtitles.end(); sub++)
         for (auto packet = sub->packets.begin(); packet != sub->packets.end(); packet++)
             av_packet_unref(&(*packet));
 
-    avcodec_close(d->avctx);
-    avcodec_free_context(&d->avctx);
-
     delete d;
 }
 
@@ -398,6 +531,8 @@ extern "C" void VS_CC imageFileCreate(const VSMap *in, VSMap *out, void *userDat
 
     int stream_index = -1;
 
+    AVCodecContext *avctx = nullptr;
+
     try {
         if (id > -1) {
             for (unsigned i = 0; i < fctx->nb_streams; i++) {
@@ -430,31 +565,23 @@ extern "C" void VS_CC imageFileCreate(const VSMap *in, VSMap *out, void *userDat
 
         AVCodecID codec_id = fctx->streams[stream_index]->codecpar->codec_id;
 
-        const AVCodec *decoder = avcodec_find_decoder(codec_id);
-        if (!decoder)
+        d.decoder = avcodec_find_decoder(codec_id);
+        if (!d.decoder)
             throw std::string("failed to find decoder for '") + avcodec_get_name(codec_id) + "'.";
 
-        d.avctx = avcodec_alloc_context3(decoder);
-        if (!d.avctx)
-            throw std::string("failed to allocate AVCodecContext.");
+        const AVCodecParameters *codecpar = fctx->streams[stream_index]->codecpar;
+        d.extradata.assign(codecpar->extradata, codecpar->extradata + codecpar->extradata_size);
 
-        int extradata_size = fctx->streams[stream_index]->codecpar->extradata_size;
-        if (extradata_size) {
-            d.avctx->extradata_size = extradata_size;
-            d.avctx->extradata = (uint8_t *)av_mallocz(extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
-            memcpy(d.avctx->extradata, fctx->streams[stream_index]->codecpar->extradata, extradata_size);
-        }
-
-        ret = avcodec_open2(d.avctx, decoder, nullptr);
-        if (ret < 0)
+        avctx = openDecoder(d.decoder, d.extradata);
+        if (!avctx)
             throw std::string("failed to open AVCodecContext.");
     } catch (const std::string &e) {
         vsapi->mapSetError(out, (d.filter_name + ": " + e).c_str());
 
         avformat_close_input(&fctx);
 
-        if (d.avctx)
-            avcodec_free_context(&d.avctx);
+        if (avctx)
+            avcodec_free_context(&avctx);
 
         vsapi->freeNode(d.clip);
 
@@ -481,7 +608,7 @@ extern "C" void VS_CC imageFileCreate(const VSMap *in, VSMap *out, void *userDat
 
         AVPacket decoded_packet = packet;
 
-        ret = avcodec_decode_subtitle2(d.avctx, &avsub, &got_avsub, &decoded_packet);
+        ret = avcodec_decode_subtitle2(avctx, &avsub, &got_avsub, &decoded_packet);
         if (ret < 0) {
             av_packet_unref(&packet);
             continue;
@@ -531,8 +658,8 @@ extern "C" void VS_CC imageFileCreate(const VSMap *in, VSMap *out, void *userDat
 
         avformat_close_input(&fctx);
 
-        if (d.avctx)
-            avcodec_free_context(&d.avctx);
+        if (avctx)
+            avcodec_free_context(&avctx);
 
         vsapi->freeNode(d.clip);
 
@@ -568,8 +695,11 @@ extern "C" void VS_CC imageFileCreate(const VSMap *in, VSMap *out, void *userDat
         }
     }
 
-    d.last_subtitle = INT_MIN;
+    vsapi->mapSetFrame(vsapi->getFramePropertiesRW(d.blank_rgb), "_Alpha", d.blank_alpha, maReplace);
 
+    d.state = new ImageFileState();
+    d.state->decoders.push_back({ avctx, INT_MIN });
+    d.state->clock = 0;
 
     d.flatten = !!vsapi->mapGetInt(in, "flatten", 0, &err);
     if (d.flatten)
@@ -577,7 +707,7 @@ extern "C" void VS_CC imageFileCreate(const VSMap *in, VSMap *out, void *userDat
 
     data = new ImageFileData(d);
 
-    vsapi->createVideoFilter(out, d.filter_name.c_str(), &d.vi, imageFileGetFrame, imageFileFree, fmUnordered, nullptr, 0, data, core);
+    vsapi->createVideoFilter(out, d.filter_name.c_str(), &d.vi, imageFileGetFrame, imageFileFree, fmParallel, nullptr, 0, data, core);
 
     if (vsapi->mapGetError(out)) {
         avformat_close_input(&fctx);
@@ -21,6 +21,12 @@
 #include <time.h>
 #include <inttypes.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
 
@@ -37,6 +43,19 @@
 #define blend(srcA, srcRGB, dstA, dstRGB, outA)  \
     ((srcA * 255 * srcRGB + (dstRGB * dstA * (255 - srcA))) / outA)
 
+#ifdef _WIN32
+typedef SRWLOCK AssLock;
+#define AssLockInit(l) InitializeSRWLock(l)
+#define AssLockDestroy(l) ((void)(l))
+#define AssLockAcquire(l) AcquireSRWLockExclusive(l)
+#define AssLockRelease(l) ReleaseSRWLockExclusive(l)
+#else
+typedef pthread_mutex_t AssLock;
+#define AssLockInit(l) pthread_mutex_init((l), NULL)
+#define AssLockDestroy(l) pthread_mutex_destroy(l)
+#define AssLockAcquire(l) pthread_mutex_lock(l)
+#define AssLockRelease(l) pthread_mutex_unlock(l)
+#endif
 
 struct AssTime {
     time_t seconds;
@@ -44,14 +63,31 @@ struct AssTime {
 };
 typedef struct AssTime AssTime;
 
+/* libass objects can't be used by more than one thread at a time so every
+   renderer gets its own library and track. They're kept until the filter is
+   freed, there are never more of them than frames rendered at the same time.
+   lastframe is the composited result of the previous ass_render_frame() call
+   with the alpha attached, it's returned as is while libass reports that
+   nothing changed. */
+typedef struct AssRenderer {
+    ASS_Library *ass_library;
+    ASS_Renderer *ass_renderer;
+    ASS_Track *ass;
+    VSFrame *lastframe;
+    struct AssRenderer *next;
+} AssRenderer;
+
 struct AssData {
     VSNode *node;
     VSVideoInfo vi[2];
 
-    int lastn;
-    VSFrame *lastframe;
-    VSFrame *lastalpha;
+    // the source clip and the luma coefficients used when the subtitles are
+    // composited straight into it
+    VSVideoInfo srcvi;
+    double kr;
+    double kb;
 
+    const char *filter_name;
     const char *file;
     const char *text;
     const char *style;
@@ -63,9 +99,12 @@ struct AssData {
     int margins[4];
     intptr_t debuglevel;
 
-    ASS_Track *ass;
-    ASS_Library *ass_library;
-    ASS_Renderer *ass_renderer;
+    // the ASS script for Subtitle or the file converted to UTF-8 for TextFile
+    char *script;
+    size_t script_size;
+
+    AssLock lock;
+    AssRenderer *renderers;
 
     int startframe;
     int endframe;
@@ -184,54 +223,378 @@ static void assRender(VSFrame *dst, VSFrame *alpha, const VSAPI *vsapi,
     }
 }
 
+/* The glyph color in the values of the source format, YUV is limited range
+   like the resizer produces it by default. */
+static void assConvertColor(const AssData *d, uint32_t color, int values[3])
+{
+    const VSVideoFormat *f = &d->srcvi.format;
+    double r = _r(color) / 255.0, g = _g(color) / 255.0, b = _b(color) / 255.0, y;
+    double scale = 1 << (f->bitsPerSample - 8);
+
+    if(f->colorFamily == cfRGB) {
+        int maxval = (1 << f->bitsPerSample) - 1;
+
+        values[0] = (int)(r * maxval + 0.5);
+        values[1] = (int)(g * maxval + 0.5);
+        values[2] = (int)(b * maxval + 0.5);
+        return;
+    }
+
+    y = d->kr * r + (1 - d->kr - d->kb) * g + d->kb * b;
+    values[0] = (int)((16 + 219 * y) * scale + 0.5);
+    values[1] = (int)((128 + 224 * (b - y) / (2 * (1 - d->kb))) * scale + 0.5);
+    values[2] = (int)((128 + 224 * (r - y) / (2 * (1 - d->kr))) * scale + 0.5);
+}
+
+/* Blends value over the part of a plane covered by the image, a subsampled
+   plane uses the average coverage of the pixels each of its samples covers. */
+static void assBlendPlane(uint8_t *plane, ptrdiff_t stride, int bytes,
+                          int ssw, int ssh, const ASS_Image *img,
+                          int alpha, int value)
+{
+    int x0 = img->dst_x >> ssw, x1 = (img->dst_x + img->w - 1) >> ssw;
+    int y0 = img->dst_y >> ssh, y1 = (img->dst_y + img->h - 1) >> ssh;
+    int x, y, i, j;
+
+    for(y = y0; y <= y1; y++) {
+        uint8_t *row8 = plane + stride * y;
+        uint16_t *row16 = (uint16_t *)row8;
+
+        for(x = x0; x <= x1; x++) {
+            unsigned sum = 0, k;
+
+            for(j = 0; j < (1 << ssh); j++) {
+                int sy = (y << ssh) + j - img->dst_y;
+
+                if(sy < 0 || sy >= img->h)
+                    continue;
+
+                for(i = 0; i < (1 << ssw); i++) {
+                    int sx = (x << ssw) + i - img->dst_x;
+
+                    if(sx >= 0 && sx < img->w)
+                        sum += img->bitmap[sy * img->stride + sx];
+                }
+            }
+
+            sum = (sum + ((1 << (ssw + ssh)) >> 1)) >> (ssw + ssh);
+            k = div255(sum * alpha);
+
+            if(k == 0)
+                continue;
+
+            if(bytes == 1)
+                row8[x] = (row8[x] * (255 - k) + value * k + 127) / 255;
+            else
+                row16[x] = (row16[x] * (255 - k) + value * k + 127) / 255;
+        }
+    }
+}
+
+/* Only the bounding boxes of the images are touched, everything else keeps
+   the source. */
+static void assComposite(const AssData *d, VSFrame *dst, const VSAPI *vsapi,
+                         const ASS_Image *img)
+{
+    const VSVideoFormat *f = &d->srcvi.format;
+    uint8_t *planes[3];
+    ptrdiff_t strides[3];
+    int p;
+
+    for(p = 0; p < f->numPlanes; p++) {
+        planes[p] = vsapi->getWritePtr(dst, p);
+        strides[p] = vsapi->getStride(dst, p);
+    }
+
+    for(; img; img = img->next) {
+        int values[3], alpha = _a(img->color);
+
+        if(img->w == 0 || img->h == 0 || alpha == 0)
+            continue;
+
+        assConvertColor(d, img->color, values);
+
+        for(p = 0; p < f->numPlanes; p++)
+            assBlendPlane(planes[p], strides[p], f->bytesPerSample,
+                          p ? f->subSamplingW : 0, p ? f->subSamplingH : 0,
+                          img, alpha, values[p]);
+    }
+}
+
+char *convertToUtf8(const char *file_name, const char *charset, int64_t *file_size, char *error, size_t error_size);
+ASS_Track *convertToASS(const char *file_name, const char *contents, size_t contents_size, ASS_Library *ass_library, const char *user_style, const char *charset, char *error, size_t error_size);
+
+static void freeRenderer(AssRenderer *r, const VSAPI *vsapi)
+{
+    vsapi->freeFrame(r->lastframe);
+    if(r->ass)
+        ass_free_track(r->ass);
+    if(r->ass_renderer)
+        ass_renderer_done(r->ass_renderer);
+    if(r->ass_library)
+        ass_library_done(r->ass_library);
+    free(r);
+}
+
+static AssRenderer *createRenderer(const AssData *d, char *error, size_t error_size, const VSAPI *vsapi)
+{
+    AssRenderer *r = calloc(1, sizeof(AssRenderer));
+    char *script;
+
+    r->ass_library = ass_library_init();
+
+    if(!r->ass_library) {
+        snprintf(error, error_size, "%s: failed to initialize ASS library", d->filter_name);
+        freeRenderer(r, vsapi);
+        return NULL;
+    }
+
+    ass_set_message_cb(r->ass_library, assDebugCallback, (void *)d->debuglevel);
+    ass_set_extract_fonts(r->ass_library, 0);
+    ass_set_style_overrides(r->ass_library, 0);
+
+    r->ass_renderer = ass_renderer_init(r->ass_library);
+
+    if(!r->ass_renderer) {
+        snprintf(error, error_size, "%s: failed to initialize ASS renderer", d->filter_name);
+        freeRenderer(r, vsapi);
+        return NULL;
+    }
+
+    ass_set_font_scale(r->ass_renderer, d->scale);
+    ass_set_frame_size(r->ass_renderer, d->vi[0].width, d->vi[0].height);
+    ass_set_margins(r->ass_renderer,
+                    d->margins[0], d->margins[1], d->margins[2], d->margins[3]);
+    ass_set_use_margins(r->ass_renderer, 0);
+
+    if(d->linespacing)
+        ass_set_line_spacing(r->ass_renderer, d->linespacing);
+
+    if(d->sar) {
+        ass_set_aspect_ratio(r->ass_renderer,
+                             (double)d->vi[0].width /
+                             d->vi[0].height * d->sar, 1);
+    }
+
+    if(d->fontdir)
+        ass_set_fonts_dir(r->ass_library, d->fontdir);
+
+    ass_set_fonts(r->ass_renderer, NULL, NULL, 1, NULL, 1);
+
+    // libass may parse the script in place so every track gets its own copy
+    script = malloc(d->script_size + 1);
+    memcpy(script, d->script, d->script_size);
+    script[d->script_size] = '\0';
+
+    if(d->file == NULL) {
+        r->ass = ass_new_track(r->ass_library);
+        ass_process_data(r->ass, script, (int)d->script_size);
+    } else {
+        r->ass = ass_read_memory(r->ass_library, script, d->script_size, NULL);
+
+        if(!r->ass) {
+            size_t len;
+
+            snprintf(error, error_size, "%s: ", d->filter_name);
+            len = strlen(error);
+            r->ass = convertToASS(d->file, d->script, d->script_size, r->ass_library, d->style, d->charset, error + len, error_size - len);
+        }
+    }
+
+    free(script);
+
+    if(!r->ass) {
+        freeRenderer(r, vsapi);
+        return NULL;
+    }
+
+    return r;
+}
+
+static AssRenderer *acquireRenderer(AssData *d, char *error, size_t error_size, const VSAPI *vsapi)
+{
+    AssRenderer *r;
+
+    AssLockAcquire(&d->lock);
+    r = d->renderers;
+    if(r)
+        d->renderers = r->next;
+    AssLockRelease(&d->lock);
+
+    if(!r)
+        r = createRenderer(d, error, error_size, vsapi);
+
+    return r;
+}
+
+static void releaseRenderer(AssData *d, AssRenderer *r)
+{
+    AssLockAcquire(&d->lock);
+    r->next = d->renderers;
+    d->renderers = r;
+    AssLockRelease(&d->lock);
+}
+
 static const VSFrame *VS_CC assGetFrame(int n, int activationReason,
         void *instanceData, void **frameData,
         VSFrameContext *frameCtx, VSCore *core,
         const VSAPI *vsapi)
 {
     AssData *d = (AssData *) instanceData;
+    char error[512] = { 0 };
+    AssRenderer *r;
+    ASS_Image *img;
+    const VSFrame *frame;
+    int64_t ts = 0;
+    int changed;
+
+    r = acquireRenderer(d, error, sizeof(error), vsapi);
+
+    if(!r) {
+        vsapi->setFilterError(error, frameCtx);
+        return NULL;
+    }
+
+    ts = (int64_t)n * 1000 * d->vi[0].fpsDen / d->vi[0].fpsNum;
+
+    img = ass_render_frame(r->ass_renderer, r->ass, ts, &changed);
+
+    if (changed || !r->lastframe) {
+        VSFrame *dst = vsapi->newVideoFrame(&d->vi[0].format,
+                                               d->vi[0].width,
+                                               d->vi[0].height,
+                                               NULL, core);
+
+        VSFrame *a = vsapi->newVideoFrame(&d->vi[1].format,
+                                             d->vi[1].width,
+                                             d->vi[1].height,
+                                             NULL, core);
+
+        assRender(dst, a, vsapi, img);
+        vsapi->mapConsumeFrame(vsapi->getFramePropertiesRW(dst), "_Alpha", a, maReplace);
+        vsapi->freeFrame(r->lastframe);
+        r->lastframe = dst;
+    }
+
+    frame = vsapi->addFrameRef(r->lastframe);
+
+    releaseRenderer(d, r);
 
-    if(n != d->lastn) {
+    return frame;
+}
+
+static const VSFrame *VS_CC assBlendGetFrame(int n, int activationReason,
+        void *instanceData, void **frameData,
+        VSFrameContext *frameCtx, VSCore *core,
+        const VSAPI *vsapi)
+{
+    AssData *d = (AssData *) instanceData;
+
+    if(activationReason == arInitial) {
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    } else if(activationReason == arAllFramesReady) {
+        char error[512] = { 0 };
+        const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+        AssRenderer *r;
         ASS_Image *img;
-        int64_t ts = 0;
+        VSFrame *dst;
+        int64_t ts;
         int changed;
 
-        ts = (int64_t)n * 1000 * d->vi[0].fpsDen / d->vi[0].fpsNum;
+        r = acquireRenderer(d, error, sizeof(error), vsapi);
 
-        img = ass_render_frame(d->ass_renderer, d->ass, ts, &changed);
+        if(!r) {
+            vsapi->freeFrame(src);
+            vsapi->setFilterError(error, frameCtx);
+            return NULL;
+        }
 
-        if (changed) {
-            VSFrame *dst = vsapi->newVideoFrame(&d->vi[0].format,
-                                                   d->vi[0].width,
-                                                   d->vi[0].height,
-                                                   NULL, core);
+        ts = (int64_t)n * 1000 * d->vi[0].fpsDen / d->vi[0].fpsNum;
 
-            VSFrame *a = vsapi->newVideoFrame(&d->vi[1].format,
-                                                 d->vi[1].width,
-                                                 d->vi[1].height,
-                                                 NULL, core);
+        img = ass_render_frame(r->ass_renderer, r->ass, ts, &changed);
 
-            assRender(dst, a, vsapi, img);
-            vsapi->freeFrame(d->lastframe);
-            vsapi->freeFrame(d->lastalpha);
-            d->lastframe = dst;
-            d->lastalpha = a;
+        // nothing to show so the source frame is passed on as it is
+        if(!img) {
+            releaseRenderer(d, r);
+            return src;
         }
 
-        d->lastn = n;
+        dst = vsapi->copyFrame(src, core);
+        vsapi->freeFrame(src);
+
+        // the images belong to the renderer until it renders again
+        assComposite(d, dst, vsapi, img);
+        releaseRenderer(d, r);
+
+        return dst;
     }
 
-    return vsapi->addFrameRef(d->lastframe);
+    return NULL;
+}
+
+/* Integer YUV, Gray and RGB clips get the subtitles composited in a single
+   filter unless a transfer or primaries conversion is asked for, the rest is
+   left to blendSubtitles(). */
+static int canComposite(AssData *d, const VSMap *in, const VSAPI *vsapi)
+{
+    static const struct {
+        int matrix;
+        const char *name;
+        double kr;
+        double kb;
+    } matrices[] = {
+        { 1, "709", 0.2126, 0.0722 },
+        { 4, "fcc", 0.30, 0.11 },
+        { 5, "470bg", 0.299, 0.114 },
+        { 6, "170m", 0.299, 0.114 },
+        { 7, "240m", 0.212, 0.087 },
+        { 9, "2020ncl", 0.2627, 0.0593 }
+    };
+    const VSVideoFormat *f = &d->srcvi.format;
+    const char *matrix_s;
+    int matrix, err, i;
+
+    if(f->sampleType != stInteger || f->bitsPerSample > 16)
+        return 0;
+
+    if(vsapi->mapGetType(in, "transfer") != ptUnset || vsapi->mapGetType(in, "transfer_s") != ptUnset ||
+       vsapi->mapGetType(in, "primaries") != ptUnset || vsapi->mapGetType(in, "primaries_s") != ptUnset)
+        return 0;
+
+    if(f->colorFamily == cfRGB)
+        return 1;
+
+    matrix = vsapi->mapGetIntSaturated(in, "matrix", 0, &err);
+    if(err)
+        matrix = -1;
+    matrix_s = vsapi->mapGetData(in, "matrix_s", 0, &err);
+    if(err)
+        matrix_s = matrix < 0 ? "709" : NULL;
+
+    for(i = 0; i < (int)(sizeof(matrices) / sizeof(matrices[0])); i++) {
+        if(matrix_s ? !strcmp(matrix_s, matrices[i].name) : matrix == matrices[i].matrix) {
+            d->kr = matrices[i].kr;
+            d->kb = matrices[i].kb;
+            return 1;
+        }
+    }
+
+    return 0;
 }
 
 static void VS_CC assFree(void *instanceData, VSCore *core, const VSAPI *vsapi)
 {
     AssData *d = (AssData *)instanceData;
     vsapi->freeNode(d->node);
-    vsapi->freeFrame(d->lastframe);
-    ass_renderer_done(d->ass_renderer);
-    ass_library_done(d->ass_library);
-    ass_free_track(d->ass);
+
+    while(d->renderers) {
+        AssRenderer *next = d->renderers->next;
+        freeRenderer(d->renderers, vsapi);
+        d->renderers = next;
+    }
+
+    AssLockDestroy(&d->lock);
+    free(d->script);
     free(d);
 }
 
@@ -256,10 +619,6 @@ static int frameToTime(int frame, int64_t fpsNum, int64_t fpsDen, char *str, siz
 }
 
 
-char *convertToUtf8(const char *file_name, const char *charset, int64_t *file_size, char *error, size_t error_size);
-ASS_Track *convertToASS(const char *file_name, const char *contents, size_t contents_size, ASS_Library *ass_library, const char *user_style, const char *charset, char *error, size_t error_size);
-
-
 static void VS_CC assRenderCreate(const VSMap *in, VSMap *out, void *userData,
                                   VSCore *core, const VSAPI *vsapi)
 {
@@ -272,9 +631,10 @@ static void VS_CC assRenderCreate(const VSMap *in, VSMap *out, void *userData,
 #define ERROR_SIZE 512
     char error[ERROR_SIZE] = { 0 };
 
-    d.lastn = -1;
+    d.filter_name = filter_name;
     d.node = vsapi->mapGetNode(in, "clip", 0, 0);
     d.vi[0] = *vsapi->getVideoInfo(d.node);
+    d.srcvi = d.vi[0];
 
     if (d.vi[0].format.colorFamily == cfUndefined || !d.vi[0].width || !d.vi[0].height)
         snprintf(error, ERROR_SIZE, "%s: clip must have known format and dimensions.", filter_name);
@@ -283,8 +643,6 @@ static void VS_CC assRenderCreate(const VSMap *in, VSMap *out, void *userData,
     d.vi[1] = d.vi[0];
     vsapi->getVideoFormatByID(&d.vi[1].format, pfGray8, core);
 
-    d.lastframe = NULL;
-
     d.file = vsapi->mapGetData(in, "file", 0, &err);
 
     if(err) {
@@ -363,49 +721,6 @@ static void VS_CC assRenderCreate(const VSMap *in, VSMap *out, void *userData,
         return;
     }
 
-    d.ass_library = ass_library_init();
-
-    if(!d.ass_library) {
-        snprintf(error, ERROR_SIZE, "%s: failed to initialize ASS library", filter_name);
-        vsapi->mapSetError(out, error);
-        vsapi->freeNode(d.node);
-        return;
-    }
-
-    ass_set_message_cb(d.ass_library, assDebugCallback, (void *)d.debuglevel);
-    ass_set_extract_fonts(d.ass_library, 0);
-    ass_set_style_overrides(d.ass_library, 0);
-
-    d.ass_renderer = ass_renderer_init(d.ass_library);
-
-    if(!d.ass_renderer) {
-        snprintf(error, ERROR_SIZE, "%s: failed to initialize ASS renderer", filter_name);
-        vsapi->mapSetError(out, error);
-        vsapi->freeNode(d.node);
-        ass_library_done(d.ass_library);
-        return;
-    }
-
-    ass_set_font_scale(d.ass_renderer, d.scale);
-    ass_set_frame_size(d.ass_renderer, d.vi[0].width, d.vi[0].height);
-    ass_set_margins(d.ass_renderer,
-                    d.margins[0], d.margins[1], d.margins[2], d.margins[3]);
-    ass_set_use_margins(d.ass_renderer, 0);
-
-    if(d.linespacing)
-        ass_set_line_spacing(d.ass_renderer, d.linespacing);
-
-    if(d.sar) {
-        ass_set_aspect_ratio(d.ass_renderer,
-                             (double)d.vi[0].width /
-                             d.vi[0].height * d.sar, 1);
-    }
-
-    if(d.fontdir)
-        ass_set_fonts_dir(d.ass_library, d.fontdir);
-
-    ass_set_fonts(d.ass_renderer, NULL, NULL, 1, NULL, 1);
-
     if(d.file == NULL) {
 #define BUFFER_SIZE 16
         char *str, *text, x[BUFFER_SIZE], y[BUFFER_SIZE], start[BUFFER_SIZE] = { 0 }, end[BUFFER_SIZE] = { 0 };
@@ -429,8 +744,6 @@ static void VS_CC assRenderCreate(const VSMap *in, VSMap *out, void *userData,
             snprintf(error, ERROR_SIZE, "%s: Unable to calculate %s time", filter_name, start[0] ? "end" : "start");
             vsapi->mapSetError(out, error);
             vsapi->freeNode(d.node);
-            ass_renderer_done(d.ass_renderer);
-            ass_library_done(d.ass_library);
             return;
         }
 
@@ -444,65 +757,54 @@ static void VS_CC assRenderCreate(const VSMap *in, VSMap *out, void *userData,
 
         free(text);
 
-        d.ass = ass_new_track(d.ass_library);
-        ass_process_data(d.ass, str, strlen(str));
-
-        free(str);
+        d.script = str;
+        d.script_size = strlen(str);
     } else {
         snprintf(error, ERROR_SIZE, "%s: ", filter_name);
 
         int64_t contents_size;
-        char *contents = convertToUtf8(d.file, d.charset, &contents_size, error + strlen(error), ERROR_SIZE - strlen(error));
+        d.script = convertToUtf8(d.file, d.charset, &contents_size, error + strlen(error), ERROR_SIZE - strlen(error));
+        d.script_size = (size_t)contents_size;
 
-        if (contents) {
-            d.ass = ass_read_memory(d.ass_library, contents, contents_size, NULL);
-
-            if (!d.ass)
-                d.ass = convertToASS(d.file, contents, contents_size, d.ass_library, d.style, d.charset, error + strlen(error), ERROR_SIZE - strlen(error));
-
-            free(contents);
-        }
-
-        if (!contents || !d.ass) {
+        if (!d.script) {
             vsapi->mapSetError(out, error);
             vsapi->freeNode(d.node);
-            ass_renderer_done(d.ass_renderer);
-            ass_library_done(d.ass_library);
             return;
         }
     }
 
-    d.lastframe = vsapi->newVideoFrame(&d.vi[0].format,
-                                       d.vi[0].width,
-                                       d.vi[0].height,
-                                       NULL, core);
+    // The first renderer is created right away so broken scripts are reported here
+    d.renderers = createRenderer(&d, error, ERROR_SIZE, vsapi);
 
-    d.lastalpha = vsapi->newVideoFrame(&d.vi[1].format,
-                                       d.vi[1].width,
-                                       d.vi[1].height,
-                                       NULL, core);
+    if (!d.renderers) {
+        vsapi->mapSetError(out, error);
+        vsapi->freeNode(d.node);
+        free(d.script);
+        return;
+    }
 
-    for (int p = 0; p < 4; p++) {
-        VSFrame *frame = p == 3 ? d.lastalpha : d.lastframe;
-        int plane = p % 3;
+    int blend = !!vsapi->mapGetInt(in, "blend", 0, &err);
+    if (err)
+        blend = 1;
 
-        memset(vsapi->getWritePtr(frame, plane),
-               0,
-               vsapi->getStride(frame, plane) * vsapi->getFrameHeight(frame, plane));
-    }
+    // composited straight into the source frames, this saves the subtitle
+    // and mask clips and the filters that convert and merge them
+    int composite = blend && canComposite(&d, in, vsapi);
 
     data = malloc(sizeof(d));
     *data = d;
+    AssLockInit(&data->lock);
 
     VSFilterDependency deps[] = {{ d.node, rpStrictSpatial }};
-    vsapi->createVideoFilter(out, filter_name, d.vi, assGetFrame, assFree,
-                        fmUnordered, deps, 1, data, core);
-
-    int blend = !!vsapi->mapGetInt(in, "blend", 0, &err);
-    if (err)
-        blend = 1;
+    if (composite) {
+        vsapi->createVideoFilter(out, filter_name, &d.srcvi, assBlendGetFrame, assFree,
+                            fmParallel, deps, 1, data, core);
+    } else {
+        vsapi->createVideoFilter(out, filter_name, d.vi, assGetFrame, assFree,
+                            fmParallel, deps, 1, data, core);
+    }
 
-    if (blend) {
+    if (blend && !composite) {
         VSNode *subs = vsapi->mapGetNode(out, "clip", 0, NULL);
 
         blendSubtitles(d.node, subs, in, out, filter_name, error, ERROR_SIZE, core, vsapi);
@@ -20,26 +20,129 @@
  */
 
 #include <math.h>
+#include <string.h>
 
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
 
+#include "../../core/cpufeatures.h"
+#include "../../core/kernel/cpulevel.h"
+
+#include "vinverse.h"
+
 struct VinverseData {
     VSNode *node;
     VSVideoInfo vi;
 
-    double sstr;
-    double scl;
-    int amnt;
+    VinverseParams params;
+    VinverseRowFunc row;
 
     int *dlut;
 };
 typedef struct VinverseData VinverseData;
 
+void vinverse_row_byte_c(const void *pp, const void *p, const void *c,
+                         const void *n, const void *nn, void *dst,
+                         int width, const VinverseParams *params)
+{
+    const uint8_t *srcpp = pp;
+    const uint8_t *srcp = p;
+    const uint8_t *src = c;
+    const uint8_t *srcn = n;
+    const uint8_t *srcnn = nn;
+    uint8_t *dstp = dst;
+    int x;
+
+    for (x = 0; x < width; x++) {
+        uint8_t b3p = (srcp[x] + (src[x] << 1) + srcn[x] + 2) >> 2;
+        uint8_t b6p = (srcpp[x] + ((srcp[x] + srcn[x]) << 2) +
+                      src[x] * 6 + srcnn[x] + 8) >> 4;
+
+        int d1 = src[x] - b3p + 255;
+        int d2 = b3p - b6p + 255;
+        int df = b3p + params->dlut[(d1 << 9) + d2];
+
+        int minm = VSMAX(src[x] - params->amnt, 0);
+        int maxm = VSMIN(src[x] + params->amnt, 255);
+
+        if (df <= minm)
+            dstp[x] = minm;
+        else if (df >= maxm)
+            dstp[x] = maxm;
+        else
+            dstp[x] = df;
+    }
+}
+
+// The same calculation as the 8 bit lookup table
+static inline int VinverseDiff(int x, int y, const VinverseParams *params)
+{
+    double y2 = y * params->sstr;
+    double da = fabs((double)x) < fabs(y2) ? x : y2;
+    return (double)x * y2 < 0.0 ? (int)(da * params->scl) : (int)da;
+}
+
+void vinverse_row_word_c(const void *pp, const void *p, const void *c,
+                         const void *n, const void *nn, void *dst,
+                         int width, const VinverseParams *params)
+{
+    const uint16_t *srcpp = pp;
+    const uint16_t *srcp = p;
+    const uint16_t *src = c;
+    const uint16_t *srcn = n;
+    const uint16_t *srcnn = nn;
+    uint16_t *dstp = dst;
+    int x;
+
+    for (x = 0; x < width; x++) {
+        int b3p = (srcp[x] + (src[x] << 1) + srcn[x] + 2) >> 2;
+        int b6p = (srcpp[x] + ((srcp[x] + srcn[x]) << 2) +
+                  src[x] * 6 + srcnn[x] + 8) >> 4;
+
+        int df = b3p + VinverseDiff(src[x] - b3p, b3p - b6p, params);
+
+        int minm = VSMAX(src[x] - params->amnt, 0);
+        int maxm = VSMIN(src[x] + params->amnt, params->peak);
+
+        dstp[x] = VSMIN(VSMAX(df, minm), maxm);
+    }
+}
+
+void vinverse_row_float_c(const void *pp, const void *p, const void *c,
+                          const void *n, const void *nn, void *dst,
+                          int width, const VinverseParams *params)
+{
+    const float *srcpp = pp;
+    const float *srcp = p;
+    const float *src = c;
+    const float *srcn = n;
+    const float *srcnn = nn;
+    float *dstp = dst;
+    const float sstr = (float)params->sstr;
+    const float scl = (float)params->scl;
+    int x;
+
+    for (x = 0; x < width; x++) {
+        float b3p = (srcp[x] + src[x] * 2.0f + srcn[x]) * 0.25f;
+        float b6p = (srcpp[x] + (srcp[x] + srcn[x]) * 4.0f +
+                    src[x] * 6.0f + srcnn[x]) * 0.0625f;
+
+        float d1 = src[x] - b3p;
+        float d2 = (b3p - b6p) * sstr;
+        float da = fabsf(d1) < fabsf(d2) ? d1 : d2;
+        float df = b3p + (d1 * d2 < 0.0f ? da * scl : da);
+
+        float minm = src[x] - params->famnt;
+        float maxm = src[x] + params->famnt;
+
+        dstp[x] = VSMIN(VSMAX(df, minm), maxm);
+    }
+}
+
 static void Vinverse(const uint8_t *src, uint8_t *dst,
                      int width, int height, ptrdiff_t stride, VinverseData *d)
 {
-    int x, y;
+    int y;
 
     for (y = 0; y < height; y++) {
         const uint8_t *srcpp = y <  2 ? src + stride * 2 : src - stride * 2;
@@ -47,25 +150,7 @@ static void Vinverse(const uint8_t *src, uint8_t *dst,
         const uint8_t *srcn  = y == height - 1 ? src - stride     : src + stride;
         const uint8_t *srcnn = y >  height - 3 ? src - stride * 2 : src + stride * 2;
 
-        for (x = 0; x < width; x++) {
-            uint8_t b3p = (srcp[x] + (src[x] << 1) + srcn[x] + 2) >> 2;
-            uint8_t b6p = (srcpp[x] + ((srcp[x] + srcn[x]) << 2) +
-                          src[x] * 6 + srcnn[x] + 8) >> 4;
-
-            int d1 = src[x] - b3p + 255;
-            int d2 = b3p - b6p + 255;
-            int df = b3p + d->dlut[(d1 << 9) + d2];
-
-            int minm = VSMAX(src[x] - d->amnt, 0);
-            int maxm = VSMIN(src[x] + d->amnt, 255);
-
-            if (df <= minm)
-                dst[x] = minm;
-            else if (df >= maxm)
-                dst[x] = maxm;
-            else
-                dst[x] = df;
-        }
+        d->row(srcpp, srcp, src, srcn, srcnn, dst, width, &d->params);
 
         src += stride;
         dst += stride;
@@ -116,6 +201,22 @@ static void VS_CC VinverseFree(void *instanceData,
     free(d);
 }
 
+static int cpuLevelFromStr(const char *name)
+{
+    if (!strcmp(name, "none"))
+        return VS_CPU_LEVEL_NONE;
+#ifdef VS_TARGET_CPU_X86
+    else if (!strcmp(name, "sse2"))
+        return VS_CPU_LEVEL_SSE2;
+    else if (!strcmp(name, "avx2"))
+        return VS_CPU_LEVEL_AVX2;
+    else if (!strcmp(name, "avx512"))
+        return VS_CPU_LEVEL_AVX512;
+#endif
+    else
+        return VS_CPU_LEVEL_MAX;
+}
+
 static void VS_CC VinverseCreate(const VSMap *in, VSMap *out, void *userData,
                                   VSCore *core, const VSAPI *vsapi)
 {
@@ -132,51 +233,77 @@ static void VS_CC VinverseCreate(const VSMap *in, VSMap *out, void *userData,
         return;
     }
 
-    if (d.vi.format.sampleType != stInteger ||
-        d.vi.format.bytesPerSample != 1) {
+    if ((d.vi.format.sampleType == stInteger && d.vi.format.bytesPerSample > 2) ||
+        (d.vi.format.sampleType == stFloat && d.vi.format.bytesPerSample != 4)) {
 
-        vsapi->mapSetError(out, "Only 8-bit int formats supported");
+        vsapi->mapSetError(out, "Only 8-16 bit int and 32 bit float formats supported");
         vsapi->freeNode(d.node);
         return;
     }
 
-    d.sstr = vsapi->mapGetFloat(in, "sstr", 0, &err);
+    d.params.sstr = vsapi->mapGetFloat(in, "sstr", 0, &err);
 
     if (err)
-        d.sstr = 2.7;
+        d.params.sstr = 2.7;
 
-    d.amnt = vsapi->mapGetIntSaturated(in, "amnt", 0, &err);
+    int amnt = vsapi->mapGetIntSaturated(in, "amnt", 0, &err);
 
     if (err)
-        d.amnt = 255;
+        amnt = 255;
 
-    if (d.amnt < 1 || d.amnt > 255) {
+    if (amnt < 1 || amnt > 255) {
         vsapi->mapSetError(out, "amnt must be greater than 0 and less than 256");
         vsapi->freeNode(d.node);
         return;
     }
 
-    d.scl = vsapi->mapGetFloat(in, "scl", 0, &err);
+    d.params.scl = vsapi->mapGetFloat(in, "scl", 0, &err);
 
     if (err)
-        d.scl = 0.25;
+        d.params.scl = 0.25;
+
+    // amnt is given in 8 bit units
+    d.params.peak = d.vi.format.sampleType == stInteger ? (1 << d.vi.format.bitsPerSample) - 1 : 0;
+    d.params.amnt = (int)(((int64_t)amnt * d.params.peak + 127) / 255);
+    d.params.famnt = amnt / 255.0f;
+    d.params.dlut = NULL;
+
+    if (d.vi.format.sampleType == stFloat) {
+        d.row = vinverse_row_float_c;
+    } else if (d.vi.format.bytesPerSample == 2) {
+        d.row = vinverse_row_word_c;
+    } else {
+        d.row = vinverse_row_byte_c;
+
+        d.dlut = malloc(512 * 511 * sizeof(int));
+
+        if (!d.dlut) {
+            vsapi->mapSetError(out, "malloc failure (dlut)");
+            vsapi->freeNode(d.node);
+            return;
+        }
 
-    d.dlut = malloc(512 * 511 * sizeof(int));
+        for (int x = -255; x <= 255; x++) {
+            for (int y = -255; y <= 255; y++)
+                d.dlut[((x + 255) << 9) + (y + 255)] = VinverseDiff(x, y, &d.params);
+        }
 
-    if (!d.dlut) {
-        vsapi->mapSetError(out, "malloc failure (dlut)");
-        vsapi->freeNode(d.node);
-        return;
+        d.params.dlut = d.dlut;
     }
 
-    for (int x = -255; x <= 255; x++) {
-        for (int y = -255; y <= 255; y++) {
-            double y2 = y * d.sstr;
-            double da = fabs((double)x) < fabs(y2) ? x : y2;
-            d.dlut[((x + 255) << 9) + (y + 255)] = (double)x * y2 < 0.0 ?
-                (int)(da * d.scl) : (int)da;
-        }
+    const char *cpu = vsapi->mapGetData(in, "cpu", 0, &err);
+    const int cpulevel = err ? VS_CPU_LEVEL_MAX : cpuLevelFromStr(cpu);
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2) {
+        if (d.vi.format.sampleType == stFloat)
+            d.row = vinverse_row_float_avx2;
+        else if (d.vi.format.bytesPerSample == 2)
+            d.row = vinverse_row_word_avx2;
+        else
+            d.row = vinverse_row_byte_avx2;
     }
+#endif
 
     data = malloc(sizeof(d));
     *data = d;
@@ -194,7 +321,8 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI
                  "clip:vnode;"
                  "sstr:float:opt;"
                  "amnt:int:opt;"
-                 "scl:float:opt;",
+                 "scl:float:opt;"
+                 "cpu:data:opt;",
                  "clip:vnode;",
                  VinverseCreate, NULL, plugin);
 }
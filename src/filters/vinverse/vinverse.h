@@ -0,0 +1,57 @@
+/*
+ * Vinverse, a simple filter to remove residual combing.
+ *
+ * VapourSynth port by Martin Herkt
+ *
+ * Copyright (C) 2006 Kevin Stone
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VINVERSE_H
+#define VINVERSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct VinverseParams {
+    double sstr;
+    double scl;
+    int amnt; // scaled to the bit depth
+    int peak;
+    float famnt;
+    const int *dlut; // 8 bit only
+} VinverseParams;
+
+/*
+ * One row of Vinverse. pp, p, n and nn are the rows two and one above and
+ * below c, already mirrored at the edges of the plane.
+ */
+typedef void (*VinverseRowFunc)(const void *pp, const void *p, const void *c, const void *n, const void *nn, void *dst, int width, const VinverseParams *params);
+
+#define DECL_ROW(pixel, isa) void vinverse_row_##pixel##_##isa(const void *pp, const void *p, const void *c, const void *n, const void *nn, void *dst, int width, const VinverseParams *params);
+
+DECL_ROW(byte, c)
+DECL_ROW(word, c)
+DECL_ROW(float, c)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_ROW(byte, avx2)
+DECL_ROW(word, avx2)
+DECL_ROW(float, avx2)
+#endif
+
+#undef DECL_ROW
+
+#endif // VINVERSE_H
@@ -0,0 +1,147 @@
+/*
+ * Vinverse, a simple filter to remove residual combing.
+ *
+ * VapourSynth port by Martin Herkt
+ *
+ * Copyright (C) 2006 Kevin Stone
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <immintrin.h>
+#include "vinverse.h"
+
+// The 8 bit lookup table calculation done in double precision, 4 lanes at a time
+static __m128i diff_half(__m128i x, __m128i y, __m256d sstr, __m256d scl)
+{
+    const __m256d absmask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    __m256d xd = _mm256_cvtepi32_pd(x);
+    __m256d y2 = _mm256_mul_pd(_mm256_cvtepi32_pd(y), sstr);
+    __m256d lt = _mm256_cmp_pd(_mm256_and_pd(xd, absmask), _mm256_and_pd(y2, absmask), _CMP_LT_OQ);
+    __m256d da = _mm256_blendv_pd(y2, xd, lt);
+    __m256d neg = _mm256_cmp_pd(_mm256_mul_pd(xd, y2), _mm256_setzero_pd(), _CMP_LT_OQ);
+    return _mm256_cvttpd_epi32(_mm256_blendv_pd(da, _mm256_mul_pd(da, scl), neg));
+}
+
+static __m256i vinverse_int(__m256i pp, __m256i p, __m256i c, __m256i n, __m256i nn, const VinverseParams *params)
+{
+    const __m256d sstr = _mm256_set1_pd(params->sstr);
+    const __m256d scl = _mm256_set1_pd(params->scl);
+    __m256i b3p = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(p, _mm256_slli_epi32(c, 1)), _mm256_add_epi32(n, _mm256_set1_epi32(2))), 2);
+    __m256i b6p = _mm256_add_epi32(_mm256_add_epi32(pp, _mm256_slli_epi32(_mm256_add_epi32(p, n), 2)), _mm256_mullo_epi32(c, _mm256_set1_epi32(6)));
+    __m256i x, y, df, minm, maxm;
+
+    b6p = _mm256_srli_epi32(_mm256_add_epi32(b6p, _mm256_add_epi32(nn, _mm256_set1_epi32(8))), 4);
+    x = _mm256_sub_epi32(c, b3p);
+    y = _mm256_sub_epi32(b3p, b6p);
+
+    df = _mm256_inserti128_si256(_mm256_castsi128_si256(diff_half(_mm256_castsi256_si128(x), _mm256_castsi256_si128(y), sstr, scl)),
+                                 diff_half(_mm256_extracti128_si256(x, 1), _mm256_extracti128_si256(y, 1), sstr, scl), 1);
+    df = _mm256_add_epi32(b3p, df);
+
+    minm = _mm256_max_epi32(_mm256_sub_epi32(c, _mm256_set1_epi32(params->amnt)), _mm256_setzero_si256());
+    maxm = _mm256_min_epi32(_mm256_add_epi32(c, _mm256_set1_epi32(params->amnt)), _mm256_set1_epi32(params->peak));
+
+    return _mm256_min_epi32(_mm256_max_epi32(df, minm), maxm);
+}
+
+static __m256 vinverse_float(__m256 pp, __m256 p, __m256 c, __m256 n, __m256 nn, const VinverseParams *params)
+{
+    const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 sstr = _mm256_set1_ps((float)params->sstr);
+    const __m256 scl = _mm256_set1_ps((float)params->scl);
+    const __m256 amnt = _mm256_set1_ps(params->famnt);
+    // c * 6 as c * 4 + c * 2 rounds the same way whether or not it is contracted to fma
+    __m256 c6 = _mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(4.0f)), _mm256_mul_ps(c, _mm256_set1_ps(2.0f)));
+    __m256 b3p = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(p, _mm256_mul_ps(c, _mm256_set1_ps(2.0f))), n), _mm256_set1_ps(0.25f));
+    __m256 b6p = _mm256_add_ps(_mm256_add_ps(pp, _mm256_mul_ps(_mm256_add_ps(p, n), _mm256_set1_ps(4.0f))), c6);
+    __m256 d1, d2, da, df;
+
+    b6p = _mm256_mul_ps(_mm256_add_ps(b6p, nn), _mm256_set1_ps(0.0625f));
+    d1 = _mm256_sub_ps(c, b3p);
+    d2 = _mm256_mul_ps(_mm256_sub_ps(b3p, b6p), sstr);
+    da = _mm256_blendv_ps(d2, d1, _mm256_cmp_ps(_mm256_and_ps(d1, absmask), _mm256_and_ps(d2, absmask), _CMP_LT_OQ));
+    df = _mm256_blendv_ps(da, _mm256_mul_ps(da, scl), _mm256_cmp_ps(_mm256_mul_ps(d1, d2), _mm256_setzero_ps(), _CMP_LT_OQ));
+    df = _mm256_add_ps(b3p, df);
+
+    return _mm256_min_ps(_mm256_max_ps(df, _mm256_sub_ps(c, amnt)), _mm256_add_ps(c, amnt));
+}
+
+static __m256i load_byte(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+
+static void store_byte(uint8_t *p, __m256i v)
+{
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(w, w));
+}
+
+static __m256i load_word(const uint16_t *p)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p));
+}
+
+static void store_word(uint16_t *p, __m256i v)
+{
+    _mm_storeu_si128((__m128i *)p, _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+static __m256 load_float(const float *p)
+{
+    return _mm256_loadu_ps(p);
+}
+
+static void store_float(float *p, __m256 v)
+{
+    _mm256_storeu_ps(p, v);
+}
+
+// The last partial group of 8 pixels goes through a zero padded copy
+#define VINVERSE_ROW(pixel, T, calc) \
+void vinverse_row_##pixel##_avx2(const void *pp, const void *p, const void *c, const void *n, const void *nn, void *dst, int width, const VinverseParams *params) \
+{ \
+    const T *srcpp = pp; \
+    const T *srcp = p; \
+    const T *src = c; \
+    const T *srcn = n; \
+    const T *srcnn = nn; \
+    T *dstp = dst; \
+    const int vec_end = width & ~7; \
+    int x; \
+ \
+    for (x = 0; x < vec_end; x += 8) \
+        store_##pixel(dstp + x, calc(load_##pixel(srcpp + x), load_##pixel(srcp + x), load_##pixel(src + x), load_##pixel(srcn + x), load_##pixel(srcnn + x), params)); \
+ \
+    if (vec_end < width) { \
+        T tmp[6][8] = { { 0 } }; \
+        size_t size = (width - vec_end) * sizeof(T); \
+ \
+        memcpy(tmp[0], srcpp + vec_end, size); \
+        memcpy(tmp[1], srcp + vec_end, size); \
+        memcpy(tmp[2], src + vec_end, size); \
+        memcpy(tmp[3], srcn + vec_end, size); \
+        memcpy(tmp[4], srcnn + vec_end, size); \
+        store_##pixel(tmp[5], calc(load_##pixel(tmp[0]), load_##pixel(tmp[1]), load_##pixel(tmp[2]), load_##pixel(tmp[3]), load_##pixel(tmp[4]), params)); \
+        memcpy(dstp + vec_end, tmp[5], size); \
+    } \
+}
+
+VINVERSE_ROW(byte, uint8_t, vinverse_int)
+VINVERSE_ROW(word, uint16_t, vinverse_int)
+VINVERSE_ROW(float, float, vinverse_float)
+
+#undef VINVERSE_ROW
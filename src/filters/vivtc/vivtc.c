@@ -22,15 +22,21 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stddef.h>
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <pthread.h>
 #endif
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
+#define VS_VIVTC_IMPL
+#include "vivtc.h"
+#include "../../core/cpufeatures.h"
 
 // Shared
 
@@ -38,8 +44,72 @@ static int isPowerOf2(int i) {
     return i && !(i & (i - 1));
 }
 
+#ifdef _WIN32
+typedef SRWLOCK VIVTCLock;
+#define vivtcLockInit(l) InitializeSRWLock(l)
+#define vivtcLockDestroy(l) ((void)(l))
+#define vivtcLockAcquire(l) AcquireSRWLockExclusive(l)
+#define vivtcLockRelease(l) ReleaseSRWLockExclusive(l)
+#else
+typedef pthread_mutex_t VIVTCLock;
+#define vivtcLockInit(l) pthread_mutex_init((l), NULL)
+#define vivtcLockDestroy(l) pthread_mutex_destroy(l)
+#define vivtcLockAcquire(l) pthread_mutex_lock(l)
+#define vivtcLockRelease(l) pthread_mutex_unlock(l)
+#endif
+
 // VFM
 
+void vfm_abs_diff_row_c(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n) {
+    int x;
+    for (x=0; x<n; x++)
+        dst[x] = abs(a[x]-b[x]);
+}
+
+void vfm_diff_map_row_c(const uint8_t *dp, ptrdiff_t tpitch, uint8_t *dst, int width, int up2, int down2) {
+    int x;
+    for (x=1; x<width-1; ++x)
+        dst[x] += vfm_diff_map_pixel(dp, tpitch, x, width, up2, down2);
+}
+
+void vfm_comb_mask_row_c(const uint8_t *srcp, ptrdiff_t stride, uint8_t *dst, int width, int cthresh) {
+    int x;
+    for (x=0; x<width; ++x)
+        dst[x] = vfm_comb_pixel(srcp, stride, x, cthresh);
+}
+
+void vfm_comb_count_row_c(const uint8_t *pp, const uint8_t *p, const uint8_t *pn, uint16_t *colsum, int width) {
+    int x;
+    for (x=0; x<width; ++x)
+        colsum[x] += (pp[x] == 0xFF && p[x] == 0xFF && pn[x] == 0xFF);
+}
+
+void vfm_field_diff_row_c(const uint8_t *curpf, const uint8_t *curf, const uint8_t *curnf, const uint8_t *prvpf, const uint8_t *prvnf,
+    const uint8_t *nxtpf, const uint8_t *nxtnf, const uint8_t *map0, const uint8_t *map1, int n, uint64_t accum[6]) {
+    int x;
+    for (x=0; x<n; x++)
+        vfm_field_diff_pixel(curpf[x], curf[x], curnf[x], prvpf[x], prvnf[x], nxtpf[x], nxtnf[x], map0[x] | map1[x], accum);
+}
+
+typedef struct {
+    void (*absDiffRow)(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n);
+    void (*diffMapRow)(const uint8_t *dp, ptrdiff_t tpitch, uint8_t *dst, int width, int up2, int down2);
+    void (*combMaskRow)(const uint8_t *srcp, ptrdiff_t stride, uint8_t *dst, int width, int cthresh);
+    void (*combCountRow)(const uint8_t *pp, const uint8_t *p, const uint8_t *pn, uint16_t *colsum, int width);
+    void (*fieldDiffRow)(const uint8_t *curpf, const uint8_t *curf, const uint8_t *curnf, const uint8_t *prvpf, const uint8_t *prvnf,
+        const uint8_t *nxtpf, const uint8_t *nxtnf, const uint8_t *map0, const uint8_t *map1, int n, uint64_t accum[6]);
+} VFMKernels;
+
+// The mic of a woven frame only depends on the frames its even and odd lines come from,
+// so neighbouring output frames can share the values of the matches they have in common.
+#define VFM_MIC_CACHE_SIZE 64
+
+typedef struct {
+    int even;
+    int odd;
+    int mic;
+} VFMMicEntry;
+
 typedef struct {
     VSNode *node;
     VSNode *clip2;
@@ -60,6 +130,9 @@ typedef struct {
     int y1;
     int micmatch;
     int micout;
+    VFMKernels kernels;
+    VIVTCLock micLock;
+    VFMMicEntry micCache[VFM_MIC_CACHE_SIZE];
 } VFMData;
 
 
@@ -76,12 +149,11 @@ static void copyField(VSFrame *dst, const VSFrame *src, int field, const VSAPI *
 // the secret is that tbuffer is an interlaced, offset subset of all the lines
 static void buildABSDiffMask(const uint8_t *prvp, const uint8_t *nxtp,
     ptrdiff_t src_pitch, ptrdiff_t tpitch, uint8_t *tbuffer, int width, int height,
-    const VSAPI *vsapi) {
+    const VFMKernels *k) {
 
-    int y, x;
+    int y;
     for (y=0; y<height; ++y) {
-        for (x=0; x<width; x++)
-            tbuffer[x] = abs(prvp[x]-nxtp[x]);
+        k->absDiffRow(prvp, nxtp, tbuffer, width);
 
         prvp += src_pitch;
         nxtp += src_pitch;
@@ -91,12 +163,12 @@ static void buildABSDiffMask(const uint8_t *prvp, const uint8_t *nxtp,
 
 
 static int calcMI(const VSFrame *src, const VSAPI *vsapi,
-    int *blockN, int chroma, int cthresh, VSFrame *cmask, int *cArray, int blockx, int blocky)
+    int *blockN, int chroma, int cthresh, VSFrame *cmask, int *cArray, uint16_t *colSum, int blockx, int blocky, const VFMKernels *k)
 {
     int ret = 0;
     const int cthresh6 = cthresh*6;
     int plane;
-    int x, y, u, v;
+    int x, y, v;
     for (plane=0; plane < (chroma ? 3 : 1); plane++) {
         const uint8_t *srcp = vsapi->getReadPtr(src, plane);
         const ptrdiff_t src_pitch = vsapi->getStride(src, plane);
@@ -130,14 +202,7 @@ static int calcMI(const VSFrame *src, const VSAPI *vsapi,
         cmkp += cmk_pitch;
 
         for (y=2; y<Height-2; ++y) {
-            for (x=0; x<Width; ++x) {
-                const int sFirst = srcp[x] - srcp[x - src_pitch];
-                const int sSecond = srcp[x] - srcp[x + src_pitch];
-                if ((sFirst > cthresh && sSecond > cthresh) || (sFirst < -cthresh && sSecond < -cthresh)) {
-                    if (abs(srcp[x - 2*src_pitch]+(srcp[x]*4)+srcp[x + 2*src_pitch]-(3*(srcp[x - src_pitch]+srcp[x + src_pitch]))) > cthresh6)
-                        cmkp[x] = 0xFF;
-                }
-            }
+            k->combMaskRow(srcp, src_pitch, cmkp, Width, cthresh);
             srcp += src_pitch;
             cmkp += cmk_pitch;
         }
@@ -225,76 +290,29 @@ static int calcMI(const VSFrame *src, const VSAPI *vsapi,
     int yhalf = blocky/2;
     const ptrdiff_t cmk_pitch = vsapi->getStride(cmask, 0);
     const uint8_t *cmkp = vsapi->getReadPtr(cmask, 0) + cmk_pitch;
-    const uint8_t *cmkpp = cmkp - cmk_pitch;
-    const uint8_t *cmkpn = cmkp + cmk_pitch;
     const int Width = vsapi->getFrameWidth(cmask, 0);
     const int Height = vsapi->getFrameHeight(cmask, 0);
     const int xblocks = ((Width+xhalf)/blockx) + 1;
     const int xblocks4 = xblocks<<2;
     const int yblocks = ((Height+yhalf)/blocky) + 1;
     const int arraysize = (xblocks*yblocks)<<2;
-    int Heighta = (Height/(blocky/2))*(blocky/2);
-    const int Widtha = (Width/(blockx/2))*(blockx/2);
-    if (Heighta == Height)
-        Heighta = Height-yhalf;
     memset(&cArray[0],0,arraysize*sizeof(int));
-    for (y=1; y<yhalf; ++y) {
+    // all rows of a half block height add to the same boxes, so count the combed
+    // pixels per column for those rows and then sum them up per half block width
+    for (y=1; y<Height-1;) {
+        const int yend = VSMIN((y/yhalf+1)*yhalf, Height-1);
         const int temp1 = (y/blocky)*xblocks4;
         const int temp2 = ((y+yhalf)/blocky)*xblocks4;
-        for (x=0; x<Width; ++x) {
-            if (cmkpp[x] == 0xFF && cmkp[x] == 0xFF && cmkpn[x] == 0xFF) {
-                const int box1 = (x/blockx)*4;
-                const int box2 = ((x+xhalf)/blockx)*4;
-                ++cArray[temp1+box1+0];
-                ++cArray[temp1+box2+1];
-                ++cArray[temp2+box1+2];
-                ++cArray[temp2+box2+3];
-            }
-        }
-        cmkpp += cmk_pitch;
-        cmkp += cmk_pitch;
-        cmkpn += cmk_pitch;
-    }
-    for (y=yhalf; y<Heighta; y+=yhalf) {
-        const int temp1 = (y/blocky)*xblocks4;
-        const int temp2 = ((y+yhalf)/blocky)*xblocks4;
-
-        for (x=0; x<Widtha; x+=xhalf) {
-            const uint8_t *cmkppT = cmkpp;
-            const uint8_t *cmkpT = cmkp;
-            const uint8_t *cmkpnT = cmkpn;
-            int sum = 0;
-            for (u=0; u<yhalf; ++u) {
-                for (v=0; v<xhalf; ++v) {
-                    if (cmkppT[x+v] == 0xFF && cmkpT[x+v] == 0xFF &&
-                        cmkpnT[x+v] == 0xFF) ++sum;
-                }
-                cmkppT += cmk_pitch;
-                cmkpT += cmk_pitch;
-                cmkpnT += cmk_pitch;
-            }
-            if (sum) {
-                const int box1 = (x/blockx)*4;
-                const int box2 = ((x+xhalf)/blockx)*4;
-                cArray[temp1+box1+0] += sum;
-                cArray[temp1+box2+1] += sum;
-                cArray[temp2+box1+2] += sum;
-                cArray[temp2+box2+3] += sum;
-            }
+        memset(colSum, 0, Width*sizeof(uint16_t));
+        for (; y<yend; ++y) {
+            k->combCountRow(cmkp - cmk_pitch, cmkp, cmkp + cmk_pitch, colSum, Width);
+            cmkp += cmk_pitch;
         }
-
-        for (x=Widtha; x<Width; ++x) {
-            const uint8_t *cmkppT = cmkpp;
-            const uint8_t *cmkpT = cmkp;
-            const uint8_t *cmkpnT = cmkpn;
+        for (x=0; x<Width; x+=xhalf) {
+            const int xend = VSMIN(x+xhalf, Width);
             int sum = 0;
-            for (u=0; u<yhalf; ++u) {
-                if (cmkppT[x] == 0xFF && cmkpT[x] == 0xFF &&
-                    cmkpnT[x] == 0xFF) ++sum;
-                cmkppT += cmk_pitch;
-                cmkpT += cmk_pitch;
-                cmkpnT += cmk_pitch;
-            }
+            for (v=x; v<xend; ++v)
+                sum += colSum[v];
             if (sum) {
                 const int box1 = (x/blockx)*4;
                 const int box2 = ((x+xhalf)/blockx)*4;
@@ -304,26 +322,6 @@ static int calcMI(const VSFrame *src, const VSAPI *vsapi,
                 cArray[temp2+box2+3] += sum;
             }
         }
-        cmkpp += cmk_pitch*yhalf;
-        cmkp += cmk_pitch*yhalf;
-        cmkpn += cmk_pitch*yhalf;
-    }
-    for (y=Heighta; y<Height-1; ++y) {
-        const int temp1 = (y/blocky)*xblocks4;
-        const int temp2 = ((y+yhalf)/blocky)*xblocks4;
-        for (x=0; x<Width; ++x) {
-            if (cmkpp[x] == 0xFF && cmkp[x] == 0xFF && cmkpn[x] == 0xFF) {
-                const int box1 = (x/blockx)*4;
-                const int box2 = ((x+xhalf)/blockx)*4;
-                ++cArray[temp1+box1+0];
-                ++cArray[temp1+box2+1];
-                ++cArray[temp2+box1+2];
-                ++cArray[temp2+box2+3];
-            }
-        }
-        cmkpp += cmk_pitch;
-        cmkp += cmk_pitch;
-        cmkpn += cmk_pitch;
     }
     for (x=0; x<arraysize; ++x) {
         if (cArray[x] > ret) {
@@ -340,65 +338,23 @@ static int calcMI(const VSFrame *src, const VSAPI *vsapi,
 // build a map over which pixels differ a lot/a little
 static void buildDiffMap(const uint8_t *prvp, const uint8_t *nxtp,
                          uint8_t *dstp,ptrdiff_t src_pitch, ptrdiff_t dst_pitch, int Height,
-    int Width, ptrdiff_t tpitch, uint8_t *tbuffer, const VSAPI *vsapi)
+    int Width, ptrdiff_t tpitch, uint8_t *tbuffer, const VFMKernels *k)
 {
     const uint8_t *dp = tbuffer+tpitch;
-    int x, y, u, diff, count;
+    int y;
 
     buildABSDiffMask(prvp-src_pitch, nxtp-src_pitch, src_pitch,
-        tpitch, tbuffer, Width, Height>>1, vsapi);
+        tpitch, tbuffer, Width, Height>>1, k);
 
     for (y=2; y<Height-2; y+=2) {
-        for (x=1; x<Width-1; ++x) {
-            diff = dp[x];
-            if (diff > 3) {
-                for (count=0,u=x-1; u<x+2 && count<2; ++u) {
-                    if (dp[u-tpitch] > 3) ++count;
-                    if (dp[u] > 3) ++count;
-                    if (dp[u+tpitch] > 3) ++count;
-                }
-                if (count > 1) {
-                    ++dstp[x];
-                    if (diff > 19) {
-                        int upper = 0, lower = 0;
-                        for (count=0, u=x-1; u<x+2 && count<6; ++u) {
-                            if (dp[u-tpitch] > 19) { ++count; upper = 1; }
-                            if (dp[u] > 19) ++count;
-                            if (dp[u+tpitch] > 19) { ++count; lower = 1; }
-                        }
-                        if (count > 3) {
-                            if (!upper || !lower) {
-                                int upper2 = 0, lower2 = 0;
-                                for (u=VSMAX(x-4,0); u<VSMIN(x+5,Width); ++u)
-                                {
-                                    if (y != 2 && dp[u-2*tpitch] > 19)
-                                        upper2 = 1;
-                                    if (dp[u-tpitch] > 19)
-                                        upper = 1;
-                                    if (dp[u+tpitch] > 19)
-                                        lower = 1;
-                                    if (y != Height-4 && dp[u+2*tpitch] > 19)
-                                        lower2 = 1;
-                                }
-                                if ((upper && (lower || upper2)) ||
-                                    (lower && (upper || lower2)))
-                                    dstp[x] += 2;
-                                else if (count > 5)
-                                    dstp[x] += 4;
-                            }
-                            else dstp[x] += 2;
-                        }
-                    }
-                }
-            }
-        }
+        k->diffMapRow(dp, tpitch, dstp, Width, y != 2, y != Height-4);
         dp += tpitch;
         dstp += dst_pitch;
     }
 }
 
 static int compareFieldsSlow(const VSFrame *prv, const VSFrame *src, const VSFrame *nxt, VSFrame *map, int match1,
-    int match2, int mchroma, int field, int y0, int y1, uint8_t *tbuffer, int tpitchy, int tpitchuv, const VSAPI *vsapi)
+    int match2, int mchroma, int field, int y0, int y1, uint8_t *tbuffer, int tpitchy, int tpitchuv, const VFMKernels *k, const VSAPI *vsapi)
 {
     int plane, ret;
     const uint8_t *prvp = 0, *srcp = 0, *nxtp = 0;
@@ -410,10 +366,11 @@ static int compareFieldsSlow(const VSFrame *prv, const VSFrame *src, const VSFra
     ptrdiff_t map_pitch;
     ptrdiff_t curf_pitch;
     int stopx;
-    int x, y, temp1, temp2, startx, y0a, y1a, tp;
+    int y, startx, y0a, y1a, tp;
     int stop = mchroma ? 3 : 1;
-    unsigned long accumPc = 0, accumNc = 0, accumPm = 0;
-    unsigned long accumNm = 0, accumPml = 0, accumNml = 0;
+    uint64_t accum[6] = { 0 };
+    unsigned long accumPc, accumNc, accumPm;
+    unsigned long accumNm, accumPml, accumNml;
     int norm1, norm2, mtn1, mtn2;
     float c1, c2, mr;
 
@@ -478,36 +435,14 @@ static int compareFieldsSlow(const VSFrame *prv, const VSFrame *src, const VSFra
         nxtnf = nxtpf + curf_pitch;
         map_pitch <<= 1;
         if ((match1 >= 3 && field == 1) || (match1 < 3 && field != 1))
-            buildDiffMap(prvpf,nxtpf,mapp,curf_pitch,map_pitch,Height,Width,tp,tbuffer,vsapi);
+            buildDiffMap(prvpf,nxtpf,mapp,curf_pitch,map_pitch,Height,Width,tp,tbuffer,k);
         else
-            buildDiffMap(prvnf,nxtnf,mapp + map_pitch,curf_pitch,map_pitch,Height,Width,tp,tbuffer,vsapi);
+            buildDiffMap(prvnf,nxtnf,mapp + map_pitch,curf_pitch,map_pitch,Height,Width,tp,tbuffer,k);
 
         for (y=2; y<Height-2; y+=2) {
-            if (y0a == y1a || y < y0a || y > y1a) {
-                for (x=startx; x<stopx; x++) {
-                    if (mapp[x] > 0 || mapp[x + map_pitch] > 0) {
-                        temp1 = curpf[x]+(curf[x]<<2)+curnf[x];
-                        temp2 = abs(3*(prvpf[x]+prvnf[x])-temp1);
-                        if (temp2 > 23 && ((mapp[x]&1) || (mapp[x + map_pitch]&1)))
-                            accumPc += temp2;
-                        if (temp2 > 42) {
-                            if ((mapp[x]&2) || (mapp[x + map_pitch]&2))
-                                accumPm += temp2;
-                            if ((mapp[x]&4) || (mapp[x + map_pitch]&4))
-                                accumPml += temp2;
-                        }
-                        temp2 = abs(3*(nxtpf[x]+nxtnf[x])-temp1);
-                        if (temp2 > 23 && ((mapp[x]&1) || (mapp[x + map_pitch]&1)))
-                            accumNc += temp2;
-                        if (temp2 > 42) {
-                            if ((mapp[x]&2) || (mapp[x + map_pitch]&2))
-                                accumNm += temp2;
-                            if ((mapp[x]&4) || (mapp[x + map_pitch]&4))
-                                accumNml += temp2;
-                        }
-                    }
-                }
-            }
+            if (y0a == y1a || y < y0a || y > y1a)
+                k->fieldDiffRow(curpf + startx, curf + startx, curnf + startx, prvpf + startx, prvnf + startx,
+                    nxtpf + startx, nxtnf + startx, mapp + startx, mapp + map_pitch + startx, stopx - startx, accum);
             prvpf += curf_pitch;
             prvnf += curf_pitch;
             curpf += curf_pitch;
@@ -518,6 +453,12 @@ static int compareFieldsSlow(const VSFrame *prv, const VSFrame *src, const VSFra
             mapp += map_pitch;
         }
     }
+    accumPc = (unsigned long)accum[0];
+    accumPm = (unsigned long)accum[1];
+    accumPml = (unsigned long)accum[2];
+    accumNc = (unsigned long)accum[3];
+    accumNm = (unsigned long)accum[4];
+    accumNml = (unsigned long)accum[5];
     if (accumPm < 500 && accumNm < 500 && (accumPml >= 500 || accumNml >= 500) &&
         VSMAX(accumPml,accumNml) > 3*VSMIN(accumPml,accumNml))
     {
@@ -581,22 +522,73 @@ static const VSFrame *createWeaveFrame(const VSFrame *prv, const VSFrame *src,
 }
 
 
-static int checkmm(int m1, int m2, int *m1mic, int *m2mic, int *blockN, int MI, int field, int chroma, int cthresh, const VSFrame **genFrames,
-    const VSFrame *prv, const VSFrame *src, const VSFrame *nxt, VSFrame *cmask, int *cArray, int blockx, int blocky, const VSAPI *vsapi, VSCore *core) {
-    if (*m1mic < 0) {
-        if (!genFrames[m1])
-            genFrames[m1] = createWeaveFrame(prv, src, nxt, vsapi, core, m1, field);
-        *m1mic = calcMI(genFrames[m1], vsapi, blockN, chroma, cthresh, cmask, cArray, blockx, blocky);
-    }
+typedef struct {
+    const VSFrame *prv;
+    const VSFrame *src;
+    const VSFrame *nxt;
+    int nprv;
+    int n;
+    int nnxt;
+    int field;
+    const VSFrame *genFrames[5];
+    int mics[5];
+    VSFrame *cmask;
+    int *cArray;
+    uint16_t *colSum;
+} VFMMatchFrames;
+
+// the frame numbers the even and odd lines of a match are woven from
+static void weaveSources(const VFMMatchFrames *f, int match, int *even, int *odd) {
+    int fieldSrc = f->n, otherSrc = f->n;
+    if (match == 0)
+        fieldSrc = f->nprv;
+    else if (match == 2)
+        fieldSrc = f->nnxt;
+    else if (match == 3)
+        otherSrc = f->nprv;
+    else if (match == 4)
+        otherSrc = f->nnxt;
+    *even = f->field ? otherSrc : fieldSrc;
+    *odd = f->field ? fieldSrc : otherSrc;
+}
 
-    if (*m2mic < 0) {
-        if (!genFrames[m2])
-            genFrames[m2] = createWeaveFrame(prv, src, nxt, vsapi, core, m2, field);
-        *m2mic = calcMI(genFrames[m2], vsapi, blockN, chroma, cthresh, cmask, cArray, blockx, blocky);
+static int calcMatchMI(VFMData *vfm, VFMMatchFrames *f, int match, const VSAPI *vsapi, VSCore *core) {
+    int even, odd, slot, mic = -1;
+
+    weaveSources(f, match, &even, &odd);
+    slot = (even * 2 + odd) & (VFM_MIC_CACHE_SIZE - 1);
+
+    vivtcLockAcquire(&vfm->micLock);
+    if (vfm->micCache[slot].even == even && vfm->micCache[slot].odd == odd)
+        mic = vfm->micCache[slot].mic;
+    vivtcLockRelease(&vfm->micLock);
+
+    if (mic < 0) {
+        if (!f->genFrames[match])
+            f->genFrames[match] = createWeaveFrame(f->prv, f->src, f->nxt, vsapi, core, match, f->field);
+        mic = calcMI(f->genFrames[match], vsapi, NULL, vfm->chroma, vfm->cthresh, f->cmask, f->cArray, f->colSum, vfm->blockx, vfm->blocky, &vfm->kernels);
+
+        vivtcLockAcquire(&vfm->micLock);
+        vfm->micCache[slot].even = even;
+        vfm->micCache[slot].odd = odd;
+        vfm->micCache[slot].mic = mic;
+        vivtcLockRelease(&vfm->micLock);
     }
 
-    if (((*m2mic)*3 < *m1mic || ((*m2mic)*2 < *m1mic && *m1mic > MI)) &&
-        abs(*m2mic-*m1mic) >= 30 && *m2mic < MI)
+    return mic;
+}
+
+static int checkmm(VFMData *vfm, VFMMatchFrames *f, int m1, int m2, const VSAPI *vsapi, VSCore *core) {
+    int *mics = f->mics;
+
+    if (mics[m1] < 0)
+        mics[m1] = calcMatchMI(vfm, f, m1, vsapi, core);
+
+    if (mics[m2] < 0)
+        mics[m2] = calcMatchMI(vfm, f, m2, vsapi, core);
+
+    if ((mics[m2]*3 < mics[m1] || (mics[m2]*2 < mics[m1] && mics[m1] > vfm->mi)) &&
+        abs(mics[m2]-mics[m1]) >= 30 && mics[m2] < vfm->mi)
         return m2;
     else
         return m1;
@@ -629,7 +621,7 @@ typedef enum {
 } VFMField;
 
 static const VSFrame *VS_CC vfmGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
-    const VFMData *vfm = (const VFMData *)instanceData;
+    VFMData *vfm = (VFMData *)instanceData;
     n = VSMIN(vfm->vi->numFrames - 1, n);
     if (activationReason == arInitial) {
         if (n > 0) {
@@ -646,10 +638,13 @@ static const VSFrame *VS_CC vfmGetFrame(int n, int activationReason, void *insta
                 vsapi->requestFrameFilter(n+1, vfm->clip2, frameCtx);
         }
     } else if (activationReason == arAllFramesReady) {
-        const VSFrame *prv = vsapi->getFrameFilter(n > 0 ? n-1 : 0, vfm->node, frameCtx);
+        VFMMatchFrames f = { NULL };
+        const int nprv = n > 0 ? n-1 : 0;
+        const int nnxt = n < vfm->vi->numFrames - 1 ? n+1 : vfm->vi->numFrames - 1;
+        const VSFrame *prv = vsapi->getFrameFilter(nprv, vfm->node, frameCtx);
         const VSFrame *src = vsapi->getFrameFilter(n, vfm->node, frameCtx);
-        const VSFrame *nxt = vsapi->getFrameFilter(n < vfm->vi->numFrames - 1 ? n+1 : vfm->vi->numFrames - 1, vfm->node, frameCtx);
-        int mics[] = { -1,-1,-1,-1,-1 };
+        const VSFrame *nxt = vsapi->getFrameFilter(nnxt, vfm->node, frameCtx);
+        int *mics = f.mics;
 
         int order, field;
         int missing;
@@ -673,8 +668,7 @@ static const VSFrame *VS_CC vfmGetFrame(int n, int activationReason, void *insta
         const int *fxo = field ^ order ? fxo1m : fxo0m;
         int match;
         int i;
-        const VSFrame *genFrames[] =  { NULL, NULL, NULL, NULL, NULL };
-        int blockN;
+        const VSFrame **genFrames = f.genFrames;
         const VSFrame *dst1;
         VSFrame *dst2;
         VSMap *m;
@@ -684,10 +678,21 @@ static const VSFrame *VS_CC vfmGetFrame(int n, int activationReason, void *insta
         int height = vsapi->getFrameHeight(src, 0);
 
         VSFrame *map = vsapi->newVideoFrame(format, width, height, NULL, core);
-        VSFrame *cmask = vsapi->newVideoFrame(format, width, height, NULL, core);
 
         uint8_t *tbuffer = (uint8_t *)malloc((height>>1)*vfm->tpitchy*sizeof(uint8_t));
-        int *cArray = (int *)malloc((((width+vfm->blockx/2)/vfm->blockx)+1)*(((height+vfm->blocky/2)/vfm->blocky)+1)*4*sizeof(int));
+
+        f.prv = prv;
+        f.src = src;
+        f.nxt = nxt;
+        f.nprv = nprv;
+        f.n = n;
+        f.nnxt = nnxt;
+        f.field = field;
+        for (i = 0; i < 5; i++)
+            mics[i] = -1;
+        f.cmask = vsapi->newVideoFrame(format, width, height, NULL, core);
+        f.cArray = (int *)malloc((((width+vfm->blockx/2)/vfm->blockx)+1)*(((height+vfm->blocky/2)/vfm->blocky)+1)*4*sizeof(int));
+        f.colSum = (uint16_t *)malloc(width*sizeof(uint16_t));
 
         // check if it's a scenechange so micmatch can be used
         // only relevant for mm mode 1
@@ -701,18 +706,18 @@ static const VSFrame *VS_CC vfmGetFrame(int n, int activationReason, void *insta
         }
 
         // p/c selection
-        match = compareFieldsSlow(prv, src, nxt, map, fxo[mC], fxo[mP], vfm->mchroma, field, vfm->y0, vfm->y1, tbuffer, vfm->tpitchy, vfm->tpitchuv, vsapi);
+        match = compareFieldsSlow(prv, src, nxt, map, fxo[mC], fxo[mP], vfm->mchroma, field, vfm->y0, vfm->y1, tbuffer, vfm->tpitchy, vfm->tpitchuv, &vfm->kernels, vsapi);
         // the mode has 3-way p/c/n matches
         if (vfm->mode >= 4)
-            match = compareFieldsSlow(prv, src, nxt, map, match, fxo[mN], vfm->mchroma, field, vfm->y0, vfm->y1, tbuffer, vfm->tpitchy, vfm->tpitchuv, vsapi);
+            match = compareFieldsSlow(prv, src, nxt, map, match, fxo[mN], vfm->mchroma, field, vfm->y0, vfm->y1, tbuffer, vfm->tpitchy, vfm->tpitchuv, &vfm->kernels, vsapi);
 
         genFrames[mC] = vsapi->addFrameRef(src);
 
         // calculate all values for mic output, checkmm calculates and prepares it for the two matches if not already done
         if (vfm->micout) {
-            checkmm(0, 1, &mics[0], &mics[1], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
-            checkmm(2, 3, &mics[2], &mics[3], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
-            checkmm(4, 0, &mics[4], &mics[0], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
+            checkmm(vfm, &f, 0, 1, vsapi, core);
+            checkmm(vfm, &f, 2, 3, vsapi, core);
+            checkmm(vfm, &f, 4, 0, vsapi, core);
         }
 
         // check the micmatches to see if one of the options are better
@@ -722,30 +727,27 @@ static const VSFrame *VS_CC vfmGetFrame(int n, int activationReason, void *insta
             // here comes the conditional hell to try to approximate mode 0-5 in tfm
             if (vfm->mode == 0) {
                 // maybe not completely appropriate but go back and see if the discarded match is less sucky
-                match = checkmm(match, match == fxo[mP] ? fxo[mC] : fxo[mP], &mics[match], &mics[match == fxo[mP] ? fxo[mC] : fxo[mP]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
+                match = checkmm(vfm, &f, match, match == fxo[mP] ? fxo[mC] : fxo[mP], vsapi, core);
             } else if (vfm->mode == 1) {
-                match = checkmm(match, fxo[mN], &mics[match], &mics[fxo[mN]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
+                match = checkmm(vfm, &f, match, fxo[mN], vsapi, core);
             } else if (vfm->mode == 2) {
-                match = checkmm(match, fxo[mU], &mics[match], &mics[fxo[mU]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
+                match = checkmm(vfm, &f, match, fxo[mU], vsapi, core);
             } else if (vfm->mode == 3) {
-                match = checkmm(match, fxo[mN], &mics[match], &mics[fxo[mN]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
-                match = checkmm(match, fxo[mU], &mics[match], &mics[fxo[mU]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
-                match = checkmm(match, fxo[mB], &mics[match], &mics[fxo[mB]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
+                match = checkmm(vfm, &f, match, fxo[mN], vsapi, core);
+                match = checkmm(vfm, &f, match, fxo[mU], vsapi, core);
+                match = checkmm(vfm, &f, match, fxo[mB], vsapi, core);
             } else if (vfm->mode == 4) {
                 // degenerate check because I'm lazy
-                match = checkmm(match, match == fxo[mP] ? fxo[mC] : fxo[mP], &mics[match], &mics[match == fxo[mP] ? fxo[mC] : fxo[mP]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky,vsapi, core);
+                match = checkmm(vfm, &f, match, match == fxo[mP] ? fxo[mC] : fxo[mP], vsapi, core);
             } else if (vfm->mode == 5) {
-                match = checkmm(match, fxo[mU], &mics[match], &mics[fxo[mU]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
-                match = checkmm(match, fxo[mB], &mics[match], &mics[fxo[mB]], &blockN, vfm->mi, field, vfm->chroma, vfm->cthresh, genFrames, prv, src, nxt, cmask, &cArray[0], vfm->blockx, vfm->blocky, vsapi, core);
+                match = checkmm(vfm, &f, match, fxo[mU], vsapi, core);
+                match = checkmm(vfm, &f, match, fxo[mB], vsapi, core);
             }
         }
 
         // Make sure mic is always calculated for selected match so _Combed will work
-        if (mics[match] < 0) {
-            if (!genFrames[match])
-                genFrames[match] = createWeaveFrame(prv, src, nxt, vsapi, core, match, field);
-            mics[match] = calcMI(genFrames[match], vsapi, &blockN, vfm->chroma, vfm->cthresh, cmask, cArray, vfm->blockx, vfm->blocky);
-        }
+        if (mics[match] < 0)
+            mics[match] = calcMatchMI(vfm, &f, match, vsapi, core);
 
         // Alternative clip handling
         if (vfm->clip2) {
@@ -770,9 +772,10 @@ static const VSFrame *VS_CC vfmGetFrame(int n, int activationReason, void *insta
             vsapi->freeFrame(genFrames[i]);
 
         free(tbuffer);
-        free(cArray);
+        free(f.cArray);
+        free(f.colSum);
         vsapi->freeFrame(map);
-        vsapi->freeFrame(cmask);
+        vsapi->freeFrame(f.cmask);
 
         dst2 = vsapi->copyFrame(dst1, core);
         vsapi->freeFrame(dst1);
@@ -792,6 +795,7 @@ static void VS_CC vfmFree(void *instanceData, VSCore *core, const VSAPI *vsapi)
     VFMData *vfm = (VFMData *)instanceData;
     vsapi->freeNode(vfm->node);
     vsapi->freeNode(vfm->clip2);
+    vivtcLockDestroy(&vfm->micLock);
     free(vfm);
 }
 
@@ -974,8 +978,32 @@ static void VS_CC createVFM(const VSMap *in, VSMap *out, void *userData, VSCore
     int widthuv = vi->width >> vi->format.subSamplingW;
     vfm.tpitchuv = (widthuv&15) ? widthuv+16-(widthuv&15) : widthuv;
 
+    vfm.kernels.absDiffRow = vfm_abs_diff_row_c;
+    vfm.kernels.diffMapRow = vfm_diff_map_row_c;
+    vfm.kernels.combMaskRow = vfm_comb_mask_row_c;
+    vfm.kernels.combCountRow = vfm_comb_count_row_c;
+    vfm.kernels.fieldDiffRow = vfm_field_diff_row_c;
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2) {
+        vfm.kernels.absDiffRow = vfm_abs_diff_row_avx2;
+        vfm.kernels.diffMapRow = vfm_diff_map_row_avx2;
+        vfm.kernels.combMaskRow = vfm_comb_mask_row_avx2;
+        vfm.kernels.combCountRow = vfm_comb_count_row_avx2;
+        vfm.kernels.fieldDiffRow = vfm_field_diff_row_avx2;
+    } else {
+        vfm.kernels.absDiffRow = vfm_abs_diff_row_sse2;
+        vfm.kernels.diffMapRow = vfm_diff_map_row_sse2;
+        vfm.kernels.combMaskRow = vfm_comb_mask_row_sse2;
+        vfm.kernels.combCountRow = vfm_comb_count_row_sse2;
+        vfm.kernels.fieldDiffRow = vfm_field_diff_row_sse2;
+    }
+#endif
+
     vfmd = (VFMData *)malloc(sizeof(vfm));
     *vfmd = vfm;
+    vivtcLockInit(&vfmd->micLock);
+    for (int i = 0; i < VFM_MIC_CACHE_SIZE; i++)
+        vfmd->micCache[i].even = -1;
 
     VSFilterDependency deps[] = {{vfm.node, rpGeneral}, {vfm.clip2, rpGeneral}};
     vsapi->createVideoFilter(out, "VFM", vfmd->vi, vfmGetFrame, vfmFree, fmParallel, deps, vfm.clip2 ? 2 : 1, vfmd, core);
@@ -1019,16 +1047,26 @@ typedef struct {
     int64_t scthresh;
     int blockx;
     int blocky;
-    int nxblocks;
-    int nyblocks;
-    int bdiffsize;
-    int64_t *bdiffs;
+    VSNode *metrics;            // The VDecimateMetrics stage, computes the metrics of node in parallel.
     const char *ovrfile;
     int dryrun;
     signed char *drop;
+    VDInfo *frameMetrics;       // Metrics of every input frame, loaded from and saved to the metrics files.
+    FILE *metricsout;
     CycleCache cache;
 } VDecimateData;
 
+typedef struct {
+    VSNode *node;
+    int chroma;
+    int blockx;
+    int blocky;
+    int nxblocks;
+    int nyblocks;
+    int bdiffsize;
+    void (*blockDiffRow)(const void *a, const void *b, int width, int blockw, int64_t *bdiffs);
+} VDMetricsData;
+
 
 static const signed char DropUnknown = -1;
 #define MaxCycleLength 25
@@ -1117,8 +1155,15 @@ CycleInfo *getCycleFromCache(int cycleNum, CycleCache *cache, VDecimateData *vdm
     return cycle;
 }
 
-static int64_t calcMetric(const VSFrame *f1, const VSFrame *f2, int64_t *totdiff, VDecimateData *vdm, const VSAPI *vsapi) {
-    int64_t *bdiffs = vdm->bdiffs;
+void vdecimate_block_diff_row_byte_c(const void *a, const void *b, int width, int blockw, int64_t *bdiffs) {
+    vdecimate_block_diff_uint8_t(a, b, 0, width, blockw, bdiffs);
+}
+
+void vdecimate_block_diff_row_word_c(const void *a, const void *b, int width, int blockw, int64_t *bdiffs) {
+    vdecimate_block_diff_uint16_t(a, b, 0, width, blockw, bdiffs);
+}
+
+static int64_t calcMetric(const VSFrame *f1, const VSFrame *f2, int64_t *totdiff, int64_t *bdiffs, const VDMetricsData *vdm, const VSAPI *vsapi) {
     int numplanes = vdm->chroma ? 3 : 1;
     int64_t maxdiff = -1;
     memset(bdiffs, 0, vdm->bdiffsize * sizeof(int64_t));
@@ -1140,28 +1185,7 @@ static int64_t calcMetric(const VSFrame *f1, const VSFrame *f2, int64_t *totdiff
         }
 
         for (int y = 0; y < height; y++) {
-            int ydest = y / hblocky;
-            int xdest = 0;
-            // some slight code duplication to not put an if statement for 8/16 bit processing in the inner loop
-            if (fi->bitsPerSample == 8) {
-                for (int x = 0; x < width; x+= hblockx) {
-                    int acc = 0;
-                    int m = VSMIN(width, x + hblockx);
-                    for (int xl = x; xl < m; xl++)
-                        acc += abs(f1p[xl] - f2p[xl]);
-                    bdiffs[ydest * nxblocks + xdest] += acc;
-                    xdest++;
-                }
-            } else {
-                for (int x = 0; x < width; x+= hblockx) {
-                    int acc = 0;
-                    int m = VSMIN(width, x + hblockx);
-                    for (int xl = x; xl < m; xl++)
-                        acc += abs(((const uint16_t *)f1p)[xl] - ((const uint16_t *)f2p)[xl]);
-                    bdiffs[ydest * nxblocks + xdest] += acc;
-                    xdest++;
-                }
-            }
+            vdm->blockDiffRow(f1p, f2p, width, hblockx, bdiffs + (y / hblocky) * nxblocks);
             f1p += stride;
             f2p += stride;
         }
@@ -1181,25 +1205,63 @@ static int64_t calcMetric(const VSFrame *f1, const VSFrame *f2, int64_t *totdiff
     return maxdiff;
 }
 
-static int vdecimateLoadOVR(const char *ovrfile, signed char *drop, int cycle, int numFrames, char *err, size_t errlen) {
-    int line = 0;
-    char buf[80];
-    char* pos;
+static const VSFrame *VS_CC vdmetricsGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    VDMetricsData *d = (VDMetricsData *)instanceData;
+
+    if (activationReason == arInitial) {
+        if (n > 0)
+            vsapi->requestFrameFilter(n - 1, d->node, frameCtx);
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        const VSFrame *prv = vsapi->getFrameFilter(VSMAX(n - 1, 0), d->node, frameCtx);
+        const VSFrame *cur = vsapi->getFrameFilter(n, d->node, frameCtx);
+        int64_t *bdiffs = (int64_t *)malloc(d->bdiffsize * sizeof(int64_t));
+        int64_t totdiff;
+        int64_t maxbdiff = calcMetric(prv, cur, &totdiff, bdiffs, d, vsapi);
+        free(bdiffs);
+        vsapi->freeFrame(prv);
+
+        VSFrame *dst = vsapi->copyFrame(cur, core);
+        vsapi->freeFrame(cur);
+        VSMap *dstProps = vsapi->getFramePropertiesRW(dst);
+        vsapi->mapSetInt(dstProps, "VDecimateMaxBlockDiff", maxbdiff, maReplace);
+        vsapi->mapSetInt(dstProps, "VDecimateTotalDiff", totdiff, maReplace);
+        return dst;
+    }
+
+    return NULL;
+}
+
+static void VS_CC vdmetricsFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    VDMetricsData *d = (VDMetricsData *)instanceData;
+    vsapi->freeNode(d->node);
+    free(d);
+}
+
+static FILE *vdecimateOpenFile(const char *filename, int write) {
 #ifdef _WIN32
-    FILE* moo = NULL;
+    FILE* f = NULL;
     int len, ret;
-    wchar_t *ovrfile_wc;
-    len = MultiByteToWideChar(CP_UTF8, 0, ovrfile, -1, NULL, 0);
-    ovrfile_wc = malloc(len * sizeof(wchar_t));
-    if (ovrfile_wc) {
-        ret = MultiByteToWideChar(CP_UTF8, 0, ovrfile, -1, ovrfile_wc, len);
+    wchar_t *filename_wc;
+    len = MultiByteToWideChar(CP_UTF8, 0, filename, -1, NULL, 0);
+    filename_wc = malloc(len * sizeof(wchar_t));
+    if (filename_wc) {
+        ret = MultiByteToWideChar(CP_UTF8, 0, filename, -1, filename_wc, len);
         if (ret == len)
-            moo = _wfopen(ovrfile_wc, L"rb");
-        free(ovrfile_wc);
+            f = _wfopen(filename_wc, write ? L"wb" : L"rb");
+        free(filename_wc);
     }
+    return f;
 #else
-    FILE* moo = fopen(ovrfile, "r");
+    return fopen(filename, write ? "w" : "r");
 #endif
+}
+
+static int vdecimateLoadOVR(const char *ovrfile, signed char *drop, int cycle, int numFrames, char *err, size_t errlen) {
+    int line = 0;
+    char buf[80];
+    char* pos;
+    FILE* moo = vdecimateOpenFile(ovrfile, 0);
     if (!moo) {
         snprintf(err, errlen, "VDecimate: can't open ovr file");
         return 1;
@@ -1261,6 +1323,51 @@ static int vdecimateLoadOVR(const char *ovrfile, signed char *drop, int cycle, i
     return 0;
 }
 
+// Lines are "frame maxbdiff totdiff", the raw metrics of a frame against the previous one.
+static int vdecimateLoadMetrics(const char *metricsfile, VDInfo *metrics, int numFrames, char *err, size_t errlen) {
+    int line = 0;
+    char buf[80];
+    char* pos;
+    FILE* moo = vdecimateOpenFile(metricsfile, 0);
+    if (!moo) {
+        snprintf(err, errlen, "VDecimate: can't open metricsin file");
+        return 1;
+    }
+
+    memset(buf, 0, sizeof(buf));
+    while (fgets(buf, 80, moo)) {
+        int frame = -1;
+        int64_t maxbdiff = -1;
+        int64_t totdiff = -1;
+
+        line++;
+        pos = buf + strspn(buf, " \t\r\n");
+
+        if (pos[0] == '#' || pos[0] == 0)
+            continue;
+
+        if (sscanf(pos, " %d %" SCNd64 " %" SCNd64, &frame, &maxbdiff, &totdiff) != 3 ||
+            frame < 0 || frame >= numFrames || maxbdiff < -1 || totdiff < 0) {
+            snprintf(err, errlen, "VDecimate: Bad metrics at line %d in metricsin", line);
+            fclose(moo);
+            return 1;
+        }
+
+        metrics[frame].maxbdiff = maxbdiff;
+        metrics[frame].totdiff = totdiff;
+    }
+
+    fclose(moo);
+    return 0;
+}
+
+static void vdecimateSaveMetrics(FILE *f, const VDInfo *metrics, int numFrames) {
+    fprintf(f, "# VDecimate metrics: frame maxbdiff totdiff\n");
+    for (int i = 0; i < numFrames; i++)
+        if (metrics[i].totdiff != DropUnknown)
+            fprintf(f, "%d %" PRId64 " %" PRId64 "\n", i, metrics[i].maxbdiff, metrics[i].totdiff);
+}
+
 static inline int findOutputFrame(int requestedFrame, int cycleStart, int outCycle, int drop, int dryrun) {
     if (dryrun)
         return requestedFrame;
@@ -1364,14 +1471,12 @@ static const VSFrame *VS_CC vdecimateGetFrame(int n, int activationReason, void
             cycle->drop = vdm->drop[cyclestart / vdm->inCycle];
 
         if (cycle->drop == DropUnknown || (vdm->dryrun && cycle->metrics[0].totdiff == DropUnknown)) {
-            if (cyclestart > 0)
-                vsapi->requestFrameFilter(cyclestart - 1, vdm->node, frameCtx);
-
             for (int i = cyclestart; i < cycleend; i++) {
-                vsapi->requestFrameFilter(i, vdm->node, frameCtx);
-                
-                if (vdm->dryrun && vdm->clip2)
-                    vsapi->requestFrameFilter(i, vdm->clip2, frameCtx);
+                if (!vdm->frameMetrics || vdm->frameMetrics[i].totdiff == DropUnknown)
+                    vsapi->requestFrameFilter(i, vdm->metrics, frameCtx);
+
+                if (vdm->dryrun)
+                    vsapi->requestFrameFilter(i, vdm->clip2 ? vdm->clip2 : vdm->node, frameCtx);
             }
         }
 
@@ -1399,13 +1504,22 @@ static const VSFrame *VS_CC vdecimateGetFrame(int n, int activationReason, void
             cycle->drop = vdm->drop[cyclestart / vdm->inCycle];
 
         if (cycle->drop == DropUnknown || (vdm->dryrun && cycle->metrics[0].totdiff == DropUnknown)) {
-            // Calculate metrics
+            // Collect the metrics computed by the metrics stage
             for (int i = cyclestart; i < cycleend; i++) {
-                const VSFrame *prv = vsapi->getFrameFilter(VSMAX(i - 1, 0), vdm->node, frameCtx);
-                const VSFrame *cur = vsapi->getFrameFilter(i, vdm->node, frameCtx);
-                cycle->metrics[i - cyclestart].maxbdiff = calcMetric(prv, cur, &cycle->metrics[i - cyclestart].totdiff, vdm, vsapi);
-                vsapi->freeFrame(prv);
-                vsapi->freeFrame(cur);
+                VDInfo *metrics = &cycle->metrics[i - cyclestart];
+
+                if (vdm->frameMetrics && vdm->frameMetrics[i].totdiff != DropUnknown) {
+                    *metrics = vdm->frameMetrics[i];
+                } else {
+                    const VSFrame *frame = vsapi->getFrameFilter(i, vdm->metrics, frameCtx);
+                    const VSMap *frameProps = vsapi->getFramePropertiesRO(frame);
+                    metrics->maxbdiff = vsapi->mapGetInt(frameProps, "VDecimateMaxBlockDiff", 0, NULL);
+                    metrics->totdiff = vsapi->mapGetInt(frameProps, "VDecimateTotalDiff", 0, NULL);
+                    vsapi->freeFrame(frame);
+
+                    if (vdm->frameMetrics)
+                        vdm->frameMetrics[i] = *metrics;
+                }
             }
 
             // The first frame's metrics are always 0, thus it's always considered a duplicate.
@@ -1465,7 +1579,12 @@ static void VS_CC vdecimateFree(void *instanceData, VSCore *core, const VSAPI *v
     VDecimateData *vdm = (VDecimateData *)instanceData;
     vsapi->freeNode(vdm->node);
     vsapi->freeNode(vdm->clip2);
-    free(vdm->bdiffs);
+    vsapi->freeNode(vdm->metrics);
+    if (vdm->metricsout) {
+        vdecimateSaveMetrics(vdm->metricsout, vdm->frameMetrics, vdm->inputNumFrames);
+        fclose(vdm->metricsout);
+    }
+    free(vdm->frameMetrics);
     if (vdm->drop)
         free(vdm->drop);
     freeCache(&vdm->cache);
@@ -1558,10 +1677,26 @@ static void VS_CC createVDecimate(const VSMap *in, VSMap *out, void *userData, V
     vdm.scthresh = (int64_t)(((int64_t)max_value * vi->width * vi->height * scthresh)/100);
     vdm.dupthresh = (int64_t)((max_value * vdm.blockx * vdm.blocky * dupthresh)/100);
 
-    vdm.nxblocks = (vdm.vi.width + vdm.blockx/2 - 1)/(vdm.blockx/2);
-    vdm.nyblocks = (vdm.vi.height + vdm.blocky/2 - 1)/(vdm.blocky/2);
-    vdm.bdiffsize = vdm.nxblocks * vdm.nyblocks;
-    vdm.bdiffs = (int64_t *)malloc(vdm.bdiffsize * sizeof(int64_t));
+    const char *metricsin = vsapi->mapGetData(in, "metricsin", 0, &err);
+    const char *metricsout = vsapi->mapGetData(in, "metricsout", 0, &err);
+
+    if (metricsin || metricsout) {
+        vdm.frameMetrics = (VDInfo *)malloc(vdm.vi.numFrames * sizeof(VDInfo));
+        for (int i = 0; i < vdm.vi.numFrames; i++)
+            vdm.frameMetrics[i].maxbdiff = vdm.frameMetrics[i].totdiff = DropUnknown;
+    }
+
+    if (metricsin) {
+        char err2[80];
+
+        if (vdecimateLoadMetrics(metricsin, vdm.frameMetrics, vdm.vi.numFrames, err2, sizeof(err2))) {
+            free(vdm.frameMetrics);
+            vsapi->freeNode(vdm.node);
+            vsapi->freeNode(vdm.clip2);
+            vsapi->mapSetError(out, err2);
+            return;
+        }
+    }
 
     if (vdm.ovrfile) {
         vdm.drop = (signed char *)malloc(vdm.vi.numFrames / vdm.inCycle + 1);
@@ -1571,7 +1706,7 @@ static void VS_CC createVDecimate(const VSMap *in, VSMap *out, void *userData, V
 
         if (vdecimateLoadOVR(vdm.ovrfile, vdm.drop, vdm.inCycle, vdm.vi.numFrames, err2, sizeof(err2))) {
             free(vdm.drop);
-            free(vdm.bdiffs);
+            free(vdm.frameMetrics);
             vsapi->freeNode(vdm.node);
             vsapi->freeNode(vdm.clip2);
             vsapi->mapSetError(out, err2);
@@ -1594,13 +1729,44 @@ static void VS_CC createVDecimate(const VSMap *in, VSMap *out, void *userData, V
             vsh_muldivRational(&vdm.vi.fpsNum, &vdm.vi.fpsDen, vdm.outCycle, vdm.inCycle);
     }
 
+    if (metricsout) {
+        vdm.metricsout = vdecimateOpenFile(metricsout, 1);
+        if (!vdm.metricsout) {
+            free(vdm.drop);
+            free(vdm.frameMetrics);
+            vsapi->freeNode(vdm.node);
+            vsapi->freeNode(vdm.clip2);
+            vsapi->mapSetError(out, "VDecimate: can't open metricsout file");
+            return;
+        }
+    }
+
+    VDMetricsData *md = (VDMetricsData *)malloc(sizeof(VDMetricsData));
+    md->node = vsapi->addNodeRef(vdm.node);
+    md->chroma = vdm.chroma;
+    md->blockx = vdm.blockx;
+    md->blocky = vdm.blocky;
+    md->nxblocks = (vdm.vi.width + vdm.blockx/2 - 1)/(vdm.blockx/2);
+    md->nyblocks = (vdm.vi.height + vdm.blocky/2 - 1)/(vdm.blocky/2);
+    md->bdiffsize = md->nxblocks * md->nyblocks;
+    md->blockDiffRow = vi->format.bitsPerSample == 8 ? vdecimate_block_diff_row_byte_c : vdecimate_block_diff_row_word_c;
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2)
+        md->blockDiffRow = vi->format.bitsPerSample == 8 ? vdecimate_block_diff_row_byte_avx2 : vdecimate_block_diff_row_word_avx2;
+    else
+        md->blockDiffRow = vi->format.bitsPerSample == 8 ? vdecimate_block_diff_row_byte_sse2 : vdecimate_block_diff_row_word_sse2;
+#endif
+
+    VSFilterDependency metricsDeps[] = {{md->node, rpGeneral}};
+    vdm.metrics = vsapi->createVideoFilter2("VDecimateMetrics", vi, vdmetricsGetFrame, vdmetricsFree, fmParallel, metricsDeps, 1, md, core);
+
     initCache(&vdm.cache, &vdm);
 
     VDecimateData *d = (VDecimateData *)malloc(sizeof(vdm));
     *d = vdm;
 
-    VSFilterDependency deps[] = {{vdm.node, rpGeneral}, {vdm.clip2, rpGeneral}};
-    vsapi->createVideoFilter(out, "VDecimate", &d->vi, vdecimateGetFrame, vdecimateFree, fmUnordered, deps, vdm.clip2 ? 2 : 1, d, core);
+    VSFilterDependency deps[] = {{vdm.node, rpGeneral}, {vdm.metrics, rpGeneral}, {vdm.clip2, rpGeneral}};
+    vsapi->createVideoFilter(out, "VDecimate", &d->vi, vdecimateGetFrame, vdecimateFree, fmUnordered, deps, vdm.clip2 ? 3 : 2, d, core);
 }
 
 ///////////////////////////////////////
@@ -1639,6 +1805,8 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI
                              "clip2:vnode:opt;"
                              "ovr:data:opt;"
                              "dryrun:int:opt;"
+                             "metricsin:data:opt;"
+                             "metricsout:data:opt;"
                              , "clip:vnode;"
                              , createVDecimate, NULL, plugin);
 }
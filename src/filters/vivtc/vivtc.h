@@ -0,0 +1,201 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef VIVTC_H
+#define VIVTC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// abs(a[x] - b[x]) for n pixels.
+#define DECL_ABS_DIFF_ROW(isa) void vfm_abs_diff_row_##isa(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n);
+
+/*
+ * One row of the VFM difference map, dp points to a row of absolute field
+ * differences with tpitch between rows. Adds the map value of the pixels
+ * [1, width - 1) to dst. up2 and down2 tell whether the rows two above and
+ * two below may be read.
+ */
+#define DECL_DIFF_MAP_ROW(isa) void vfm_diff_map_row_##isa(const uint8_t *dp, ptrdiff_t tpitch, uint8_t *dst, int width, int up2, int down2);
+
+/*
+ * Combing mask of a row that has at least two rows above and below it,
+ * dst is set to 0xFF where the pixel is combed and 0 elsewhere.
+ */
+#define DECL_COMB_MASK_ROW(isa) void vfm_comb_mask_row_##isa(const uint8_t *srcp, ptrdiff_t stride, uint8_t *dst, int width, int cthresh);
+
+// Adds 1 to colsum[x] where all three mask rows are 0xFF.
+#define DECL_COMB_COUNT_ROW(isa) void vfm_comb_count_row_##isa(const uint8_t *pp, const uint8_t *p, const uint8_t *pn, uint16_t *colsum, int width);
+
+/*
+ * Field difference sums of n pixels for compareFieldsSlow. accum receives
+ * the p sums for the map bits 1, 2 and 4 followed by the same for n.
+ */
+#define DECL_FIELD_DIFF_ROW(isa) void vfm_field_diff_row_##isa(const uint8_t *curpf, const uint8_t *curf, const uint8_t *curnf, const uint8_t *prvpf, const uint8_t *prvnf, \
+                                                              const uint8_t *nxtpf, const uint8_t *nxtnf, const uint8_t *map0, const uint8_t *map1, int n, uint64_t accum[6]);
+
+/*
+ * Sums of absolute differences of one row for VDecimate. The row is split into
+ * blocks of blockw pixels, the sum of block i is added to bdiffs[i]. The last
+ * block may be narrower.
+ */
+#define DECL_BLOCK_DIFF_ROW(pixel, isa) void vdecimate_block_diff_row_##pixel##_##isa(const void *a, const void *b, int width, int blockw, int64_t *bdiffs);
+
+DECL_ABS_DIFF_ROW(c)
+DECL_DIFF_MAP_ROW(c)
+DECL_COMB_MASK_ROW(c)
+DECL_COMB_COUNT_ROW(c)
+DECL_FIELD_DIFF_ROW(c)
+DECL_BLOCK_DIFF_ROW(byte, c)
+DECL_BLOCK_DIFF_ROW(word, c)
+
+#ifdef VS_TARGET_CPU_X86
+DECL_ABS_DIFF_ROW(sse2)
+DECL_DIFF_MAP_ROW(sse2)
+DECL_COMB_MASK_ROW(sse2)
+DECL_COMB_COUNT_ROW(sse2)
+DECL_FIELD_DIFF_ROW(sse2)
+DECL_BLOCK_DIFF_ROW(byte, sse2)
+DECL_BLOCK_DIFF_ROW(word, sse2)
+
+DECL_ABS_DIFF_ROW(avx2)
+DECL_DIFF_MAP_ROW(avx2)
+DECL_COMB_MASK_ROW(avx2)
+DECL_COMB_COUNT_ROW(avx2)
+DECL_FIELD_DIFF_ROW(avx2)
+DECL_BLOCK_DIFF_ROW(byte, avx2)
+DECL_BLOCK_DIFF_ROW(word, avx2)
+#endif
+
+#undef DECL_BLOCK_DIFF_ROW
+#undef DECL_FIELD_DIFF_ROW
+#undef DECL_COMB_COUNT_ROW
+#undef DECL_COMB_MASK_ROW
+#undef DECL_DIFF_MAP_ROW
+#undef DECL_ABS_DIFF_ROW
+
+#ifdef VS_VIVTC_IMPL
+// Single pixel versions used for the edges the vector code can't do.
+static inline int vfm_diff_map_pixel(const uint8_t *dp, ptrdiff_t tpitch, int x, int width, int up2, int down2)
+{
+    const int diff = dp[x];
+    int ret = 0;
+    int u, count;
+
+    if (diff > 3) {
+        for (count=0,u=x-1; u<x+2 && count<2; ++u) {
+            if (dp[u-tpitch] > 3) ++count;
+            if (dp[u] > 3) ++count;
+            if (dp[u+tpitch] > 3) ++count;
+        }
+        if (count > 1) {
+            ++ret;
+            if (diff > 19) {
+                int upper = 0, lower = 0;
+                for (count=0, u=x-1; u<x+2 && count<6; ++u) {
+                    if (dp[u-tpitch] > 19) { ++count; upper = 1; }
+                    if (dp[u] > 19) ++count;
+                    if (dp[u+tpitch] > 19) { ++count; lower = 1; }
+                }
+                if (count > 3) {
+                    if (!upper || !lower) {
+                        int upper2 = 0, lower2 = 0;
+                        for (u=(x-4 > 0 ? x-4 : 0); u<(x+5 < width ? x+5 : width); ++u)
+                        {
+                            if (up2 && dp[u-2*tpitch] > 19)
+                                upper2 = 1;
+                            if (dp[u-tpitch] > 19)
+                                upper = 1;
+                            if (dp[u+tpitch] > 19)
+                                lower = 1;
+                            if (down2 && dp[u+2*tpitch] > 19)
+                                lower2 = 1;
+                        }
+                        if ((upper && (lower || upper2)) ||
+                            (lower && (upper || lower2)))
+                            ret += 2;
+                        else if (count > 5)
+                            ret += 4;
+                    }
+                    else ret += 2;
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+static inline int vfm_comb_pixel(const uint8_t *srcp, ptrdiff_t stride, int x, int cthresh)
+{
+    const int sFirst = srcp[x] - srcp[x - stride];
+    const int sSecond = srcp[x] - srcp[x + stride];
+    if ((sFirst > cthresh && sSecond > cthresh) || (sFirst < -cthresh && sSecond < -cthresh)) {
+        if (abs(srcp[x - 2*stride]+(srcp[x]*4)+srcp[x + 2*stride]-(3*(srcp[x - stride]+srcp[x + stride]))) > cthresh*6)
+            return 0xFF;
+    }
+    return 0;
+}
+
+static inline void vfm_field_diff_pixel(int curp, int cur, int curn, int prvp, int prvn, int nxtp, int nxtn, int m, uint64_t accum[6])
+{
+    const int temp1 = curp+(cur<<2)+curn;
+    int temp2 = abs(3*(prvp+prvn)-temp1);
+    if (temp2 > 23 && (m&1))
+        accum[0] += temp2;
+    if (temp2 > 42) {
+        if (m&2)
+            accum[1] += temp2;
+        if (m&4)
+            accum[2] += temp2;
+    }
+    temp2 = abs(3*(nxtp+nxtn)-temp1);
+    if (temp2 > 23 && (m&1))
+        accum[3] += temp2;
+    if (temp2 > 42) {
+        if (m&2)
+            accum[4] += temp2;
+        if (m&4)
+            accum[5] += temp2;
+    }
+}
+
+// Block sums from pixel x on, x must be the start of a block.
+#define VDECIMATE_BLOCK_DIFF(T) \
+static inline void vdecimate_block_diff_##T(const T *a, const T *b, int x, int width, int blockw, int64_t *bdiffs) \
+{ \
+    for (; x < width; x += blockw) { \
+        int acc = 0; \
+        int m = x + blockw < width ? x + blockw : width; \
+        int xl; \
+        for (xl = x; xl < m; xl++) \
+            acc += abs(a[xl] - b[xl]); \
+        bdiffs[x / blockw] += acc; \
+    } \
+}
+
+VDECIMATE_BLOCK_DIFF(uint8_t)
+VDECIMATE_BLOCK_DIFF(uint16_t)
+
+#undef VDECIMATE_BLOCK_DIFF
+#endif
+
+#endif // VIVTC_H
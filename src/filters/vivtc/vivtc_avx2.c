@@ -0,0 +1,291 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <immintrin.h>
+#define VS_VIVTC_IMPL
+#include "vivtc.h"
+#include "VSHelper4.h"
+
+#define LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define LOAD128(p) _mm_loadu_si128((const __m128i *)(p))
+
+// 0xFF where v <= k
+static __m256i le_epu8(__m256i v, __m256i k)
+{
+    return _mm256_cmpeq_epi8(_mm256_subs_epu8(v, k), _mm256_setzero_si256());
+}
+
+static __m256i mul3_epi16(__m256i v)
+{
+    return _mm256_add_epi16(v, _mm256_add_epi16(v, v));
+}
+
+static uint64_t hsum_epi32(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(s);
+}
+
+void vfm_abs_diff_row_avx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    int x;
+
+    for (x = 0; x + 32 <= n; x += 32) {
+        __m256i va = LOAD(a + x);
+        __m256i vb = LOAD(b + x);
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va)));
+    }
+    for (; x < n; x++)
+        dst[x] = abs(a[x] - b[x]);
+}
+
+void vfm_diff_map_row_avx2(const uint8_t *dp, ptrdiff_t tpitch, uint8_t *dst, int width, int up2, int down2)
+{
+    const __m256i k3 = _mm256_set1_epi8(3);
+    const __m256i k19 = _mm256_set1_epi8(19);
+    const __m256i ones = _mm256_set1_epi8(-1);
+    const uint8_t *dpp = dp - tpitch;
+    const uint8_t *dpn = dp + tpitch;
+    int x, i;
+
+    for (x = 1; x < VSMIN(4, width - 1); x++)
+        dst[x] += vfm_diff_map_pixel(dp, tpitch, x, width, up2, down2);
+
+    // the widest neighborhood is x - 4 to x + 4, the edges are left to the scalar code
+    for (; x + 36 <= width; x += 32) {
+        // counts are kept negated as sums of compare masks
+        __m256i le3sum = _mm256_setzero_si256();
+        __m256i le19sum = _mm256_setzero_si256();
+        // 0xFF while no pixel > 19 has been found
+        __m256i upNear = ones, loNear = ones;
+        __m256i upFar, loFar, up2Far = ones, lo2Far = ones;
+
+        for (i = -1; i <= 1; i++) {
+            __m256i a = LOAD(dpp + x + i);
+            __m256i b = LOAD(dp + x + i);
+            __m256i c = LOAD(dpn + x + i);
+            __m256i a19 = le_epu8(a, k19);
+            __m256i c19 = le_epu8(c, k19);
+            le3sum = _mm256_add_epi8(le3sum, _mm256_add_epi8(le_epu8(a, k3), _mm256_add_epi8(le_epu8(b, k3), le_epu8(c, k3))));
+            le19sum = _mm256_add_epi8(le19sum, _mm256_add_epi8(a19, _mm256_add_epi8(le_epu8(b, k19), c19)));
+            upNear = _mm256_and_si256(upNear, a19);
+            loNear = _mm256_and_si256(loNear, c19);
+        }
+
+        upFar = upNear;
+        loFar = loNear;
+        for (i = -4; i <= 4; i++) {
+            if (i >= -1 && i <= 1)
+                continue;
+            upFar = _mm256_and_si256(upFar, le_epu8(LOAD(dpp + x + i), k19));
+            loFar = _mm256_and_si256(loFar, le_epu8(LOAD(dpn + x + i), k19));
+        }
+        if (up2) {
+            for (i = -4; i <= 4; i++)
+                up2Far = _mm256_and_si256(up2Far, le_epu8(LOAD(dpp - tpitch + x + i), k19));
+        }
+        if (down2) {
+            for (i = -4; i <= 4; i++)
+                lo2Far = _mm256_and_si256(lo2Far, le_epu8(LOAD(dpn + tpitch + x + i), k19));
+        }
+
+        {
+            __m256i center = LOAD(dp + x);
+            // at least 2 of the 9 are > 3, more than 3 and more than 5 of the 9 are > 19
+            __m256i f1 = _mm256_andnot_si256(le_epu8(center, k3), _mm256_cmpgt_epi8(le3sum, _mm256_set1_epi8(-8)));
+            __m256i f19 = _mm256_and_si256(f1, _mm256_andnot_si256(le_epu8(center, k19), _mm256_cmpgt_epi8(le19sum, _mm256_set1_epi8(-6))));
+            __m256i many19 = _mm256_cmpgt_epi8(le19sum, _mm256_set1_epi8(-4));
+            __m256i both = _mm256_andnot_si256(_mm256_or_si256(upNear, loNear), ones);
+            __m256i up = _mm256_andnot_si256(upFar, ones);
+            __m256i lo = _mm256_andnot_si256(loFar, ones);
+            __m256i cond = _mm256_or_si256(_mm256_and_si256(up, _mm256_andnot_si256(_mm256_and_si256(loFar, up2Far), ones)),
+                                           _mm256_and_si256(lo, _mm256_andnot_si256(_mm256_and_si256(upFar, lo2Far), ones)));
+            __m256i add2 = _mm256_and_si256(f19, _mm256_or_si256(both, cond));
+            __m256i add4 = _mm256_andnot_si256(_mm256_or_si256(both, cond), _mm256_and_si256(f19, many19));
+            __m256i inc = _mm256_or_si256(_mm256_and_si256(f1, _mm256_set1_epi8(1)),
+                                          _mm256_or_si256(_mm256_and_si256(add2, _mm256_set1_epi8(2)), _mm256_and_si256(add4, _mm256_set1_epi8(4))));
+            _mm256_storeu_si256((__m256i *)(dst + x), _mm256_add_epi8(LOAD(dst + x), inc));
+        }
+    }
+
+    for (; x < width - 1; x++)
+        dst[x] += vfm_diff_map_pixel(dp, tpitch, x, width, up2, down2);
+}
+
+static __m256i comb_epi16(const uint8_t *srcp, ptrdiff_t stride, __m256i t, __m256i nt, __m256i t6)
+{
+    __m256i p2 = _mm256_cvtepu8_epi16(LOAD128(srcp - 2 * stride));
+    __m256i p1 = _mm256_cvtepu8_epi16(LOAD128(srcp - stride));
+    __m256i c = _mm256_cvtepu8_epi16(LOAD128(srcp));
+    __m256i n1 = _mm256_cvtepu8_epi16(LOAD128(srcp + stride));
+    __m256i n2 = _mm256_cvtepu8_epi16(LOAD128(srcp + 2 * stride));
+    __m256i sFirst = _mm256_sub_epi16(c, p1);
+    __m256i sSecond = _mm256_sub_epi16(c, n1);
+    __m256i pos = _mm256_and_si256(_mm256_cmpgt_epi16(sFirst, t), _mm256_cmpgt_epi16(sSecond, t));
+    __m256i neg = _mm256_and_si256(_mm256_cmpgt_epi16(nt, sFirst), _mm256_cmpgt_epi16(nt, sSecond));
+    __m256i v = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(p2, n2), _mm256_slli_epi16(c, 2)), mul3_epi16(_mm256_add_epi16(p1, n1)));
+    return _mm256_and_si256(_mm256_or_si256(pos, neg), _mm256_cmpgt_epi16(_mm256_abs_epi16(v), t6));
+}
+
+void vfm_comb_mask_row_avx2(const uint8_t *srcp, ptrdiff_t stride, uint8_t *dst, int width, int cthresh)
+{
+    const __m256i t = _mm256_set1_epi16(cthresh);
+    const __m256i nt = _mm256_set1_epi16(-cthresh);
+    const __m256i t6 = _mm256_set1_epi16(cthresh * 6);
+    int x;
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        __m256i lo = comb_epi16(srcp + x, stride, t, nt, t6);
+        __m256i hi = comb_epi16(srcp + x + 16, stride, t, nt, t6);
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    for (; x < width; x++)
+        dst[x] = vfm_comb_pixel(srcp, stride, x, cthresh);
+}
+
+void vfm_comb_count_row_avx2(const uint8_t *pp, const uint8_t *p, const uint8_t *pn, uint16_t *colsum, int width)
+{
+    const __m256i ones = _mm256_set1_epi8(-1);
+    int x;
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        __m256i m = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_and_si256(LOAD(pp + x), LOAD(p + x)), LOAD(pn + x)), ones);
+        _mm256_storeu_si256((__m256i *)(colsum + x), _mm256_sub_epi16(LOAD(colsum + x), _mm256_cvtepi8_epi16(_mm256_castsi256_si128(m))));
+        _mm256_storeu_si256((__m256i *)(colsum + x + 16), _mm256_sub_epi16(LOAD(colsum + x + 16), _mm256_cvtepi8_epi16(_mm256_extracti128_si256(m, 1))));
+    }
+    for (; x < width; x++)
+        colsum[x] += (pp[x] == 0xFF && p[x] == 0xFF && pn[x] == 0xFF);
+}
+
+void vfm_field_diff_row_avx2(const uint8_t *curpf, const uint8_t *curf, const uint8_t *curnf, const uint8_t *prvpf, const uint8_t *prvnf,
+                             const uint8_t *nxtpf, const uint8_t *nxtnf, const uint8_t *map0, const uint8_t *map1, int n, uint64_t accum[6])
+{
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i two = _mm256_set1_epi16(2);
+    const __m256i four = _mm256_set1_epi16(4);
+    const __m256i t23 = _mm256_set1_epi16(23);
+    const __m256i t42 = _mm256_set1_epi16(42);
+    __m256i acc[6];
+    int x, i;
+
+    for (i = 0; i < 6; i++)
+        acc[i] = _mm256_setzero_si256();
+
+    for (x = 0; x + 16 <= n; x += 16) {
+        __m256i m = _mm256_cvtepu8_epi16(_mm_or_si128(LOAD128(map0 + x), LOAD128(map1 + x)));
+        __m256i b1 = _mm256_cmpeq_epi16(_mm256_and_si256(m, one), one);
+        __m256i b2 = _mm256_cmpeq_epi16(_mm256_and_si256(m, two), two);
+        __m256i b4 = _mm256_cmpeq_epi16(_mm256_and_si256(m, four), four);
+        __m256i temp1 = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(LOAD128(curpf + x)), _mm256_cvtepu8_epi16(LOAD128(curnf + x))),
+                                         _mm256_slli_epi16(_mm256_cvtepu8_epi16(LOAD128(curf + x)), 2));
+        __m256i tp = _mm256_abs_epi16(_mm256_sub_epi16(mul3_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(LOAD128(prvpf + x)), _mm256_cvtepu8_epi16(LOAD128(prvnf + x)))), temp1));
+        __m256i tn = _mm256_abs_epi16(_mm256_sub_epi16(mul3_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(LOAD128(nxtpf + x)), _mm256_cvtepu8_epi16(LOAD128(nxtnf + x)))), temp1));
+        __m256i p23 = _mm256_and_si256(tp, _mm256_cmpgt_epi16(tp, t23));
+        __m256i p42 = _mm256_and_si256(tp, _mm256_cmpgt_epi16(tp, t42));
+        __m256i n23 = _mm256_and_si256(tn, _mm256_cmpgt_epi16(tn, t23));
+        __m256i n42 = _mm256_and_si256(tn, _mm256_cmpgt_epi16(tn, t42));
+
+        acc[0] = _mm256_add_epi32(acc[0], _mm256_madd_epi16(_mm256_and_si256(p23, b1), one));
+        acc[1] = _mm256_add_epi32(acc[1], _mm256_madd_epi16(_mm256_and_si256(p42, b2), one));
+        acc[2] = _mm256_add_epi32(acc[2], _mm256_madd_epi16(_mm256_and_si256(p42, b4), one));
+        acc[3] = _mm256_add_epi32(acc[3], _mm256_madd_epi16(_mm256_and_si256(n23, b1), one));
+        acc[4] = _mm256_add_epi32(acc[4], _mm256_madd_epi16(_mm256_and_si256(n42, b2), one));
+        acc[5] = _mm256_add_epi32(acc[5], _mm256_madd_epi16(_mm256_and_si256(n42, b4), one));
+    }
+
+    for (i = 0; i < 6; i++)
+        accum[i] += hsum_epi32(acc[i]);
+
+    for (; x < n; x++)
+        vfm_field_diff_pixel(curpf[x], curf[x], curnf[x], prvpf[x], prvnf[x], nxtpf[x], nxtnf[x], map0[x] | map1[x], accum);
+}
+
+static __m256i sad_epu16(__m256i a, __m256i b)
+{
+    __m256i d = _mm256_or_si256(_mm256_subs_epu16(a, b), _mm256_subs_epu16(b, a));
+    return _mm256_add_epi32(_mm256_srli_epi32(d, 16), _mm256_and_si256(d, _mm256_set1_epi32(0xFFFF)));
+}
+
+void vdecimate_block_diff_row_byte_avx2(const void *a, const void *b, int width, int blockw, int64_t *bdiffs)
+{
+    const uint8_t *ap = a, *bp = b;
+    int x = 0;
+
+    if (blockw % 32 == 0) {
+        for (; x + blockw <= width; x += blockw) {
+            __m256i acc = _mm256_setzero_si256();
+            __m128i s;
+            int xl;
+
+            for (xl = x; xl < x + blockw; xl += 32)
+                acc = _mm256_add_epi64(acc, _mm256_sad_epu8(LOAD(ap + xl), LOAD(bp + xl)));
+            s = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            bdiffs[x / blockw] += _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+        }
+    } else if (blockw == 16) {
+        for (; x + 32 <= width; x += 32) {
+            __m256i sad = _mm256_sad_epu8(LOAD(ap + x), LOAD(bp + x));
+            sad = _mm256_add_epi64(sad, _mm256_srli_si256(sad, 8));
+            bdiffs[x / 16] += _mm256_cvtsi256_si32(sad);
+            bdiffs[x / 16 + 1] += _mm_cvtsi128_si32(_mm256_extracti128_si256(sad, 1));
+        }
+    } else if (blockw == 8) {
+        for (; x + 32 <= width; x += 32) {
+            __m256i sad = _mm256_sad_epu8(LOAD(ap + x), LOAD(bp + x));
+            __m128i lo = _mm256_castsi256_si128(sad), hi = _mm256_extracti128_si256(sad, 1);
+            bdiffs[x / 8] += _mm_cvtsi128_si32(lo);
+            bdiffs[x / 8 + 1] += _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+            bdiffs[x / 8 + 2] += _mm_cvtsi128_si32(hi);
+            bdiffs[x / 8 + 3] += _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+        }
+    }
+
+    vdecimate_block_diff_uint8_t(ap, bp, x, width, blockw, bdiffs);
+}
+
+void vdecimate_block_diff_row_word_avx2(const void *a, const void *b, int width, int blockw, int64_t *bdiffs)
+{
+    const uint16_t *ap = a, *bp = b;
+    int x = 0;
+
+    if (blockw % 16 == 0) {
+        for (; x + blockw <= width; x += blockw) {
+            __m256i acc = _mm256_setzero_si256();
+            int xl;
+
+            for (xl = x; xl < x + blockw; xl += 16)
+                acc = _mm256_add_epi32(acc, sad_epu16(LOAD(ap + xl), LOAD(bp + xl)));
+            bdiffs[x / blockw] += hsum_epi32(acc);
+        }
+    } else if (blockw == 8) {
+        for (; x + 16 <= width; x += 16) {
+            __m256i sad = sad_epu16(LOAD(ap + x), LOAD(bp + x));
+            __m128i lo = _mm256_castsi256_si128(sad), hi = _mm256_extracti128_si256(sad, 1);
+            lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+            hi = _mm_add_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+            bdiffs[x / 8] += (uint32_t)_mm_cvtsi128_si32(_mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1))));
+            bdiffs[x / 8 + 1] += (uint32_t)_mm_cvtsi128_si32(_mm_add_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1))));
+        }
+    }
+
+    vdecimate_block_diff_uint16_t(ap, bp, x, width, blockw, bdiffs);
+}
@@ -0,0 +1,290 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <emmintrin.h>
+#define VS_VIVTC_IMPL
+#include "vivtc.h"
+#include "VSHelper4.h"
+
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+
+// 0xFF where v <= k
+static __m128i le_epu8(__m128i v, __m128i k)
+{
+    return _mm_cmpeq_epi8(_mm_subs_epu8(v, k), _mm_setzero_si128());
+}
+
+static __m128i abs_epi16(__m128i v)
+{
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+static __m128i mul3_epi16(__m128i v)
+{
+    return _mm_add_epi16(v, _mm_add_epi16(v, v));
+}
+
+static uint64_t hsum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+void vfm_abs_diff_row_sse2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    int x;
+
+    for (x = 0; x + 16 <= n; x += 16) {
+        __m128i va = LOAD(a + x);
+        __m128i vb = LOAD(b + x);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)));
+    }
+    for (; x < n; x++)
+        dst[x] = abs(a[x] - b[x]);
+}
+
+void vfm_diff_map_row_sse2(const uint8_t *dp, ptrdiff_t tpitch, uint8_t *dst, int width, int up2, int down2)
+{
+    const __m128i k3 = _mm_set1_epi8(3);
+    const __m128i k19 = _mm_set1_epi8(19);
+    const __m128i ones = _mm_set1_epi8(-1);
+    const uint8_t *dpp = dp - tpitch;
+    const uint8_t *dpn = dp + tpitch;
+    int x, i;
+
+    for (x = 1; x < VSMIN(4, width - 1); x++)
+        dst[x] += vfm_diff_map_pixel(dp, tpitch, x, width, up2, down2);
+
+    // the widest neighborhood is x - 4 to x + 4, the edges are left to the scalar code
+    for (; x + 20 <= width; x += 16) {
+        // counts are kept negated as sums of compare masks
+        __m128i le3sum = _mm_setzero_si128();
+        __m128i le19sum = _mm_setzero_si128();
+        // 0xFF while no pixel > 19 has been found
+        __m128i upNear = ones, loNear = ones;
+        __m128i upFar, loFar, up2Far = ones, lo2Far = ones;
+
+        for (i = -1; i <= 1; i++) {
+            __m128i a = LOAD(dpp + x + i);
+            __m128i b = LOAD(dp + x + i);
+            __m128i c = LOAD(dpn + x + i);
+            __m128i a19 = le_epu8(a, k19);
+            __m128i c19 = le_epu8(c, k19);
+            le3sum = _mm_add_epi8(le3sum, _mm_add_epi8(le_epu8(a, k3), _mm_add_epi8(le_epu8(b, k3), le_epu8(c, k3))));
+            le19sum = _mm_add_epi8(le19sum, _mm_add_epi8(a19, _mm_add_epi8(le_epu8(b, k19), c19)));
+            upNear = _mm_and_si128(upNear, a19);
+            loNear = _mm_and_si128(loNear, c19);
+        }
+
+        upFar = upNear;
+        loFar = loNear;
+        for (i = -4; i <= 4; i++) {
+            if (i >= -1 && i <= 1)
+                continue;
+            upFar = _mm_and_si128(upFar, le_epu8(LOAD(dpp + x + i), k19));
+            loFar = _mm_and_si128(loFar, le_epu8(LOAD(dpn + x + i), k19));
+        }
+        if (up2) {
+            for (i = -4; i <= 4; i++)
+                up2Far = _mm_and_si128(up2Far, le_epu8(LOAD(dpp - tpitch + x + i), k19));
+        }
+        if (down2) {
+            for (i = -4; i <= 4; i++)
+                lo2Far = _mm_and_si128(lo2Far, le_epu8(LOAD(dpn + tpitch + x + i), k19));
+        }
+
+        {
+            __m128i center = LOAD(dp + x);
+            // at least 2 of the 9 are > 3, more than 3 and more than 5 of the 9 are > 19
+            __m128i f1 = _mm_andnot_si128(le_epu8(center, k3), _mm_cmpgt_epi8(le3sum, _mm_set1_epi8(-8)));
+            __m128i f19 = _mm_and_si128(f1, _mm_andnot_si128(le_epu8(center, k19), _mm_cmpgt_epi8(le19sum, _mm_set1_epi8(-6))));
+            __m128i many19 = _mm_cmpgt_epi8(le19sum, _mm_set1_epi8(-4));
+            __m128i both = _mm_andnot_si128(_mm_or_si128(upNear, loNear), ones);
+            __m128i up = _mm_andnot_si128(upFar, ones);
+            __m128i lo = _mm_andnot_si128(loFar, ones);
+            __m128i cond = _mm_or_si128(_mm_and_si128(up, _mm_andnot_si128(_mm_and_si128(loFar, up2Far), ones)),
+                                        _mm_and_si128(lo, _mm_andnot_si128(_mm_and_si128(upFar, lo2Far), ones)));
+            __m128i add2 = _mm_and_si128(f19, _mm_or_si128(both, cond));
+            __m128i add4 = _mm_andnot_si128(_mm_or_si128(both, cond), _mm_and_si128(f19, many19));
+            __m128i inc = _mm_or_si128(_mm_and_si128(f1, _mm_set1_epi8(1)),
+                                       _mm_or_si128(_mm_and_si128(add2, _mm_set1_epi8(2)), _mm_and_si128(add4, _mm_set1_epi8(4))));
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_add_epi8(LOAD(dst + x), inc));
+        }
+    }
+
+    for (; x < width - 1; x++)
+        dst[x] += vfm_diff_map_pixel(dp, tpitch, x, width, up2, down2);
+}
+
+static __m128i comb_epi16(__m128i p2, __m128i p1, __m128i c, __m128i n1, __m128i n2, __m128i t, __m128i nt, __m128i t6)
+{
+    __m128i sFirst = _mm_sub_epi16(c, p1);
+    __m128i sSecond = _mm_sub_epi16(c, n1);
+    __m128i pos = _mm_and_si128(_mm_cmpgt_epi16(sFirst, t), _mm_cmpgt_epi16(sSecond, t));
+    __m128i neg = _mm_and_si128(_mm_cmpgt_epi16(nt, sFirst), _mm_cmpgt_epi16(nt, sSecond));
+    __m128i v = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(p2, n2), _mm_slli_epi16(c, 2)), mul3_epi16(_mm_add_epi16(p1, n1)));
+    return _mm_and_si128(_mm_or_si128(pos, neg), _mm_cmpgt_epi16(abs_epi16(v), t6));
+}
+
+void vfm_comb_mask_row_sse2(const uint8_t *srcp, ptrdiff_t stride, uint8_t *dst, int width, int cthresh)
+{
+    const __m128i t = _mm_set1_epi16(cthresh);
+    const __m128i nt = _mm_set1_epi16(-cthresh);
+    const __m128i t6 = _mm_set1_epi16(cthresh * 6);
+    const __m128i zero = _mm_setzero_si128();
+    int x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        __m128i p2 = LOAD(srcp + x - 2 * stride);
+        __m128i p1 = LOAD(srcp + x - stride);
+        __m128i c = LOAD(srcp + x);
+        __m128i n1 = LOAD(srcp + x + stride);
+        __m128i n2 = LOAD(srcp + x + 2 * stride);
+        __m128i lo = comb_epi16(_mm_unpacklo_epi8(p2, zero), _mm_unpacklo_epi8(p1, zero), _mm_unpacklo_epi8(c, zero),
+                                _mm_unpacklo_epi8(n1, zero), _mm_unpacklo_epi8(n2, zero), t, nt, t6);
+        __m128i hi = comb_epi16(_mm_unpackhi_epi8(p2, zero), _mm_unpackhi_epi8(p1, zero), _mm_unpackhi_epi8(c, zero),
+                                _mm_unpackhi_epi8(n1, zero), _mm_unpackhi_epi8(n2, zero), t, nt, t6);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packs_epi16(lo, hi));
+    }
+    for (; x < width; x++)
+        dst[x] = vfm_comb_pixel(srcp, stride, x, cthresh);
+}
+
+void vfm_comb_count_row_sse2(const uint8_t *pp, const uint8_t *p, const uint8_t *pn, uint16_t *colsum, int width)
+{
+    const __m128i ones = _mm_set1_epi8(-1);
+    int x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        __m128i m = _mm_cmpeq_epi8(_mm_and_si128(_mm_and_si128(LOAD(pp + x), LOAD(p + x)), LOAD(pn + x)), ones);
+        _mm_storeu_si128((__m128i *)(colsum + x), _mm_sub_epi16(LOAD(colsum + x), _mm_unpacklo_epi8(m, m)));
+        _mm_storeu_si128((__m128i *)(colsum + x + 8), _mm_sub_epi16(LOAD(colsum + x + 8), _mm_unpackhi_epi8(m, m)));
+    }
+    for (; x < width; x++)
+        colsum[x] += (pp[x] == 0xFF && p[x] == 0xFF && pn[x] == 0xFF);
+}
+
+static void field_diff_epi16(__m128i curp, __m128i cur, __m128i curn, __m128i prvp, __m128i prvn, __m128i nxtp, __m128i nxtn, __m128i m, __m128i acc[6])
+{
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i four = _mm_set1_epi16(4);
+    const __m128i t23 = _mm_set1_epi16(23);
+    const __m128i t42 = _mm_set1_epi16(42);
+    __m128i b1 = _mm_cmpeq_epi16(_mm_and_si128(m, one), one);
+    __m128i b2 = _mm_cmpeq_epi16(_mm_and_si128(m, two), two);
+    __m128i b4 = _mm_cmpeq_epi16(_mm_and_si128(m, four), four);
+    __m128i temp1 = _mm_add_epi16(_mm_add_epi16(curp, curn), _mm_slli_epi16(cur, 2));
+    __m128i tp = abs_epi16(_mm_sub_epi16(mul3_epi16(_mm_add_epi16(prvp, prvn)), temp1));
+    __m128i tn = abs_epi16(_mm_sub_epi16(mul3_epi16(_mm_add_epi16(nxtp, nxtn)), temp1));
+    __m128i p23 = _mm_and_si128(tp, _mm_cmpgt_epi16(tp, t23));
+    __m128i p42 = _mm_and_si128(tp, _mm_cmpgt_epi16(tp, t42));
+    __m128i n23 = _mm_and_si128(tn, _mm_cmpgt_epi16(tn, t23));
+    __m128i n42 = _mm_and_si128(tn, _mm_cmpgt_epi16(tn, t42));
+
+    acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(_mm_and_si128(p23, b1), one));
+    acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(_mm_and_si128(p42, b2), one));
+    acc[2] = _mm_add_epi32(acc[2], _mm_madd_epi16(_mm_and_si128(p42, b4), one));
+    acc[3] = _mm_add_epi32(acc[3], _mm_madd_epi16(_mm_and_si128(n23, b1), one));
+    acc[4] = _mm_add_epi32(acc[4], _mm_madd_epi16(_mm_and_si128(n42, b2), one));
+    acc[5] = _mm_add_epi32(acc[5], _mm_madd_epi16(_mm_and_si128(n42, b4), one));
+}
+
+void vfm_field_diff_row_sse2(const uint8_t *curpf, const uint8_t *curf, const uint8_t *curnf, const uint8_t *prvpf, const uint8_t *prvnf,
+                             const uint8_t *nxtpf, const uint8_t *nxtnf, const uint8_t *map0, const uint8_t *map1, int n, uint64_t accum[6])
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc[6];
+    int x, i;
+
+    for (i = 0; i < 6; i++)
+        acc[i] = _mm_setzero_si128();
+
+    for (x = 0; x + 16 <= n; x += 16) {
+        __m128i curp = LOAD(curpf + x), cur = LOAD(curf + x), curn = LOAD(curnf + x);
+        __m128i prvp = LOAD(prvpf + x), prvn = LOAD(prvnf + x);
+        __m128i nxtp = LOAD(nxtpf + x), nxtn = LOAD(nxtnf + x);
+        __m128i m = _mm_or_si128(LOAD(map0 + x), LOAD(map1 + x));
+
+        field_diff_epi16(_mm_unpacklo_epi8(curp, zero), _mm_unpacklo_epi8(cur, zero), _mm_unpacklo_epi8(curn, zero),
+                         _mm_unpacklo_epi8(prvp, zero), _mm_unpacklo_epi8(prvn, zero),
+                         _mm_unpacklo_epi8(nxtp, zero), _mm_unpacklo_epi8(nxtn, zero), _mm_unpacklo_epi8(m, zero), acc);
+        field_diff_epi16(_mm_unpackhi_epi8(curp, zero), _mm_unpackhi_epi8(cur, zero), _mm_unpackhi_epi8(curn, zero),
+                         _mm_unpackhi_epi8(prvp, zero), _mm_unpackhi_epi8(prvn, zero),
+                         _mm_unpackhi_epi8(nxtp, zero), _mm_unpackhi_epi8(nxtn, zero), _mm_unpackhi_epi8(m, zero), acc);
+    }
+
+    for (i = 0; i < 6; i++)
+        accum[i] += hsum_epi32(acc[i]);
+
+    for (; x < n; x++)
+        vfm_field_diff_pixel(curpf[x], curf[x], curnf[x], prvpf[x], prvnf[x], nxtpf[x], nxtnf[x], map0[x] | map1[x], accum);
+}
+
+static __m128i sad_epu16(__m128i a, __m128i b)
+{
+    __m128i d = _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+    return _mm_add_epi32(_mm_srli_epi32(d, 16), _mm_and_si128(d, _mm_set1_epi32(0xFFFF)));
+}
+
+void vdecimate_block_diff_row_byte_sse2(const void *a, const void *b, int width, int blockw, int64_t *bdiffs)
+{
+    const uint8_t *ap = a, *bp = b;
+    int x = 0;
+
+    if (blockw % 16 == 0) {
+        for (; x + blockw <= width; x += blockw) {
+            __m128i acc = _mm_setzero_si128();
+            int xl;
+
+            for (xl = x; xl < x + blockw; xl += 16)
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(LOAD(ap + xl), LOAD(bp + xl)));
+            bdiffs[x / blockw] += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+        }
+    } else if (blockw == 8) {
+        for (; x + 16 <= width; x += 16) {
+            __m128i sad = _mm_sad_epu8(LOAD(ap + x), LOAD(bp + x));
+            bdiffs[x / 8] += _mm_cvtsi128_si32(sad);
+            bdiffs[x / 8 + 1] += _mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+        }
+    }
+
+    vdecimate_block_diff_uint8_t(ap, bp, x, width, blockw, bdiffs);
+}
+
+void vdecimate_block_diff_row_word_sse2(const void *a, const void *b, int width, int blockw, int64_t *bdiffs)
+{
+    const uint16_t *ap = a, *bp = b;
+    int x = 0;
+
+    if (blockw % 8 == 0) {
+        for (; x + blockw <= width; x += blockw) {
+            __m128i acc = _mm_setzero_si128();
+            int xl;
+
+            for (xl = x; xl < x + blockw; xl += 8)
+                acc = _mm_add_epi32(acc, sad_epu16(LOAD(ap + xl), LOAD(bp + xl)));
+            bdiffs[x / blockw] += hsum_epi32(acc);
+        }
+    }
+
+    vdecimate_block_diff_uint16_t(ap, bp, x, width, blockw, bdiffs);
+}
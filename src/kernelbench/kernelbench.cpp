@@ -0,0 +1,555 @@
+/*
+* Copyright (c) 2012-2021 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+// Times the plane kernels in src/core/kernel for every instruction set the cpu
+// supports and the Expr compilers through the public API. It's only meant for
+// comparing kernels with each other and between builds so it's never installed.
+//
+// Usage: kernelbench [--quick] [substring...]
+// Only benchmarks whose name contains one of the substrings are run.
+
+#include "VapourSynth4.h"
+#include "VSHelper4.h"
+#include "../core/cpufeatures.h"
+#include "../core/kernel/generic.h"
+#include "../core/kernel/merge.h"
+#include "../core/kernel/planestats.h"
+#include "../core/kernel/transpose.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef VS_TARGET_CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace {
+
+enum PixelType { ptByte, ptWord, ptFloat };
+enum Isa { isaC, isaSSE2, isaAVX2, isaAVX512, isaNEON };
+
+const char *const isaNames[] = { "c", "sse2", "avx2", "avx512", "neon" };
+
+struct Resolution {
+    const char *name;
+    unsigned width;
+    unsigned height;
+};
+
+struct Depth {
+    PixelType type;
+    unsigned bits;
+
+    unsigned bytesPerSample() const { return type == ptByte ? 1 : type == ptWord ? 2 : 4; }
+};
+
+// the dci sizes give strides that are multiples of 4096 bytes at 8 and 16 bits, compare them with and without --pad-strides
+const Resolution resolutions[] = { { "480p", 720, 480 }, { "1080p", 1920, 1080 }, { "2160p", 3840, 2160 }, { "2k", 2048, 1080 }, { "4k", 4096, 2160 } };
+const Depth depths[] = { { ptByte, 8 }, { ptWord, 10 }, { ptWord, 16 }, { ptFloat, 32 } };
+
+bool isaSupported(Isa isa) {
+#if defined(VS_TARGET_CPU_X86)
+    const CPUFeatures *f = getCPUFeatures();
+    if (isa == isaAVX2)
+        return f->avx2;
+    if (isa == isaAVX512)
+        return f->avx512_f && f->avx512_bw && f->avx512_dq;
+    return isa == isaC || isa == isaSSE2;
+#elif defined(VS_TARGET_CPU_ARM_NEON)
+    return isa == isaC || isa == isaNEON;
+#else
+    return isa == isaC;
+#endif
+}
+
+uint64_t readCycles() {
+#ifdef VS_TARGET_CPU_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct AlignedDeleter {
+    void operator()(uint8_t *p) const { vsh::vsh_aligned_free(p); }
+};
+
+// set by --pad-strides, uses the same stride policy as ccfPadStrides
+bool padStrides = false;
+
+ptrdiff_t planeStride(unsigned rowSize) {
+    ptrdiff_t stride = (rowSize + 63) & ~63;
+    if (padStrides && !(stride % 4096))
+        stride += 64;
+    return stride;
+}
+
+struct Plane {
+    std::unique_ptr<uint8_t[], AlignedDeleter> data;
+    ptrdiff_t stride;
+
+    Plane(unsigned width, unsigned height, unsigned bytesPerSample) : stride(planeStride(width * bytesPerSample)) {
+        data.reset(static_cast<uint8_t *>(vsh::vsh_aligned_malloc(stride * height, 64)));
+        memset(data.get(), 0, stride * height);
+    }
+
+    uint8_t *row(unsigned y) const { return data.get() + y * stride; }
+};
+
+// All planes a kernel may touch, allocated once per resolution and depth
+struct Frame {
+    unsigned width;
+    unsigned height;
+    Depth depth;
+    std::vector<Plane> src;
+    Plane dst;
+    Plane dstT;
+
+    Frame(unsigned width, unsigned height, Depth depth) : width(width), height(height), depth(depth), dst(width, height, depth.bytesPerSample()), dstT(height, width, depth.bytesPerSample()) {
+        std::mt19937 gen(1234);
+        for (int i = 0; i < 3; i++) {
+            src.emplace_back(width, height, depth.bytesPerSample());
+            for (unsigned y = 0; y < height; y++) {
+                uint8_t *row = src.back().row(y);
+                for (unsigned x = 0; x < width; x++) {
+                    uint32_t v = gen();
+                    if (depth.type == ptByte)
+                        row[x] = static_cast<uint8_t>(v);
+                    else if (depth.type == ptWord)
+                        reinterpret_cast<uint16_t *>(row)[x] = static_cast<uint16_t>(v & ((1U << depth.bits) - 1));
+                    else
+                        reinterpret_cast<float *>(row)[x] = (v >> 8) / static_cast<float>(1 << 24);
+                }
+            }
+        }
+    }
+};
+
+struct Benchmark {
+    std::string name;
+    Isa isa;
+    // planes read and written per call, used for the bandwidth figure
+    unsigned planesTouched;
+    // returns false when there's no version of the kernel for the pixel type
+    std::function<bool(Frame &)> run;
+};
+
+template<typename F>
+F pick(const Depth &depth, F byteFunc, F wordFunc, F floatFunc) {
+    return depth.type == ptByte ? byteFunc : depth.type == ptWord ? wordFunc : floatFunc;
+}
+
+vs_generic_params makeGenericParams(const Depth &depth, unsigned matrixsize) {
+    vs_generic_params params = {};
+    params.maxval = depth.type == ptFloat ? 0 : static_cast<uint16_t>((1U << depth.bits) - 1);
+    params.scale = 1.0f;
+    params.threshold = params.maxval;
+    params.thresholdf = INFINITY;
+    params.stencil = 0xFF;
+    params.matrixsize = matrixsize;
+    for (int i = 0; i < 25; i++) {
+        params.matrix[i] = 1;
+        params.matrixf[i] = 1.0f;
+    }
+    for (int i = 0; i < 5; i++) {
+        params.matrix_h[i] = 1;
+        params.matrix_v[i] = 1;
+        params.matrixf_h[i] = 1.0f;
+        params.matrixf_v[i] = 1.0f;
+    }
+    params.div = matrixsize ? 1.0f / matrixsize : 1.0f;
+    params.hi = params.maxval;
+    params.hif = 1.0f;
+    params.gamma = 1.0f;
+    params.max_in = 1.0f;
+    params.max_out = 1.0f;
+    return params;
+}
+
+typedef void (*GenericFunc)(const void *, ptrdiff_t, void *, ptrdiff_t, const vs_generic_params *, unsigned, unsigned);
+typedef void (*MergeFunc)(const void *, const void *, void *, vs_merge_weight, unsigned);
+typedef void (*MaskMergeFunc)(const void *, const void *, const void *, void *, unsigned, unsigned, unsigned);
+typedef void (*PreMultiplyFunc)(const void *, const void *, void *, unsigned, unsigned, unsigned, unsigned);
+typedef void (*DiffFunc)(const void *, const void *, void *, unsigned, unsigned);
+typedef void (*Stats1Func)(vs_plane_stats *, const void *, ptrdiff_t, unsigned, unsigned);
+typedef void (*Stats2Func)(vs_plane_stats *, const void *, ptrdiff_t, const void *, ptrdiff_t, unsigned, unsigned);
+typedef void (*TransposeFunc)(const void *, ptrdiff_t, void *, ptrdiff_t, unsigned, unsigned);
+
+void addGeneric(std::vector<Benchmark> &list, const char *name, Isa isa, unsigned matrixsize, GenericFunc byteFunc, GenericFunc wordFunc, GenericFunc floatFunc) {
+    list.push_back({ std::string("generic_") + name, isa, 2, [=](Frame &f) {
+        GenericFunc func = pick(f.depth, byteFunc, wordFunc, floatFunc);
+        if (!func)
+            return false;
+        vs_generic_params params = makeGenericParams(f.depth, matrixsize);
+        func(f.src[0].data.get(), f.src[0].stride, f.dst.data.get(), f.dst.stride, &params, f.width, f.height);
+        return true;
+    } });
+}
+
+void addMerge(std::vector<Benchmark> &list, Isa isa, MergeFunc byteFunc, MergeFunc wordFunc, MergeFunc floatFunc) {
+    list.push_back({ "merge", isa, 3, [=](Frame &f) {
+        MergeFunc func = pick(f.depth, byteFunc, wordFunc, floatFunc);
+        vs_merge_weight weight;
+        if (f.depth.type == ptFloat)
+            weight.f = 0.5f;
+        else
+            weight.u = 1U << 14;
+        for (unsigned y = 0; y < f.height; y++)
+            func(f.src[0].row(y), f.src[1].row(y), f.dst.row(y), weight, f.width);
+        return true;
+    } });
+}
+
+void addMaskMerge(std::vector<Benchmark> &list, const char *name, Isa isa, MaskMergeFunc byteFunc, MaskMergeFunc wordFunc, MaskMergeFunc floatFunc) {
+    list.push_back({ name, isa, 4, [=](Frame &f) {
+        MaskMergeFunc func = pick(f.depth, byteFunc, wordFunc, floatFunc);
+        for (unsigned y = 0; y < f.height; y++)
+            func(f.src[0].row(y), f.src[1].row(y), f.src[2].row(y), f.dst.row(y), f.depth.bits, 1U << (f.depth.bits - 1), f.width);
+        return true;
+    } });
+}
+
+void addPreMultiply(std::vector<Benchmark> &list, Isa isa, PreMultiplyFunc byteFunc, PreMultiplyFunc wordFunc, PreMultiplyFunc floatFunc) {
+    list.push_back({ "premultiply", isa, 3, [=](Frame &f) {
+        PreMultiplyFunc func = pick(f.depth, byteFunc, wordFunc, floatFunc);
+        for (unsigned y = 0; y < f.height; y++)
+            func(f.src[0].row(y), f.src[1].row(y), f.dst.row(y), f.depth.bits, 16U << (f.depth.bits - 8), 0, f.width);
+        return true;
+    } });
+}
+
+void addDiff(std::vector<Benchmark> &list, const char *name, Isa isa, DiffFunc byteFunc, DiffFunc wordFunc, DiffFunc floatFunc) {
+    list.push_back({ name, isa, 3, [=](Frame &f) {
+        DiffFunc func = pick(f.depth, byteFunc, wordFunc, floatFunc);
+        for (unsigned y = 0; y < f.height; y++)
+            func(f.src[0].row(y), f.src[1].row(y), f.dst.row(y), f.depth.bits, f.width);
+        return true;
+    } });
+}
+
+void addPlaneStats(std::vector<Benchmark> &list, Isa isa, Stats1Func byte1, Stats1Func word1, Stats1Func float1, Stats2Func byte2, Stats2Func word2, Stats2Func float2) {
+    list.push_back({ "plane_stats_1", isa, 1, [=](Frame &f) {
+        vs_plane_stats stats = {};
+        pick(f.depth, byte1, word1, float1)(&stats, f.src[0].data.get(), f.src[0].stride, f.width, f.height);
+        return true;
+    } });
+    list.push_back({ "plane_stats_2", isa, 2, [=](Frame &f) {
+        vs_plane_stats stats = {};
+        pick(f.depth, byte2, word2, float2)(&stats, f.src[0].data.get(), f.src[0].stride, f.src[1].data.get(), f.src[1].stride, f.width, f.height);
+        return true;
+    } });
+}
+
+void addTranspose(std::vector<Benchmark> &list, Isa isa, TransposeFunc byteFunc, TransposeFunc wordFunc, TransposeFunc dwordFunc) {
+    list.push_back({ "transpose", isa, 2, [=](Frame &f) {
+        pick(f.depth, byteFunc, wordFunc, dwordFunc)(f.src[0].data.get(), f.src[0].stride, f.dstT.data.get(), f.dstT.stride, f.width, f.height);
+        return true;
+    } });
+}
+
+#define GENERIC(list, kernel, isa, isaEnum, matrixsize) \
+    addGeneric(list, #kernel, isaEnum, matrixsize, vs_generic_##kernel##_byte_##isa, vs_generic_##kernel##_word_##isa, vs_generic_##kernel##_float_##isa)
+
+#define GENERIC_SIMD(list, isa, isaEnum) \
+    GENERIC(list, 3x3_prewitt, isa, isaEnum, 9); \
+    GENERIC(list, 3x3_sobel, isa, isaEnum, 9); \
+    GENERIC(list, 3x3_min, isa, isaEnum, 9); \
+    GENERIC(list, 3x3_max, isa, isaEnum, 9); \
+    GENERIC(list, 3x3_median, isa, isaEnum, 9); \
+    GENERIC(list, 3x3_deflate, isa, isaEnum, 9); \
+    GENERIC(list, 3x3_inflate, isa, isaEnum, 9); \
+    GENERIC(list, 3x3_conv, isa, isaEnum, 9); \
+    GENERIC(list, invert, isa, isaEnum, 0); \
+    GENERIC(list, limit, isa, isaEnum, 0); \
+    GENERIC(list, binarize, isa, isaEnum, 0); \
+    addGeneric(list, "levels", isaEnum, 0, nullptr, nullptr, vs_generic_levels_float_##isa)
+
+#define MERGE(list, isa, isaEnum) \
+    addMerge(list, isaEnum, vs_merge_byte_##isa, vs_merge_word_##isa, vs_merge_float_##isa); \
+    addMaskMerge(list, "mask_merge", isaEnum, vs_mask_merge_byte_##isa, vs_mask_merge_word_##isa, vs_mask_merge_float_##isa); \
+    addMaskMerge(list, "mask_merge_premul", isaEnum, vs_mask_merge_premul_byte_##isa, vs_mask_merge_premul_word_##isa, vs_mask_merge_premul_float_##isa); \
+    addDiff(list, "makediff", isaEnum, vs_makediff_byte_##isa, vs_makediff_word_##isa, vs_makediff_float_##isa); \
+    addDiff(list, "mergediff", isaEnum, vs_mergediff_byte_##isa, vs_mergediff_word_##isa, vs_mergediff_float_##isa)
+
+#define PREMULTIPLY(list, isa, isaEnum) \
+    addPreMultiply(list, isaEnum, vs_premultiply_byte_##isa, vs_premultiply_word_##isa, vs_premultiply_float_##isa)
+
+#define PLANE_STATS(list, isa, isaEnum) \
+    addPlaneStats(list, isaEnum, vs_plane_stats_1_byte_##isa, vs_plane_stats_1_word_##isa, vs_plane_stats_1_float_##isa, \
+                  vs_plane_stats_2_byte_##isa, vs_plane_stats_2_word_##isa, vs_plane_stats_2_float_##isa)
+
+#define TRANSPOSE(list, isa, isaEnum) \
+    addTranspose(list, isaEnum, vs_transpose_plane_byte_##isa, vs_transpose_plane_word_##isa, vs_transpose_plane_dword_##isa)
+
+std::vector<Benchmark> getKernelBenchmarks() {
+    std::vector<Benchmark> list;
+
+    GENERIC_SIMD(list, c, isaC);
+    GENERIC(list, 5x5_conv, c, isaC, 25);
+    GENERIC(list, 5x5_conv_sep, c, isaC, 25);
+    GENERIC(list, 1d_conv_h, c, isaC, 5);
+    GENERIC(list, 1d_conv_v, c, isaC, 5);
+    MERGE(list, c, isaC);
+    PREMULTIPLY(list, c, isaC);
+    PLANE_STATS(list, c, isaC);
+    TRANSPOSE(list, c, isaC);
+
+#ifdef VS_TARGET_CPU_X86
+    GENERIC_SIMD(list, sse2, isaSSE2);
+    MERGE(list, sse2, isaSSE2);
+    PREMULTIPLY(list, sse2, isaSSE2);
+    PLANE_STATS(list, sse2, isaSSE2);
+    TRANSPOSE(list, sse2, isaSSE2);
+
+    GENERIC_SIMD(list, avx2, isaAVX2);
+    GENERIC(list, 5x5_conv_sep, avx2, isaAVX2, 25);
+    MERGE(list, avx2, isaAVX2);
+    PREMULTIPLY(list, avx2, isaAVX2);
+    PLANE_STATS(list, avx2, isaAVX2);
+    TRANSPOSE(list, avx2, isaAVX2);
+
+    GENERIC_SIMD(list, avx512, isaAVX512);
+    PLANE_STATS(list, avx512, isaAVX512);
+#endif
+
+#ifdef VS_TARGET_CPU_ARM_NEON
+    MERGE(list, neon, isaNEON);
+    PLANE_STATS(list, neon, isaNEON);
+#endif
+
+    // keep all versions of a kernel next to each other in the output
+    std::stable_sort(list.begin(), list.end(), [](const Benchmark &a, const Benchmark &b) { return a.name < b.name; });
+    return list;
+}
+
+#undef TRANSPOSE
+#undef PLANE_STATS
+#undef PREMULTIPLY
+#undef MERGE
+#undef GENERIC_SIMD
+#undef GENERIC
+
+struct Timing {
+    double seconds;
+    uint64_t cycles;
+};
+
+// Calls f until minTime has passed and returns the fastest call since that's the least disturbed one
+template<typename F>
+Timing measure(F f, double minTime) {
+    f();
+    Timing best = { INFINITY, 0 };
+    double total = 0;
+    int iterations = 0;
+    while (total < minTime || iterations < 3) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t startCycles = readCycles();
+        f();
+        uint64_t cycles = readCycles() - startCycles;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed < best.seconds)
+            best = { elapsed, cycles };
+        total += elapsed;
+        iterations++;
+    }
+    return best;
+}
+
+void printHeader() {
+    printf("%-24s %-7s %-6s %5s %10s %9s %9s\n", "kernel", "isa", "size", "bits", "ms", "GB/s", "cyc/px");
+}
+
+void printResult(const std::string &name, const char *isa, const Resolution &res, const Depth &depth, const Timing &t, double bytes) {
+    double pixels = static_cast<double>(res.width) * res.height;
+#ifdef VS_TARGET_CPU_X86
+    printf("%-24s %-7s %-6s %5u %10.3f %9.2f %9.3f\n", name.c_str(), isa, res.name, depth.bits, t.seconds * 1000, bytes / t.seconds / 1e9, t.cycles / pixels);
+#else
+    printf("%-24s %-7s %-6s %5u %10.3f %9.2f %9s\n", name.c_str(), isa, res.name, depth.bits, t.seconds * 1000, bytes / t.seconds / 1e9, "-");
+#endif
+}
+
+bool matchesFilter(const std::string &name, const std::vector<std::string> &filters) {
+    if (filters.empty())
+        return true;
+    for (const auto &filter : filters) {
+        if (name.find(filter) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+void runKernelBenchmarks(const std::vector<std::string> &filters, double minTime) {
+    std::vector<Benchmark> list = getKernelBenchmarks();
+
+    for (const auto &res : resolutions) {
+        for (const auto &depth : depths) {
+            std::unique_ptr<Frame> frame;
+            for (const auto &b : list) {
+                if (!isaSupported(b.isa) || !matchesFilter(b.name, filters))
+                    continue;
+                if (!frame)
+                    frame.reset(new Frame(res.width, res.height, depth));
+                if (!b.run(*frame))
+                    continue;
+                Timing t = measure([&]() { b.run(*frame); }, minTime);
+                printResult(b.name, isaNames[b.isa], res, depth, t, static_cast<double>(res.width) * res.height * depth.bytesPerSample() * b.planesTouched);
+            }
+        }
+    }
+}
+
+// Expr is timed as whole frames through the public API since its compilers are internal to the filter,
+// the frames come from BlankClip with keep set so almost all the time is spent in the generated code
+struct ExprBenchmark {
+    const char *name;
+    const char *expr;
+    bool floatOnly;
+};
+
+const ExprBenchmark exprBenchmarks[] = {
+    { "expr_average", "x y + 2 /", false },
+    { "expr_lerp", "x 0.25 * y 0.75 * +", false },
+    { "expr_absdiff_clamp", "x y - abs 4 * 0 max 100 min", false },
+    { "expr_transcendental", "x 1 + log y 0.5 * exp +", true },
+};
+
+VSNode *invokeForNode(const VSAPI *vsapi, VSPlugin *plugin, const char *name, VSMap *args) {
+    VSMap *ret = vsapi->invoke(plugin, name, args);
+    VSNode *node = nullptr;
+    if (const char *err = vsapi->mapGetError(ret))
+        fprintf(stderr, "%s failed: %s\n", name, err);
+    else
+        node = vsapi->mapGetNode(ret, "clip", 0, nullptr);
+    vsapi->freeMap(ret);
+    return node;
+}
+
+void runExprBenchmarks(const std::vector<std::string> &filters, double minTime) {
+    const VSAPI *vsapi = getVapourSynthAPI(VAPOURSYNTH_API_VERSION);
+    if (!vsapi) {
+        fprintf(stderr, "Failed to initialize VapourSynth, skipping Expr\n");
+        return;
+    }
+
+    const char *const exprIsas[] = { "none", "sse2", "avx2", "avx512" };
+    const Isa exprIsaEnums[] = { isaC, isaSSE2, isaAVX2, isaAVX512 };
+
+    for (size_t i = 0; i < sizeof(exprIsas) / sizeof(exprIsas[0]); i++) {
+        if (!isaSupported(exprIsaEnums[i]))
+            continue;
+
+        for (const auto &eb : exprBenchmarks) {
+            if (!matchesFilter(eb.name, filters))
+                continue;
+
+            for (const auto &res : resolutions) {
+                for (const auto &depth : depths) {
+                    if (eb.floatOnly && depth.type != ptFloat)
+                        continue;
+
+                    // a new core every time so no caches carry over
+                    VSCore *core = vsapi->createCore(padStrides ? ccfPadStrides : 0);
+                    vsapi->setThreadCount(1, core);
+                    VSPlugin *stdPlugin = vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core);
+                    VSMap *args = vsapi->createMap();
+
+                    vsapi->mapSetData(args, "cpu", exprIsas[i], -1, dtUtf8, maReplace);
+                    vsapi->freeMap(vsapi->invoke(stdPlugin, "SetMaxCPU", args));
+                    vsapi->clearMap(args);
+
+                    int format = vsapi->queryVideoFormatID(cfGray, depth.type == ptFloat ? stFloat : stInteger, depth.bits, 0, 0, core);
+                    vsapi->mapSetInt(args, "width", res.width, maReplace);
+                    vsapi->mapSetInt(args, "height", res.height, maReplace);
+                    vsapi->mapSetInt(args, "format", format, maReplace);
+                    vsapi->mapSetInt(args, "length", 1 << 30, maReplace);
+                    vsapi->mapSetInt(args, "keep", 1, maReplace);
+                    VSNode *blank = invokeForNode(vsapi, stdPlugin, "BlankClip", args);
+                    vsapi->clearMap(args);
+
+                    VSNode *node = nullptr;
+                    if (blank) {
+                        vsapi->mapSetNode(args, "clips", blank, maAppend);
+                        vsapi->mapSetNode(args, "clips", blank, maAppend);
+                        vsapi->mapSetData(args, "expr", eb.expr, -1, dtUtf8, maReplace);
+                        node = invokeForNode(vsapi, stdPlugin, "Expr", args);
+                        vsapi->freeNode(blank);
+                    }
+                    vsapi->freeMap(args);
+
+                    if (node) {
+                        int n = 0;
+                        Timing t = measure([&]() {
+                            char err[256];
+                            const VSFrame *f = vsapi->getFrame(n++, node, err, sizeof(err));
+                            if (!f)
+                                fprintf(stderr, "Expr failed: %s\n", err);
+                            vsapi->freeFrame(f);
+                        }, minTime);
+                        printResult(eb.name, isaNames[exprIsaEnums[i]], res, depth, t, static_cast<double>(res.width) * res.height * depth.bytesPerSample() * 3);
+                        vsapi->freeNode(node);
+                    }
+
+                    vsapi->freeCore(core);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> filters;
+    double minTime = 0.25;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--quick")) {
+            minTime = 0.02;
+        } else if (!strcmp(argv[i], "--pad-strides")) {
+            padStrides = true;
+        } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            printf("Usage: kernelbench [--quick] [--pad-strides] [substring...]\n");
+            return 0;
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+
+    if (!getCPUFeatures()->can_run_vs) {
+        fprintf(stderr, "This cpu doesn't meet the minimum requirements of VapourSynth\n");
+        return 1;
+    }
+
+    printHeader();
+    runKernelBenchmarks(filters, minTime);
+    runExprBenchmarks(filters, minTime);
+    return 0;
+}
@@ -0,0 +1,452 @@
+/*
+* Copyright (c) 2012-2021 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+// Builds a set of synthetic filter graphs from BlankClip and TestAudio and pulls every
+// frame through getFrameAsync at different thread counts. The filters themselves do
+// very little work so the numbers mostly reflect the scheduler and the caches.
+//
+// Usage: pipelinebench [--quick] [--flags n] [--threads n] [substring...]
+// Only graphs whose name contains one of the substrings are run, --flags sets the
+// core creation flags so different scheduler and cache modes can be compared.
+
+#include "VapourSynth4.h"
+#include "VSHelper4.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const VSAPI *vsapi = nullptr;
+
+// Creates the graphs and keeps a reference to every node in it for the statistics
+class GraphBuilder {
+    VSCore *core;
+    VSPlugin *stdPlugin;
+    std::vector<VSNode *> nodes;
+    std::string error;
+public:
+    explicit GraphBuilder(VSCore *core) : core(core), stdPlugin(vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core)) {
+    }
+
+    ~GraphBuilder() {
+        for (auto iter : nodes)
+            vsapi->freeNode(iter);
+    }
+
+    VSCore *getCore() const {
+        return core;
+    }
+
+    const std::vector<VSNode *> &getNodes() const {
+        return nodes;
+    }
+
+    const std::string &getError() const {
+        return error;
+    }
+
+    // Invokes a function in the std namespace and frees args, the returned node is owned by the builder
+    VSNode *invoke(const char *name, VSMap *args) {
+        VSMap *ret = vsapi->invoke(stdPlugin, name, args);
+        vsapi->freeMap(args);
+        VSNode *node = nullptr;
+        if (const char *err = vsapi->mapGetError(ret)) {
+            if (error.empty())
+                error = std::string(name) + ": " + err;
+        } else {
+            node = vsapi->mapGetNode(ret, "clip", 0, nullptr);
+            nodes.push_back(node);
+        }
+        vsapi->freeMap(ret);
+        return node;
+    }
+
+    VSNode *expr(const std::vector<VSNode *> &clips, const std::string &e) {
+        if (std::find(clips.begin(), clips.end(), nullptr) != clips.end())
+            return nullptr;
+        VSMap *args = vsapi->createMap();
+        for (auto iter : clips)
+            vsapi->mapSetNode(args, "clips", iter, maAppend);
+        vsapi->mapSetData(args, "expr", e.c_str(), -1, dtUtf8, maReplace);
+        return invoke("Expr", args);
+    }
+
+    VSNode *trim(VSNode *clip, int first, int last) {
+        if (!clip)
+            return nullptr;
+        VSMap *args = vsapi->createMap();
+        vsapi->mapSetNode(args, "clip", clip, maReplace);
+        vsapi->mapSetInt(args, "first", first, maReplace);
+        vsapi->mapSetInt(args, "last", last, maReplace);
+        return invoke("Trim", args);
+    }
+
+    VSNode *loop(VSNode *clip, int times) {
+        if (!clip)
+            return nullptr;
+        VSMap *args = vsapi->createMap();
+        vsapi->mapSetNode(args, "clip", clip, maReplace);
+        vsapi->mapSetInt(args, "times", times, maReplace);
+        return invoke("Loop", args);
+    }
+
+    VSNode *splice(VSNode *a, VSNode *b) {
+        if (!a || !b)
+            return nullptr;
+        VSMap *args = vsapi->createMap();
+        vsapi->mapSetNode(args, "clips", a, maAppend);
+        vsapi->mapSetNode(args, "clips", b, maAppend);
+        return invoke("Splice", args);
+    }
+
+    VSNode *merge(VSNode *a, VSNode *b) {
+        if (!a || !b)
+            return nullptr;
+        VSMap *args = vsapi->createMap();
+        vsapi->mapSetNode(args, "clipa", a, maReplace);
+        vsapi->mapSetNode(args, "clipb", b, maReplace);
+        return invoke("Merge", args);
+    }
+
+    VSNode *blankClip(int length) {
+        VSMap *args = vsapi->createMap();
+        vsapi->mapSetInt(args, "width", 1920, maReplace);
+        vsapi->mapSetInt(args, "height", 1080, maReplace);
+        vsapi->mapSetInt(args, "format", pfYUV420P8, maReplace);
+        vsapi->mapSetInt(args, "length", length, maReplace);
+        return invoke("BlankClip", args);
+    }
+};
+
+// Moves every frame by offset while keeping the length by repeating the first or last frame
+VSNode *shiftClip(GraphBuilder &b, VSNode *clip, int offset, int length) {
+    if (offset > 0) {
+        VSNode *tail = b.trim(clip, offset, length - 1);
+        VSNode *pad = b.loop(b.trim(clip, length - 1, length - 1), offset);
+        return b.splice(tail, pad);
+    } else if (offset < 0) {
+        VSNode *pad = b.loop(b.trim(clip, 0, 0), -offset);
+        VSNode *head = b.trim(clip, 0, length - 1 + offset);
+        return b.splice(pad, head);
+    }
+    return clip;
+}
+
+VSNode *buildPointwiseChain(GraphBuilder &b, int length) {
+    VSNode *clip = b.blankClip(length);
+    for (int i = 0; i < 8 && clip; i++) {
+        if (i % 2) {
+            VSMap *args = vsapi->createMap();
+            vsapi->mapSetNode(args, "clip", clip, maReplace);
+            clip = b.invoke("Invert", args);
+        } else {
+            clip = b.expr({ clip }, "x " + std::to_string(i + 1) + " +");
+        }
+    }
+    return clip;
+}
+
+VSNode *buildFanOutIn(GraphBuilder &b, int length) {
+    VSNode *clip = b.blankClip(length);
+    if (!clip)
+        return nullptr;
+    std::vector<VSNode *> branches;
+    for (int i = 0; i < 8; i++)
+        branches.push_back(b.expr({ clip }, "x " + std::to_string(i * 4) + " +"));
+    while (branches.size() > 1) {
+        std::vector<VSNode *> next;
+        for (size_t i = 0; i < branches.size(); i += 2)
+            next.push_back(b.merge(branches[i], branches[i + 1]));
+        branches.swap(next);
+    }
+    return branches[0];
+}
+
+VSNode *buildTemporal(GraphBuilder &b, int length) {
+    const int radius = 3;
+    static const char vars[] = "xyzabcdefghijklmnopqrstuvw";
+    VSNode *clip = b.blankClip(length);
+    if (!clip)
+        return nullptr;
+    std::vector<VSNode *> clips;
+    std::string e;
+    for (int i = -radius; i <= radius; i++) {
+        VSNode *shifted = shiftClip(b, clip, i, length);
+        if (!shifted)
+            return nullptr;
+        e += std::string(1, vars[clips.size()]) + (clips.empty() ? " " : " + ");
+        clips.push_back(shifted);
+    }
+    e += std::to_string(clips.size()) + " /";
+    return b.expr(clips, e);
+}
+
+VSNode *buildSpliceTree(GraphBuilder &b, VSNode *clip, int first, int last, int depth) {
+    if (!clip)
+        return nullptr;
+    if (depth == 0 || last - first < 2)
+        return b.trim(clip, first, last);
+    int middle = first + (last - first + 1) / 2;
+    VSNode *left = buildSpliceTree(b, clip, first, middle - 1, depth - 1);
+    VSNode *right = buildSpliceTree(b, clip, middle, last, depth - 1);
+    return b.splice(left, right);
+}
+
+VSNode *buildSpliceTree(GraphBuilder &b, int length) {
+    return buildSpliceTree(b, b.blankClip(length), 0, length - 1, 8);
+}
+
+struct FrameEvalData {
+    std::vector<VSNode *> choices;
+};
+
+void VS_CC frameEvalSelect(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    FrameEvalData *d = reinterpret_cast<FrameEvalData *>(userData);
+    int64_t n = vsapi->mapGetInt(in, "n", 0, nullptr);
+    vsapi->mapSetNode(out, "val", d->choices[n % d->choices.size()], maReplace);
+}
+
+void VS_CC frameEvalFree(void *userData) {
+    FrameEvalData *d = reinterpret_cast<FrameEvalData *>(userData);
+    for (auto iter : d->choices)
+        vsapi->freeNode(iter);
+    delete d;
+}
+
+VSNode *buildFrameEval(GraphBuilder &b, int length) {
+    VSNode *clip = b.blankClip(length);
+    // every level picks one of a few variants of the previous one for each frame
+    for (int level = 0; level < 4 && clip; level++) {
+        FrameEvalData *d = new FrameEvalData;
+        for (int i = 0; i < 4; i++) {
+            VSNode *choice = b.expr({ clip }, "x " + std::to_string(i) + " +");
+            if (!choice) {
+                frameEvalFree(d);
+                return nullptr;
+            }
+            d->choices.push_back(vsapi->addNodeRef(choice));
+        }
+        VSFunction *func = vsapi->createFunction(frameEvalSelect, d, frameEvalFree, b.getCore());
+        VSMap *args = vsapi->createMap();
+        vsapi->mapSetNode(args, "clip", clip, maReplace);
+        vsapi->mapSetFunction(args, "eval", func, maReplace);
+        vsapi->freeFunction(func);
+        clip = b.invoke("FrameEval", args);
+    }
+    return clip;
+}
+
+VSNode *buildAudioChain(GraphBuilder &b, int length) {
+    VSMap *args = vsapi->createMap();
+    vsapi->mapSetInt(args, "channels", 6, maReplace);
+    vsapi->mapSetInt(args, "length", static_cast<int64_t>(length) * VS_AUDIO_FRAME_SAMPLES * 4, maReplace);
+    VSNode *clip = b.invoke("TestAudio", args);
+    for (int i = 0; i < 8 && clip; i++) {
+        args = vsapi->createMap();
+        vsapi->mapSetNode(args, "clip", clip, maReplace);
+        vsapi->mapSetFloat(args, "gain", (i % 2) ? 0.5 : 2.0, maReplace);
+        clip = b.invoke("AudioGain", args);
+    }
+    return clip;
+}
+
+struct Graph {
+    const char *name;
+    VSNode *(*build)(GraphBuilder &b, int length);
+};
+
+const Graph graphs[] = {
+    { "pointwise_chain", buildPointwiseChain },
+    { "fanout_fanin", buildFanOutIn },
+    { "temporal_radius3", buildTemporal },
+    { "splice_trim_tree", buildSpliceTree },
+    { "frameeval", buildFrameEval },
+    { "audio_chain", buildAudioChain },
+};
+
+// Keeps a fixed number of frames in flight the same way vspipe does
+struct Run {
+    std::mutex lock;
+    std::condition_variable done;
+    VSNode *node;
+    VSCore *core;
+    int total;
+    int requested = 0;
+    int completed = 0;
+    int64_t peakMemory = 0;
+    std::string error;
+};
+
+void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg) {
+    Run *r = reinterpret_cast<Run *>(userData);
+    vsapi->freeFrame(f);
+
+    VSCoreInfo info;
+    vsapi->getCoreInfo(r->core, &info);
+
+    int next = -1;
+    {
+        std::lock_guard<std::mutex> guard(r->lock);
+        r->peakMemory = std::max(r->peakMemory, info.usedFramebufferSize);
+        if (errorMsg && r->error.empty())
+            r->error = errorMsg;
+        r->completed++;
+        if (r->requested < r->total && r->error.empty())
+            next = r->requested++;
+        else if (r->completed == r->requested)
+            r->done.notify_one();
+    }
+
+    // the callback may be invoked from inside getFrameAsync so the lock can't be held here
+    if (next >= 0)
+        vsapi->getFrameAsync(next, r->node, frameDoneCallback, r);
+}
+
+int64_t getStat(const VSMap *stats, const char *key) {
+    int err;
+    int64_t v = vsapi->mapGetInt(stats, key, 0, &err);
+    return err ? 0 : v;
+}
+
+void runGraph(const Graph &graph, int threads, int length, int flags) {
+    VSCore *core = vsapi->createCore(flags);
+    vsapi->setThreadCount(threads, core);
+
+    {
+        GraphBuilder b(core);
+        VSNode *node = graph.build(b, length);
+        if (!node) {
+            fprintf(stderr, "%s: failed to create graph: %s\n", graph.name, b.getError().c_str());
+            vsapi->freeCore(core);
+            return;
+        }
+
+        Run r;
+        r.node = node;
+        r.core = core;
+        r.total = (vsapi->getNodeType(node) == mtVideo) ? vsapi->getVideoInfo(node)->numFrames : vsapi->getAudioInfo(node)->numFrames;
+
+        auto start = std::chrono::steady_clock::now();
+        int initial = std::min(r.total, threads * 2);
+        for (int i = 0; i < initial; i++) {
+            int n;
+            {
+                std::lock_guard<std::mutex> guard(r.lock);
+                n = r.requested++;
+            }
+            vsapi->getFrameAsync(n, node, frameDoneCallback, &r);
+        }
+        {
+            std::unique_lock<std::mutex> guard(r.lock);
+            r.done.wait(guard, [&r]() { return r.completed == r.requested && (r.requested == r.total || !r.error.empty()); });
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!r.error.empty()) {
+            fprintf(stderr, "%s: %s\n", graph.name, r.error.c_str());
+        } else {
+            VSMap *stats = vsapi->createMap();
+            vsapi->getCoreStatistics(core, stats);
+            double schedulingTime = static_cast<double>(getStat(stats, "schedulingTime"));
+            double filterTime = static_cast<double>(getStat(stats, "filterTime"));
+
+            int64_t hits = 0;
+            int64_t lookups = 0;
+            for (auto iter : b.getNodes()) {
+                vsapi->clearMap(stats);
+                vsapi->getNodeStatistics(iter, stats);
+                int64_t nodeHits = getStat(stats, "cacheHits");
+                hits += nodeHits;
+                lookups += nodeHits + getStat(stats, "cacheNearMisses") + getStat(stats, "cacheMisses");
+            }
+            vsapi->freeMap(stats);
+
+            double overhead = (schedulingTime + filterTime) > 0 ? 100 * schedulingTime / (schedulingTime + filterTime) : 0;
+            double hitRate = lookups ? 100.0 * hits / lookups : 0;
+            printf("%-18s %7d %10.1f %10.1f %10.1f %10.1f\n", graph.name, threads, r.total / elapsed, overhead, r.peakMemory / (1024.0 * 1024.0), hitRate);
+            fflush(stdout);
+        }
+    }
+
+    vsapi->freeCore(core);
+}
+
+bool matchesFilter(const char *name, const std::vector<std::string> &filters) {
+    if (filters.empty())
+        return true;
+    for (const auto &filter : filters) {
+        if (strstr(name, filter.c_str()))
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> filters;
+    int length = 1000;
+    int flags = 0;
+    int maxThreads = std::max(1U, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--quick")) {
+            length = 100;
+        } else if (!strcmp(argv[i], "--flags") && i + 1 < argc) {
+            flags = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            maxThreads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            printf("Usage: pipelinebench [--quick] [--flags n] [--threads n] [substring...]\n");
+            return 0;
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+
+    vsapi = getVapourSynthAPI(VAPOURSYNTH_API_VERSION);
+    if (!vsapi) {
+        fprintf(stderr, "Failed to initialize VapourSynth\n");
+        return 1;
+    }
+
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    printf("%-18s %7s %10s %10s %10s %10s\n", "graph", "threads", "fps", "sched %", "peak MB", "cache hit %");
+    for (const auto &graph : graphs) {
+        if (!matchesFilter(graph.name, filters))
+            continue;
+        for (int threads : threadCounts)
+            runGraph(graph, threads, length, flags);
+    }
+
+    return 0;
+}
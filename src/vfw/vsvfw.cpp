@@ -26,8 +26,10 @@
 #include <vfw.h>
 #include <aviriff.h>
 #include <string>
+#include <cwchar>
 #include <algorithm>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <vector>
 #include <chrono>
@@ -44,6 +46,70 @@ using namespace vsh;
 
 static std::atomic<long> refCount(0);
 
+// Hosts often open the same script several times, NLEs do it for proxies and for every bin a file is in. Each opening
+// of an unchanged script shares the one evaluated script so sources are only opened once and all readers use the same
+// frame caches. Scripts are identified by their full path and modification time so editing a script gives new openings
+// a fresh evaluation while the old one lives on until its last reader closes.
+struct SharedScript {
+    std::wstring path;
+    FILETIME writeTime;
+    VSScript *se;
+    int refs;
+};
+
+static std::mutex sharedScriptsLock;
+static std::vector<SharedScript> sharedScripts;
+
+// Returns the shared evaluation of a script, it's only shared when evaluation succeeded
+static VSScript *acquireScript(const VSSCRIPTAPI *vssapi, const std::string &filename) {
+    std::wstring path = utf16_from_utf8(filename);
+    std::vector<wchar_t> fullPath(MAX_PATH);
+    DWORD length = GetFullPathNameW(path.c_str(), static_cast<DWORD>(fullPath.size()), fullPath.data(), nullptr);
+    if (length > fullPath.size()) {
+        fullPath.resize(length);
+        length = GetFullPathNameW(path.c_str(), static_cast<DWORD>(fullPath.size()), fullPath.data(), nullptr);
+    }
+    if (length > 0 && length < fullPath.size())
+        path.assign(fullPath.data(), length);
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+        return vssapi->evaluateFile(filename.c_str(), nullptr, 0);
+
+    std::lock_guard<std::mutex> lock(sharedScriptsLock);
+    for (auto &iter : sharedScripts) {
+        if (!_wcsicmp(iter.path.c_str(), path.c_str()) && !CompareFileTime(&iter.writeTime, &attributes.ftLastWriteTime)) {
+            iter.refs++;
+            return iter.se;
+        }
+    }
+
+    // evaluated with the lock held so opening the same script from several threads doesn't evaluate it several times
+    VSScript *se = vssapi->evaluateFile(filename.c_str(), nullptr, 0);
+    if (!vssapi->getError(se))
+        sharedScripts.push_back({ path, attributes.ftLastWriteTime, se, 1 });
+    return se;
+}
+
+static void releaseScript(const VSSCRIPTAPI *vssapi, VSScript *se) {
+    if (!se)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(sharedScriptsLock);
+        for (auto iter = sharedScripts.begin(); iter != sharedScripts.end(); ++iter) {
+            if (iter->se == se) {
+                if (--iter->refs > 0)
+                    return;
+                sharedScripts.erase(iter);
+                break;
+            }
+        }
+    }
+
+    vssapi->freeScript(se);
+}
+
 static const GUID CLSID_VapourSynth
     = { 0x58f74ca0, 0xbd0e, 0x4664, { 0xa4, 0x9b, 0x8d, 0x10, 0xe6, 0xf0, 0xc1, 0x31 } };
 
@@ -75,9 +141,29 @@ private:
 
     std::mutex cs_filter_graph;
 
+    // Frames after a sequential read are requested ahead of time and packed on
+    // the worker thread that delivers them, reads then only have to copy them
+    struct PrefetchedFrame {
+        int n = -1; // -1 when the slot is free
+        bool done = false;
+        bool success = false;
+        std::vector<uint8_t> packed;
+    };
+
+    int prefetch_frames = 0;
+    int last_read = -1;
+    std::mutex prefetch_lock;
+    std::condition_variable prefetch_done;
+    std::vector<PrefetchedFrame> prefetch_ring;
+
     bool DelayInit();
     bool DelayInit2();
 
+    int ImageSize();
+    void PackFrame(const VSFrame *f, void *lpBuffer);
+    void Prefetch(int n);
+    bool TakePrefetched(int n, void *lpBuffer);
+
     void Lock();
     void Unlock();
 public:
@@ -398,7 +484,7 @@ VapourSynthFile::~VapourSynthFile() {
     if (vi || ai) {
         vi = nullptr;
         ai = nullptr;
-        vssapi->freeScript(se);
+        releaseScript(vssapi, se);
         se = nullptr;
     }
     Unlock();
@@ -435,7 +521,7 @@ msg.set_output()\n";
 
 bool VapourSynthFile::DelayInit2() {
     if (!szScriptName.empty() && !vi) {
-        VSScript *se = vssapi->evaluateFile(szScriptName.c_str(), nullptr, 0);
+        se = acquireScript(vssapi, szScriptName);
         if (!vssapi->getError(se)) {
             error_msg.clear();
 
@@ -473,6 +559,9 @@ bool VapourSynthFile::DelayInit2() {
             VSMap *options = vsapi->createMap();
             vssapi->getOptions(se, options);
             enable_v210 = !!vsapi->mapGetInt(options, "enable_v210", 0, &error);
+            prefetch_frames = vsapi->mapGetIntSaturated(options, "VFW_ReadAheadFrameCount", 0, &error);
+            if (error)
+                prefetch_frames = -1;
             vsapi->freeMap(options);
 
             ////////// audio
@@ -497,6 +586,10 @@ bool VapourSynthFile::DelayInit2() {
             vsapi->getCoreInfo(vssapi->getCore(se), &info);
             num_threads = info.numThreads;
 
+            if (prefetch_frames < 0)
+                prefetch_frames = num_threads;
+            prefetch_ring.resize(prefetch_frames);
+
             return true;
         } else {
             error_msg = vssapi->getError(se);
@@ -507,7 +600,7 @@ bool VapourSynthFile::DelayInit2() {
             audioNode = nullptr;
             vi = nullptr;
             ai = nullptr;
-            vssapi->freeScript(se);
+            releaseScript(vssapi, se);
             se = nullptr;
             std::string error_script = ErrorScript1;
             error_script += error_msg;
@@ -743,46 +836,38 @@ STDMETHODIMP_(LONG) VapourSynthStream::FindSample(LONG lPos, LONG lFlags) noexce
 
 void VS_CC VapourSynthFile::frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *, const char *errorMsg) {
     VapourSynthFile *vsfile = static_cast<VapourSynthFile *>(userData);
-    vsfile->vsapi->freeFrame(f);
-    --vsfile->pending_requests;
-}
 
-bool VapourSynthStream::ReadFrame(void* lpBuffer, int n) {
-    const VSAPI *vsapi = parent->vsapi;
-    const VSSCRIPTAPI *vssapi = parent->vssapi;
-    std::vector<char> errMsg(32 * 1024);
-    const VSFrame *f = vsapi->getFrame(n, parent->videoNode, errMsg.data(), static_cast<int>(errMsg.size()));
-    VSScript *errSe = nullptr;
-    if (!f) {
-        std::string matrix;
-        if (parent->vi->format.colorFamily == cfYUV || parent->vi->format.colorFamily == cfGray)
-            matrix = ", matrix_s=\"709\"";
+    PrefetchedFrame *slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(vsfile->prefetch_lock);
+        for (auto &iter : vsfile->prefetch_ring) {
+            if (iter.n == n && !iter.done) {
+                slot = &iter;
+                break;
+            }
+        }
+    }
 
-        char nameBuffer[32];
-        vsapi->getVideoFormatName(&parent->vi->format, nameBuffer);
+    // the slot belongs to this request until it's marked as done
+    if (slot && f)
+        vsfile->PackFrame(f, slot->packed.data());
+    vsfile->vsapi->freeFrame(f);
 
-        std::string frameErrorScript = "import vapoursynth as vs\nimport sys\ncore = vs.get_core()\n";
-        frameErrorScript += "err_script_formatid = " + std::string(nameBuffer) + "\n";
-        frameErrorScript += "err_script_width = " + std::to_string(parent->vi->width) + "\n";
-        frameErrorScript += "err_script_height = " + std::to_string(parent->vi->height) + "\n";
-        frameErrorScript += "err_script_background = core.std.BlankClip(width=err_script_width, height=err_script_height, format=vs.RGB24)\n";
-        frameErrorScript += "err_script_clip = core.text.Text(err_script_background, r\"\"\"";
-        frameErrorScript += errMsg.data();
-        frameErrorScript += "\"\"\")\n";
-        frameErrorScript += "err_script_clip = core.resize.Bilinear(err_script_clip, format=err_script_formatid" + matrix + ")\n";
-        frameErrorScript += "err_script_clip.set_output()\n";
+    if (slot) {
+        std::lock_guard<std::mutex> lock(vsfile->prefetch_lock);
+        slot->success = !!f;
+        slot->done = true;
+        vsfile->prefetch_done.notify_all();
+    }
 
-        errSe = vssapi->evaluateBuffer(frameErrorScript.c_str(), "vfw_error.message", nullptr, 0);
-        VSNode *node = vssapi->getOutputNode(errSe, 0);
-        f = vsapi->getFrame(0, node, nullptr, 0);
-        vsapi->freeNode(node);
+    --vsfile->pending_requests;
+}
 
-        if (!f) {
-            vssapi->freeScript(errSe);
-            return false;
-        }
-    }
+int VapourSynthFile::ImageSize() {
+    return BMPSize(vi, IsSameVideoFormat(vi->format, cfYUV, stInteger, 10, 1, 0) && enable_v210);
+}
 
+void VapourSynthFile::PackFrame(const VSFrame *f, void *lpBuffer) {
     const VSVideoFormat &fi = *vsapi->getVideoFrameFormat(f);
 
     p2p_buffer_param p = {};
@@ -818,7 +903,7 @@ bool VapourSynthStream::ReadFrame(void* lpBuffer, int n) {
     } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 16, 0, 0)) {
         p.packing = p2p_y416_le;
         p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
-    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0) && parent->enable_v210) {
+    } else if (IsSameVideoFormat(fi, cfYUV, stInteger, 10, 1, 0) && enable_v210) {
         p.packing = p2p_v210_le;
         p.dst_stride[0] = ((16 * ((p.width + 5) / 6) + 127) & ~127);
         p2p_pack_frame(&p, P2P_ALPHA_SET_ONE);
@@ -861,17 +946,115 @@ bool VapourSynthStream::ReadFrame(void* lpBuffer, int n) {
                 vsapi->getFrameHeight(f, plane3));
         }
     }
+}
 
-    vsapi->freeFrame(f);
-    vssapi->freeScript(errSe);
+void VapourSynthFile::Prefetch(int n) {
+    std::lock_guard<std::mutex> lock(prefetch_lock);
+
+    int end = std::min(n + 1 + prefetch_frames, vi->numFrames);
 
-    if (!errSe) {
-        for (int i = n + 1; i < std::min<int>(n + parent->num_threads, parent->vi->numFrames); i++) {
-            ++parent->pending_requests;
-            vsapi->getFrameAsync(i, parent->videoNode, VapourSynthFile::frameDoneCallback, static_cast<void *>(parent));
+    for (int i = n + 1; i < end; i++) {
+        PrefetchedFrame *slot = nullptr;
+        bool requested = false;
+
+        // finished frames outside of the window can be reused, pending ones have to complete first
+        for (auto &iter : prefetch_ring) {
+            if (iter.n == i) {
+                requested = true;
+                break;
+            } else if (!slot && (iter.n < 0 || (iter.done && (iter.n <= n || iter.n >= end)))) {
+                slot = &iter;
+            }
+        }
+
+        if (requested)
+            continue;
+        if (!slot)
+            break;
+
+        slot->n = i;
+        slot->done = false;
+        slot->success = false;
+        slot->packed.resize(ImageSize());
+
+        ++pending_requests;
+        vsapi->getFrameAsync(i, videoNode, VapourSynthFile::frameDoneCallback, static_cast<void *>(this));
+    }
+}
+
+bool VapourSynthFile::TakePrefetched(int n, void *lpBuffer) {
+    std::unique_lock<std::mutex> lock(prefetch_lock);
+
+    for (auto &iter : prefetch_ring) {
+        if (iter.n == n) {
+            prefetch_done.wait(lock, [&iter] { return iter.done; });
+
+            bool success = iter.success;
+            if (success)
+                memcpy(lpBuffer, iter.packed.data(), iter.packed.size());
+            iter.n = -1;
+            iter.done = false;
+            return success;
+        }
+    }
+
+    return false;
+}
+
+bool VapourSynthStream::ReadFrame(void* lpBuffer, int n) {
+    const VSAPI *vsapi = parent->vsapi;
+    const VSSCRIPTAPI *vssapi = parent->vssapi;
+
+    // only prefetch when reading forward one frame at a time
+    bool sequential = (n == parent->last_read + 1 && parent->last_read >= 0);
+    parent->last_read = n;
+
+    if (parent->TakePrefetched(n, lpBuffer)) {
+        parent->Prefetch(n);
+        return true;
+    }
+
+    std::vector<char> errMsg(32 * 1024);
+    const VSFrame *f = vsapi->getFrame(n, parent->videoNode, errMsg.data(), static_cast<int>(errMsg.size()));
+    VSScript *errSe = nullptr;
+    if (!f) {
+        std::string matrix;
+        if (parent->vi->format.colorFamily == cfYUV || parent->vi->format.colorFamily == cfGray)
+            matrix = ", matrix_s=\"709\"";
+
+        char nameBuffer[32];
+        vsapi->getVideoFormatName(&parent->vi->format, nameBuffer);
+
+        std::string frameErrorScript = "import vapoursynth as vs\nimport sys\ncore = vs.get_core()\n";
+        frameErrorScript += "err_script_formatid = " + std::string(nameBuffer) + "\n";
+        frameErrorScript += "err_script_width = " + std::to_string(parent->vi->width) + "\n";
+        frameErrorScript += "err_script_height = " + std::to_string(parent->vi->height) + "\n";
+        frameErrorScript += "err_script_background = core.std.BlankClip(width=err_script_width, height=err_script_height, format=vs.RGB24)\n";
+        frameErrorScript += "err_script_clip = core.text.Text(err_script_background, r\"\"\"";
+        frameErrorScript += errMsg.data();
+        frameErrorScript += "\"\"\")\n";
+        frameErrorScript += "err_script_clip = core.resize.Bilinear(err_script_clip, format=err_script_formatid" + matrix + ")\n";
+        frameErrorScript += "err_script_clip.set_output()\n";
+
+        errSe = vssapi->evaluateBuffer(frameErrorScript.c_str(), "vfw_error.message", nullptr, 0);
+        VSNode *node = vssapi->getOutputNode(errSe, 0);
+        f = vsapi->getFrame(0, node, nullptr, 0);
+        vsapi->freeNode(node);
+
+        if (!f) {
+            vssapi->freeScript(errSe);
+            return false;
         }
     }
 
+    parent->PackFrame(f, lpBuffer);
+
+    vsapi->freeFrame(f);
+    vssapi->freeScript(errSe);
+
+    if (!errSe && sequential)
+        parent->Prefetch(n);
+
     return !errSe;
 }
 
@@ -911,20 +1094,22 @@ HRESULT VapourSynthStream::Read2(LONG lStart, LONG lSamples, LPVOID lpBuffer, LO
 
         const VSAudioFormat &af = ai->format;
 
-        int startFrame = lStart / VS_AUDIO_FRAME_SAMPLES;
-        int endFrame = (lStart + lSamples - 1) / VS_AUDIO_FRAME_SAMPLES;
+        const VSAPI *vsapi = parent->vsapi;
+        int frameSamples = vsapi->getAudioFrameSamples(parent->vssapi->getCore(parent->se));
+
+        int startFrame = lStart / frameSamples;
+        int endFrame = (lStart + lSamples - 1) / frameSamples;
 
         std::vector<const uint8_t *> tmp;
         tmp.resize(ai->format.numChannels);
 
-        const VSAPI *vsapi = parent->vsapi;
         size_t dstPos = 0;
 
         for (int i = startFrame; i <= endFrame; i++) {
             const VSFrame *f = vsapi->getFrame(i, parent->audioNode, nullptr, 0);
-            int64_t firstFrameSample = i * static_cast<int64_t>(VS_AUDIO_FRAME_SAMPLES);
+            int64_t firstFrameSample = i * static_cast<int64_t>(frameSamples);
             size_t offset = 0;
-            size_t copyLength = VS_AUDIO_FRAME_SAMPLES;
+            size_t copyLength = frameSamples;
             if (firstFrameSample < lStart) {
                 offset = (lStart - firstFrameSample) * bytesPerOutputSample;
                 copyLength -= (lStart - firstFrameSample);
@@ -0,0 +1,182 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "directoutput.h"
+#include "VSHelper4.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef VS_TARGET_OS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "../common/vsutf16.h"
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static size_t alignSize(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+DirectOutput *DirectOutput::create(const std::string &filename, std::string &error) {
+    DirectOutput *output = new DirectOutput();
+
+#ifdef VS_TARGET_OS_WINDOWS
+    output->handle = CreateFileW(utf16_from_utf8(filename).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+    if (output->handle == INVALID_HANDLE_VALUE) {
+        output->handle = nullptr;
+        error = "Failed to open " + filename + " for unbuffered writing, error: " + std::to_string(GetLastError());
+        delete output;
+        return nullptr;
+    }
+#else
+#ifdef O_DIRECT
+    output->fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+#else
+    output->fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+#endif
+    if (output->fd < 0) {
+        error = "Failed to open " + filename + " for unbuffered writing, errno: " + std::to_string(errno);
+        delete output;
+        return nullptr;
+    }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    fcntl(output->fd, F_NOCACHE, 1);
+#endif
+#endif
+
+    output->capacity = flushSize + alignment;
+    output->buffer = vsh::vsh_aligned_malloc<uint8_t>(output->capacity, alignment);
+    return output;
+}
+
+DirectOutput::~DirectOutput() {
+#ifdef VS_TARGET_OS_WINDOWS
+    if (handle)
+        CloseHandle(handle);
+#else
+    if (fd >= 0)
+        close(fd);
+#endif
+    vsh::vsh_aligned_free(buffer);
+}
+
+void DirectOutput::preallocate(int64_t size) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE_ALLOCATION_INFO info = {};
+    info.AllocationSize.QuadPart = size;
+    SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info));
+#elif defined(VS_TARGET_OS_LINUX)
+    // the file size only grows with the writes so an aborted run never leaves zeroes at the end
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size);
+#else
+    (void)size;
+#endif
+}
+
+// size has to be a multiple of the alignment unless it's the last write
+bool DirectOutput::writeBlocks(size_t size) {
+    size_t written = 0;
+    while (written < size) {
+#ifdef VS_TARGET_OS_WINDOWS
+        DWORD result = 0;
+        if (!WriteFile(handle, buffer + written, static_cast<DWORD>(std::min<size_t>(size - written, 0x40000000)), &result, nullptr))
+            return false;
+#else
+        ssize_t result = pwrite(fd, buffer + written, size - written, fileOffset + written);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+#endif
+        written += result;
+    }
+    fileOffset += size;
+    return true;
+}
+
+uint8_t *DirectOutput::acquire(size_t size) {
+    if (used + size > capacity) {
+        size_t newCapacity = alignSize(used + size, alignment);
+        uint8_t *newBuffer = vsh::vsh_aligned_malloc<uint8_t>(newCapacity, alignment);
+        memcpy(newBuffer, buffer, used);
+        vsh::vsh_aligned_free(buffer);
+        buffer = newBuffer;
+        capacity = newCapacity;
+    }
+    return buffer + used;
+}
+
+bool DirectOutput::commit(size_t size) {
+    used += size;
+    if (used < flushSize)
+        return true;
+
+    // only whole blocks can be written, the rest moves to the start of the buffer
+    size_t blocks = used & ~(alignment - 1);
+    if (!writeBlocks(blocks))
+        return false;
+    memmove(buffer, buffer + blocks, used - blocks);
+    used -= blocks;
+    return true;
+}
+
+bool DirectOutput::write(const void *data, size_t size) {
+    memcpy(acquire(size), data, size);
+    return commit(size);
+}
+
+bool DirectOutput::finish(std::string &error) {
+    int64_t totalSize = fileOffset + used;
+
+#ifdef VS_TARGET_OS_WINDOWS
+    // the last block is padded and cut off again afterwards
+    size_t padded = alignSize(used, alignment);
+    memset(buffer + used, 0, padded - used);
+    LARGE_INTEGER position;
+    position.QuadPart = totalSize;
+    if (!writeBlocks(padded) || !SetFilePointerEx(handle, position, nullptr, FILE_BEGIN) || !SetEndOfFile(handle)) {
+        error = "Error: failed to finish unbuffered output, error: " + std::to_string(GetLastError());
+        return false;
+    }
+#else
+    // the tail can't be written with O_DIRECT so it's turned off for the last write
+    size_t blocks = used & ~(alignment - 1);
+    bool success = writeBlocks(blocks);
+    if (success && used > blocks) {
+        memmove(buffer, buffer + blocks, used - blocks);
+#ifdef O_DIRECT
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+#endif
+        success = writeBlocks(used - blocks);
+    }
+
+    if (!success || ftruncate(fd, totalSize)) {
+        error = "Error: failed to finish unbuffered output, errno: " + std::to_string(errno);
+        return false;
+    }
+#endif
+
+    used = 0;
+    return true;
+}
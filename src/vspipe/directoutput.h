@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef DIRECTOUTPUT_H
+#define DIRECTOUTPUT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Unbuffered file output for vspipe. The file is opened with O_DIRECT (F_NOCACHE on macOS) or FILE_FLAG_NO_BUFFERING
+// so the output doesn't pass through the page cache, which requires every write to be aligned in position, size and
+// memory. Everything is staged in an aligned buffer and written out in large aligned blocks, the last partial block is
+// written when finishing and the file is then truncated to the exact size. Failed writes leave the cause in errno or
+// GetLastError().
+
+class DirectOutput {
+private:
+    static const size_t alignment = 4096;
+    static const size_t flushSize = 8 * 1024 * 1024;
+#ifdef VS_TARGET_OS_WINDOWS
+    void *handle = nullptr;
+#else
+    int fd = -1;
+#endif
+    uint8_t *buffer = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    int64_t fileOffset = 0;
+    DirectOutput() = default;
+    bool writeBlocks(size_t size);
+public:
+    static DirectOutput *create(const std::string &filename, std::string &error);
+    ~DirectOutput();
+
+    // reserves the expected size on disk so the file isn't fragmented, failures are ignored since it's only a hint
+    void preallocate(int64_t size);
+    // returns space for size bytes in the staging buffer, they're only written once passed to commit()
+    uint8_t *acquire(size_t size);
+    bool commit(size_t size);
+    bool write(const void *data, size_t size);
+    // writes everything that's left and sets the file to the size actually written
+    bool finish(std::string &error);
+};
+
+#endif
@@ -0,0 +1,370 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "graphplan.h"
+#include "VSHelper4.h"
+#include <map>
+#include <algorithm>
+#include <cstring>
+
+// A plan starts with the magic, version and the output index it was made for. It's followed by the number of plugins
+// and the identifier and path of each of them, then the number of calls with the plugin identifier, function name and
+// arguments of each and finally a node reference to the output and a flag with another reference for the alpha.
+// Calls only refer to nodes returned by earlier calls. Strings are stored as their length followed by the bytes.
+//
+// Arguments are stored as the number of keys followed by the key, type and number of elements for every key. Ints and
+// floats are stored as int64_t and double, data as the type hint, the size and the bytes and nodes as a reference
+// which is the index of the call followed by the key and index the call returned the node under.
+
+static void put(std::vector<uint8_t> &buffer, const void *data, size_t size) {
+    buffer.insert(buffer.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+}
+
+template<typename T>
+static void put(std::vector<uint8_t> &buffer, T value) {
+    put(buffer, &value, sizeof(value));
+}
+
+static void putString(std::vector<uint8_t> &buffer, const std::string &s) {
+    put(buffer, static_cast<uint32_t>(s.size()));
+    put(buffer, s.data(), s.size());
+}
+
+bool isGraphPlan(const std::vector<uint8_t> &data) {
+    uint32_t magic;
+    if (data.size() < sizeof(magic))
+        return false;
+    memcpy(&magic, data.data(), sizeof(magic));
+    return magic == graphPlanMagic;
+}
+
+namespace {
+
+class PlanWriter {
+    const VSAPI *vsapi;
+    // calls are identified by their recorded arguments since all nodes created by the same call share them
+    std::map<const VSMap *, uint32_t> callIndices;
+    std::map<std::string, std::string> plugins;
+    std::vector<uint8_t> calls;
+    uint32_t numCalls = 0;
+
+    bool addCall(VSNode *node, const VSMap *args, std::string &error) {
+        const char *name = vsapi->getNodeCreationFunctionName(node, 0);
+        VSPlugin *plugin = vsapi->getNodeCreationFunctionPlugin(node, 0);
+        if (!name || !plugin) {
+            error = std::string("The function that created ") + vsapi->getNodeName(node) + " wasn't recorded";
+            return false;
+        }
+
+        std::vector<uint8_t> argData;
+        int numKeys = vsapi->mapNumKeys(args);
+        put(argData, static_cast<uint32_t>(numKeys));
+
+        for (int i = 0; i < numKeys; i++) {
+            const char *key = vsapi->mapGetKey(args, i);
+            int type = vsapi->mapGetType(args, key);
+            int numElements = vsapi->mapNumElements(args, key);
+            putString(argData, key);
+            put(argData, static_cast<uint32_t>(type));
+            put(argData, static_cast<uint32_t>(std::max(numElements, 0)));
+
+            if (type == ptInt) {
+                put(argData, vsapi->mapGetIntArray(args, key, nullptr), numElements * sizeof(int64_t));
+            } else if (type == ptFloat) {
+                put(argData, vsapi->mapGetFloatArray(args, key, nullptr), numElements * sizeof(double));
+            } else if (type == ptData) {
+                for (int j = 0; j < numElements; j++) {
+                    put(argData, static_cast<int32_t>(vsapi->mapGetDataTypeHint(args, key, j, nullptr)));
+                    put(argData, static_cast<uint32_t>(vsapi->mapGetDataSize(args, key, j, nullptr)));
+                    put(argData, vsapi->mapGetData(args, key, j, nullptr), vsapi->mapGetDataSize(args, key, j, nullptr));
+                }
+            } else if (type == ptVideoNode || type == ptAudioNode) {
+                for (int j = 0; j < numElements; j++) {
+                    VSNode *ref = vsapi->mapGetNode(args, key, j, nullptr);
+                    bool success = addNode(argData, ref, error);
+                    vsapi->freeNode(ref);
+                    if (!success)
+                        return false;
+                }
+            } else if (numElements > 0) {
+                error = std::string(name) + " was passed a function or frame as " + key + ", graphs using them can't be stored";
+                return false;
+            }
+        }
+
+        const char *path = vsapi->getPluginPath(plugin);
+        plugins[vsapi->getPluginID(plugin)] = path ? path : "";
+
+        putString(calls, vsapi->getPluginID(plugin));
+        putString(calls, name);
+        put(calls, argData.data(), argData.size());
+        callIndices[args] = numCalls++;
+        return true;
+    }
+
+public:
+    explicit PlanWriter(const VSAPI *vsapi) : vsapi(vsapi) {}
+
+    bool addNode(std::vector<uint8_t> &buffer, VSNode *node, std::string &error) {
+        const VSMap *args = vsapi->getNodeCreationFunctionArguments(node, 0);
+        int index = 0;
+        const char *key = vsapi->getNodeCreationFunctionOutput(node, &index);
+        if (!args || !key) {
+            error = std::string(vsapi->getNodeName(node)) + " wasn't returned by the function that created it, graphs without graph inspection or with nodes made by scripts can't be stored";
+            return false;
+        }
+
+        auto iter = callIndices.find(args);
+        if (iter == callIndices.end()) {
+            if (!addCall(node, args, error))
+                return false;
+            iter = callIndices.find(args);
+        }
+
+        put(buffer, iter->second);
+        putString(buffer, key);
+        put(buffer, static_cast<int32_t>(index));
+        return true;
+    }
+
+    void write(std::vector<uint8_t> &buffer) {
+        put(buffer, static_cast<uint32_t>(plugins.size()));
+        for (const auto &iter : plugins) {
+            putString(buffer, iter.first);
+            putString(buffer, iter.second);
+        }
+        put(buffer, numCalls);
+        put(buffer, calls.data(), calls.size());
+    }
+};
+
+class PlanReader {
+    const uint8_t *data;
+    size_t size;
+public:
+    PlanReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    const uint8_t *take(size_t n) {
+        if (n > size)
+            return nullptr;
+        const uint8_t *result = data;
+        data += n;
+        size -= n;
+        return result;
+    }
+
+    template<typename T>
+    bool read(T &value) {
+        const uint8_t *p = take(sizeof(T));
+        if (p)
+            memcpy(&value, p, sizeof(T));
+        return !!p;
+    }
+
+    bool readString(std::string &s) {
+        uint32_t length;
+        if (!read(length))
+            return false;
+        const uint8_t *p = take(length);
+        if (p)
+            s.assign(reinterpret_cast<const char *>(p), length);
+        return !!p;
+    }
+};
+
+}
+
+bool writeGraphPlan(std::vector<uint8_t> &buffer, int outputIndex, VSNode *node, VSNode *alphaNode, const VSAPI *vsapi, std::string &error) {
+    PlanWriter writer(vsapi);
+    std::vector<uint8_t> outputs;
+    if (!writer.addNode(outputs, node, error))
+        return false;
+    put(outputs, static_cast<uint32_t>(!!alphaNode));
+    if (alphaNode && !writer.addNode(outputs, alphaNode, error))
+        return false;
+
+    buffer.clear();
+    put(buffer, graphPlanMagic);
+    put(buffer, graphPlanVersion);
+    put(buffer, static_cast<int32_t>(outputIndex));
+    writer.write(buffer);
+    put(buffer, outputs.data(), outputs.size());
+    return true;
+}
+
+static VSNode *readNodeReference(PlanReader &reader, const std::vector<VSMap *> &results, const VSAPI *vsapi) {
+    uint32_t call;
+    std::string key;
+    int32_t index;
+    int err;
+    if (!reader.read(call) || !reader.readString(key) || !reader.read(index) || call >= results.size())
+        return nullptr;
+    return vsapi->mapGetNode(results[call], key.c_str(), index, &err);
+}
+
+static bool readArguments(PlanReader &reader, VSMap *args, const std::vector<VSMap *> &results, const VSAPI *vsapi) {
+    uint32_t numKeys;
+    if (!reader.read(numKeys))
+        return false;
+
+    for (uint32_t i = 0; i < numKeys; i++) {
+        std::string key;
+        uint32_t type, numElements;
+        if (!reader.readString(key) || !reader.read(type) || !reader.read(numElements))
+            return false;
+
+        if (numElements == 0) {
+            vsapi->mapSetEmpty(args, key.c_str(), type);
+        } else if (type == ptInt || type == ptFloat) {
+            const uint8_t *values = reader.take(static_cast<size_t>(numElements) * 8);
+            if (!values)
+                return false;
+            // the values aren't necessarily aligned in the buffer
+            if (type == ptInt) {
+                std::vector<int64_t> ints(numElements);
+                memcpy(ints.data(), values, numElements * sizeof(int64_t));
+                vsapi->mapSetIntArray(args, key.c_str(), ints.data(), numElements);
+            } else {
+                std::vector<double> floats(numElements);
+                memcpy(floats.data(), values, numElements * sizeof(double));
+                vsapi->mapSetFloatArray(args, key.c_str(), floats.data(), numElements);
+            }
+        } else if (type == ptData) {
+            for (uint32_t j = 0; j < numElements; j++) {
+                int32_t hint;
+                uint32_t dataSize;
+                if (!reader.read(hint) || !reader.read(dataSize))
+                    return false;
+                const uint8_t *bytes = reader.take(dataSize);
+                if (!bytes)
+                    return false;
+                vsapi->mapSetData(args, key.c_str(), reinterpret_cast<const char *>(bytes), dataSize, hint, maAppend);
+            }
+        } else if (type == ptVideoNode || type == ptAudioNode) {
+            for (uint32_t j = 0; j < numElements; j++) {
+                VSNode *ref = readNodeReference(reader, results, vsapi);
+                if (!ref)
+                    return false;
+                vsapi->mapConsumeNode(args, key.c_str(), ref, maAppend);
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool loadGraphPlan(const std::vector<uint8_t> &data, int outputIndex, VSCore *core, const VSAPI *vsapi, VSNode *&node, VSNode *&alphaNode, std::string &error) {
+    node = nullptr;
+    alphaNode = nullptr;
+
+    PlanReader reader(data.data(), data.size());
+    uint32_t magic, version, numPlugins;
+    int32_t planOutputIndex;
+    if (!reader.read(magic) || magic != graphPlanMagic || !reader.read(version) || version != graphPlanVersion || !reader.read(planOutputIndex)) {
+        error = "Unsupported graph plan version";
+        return false;
+    }
+
+    if (planOutputIndex != outputIndex) {
+        error = "The graph plan was made for output index " + std::to_string(planOutputIndex);
+        return false;
+    }
+
+    if (!reader.read(numPlugins)) {
+        error = "Corrupt graph plan";
+        return false;
+    }
+
+    // plugins that were loaded by the script itself aren't autoloaded
+    for (uint32_t i = 0; i < numPlugins; i++) {
+        std::string id, path;
+        if (!reader.readString(id) || !reader.readString(path)) {
+            error = "Corrupt graph plan";
+            return false;
+        }
+
+        if (vsapi->getPluginByID(id.c_str(), core))
+            continue;
+
+        if (path.empty()) {
+            error = "Plugin " + id + " isn't available";
+            return false;
+        }
+
+        VSMap *args = vsapi->createMap();
+        vsapi->mapSetData(args, "path", path.c_str(), static_cast<int>(path.size()), dtUtf8, maReplace);
+        VSMap *result = vsapi->invoke(vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core), "LoadPlugin", args);
+        vsapi->freeMap(args);
+        if (vsapi->mapGetError(result))
+            error = vsapi->mapGetError(result);
+        vsapi->freeMap(result);
+        if (!error.empty())
+            return false;
+    }
+
+    std::vector<VSMap *> results;
+    uint32_t numCalls;
+    bool success = reader.read(numCalls);
+
+    for (uint32_t i = 0; success && i < numCalls; i++) {
+        std::string id, name;
+        VSMap *args = vsapi->createMap();
+        if (!reader.readString(id) || !reader.readString(name) || !readArguments(reader, args, results, vsapi)) {
+            vsapi->freeMap(args);
+            success = false;
+            break;
+        }
+
+        VSPlugin *plugin = vsapi->getPluginByID(id.c_str(), core);
+        VSMap *result = plugin ? vsapi->invoke(plugin, name.c_str(), args) : nullptr;
+        vsapi->freeMap(args);
+        if (!result || vsapi->mapGetError(result)) {
+            error = id + "." + name + ": " + (result ? vsapi->mapGetError(result) : "plugin not found");
+            vsapi->freeMap(result);
+            break;
+        }
+        results.push_back(result);
+    }
+
+    if (success && error.empty()) {
+        uint32_t hasAlpha;
+        node = readNodeReference(reader, results, vsapi);
+        if (!node || !reader.read(hasAlpha) || (hasAlpha && !(alphaNode = readNodeReference(reader, results, vsapi))))
+            success = false;
+    }
+
+    if (!success && error.empty())
+        error = "Corrupt graph plan";
+
+    for (auto &iter : results)
+        vsapi->freeMap(iter);
+
+    if (!error.empty()) {
+        vsapi->freeNode(node);
+        vsapi->freeNode(alphaNode);
+        node = nullptr;
+        alphaNode = nullptr;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef GRAPHPLAN_H
+#define GRAPHPLAN_H
+
+#include <VapourSynth4.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A graph plan is the list of function calls that produced an output of a script, replaying them through invoke() gives
+// back the same graph without having to start Python. Creating a plan needs a core with ccfEnableGraphInspection and
+// fails if any call got a function or frame as an argument since those only exist in the script that made them.
+
+static const uint32_t graphPlanMagic = 0x4E505356; // VSPN
+static const uint32_t graphPlanVersion = 1;
+
+bool isGraphPlan(const std::vector<uint8_t> &data);
+bool writeGraphPlan(std::vector<uint8_t> &buffer, int outputIndex, VSNode *node, VSNode *alphaNode, const VSAPI *vsapi, std::string &error);
+bool loadGraphPlan(const std::vector<uint8_t> &data, int outputIndex, VSCore *core, const VSAPI *vsapi, VSNode *&node, VSNode *&alphaNode, std::string &error);
+
+#endif
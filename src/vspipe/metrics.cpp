@@ -0,0 +1,275 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "metrics.h"
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+#ifdef VS_TARGET_OS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef SOCKET socket_t;
+static const socket_t invalidSocket = INVALID_SOCKET;
+static void closeSocket(socket_t s) { closesocket(s); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+static const socket_t invalidSocket = -1;
+static void closeSocket(socket_t s) { close(s); }
+#endif
+
+// how long a blocking call may take before the stop flag is checked again
+static const int pollInterval = 200;
+
+static bool waitReadable(socket_t s) {
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(s, &set);
+    timeval tv = { 0, pollInterval * 1000 };
+    return select(static_cast<int>(s + 1), &set, nullptr, nullptr, &tv) > 0;
+}
+
+static void collectNodes(std::vector<VSNode *> &nodes, std::set<VSNode *> &visited, VSNode *node, const VSAPI *vsapi) {
+    if (!visited.insert(node).second)
+        return;
+    nodes.push_back(node);
+
+    int numDeps = vsapi->getNumNodeDependencies(node);
+    const VSFilterDependency *deps = vsapi->getNodeDependencies(node);
+    for (int i = 0; i < numDeps; i++)
+        collectNodes(nodes, visited, deps[i].source, vsapi);
+}
+
+static std::string escapeLabel(const char *s) {
+    std::string result;
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            result += '\\';
+        if (*s == '\n')
+            result += "\\n";
+        else
+            result += *s;
+    }
+    return result;
+}
+
+static void addFamily(std::string &s, const char *name, const char *type, const char *help) {
+    s += "# TYPE ";
+    s += name;
+    s += " ";
+    s += type;
+    s += "\n# HELP ";
+    s += name;
+    s += " ";
+    s += help;
+    s += "\n";
+}
+
+static void addSample(std::string &s, const char *name, const char *suffix, const std::string &labels, int64_t value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), " %lld\n", static_cast<long long>(value));
+    s += name;
+    s += suffix;
+    s += labels;
+    s += buffer;
+}
+
+static void addSample(std::string &s, const char *name, const char *suffix, const std::string &labels, double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), " %.9g\n", value);
+    s += name;
+    s += suffix;
+    s += labels;
+    s += buffer;
+}
+
+MetricsExporter::MetricsExporter(const VSAPI *vsapi, VSCore *core) : vsapi(vsapi), core(core), stop(false) {
+}
+
+MetricsExporter *MetricsExporter::create(int port, VSNode *node, VSCore *core, const VSAPI *vsapi, std::string &error) {
+#ifdef VS_TARGET_OS_WINDOWS
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+        error = "Failed to initialize winsock";
+        return nullptr;
+    }
+#endif
+
+    socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == invalidSocket) {
+        error = "Failed to create metrics socket";
+        return nullptr;
+    }
+
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) || listen(s, 4)) {
+        closeSocket(s);
+        error = "Failed to listen on port " + std::to_string(port) + " for metrics";
+        return nullptr;
+    }
+
+    MetricsExporter *exporter = new MetricsExporter(vsapi, core);
+    std::set<VSNode *> visited;
+    collectNodes(exporter->nodes, visited, node, vsapi);
+    exporter->listenSocket = static_cast<intptr_t>(s);
+    exporter->thread = std::thread(&MetricsExporter::run, exporter);
+    return exporter;
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop = true;
+    if (thread.joinable())
+        thread.join();
+    if (listenSocket != -1)
+        closeSocket(static_cast<socket_t>(listenSocket));
+#ifdef VS_TARGET_OS_WINDOWS
+    WSACleanup();
+#endif
+}
+
+void MetricsExporter::run() {
+    socket_t s = static_cast<socket_t>(listenSocket);
+    while (!stop) {
+        if (!waitReadable(s))
+            continue;
+        socket_t client = accept(s, nullptr, nullptr);
+        if (client == invalidSocket)
+            continue;
+        serveClient(static_cast<intptr_t>(client));
+        closeSocket(client);
+    }
+}
+
+void MetricsExporter::serveClient(intptr_t clientHandle) {
+    socket_t client = static_cast<socket_t>(clientHandle);
+
+    // only the request line matters, headers are read until the blank line and then ignored
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        if (stop || !waitReadable(client))
+            return;
+        int n = recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            return;
+        request.append(buffer, n);
+    }
+
+    std::string response;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+        std::string body = formatMetrics();
+        response = "HTTP/1.1 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    } else {
+        response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        int n = send(client, response.data() + sent, static_cast<int>(response.size() - sent), 0);
+        if (n <= 0)
+            return;
+        sent += n;
+    }
+}
+
+std::string MetricsExporter::formatMetrics() {
+    std::string s;
+
+    VSCoreInfo info;
+    vsapi->getCoreInfo(core, &info);
+    VSMap *stats = vsapi->createMap();
+    vsapi->getCoreStatistics(core, stats);
+
+    addFamily(s, "vs_threads", "gauge", "Number of worker threads");
+    addSample(s, "vs_threads", "", "", static_cast<int64_t>(info.numThreads));
+    addFamily(s, "vs_threads_active", "gauge", "Worker threads currently running tasks");
+    addSample(s, "vs_threads_active", "", "", vsapi->mapGetInt(stats, "activeThreads", 0, nullptr));
+    addFamily(s, "vs_threads_idle", "gauge", "Worker threads waiting for work");
+    addSample(s, "vs_threads_idle", "", "", vsapi->mapGetInt(stats, "idleThreads", 0, nullptr));
+    addFamily(s, "vs_queued_tasks", "gauge", "Frame requests waiting in the thread pool");
+    addSample(s, "vs_queued_tasks", "", "", vsapi->mapGetInt(stats, "queuedTasks", 0, nullptr));
+    addFamily(s, "vs_memory_used_bytes", "gauge", "Memory used by frames");
+    addSample(s, "vs_memory_used_bytes", "", "", vsapi->mapGetInt(stats, "memoryUsed", 0, nullptr));
+    addFamily(s, "vs_memory_limit_bytes", "gauge", "Framebuffer cache limit");
+    addSample(s, "vs_memory_limit_bytes", "", "", vsapi->mapGetInt(stats, "memoryLimit", 0, nullptr));
+    addFamily(s, "vs_scheduling_seconds", "counter", "Time worker threads spent in the scheduler");
+    addSample(s, "vs_scheduling_seconds", "_total", "", vsapi->mapGetInt(stats, "schedulingTime", 0, nullptr) / 1e9);
+    addFamily(s, "vs_filter_seconds", "counter", "Time worker threads spent in filter code");
+    addSample(s, "vs_filter_seconds", "_total", "", vsapi->mapGetInt(stats, "filterTime", 0, nullptr) / 1e9);
+
+    struct NodeSample {
+        std::string labels;
+        int64_t frames;
+        int64_t processingTime;
+        int64_t cacheHits;
+        int64_t cacheMisses;
+        int64_t cacheBytes;
+    };
+
+    std::vector<NodeSample> samples;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        vsapi->clearMap(stats);
+        vsapi->getNodeStatistics(nodes[i], stats);
+        // the index tells apart several instances of the same filter, it follows the graph from the output
+        NodeSample sample = { "{node=\"" + std::to_string(i) + "\",filter=\"" + escapeLabel(vsapi->getNodeName(nodes[i])) + "\"}",
+            vsapi->mapGetInt(stats, "framesProduced", 0, nullptr), vsapi->mapGetInt(stats, "processingTime", 0, nullptr),
+            vsapi->mapGetInt(stats, "cacheHits", 0, nullptr), vsapi->mapGetInt(stats, "cacheNearMisses", 0, nullptr) + vsapi->mapGetInt(stats, "cacheMisses", 0, nullptr),
+            vsapi->mapGetInt(stats, "cacheBytes", 0, nullptr) };
+        samples.push_back(sample);
+    }
+    vsapi->freeMap(stats);
+
+    addFamily(s, "vs_node_frames", "counter", "Frames returned by the filter");
+    for (const auto &iter : samples)
+        addSample(s, "vs_node_frames", "_total", iter.labels, iter.frames);
+    addFamily(s, "vs_node_processing_seconds", "counter", "Time spent in the filter, only measured with graph inspection or cost aware eviction");
+    for (const auto &iter : samples)
+        addSample(s, "vs_node_processing_seconds", "_total", iter.labels, iter.processingTime / 1e9);
+    addFamily(s, "vs_node_cache_hits", "counter", "Frame requests served from the cache");
+    for (const auto &iter : samples)
+        addSample(s, "vs_node_cache_hits", "_total", iter.labels, iter.cacheHits);
+    addFamily(s, "vs_node_cache_misses", "counter", "Frame requests the cache couldn't serve");
+    for (const auto &iter : samples)
+        addSample(s, "vs_node_cache_misses", "_total", iter.labels, iter.cacheMisses);
+    addFamily(s, "vs_node_cache_hit_ratio", "gauge", "Share of cache lookups that were hits");
+    for (const auto &iter : samples)
+        addSample(s, "vs_node_cache_hit_ratio", "", iter.labels, (iter.cacheHits + iter.cacheMisses) ? static_cast<double>(iter.cacheHits) / (iter.cacheHits + iter.cacheMisses) : 0.);
+    addFamily(s, "vs_node_cache_bytes", "gauge", "Memory held by the cache");
+    for (const auto &iter : samples)
+        addSample(s, "vs_node_cache_bytes", "", iter.labels, iter.cacheBytes);
+
+    s += "# EOF\n";
+    return s;
+}
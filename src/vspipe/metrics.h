@@ -0,0 +1,55 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <VapourSynth4.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP server that answers GET /metrics with the core and node statistics in the OpenMetrics text format
+// so a render can be scraped by Prometheus while it runs. It only listens on the loopback interface and handles one
+// connection at a time. Everything is read with getCoreStatistics() and getNodeStatistics() which never stop the pool.
+
+class MetricsExporter {
+private:
+    const VSAPI *vsapi;
+    VSCore *core;
+    // the graph can't change after the script has been evaluated so the nodes are collected once,
+    // they're kept alive by the output node which must outlive the exporter
+    std::vector<VSNode *> nodes;
+    intptr_t listenSocket = -1;
+    std::atomic<bool> stop;
+    std::thread thread;
+
+    MetricsExporter(const VSAPI *vsapi, VSCore *core);
+    void run();
+    void serveClient(intptr_t client);
+    std::string formatMetrics();
+public:
+    static MetricsExporter *create(int port, VSNode *node, VSCore *core, const VSAPI *vsapi, std::string &error);
+    ~MetricsExporter();
+};
+
+#endif
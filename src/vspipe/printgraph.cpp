@@ -22,6 +22,7 @@
 #include <set>
 #include <map>
 #include <list>
+#include <vector>
 #include <algorithm>
 #include <cstring>
 #include <climits>
@@ -156,6 +157,13 @@ struct NodeTimeRecord {
     std::string filterName;
     int filterMode;
     int64_t nanoSeconds;
+    int64_t latency[3];
+    int64_t cacheHits;
+    int64_t cacheLookups;
+    int64_t lockWaitTime;
+    int64_t cacheBytes;
+    int64_t liveBytes;
+    int64_t peakBytes;
 
     bool operator<(const NodeTimeRecord &other) const noexcept {
         return nanoSeconds > other.nanoSeconds;
@@ -166,7 +174,15 @@ static void printNodeTimesHelper(std::list<NodeTimeRecord> &lines, std::set<VSNo
     if (!visited.insert(node).second)
         return;
 
-    lines.push_back(NodeTimeRecord{ vsapi->getNodeName(node), vsapi->getNodeFilterMode(node), vsapi->getNodeFilterTime(node) } );
+    VSMap *stats = vsapi->createMap();
+    vsapi->getNodeStatistics(node, stats);
+    int64_t cacheHits = vsapi->mapGetInt(stats, "cacheHits", 0, nullptr);
+    int64_t cacheLookups = cacheHits + vsapi->mapGetInt(stats, "cacheNearMisses", 0, nullptr) + vsapi->mapGetInt(stats, "cacheMisses", 0, nullptr);
+    lines.push_back(NodeTimeRecord{ vsapi->getNodeName(node), vsapi->getNodeFilterMode(node), vsapi->getNodeFilterTime(node),
+        { vsapi->mapGetInt(stats, "latencyP50", 0, nullptr), vsapi->mapGetInt(stats, "latencyP95", 0, nullptr), vsapi->mapGetInt(stats, "latencyP99", 0, nullptr) },
+        cacheHits, cacheLookups, vsapi->mapGetInt(stats, "serialLockWaitTime", 0, nullptr), vsapi->mapGetInt(stats, "cacheBytes", 0, nullptr),
+        vsapi->mapGetInt(stats, "memoryLiveBytes", 0, nullptr), vsapi->mapGetInt(stats, "memoryPeakBytes", 0, nullptr) } );
+    vsapi->freeMap(stats);
 
     int numDeps = vsapi->getNumNodeDependencies(node);
     const VSFilterDependency *deps = vsapi->getNodeDependencies(node);
@@ -208,6 +224,84 @@ static std::string filterModeToString(int fm) {
         return "unordered";
 }
 
+struct NodeProfileRecord {
+    VSNode *node;
+    int64_t nanoSeconds;
+    int64_t frames;
+    int64_t cacheHits;
+    int64_t cacheLookups;
+    int64_t cacheBytes;
+    int64_t lockWaitTime;
+};
+
+struct EdgeProfileRecord {
+    VSNode *source;
+    VSNode *consumer;
+    int64_t requests;
+};
+
+static void printNodeProfileGraphHelper(std::vector<NodeProfileRecord> &nodes, std::vector<EdgeProfileRecord> &edges, std::set<VSNode *> &visited, VSNode *node, const VSAPI *vsapi) {
+    if (!visited.insert(node).second)
+        return;
+
+    VSMap *stats = vsapi->createMap();
+    vsapi->getNodeStatistics(node, stats);
+    int64_t cacheHits = vsapi->mapGetInt(stats, "cacheHits", 0, nullptr);
+    int64_t cacheLookups = cacheHits + vsapi->mapGetInt(stats, "cacheNearMisses", 0, nullptr) + vsapi->mapGetInt(stats, "cacheMisses", 0, nullptr);
+    nodes.push_back(NodeProfileRecord{ node, vsapi->getNodeFilterTime(node), vsapi->mapGetInt(stats, "framesProduced", 0, nullptr), cacheHits, cacheLookups,
+        vsapi->mapGetInt(stats, "cacheBytes", 0, nullptr), vsapi->mapGetInt(stats, "serialLockWaitTime", 0, nullptr) });
+
+    int numDeps = vsapi->getNumNodeDependencies(node);
+    const VSFilterDependency *deps = vsapi->getNodeDependencies(node);
+    int numCounts = vsapi->mapNumElements(stats, "dependencyRequests");
+
+    for (int i = 0; i < numDeps; i++)
+        edges.push_back(EdgeProfileRecord{ deps[i].source, node, (i < numCounts) ? vsapi->mapGetInt(stats, "dependencyRequests", i, nullptr) : 0 });
+    vsapi->freeMap(stats);
+
+    for (int i = 0; i < numDeps; i++)
+        printNodeProfileGraphHelper(nodes, edges, visited, deps[i].source, vsapi);
+}
+
+std::string printNodeProfileGraph(VSNode *node, const VSAPI *vsapi) {
+    std::vector<NodeProfileRecord> nodes;
+    std::vector<EdgeProfileRecord> edges;
+    std::set<VSNode *> visited;
+    printNodeProfileGraphHelper(nodes, edges, visited, node, vsapi);
+
+    int64_t totalTime = 0;
+    for (const auto &iter : nodes)
+        totalTime += iter.nanoSeconds;
+    int64_t maxRequests = 0;
+    for (const auto &iter : edges)
+        maxRequests = std::max(maxRequests, iter.requests);
+
+    std::string s = "digraph {\n  node [style=filled]\n";
+    for (const auto &iter : nodes) {
+        double share = totalTime ? static_cast<double>(iter.nanoSeconds) / totalTime : 0;
+        int filterMode = vsapi->getNodeFilterMode(iter.node);
+        // the filter time share decides how red a node is, filters that process one frame at a time are boxes and get a red border once frames had to wait for them
+        bool serial = (filterMode == fmUnordered || filterMode == fmFrameState);
+        s += "  " + mangleNode(iter.node, vsapi) + " [label=\"" + vsapi->getNodeName(iter.node) + "\\n" + filterModeToString(filterMode) +
+            "\\ntime " + printWithTwoDecimals(share * 100) + "% (" + printWithTwoDecimals(iter.nanoSeconds / 1000000000.) + " s)" +
+            "\\nframes " + std::to_string(iter.frames) +
+            "\\ncache " + (iter.cacheLookups ? printWithTwoDecimals(iter.cacheHits * 100. / iter.cacheLookups) + "%" : std::string("-")) + ", " + printWithTwoDecimals(iter.cacheBytes / 1048576.) + " MB";
+        if (serial)
+            s += "\\nlock " + printWithTwoDecimals(iter.lockWaitTime / 1000000000.) + " s";
+        s += "\", shape=" + std::string(serial ? "box" : "oval") + ", fillcolor=\"0.000 " + printWithTwoDecimals(share) + " 1.000\"";
+        if (iter.lockWaitTime > 0)
+            s += ", color=red, penwidth=3";
+        s += "]\n";
+    }
+
+    for (const auto &iter : edges) {
+        double width = maxRequests ? 1 + 4. * iter.requests / maxRequests : 1;
+        s += "  " + mangleNode(iter.source, vsapi) + " -> " + mangleNode(iter.consumer, vsapi) + " [label=\"" + std::to_string(iter.requests) + "\", penwidth=" + printWithTwoDecimals(width) + "]\n";
+    }
+    s += "}";
+    return s;
+}
+
 std::string printNodeTimes(VSNode *node, double processingTime, const VSAPI *vsapi) {
     std::list<NodeTimeRecord> lines;
     std::set<VSNode *> visited;
@@ -217,10 +311,67 @@ std::string printNodeTimes(VSNode *node, double processingTime, const VSAPI *vsa
 
     lines.sort();
 
-    s += extendStringRight("Filtername", 20) + " " + extendStringRight("Filter mode", 10) + " " + extendStringLeft("Time (%)", 10) + " " + extendStringLeft("Time (s)", 10) + "\n";
+    s += extendStringRight("Filtername", 20) + " " + extendStringRight("Filter mode", 10) + " " + extendStringLeft("Time (%)", 10) + " " + extendStringLeft("Time (s)", 10) + " " +
+        extendStringLeft("p50 (ms)", 10) + " " + extendStringLeft("p95 (ms)", 10) + " " + extendStringLeft("p99 (ms)", 10) + " " + extendStringLeft("Cache (%)", 10) + " " + extendStringLeft("Lock (s)", 10) + " " +
+        extendStringLeft("Cache (MB)", 10) + " " + extendStringLeft("Live (MB)", 10) + " " + extendStringLeft("Peak (MB)", 10) + "\n";
+
+    for (const auto & it : lines) {
+        s += extendStringRight(it.filterName, 20) + " " + extendStringRight(filterModeToString(it.filterMode), 10) + " " + extendStringLeft(printWithTwoDecimals((it.nanoSeconds) / (processingTime * 10000000)), 10) + " " + extendStringLeft(printWithTwoDecimals(it.nanoSeconds / 1000000000.), 10);
+        for (int i = 0; i < 3; i++)
+            s += " " + extendStringLeft(printWithTwoDecimals(it.latency[i] / 1000000.), 10);
+        s += " " + extendStringLeft(it.cacheLookups ? printWithTwoDecimals(it.cacheHits * 100. / it.cacheLookups) : "-", 10) + " " + extendStringLeft(printWithTwoDecimals(it.lockWaitTime / 1000000000.), 10);
+        s += " " + extendStringLeft(printWithTwoDecimals(it.cacheBytes / 1048576.), 10) + " " + extendStringLeft(printWithTwoDecimals(it.liveBytes / 1048576.), 10) + " " + extendStringLeft(printWithTwoDecimals(it.peakBytes / 1048576.), 10) + "\n";
+    }
+
+    return s;
+}
+
+static std::string escapeJSONString(const std::string &s) {
+    std::string result;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            result += buffer;
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+std::string printNodeTimesJSON(VSNode *node, const VSAPI *vsapi) {
+    std::list<NodeTimeRecord> lines;
+    std::set<VSNode *> visited;
+    std::string s = "[";
+
+    printNodeTimesHelper(lines, visited, node, vsapi);
 
-    for (const auto & it : lines)
-        s += extendStringRight(it.filterName, 20) + " " + extendStringRight(filterModeToString(it.filterMode), 10) + " " + extendStringLeft(printWithTwoDecimals((it.nanoSeconds) / (processingTime * 10000000)), 10) + " " + extendStringLeft(printWithTwoDecimals(it.nanoSeconds / 1000000000.), 10) + "\n";
+    lines.sort();
 
+    for (const auto &it : lines) {
+        if (s.length() > 1)
+            s += ", ";
+        s += "{\"name\": \"" + escapeJSONString(it.filterName) + "\", \"mode\": \"" + filterModeToString(it.filterMode) + "\", \"time\": " + std::to_string(it.nanoSeconds / 1000000000.) +
+            ", \"latencyP50\": " + std::to_string(it.latency[0] / 1000000.) + ", \"latencyP95\": " + std::to_string(it.latency[1] / 1000000.) + ", \"latencyP99\": " + std::to_string(it.latency[2] / 1000000.) +
+            ", \"cacheBytes\": " + std::to_string(it.cacheBytes) + ", \"liveBytes\": " + std::to_string(it.liveBytes) + ", \"peakBytes\": " + std::to_string(it.peakBytes) + "}";
+    }
+
+    s += "]";
     return s;
-}
\ No newline at end of file
+}
+
+int64_t getTotalNodeTime(VSNode *node, const VSAPI *vsapi) {
+    std::list<NodeTimeRecord> lines;
+    std::set<VSNode *> visited;
+    int64_t total = 0;
+
+    printNodeTimesHelper(lines, visited, node, vsapi);
+
+    for (const auto &it : lines)
+        total += it.nanoSeconds;
+    return total;
+}
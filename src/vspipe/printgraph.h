@@ -25,6 +25,9 @@
 #include <string>
 
 std::string printNodeGraph(bool simple, VSNode *node, const VSAPI *vsapi);
+std::string printNodeProfileGraph(VSNode *node, const VSAPI *vsapi);
 std::string printNodeTimes(VSNode *node, double processingTime, const VSAPI *vsapi);
+std::string printNodeTimesJSON(VSNode *node, const VSAPI *vsapi);
+int64_t getTotalNodeTime(VSNode *node, const VSAPI *vsapi);
 
 #endif
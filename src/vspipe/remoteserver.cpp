@@ -0,0 +1,179 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "remoteserver.h"
+#include "VSHelper4.h"
+#include "../common/planecoder.h"
+#include "../common/remoteprotocol.h"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct RemoteClient {
+    RemoteSocket socket;
+    VSNode *node;
+    const VSAPI *vsapi;
+    bool compress = false;
+
+    // keeps the frames sent from different worker threads from being interleaved
+    std::mutex sendLock;
+
+    std::mutex stateLock;
+    std::condition_variable done;
+    int outstanding = 0;
+};
+
+static void sendError(RemoteClient *client, int n, const std::string &message) {
+    std::lock_guard<std::mutex> lock(client->sendLock);
+    remoteSendMessage(client->socket, rmError, n, message.data(), message.size());
+}
+
+// planes are compressed by the worker thread that finished the frame before taking the send lock, raw planes
+// are sent straight from the frame
+static void sendFrame(RemoteClient *client, const VSFrame *f, int n) {
+    const VSAPI *vsapi = client->vsapi;
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(f);
+
+    std::vector<uint8_t> props;
+    remoteWriteProperties(props, vsapi->getFramePropertiesRO(f), vsapi);
+    uint32_t propsSize = static_cast<uint32_t>(props.size());
+
+    RemotePlaneHeader headers[3] = {};
+    std::vector<uint8_t> coded[3];
+    uint64_t size = sizeof(propsSize) + props.size();
+    for (int p = 0; p < fi->numPlanes; p++) {
+        int width = vsapi->getFrameWidth(f, p);
+        int height = vsapi->getFrameHeight(f, p);
+        headers[p].coding = rpRaw;
+        headers[p].size = static_cast<uint64_t>(width) * fi->bytesPerSample * height;
+        if (client->compress) {
+            coded[p].resize(planeCoderBound(width, height));
+            size_t codedSize = remoteCompressPlane(vsapi->getReadPtr(f, p), vsapi->getStride(f, p), width, height, fi->bytesPerSample, coded[p].data());
+            // noise doesn't compress, there's no point in decoding something that's bigger than the raw plane
+            if (codedSize < headers[p].size) {
+                headers[p].coding = rpCompressed;
+                headers[p].size = codedSize;
+            }
+        }
+        size += sizeof(RemotePlaneHeader) + headers[p].size;
+    }
+
+    std::lock_guard<std::mutex> lock(client->sendLock);
+    RemoteMessageHeader header = { rmFrame, n, size };
+    if (!remoteSend(client->socket, &header, sizeof(header)) || !remoteSend(client->socket, &propsSize, sizeof(propsSize)) || !remoteSend(client->socket, props.data(), props.size()))
+        return;
+    for (int p = 0; p < fi->numPlanes; p++) {
+        if (!remoteSend(client->socket, &headers[p], sizeof(headers[p])))
+            return;
+        bool sent;
+        if (headers[p].coding == rpCompressed)
+            sent = remoteSend(client->socket, coded[p].data(), static_cast<size_t>(headers[p].size));
+        else
+            sent = remoteSendRows(client->socket, vsapi->getReadPtr(f, p), vsapi->getStride(f, p), static_cast<size_t>(vsapi->getFrameWidth(f, p)) * fi->bytesPerSample, vsapi->getFrameHeight(f, p));
+        if (!sent)
+            return;
+    }
+}
+
+static void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg) {
+    RemoteClient *client = reinterpret_cast<RemoteClient *>(userData);
+    if (f) {
+        sendFrame(client, f, n);
+        client->vsapi->freeFrame(f);
+    } else {
+        sendError(client, n, errorMsg ? errorMsg : "unknown error");
+    }
+
+    std::lock_guard<std::mutex> lock(client->stateLock);
+    if (--client->outstanding == 0)
+        client->done.notify_all();
+}
+
+static void serveClient(RemoteClient *client) {
+    const VSAPI *vsapi = client->vsapi;
+    const VSVideoInfo *vi = vsapi->getVideoInfo(client->node);
+
+    RemoteMessageHeader header;
+    RemoteHello hello;
+    if (remoteRecv(client->socket, &header, sizeof(header)) && header.type == rmHello && header.size == sizeof(hello) && remoteRecv(client->socket, &hello, sizeof(hello)) && hello.magic == remoteMagic) {
+        if (hello.version != remoteVersion) {
+            sendError(client, 0, "the server uses protocol version " + std::to_string(remoteVersion));
+        } else {
+            client->compress = !!(hello.flags & remoteFlagCompress);
+            RemoteVideoInfo info = { vi->format.colorFamily, vi->format.sampleType, vi->format.bitsPerSample, vi->format.subSamplingW, vi->format.subSamplingH, vi->width, vi->height, vi->numFrames, vi->fpsNum, vi->fpsDen };
+            bool connected = remoteSendMessage(client->socket, rmInfo, 0, &info, sizeof(info));
+
+            while (connected && remoteRecv(client->socket, &header, sizeof(header)) && header.type == rmRequest && header.size == 0) {
+                if (header.n < 0 || header.n >= vi->numFrames) {
+                    sendError(client, header.n, "requested frame " + std::to_string(header.n) + " is out of bounds");
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(client->stateLock);
+                    client->outstanding++;
+                }
+                vsapi->getFrameAsync(header.n, client->node, frameDoneCallback, client);
+            }
+        }
+    }
+
+    // the callbacks still use the socket so it can only be closed once they're all done
+    remoteShutdown(client->socket);
+    {
+        std::unique_lock<std::mutex> lock(client->stateLock);
+        client->done.wait(lock, [client] { return client->outstanding == 0; });
+    }
+    remoteClose(client->socket);
+    delete client;
+}
+
+bool serveRemoteNode(int port, VSNode *node, const VSAPI *vsapi, std::string &error) {
+    if (vsapi->getNodeType(node) != mtVideo || !vsh::isConstantVideoFormat(vsapi->getVideoInfo(node))) {
+        error = "Only video with a constant format and size can be served";
+        return false;
+    }
+
+    if (!remoteStartup()) {
+        error = "Failed to initialize sockets";
+        return false;
+    }
+
+    RemoteSocket s = remoteListen(port, error);
+    if (s == invalidRemoteSocket) {
+        remoteCleanup();
+        return false;
+    }
+
+    fprintf(stderr, "Serving the output on port %d\n", port);
+
+    for (;;) {
+        RemoteSocket clientSocket = remoteAccept(s);
+        if (clientSocket == invalidRemoteSocket)
+            continue;
+        RemoteClient *client = new RemoteClient();
+        client->socket = clientSocket;
+        client->node = node;
+        client->vsapi = vsapi;
+        std::thread(serveClient, client).detach();
+    }
+}
@@ -0,0 +1,33 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef REMOTESERVER_H
+#define REMOTESERVER_H
+
+#include <VapourSynth4.h>
+#include <string>
+
+// Serves node to remote.Source clients on all interfaces using the protocol in remoteprotocol.h. Every client
+// gets its own thread and all of its requests are passed on to getFrameAsync() as they arrive so the local thread
+// pool decides how many frames are processed at once. Only returns if listening fails.
+
+bool serveRemoteNode(int port, VSNode *node, const VSAPI *vsapi, std::string &error);
+
+#endif
@@ -0,0 +1,165 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "requestreplay.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+static_assert(sizeof(RecordedRequest) == 16, "RecordedRequest has to match the recorded layout");
+
+bool loadRequestRecording(const std::vector<uint8_t> &data, std::vector<RecordedRequest> &requests, std::string &error) {
+    uint32_t header[2];
+    if (data.size() < sizeof(header)) {
+        error = "Not a request recording";
+        return false;
+    }
+
+    memcpy(header, data.data(), sizeof(header));
+    if (header[0] != requestRecordingMagic) {
+        error = "Not a request recording";
+        return false;
+    } else if (header[1] != requestRecordingVersion) {
+        error = "Unsupported request recording version " + std::to_string(header[1]);
+        return false;
+    }
+
+    // a recording that was cut off while being written is still usable up to the last complete request
+    size_t count = (data.size() - sizeof(header)) / sizeof(RecordedRequest);
+    requests.resize(count);
+    if (count)
+        memcpy(requests.data(), data.data() + sizeof(header), count * sizeof(RecordedRequest));
+    return true;
+}
+
+struct ReplayState;
+
+struct ReplayRequest {
+    ReplayState *state;
+    std::chrono::steady_clock::time_point issued;
+    int64_t latency;
+};
+
+struct ReplayState {
+    const VSAPI *vsapi;
+    std::mutex lock;
+    std::condition_variable done;
+    int outstanding = 0;
+    int failed = 0;
+    std::string firstError;
+};
+
+static void VS_CC replayFrameDone(void *userData, const VSFrame *f, int n, VSNode *node, const char *errorMsg) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    ReplayRequest *request = reinterpret_cast<ReplayRequest *>(userData);
+    ReplayState *state = request->state;
+    if (f)
+        state->vsapi->freeFrame(f);
+
+    std::lock_guard<std::mutex> lock(state->lock);
+    request->latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - request->issued).count();
+    if (!f) {
+        if (!state->failed)
+            state->firstError = "Frame " + std::to_string(n) + ": " + (errorMsg ? errorMsg : "unknown error");
+        state->failed++;
+    }
+    if (--state->outstanding == 0)
+        state->done.notify_one();
+}
+
+static double getPercentile(const std::vector<int64_t> &sortedLatencies, double percentile) {
+    if (sortedLatencies.empty())
+        return 0;
+    return sortedLatencies[std::min(static_cast<size_t>(percentile * sortedLatencies.size()), sortedLatencies.size() - 1)] / 1000000.;
+}
+
+bool replayRequests(const std::vector<RecordedRequest> &requests, const ReplayNodes &nodes, FILE *report, const VSAPI *vsapi, std::string &error) {
+    ReplayState state;
+    state.vsapi = vsapi;
+    std::vector<ReplayRequest> replayed(requests.size(), { &state, {}, -1 });
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point due = startTime;
+    int64_t recordedTime = 0;
+    int64_t maxLateness = 0;
+    size_t skipped = 0;
+
+    // every request is issued at the recorded time after the start and not after the previous one so a slow issue doesn't delay everything after it
+    for (size_t i = 0; i < requests.size(); i++) {
+        const RecordedRequest &r = requests[i];
+        recordedTime += r.delay;
+        due += std::chrono::microseconds(r.delay);
+
+        auto iter = nodes.find(std::make_pair(static_cast<int>(r.outputIndex), !!r.alpha));
+        if (iter == nodes.end()) {
+            skipped++;
+            continue;
+        }
+
+        std::this_thread::sleep_until(due);
+        ReplayRequest &request = replayed[i];
+        request.issued = std::chrono::steady_clock::now();
+        maxLateness = std::max<int64_t>(maxLateness, std::chrono::duration_cast<std::chrono::nanoseconds>(request.issued - due).count());
+        {
+            std::lock_guard<std::mutex> lock(state.lock);
+            state.outstanding++;
+        }
+        vsapi->getFrameAsyncPriority(r.n, iter->second, r.priority, replayFrameDone, &request);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(state.lock);
+        state.done.wait(lock, [&state] { return state.outstanding == 0; });
+    }
+
+    double totalTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(requests.size());
+    int64_t latencySum = 0;
+    for (const auto &iter : replayed) {
+        if (iter.latency >= 0) {
+            latencies.push_back(iter.latency);
+            latencySum += iter.latency;
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    if (report) {
+        fprintf(report, "Requests: %zu (%zu skipped, %d failed)\n", requests.size(), skipped, state.failed);
+        fprintf(report, "Recorded time: %.2f seconds\n", recordedTime / 1000000.);
+        fprintf(report, "Replay time: %.2f seconds\n", totalTime);
+        fprintf(report, "Request latency: mean %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n", latencies.empty() ? 0 : latencySum / (latencies.size() * 1000000.),
+            getPercentile(latencies, 0.5), getPercentile(latencies, 0.95), getPercentile(latencies, 0.99), latencies.empty() ? 0 : latencies.back() / 1000000.);
+        fprintf(report, "Most late request: %.2f ms\n", maxLateness / 1000000.);
+    }
+
+    if (skipped)
+        fprintf(stderr, "Warning: skipped %zu requests for outputs the script doesn't have\n", skipped);
+
+    if (state.failed) {
+        error = "Failed to replay " + std::to_string(state.failed) + " requests, the first error was:\n" + state.firstError;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef REQUESTREPLAY_H
+#define REQUESTREPLAY_H
+
+#include <VapourSynth4.h>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A request recording is written by the core after recordFrameRequests() and holds every frame request made from outside
+// of filters with the delay since the previous one. Replaying it issues the same requests with the same delays against a
+// script, so the latency of interactive use like seeking around in a previewer can be measured again after changing the
+// script or the core. The layout matches VSRequestRecorder in the core.
+
+static const uint32_t requestRecordingMagic = 0x51525356; // VSRQ
+static const uint32_t requestRecordingVersion = 1;
+
+struct RecordedRequest {
+    uint32_t delay; // microseconds since the previous request
+    int32_t n;
+    int32_t outputIndex;
+    uint8_t alpha;
+    uint8_t priority;
+    uint16_t reserved;
+};
+
+// the nodes are looked up by output index and whether it's the alpha clip
+typedef std::map<std::pair<int, bool>, VSNode *> ReplayNodes;
+
+bool loadRequestRecording(const std::vector<uint8_t> &data, std::vector<RecordedRequest> &requests, std::string &error);
+// waits for all requests to finish and prints the latencies to report
+bool replayRequests(const std::vector<RecordedRequest> &requests, const ReplayNodes &nodes, FILE *report, const VSAPI *vsapi, std::string &error);
+
+#endif
@@ -0,0 +1,168 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "sharedoutput.h"
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef VS_TARGET_OS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "../common/vsutf16.h"
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static size_t alignSize(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// the reader lives in another process so there's nothing better than polling
+static void waitBriefly() {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+SharedOutput *SharedOutput::create(const std::string &name, int numSlots, size_t maxFrameSize, size_t maxStreamHeaderSize, int64_t totalFrames, std::string &error) {
+    SharedOutput *output = new SharedOutput();
+    output->name = name;
+
+    const size_t pageSize = 4096;
+    size_t streamHeaderOffset = alignSize(sizeof(SharedOutputHeader), 64);
+    size_t slotsOffset = alignSize(streamHeaderOffset + maxStreamHeaderSize, pageSize);
+    size_t slotSize = alignSize(sizeof(SharedOutputSlot) + maxFrameSize, pageSize);
+    output->mappingSize = slotsOffset + slotSize * numSlots;
+
+    void *ptr = nullptr;
+#ifdef VS_TARGET_OS_WINDOWS
+    std::wstring wname = utf16_from_utf8("Local\\" + name);
+    output->mappingHandle = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(output->mappingSize) >> 32), static_cast<DWORD>(output->mappingSize & 0xFFFFFFFF), wname.c_str());
+    if (!output->mappingHandle || GetLastError() == ERROR_ALREADY_EXISTS) {
+        error = "Failed to create shared memory " + name + ", error: " + std::to_string(GetLastError());
+        delete output;
+        return nullptr;
+    }
+    ptr = MapViewOfFile(output->mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, output->mappingSize);
+    if (!ptr) {
+        error = "Failed to map shared memory " + name + ", error: " + std::to_string(GetLastError());
+        delete output;
+        return nullptr;
+    }
+#else
+    int fd = shm_open(("/" + name).c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        error = "Failed to create shared memory " + name + ", errno: " + std::to_string(errno);
+        output->name.clear();
+        delete output;
+        return nullptr;
+    }
+    if (ftruncate(fd, output->mappingSize)) {
+        error = "Failed to resize shared memory " + name + ", errno: " + std::to_string(errno);
+        close(fd);
+        delete output;
+        return nullptr;
+    }
+    ptr = mmap(nullptr, output->mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        error = "Failed to map shared memory " + name + ", errno: " + std::to_string(errno);
+        delete output;
+        return nullptr;
+    }
+#endif
+
+    // the published fields are written last so a reader never sees a partially initialized header
+    output->header = new(ptr) SharedOutputHeader();
+    output->header->version = VSPIPE_SHARED_OUTPUT_VERSION;
+    output->header->numSlots = numSlots;
+    output->header->slotSize = slotSize;
+    output->header->slotsOffset = slotsOffset;
+    output->header->streamHeaderOffset = streamHeaderOffset;
+    output->header->streamHeaderSize = 0;
+    output->header->totalFrames = totalFrames;
+    output->header->published = 0;
+    output->header->consumed = 0;
+    output->header->state = sosRunning;
+    output->header->readerState = sorsNone;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(output->header->magic, VSPIPE_SHARED_OUTPUT_MAGIC, sizeof(output->header->magic));
+
+    return output;
+}
+
+SharedOutput::~SharedOutput() {
+#ifdef VS_TARGET_OS_WINDOWS
+    if (header)
+        UnmapViewOfFile(header);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+#else
+    if (header)
+        munmap(header, mappingSize);
+    if (!name.empty())
+        shm_unlink(("/" + name).c_str());
+#endif
+}
+
+bool SharedOutput::setStreamHeader(const void *data, size_t size) {
+    if (size > header->slotsOffset - header->streamHeaderOffset)
+        return false;
+    memcpy(reinterpret_cast<uint8_t *>(header) + header->streamHeaderOffset, data, size);
+    header->streamHeaderSize = size;
+    return true;
+}
+
+uint8_t *SharedOutput::acquireSlot(int64_t n) {
+    while (static_cast<uint64_t>(n) - header->consumed.load(std::memory_order_acquire) >= header->numSlots) {
+        if (header->readerState.load(std::memory_order_acquire) == sorsClosed)
+            return nullptr;
+        waitBriefly();
+    }
+
+    uint8_t *slot = reinterpret_cast<uint8_t *>(header) + header->slotsOffset + (n % header->numSlots) * header->slotSize;
+    return slot + sizeof(SharedOutputSlot);
+}
+
+void SharedOutput::publishSlot(int64_t n, size_t size) {
+    SharedOutputSlot *slot = reinterpret_cast<SharedOutputSlot *>(reinterpret_cast<uint8_t *>(header) + header->slotsOffset + (n % header->numSlots) * header->slotSize);
+    slot->frameNumber = n;
+    slot->dataSize = size;
+    header->published.store(n + 1, std::memory_order_release);
+}
+
+size_t SharedOutput::getMaxFrameSize() const {
+    return header->slotSize - sizeof(SharedOutputSlot);
+}
+
+void SharedOutput::finish(bool error) {
+    header->state.store(error ? sosError : sosFinished, std::memory_order_release);
+    if (error)
+        return;
+
+    while (header->consumed.load(std::memory_order_acquire) < header->published.load(std::memory_order_relaxed)) {
+        if (header->readerState.load(std::memory_order_acquire) == sorsClosed)
+            break;
+        waitBriefly();
+    }
+}
@@ -0,0 +1,98 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef SHAREDOUTPUT_H
+#define SHAREDOUTPUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Shared memory transport for vspipe output. The mapping is named /<name> with POSIX shm and Local\<name> on Windows.
+//
+// The mapping starts with a SharedOutputHeader followed by the stream header (y4m or wave headers, if any) at
+// streamHeaderOffset and numSlots slots of slotSize bytes starting at slotsOffset. Frame n is stored in slot
+// n % numSlots as a SharedOutputSlot followed by exactly the bytes that would otherwise have been written to the
+// output, including the y4m frame header. Planes are always packed without padding.
+//
+// vspipe increments published after a slot has been filled and the reader increments consumed when it's done with the
+// oldest slot. vspipe never waits for a reader to attach so the reader has to set readerState to attached before
+// consuming and should set it to closed when it stops early. Once state isn't running again no more frames will be
+// published, vspipe then keeps the mapping alive until everything published has been consumed or the reader closes.
+
+#define VSPIPE_SHARED_OUTPUT_MAGIC "VSPSHM01"
+#define VSPIPE_SHARED_OUTPUT_VERSION 1
+
+enum SharedOutputState : uint32_t {
+    sosRunning = 0,
+    sosFinished = 1,
+    sosError = 2
+};
+
+enum SharedOutputReaderState : uint32_t {
+    sorsNone = 0,
+    sorsAttached = 1,
+    sorsClosed = 2
+};
+
+struct SharedOutputHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numSlots;
+    uint64_t slotSize;
+    uint64_t slotsOffset;
+    uint64_t streamHeaderOffset;
+    uint64_t streamHeaderSize;
+    uint64_t totalFrames;
+    alignas(64) std::atomic<uint64_t> published;
+    alignas(64) std::atomic<uint64_t> consumed;
+    alignas(64) std::atomic<uint32_t> state;
+    std::atomic<uint32_t> readerState;
+};
+
+struct SharedOutputSlot {
+    uint64_t frameNumber;
+    uint64_t dataSize;
+    uint8_t reserved[48];
+};
+
+class SharedOutput {
+private:
+    std::string name;
+    SharedOutputHeader *header = nullptr;
+    size_t mappingSize = 0;
+#ifdef VS_TARGET_OS_WINDOWS
+    void *mappingHandle = nullptr;
+#endif
+    SharedOutput() = default;
+public:
+    static SharedOutput *create(const std::string &name, int numSlots, size_t maxFrameSize, size_t maxStreamHeaderSize, int64_t totalFrames, std::string &error);
+    ~SharedOutput();
+
+    bool setStreamHeader(const void *data, size_t size);
+    // waits for a free slot, returns nullptr if the reader closed
+    uint8_t *acquireSlot(int64_t n);
+    void publishSlot(int64_t n, size_t size);
+    size_t getMaxFrameSize() const;
+    void finish(bool error);
+};
+
+#endif
@@ -23,23 +23,38 @@
 #include "VSScript4.h"
 #include "../core/version.h"
 #include "printgraph.h"
+#include "xxhash64.h"
+#include "sharedoutput.h"
+#include "metrics.h"
+#include "remoteserver.h"
+#include "graphplan.h"
+#include "directoutput.h"
+#include "requestreplay.h"
 extern "C" {
 #include "md5.h"
 }
 #include <string>
 #include <map>
 #include <vector>
+#include <atomic>
+#include <deque>
 #include <mutex>
+#include <thread>
 #include <condition_variable>
 #include <algorithm>
 #include <chrono>
 #include <locale>
 #include <sstream>
+#include <climits>
+#include <cstring>
 #include "../common/wave.h"
+#include "../common/videooutput.h"
 #ifdef VS_TARGET_OS_WINDOWS
 #include <io.h>
 #include <fcntl.h>
 #include "../common/vsutf16.h"
+#else
+#include <unistd.h>
 #endif
 
 #define __STDC_FORMAT_MACROS
@@ -93,7 +108,22 @@ enum class VSPipeMode {
     PrintHelp,
     PrintInfo,
     PrintSimpleGraph,
-    PrintFullGraph
+    PrintFullGraph,
+    PrintProfileGraph,
+    Benchmark,
+    Serve,
+    SavePlan,
+    ReplayRequests
+};
+
+enum class VSPipeBenchmarkFormat {
+    Text,
+    JSON
+};
+
+enum class VSPipeBackpressure {
+    Stall,
+    Grow
 };
 
 enum class VSPipeHeaders {
@@ -103,6 +133,14 @@ enum class VSPipeHeaders {
     WAVE64
 };
 
+// An output written in the same run as the main one, only the headers can be chosen separately
+
+struct VSPipeExtraOutput {
+    int index = 0;
+    VSPipeHeaders headers = VSPipeHeaders::None;
+    nstring filename;
+};
+
 // Struct used to return the parsed command line options
 struct VSPipeOptions {
     VSPipeMode mode = VSPipeMode::Output;
@@ -111,13 +149,38 @@ struct VSPipeOptions {
     int64_t endPos = -1;
     int outputIndex = 0;
     int requests = 0;
+    bool adaptiveRequests = false;
+    int liveLatency = 0;
+    int warmupFrames = 0;
+    VSPipeBenchmarkFormat benchmarkFormat = VSPipeBenchmarkFormat::Text;
+    int reorderWindow = 0;
+    VSPipeBackpressure backpressure = VSPipeBackpressure::Stall;
     bool printProgress = false;
     bool printFilterTime = false;
     bool calculateMD5 = false;
+    bool calculateHash = false;
+    nstring hashFilename;
     nstring scriptFilename;
     nstring outputFilename;
     nstring timecodesFilename;
+    nstring traceFilename;
+    nstring replayFilename;
+    nstring cacheSizesFilename;
+    int metricsPort = 0;
+    int servePort = 0;
+    std::string sharedOutputName;
+    int sharedOutputSlots = 4;
+    bool directOutput = false;
+    int segments = 0;
+    int segmentOverlap = 0;
+    int segmentJobs = 0;
+    bool keepSegmentFiles = false;
+    nstring workerCommand;
+    nstring executablePath;
+    nstring checkpointFilename;
+    bool resume = false;
     std::map<std::string, std::string> scriptArgs;
+    std::vector<VSPipeExtraOutput> extraOutputs;
 };
 
 // All state used for outputting frames
@@ -127,42 +190,114 @@ struct VSPipeOutputData {
     const VSAPI *vsapi = nullptr;
     VSPipeHeaders outputHeaders = VSPipeHeaders::None;
     FILE *outFile = nullptr;
+    std::string sharedOutputName;
+    int sharedOutputSlots = 0;
+    std::unique_ptr<SharedOutput> sharedOutput;
+    std::unique_ptr<DirectOutput> directOutput;
     VSNode *node = nullptr;
     VSNode *alphaNode = nullptr;
 
     /* Total number of frames and samples */
     int totalFrames = -1;
     int64_t totalSamples = -1;
+    int audioFrameSamples = VS_AUDIO_FRAME_SAMPLES;
 
     /* Fields used for keeping track of how many frames have been requested and completed and how to reorder them */
     int outputFrames = 0;
     int requestedFrames = 0;
     int completedFrames = 0;
     int completedAlphaFrames = 0;
-    std::map<int, std::pair<const VSFrame *, const VSFrame *>> reorderMap;
+    /* Ring buffer indexed by frame number modulo its size, holds the frames that can't be queued for writing yet */
+    std::vector<std::pair<const VSFrame *, const VSFrame *>> reorderBuffer;
+    VSPipeBackpressure backpressure = VSPipeBackpressure::Stall;
+
+    /* Frames in output order waiting for the writer thread, new requests are deferred while the window is full or more than maxQueuedFrames are waiting */
+    std::deque<std::pair<const VSFrame *, const VSFrame *>> writeQueue;
+    int maxQueuedFrames = 1;
+    int writtenFrames = 0;
+    bool outputDone = false;
 
     /* Error reporting */
     bool outputError = false;
     std::string errorMessage;
 
-    /* Only used to keep the main thread waiting during processing */
+    /* Protects all of the above, the main thread waits on condition until the writer is done and the writer waits on writeCondition for frames */
     std::condition_variable condition;
-    std::mutex mutex;
+    std::condition_variable writeCondition;
+    std::mutex ownMutex;
+    std::mutex *mutex = &ownMutex;
+
+    /* Outputs rendered in the same run, they share the mutex of the main output and include the output itself */
+    std::vector<VSPipeOutputData *> group;
 
-    /* Buffer used to interleave audio or to pack together video where the rowsize isn't the same as pitch due to multiple calls to stdout being very slow */
+    /* Buffer used by the writer thread to interleave audio or to pack together video where the rowsize isn't the same as pitch */
     std::vector<uint8_t> buffer;
 
     /* Statistics */
     bool calculateMD5 = false;
     MD5_CTX md5Ctx = {};
+    std::vector<uint64_t> frameHashes;
+    std::vector<uint64_t> alphaFrameHashes;
     bool printProgress = false;
     std::chrono::time_point<std::chrono::steady_clock> startTime;
     std::chrono::time_point<std::chrono::steady_clock> lastFPSReportTime;
 
+    /* Number of outstanding requests, only changes at runtime in adaptive mode where it's tuned for throughput within the framebuffer limit */
+    VSCore *core = nullptr;
+    int targetRequests = 1;
+    int maxRequests = 1;
+    int finishedFrames = 0;
+    bool adaptiveRequests = false;
+    int adjustDirection = 1;
+    int lastAdjustFrames = 0;
+    double lastAdjustFPS = 0;
+    std::chrono::time_point<std::chrono::steady_clock> lastAdjustTime;
+
+    /* Benchmark mode, frames are freed as soon as they're in order and the steady state starts after warmupFrames */
+    bool discardOutput = false;
+    int warmupFrames = 0;
+    std::vector<std::chrono::time_point<std::chrono::steady_clock>> requestTimes;
+    std::vector<int64_t> frameLatencies;
+    std::chrono::time_point<std::chrono::steady_clock> steadyStartTime;
+    std::chrono::time_point<std::chrono::steady_clock> endTime;
+    int64_t peakFramebufferSize = 0;
+
     /* Timecode output */
     FILE *timecodesFile = nullptr;
     int64_t currentTimecodeNum = 0;
     int64_t currentTimecodeDen = 1;
+
+    /* Checkpointing, the byte counts are only updated by the writer thread */
+    nstring checkpointFilename;
+    int64_t startPos = 0;
+    int64_t endPos = -1;
+    int outputIndex = 0;
+    int resumeFrame = 0;
+    int64_t outputBytes = 0;
+    int64_t timecodesBytes = 0;
+    std::chrono::time_point<std::chrono::steady_clock> lastCheckpointTime;
+
+    /* Live mode, requests expire after liveLatency microseconds and a frame that misses it is replaced by the last frame
+       handed to the writer, the first frame that fails for any other reason is taken as the end of the stream */
+    int64_t liveLatency = 0;
+    int liveEnd = INT_MAX;
+    int repeatedFrames = 0;
+    std::pair<const VSFrame *, const VSFrame *> lastLiveFrames = {};
+};
+
+// The state needed to continue writing after the last checkpointed frame
+
+struct VSPipeCheckpoint {
+    int nextFrame = 0;
+    int totalFrames = 0;
+    int64_t startPos = 0;
+    int64_t endPos = -1;
+    int outputIndex = 0;
+    int64_t outputBytes = 0;
+    int64_t timecodesBytes = 0;
+    int64_t timecodeNum = 0;
+    int64_t timecodeDen = 1;
+    std::string md5State;
 };
 
 /////////////////////////////////////////////
@@ -230,70 +365,452 @@ static bool isCompletedFrame(const std::pair<const VSFrame *, const VSFrame *> &
     return (f.first && (!hasAlpha || f.second));
 }
 
-static void outputFrame(const VSFrame *frame, VSPipeOutputData *data) {
-    if (!data->outputError && data->outFile) {
-        if (data->vsapi->getFrameType(frame) == mtVideo) {
-            const VSVideoFormat *fi = data->vsapi->getVideoFrameFormat(frame);
-            const int rgbRemap[] = { 1, 2, 0 };
-            for (int rp = 0; rp < fi->numPlanes; rp++) {
-                int p = (fi->colorFamily == cfRGB) ? rgbRemap[rp] : rp;
-                ptrdiff_t stride = data->vsapi->getStride(frame, p);
-                const uint8_t *readPtr = data->vsapi->getReadPtr(frame, p);
-                int rowSize = data->vsapi->getFrameWidth(frame, p) * fi->bytesPerSample;
-                int height = data->vsapi->getFrameHeight(frame, p);
-
-                if (rowSize != stride) {
-                    bitblt(data->buffer.data(), rowSize, readPtr, stride, rowSize, height);
-                    readPtr = data->buffer.data();
-                }
+static void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *rnode, const char *errorMsg);
 
-                if (data->calculateMD5)
-                    MD5_Update(&data->md5Ctx, readPtr, rowSize * height);
+static void setOutputError(VSPipeOutputData *data, const std::string &message) {
+    if (data->errorMessage.empty())
+        data->errorMessage = message;
+    data->totalFrames = data->requestedFrames;
+    data->outputError = true;
+}
 
-                if (fwrite(readPtr, 1, rowSize * height, data->outFile) != static_cast<size_t>(rowSize * height)) {
-                    if (data->errorMessage.empty())
-                        data->errorMessage = "Error: fwrite() call failed when writing frame: " + std::to_string(data->outputFrames) + ", plane: " + std::to_string(p) +
-                        ", errno: " + std::to_string(errno);
-                    data->totalFrames = data->requestedFrames;
-                    data->outputError = true;
-                    break;
-                }
-            }
-        } else if (data->vsapi->getFrameType(frame) == mtAudio) {
-            const VSAudioFormat *fi = data->vsapi->getAudioFrameFormat(frame);
+// the error the core reports for requests made with getFrameAsyncDeadline() that expired
+static const char *liveDeadlineError = "Frame request deadline exceeded";
+
+static std::pair<const VSFrame *, const VSFrame *> &reorderSlot(VSPipeOutputData *data, int n) {
+    return data->reorderBuffer[n % data->reorderBuffer.size()];
+}
+
+static void growReorderBuffer(VSPipeOutputData *data) {
+    std::vector<std::pair<const VSFrame *, const VSFrame *>> newBuffer(data->reorderBuffer.size() * 2);
+    for (int n = data->outputFrames; n < data->requestedFrames; n++)
+        newBuffer[n % newBuffer.size()] = reorderSlot(data, n);
+    data->reorderBuffer.swap(newBuffer);
+}
+
+// hill climbs towards the request count with the highest output rate, the framebuffer getting close to its limit or a
+// full reorder window always takes precedence since more requests would only make it worse
+static void adjustRequests(VSPipeOutputData *data) {
+    std::chrono::time_point<std::chrono::steady_clock> currentTime(std::chrono::steady_clock::now());
+    std::chrono::duration<double> elapsedSeconds = currentTime - data->lastAdjustTime;
+    if (elapsedSeconds.count() < 0.5)
+        return;
+
+    double fps = (data->finishedFrames - data->lastAdjustFrames) / elapsedSeconds.count();
+    data->lastAdjustTime = currentTime;
+    data->lastAdjustFrames = data->finishedFrames;
+
+    VSCoreInfo info;
+    data->vsapi->getCoreInfo(data->core, &info);
+    bool memoryPressure = info.usedFramebufferSize > info.maxFramebufferSize - info.maxFramebufferSize / 8;
+    bool windowFull = data->requestedFrames - data->writtenFrames >= static_cast<int>(data->reorderBuffer.size());
+
+    int step = std::max(1, data->targetRequests / 8);
+    if (memoryPressure) {
+        data->adjustDirection = -1;
+        step = std::max(1, data->targetRequests / 4);
+    } else if (windowFull) {
+        data->adjustDirection = -1;
+    } else if (fps < data->lastAdjustFPS * 0.97) {
+        data->adjustDirection = -data->adjustDirection;
+    } else if (fps < data->lastAdjustFPS * 1.03) {
+        // no measurable difference so prefer fewer requests since they use less memory
+        data->adjustDirection = -1;
+    }
+
+    data->lastAdjustFPS = fps;
+    data->targetRequests = std::min(std::max(data->targetRequests + data->adjustDirection * step, 1), data->maxRequests);
+}
+
+// outputs rendered together only request frames up to the request window of the others past their position in the clip,
+// the frames of shared filters are then requested close together and are still cached when the other outputs need them
+static bool isAheadOfGroup(const VSPipeOutputData *data) {
+    double position = static_cast<double>(data->requestedFrames) / data->totalFrames;
+    for (const VSPipeOutputData *other : data->group) {
+        if (other != data && other->requestedFrames < other->totalFrames && position > static_cast<double>(other->requestedFrames + other->targetRequests) / other->totalFrames)
+            return true;
+    }
+    return false;
+}
+
+// with the stall policy every frame between the oldest unwritten one and the newest requested one has to fit in the
+// reorder buffer so a slow frame at the head stops new requests, with the grow policy the buffer grows instead
+static bool canRequestFrame(VSPipeOutputData *data) {
+    if (!data->group.empty() && isAheadOfGroup(data))
+        return false;
+
+    if (data->backpressure == VSPipeBackpressure::Stall)
+        return data->requestedFrames - data->writtenFrames < static_cast<int>(data->reorderBuffer.size());
+
+    if (static_cast<int>(data->writeQueue.size()) >= data->maxQueuedFrames)
+        return false;
+    if (data->requestedFrames - data->outputFrames >= static_cast<int>(data->reorderBuffer.size()))
+        growReorderBuffer(data);
+    return true;
+}
+
+// requests are held back while the output can't keep up so the queue doesn't grow without bounds, everything
+// that can be requested right now is sent as a single range
+static void requestOutputFrames(VSPipeOutputData *data) {
+    int start = data->requestedFrames;
+    while (data->requestedFrames < data->totalFrames && data->requestedFrames - data->finishedFrames < data->targetRequests && canRequestFrame(data)) {
+        if (data->discardOutput)
+            data->requestTimes[data->requestedFrames] = std::chrono::steady_clock::now();
+        data->requestedFrames++;
+    }
+
+    int count = data->requestedFrames - start;
+    if (count > 0 && data->liveLatency > 0) {
+        // nothing is late before the first frame is out since the source may still be starting up
+        int64_t timeout = (data->outputFrames > 0) ? data->liveLatency : 0;
+        for (int n = start; n < data->requestedFrames; n++) {
+            data->vsapi->getFrameAsyncDeadline(n, data->node, prBulk, timeout, frameDoneCallback, data);
+            if (data->alphaNode)
+                data->vsapi->getFrameAsyncDeadline(n, data->alphaNode, prBulk, timeout, frameDoneCallback, data);
+        }
+    } else if (count > 0) {
+        data->vsapi->getFramesAsync(start, count, 1, data->node, frameDoneCallback, data);
+        if (data->alphaNode)
+            data->vsapi->getFramesAsync(start, count, 1, data->alphaNode, frameDoneCallback, data);
+    }
+}
+
+// progress in one output of a group can allow the others to request more
+static void requestFrames(VSPipeOutputData *data) {
+    if (data->group.empty()) {
+        requestOutputFrames(data);
+    } else {
+        for (VSPipeOutputData *output : data->group)
+            requestOutputFrames(output);
+    }
+}
+
+static bool writeSegments(FILE *outFile, const std::vector<OutputSegment> &segments) {
+#ifdef VS_TARGET_OS_WINDOWS
+    for (const auto &iter : segments) {
+        if (fwrite(iter.data, 1, iter.size, outFile) != iter.size)
+            return false;
+    }
+    return true;
+#else
+    return writeOutputSegments(fileno(outFile), segments);
+#endif
+}
+
+// adds the planes of a frame to segments, planes where the stride differs from the row size are packed into packBuffer
+// at bufferOffset, with packAll set every plane is packed
+static void addFrameSegments(const VSFrame *frame, std::vector<OutputSegment> &segments, uint8_t *packBuffer, size_t &bufferOffset, bool packAll, VSPipeOutputData *data) {
+    if (data->vsapi->getFrameType(frame) == mtVideo) {
+        addVideoFrameSegments(frame, segments, packBuffer, bufferOffset, packAll, true, data->vsapi);
+    } else if (data->vsapi->getFrameType(frame) == mtAudio) {
+        const VSAudioFormat *fi = data->vsapi->getAudioFrameFormat(frame);
+
+        int numChannels = fi->numChannels;
+        int numSamples = data->vsapi->getFrameLength(frame);
+        size_t bytesPerOutputSample = (fi->bitsPerSample + 7) / 8;
+        size_t toOutput = bytesPerOutputSample * numSamples * numChannels;
+
+        std::vector<const uint8_t *> srcPtrs;
+        srcPtrs.reserve(numChannels);
+        for (int channel = 0; channel < numChannels; channel++)
+            srcPtrs.push_back(data->vsapi->getReadPtr(frame, channel));
+
+        uint8_t *dstPtr = packBuffer + bufferOffset;
+        if (bytesPerOutputSample == 2)
+            PackChannels16to16le(srcPtrs.data(), dstPtr, numSamples, numChannels);
+        else if (bytesPerOutputSample == 3)
+            PackChannels32to24le(srcPtrs.data(), dstPtr, numSamples, numChannels);
+        else if (bytesPerOutputSample == 4)
+            PackChannels32to32le(srcPtrs.data(), dstPtr, numSamples, numChannels);
+
+        bufferOffset += toOutput;
+        segments.push_back({ dstPtr, toOutput });
+    }
+}
+
+// only called from the writer thread, everything touched here apart from the frames is only used by it
+static bool writeFrame(const VSFrame *frame, const VSFrame *alphaFrame, int n, VSPipeOutputData *data, std::string &error) {
+    if (data->sharedOutput) {
+        // everything is packed straight into the slot so the reader never has to copy
+        uint8_t *slot = data->sharedOutput->acquireSlot(n);
+        if (!slot) {
+            error = "Error: shared memory reader closed before frame " + std::to_string(n);
+            return false;
+        }
+
+        std::vector<OutputSegment> segments;
+        size_t bufferOffset = 0;
+        if (data->outputHeaders == VSPipeHeaders::Y4M) {
+            memcpy(slot, "FRAME\n", 6);
+            bufferOffset = 6;
+        }
+
+        addFrameSegments(frame, segments, slot, bufferOffset, true, data);
+        if (alphaFrame)
+            addFrameSegments(alphaFrame, segments, slot, bufferOffset, true, data);
+
+        if (data->calculateMD5) {
+            for (const auto &iter : segments)
+                MD5_Update(&data->md5Ctx, iter.data, static_cast<unsigned long>(iter.size));
+        }
+
+        data->sharedOutput->publishSlot(n, bufferOffset);
+    } else if (data->directOutput) {
+        // packed straight into the aligned staging buffer, the buffer is the size of the largest frame
+        uint8_t *dst = data->directOutput->acquire(data->buffer.size() + 6);
+
+        std::vector<OutputSegment> segments;
+        size_t bufferOffset = 0;
+        if (data->outputHeaders == VSPipeHeaders::Y4M) {
+            memcpy(dst, "FRAME\n", 6);
+            bufferOffset = 6;
+        }
+
+        addFrameSegments(frame, segments, dst, bufferOffset, true, data);
+        if (alphaFrame)
+            addFrameSegments(alphaFrame, segments, dst, bufferOffset, true, data);
+
+        if (data->calculateMD5) {
+            for (const auto &iter : segments)
+                MD5_Update(&data->md5Ctx, iter.data, static_cast<unsigned long>(iter.size));
+        }
+
+        if (!data->directOutput->commit(bufferOffset)) {
+            error = "Error: write failed when writing frame: " + std::to_string(n) + ", errno: " + std::to_string(errno);
+            return false;
+        }
+
+        data->outputBytes += bufferOffset;
+    } else if (data->outFile) {
+        std::vector<OutputSegment> segments;
+        size_t bufferOffset = 0;
+
+        // the frame header goes out with the planes in the same call
+        if (data->outputHeaders == VSPipeHeaders::Y4M)
+            segments.push_back({ reinterpret_cast<const uint8_t *>(y4mFrameHeader), y4mFrameHeaderSize });
+        size_t firstPlane = segments.size();
+
+        addFrameSegments(frame, segments, data->buffer.data(), bufferOffset, false, data);
+        if (alphaFrame)
+            addFrameSegments(alphaFrame, segments, data->buffer.data(), bufferOffset, false, data);
+
+        if (data->calculateMD5) {
+            for (size_t i = firstPlane; i < segments.size(); i++)
+                MD5_Update(&data->md5Ctx, segments[i].data, static_cast<unsigned long>(segments[i].size));
+        }
+
+        if (!writeSegments(data->outFile, segments)) {
+            error = "Error: write failed when writing frame: " + std::to_string(n) + ", errno: " + std::to_string(errno);
+            return false;
+        }
+
+        for (const auto &iter : segments)
+            data->outputBytes += iter.size;
+    }
 
-            int numChannels = fi->numChannels;
-            int numSamples = data->vsapi->getFrameLength(frame);
-            size_t bytesPerOutputSample = (fi->bitsPerSample + 7) / 8;
-            size_t toOutput = bytesPerOutputSample * numSamples * numChannels;
+    if (data->timecodesFile) {
+        std::ostringstream stream;
+        stream.imbue(std::locale("C"));
+        stream.setf(std::ios::fixed, std::ios::floatfield);
+        stream << (data->currentTimecodeNum * 1000 / static_cast<double>(data->currentTimecodeDen));
+        int written = fprintf(data->timecodesFile, "%s\n", stream.str().c_str());
+        if (written < 0) {
+            error = "Error: failed to write timecode for frame " + std::to_string(n) + ". errno: " + std::to_string(errno);
+            return false;
+        }
+        data->timecodesBytes += written;
 
-            std::vector<const uint8_t *> srcPtrs;
-            srcPtrs.reserve(numChannels);
-            for (int channel = 0; channel < numChannels; channel++)
-                srcPtrs.push_back(data->vsapi->getReadPtr(frame, channel));
-            
-            if (bytesPerOutputSample == 2)
-                PackChannels16to16le(srcPtrs.data(), data->buffer.data(), numSamples, numChannels);
-            else if (bytesPerOutputSample == 3)
-                PackChannels32to24le(srcPtrs.data(), data->buffer.data(), numSamples, numChannels);
-            else if (bytesPerOutputSample == 4)
-                PackChannels32to32le(srcPtrs.data(), data->buffer.data(), numSamples, numChannels);
+        const VSMap *props = data->vsapi->getFramePropertiesRO(frame);
+        int err_num, err_den;
+        int64_t duration_num = data->vsapi->mapGetInt(props, "_DurationNum", 0, &err_num);
+        int64_t duration_den = data->vsapi->mapGetInt(props, "_DurationDen", 0, &err_den);
 
-            if (data->calculateMD5)
-                MD5_Update(&data->md5Ctx, data->buffer.data(), static_cast<unsigned long>(toOutput));
+        if (err_num || err_den) {
+            error = "Error: missing duration at frame " + std::to_string(n);
+            return false;
+        } else if (!duration_den) {
+            error = "Error: duration denominator is zero at frame " + std::to_string(n);
+            return false;
+        }
+
+        addRational(&data->currentTimecodeNum, &data->currentTimecodeDen, duration_num, duration_den);
+    }
+
+    return true;
+}
+
+static const double checkpointInterval = 5;
+
+static std::string bytesToHex(const void *data, size_t size) {
+    std::string result;
+    char buffer[3];
+    for (size_t i = 0; i < size; i++) {
+        snprintf(buffer, sizeof(buffer), "%02x", static_cast<const uint8_t *>(data)[i]);
+        result += buffer;
+    }
+    return result;
+}
+
+static bool hexToBytes(const std::string &hex, void *data, size_t size) {
+    if (hex.size() != size * 2)
+        return false;
+    for (size_t i = 0; i < size; i++) {
+        char *end;
+        std::string byte = hex.substr(i * 2, 2);
+        static_cast<uint8_t *>(data)[i] = static_cast<uint8_t>(strtoul(byte.c_str(), &end, 16));
+        if (*end)
+            return false;
+    }
+    return true;
+}
+
+static bool readCheckpoint(const nstring &filename, VSPipeCheckpoint &checkpoint) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(filename.c_str(), L"rb");
+#else
+    FILE *f = fopen(filename.c_str(), "rb");
+#endif
+    if (!f)
+        return false;
+
+    char key[32];
+    char value[1024];
+    int version = 0;
+    while (fscanf(f, "%31s %1023s", key, value) == 2) {
+        std::string k = key;
+        if (k == "version")
+            version = atoi(value);
+        else if (k == "nextFrame")
+            checkpoint.nextFrame = atoi(value);
+        else if (k == "totalFrames")
+            checkpoint.totalFrames = atoi(value);
+        else if (k == "start")
+            checkpoint.startPos = strtoll(value, nullptr, 10);
+        else if (k == "end")
+            checkpoint.endPos = strtoll(value, nullptr, 10);
+        else if (k == "outputIndex")
+            checkpoint.outputIndex = atoi(value);
+        else if (k == "outputBytes")
+            checkpoint.outputBytes = strtoll(value, nullptr, 10);
+        else if (k == "timecodesBytes")
+            checkpoint.timecodesBytes = strtoll(value, nullptr, 10);
+        else if (k == "timecodeNum")
+            checkpoint.timecodeNum = strtoll(value, nullptr, 10);
+        else if (k == "timecodeDen")
+            checkpoint.timecodeDen = strtoll(value, nullptr, 10);
+        else if (k == "md5")
+            checkpoint.md5State = value;
+    }
+
+    fclose(f);
+    return version == 1 && checkpoint.timecodeDen > 0;
+}
+
+// written to a temporary file first so a crash while writing never leaves a broken checkpoint behind
+static bool writeCheckpoint(VSPipeOutputData *data, int nextFrame) {
+    if (data->outFile)
+        fflush(data->outFile);
+    if (data->timecodesFile)
+        fflush(data->timecodesFile);
+
+    nstring tempFilename = data->checkpointFilename + NSTRING(".tmp");
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(tempFilename.c_str(), L"wb");
+#else
+    FILE *f = fopen(tempFilename.c_str(), "wb");
+#endif
+    if (!f)
+        return false;
+
+    bool success = fprintf(f, "version 1\nnextFrame %d\ntotalFrames %d\nstart %" PRId64 "\nend %" PRId64 "\noutputIndex %d\noutputBytes %" PRId64 "\ntimecodesBytes %" PRId64 "\ntimecodeNum %" PRId64 "\ntimecodeDen %" PRId64 "\nmd5 %s\n",
+        nextFrame, data->totalFrames, data->startPos, data->endPos, data->outputIndex, data->outputBytes, data->timecodesBytes, data->currentTimecodeNum, data->currentTimecodeDen,
+        bytesToHex(&data->md5Ctx, sizeof(data->md5Ctx)).c_str()) >= 0;
+    success = !fclose(f) && success;
+
+#ifdef VS_TARGET_OS_WINDOWS
+    return success && MoveFileExW(tempFilename.c_str(), data->checkpointFilename.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    return success && !rename(tempFilename.c_str(), data->checkpointFilename.c_str());
+#endif
+}
+
+// cuts off anything written after the checkpoint and positions the file at the new end
+static bool truncateFile(FILE *f, int64_t size) {
+    fflush(f);
+#ifdef VS_TARGET_OS_WINDOWS
+    return !_chsize_s(_fileno(f), size) && !_fseeki64(f, size, SEEK_SET);
+#else
+    return !ftruncate(fileno(f), size) && !fseeko(f, size, SEEK_SET);
+#endif
+}
+
+// a live stream ends at frame n, frames after it that already arrived are never written
+static void endLiveOutput(VSPipeOutputData *data, int n) {
+    data->liveEnd = n;
+    data->totalFrames = data->requestedFrames;
+    for (int i = n; i < data->requestedFrames; i++) {
+        auto &slot = reorderSlot(data, i);
+        data->vsapi->freeFrame(slot.first);
+        data->vsapi->freeFrame(slot.second);
+        slot = {};
+    }
+}
 
-            if (fwrite(data->buffer.data(), 1, toOutput, data->outFile) != toOutput) {
-                if (data->errorMessage.empty())
-                    data->errorMessage = "Error: fwrite() call failed when writing frame: " + std::to_string(data->outputFrames) + ", errno: " + std::to_string(errno);
-                data->totalFrames = data->requestedFrames;
-                data->outputError = true;
+static bool isOutputFinished(const VSPipeOutputData *data) {
+    return data->writeQueue.empty() && data->totalFrames == data->completedFrames && data->totalFrames == data->completedAlphaFrames;
+}
+
+static void writerThread(VSPipeOutputData *data) {
+    // the headers were written through the FILE buffer
+    if (data->outFile)
+        fflush(data->outFile);
+
+    std::unique_lock<std::mutex> lock(*data->mutex);
+
+    while (true) {
+        data->writeCondition.wait(lock, [data] { return !data->writeQueue.empty() || isOutputFinished(data); });
+        if (data->writeQueue.empty())
+            break;
+
+        std::pair<const VSFrame *, const VSFrame *> frames = data->writeQueue.front();
+        data->writeQueue.pop_front();
+        bool skipFrame = data->outputError;
+        lock.unlock();
+
+        std::string error;
+        bool success = skipFrame || writeFrame(frames.first, frames.second, data->writtenFrames, data, error);
+        data->vsapi->freeFrame(frames.first);
+        data->vsapi->freeFrame(frames.second);
+
+        if (success && !skipFrame && !data->checkpointFilename.empty()) {
+            std::chrono::time_point<std::chrono::steady_clock> currentTime(std::chrono::steady_clock::now());
+            if (std::chrono::duration<double>(currentTime - data->lastCheckpointTime).count() > checkpointInterval) {
+                data->lastCheckpointTime = currentTime;
+                if (!writeCheckpoint(data, data->writtenFrames + 1)) {
+                    error = "Error: failed to write checkpoint, errno: " + std::to_string(errno);
+                    success = false;
+                }
             }
         }
+
+        lock.lock();
+        data->writtenFrames++;
+        if (!success)
+            setOutputError(data, error);
+
+        requestFrames(data);
     }
+
+    if (!data->outputError && !data->checkpointFilename.empty() && !writeCheckpoint(data, data->writtenFrames))
+        setOutputError(data, "Error: failed to write checkpoint, errno: " + std::to_string(errno));
+
+    data->outputDone = true;
+    data->condition.notify_one();
 }
 
 static void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *rnode, const char *errorMsg) {
     VSPipeOutputData *data = reinterpret_cast<VSPipeOutputData *>(userData);
+    std::lock_guard<std::mutex> lock(*data->mutex);
 
     bool printToConsole = false;
     bool hasMeaningfulFPS = false;
@@ -326,119 +843,128 @@ static void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSN
         data->completedAlphaFrames++;
     }
 
-    if (f) {
+    if (data->liveLatency > 0 && !f && n < data->liveEnd) {
+        if (errorMsg && !strcmp(errorMsg, liveDeadlineError) && data->lastLiveFrames.first) {
+            f = data->vsapi->addFrameRef((rnode == data->node) ? data->lastLiveFrames.first : data->lastLiveFrames.second);
+            if (rnode == data->node)
+                data->repeatedFrames++;
+        } else {
+            endLiveOutput(data, n);
+        }
+    }
+
+    if (f && n >= data->liveEnd) {
+        data->vsapi->freeFrame(f);
+    } else if (f) {
+        auto &slot = reorderSlot(data, n);
         if (rnode == data->node)
-            data->reorderMap[n].first = f;
+            slot.first = f;
         else
-            data->reorderMap[n].second = f;
-
-        bool completed = isCompletedFrame(data->reorderMap[n], !!data->alphaNode);
-
-        if (completed && data->requestedFrames < data->totalFrames) {
-            data->vsapi->getFrameAsync(data->requestedFrames, data->node, frameDoneCallback, userData);
-            if (data->alphaNode)
-                data->vsapi->getFrameAsync(data->requestedFrames, data->alphaNode, frameDoneCallback, userData);
-            data->requestedFrames++;
-        }
-
-        while (data->reorderMap.count(data->outputFrames) && isCompletedFrame(data->reorderMap[data->outputFrames], !!data->alphaNode)) {
-            const VSFrame *frame = data->reorderMap[data->outputFrames].first;
-            const VSFrame *alphaFrame = data->reorderMap[data->outputFrames].second;
-            data->reorderMap.erase(data->outputFrames);
-            if (!data->outputError) {
-                if (data->outputHeaders == VSPipeHeaders::Y4M && data->outFile) {
-                    if (fwrite("FRAME\n", 1, 6, data->outFile) != 6) {
-                        if (data->errorMessage.empty())
-                            data->errorMessage = "Error: fwrite() call failed when writing header, errno: " + std::to_string(errno);
-                        data->totalFrames = data->requestedFrames;
-                        data->outputError = true;
-                    }
-                }
+            slot.second = f;
+
+        if (isCompletedFrame(slot, !!data->alphaNode)) {
+            data->finishedFrames++;
+
+            if (data->discardOutput) {
+                std::chrono::time_point<std::chrono::steady_clock> currentTime(std::chrono::steady_clock::now());
+                if (data->finishedFrames == data->warmupFrames)
+                    data->steadyStartTime = currentTime;
+                else if (data->finishedFrames > data->warmupFrames)
+                    data->frameLatencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(currentTime - data->requestTimes[n]).count());
+                if (data->finishedFrames == data->totalFrames)
+                    data->endTime = currentTime;
+
+                VSCoreInfo info;
+                data->vsapi->getCoreInfo(data->core, &info);
+                data->peakFramebufferSize = std::max(data->peakFramebufferSize, info.usedFramebufferSize);
+            }
+        }
 
-                outputFrame(frame, data);
-                if (alphaFrame)
-                    outputFrame(alphaFrame, data);
-
-                if (data->timecodesFile && !data->outputError) {
-                    std::ostringstream stream;
-                    stream.imbue(std::locale("C"));
-                    stream.setf(std::ios::fixed, std::ios::floatfield);
-                    stream << (data->currentTimecodeNum * 1000 / static_cast<double>(data->currentTimecodeDen));
-                    if (fprintf(data->timecodesFile, "%s\n", stream.str().c_str()) < 0) {
-                        if (data->errorMessage.empty())
-                            data->errorMessage = "Error: failed to write timecode for frame " + std::to_string(data->outputFrames) + ". errno: " + std::to_string(errno);
-                        data->totalFrames = data->requestedFrames;
-                        data->outputError = true;
-                    } else {
-                        const VSMap *props = data->vsapi->getFramePropertiesRO(frame);
-                        int err_num, err_den;
-                        int64_t duration_num = data->vsapi->mapGetInt(props, "_DurationNum", 0, &err_num);
-                        int64_t duration_den = data->vsapi->mapGetInt(props, "_DurationDen", 0, &err_den);
-
-                        if (err_num || err_den || !duration_den) {
-                            if (data->errorMessage.empty()) {
-                                if (err_num || err_den)
-                                    data->errorMessage = "Error: missing duration at frame ";
-                                else if (!duration_den)
-                                    data->errorMessage = "Error: duration denominator is zero at frame ";
-                                data->errorMessage += std::to_string(data->outputFrames);
-                            }
-
-                            data->totalFrames = data->requestedFrames;
-                            data->outputError = true;
-                        } else {
-                            addRational(&data->currentTimecodeNum, &data->currentTimecodeDen, duration_num, duration_den);
-                        }
-                    }
-                }
+        // frames are handed to the writer thread in order
+        while (data->outputFrames < data->requestedFrames && isCompletedFrame(reorderSlot(data, data->outputFrames), !!data->alphaNode)) {
+            auto &head = reorderSlot(data, data->outputFrames);
+            if (data->liveLatency > 0) {
+                data->vsapi->freeFrame(data->lastLiveFrames.first);
+                data->vsapi->freeFrame(data->lastLiveFrames.second);
+                data->lastLiveFrames = { data->vsapi->addFrameRef(head.first), head.second ? data->vsapi->addFrameRef(head.second) : nullptr };
             }
-            data->vsapi->freeFrame(frame);
-            data->vsapi->freeFrame(alphaFrame);
+            if (data->discardOutput || data->outputFrames < data->warmupFrames) {
+                data->vsapi->freeFrame(head.first);
+                data->vsapi->freeFrame(head.second);
+                data->writtenFrames++;
+            } else {
+                data->writeQueue.push_back(head);
+            }
+            head = {};
             data->outputFrames++;
         }
-    } else {
-        data->outputError = true;
-        data->totalFrames = data->requestedFrames;
-        if (data->errorMessage.empty()) {
-            if (errorMsg)
-                data->errorMessage = "Error: Failed to retrieve frame " + std::to_string(n) + " with error: " + errorMsg;
-            else
-                data->errorMessage = "Error: Failed to retrieve frame " + std::to_string(n);
-        }
+
+        if (data->adaptiveRequests)
+            adjustRequests(data);
+        requestFrames(data);
+    } else if (n < data->liveEnd) {
+        if (errorMsg)
+            setOutputError(data, "Error: Failed to retrieve frame " + std::to_string(n) + " with error: " + errorMsg);
+        else
+            setOutputError(data, "Error: Failed to retrieve frame " + std::to_string(n));
     }
 
     if (printToConsole && !data->outputError) {
-        if (data->vsapi->getNodeType(rnode) == mtVideo) {
+        if (data->liveLatency > 0) {
+            fprintf(stderr, "Frame: %d (%d repeated)\r", data->completedFrames, data->repeatedFrames);
+        } else if (data->vsapi->getNodeType(rnode) == mtVideo) {
             if (hasMeaningfulFPS)
                 fprintf(stderr, "Frame: %d/%d (%.2f fps)\r", data->completedFrames, data->totalFrames, fps);
             else
                 fprintf(stderr, "Frame: %d/%d\r", data->completedFrames, data->totalFrames);
         } else {
             if (hasMeaningfulFPS)
-                fprintf(stderr, "Sample: %" PRId64 "/%" PRId64 " (%.2f sps)\r", static_cast<int64_t>(data->completedFrames * VS_AUDIO_FRAME_SAMPLES), static_cast<int64_t>(data->totalFrames * VS_AUDIO_FRAME_SAMPLES), fps);
+                fprintf(stderr, "Sample: %" PRId64 "/%" PRId64 " (%.2f sps)\r", data->completedFrames * static_cast<int64_t>(data->audioFrameSamples), data->totalFrames * static_cast<int64_t>(data->audioFrameSamples), fps);
             else
-                fprintf(stderr, "Sample: %" PRId64 "/%" PRId64 "\r", static_cast<int64_t>(data->completedFrames * VS_AUDIO_FRAME_SAMPLES), static_cast<int64_t>(data->totalFrames * VS_AUDIO_FRAME_SAMPLES));
+                fprintf(stderr, "Sample: %" PRId64 "/%" PRId64 "\r", data->completedFrames * static_cast<int64_t>(data->audioFrameSamples), data->totalFrames * static_cast<int64_t>(data->audioFrameSamples));
         }
     }
 
-    if (data->totalFrames == data->completedFrames && data->totalFrames == data->completedAlphaFrames) {
-        std::lock_guard<std::mutex> lock(data->mutex);
-        data->condition.notify_one();
+    data->writeCondition.notify_one();
+}
+
+// the stream header is placed in the shared memory when it's used so it's the same bytes a pipe reader would get
+static bool writeStreamHeader(VSPipeOutputData *data, const void *header, size_t size) {
+    // the header is already in the file when resuming
+    if (data->resumeFrame > 0)
+        return true;
+
+    data->outputBytes += size;
+    if (data->sharedOutput) {
+        if (!data->sharedOutput->setStreamHeader(header, size)) {
+            fprintf(stderr, "Error: header too large for shared memory\n");
+            return false;
+        }
+    } else if (data->directOutput) {
+        if (!data->directOutput->write(header, size)) {
+            fprintf(stderr, "Error: write failed when writing initial header, errno: %d\n", errno);
+            return false;
+        }
+    } else if (data->outFile) {
+        if (fwrite(header, 1, size, data->outFile) != size) {
+            fprintf(stderr, "Error: fwrite() call failed when writing initial header, errno: %d\n", errno);
+            return false;
+        }
     }
+    return true;
 }
 
-static std::string floatBitsToLetter(int bits) {
-    switch (bits) {
-    case 16:
-        return "h";
-    case 32:
-        return "s";
-    case 64:
-        return "d";
-    default:
-        assert(false);
-        return "u";
+static bool createSharedOutput(VSPipeOutputData *data, size_t maxFrameSize, int64_t totalFrames) {
+    if (data->sharedOutputName.empty())
+        return true;
+
+    std::string error;
+    data->sharedOutput.reset(SharedOutput::create(data->sharedOutputName, data->sharedOutputSlots, maxFrameSize, 4096, totalFrames, error));
+    if (!data->sharedOutput) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return false;
     }
+    return true;
 }
 
 static bool initializeVideoOutput(VSPipeOutputData *data) {
@@ -454,66 +980,38 @@ static bool initializeVideoOutput(VSPipeOutputData *data) {
         return false;
     }
 
-    std::string y4mFormat;
+    if (!createSharedOutput(data, static_cast<size_t>(vi->width) * vi->height * vi->format.bytesPerSample * (vi->format.numPlanes + (data->alphaNode ? 1 : 0)) + 6, vi->numFrames))
+        return false;
 
     if (data->outputHeaders == VSPipeHeaders::Y4M) {
-        if (vi->format.colorFamily == cfGray) {
-            y4mFormat = "mono";
-            if (vi->format.bitsPerSample > 8)
-                y4mFormat = y4mFormat + std::to_string(vi->format.bitsPerSample);
-        } else if (vi->format.colorFamily == cfYUV) {
-            if (vi->format.subSamplingW == 1 && vi->format.subSamplingH == 1)
-                y4mFormat = "420";
-            else if (vi->format.subSamplingW == 1 && vi->format.subSamplingH == 0)
-                y4mFormat = "422";
-            else if (vi->format.subSamplingW == 0 && vi->format.subSamplingH == 0)
-                y4mFormat = "444";
-            else if (vi->format.subSamplingW == 2 && vi->format.subSamplingH == 2)
-                y4mFormat = "410";
-            else if (vi->format.subSamplingW == 2 && vi->format.subSamplingH == 0)
-                y4mFormat = "411";
-            else if (vi->format.subSamplingW == 0 && vi->format.subSamplingH == 1)
-                y4mFormat = "440";
-            else {
-                fprintf(stderr, "Error: no y4m identifier exists for current format\n");
-                return false;
-            }
-
-            if (vi->format.bitsPerSample > 8 && vi->format.sampleType == stInteger)
-                y4mFormat += "p" + std::to_string(vi->format.bitsPerSample);
-            else if (vi->format.sampleType == stFloat)
-                y4mFormat += "p" + floatBitsToLetter(vi->format.bitsPerSample);
-        } else {
-            fprintf(stderr, "Error: no y4m identifier exists for current format\n");
+        std::string header;
+        std::string error;
+        if (!getY4MHeader(vi, header, error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
             return false;
         }
 
-        if (!y4mFormat.empty())
-            y4mFormat = " C" + y4mFormat;
-
-        std::string header = "YUV4MPEG2" + y4mFormat
-            + " W" + std::to_string(vi->width)
-            + " H" + std::to_string(vi->height)
-            + " F" + std::to_string(vi->fpsNum) + ":" + std::to_string(vi->fpsDen)
-            + " Ip A0:0"
-            + " XLENGTH=" + std::to_string(vi->numFrames) + "\n";
-
-        if (data->outFile) {
-            if (fwrite(header.c_str(), 1, header.size(), data->outFile) != header.size()) {
-                fprintf(stderr, "Error: fwrite() call failed when writing initial header, errno: %d\n", errno);
-                return false;
-            }
-        }
+        if (!writeStreamHeader(data, header.c_str(), header.size()))
+            return false;
     }
 
-    if (data->timecodesFile && !data->outputError) {
-        if (fprintf(data->timecodesFile, "# timecode format v2\n") < 0) {
+    if (data->timecodesFile && !data->outputError && data->resumeFrame == 0) {
+        data->timecodesBytes = fprintf(data->timecodesFile, "# timecode format v2\n");
+        if (data->timecodesBytes < 0) {
             fprintf(stderr, "Error: failed to write timecodes file header, errno: %d\n", errno);
             return false;
         }
     }
 
-    data->buffer.resize(vi->width * vi->height * vi->format.bytesPerSample);
+    data->buffer.resize(static_cast<size_t>(vi->width) * vi->height * vi->format.bytesPerSample * (vi->format.numPlanes + (data->alphaNode ? 1 : 0)));
+
+    if (data->directOutput) {
+        int64_t frameSize = static_cast<int64_t>(vi->width) * vi->height * (data->alphaNode ? 1 : 0);
+        for (int p = 0; p < vi->format.numPlanes; p++)
+            frameSize += static_cast<int64_t>(p ? (vi->width >> vi->format.subSamplingW) : vi->width) * (p ? (vi->height >> vi->format.subSamplingH) : vi->height);
+        frameSize = frameSize * vi->format.bytesPerSample + ((data->outputHeaders == VSPipeHeaders::Y4M) ? 6 : 0);
+        data->directOutput->preallocate(data->outputBytes + frameSize * data->totalFrames);
+    }
     return true;
 }
 
@@ -525,18 +1023,17 @@ static bool initializeAudioOutput(VSPipeOutputData *data) {
 
     const VSAudioInfo *ai = data->vsapi->getAudioInfo(data->node);
 
+    if (!createSharedOutput(data, static_cast<size_t>(ai->format.numChannels) * data->audioFrameSamples * ai->format.bytesPerSample, ai->numFrames))
+        return false;
+
     if (data->outputHeaders == VSPipeHeaders::WAVE64) {
         Wave64Header header;
         if (!CreateWave64Header(header, ai->format.sampleType == stFloat, ai->format.bitsPerSample, ai->sampleRate, ai->format.channelLayout, ai->numSamples)) {
             fprintf(stderr, "Error: cannot create valid w64 header\n");
             return false;
         }
-        if (data->outFile) {
-            if (fwrite(&header, 1, sizeof(header), data->outFile) != sizeof(header)) {
-                fprintf(stderr, "Error: fwrite() call failed when writing initial header, errno: %d\n", errno);
-                return false;
-            }
-        }
+        if (!writeStreamHeader(data, &header, sizeof(header)))
+            return false;
     } else if (data->outputHeaders == VSPipeHeaders::WAVE) {
         WaveHeader header;
         if (!CreateWaveHeader(header, ai->format.sampleType == stFloat, ai->format.bitsPerSample, ai->sampleRate, ai->format.channelLayout, ai->numSamples)) {
@@ -544,50 +1041,539 @@ static bool initializeAudioOutput(VSPipeOutputData *data) {
             return false;
         }
 
-        if (data->outFile) {
-            if (fwrite(&header, 1, sizeof(header), data->outFile) != sizeof(header)) {
-                fprintf(stderr, "Error: fwrite() call failed when writing initial header, errno: %d\n", errno);
+        if (!writeStreamHeader(data, &header, sizeof(header)))
+            return false;
+    }
+
+    data->buffer.resize(static_cast<size_t>(ai->format.numChannels) * data->audioFrameSamples * ai->format.bytesPerSample);
+
+    if (data->directOutput)
+        data->directOutput->preallocate(data->outputBytes + data->totalSamples * ai->format.numChannels * ((ai->format.bitsPerSample + 7) / 8));
+    return true;
+}
+
+static void prepareOutput(const VSPipeOptions &opts, VSPipeOutputData *data, VSCore *core, int requests, int numThreads) {
+    data->startTime = std::chrono::steady_clock::now();
+    data->lastFPSReportTime = std::chrono::steady_clock::now();
+
+    data->core = core;
+    data->discardOutput = (opts.mode == VSPipeMode::Benchmark || opts.mode == VSPipeMode::PrintProfileGraph);
+    data->warmupFrames = std::min(opts.warmupFrames, data->totalFrames);
+    if (data->discardOutput) {
+        data->requestTimes.resize(data->totalFrames);
+        data->frameLatencies.reserve(data->totalFrames - data->warmupFrames);
+        data->steadyStartTime = data->startTime;
+    }
+    // in adaptive mode the thread count is only the starting point and up to four times as many requests can be made
+    data->adaptiveRequests = opts.adaptiveRequests;
+    data->lastAdjustTime = data->startTime;
+    data->targetRequests = requests;
+    data->maxRequests = opts.adaptiveRequests ? std::max(requests, numThreads * 4) : requests;
+
+    data->maxQueuedFrames = data->maxRequests;
+    data->backpressure = opts.backpressure;
+    data->reorderBuffer.resize(std::max(data->maxRequests, (opts.reorderWindow > 0) ? opts.reorderWindow : data->maxRequests * 2));
+
+    // everything before the resume point counts as already written
+    data->requestedFrames = data->resumeFrame;
+    data->outputFrames = data->resumeFrame;
+    data->completedFrames = data->resumeFrame;
+    data->completedAlphaFrames = data->resumeFrame;
+    data->finishedFrames = data->resumeFrame;
+    data->writtenFrames = data->resumeFrame;
+    data->lastAdjustFrames = data->resumeFrame;
+    data->lastCheckpointTime = data->startTime;
+}
+
+static bool outputNode(const VSPipeOptions &opts, VSPipeOutputData *data, VSCore *core, const std::vector<VSPipeOutputData *> &extraOutputs) {
+    VSCoreInfo info;
+    data->vsapi->getCoreInfo(core, &info);
+
+    int requests = opts.requests;
+    if (requests < 1 && data->liveLatency > 0) {
+        // a request further ahead of the stream than the latency would expire before its frame has even arrived
+        const VSVideoInfo *vi = data->vsapi->getVideoInfo(data->node);
+        requests = (vi->fpsNum > 0 && vi->fpsDen > 0) ? static_cast<int>(std::min<int64_t>(std::max<int64_t>(data->liveLatency * vi->fpsNum / (vi->fpsDen * 1000000), 1), info.numThreads * 4)) : 1;
+    } else if (requests < 1) {
+        requests = info.numThreads;
+    }
+
+    if (data->resumeFrame > data->totalFrames) {
+        fprintf(stderr, "The checkpoint was made for a longer clip\n");
+        return true;
+    }
+
+    // the extra outputs share the main output's mutex so requesting frames for all of them only takes one lock
+    std::vector<VSPipeOutputData *> outputs = { data };
+    outputs.insert(outputs.end(), extraOutputs.begin(), extraOutputs.end());
+    for (VSPipeOutputData *output : outputs) {
+        prepareOutput(opts, output, core, requests, info.numThreads);
+        output->mutex = data->mutex;
+        if (outputs.size() > 1)
+            output->group = outputs;
+    }
+
+    std::vector<std::thread> writers;
+    for (VSPipeOutputData *output : outputs)
+        writers.emplace_back(writerThread, output);
+
+    std::unique_lock<std::mutex> lock(*data->mutex);
+
+    requestFrames(data);
+
+    for (VSPipeOutputData *output : outputs)
+        output->writeCondition.notify_one();
+    for (VSPipeOutputData *output : outputs)
+        output->condition.wait(lock, [output] { return output->outputDone; });
+    lock.unlock();
+    for (auto &iter : writers)
+        iter.join();
+
+    bool error = false;
+    for (VSPipeOutputData *output : outputs) {
+        output->vsapi->freeFrame(output->lastLiveFrames.first);
+        output->vsapi->freeFrame(output->lastLiveFrames.second);
+        if (output->sharedOutput)
+            output->sharedOutput->finish(output->outputError);
+        if (output->directOutput && !output->outputError && !output->directOutput->finish(output->errorMessage))
+            output->outputError = true;
+
+        if (output->outputError) {
+            for (auto &iter : output->reorderBuffer) {
+                output->vsapi->freeFrame(iter.first);
+                output->vsapi->freeFrame(iter.second);
+            }
+            fprintf(stderr, "%s\n", output->errorMessage.c_str());
+            error = true;
+        }
+    }
+
+    return error;
+}
+
+// the -s/-e range is in frames for video and in samples for audio
+static bool trimOutputNode(const VSPipeOptions &opts, VSNode *&node, VSCore *core, const VSAPI *vsapi, std::string &error) {
+    if (opts.startPos == 0 && opts.endPos == -1)
+        return true;
+
+    VSMap *args = vsapi->createMap();
+    vsapi->mapSetNode(args, "clip", node, maAppend);
+    if (opts.startPos != 0)
+        vsapi->mapSetInt(args, "first", opts.startPos, maAppend);
+    if (opts.endPos > -1)
+        vsapi->mapSetInt(args, "last", opts.endPos, maAppend);
+    VSMap *result = vsapi->invoke(vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core), (vsapi->getNodeType(node) == mtVideo) ? "Trim" : "AudioTrim", args);
+    vsapi->freeMap(args);
+    if (vsapi->mapGetError(result)) {
+        error = vsapi->mapGetError(result);
+        vsapi->freeMap(result);
+        return false;
+    }
+
+    vsapi->freeNode(node);
+    node = vsapi->mapGetNode(result, "clip", 0, nullptr);
+    vsapi->freeMap(result);
+    return true;
+}
+
+static void closeExtraOutputs(std::vector<std::unique_ptr<VSPipeOutputData>> &outputs) {
+    for (auto &iter : outputs) {
+        iter->vsapi->freeNode(iter->node);
+        iter->vsapi->freeNode(iter->alphaNode);
+        if (iter->outFile)
+            fclose(iter->outFile);
+    }
+    outputs.clear();
+}
+
+// the additional outputs cover the same range with the same request settings as the main output, only the headers can differ
+static bool openExtraOutputs(const VSPipeOptions &opts, const std::vector<std::pair<VSNode *, VSNode *>> &nodes, VSCore *core, const VSAPI *vsapi, std::vector<std::unique_ptr<VSPipeOutputData>> &outputs) {
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const VSPipeExtraOutput &extra = opts.extraOutputs[i];
+        outputs.emplace_back(new VSPipeOutputData());
+        VSPipeOutputData *data = outputs.back().get();
+
+        data->vsapi = vsapi;
+        data->outputHeaders = extra.headers;
+        data->node = vsapi->addNodeRef(nodes[i].first);
+        data->alphaNode = nodes[i].second ? vsapi->addNodeRef(nodes[i].second) : nullptr;
+
+        std::string error;
+        if (!trimOutputNode(opts, data->node, core, vsapi, error) || (data->alphaNode && !trimOutputNode(opts, data->alphaNode, core, vsapi, error))) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+
+#ifdef VS_TARGET_OS_WINDOWS
+        data->outFile = _wfopen(extra.filename.c_str(), L"wb");
+#else
+        data->outFile = fopen(extra.filename.c_str(), "wb");
+#endif
+        if (!data->outFile) {
+            fprintf(stderr, "Failed to open output %d for writing\n", extra.index);
+            return false;
+        }
+
+        if (vsapi->getNodeType(data->node) == mtVideo) {
+            const VSVideoInfo *vi = vsapi->getVideoInfo(data->node);
+            if (!isConstantVideoFormat(vi)) {
+                fprintf(stderr, "Cannot output clips with varying dimensions\n");
                 return false;
             }
+
+            data->totalFrames = vi->numFrames;
+            if (!initializeVideoOutput(data))
+                return false;
+        } else {
+            const VSAudioInfo *ai = vsapi->getAudioInfo(data->node);
+            data->totalFrames = ai->numFrames;
+            data->totalSamples = ai->numSamples;
+            data->audioFrameSamples = vsapi->getAudioFrameSamples(core);
+            if (!initializeAudioOutput(data))
+                return false;
         }
     }
 
-    data->buffer.resize(ai->format.numChannels * VS_AUDIO_FRAME_SAMPLES * ai->format.bytesPerSample);
     return true;
 }
 
-static bool outputNode(const VSPipeOptions &opts, VSPipeOutputData *data, VSCore *core) {
-    int requests = opts.requests;
-    if (requests < 1) {
-        VSCoreInfo info;
-        data->vsapi->getCoreInfo(core, &info);
-        requests = info.numThreads;
+static bool renderOutputs(const VSPipeOptions &opts, VSPipeOutputData *data, const std::vector<std::pair<VSNode *, VSNode *>> &extraNodes, VSCore *core) {
+    std::vector<std::unique_ptr<VSPipeOutputData>> extraOutputs;
+    bool success = openExtraOutputs(opts, extraNodes, core, data->vsapi, extraOutputs);
+    if (success) {
+        std::vector<VSPipeOutputData *> outputs;
+        for (auto &iter : extraOutputs)
+            outputs.push_back(iter.get());
+        success = !outputNode(opts, data, core, outputs);
+    }
+    closeExtraOutputs(extraOutputs);
+    return success;
+}
+
+// Segmented rendering, the coordinator splits the frames into segments that are rendered by separate vspipe processes
+// which start overlap frames early and discard them so temporal filters are warm at the segment start. The raw output
+// of every worker is collected in a segment file and the files are then stitched together with the stream headers.
+
+#ifdef VS_TARGET_OS_WINDOWS
+static nstring utf8ToNstring(const std::string &s) {
+    return utf16_from_utf8(s);
+}
+
+static nstring quoteArgument(const nstring &s) {
+    nstring result = NSTRING("\"");
+    for (auto c : s) {
+        if (c == NSTRING('"'))
+            result += NSTRING('\\');
+        result += c;
+    }
+    return result + NSTRING("\"");
+}
+
+static nstring numberToNstring(int64_t n) {
+    return std::to_wstring(n);
+}
+#else
+static nstring utf8ToNstring(const std::string &s) {
+    return s;
+}
+
+static nstring quoteArgument(const nstring &s) {
+    nstring result = "'";
+    for (auto c : s) {
+        if (c == '\'')
+            result += "'\\''";
+        else
+            result += c;
+    }
+    return result + "'";
+}
+
+static nstring numberToNstring(int64_t n) {
+    return std::to_string(n);
+}
+#endif
+
+static nstring getSegmentFilename(const VSPipeOptions &opts, int segment) {
+    nstring base = (opts.outputFilename.empty() || opts.outputFilename == NSTRING("-") || opts.outputFilename == NSTRING(".")) ? NSTRING("vspipe") : opts.outputFilename;
+    nstring number = numberToNstring(segment);
+    return base + NSTRING(".segment") + nstring(std::max<int>(4 - static_cast<int>(number.length()), 0), NSTRING('0')) + number;
+}
+
+// runs a worker and copies everything it writes to stdout into the segment file
+static bool renderSegment(const VSPipeOptions &opts, int64_t first, int64_t last, int warmup, const nstring &filename, std::string &error) {
+    nstring command = opts.workerCommand.empty() ? quoteArgument(opts.executablePath) : opts.workerCommand;
+    command += NSTRING(" --start ") + numberToNstring(first) + NSTRING(" --end ") + numberToNstring(last) + NSTRING(" --warmup ") + numberToNstring(warmup);
+    command += NSTRING(" --outputindex ") + numberToNstring(opts.outputIndex);
+    if (opts.requests > 0)
+        command += NSTRING(" --requests ") + numberToNstring(opts.requests);
+    for (const auto &iter : opts.scriptArgs)
+        command += NSTRING(" --arg ") + quoteArgument(utf8ToNstring(iter.first + "=" + iter.second));
+    command += NSTRING(" ") + quoteArgument(opts.scriptFilename) + NSTRING(" -");
+
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *pipe = _wpopen(command.c_str(), L"rb");
+    FILE *segmentFile = _wfopen(filename.c_str(), L"wb");
+#else
+    FILE *pipe = popen(command.c_str(), "r");
+    FILE *segmentFile = fopen(filename.c_str(), "wb");
+#endif
+
+    bool success = pipe && segmentFile;
+    if (success) {
+        std::vector<uint8_t> buffer(1024 * 1024);
+        size_t size;
+        while (success && (size = fread(buffer.data(), 1, buffer.size(), pipe)) > 0)
+            success = (fwrite(buffer.data(), 1, size, segmentFile) == size);
     }
 
+    if (segmentFile && fclose(segmentFile))
+        success = false;
+#ifdef VS_TARGET_OS_WINDOWS
+    if (pipe && _pclose(pipe))
+        success = false;
+#else
+    if (pipe && pclose(pipe))
+        success = false;
+#endif
+
+    if (!success)
+        error = "Error: rendering frames " + std::to_string(first) + "-" + std::to_string(last) + " failed";
+    return success;
+}
+
+static bool appendSegment(const nstring &filename, size_t frameSize, int numFrames, VSPipeOutputData *data, std::string &error) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *segmentFile = _wfopen(filename.c_str(), L"rb");
+#else
+    FILE *segmentFile = fopen(filename.c_str(), "rb");
+#endif
+    if (!segmentFile) {
+        error = "Error: failed to open segment file " + nstringToUtf8(filename);
+        return false;
+    }
+
+    std::vector<uint8_t> buffer(frameSize);
+    bool success = true;
+    int n = 0;
+    for (; n < numFrames && success; n++) {
+        if (fread(buffer.data(), 1, frameSize, segmentFile) != frameSize) {
+            error = "Error: segment file " + nstringToUtf8(filename) + " is truncated";
+            success = false;
+        } else if ((data->outputHeaders == VSPipeHeaders::Y4M && fwrite("FRAME\n", 1, 6, data->outFile) != 6) || fwrite(buffer.data(), 1, frameSize, data->outFile) != frameSize) {
+            error = "Error: write failed when stitching segment " + nstringToUtf8(filename) + ", errno: " + std::to_string(errno);
+            success = false;
+        }
+    }
+
+    fclose(segmentFile);
+    return success;
+}
+
+static bool outputSegments(const VSPipeOptions &opts, VSPipeOutputData *data) {
+    const VSVideoInfo *vi = data->vsapi->getVideoInfo(data->node);
+    size_t frameSize = 0;
+    for (int p = 0; p < vi->format.numPlanes; p++)
+        frameSize += static_cast<size_t>(vi->width >> (p ? vi->format.subSamplingW : 0)) * (vi->height >> (p ? vi->format.subSamplingH : 0)) * vi->format.bytesPerSample;
+    if (data->alphaNode)
+        frameSize += static_cast<size_t>(vi->width) * vi->height * data->vsapi->getVideoInfo(data->alphaNode)->format.bytesPerSample;
+
+    int numSegments = std::min(opts.segments, std::max(data->totalFrames, 1));
+    std::vector<int> segmentStarts;
+    for (int i = 0; i <= numSegments; i++)
+        segmentStarts.push_back(static_cast<int>(static_cast<int64_t>(data->totalFrames) * i / numSegments));
+
     data->startTime = std::chrono::steady_clock::now();
-    data->lastFPSReportTime = std::chrono::steady_clock::now();
 
-    std::unique_lock<std::mutex> lock(data->mutex);
+    // workers trim the untrimmed output themselves so they get absolute frame numbers
+    std::atomic<int> nextSegment(0);
+    std::vector<std::string> errors(numSegments);
+    std::vector<std::thread> jobs;
+    int numJobs = (opts.segmentJobs > 0) ? std::min(opts.segmentJobs, numSegments) : numSegments;
+    for (int j = 0; j < numJobs; j++) {
+        jobs.emplace_back([&]() {
+            int i;
+            while ((i = nextSegment++) < numSegments) {
+                int warmup = std::min(opts.segmentOverlap, static_cast<int>(opts.startPos + segmentStarts[i]));
+                int64_t first = opts.startPos + segmentStarts[i] - warmup;
+                int64_t last = opts.startPos + segmentStarts[i + 1] - 1;
+                if (!renderSegment(opts, first, last, warmup, getSegmentFilename(opts, i), errors[i]))
+                    break;
+                if (opts.printProgress)
+                    fprintf(stderr, "Segment %d/%d done\n", i + 1, numSegments);
+            }
+        });
+    }
 
-    int intitalRequestSize = std::min(requests, data->totalFrames);
-    data->requestedFrames = intitalRequestSize;
-    for (int n = 0; n < intitalRequestSize; n++) {
-        data->vsapi->getFrameAsync(n, data->node, frameDoneCallback, data);
-        if (data->alphaNode)
-            data->vsapi->getFrameAsync(n, data->alphaNode, frameDoneCallback, data);
+    for (auto &iter : jobs)
+        iter.join();
+
+    bool success = true;
+    for (int i = 0; i < numSegments && success; i++) {
+        if (!errors[i].empty()) {
+            fprintf(stderr, "%s\n", errors[i].c_str());
+            success = false;
+        }
     }
 
-    data->condition.wait(lock);
+    for (int i = 0; i < numSegments && success && data->outFile; i++) {
+        std::string error;
+        if (!appendSegment(getSegmentFilename(opts, i), frameSize, segmentStarts[i + 1] - segmentStarts[i], data, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            success = false;
+        }
+    }
 
-    if (data->outputError) {
-        for (auto &iter : data->reorderMap) {
-            data->vsapi->freeFrame(iter.second.first);
-            data->vsapi->freeFrame(iter.second.second);
+    if (!opts.keepSegmentFiles) {
+        for (int i = 0; i < numSegments; i++) {
+#ifdef VS_TARGET_OS_WINDOWS
+            _wremove(getSegmentFilename(opts, i).c_str());
+#else
+            remove(getSegmentFilename(opts, i).c_str());
+#endif
         }
-        fprintf(stderr, "%s\n", data->errorMessage.c_str());
     }
 
-    return data->outputError;
+    return success;
+}
+
+static int64_t getLatencyPercentile(const std::vector<int64_t> &sortedLatencies, double percentile) {
+    if (sortedLatencies.empty())
+        return 0;
+    return sortedLatencies[std::min(static_cast<size_t>(percentile * sortedLatencies.size()), sortedLatencies.size() - 1)];
+}
+
+// the node times and thread utilization include the warmup since the core only keeps totals
+static void printBenchmarkReport(FILE *outFile, VSPipeBenchmarkFormat format, VSPipeOutputData *data) {
+    VSCoreInfo info;
+    data->vsapi->getCoreInfo(data->core, &info);
+
+    std::vector<int64_t> latencies = data->frameLatencies;
+    std::sort(latencies.begin(), latencies.end());
+
+    int steadyFrames = data->totalFrames - data->warmupFrames;
+    double steadyTime = std::chrono::duration<double>(data->endTime - data->steadyStartTime).count();
+    double totalTime = std::chrono::duration<double>(data->endTime - data->startTime).count();
+    double fps = (steadyTime > 0) ? steadyFrames / steadyTime : 0;
+    double utilization = (totalTime > 0) ? getTotalNodeTime(data->node, data->vsapi) / (totalTime * 1000000000. * info.numThreads) : 0;
+    double latency[] = { getLatencyPercentile(latencies, 0.5) / 1000000., getLatencyPercentile(latencies, 0.95) / 1000000., getLatencyPercentile(latencies, 0.99) / 1000000. };
+
+    if (format == VSPipeBenchmarkFormat::JSON) {
+        fprintf(outFile, "{\"frames\": %d, \"warmupFrames\": %d, \"threads\": %d, \"time\": %f, \"steadyTime\": %f, \"fps\": %f, "
+            "\"latencyP50\": %f, \"latencyP95\": %f, \"latencyP99\": %f, \"peakFramebufferSize\": %" PRId64 ", \"maxFramebufferSize\": %" PRId64 ", \"threadUtilization\": %f, \"nodes\": %s}\n",
+            data->totalFrames, data->warmupFrames, info.numThreads, totalTime, steadyTime, fps, latency[0], latency[1], latency[2], data->peakFramebufferSize, info.maxFramebufferSize, utilization,
+            printNodeTimesJSON(data->node, data->vsapi).c_str());
+    } else {
+        fprintf(outFile, "Frames: %d (%d warmup)\n", data->totalFrames, data->warmupFrames);
+        fprintf(outFile, "Threads: %d\n", info.numThreads);
+        fprintf(outFile, "Total time: %.2f seconds\n", totalTime);
+        fprintf(outFile, "Steady state: %.2f fps over %.2f seconds\n", fps, steadyTime);
+        fprintf(outFile, "Frame latency: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n", latency[0], latency[1], latency[2]);
+        fprintf(outFile, "Peak framebuffer: %.2f MB of %.2f MB\n", data->peakFramebufferSize / (1024. * 1024.), info.maxFramebufferSize / (1024. * 1024.));
+        fprintf(outFile, "Thread utilization: %.2f%%\n\n", utilization * 100);
+        fprintf(outFile, "%s", printNodeTimes(data->node, totalTime, data->vsapi).c_str());
+    }
+}
+
+// Hashes every frame on the worker threads as it passes through, each frame number is only requested once so the hashes can be stored without locking
+
+struct FrameHashData {
+    VSNode *node;
+    std::vector<uint64_t> *hashes;
+};
+
+static uint64_t hashFrame(const VSFrame *frame, const VSAPI *vsapi) {
+    XXH64State state;
+    XXH64_Init(&state, 0);
+
+    if (vsapi->getFrameType(frame) == mtVideo) {
+        const VSVideoFormat *fi = vsapi->getVideoFrameFormat(frame);
+        for (int p = 0; p < fi->numPlanes; p++) {
+            ptrdiff_t stride = vsapi->getStride(frame, p);
+            const uint8_t *readPtr = vsapi->getReadPtr(frame, p);
+            size_t rowSize = vsapi->getFrameWidth(frame, p) * fi->bytesPerSample;
+            int height = vsapi->getFrameHeight(frame, p);
+            for (int y = 0; y < height; y++) {
+                XXH64_Update(&state, readPtr, rowSize);
+                readPtr += stride;
+            }
+        }
+    } else {
+        const VSAudioFormat *fi = vsapi->getAudioFrameFormat(frame);
+        size_t channelSize = vsapi->getFrameLength(frame) * static_cast<size_t>(fi->bytesPerSample);
+        for (int channel = 0; channel < fi->numChannels; channel++)
+            XXH64_Update(&state, vsapi->getReadPtr(frame, channel), channelSize);
+    }
+
+    return XXH64_Final(&state);
+}
+
+static const VSFrame *VS_CC frameHashGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    FrameHashData *d = reinterpret_cast<FrameHashData *>(instanceData);
+
+    if (activationReason == arInitial) {
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        const VSFrame *frame = vsapi->getFrameFilter(n, d->node, frameCtx);
+        (*d->hashes)[n] = hashFrame(frame, vsapi);
+        return frame;
+    }
+
+    return nullptr;
+}
+
+static void VS_CC frameHashFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    FrameHashData *d = reinterpret_cast<FrameHashData *>(instanceData);
+    vsapi->freeNode(d->node);
+    delete d;
+}
+
+// takes ownership of node
+static VSNode *createFrameHashFilter(VSNode *node, std::vector<uint64_t> &hashes, VSCore *core, const VSAPI *vsapi) {
+    FrameHashData *d = new FrameHashData{ node, &hashes };
+    VSFilterDependency deps[] = { { node, rpStrictSpatial } };
+    if (vsapi->getNodeType(node) == mtVideo) {
+        hashes.resize(vsapi->getVideoInfo(node)->numFrames);
+        return vsapi->createVideoFilter2("FrameHash", vsapi->getVideoInfo(node), frameHashGetFrame, frameHashFree, fmParallel, deps, 1, d, core);
+    } else {
+        hashes.resize(vsapi->getAudioInfo(node)->numFrames);
+        return vsapi->createAudioFilter2("FrameHash", vsapi->getAudioInfo(node), frameHashGetFrame, frameHashFree, fmParallel, deps, 1, d, core);
+    }
+}
+
+// the combined hash is the hash of all frame hashes in order with the alpha hash following its frame
+static uint64_t combineFrameHashes(const VSPipeOutputData *data) {
+    XXH64State state;
+    XXH64_Init(&state, 0);
+    for (int n = 0; n < data->totalFrames; n++) {
+        uint8_t bytes[16];
+        int numBytes = 0;
+        for (uint64_t hash : { data->frameHashes[n], data->alphaNode ? data->alphaFrameHashes[n] : 0 }) {
+            for (int i = 0; i < 8; i++)
+                bytes[numBytes++] = static_cast<uint8_t>(hash >> (i * 8));
+        }
+        XXH64_Update(&state, bytes, data->alphaNode ? 16 : 8);
+    }
+    return XXH64_Final(&state);
+}
+
+static bool writeFrameHashes(const nstring &filename, const VSPipeOutputData *data) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(filename.c_str(), L"wb");
+#else
+    FILE *f = fopen(filename.c_str(), "wb");
+#endif
+    if (!f)
+        return false;
+
+    bool success = true;
+    for (int n = 0; n < data->totalFrames && success; n++) {
+        if (data->alphaNode)
+            success = (fprintf(f, "%d %016" PRIx64 " %016" PRIx64 "\n", n, data->frameHashes[n], data->alphaFrameHashes[n]) >= 0);
+        else
+            success = (fprintf(f, "%d %016" PRIx64 "\n", n, data->frameHashes[n]) >= 0);
+    }
+
+    return !fclose(f) && success;
 }
 
 static const char *colorFamilyToString(int colorFamily) {
@@ -619,10 +1605,88 @@ static bool nstringToInt(const nstring &ns, int &result) {
         result = std::stoi(s, &pos);
     } catch (std::invalid_argument &) {
         return false;
-    } catch (std::out_of_range &) {
+    } catch (std::out_of_range &) {
+        return false;
+    }
+    return pos == s.length();
+}
+
+// scripts are recognized by their first bytes and aren't read any further
+static bool readGraphPlanFile(const nstring &filename, std::vector<uint8_t> &data) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(filename.c_str(), L"rb");
+#else
+    FILE *f = fopen(filename.c_str(), "rb");
+#endif
+    if (!f)
+        return false;
+
+    uint8_t buffer[65536];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data.insert(data.end(), buffer, buffer + size);
+        if (!isGraphPlan(data))
+            break;
+    }
+    fclose(f);
+    return isGraphPlan(data);
+}
+
+// a graph plan only has the selected output, otherwise every output the recording used is looked up in the script
+static bool replayRequestFile(const VSPipeOptions &opts, VSScript *se, const VSSCRIPTAPI *vssapi, VSNode *node, VSNode *alphaNode, FILE *outFile, const VSAPI *vsapi) {
+#ifdef VS_TARGET_OS_WINDOWS
+    FILE *f = _wfopen(opts.replayFilename.c_str(), L"rb");
+#else
+    FILE *f = fopen(opts.replayFilename.c_str(), "rb");
+#endif
+    if (!f) {
+        fprintf(stderr, "Failed to open request recording\n");
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.insert(data.end(), buffer, buffer + size);
+    fclose(f);
+
+    std::vector<RecordedRequest> requests;
+    std::string error;
+    if (!loadRequestRecording(data, requests, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
         return false;
     }
-    return pos == s.length();
+
+    ReplayNodes nodes;
+    std::vector<VSNode *> ownedNodes;
+    nodes[std::make_pair(opts.outputIndex, false)] = node;
+    if (alphaNode)
+        nodes[std::make_pair(opts.outputIndex, true)] = alphaNode;
+    if (se) {
+        for (const auto &iter : requests) {
+            if (iter.outputIndex < 0 || nodes.count(std::make_pair(static_cast<int>(iter.outputIndex), false)))
+                continue;
+            VSNode *outputNode = vssapi->getOutputNode(se, iter.outputIndex);
+            if (!outputNode)
+                continue;
+            nodes[std::make_pair(static_cast<int>(iter.outputIndex), false)] = outputNode;
+            ownedNodes.push_back(outputNode);
+            VSNode *outputAlphaNode = vssapi->getOutputAlphaNode(se, iter.outputIndex);
+            if (outputAlphaNode) {
+                nodes[std::make_pair(static_cast<int>(iter.outputIndex), true)] = outputAlphaNode;
+                ownedNodes.push_back(outputAlphaNode);
+            }
+        }
+    }
+
+    bool success = replayRequests(requests, nodes, outFile, vsapi, error);
+    if (!success)
+        fprintf(stderr, "%s\n", error.c_str());
+
+    for (VSNode *iter : ownedNodes)
+        vsapi->freeNode(iter);
+    return success;
 }
 
 static bool printVersion(const VSAPI *vsapi) {
@@ -649,13 +1713,38 @@ static void printHelp() {
         "  -s, --start N                    Set output frame/sample range start\n"
         "  -e, --end N                      Set output frame/sample range end (inclusive)\n"
         "  -o, --outputindex N              Select output index\n"
-        "  -r, --requests N                 Set number of concurrent frame requests\n"
+        "  -r, --requests <N/auto>          Set number of concurrent frame requests or adjust it while running\n"
+        "      --reorder-window N           Set the maximum number of frames held for reordering and writing, defaults to twice the number of requests\n"
+        "      --backpressure <stall/grow>  Stop requesting frames or grow the reorder window when a slow frame fills it\n"
+        "      --live N                     Output a live source in order, frames later than N milliseconds are replaced by the previous one\n"
         "  -c, --container <y4m/wav/w64>    Add headers for the specified format to the output\n"
+        "      --add-output N[:container] FILE  Also write output index N to FILE in the same run, can be used several times\n"
         "  -t, --timecodes FILE             Write timecodes v2 file\n"
+        "      --checkpoint FILE            Periodically record how far the output has been written\n"
+        "      --resume                     Continue from the checkpoint file if it exists instead of starting over\n"
+        "      --shm NAME                   Publish the output in a shared memory ring instead of writing it, see sharedoutput.h\n"
+        "      --shm-slots N                Set the number of frames the shared memory ring holds, defaults to 4\n"
+        "      --direct                     Write the output file with unbuffered aligned writes that bypass the OS file cache\n"
         "  -p, --progress                   Print progress to stderr\n"
+        "      --hash                       Print a combined xxh64 hash of all frames, hashed in parallel\n"
+        "      --hash-file FILE             Write the xxh64 hash of every frame to a file, implies --hash\n"
         "      --filter-time                Prints time spent in individual filters after processing\n"
+        "      --trace FILE                 Write a chrome/perfetto trace of the frame processing\n"
+        "      --cache-sizes FILE           Start the caches at the sizes stored in FILE by the previous run and store the new sizes after processing\n"
+        "      --metrics-port N             Serve live OpenMetrics statistics on http://127.0.0.1:N/metrics while processing\n"
+        "      --serve N                    Serve the output to remote.Source on port N of all interfaces instead of writing it\n"
         "  -i, --info                       Show output node info and exit\n"
+        "      --plan                       Write a graph plan of the output to <outfile> that vspipe can use instead of the script to skip starting Python\n"
         "  -g  --graph <simple/full>        Print output node filter graph in dot format and exit\n"
+        "  -g  --graph profile              Process the -s/-e range like --benchmark, then print the graph with per node time, cache and request statistics\n"
+        "      --benchmark <text/json>      Process all frames without output and print timing statistics to the output\n"
+        "      --replay-requests FILE       Issue the requests from a recording made with core.record_requests() again and print their latency\n"
+        "      --warmup N                   Don't output the first N frames or exclude them from the benchmark fps and latency\n"
+        "      --segments N                 Render the output in N segments with separate vspipe processes and stitch them together\n"
+        "      --segment-overlap N          Start every segment N frames early so temporal filters are warm\n"
+        "      --segment-jobs N             Set the number of segments rendered at the same time, defaults to all\n"
+        "      --segment-files              Keep the raw segment files named <outfile>.segmentNNNN\n"
+        "      --worker-command CMD         Command used to start the workers instead of this vspipe, for example ssh host vspipe\n"
         "  -v, --version                    Show version info and exit\n"
         "\n"
         "Examples:\n"
@@ -671,11 +1760,35 @@ static void printHelp() {
         "    vspipe --arg deinterlace=yes --arg \"message=fluffy kittens\" script.vpy output.raw\n"
         "  Pipe to x264 and write timecodes file:\n"
         "    vspipe script.vpy - -c y4m --timecodes timecodes.txt | x264 --demuxer y4m -o script.mkv -\n"
+        "  Write the video and audio of a script in one run:\n"
+        "    vspipe -c y4m --add-output 1:wav audio.wav script.vpy video.y4m\n"
+        "  Save a graph plan and encode from it:\n"
+        "    vspipe --plan script.vpy script.vsplan\n"
+        "    vspipe script.vsplan - -c y4m | x264 --demuxer y4m -o script.mkv -\n"
+        "  Replay the requests recorded while previewing a script:\n"
+        "    vspipe --replay-requests preview.vsrq script.vpy -\n"
+        "  Stream a capture script with at most 100 ms of processing latency:\n"
+        "    vspipe --live 100 -c y4m capture.vpy - | ffplay -\n"
         );
 }
 
+static bool parseContainer(const std::string &name, VSPipeHeaders &headers) {
+    if (name == "y4m")
+        headers = VSPipeHeaders::Y4M;
+    else if (name == "wav")
+        headers = VSPipeHeaders::WAVE;
+    else if (name == "w64")
+        headers = VSPipeHeaders::WAVE64;
+    else
+        return false;
+    return true;
+}
+
 template<typename T>
 static int parseOptions(VSPipeOptions &opts, int argc, T **argv) {
+    if (argc > 0)
+        opts.executablePath = argv[0];
+
     for (int arg = 1; arg < argc; arg++) {
         nstring argString = argv[arg];
         if (argString == NSTRING("-v") || argString == NSTRING("--version")) {
@@ -691,13 +1804,7 @@ static int parseOptions(VSPipeOptions &opts, int argc, T **argv) {
                 return 1;
             }
 
-            if (nstringToUtf8(argv[arg + 1]) == "y4m") {
-                opts.outputHeaders = VSPipeHeaders::Y4M;
-            } else if (nstringToUtf8(argv[arg + 1]) == "wav") {
-                opts.outputHeaders = VSPipeHeaders::WAVE;
-            } else if (nstringToUtf8(argv[arg + 1]) == "w64") {
-                opts.outputHeaders = VSPipeHeaders::WAVE64;
-            } else {
+            if (!parseContainer(nstringToUtf8(argv[arg + 1]), opts.outputHeaders)) {
                 fprintf(stderr, "Unknown container type specified: %s\n", nstringToUtf8(argv[arg + 1]).c_str());
                 return 1;
             }
@@ -710,10 +1817,22 @@ static int parseOptions(VSPipeOptions &opts, int argc, T **argv) {
             opts.printProgress = true;
         } else if (argString == NSTRING("--md5")) {
             opts.calculateMD5 = true;
+        } else if (argString == NSTRING("--hash")) {
+            opts.calculateHash = true;
+        } else if (argString == NSTRING("--hash-file")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No hash file specified\n");
+                return 1;
+            }
+
+            opts.calculateHash = true;
+            opts.hashFilename = argv[arg + 1];
+
+            arg++;
         } else if (argString == NSTRING("--filter-time")) {
             opts.printFilterTime = true;
         } else if (argString == NSTRING("-i") || argString == NSTRING("--info")) {
-            if (opts.mode == VSPipeMode::PrintSimpleGraph || opts.mode == VSPipeMode::PrintFullGraph) {
+            if (opts.mode == VSPipeMode::PrintSimpleGraph || opts.mode == VSPipeMode::PrintFullGraph || opts.mode == VSPipeMode::PrintProfileGraph) {
                 fprintf(stderr, "Cannot combine graph and info arguments\n");
                 return 1;
             }
@@ -734,11 +1853,48 @@ static int parseOptions(VSPipeOptions &opts, int argc, T **argv) {
                 opts.mode = VSPipeMode::PrintSimpleGraph;
             } else if (nstringToUtf8(argv[arg + 1]) == "full") {
                 opts.mode = VSPipeMode::PrintFullGraph;
+            } else if (nstringToUtf8(argv[arg + 1]) == "profile") {
+                opts.mode = VSPipeMode::PrintProfileGraph;
             } else {
                 fprintf(stderr, "Unknown graph type specified: %s\n", nstringToUtf8(argv[arg + 1]).c_str());
                 return 1;
             }
 
+            arg++;
+        } else if (argString == NSTRING("--benchmark")) {
+            if (opts.mode == VSPipeMode::PrintInfo || opts.mode == VSPipeMode::PrintSimpleGraph || opts.mode == VSPipeMode::PrintFullGraph || opts.mode == VSPipeMode::PrintProfileGraph) {
+                fprintf(stderr, "Cannot combine benchmark with info or graph arguments\n");
+                return 1;
+            }
+
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No benchmark report format specified\n");
+                return 1;
+            }
+
+            if (nstringToUtf8(argv[arg + 1]) == "text") {
+                opts.benchmarkFormat = VSPipeBenchmarkFormat::Text;
+            } else if (nstringToUtf8(argv[arg + 1]) == "json") {
+                opts.benchmarkFormat = VSPipeBenchmarkFormat::JSON;
+            } else {
+                fprintf(stderr, "Unknown benchmark report format specified: %s\n", nstringToUtf8(argv[arg + 1]).c_str());
+                return 1;
+            }
+
+            opts.mode = VSPipeMode::Benchmark;
+
+            arg++;
+        } else if (argString == NSTRING("--warmup")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "Number of warmup frames not specified\n");
+                return 1;
+            }
+
+            if (!nstringToInt(argv[arg + 1], opts.warmupFrames)) {
+                fprintf(stderr, "Couldn't convert %s to an integer (warmup)\n", nstringToUtf8(argv[arg + 1]).c_str());
+                return 1;
+            }
+
             arg++;
         } else if (argString == NSTRING("-h") || argString == NSTRING("--help")) {
             if (argc > 2) {
@@ -799,11 +1955,113 @@ static int parseOptions(VSPipeOptions &opts, int argc, T **argv) {
                 return 1;
             }
 
-            if (!nstringToInt(argv[arg + 1], opts.requests)) {
+            if (nstring(argv[arg + 1]) == NSTRING("auto")) {
+                opts.adaptiveRequests = true;
+                opts.requests = 0;
+            } else if (!nstringToInt(argv[arg + 1], opts.requests)) {
                 fprintf(stderr, "Couldn't convert %s to an integer (requests)\n", nstringToUtf8(argv[arg + 1]).c_str());
                 return 1;
             }
 
+            arg++;
+        } else if (argString == NSTRING("--shm")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No shared memory name specified\n");
+                return 1;
+            }
+
+            opts.sharedOutputName = nstringToUtf8(argv[arg + 1]);
+
+            arg++;
+        } else if (argString == NSTRING("--shm-slots")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "Number of shared memory slots not specified\n");
+                return 1;
+            }
+
+            if (!nstringToInt(argv[arg + 1], opts.sharedOutputSlots) || opts.sharedOutputSlots < 1) {
+                fprintf(stderr, "Couldn't convert %s to a positive integer (shared memory slots)\n", nstringToUtf8(argv[arg + 1]).c_str());
+                return 1;
+            }
+
+            arg++;
+        } else if (argString == NSTRING("--direct")) {
+            opts.directOutput = true;
+        } else if (argString == NSTRING("--segments") || argString == NSTRING("--segment-overlap") || argString == NSTRING("--segment-jobs")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No value specified for %s\n", nstringToUtf8(argString).c_str());
+                return 1;
+            }
+
+            int &value = (argString == NSTRING("--segments")) ? opts.segments : ((argString == NSTRING("--segment-overlap")) ? opts.segmentOverlap : opts.segmentJobs);
+            if (!nstringToInt(argv[arg + 1], value) || value < 0) {
+                fprintf(stderr, "Couldn't convert %s to a positive integer (%s)\n", nstringToUtf8(argv[arg + 1]).c_str(), nstringToUtf8(argString).c_str());
+                return 1;
+            }
+
+            arg++;
+        } else if (argString == NSTRING("--checkpoint")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No checkpoint file specified\n");
+                return 1;
+            }
+
+            opts.checkpointFilename = argv[arg + 1];
+
+            arg++;
+        } else if (argString == NSTRING("--resume")) {
+            opts.resume = true;
+        } else if (argString == NSTRING("--segment-files")) {
+            opts.keepSegmentFiles = true;
+        } else if (argString == NSTRING("--worker-command")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No worker command specified\n");
+                return 1;
+            }
+
+            opts.workerCommand = argv[arg + 1];
+
+            arg++;
+        } else if (argString == NSTRING("--reorder-window")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "Reorder window size not specified\n");
+                return 1;
+            }
+
+            if (!nstringToInt(argv[arg + 1], opts.reorderWindow)) {
+                fprintf(stderr, "Couldn't convert %s to an integer (reorder window)\n", nstringToUtf8(argv[arg + 1]).c_str());
+                return 1;
+            }
+
+            arg++;
+        } else if (argString == NSTRING("--live")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "Live latency not specified\n");
+                return 1;
+            }
+
+            if (!nstringToInt(argv[arg + 1], opts.liveLatency) || opts.liveLatency < 1) {
+                fprintf(stderr, "Couldn't convert %s to a positive integer (live latency)\n", nstringToUtf8(argv[arg + 1]).c_str());
+                return 1;
+            }
+
+            arg++;
+        } else if (argString == NSTRING("--backpressure")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "Backpressure policy not specified\n");
+                return 1;
+            }
+
+            nstring policy = argv[arg + 1];
+            if (policy == NSTRING("stall")) {
+                opts.backpressure = VSPipeBackpressure::Stall;
+            } else if (policy == NSTRING("grow")) {
+                opts.backpressure = VSPipeBackpressure::Grow;
+            } else {
+                fprintf(stderr, "Unknown backpressure policy %s\n", nstringToUtf8(policy).c_str());
+                return 1;
+            }
+
             arg++;
         } else if (argString == NSTRING("-a") || argString == NSTRING("--arg")) {
             if (argc <= arg + 1) {
@@ -829,6 +2087,83 @@ static int parseOptions(VSPipeOptions &opts, int argc, T **argv) {
 
             opts.timecodesFilename = argv[arg + 1];
 
+            arg++;
+        } else if (argString == NSTRING("--trace")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No trace file specified\n");
+                return 1;
+            }
+
+            opts.traceFilename = argv[arg + 1];
+
+            arg++;
+        } else if (argString == NSTRING("--cache-sizes")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No cache size file specified\n");
+                return 1;
+            }
+
+            opts.cacheSizesFilename = argv[arg + 1];
+
+            arg++;
+        } else if (argString == NSTRING("--metrics-port")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No metrics port specified\n");
+                return 1;
+            }
+
+            if (!nstringToInt(argv[arg + 1], opts.metricsPort) || opts.metricsPort < 1 || opts.metricsPort > 65535) {
+                fprintf(stderr, "Couldn't convert %s to a valid port number (metrics port)\n", nstringToUtf8(argv[arg + 1]).c_str());
+                return 1;
+            }
+
+            arg++;
+        } else if (argString == NSTRING("--serve")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No serve port specified\n");
+                return 1;
+            }
+
+            if (!nstringToInt(argv[arg + 1], opts.servePort) || opts.servePort < 1 || opts.servePort > 65535) {
+                fprintf(stderr, "Couldn't convert %s to a valid port number (serve port)\n", nstringToUtf8(argv[arg + 1]).c_str());
+                return 1;
+            }
+
+            opts.mode = VSPipeMode::Serve;
+            arg++;
+        } else if (argString == NSTRING("--add-output")) {
+            if (argc <= arg + 2) {
+                fprintf(stderr, "No output index and file specified\n");
+                return 1;
+            }
+
+            VSPipeExtraOutput extra;
+            nstring spec = argv[arg + 1];
+            size_t separator = spec.find(NSTRING(':'));
+            if (!nstringToInt(spec.substr(0, separator), extra.index) || extra.index < 0) {
+                fprintf(stderr, "Couldn't convert %s to a valid output index\n", nstringToUtf8(spec).c_str());
+                return 1;
+            }
+
+            if (separator != nstring::npos && !parseContainer(nstringToUtf8(spec.substr(separator + 1)), extra.headers)) {
+                fprintf(stderr, "Unknown container type specified: %s\n", nstringToUtf8(spec.substr(separator + 1)).c_str());
+                return 1;
+            }
+
+            extra.filename = argv[arg + 2];
+            opts.extraOutputs.push_back(extra);
+            arg += 2;
+        } else if (argString == NSTRING("--plan")) {
+            opts.mode = VSPipeMode::SavePlan;
+        } else if (argString == NSTRING("--replay-requests")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No request recording specified\n");
+                return 1;
+            }
+
+            opts.replayFilename = argv[arg + 1];
+            opts.mode = VSPipeMode::ReplayRequests;
+
             arg++;
         } else if (opts.scriptFilename.empty() && !argString.empty() && argString.substr(0, 1) != NSTRING("-")) {
             opts.scriptFilename = argString;
@@ -844,12 +2179,24 @@ static int parseOptions(VSPipeOptions &opts, int argc, T **argv) {
     if (argc <= 1)
         opts.mode = VSPipeMode::PrintHelp;
 
-    if ((opts.mode == VSPipeMode::Output || opts.mode == VSPipeMode::PrintInfo || opts.mode == VSPipeMode::PrintSimpleGraph || opts.mode == VSPipeMode::PrintFullGraph) && opts.scriptFilename.empty()) {
+    if ((opts.mode == VSPipeMode::Output || opts.mode == VSPipeMode::PrintInfo || opts.mode == VSPipeMode::PrintSimpleGraph || opts.mode == VSPipeMode::PrintFullGraph || opts.mode == VSPipeMode::PrintProfileGraph || opts.mode == VSPipeMode::Benchmark || opts.mode == VSPipeMode::Serve || opts.mode == VSPipeMode::SavePlan || opts.mode == VSPipeMode::ReplayRequests) && opts.scriptFilename.empty()) {
         fprintf(stderr, "No script file specified\n");
         return 1;
-    } else if (opts.mode == VSPipeMode::Output && opts.outputFilename.empty()) {
+    } else if (opts.mode == VSPipeMode::Output && opts.outputFilename.empty() && opts.sharedOutputName.empty()) {
         fprintf(stderr, "No output file specified\n");
         return 1;
+    } else if (opts.mode == VSPipeMode::SavePlan && (opts.outputFilename.empty() || opts.outputFilename == NSTRING("."))) {
+        fprintf(stderr, "No plan file specified\n");
+        return 1;
+    } else if (!opts.extraOutputs.empty() && (opts.mode != VSPipeMode::Output || !opts.sharedOutputName.empty() || opts.segments > 0 || !opts.checkpointFilename.empty() || opts.calculateHash)) {
+        fprintf(stderr, "Additional outputs can only be written to files without --shm, --segments, --checkpoint or --hash\n");
+        return 1;
+    } else if (opts.directOutput && (opts.mode != VSPipeMode::Output || opts.outputFilename.empty() || opts.outputFilename == NSTRING("-") || opts.outputFilename == NSTRING(".") || !opts.sharedOutputName.empty() || opts.segments > 0 || !opts.checkpointFilename.empty())) {
+        fprintf(stderr, "Direct output can only be used when writing to a file without --shm, --segments or --checkpoint\n");
+        return 1;
+    } else if (opts.liveLatency > 0 && (opts.mode != VSPipeMode::Output || opts.segments > 0 || !opts.checkpointFilename.empty() || !opts.extraOutputs.empty() || opts.calculateHash)) {
+        fprintf(stderr, "Live output can't be combined with --segments, --checkpoint, --add-output, --hash or other modes\n");
+        return 1;
     }
 
     return 0;
@@ -863,37 +2210,91 @@ int wmain(int argc, wchar_t **argv) {
 #else
 int main(int argc, char **argv) {
 #endif
-    const VSSCRIPTAPI *vssapi = getVSScriptAPI(VSSCRIPT_API_VERSION);
-    if (!vssapi) {
-        fprintf(stderr, "Failed to initialize VSScript\n");
-        return 1;
+    VSPipeOptions opts{};
+    int parseResult = parseOptions(opts, argc, argv);
+    if (parseResult)
+        return parseResult;
+
+    if (opts.mode == VSPipeMode::PrintHelp) {
+        printHelp();
+        return 0;
+    }
+
+    // graph plans are rebuilt with the core alone so Python is never started for them
+    std::vector<uint8_t> plan;
+    bool usePlan = opts.mode != VSPipeMode::PrintVersion && opts.mode != VSPipeMode::SavePlan && readGraphPlanFile(opts.scriptFilename, plan);
+
+    const VSSCRIPTAPI *vssapi = nullptr;
+    const VSAPI *vsapi = nullptr;
+    if (usePlan) {
+        vsapi = getVapourSynthAPI(VAPOURSYNTH_API_VERSION);
+    } else {
+        vssapi = getVSScriptAPI(VSSCRIPT_API_VERSION);
+        if (!vssapi) {
+            fprintf(stderr, "Failed to initialize VSScript\n");
+            return 1;
+        }
+        vsapi = vssapi->getVSAPI(VAPOURSYNTH_API_VERSION);
     }
 
-    const VSAPI *vsapi = vssapi->getVSAPI(VAPOURSYNTH_API_VERSION);
     if (!vsapi) {
         fprintf(stderr, "Failed to get VapourSynth API pointer\n");
         return 1;
     }
 
-    VSPipeOptions opts{};
-    int parseResult = parseOptions(opts, argc, argv);
-    if (parseResult)
-        return parseResult;
-
-    if (opts.mode == VSPipeMode::PrintVersion) {
+    if (opts.mode == VSPipeMode::PrintVersion)
         return printVersion(vsapi) ? 0 : 1;
-    } else if (opts.mode == VSPipeMode::PrintHelp) {
-        printHelp();
-        return 0;
+
+    VSPipeCheckpoint checkpoint;
+    bool resuming = false;
+    if (!opts.checkpointFilename.empty()) {
+        if (opts.mode != VSPipeMode::Output || opts.outputFilename.empty() || opts.outputFilename == NSTRING("-") || opts.outputFilename == NSTRING(".") || !opts.sharedOutputName.empty() || opts.segments > 0 || opts.calculateHash) {
+            fprintf(stderr, "Checkpoints can only be used when writing to a file without --shm, --segments or --hash\n");
+            return 1;
+        }
+
+        // without a checkpoint to resume from everything starts from the beginning
+        resuming = opts.resume && readCheckpoint(opts.checkpointFilename, checkpoint);
+        if (resuming && (checkpoint.startPos != opts.startPos || checkpoint.endPos != opts.endPos || checkpoint.outputIndex != opts.outputIndex)) {
+            fprintf(stderr, "The checkpoint was made with a different frame range or output index\n");
+            return 1;
+        }
+
+        if (resuming && checkpoint.md5State.empty() == opts.calculateMD5) {
+            fprintf(stderr, "The checkpoint was made with a different --md5 setting\n");
+            return 1;
+        }
+    } else if (opts.resume) {
+        fprintf(stderr, "No checkpoint file specified\n");
+        return 1;
     }
 
     FILE *outFile = nullptr;
     bool closeOutFile = false;
+    std::unique_ptr<DirectOutput> directOutput;
 
-    if (opts.outputFilename.empty() || opts.outputFilename == NSTRING("-")) {
+    if (resuming) {
+#ifdef VS_TARGET_OS_WINDOWS
+        outFile = _wfopen(opts.outputFilename.c_str(), L"r+b");
+#else
+        outFile = fopen(opts.outputFilename.c_str(), "r+b");
+#endif
+        if (!outFile || !truncateFile(outFile, checkpoint.outputBytes)) {
+            fprintf(stderr, "Failed to reopen output for resuming\n");
+            return 1;
+        }
+        closeOutFile = true;
+    } else if (opts.outputFilename.empty() || opts.outputFilename == NSTRING("-")) {
         outFile = stdout;
     } else if (opts.outputFilename == NSTRING(".")) {
         // do nothing
+    } else if (opts.directOutput) {
+        std::string error;
+        directOutput.reset(DirectOutput::create(nstringToUtf8(opts.outputFilename), error));
+        if (!directOutput) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
     } else {
 #ifdef VS_TARGET_OS_WINDOWS
         outFile = _wfopen(opts.outputFilename.c_str(), L"wb");
@@ -910,53 +2311,111 @@ int main(int argc, char **argv) {
     FILE *timecodesFile = nullptr;
     if (opts.mode == VSPipeMode::Output && !opts.timecodesFilename.empty()) {
 #ifdef VS_TARGET_OS_WINDOWS
-        timecodesFile = _wfopen(opts.timecodesFilename.c_str(), L"wb");
+        timecodesFile = _wfopen(opts.timecodesFilename.c_str(), resuming ? L"r+b" : L"wb");
 #else
-        timecodesFile = fopen(opts.timecodesFilename.c_str(), "wb");
+        timecodesFile = fopen(opts.timecodesFilename.c_str(), resuming ? "r+b" : "wb");
 #endif
-        if (!timecodesFile) {
+        if (!timecodesFile || (resuming && !truncateFile(timecodesFile, checkpoint.timecodesBytes))) {
             fprintf(stderr, "Failed to open timecodes file for writing\n");
             return 1;
         }
     }
 
-    vsapi = vssapi->getVSAPI(VAPOURSYNTH_API_VERSION);
-    if (!vsapi) {
-        fprintf(stderr, "Failed to get VapourSynth API pointer\n");
-        return 1;
-    }
-
     std::chrono::time_point<std::chrono::steady_clock> scriptEvaluationStart = std::chrono::steady_clock::now();
     
-    VSScriptOptions scriptOpts = { sizeof(VSScriptOptions), (opts.mode == VSPipeMode::PrintSimpleGraph || opts.mode == VSPipeMode::PrintFullGraph || opts.printFilterTime) ? ccfEnableGraphInspection : 0, logMessageHandler, nullptr, nullptr };
+    int coreFlags = (opts.mode == VSPipeMode::PrintSimpleGraph || opts.mode == VSPipeMode::PrintFullGraph || opts.mode == VSPipeMode::PrintProfileGraph || opts.mode == VSPipeMode::Benchmark || opts.mode == VSPipeMode::SavePlan || opts.printFilterTime) ? ccfEnableGraphInspection : 0;
+    if (!opts.traceFilename.empty())
+        coreFlags |= ccfEnableTracing;
+    if (opts.liveLatency > 0)
+        coreFlags |= ccfLiveMode;
+    VSScriptOptions scriptOpts = { sizeof(VSScriptOptions), coreFlags, logMessageHandler, nullptr, nullptr };
 
     VSScript *se = nullptr;
-    if (!opts.scriptArgs.empty()) {
-        VSMap *foldedArgs = vsapi->createMap();
-        for (const auto &iter : opts.scriptArgs)
-            vsapi->mapSetData(foldedArgs, iter.first.c_str(), iter.second.c_str(), static_cast<int>(iter.second.size()), dtUtf8, maAppend);
-        se = vssapi->evaluateFile(nstringToUtf8(opts.scriptFilename).c_str(), foldedArgs, &scriptOpts);
-        vsapi->freeMap(foldedArgs);
+    VSCore *core = nullptr;
+    VSNode *node = nullptr;
+    VSNode *alphaNode = nullptr;
+
+    std::vector<std::pair<VSNode *, VSNode *>> extraNodes;
+
+    if (usePlan) {
+        if (!opts.extraOutputs.empty()) {
+            fprintf(stderr, "A graph plan only contains a single output\n");
+            return 1;
+        }
+
+        if (!opts.scriptArgs.empty())
+            fprintf(stderr, "Warning: script arguments are ignored when using a graph plan\n");
+
+        core = vsapi->createCore(coreFlags);
+        vsapi->addLogHandler(logMessageHandler, nullptr, nullptr, core);
+
+        std::string error;
+        if (!loadGraphPlan(plan, opts.outputIndex, core, vsapi, node, alphaNode, error)) {
+            fprintf(stderr, "Graph plan loading failed:\n%s\n", error.c_str());
+            vsapi->freeCore(core);
+            return 1;
+        }
     } else {
-        se = vssapi->evaluateFile(nstringToUtf8(opts.scriptFilename).c_str(), nullptr, &scriptOpts);
-    }
+        if (!opts.scriptArgs.empty()) {
+            VSMap *foldedArgs = vsapi->createMap();
+            for (const auto &iter : opts.scriptArgs)
+                vsapi->mapSetData(foldedArgs, iter.first.c_str(), iter.second.c_str(), static_cast<int>(iter.second.size()), dtUtf8, maAppend);
+            se = vssapi->evaluateFile(nstringToUtf8(opts.scriptFilename).c_str(), foldedArgs, &scriptOpts);
+            vsapi->freeMap(foldedArgs);
+        } else {
+            se = vssapi->evaluateFile(nstringToUtf8(opts.scriptFilename).c_str(), nullptr, &scriptOpts);
+        }
 
-    if (vssapi->getError(se)) {
-        int code = vssapi->getExitCode(se);
-        if (code == 0) code = 1;
-        fprintf(stderr, "Script evaluation failed:\n%s\n", vssapi->getError(se));
-        vssapi->freeScript(se);
-        return code;
-    }
+        if (vssapi->getError(se)) {
+            int code = vssapi->getExitCode(se);
+            if (code == 0) code = 1;
+            fprintf(stderr, "Script evaluation failed:\n%s\n", vssapi->getError(se));
+            vssapi->freeScript(se);
+            return code;
+        }
 
-    VSNode *node = vssapi->getOutputNode(se, opts.outputIndex);
-    if (!node) {
-       fprintf(stderr, "Failed to retrieve output node. Invalid index specified?\n");
-       vssapi->freeScript(se);
-       return 1;
+        node = vssapi->getOutputNode(se, opts.outputIndex);
+        if (!node) {
+           fprintf(stderr, "Failed to retrieve output node. Invalid index specified?\n");
+           vssapi->freeScript(se);
+           return 1;
+        }
+
+        alphaNode = vssapi->getOutputAlphaNode(se, opts.outputIndex);
+        core = vssapi->getCore(se);
+
+        for (const auto &iter : opts.extraOutputs) {
+            VSNode *extraNode = vssapi->getOutputNode(se, iter.index);
+            if (!extraNode) {
+                fprintf(stderr, "Failed to retrieve output node %d\n", iter.index);
+                for (auto &iter2 : extraNodes) {
+                    vsapi->freeNode(iter2.first);
+                    vsapi->freeNode(iter2.second);
+                }
+                vsapi->freeNode(node);
+                vsapi->freeNode(alphaNode);
+                vssapi->freeScript(se);
+                return 1;
+            }
+            extraNodes.emplace_back(extraNode, vssapi->getOutputAlphaNode(se, iter.index));
+        }
     }
 
-    VSNode *alphaNode = vssapi->getOutputAlphaNode(se, opts.outputIndex);
+    // the core of a plan belongs to vspipe itself
+    auto freeScript = [&]() {
+        for (auto &iter : extraNodes) {
+            vsapi->freeNode(iter.first);
+            vsapi->freeNode(iter.second);
+        }
+        if (se)
+            vssapi->freeScript(se);
+        else
+            vsapi->freeCore(core);
+    };
+
+    // there are no stored sizes the first time
+    if (!opts.cacheSizesFilename.empty())
+        vsapi->loadCacheSizes(nstringToUtf8(opts.cacheSizesFilename).c_str(), core);
 
     std::chrono::duration<double> scriptEvaluationTime = std::chrono::steady_clock::now() - scriptEvaluationStart;
     if (opts.printProgress)
@@ -972,42 +2431,86 @@ int main(int argc, char **argv) {
         std::string graph = printNodeGraph(false, node, vsapi);
         if (outFile)
             fprintf(outFile, "%s\n", graph.c_str());
+    } else if (opts.mode == VSPipeMode::SavePlan) {
+        std::vector<uint8_t> buffer;
+        std::string error;
+        if (!writeGraphPlan(buffer, opts.outputIndex, node, alphaNode, vsapi, error)) {
+            fprintf(stderr, "Failed to create graph plan: %s\n", error.c_str());
+            success = false;
+        } else if (outFile && fwrite(buffer.data(), 1, buffer.size(), outFile) != buffer.size()) {
+            fprintf(stderr, "Failed to write graph plan\n");
+            success = false;
+        }
+    } else if (opts.mode == VSPipeMode::Serve) {
+        std::string error;
+        serveRemoteNode(opts.servePort, node, vsapi, error);
+        fprintf(stderr, "%s\n", error.c_str());
+        success = false;
+    } else if (opts.mode == VSPipeMode::ReplayRequests) {
+        success = replayRequestFile(opts, se, vssapi, node, alphaNode, outFile, vsapi);
     } else {
         int nodeType = vsapi->getNodeType(node);
 
-        if (opts.startPos != 0 || opts.endPos != -1) {
-            VSMap *args = vsapi->createMap();
-            vsapi->mapSetNode(args, "clip", node, maAppend);
-            if (opts.startPos != 0)
-                vsapi->mapSetInt(args, "first", opts.startPos, maAppend);
-            if (opts.endPos > -1)
-                vsapi->mapSetInt(args, "last", opts.endPos, maAppend);
-            VSMap *result = vsapi->invoke(vsapi->getPluginByID(VSH_STD_PLUGIN_ID, vssapi->getCore(se)), (nodeType == mtVideo) ? "Trim" : "AudioTrim", args);
-            vsapi->freeMap(args);
-            if (vsapi->mapGetError(result)) {
-                fprintf(stderr, "%s\n", vsapi->mapGetError(result));
-                vsapi->freeMap(result);
-                vsapi->freeNode(node);
-                vsapi->freeNode(alphaNode);
-                vssapi->freeScript(se);
-                return 1;
-            } else {
-                vsapi->freeNode(node);
-                node = vsapi->mapGetNode(result, "clip", 0, nullptr);
-                vsapi->freeMap(result);
-            }
+        std::string trimError;
+        if (!trimOutputNode(opts, node, core, vsapi, trimError)) {
+            fprintf(stderr, "%s\n", trimError.c_str());
+            vsapi->freeNode(node);
+            vsapi->freeNode(alphaNode);
+            freeScript();
+            return 1;
         }
 
         std::unique_ptr<VSPipeOutputData> data(new VSPipeOutputData());
 
         data->vsapi = vsapi;
-        data->outputHeaders = opts.outputHeaders;
+        data->outputHeaders = (opts.mode == VSPipeMode::Benchmark || opts.mode == VSPipeMode::PrintProfileGraph) ? VSPipeHeaders::None : opts.outputHeaders;
         data->calculateMD5 = opts.calculateMD5;
         MD5_Init(&data->md5Ctx);
+        if (opts.calculateHash && opts.mode != VSPipeMode::PrintInfo) {
+            node = createFrameHashFilter(node, data->frameHashes, core, vsapi);
+            if (alphaNode)
+                alphaNode = createFrameHashFilter(alphaNode, data->alphaFrameHashes, core, vsapi);
+        }
         data->printProgress = opts.printProgress;
         data->node = node;
         data->alphaNode = alphaNode;
-        data->outFile = outFile;
+
+        // stopped when leaving this scope which is before the nodes it reads statistics from are freed
+        std::unique_ptr<MetricsExporter> metrics;
+        if (opts.metricsPort > 0 && opts.mode != VSPipeMode::PrintInfo) {
+            std::string error;
+            metrics.reset(MetricsExporter::create(opts.metricsPort, node, core, vsapi, error));
+            if (!metrics)
+                fprintf(stderr, "Warning: %s\n", error.c_str());
+        }
+
+        data->outFile = (opts.mode == VSPipeMode::Benchmark || opts.mode == VSPipeMode::PrintProfileGraph || !opts.sharedOutputName.empty()) ? nullptr : outFile;
+        data->directOutput = std::move(directOutput);
+        data->timecodesFile = timecodesFile;
+        if (opts.mode == VSPipeMode::Output) {
+            data->sharedOutputName = opts.sharedOutputName;
+            data->sharedOutputSlots = opts.sharedOutputSlots;
+            data->checkpointFilename = opts.checkpointFilename;
+            data->startPos = opts.startPos;
+            data->endPos = opts.endPos;
+            data->outputIndex = opts.outputIndex;
+            data->liveLatency = opts.liveLatency * static_cast<int64_t>(1000);
+        }
+
+        if (resuming) {
+            if ((!checkpoint.md5State.empty() && !hexToBytes(checkpoint.md5State, &data->md5Ctx, sizeof(data->md5Ctx))) || checkpoint.nextFrame < 0) {
+                fprintf(stderr, "Invalid checkpoint file\n");
+                vsapi->freeNode(node);
+                vsapi->freeNode(alphaNode);
+                freeScript();
+                return 1;
+            }
+            data->resumeFrame = checkpoint.nextFrame;
+            data->outputBytes = checkpoint.outputBytes;
+            data->timecodesBytes = checkpoint.timecodesBytes;
+            data->currentTimecodeNum = checkpoint.timecodeNum;
+            data->currentTimecodeDen = checkpoint.timecodeDen;
+        }
         
         if (nodeType == mtVideo) {
 
@@ -1047,16 +2550,18 @@ int main(int argc, char **argv) {
                     fprintf(stderr, "Cannot output clips with varying dimensions\n");
                     vsapi->freeNode(node);
                     vsapi->freeNode(alphaNode);
-                    vssapi->freeScript(se);
+                    freeScript();
                     return 1;
                 }
 
                 data->totalFrames = vi->numFrames;
 
                 success = initializeVideoOutput(data.get());
-                if (success) {
+                if (success && opts.segments > 0) {
+                    success = outputSegments(opts, data.get());
+                } else if (success) {
                     data->lastFPSReportTime = std::chrono::steady_clock::now();
-                    success = !outputNode(opts, data.get(), vssapi->getCore(se));
+                    success = renderOutputs(opts, data.get(), extraNodes, core);
                 }
             }
         } else if (nodeType == mtAudio) {
@@ -1078,11 +2583,18 @@ int main(int argc, char **argv) {
             } else {
                 data->totalFrames = ai->numFrames;
                 data->totalSamples = ai->numSamples;
+                data->audioFrameSamples = vsapi->getAudioFrameSamples(core);
 
                 success = initializeAudioOutput(data.get());
-                if (success) {
+                if (success && opts.segments > 0) {
+                    fprintf(stderr, "Error: segmented rendering is only supported for video\n");
+                    success = false;
+                } else if (success && opts.liveLatency > 0) {
+                    fprintf(stderr, "Error: live output is only supported for video\n");
+                    success = false;
+                } else if (success) {
                     
-                    success = !outputNode(opts, data.get(), vssapi->getCore(se));
+                    success = renderOutputs(opts, data.get(), extraNodes, core);
                 }
             }
         }
@@ -1097,13 +2609,15 @@ int main(int argc, char **argv) {
 
         std::chrono::duration<double> elapsedSeconds = std::chrono::steady_clock::now() - data->startTime;
         if (opts.mode == VSPipeMode::Output) {
-            if (vsapi->getNodeType(node) == mtVideo)
+            if (data->liveLatency > 0)
+                fprintf(stderr, "Output %d frames in %.2f seconds (%d repeated after missing the deadline)\n", data->writtenFrames, elapsedSeconds.count(), data->repeatedFrames);
+            else if (vsapi->getNodeType(node) == mtVideo)
                 fprintf(stderr, "Output %d frames in %.2f seconds (%.2f fps)\n", data->totalFrames, elapsedSeconds.count(), data->totalFrames / elapsedSeconds.count());
             else
-                fprintf(stderr, "Output %" PRId64 " samples in %.2f seconds (%.2f sps)\n", data->totalSamples, elapsedSeconds.count(), (data->totalFrames / elapsedSeconds.count()) * VS_AUDIO_FRAME_SAMPLES);
+                fprintf(stderr, "Output %" PRId64 " samples in %.2f seconds (%.2f sps)\n", data->totalSamples, elapsedSeconds.count(), (data->totalFrames / elapsedSeconds.count()) * data->audioFrameSamples);
         }
 
-        if (opts.calculateMD5 && outFile) {
+        if (opts.calculateMD5 && (outFile || data->directOutput)) {
             fprintf(stderr, "MD5: ");
             for (int i = 0; i < 16; i++)
                 fprintf(stderr, "%02x", (int)md5[i]);
@@ -1112,8 +2626,32 @@ int main(int argc, char **argv) {
             fprintf(stderr, "MD5: OUTPUT REQUIRED");
         }
 
+        if (opts.calculateHash && success && opts.mode != VSPipeMode::PrintInfo) {
+            fprintf(stderr, "XXH64: %016" PRIx64 "\n", combineFrameHashes(data.get()));
+            if (!opts.hashFilename.empty() && !writeFrameHashes(opts.hashFilename, data.get())) {
+                fprintf(stderr, "Failed to write hash file\n");
+                success = false;
+            }
+        }
+
+        if (opts.mode == VSPipeMode::Benchmark && success && outFile)
+            printBenchmarkReport(outFile, opts.benchmarkFormat, data.get());
+
+        if (opts.mode == VSPipeMode::PrintProfileGraph && success && outFile)
+            fprintf(outFile, "%s\n", printNodeProfileGraph(node, vsapi).c_str());
+
         if (opts.printFilterTime)
             fprintf(stderr, "%s", printNodeTimes(node, elapsedSeconds.count(), vsapi).c_str());
+
+        if (!opts.traceFilename.empty() && !vsapi->writeTrace(nstringToUtf8(opts.traceFilename).c_str(), core)) {
+            fprintf(stderr, "Failed to write trace file\n");
+            success = false;
+        }
+
+        if (!opts.cacheSizesFilename.empty() && success && opts.mode != VSPipeMode::PrintInfo && !vsapi->saveCacheSizes(nstringToUtf8(opts.cacheSizesFilename).c_str(), core)) {
+            fprintf(stderr, "Failed to write cache size file\n");
+            success = false;
+        }
     }
 
     if (outFile && closeOutFile)
@@ -1124,7 +2662,7 @@ int main(int argc, char **argv) {
 
     vsapi->freeNode(node);
     vsapi->freeNode(alphaNode);
-    vssapi->freeScript(se);
+    freeScript();
 
     return success ? 0 : 1;
 }
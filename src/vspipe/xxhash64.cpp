@@ -0,0 +1,141 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "xxhash64.h"
+#include <cstring>
+
+static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// the hash is defined on little endian input
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * prime1 + prime4;
+}
+
+void XXH64_Init(XXH64State *state, uint64_t seed) {
+    state->totalLength = 0;
+    state->v[0] = seed + prime1 + prime2;
+    state->v[1] = seed + prime2;
+    state->v[2] = seed;
+    state->v[3] = seed - prime1;
+    state->bufferSize = 0;
+}
+
+void XXH64_Update(XXH64State *state, const void *data, size_t size) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const uint8_t *end = p + size;
+    state->totalLength += size;
+
+    if (state->bufferSize + size < 32) {
+        memcpy(state->buffer + state->bufferSize, p, size);
+        state->bufferSize += size;
+        return;
+    }
+
+    if (state->bufferSize) {
+        size_t fill = 32 - state->bufferSize;
+        memcpy(state->buffer + state->bufferSize, p, fill);
+        for (int i = 0; i < 4; i++)
+            state->v[i] = round(state->v[i], read64(state->buffer + i * 8));
+        p += fill;
+        state->bufferSize = 0;
+    }
+
+    uint64_t v0 = state->v[0], v1 = state->v[1], v2 = state->v[2], v3 = state->v[3];
+    while (end - p >= 32) {
+        v0 = round(v0, read64(p));
+        v1 = round(v1, read64(p + 8));
+        v2 = round(v2, read64(p + 16));
+        v3 = round(v3, read64(p + 24));
+        p += 32;
+    }
+    state->v[0] = v0;
+    state->v[1] = v1;
+    state->v[2] = v2;
+    state->v[3] = v3;
+
+    state->bufferSize = end - p;
+    memcpy(state->buffer, p, state->bufferSize);
+}
+
+uint64_t XXH64_Final(const XXH64State *state) {
+    uint64_t h;
+    if (state->totalLength >= 32) {
+        h = rotl(state->v[0], 1) + rotl(state->v[1], 7) + rotl(state->v[2], 12) + rotl(state->v[3], 18);
+        for (int i = 0; i < 4; i++)
+            h = mergeRound(h, state->v[i]);
+    } else {
+        h = state->v[2] + prime5;
+    }
+
+    h += state->totalLength;
+
+    const uint8_t *p = state->buffer;
+    const uint8_t *end = p + state->bufferSize;
+    while (end - p >= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * prime1 + prime4;
+        p += 8;
+    }
+
+    if (end - p >= 4) {
+        h ^= read32(p) * prime1;
+        h = rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= *p * prime5;
+        h = rotl(h, 11) * prime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
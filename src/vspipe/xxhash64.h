@@ -0,0 +1,40 @@
+/*
+* Copyright (c) 2024 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Streaming implementation of the XXH64 hash, produces the same values as the reference implementation
+
+struct XXH64State {
+    uint64_t totalLength;
+    uint64_t v[4];
+    uint8_t buffer[32];
+    size_t bufferSize;
+};
+
+void XXH64_Init(XXH64State *state, uint64_t seed);
+void XXH64_Update(XXH64State *state, const void *data, size_t size);
+uint64_t XXH64_Final(const XXH64State *state);
+
+#endif
@@ -23,8 +23,13 @@
 #include "vsscript_internal.h"
 #include "cython/vapoursynth_api.h"
 #include <mutex>
+#include <shared_mutex>
 #include <atomic>
 #include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstring>
 
 #ifdef VS_TARGET_OS_WINDOWS
 #define WIN32_LEAN_AND_MEAN
@@ -33,7 +38,13 @@
 
 static std::once_flag flag;
 
+// Evaluations with the V4 API don't hold the lock, they only need the GIL which is released whenever a filter is
+// created or a frame is waited for so different scripts can be evaluated at the same time. The V3 API evaluations
+// still hold it.
 static std::mutex vsscriptlock;
+// The V3 API evaluations change the working directory of the whole process so they hold this exclusively, V4
+// evaluations hold it shared so relative paths in them never resolve against another script's directory
+static std::shared_timed_mutex workingDirLock;
 static std::atomic<int> initializationCount(0);
 static std::atomic<int> scriptID(1000);
 static bool initialized = false;
@@ -157,6 +168,7 @@ VS_API(int) vsscript_createScript(VSScript **handle) VS_NOEXCEPT {
 // V3 API compatibility
 VS_API(int) vsscript_evaluateScript(VSScript **handle, const char *script, const char *scriptFilename, int flags) VS_NOEXCEPT {
     std::lock_guard<std::mutex> lock(vsscriptlock);
+    std::lock_guard<std::shared_timed_mutex> dirLock(workingDirLock);
     if (*handle == nullptr) {
         if (createScriptInternal(handle)) return 1;
     }
@@ -166,6 +178,7 @@ VS_API(int) vsscript_evaluateScript(VSScript **handle, const char *script, const
 // V3 API compatibility
 VS_API(int) vsscript_evaluateFile(VSScript **handle, const char *scriptFilename, int flags) VS_NOEXCEPT {
     std::lock_guard<std::mutex> lock(vsscriptlock);
+    std::lock_guard<std::shared_timed_mutex> dirLock(workingDirLock);
     if (*handle == nullptr) {
         if (createScriptInternal(handle)) return 1;
     }
@@ -173,19 +186,112 @@ VS_API(int) vsscript_evaluateFile(VSScript **handle, const char *scriptFilename,
 }
 
 static VSScript *VS_CC evaluateBuffer(const char *buffer, const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options) VS_NOEXCEPT {
-    std::lock_guard<std::mutex> lock(vsscriptlock);
     VSScript *handle = createScriptInternal();
+    std::shared_lock<std::shared_timed_mutex> dirLock(workingDirLock);
     vpy4_evaluateBuffer(handle, buffer, scriptFilename, vars, options);
     return handle;
 }
 
 static VSScript *VS_CC evaluateFile(const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options) VS_NOEXCEPT {
-    std::lock_guard<std::mutex> lock(vsscriptlock);
     VSScript *handle = createScriptInternal();
+    std::shared_lock<std::shared_timed_mutex> dirLock(workingDirLock);
     vpy4_evaluateFile(handle, scriptFilename, vars, options);
     return handle;
 }
 
+// everything the evaluation thread needs is copied so the caller's buffers can go away as soon as the call returns
+struct AsyncEvaluation {
+    VSScript *handle;
+    bool isFile;
+    bool hasFilename;
+    std::string buffer;
+    std::string scriptFilename;
+    VSMap *vars;
+    bool hasOptions;
+    VSScriptOptions options;
+    VSScriptEvaluationDone done;
+    void *userData;
+
+    void run() {
+        const char *fn = hasFilename ? scriptFilename.c_str() : nullptr;
+        {
+            std::shared_lock<std::shared_timed_mutex> dirLock(workingDirLock);
+            if (isFile)
+                vpy4_evaluateFile(handle, fn, vars, hasOptions ? &options : nullptr);
+            else
+                vpy4_evaluateBuffer(handle, buffer.c_str(), fn, vars, hasOptions ? &options : nullptr);
+        }
+        if (vars)
+            vpy4_getVSAPI(VAPOURSYNTH_API_VERSION)->freeMap(vars);
+        done(userData, handle);
+    }
+};
+
+static VSScript *evaluateAsync(bool isFile, const char *buffer, const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options, VSScriptEvaluationDone done, void *userData) VS_NOEXCEPT {
+    AsyncEvaluation *e = new AsyncEvaluation();
+    e->handle = createScriptInternal();
+    e->vars = nullptr;
+    if (vars) {
+        const VSAPI *vsapi = vpy4_getVSAPI(VAPOURSYNTH_API_VERSION);
+        e->vars = vsapi->createMap();
+        vsapi->copyMap(vars, e->vars);
+    }
+    VSScript *handle = e->handle;
+    e->isFile = isFile;
+    // a NULL buffer is reported as an error by the evaluation itself
+    if (buffer)
+        e->buffer = buffer;
+    e->hasFilename = !!scriptFilename;
+    if (scriptFilename)
+        e->scriptFilename = scriptFilename;
+    e->hasOptions = !!options;
+    e->options = {};
+    if (options)
+        memcpy(&e->options, options, std::min<size_t>(std::max(options->size, 0), sizeof(VSScriptOptions)));
+    e->done = done;
+    e->userData = userData;
+
+    if (!isFile && !buffer) {
+        // keep the synchronous error path so the message is the same
+        e->run();
+        delete e;
+        return handle;
+    }
+
+    try {
+        std::thread([e]() {
+            e->run();
+            delete e;
+        }).detach();
+    } catch (std::system_error &) {
+        e->run();
+        delete e;
+    }
+    return handle;
+}
+
+static VSScript *VS_CC evaluateBufferAsync(const char *buffer, const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options, VSScriptEvaluationDone done, void *userData) VS_NOEXCEPT {
+    return evaluateAsync(false, buffer, scriptFilename, vars, options, done, userData);
+}
+
+static VSScript *VS_CC evaluateFileAsync(const char *scriptFilename, const VSMap *vars, const VSScriptOptions *options, VSScriptEvaluationDone done, void *userData) VS_NOEXCEPT {
+    return evaluateAsync(true, nullptr, scriptFilename, vars, options, done, userData);
+}
+
+static VSScript *VS_CC compileBuffer(const char *buffer, const char *scriptFilename) VS_NOEXCEPT {
+    VSScript *handle = createScriptInternal();
+    std::shared_lock<std::shared_timed_mutex> dirLock(workingDirLock);
+    vpy4_compileBuffer(handle, buffer, scriptFilename);
+    return handle;
+}
+
+static VSScript *VS_CC evaluateCompiled(VSScript *compiled, const VSMap *vars, const VSScriptOptions *options) VS_NOEXCEPT {
+    VSScript *handle = createScriptInternal();
+    std::shared_lock<std::shared_timed_mutex> dirLock(workingDirLock);
+    vpy4_evaluateCompiled(handle, compiled, vars, options);
+    return handle;
+}
+
 VS_API(void) vsscript_freeScript(VSScript *handle) VS_NOEXCEPT {
     std::lock_guard<std::mutex> lock(vsscriptlock);
     if (handle) {
@@ -319,7 +425,11 @@ static VSSCRIPTAPI vsscript_api = {
     &getOptions,
     &vsscript_getCore,
     &clearLogHandler,
-    &vsscript_freeScript
+    &vsscript_freeScript,
+    &evaluateBufferAsync,
+    &evaluateFileAsync,
+    &compileBuffer,
+    &evaluateCompiled
 };
 
 const VSSCRIPTAPI *VS_CC getVSScriptAPI(int version) VS_NOEXCEPT {
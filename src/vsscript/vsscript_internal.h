@@ -26,6 +26,7 @@ struct VSScript {
     void *errstr;
     int id;
     int exitCode;
+    void *code;
 };
 
 #endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 import time
+import asyncio
 import unittest
 import threading
 import vapoursynth as vs
@@ -102,5 +103,21 @@ class FilterTestSequence(unittest.TestCase):
         with self.assertRaisesRegex(vs.Error, "Fail"):
             fut.result(2)
 
+    def test_asyncio_slow(self):
+        async def fetch():
+            return await self.slow_filter.get_frame_asyncio(1)
+        self.assertIsInstance(asyncio.run(asyncio.wait_for(fetch(), 2)), vs.VideoFrame)
+
+    def test_asyncio_fail(self):
+        async def fetch():
+            return await self.fail_filter.get_frame_asyncio(1)
+        with self.assertRaisesRegex(vs.Error, "Fail"):
+            asyncio.run(asyncio.wait_for(fetch(), 2))
+
+    def test_frames_batched_fail(self):
+        with self.assertRaisesRegex(vs.Error, "Fail"):
+            for batch in self.fail_filter.frames_batched(4):
+                pass
+
 if __name__ == '__main__':
     unittest.main()
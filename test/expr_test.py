@@ -387,6 +387,97 @@ class CoreTestSequence(unittest.TestCase):
     def test_expr_cos65(self):
         self.helper_sincos('cos', lambda x: math.cos(x))
 
+    def test_expr_fast(self):
+        clip = self.core.std.BlankClip(format=vs.GRAYS, color=0.7)
+        for op, f in [('exp', math.exp), ('log', math.log), ('sin', math.sin), ('cos', math.cos), ('2.2 pow', lambda x: x ** 2.2)]:
+            value = get_pixel_value(self.core.std.Expr(clip, "x %s" % op, fast=True))
+            self.assertTrue(abs(value - f(0.7)) < 2e-5)
+
+    def test_expr_quarter_pow(self):
+        clip = self.core.std.BlankClip(format=vs.GRAYS, color=0.7)
+        for e in [0.25, 0.75, 1.25, -0.75]:
+            value = get_pixel_value(self.core.std.Expr(clip, "x %s pow" % e))
+            self.assertTrue(abs(value - 0.7 ** e) < 1e-6)
+
+    def test_expr_multi(self):
+        clipa = self.core.std.BlankClip(format=vs.YUV420P8, color=[58, 100, 200])
+        clipb = self.core.std.BlankClip(format=vs.YUV420P8, color=[20, 120, 40])
+        clips = self.core.std.ExprMulti([clipa, clipb], ["x y +", "x y -", "x y + 2 /"])
+        self.assertEqual(len(clips), 3)
+        for clip, expected in zip(clips, [[78, 220, 240], [38, 0, 160], [39, 110, 120]]):
+            self.assertEqual(clip.height, clipa.height)
+            frame = clip.get_frame(0)
+            for plane in range(3):
+                self.assertEqual(frame.get_read_array(plane)[0,0], expected[plane])
+
+    def helper_int_sources(self, format):
+        # Every 16 bit value appears in x, the odd width leaves a partial vector at the end of every row.
+        clip = self.core.std.BlankClip(format=format, width=261, height=256)
+        if format == vs.GRAY8:
+            return [self.core.std.Expr(clip, e) for e in ["X Y +", "Y 3 * X -", "X 7 * Y - 3 /"]]
+        return [self.core.std.Expr(clip, e) for e in ["Y 256 * X +", "X 256 * Y + 65535 swap -", "X Y * 3 /"]]
+
+    def helper_int_matches_c(self, clips, expr, format=None):
+        def run(cpu):
+            old = self.core.std.SetMaxCPU(cpu)
+            try:
+                return self.core.std.Expr(clips, expr, format=format)
+            finally:
+                self.core.std.SetMaxCPU(old)
+        ref = run('none')
+        for cpu in ['avx2', 'sse2']:
+            diff = self.core.std.PlaneStats(run(cpu), ref).get_frame(0).props['PlaneStatsDiff']
+            self.assertEqual(diff, 0, "%s at %s" % (expr, cpu))
+        return ref
+
+    def test_expr_int_round_half_even(self):
+        for format in [vs.GRAY8, vs.GRAY16]:
+            clips = self.helper_int_sources(format)
+            for expr in ["x 2 /", "x 4 /", "x y + 2 /", "x y - 4 /", "x 0.5 *", "x 3 * 8 /"]:
+                self.helper_int_matches_c(clips, expr)
+        # Python's round() also rounds half to even.
+        clip = self.core.std.BlankClip(format=vs.GRAY8, width=256, height=1)
+        clip = self.core.std.Expr(clip, "X")
+        for divisor in [2, 4]:
+            arr = self.helper_int_matches_c(clip, "x %d /" % divisor).get_frame(0).get_read_array(0)
+            self.assertEqual([arr[0, i] for i in range(256)], [round(i / divisor) for i in range(256)])
+
+    def test_expr_int_signed(self):
+        for format in [vs.GRAY8, vs.GRAY16]:
+            clips = self.helper_int_sources(format)
+            for expr in ["x y - abs", "y x - abs", "x y - z + abs", "x y - 2 / abs", "0 x - y +", "x y - 0 max"]:
+                self.helper_int_matches_c(clips, expr)
+
+    def test_expr_int_unsigned_minmax(self):
+        clips = self.helper_int_sources(vs.GRAY16)
+        for expr in ["x y max", "x y min", "x 65535 min", "x 65534 max", "x 32768 max y min", "x 65535 y - max", "x y max z min"]:
+            self.helper_int_matches_c(clips, expr)
+        clips = self.helper_int_sources(vs.GRAY8)
+        for expr in ["x y max", "x y min", "x y * z max", "x y * 65535 min"]:
+            self.helper_int_matches_c(clips, expr)
+
+    def test_expr_int_fma(self):
+        for format in [vs.GRAY8, vs.GRAY16]:
+            clips = self.helper_int_sources(format)
+            if format == vs.GRAY16:
+                clips = [self.core.std.Expr(c, "x 255 min") for c in clips]
+            for expr in ["x y * z +", "z x y * +", "x y * z -", "z x y * -", "x y * z + 2 /", "0 x y * - z -"]:
+                self.helper_int_matches_c(clips, expr)
+
+    def test_expr_int_store_depth(self):
+        # 16 bit stores are clamped to the nominal depth of the output format.
+        for format in [vs.GRAY8, vs.GRAY16]:
+            clips = self.helper_int_sources(format)
+            for outformat in [vs.GRAY9, vs.GRAY10, vs.GRAY12, vs.GRAY14]:
+                for expr in ["x", "x 4 *", "x y - abs", "x y - 2 /", "x 2 / 700 -"]:
+                    self.helper_int_matches_c(clips, expr, format=outformat)
+        clip = self.core.std.Expr(self.core.std.BlankClip(format=vs.GRAY16, width=261, height=256), "Y 256 * X +")
+        arr = self.helper_int_matches_c(clip, "x", format=vs.GRAY10).get_frame(0).get_read_array(0)
+        self.assertEqual(arr[0, 260], 260)
+        self.assertEqual(arr[3, 255], 1023)
+        self.assertEqual(arr[4, 0], 1023)
+        self.assertEqual(arr[255, 260], 1023)
+
         
 if __name__ == '__main__':
     unittest.main()
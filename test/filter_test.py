@@ -8,6 +8,33 @@ class FilterTestSequence(unittest.TestCase):
         self.Transpose = self.core.std.Transpose
         self.BlankClip = self.core.std.BlankClip
 		
+    def _pattern(self, format, width=301, height=173, wave='X 0.37 * Y 0.61 * + sin'):
+        # A smooth pattern spanning the whole range of integer formats and -1 to 1 for float ones.
+        clip = self.BlankClip(format=format, width=width, height=height)
+        if clip.format.sample_type == vs.FLOAT:
+            return self.core.std.Expr(clip, wave)
+        half = 1 << (clip.format.bits_per_sample - 1)
+        return self.core.std.Expr(clip, f'{wave} {half - 1} * {half} +')
+
+    def _pixels(self, clip, plane=0):
+        f = clip.get_frame(0)
+        arr = f.get_read_array(plane)
+        width = f.width >> (f.format.subsampling_w if plane else 0)
+        height = f.height >> (f.format.subsampling_h if plane else 0)
+        return [[arr[y, x] for x in range(width)] for y in range(height)]
+
+    def _assert_same(self, a, b):
+        for plane in range(a.format.num_planes):
+            diff = self.core.std.PlaneStats(a, b, plane=plane).get_frame(0).props['PlaneStatsDiff']
+            self.assertEqual(diff, 0)
+
+    def _with_cpu(self, cpu, func):
+        old = self.core.std.SetMaxCPU(cpu)
+        try:
+            return func()
+        finally:
+            self.core.std.SetMaxCPU(old)
+
     def test_transpose8_test(self):
         clip = self.BlankClip(format=vs.YUV420P8, color=[0, 0, 0], width=1156, height=752)
         self.Transpose(clip).get_frame(0)
@@ -20,5 +47,310 @@ class FilterTestSequence(unittest.TestCase):
         clip = self.BlankClip(format=vs.YUV444PS, color=[0, 0, 0], width=1156, height=752)
         self.Transpose(clip).get_frame(0)
 
+    def test_transpose_matches_c(self):
+        # Sizes that aren't multiples of the block size leave partial blocks on both edges.
+        for format in [vs.GRAY8, vs.GRAY16, vs.GRAYS]:
+            for width, height in [(1, 1), (1, 37), (37, 1), (7, 5), (33, 17), (301, 173)]:
+                clip = self._pattern(format, width=width, height=height)
+                transpose = lambda: self.Transpose(clip)
+                self._assert_same(transpose(), self._with_cpu('none', transpose))
+
+    def test_transpose_reference(self):
+        for format in [vs.GRAY8, vs.GRAY16, vs.GRAYS]:
+            for width, height in [(1, 1), (1, 9), (9, 1), (7, 5), (17, 33)]:
+                clip = self._pattern(format, width=width, height=height)
+                src = self._pixels(clip)
+                out = self._pixels(self.Transpose(clip))
+                self.assertEqual(out, [[src[y][x] for y in range(height)] for x in range(width)])
+
+    def test_boxblur_vertical_matches_transposed(self):
+        sources = [self._pattern(vs.GRAY8), self._pattern(vs.GRAY16), self._pattern(vs.GRAYS)]
+        for clip in sources:
+            for radius, passes in [(1, 1), (1, 2), (4, 3), (40, 2), (200, 1)]:
+                blurred = self.core.std.BoxBlur(clip, hradius=0, vradius=radius, vpasses=passes)
+                ref = self.Transpose(self.core.std.BoxBlur(self.Transpose(clip), hradius=radius, hpasses=passes, vradius=0))
+                self._assert_same(blurred, ref)
+
+    def test_boxblur_horizontal_matches_c(self):
+        sources = [self._pattern(vs.GRAY8), self._pattern(vs.GRAY16), self._pattern(vs.GRAYS)]
+        for clip in sources:
+            for radius, passes in [(1, 1), (1, 2), (4, 3), (40, 2), (200, 1)]:
+                blur = lambda: self.core.std.BoxBlur(clip, hradius=radius, hpasses=passes, vradius=0)
+                self._assert_same(blur(), self._with_cpu('none', blur))
+
+    def test_fliphorizontal_matches_c(self):
+        # The odd widths leave a partial vector at the start of the reversed rows.
+        for format in [vs.GRAY8, vs.GRAY16, vs.GRAYS]:
+            for width in [1, 3, 15, 17, 33, 65, 301]:
+                clip = self._pattern(format, width=width, height=7)
+                for flip in [self.core.std.FlipHorizontal, self.core.std.Turn180]:
+                    ref = self._with_cpu('none', lambda: flip(clip))
+                    self._assert_same(flip(clip), ref)
+                self._assert_same(self.core.std.FlipHorizontal(self.core.std.FlipHorizontal(clip)), clip)
+
+    def test_fliphorizontal_reference(self):
+        for format in [vs.GRAY8, vs.GRAY16, vs.GRAYS]:
+            for width in [1, 3, 15, 17, 33, 65]:
+                clip = self._pattern(format, width=width, height=3)
+                src = self._pixels(clip)
+                self.assertEqual(self._pixels(self.core.std.FlipHorizontal(clip)), [row[::-1] for row in src])
+                self.assertEqual(self._pixels(self.core.std.Turn180(clip)), [row[::-1] for row in src[::-1]])
+
+    def test_blankclip_shared_planes(self):
+        clip = self.BlankClip(format=vs.YUV420P16, width=301 * 2, height=173 * 2, color=[1000, 2000, 3000], length=3)
+        for n in range(3):
+            f = clip.get_frame(n)
+            for plane, color in enumerate([1000, 2000, 3000]):
+                arr = f.get_read_array(plane)
+                self.assertEqual(arr[0, 0], color)
+                self.assertEqual(arr[f.height // (2 if plane else 1) - 1, f.width // (2 if plane else 1) - 1], color)
+        g = clip.get_frame(0).copy()
+        g.get_write_array(0)[0, 0] = 5
+        self.assertEqual(clip.get_frame(1).get_read_array(0)[0, 0], 1000)
+
+    def test_lut_matches_c(self):
+        # The odd widths leave a scalar tail after the vector loop.
+        for width in [1, 31, 33, 301]:
+            src8 = self._pattern(vs.GRAY8, width=width)
+            src10 = self._pattern(vs.GRAY10, width=width)
+            src16 = self._pattern(vs.GRAY16, width=width)
+            cases = [
+                (src8, dict(lut=[(i * 77 + 13) % 256 for i in range(256)])),
+                (src8, dict(lut=[(i * 1021) % 65536 for i in range(256)], bits=16)),
+                (src8, dict(lutf=[i * 0.25 - 3 for i in range(256)], floatout=True)),
+                (src10, dict(lut=[1023 - i for i in range(1024)])),
+                (src10, dict(lut=[i >> 2 for i in range(1024)], bits=8)),
+                (src16, dict(lut=[(i * 7) % 256 for i in range(65536)], bits=8)),
+                (src16, dict(lut=[(i * 31 + 5) % 65536 for i in range(65536)])),
+                (src16, dict(lutf=[i / 7 for i in range(65536)], floatout=True)),
+            ]
+            for clip, args in cases:
+                lut = lambda: self.core.std.Lut(clip, **args)
+                self._assert_same(lut(), self._with_cpu('none', lut))
+
+    def test_lut_reference(self):
+        for format, size in [(vs.GRAY8, 256), (vs.GRAY10, 1024), (vs.GRAY16, 65536)]:
+            table = [(i * 2654435761) % size for i in range(size)]
+            for width in [1, 17, 33]:
+                clip = self._pattern(format, width=width, height=3)
+                src = self._pixels(clip)
+                out = self._pixels(self.core.std.Lut(clip, lut=table))
+                self.assertEqual(out, [[table[v] for v in row] for row in src])
+        # Planes that aren't processed are passed through untouched.
+        clip = self._pattern(vs.YUV444P8, width=33)
+        processed = self.core.std.Lut(clip, lut=[255 - i for i in range(256)], planes=[1])
+        self.assertEqual(self._pixels(processed, 0), self._pixels(clip, 0))
+        self.assertEqual(self._pixels(processed, 2), self._pixels(clip, 2))
+        self.assertEqual(self._pixels(processed, 1), [[255 - v for v in row] for row in self._pixels(clip, 1)])
+
+    def test_lut2_matches_c(self):
+        for width in [1, 31, 33, 301]:
+            clipa = self._pattern(vs.GRAY8, width=width)
+            clipb = self._pattern(vs.GRAY8, width=width, wave='X 0.11 * Y 0.29 * - cos')
+            cases = [
+                dict(lut=[(i * 77 + 13) % 256 for i in range(65536)]),
+                dict(lut=[(i * 31) % 65536 for i in range(65536)], bits=16),
+                dict(lutf=[i * 0.5 for i in range(65536)], floatout=True),
+            ]
+            for args in cases:
+                lut2 = lambda: self.core.std.Lut2(clipa, clipb, **args)
+                self._assert_same(lut2(), self._with_cpu('none', lut2))
+
+    def test_lut2_reference(self):
+        # Mixed depths, the table is indexed with clipb shifted above the bits of clipa.
+        for formata, formatb in [(vs.GRAY8, vs.GRAY8), (vs.GRAY8, vs.GRAY10), (vs.GRAY10, vs.GRAY8)]:
+            clipa = self._pattern(formata, width=17, height=3)
+            clipb = self._pattern(formatb, width=17, height=3, wave='X 0.11 * Y 0.29 * - cos')
+            bitsa = clipa.format.bits_per_sample
+            size = 1 << (bitsa + clipb.format.bits_per_sample)
+            table = [(i * 2654435761) % 256 for i in range(size)]
+            out = self._pixels(self.core.std.Lut2(clipa, clipb, lut=table, bits=8))
+            expected = [[table[(b << bitsa) + a] for a, b in zip(rowa, rowb)] for rowa, rowb in zip(self._pixels(clipa), self._pixels(clipb))]
+            self.assertEqual(out, expected)
+
+    def test_single_pixel_ops_match_c(self):
+        for width in [1, 17, 33, 301]:
+            sources = [
+                self._pattern(vs.YUV444P8, width=width),
+                self._pattern(vs.YUV444P10, width=width),
+                self._pattern(vs.YUV444P16, width=width),
+                self._pattern(vs.YUV444PS, width=width),
+            ]
+            for clip in sources:
+                filters = [self.core.std.Invert, self.core.std.InvertMask]
+                if clip.format.sample_type == vs.INTEGER:
+                    maxval = (1 << clip.format.bits_per_sample) - 1
+                    filters += [
+                        lambda c: self.core.std.Limiter(c, min=[20, 40], max=[200, 210]),
+                        lambda c: self.core.std.Limiter(c, min=100, max=100),
+                        lambda c: self.core.std.Binarize(c, threshold=[100, 130]),
+                        lambda c: self.core.std.Binarize(c, threshold=0),
+                        lambda c: self.core.std.Binarize(c, threshold=maxval, v0=3, v1=maxval - 3),
+                        lambda c: self.core.std.Levels(c, min_in=16, max_in=235, min_out=0, max_out=255, gamma=1.7),
+                    ]
+                else:
+                    filters += [
+                        lambda c: self.core.std.Limiter(c, min=[0.1, -0.3], max=[0.4, 0.2]),
+                        lambda c: self.core.std.Limiter(c, min=0.25, max=0.25),
+                        lambda c: self.core.std.Binarize(c, threshold=[0.2, -0.1]),
+                        lambda c: self.core.std.Binarize(c, threshold=-1, v0=0.25, v1=0.75),
+                    ]
+                for f in filters:
+                    ref = self._with_cpu('none', lambda: f(clip))
+                    self._assert_same(f(clip), ref)
+
+    def test_single_pixel_ops_reference(self):
+        for format in [vs.GRAY8, vs.GRAY10, vs.GRAY16]:
+            for width in [1, 17, 33]:
+                clip = self._pattern(format, width=width, height=3)
+                maxval = (1 << clip.format.bits_per_sample) - 1
+                half = (maxval + 1) // 2
+                src = self._pixels(clip)
+                expected = lambda op: [[op(v) for v in row] for row in src]
+                self.assertEqual(self._pixels(self.core.std.Invert(clip)), expected(lambda v: maxval - v))
+                self.assertEqual(self._pixels(self.core.std.Limiter(clip, min=half, max=half)), expected(lambda v: half))
+                self.assertEqual(self._pixels(self.core.std.Limiter(clip, min=half // 2, max=half + half // 2)), expected(lambda v: min(max(v, half // 2), half + half // 2)))
+                self.assertEqual(self._pixels(self.core.std.Binarize(clip, threshold=0)), expected(lambda v: maxval))
+                self.assertEqual(self._pixels(self.core.std.Binarize(clip, threshold=maxval)), expected(lambda v: maxval if v >= maxval else 0))
+                self.assertEqual(self._pixels(self.core.std.Binarize(clip, threshold=half, v0=3, v1=maxval - 3)), expected(lambda v: maxval - 3 if v >= half else 3))
+
+    def test_levels_float_gamma_matches_c(self):
+        clip = self.core.std.Expr(self._pattern(vs.GRAYS), 'x 0.6 * 0.4 +')
+        for gamma in [0.3, 1 / 2.2, 1, 2.2, 5]:
+            levels = lambda: self.core.std.Levels(clip, min_in=0.1, max_in=0.9, min_out=0.05, max_out=0.95, gamma=gamma)
+            ref = self._with_cpu('none', levels)
+            diff = self.core.std.Expr([levels(), ref], 'x y - abs')
+            self.assertLess(self.core.std.PlaneStats(diff).get_frame(0).props['PlaneStatsMax'], 1e-6)
+
+    def _conv5x5_reference(self, clip, matrix, divisor, maxval):
+        # Edge taps are mapped the same way as in the C kernel.
+        def tap(x, d, n):
+            if x + d < 0:
+                return min(-d - x, n - 1)
+            if x + d >= n:
+                return x - min(d - (n - 1 - x), x)
+            return x + d
+        src = clip.get_frame(0).get_read_array(0)
+        w, h = clip.width, clip.height
+        out = []
+        for y in range(h):
+            row = []
+            for x in range(w):
+                acc = 0
+                for i in range(5):
+                    for j in range(5):
+                        acc += matrix[i * 5 + j] * src[tap(y, i - 2, h), tap(x, j - 2, w)]
+                row.append(min(max(int(round(abs(acc / divisor))), 0), maxval))
+            out.append(row)
+        return out
+
+    def test_convolution_separable_matches_reference(self):
+        binomial = [1, 4, 6, 4, 1]
+        deriv = [-1, -2, 0, 2, 1]
+        matrices = [
+            [a * b for a in binomial for b in binomial],
+            [a * b for a in deriv for b in binomial],
+            [a * b * 3 for a in binomial for b in deriv],
+            [a * b for a in binomial for b in binomial],
+        ]
+        # Not separable, checks that the split is only used when exact.
+        matrices[3][12] += 1
+        matrices[3][24] = 0
+        for format, expr, maxval in [(vs.GRAY8, 'X 1.37 * Y 0.61 * + sin 127 * 128 +', 255), (vs.GRAY16, 'X 1.37 * Y 0.61 * + sin 32767 * 32768 +', 65535)]:
+            for width, height in [(37, 11), (9, 6)]:
+                clip = self.core.std.Expr(self.BlankClip(format=format, width=width, height=height), expr)
+                for matrix in matrices:
+                    divisor = abs(sum(matrix)) or 1
+                    conv = self.core.std.Convolution(clip, matrix=matrix, saturate=False)
+                    ref = self._conv5x5_reference(clip, matrix, divisor, maxval)
+                    for f in [conv.get_frame(0), self._with_cpu('none', lambda: self.core.std.Convolution(clip, matrix=matrix, saturate=False)).get_frame(0)]:
+                        plane = f.get_read_array(0)
+                        for y in range(height):
+                            self.assertEqual([plane[y, x] for x in range(width)], ref[y])
+
+    def test_convolution_separable_float_matches_c(self):
+        clip = self._pattern(vs.GRAYS)
+        binomial = [1, 4, 6, 4, 1]
+        matrix = [a * b * 0.5 for a in binomial for b in [-1, -2, 0, 2, 1]]
+        conv = lambda: self.core.std.Convolution(clip, matrix=matrix, divisor=16, saturate=False)
+        ref = self._with_cpu('none', conv)
+        diff = self.core.std.Expr([conv(), ref], 'x y - abs')
+        self.assertLess(self.core.std.PlaneStats(diff).get_frame(0).props['PlaneStatsMax'], 1e-5)
+
+    def test_premultiply_matches_c(self):
+        cases = [(vs.YUV420P8, vs.GRAY8, 302), (vs.YUV444P8, vs.GRAY8, 33), (vs.YUV444P10, vs.GRAY10, 17), (vs.YUV444P16, vs.GRAY16, 301), (vs.YUV444PS, vs.GRAYS, 33)]
+        for format, alphaformat, width in cases:
+            clip = self._pattern(format, width=width)
+            alpha = self._pattern(alphaformat, width=width, wave='X 0.11 * Y 0.29 * - cos')
+            if alpha.format.sample_type == vs.FLOAT:
+                alpha = self.core.std.Expr(alpha, 'x 0.5 * 0.5 +')
+            back = self.core.std.Invert(clip)
+            premultiplied = self.core.std.PreMultiply(clip, alpha)
+            ref = self._with_cpu('none', lambda: self.core.std.PreMultiply(clip, alpha))
+            merged = self.core.std.MaskedMerge(back, clip, alpha, premultiply=True)
+            twostep = self.core.std.MaskedMerge(back, premultiplied, alpha, premultiplied=True)
+            self._assert_same(premultiplied, ref)
+            self._assert_same(merged, twostep)
+
+    def test_premultiply_alpha_limits(self):
+        # Opaque pixels are left alone and transparent ones end up at black and neutral chroma.
+        for format, alphaformat, alphamax in [(vs.YUV420P8, vs.GRAY8, 255), (vs.YUV444P8, vs.GRAY8, 255), (vs.YUV444P10, vs.GRAY10, 1023), (vs.YUV444P16, vs.GRAY16, 65535), (vs.YUV444PS, vs.GRAYS, 1)]:
+            for width in [2, 18, 34, 302] if format == vs.YUV420P8 else [1, 17, 33, 301]:
+                clip = self._pattern(format, width=width)
+                opaque = self.BlankClip(format=alphaformat, width=width, height=clip.height, color=alphamax)
+                transparent = self.BlankClip(format=alphaformat, width=width, height=clip.height, color=0)
+                self._assert_same(self.core.std.PreMultiply(clip, opaque), clip)
+                if clip.format.sample_type == vs.FLOAT:
+                    self._assert_same(self.core.std.PreMultiply(clip, transparent), self.BlankClip(clip, color=[0, 0, 0]))
+                    continue
+                bits = clip.format.bits_per_sample
+                half = 1 << (bits - 1)
+                # Without _ColorRange YUV is treated as limited range.
+                full = self.core.std.SetFrameProps(clip, _ColorRange=0)
+                self._assert_same(self.core.std.PreMultiply(full, transparent), self.BlankClip(clip, color=[0, half, half]))
+                self._assert_same(self.core.std.PreMultiply(clip, transparent), self.BlankClip(clip, color=[16 << (bits - 8), half, half]))
+
+    def test_planestats_multiple_planes(self):
+        for width in [18, 302]:
+            sources = [
+                self._pattern(vs.YUV444P8, width=width - 1),
+                self._pattern(vs.YUV420P16, width=width),
+                self._pattern(vs.YUV444PS, width=width - 1),
+            ]
+            for clip in sources:
+                other = self.core.std.Invert(clip)
+                props = self.core.std.PlaneStats(clip, other, plane=[2, 0, 1]).get_frame(0).props
+                for i, plane in enumerate([2, 0, 1]):
+                    single = self.core.std.PlaneStats(clip, other, plane=plane).get_frame(0).props
+                    ref = self._with_cpu('none', lambda: self.core.std.PlaneStats(clip, other, plane=plane).get_frame(0).props)
+                    for name in ['Min', 'Max', 'Average', 'Diff']:
+                        self.assertEqual(props['PlaneStats' + name][i], single['PlaneStats' + name])
+                        self.assertAlmostEqual(single['PlaneStats' + name], ref['PlaneStats' + name], places=9)
+
+    def test_planestats_reference(self):
+        # Single pixel, odd widths and odd sized subsampled chroma planes.
+        for format, width, height in [(vs.YUV444P8, 1, 1), (vs.YUV420P8, 18, 6), (vs.YUV444P10, 17, 3), (vs.YUV420P16, 34, 2), (vs.YUV444PS, 33, 3)]:
+            clip = self._pattern(format, width=width, height=height)
+            other = self.core.std.Invert(clip)
+            scale = 1 if clip.format.sample_type == vs.FLOAT else (1 << clip.format.bits_per_sample) - 1
+            props = self.core.std.PlaneStats(clip, other, plane=[0, 1, 2]).get_frame(0).props
+            for plane in range(3):
+                a = [v for row in self._pixels(clip, plane) for v in row]
+                b = [v for row in self._pixels(other, plane) for v in row]
+                self.assertEqual(props['PlaneStatsMin'][plane], min(a))
+                self.assertEqual(props['PlaneStatsMax'][plane], max(a))
+                self.assertAlmostEqual(props['PlaneStatsAverage'][plane], sum(a) / (len(a) * scale), places=6)
+                self.assertAlmostEqual(props['PlaneStatsDiff'][plane], sum(abs(x - y) for x, y in zip(a, b)) / (len(a) * scale), places=6)
+
+    def test_planestats_constant(self):
+        for format, color, scale in [(vs.GRAY8, 77, 255), (vs.GRAY16, 40000, 65535), (vs.GRAYS, 0.25, 1)]:
+            for width in [1, 17, 301]:
+                clip = self.BlankClip(format=format, width=width, height=5, color=color)
+                props = self.core.std.PlaneStats(clip, clip).get_frame(0).props
+                self.assertEqual(props['PlaneStatsMin'], color)
+                self.assertEqual(props['PlaneStatsMax'], color)
+                self.assertAlmostEqual(props['PlaneStatsAverage'], color / scale, places=9)
+                self.assertEqual(props['PlaneStatsDiff'], 0)
+
 if __name__ == '__main__':
     unittest.main()
@@ -66,5 +66,22 @@ class FilterTestSequence(unittest.TestCase):
         ret = self.Lut2(clipa=clipx, clipb=clipy, planes=[0, 1, 2], function=lambda x, y: x, bits=10)
         self.checkDifference(clipx, ret)
 
+    def testLUTFunctionShared(self):
+        calls = []
+        def f(x):
+            calls.append(x)
+            return x // 2
+        clip = self.BlankClip(format=vs.YUV420P8, color=[200, 100, 50])
+        ret1 = self.Lut(clip, function=f)
+        ret2 = self.Lut(clip, function=f)
+        self.assertEqual(len(calls), 256)
+        self.checkDifference(ret1, self.BlankClip(format=vs.YUV420P8, color=[100, 50, 25]))
+        self.checkDifference(ret2, self.BlankClip(format=vs.YUV420P8, color=[100, 50, 25]))
+
+        # a different output format needs its own table
+        ret3 = self.Lut(clip, function=f, bits=10)
+        self.assertEqual(len(calls), 512)
+        self.checkDifference(ret3, self.BlankClip(format=vs.YUV420P10, color=[100, 50, 25]))
+
 if __name__ == '__main__':
     unittest.main()
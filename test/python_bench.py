@@ -0,0 +1,175 @@
+# Times the Python side of the API, function invocation, argument conversion, frame requests,
+# frame property access and Python callbacks in filters. The clips are tiny BlankClips so the
+# numbers mostly reflect the overhead in vapoursynth.pyx and not the filters.
+#
+# Usage: python python_bench.py [--quick] [--repeat n] [--threads n] [--output file] [substring...]
+# Only benchmarks whose name contains one of the substrings are run. The results are written
+# as JSON to stdout or the output file, the time of the fastest of the repeats is reported.
+
+import argparse
+import json
+import platform
+import sys
+import time
+import vapoursynth as vs
+
+core = vs.core
+
+
+def small_clip(length):
+    return core.std.BlankClip(format=vs.GRAY8, width=16, height=16, length=length)
+
+
+def bench_function_call(n):
+    blank = core.std.BlankClip
+    start = time.perf_counter()
+    for _ in range(n):
+        blank()
+    return time.perf_counter() - start
+
+
+def bench_map_conversion(n):
+    clip = small_clip(1)
+    setprops = core.std.SetFrameProps
+    start = time.perf_counter()
+    for i in range(n):
+        setprops(clip, Int=i, Float=0.5, Ints=[1, 2, 3], Floats=[0.25, 0.75], Text='text', Data=b'data', Clip=clip)
+    return time.perf_counter() - start
+
+
+def bench_get_frame(n):
+    clip = small_clip(n)
+    start = time.perf_counter()
+    for i in range(n):
+        clip.get_frame(i)
+    return time.perf_counter() - start
+
+
+def bench_frames(n):
+    clip = small_clip(n)
+    start = time.perf_counter()
+    for _ in clip.frames():
+        pass
+    return time.perf_counter() - start
+
+
+def bench_frames_batched(n):
+    clip = small_clip(n)
+    start = time.perf_counter()
+    for _ in clip.frames_batched(16):
+        pass
+    return time.perf_counter() - start
+
+
+def bench_prop_read(n):
+    props = small_clip(1).std.SetFrameProps(Value=1).get_frame(0).props
+    start = time.perf_counter()
+    for _ in range(n):
+        props['Value']
+    return time.perf_counter() - start
+
+
+def bench_prop_write(n):
+    props = small_clip(1).get_frame(0).copy().props
+    start = time.perf_counter()
+    for i in range(n):
+        props['Value'] = i
+    return time.perf_counter() - start
+
+
+def bench_prop_iterate(n):
+    props = small_clip(1).std.SetFrameProps(**{f'Prop{i}': i for i in range(10)}).get_frame(0).props
+    start = time.perf_counter()
+    for _ in range(n // 10):
+        dict(props)
+    return time.perf_counter() - start
+
+
+def bench_frame_eval(n):
+    clip = small_clip(n)
+    evaluated = core.std.FrameEval(clip, lambda n: clip)
+    start = time.perf_counter()
+    for _ in evaluated.frames():
+        pass
+    return time.perf_counter() - start
+
+
+def bench_frame_eval_props(n):
+    clip = small_clip(n)
+    evaluated = core.std.FrameEval(clip, lambda n, f: clip, prop_src=clip)
+    start = time.perf_counter()
+    for _ in evaluated.frames():
+        pass
+    return time.perf_counter() - start
+
+
+def bench_modify_frame(n):
+    clip = small_clip(n)
+    modified = core.std.ModifyFrame(clip, clip, lambda n, f: f)
+    start = time.perf_counter()
+    for _ in modified.frames():
+        pass
+    return time.perf_counter() - start
+
+
+# name, function and number of operations in a full run
+benchmarks = [
+    ('function_call', bench_function_call, 100000),
+    ('map_conversion', bench_map_conversion, 100000),
+    ('get_frame', bench_get_frame, 10000),
+    ('frames', bench_frames, 10000),
+    ('frames_batched', bench_frames_batched, 10000),
+    ('prop_read', bench_prop_read, 1000000),
+    ('prop_write', bench_prop_write, 1000000),
+    ('prop_iterate', bench_prop_iterate, 1000000),
+    ('frame_eval', bench_frame_eval, 10000),
+    ('frame_eval_props', bench_frame_eval_props, 10000),
+    ('modify_frame', bench_modify_frame, 10000),
+]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmarks the overhead of the VapourSynth Python API.')
+    parser.add_argument('--quick', action='store_true', help='run a tenth of the operations')
+    parser.add_argument('--repeat', type=int, default=3, help='number of times every benchmark is run')
+    parser.add_argument('--threads', type=int, default=0, help='number of threads, the default is all of them')
+    parser.add_argument('--output', help='file to write the results to instead of stdout')
+    parser.add_argument('filters', nargs='*', help='only run benchmarks whose name contains one of these')
+    args = parser.parse_args()
+
+    if args.threads > 0:
+        core.num_threads = args.threads
+
+    results = []
+    for name, func, count in benchmarks:
+        if args.filters and not any(f in name for f in args.filters):
+            continue
+        if args.quick:
+            count //= 10
+        best = min(func(count) for _ in range(max(args.repeat, 1)))
+        results.append({
+            'name': name,
+            'operations': count,
+            'seconds': best,
+            'ns_per_operation': best * 1e9 / count,
+        })
+        print(f'{name}: {best * 1e9 / count:.0f} ns per operation', file=sys.stderr)
+
+    report = {
+        'vapoursynth': core.version_number(),
+        'python': platform.python_version(),
+        'threads': core.num_threads,
+        'quick': args.quick,
+        'results': results,
+    }
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(report, f, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+
+if __name__ == '__main__':
+    main()
@@ -27,6 +27,172 @@ class CoreTestSequence(unittest.TestCase):
             self.assertIsInstance(frame, vs.VideoFrame)
         self.assertEqual(e, 199)
 
+    def test_frames_batched(self):
+        clip = self.core.std.BlankClip(length=203)
+        for adaptive in (False, True):
+            batches = list(clip.frames_batched(8, adaptive=adaptive))
+            self.assertEqual([len(b) for b in batches], [8] * 25 + [3])
+            for batch in batches:
+                for frame in batch:
+                    self.assertIsInstance(frame, vs.VideoFrame)
+
+    def test_shared_thread_pool(self):
+        pool = vs.SharedThreadPool(2)
+        self.core.attach_shared_thread_pool(pool, 3)
+        self.core.attach_shared_thread_pool(pool, 1)
+        with self.assertRaises(vs.Error):
+            self.core.attach_shared_thread_pool(vs.SharedThreadPool())
+        with self.assertRaises(ValueError):
+            self.core.attach_shared_thread_pool(pool, 0)
+        del pool
+        self.assertEqual(len(list(self.core.std.BlankClip(length=50).frames())), 50)
+
+    def test_set_concurrency(self):
+        clip = self.core.std.BlankClip(length=100).std.Expr('x 1 +')
+        clip.set_concurrency(max_concurrency=1)
+        self.assertEqual(len(list(clip.frames())), 100)
+        clip.set_concurrency(max_concurrency=0, frame_scratch_size=1024, max_scratch_size=3000)
+        self.assertEqual(len(list(clip.frames())), 100)
+
+    def test_frames_batched_early_exit(self):
+        clip = self.core.std.BlankClip(length=1000)
+        gen = clip.frames_batched(4, prefetch=64)
+        self.assertEqual(len(next(gen)), 4)
+        gen.close()
+        self.assertEqual(len(next(clip.frames_batched(4))), 4)
+
+    def test_plane_array_interface(self):
+        frame = self.core.std.BlankClip(format=vs.YUV420P16, width=640, height=480, color=[1, 2, 3]).get_frame(0)
+        plane = list(frame.planes())[1]
+        iface = plane.__array_interface__
+        self.assertEqual(iface['shape'], (240, 320))
+        self.assertEqual(iface['strides'], (frame.get_stride(1), 2))
+        self.assertEqual(iface['typestr'][1:], 'u2')
+        self.assertEqual(iface['data'], (frame.get_read_ptr(1).value, True))
+        self.assertEqual(plane.__dlpack_device__(), (1, 0))
+
+    def test_frame_from_buffers(self):
+        src = self.core.std.BlankClip(format=vs.YUV420P8, width=640, height=480, color=[10, 20, 30]).get_frame(0)
+        frame = self.core.create_video_frame_from_buffers(src.format, 640, 480, list(src.planes()))
+        for p in range(3):
+            self.assertEqual(frame.get_stride(p), src.get_stride(p))
+            self.assertEqual(memoryview(list(frame.planes())[p]).tobytes(), memoryview(list(src.planes())[p]).tobytes())
+        with self.assertRaises(ValueError):
+            self.core.create_video_frame_from_buffers(src.format, 320, 480, list(src.planes()))
+
+    def test_read_frames(self):
+        clip = self.core.std.BlankClip(format=vs.YUV420P8, width=64, height=48, color=[10, 20, 30], length=20)
+        out = bytearray(12 * 32 * 24 * 2)
+        clip.read_frames(out, start=5, count=12, planes=[1, 2], prefetch=3)
+        self.assertEqual(out, (bytes([20]) * (32 * 24) + bytes([30]) * (32 * 24)) * 12)
+        luma = bytearray(20 * 64 * 48)
+        clip.read_frames(luma, planes=0)
+        self.assertEqual(luma, bytes([10]) * len(luma))
+        with self.assertRaises(ValueError):
+            clip.read_frames(bytearray(10), planes=0)
+        with self.assertRaises(ValueError):
+            clip.read_frames(luma, planes=[0, 1])
+
+    def test_select_by_prop(self):
+        blank = self.core.std.BlankClip(format=vs.GRAY8, width=16, height=16, length=10)
+        control = self.core.std.Interleave([blank.std.SetFrameProps(_Pick=0), blank.std.SetFrameProps(_Pick=1), blank.std.SetFrameProps(_Pick=5)])
+        clips = [blank.std.BlankClip(color=10), blank.std.BlankClip(color=20)]
+        clip = self.core.std.SelectByProp(clips, [control], 'x._Pick')
+        self.assertEqual([memoryview(next(f.planes()))[0, 0] for f in clip.frames()], [10, 20, 20] * 3 + [10])
+        with self.assertRaises(vs.Error):
+            self.core.std.SelectByProp(clips, [control], 'x 1 +')
+
+    def test_merge_half(self):
+        clipa = self.core.std.BlankClip(format=vs.GRAYH, width=40, height=8, color=0.25)
+        clipb = self.core.std.BlankClip(format=vs.GRAYH, width=40, height=8, color=0.75)
+        merged = self.core.std.Merge(clipa, clipb, weight=0.5).std.PlaneStats()
+        self.assertEqual(merged.get_frame(0).props['PlaneStatsAverage'], 0.5)
+        diff = self.core.std.MakeDiff(clipb, clipa).std.PlaneStats(clipa)
+        props = diff.get_frame(0).props
+        self.assertEqual(props['PlaneStatsMax'], 0.5)
+        self.assertEqual(props['PlaneStatsDiff'], 0.25)
+
+    def test_props_view(self):
+        frame = self.core.std.BlankClip(format=vs.GRAY8, width=16, height=16).get_frame(0).copy()
+        frame.props['Ints'] = list(range(1000))
+        frame.props['Floats'] = [0.5, 1.5]
+        frame.props['Blob'] = [b'abc', b'de']
+        ints = frame.props.get_view('Ints')
+        self.assertEqual(len(ints), 1000)
+        self.assertEqual(ints[-1], 999)
+        self.assertEqual(memoryview(ints).format, 'q')
+        self.assertEqual(memoryview(ints).tolist(), list(range(1000)))
+        self.assertEqual(list(memoryview(frame.props.get_view('Floats'))), [0.5, 1.5])
+        blob = frame.props.get_view('Blob')
+        self.assertEqual(bytes(blob[1]), b'de')
+        frame.props['Ints'] = 5
+        self.assertEqual(ints[1:3], [1, 2])
+        with self.assertRaises(KeyError):
+            frame.props.get_view('Missing')
+
+    def test_record_requests(self):
+        import os, struct, tempfile
+        clip = self.core.std.BlankClip(length=10)
+        clip.set_output(3)
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            self.core.record_requests(path)
+            clip.get_frame(2)
+            self.core.std.BlankClip().get_frame(0)
+            self.core.record_requests()
+            with open(path, 'rb') as f:
+                data = f.read()
+        finally:
+            os.remove(path)
+            vs.clear_output(3)
+        self.assertEqual(len(data), 8 + 2 * 16)
+        self.assertEqual(struct.unpack_from('=iiBB', data, 12), (2, 3, 0, 0))
+        self.assertEqual(struct.unpack_from('=ii', data, 28), (0, -1))
+
+    def test_cache_sizes(self):
+        import os, tempfile
+        clip = self.core.std.BlankClip(length=10).std.Invert()
+        stacked = self.core.std.StackHorizontal([clip, clip])
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            self.core.save_cache_sizes(path)
+            with open(path) as f:
+                lines = f.read().splitlines()
+            self.core.load_cache_sizes(path)
+        finally:
+            os.remove(path)
+        self.assertEqual(lines[0], 'VapourSynthCacheSizes\t1')
+        self.assertTrue(lines[1:])
+        self.assertTrue(all(len(line.split('\t')) == 4 for line in lines[1:]))
+        with self.assertRaises(vs.Error):
+            self.core.load_cache_sizes(path)
+
+    def test_lightweight_chain(self):
+        blank = self.core.std.BlankClip(format=vs.GRAY8, width=16, height=16, length=100)
+        control = self.core.std.Interleave([blank.std.SetFrameProps(_Pick=0), blank.std.SetFrameProps(_Pick=1)])
+        clip = blank.std.CopyFrameProps(control.std.Trim(10, 109)).std.SetFrameProp('Stage', intval=1).std.AssumeFPS(fpsnum=25)
+        clip = clip.std.SetFieldBased(1).std.RemoveFrameProps('Stage')
+        self.assertEqual(clip.num_frames, 100)
+        self.assertEqual([f.props['_Pick'] for f in clip.frames()], [0, 1] * 50)
+        self.assertTrue(all(f.props['_FieldBased'] == 1 and 'Stage' not in f.props for f in clip.frames()))
+
+    def test_output_file(self):
+        import io, tempfile
+        clip = self.core.std.BlankClip(format=vs.YUV420P10, width=64, height=48, length=5, color=[10, 20, 30])
+        expected = io.BytesIO()
+        clip.output(expected, y4m=True)
+        progress = []
+        with tempfile.TemporaryFile() as f:
+            clip.output(f, y4m=True, progress_update=lambda n, total: progress.append(n))
+            f.seek(0)
+            self.assertEqual(f.read(), expected.getvalue())
+        self.assertEqual(progress, list(range(6)))
+        with tempfile.TemporaryFile() as f:
+            with self.assertRaises(ZeroDivisionError):
+                clip.output(f, progress_update=lambda n, total: 1 // (n - 3))
+
 ### Filter-Call-Tests
 
     def test_func1(self):
@@ -230,6 +396,18 @@ class CoreTestSequence(unittest.TestCase):
             levels_clip = self.core.std.BlankClip(format=vs.YUV420P10, color=[i, 0, 0]).std.Levels(min_in=504, max_in=520, gamma=1, min_out=0, max_out=1023, planes=0).std.PEMVerifier()
             levels_clip.get_frame(0)
 
+    def test_convolution_hv(self):
+        def blank(color, width=24):
+            return self.core.std.BlankClip(format=vs.GRAY8, width=width, height=72, color=color)
+        clip = self.core.std.StackHorizontal([blank(10), blank(200), blank(60)])
+        sep = clip.std.Convolution([1, 2, 1], mode='hv')
+        square = clip.std.Convolution([1, 2, 1, 2, 4, 2, 1, 2, 1])
+        self.assertEqual(sep.std.PlaneStats(square).get_frame(0).props['PlaneStatsDiff'], 0)
+        props = blank(100, 72).std.Convolution([1] * 65, mode='hv').std.PlaneStats().get_frame(0).props
+        self.assertEqual((props['PlaneStatsMin'], props['PlaneStatsMax']), (100, 100))
+        with self.assertRaises(vs.Error):
+            clip.std.Convolution([1] * 67, mode='hv')
+
     def test_convolution_clamp(self):
         for i in range(1024):
             levels_clip = self.core.std.BlankClip(format=vs.YUV420P10, color=[i, 0, 0]).std.Convolution([1, 1, 1, 1, 1, 1, 1, 1, 1], divisor=.1, planes=0).std.PEMVerifier()